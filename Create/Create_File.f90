@@ -1,4 +1,9 @@
 Program Create_File
+!
+! Reorders the DHSVM stream forcings into the RBM forcing file.  It
+! works one time step at a time: only the forcings of one step of the
+! network are kept in memory, whatever the length of the run
+!
 implicit none
 !
 ! Integer variables
@@ -8,6 +13,7 @@ integer::narray,nf,nfile,n_head,nn,no_years,no_seg
 integer::no_dt,no_days,nobs_start,nobs_end
 integer::start_day,start_mon,start_yr,end_day,end_mon,end_yr,start_hour,end_hour
 integer::Julian,start_jul,end_jul
+integer::nvar,nseg_in,max_id
 integer,allocatable,dimension(:):: seg_no,seg_indx,seg_seq,seg_net
 integer,allocatable,dimension(:):: dummy
 !
@@ -15,10 +21,19 @@ integer,allocatable,dimension(:):: dummy
 real::press=1013.
 real,allocatable,dimension(:)::depth,out_flow,in_flow,lat_flow
 real,allocatable,dimension(:,:)::forcing
+real,allocatable,dimension(:,:)::record,rbm_record
+!
+! Logical variables
+!
+logical::binary=.false.
 !
 ! Character variables
 !
 character (len=1)  :: colon=':'
+character (len=1)  :: blank
+character (len=8)  :: magic
+character (len=20) :: record_date
+character (len=200):: Format
 character (len=19) :: start_date,end_date 
 character (len=19) :: time_stamp0,time_stamp
 character (len=4)  :: path
@@ -39,12 +54,18 @@ integer numarg
         write (*,*) ' '
         write (*,*) 'First:  Directory with forcing files *(*.Only)'
         write (*,*) 'Second:  Project Name'
+        write (*,*) 'Third (optional): BINARY to read RBM.Forcing.bin'
+        write (*,*) '        and write <Project Name>.forcing.bin'
         write (*,*) 'eg: $ ./Create_File <Input directory> <Project Name>'
         write (*,*) ' '
         stop
       end if
       call getarg ( 1, InDirectry )
       call getarg ( 2, Project )
+      if (numarg .ge. 3) then
+        call getarg ( 3, Format )
+        binary = TRIM(Format) .eq. 'BINARY'
+      end if
 !
 !write(*,*) 'Name of Project.  Required files include:'
 !write(*,*) 'ProjectName.map'
@@ -60,40 +81,55 @@ integer numarg
 !
 write(*,*) TRIM(Project)//'.map'
 open(10,file=TRIM(Project)//'.segmap',status='old')
-open(20,file=TRIM(InDirectry)//'/ATP.Only',status='old')
-open(21,file=TRIM(InDirectry)//'/NLW.Only',status='old')
-open(22,file=TRIM(InDirectry)//'/NSW.Only',status='old')
-open(23,file=TRIM(InDirectry)//'/VP.Only',status='old')
-open(24,file=TRIM(InDirectry)//'/WND.Only',status='old')
-open(25,file=TRIM(InDirectry)//'/Inflow.Only',status='old')
-open(26,file=TRIM(InDirectry)//'/Outflow.Only',status='old')
-!
-open(30,file=TRIM(Project)//'.forcing',status='unknown')
+if (binary) then
+!
+! DHSVM run with CHANNEL OUTPUT FORMAT = BINARY writes all the forcings
+! to RBM.Forcing.bin, see channel_save_outflow_bin_cplmt()
+!
+  open(19,file=TRIM(InDirectry)//'/RBM.Forcing.bin',status='old'        &
+      ,access='stream',form='unformatted')
+  open(30,file=TRIM(Project)//'.forcing.bin',status='replace'           &
+      ,access='stream',form='unformatted')
+else
+  open(20,file=TRIM(InDirectry)//'/ATP.Only',status='old')
+  open(21,file=TRIM(InDirectry)//'/NLW.Only',status='old')
+  open(22,file=TRIM(InDirectry)//'/NSW.Only',status='old')
+  open(23,file=TRIM(InDirectry)//'/VP.Only',status='old')
+  open(24,file=TRIM(InDirectry)//'/WND.Only',status='old')
+  open(25,file=TRIM(InDirectry)//'/Inflow.Only',status='old')
+  open(26,file=TRIM(InDirectry)//'/Outflow.Only',status='old')
+!
+  open(30,file=TRIM(Project)//'.forcing',status='unknown')
+end if
 !
 ! Get some information about the network from the "<Project>.map" file
 !
 read(10,*) n_head,no_seg
 !
-! Allocate arrays after increasing expected size to account
-! for differences in the number of segments and the size of
-! the largest stream segment number in DHSVM.
-!
-narray=no_seg+no_seg/2
-allocate (dummy(narray))
-allocate (seg_no(narray))
-allocate (seg_indx(narray))
-allocate (seg_net(narray))
-allocate (seg_seq(narray))
-allocate (in_flow(narray))
-allocate (out_flow(narray))
-!allocate (lat_flow(narray))
-!allocate (depth(narray))
-allocate (forcing(5,narray))
+allocate (seg_no(no_seg))
 !
 do n=1,no_seg
   read(10,*) sequence,nn,path,seg_no(n)
 end do
 !
+if (binary) then
+  read(19) magic
+  if (magic .ne. 'DHSVMRBM') then
+    write(*,*) TRIM(InDirectry)//'/RBM.Forcing.bin is not a forcing file'
+    stop
+  end if
+  read(19) start_date,blank,end_date,no_dt,nseg_in,nvar
+  write(*,*) 'start ',start_date
+  write(*,*) 'end ',end_date
+  read(start_date,'(i2,1x,i2,1x,i4,1x,i2,a6)') start_mon,start_day,start_yr  &
+                                              ,start_hour,fluff
+  start_jul=Julian(start_yr,start_mon,start_day)
+  read(end_date,'(i2,1x,i2,1x,i4,1x,i2,a6)') end_mon,end_day,end_yr          &
+                                              ,end_hour,fluff
+  allocate (record(nvar,nseg_in))
+  narray=nseg_in
+else
+narray=no_seg
 nfile=20
 do nf=1,7
   read(nfile,'(A19,1x,A19,1x,i2)') start_date,end_date, no_dt
@@ -106,7 +142,16 @@ do nf=1,7
                                               ,end_hour,fluff
   nfile=nfile+1
 end do
+end if
 !
+! The arrays of one time step, in the order of the DHSVM files
+!
+allocate (dummy(narray))
+allocate (seg_seq(narray))
+allocate (in_flow(narray))
+allocate (out_flow(narray))
+allocate (forcing(5,narray))
+if (binary) allocate (rbm_record(8,no_seg))
 !
 delta_t=no_dt
 !
@@ -150,10 +195,15 @@ no_cycles=nobs_start+nobs_end+no_dt*(no_days-1)
 
 !
 write(*,*) 'no_cycles ',no_cycles
+if (binary) then
+  write(30) start_yr,start_mon,start_day,start_hour                   &
+           ,end_yr,end_mon,end_day,end_hour,no_dt,nd_start
+else
 write(30,'(2(i4.4,i2.2,i2.2,a1,i2.2,1x),2i4)')          &
      start_yr,start_mon,start_day,colon,start_hour          &
     ,end_yr,end_mon,end_day,colon,end_hour                  &
     ,no_dt,nd_start
+end if
 !
 ! Read segment mapping
 !
@@ -164,25 +214,61 @@ nfile=19
 ! the indexed location in the forcing files
 !
   nfile=nfile+1
+if (binary) then
+  read(19) (seg_seq(n),n=1,nseg_in)
+else
   read(nfile,*) (seg_seq(n),n=1,no_seg)
-  do nf=1,no_seg
-    seg_net(seg_seq(nf))=nf
-  end do
+end if
+!
+! SEG_NET is indexed by the DHSVM segment number, which can be larger
+! than the number of segments
+!
+max_id=max(maxval(seg_seq),maxval(seg_no))
+allocate (seg_net(max_id))
+seg_net=0
+do nf=1,narray
+  seg_net(seg_seq(nf))=nf
+end do
+do n=1,no_seg
+  if (seg_net(seg_no(n)) .eq. 0) then
+    write(*,*) 'Segment ',seg_no(n),' of the segment map is not in the DHSVM output'
+    stop
+  end if
+end do
+if (.not. binary) then
 do nf=2,7
   nfile=nfile+1
   read(nfile,*) (dummy(n),n=1,no_seg)
 !  read(nfile,*) time_stamp0
 !  write(*,"('Initial Time Stamp - ',a19)"), time_stamp0
 end do!
+end if
 ! Read the forcings from the DHSVM file
 !
 do nc=1,no_cycles
+  if (binary) then
+!
+! The variables of each segment are stored in the order inflow, outflow,
+! ISW, NSW, ILW, NLW, VP, WND, ATP, Beam, Diffuse, Skyview
+!
+    read(19) record_date,record
+    do n=1,nseg_in
+      forcing(1,n)=record(9,n)
+      forcing(2,n)=record(6,n)
+      forcing(3,n)=record(4,n)
+      forcing(4,n)=record(7,n)
+      forcing(5,n)=record(8,n)
+      in_flow(n)=record(1,n)
+      out_flow(n)=record(2,n)
+    end do
+  else
   nfile=19
   do nf=1,5
     nfile=nfile+1
     read(nfile,*) time_stamp,(forcing(nf,n),n=1,no_seg)
   end do
-  do n=1,no_seg
+  end if
+  do n=1,narray
     forcing(4,n)=0.01*forcing(4,n)
     forcing(2,n)=2.3884e-04*forcing(2,n)
     forcing(3,n)=2.3884e-04*forcing(3,n)
@@ -190,9 +276,11 @@ do nc=1,no_cycles
 !
 ! Read the streamflow from the DHSVM file
 !
+  if (.not. binary) then
   read(25,*) time_stamp,(in_flow(n),n=1,no_seg)
   read(26,*) time_stamp,(out_flow(n),n=1,no_seg)
-  do n=1,no_seg
+  end if
+  do n=1,narray
     ! Convert the unit from cubic meter per sec to cubic feet per sec
     in_flow(n) = in_flow(n) * 35.315;
     out_flow(n) = out_flow(n) * 35.315;
@@ -211,8 +299,19 @@ do nc=1,no_cycles
     nf=seg_no(n)
     nn=seg_net(nf)
     !write(*,*) n,nf,nn
+    if (binary) then
+      rbm_record(1,n)=press
+      rbm_record(2:6,n)=forcing(1:5,nn)
+      rbm_record(7,n)=in_flow(nn)
+      rbm_record(8,n)=out_flow(nn)
+    else
     write(30,*) n,press,(forcing(nf,nn),nf=1,5)                  &
                ,in_flow(nn),out_flow(nn)
+    end if
   end do
+!
+! The binary time step is written at once
+!
+  if (binary) write(30) rbm_record
 end do
 end Program Create_File
@@ -12,8 +12,20 @@
  * 2) Forces flat areas to have known drainage directions by adding incremental 
  *    elevation adjustments.
  * 
- * Usage: <input DEM> <output DEM> <rows> <columns> <NODATA>
+ * Usage: <input DEM> <mask> <output DEM> <rows> <columns> <NODATA> [method]
  * Dems should be binary floats, as needed for DHSVM input.
+ *
+ * With method "priority" or "priority-edges" the sinks are instead filled
+ * in one pass with the priority-flood (Barnes et al., 2014): the cells are
+ * flooded from the outlets in the order of their elevation, kept in a
+ * min-heap, and a cell that is not above the cell it is reached from is
+ * raised to the next float above it (epsilon filling), so that flats get a
+ * gradient towards the outlet.  This takes O(n log n) for n cells however
+ * many pits there are.  The flow direction of a cell is that to the cell it
+ * was reached from, and the flow accumulation is summed in the reverse of
+ * the flooding order, without the iterations and the sort.  "priority" has
+ * a single outlet, the lowest cell of the edge of the mask, as the iterative
+ * method; with "priority-edges" every cell of the edge is an outlet.
  * DESCRIP-END.
  * FUNCTIONS: equal.c from DHSVM
  * COMMENTS: compile with: gcc FILL_SINKS_DHSVM.c -lm -o FILL_SINKS_DHSVM
@@ -27,6 +39,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 
 /******************************************************************************/
 /*				GLOBAL VARIABLES                              */
@@ -40,6 +53,14 @@ typedef struct {
   int   y;
 } ITEM;
 
+typedef struct {
+  float Elev;
+  int   Cell;			/* y * ncols + x */
+  int   Order;			/* order of insertion, so that cells of equal
+				   elevation are flooded in the order they
+				   are reached */
+} HEAPITEM;
+
 int xneighbor[NDIR] = {0, 1, 0, -1};
 int yneighbor[NDIR] = {-1, 0, 1, 0};
 int DirIndex[NDIR] = {1, 2, 3, 4};
@@ -57,13 +78,22 @@ void assign_pour_point(int **NumxL, int **NumxR, int **NumyN, int **NumyS,
 		       float **Dem, int **Dir, int nrows, int ncols, int max, 
 		       int min, float NODATA);
 void AllocateArrays(int ***NumxL, int ***NumxR, int ***NumyS, int ***NumyN,
-		    int ***Dir, float ***Dem, int ***FlowAcc, unsigned char ***Mask, int ncols, int nrows);
+		    int ***Dir, float ***Dem, int ***FlowAcc, unsigned char ***Mask, int ncols, int nrows,
+		    int Radial);
 float average(float **Dem,int i, int j, int ncols, int nrows, float NODATA);
 unsigned char fequal(float a, float b);
 unsigned char fless(float a, float b);
 void FlowAccumulation(float **Dem, int ncols, int nrows, float NODATA, int **Dir, int **FlowAcc);
 void quick(ITEM *OrderedCells, int count);
 void qs(ITEM *item, int left, int right);
+void IterativeFill(int ncols, int nrows, float **Dem, int **Dir,
+		   int **NumxL, int **NumxR, int **NumyN, int **NumyS,
+		   int **FlowAcc, float NODATA);
+void WriteGrid(char *FileName, float *Matrix, int ncols, int nrows);
+void PriorityFlood(int ncols, int nrows, float **Dem, int **Dir, int **FlowAcc,
+		   float NODATA, int EdgeOutlets);
+void HeapPush(HEAPITEM *Heap, int *NHeap, float Elev, int Cell, int Order);
+HEAPITEM HeapPop(HEAPITEM *Heap, int *NHeap);
 
 /******************************************************************************/
 /*				    MAIN PROGRAM                              */
@@ -71,35 +101,33 @@ void qs(ITEM *item, int left, int right);
 
 int main(int argc, char **argv)
 {
-  int i, j, n;
+  int i, j;
   int x, y;
-  int xn, yn;
   float **Dem;
   int **Dir;
   int **NumxL, **NumxR, **NumyS, **NumyN;
   int **FlowAcc;
   unsigned char **Mask;
-  FILE *fi, *fo;
+  FILE *fi;
   int nrows, ncols;
   float xmin, xmax, ymin, ymax;
   float NODATA, cellsize;
   float xll, yll;
-  int NumSinks, NumUndefined, NumOutlets;
   char InFile[100], OutFile[100], MaskFile[100];
   int NElements;
   float *Matrix;
   unsigned char *MaskArray;
-  float OutletElevation;
-  int MaxAccum;
-  float min;
-  int steepestdirection;
-  int SetOutlets = 1;
+  int Priority = 0;
+  int EdgeOutlets = 0;
 
-  if(argc != 7) {
-    fprintf(stderr, "%s <input dem> <mask> <output dem> <rows> <columns> <NODATA>\n",
+  if(argc != 7 && argc != 8) {
+    fprintf(stderr, "%s <input dem> <mask> <output dem> <rows> <columns> <NODATA> [method]\n",
 	    argv[0]);
     fprintf(stderr, "Dems should be binary float grids, as used by DHSVM.\n");
     fprintf(stderr, "The mask file should be a binary unsigned char grid, as used by DHSVM.\n");
+    fprintf(stderr, "method is iterative (the default), priority (priority-flood with the\n");
+    fprintf(stderr, "lowest edge cell of the mask as the outlet) or priority-edges (with\n");
+    fprintf(stderr, "all the edge cells as outlets).\n");
     exit(0);
   }
   strcpy(InFile, argv[1]);
@@ -108,14 +136,25 @@ int main(int argc, char **argv)
   nrows = atoi(argv[4]);
   ncols = atoi(argv[5]);
   NODATA = atof(argv[6]);
+  if(argc == 8) {
+    if(strcmp(argv[7], "priority") == 0)
+      Priority = 1;
+    else if(strcmp(argv[7], "priority-edges") == 0)
+      Priority = EdgeOutlets = 1;
+    else if(strcmp(argv[7], "iterative") != 0) {
+      fprintf(stderr, "Unknown method %s\n", argv[7]);
+      exit(0);
+    }
+  }
 
   if((fi=fopen(InFile,"rb")) == NULL) {
     fprintf(stderr, "Could not open %s\n", InFile);
     exit(0);
   } 
 
+  /* the priority-flood does not need the search arrays */
   AllocateArrays(&NumxL,&NumxR,&NumyS,&NumyN,
-		 &Dir, &Dem, &FlowAcc, &Mask, ncols, nrows);
+		 &Dir, &Dem, &FlowAcc, &Mask, ncols, nrows, !Priority);
 
   if (!(Matrix = (float *) calloc(ncols*nrows,
 				  sizeof(float)))) {
@@ -160,6 +199,69 @@ int main(int argc, char **argv)
     }
   }
  
+  if(Priority)
+    PriorityFlood(ncols, nrows, Dem, Dir, FlowAcc, NODATA, EdgeOutlets);
+  else
+    IterativeFill(ncols, nrows, Dem, Dir, NumxL, NumxR, NumyN, NumyS,
+		  FlowAcc, NODATA);
+
+  /* Save the flow accumulation and the flow direction grids. */
+  for (y = 0; y < nrows; y++){
+    for (x = 0; x < ncols; x++) {
+      Matrix[y * ncols + x] = FlowAcc[y][x];
+    }
+  }
+  WriteGrid("FlowAcc.bin", Matrix, ncols, nrows);
+
+  for (y = 0; y < nrows; y++){
+    for (x = 0; x < ncols; x++) {
+      Matrix[y * ncols + x] = Dir[y][x];
+    }
+  }
+  WriteGrid("Dir.bin", Matrix, ncols, nrows);
+
+  for (y = 0; y < nrows; y++){
+    for (x = 0; x < ncols; x++) {
+      Matrix[y * ncols + x] = Dem[y][x];
+    }
+  }
+  WriteGrid(OutFile, Matrix, ncols, nrows);
+  free(Matrix);
+
+  if(!Priority) {
+    for(i=0; i<nrows; i++){
+      free(NumxL[i]);
+      free(NumxR[i]);
+      free(NumyN[i]);
+      free(NumyS[i]);
+    }
+    free(NumxL);
+    free(NumxR);
+    free(NumyN);
+    free(NumyS);
+  }
+
+} /* End of Main. */
+
+/* -------------------------------------------------------------
+   IterativeFill()
+   Fills the sinks with repeated radial searches, the default
+   method.
+   ------------------------------------------------------------- */
+void IterativeFill(int ncols, int nrows, float **Dem, int **Dir,
+		   int **NumxL, int **NumxR, int **NumyN, int **NumyS,
+		   int **FlowAcc, float NODATA)
+{
+  int n;
+  int x, y;
+  int xn, yn;
+  int NumSinks, NumUndefined, NumOutlets;
+  float OutletElevation;
+  int MaxAccum;
+  float min;
+  int steepestdirection;
+  int SetOutlets = 1;
+
   /* Fill in flow direction grid. */
   find_flowdir(0, 0, ncols, nrows, ncols, nrows, Dem, Dir, NODATA, SetOutlets);  SetOutlets = 0;
 
@@ -260,83 +362,207 @@ int main(int argc, char **argv)
      }
   }
 
+  FlowAccumulation(Dem, ncols, nrows, NODATA, Dir, FlowAcc);
+} /* End of function. */
 
-   if((fo=fopen("FlowAcc.bin","wb")) == NULL) {
-    fprintf(stderr, "Could not open %s\n", OutFile);
+/* -------------------------------------------------------------
+   PriorityFlood()
+   Fills the sinks, and finds the flow directions and the flow
+   accumulation, in one pass over the cells in the order of their
+   elevation from the outlets (Barnes et al., 2014, Priority-Flood+
+   epsilon).  With EdgeOutlets all the cells at the edge of the mask
+   are outlets, otherwise only the lowest of them.  A part of the
+   mask that is not connected to the rest gets the lowest of its
+   edge cells as its outlet.
+   ------------------------------------------------------------- */
+void PriorityFlood(int ncols, int nrows, float **Dem, int **Dir, int **FlowAcc,
+		   float NODATA, int EdgeOutlets)
+{
+  int x, y, n;
+  int xn, yn;
+  int c, cn;
+  int count, k;
+  int NHeap, NOrder, NPushed, NRaised, NOutlets, Edge, Lowest;
+  unsigned char *Closed;
+  int *Order;
+  HEAPITEM *Heap;
+  HEAPITEM Item;
+
+  if (!(Closed = (unsigned char *) calloc(ncols * nrows, sizeof(unsigned char))) ||
+      !(Order = (int *) calloc(ncols * nrows, sizeof(int))) ||
+      !(Heap = (HEAPITEM *) calloc(ncols * nrows, sizeof(HEAPITEM)))) {
+    fprintf(stderr, "Error allocating memory in PriorityFlood().\n");
     exit(0);
-  } 
+  }
 
-   for (y = 0; y < nrows; y++){
-     for (x = 0; x < ncols; x++) {
-       Matrix[y * ncols + x] = FlowAcc[y][x];
-     }
+  count = 0;
+  for (y = 0; y < nrows; y++) {
+    for (x = 0; x < ncols; x++) {
+      if(Dem[y][x] != NODATA) {
+	count++;
+	Dir[y][x] = 0;
+	FlowAcc[y][x] = 1;
+      }
+      else {
+	Dir[y][x] = NODATA;
+	FlowAcc[y][x] = NODATA;
+	Closed[y * ncols + x] = 1;
+      }
+    }
+  }
 
+  NHeap = 0;
+  NOrder = 0;
+  NPushed = 0;
+  NRaised = 0;
+  NOutlets = 0;
+  while(NOrder < count) {
+    /* The outlets: the cells at the edge of the mask, that have a
+       neighbor outside the grid or without data, of the cells not
+       flooded yet. */
+    Lowest = -1;
+    for (y = 0; y < nrows; y++) {
+      for (x = 0; x < ncols; x++) {
+	if(Closed[y * ncols + x])
+	  continue;
+	Edge = 0;
+	for(n = 0; n < NDIR; n++) {
+	  yn = y + yneighbor[n];
+	  xn = x + xneighbor[n];
+	  if(yn < 0 || yn >= nrows || xn < 0 || xn >= ncols || Dem[yn][xn] == NODATA)
+	    Edge = 1;
+	}
+	if(!Edge)
+	  continue;
+	if(EdgeOutlets) {
+	  Closed[y * ncols + x] = 1;
+	  Dir[y][x] = -99;
+	  HeapPush(Heap, &NHeap, Dem[y][x], y * ncols + x, NPushed++);
+	  NOutlets++;
+	}
+	else if(Lowest < 0 || Dem[y][x] < Dem[Lowest / ncols][Lowest % ncols])
+	  Lowest = y * ncols + x;
+      }
+    }
+    if(Lowest >= 0) {
+      Closed[Lowest] = 1;
+      Dir[Lowest / ncols][Lowest % ncols] = -99;
+      HeapPush(Heap, &NHeap, Dem[Lowest / ncols][Lowest % ncols], Lowest, NPushed++);
+      NOutlets++;
+    }
 
-/******************************************************************************/ 
-/* Added the following section so that the flow direction grid would be saved */ 
-/******************************************************************************/ 
+    /* Flood from the outlets, raising the cells that are not above the
+       cell they are reached from to the next float above it.  Each cell
+       drains to the cell it is reached from. */
+    while(NHeap > 0) {
+      Item = HeapPop(Heap, &NHeap);
+      c = Item.Cell;
+      Order[NOrder++] = c;
+      y = c / ncols;
+      x = c % ncols;
+      for(n = 0; n < NDIR; n++) {
+	yn = y + yneighbor[n];
+	xn = x + xneighbor[n];
+	if(yn < 0 || yn >= nrows || xn < 0 || xn >= ncols)
+	  continue;
+	cn = yn * ncols + xn;
+	if(Closed[cn])
+	  continue;
+	Closed[cn] = 1;
+	Dir[yn][xn] = DirIndex[(n + NDIR / 2) % NDIR];
+	if(Dem[yn][xn] <= Item.Elev) {
+	  Dem[yn][xn] = nextafterf(Item.Elev, FLT_MAX);
+	  NRaised++;
+	}
+	HeapPush(Heap, &NHeap, Dem[yn][xn], cn, NPushed++);
+      }
+    }
+  }
 
-if((fo=fopen("Dir.bin","wb")) == NULL) { 
-fprintf(stderr, "Could not open %s\n", OutFile); 
-exit(0); 
-} 
+  /* Each cell is flooded after the cell it drains to, so the upstream
+     cells come first in the reverse of the flooding order. */
+  for(k = NOrder - 1; k >= 0; k--) {
+    c = Order[k];
+    y = c / ncols;
+    x = c % ncols;
+    if(Dir[y][x] > 0) {
+      yn = y + yneighbor[Dir[y][x] - 1];
+      xn = x + xneighbor[Dir[y][x] - 1];
+      FlowAcc[yn][xn] += FlowAcc[y][x];
+    }
+  }
 
-for (y = 0; y < nrows; y++){ 
-for (x = 0; x < ncols; x++) { 
-Matrix[y * ncols + x] = Dir[y][x]; 
-} 
-} 
+  fprintf(stderr, "NumRaised = %d, NumOutlets = %d\n", NRaised, NOutlets);
 
-/******************************************************************************/ 
-/* End of section added so that the flow direction grid would be saved */ 
-/******************************************************************************/ 
-   }
+  free(Closed);
+  free(Order);
+  free(Heap);
+} /* End of function. */
 
+/* -------------------------------------------------------------
+   HeapPush(), HeapPop()
+   Binary min-heap of the cells of PriorityFlood(), ordered by
+   elevation and then by the order of insertion.
+   ------------------------------------------------------------- */
+#define HEAPLESS(a, b) ((a).Elev < (b).Elev || \
+			((a).Elev == (b).Elev && (a).Order < (b).Order))
 
-  NElements = 0;
-  NElements = fwrite(Matrix,sizeof(float), nrows*ncols,fo);
- 
-  if(NElements != nrows*ncols) {
-    fprintf(stderr, "Problem writing in %s\n",OutFile);
-    fprintf(stderr, "NElements = %d\n", NElements);
-    exit(0);
+void HeapPush(HEAPITEM *Heap, int *NHeap, float Elev, int Cell, int Order)
+{
+  HEAPITEM Item;
+  int i, parent;
+
+  Item.Elev = Elev;
+  Item.Cell = Cell;
+  Item.Order = Order;
+  for(i = (*NHeap)++; i > 0; i = parent) {
+    parent = (i - 1) / 2;
+    if(!HEAPLESS(Item, Heap[parent]))
+      break;
+    Heap[i] = Heap[parent];
   }
-  fclose(fo);
+  Heap[i] = Item;
+}
 
-  if((fo=fopen(OutFile,"wb")) == NULL) {
-    fprintf(stderr, "Could not open %s\n", OutFile);
-    exit(0);
-  } 
+HEAPITEM HeapPop(HEAPITEM *Heap, int *NHeap)
+{
+  HEAPITEM Top, Last;
+  int i, child;
+
+  Top = Heap[0];
+  Last = Heap[--(*NHeap)];
+  for(i = 0; (child = 2 * i + 1) < *NHeap; i = child) {
+    if(child + 1 < *NHeap && HEAPLESS(Heap[child + 1], Heap[child]))
+      child++;
+    if(!HEAPLESS(Heap[child], Last))
+      break;
+    Heap[i] = Heap[child];
+  }
+  if(*NHeap > 0)
+    Heap[i] = Last;
+  return Top;
+}
 
-   for (y = 0; y < nrows; y++){
-     for (x = 0; x < ncols; x++) {
-       Matrix[y * ncols + x] = Dem[y][x];
-     }
-   }
+/* -------------------------------------------------------------
+   WriteGrid()
+   ------------------------------------------------------------- */
+void WriteGrid(char *FileName, float *Matrix, int ncols, int nrows)
+{
+  FILE *fo;
+  int NElements;
 
-  NElements = 0;
+  if((fo=fopen(FileName,"wb")) == NULL) {
+    fprintf(stderr, "Could not open %s\n", FileName);
+    exit(0);
+  }
   NElements = fwrite(Matrix,sizeof(float), nrows*ncols,fo);
- 
   if(NElements != nrows*ncols) {
-    fprintf(stderr, "Problem writing in %s\n",OutFile);
+    fprintf(stderr, "Problem writing in %s\n",FileName);
     fprintf(stderr, "NElements = %d\n", NElements);
     exit(0);
   }
   fclose(fo);
-  free(Matrix);
-
-  for(i=0; i<nrows; i++){
-    free(NumxL[i]);
-    free(NumxR[i]);
-    free(NumyN[i]);
-    free(NumyS[i]);
-  }
-  free(NumxL);
-  free(NumxR);
-  free(NumyN);
-  free(NumyS);
-
-} /* End of Main. */
+}
 
 void find_flowdir(int xmin, int ymin, int xmax, int ymax, int ncols, int nrows, float **Dem, int **Dir, float NODATA, int SetOutlets)
 {
@@ -702,10 +928,12 @@ void assign_pour_point(int **NumxL, int **NumxR, int **NumyN, int **NumyS,
 
 void AllocateArrays(int ***NumxL, int ***NumxR, int ***NumyS, int ***NumyN,
 		    int ***Dir, float ***Dem, int ***FlowAcc, unsigned char ***Mask,
-		    int ncols, int nrows)
+		    int ncols, int nrows, int Radial)
 {
   int i;
 
+  /* The search arrays are only needed by RadialSearch(). */
+  if (Radial) {
 
   if (!((*NumxL) = (int **) calloc(nrows, sizeof(int *))))
     {
@@ -758,6 +986,7 @@ void AllocateArrays(int ***NumxL, int ***NumxR, int ***NumyS, int ***NumyN,
       exit(0);
       }
     }
+  }
 
     if (!((*Dem) = (float **) calloc(nrows, sizeof(float *))))
     {
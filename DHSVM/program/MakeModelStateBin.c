@@ -1,6 +1,6 @@
 /*
  * SUMMARY:      MakeModelStateBin.c - Create initial model state for DHSVM
- * USAGE:        MakeModelStateBin <infofile>
+ * USAGE:        MakeModelStateBin <infofile> [<ensemblefile>]
  *
  * AUTHOR:       Bart Nijssen
  * ORG:          University of Washington, Department of Civil Engineering
@@ -9,8 +9,13 @@
  * LAST-MOD:     Mon Jul 28 20:59:20 1997 by Laura Bowling <lxb@u.washington.edu>
  * DESCRIPTION:  Create initial model state for DHSVM (binary I/O format)
  * DESCRIP-END.
- * FUNCTIONS:    ()
- * COMMENTS:
+ * FUNCTIONS:    main()
+ *               StoreModelState()
+ * COMMENTS:     With an ensemble file (see ModelStateEnsemble.c) the state
+ *               of each member is perturbed and stored in member.NNN/ under
+ *               the path of the info file, as state maps or as a model
+ *               state checkpoint.  The members are made in parallel with
+ *               OpenMP.
  */
 
 static const char vcid[] = "$Id: MakeModelStateBin.c,v 3.1";
@@ -27,17 +32,10 @@ static const char vcid[] = "$Id: MakeModelStateBin.c,v 3.1";
 #include "fifobin.h"
 #include "Calendar.h"
 #include "DHSVMerror.h"
+#include "modelstateensemble.h"
 
-#define MAXLAYERS 10
-#define MONTHSPYR 12
-
-void StoreModelState(char *Path, DATE Current, int NY, int NX, 
-                     int NVegLayers, float *RainInt, float *SnowInt,
-                     float TempIntStorage, unsigned char SnowMask, 
-                     unsigned short LastSnow, float Swq, float LwBottom, 
-                     float TBottom, float LwTop, float TTop, float Cold, 
-                     int NSoilLayers, float *Moist, float SoilTSurf,
-                     float *Temp, float GroundHeat, float Runoff);
+void StoreModelState(char *Path, STATEINFO *Info, int NPlanes,
+		     STATEPLANE *Planes, float *State);
 
 /*****************************************************************************
   MakeModelStateBin()
@@ -70,33 +68,18 @@ int main(int argc, char *argv[])
 {
   char InfoFileName[MAXSTRING+1];
   char Path[MAXSTRING+1];
-  DATE Day;
-  int NY;
-  int NX;
-  int NVegLayers;
-  int i;
-  float RainInt[MAXLAYERS];
-  float SnowInt[MAXLAYERS];
-  float TempIntStorage;
-  unsigned char SnowMask;
-  unsigned short LastSnow;
-  float Swq;
-  float LwBottom;
-  float TBottom;
-  float LwTop;
-  float TTop;
-  float Cold;
-  int NSoilLayers;
-  float Moist[MAXLAYERS];
-  float SoilTSurf;
-  float Temp[MAXLAYERS];
-  float GroundHeat;
-  float Runoff;
-  int Junk;
+  STATEINFO Info;
+  ENSEMBLE Ens;
+  STATEBASIN Basin;
+  STATEPLANE *Planes;
+  int NPlanes;
+  int NCells;
+  int Member;
+  float *State;
   FILE *InfoFile;
 
-  if (argc != 2) {
-    fprintf(stderr, "Usage: MakeModelState <infofile>\n");
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "Usage: MakeModelState <infofile> [<ensemblefile>]\n");
     fprintf(stderr, "The info file MUST contain the following information:\n");
     fprintf(stderr, " - path for output file\n");
     fprintf(stderr, " - date for the model state, in mm/dd/yyyy-hh\n");
@@ -119,6 +102,9 @@ int main(int argc, char *argv[])
     fprintf(stderr, " - soil temperature in C for each root zone layer\n");
     fprintf(stderr, " - ground heat storage\n");
     fprintf(stderr, " - runoff\n");
+    fprintf(stderr, "The ensemble file holds the number of members, the\n");
+    fprintf(stderr, "perturbations and the output (state maps or checkpoint),\n");
+    fprintf(stderr, "see ModelStateEnsemble.c\n");
     exit(1);
   }
   strcpy(InfoFileName, argv[1]);
@@ -127,43 +113,44 @@ int main(int argc, char *argv[])
     fprintf(stderr, "Canot open info file %s\n", InfoFileName);
     exit(1);
   }
-
-  fscanf(InfoFile, "%s", Path);
-  ScanDate(InfoFile, &Day);
-  fscanf(InfoFile, "%d %d", &NY, &NX);
-  fscanf(InfoFile, "%d", &NVegLayers);
-  for (i = 0; i < NVegLayers; i++) 
-    fscanf(InfoFile, "%f", &RainInt[i]);
-  fscanf(InfoFile, "%f", &SnowInt[0]);
-  for (i = 1; i < NVegLayers; i++) 
-    SnowInt[i] = 0;
-  TempIntStorage = 0.0;
-  fscanf(InfoFile, "%d", &Junk);
-  SnowMask = (unsigned char) Junk;
-  fscanf(InfoFile, "%d", &Junk);
-  LastSnow = (unsigned short) Junk;
-  fscanf(InfoFile, "%f", &Swq);
-  fscanf(InfoFile, "%f", &LwBottom);
-  fscanf(InfoFile, "%f", &TBottom);
-  fscanf(InfoFile, "%f", &LwTop);
-  fscanf(InfoFile, "%f", &TTop);
-  fscanf(InfoFile, "%f", &Cold);
-  fscanf(InfoFile, "%d", &NSoilLayers);
-  for (i = 0; i <= NSoilLayers; i++)
-    fscanf(InfoFile, "%f", &Moist[i]);
-  fscanf(InfoFile, "%f", &SoilTSurf);
-  for (i = 0; i < NSoilLayers; i++)
-    fscanf(InfoFile, "%f", &Temp[i]);
-  fscanf(InfoFile, "%f", &GroundHeat);
-  fscanf(InfoFile, "%f", &Runoff);
+  ReadStateInfo(InfoFile, &Info);
+  fclose(InfoFile);
 
   //  InitErrorMessage();
 
-  StoreModelState(Path, Day, NY, NX, NVegLayers, RainInt, SnowInt,
-                  TempIntStorage, SnowMask,
-                  LastSnow, Swq, LwBottom, TBottom, LwTop, TTop, Cold,
-                  NSoilLayers, Moist, SoilTSurf, Temp, GroundHeat, Runoff);
+  NPlanes = MakeStatePlanes(&Info, &Planes);
+  DefaultEnsemble(&Ens);
+  if (argc == 3)
+    ReadEnsemble(argv[2], NPlanes, Planes, &Ens);
+  if (Ens.Format == ENSEMBLE_CHECKPOINT) {
+    ReadStateBasin(&Info, &Ens, &Basin);
+    NCells = Basin.NActive;
+  }
+  else
+    NCells = Info.NY * Info.NX;
+
+  /* all the state variables of a member are filled in one buffer and
+     written with one call per file, the members in parallel */
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) private(Path, State)
+#endif
+  for (Member = 0; Member < Ens.NMembers; Member++) {
+    if (!(State = (float *) malloc((size_t) NPlanes * NCells * sizeof(float)))) {
+      perror("MakeModelStateBin");
+      exit(1);
+    }
+    MemberPath(Info.Path, &Ens, Member, Path);
+    FillMemberState(&Ens, NPlanes, Planes, Member, NCells,
+		    (Ens.Format == ENSEMBLE_CHECKPOINT) ? Basin.Cells : NULL,
+		    State);
+    if (Ens.Format == ENSEMBLE_CHECKPOINT)
+      StoreMemberCheckpoint(Path, &Info, &Ens, &Basin, NPlanes, State);
+    else
+      StoreModelState(Path, &Info, NPlanes, Planes, State);
+    free(State);
+  }
 
+  free(Planes);
   return 0;
 }
 
@@ -193,230 +180,39 @@ int main(int argc, char *argv[])
       - ground heat storage
 *****************************************************************************/
 
-void StoreModelState(char *Path, DATE Current, int NY, int NX, 
-                     int NVegLayers, float *RainInt, float *SnowInt,
-                     float TempIntStorage, unsigned char SnowMask, 
-                     unsigned short LastSnow, float Swq, float LwBottom, 
-                     float TBottom, float LwTop, float TTop, float Cold, 
-                     int NSoilLayers, float *Moist, float SoilTSurf,
-                     float *Temp, float GroundHeat, float Runoff)
+void StoreModelState(char *Path, STATEINFO *Info, int NPlanes,
+		     STATEPLANE *Planes, float *State)
 {
-  const char *Routine = "StoreModelState";
+  static char *Prefix[NSTATEFILES] = {
+    "Interception.State.", "Snow.State.", "Soil.State."
+  };
+  static char *Label[NSTATEFILES] = {
+    "Interception storage for each vegetation layer",
+    "Snow pack moisture and temperature state",
+    "Soil moisture and temperature state"
+  };
   char Str[NAMESIZE+1];
-  char DataLabel[MAXSTRING+1];
-  char FileLabel[MAXSTRING+1];
   char FileName[NAMESIZE+1];
-  char Units[MAXSTRING+1];
-  int i;			/* counter */
-  int x;			/* counter */
-  int y;			/* counter */
-  int NumberType;		/* number type */
-  void *Array;
+  int File;
+  int First;			/* first map of the file */
+  int p;
 
   /* print a message to stdout that state is being stored */
 
-  printf("Storing model state\n");
- 
-  /* Store the canopy interception */
-
-  sprintf(Str, "%02d.%02d.%04d.%02d.00.00", Current.Month, Current.Day, 
-	  Current.Year, Current.Hour);
-  MakeFileNameBin(Path, "Interception.State.", Str, FileName); 
-  strcpy(FileLabel, "Interception storage for each vegetation layer");
-  CreateFileBin(FileName, FileLabel);
-
-  if (!(Array = (float *) calloc(NY * NX, sizeof(float)))) {
-    perror(Routine);
-    exit(1);
-  }
-
-  for (i = 0; i < NVegLayers; i++) {
-    for (y = 0; y < NY; y++) 
-      for (x = 0; x < NX; x++) 
-        ((float *)Array)[y*NX + x] = RainInt[i];
-    NumberType = NT_FLOAT32;
-    sprintf(DataLabel, "Rain interception for vegetation Layer %d", i+1);
-    strcpy(Units, "mm");
-    Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                  FileName);
-  }
-  
-  for (i = 0; i < NVegLayers; i++) {
-    for (y = 0; y < NY; y++) 
-      for (x = 0; x < NX; x++) 
-        ((float *)Array)[y*NX + x] = SnowInt[i];
-    NumberType = NT_FLOAT32;
-    sprintf(DataLabel, "Snow interception for vegetation Layer %d", i+1);
-    strcpy(Units, "mm");
-    Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                  FileName);
-  }
-
-  for (y = 0; y < NY; y++) 
-    for (x = 0; x < NX; x++) 
-      ((float *)Array)[y*NX + x] = TempIntStorage;
-  NumberType = NT_FLOAT32;
-  sprintf(DataLabel, "Temporary snow interception for vegetation Layer %d", i+1);
-  strcpy(Units, "mm");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                   FileName);
-  
-  free(Array);
-
-  /* Store the snow pack conditions */
-  
-  MakeFileNameBin(Path, "Snow.State.", Str, FileName); 
-  strcpy(FileLabel, "Snow pack moisture and temperature state");
-  CreateFileBin(FileName, FileLabel);
-  
-  NumberType = NT_FLOAT32;
-  if (!(Array = (float *) calloc(NY * NX, sizeof(SizeOfNumberType(NumberType))))) {
-    perror(Routine);
-    exit(1);
-  }
-  
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = (float)SnowMask;
-  
-  strcpy(DataLabel, "Snow Cover Mask");
-  strcpy(Units, "");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = (float)LastSnow;
-
-  strcpy(DataLabel, "Number of Days Since Last Snowfall");
-  strcpy(Units, "Days");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = Swq;
-
-  strcpy(DataLabel, "Snow Water Equivalent");
-  strcpy(Units, "mm");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = LwBottom;
-
-  strcpy(DataLabel, "Liquid Water Content of Bottom Layer");
-  strcpy(Units, "mm");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-    
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = TBottom;
-
-  strcpy(DataLabel, "Temperature of Bottom Layer");
-  strcpy(Units, "C");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = LwTop;
-
-  strcpy(DataLabel, "Liquid Water Content of Surface Layer");
-  strcpy(Units, "mm");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = TTop;
-
-  strcpy(DataLabel, "Temperature of Surface Layer");
-  strcpy(Units, "mm");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = Cold;;
-
-  strcpy(DataLabel, "Cold Content of Snow Pack");
-  strcpy(Units, "");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  free(Array);
-
-  /* Store the soil conditions */ 
-  
-  MakeFileNameBin(Path, "Soil.State.", Str, FileName);
-  strcpy(FileLabel, "Soil moisture and temperature state");
-  CreateFileBin(FileName, FileLabel);
-  
-  if (!(Array = (float *) calloc(NY * NX, sizeof(float)))) {
-    perror(Routine);
-    exit(1);
+  printf("Storing model state in %s\n", Path);
+
+  sprintf(Str, "%02d.%02d.%04d.%02d.00.00", Info->Day.Month, Info->Day.Day, 
+	  Info->Day.Year, Info->Day.Hour);
+
+  /* the maps of a state file follow each other in State, so that they are
+     written as one NMaps * NY by NX matrix */
+  for (File = 0, p = 0; File < NSTATEFILES; File++) {
+    for (First = p; p < NPlanes && Planes[p].File == File; p++)
+      ;
+    MakeFileNameBin(Path, Prefix[File], Str, FileName); 
+    CreateFileBin(FileName, Label[File]);
+    Write2DMatrixBin((p - First) * Info->NY, Info->NX, NT_FLOAT32,
+		     Label[File], "", State + (size_t) First * Info->NY * Info->NX,
+		     FileName);
   }
-  
-  for (i = 0; i < NSoilLayers+1; i++) {
-
-    for (y = 0; y < NY; y++) 
-      for (x = 0; x < NX; x++) 
-        ((float *)Array)[y*NX + x] = Moist[i];
-    
-    NumberType = NT_FLOAT32;
-    sprintf(DataLabel, "Soil Moisture Content of Layer %d", i);
-    strcpy(Units, "");
-    Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                  FileName);
-  }
-  
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = SoilTSurf;
-  
-  NumberType = NT_FLOAT32;
-  strcpy(DataLabel, "Temperature of Soil Surface");
-  strcpy(Units, "C");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  for (i = 0; i < NSoilLayers; i++) {
-
-    for (y = 0; y < NY; y++) 
-      for (x = 0; x < NX; x++) 
-        ((float *)Array)[y*NX + x] = Temp[i];
-    
-    NumberType = NT_FLOAT32;
-    sprintf(DataLabel, "Soil Temperature of Layer %d", i);
-    strcpy(Units, "");
-    Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                  FileName);
-  }
-  
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = GroundHeat;
-  
-  NumberType = NT_FLOAT32;
-  strcpy(DataLabel, "Ground Heat Storage");
-  strcpy(Units, "");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = Runoff;
-  
-  NumberType = NT_FLOAT32;
-  strcpy(DataLabel, "Runoff");
-  strcpy(Units, "");
-  Write2DMatrixBin(NY, NX, NumberType, DataLabel, Units, Array, 
-                FileName);
-
-  free(Array);
 }
-
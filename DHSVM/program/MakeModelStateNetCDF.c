@@ -1,6 +1,7 @@
 /*
  * SUMMARY:      MakeModelStateNetCDF.c - Create initial model state for DHSVM
- * USAGE:        MakeModelStateBin <infofile>
+ * USAGE:        MakeModelStateNetCDF <infofile> <cellsize> <Xorig> <Yorig>
+ *                                    [<ensemblefile>]
  *
  * AUTHOR:       Bart Nijssen
  * ORG:          University of Washington, Department of Civil Engineering
@@ -10,8 +11,16 @@
  * $Id:          MakeModelStateNetCDF.c, v 3.1.1  2013/2/6  Ning Exp $
  * DESCRIPTION:  Create initial model state for DHSVM (netcdf I/O format)
  * DESCRIP-END.
- * FUNCTIONS:    ()
- * COMMENTS:
+ * FUNCTIONS:    main()
+ *               StoreModelState()
+ *               GetFloat()
+ *               CopyDouble()
+ * COMMENTS:     With an ensemble file (see ModelStateEnsemble.c) the state
+ *               of each member is perturbed and stored in member.NNN/ under
+ *               the path of the info file.  The members are filled in
+ *               parallel with OpenMP and written one at a time, the netcdf
+ *               library is not thread safe.  The checkpoint format is made
+ *               by MakeModelStateBin.
  */
 
 static const char vcid[] = "$Id: MakeModelStateNetCDF.c,v 3.1";
@@ -30,17 +39,10 @@ static const char vcid[] = "$Id: MakeModelStateNetCDF.c,v 3.1";
 #include "DHSVMerror.h"
 #include "data.h"
 #include "init.h"
-#define MAXLAYERS 10
-#define MONTHSPYR 12
-
-void StoreModelState(char *Path, DATE Current, int NY, int NX, 
-                     int NVegLayers, float *RainInt, float *SnowInt,
-                     float TempIntStorage, unsigned char SnowMask, 
-                     unsigned short LastSnow, float Swq, float LwBottom, 
-                     float TBottom, float LwTop, float TTop, float Cold, 
-                     int NSoilLayers, float *Moist, float SoilTSurf,
-                     float *Temp, float GroundHeat, float Runoff,
-					 MAPSIZE Map, MAPDUMP DMap);
+#include "modelstateensemble.h"
+
+void StoreModelState(char *Path, STATEINFO *Info, int NPlanes,
+		     STATEPLANE *Planes, float *State, MAPSIZE *Map);
 float GetFloat(char *numberStr);
 
 int CopyDouble(double *Value, char *Str, const int NValues);
@@ -76,43 +78,21 @@ int main(int argc, char *argv[])
 {
   char InfoFileName[MAXSTRING+1];
   char Path[MAXSTRING+1];
-  DATE Day;
-  int NY;
-  int NX;
   float dx; /* cell size */
-  int NVegLayers;
-  int i;
-  float RainInt[MAXLAYERS];
-  float SnowInt[MAXLAYERS];
-  float TempIntStorage;
-  unsigned char SnowMask;
-  unsigned short LastSnow;
-  float Swq;
-  float LwBottom;
-  float TBottom;
-  float LwTop;
-  float TTop;
-  float Cold;
-  int NSoilLayers;
-  float Moist[MAXLAYERS];
-  float SoilTSurf;
-  float Temp[MAXLAYERS];
-  float GroundHeat;
-  float Runoff;
-  int Junk;
-  double Xorig;					
-  double Yorig;					
+  STATEINFO Info;
+  ENSEMBLE Ens;
+  STATEPLANE *Planes;
+  int NPlanes;
+  int Member;
+  float *State;
   FILE *InfoFile;
   MAPSIZE *Map;
-  MAPDUMP *DMap;
   
-  if (!(DMap = (MAPDUMP *) calloc(1, sizeof(MAPDUMP))))
-    exit(-1);
   if (!(Map = (MAPSIZE *) calloc(1, sizeof(MAPSIZE))))
     exit(-1);
 
-  if (argc != 5) {
-    fprintf(stderr, "Usage: MakeModelState <infofile> <cellsize> <Xorig> <Yorig>\n");
+  if (argc != 5 && argc != 6) {
+    fprintf(stderr, "Usage: MakeModelState <infofile> <cellsize> <Xorig> <Yorig> [<ensemblefile>]\n");
 	fprintf(stderr, "The cellsize (in the same units as the DEM elevation\n");
 	fprintf(stderr, "Xorig is the extreme west and Yorig is the extreme north");
     fprintf(stderr, "The info file MUST contain the following information:\n");
@@ -137,6 +117,8 @@ int main(int argc, char *argv[])
     fprintf(stderr, " - soil temperature in C for each root zone layer\n");
     fprintf(stderr, " - ground heat storage\n");
     fprintf(stderr, " - runoff\n");
+    fprintf(stderr, "The ensemble file holds the number of members and the\n");
+    fprintf(stderr, "perturbations, see ModelStateEnsemble.c\n");
     exit(1);
   }
   strcpy(InfoFileName, argv[1]); 
@@ -154,51 +136,51 @@ int main(int argc, char *argv[])
   if (!(CopyDouble(&(Map->Yorig), argv[4], 1)))
 	  exit (-1);;
 
-  fscanf(InfoFile, "%s", Path);
-  ScanDate(InfoFile, &Day);
-  fscanf(InfoFile, "%d %d", &NY, &NX);
-  fscanf(InfoFile, "%d", &NVegLayers);
-  for (i = 0; i < NVegLayers; i++) 
-    fscanf(InfoFile, "%f", &RainInt[i]);
-  fscanf(InfoFile, "%f", &SnowInt[0]);
-  for (i = 1; i < NVegLayers; i++) 
-    SnowInt[i] = 0;
-  TempIntStorage = 0.0;
-  fscanf(InfoFile, "%d", &Junk);
-  SnowMask = (unsigned char) Junk;
-  fscanf(InfoFile, "%d", &Junk);
-  LastSnow = (unsigned short) Junk;
-  fscanf(InfoFile, "%f", &Swq);
-  fscanf(InfoFile, "%f", &LwBottom);
-  fscanf(InfoFile, "%f", &TBottom);
-  fscanf(InfoFile, "%f", &LwTop);
-  fscanf(InfoFile, "%f", &TTop);
-  fscanf(InfoFile, "%f", &Cold);
-  fscanf(InfoFile, "%d", &NSoilLayers);
-  for (i = 0; i <= NSoilLayers; i++)
-    fscanf(InfoFile, "%f", &Moist[i]);
-  fscanf(InfoFile, "%f", &SoilTSurf);
-  for (i = 0; i < NSoilLayers; i++)
-    fscanf(InfoFile, "%f", &Temp[i]);
-  fscanf(InfoFile, "%f", &GroundHeat); 
-  fscanf(InfoFile, "%f", &Runoff);
+  ReadStateInfo(InfoFile, &Info);
+  fclose(InfoFile);
 
   Map->X = 0;
   Map->Y = 0;
   Map->OffsetX = 0;
   Map->OffsetY = 0;
-  Map->NX = NX;
-  Map->NY = NY;
+  Map->NX = Info.NX;
+  Map->NY = Info.NY;
   Map->DX = dx;
   Map->DY = dx;
   Map->DXY = (float) sqrt(Map->DX * Map->DX + Map->DY * Map->DY);
 
-  StoreModelState(Path, Day, NY, NX, NVegLayers, 
-                  RainInt, SnowInt,TempIntStorage, SnowMask,
-                  LastSnow, Swq, LwBottom, TBottom, LwTop, TTop, Cold,
-                  NSoilLayers, Moist, SoilTSurf, Temp, GroundHeat, Runoff,
-				  *Map, *DMap);
+  NPlanes = MakeStatePlanes(&Info, &Planes);
+  DefaultEnsemble(&Ens);
+  if (argc == 6)
+    ReadEnsemble(argv[5], NPlanes, Planes, &Ens);
+  if (Ens.Format != ENSEMBLE_MAPS) {
+    fprintf(stderr, "Use MakeModelStateBin for a model state checkpoint\n");
+    exit(1);
+  }
+
+  /* all the state variables of a member are filled in one buffer, the
+     members in parallel */
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) private(Path, State)
+#endif
+  for (Member = 0; Member < Ens.NMembers; Member++) {
+    if (!(State = (float *) malloc((size_t) NPlanes * Info.NY * Info.NX *
+				   sizeof(float)))) {
+      perror("MakeModelStateNetCDF");
+      exit(1);
+    }
+    MemberPath(Info.Path, &Ens, Member, Path);
+    FillMemberState(&Ens, NPlanes, Planes, Member, Info.NY * Info.NX, NULL,
+		    State);
+#ifdef HAVE_OPENMP
+#pragma omp critical
+#endif
+    StoreModelState(Path, &Info, NPlanes, Planes, State, Map);
+    free(State);
+  }
 
+  free(Planes);
+  free(Map);
   return EXIT_SUCCESS;
 }
 
@@ -227,346 +209,48 @@ int main(int argc, char *argv[])
       - surface temperature
       - ground heat storage
 *****************************************************************************/
-void StoreModelState(char *Path, DATE Current, int NY, int NX, 
-                     int NVegLayers, float *RainInt, float *SnowInt,
-                     float TempIntStorage, unsigned char SnowMask, 
-                     unsigned short LastSnow, float Swq, float LwBottom, 
-                     float TBottom, float LwTop, float TTop, float Cold, 
-                     int NSoilLayers, float *Moist, float SoilTSurf,
-                     float *Temp, float GroundHeat, float Runoff, 
-					 MAPSIZE Map, MAPDUMP DMap)
+void StoreModelState(char *Path, STATEINFO *Info, int NPlanes,
+		     STATEPLANE *Planes, float *State, MAPSIZE *Map)
 {
-  const char *Routine = "StoreModelState";
+  static char *Prefix[NSTATEFILES] = {
+    "Interception.State.", "Snow.State.", "Soil.State."
+  };
+  static char *Label[NSTATEFILES] = {
+    "Interception storage for each vegetation layer",
+    "Snow pack moisture and temperature state",
+    "Soil moisture and temperature state"
+  };
   char Str[NAMESIZE+1];
-  char FileLabel[MAXSTRING+1];
   char FileName[NAMESIZE+1];
-  char VarName[BUFSIZE + 1], LongName[BUFSIZE + 1];
-  char Units[MAXSTRING+1];
-  int i;			/* counter */
-  int x;			/* counter */
-  int y;			/* counter */
-  int NumberType;		/* number type */
-  void *Array;
+  int File;
+  int p;
+  MAPDUMP DMap;
 
   /* print a message to stdout that state is being stored */
-  printf("Storing model state\n");
+  printf("Storing model state in %s\n", Path);
  
-  /* Store the canopy interception */
-  sprintf(Str, "%02d.%02d.%04d.%02d.00.00", Current.Month, Current.Day, 
-	  Current.Year, Current.Hour);
-  MakeFileNameNetCDF(Path, "Interception.State.", Str, FileName); 
-  strcpy(FileLabel, "Interception storage for each vegetation layer");
-  CreateMapFileNetCDF(FileName, FileLabel, &Map);
-  if (!(Array = (float *) calloc(NY * NX, sizeof(float)))) {
-    perror(Routine);
-    exit(1);
-  }
-  for (i = 0; i < NVegLayers; i++) {
-    for (y = 0; y < NY; y++) {
-      for (x = 0; x < NX; x++) { 
-		  ((float *) Array)[y * NX + x] = RainInt[i];}
-	}
-	DMap.ID = 202;
-    DMap.Layer = i;
-    DMap.Resolution = MAP_OUTPUT;
-	strcpy(DMap.FileName, "");
-	strcpy(VarName, "Precip.IntRain");
-	sprintf(DMap.Name, "%d.%s", i, VarName);
-	strcpy(LongName, "Interception Storage (liquid)");
-	sprintf(DMap.LongName, "%s (Layer %d)", LongName, i);
-	strcpy(DMap.Format, "%.4g");
-	strcpy(DMap.Units, "m");
-	sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-	strncpy(DMap.FileName, Str, BUFSIZE);
-	strcpy(DMap.FileLabel, "Interception Storage (liquid)");
-	DMap.NumberType = NC_FLOAT;
-	Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-  }
-  
-  for (i = 0; i < NVegLayers; i++) {
-    for (y = 0; y < NY; y++) {
-      for (x = 0; x < NX; x++) {
-		  ((float *)Array)[y*NX + x] = SnowInt[i];}
-	}
-	DMap.ID = 203;
-    DMap.Layer = i;
+  memset(&DMap, 0, sizeof(MAPDUMP));
+  sprintf(Str, "%02d.%02d.%04d.%02d.00.00", Info->Day.Month, Info->Day.Day, 
+	  Info->Day.Year, Info->Day.Hour);
+  for (File = -1, p = 0; p < NPlanes; p++) {
+    if (Planes[p].File != File) {
+      File = Planes[p].File;
+      MakeFileNameNetCDF(Path, Prefix[File], Str, FileName); 
+      CreateMapFileNetCDF(FileName, Label[File], Map);
+    }
+    DMap.ID = Planes[p].ID;
+    DMap.Layer = (Planes[p].Layer < 0) ? 0 : Planes[p].Layer;
     DMap.Resolution = MAP_OUTPUT;
-	strcpy(DMap.FileName, "");
-	strcpy(VarName, "Precip.IntSnow");
-	sprintf(DMap.Name, "%d.%s", i, VarName);
-	strcpy(LongName, "Interception Storage (frozen)");
-	sprintf(DMap.LongName, "%s (Layer %d)", LongName, i);
-	strcpy(DMap.Format, "%.4g");
-	strcpy(DMap.Units, "m");
-	sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-	strncpy(DMap.FileName, Str, BUFSIZE);
-	strcpy(DMap.FileLabel, "Interception storage (frozen)");
-	DMap.NumberType = NC_FLOAT;
-	Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
+    strcpy(DMap.Name, Planes[p].Name);
+    strcpy(DMap.LongName, Planes[p].LongName);
+    strcpy(DMap.Format, Planes[p].Format);
+    strcpy(DMap.Units, Planes[p].Units);
+    sprintf(DMap.FileName, "Map.%s.nc", DMap.Name);
+    strcpy(DMap.FileLabel, Planes[p].FileLabel);
+    DMap.NumberType = NC_FLOAT;
+    Write2DMatrixNetCDF(FileName, State + (size_t) p * Info->NY * Info->NX,
+			DMap.NumberType, Info->NY, Info->NX, &DMap, 0);
   }
-
-  for (y = 0; y < NY; y++) 
-    for (x = 0; x < NX; x++) 
-      ((float *)Array)[y * NX + x] = TempIntStorage;
-  DMap.ID = 204;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Temp.Instor");
-  strcpy(DMap.LongName, "Temporary interception storage for top vegetation layer");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "m");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Temporary interception storage for top vegetation layer");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-  free(Array);
-
-  /* Store the snow pack conditions */ 
-  sprintf(Str, "%02d.%02d.%04d.%02d.00.00", Current.Month, Current.Day, 
-	  Current.Year, Current.Hour);
-  MakeFileNameNetCDF(Path, "Snow.State.", Str, FileName); 
-  strcpy(FileLabel, "Snow pack moisture and temperature state");
-  CreateMapFileNetCDF(FileName, FileLabel, &Map);
-
-  if (!(Array = (float *) calloc(NY * NX, sizeof(float)))) {
-    perror(Routine);
-    exit(1);
-  }
-  
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = (float)SnowMask;
-  DMap.ID = 401;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.HasSnow");
-  strcpy(DMap.LongName, "Snow Presence/Absence");
-  strcpy(DMap.Format, "%1d");
-  strcpy(DMap.Units, "");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Snow cover flag");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = (float)LastSnow;
-  DMap.ID = 403;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.LastSnow");
-  strcpy(DMap.LongName, "Last Snowfall");
-  strcpy(DMap.Format, "%4d");
-  strcpy(DMap.Units, "days");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Days since last snowfall");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = Swq;
-  DMap.ID = 404;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.Swq");
-  strcpy(DMap.LongName, "Snow Water Equivalent");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "m");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Snow water equivalent");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = LwBottom;
-  DMap.ID = 406;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.PackWater");
-  strcpy(DMap.LongName, "Liquid Water Content (Deep Layer)");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "m");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Liquid water content of snow pack");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-    
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = TBottom;
-  DMap.ID = 407;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.TPack");
-  strcpy(DMap.LongName, "Snow Temperature (Deep Layer)");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "C");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Temperature of snow pack");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = LwTop;
-  DMap.ID = 408;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.SurfWater");
-  strcpy(DMap.LongName, "Liquid Water Content (Surface Layer)");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "m");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Liquid water content of surface layer");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = TTop;
-  DMap.ID = 409;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.TSurf");
-  strcpy(DMap.LongName, "Snow Temperature (Surface Layer)");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "C");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Temperature of snow pack surface layer");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = Cold;;
-  DMap.ID = 410;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Snow.ColdContent");
-  strcpy(DMap.LongName, "Snow Cold Content");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "J");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Cold content of snow pack");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  free(Array);
-
-  /* Store the soil conditions */   
-  sprintf(Str, "%02d.%02d.%04d.%02d.00.00", Current.Month, Current.Day, 
-	  Current.Year, Current.Hour);
-  MakeFileNameNetCDF(Path, "Soil.State.", Str, FileName); 
-  strcpy(FileLabel, "Soil moisture and temperature state");
-  CreateMapFileNetCDF(FileName, FileLabel, &Map);
-
-  if (!(Array = (float *) calloc(NY * NX, sizeof(float)))) {
-    perror(Routine);
-    exit(1);
-  }
-  
-  for (i = 0; i < NSoilLayers+1; i++) {
-    for (y = 0; y < NY; y++) 
-      for (x = 0; x < NX; x++) 
-        ((float *)Array)[y*NX + x] = Moist[i];
-	DMap.ID = 501;
-    DMap.Layer = i;
-    DMap.Resolution = MAP_OUTPUT;
-	strcpy(DMap.FileName, "");
-	strcpy(VarName, "Soil.Moist");
-	sprintf(DMap.Name, "%d.%s", i, VarName);
-	strcpy(LongName, "Soil Moisture Content");
-	sprintf(DMap.LongName, "%s (Layer %d)", LongName, i);
-	strcpy(DMap.Format, "%.4g");
-	strcpy(DMap.Units, "");
-	sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-	strncpy(DMap.FileName, Str, BUFSIZE);
-	strcpy(DMap.FileLabel, "Soil moisture");
-	DMap.NumberType = NC_FLOAT;
-	Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-  }
-  
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = SoilTSurf;
-  DMap.ID = 505;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Soil.TSurf");
-  strcpy(DMap.LongName, "Surface Temperature");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "C");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Soil surface temperature");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (i = 0; i < NSoilLayers; i++) {
-    for (y = 0; y < NY; y++) 
-      for (x = 0; x < NX; x++) 
-        ((float *)Array)[y*NX + x] = Temp[i];
-	DMap.ID = 511;
-    DMap.Layer = i;
-    DMap.Resolution = MAP_OUTPUT;
-	strcpy(DMap.FileName, "");
-	strcpy(VarName, "Soil.Temp");
-	sprintf(DMap.Name, "%d.%s", i, VarName);
-	strcpy(LongName, "Soil Temperature");
-	sprintf(DMap.LongName, "%s (Layer %d)", LongName, i);
-	strcpy(DMap.Format, "%.4g");
-	strcpy(DMap.Units, "C");
-	sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-	strncpy(DMap.FileName, Str, BUFSIZE);
-	strcpy(DMap.FileLabel, "Soil Temperature");
-	DMap.NumberType = NC_FLOAT;
-	Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-  }
-  
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = GroundHeat;
-  DMap.ID = 510;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Soil.Qst");
-  strcpy(DMap.LongName, "Ground Heat Storage");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "W/m2");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Ground heat storage");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      ((float *)Array)[y*NX + x] = Runoff;
-  DMap.ID = 512;
-  DMap.Resolution = MAP_OUTPUT;
-  strcpy(DMap.FileName, "");
-  strcpy(DMap.Name, "Soil.Runoff");
-  strcpy(DMap.LongName, "Surface Ponding");
-  strcpy(DMap.Format, "%.4g");
-  strcpy(DMap.Units, "m");
-  sprintf(Str, "%sMap.%s.nc", DMap.FileName, DMap.Name);
-  strncpy(DMap.FileName, Str, BUFSIZE);
-  strcpy(DMap.FileLabel, "Surface Ponding");
-  DMap.NumberType = NC_FLOAT;
-  Write2DMatrixNetCDF(FileName, Array, DMap.NumberType, NY, NX, &DMap, 0);
-
-  free(Array);
 }
 
 /*****************************************************************************
@@ -0,0 +1,690 @@
+/*
+ * SUMMARY:      ModelStateEnsemble.c - Initial model states for an ensemble
+ * USAGE:        Part of MakeModelStateBin and MakeModelStateNetCDF
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Reads the uniform model state of the info file and the
+ *               ensemble file, and fills all the state variables of a
+ *               member, perturbed, in one buffer that is written as the
+ *               state files or as a model state checkpoint.
+ * DESCRIP-END.
+ * FUNCTIONS:    ReadStateInfo()
+ *               DefaultEnsemble()
+ *               ReadEnsemble()
+ *               MakeStatePlanes()
+ *               ReadStateBasin()
+ *               MemberPath()
+ *               FillMemberState()
+ *               StoreMemberCheckpoint()
+ *               SetPlane()
+ *               Mix()
+ *               Gauss()
+ *               CheckpointSum()
+ * COMMENTS:     The ensemble file has one keyword and its values per line,
+ *               with # starting a comment:
+ *
+ *                 members <n>        number of members (1)
+ *                 seed <n>           seed of the perturbations (1)
+ *                 format <maps|checkpoint>
+ *                 outside <n>        mask value outside the basin (0)
+ *                 mask <file>        binary basin mask (checkpoint)
+ *                 network <file>     stream network file (checkpoint)
+ *                 hydrograph <n>     unit hydrograph length, without a
+ *                                    network (checkpoint)
+ *                 storage <m3>       storage of each channel segment (0)
+ *                 perturb <var> <sd> <relative|absolute> <member|cell>
+ *                         [<min> <max>]
+ *
+ *               <var> is the variable name of the state maps, e.g.
+ *               Soil.Moist for all soil layers or 0.Soil.Moist for the top
+ *               one.  The value of the info file becomes value * (1 + sd *
+ *               z) (relative) or value + sd * z (absolute), with z a
+ *               standard normal deviate drawn once for the member or for
+ *               every cell and layer, and is kept within [min, max], or
+ *               above 0 for the water stores without bounds.
+ *
+ *               z follows from the seed, the member, the perturbation, the
+ *               layer and the cell alone, so the members are the same
+ *               whatever the number of threads and the order they are
+ *               made in, and a cell gets the same value in the state maps
+ *               and in the checkpoint.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "constants.h"
+#include "modelstateensemble.h"
+
+static void SetPlane(STATEPLANE *Plane, int File, int ID, int Layer,
+		     char *Var, char *LongName, char *Format, char *Units,
+		     char *FileLabel, int NonNegative, float Value);
+static unsigned long long Mix(unsigned long long Key);
+static double Gauss(unsigned int Seed, int Member, int Perturb, int Layer,
+		    int Cell);
+static unsigned int CheckpointSum(unsigned int Sum, const unsigned int *Words,
+				  size_t NWords);
+
+/*****************************************************************************
+  ReadStateInfo()
+
+  Read the uniform model state from the info file
+*****************************************************************************/
+void ReadStateInfo(FILE *InfoFile, STATEINFO *Info)
+{
+  int i;
+  int Junk;
+
+  fscanf(InfoFile, "%s", Info->Path);
+  ScanDate(InfoFile, &(Info->Day));
+  fscanf(InfoFile, "%d %d", &(Info->NY), &(Info->NX));
+  fscanf(InfoFile, "%d", &(Info->NVegLayers));
+  if (Info->NVegLayers < 1 || Info->NVegLayers > MAXLAYERS) {
+    fprintf(stderr, "Number of vegetation layers must be 1 - %d\n", MAXLAYERS);
+    exit(1);
+  }
+  for (i = 0; i < Info->NVegLayers; i++)
+    fscanf(InfoFile, "%f", &(Info->RainInt[i]));
+  fscanf(InfoFile, "%f", &(Info->SnowInt[0]));
+  for (i = 1; i < Info->NVegLayers; i++)
+    Info->SnowInt[i] = 0;
+  Info->TempIntStorage = 0.0;
+  fscanf(InfoFile, "%d", &Junk);
+  Info->SnowMask = (unsigned char) Junk;
+  fscanf(InfoFile, "%d", &Junk);
+  Info->LastSnow = (unsigned short) Junk;
+  fscanf(InfoFile, "%f", &(Info->Swq));
+  fscanf(InfoFile, "%f", &(Info->LwBottom));
+  fscanf(InfoFile, "%f", &(Info->TBottom));
+  fscanf(InfoFile, "%f", &(Info->LwTop));
+  fscanf(InfoFile, "%f", &(Info->TTop));
+  fscanf(InfoFile, "%f", &(Info->Cold));
+  fscanf(InfoFile, "%d", &(Info->NSoilLayers));
+  if (Info->NSoilLayers < 1 || Info->NSoilLayers >= MAXLAYERS) {
+    fprintf(stderr, "Number of soil layers must be 1 - %d\n", MAXLAYERS - 1);
+    exit(1);
+  }
+  for (i = 0; i <= Info->NSoilLayers; i++)
+    fscanf(InfoFile, "%f", &(Info->Moist[i]));
+  fscanf(InfoFile, "%f", &(Info->SoilTSurf));
+  for (i = 0; i < Info->NSoilLayers; i++)
+    fscanf(InfoFile, "%f", &(Info->Temp[i]));
+  fscanf(InfoFile, "%f", &(Info->GroundHeat));
+  fscanf(InfoFile, "%f", &(Info->Runoff));
+}
+
+/*****************************************************************************
+  DefaultEnsemble()
+
+  A single member with the state of the info file, as state maps
+*****************************************************************************/
+void DefaultEnsemble(ENSEMBLE *Ens)
+{
+  memset(Ens, 0, sizeof(ENSEMBLE));
+  Ens->NMembers = 1;
+  Ens->Seed = 1;
+  Ens->Format = ENSEMBLE_MAPS;
+  Ens->OutsideBasin = 0;
+  Ens->NHydro = 0;
+  Ens->Storage = 0.0;
+  Ens->NPerturb = 0;
+}
+
+/*****************************************************************************
+  ReadEnsemble()
+
+  Read the ensemble file, see the comments at the top
+*****************************************************************************/
+void ReadEnsemble(char *FileName, int NPlanes, STATEPLANE *Planes,
+		  ENSEMBLE *Ens)
+{
+  char Line[MAXSTRING + 1];
+  char Key[MAXSTRING + 1];
+  char Word[MAXSTRING + 1];
+  char Var[MAXSTRING + 1];
+  char Kind[MAXSTRING + 1];
+  char Scope[MAXSTRING + 1];
+  char *Dot;
+  PERTURBATION *Perturb;
+  FILE *InFile;
+  int NLine;
+  int NRead;
+  int Value;
+  int p;
+
+  if (!(InFile = fopen(FileName, "r"))) {
+    fprintf(stderr, "Cannot open ensemble file %s\n", FileName);
+    exit(1);
+  }
+
+  NLine = 0;
+  while (fgets(Line, MAXSTRING, InFile) != NULL) {
+    NLine++;
+    if ((Dot = strchr(Line, '#')) != NULL)
+      *Dot = '\0';
+    if (sscanf(Line, "%s", Key) != 1)
+      continue;
+
+    if (strcmp(Key, "members") == 0) {
+      if (sscanf(Line, "%*s %d", &(Ens->NMembers)) != 1 || Ens->NMembers < 1)
+	goto BadLine;
+    }
+    else if (strcmp(Key, "seed") == 0) {
+      if (sscanf(Line, "%*s %u", &(Ens->Seed)) != 1)
+	goto BadLine;
+    }
+    else if (strcmp(Key, "format") == 0) {
+      if (sscanf(Line, "%*s %s", Word) != 1)
+	goto BadLine;
+      if (strcmp(Word, "maps") == 0)
+	Ens->Format = ENSEMBLE_MAPS;
+      else if (strcmp(Word, "checkpoint") == 0)
+	Ens->Format = ENSEMBLE_CHECKPOINT;
+      else
+	goto BadLine;
+    }
+    else if (strcmp(Key, "outside") == 0) {
+      if (sscanf(Line, "%*s %d", &Value) != 1 || Value < 0 || Value > 255)
+	goto BadLine;
+      Ens->OutsideBasin = (unsigned char) Value;
+    }
+    else if (strcmp(Key, "mask") == 0) {
+      if (sscanf(Line, "%*s %s", Ens->MaskFile) != 1)
+	goto BadLine;
+    }
+    else if (strcmp(Key, "network") == 0) {
+      if (sscanf(Line, "%*s %s", Ens->NetworkFile) != 1)
+	goto BadLine;
+    }
+    else if (strcmp(Key, "hydrograph") == 0) {
+      if (sscanf(Line, "%*s %d", &(Ens->NHydro)) != 1 || Ens->NHydro < 0)
+	goto BadLine;
+    }
+    else if (strcmp(Key, "storage") == 0) {
+      if (sscanf(Line, "%*s %f", &(Ens->Storage)) != 1)
+	goto BadLine;
+    }
+    else if (strcmp(Key, "perturb") == 0) {
+      if (Ens->NPerturb == MAXPERTURB) {
+	fprintf(stderr, "%s: more than %d perturbations\n", FileName,
+		MAXPERTURB);
+	exit(1);
+      }
+      Perturb = &(Ens->Perturb[Ens->NPerturb]);
+      NRead = sscanf(Line, "%*s %s %f %s %s %f %f", Var, &(Perturb->Sd), Kind,
+		     Scope, &(Perturb->Min), &(Perturb->Max));
+      if ((NRead != 4 && NRead != 6) ||
+	  (strcmp(Kind, "relative") != 0 && strcmp(Kind, "absolute") != 0) ||
+	  (strcmp(Scope, "member") != 0 && strcmp(Scope, "cell") != 0) ||
+	  (NRead == 6 && Perturb->Min > Perturb->Max))
+	goto BadLine;
+      Perturb->Relative = (strcmp(Kind, "relative") == 0);
+      Perturb->PerCell = (strcmp(Scope, "cell") == 0);
+      Perturb->HasBounds = (NRead == 6);
+
+      /* <layer>.<variable> or <variable> for all layers */
+      Perturb->Layer = -1;
+      if (sscanf(Var, "%d", &Value) == 1 && (Dot = strchr(Var, '.')) != NULL) {
+	Perturb->Layer = Value;
+	Dot++;
+      }
+      else
+	Dot = Var;
+      strncpy(Perturb->Var, Dot, BUFSIZE);
+      for (p = 0; p < NPlanes; p++)
+	if (strcmp(Planes[p].Var, Perturb->Var) == 0 &&
+	    (Perturb->Layer < 0 || Planes[p].Layer == Perturb->Layer))
+	  break;
+      if (p == NPlanes) {
+	fprintf(stderr, "%s line %d: no state variable %s\n", FileName, NLine,
+		Var);
+	exit(1);
+      }
+      Ens->NPerturb++;
+    }
+    else
+      goto BadLine;
+  }
+  fclose(InFile);
+
+  if (Ens->Format == ENSEMBLE_CHECKPOINT && Ens->MaskFile[0] == '\0') {
+    fprintf(stderr, "%s: a checkpoint needs the basin mask\n", FileName);
+    exit(1);
+  }
+  return;
+
+BadLine:
+  fprintf(stderr, "%s line %d: cannot read %s", FileName, NLine, Line);
+  exit(1);
+}
+
+/*****************************************************************************
+  MakeStatePlanes()
+
+  The maps of the state files in the order DHSVM reads them, which is also
+  the order of the state variables in the checkpoint: the interception,
+  snow and soil state files follow each other.  Returns the number of maps.
+*****************************************************************************/
+int MakeStatePlanes(STATEINFO *Info, STATEPLANE **Planes)
+{
+  STATEPLANE *P;
+  int NPlanes;
+  int i;
+
+  NPlanes = 2 * Info->NVegLayers + 1 + 8 + (Info->NSoilLayers + 1) + 1 +
+    Info->NSoilLayers + 2;
+  if (!(*Planes = (STATEPLANE *) calloc(NPlanes, sizeof(STATEPLANE)))) {
+    perror("MakeStatePlanes");
+    exit(1);
+  }
+  P = *Planes;
+
+  for (i = 0; i < Info->NVegLayers; i++, P++)
+    SetPlane(P, INTERCEPTION_STATE, 202, i, "Precip.IntRain",
+	     "Interception Storage (liquid)", "%.4g", "m",
+	     "Interception Storage (liquid)", TRUE, Info->RainInt[i]);
+  for (i = 0; i < Info->NVegLayers; i++, P++)
+    SetPlane(P, INTERCEPTION_STATE, 203, i, "Precip.IntSnow",
+	     "Interception Storage (frozen)", "%.4g", "m",
+	     "Interception storage (frozen)", TRUE, Info->SnowInt[i]);
+  SetPlane(P++, INTERCEPTION_STATE, 204, -1, "Temp.Instor",
+	   "Temporary interception storage for top vegetation layer", "%.4g",
+	   "m", "Temporary interception storage for top vegetation layer",
+	   TRUE, Info->TempIntStorage);
+
+  SetPlane(P++, SNOW_STATE, 401, -1, "Snow.HasSnow", "Snow Presence/Absence",
+	   "%1d", "", "Snow cover flag", TRUE, (float) Info->SnowMask);
+  SetPlane(P++, SNOW_STATE, 403, -1, "Snow.LastSnow", "Last Snowfall", "%4d",
+	   "days", "Days since last snowfall", TRUE, (float) Info->LastSnow);
+  SetPlane(P++, SNOW_STATE, 404, -1, "Snow.Swq", "Snow Water Equivalent",
+	   "%.4g", "m", "Snow water equivalent", TRUE, Info->Swq);
+  SetPlane(P++, SNOW_STATE, 406, -1, "Snow.PackWater",
+	   "Liquid Water Content (Deep Layer)", "%.4g", "m",
+	   "Liquid water content of snow pack", TRUE, Info->LwBottom);
+  SetPlane(P++, SNOW_STATE, 407, -1, "Snow.TPack",
+	   "Snow Temperature (Deep Layer)", "%.4g", "C",
+	   "Temperature of snow pack", FALSE, Info->TBottom);
+  SetPlane(P++, SNOW_STATE, 408, -1, "Snow.SurfWater",
+	   "Liquid Water Content (Surface Layer)", "%.4g", "m",
+	   "Liquid water content of surface layer", TRUE, Info->LwTop);
+  SetPlane(P++, SNOW_STATE, 409, -1, "Snow.TSurf",
+	   "Snow Temperature (Surface Layer)", "%.4g", "C",
+	   "Temperature of snow pack surface layer", FALSE, Info->TTop);
+  SetPlane(P++, SNOW_STATE, 410, -1, "Snow.ColdContent", "Snow Cold Content",
+	   "%.4g", "J", "Cold content of snow pack", FALSE, Info->Cold);
+
+  for (i = 0; i < Info->NSoilLayers + 1; i++, P++)
+    SetPlane(P, SOIL_STATE, 501, i, "Soil.Moist", "Soil Moisture Content",
+	     "%.4g", "", "Soil moisture", TRUE, Info->Moist[i]);
+  SetPlane(P++, SOIL_STATE, 505, -1, "Soil.TSurf", "Surface Temperature",
+	   "%.4g", "C", "Soil surface temperature", FALSE, Info->SoilTSurf);
+  for (i = 0; i < Info->NSoilLayers; i++, P++)
+    SetPlane(P, SOIL_STATE, 511, i, "Soil.Temp", "Soil Temperature", "%.4g",
+	     "C", "Soil Temperature", FALSE, Info->Temp[i]);
+  SetPlane(P++, SOIL_STATE, 510, -1, "Soil.Qst", "Ground Heat Storage", "%.4g",
+	   "W/m2", "Ground heat storage", FALSE, Info->GroundHeat);
+  SetPlane(P++, SOIL_STATE, 512, -1, "Soil.Runoff", "Surface Ponding", "%.4g",
+	   "m", "Surface Ponding", TRUE, Info->Runoff);
+
+  return NPlanes;
+}
+
+/*****************************************************************************
+  ReadStateBasin()
+
+  The cells of the basin mask, row by row like the active cells of DHSVM,
+  and the segment ids of the stream network in routing order, which is
+  the order of the file sorted (stably) by stream order like
+  channel_compile_network() of DHSVM.  NetHash is the network hash of the
+  checkpoint header
+*****************************************************************************/
+void ReadStateBasin(STATEINFO *Info, ENSEMBLE *Ens, STATEBASIN *Basin)
+{
+  char Line[MAXSTRING + 1];
+  char *Hash;
+  unsigned char *Mask;
+  unsigned int Words[3];
+  unsigned int *Id;
+  int *Count;
+  int *Order;
+  int MaxChannel;
+  int MaxOrder;
+  int i;
+  FILE *InFile;
+
+  if (!(Mask = (unsigned char *) malloc((size_t) Info->NY * Info->NX)) ||
+      !(Basin->Cells = (int *) malloc((size_t) Info->NY * Info->NX *
+				      sizeof(int)))) {
+    perror("ReadStateBasin");
+    exit(1);
+  }
+  if (!(InFile = fopen(Ens->MaskFile, "rb"))) {
+    fprintf(stderr, "Cannot open mask file %s\n", Ens->MaskFile);
+    exit(1);
+  }
+  if (fread(Mask, 1, (size_t) Info->NY * Info->NX, InFile) !=
+      (size_t) Info->NY * Info->NX) {
+    fprintf(stderr, "Mask file %s is not %d by %d\n", Ens->MaskFile,
+	    Info->NY, Info->NX);
+    exit(1);
+  }
+  fclose(InFile);
+
+  Words[0] = (unsigned int) Info->NY;
+  Words[1] = (unsigned int) Info->NX;
+  for (i = 0, Basin->NActive = 0; i < Info->NY * Info->NX; i++)
+    if (Mask[i] != Ens->OutsideBasin)
+      Basin->Cells[Basin->NActive++] = i;
+  free(Mask);
+  if (Basin->NActive == 0) {
+    fprintf(stderr, "Mask file %s has no cells in the basin\n", Ens->MaskFile);
+    exit(1);
+  }
+  Words[2] = (unsigned int) Basin->NActive;
+  Basin->GeomHash = CheckpointSum(CHECKPOINT_SEED, Words, 3);
+  for (i = 0; i < Basin->NActive; i++) {
+    Words[0] = (unsigned int) (Basin->Cells[i] / Info->NX);
+    Words[1] = (unsigned int) (Basin->Cells[i] % Info->NX);
+    Basin->GeomHash = CheckpointSum(Basin->GeomHash, Words, 2);
+  }
+
+  Basin->NChannel = 0;
+  Basin->ChannelID = NULL;
+  Words[0] = 0;
+  Basin->NetHash = CheckpointSum(CHECKPOINT_SEED, Words, 1);
+  if (Ens->NetworkFile[0] == '\0')
+    return;
+
+  if (!(InFile = fopen(Ens->NetworkFile, "r"))) {
+    fprintf(stderr, "Cannot open stream network file %s\n", Ens->NetworkFile);
+    exit(1);
+  }
+  Id = NULL;
+  Order = NULL;
+  MaxChannel = 0;
+  MaxOrder = 0;
+  while (fgets(Line, MAXSTRING, InFile) != NULL) {
+    if ((Hash = strchr(Line, '#')) != NULL)
+      *Hash = '\0';
+    if (Basin->NChannel == MaxChannel) {
+      MaxChannel = (MaxChannel > 0) ? 2 * MaxChannel : 1024;
+      if (!(Id = (unsigned int *) realloc(Id, MaxChannel *
+					   sizeof(unsigned int))) ||
+	  !(Order = (int *) realloc(Order, MaxChannel * sizeof(int)))) {
+	perror("ReadStateBasin");
+	exit(1);
+      }
+    }
+    if (sscanf(Line, "%u %d", &Id[Basin->NChannel],
+	       &Order[Basin->NChannel]) != 2)
+      continue;
+    if (Order[Basin->NChannel] < 0) {
+      fprintf(stderr, "Stream network file %s has a negative order\n",
+	      Ens->NetworkFile);
+      exit(1);
+    }
+    if (Order[Basin->NChannel] > MaxOrder)
+      MaxOrder = Order[Basin->NChannel];
+    Basin->NChannel++;
+  }
+  fclose(InFile);
+
+  /* counting sort by order, as the network is compiled */
+  if (!(Count = (int *) calloc(MaxOrder + 2, sizeof(int))) ||
+      !(Basin->ChannelID = (unsigned int *) malloc((Basin->NChannel + 1) *
+						   sizeof(unsigned int)))) {
+    perror("ReadStateBasin");
+    exit(1);
+  }
+  for (i = 0; i < Basin->NChannel; i++)
+    Count[Order[i] + 1]++;
+  for (i = 1; i <= MaxOrder + 1; i++)
+    Count[i] += Count[i - 1];
+  for (i = 0; i < Basin->NChannel; i++)
+    Basin->ChannelID[Count[Order[i]]++] = Id[i];
+  free(Count);
+  free(Order);
+  free(Id);
+
+  Words[0] = (unsigned int) Basin->NChannel;
+  Basin->NetHash = CheckpointSum(CHECKPOINT_SEED, Words, 1);
+  for (i = 0; i < Basin->NChannel; i++)
+    Basin->NetHash = CheckpointSum(Basin->NetHash, &Basin->ChannelID[i], 1);
+}
+
+/*****************************************************************************
+  MemberPath()
+
+  Path of the state files of a member, a directory member.NNN under Path
+  if there is more than one member
+*****************************************************************************/
+void MemberPath(char *Path, ENSEMBLE *Ens, int Member, char *MemberDir)
+{
+  if (Ens->NMembers == 1) {
+    strcpy(MemberDir, Path);
+    return;
+  }
+  sprintf(MemberDir, "%smember.%03d/", Path, Member + 1);
+  if (mkdir(MemberDir, 0755) != 0 && errno != EEXIST) {
+    perror(MemberDir);
+    exit(1);
+  }
+}
+
+/*****************************************************************************
+  FillMemberState()
+
+  Fill the NPlanes maps of a member, NCells values each, in State.  The
+  cells are Cells[k] = y * NX + x, or all the cells in order if Cells is
+  NULL.
+*****************************************************************************/
+void FillMemberState(ENSEMBLE *Ens, int NPlanes, STATEPLANE *Planes,
+		     int Member, int NCells, int *Cells, float *State)
+{
+  PERTURBATION *Perturb;
+  float *Plane;
+  double Z;
+  float Value;
+  int Layer;
+  int j;
+  int k;
+  int p;
+
+  for (p = 0; p < NPlanes; p++) {
+    Plane = State + (size_t) p * NCells;
+    for (k = 0; k < NCells; k++)
+      Plane[k] = Planes[p].Value;
+
+    Layer = (Planes[p].Layer < 0) ? 0 : Planes[p].Layer;
+    for (j = 0; j < Ens->NPerturb; j++) {
+      Perturb = &(Ens->Perturb[j]);
+      if (strcmp(Perturb->Var, Planes[p].Var) != 0 ||
+	  (Perturb->Layer >= 0 && Perturb->Layer != Planes[p].Layer))
+	continue;
+      Z = Gauss(Ens->Seed, Member, j, -1, -1);
+      for (k = 0; k < NCells; k++) {
+	if (Perturb->PerCell)
+	  Z = Gauss(Ens->Seed, Member, j, Layer, Cells ? Cells[k] : k);
+	if (Perturb->Relative)
+	  Value = Plane[k] * (float) (1. + Perturb->Sd * Z);
+	else
+	  Value = Plane[k] + (float) (Perturb->Sd * Z);
+	if (Perturb->HasBounds) {
+	  if (Value < Perturb->Min)
+	    Value = Perturb->Min;
+	  if (Value > Perturb->Max)
+	    Value = Perturb->Max;
+	}
+	else if (Planes[p].NonNegative && Value < 0.)
+	  Value = 0.;
+	Plane[k] = Value;
+      }
+    }
+  }
+}
+
+/*****************************************************************************
+  StoreMemberCheckpoint()
+
+  Store the state of a member as a full model state checkpoint, laid out
+  as by StoreModelCheckpoint() of DHSVM: the state maps of the basin cells,
+  the channel storages in routing order, and the unit hydrograph (0) if
+  there is no network.  State holds the NPlanes maps of Basin->NActive
+  cells.
+*****************************************************************************/
+void StoreMemberCheckpoint(char *Path, STATEINFO *Info, ENSEMBLE *Ens,
+			   STATEBASIN *Basin, int NPlanes, float *State)
+{
+  char FileName[NAMESIZE + 1];
+  unsigned int Header[NCHKHEADER];
+  unsigned int *Tail;
+  size_t NState;
+  size_t NTail;
+  float Zero;
+  int NHydro;
+  int i;
+  FILE *OutFile;
+
+  NHydro = (Basin->NChannel > 0) ? 0 : Ens->NHydro;
+  NState = (size_t) NPlanes * Basin->NActive;
+  NTail = (size_t) Basin->NChannel + NHydro;
+  if (!(Tail = (unsigned int *) calloc(NTail + 1, sizeof(unsigned int)))) {
+    perror("StoreMemberCheckpoint");
+    exit(1);
+  }
+  for (i = 0; i < Basin->NChannel; i++)
+    memcpy(&Tail[i], &(Ens->Storage), sizeof(float));
+  Zero = 0.;
+  for (i = 0; i < NHydro; i++)
+    memcpy(&Tail[Basin->NChannel + i], &Zero, sizeof(float));
+
+  Header[chk_version] = CHECKPOINT_VERSION;
+  Header[chk_ny] = (unsigned int) Info->NY;
+  Header[chk_nx] = (unsigned int) Info->NX;
+  Header[chk_nactive] = (unsigned int) Basin->NActive;
+  Header[chk_veglayers] = (unsigned int) Info->NVegLayers;
+  Header[chk_soillayers] = (unsigned int) Info->NSoilLayers;
+  Header[chk_nchannel] = (unsigned int) Basin->NChannel;
+  Header[chk_nhydro] = (unsigned int) NHydro;
+  Header[chk_year] = (unsigned int) Info->Day.Year;
+  Header[chk_month] = (unsigned int) Info->Day.Month;
+  Header[chk_day] = (unsigned int) Info->Day.Day;
+  Header[chk_hour] = (unsigned int) Info->Day.Hour;
+  Header[chk_min] = 0;
+  Header[chk_sec] = 0;
+  for (i = chk_baseyear; i <= chk_basesec; i++)
+    Header[i] = Header[chk_year + i - chk_baseyear];
+  Header[chk_geomhash] = Basin->GeomHash;
+  Header[chk_nethash] = Basin->NetHash;
+  Header[chk_channelvars] = CHKCHANNEL_STORAGE;
+  Header[chk_datasum] =
+    CheckpointSum(CheckpointSum(CHECKPOINT_SEED, (unsigned int *) State,
+				NState), Tail, NTail);
+  Header[chk_basesum] = Header[chk_datasum];
+  Header[chk_headersum] = CheckpointSum(CHECKPOINT_SEED, Header,
+					chk_headersum);
+
+  sprintf(FileName, "%sModel.State.%02d.%02d.%04d.%02d.%02d.%02d.chk", Path,
+	  Info->Day.Month, Info->Day.Day, Info->Day.Year, Info->Day.Hour, 0, 0);
+  if (!(OutFile = fopen(FileName, "wb"))) {
+    fprintf(stderr, "Cannot open checkpoint %s\n", FileName);
+    exit(1);
+  }
+  if (fwrite(CHECKPOINT_MAGIC, 1, strlen(CHECKPOINT_MAGIC), OutFile) !=
+      strlen(CHECKPOINT_MAGIC) ||
+      fwrite(Header, sizeof(unsigned int), NCHKHEADER, OutFile) != NCHKHEADER ||
+      fwrite(State, sizeof(float), NState, OutFile) != NState ||
+      fwrite(Tail, sizeof(unsigned int), NTail, OutFile) != NTail ||
+      fclose(OutFile) != 0) {
+    fprintf(stderr, "Cannot write checkpoint %s\n", FileName);
+    exit(1);
+  }
+  free(Tail);
+}
+
+/*****************************************************************************
+  SetPlane()
+*****************************************************************************/
+static void SetPlane(STATEPLANE *Plane, int File, int ID, int Layer,
+		     char *Var, char *LongName, char *Format, char *Units,
+		     char *FileLabel, int NonNegative, float Value)
+{
+  Plane->File = File;
+  Plane->ID = ID;
+  Plane->Layer = Layer;
+  strcpy(Plane->Var, Var);
+  if (Layer >= 0) {
+    sprintf(Plane->Name, "%d.%s", Layer, Var);
+    sprintf(Plane->LongName, "%s (Layer %d)", LongName, Layer);
+  }
+  else {
+    strcpy(Plane->Name, Var);
+    strcpy(Plane->LongName, LongName);
+  }
+  strcpy(Plane->Format, Format);
+  strcpy(Plane->Units, Units);
+  strcpy(Plane->FileLabel, FileLabel);
+  Plane->NonNegative = NonNegative;
+  Plane->Value = Value;
+}
+
+/*****************************************************************************
+  Mix()
+
+  The splitmix64 finalizer, which turns a key into 64 well mixed bits
+*****************************************************************************/
+static unsigned long long Mix(unsigned long long Key)
+{
+  Key += 0x9e3779b97f4a7c15ULL;
+  Key = (Key ^ (Key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  Key = (Key ^ (Key >> 27)) * 0x94d049bb133111ebULL;
+  return Key ^ (Key >> 31);
+}
+
+/*****************************************************************************
+  Gauss()
+
+  Standard normal deviate of the seed, member, perturbation, layer and cell
+  (Box-Muller)
+*****************************************************************************/
+static double Gauss(unsigned int Seed, int Member, int Perturb, int Layer,
+		    int Cell)
+{
+  unsigned long long Key;
+  double U1;
+  double U2;
+
+  Key = Mix((unsigned long long) Seed);
+  Key = Mix(Key ^ (unsigned long long) Member);
+  Key = Mix(Key ^ (unsigned long long) Perturb);
+  Key = Mix(Key ^ (unsigned long long) (Layer + 1));
+  Key = Mix(Key ^ (unsigned long long) (Cell + 1));
+  U1 = ((double) (Key >> 11) + 0.5) / 9007199254740992.0;
+  Key = Mix(Key);
+  U2 = (double) (Key >> 11) / 9007199254740992.0;
+  return sqrt(-2. * log(U1)) * cos(2. * PI * U2);
+}
+
+/*****************************************************************************
+  CheckpointSum()
+
+  FNV-1a over 32-bit words, as the checksums of the checkpoint of DHSVM
+*****************************************************************************/
+static unsigned int CheckpointSum(unsigned int Sum, const unsigned int *Words,
+				  size_t NWords)
+{
+  size_t i;
+
+  for (i = 0; i < NWords; i++) {
+    Sum ^= Words[i];
+    Sum *= 16777619u;
+  }
+  return Sum;
+}
@@ -0,0 +1,133 @@
+/*
+ * SUMMARY:      channel_flow_text.c - convert binary channel flow output to
+ *               text
+ * USAGE:        channel_flow_text <Stream.Flow.bin> <Stream.Flow>
+ *                                 <Streamflow.Only>
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Reads a Stream.Flow.bin or Road.Flow.bin file written with
+ *               CHANNEL OUTPUT FORMAT = BINARY and writes the Stream.Flow and
+ *               Streamflow.Only text files DHSVM writes with the TEXT format
+ * DESCRIP-END.
+ * COMMENTS:     The layout of the binary file is described with
+ *               channel_save_outflow_bin_header() and
+ *               channel_save_outflow_bin() in sourcecode/channel.c.  The
+ *               file has to be read on a machine with the same byte order
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* must match sourcecode/channel.h */
+#define CHANNEL_BIN_MAGIC   "DHSVMFLW"
+#define CHANNEL_BIN_DATELEN 20
+
+int main(int argc, char **argv)
+{
+  FILE *infile, *flowfile, *onlyfile;
+  char magic[sizeof(CHANNEL_BIN_MAGIC)];
+  char date[CHANNEL_BIN_DATELEN + 1];
+  int nrecord;			/* number of recorded segments */
+  int *id;			/* segment ids */
+  char **name;			/* segment record names, NULL if none */
+  float *values;		/* one record: 4 values per segment */
+  float totals[5];
+  int len;
+  int i;
+  long nsteps = 0;
+
+  if (argc != 4) {
+    printf("usage is: channel_flow_text <binary flow file> <flow file> "
+	   "<flow only file>\n");
+    exit(-1);
+  }
+
+  if (!(infile = fopen(argv[1], "rb"))) {
+    printf("unable to open %s\n", argv[1]);
+    exit(-1);
+  }
+  if (!(flowfile = fopen(argv[2], "w")) || !(onlyfile = fopen(argv[3], "w"))) {
+    printf("unable to open the output files\n");
+    exit(-1);
+  }
+
+  /* header */
+  if (fread(magic, 1, strlen(CHANNEL_BIN_MAGIC), infile) !=
+      strlen(CHANNEL_BIN_MAGIC) ||
+      strncmp(magic, CHANNEL_BIN_MAGIC, strlen(CHANNEL_BIN_MAGIC)) != 0 ||
+      fread(&nrecord, sizeof(int), 1, infile) != 1 || nrecord < 0) {
+    printf("%s is not a binary channel flow file\n", argv[1]);
+    exit(-1);
+  }
+  id = (int *) calloc(nrecord + 1, sizeof(int));
+  name = (char **) calloc(nrecord + 1, sizeof(char *));
+  values = (float *) calloc(4 * nrecord + 1, sizeof(float));
+  if (id == NULL || name == NULL || values == NULL) {
+    printf("out of memory\n");
+    exit(-1);
+  }
+  for (i = 0; i < nrecord; i++) {
+    if (fread(&(id[i]), sizeof(int), 1, infile) != 1 ||
+	fread(&len, sizeof(int), 1, infile) != 1) {
+      printf("%s: truncated header\n", argv[1]);
+      exit(-1);
+    }
+    if (len >= 0) {
+      if (!(name[i] = (char *) calloc(len + 1, sizeof(char)))) {
+	printf("out of memory\n");
+	exit(-1);
+      }
+      if (fread(name[i], 1, len, infile) != len) {
+	printf("%s: truncated header\n", argv[1]);
+	exit(-1);
+      }
+    }
+  }
+
+  fprintf(onlyfile, "DATE ");
+  for (i = 0; i < nrecord; i++)
+    fprintf(onlyfile, "%s ", name[i] != NULL ? name[i] : "(null)");
+  fprintf(onlyfile, "\n");
+
+  /* one record per time step */
+  date[CHANNEL_BIN_DATELEN] = '\0';
+  while (fread(date, 1, CHANNEL_BIN_DATELEN, infile) == CHANNEL_BIN_DATELEN) {
+    if (fread(values, sizeof(float), 4 * nrecord, infile) != 4 * nrecord ||
+	fread(totals, sizeof(float), 5, infile) != 5) {
+      printf("%s: truncated record after %ld steps\n", argv[1], nsteps);
+      break;
+    }
+
+    fprintf(onlyfile, "%15s ", date);
+    for (i = 0; i < nrecord; i++) {
+      fprintf(flowfile, "%15s %10d %12.5g %12.5g %12.5g %12.5g", date, id[i],
+	      values[4 * i], values[4 * i + 1], values[4 * i + 2],
+	      values[4 * i + 3]);
+      if (name[i] != NULL)
+	fprintf(flowfile, "   \"%s\"\n", name[i]);
+      else
+	fprintf(flowfile, "\n");
+      fprintf(onlyfile, "%12.5g ", values[4 * i + 2]);
+    }
+    fprintf(flowfile, "%15s %10d %12.5g %12.5g %12.5g %12.5g %12.5g \"Totals\"\n",
+	    date, 0, totals[0], totals[1], totals[2], totals[3], totals[4]);
+    fprintf(onlyfile, "\n");
+    nsteps++;
+  }
+
+  printf("%ld time steps of %d segments converted\n", nsteps, nrecord);
+
+  fclose(infile);
+  fclose(flowfile);
+  fclose(onlyfile);
+  for (i = 0; i < nrecord; i++)
+    free(name[i]);
+  free(name);
+  free(id);
+  free(values);
+
+  return 0;
+}
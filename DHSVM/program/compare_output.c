@@ -0,0 +1,600 @@
+/*
+ * SUMMARY:      compare_output.c - Compare a DHSVM output directory with a
+ *               golden output
+ * USAGE:        compare_output [options] <golden directory> <directory>
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Compares each file of the golden output directory with the
+ *               file of the same name in the other directory and reports,
+ *               for each variable, the largest deviation, where it occurs
+ *               and the first time a value is outside its tolerance.  The
+ *               exit status is 0 if all values are within their
+ *               tolerances, 1 otherwise.
+ * DESCRIP-END.
+ * FUNCTIONS:    main()
+ *               Usage()
+ *               ReadTolerances()
+ *               FindTolerance()
+ *               FindVariable()
+ *               CompareValue()
+ *               CompareText()
+ *               CompareBinary()
+ *               Report()
+ * COMMENTS:     Files ending in .bin are maps or model states, arrays of
+ *               4 byte floats.  With -r and -c the location of a value is
+ *               given as its layer, row and column, and each layer is a
+ *               variable of its own.  For a model state, the time is the
+ *               date in the name of the file.
+ *
+ *               All other files are text tables (Aggregated.Values,
+ *               Mass.Balance, Stream.Flow, ...), compared line by line and
+ *               token by token.  The numbers are compared with their
+ *               tolerances, all other tokens have to be the same.  The
+ *               variables are the columns, named by the first line of the
+ *               file if it is a header with a name for each column, by
+ *               their number otherwise.  The time of a line is its first
+ *               token if that is a date.
+ *
+ *               A value passes if |value - golden| <= abs + rel * |golden|.
+ *               The tolerances are exact (0 0) unless set with -a and -e or
+ *               in a tolerance file (-t), with lines of
+ *
+ *                 <file pattern> <variable pattern> <abs> <rel>
+ *                 <file pattern> ignore
+ *
+ *               where the patterns are shell wildcards.  The last line
+ *               that matches a variable sets its tolerances.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define MAXSTRING      255
+#define MAXTOKENS      4096
+
+typedef struct {
+  char FilePattern[MAXSTRING + 1];
+  char VarPattern[MAXSTRING + 1];
+  int Ignore;
+  double Abs;
+  double Rel;
+} TOLERANCE;
+
+typedef struct {
+  char Name[2 * MAXSTRING + 2];	/* <file>:<variable> */
+  double Abs;			/* tolerances */
+  double Rel;
+  long N;			/* values compared */
+  long NDiff;			/* values that differ */
+  long NFail;			/* values outside the tolerances */
+  double MaxAbs;		/* largest absolute deviation */
+  double MaxRel;		/* largest relative deviation */
+  double Golden;		/* golden value at MaxAbs */
+  double Value;			/* value at MaxAbs */
+  char Where[2 * MAXSTRING + 2];	/* location of MaxAbs */
+  char First[MAXSTRING + 1];	/* time of the first value outside the
+				   tolerances */
+} VARIABLE;
+
+static TOLERANCE *Tolerances = NULL;
+static int NTolerances = 0;
+static double DefaultAbs = 0.0;
+static double DefaultRel = 0.0;
+static VARIABLE *Variables = NULL;
+static int NVariables = 0;
+static int NProblems = 0;		/* missing files and mismatched
+					   structure */
+static int NX = 0;
+static int NY = 0;
+static int Verbose = 0;
+
+static void Usage(char *Program);
+static void ReadTolerances(const char *FileName);
+static TOLERANCE *FindTolerance(const char *File, const char *Var);
+static VARIABLE *FindVariable(const char *File, const char *Var);
+static void CompareValue(VARIABLE *Var, double Golden, double Value,
+			 const char *Where, const char *Time);
+static void CompareText(const char *File, const char *GoldenPath,
+			const char *Path);
+static void CompareBinary(const char *File, const char *GoldenPath,
+			  const char *Path);
+static int Report(void);
+
+/*****************************************************************************
+  main()
+*****************************************************************************/
+int main(int argc, char **argv)
+{
+  char GoldenPath[2 * MAXSTRING + 2];
+  char Path[2 * MAXSTRING + 2];
+  struct dirent **Files;
+  struct stat Stat;
+  TOLERANCE *Tol;
+  const char *Name;
+  int NFiles;
+  int NCompared = 0;
+  int i;
+  int c;
+
+  while ((c = getopt(argc, argv, "t:a:e:r:c:v")) != -1) {
+    switch (c) {
+    case 't':
+      ReadTolerances(optarg);
+      break;
+    case 'a':
+      DefaultAbs = atof(optarg);
+      break;
+    case 'e':
+      DefaultRel = atof(optarg);
+      break;
+    case 'r':
+      NY = atoi(optarg);
+      break;
+    case 'c':
+      NX = atoi(optarg);
+      break;
+    case 'v':
+      Verbose = 1;
+      break;
+    default:
+      Usage(argv[0]);
+    }
+  }
+  if (optind != argc - 2 || DefaultAbs < 0.0 || DefaultRel < 0.0 ||
+      NX < 0 || NY < 0 || (NX > 0) != (NY > 0))
+    Usage(argv[0]);
+
+  if ((NFiles = scandir(argv[optind], &Files, NULL, alphasort)) < 0) {
+    fprintf(stderr, "%s: cannot read directory %s\n", argv[0], argv[optind]);
+    exit(2);
+  }
+
+  for (i = 0; i < NFiles; i++) {
+    Name = Files[i]->d_name;
+    snprintf(GoldenPath, sizeof(GoldenPath), "%s/%s", argv[optind], Name);
+    snprintf(Path, sizeof(Path), "%s/%s", argv[optind + 1], Name);
+    Tol = FindTolerance(Name, "*");
+    if (Name[0] == '.' || stat(GoldenPath, &Stat) != 0 ||
+	!S_ISREG(Stat.st_mode) || (Tol != NULL && Tol->Ignore)) {
+      free(Files[i]);
+      continue;
+    }
+    if (stat(Path, &Stat) != 0) {
+      printf("MISSING  %s\n", Path);
+      NProblems++;
+    }
+    else if (strlen(Name) > 4 && strcmp(Name + strlen(Name) - 4, ".bin") == 0)
+      CompareBinary(Name, GoldenPath, Path);
+    else
+      CompareText(Name, GoldenPath, Path);
+    NCompared++;
+    free(Files[i]);
+  }
+  free(Files);
+
+  if (NCompared == 0) {
+    fprintf(stderr, "%s: no files to compare in %s\n", argv[0],
+	    argv[optind]);
+    exit(2);
+  }
+  return Report();
+}
+
+/*****************************************************************************
+  Usage()
+*****************************************************************************/
+static void Usage(char *Program)
+{
+  fprintf(stderr, "usage: %s [options] <golden directory> <directory>\n",
+	  Program);
+  fprintf(stderr, "  -t file     tolerance file\n");
+  fprintf(stderr, "  -a abs      default absolute tolerance (0)\n");
+  fprintf(stderr, "  -e rel      default relative tolerance (0)\n");
+  fprintf(stderr, "  -r rows     rows of the maps, for the locations\n");
+  fprintf(stderr, "  -c cols     columns of the maps\n");
+  fprintf(stderr, "  -v          report all variables, also the identical "
+	  "ones\n");
+  exit(2);
+}
+
+/*****************************************************************************
+  ReadTolerances()
+*****************************************************************************/
+static void ReadTolerances(const char *FileName)
+{
+  char Buffer[4 * MAXSTRING];
+  char Abs[MAXSTRING + 1];
+  char Rel[MAXSTRING + 1];
+  TOLERANCE *Tol;
+  FILE *InFile;
+  char *End;
+  int Line = 0;
+  int n;
+
+  if (!(InFile = fopen(FileName, "r"))) {
+    fprintf(stderr, "compare_output: cannot open %s\n", FileName);
+    exit(2);
+  }
+  while (fgets(Buffer, sizeof(Buffer), InFile)) {
+    Line++;
+    if ((End = strchr(Buffer, '#')) != NULL)
+      *End = '\0';
+    if (!(Tolerances = (TOLERANCE *) realloc(Tolerances,
+					     (NTolerances + 1) *
+					     sizeof(TOLERANCE)))) {
+      fprintf(stderr, "compare_output: out of memory\n");
+      exit(2);
+    }
+    Tol = &(Tolerances[NTolerances]);
+    memset(Tol, 0, sizeof(TOLERANCE));
+    n = sscanf(Buffer, "%255s %255s %255s %255s", Tol->FilePattern,
+	       Tol->VarPattern, Abs, Rel);
+    if (n <= 0)
+      continue;
+    if (n == 2 && strcmp(Tol->VarPattern, "ignore") == 0) {
+      Tol->Ignore = 1;
+      strcpy(Tol->VarPattern, "*");
+    }
+    else if (n != 4 || (Tol->Abs = strtod(Abs, &End)) < 0.0 || *End != '\0'
+	     || (Tol->Rel = strtod(Rel, &End)) < 0.0 || *End != '\0') {
+      fprintf(stderr, "compare_output: error in line %d of %s\n", Line,
+	      FileName);
+      exit(2);
+    }
+    NTolerances++;
+  }
+  fclose(InFile);
+}
+
+/*****************************************************************************
+  FindTolerance()
+
+  Last line of the tolerance file that matches the variable, NULL if none
+*****************************************************************************/
+static TOLERANCE *FindTolerance(const char *File, const char *Var)
+{
+  int i;
+
+  for (i = NTolerances - 1; i >= 0; i--)
+    if (fnmatch(Tolerances[i].FilePattern, File, 0) == 0 &&
+	fnmatch(Tolerances[i].VarPattern, Var, 0) == 0)
+      return &(Tolerances[i]);
+  return NULL;
+}
+
+/*****************************************************************************
+  FindVariable()
+
+  Finds or adds a variable, the list is short enough for a linear search
+  from the end, where the variables of the current file are
+*****************************************************************************/
+static VARIABLE *FindVariable(const char *File, const char *Var)
+{
+  char Name[2 * MAXSTRING + 2];
+  TOLERANCE *Tol;
+  VARIABLE *New;
+  int i;
+
+  snprintf(Name, sizeof(Name), "%s:%s", File, Var);
+  for (i = NVariables - 1; i >= 0; i--)
+    if (strcmp(Variables[i].Name, Name) == 0)
+      return &(Variables[i]);
+
+  if (!(Variables = (VARIABLE *) realloc(Variables, (NVariables + 1) *
+					 sizeof(VARIABLE)))) {
+    fprintf(stderr, "compare_output: out of memory\n");
+    exit(2);
+  }
+  New = &(Variables[NVariables++]);
+  memset(New, 0, sizeof(VARIABLE));
+  strcpy(New->Name, Name);
+  if ((Tol = FindTolerance(File, Var)) != NULL && !Tol->Ignore) {
+    New->Abs = Tol->Abs;
+    New->Rel = Tol->Rel;
+  }
+  else {
+    New->Abs = DefaultAbs;
+    New->Rel = DefaultRel;
+  }
+  return New;
+}
+
+/*****************************************************************************
+  CompareValue()
+*****************************************************************************/
+static void CompareValue(VARIABLE *Var, double Golden, double Value,
+			 const char *Where, const char *Time)
+{
+  double Diff;
+  int Fail;
+
+  Var->N++;
+  if (Golden == Value || (isnan(Golden) && isnan(Value)))
+    return;
+
+  Diff = fabs(Value - Golden);
+  if (isnan(Diff))
+    Diff = HUGE_VAL;
+  Fail = !(Diff <= Var->Abs + Var->Rel * fabs(Golden));
+
+  Var->NDiff++;
+  if (Var->NDiff == 1 || Diff > Var->MaxAbs) {
+    Var->MaxAbs = Diff;
+    Var->Golden = Golden;
+    Var->Value = Value;
+    strncpy(Var->Where, Where, sizeof(Var->Where) - 1);
+  }
+  if (Golden != 0.0 && Diff / fabs(Golden) > Var->MaxRel)
+    Var->MaxRel = Diff / fabs(Golden);
+  if (Fail && Var->NFail++ == 0)
+    strncpy(Var->First, Time, MAXSTRING);
+}
+
+/*****************************************************************************
+  CompareText()
+*****************************************************************************/
+
+/* splits a line into tokens at white space, returns their number */
+static int Tokenize(char *Line, char **Tokens)
+{
+  int N = 0;
+
+  for (Line = strtok(Line, " \t\r\n"); Line != NULL && N < MAXTOKENS;
+       Line = strtok(NULL, " \t\r\n"))
+    Tokens[N++] = Line;
+  return N;
+}
+
+static int IsNumber(const char *Token, double *Value)
+{
+  char *End;
+
+  *Value = strtod(Token, &End);
+  return End != Token && *End == '\0';
+}
+
+static int IsDate(const char *Token)
+{
+  return isdigit((unsigned char) Token[0]) && strchr(Token, ':') != NULL;
+}
+
+static void CompareText(const char *File, const char *GoldenPath,
+			const char *Path)
+{
+  static char *Header[MAXTOKENS];
+  static char *GoldenTokens[MAXTOKENS];
+  static char *Tokens[MAXTOKENS];
+  char *HeaderLine = NULL;
+  char *GoldenLine = NULL;
+  char *Line = NULL;
+  size_t GoldenSize = 0;
+  size_t Size = 0;
+  char Where[2 * MAXSTRING + 2];
+  char Time[MAXSTRING + 1];
+  char Column[32];
+  FILE *GoldenFile;
+  FILE *InFile;
+  double Golden;
+  double Value;
+  long LineNo = 0;
+  int NHeader = 0;
+  int NGolden;
+  int N;
+  int j;
+
+  if (!(GoldenFile = fopen(GoldenPath, "r")) || !(InFile = fopen(Path, "r"))) {
+    fprintf(stderr, "compare_output: cannot open %s\n", Path);
+    exit(2);
+  }
+
+  for (;;) {
+    NGolden = getline(&GoldenLine, &GoldenSize, GoldenFile);
+    N = getline(&Line, &Size, InFile);
+    LineNo++;
+    if (NGolden < 0 || N < 0) {
+      if (NGolden >= 0 || N >= 0) {
+	printf("LINES    %s: %s has %s lines than the golden output\n", File,
+	       Path, (N >= 0) ? "more" : "fewer");
+	NProblems++;
+      }
+      break;
+    }
+
+    if (LineNo == 1)
+      HeaderLine = strdup(GoldenLine);
+    NGolden = Tokenize(GoldenLine, GoldenTokens);
+    N = Tokenize(Line, Tokens);
+
+    /* a header names the columns */
+    if (LineNo == 1 && NGolden > 0 &&
+	isalpha((unsigned char) GoldenTokens[0][0])) {
+      NHeader = Tokenize(HeaderLine, Header);
+    }
+
+    if (NGolden > 0 && IsDate(GoldenTokens[0]))
+      snprintf(Time, sizeof(Time), "%s", GoldenTokens[0]);
+    else
+      snprintf(Time, sizeof(Time), "line %ld", LineNo);
+    if (NGolden > 0 && IsDate(GoldenTokens[0]))
+      snprintf(Where, sizeof(Where), "line %ld, %s", LineNo,
+	       GoldenTokens[0]);
+    else
+      snprintf(Where, sizeof(Where), "line %ld", LineNo);
+
+    if (N != NGolden) {
+      printf("COLUMNS  %s: %d instead of %d tokens in %s\n", File, N,
+	     NGolden, Where);
+      NProblems++;
+      continue;
+    }
+
+    for (j = 0; j < N; j++) {
+      if (IsNumber(GoldenTokens[j], &Golden) && IsNumber(Tokens[j], &Value)) {
+	if (NHeader == N)
+	  CompareValue(FindVariable(File, Header[j]), Golden, Value, Where,
+		       Time);
+	else {
+	  sprintf(Column, "column %d", j + 1);
+	  CompareValue(FindVariable(File, Column), Golden, Value, Where,
+		       Time);
+	}
+      }
+      else if (strcmp(GoldenTokens[j], Tokens[j]) != 0) {
+	printf("TEXT     %s: \"%s\" instead of \"%s\" in %s\n", File,
+	       Tokens[j], GoldenTokens[j], Where);
+	NProblems++;
+	break;
+      }
+    }
+  }
+
+  free(HeaderLine);
+  free(GoldenLine);
+  free(Line);
+  fclose(GoldenFile);
+  fclose(InFile);
+}
+
+/*****************************************************************************
+  CompareBinary()
+*****************************************************************************/
+static float *ReadFloats(const char *Path, long *N)
+{
+  FILE *InFile;
+  float *Values;
+  long Bytes;
+
+  if (!(InFile = fopen(Path, "rb"))) {
+    fprintf(stderr, "compare_output: cannot open %s\n", Path);
+    exit(2);
+  }
+  fseek(InFile, 0, SEEK_END);
+  Bytes = ftell(InFile);
+  rewind(InFile);
+  *N = Bytes / sizeof(float);
+  if (!(Values = (float *) malloc(Bytes + 1)) ||
+      fread(Values, 1, Bytes, InFile) != (size_t) Bytes) {
+    fprintf(stderr, "compare_output: cannot read %s\n", Path);
+    exit(2);
+  }
+  fclose(InFile);
+  return Values;
+}
+
+static void CompareBinary(const char *File, const char *GoldenPath,
+			  const char *Path)
+{
+  char Where[2 * MAXSTRING + 2];
+  char Time[MAXSTRING + 1];
+  char Layer[32];
+  VARIABLE *Var = NULL;
+  float *Golden;
+  float *Values;
+  const char *s;
+  long NGolden;
+  long N;
+  long Cells;
+  long i;
+  int m;
+  int d;
+  int y;
+  int H;
+  int M;
+  int S;
+
+  Golden = ReadFloats(GoldenPath, &NGolden);
+  Values = ReadFloats(Path, &N);
+  if (N != NGolden) {
+    printf("SIZE     %s: %ld instead of %ld values\n", File, N, NGolden);
+    NProblems++;
+    free(Golden);
+    free(Values);
+    return;
+  }
+
+  /* date of a model state, Soil.State.mm.dd.yyyy.hh.mm.ss.bin */
+  strcpy(Time, "-");
+  for (s = File; *s != '\0'; s++)
+    if (sscanf(s, ".%2d.%2d.%4d.%2d.%2d.%2d.bin", &m, &d, &y, &H, &M, &S)
+	== 6) {
+      sprintf(Time, "%02d/%02d/%04d-%02d:%02d:%02d", m, d, y, H, M, S);
+      break;
+    }
+
+  Cells = (NX > 0 && NGolden % ((long) NX * NY) == 0) ? (long) NX * NY : 0;
+  if (Cells == 0)
+    Var = FindVariable(File, "all");
+  for (i = 0; i < NGolden; i++) {
+    if (Cells > 0) {
+      if (i % Cells == 0) {
+	sprintf(Layer, "layer %ld", i / Cells + 1);
+	Var = FindVariable(File, Layer);
+      }
+      snprintf(Where, sizeof(Where), "layer %ld row %ld col %ld",
+	       i / Cells + 1, (i % Cells) / NX, i % NX);
+    }
+    else
+      snprintf(Where, sizeof(Where), "value %ld", i);
+    CompareValue(Var, Golden[i], Values[i], Where, Time);
+  }
+
+  free(Golden);
+  free(Values);
+}
+
+/*****************************************************************************
+  Report()
+*****************************************************************************/
+static int Report(void)
+{
+  VARIABLE *Var;
+  double MaxAbs = 0.0;		/* largest deviations of all variables */
+  double MaxRel = 0.0;
+  int NDiffer = 0;
+  int NFail = 0;
+  int i;
+
+  printf("%-6s %-44s %11s %11s %9s  %-32s %s\n", "", "Variable", "Max abs",
+	 "Max rel", "Outside", "At the max abs", "First outside");
+  for (i = 0; i < NVariables; i++) {
+    Var = &(Variables[i]);
+    if (Var->NDiff > 0)
+      NDiffer++;
+    if (Var->NFail > 0)
+      NFail++;
+    if (Var->MaxAbs > MaxAbs)
+      MaxAbs = Var->MaxAbs;
+    if (Var->MaxRel > MaxRel)
+      MaxRel = Var->MaxRel;
+    if (Var->NDiff == 0 && !Verbose)
+      continue;
+    printf("%-6s %-44s %11.4g %11.4g %9ld  %-32s %s\n",
+	   (Var->NFail > 0) ? "FAIL" : ((Var->NDiff > 0) ? "DIFF" : "OK"),
+	   Var->Name, Var->MaxAbs, Var->MaxRel, Var->NFail,
+	   (Var->NDiff > 0) ? Var->Where : "-",
+	   (Var->NFail > 0) ? Var->First : "-");
+    if (Var->NDiff > 0 && Verbose)
+      printf("%-6s %-44s golden %.9g, value %.9g, tolerance %g + %g * "
+	     "|golden|\n", "", "", Var->Golden, Var->Value, Var->Abs,
+	     Var->Rel);
+  }
+  printf("\n%d variables, %d differ, %d outside the tolerances, "
+	 "%d missing files or mismatches\n", NVariables, NDiffer, NFail,
+	 NProblems);
+  printf("Largest deviation: %.4g abs, %.4g rel\n", MaxAbs, MaxRel);
+  if (NFail > 0 || NProblems > 0) {
+    printf("FAILED\n");
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
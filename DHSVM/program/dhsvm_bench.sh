@@ -0,0 +1,492 @@
+#!/bin/sh
+#
+# SUMMARY:      dhsvm_bench.sh - Standard DHSVM benchmark suite
+# USAGE:        dhsvm_bench.sh [--scaling] <DHSVM> <make_synthetic_basin>
+#                              <directory>
+#               dhsvm_bench.sh --compare <baseline record> <record>
+#
+# AUTHOR:       DHSVM project
+# ORG:          Pacific Northwest National Laboratory
+# ORIG-DATE:    Oct-2026
+# DESCRIPTION:  Makes synthetic basins of 100k, 1M and 10M cells with
+#               make_synthetic_basin and runs DHSVM on each with the
+#               options of the variants below, with OPTIONS PROFILE = TRUE.
+#               The output of each run goes to <directory>/<size>/log.<variant>
+#               and the throughput of all runs to <directory>/summary.txt.
+#
+#               The record of the suite, <directory>/bench.json, gives the
+#               git revision, the compiler and its flags, the host CPU and,
+#               for each run, the time of the initialization, of the loop
+#               and of each of its phases, the peak memory, the bytes read
+#               and written and the deviation of the output from the golden
+#               output of the basin and variant in <directory>/golden, which
+#               is the output of the first run that had none.
+#
+#               With --compare the runs of two records with the same basin
+#               (cells, days, seed), variant and threads are compared, and
+#               each time, memory or I/O measure that has grown by more than
+#               the noise threshold, and each run whose output has left its
+#               tolerances, is flagged as a regression.  The exit status is
+#               1 if there is one, 0 otherwise.
+#
+#               With --scaling each basin and variant is run with each of
+#               BENCH_SCALING_THREADS instead, and the loop time of each
+#               phase of the profile goes to <directory>/scaling.csv and
+#               scaling.json, with the speedup and the parallel efficiency
+#               of the phase against the run with the fewest threads.  The
+#               strong scaling runs keep the basin, the weak scaling runs
+#               give each thread BENCH_SIZES cells.  The phase whose efficiency drops
+#               first is the one that stops scaling.
+# DESCRIP-END.
+# COMMENTS:     The basins are only made once, they can be reused by the
+#               runs of other builds.  The variants are
+#
+#                 base        no snow
+#                 snow        cold forcing and an initial snow pack
+#                 heatflux    SENSIBLE HEAT FLUX = TRUE
+#                 shading     SHADING = TRUE
+#                 streamtemp  STREAM TEMPERATURE = TRUE
+#
+#               The environment can change the suite:
+#
+#                 BENCH_SIZES     cells of the basins ("100000 1000000 10000000")
+#                 BENCH_VARIANTS  variants (all of the above)
+#                 BENCH_DAYS      days of each run (1)
+#                 BENCH_THREADS   NUMBER OF THREADS (1)
+#                 BENCH_SEED      seed of the basins (1)
+#                 BENCH_RECORD    record of the suite (<directory>/bench.json)
+#                 BENCH_GOLDEN    golden outputs (<directory>/golden)
+#                 BENCH_COMPARE_OUTPUT  compare_output, without it the output
+#                                 is not compared
+#                 BENCH_TOLERANCES      tolerance file (regress.tol)
+#                 BENCH_COMPILER, BENCH_FLAGS  compiler and flags of the
+#                                 build, for the record
+#
+#               and with --scaling
+#
+#                 BENCH_SIZES            cells of the basins, of each thread
+#                                        for weak scaling ("100000")
+#                 BENCH_VARIANTS         variants ("base")
+#                 BENCH_SCALING          strong and/or weak ("strong weak")
+#                 BENCH_SCALING_THREADS  thread counts ("1 2 4 8")
+#
+#               The efficiency of a strong scaling run with p threads is
+#               T(p0) p0 / (T(p) p), of a weak scaling run T(p0) / T(p),
+#               where p0 is the fewest threads of the matrix.
+#
+#               and with --compare
+#
+#                 BENCH_NOISE     relative noise threshold (0.05)
+#                 BENCH_NOISE_S   times below which nothing is flagged (0.01)
+#                 BENCH_NOISE_MB  memory and I/O below which nothing is
+#                                 flagged (1)
+#
+#               The record is version 1 of the "dhsvm-bench" schema, one
+#               run per line of its "runs":
+#
+#                 {"cells": <n>, "variant": <name>, "threads": <n>,
+#                  "days": <n>, "seed": <n>, "status": "ok" or "failed",
+#                  "init_s": <s>, "loop_s": <s>, "step_ms": <ms>,
+#                  "throughput": <simulated h / wall h>,
+#                  "peak_rss_mb": <MB>, "tagged_peak_mb": <MB>,
+#                  "io_read_mb": <MB>, "io_written_mb": <MB>,
+#                  "phases": {<phase>: <wall s>, ...},
+#                  "golden": {"status": "passed", "failed" or "new",
+#                             "differ": <n>, "outside": <n>,
+#                             "max_abs": <x>, "max_rel": <x>} or null}
+#
+#               with null for what the log does not give.  The times are
+#               only comparable between records of the same host.
+
+if [ "$1" = "--compare" ]; then
+  if [ $# -ne 3 ]; then
+    echo "usage: $0 --compare <baseline record> <record>" >&2
+    exit 2
+  fi
+  for f in "$2" "$3"; do
+    if ! grep -q '"schema": "dhsvm-bench"' "$f" ||
+       ! grep -q '"version": 1,' "$f"; then
+      echo "$0: $f is not a version 1 dhsvm-bench record" >&2
+      exit 2
+    fi
+  done
+  awk -v noise="${BENCH_NOISE:-0.05}" -v noise_s="${BENCH_NOISE_S:-0.01}" \
+      -v noise_mb="${BENCH_NOISE_MB:-1}" '
+    # value of the number or string "name" in s, "" if it is null or missing
+    function get(s, name) {
+      if (!match(s, "\"" name "\": (\"[^\"]*\"|[-+.0-9eE]+)"))
+        return ""
+      v = substr(s, RSTART + length(name) + 4, RLENGTH - length(name) - 4)
+      gsub(/"/, "", v)
+      return v
+    }
+    function host(s) { return get(s, "host") " " get(s, "cpu") }
+    # one measure of a run, flagged if it grew by more than the noise
+    function check(key, measure, a, b, floor) {
+      if (a == "" || b == "")
+        return
+      a += 0
+      b += 0
+      change = (a > 0) ? 100. * (b - a) / a : 0.0
+      flag = ""
+      if (b > a * (1 + noise) && b - a > floor) {
+        flag = "REGRESSION"
+        nregress++
+      }
+      else if (a > b * (1 + noise) && a - b > floor)
+        flag = "faster"
+      printf "%-34s %-22s %12.4f %12.4f %+8.1f%% %s\n", key, measure, a, b,
+        change, flag
+    }
+    FNR == 1 { file++ }
+    /"host": / { hosts[file] = host($0) }
+    /"revision": / { revision[file] = get($0, "revision") }
+    /^ *\{"cells": / {
+      key = get($0, "cells") " " get($0, "variant") " t" get($0, "threads") \
+        " d" get($0, "days") " s" get($0, "seed")
+      if (file == 1) {
+        base[key] = $0
+        next
+      }
+      seen[key] = 1
+      if (!(key in base)) {
+        printf "%-34s not in the baseline\n", key
+        next
+      }
+      a = base[key]
+      if (get(a, "status") != "ok" || get($0, "status") != "ok") {
+        printf "%-34s %s in the baseline, %s in the record\n", key,
+          get(a, "status"), get($0, "status")
+        if (get($0, "status") != "ok") {
+          printf "%-34s %-22s %s\n", key, "run", "REGRESSION"
+          nregress++
+        }
+        next
+      }
+      check(key, "init", get(a, "init_s"), get($0, "init_s"), noise_s)
+      check(key, "time loop", get(a, "loop_s"), get($0, "loop_s"), noise_s)
+      # the phases of the record, "name": wall, ...
+      phases = $0
+      sub(/.*"phases": \{/, "", phases)
+      sub(/\}.*/, "", phases)
+      n = split(phases, pair, /, "/)
+      for (i = 1; i <= n; i++) {
+        name = pair[i]
+        sub(/^"/, "", name)
+        sub(/": .*/, "", name)
+        check(key, substr(name, 1, 22), get(a, name), get($0, name), noise_s)
+      }
+      check(key, "peak resident set", get(a, "peak_rss_mb"),
+        get($0, "peak_rss_mb"), noise_mb)
+      check(key, "MB read", get(a, "io_read_mb"), get($0, "io_read_mb"),
+        noise_mb)
+      check(key, "MB written", get(a, "io_written_mb"),
+        get($0, "io_written_mb"), noise_mb)
+      # the output
+      ga = a
+      gb = $0
+      sub(/.*"golden": /, "", ga)
+      sub(/.*"golden": /, "", gb)
+      if (get(gb, "status") == "failed") {
+        printf "%-34s %-22s %12s %12s %9s %s\n", key, "golden output",
+          get(ga, "status"), "failed", "", "REGRESSION"
+        nregress++
+      }
+      else if (get(ga, "max_rel") != "" && get(gb, "max_rel") != "")
+        printf "%-34s %-22s %12.4g %12.4g\n", key, "max rel deviation",
+          get(ga, "max_rel"), get(gb, "max_rel")
+    }
+    END {
+      for (key in base)
+        if (!(key in seen))
+          printf "%-34s not in the record\n", key
+      if (hosts[1] != hosts[2])
+        printf "WARNING: the records are of different hosts (%s, %s), the " \
+          "times are not comparable\n", hosts[1], hosts[2]
+      printf "%d regression(s) from %s to %s beyond a noise of %.0f%%\n",
+        nregress, revision[1], revision[2], 100 * noise
+      exit (nregress > 0)
+    }' "$2" "$3"
+  exit $?
+fi
+
+scaling=0
+if [ "$1" = "--scaling" ]; then
+  scaling=1
+  shift
+fi
+if [ $# -ne 3 ]; then
+  echo "usage: $0 [--scaling] <DHSVM> <make_synthetic_basin> <directory>" >&2
+  exit 1
+fi
+
+dhsvm=$1
+generator=$2
+dir=$3
+
+if [ $scaling -eq 1 ]; then
+  sizes=${BENCH_SIZES:-"100000"}
+  variants=${BENCH_VARIANTS:-"base"}
+else
+  sizes=${BENCH_SIZES:-"100000 1000000 10000000"}
+  variants=${BENCH_VARIANTS:-"base snow heatflux shading streamtemp"}
+fi
+days=${BENCH_DAYS:-1}
+threads=${BENCH_THREADS:-1}
+seed=${BENCH_SEED:-1}
+modes=${BENCH_SCALING:-"strong weak"}
+scaling_threads=${BENCH_SCALING_THREADS:-"1 2 4 8"}
+
+# make_basin <cells>: the basin of <cells> cells in $dir/<cells>, once
+make_basin() {
+  basin="$dir/$1"
+  # keep the number of stream and road segments (at most 65535 each) in
+  # check on the large basins
+  area=`awk "BEGIN { a = 0.5 * $1 / 100000.; if (a < 0.5) a = 0.5; print (a > 8) ? 8 : a }"`
+  road=`awk "BEGIN { k = 10 * sqrt($1 / 1000000.); print (k < 10) ? 10 : int(k) }"`
+  if [ ! -f "$basin/input/dem.bin" ]; then
+    echo "Making the basin of $1 cells in $basin"
+    "$generator" -n "$1" -a "$area" -k "$road" -s "$seed" -D "$days" "$basin" \
+      > "$basin.log" 2>&1 || { cat "$basin.log"; exit 1; }
+  fi
+}
+
+# variant_flags <variant>: the make_synthetic_basin flags of the variant
+variant_flags() {
+  case $1 in
+    base)       flags="" ;;
+    snow)       flags="-C" ;;
+    heatflux)   flags="-F" ;;
+    shading)    flags="-L" ;;
+    streamtemp) flags="-R" ;;
+    *) echo "$0: unknown variant $1" >&2; exit 1 ;;
+  esac
+}
+
+mkdir -p "$dir" || exit 1
+
+if [ $scaling -eq 1 ]; then
+  # one line per run and phase: mode cells variant threads phase wall, the
+  # phase names without blanks
+  runs="$dir/scaling.runs"
+  : > "$runs"
+  for mode in $modes; do
+    case $mode in
+      strong|weak) ;;
+      *) echo "$0: unknown scaling $mode" >&2; exit 1 ;;
+    esac
+    for size in $sizes; do
+      for variant in $variants; do
+        variant_flags "$variant"
+        for nthreads in $scaling_threads; do
+          cells=$size
+          [ $mode = weak ] && cells=`expr $size \* $nthreads`
+          make_basin "$cells"
+          name="$variant.t$nthreads"
+          "$generator" -x -n "$cells" -a "$area" -k "$road" -s "$seed" \
+            -D "$days" -j "$nthreads" -o "$name" $flags "$basin" \
+            > /dev/null || exit 1
+          echo "Running $variant on $cells cells with $nthreads thread(s)"
+          log="$basin/log.$name"
+          ( cd "$basin" && "$dhsvm" "input.$name" ) > "$log" 2>&1
+          if [ $? -ne 0 ]; then
+            echo "$0: DHSVM failed, see $log" >&2
+            continue
+          fi
+          # the rows of the loop profile, whose names may have blanks
+          awk -v key="$mode $size $variant $nthreads" '
+            /^Profile of the time loop/ { inloop = 1; next }
+            inloop && /^Phase / { next }
+            inloop && /^Throughput:/ { inloop = 0 }
+            inloop && NF >= 3 {
+              for (i = 1; i <= NF && $i !~ /^[0-9.]+$/; i++)
+                ;
+              name = $1
+              for (j = 2; j < i; j++)
+                name = name "_" $j
+              wall = (name == "other") ? $i : $(i + 1)
+              print key, name, wall
+            }' "$log" >> "$runs"
+        done
+      done
+    done
+  done
+
+  # speedup and efficiency against the run with the fewest threads of each
+  # mode, basin size, variant and phase, empty (null) for the phases that
+  # took no measurable time
+  awk '
+    { k = $1 " " $2 " " $3 " " $5
+      if (!(k in base) || $4 < basew[k]) { base[k] = $6; basew[k] = $4 }
+      line[++n] = $0 }
+    END {
+      print "mode,cells,variant,threads,phase,wall_s,speedup,efficiency" > csv
+      printf "[" > json
+      for (i = 1; i <= n; i++) {
+        split(line[i], f, " ")
+        k = f[1] " " f[2] " " f[3] " " f[5]
+        cells = (f[1] == "weak") ? f[2] * f[4] : f[2]
+        speedup = ""
+        eff = ""
+        if (f[6] > 0 && base[k] > 0) {
+          speedup = base[k] / f[6]
+          eff = (f[1] == "strong") ? speedup * basew[k] / f[4] : speedup
+          if (f[1] == "weak")
+            speedup *= f[4] / basew[k]
+          speedup = sprintf("%.4f", speedup)
+          eff = sprintf("%.4f", eff)
+        }
+        printf "%s,%d,%s,%d,%s,%.6f,%s,%s\n", f[1], cells, f[3],
+          f[4], f[5], f[6], speedup, eff > csv
+        printf "%s\n  {\"mode\": \"%s\", \"cells\": %d, \"variant\": \"%s\", \"threads\": %d, \"phase\": \"%s\", \"wall_s\": %.6f, \"speedup\": %s, \"efficiency\": %s}", \
+          (i > 1) ? "," : "", f[1], cells, f[3], f[4], f[5],
+          f[6], (speedup == "") ? "null" : speedup,
+          (eff == "") ? "null" : eff > json
+      }
+      printf "\n]\n" > json
+    }' csv="$dir/scaling.csv" json="$dir/scaling.json" "$runs"
+
+  cat "$dir/scaling.csv"
+  exit 0
+fi
+
+summary="$dir/summary.txt"
+printf "%-10s %-12s %12s %12s %s\n" "cells" "variant" "loop (s)" "step (ms)" \
+  "simulated h / wall h" > "$summary"
+
+record=${BENCH_RECORD:-"$dir/bench.json"}
+golden=${BENCH_GOLDEN:-"$dir/golden"}
+compare=${BENCH_COMPARE_OUTPUT:-""}
+tolerances=${BENCH_TOLERANCES:-regress.tol}
+[ -f "$tolerances" ] || tolerances=`dirname "$0"`/$tolerances
+# one line per run of the record
+runs="$dir/bench.runs"
+: > "$runs"
+
+# json_string <text>: <text> as a JSON string
+json_string() {
+  printf '%s\n' "$1" | tr '\n' ' ' | awk '{ sub(/ $/, "")
+    gsub(/\\/, "&&"); gsub(/"/, "\\\""); printf "\"%s\"", $0 }'
+}
+
+for size in $sizes; do
+  make_basin "$size"
+  for variant in $variants; do
+    variant_flags "$variant"
+    "$generator" -x -n "$size" -a "$area" -k "$road" -s "$seed" -D "$days" \
+      -j "$threads" -o "$variant" $flags "$basin" > /dev/null || exit 1
+    echo "Running $variant on $size cells"
+    log="$basin/log.$variant"
+    ( cd "$basin" && "$dhsvm" "input.$variant" ) > "$log" 2>&1
+    if [ $? -ne 0 ]; then
+      echo "$0: DHSVM failed, see $log" >&2
+      printf "%-10s %-12s %12s\n" "$size" "$variant" "failed" >> "$summary"
+      printf '    {"cells": %d, "variant": "%s", "threads": %d, "days": %d, "seed": %d, "status": "failed"}\n' \
+        "$size" "$variant" "$threads" "$days" "$seed" >> "$runs"
+      continue
+    fi
+    awk -v size="$size" -v variant="$variant" '
+      /^time step / { loop = $4; step = $8 }
+      /^Throughput:/ { rate = $2 }
+      END { printf "%-10s %-12s %12s %12s %s\n", size, variant, loop, step, rate }' \
+      "$log" >> "$summary"
+
+    # the output against the golden output of the basin and variant, the
+    # first output becomes the golden output
+    check="$basin/compare.$variant"
+    : > "$check"
+    if [ -n "$compare" ]; then
+      if [ ! -d "$golden/$size/$variant" ]; then
+        mkdir -p "$golden/$size" &&
+          cp -R "$basin/output.$variant" "$golden/$size/$variant" || exit 1
+        echo "new" > "$check"
+      else
+        "$compare" -t "$tolerances" "$golden/$size/$variant" \
+          "$basin/output.$variant" > "$check"
+      fi
+    fi
+
+    awk -v size="$size" -v variant="$variant" -v threads="$threads" \
+        -v days="$days" -v seed="$seed" -v check="$check" '
+      function num(x) { return (x == "") ? "null" : x }
+      /^Profile of the initialization, / { init = $5 }
+      /^Profile of the time loop/ { inloop = 1; next }
+      inloop && /^Phase / { next }
+      inloop && /^time step / { loop = $4; step = $8; next }
+      inloop && /^Throughput:/ { rate = $2; inloop = 0; next }
+      inloop && NF >= 3 {
+        for (i = 1; i <= NF && $i !~ /^[0-9.]+$/; i++)
+          ;
+        name = $1
+        for (j = 2; j < i; j++)
+          name = name " " $j
+        phases = phases sprintf("%s\"%s\": %s", (phases == "") ? "" : ", ",
+          name, (name == "other") ? $i : $(i + 1))
+      }
+      /^total / { tagged = $3 }
+      /^Peak resident set of the process:/ { rss = $7 }
+      / MB read and .* MB written by the process$/ { read = $1; written = $5 }
+      END {
+        golden = "null"
+        while ((getline line < check) > 0) {
+          if (line == "new")
+            status = "new"
+          else if (line == "PASSED" || line == "FAILED")
+            status = tolower(line)
+          else if (line ~ /^[0-9]+ variables, /) {
+            split(line, f, " ")
+            differ = f[3]
+            outside = f[5]
+          }
+          else if (line ~ /^Largest deviation: /) {
+            split(line, f, "[ ,]+")
+            maxabs = f[3]
+            maxrel = f[5]
+          }
+        }
+        if (status == "new")
+          golden = "{\"status\": \"new\"}"
+        else if (status != "")
+          golden = sprintf("{\"status\": \"%s\", \"differ\": %s, \"outside\": %s, \"max_abs\": %s, \"max_rel\": %s}",
+            status, num(differ), num(outside), num(maxabs), num(maxrel))
+        printf "    {\"cells\": %d, \"variant\": \"%s\", \"threads\": %d, \"days\": %d, \"seed\": %d, \"status\": \"ok\", ",
+          size, variant, threads, days, seed
+        printf "\"init_s\": %s, \"loop_s\": %s, \"step_ms\": %s, \"throughput\": %s, ",
+          num(init), num(loop), num(step), num(rate)
+        printf "\"peak_rss_mb\": %s, \"tagged_peak_mb\": %s, \"io_read_mb\": %s, \"io_written_mb\": %s, ",
+          num(rss), num(tagged), num(read), num(written)
+        printf "\"phases\": {%s}, \"golden\": %s}\n", phases, golden
+      }' "$log" >> "$runs"
+  done
+done
+
+# the record, with the build and the host of the runs
+source=`dirname "$0"`
+revision=${BENCH_REVISION:-`git -C "$source" rev-parse HEAD 2> /dev/null`}
+dirty=false
+if [ -z "$BENCH_REVISION" ] &&
+   [ -n "`git -C "$source" status --porcelain --untracked-files=no 2> /dev/null`" ]; then
+  dirty=true
+fi
+cpu=`awk -F': *' '/^model name/ { print $2; exit }' /proc/cpuinfo 2> /dev/null`
+[ -n "$cpu" ] || cpu=`uname -m`
+{
+  echo "{"
+  echo '  "schema": "dhsvm-bench",'
+  echo '  "version": 1,'
+  echo "  \"date\": \"`date -u +%Y-%m-%dT%H:%M:%SZ`\","
+  echo "  \"revision\": `json_string "${revision:-unknown}"`,"
+  echo "  \"dirty\": $dirty,"
+  echo "  \"compiler\": `json_string "${BENCH_COMPILER:-unknown}"`,"
+  echo "  \"flags\": `json_string "$BENCH_FLAGS"`,"
+  echo "  \"host\": `json_string "\`uname -n\`"`,"
+  echo "  \"cpu\": `json_string "$cpu"`,"
+  echo "  \"cpus\": `getconf _NPROCESSORS_ONLN 2> /dev/null || echo 0`,"
+  echo '  "runs": ['
+  sed '$!s/$/,/' "$runs"
+  echo '  ]'
+  echo "}"
+} > "$record"
+
+cat "$summary"
+echo "The record of the suite is $record"
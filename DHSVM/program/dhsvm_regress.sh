@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+# SUMMARY:      dhsvm_regress.sh - Compare the output of DHSVM with a golden
+#               output
+# USAGE:        dhsvm_regress.sh [-u] <DHSVM> <make_synthetic_basin>
+#                                <compare_output> <directory>
+#
+# AUTHOR:       DHSVM project
+# ORG:          Pacific Northwest National Laboratory
+# ORIG-DATE:    Oct-2026
+# DESCRIPTION:  Runs DHSVM on the reference basin, a small synthetic basin
+#               with snow, the sensible heat flux, roads and streams, and
+#               compares Aggregated.Values, Mass.Balance, Stream.Flow and
+#               the other text output, the map dumps and the model state
+#               at the end of the run with the golden output in
+#               <directory>/golden, with the tolerances of regress.tol.
+#               The exit status is that of compare_output: 0 if all values
+#               are within their tolerances.
+# DESCRIP-END.
+# COMMENTS:     With -u, or if there is no golden output yet, the output of
+#               the run becomes the golden output.  Make it with a build
+#               that is known to be right, then check the other builds and
+#               options against it.
+#
+#               The environment can change the test:
+#
+#                 REGRESS_THREADS     NUMBER OF THREADS (1)
+#                 REGRESS_TOLERANCES  tolerance file (regress.tol)
+#                 REGRESS_GOLDEN      golden output (<directory>/golden)
+#                 REGRESS_OPTIONS     lines added to the [OPTIONS] of the
+#                                     input file, separated by ';'
+#
+#               The accuracy levels of exp, log and pow are checked
+#               against the golden output of the default EXACT level with
+#               the tolerances of regress_math.tol:
+#
+#                 REGRESS_OPTIONS="MATH ACCURACY = FAST" \
+#                 REGRESS_TOLERANCES=regress_math.tol dhsvm_regress.sh ...
+
+update=0
+if [ "$1" = "-u" ]; then
+  update=1
+  shift
+fi
+if [ $# -ne 4 ]; then
+  echo "usage: $0 [-u] <DHSVM> <make_synthetic_basin> <compare_output> <directory>" >&2
+  exit 2
+fi
+
+dhsvm=$1
+generator=$2
+compare=$3
+dir=$4
+
+rows=48
+cols=48
+threads=${REGRESS_THREADS:-1}
+tolerances=${REGRESS_TOLERANCES:-regress.tol}
+[ -f "$tolerances" ] || tolerances=`dirname "$0"`/$tolerances
+golden=${REGRESS_GOLDEN:-"$dir/golden"}
+basin="$dir/basin"
+
+mkdir -p "$dir" || exit 2
+if [ ! -f "$basin/input/dem.bin" ]; then
+  echo "Making the reference basin in $basin"
+  "$generator" -r $rows -c $cols -D 3 -s 11 -C -F -O -o regress "$basin" \
+    > "$basin.log" 2>&1 || { cat "$basin.log"; exit 2; }
+fi
+"$generator" -x -r $rows -c $cols -D 3 -s 11 -C -F -O -j "$threads" \
+  -o regress "$basin" > /dev/null || exit 2
+if [ -n "$REGRESS_OPTIONS" ]; then
+  echo "$REGRESS_OPTIONS" | tr ';' '\n' | sed 's/^ *//' > "$dir/options"
+  awk -v options="$dir/options" '{ print }
+    /^\[OPTIONS\]/ { while ((getline line < options) > 0) print line }' \
+    "$basin/input.regress" > "$basin/input.options" || exit 2
+  mv "$basin/input.options" "$basin/input.regress" || exit 2
+fi
+
+rm -rf "$basin/output.regress"
+mkdir "$basin/output.regress" || exit 2
+echo "Running DHSVM on the reference basin with $threads threads"
+( cd "$basin" && "$dhsvm" input.regress ) > "$dir/log" 2>&1
+if [ $? -ne 0 ]; then
+  echo "$0: DHSVM failed, see $dir/log" >&2
+  exit 2
+fi
+
+if [ $update -eq 1 ] || [ ! -d "$golden" ]; then
+  rm -rf "$golden"
+  cp -R "$basin/output.regress" "$golden" || exit 2
+  echo "The output is the new golden output in $golden"
+  exit 0
+fi
+
+"$compare" -t "$tolerances" -r $rows -c $cols "$golden" "$basin/output.regress"
@@ -20,12 +20,18 @@
 #include "data.h"
 #include "fileio.h"
 #include "init.h"
+#include "nearestchannel.h"
 
 /* This code is used to find out the location of the nearest channel to ALL in-basin cells (mask > 0)
    
    ************ One potential issue with this code is that if no channel is found in 100 cell-moves or loops,
     the location of the nearest channel is wherevere at the time of the bail ************
 
+   ************ The flow and distance methods (the optional last argument) do not have it: they search
+    from all the channels at once with NearestChannel() of DHSVM (sourcecode/NearestChannel.c), the first
+    channel down the whole flow path or the nearest channel in a straight line, in time linear in the
+    number of cells. DHSVM can also do this itself, with IMPERVIOUS SURFACE ROUTING FILE = FLOW or DISTANCE ****
+
    ****Usage: nrows ncols binary_flowd_file binary_mask_file stream_map_file n_header_map_file
    Note that n_header_map_file = the number of header lines in the stream map file ********
 
@@ -54,6 +60,9 @@ imperfect basin masks (in coastal areas) and 8-direction flow by Matthew Wiley 1
 *********************************************************************************************************************************/
 
 int GetNumber(char *numberStr);
+void FindNearestChannel(int nrows, int ncols, int method, unsigned char **mask,
+			unsigned char **flowd, unsigned char **has_channel,
+			FILE *outfile);
 float GetFloat(char *numberStr);
 int CopyDouble(double *Value, char *Str, const int NValues);
 
@@ -84,6 +93,7 @@ int main(int argc, char **argv)
   int xneighbor[16] = {1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1, -1, -1, 0, 1};
   int yneighbor[16] = {0, 1, 1, 1, 0, -1, -1, -1, 0, 1, 1, 1, 0, -1, -1, -1};
   int err = 1;
+  int method;
   MAPSIZE Map;
   MAPDUMP DMap;
   char VarName[255];
@@ -94,7 +104,7 @@ int main(int argc, char **argv)
 
   if(argc < 11) {
     printf("usage: <nrows> <ncols> <cell_size> <Xorig> <Yorig> <flowd_file> \n"); 
-	printf("usage: <mask_file> <stream_map_file> <n_header>\n");
+	printf("usage: <mask_file> <stream_map_file> <n_header> [method]\n");
     printf("where: flowd_file is a netCDF flow direction file in the same format as mask file\n");
     printf("       make sure that the flowd_file is free of sinks, etc\n");
     printf("       flowdirection is assumed to be from ARC-INFO, i.e. 1 to 128\n");
@@ -103,6 +113,9 @@ int main(int argc, char **argv)
     printf("       n_header are the number of header lines in the stream map file\n");
     printf("       enter 0 if there are no header lines, i.e. lines starting with #\n");
     printf("       caution: make sure you are referring to the map file not the network file\n");
+    printf("       method is path (default) to follow the flow path of each cell for up to\n");
+    printf("       100 moves, flow for the first channel down the flow path found for all\n");
+    printf("       the cells at once, or distance for the nearest channel in a straight line\n");
     exit(-1);
   }
 
@@ -122,6 +135,18 @@ int main(int argc, char **argv)
   strcpy(outputpath, argv[9]);
   nskip = GetNumber(argv[10]);
 
+  method = 0;
+  if (argc > 11) {
+    if (strcmp(argv[11], "flow") == 0)
+      method = NEAREST_FLOW;
+    else if (strcmp(argv[11], "distance") == 0)
+      method = NEAREST_DISTANCE;
+    else if (strcmp(argv[11], "path") != 0) {
+      printf("unknown method %s, use path, flow or distance\n", argv[11]);
+      exit(-1);
+    }
+  }
+
 
   Map.X = 0;
   Map.Y = 0;
@@ -288,6 +313,13 @@ int main(int argc, char **argv)
       //printf("%d %d \n",icol,irow);
   } 
  
+  /* Search from all the channels at once, see NearestChannel.c */
+  if (method != 0) {
+    printf("looking for channels \n");
+    FindNearestChannel(nrows, ncols, method, mask, flowd, has_channel, outfile);
+    return EXIT_SUCCESS;
+  }
+
   /* Trace each pixel in the masked area to the nearest downslope pixel */
   printf("looking for channels \n");
   for (y = 0; y < nrows; y++) 
@@ -339,6 +371,67 @@ int main(int argc, char **argv)
   return EXIT_SUCCESS;
 }
 
+/*****************************************************************************
+  FindNearestChannel()
+
+  Writes the surface routing file with NearestChannel().  A cell drains to
+  the first neighbor in the mask of flowd, flowd + 1, ... like the flow
+  paths above.
+*****************************************************************************/
+void FindNearestChannel(int nrows, int ncols, int method, unsigned char **mask,
+			unsigned char **flowd, unsigned char **has_channel,
+			FILE *outfile)
+{
+  unsigned char *inbasin, *channel, *down;
+  int *drainsy, *drainsx;
+  int y, x, i, k, d, ty, tx;
+  int nlost;
+
+  if (!(inbasin = (unsigned char *) calloc(nrows * ncols, sizeof(unsigned char))) ||
+      !(channel = (unsigned char *) calloc(nrows * ncols, sizeof(unsigned char))) ||
+      !(down = (unsigned char *) calloc(nrows * ncols, sizeof(unsigned char))) ||
+      !(drainsy = (int *) calloc(nrows * ncols, sizeof(int))) ||
+      !(drainsx = (int *) calloc(nrows * ncols, sizeof(int)))) {
+    printf("failed to allocate memory \n");
+    exit(-1);
+  }
+
+  for (y = 0, i = 0; y < nrows; y++) {
+    for (x = 0; x < ncols; x++, i++) {
+      inbasin[i] = (mask[y][x] > 0);
+      channel[i] = has_channel[y][x];
+      if (!inbasin[i])
+	continue;
+      for (k = 0; k < NEAREST_NDIRS; k++) {
+	d = (flowd[y][x] + k) % NEAREST_NDIRS;
+	ty = y + NearestDY[d];
+	tx = x + NearestDX[d];
+	if (ty >= 0 && ty < nrows && tx >= 0 && tx < ncols && mask[ty][tx] > 0) {
+	  down[i] = 1 << d;
+	  break;
+	}
+      }
+    }
+  }
+
+  nlost = NearestChannel(nrows, ncols, method, inbasin, channel, down,
+			 drainsy, drainsx);
+  if (nlost > 0)
+    printf("%d cells have no channel down their flow path, they get the nearest channel\n",
+	   nlost);
+
+  for (y = 0, i = 0; y < nrows; y++)
+    for (x = 0; x < ncols; x++, i++)
+      if (inbasin[i])
+	fprintf(outfile, "%d %d %d %d \n", y, x, drainsy[i], drainsx[i]);
+
+  free(inbasin);
+  free(channel);
+  free(down);
+  free(drainsy);
+  free(drainsx);
+}
+
 /*****************************************************************************
   GetNumber()
 *****************************************************************************/
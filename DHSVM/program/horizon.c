@@ -0,0 +1,358 @@
+/*
+ * SUMMARY:      horizon.c - Horizon angles of a DEM in azimuth sectors
+ * USAGE:        Part of the DHSVM preprocessing programs
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Computes, for each cell of a DEM and each of NSectors
+ *               azimuths, the tangent of the angle of the horizon, once for
+ *               the sky view factor (skyview) and the terrain shading of
+ *               every hour of the year (make_shade_maps).  The sky view
+ *               factor is the mean of cos^2 of the horizon angles, and a
+ *               cell is in the shade of the terrain when the solar altitude
+ *               is below the horizon at the solar azimuth.
+ * DESCRIP-END.
+ * FUNCTIONS:    MakeHorizons()
+ *               SweepSector()
+ *               ReadHorizons()
+ *               WriteHorizons()
+ *               DemHash()
+ *               SkyViewFactor()
+ *               HorizonTan()
+ *               FreeHorizons()
+ * COMMENTS:     Instead of marching a ray from every cell, the cells of a
+ *               sector are cut into lines in the direction of the sector,
+ *               one cell per column (or row) as a line drawn on the grid,
+ *               so that every cell lies on exactly one line.  Each line is
+ *               swept from its far end while the upper convex hull of the
+ *               elevations ahead is kept on a stack.  The horizon of a cell
+ *               is the vertex of the hull with the steepest slope, found by
+ *               popping the vertices that the cell hides from the cells
+ *               behind it, so that each sector costs O(cells) rather than
+ *               O(cells * path length).  The lines are done by the OpenMP
+ *               threads with HAVE_OPENMP (OMP_NUM_THREADS).
+ *
+ *               As with the ray marching, a cell is taken at the center of
+ *               the grid cell the line passes through, so the distances are
+ *               those along the line.  Only terrain higher than the cell
+ *               counts, the horizon angles are never negative.
+ *
+ *               With a cache file the horizons are read from it if it was
+ *               made for the same DEM, cell size and number of sectors,
+ *               and computed and written to it otherwise, so that the
+ *               shade maps of the twelve months and the sky view share one
+ *               computation.  The file holds a header and the tangents as
+ *               4 byte floats, NSectors * rows * columns of them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "horizon.h"
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+#define HORIZON_MAGIC "DHSVMHZ1"
+
+typedef struct {
+  char Magic[8];
+  int NRows;
+  int NCols;
+  int NSectors;
+  float DX;
+  unsigned int Hash;		/* of the DEM */
+} HORIZONHEADER;
+
+static void SweepSector(HORIZON *Horizon, float **Elev, int k);
+static int ReadHorizons(HORIZON *Horizon, const char *CacheFile,
+			unsigned int Hash);
+static void WriteHorizons(HORIZON *Horizon, const char *CacheFile,
+			  unsigned int Hash);
+static unsigned int DemHash(float **Elev, int NRows, int NCols);
+
+/*****************************************************************************
+  MakeHorizons()
+
+  Fills Horizon for the DEM Elev, from CacheFile if it holds the horizons
+  of this DEM (CacheFile may be NULL or empty for none)
+*****************************************************************************/
+void MakeHorizons(HORIZON *Horizon, float **Elev, int NRows, int NCols,
+		  float DX, int NSectors, const char *CacheFile)
+{
+  unsigned int Hash;
+  int k;
+
+  if (NSectors < 1) {
+    printf("the number of sectors must be at least 1\n");
+    exit(-1);
+  }
+  Horizon->NRows = NRows;
+  Horizon->NCols = NCols;
+  Horizon->NSectors = NSectors;
+  Horizon->DX = DX;
+  if (!(Horizon->Tan = (float *) calloc((size_t) NSectors * NRows * NCols,
+					sizeof(float)))) {
+    printf("not enough memory for the horizons of %d sectors\n", NSectors);
+    exit(-1);
+  }
+
+  Hash = DemHash(Elev, NRows, NCols);
+  if (CacheFile != NULL && CacheFile[0] != '\0' &&
+      ReadHorizons(Horizon, CacheFile, Hash)) {
+    printf("horizons of %d sectors read from %s\n", NSectors, CacheFile);
+    return;
+  }
+
+  printf("computing the horizons in %d sectors\n", NSectors);
+  for (k = 0; k < NSectors; k++)
+    SweepSector(Horizon, Elev, k);
+
+  if (CacheFile != NULL && CacheFile[0] != '\0')
+    WriteHorizons(Horizon, CacheFile, Hash);
+}
+
+/*****************************************************************************
+  SweepSector()
+
+  Horizons of sector k.  The major axis is the one the direction moves
+  along more; each step of a line moves one cell along it and Minor cells
+  (rounded) along the other axis.
+*****************************************************************************/
+static void SweepSector(HORIZON *Horizon, float **Elev, int k)
+{
+  double Azimuth = 2. * PI * k / Horizon->NSectors;
+  double Ex = sin(Azimuth);	/* east component of the direction */
+  double Ey = -cos(Azimuth);	/* south component (rows go south) */
+  int XMajor = (fabs(Ex) >= fabs(Ey));
+  double Major = XMajor ? Ex : Ey;
+  double Minor = (XMajor ? Ey : Ex) / fabs(Major);
+  double Step = Horizon->DX / fabs(Major);	/* distance of a step */
+  int NSteps = XMajor ? Horizon->NCols : Horizon->NRows;
+  int NOther = XMajor ? Horizon->NRows : Horizon->NCols;
+  float *Tan = Horizon->Tan + (size_t) k * Horizon->NRows * Horizon->NCols;
+  int *Offset;			/* minor axis offset of each step */
+  int OffsetMin = 0;
+  int OffsetMax = 0;
+  int Line;
+  int i;
+
+  if (!(Offset = (int *) calloc(NSteps, sizeof(int)))) {
+    printf("not enough memory for the horizons\n");
+    exit(-1);
+  }
+  for (i = 0; i < NSteps; i++) {
+    Offset[i] = (int) floor(i * Minor + 0.5);
+    if (Offset[i] < OffsetMin)
+      OffsetMin = Offset[i];
+    if (Offset[i] > OffsetMax)
+      OffsetMax = Offset[i];
+  }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel private(i)
+#endif
+  {
+    int *Cell;			/* cell of each point of the line */
+    int *Stack;			/* upper hull of the points ahead */
+    float *S;			/* distance along the line */
+    float *Z;			/* elevation */
+    int Height;
+    int n;
+    int j;
+
+    Cell = (int *) calloc(NSteps, sizeof(int));
+    Stack = (int *) calloc(NSteps, sizeof(int));
+    S = (float *) calloc(NSteps, sizeof(float));
+    Z = (float *) calloc(NSteps, sizeof(float));
+    if (Cell == NULL || Stack == NULL || S == NULL || Z == NULL) {
+      printf("not enough memory for the horizons\n");
+      exit(-1);
+    }
+
+#ifdef HAVE_OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for (Line = -OffsetMax; Line < NOther - OffsetMin; Line++) {
+      /* the cells of the line, in the direction of the sector */
+      for (i = 0, n = 0; i < NSteps; i++) {
+	int m = (Major > 0) ? i : NSteps - 1 - i;
+	int o = Line + Offset[i];
+	int y;
+	int x;
+
+	if (o < 0 || o >= NOther)
+	  continue;
+	y = XMajor ? o : m;
+	x = XMajor ? m : o;
+	Cell[n] = y * Horizon->NCols + x;
+	S[n] = (float) (i * Step);
+	Z[n] = Elev[y][x];
+	n++;
+      }
+
+      /* from the far end back, the top of the stack is the nearest vertex
+         of the hull */
+      for (j = n - 1, Height = 0; j >= 0; j--) {
+	while (Height >= 2 &&
+	       (Z[Stack[Height - 2]] - Z[j]) / (S[Stack[Height - 2]] - S[j]) >=
+	       (Z[Stack[Height - 1]] - Z[j]) / (S[Stack[Height - 1]] - S[j]))
+	  Height--;
+	Tan[Cell[j]] = 0.0;
+	if (Height > 0 && Z[Stack[Height - 1]] > Z[j])
+	  Tan[Cell[j]] = (Z[Stack[Height - 1]] - Z[j]) /
+	    (S[Stack[Height - 1]] - S[j]);
+	Stack[Height++] = j;
+      }
+    }
+
+    free(Cell);
+    free(Stack);
+    free(S);
+    free(Z);
+  }
+
+  free(Offset);
+}
+
+/*****************************************************************************
+  DemHash()
+
+  FNV-1a hash of the elevations, to tell if a cache file was made for them
+*****************************************************************************/
+static unsigned int DemHash(float **Elev, int NRows, int NCols)
+{
+  unsigned int Hash = 2166136261u;
+  const unsigned char *Byte;
+  size_t i;
+  int y;
+
+  for (y = 0; y < NRows; y++) {
+    Byte = (const unsigned char *) Elev[y];
+    for (i = 0; i < NCols * sizeof(float); i++) {
+      Hash ^= Byte[i];
+      Hash *= 16777619u;
+    }
+  }
+  return Hash;
+}
+
+/*****************************************************************************
+  ReadHorizons()
+
+  Returns TRUE if CacheFile holds the horizons of this DEM and they are
+  read
+*****************************************************************************/
+static int ReadHorizons(HORIZON *Horizon, const char *CacheFile,
+			unsigned int Hash)
+{
+  HORIZONHEADER Header;
+  size_t N = (size_t) Horizon->NSectors * Horizon->NRows * Horizon->NCols;
+  FILE *File;
+  int Ok;
+
+  if (!(File = fopen(CacheFile, "rb")))
+    return 0;
+  Ok = (fread(&Header, sizeof(Header), 1, File) == 1 &&
+	memcmp(Header.Magic, HORIZON_MAGIC, sizeof(Header.Magic)) == 0 &&
+	Header.NRows == Horizon->NRows && Header.NCols == Horizon->NCols &&
+	Header.NSectors == Horizon->NSectors && Header.DX == Horizon->DX &&
+	Header.Hash == Hash &&
+	fread(Horizon->Tan, sizeof(float), N, File) == N);
+  fclose(File);
+  if (!Ok)
+    printf("%s is not a horizon file of this DEM and number of sectors\n",
+	   CacheFile);
+  return Ok;
+}
+
+/*****************************************************************************
+  WriteHorizons()
+*****************************************************************************/
+static void WriteHorizons(HORIZON *Horizon, const char *CacheFile,
+			  unsigned int Hash)
+{
+  HORIZONHEADER Header;
+  size_t N = (size_t) Horizon->NSectors * Horizon->NRows * Horizon->NCols;
+  FILE *File;
+  int Ok;
+
+  memset(&Header, 0, sizeof(Header));
+  memcpy(Header.Magic, HORIZON_MAGIC, sizeof(Header.Magic));
+  Header.NRows = Horizon->NRows;
+  Header.NCols = Horizon->NCols;
+  Header.NSectors = Horizon->NSectors;
+  Header.DX = Horizon->DX;
+  Header.Hash = Hash;
+
+  if (!(File = fopen(CacheFile, "wb"))) {
+    printf("cannot write the horizons to %s\n", CacheFile);
+    return;
+  }
+  Ok = (fwrite(&Header, sizeof(Header), 1, File) == 1 &&
+	fwrite(Horizon->Tan, sizeof(float), N, File) == N);
+  if (fclose(File) != 0 || !Ok) {
+    printf("cannot write the horizons to %s\n", CacheFile);
+    remove(CacheFile);
+    return;
+  }
+  printf("horizons written to %s\n", CacheFile);
+}
+
+/*****************************************************************************
+  SkyViewFactor()
+
+  Fraction of the sky seen from cell (y, x), the mean of cos^2 of the
+  horizon angles of the sectors
+*****************************************************************************/
+float SkyViewFactor(HORIZON *Horizon, int y, int x)
+{
+  size_t Cells = (size_t) Horizon->NRows * Horizon->NCols;
+  const float *Tan = Horizon->Tan + (size_t) y * Horizon->NCols + x;
+  double Sum = 0.0;
+  int k;
+
+  for (k = 0; k < Horizon->NSectors; k++)
+    Sum += 1.0 / (1.0 + (double) Tan[k * Cells] * Tan[k * Cells]);
+  return (float) (Sum / Horizon->NSectors);
+}
+
+/*****************************************************************************
+  HorizonTan()
+
+  Tangent of the horizon angle of cell (y, x) at Azimuth (radians clockwise
+  from north), interpolated between the two nearest sectors
+*****************************************************************************/
+float HorizonTan(HORIZON *Horizon, int y, int x, float Azimuth)
+{
+  size_t Cells = (size_t) Horizon->NRows * Horizon->NCols;
+  const float *Tan = Horizon->Tan + (size_t) y * Horizon->NCols + x;
+  double Sector = Azimuth / (2. * PI) * Horizon->NSectors;
+  double Fraction;
+  int k0;
+  int k1;
+
+  Sector -= floor(Sector / Horizon->NSectors) * Horizon->NSectors;
+  k0 = (int) Sector;
+  Fraction = Sector - k0;
+  k0 %= Horizon->NSectors;
+  k1 = (k0 + 1) % Horizon->NSectors;
+  return (float) ((1.0 - Fraction) * Tan[k0 * Cells] +
+		  Fraction * Tan[k1 * Cells]);
+}
+
+/*****************************************************************************
+  FreeHorizons()
+*****************************************************************************/
+void FreeHorizons(HORIZON *Horizon)
+{
+  free(Horizon->Tan);
+  Horizon->Tan = NULL;
+}
@@ -0,0 +1,36 @@
+/*
+ * SUMMARY:      horizon.h - header file for the horizon angles of a DEM
+ * USAGE:        Part of the DHSVM preprocessing programs
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Horizon angles of each cell in a number of azimuth sectors,
+ *               shared by the sky view and the shade map programs, see
+ *               horizon.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef HORIZON_H
+#define HORIZON_H
+
+typedef struct {
+  int NRows;
+  int NCols;
+  int NSectors;			/* sector k looks at the azimuth 2 pi k /
+				   NSectors, clockwise from north */
+  float DX;			/* cell size, in the units of the DEM */
+  float *Tan;			/* tangent of the horizon angle, >= 0, of
+				   sector k and cell (y, x) at
+				   Tan[((size_t) k * NRows + y) * NCols + x] */
+} HORIZON;
+
+void MakeHorizons(HORIZON *Horizon, float **Elev, int NRows, int NCols,
+		  float DX, int NSectors, const char *CacheFile);
+float SkyViewFactor(HORIZON *Horizon, int y, int x);
+float HorizonTan(HORIZON *Horizon, int y, int x, float Azimuth);
+void FreeHorizons(HORIZON *Horizon);
+
+#endif
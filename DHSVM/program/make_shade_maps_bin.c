@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include "horizon.h"
 
 #define DEGPRAD        57.29578               /* degree per radian */
 #define MINPDEG        4.                     /* minutes per degree longitude */
@@ -56,10 +57,13 @@ void SolarHour(float Latitude, float LocalHour, float Dt, float NoonHour, float
 
 void CalcSlopeAspect(int nRows, int nCols, float dx, float **elev, float ***slope, float ***aspect);
 
-void CalcHillShadeWithTerrainBlocking(int nColss, int nCols, float dx, float max_elev, float **elev,
+void CalcHillShadeWithHorizons(int nRows, int nCols, HORIZON *horizon, float **elev,
   float sal, float saz, float **slope, float **aspect,
   float ***hillshade);
 
+void AddShadeStep(int nRows, int nCols, float **hillshade, float sinesolaraltitude,
+  int compress, unsigned char **outputgrid, float **average);
+
 int main(int argc, char **argv)
 {
   FILE   *demfile, *outfile, *outfile2;
@@ -98,6 +102,11 @@ int main(int argc, char **argv)
   float  noon_hour, declination, halfdaylength, solar_hour;
   float  sunrise, sunset, timeadjustment, sunearthdistance;
   float  sinesolaraltitude, solartimestep, sunmax, solarazimuth;
+  HORIZON horizon;
+  int    nsectors;
+  int    nout, compress;
+  int    firstmonth, lastmonth;
+  float  **average;
   float  beam, diffuse;
 
 
@@ -110,12 +119,21 @@ int main(int argc, char **argv)
     printf("longitude and latitude of the site (dd)\n");
     printf("longitude of location for met file time stamp\n");
     printf("year month day output_time_step (hours)\n");
+    printf("[number of horizon sectors (default 32)] [horizon file] [# of output maps per day]\n");
+    printf("the horizons are read from the horizon file if it was made for this dem\n");
+    printf("and number of sectors, and written to it otherwise\n");
+    printf("with month 0 the maps of the twelve months are made, in outfilename.MM.bin\n");
+    printf("with # of output maps per day (8 for 3 hourly) the time steps are averaged\n");
+    printf("to that many maps, as average_shadow does\n");
     exit(-1);
   }
   /* note: this program will loop over all time, starting at 0 and advancing */
   /* every hour */
   /* output images ranging from 0 to 255 are made at every output_time_step */
   /* these are in the proper format for DHSVM */
+  /* with month 0 and 8 output maps per day the files are the Shadow.MM.bin */
+  /* files that DHSVM reads with 3 hourly time steps, without the hourly */
+  /* maps and average_shadow */
 
   strcpy(demfilename, argv[1]);   /* name of the binary float dem input file - no header */
   strcpy(outfilename, argv[2]);   /* name of the binary float hillshade output file        */
@@ -130,7 +148,12 @@ int main(int argc, char **argv)
   day = GetNumber(argv[11]);
   outstep = GetFloat(argv[12]);
 
-  printf("calculating shade map for %d / %d / %d \n", month, day, year);
+  nsectors = 32;                  /* azimuth sectors of the horizons */
+  if (argc > 13)
+    nsectors = GetNumber(argv[13]);
+  nout = 0;                       /* output maps per day, 0 for every time step */
+  if (argc > 15)
+    nout = GetNumber(argv[15]);
 
   temp = calloc(nRows*nCols, sizeof(float));
   if (temp == NULL)
@@ -141,10 +164,6 @@ int main(int argc, char **argv)
     exit(-1);
   }
 
-  if (!(outfile = fopen(outfilename, "wb"))) {
-    printf("output file not opened \n");
-    exit(-1);
-  }
   /*
   sprintf(outfilename2,"%s.float",outfilename);
   if (!(outfile2 = fopen(outfilename2, "wb"))){
@@ -185,6 +204,12 @@ int main(int argc, char **argv)
     if (!((outputgrid)[ny] = (unsigned char*)calloc(nCols, sizeof(unsigned char))))
       exit(-1);
   }
+  if (!((average) = (float**)calloc(nRows, sizeof(float*))))
+    exit(-1);
+  for (ny = 0; ny < nRows; ny++) {
+    if (!((average)[ny] = (float*)calloc(nCols, sizeof(float))))
+      exit(-1);
+  }
 
   max_elev = 0.0;
   for (ny = 0; ny < nRows; ny++) {
@@ -196,56 +221,81 @@ int main(int argc, char **argv)
 
   CalcSlopeAspect(nRows, nCols, dx, elev, &slope, &aspect);
 
+  /* the horizons of all the cells once for all the hours, see horizon.c */
+  MakeHorizons(&horizon, elev, nRows, nCols, dx, nsectors,
+    (argc > 14) ? argv[14] : NULL);
+
   dt = outstep;
   stepsperday = (int)(24 / outstep);
-  for (i = 0; i < stepsperday; i++) {
-    hour = (float)i*outstep;
-    printf("working on hour %f \n", hour);
-    jday = DayOfYear(year, month, day);
+  if (nout <= 0)
+    nout = stepsperday;
+  if (stepsperday % nout != 0) {
+    printf("Number of time steps not wholly divisible by number of output maps \n");
+    exit(-1);
+  }
+  compress = stepsperday / nout;
 
+  firstmonth = lastmonth = month;
+  if (month == 0) {
+    firstmonth = 1;
+    lastmonth = MONTHPYEAR;
+  }
+
+  for (month = firstmonth; month <= lastmonth; month++) {
+    if (firstmonth != lastmonth)
+      sprintf(outfilename, "%s.%02d.bin", argv[2], month);
+    if (!(outfile = fopen(outfilename, "wb"))) {
+      printf("output file not opened \n");
+      exit(-1);
+    }
+    printf("calculating shade map for %d / %d / %d \n", month, day, year);
+
+    jday = DayOfYear(year, month, day);
     SolarDay(jday, longitude, latitude,
       standardmeridian, &noon_hour,
       &declination, &halfdaylength,
       &sunrise, &sunset, &timeadjustment, &sunearthdistance);
 
-    SolarHour(latitude, hour + dt, dt, noon_hour, &solar_hour,
-      declination, sunrise, sunset,
-      timeadjustment, sunearthdistance,
-      &sinesolaraltitude, &daylight, &solartimestep,
-      &sunmax, &solarazimuth);
-    sal = asin(sinesolaraltitude);
-    saz = solarazimuth;
-
-    /*  printf("for %2d/%2d/%4d at met-file-time %5.2f and solar hour %5.2f \n",
-        month,day,year,hour+0.5*dt,solar_hour);
-    printf(" sunrise is at %5.2f with sunset at %5.2f and solar alt: %f with azimuth %f \n",
-    sunrise,sunset,sal*DEGPRAD,saz*DEGPRAD);*/
-
-    CalcHillShadeWithTerrainBlocking(nRows, nCols, dx, max_elev, elev,
-      sal, saz, slope, aspect, &hillshade);
-
-    /* at this point hillshade is between 0 and 255 */
-    /* which is the standard arc-info for the hillshade command */
-    /* we need to translate this to the proper dhsvm format */
-    /* and output it as an unsigned char */
-
-    for (ny = 0; ny < nRows; ny++) {
-      for (nx = 0; nx < nCols; nx++) {
-        if (sinesolaraltitude > 0)
-          if (hillshade[ny][nx] / 255 / sinesolaraltitude>11.47)
-            outputgrid[ny][nx] = 255;
-          else
-            outputgrid[ny][nx] = (unsigned char)(hillshade[ny][nx] / sinesolaraltitude / 11.47);
-        else outputgrid[ny][nx] = 0;
+    for (i = 0; i < stepsperday; i++) {
+      hour = (float)i*outstep;
+      printf("working on hour %f \n", hour);
+
+      SolarHour(latitude, hour + dt, dt, noon_hour, &solar_hour,
+        declination, sunrise, sunset,
+        timeadjustment, sunearthdistance,
+        &sinesolaraltitude, &daylight, &solartimestep,
+        &sunmax, &solarazimuth);
+      sal = asin(sinesolaraltitude);
+      saz = solarazimuth;
+
+      /*  printf("for %2d/%2d/%4d at met-file-time %5.2f and solar hour %5.2f \n",
+          month,day,year,hour+0.5*dt,solar_hour);
+      printf(" sunrise is at %5.2f with sunset at %5.2f and solar alt: %f with azimuth %f \n",
+      sunrise,sunset,sal*DEGPRAD,saz*DEGPRAD);*/
+
+      CalcHillShadeWithHorizons(nRows, nCols, &horizon, elev,
+        sal, saz, slope, aspect, &hillshade);
+
+      AddShadeStep(nRows, nCols, hillshade, sinesolaraltitude, compress,
+        outputgrid, average);
+
+      /* the average of the last compress time steps is complete */
+      if ((i + 1) % compress == 0) {
+        for (ny = 0; ny < nRows; ny++) {
+          for (nx = 0; nx < nCols; nx++) {
+            outputgrid[ny][nx] = (unsigned char)average[ny][nx];
+            if (average[ny][nx] > 255.0) outputgrid[ny][nx] = 255;
+            average[ny][nx] = 0.0;
+          }
+          fwrite(outputgrid[ny], sizeof(unsigned char), nCols, outfile);
+        }
       }
     }
-
-    for (ny = 0; ny < nRows; ny++) {
-      fwrite(outputgrid[ny], sizeof(unsigned char), nCols, outfile);
-    }
-
-
+    fclose(outfile);
   }
+  FreeHorizons(&horizon);
+
+  return EXIT_SUCCESS;
 }
 
 
@@ -593,21 +643,21 @@ void CalcSlopeAspect(int nRows, int nCols, float dx, float **elev,
 }
 
 
-void CalcHillShadeWithTerrainBlocking(int nRows, int nCols, float dx, float max_elev, float **elev,
+void CalcHillShadeWithHorizons(int nRows, int nCols, HORIZON *horizon, float **elev,
   float sal, float saz, float **slope, float **aspect,
   float ***hillshade)
 {
   int ny, nx;
-  float lx, ly;
-  double max_angle, angle;
-  double theta;
-  float x, y, sx, sy, dz, dist;
-  float mx, my;
-  float start_elev;
-  int stop_flag;
-  float safe_distance;
+  float tansal;
 
   if (sal > 0) {
+    /* a cell of the dem (elev > 0) is in the shade of the terrain if the */
+    /* horizon at the solar azimuth is above the sun, see horizon.c */
+    /* the threads each take a band of rows */
+    tansal = tan(sal);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for private(nx) schedule(static)
+#endif
     for (ny = 0; ny < nRows; ny++) {
       for (nx = 0; nx < nCols; nx++) {
         (*hillshade)[ny][nx] = 255 * (cos(sal)*sin(slope[ny][nx])
@@ -617,52 +667,8 @@ void CalcHillShadeWithTerrainBlocking(int nRows, int nCols, float dx, float max_
         /* at this point hillshade can range from 0 to 255 */
 
         if ((*hillshade)[ny][nx] < 0.0) (*hillshade)[ny][nx] = 0.0;
-      }
-    }
-
-
-    ly = (float)(nRows*dx - dx);
-    lx = (float)(nCols*dx - dx);
-
-    /* utilize a series of checks to speed up program */
-    /* if one pixel in the given direction blocks, no need to check the rest in that direction */
-    /* if we are beyond the distance that the max elev can't block, then don't check the rest  */
-    /*   in that direction */
-    /* here x increases eastward and y increases southward */
-
-
-
-
-
-    for (ny = 0; ny < nRows; ny++) {
-      for (nx = 0; nx < nCols; nx++) {
-        start_elev = elev[ny][nx];
-        if (start_elev > 0) {
-          safe_distance = tan(sal)*(max_elev - start_elev);
-          sx = (float)nx*dx + 0.5*dx;
-          sy = (float)ny*dx + 0.5*dx;
-          x = sx;
-          y = sy;
-
-          while (x > dx && x < lx && y>dx && y < ly) {
-            x = x + ((float)sin(saz))*dx;
-            y = y - ((float)cos(saz))*dx;
-            dz = elev[(int)(y / dx)][(int)(x / dx)] - start_elev;
-            dist = sqrt((x - sx)*(x - sx) + (y - sy)*(y - sy));
-            if (dist > safe_distance) {
-              x = 0;
-              y = 0;
-            }
-            if (dz > 0) {
-              angle = atan((double)(dz / dist));
-              if (angle > sal) {
-                x = 0;
-                y = 0;
-                (*hillshade)[ny][nx] = 0.0;
-              }
-            }
-          }
-        }
+        if (elev[ny][nx] > 0 && HorizonTan(horizon, ny, nx, saz) > tansal)
+          (*hillshade)[ny][nx] = 0.0;
       }
     }
   }
@@ -673,11 +679,37 @@ void CalcHillShadeWithTerrainBlocking(int nRows, int nCols, float dx, float max_
         (*hillshade)[ny][nx] = 0.0;
       }
     }
-
   }
+}
 
+/*****************************************************************************
+  AddShadeStep()
 
+  Adds the shade factor of a time step (0 to 255, the proper dhsvm format)
+  to the average of the compress time steps of an output map, in the same
+  way as average_shadow
+*****************************************************************************/
+void AddShadeStep(int nRows, int nCols, float **hillshade, float sinesolaraltitude,
+  int compress, unsigned char **outputgrid, float **average)
+{
+  int ny, nx;
 
+  /* at this point hillshade is between 0 and 255 */
+  /* which is the standard arc-info for the hillshade command */
+  /* we need to translate this to the proper dhsvm format */
+  /* and output it as an unsigned char */
+#ifdef HAVE_OPENMP
+#pragma omp parallel for private(nx) schedule(static)
+#endif
+  for (ny = 0; ny < nRows; ny++) {
+    for (nx = 0; nx < nCols; nx++) {
+      if (sinesolaraltitude > 0)
+        if (hillshade[ny][nx] / 255 / sinesolaraltitude>11.47)
+          outputgrid[ny][nx] = 255;
+        else
+          outputgrid[ny][nx] = (unsigned char)(hillshade[ny][nx] / sinesolaraltitude / 11.47);
+      else outputgrid[ny][nx] = 0;
+      average[ny][nx] += (float)outputgrid[ny][nx] / (float)compress;
+    }
+  }
 }
-
-
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include "horizon.h"
 #include "fifoNetCDF.h"
 #include "sizeofNetCDF.h"
 #include "data.h"
@@ -63,9 +64,12 @@ void SolarHour(float Latitude, float LocalHour, float Dt, float NoonHour, float
 
 void CalcSlopeAspect(int nRows, int nCols, float dx, float **elev, float ***slope, float ***aspect);
 
-void CalcHillShadeWithTerrainBlocking(int nColss,int nCols,float dx,float max_elev,float **elev,
-				     float sal,float saz,float **slope,float **aspect,
-				     float ***hillshade);
+void CalcHillShadeWithHorizons(int nRows, int nCols, HORIZON *horizon, float **elev,
+  float sal, float saz, float **slope, float **aspect,
+  float ***hillshade);
+
+void AddShadeStep(int nRows, int nCols, float **hillshade, float sinesolaraltitude,
+  int compress, unsigned char **outputgrid, float **average);
 
 int main(int argc, char **argv)
 {
@@ -79,7 +83,7 @@ int main(int argc, char **argv)
   float  **elev,**slope,**aspect,**hillshade;
   unsigned char **outputgrid;
   void  *Array;
-  int    i;
+  int    i, q;
   int    ny,nx;
   float  lx,ly;
   double max_angle,angle;
@@ -108,11 +112,16 @@ int main(int argc, char **argv)
   float  noon_hour,  declination, halfdaylength, solar_hour;
   float  sunrise, sunset, timeadjustment, sunearthdistance;
   float  sinesolaraltitude, solartimestep, sunmax, solarazimuth;
+  HORIZON horizon;
+  int    nsectors;
+  int    nout, compress;
+  int    firstmonth, lastmonth;
+  float  **average;
   float  beam,diffuse;
   MAPSIZE Map;
   MAPDUMP DMap;
 
-  if(argc < 14) {
+  if(argc < 15) {
     printf("usage is: make_dhsvm_shade_maps:  \n");
     printf("demfilename  \n");
     printf("outfilename  \n");
@@ -121,13 +130,22 @@ int main(int argc, char **argv)
     printf("longitude and latitude of the site (dd)\n");
     printf("longitude of location for met file time stamp\n");
     printf("year month day output_time_step (hours)\n");
-	printf("Xorig Yorig");
+    printf("Xorig Yorig\n");
+    printf("[number of horizon sectors (default 32)] [horizon file] [# of output maps per day]\n");
+    printf("the horizons are read from the horizon file if it was made for this dem\n");
+    printf("and number of sectors, and written to it otherwise\n");
+    printf("with month 0 the maps of the twelve months are made, in outfilename.MM.nc\n");
+    printf("with # of output maps per day (8 for 3 hourly) the time steps are averaged\n");
+    printf("to that many maps, as average_shadow does\n");
     exit(-1);
   }
   /* note: this program will loop over all time, starting at 0 and advancing */
   /* every hour */
   /* output images ranging from 0 to 255 are made at every output_time_step */
   /* these are in the proper format for DHSVM */
+  /* with month 0 and 8 output maps per day the files are the Shadow.MM.nc */
+  /* files that DHSVM reads with 3 hourly time steps, without the hourly */
+  /* maps and average_shadow */
 
   strcpy(demfilename, argv[1]);   /* name of the nc_float dem input file - no header */
   strcpy(outfilename, argv[2]);   /* name of the nc_float hillshade output file        */
@@ -147,7 +165,12 @@ int main(int argc, char **argv)
   /* exterme north coordinate */
   if (!(CopyDouble(&Map.Yorig, argv[14], 1)))
 	  exit (-1);;
-  printf("calculating shade map for %d / %d / %d \n",month,day,year);
+  nsectors = 32;                  /* azimuth sectors of the horizons */
+  if (argc > 15)
+    nsectors = GetNumber(argv[15]);
+  nout = 0;                       /* output maps per day, 0 for every time step */
+  if (argc > 17)
+    nout = GetNumber(argv[17]);
 
   Map.X = 0;
   Map.Y = 0;
@@ -207,6 +230,12 @@ int main(int argc, char **argv)
     if (!((outputgrid)[ny] = (unsigned char*) calloc(nCols, sizeof(unsigned char))))
       exit(-1);
   }
+  if (!((average) = (float**) calloc(nRows, sizeof(float*))))
+    exit(-1);
+  for (ny = 0; ny < nRows; ny++) {
+    if (!((average)[ny] = (float*) calloc(nCols, sizeof(float))))
+      exit(-1);
+  }
 
   strcpy(VarName, "Basin.DEM");
   flag = Read2DMatrixNetCDF(demfilename, temp, NC_FLOAT, Map.NY, Map.NX, 0,
@@ -235,66 +264,89 @@ int main(int argc, char **argv)
 
   CalcSlopeAspect(nRows,nCols,dx,elev,&slope,&aspect);
 
+  /* the horizons of all the cells once for all the hours, see horizon.c */
+  MakeHorizons(&horizon, elev, nRows, nCols, dx, nsectors,
+    (argc > 16) ? argv[16] : NULL);
+
   dt = outstep; // in hours
   stepsperday = (int)(24 / outstep);
+  if (nout <= 0)
+    nout = stepsperday;
+  if (stepsperday % nout != 0) {
+    printf("Number of time steps not wholly divisible by number of output maps \n");
+    exit(-1);
+  }
+  compress = stepsperday / nout;
 
   /* netcdf map properties */
-  DMap.N = stepsperday;					
+  DMap.N = nout;
   if (!(DMap.DumpDate = (DATE *) calloc(DMap.N, sizeof(DATE))))
       exit(-1);
 
-  CreateMapFileNetCDF(DMap.FileName, DMap.FileLabel, &Map);
+  firstmonth = lastmonth = month;
+  if (month == 0) {
+    firstmonth = 1;
+    lastmonth = MONTHPYEAR;
+  }
+
+  for (month = firstmonth; month <= lastmonth; month++) {
+    if (firstmonth != lastmonth)
+      sprintf(DMap.FileName, "%s.%02d.nc", outfilename, month);
+    printf("calculating shade map for %d / %d / %d \n",month,day,year);
+    CreateMapFileNetCDF(DMap.FileName, DMap.FileLabel, &Map);
 
-  for(i = 0; i < stepsperday; i++){
-    hour = (float)i * outstep;
-    printf("working on hour %f \n",hour);
     jday = DayOfYear(year,month,day);
-  
     SolarDay(jday, longitude, latitude,
-           standardmeridian, &noon_hour, 
+           standardmeridian, &noon_hour,
            &declination, &halfdaylength,
            &sunrise, &sunset, &timeadjustment, &sunearthdistance);
 
-    SolarHour(latitude, hour+dt, dt, noon_hour, &solar_hour,
-	    declination,sunrise, sunset,
-	    timeadjustment, sunearthdistance,
-	    &sinesolaraltitude, &daylight, &solartimestep,
-	    &sunmax, &solarazimuth); 
-
-    sal=asin(sinesolaraltitude);
-    saz=solarazimuth;
-
-    /*  printf("for %2d/%2d/%4d at met-file-time %5.2f and solar hour %5.2f \n",
-	  month,day,year,hour+0.5*dt,solar_hour);
-    printf(" sunrise is at %5.2f with sunset at %5.2f and solar alt: %f with azimuth %f \n",
-    sunrise,sunset,sal*DEGPRAD,saz*DEGPRAD);*/
-
-    CalcHillShadeWithTerrainBlocking(nRows,nCols,dx,max_elev,elev,
-				   sal,saz,slope,aspect,&hillshade);
-
-	DMap.DumpDate[i].Year = year;
-    DMap.DumpDate[i].Month = month;
-    DMap.DumpDate[i].Day = day;
-    DMap.DumpDate[i].JDay = jday;
-    DMap.DumpDate[i].Hour = (int)hour;
-
-    /* at this point hillshade is between 0 and 255 */
-    /* which is the standard arc-info for the hillshade command */
-    /* we need to translate this to the proper dhsvm format */
-    /* and output it as an unsigned char */
-    for (ny = 0; ny < nRows; ny++) {
-	    for (nx = 0; nx < nCols; nx++) {
-		    if(sinesolaraltitude>0)
-			    if(hillshade[ny][nx]/255/sinesolaraltitude>11.47)
-				    outputgrid[ny][nx]=255;
-			    else
-				    outputgrid[ny][nx]=(unsigned char)(hillshade[ny][nx]/sinesolaraltitude/11.47);
-		    else outputgrid[ny][nx]=0;
-			((unsigned char *) Array)[ny * Map.NX + nx] = outputgrid[ny][nx];
-	    }
+    for(i = 0; i < stepsperday; i++){
+      hour = (float)i * outstep;
+      printf("working on hour %f \n",hour);
+
+      SolarHour(latitude, hour+dt, dt, noon_hour, &solar_hour,
+	      declination,sunrise, sunset,
+	      timeadjustment, sunearthdistance,
+	      &sinesolaraltitude, &daylight, &solartimestep,
+	      &sunmax, &solarazimuth);
+
+      sal=asin(sinesolaraltitude);
+      saz=solarazimuth;
+
+      /*  printf("for %2d/%2d/%4d at met-file-time %5.2f and solar hour %5.2f \n",
+	    month,day,year,hour+0.5*dt,solar_hour);
+      printf(" sunrise is at %5.2f with sunset at %5.2f and solar alt: %f with azimuth %f \n",
+      sunrise,sunset,sal*DEGPRAD,saz*DEGPRAD);*/
+
+      CalcHillShadeWithHorizons(nRows, nCols, &horizon, elev,
+        sal, saz, slope, aspect, &hillshade);
+
+      AddShadeStep(nRows, nCols, hillshade, sinesolaraltitude, compress,
+        outputgrid, average);
+
+      /* the average of the last compress time steps is complete, dated */
+      /* with the first of them */
+      if ((i + 1) % compress == 0) {
+        q = i / compress;
+        DMap.DumpDate[q].Year = year;
+        DMap.DumpDate[q].Month = month;
+        DMap.DumpDate[q].Day = day;
+        DMap.DumpDate[q].JDay = jday;
+        DMap.DumpDate[q].Hour = (int)((i + 1 - compress) * outstep);
+        for (ny = 0; ny < nRows; ny++) {
+          for (nx = 0; nx < nCols; nx++) {
+            outputgrid[ny][nx] = (unsigned char)average[ny][nx];
+            if (average[ny][nx] > 255.0) outputgrid[ny][nx] = 255;
+            average[ny][nx] = 0.0;
+            ((unsigned char *) Array)[ny * Map.NX + nx] = outputgrid[ny][nx];
+          }
+        }
+        Write2DMatrixNetCDF(DMap.FileName, Array, DMap.NumberType, Map.NY, Map.NX, &DMap, q);
+      }
     }
-    Write2DMatrixNetCDF(DMap.FileName, Array, DMap.NumberType, Map.NY, Map.NX, &DMap, i);
   }
+  FreeHorizons(&horizon);
 
   return EXIT_SUCCESS;
 }
@@ -652,81 +704,76 @@ void CalcSlopeAspect(int nRows, int nCols, float dx, float **elev, float ***slop
 }
 
 /*****************************************************************************
-  CalcHillShadeWithTerrainBlocking()
+  CalcHillShadeWithHorizons()
 *****************************************************************************/
-void CalcHillShadeWithTerrainBlocking(int nRows,int nCols,float dx,float max_elev,float **elev,
-				     float sal,float saz,float **slope,float **aspect,
-				     float ***hillshade)
+void CalcHillShadeWithHorizons(int nRows, int nCols, HORIZON *horizon, float **elev,
+  float sal, float saz, float **slope, float **aspect,
+  float ***hillshade)
 {
-  int ny,nx;
-  float lx,ly;
-  double max_angle,angle;
-  double theta;
-  float x,y,sx,sy,dz,dist;
-  float mx,my;
-  float start_elev;
-  int stop_flag;
-  float safe_distance;
-
-  if(sal>0){
+  int ny, nx;
+  float tansal;
+
+  if (sal > 0) {
+    /* a cell of the dem (elev > 0) is in the shade of the terrain if the */
+    /* horizon at the solar azimuth is above the sun, see horizon.c */
+    /* the threads each take a band of rows */
+    tansal = tan(sal);
+#ifdef HAVE_OPENMP
+#pragma omp parallel for private(nx) schedule(static)
+#endif
     for (ny = 0; ny < nRows; ny++) {
-      for (nx = 0; nx < nCols; nx++) {  
-        (*hillshade)[ny][nx] =   255*(cos(sal)*sin(slope[ny][nx])
-			       *cos(aspect[ny][nx]-saz)+sin(sal)
-			       *cos(slope[ny][nx]));
+      for (nx = 0; nx < nCols; nx++) {
+        (*hillshade)[ny][nx] = 255 * (cos(sal)*sin(slope[ny][nx])
+          *cos(aspect[ny][nx] - saz) + sin(sal)
+          *cos(slope[ny][nx]));
 
-	/* at this point hillshade can range from 0 to 255 */
+        /* at this point hillshade can range from 0 to 255 */
 
-	if ((*hillshade)[ny][nx]<0.0) (*hillshade)[ny][nx]=0.0;
+        if ((*hillshade)[ny][nx] < 0.0) (*hillshade)[ny][nx] = 0.0;
+        if (elev[ny][nx] > 0 && HorizonTan(horizon, ny, nx, saz) > tansal)
+          (*hillshade)[ny][nx] = 0.0;
       }
     }
-    ly=(float)(nRows*dx-dx);
-    lx=(float)(nCols*dx-dx);
-
-    /* utilize a series of checks to speed up program */
-    /* if one pixel in the given direction blocks, no need to check the rest in that direction */
-    /* if we are beyond the distance that the max elev can't block, then don't check the rest  */
-    /*   in that direction */
-    /* here x increases eastward and y increases southward */
-   for (ny = 0; ny < nRows; ny++) {
-      for (nx = 0; nx < nCols; nx++) {
-	    start_elev=elev[ny][nx];
-	    if (start_elev>0) {
-	      safe_distance=tan(sal)*(max_elev-start_elev);
-	      sx=(float)nx*dx+0.5*dx;
-	      sy=(float)ny*dx+0.5*dx;
-	      x=sx;
-	      y=sy;
-
-	      while(x>dx && x < lx && y>dx && y<ly) {
-	        x=x+((float)sin(saz))*dx;
-	        y=y-((float)cos(saz))*dx;
-	        dz=elev[(int)(y/dx)][(int)(x/dx)]-start_elev;
-	        dist=sqrt((x-sx)*(x-sx)+(y-sy)*(y-sy));
-	        if(dist > safe_distance){
-	          x=0;
-	          y=0;
-	        }
-	        if(dz>0) {
-	           angle=atan((double)(dz/dist));
-	           if(angle > sal) {
-	              x=0;
-	              y=0;
-	              (*hillshade)[ny][nx]=0.0;
-	           }	    
-	         }
-	       }
-	     }
-        }
-      }
   }
   else
-    {
-      for (ny = 0; ny < nRows; ny++) {
-	for (nx = 0; nx < nCols; nx++) {
-	  (*hillshade)[ny][nx]=0.0;
-	}
+  {
+    for (ny = 0; ny < nRows; ny++) {
+      for (nx = 0; nx < nCols; nx++) {
+        (*hillshade)[ny][nx] = 0.0;
       }
     }
+  }
 }
 /*****************************************************************************/
+
+/*****************************************************************************
+  AddShadeStep()
+
+  Adds the shade factor of a time step (0 to 255, the proper dhsvm format)
+  to the average of the compress time steps of an output map, in the same
+  way as average_shadow
+*****************************************************************************/
+void AddShadeStep(int nRows, int nCols, float **hillshade, float sinesolaraltitude,
+  int compress, unsigned char **outputgrid, float **average)
+{
+  int ny, nx;
+
+  /* at this point hillshade is between 0 and 255 */
+  /* which is the standard arc-info for the hillshade command */
+  /* we need to translate this to the proper dhsvm format */
+  /* and output it as an unsigned char */
+#ifdef HAVE_OPENMP
+#pragma omp parallel for private(nx) schedule(static)
+#endif
+  for (ny = 0; ny < nRows; ny++) {
+    for (nx = 0; nx < nCols; nx++) {
+      if (sinesolaraltitude > 0)
+        if (hillshade[ny][nx] / 255 / sinesolaraltitude>11.47)
+          outputgrid[ny][nx] = 255;
+        else
+          outputgrid[ny][nx] = (unsigned char)(hillshade[ny][nx] / sinesolaraltitude / 11.47);
+      else outputgrid[ny][nx] = 0;
+      average[ny][nx] += (float)outputgrid[ny][nx] / (float)compress;
+    }
+  }
+}
@@ -0,0 +1,668 @@
+/*
+ * SUMMARY:      make_stream_network.c - Make the stream network of a DEM
+ * USAGE:        make_stream_network nrows ncols cellsize dem_file flowd_file
+ *                 mask_file soildepth_file source_area output_dir
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Writes the stream inputs of DHSVM, stream.network.dat,
+ *               stream.map.dat and stream.class.dat, from the filled DEM,
+ *               the D8 flow directions, the mask and the soil depth, with
+ *               the same rules as CreateStreamNetwork_PythonV (without
+ *               ArcGIS), and convergence.txt of make_stream_connectivity
+ *               and stream.order.dat with the Strahler order.
+ * DESCRIP-END.
+ * FUNCTIONS:    main()
+ *               ReadGrid()
+ *               FlowOrder()
+ *               MakeSegments()
+ *               ChannelClass()
+ *               Azimuth()
+ *               WriteNetwork()
+ *               WriteMap()
+ *               WriteClasses()
+ *               WriteOrders()
+ * COMMENTS:     The maps are binary, like those of find_nearest_channel_bin:
+ *               the DEM and the soil depth float, the flow directions and
+ *               the mask unsigned char, row 0 the northern row.  The flow
+ *               directions are those of ARC-INFO, 1 to 128 (see
+ *               FILL_SINKS_DHSVM.c), the cells that drain out of the mask
+ *               or the grid are outlets.
+ *
+ *               All is done in a few passes over the cells: the cells in
+ *               flow order (upstream cells first) from the number of cells
+ *               draining to each cell, the flow accumulation in that
+ *               order, and the segments in the reverse order, downstream
+ *               cells first, so that each segment is numbered after the
+ *               segment it drains to and the outlets get the lowest IDs.
+ *
+ *               The streams are the cells that more than source_area (m2)
+ *               drains to, cut into segments at the confluences like the
+ *               links of StreamLink.  A segment runs from the center of
+ *               its top cell to the edge of the cell it drains to, half of
+ *               the last step is in that cell (at an outlet, in the
+ *               direction of flowd).  As in createstreamnetwork.py:
+ *
+ *               - the slope is the drop from the top cell to the cell the
+ *                 segment drains to over the length, at least 0.00001
+ *               - the channel class is from the slope and the mean of the
+ *                 contributing area at the top and the bottom of the
+ *                 segment (only the local area for a headwater segment),
+ *                 see ChannelClass(), with the classes of channelclass.py
+ *               - the cut height is 0.95 of the shallowest soil in the
+ *                 segment and the cut width is that of the class
+ *               - the azimuth of each part of a segment in a cell is the
+ *                 direction from its downstream to its upstream end
+ *               - the order written to the network file is the routing
+ *                 order that DHSVM needs (1 for the headwater segments,
+ *                 one more than the highest order flowing into the others),
+ *                 stream.order.dat has it with the Strahler order
+ *
+ *               The outlets drain to segment 0 and are saved, SAVE
+ *               "Outlet <ID>".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#undef PI
+#define PI          3.14159265358979323846
+#define MINSLOPE    0.00001
+#define MAXSTRING   1024
+#define NCLASSES    18
+
+typedef struct {
+  int Outlet;			/* index of the outlet segment, -1 if none */
+  int Top;			/* most upstream cell */
+  int Bottom;			/* most downstream cell */
+  int NCells;
+  int NUp;			/* number of segments that drain to it */
+  float Length;			/* m */
+  float Slope;
+  float Area;			/* mean contributing area (m2) */
+  float CutHeight;		/* m */
+  int Class;
+  int Order;			/* routing order */
+  int Strahler;
+} SEGMENT;
+
+/* channel classes of channelclass.py: ID, width, bank height, Manning's n,
+   the last is also the cut width of the stream map */
+static const float Classes[NCLASSES][3] = {
+  {0.5, 0.03, 0.06}, {1.0, 0.03, 0.09}, {2.0, 0.03, 0.12},
+  {3.0, 0.03, 0.15}, {4.0, 0.03, 0.18}, {4.5, 0.03, 0.21},
+  {0.5, 0.05, 0.10}, {1.0, 0.05, 0.15}, {2.0, 0.05, 0.20},
+  {3.0, 0.05, 0.25}, {4.0, 0.05, 0.30}, {4.5, 0.05, 0.35},
+  {0.5, 0.10, 0.20}, {1.0, 0.10, 0.30}, {2.0, 0.10, 0.40},
+  {3.0, 0.10, 0.50}, {4.0, 0.10, 0.60}, {4.5, 0.10, 0.70}
+};
+
+/* flow directions, recast from 1-128 to 0-7 clockwise from east */
+static const int xneighbor[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int yneighbor[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+static int NY;
+static int NX;
+static float DX;
+
+int GetNumber(char *numberStr);
+float GetFloat(char *numberStr);
+static void *ReadGrid(const char *FileName, size_t Size);
+static int *FlowOrder(unsigned char *Mask, int *Receiver);
+static SEGMENT *MakeSegments(float *Elev, float *SoilDepth, int *Receiver,
+			     unsigned char *FlowD, int *Order, int NOrder,
+			     float SourceArea, int **InSeg, int *NSeg);
+static int ChannelClass(float Slope, float Area);
+static float Azimuth(double FirstX, double FirstY, double LastX,
+		     double LastY);
+static void WriteNetwork(const char *FileName, SEGMENT *Seg, int NSeg);
+static void WriteMap(const char *FileName, SEGMENT *Seg, int NSeg,
+		     int *Receiver, unsigned char *FlowD, FILE *ConvFile);
+static void WriteClasses(const char *FileName);
+static void WriteOrders(const char *FileName, SEGMENT *Seg, int NSeg);
+
+int main(int argc, char **argv)
+{
+  float *Elev;
+  float *SoilDepth;
+  unsigned char *FlowD;
+  unsigned char *Mask;
+  int *Receiver;
+  int *Order;
+  int *InSeg;
+  SEGMENT *Seg;
+  float SourceArea;
+  char FileName[MAXSTRING + 1];
+  int NMask;
+  int NSeg;
+  int i;
+  int d;
+  int x;
+  int y;
+  FILE *ConvFile;
+
+  if (argc < 10) {
+    printf("usage: nrows ncols cellsize dem_file flowd_file mask_file soildepth_file source_area output_dir\n");
+    printf("where: dem_file is the binary float DEM, free of sinks (see FILL_SINKS_DHSVM.c)\n");
+    printf("       flowd_file is the binary flow direction file, 1 to 128 as in ARC-INFO\n");
+    printf("       mask_file and soildepth_file are the DHSVM binary mask and soil depth\n");
+    printf("       source_area is the area (m2) that drains to the head of a stream\n");
+    printf("       output_dir is where stream.network.dat, stream.map.dat,\n");
+    printf("       stream.class.dat, stream.order.dat and convergence.txt are written\n");
+    exit(-1);
+  }
+
+  NY = GetNumber(argv[1]);
+  NX = GetNumber(argv[2]);
+  DX = GetFloat(argv[3]);
+  SourceArea = GetFloat(argv[8]);
+  if (NY <= 0 || NX <= 0 || DX <= 0 || SourceArea < 0) {
+    printf("nrows, ncols and cellsize have to be positive\n");
+    exit(-1);
+  }
+
+  Elev = (float *) ReadGrid(argv[4], sizeof(float));
+  FlowD = (unsigned char *) ReadGrid(argv[5], sizeof(unsigned char));
+  Mask = (unsigned char *) ReadGrid(argv[6], sizeof(unsigned char));
+  SoilDepth = (float *) ReadGrid(argv[7], sizeof(float));
+
+  /* the cell each cell drains to, -1 out of the mask */
+  if (!(Receiver = (int *) calloc(NY * NX, sizeof(int)))) {
+    printf("failed to allocate memory \n");
+    exit(-1);
+  }
+  for (y = 0, i = 0; y < NY; y++) {
+    for (x = 0; x < NX; x++, i++) {
+      Receiver[i] = -1;
+      if (!Mask[i])
+	continue;
+      for (d = 0; d < 8 && FlowD[i] != (1 << d); d++)
+	;
+      if (d == 8) {
+	printf("pixel with undefined flow direction encountered at [%d][%d]:%d\n",
+	       y, x, FlowD[i]);
+	exit(-1);
+      }
+      FlowD[i] = d;
+      if (y + yneighbor[d] >= 0 && y + yneighbor[d] < NY &&
+	  x + xneighbor[d] >= 0 && x + xneighbor[d] < NX &&
+	  Mask[i + yneighbor[d] * NX + xneighbor[d]])
+	Receiver[i] = i + yneighbor[d] * NX + xneighbor[d];
+    }
+  }
+
+  Order = FlowOrder(Mask, Receiver);
+  for (i = 0, NMask = 0; i < NY * NX; i++)
+    if (Mask[i])
+      NMask++;
+
+  Seg = MakeSegments(Elev, SoilDepth, Receiver, FlowD, Order, NMask,
+		     SourceArea, &InSeg, &NSeg);
+  printf("%d stream segments\n", NSeg);
+  if (NSeg == 0) {
+    printf("no streams, use a smaller source_area\n");
+    exit(-1);
+  }
+
+  sprintf(FileName, "%.900s/stream.network.dat", argv[9]);
+  WriteNetwork(FileName, Seg, NSeg);
+  sprintf(FileName, "%.900s/stream.class.dat", argv[9]);
+  WriteClasses(FileName);
+  sprintf(FileName, "%.900s/stream.order.dat", argv[9]);
+  WriteOrders(FileName, Seg, NSeg);
+  sprintf(FileName, "%.900s/convergence.txt", argv[9]);
+  if (!(ConvFile = fopen(FileName, "w"))) {
+    printf("%s not opened \n", FileName);
+    exit(-1);
+  }
+  sprintf(FileName, "%.900s/stream.map.dat", argv[9]);
+  WriteMap(FileName, Seg, NSeg, Receiver, FlowD, ConvFile);
+  fclose(ConvFile);
+
+  free(Elev);
+  free(SoilDepth);
+  free(FlowD);
+  free(Mask);
+  free(Receiver);
+  free(Order);
+  free(InSeg);
+  free(Seg);
+  return EXIT_SUCCESS;
+}
+
+/*****************************************************************************
+  ReadGrid()
+*****************************************************************************/
+static void *ReadGrid(const char *FileName, size_t Size)
+{
+  FILE *InFile;
+  void *Grid;
+
+  if (!(Grid = calloc(NY * NX, Size))) {
+    printf("failed to allocate memory \n");
+    exit(-1);
+  }
+  if (!(InFile = fopen(FileName, "rb"))) {
+    printf("%s not opened \n", FileName);
+    exit(-1);
+  }
+  if (fread(Grid, Size, NY * NX, InFile) != (size_t) (NY * NX)) {
+    printf("%s length does not match nrow*ncol \n", FileName);
+    exit(-1);
+  }
+  fclose(InFile);
+  return Grid;
+}
+
+/*****************************************************************************
+  FlowOrder()
+
+  The cells of the mask, each after all the cells that drain to it (Kahn's
+  topological sort)
+*****************************************************************************/
+static int *FlowOrder(unsigned char *Mask, int *Receiver)
+{
+  int *Order;
+  int *NDonors;
+  int NOrder = 0;
+  int NMask = 0;
+  int Head;
+  int i;
+
+  if (!(Order = (int *) calloc(NY * NX, sizeof(int))) ||
+      !(NDonors = (int *) calloc(NY * NX, sizeof(int)))) {
+    printf("failed to allocate memory \n");
+    exit(-1);
+  }
+  for (i = 0; i < NY * NX; i++)
+    if (Receiver[i] >= 0)
+      NDonors[Receiver[i]]++;
+  for (i = 0; i < NY * NX; i++) {
+    if (Mask[i]) {
+      NMask++;
+      if (NDonors[i] == 0)
+	Order[NOrder++] = i;
+    }
+  }
+  for (Head = 0; Head < NOrder; Head++) {
+    i = Receiver[Order[Head]];
+    if (i >= 0 && --NDonors[i] == 0)
+      Order[NOrder++] = i;
+  }
+  if (NOrder < NMask) {
+    printf("the flow directions of %d cells go around in circles, fill the sinks first\n",
+	   NMask - NOrder);
+    exit(-1);
+  }
+  free(NDonors);
+  return Order;
+}
+
+/*****************************************************************************
+  MakeSegments()
+*****************************************************************************/
+static SEGMENT *MakeSegments(float *Elev, float *SoilDepth, int *Receiver,
+			     unsigned char *FlowD, int *Order, int NOrder,
+			     float SourceArea, int **InSeg, int *NSeg)
+{
+  SEGMENT *Seg;
+  int *Acc;
+  unsigned char *Donors;
+  float CellArea = DX * DX;
+  float Threshold;
+  float Step;
+  int *StrMax;
+  int *StrCount;
+  int MaxSeg = 1024;
+  int Local;
+  int i;
+  int k;
+  int n;
+  int r;
+  int s;
+
+  if (!(Acc = (int *) calloc(NY * NX, sizeof(int))) ||
+      !(Donors = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(*InSeg = (int *) calloc(NY * NX, sizeof(int))) ||
+      !(Seg = (SEGMENT *) calloc(MaxSeg, sizeof(SEGMENT)))) {
+    printf("failed to allocate memory \n");
+    exit(-1);
+  }
+
+  /* flow accumulation, upstream cells first, and the stream cells that
+     drain to each cell */
+  Threshold = SourceArea / CellArea;
+  for (k = 0; k < NOrder; k++) {
+    i = Order[k];
+    Acc[i]++;
+    if (Receiver[i] >= 0)
+      Acc[Receiver[i]] += Acc[i];
+  }
+  for (k = 0; k < NOrder; k++) {
+    i = Order[k];
+    (*InSeg)[i] = -1;
+    if (Acc[i] - 1 > Threshold && Receiver[i] >= 0 &&
+	Donors[Receiver[i]] < 255)
+      Donors[Receiver[i]]++;
+  }
+
+  /* segments, downstream cells first, a cell continues the segment of its
+     receiver unless that is a confluence */
+  *NSeg = 0;
+  for (k = NOrder - 1; k >= 0; k--) {
+    i = Order[k];
+    if (Acc[i] - 1 <= Threshold)
+      continue;
+    r = Receiver[i];
+    if (r >= 0 && Donors[r] == 1) {
+      s = (*InSeg)[r];
+    }
+    else {
+      if (*NSeg == MaxSeg) {
+	MaxSeg *= 2;
+	if (!(Seg = (SEGMENT *) realloc(Seg, MaxSeg * sizeof(SEGMENT)))) {
+	  printf("failed to allocate memory \n");
+	  exit(-1);
+	}
+      }
+      s = (*NSeg)++;
+      memset(&Seg[s], 0, sizeof(SEGMENT));
+      Seg[s].Outlet = (r >= 0) ? (*InSeg)[r] : -1;
+      Seg[s].Bottom = i;
+      Seg[s].CutHeight = SoilDepth[i];
+      Seg[s].Order = 1;
+      if (r >= 0)
+	Seg[(*InSeg)[r]].NUp++;
+    }
+    (*InSeg)[i] = s;
+    Seg[s].Top = i;
+    Seg[s].NCells++;
+    if (SoilDepth[i] < Seg[s].CutHeight)
+      Seg[s].CutHeight = SoilDepth[i];
+    Step = (xneighbor[FlowD[i]] != 0 && yneighbor[FlowD[i]] != 0) ?
+      DX * sqrt(2.0) : DX;
+    /* at an outlet only to the edge of the cell */
+    Seg[s].Length += (r >= 0) ? Step : 0.5 * Step;
+  }
+
+  if (!(StrMax = (int *) calloc(*NSeg, sizeof(int))) ||
+      !(StrCount = (int *) calloc(*NSeg, sizeof(int)))) {
+    printf("failed to allocate memory \n");
+    exit(-1);
+  }
+  for (n = *NSeg - 1; n >= 0; n--) {
+    /* the segments that drain to n have higher IDs, they are done */
+    r = Receiver[Seg[n].Bottom];
+    Seg[n].Slope = fabs(Elev[Seg[n].Top] - Elev[(r >= 0) ? r : Seg[n].Bottom]) /
+      Seg[n].Length;
+    if (Seg[n].Slope < MINSLOPE)
+      Seg[n].Slope = MINSLOPE;
+
+    /* the local area is Acc[Bottom] less that of the segments draining to
+       n, which took it off Area below */
+    Local = Acc[Seg[n].Bottom];
+    Seg[n].Area += Local;
+    if (Seg[n].NUp == 0)
+      Seg[n].Area = 0.5 * Seg[n].Area * CellArea;
+    else
+      Seg[n].Area = ((Acc[Seg[n].Top] - 1) + 0.5 * Seg[n].Area) * CellArea;
+    Seg[n].CutHeight *= 0.95;
+    Seg[n].Class = ChannelClass(Seg[n].Slope, Seg[n].Area);
+
+    Seg[n].Strahler = (StrCount[n] == 0) ? 1 :
+      ((StrCount[n] > 1) ? StrMax[n] + 1 : StrMax[n]);
+
+    s = Seg[n].Outlet;
+    if (s >= 0) {
+      Seg[s].Area -= Local;
+      if (Seg[s].Order <= Seg[n].Order)
+	Seg[s].Order = Seg[n].Order + 1;
+      if (Seg[n].Strahler > StrMax[s]) {
+	StrMax[s] = Seg[n].Strahler;
+	StrCount[s] = 1;
+      }
+      else if (Seg[n].Strahler == StrMax[s])
+	StrCount[s]++;
+    }
+  }
+
+  free(StrMax);
+  free(StrCount);
+  free(Acc);
+  free(Donors);
+  return Seg;
+}
+
+/*****************************************************************************
+  ChannelClass()
+
+  The classes of channelclass.py, from the slope (up to 0.002, 0.1 and
+  more) and the mean contributing area (up to 1, 10, 20, 30, 40 km2 and more)
+*****************************************************************************/
+static int ChannelClass(float Slope, float Area)
+{
+  const float Areas[5] = { 1e6, 1e7, 2e7, 3e7, 4e7 };
+  int a;
+  int s;
+
+  s = (Slope <= 0.002) ? 0 : ((Slope <= 0.1) ? 1 : 2);
+  for (a = 0; a < 5 && Area > Areas[a]; a++)
+    ;
+  return 6 * s + a + 1;
+}
+
+/*****************************************************************************
+  Azimuth()
+
+  Direction (degrees from north) from the last to the first point, as in
+  roadaspect.py, x east and y north
+*****************************************************************************/
+static float Azimuth(double FirstX, double FirstY, double LastX,
+		     double LastY)
+{
+  double Degrees;
+
+  Degrees = atan2(FirstX - LastX, FirstY - LastY) * 180.0 / PI;
+  return (float) fmod(floor(fmod(Degrees + 360.0, 360.0) + 0.5), 360.0);
+}
+
+/*****************************************************************************
+  WriteNetwork()
+*****************************************************************************/
+static void WriteNetwork(const char *FileName, SEGMENT *Seg, int NSeg)
+{
+  FILE *OutFile;
+  int n;
+
+  if (!(OutFile = fopen(FileName, "w"))) {
+    printf("%s not opened \n", FileName);
+    exit(-1);
+  }
+  for (n = 0; n < NSeg; n++) {
+    fprintf(OutFile, "%5d %3d %11.5f %17.5f %3d %7d", n + 1, Seg[n].Order,
+	    Seg[n].Slope, Seg[n].Length, Seg[n].Class,
+	    (Seg[n].Outlet >= 0) ? Seg[n].Outlet + 1 : 0);
+    if (Seg[n].Outlet < 0)
+      fprintf(OutFile, " SAVE \"Outlet %d\"", n + 1);
+    fprintf(OutFile, "\n");
+  }
+  fclose(OutFile);
+}
+
+/*****************************************************************************
+  WriteMap()
+
+  The stream map, segment by segment from the top cell down, and the
+  convergence file of make_stream_connectivity with the length weighted
+  cut height and azimuth of each segment
+*****************************************************************************/
+static void WriteMap(const char *FileName, SEGMENT *Seg, int NSeg,
+		     int *Receiver, unsigned char *FlowD, FILE *ConvFile)
+{
+  FILE *OutFile;
+  double InX, InY;		/* upstream end of the part in the cell */
+  double OutX, OutY;		/* downstream end */
+  double Half;
+  float Length;
+  float Aspect;
+  double SumAspect;
+  int *UpStart;
+  int *Up;
+  int Pred;
+  int i;
+  int n;
+  int r;
+  int u;
+
+  if (!(OutFile = fopen(FileName, "w"))) {
+    printf("%s not opened \n", FileName);
+    exit(-1);
+  }
+  fprintf(OutFile, "###### This file has been automatically generated #####\n");
+  fprintf(OutFile, "######             EDIT WITH CARE!!!              #####\n");
+  fprintf(OutFile, "# Created by make_stream_network\n");
+  fprintf(OutFile, "#                   Segment  Cut/Bank     Cut     Segment\n");
+  fprintf(OutFile, "#  Col  Row  ID      Length   Height     Width     Aspect   SINK?\n");
+  fprintf(OutFile, "#                     (m)      (m)        (m)       (d)    (optional)\n");
+  fprintf(OutFile, "# \n");
+
+  /* the segments that drain to each segment, by ID */
+  if (!(UpStart = (int *) calloc(NSeg + 1, sizeof(int))) ||
+      !(Up = (int *) calloc(NSeg, sizeof(int)))) {
+    printf("failed to allocate memory \n");
+    exit(-1);
+  }
+  for (n = 0; n < NSeg; n++)
+    UpStart[n + 1] = UpStart[n] + Seg[n].NUp;
+  for (n = 0; n < NSeg; n++)
+    Seg[n].NUp = 0;
+  for (n = 0; n < NSeg; n++)
+    if (Seg[n].Outlet >= 0)
+      Up[UpStart[Seg[n].Outlet] + Seg[Seg[n].Outlet].NUp++] = n + 1;
+
+  for (n = 0; n < NSeg; n++) {
+    SumAspect = 0.0;
+    Pred = -1;
+    for (i = Seg[n].Top;; Pred = i, i = r) {
+      r = Receiver[i];
+      /* the cell centers are at (col, -row) * DX */
+      InX = OutX = (i % NX) * DX;
+      InY = OutY = -(i / NX) * DX;
+      Length = 0.0;
+      if (Pred >= 0) {
+	Half = 0.5 * DX * sqrt((double) ((Pred % NX - i % NX) * (Pred % NX - i % NX) +
+					 (Pred / NX - i / NX) * (Pred / NX - i / NX)));
+	Length += Half;
+	InX += 0.5 * (Pred % NX - i % NX) * DX;
+	InY -= 0.5 * (Pred / NX - i / NX) * DX;
+      }
+      Half = (xneighbor[FlowD[i]] != 0 && yneighbor[FlowD[i]] != 0) ?
+	0.5 * DX * sqrt(2.0) : 0.5 * DX;
+      Length += Half;
+      OutX += 0.5 * xneighbor[FlowD[i]] * DX;
+      OutY -= 0.5 * yneighbor[FlowD[i]] * DX;
+      Aspect = Azimuth(InX, InY, OutX, OutY);
+      SumAspect += Aspect * Length;
+      fprintf(OutFile, "%5d %5d %5d %11.4f %10.4f %9.4f %10.4f\n", i % NX,
+	      i / NX, n + 1, Length, Seg[n].CutHeight,
+	      Classes[Seg[n].Class - 1][2], Aspect);
+      if (i == Seg[n].Bottom)
+	break;
+    }
+    /* the other half of the last step, in the cell it drains to */
+    if (r >= 0) {
+      Aspect = Azimuth(OutX, OutY, (r % NX) * DX, -(r / NX) * DX);
+      SumAspect += Aspect * Half;
+      fprintf(OutFile, "%5d %5d %5d %11.4f %10.4f %9.4f %10.4f\n", r % NX,
+	      r / NX, n + 1, Half, Seg[n].CutHeight,
+	      Classes[Seg[n].Class - 1][2], Aspect);
+    }
+
+    fprintf(ConvFile, "%d %d %.3f %.2f %.2f ", n + 1,
+	    (Seg[n].Outlet >= 0) ? Seg[n].Outlet + 1 : -1, Seg[n].Length,
+	    Seg[n].CutHeight, SumAspect / Seg[n].Length);
+    for (u = UpStart[n]; u < UpStart[n + 1]; u++)
+      fprintf(ConvFile, " %d ", Up[u]);
+    fprintf(ConvFile, "\n");
+  }
+
+  free(UpStart);
+  free(Up);
+  fclose(OutFile);
+}
+
+/*****************************************************************************
+  WriteClasses()
+*****************************************************************************/
+static void WriteClasses(const char *FileName)
+{
+  FILE *OutFile;
+  int n;
+
+  if (!(OutFile = fopen(FileName, "w"))) {
+    printf("%s not opened \n", FileName);
+    exit(-1);
+  }
+  fprintf(OutFile, "# ID, width, bank height, Manning's n\n");
+  for (n = 0; n < NCLASSES; n++)
+    fprintf(OutFile, "%d %.2f %.2f %.2f\n", n + 1, Classes[n][0],
+	    Classes[n][1], Classes[n][2]);
+  fclose(OutFile);
+}
+
+/*****************************************************************************
+  WriteOrders()
+*****************************************************************************/
+static void WriteOrders(const char *FileName, SEGMENT *Seg, int NSeg)
+{
+  FILE *OutFile;
+  int n;
+
+  if (!(OutFile = fopen(FileName, "w"))) {
+    printf("%s not opened \n", FileName);
+    exit(-1);
+  }
+  fprintf(OutFile, "# ID, Strahler order, routing order, cells, mean "
+	  "contributing area (m2)\n");
+  for (n = 0; n < NSeg; n++)
+    fprintf(OutFile, "%5d %3d %3d %6d %14.1f\n", n + 1, Seg[n].Strahler,
+	    Seg[n].Order, Seg[n].NCells, Seg[n].Area);
+  fclose(OutFile);
+}
+
+/*****************************************************************************
+  GetNumber()
+*****************************************************************************/
+int GetNumber(char *numberStr)
+{
+  char *endPtr;
+  int number = 0;
+
+  number = (int) strtol(numberStr, &endPtr, 0);
+  if (*endPtr != '\0') {
+    printf("problem extracting integer from %s \n", numberStr);
+    exit(-1);
+  }
+
+  return number;
+}
+
+/*****************************************************************************
+  GetFloat()
+*****************************************************************************/
+float GetFloat(char *numberStr)
+{
+  char *endPtr;
+  float number = 0;
+
+  number = (float) strtod(numberStr, &endPtr);
+  if (*endPtr != '\0') {
+    printf("problem extracting float from %s \n", numberStr);
+    exit(-1);
+  }
+
+  return number;
+}
@@ -0,0 +1,1629 @@
+/*
+ * SUMMARY:      make_synthetic_basin.c - Make the inputs of a synthetic basin
+ * USAGE:        make_synthetic_basin [options] <directory>
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Writes a complete, reproducible DHSVM input set for a basin
+ *               of any size: a fractal DEM, the basin mask, soil and
+ *               vegetation maps, the soil depth, the stream and road
+ *               networks, the shade and sky view maps, the met station
+ *               files, the initial model state and the configuration file.
+ *               The same options and seed always give the same basin, so
+ *               the runs can be used to compare the performance of
+ *               different versions (see dhsvm_bench.sh).
+ * DESCRIP-END.
+ * FUNCTIONS:    main()
+ *               Usage()
+ *               Random()
+ *               Fractal()
+ *               Quantile()
+ *               ClassMap()
+ *               FillSinks()
+ *               MakeStreams()
+ *               MakeRoads()
+ *               SolarPosition()
+ *               WriteShadeMaps()
+ *               WriteMetFiles()
+ *               WriteModelState()
+ *               WriteConfig()
+ * COMMENTS:     All maps are in the binary format (FORMAT = BIN), row 0 is
+ *               the northern row.  The paths in the configuration file are
+ *               relative to <directory>, DHSVM has to be run from there.
+ *
+ *               The DEM is made with the diamond-square algorithm, tilted
+ *               and with a valley so that the basin drains to the south.
+ *               The sinks are filled with a priority flood from the edge of
+ *               the mask, which also gives the D8 flow direction of each
+ *               cell.  Cells that drain more than the threshold area are
+ *               stream cells, cut into segments at the confluences and at
+ *               the maximum segment length.  The roads follow every N-th
+ *               row, with N set by the road density, and have a culvert
+ *               (sink) at the lower end of each segment.
+ *
+ *               The shade maps only account for the slope and aspect of
+ *               each cell, not for the shadows of the surrounding terrain,
+ *               and the sky view factor is (1 + cos(slope)) / 2.  Use
+ *               make_shade_maps_bin and skyviewBin on the DEM for the real
+ *               maps; the cost of the model does not depend on the values.
+ *
+ *               With -x only the configuration and met files are written,
+ *               for another set of options on an existing basin.
+ *
+ *               With -O the model state and maps of the snow water
+ *               equivalent, the moisture of the top soil layer and the
+ *               water table depth are dumped at the last step, for the
+ *               comparison of the output with compare_output (see
+ *               dhsvm_regress.sh).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#undef PI
+#define PI             3.14159265358979323846
+#define RADPDEG        (PI/180.0)
+#define SOLARCON       1360.
+#define STEFAN         5.6696e-8
+#define SHADEFACTOR    22.23191		/* shade factor of a flat cell */
+#define MAXSEGMENTS    65535		/* channel IDs are unsigned short */
+#define NSOILLAYERS    3
+#define NVEGTEMPLATES  5
+#define NSOILTEMPLATES 4
+#define NDUMPMAPS      3
+#define MAXSTRING      1024
+
+typedef struct {
+  int Year;
+  int Month;
+  int Day;
+  int Hour;
+} DATE;
+
+typedef struct {
+  int Outlet;			/* index of the outlet segment, -1 if none */
+  int NCells;
+  int Bottom;			/* most downstream cell */
+  float Length;			/* m */
+  float TopElev;		/* m */
+  float BottomElev;		/* m */
+  int Class;
+  int Order;
+} SEGMENT;
+
+/* basin parameters, set from the command line */
+static int NY = 316;
+static int NX = 316;
+static float DX = 90.0;
+static float MaskFraction = 0.8;
+static int NVeg = 4;
+static int NSoil = 3;
+static int NStations = 4;
+static float StreamArea = 0.5;		/* km2 drained by the head of a stream */
+static int StreamLength = 20;		/* maximum segment length (cells) */
+static float RoadDensity = 1.0;		/* km of road per km2 */
+static int RoadLength = 10;		/* maximum road segment length (cells) */
+static float Roughness = 0.8;		/* Hurst exponent of the DEM */
+static float Relief = 1000.;		/* m */
+static float BaseElev = 500.;		/* m */
+static unsigned long Seed = 1;
+static DATE Start = { 2003, 3, 1, 0 };
+static int NDays = 1;
+static int Dt = 3;			/* hours */
+static int Snow = 0;
+static int HeatFlux = 0;
+static int Shading = 0;
+static int StreamTemp = 0;
+static int NThreads = 1;
+static int ConfigOnly = 0;
+static int Dumps = 0;
+static char Name[MAXSTRING + 1] = "";
+
+/* location of the grid */
+static double Latitude = 47.0;
+static double Longitude = -121.0;
+static double North = 5200000.;
+static double West = 600000.;
+
+static unsigned long long RandomState;
+
+/* map variables (ID, layer) dumped with -O: Snow.Swq, Soil.Moist of the
+   top layer and Soil.TableDepth */
+static const int DumpMaps[NDUMPMAPS][2] = { {404, 1}, {501, 1}, {503, 1} };
+
+static void Usage(char *Program);
+static double Random(void);
+static float *Fractal(int ny, int nx, float H);
+static float Quantile(float *Values, unsigned char *Mask, int N, float P);
+static void ClassMap(float *Score, unsigned char *Mask, int NClasses,
+		     unsigned char *Class);
+static int *FillSinks(float *Elev, unsigned char *Mask, int **Order,
+		      int *NOrder);
+static int MakeStreams(float *Elev, unsigned char *Mask, float *Depth,
+		       int *Receiver, int *Order, int NOrder,
+		       const char *MapFile, const char *NetworkFile,
+		       const char *RvegFile, const char *StateFile);
+static int MakeRoads(float *Elev, unsigned char *Mask, const char *MapFile,
+		     const char *NetworkFile);
+static void SolarPosition(int DayOfYear, double Hour, double *CosZenith,
+			  double *Azimuth);
+static void WriteShadeMaps(float *Elev, const char *Path);
+static void WriteMetFiles(float *Elev, int *StationCell);
+static void WriteModelState(unsigned char *Mask, unsigned char *SoilType);
+static void WriteConfig(const char *FileName, int *StationCell,
+			float *Elev, int HaveRoads);
+
+static const char *SoilTemplate[NSOILTEMPLATES][17] = {
+  {"Loam", "0.01", "3.0", "0.5", "3.0e-5", "0.0", "0.1", "3",
+   "0.43 0.43 0.43", "0.25 0.25 0.25", "0.11 0.11 0.11", "0.25 0.25 0.25",
+   "0.10 0.10 0.10", "1485. 1485. 1485.", "0.001 0.001 0.001",
+   "7.114 6.923 7.0", "1.4e6 1.4e6 1.4e6"},
+  {"Sandy Loam", "0.03", "2.0", "0.5", "6.0e-5", "0.0", "0.15", "3",
+   "0.41 0.41 0.41", "0.32 0.32 0.32", "0.09 0.09 0.09", "0.18 0.18 0.18",
+   "0.06 0.06 0.06", "1560. 1560. 1560.", "0.003 0.003 0.003",
+   "7.6 7.6 7.6", "1.3e6 1.3e6 1.3e6"},
+  {"Silt Loam", "0.005", "3.0", "0.5", "1.5e-5", "0.0", "0.1", "3",
+   "0.49 0.49 0.49", "0.23 0.23 0.23", "0.21 0.21 0.21", "0.30 0.30 0.30",
+   "0.13 0.13 0.13", "1350. 1350. 1350.", "0.0005 0.0005 0.0005",
+   "6.5 6.5 6.5", "1.5e6 1.5e6 1.5e6"},
+  {"Clay Loam", "0.002", "4.0", "0.5", "8.0e-6", "0.0", "0.1", "3",
+   "0.46 0.46 0.46", "0.24 0.24 0.24", "0.26 0.26 0.26", "0.35 0.35 0.35",
+   "0.19 0.19 0.19", "1430. 1430. 1430.", "0.0002 0.0002 0.0002",
+   "6.0 6.0 6.0", "1.6e6 1.6e6 1.6e6"}
+};
+
+/* vegetation description, overstory, understory, height, maximum and
+   minimum resistance, moisture threshold, vapor pressure deficit, rpc,
+   root fractions and LAI (the same in each month) of the layers that are
+   present */
+static const char *VegTemplate[NVEGTEMPLATES][13] = {
+  {"Evergreen Needleleaf", "TRUE", "TRUE", "30.0 0.5", "5000. 600.",
+   "666.6 200.", "0.33 0.13", "4000. 4000.", "0.108 0.108",
+   "0.20 0.40 0.40", "0.40 0.60 0.00", "5.0", "1.0"},
+  {"Deciduous Broadleaf", "TRUE", "TRUE", "20.0 0.5", "5000. 600.",
+   "500. 200.", "0.33 0.13", "4000. 4000.", "0.108 0.108",
+   "0.20 0.40 0.40", "0.40 0.60 0.00", "3.0", "1.5"},
+  {"Shrub", "FALSE", "TRUE", "2.0", "600.", "200.", "0.13", "4000.",
+   "0.108", "", "0.40 0.40 0.20", "", "2.0"},
+  {"Grassland", "FALSE", "TRUE", "0.5", "600.", "120.", "0.13", "4000.",
+   "0.108", "", "0.50 0.50 0.00", "", "1.5"},
+  {"Bare", "FALSE", "FALSE", "", "", "", "", "", "", "", "", "", ""}
+};
+
+/*****************************************************************************
+  main()
+*****************************************************************************/
+int main(int argc, char **argv)
+{
+  char Dir[MAXSTRING + 1];
+  char FileName[2 * MAXSTRING + 16];
+  char Str[MAXSTRING + 16];
+  float *Elev;
+  float *Noise;
+  float *Depth;
+  unsigned char *Mask;
+  unsigned char *SoilType;
+  unsigned char *VegType;
+  int *Receiver;
+  int *Order;
+  int NOrder;
+  int StationCell[256];
+  int HaveRoads = 0;
+  int NSeg = 0;
+  int Cells = 0;
+  int i;
+  int x;
+  int y;
+  int c;
+  FILE *OutFile;
+
+  while ((c = getopt(argc, argv, "n:r:c:g:m:v:t:w:a:l:d:k:H:z:s:S:D:T:j:o:CFLROx"))
+	 != -1) {
+    switch (c) {
+    case 'n':
+      Cells = atoi(optarg);
+      break;
+    case 'r':
+      NY = atoi(optarg);
+      break;
+    case 'c':
+      NX = atoi(optarg);
+      break;
+    case 'g':
+      DX = atof(optarg);
+      break;
+    case 'm':
+      MaskFraction = atof(optarg);
+      break;
+    case 'v':
+      NVeg = atoi(optarg);
+      break;
+    case 't':
+      NSoil = atoi(optarg);
+      break;
+    case 'w':
+      NStations = atoi(optarg);
+      break;
+    case 'a':
+      StreamArea = atof(optarg);
+      break;
+    case 'l':
+      StreamLength = atoi(optarg);
+      break;
+    case 'd':
+      RoadDensity = atof(optarg);
+      break;
+    case 'k':
+      RoadLength = atoi(optarg);
+      break;
+    case 'H':
+      Roughness = atof(optarg);
+      break;
+    case 'z':
+      Relief = atof(optarg);
+      break;
+    case 's':
+      Seed = strtoul(optarg, NULL, 10);
+      break;
+    case 'S':
+      if (sscanf(optarg, "%d/%d/%d-%d", &Start.Month, &Start.Day,
+		 &Start.Year, &Start.Hour) != 4) {
+	fprintf(stderr, "%s: bad start date %s (mm/dd/yyyy-hh)\n", argv[0],
+		optarg);
+	exit(1);
+      }
+      break;
+    case 'D':
+      NDays = atoi(optarg);
+      break;
+    case 'T':
+      Dt = atoi(optarg);
+      break;
+    case 'j':
+      NThreads = atoi(optarg);
+      break;
+    case 'o':
+      strncpy(Name, optarg, MAXSTRING);
+      break;
+    case 'C':
+      Snow = 1;
+      break;
+    case 'F':
+      HeatFlux = 1;
+      break;
+    case 'L':
+      Shading = 1;
+      break;
+    case 'R':
+      StreamTemp = 1;
+      break;
+    case 'O':
+      Dumps = 1;
+      break;
+    case 'x':
+      ConfigOnly = 1;
+      break;
+    default:
+      Usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1)
+    Usage(argv[0]);
+
+  if (Cells > 0) {
+    NY = (int) (sqrt((double) Cells) + 0.5);
+    NX = (Cells + NY - 1) / NY;
+  }
+  if (NY < 8 || NX < 8 || DX <= 0.0 || MaskFraction <= 0.0 ||
+      MaskFraction > 1.0 || NVeg < 1 || NVeg > NVEGTEMPLATES || NSoil < 1 ||
+      NSoil > NSOILTEMPLATES || NStations < 1 || NStations > 256 ||
+      StreamArea <= 0.0 || StreamLength < 1 || RoadDensity < 0.0 ||
+      RoadLength < 2 || NDays < 1 || Dt < 1 || 24 % Dt != 0 ||
+      NThreads < 1) {
+    fprintf(stderr, "%s: parameter out of range\n", argv[0]);
+    Usage(argv[0]);
+  }
+  if (Name[0] == '\0')
+    sprintf(Name, "%s%s%s%s", Snow ? "snow" : "nosnow",
+	    HeatFlux ? ".heatflux" : "", Shading ? ".shading" : "",
+	    StreamTemp ? ".streamtemp" : "");
+
+  strncpy(Dir, argv[optind], MAXSTRING - 1);
+  Dir[MAXSTRING - 1] = '\0';
+  if (Dir[strlen(Dir) - 1] != '/')
+    strcat(Dir, "/");
+  mkdir(Dir, 0777);
+  sprintf(FileName, "%sinput", Dir);
+  mkdir(FileName, 0777);
+  sprintf(FileName, "%sstate", Dir);
+  mkdir(FileName, 0777);
+  sprintf(FileName, "%smet", Dir);
+  mkdir(FileName, 0777);
+  sprintf(FileName, "%soutput.%s", Dir, Name);
+  mkdir(FileName, 0777);
+  if (chdir(Dir) != 0) {
+    perror(Dir);
+    exit(1);
+  }
+
+  /* the DEM, the mask and the class maps are made in this order from one
+     random sequence, so that a seed always gives the same basin */
+  RandomState = Seed;
+  Elev = Fractal(NY, NX, Roughness);
+  for (y = 0; y < NY; y++)
+    for (x = 0; x < NX; x++) {
+      i = y * NX + x;
+      Elev[i] = BaseElev + Relief * (0.6 * Elev[i] +
+				     0.25 * (1.0 - (float) y / NY) +
+				     0.15 * fabs(2.0 * x / NX - 1.0));
+    }
+
+  if (!(Mask = (unsigned char *) calloc(NY * NX, sizeof(unsigned char)))) {
+    perror("Mask");
+    exit(1);
+  }
+  Noise = Fractal(NY, NX, Roughness);
+  for (y = 0; y < NY; y++)
+    for (x = 0; x < NX; x++) {
+      double ry = 2.0 * (y + 0.5) / NY - 1.0;
+      double rx = 2.0 * (x + 0.5) / NX - 1.0;
+      i = y * NX + x;
+      Noise[i] = (float) (rx * rx + ry * ry + 0.5 * Noise[i]);
+      Mask[i] = 1;
+    }
+  if (MaskFraction < 1.0) {
+    float Threshold = Quantile(Noise, NULL, NY * NX, MaskFraction);
+    for (i = 0; i < NY * NX; i++)
+      Mask[i] = (Noise[i] <= Threshold);
+  }
+  free(Noise);
+
+  Receiver = FillSinks(Elev, Mask, &Order, &NOrder);
+  printf("%d rows, %d columns, %d cells in the basin\n", NY, NX, NOrder);
+
+  if (!(SoilType = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(VegType = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(Depth = (float *) calloc(NY * NX, sizeof(float)))) {
+    perror("maps");
+    exit(1);
+  }
+  Noise = Fractal(NY, NX, Roughness);
+  ClassMap(Noise, Mask, NSoil, SoilType);
+  for (i = 0; i < NY * NX; i++)
+    Depth[i] = 1.0 + 2.0 * Noise[i];
+  free(Noise);
+  Noise = Fractal(NY, NX, Roughness);
+  for (i = 0; i < NY * NX; i++)
+    Noise[i] = 0.5 * Noise[i] + 0.5 * (Elev[i] - BaseElev) / Relief;
+  ClassMap(Noise, Mask, NVeg, VegType);
+  free(Noise);
+
+  /* met stations on a regular grid over the domain */
+  {
+    int NCol = (int) ceil(sqrt((double) NStations));
+    int NRow = (NStations + NCol - 1) / NCol;
+    for (i = 0; i < NStations; i++) {
+      y = (int) (((i / NCol) + 0.5) * NY / NRow);
+      x = (int) (((i % NCol) + 0.5) * NX / NCol);
+      StationCell[i] = y * NX + x;
+    }
+  }
+
+  if (!ConfigOnly) {
+    sprintf(FileName, "input/dem.bin");
+    if (!(OutFile = fopen(FileName, "wb")) ||
+	fwrite(Elev, sizeof(float), NY * NX, OutFile) != (size_t) NY * NX) {
+      perror(FileName);
+      exit(1);
+    }
+    fclose(OutFile);
+    sprintf(FileName, "input/mask.bin");
+    if (!(OutFile = fopen(FileName, "wb")) ||
+	fwrite(Mask, 1, NY * NX, OutFile) != (size_t) NY * NX) {
+      perror(FileName);
+      exit(1);
+    }
+    fclose(OutFile);
+    sprintf(FileName, "input/soiltype.bin");
+    if (!(OutFile = fopen(FileName, "wb")) ||
+	fwrite(SoilType, 1, NY * NX, OutFile) != (size_t) NY * NX) {
+      perror(FileName);
+      exit(1);
+    }
+    fclose(OutFile);
+    sprintf(FileName, "input/soildepth.bin");
+    if (!(OutFile = fopen(FileName, "wb")) ||
+	fwrite(Depth, sizeof(float), NY * NX, OutFile) != (size_t) NY * NX) {
+      perror(FileName);
+      exit(1);
+    }
+    fclose(OutFile);
+    sprintf(FileName, "input/vegtype.bin");
+    if (!(OutFile = fopen(FileName, "wb")) ||
+	fwrite(VegType, 1, NY * NX, OutFile) != (size_t) NY * NX) {
+      perror(FileName);
+      exit(1);
+    }
+    fclose(OutFile);
+
+    sprintf(Str, "state/Channel.State.%02d.%02d.%04d.%02d.00.00",
+	    Start.Month, Start.Day, Start.Year, Start.Hour);
+    NSeg = MakeStreams(Elev, Mask, Depth, Receiver, Order, NOrder,
+		       "input/stream.map.dat", "input/stream.network.dat",
+		       "input/riparian.veg.dat", Str);
+    HaveRoads = MakeRoads(Elev, Mask, "input/road.map.dat",
+			  "input/road.network.dat");
+    WriteShadeMaps(Elev, "input/shadow");
+    WriteModelState(Mask, SoilType);
+    printf("%d stream segments\n", NSeg);
+  }
+  else {
+    /* the roads are there if the road files are */
+    HaveRoads = (access("input/road.network.dat", R_OK) == 0);
+    if (Shading)
+      WriteShadeMaps(Elev, "input/shadow");
+  }
+
+  WriteMetFiles(Elev, StationCell);
+  sprintf(Str, "input.%s", Name);
+  WriteConfig(Str, StationCell, Elev, HaveRoads);
+  printf("Wrote %s%s\n", Dir, Str);
+
+  free(Elev);
+  free(Mask);
+  free(SoilType);
+  free(VegType);
+  free(Depth);
+  free(Receiver);
+  free(Order);
+  return 0;
+}
+
+/*****************************************************************************
+  Usage()
+*****************************************************************************/
+static void Usage(char *Program)
+{
+  fprintf(stderr, "usage: %s [options] <directory>\n", Program);
+  fprintf(stderr, "  -n cells    number of cells, square grid (or -r, -c)\n");
+  fprintf(stderr, "  -r rows     number of rows (316)\n");
+  fprintf(stderr, "  -c cols     number of columns (316)\n");
+  fprintf(stderr, "  -g m        grid spacing (90)\n");
+  fprintf(stderr, "  -m frac     fraction of the grid in the basin (0.8)\n");
+  fprintf(stderr, "  -v n        vegetation classes, 1-%d (4)\n",
+	  NVEGTEMPLATES);
+  fprintf(stderr, "  -t n        soil classes, 1-%d (3)\n", NSOILTEMPLATES);
+  fprintf(stderr, "  -w n        met stations (4)\n");
+  fprintf(stderr, "  -a km2      area drained by a stream head (0.5)\n");
+  fprintf(stderr, "  -l cells    maximum stream segment length (20)\n");
+  fprintf(stderr, "  -d km/km2   road density, 0 for no roads (1.0)\n");
+  fprintf(stderr, "  -k cells    maximum road segment length (10)\n");
+  fprintf(stderr, "  -H h        roughness (Hurst exponent) of the DEM (0.8)\n");
+  fprintf(stderr, "  -z m        relief (1000)\n");
+  fprintf(stderr, "  -s seed     random seed (1)\n");
+  fprintf(stderr, "  -S date     model start, mm/dd/yyyy-hh (03/01/2003-00)\n");
+  fprintf(stderr, "  -D days     length of the run (1)\n");
+  fprintf(stderr, "  -T hours    time step (3)\n");
+  fprintf(stderr, "  -j n        NUMBER OF THREADS (1)\n");
+  fprintf(stderr, "  -C          cold forcing and an initial snow pack\n");
+  fprintf(stderr, "  -F          SENSIBLE HEAT FLUX = TRUE\n");
+  fprintf(stderr, "  -L          SHADING = TRUE\n");
+  fprintf(stderr, "  -R          STREAM TEMPERATURE = TRUE\n");
+  fprintf(stderr, "  -O          dump the model state and maps at the last "
+	  "step\n");
+  fprintf(stderr, "  -o name     name of the run, the configuration is\n");
+  fprintf(stderr, "              input.<name> and the output goes to\n");
+  fprintf(stderr, "              output.<name>/ (from the options)\n");
+  fprintf(stderr, "  -x          only write the configuration and met files\n");
+  exit(1);
+}
+
+/*****************************************************************************
+  Random()
+
+  Uniform random number in [0, 1) (splitmix64), the same on all systems
+*****************************************************************************/
+static double Random(void)
+{
+  unsigned long long z;
+
+  z = (RandomState += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return (double) (z >> 11) / 9007199254740992.0;
+}
+
+/*****************************************************************************
+  Fractal()
+
+  Fractal surface of ny x nx values scaled to [0, 1], made with the
+  diamond-square algorithm on the smallest 2^k + 1 square that covers the
+  grid.  H is the Hurst exponent, the amplitude of the displacements halves
+  by a factor 2^H at each level.
+*****************************************************************************/
+static float *Fractal(int ny, int nx, float H)
+{
+  float *Square;
+  float *Surface;
+  float Min;
+  float Max;
+  double Scale = 1.0;
+  int Size = 1;
+  int N;
+  int Step;
+  int Half;
+  int x;
+  int y;
+
+  while (Size < ny - 1 || Size < nx - 1)
+    Size *= 2;
+  N = Size + 1;
+  if (!(Square = (float *) calloc((size_t) N * N, sizeof(float))) ||
+      !(Surface = (float *) calloc((size_t) ny * nx, sizeof(float)))) {
+    perror("Fractal");
+    exit(1);
+  }
+
+  Square[0] = Random();
+  Square[Size] = Random();
+  Square[(size_t) Size * N] = Random();
+  Square[(size_t) Size * N + Size] = Random();
+
+  for (Step = Size; Step > 1; Step /= 2) {
+    Half = Step / 2;
+    /* diamond step: centres of the squares */
+    for (y = Half; y < N; y += Step)
+      for (x = Half; x < N; x += Step)
+	Square[(size_t) y * N + x] =
+	  0.25 * (Square[(size_t) (y - Half) * N + x - Half] +
+		  Square[(size_t) (y - Half) * N + x + Half] +
+		  Square[(size_t) (y + Half) * N + x - Half] +
+		  Square[(size_t) (y + Half) * N + x + Half]) +
+	  Scale * (Random() - 0.5);
+    /* square step: edge midpoints */
+    for (y = 0; y < N; y += Half)
+      for (x = (y + Half) % Step; x < N; x += Step) {
+	double Sum = 0.0;
+	int Count = 0;
+	if (y >= Half) {
+	  Sum += Square[(size_t) (y - Half) * N + x];
+	  Count++;
+	}
+	if (y + Half < N) {
+	  Sum += Square[(size_t) (y + Half) * N + x];
+	  Count++;
+	}
+	if (x >= Half) {
+	  Sum += Square[(size_t) y * N + x - Half];
+	  Count++;
+	}
+	if (x + Half < N) {
+	  Sum += Square[(size_t) y * N + x + Half];
+	  Count++;
+	}
+	Square[(size_t) y * N + x] = Sum / Count + Scale * (Random() - 0.5);
+      }
+    Scale *= pow(2.0, -H);
+  }
+
+  Min = Max = Square[0];
+  for (y = 0; y < ny; y++)
+    for (x = 0; x < nx; x++) {
+      float Value = Square[(size_t) y * N + x];
+      Surface[y * nx + x] = Value;
+      if (Value < Min)
+	Min = Value;
+      if (Value > Max)
+	Max = Value;
+    }
+  for (y = 0; y < ny * nx; y++)
+    Surface[y] = (Max > Min) ? (Surface[y] - Min) / (Max - Min) : 0.0;
+
+  free(Square);
+  return Surface;
+}
+
+/*****************************************************************************
+  Quantile()
+
+  Value below which a fraction P of the N values lies, only the values with
+  Mask set if Mask is not NULL
+*****************************************************************************/
+static int CompareFloat(const void *a, const void *b)
+{
+  float A = *(const float *) a;
+  float B = *(const float *) b;
+
+  return (A > B) - (A < B);
+}
+
+static float Quantile(float *Values, unsigned char *Mask, int N, float P)
+{
+  float *Sorted;
+  float Value;
+  int Count = 0;
+  int i;
+
+  if (!(Sorted = (float *) calloc(N, sizeof(float)))) {
+    perror("Quantile");
+    exit(1);
+  }
+  for (i = 0; i < N; i++)
+    if (Mask == NULL || Mask[i])
+      Sorted[Count++] = Values[i];
+  qsort(Sorted, Count, sizeof(float), CompareFloat);
+  i = (int) (P * Count + 0.5) - 1;
+  if (i < 0)
+    i = 0;
+  if (i > Count - 1)
+    i = Count - 1;
+  Value = Sorted[i];
+  free(Sorted);
+  return Value;
+}
+
+/*****************************************************************************
+  ClassMap()
+
+  Classes 1..NClasses in equal shares of the basin, in the order of Score,
+  so that the classes form patches.  Cells outside the basin are class 1.
+*****************************************************************************/
+static void ClassMap(float *Score, unsigned char *Mask, int NClasses,
+		     unsigned char *Class)
+{
+  float Threshold[NVEGTEMPLATES];
+  int i;
+  int j;
+
+  for (j = 0; j < NClasses - 1; j++)
+    Threshold[j] = Quantile(Score, Mask, NY * NX, (j + 1.0) / NClasses);
+  for (i = 0; i < NY * NX; i++) {
+    Class[i] = 1;
+    if (Mask[i])
+      for (j = 0; j < NClasses - 1; j++)
+	if (Score[i] > Threshold[j])
+	  Class[i] = j + 2;
+  }
+}
+
+/*****************************************************************************
+  FillSinks()
+
+  Fills the sinks in the basin with a priority flood from the cells on the
+  edge of the mask, raising each cell at least EPSILON above the cell that
+  floods it.  Returns the receiver (D8 downstream cell) of each basin cell,
+  -1 for the edge cells that drain out of the basin, and the basin cells in
+  the order in which they were flooded (Order), in which each cell comes
+  after its receiver.
+*****************************************************************************/
+#define EPSILON 0.01
+
+typedef struct {
+  float Elev;
+  int Cell;
+} HEAPITEM;
+
+static void HeapPush(HEAPITEM *Heap, int *N, float Elev, int Cell)
+{
+  int i = (*N)++;
+
+  while (i > 0 && Heap[(i - 1) / 2].Elev > Elev) {
+    Heap[i] = Heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  Heap[i].Elev = Elev;
+  Heap[i].Cell = Cell;
+}
+
+static HEAPITEM HeapPop(HEAPITEM *Heap, int *N)
+{
+  HEAPITEM Top = Heap[0];
+  HEAPITEM Last = Heap[--(*N)];
+  int i = 0;
+  int Child;
+
+  while ((Child = 2 * i + 1) < *N) {
+    if (Child + 1 < *N && Heap[Child + 1].Elev < Heap[Child].Elev)
+      Child++;
+    if (Heap[Child].Elev >= Last.Elev)
+      break;
+    Heap[i] = Heap[Child];
+    i = Child;
+  }
+  Heap[i] = Last;
+  return Top;
+}
+
+static int *FillSinks(float *Elev, unsigned char *Mask, int **Order,
+		      int *NOrder)
+{
+  HEAPITEM *Heap;
+  unsigned char *Done;
+  int *Receiver;
+  int NHeap = 0;
+  int i;
+  int k;
+  int x;
+  int y;
+
+  if (!(Heap = (HEAPITEM *) calloc(NY * NX, sizeof(HEAPITEM))) ||
+      !(Done = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(Receiver = (int *) calloc(NY * NX, sizeof(int))) ||
+      !(*Order = (int *) calloc(NY * NX, sizeof(int)))) {
+    perror("FillSinks");
+    exit(1);
+  }
+
+  for (y = 0; y < NY; y++)
+    for (x = 0; x < NX; x++) {
+      int Edge = 0;
+      i = y * NX + x;
+      Receiver[i] = -1;
+      if (!Mask[i])
+	continue;
+      for (k = 0; k < 9 && !Edge; k++) {
+	int yy = y + k / 3 - 1;
+	int xx = x + k % 3 - 1;
+	Edge = (yy < 0 || yy >= NY || xx < 0 || xx >= NX ||
+		!Mask[yy * NX + xx]);
+      }
+      if (Edge) {
+	HeapPush(Heap, &NHeap, Elev[i], i);
+	Done[i] = 1;
+      }
+    }
+
+  *NOrder = 0;
+  while (NHeap > 0) {
+    HEAPITEM Item = HeapPop(Heap, &NHeap);
+    i = Item.Cell;
+    (*Order)[(*NOrder)++] = i;
+    y = i / NX;
+    x = i % NX;
+    for (k = 0; k < 9; k++) {
+      int yy = y + k / 3 - 1;
+      int xx = x + k % 3 - 1;
+      int j;
+      if (yy < 0 || yy >= NY || xx < 0 || xx >= NX)
+	continue;
+      j = yy * NX + xx;
+      if (!Mask[j] || Done[j])
+	continue;
+      if (Elev[j] < Elev[i] + EPSILON)
+	Elev[j] = Elev[i] + EPSILON;
+      Receiver[j] = i;
+      Done[j] = 1;
+      HeapPush(Heap, &NHeap, Elev[j], j);
+    }
+  }
+
+  free(Heap);
+  free(Done);
+  return Receiver;
+}
+
+/*****************************************************************************
+  MakeStreams()
+
+  Writes the stream map, network and riparian vegetation files and the
+  initial channel state, returns the number of segments
+*****************************************************************************/
+static int MakeStreams(float *Elev, unsigned char *Mask, float *Depth,
+		       int *Receiver, int *Order, int NOrder,
+		       const char *MapFile, const char *NetworkFile,
+		       const char *RvegFile, const char *StateFile)
+{
+  const float Width[3] = { 2.0, 5.0, 10.0 };
+  const float Bank[3] = { 0.3, 0.6, 1.0 };
+  const float Manning[3] = { 0.05, 0.04, 0.035 };
+  SEGMENT *Seg;
+  int *Acc;
+  int *InSeg;
+  unsigned char *Donors;
+  float *CellLength;
+  int Threshold;
+  int NSeg = 0;
+  int MaxSeg = 1024;
+  int i;
+  int k;
+  int n;
+  FILE *OutFile;
+
+  Threshold = (int) ceil(StreamArea * 1e6 / (DX * DX));
+  if (Threshold < 2)
+    Threshold = 2;
+
+  if (!(Acc = (int *) calloc(NY * NX, sizeof(int))) ||
+      !(InSeg = (int *) calloc(NY * NX, sizeof(int))) ||
+      !(Donors = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(CellLength = (float *) calloc(NY * NX, sizeof(float))) ||
+      !(Seg = (SEGMENT *) calloc(MaxSeg, sizeof(SEGMENT)))) {
+    perror("MakeStreams");
+    exit(1);
+  }
+
+  /* flow accumulation, upstream cells first */
+  for (k = NOrder - 1; k >= 0; k--) {
+    i = Order[k];
+    Acc[i]++;
+    if (Receiver[i] >= 0)
+      Acc[Receiver[i]] += Acc[i];
+  }
+  for (k = 0; k < NOrder; k++) {
+    i = Order[k];
+    InSeg[i] = -1;
+    if (Acc[i] >= Threshold && Receiver[i] >= 0 && Donors[Receiver[i]] < 255)
+      Donors[Receiver[i]]++;
+  }
+
+  /* segments, downstream cells first, so that each segment is created
+     after its outlet */
+  for (k = 0; k < NOrder; k++) {
+    int r;
+    int s;
+    i = Order[k];
+    if (Acc[i] < Threshold)
+      continue;
+    r = Receiver[i];
+    CellLength[i] = DX;
+    if (r >= 0 && r / NX != i / NX && r % NX != i % NX)
+      CellLength[i] = DX * sqrt(2.0);
+    if (r >= 0 && Donors[r] == 1 && InSeg[r] >= 0 &&
+	Seg[InSeg[r]].NCells < StreamLength) {
+      s = InSeg[r];
+    }
+    else {
+      if (NSeg == MAXSEGMENTS) {
+	fprintf(stderr, "MakeStreams: more than %d segments, use a larger "
+		"area (-a) or longer segments (-l)\n", MAXSEGMENTS);
+	exit(1);
+      }
+      if (NSeg == MaxSeg) {
+	MaxSeg *= 2;
+	if (!(Seg = (SEGMENT *) realloc(Seg, MaxSeg * sizeof(SEGMENT)))) {
+	  perror("MakeStreams");
+	  exit(1);
+	}
+      }
+      s = NSeg++;
+      Seg[s].Outlet = (r >= 0) ? InSeg[r] : -1;
+      Seg[s].NCells = 0;
+      Seg[s].Bottom = i;
+      Seg[s].Length = 0.0;
+      Seg[s].BottomElev = (r >= 0) ? Elev[r] : Elev[i] - 0.001 * DX;
+      Seg[s].Class = (Acc[i] < 10 * Threshold) ? 1 :
+	((Acc[i] < 100 * Threshold) ? 2 : 3);
+      Seg[s].Order = 1;
+    }
+    InSeg[i] = s;
+    Seg[s].NCells++;
+    Seg[s].Length += CellLength[i];
+    Seg[s].TopElev = Elev[i];
+  }
+
+  /* routing order, each outlet has a higher order than the segments that
+     flow into it */
+  for (n = NSeg - 1; n >= 0; n--)
+    if (Seg[n].Outlet >= 0 && Seg[Seg[n].Outlet].Order <= Seg[n].Order)
+      Seg[Seg[n].Outlet].Order = Seg[n].Order + 1;
+
+  if (!(OutFile = fopen(NetworkFile, "w"))) {
+    perror(NetworkFile);
+    exit(1);
+  }
+  fprintf(OutFile, "# synthetic stream network: ID, order, slope, length, "
+	  "class, outlet ID (0 for none), save flag and name\n");
+  for (n = 0; n < NSeg; n++) {
+    float Slope = (Seg[n].TopElev - Seg[n].BottomElev) / Seg[n].Length;
+    if (Slope < 0.0005)
+      Slope = 0.0005;
+    fprintf(OutFile, "%d %d %.5f %.2f %d %d", n + 1, Seg[n].Order, Slope,
+	    Seg[n].Length, Seg[n].Class,
+	    (Seg[n].Outlet >= 0) ? Seg[n].Outlet + 1 : 0);
+    if (Seg[n].Outlet < 0)
+      fprintf(OutFile, " SAVE \"Outlet %d\"", n + 1);
+    fprintf(OutFile, "\n");
+  }
+  fclose(OutFile);
+
+  if (!(OutFile = fopen("input/stream.class.dat", "w"))) {
+    perror("input/stream.class.dat");
+    exit(1);
+  }
+  fprintf(OutFile, "# ID, width, bank height, Manning's n\n");
+  for (n = 0; n < 3; n++)
+    fprintf(OutFile, "%d %.2f %.2f %.3f\n", n + 1, Width[n], Bank[n],
+	    Manning[n]);
+  fclose(OutFile);
+
+  if (!(OutFile = fopen(MapFile, "w"))) {
+    perror(MapFile);
+    exit(1);
+  }
+  fprintf(OutFile, "# column, row, segment ID, length, cut height, "
+	  "cut width, azimuth\n");
+  for (k = 0; k < NOrder; k++) {
+    double Azimuth = 180.;
+    float Cut;
+    int r;
+    i = Order[k];
+    if (InSeg[i] < 0)
+      continue;
+    r = Receiver[i];
+    if (r >= 0)
+      Azimuth = atan2((double) (r % NX - i % NX),
+		      (double) (i / NX - r / NX)) / RADPDEG;
+    if (Azimuth < 0.0)
+      Azimuth += 360.;
+    Cut = Bank[Seg[InSeg[i]].Class - 1];
+    if (Cut > 0.9 * Depth[i])
+      Cut = 0.9 * Depth[i];
+    fprintf(OutFile, "%d %d %d %.2f %.3f %.2f %.1f\n", i % NX, i / NX,
+	    InSeg[i] + 1, CellLength[i], Cut,
+	    Width[Seg[InSeg[i]].Class - 1], Azimuth);
+  }
+  fclose(OutFile);
+
+  if (!(OutFile = fopen(RvegFile, "w"))) {
+    perror(RvegFile);
+    exit(1);
+  }
+  fprintf(OutFile, "# ID, height, buffer width, 12 monthly extinction "
+	  "coefficients, distance, overhang, stream width\n");
+  for (n = 0; n < NSeg; n++)
+    fprintf(OutFile, "%d 20.0 10.0 0.4 0.4 0.4 0.5 0.6 0.7 0.7 0.7 0.6 "
+	    "0.5 0.4 0.4 1.0 1.0 %.2f\n", n + 1, Width[Seg[n].Class - 1]);
+  fclose(OutFile);
+
+  if (!(OutFile = fopen(StateFile, "w"))) {
+    perror(StateFile);
+    exit(1);
+  }
+  for (n = 0; n < NSeg; n++)
+    fprintf(OutFile, "%d %.3f\n", n + 1,
+	    0.1 * Width[Seg[n].Class - 1] * Seg[n].Length);
+  fclose(OutFile);
+
+  free(Acc);
+  free(InSeg);
+  free(Donors);
+  free(CellLength);
+  free(Seg);
+  return NSeg;
+}
+
+/*****************************************************************************
+  MakeRoads()
+
+  Roads along every N-th row of the basin, with N such that the road length
+  per basin area is RoadDensity.  Each stretch of road in the basin is cut
+  into segments of at most RoadLength cells that drain to a culvert (sink)
+  at their lower end.  Returns FALSE if there are no roads.
+*****************************************************************************/
+static int MakeRoads(float *Elev, unsigned char *Mask, const char *MapFile,
+		     const char *NetworkFile)
+{
+  FILE *MapOut;
+  FILE *NetOut;
+  int Spacing;
+  int NBasin = 0;
+  int NSeg = 0;
+  int i;
+  int x;
+  int y;
+
+  if (RoadDensity <= 0.0)
+    return 0;
+
+  for (i = 0; i < NY * NX; i++)
+    NBasin += Mask[i];
+  /* a road along every row would be 1000 / DX km per km2 */
+  Spacing = (int) (1000. / (DX * RoadDensity) + 0.5);
+  if (Spacing < 2)
+    Spacing = 2;
+
+  if (!(MapOut = fopen(MapFile, "w")) || !(NetOut = fopen(NetworkFile, "w"))) {
+    perror(MapFile);
+    exit(1);
+  }
+  fprintf(MapOut, "# column, row, segment ID, length, cut height, "
+	  "cut width, azimuth, sink\n");
+  fprintf(NetOut, "# synthetic road network: ID, order, slope, length, "
+	  "class\n");
+
+  for (y = Spacing / 2; y < NY; y += Spacing) {
+    x = 0;
+    while (x < NX) {
+      int First;
+      int Last;
+      int Sink;
+      float Slope;
+      while (x < NX && !Mask[y * NX + x])
+	x++;
+      First = x;
+      while (x < NX && Mask[y * NX + x] && x - First < RoadLength)
+	x++;
+      Last = x - 1;
+      if (Last - First < 1)
+	continue;
+      if (NSeg == MAXSEGMENTS) {
+	fprintf(stderr, "MakeRoads: more than %d segments, use a lower "
+		"density (-d) or longer segments (-k)\n", MAXSEGMENTS);
+	exit(1);
+      }
+      NSeg++;
+      Sink = (Elev[y * NX + First] < Elev[y * NX + Last]) ? First : Last;
+      Slope = fabs(Elev[y * NX + First] - Elev[y * NX + Last]) /
+	((Last - First) * DX);
+      if (Slope < 0.001)
+	Slope = 0.001;
+      fprintf(NetOut, "%d 1 %.5f %.2f 1\n", NSeg, Slope,
+	      (Last - First + 1) * DX);
+      for (i = First; i <= Last; i++)
+	fprintf(MapOut, "%d %d %d %.2f 0.300 5.00 %.1f%s\n", i, y, NSeg, DX,
+		(Sink == First) ? 270. : 90., (i == Sink) ? " SINK" : "");
+    }
+  }
+  fclose(MapOut);
+  fclose(NetOut);
+
+  if (!(NetOut = fopen("input/road.class.dat", "w"))) {
+    perror("input/road.class.dat");
+    exit(1);
+  }
+  fprintf(NetOut, "# ID, width, cut height, Manning's n, maximum road "
+	  "infiltration, crown type\n");
+  fprintf(NetOut, "1 5.00 0.30 0.015 0.000001 CROWNED\n");
+  fclose(NetOut);
+
+  printf("%d road segments over %.0f%% of the rows\n", NSeg, 100. / Spacing);
+  return NSeg > 0;
+}
+
+/*****************************************************************************
+  SolarPosition()
+
+  Cosine of the solar zenith angle and the solar azimuth (radians clockwise
+  from north) at the centre of the grid, Hour is the local solar time
+*****************************************************************************/
+static void SolarPosition(int DayOfYear, double Hour, double *CosZenith,
+			  double *Azimuth)
+{
+  double Declination;
+  double HourAngle;
+  double SinZenith;
+  double Lat = Latitude * RADPDEG;
+
+  Declination = 23.45 * RADPDEG * sin(2.0 * PI * (284 + DayOfYear) / 365.);
+  HourAngle = (Hour - 12.0) * 15.0 * RADPDEG;
+  *CosZenith = sin(Lat) * sin(Declination) +
+    cos(Lat) * cos(Declination) * cos(HourAngle);
+  SinZenith = sqrt(1.0 - *CosZenith * *CosZenith);
+  if (SinZenith < 1e-6) {
+    *Azimuth = PI;
+    return;
+  }
+  *Azimuth = atan2(-cos(Declination) * sin(HourAngle) / SinZenith,
+		   (sin(Declination) - sin(Lat) * *CosZenith) /
+		   (cos(Lat) * SinZenith));
+  if (*Azimuth < 0.0)
+    *Azimuth += 2.0 * PI;
+}
+
+/*****************************************************************************
+  WriteShadeMaps()
+
+  Shade maps for the months of the run, named <Path>.<mm>.bin, one map per
+  time step of the day for the middle of the month, and the sky view map
+  <Path>.skyview.bin
+*****************************************************************************/
+static int DayOfYear(int Month, int Day)
+{
+  const int First[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273,
+    304, 334
+  };
+  return First[Month - 1] + Day;
+}
+
+static void WriteShadeMaps(float *Elev, const char *Path)
+{
+  char FileName[MAXSTRING + 1];
+  unsigned char *Shade;
+  float *SkyView;
+  float *Slope;
+  float *Aspect;
+  int Month;
+  int NMonths;
+  int Step;
+  int i;
+  int m;
+  int x;
+  int y;
+  FILE *OutFile;
+
+  if (!(Shade = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(SkyView = (float *) calloc(NY * NX, sizeof(float))) ||
+      !(Slope = (float *) calloc(NY * NX, sizeof(float))) ||
+      !(Aspect = (float *) calloc(NY * NX, sizeof(float)))) {
+    perror("WriteShadeMaps");
+    exit(1);
+  }
+
+  for (y = 0; y < NY; y++)
+    for (x = 0; x < NX; x++) {
+      int xw = (x > 0) ? x - 1 : x;
+      int xe = (x < NX - 1) ? x + 1 : x;
+      int yn = (y > 0) ? y - 1 : y;
+      int ys = (y < NY - 1) ? y + 1 : y;
+      double dzdx = (Elev[y * NX + xe] - Elev[y * NX + xw]) / ((xe - xw) * DX);
+      double dzdy = (Elev[yn * NX + x] - Elev[ys * NX + x]) / ((ys - yn) * DX);
+      i = y * NX + x;
+      Slope[i] = atan(sqrt(dzdx * dzdx + dzdy * dzdy));
+      Aspect[i] = atan2(-dzdx, -dzdy);
+      SkyView[i] = 0.5 * (1.0 + cos(Slope[i]));
+    }
+
+  sprintf(FileName, "%s.skyview.bin", Path);
+  if (!(OutFile = fopen(FileName, "wb")) ||
+      fwrite(SkyView, sizeof(float), NY * NX, OutFile) != (size_t) NY * NX) {
+    perror(FileName);
+    exit(1);
+  }
+  fclose(OutFile);
+
+  /* months of the run */
+  NMonths = (NDays + Start.Day - 2) / 28 + 1;
+  if (NMonths > 12)
+    NMonths = 12;
+  for (m = 0; m < NMonths; m++) {
+    Month = (Start.Month - 1 + m) % 12 + 1;
+    sprintf(FileName, "%s.%02d.bin", Path, Month);
+    if (!(OutFile = fopen(FileName, "wb"))) {
+      perror(FileName);
+      exit(1);
+    }
+    for (Step = 0; Step < 24 / Dt; Step++) {
+      double CosZenith;
+      double Azimuth;
+      SolarPosition(DayOfYear(Month, 15), (Step + 0.5) * Dt, &CosZenith,
+		    &Azimuth);
+      for (i = 0; i < NY * NX; i++) {
+	double Factor = 0.0;
+	if (CosZenith > 0.01) {
+	  double CosIncidence = CosZenith * cos(Slope[i]) +
+	    sqrt(1.0 - CosZenith * CosZenith) * sin(Slope[i]) *
+	    cos(Azimuth - Aspect[i]);
+	  Factor = (CosIncidence > 0.0) ? CosIncidence / CosZenith : 0.0;
+	}
+	Factor *= SHADEFACTOR;
+	Shade[i] = (Factor > 255.) ? 255 : (unsigned char) (Factor + 0.5);
+      }
+      if (fwrite(Shade, 1, NY * NX, OutFile) != (size_t) NY * NX) {
+	perror(FileName);
+	exit(1);
+      }
+    }
+    fclose(OutFile);
+  }
+
+  free(Shade);
+  free(SkyView);
+  free(Slope);
+  free(Aspect);
+}
+
+/*****************************************************************************
+  WriteMetFiles()
+
+  One file per station with a diurnal cycle of temperature and radiation
+  and a storm of 12 hours every third day.  With -C the air is below
+  freezing and the precipitation falls as snow.
+*****************************************************************************/
+static void WriteMetFiles(float *Elev, int *StationCell)
+{
+  const int DaysPerMonth[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31,
+    30, 31
+  };
+  char FileName[MAXSTRING + 1];
+  DATE Now;
+  double TMean = Snow ? -4.0 : 12.0;
+  int NSteps = NDays * 24 / Dt;
+  int Step;
+  int n;
+  int j;
+  FILE *OutFile;
+
+  for (n = 0; n < NStations; n++) {
+    double Lapse = -0.0065 * (Elev[StationCell[n]] - BaseElev);
+    sprintf(FileName, "met/station.%02d.%s", n + 1,
+	    HeatFlux ? "heatflux" : (Snow ? "snow" : "nosnow"));
+    if (Snow && HeatFlux)
+      sprintf(FileName, "met/station.%02d.snow.heatflux", n + 1);
+    if (!(OutFile = fopen(FileName, "w"))) {
+      perror(FileName);
+      exit(1);
+    }
+    Now = Start;
+    /* one record before and after the run for the interpolation */
+    for (Step = 0; Step <= NSteps; Step++) {
+      double Hour = Now.Hour + 0.5 * Dt;
+      double CosZenith;
+      double Azimuth;
+      double Tair;
+      double Sin;
+      double Lin;
+      double Precip = 0.0;
+      int Day = DayOfYear(Now.Month, Now.Day);
+
+      SolarPosition(Day, Hour, &CosZenith, &Azimuth);
+      Tair = TMean + Lapse + 6.0 * sin(2.0 * PI * (Hour - 9.0) / 24.0);
+      Sin = (CosZenith > 0.0) ? 0.75 * SOLARCON * CosZenith : 0.0;
+      Lin = 0.8 * STEFAN * pow(Tair + 273.15, 4.0);
+      if ((Day % 3) == 0 && Hour < 12.0)
+	Precip = 0.002 * Dt;
+      fprintf(OutFile, "%02d/%02d/%04d-%02d %.2f %.2f %.1f %.1f %.1f",
+	      Now.Month, Now.Day, Now.Year, Now.Hour, Tair,
+	      2.0 + (n % 3), (Precip > 0.0) ? 95.0 : 60.0, Sin, Lin);
+      if (HeatFlux)
+	for (j = 0; j < NSOILLAYERS; j++)
+	  fprintf(OutFile, " %.2f", TMean + 4.0);
+      fprintf(OutFile, " %.5f\n", Precip);
+
+      Now.Hour += Dt;
+      if (Now.Hour >= 24) {
+	Now.Hour -= 24;
+	Now.Day++;
+	if (Now.Day > DaysPerMonth[Now.Month - 1] +
+	    (Now.Month == 2 && Now.Year % 4 == 0 &&
+	     (Now.Year % 100 != 0 || Now.Year % 400 == 0))) {
+	  Now.Day = 1;
+	  if (++Now.Month > 12) {
+	    Now.Month = 1;
+	    Now.Year++;
+	  }
+	}
+      }
+    }
+    fclose(OutFile);
+  }
+}
+
+/*****************************************************************************
+  WriteModelState()
+
+  Initial interception, snow and soil state files for the start of the run,
+  no interception, a 0.3 m snow pack on all cells with -C, and the soil at
+  field capacity
+*****************************************************************************/
+static void WriteMaps(FILE *OutFile, const char *FileName, float *Array,
+		      float Value, int NMaps)
+{
+  int i;
+
+  if (Value >= -1e6)
+    for (i = 0; i < NY * NX; i++)
+      Array[i] = Value;
+  for (i = 0; i < NMaps; i++)
+    if (fwrite(Array, sizeof(float), NY * NX, OutFile) != (size_t) NY * NX) {
+      perror(FileName);
+      exit(1);
+    }
+}
+
+static void WriteModelState(unsigned char *Mask, unsigned char *SoilType)
+{
+  char FileName[MAXSTRING + 1];
+  char Str[32];
+  float *Array;
+  float Fc;
+  float TSoil = Snow ? 0.0 : 8.0;
+  int i;
+  int j;
+  FILE *OutFile;
+
+  if (!(Array = (float *) calloc(NY * NX, sizeof(float)))) {
+    perror("WriteModelState");
+    exit(1);
+  }
+  sprintf(Str, "%02d.%02d.%04d.%02d.00.00", Start.Month, Start.Day,
+	  Start.Year, Start.Hour);
+
+  /* rain and snow interception of two layers and temporary storage */
+  sprintf(FileName, "state/Interception.State.%s.bin", Str);
+  if (!(OutFile = fopen(FileName, "wb"))) {
+    perror(FileName);
+    exit(1);
+  }
+  WriteMaps(OutFile, FileName, Array, 0.0, 5);
+  fclose(OutFile);
+
+  /* snow mask, days since the last snow, swq, liquid water and temperature
+     of the bottom and surface layers, cold content */
+  sprintf(FileName, "state/Snow.State.%s.bin", Str);
+  if (!(OutFile = fopen(FileName, "wb"))) {
+    perror(FileName);
+    exit(1);
+  }
+  WriteMaps(OutFile, FileName, Array, Snow ? 1.0 : 0.0, 1);
+  WriteMaps(OutFile, FileName, Array, Snow ? 5.0 : 0.0, 1);
+  WriteMaps(OutFile, FileName, Array, Snow ? 0.3 : 0.0, 1);
+  WriteMaps(OutFile, FileName, Array, 0.0, 1);
+  WriteMaps(OutFile, FileName, Array, Snow ? -2.0 : 0.0, 1);
+  WriteMaps(OutFile, FileName, Array, 0.0, 1);
+  WriteMaps(OutFile, FileName, Array, Snow ? -2.0 : 0.0, 1);
+  WriteMaps(OutFile, FileName, Array, 0.0, 1);
+  fclose(OutFile);
+
+  /* moisture of the root zones and the layer below them, surface and soil
+     temperatures, ground heat storage and infiltration excess */
+  sprintf(FileName, "state/Soil.State.%s.bin", Str);
+  if (!(OutFile = fopen(FileName, "wb"))) {
+    perror(FileName);
+    exit(1);
+  }
+  for (i = 0; i < NY * NX; i++) {
+    sscanf(SoilTemplate[(Mask[i] ? SoilType[i] : 1) - 1][11], "%f", &Fc);
+    Array[i] = Fc;
+  }
+  for (j = 0; j <= NSOILLAYERS; j++)
+    WriteMaps(OutFile, FileName, Array, -1e9, 1);
+  WriteMaps(OutFile, FileName, Array, TSoil, NSOILLAYERS + 1);
+  WriteMaps(OutFile, FileName, Array, 0.0, 2);
+  fclose(OutFile);
+
+  free(Array);
+}
+
+/*****************************************************************************
+  WriteConfig()
+*****************************************************************************/
+static void WriteMonthly(FILE *OutFile, const char *Key, int Type,
+			 const char *Value)
+{
+  int i;
+
+  fprintf(OutFile, "%s %d =", Key, Type);
+  for (i = 0; i < 12; i++)
+    fprintf(OutFile, " %s", Value);
+  fprintf(OutFile, "\n");
+}
+
+static void WriteConfig(const char *FileName, int *StationCell, float *Elev,
+			int HaveRoads)
+{
+  const char *Bool[2] = { "FALSE", "TRUE" };
+  const int DaysPerMonth[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31,
+    30, 31
+  };
+  DATE End = Start;
+  int i;
+  int j;
+  FILE *OutFile;
+
+  /* the last step starts Dt hours before the end of the last day */
+  End.Hour = Start.Hour + NDays * 24 - Dt;
+  while (End.Hour >= 24) {
+    End.Hour -= 24;
+    if (++End.Day > DaysPerMonth[End.Month - 1] +
+	(End.Month == 2 && End.Year % 4 == 0 &&
+	 (End.Year % 100 != 0 || End.Year % 400 == 0))) {
+      End.Day = 1;
+      if (++End.Month > 12) {
+	End.Month = 1;
+	End.Year++;
+      }
+    }
+  }
+
+  if (!(OutFile = fopen(FileName, "w"))) {
+    perror(FileName);
+    exit(1);
+  }
+
+  fprintf(OutFile, "# Synthetic basin, %d x %d cells of %g m, seed %lu\n",
+	  NY, NX, DX, Seed);
+  fprintf(OutFile, "# made with make_synthetic_basin, run DHSVM from the "
+	  "directory of this file\n\n");
+
+  fprintf(OutFile, "[OPTIONS]\n");
+  fprintf(OutFile, "Format                = BIN\n");
+  fprintf(OutFile, "Extent                = BASIN\n");
+  fprintf(OutFile, "Gradient              = TOPO\n");
+  fprintf(OutFile, "Flow Routing          = NETWORK\n");
+  fprintf(OutFile, "Sensible Heat Flux    = %s\n", Bool[HeatFlux]);
+  fprintf(OutFile, "Infiltration          = STATIC\n");
+  fprintf(OutFile, "Interpolation         = INVDIST\n");
+  fprintf(OutFile, "MM5                   = FALSE\n");
+  fprintf(OutFile, "QPF                   = FALSE\n");
+  fprintf(OutFile, "PRISM                 = FALSE\n");
+  fprintf(OutFile, "Gridded Met Data      = FALSE\n");
+  fprintf(OutFile, "Canopy radiation attenuation mode = FIXED\n");
+  fprintf(OutFile, "Shading               = %s\n", Bool[Shading]);
+  fprintf(OutFile, "Snotel                = FALSE\n");
+  fprintf(OutFile, "Outside               = FALSE\n");
+  fprintf(OutFile, "Rhoverride            = FALSE\n");
+  fprintf(OutFile, "Precipitation Source  = STATION\n");
+  fprintf(OutFile, "Wind Source           = STATION\n");
+  fprintf(OutFile, "Temperature lapse rate = CONSTANT\n");
+  fprintf(OutFile, "Precipitation lapse rate = CONSTANT\n");
+  fprintf(OutFile, "Shading Data Path     = input/shadow\n");
+  fprintf(OutFile, "Shading Data Extension = bin\n");
+  fprintf(OutFile, "Skyview Data Path     = input/shadow.skyview.bin\n");
+  fprintf(OutFile, "Stream Temperature    = %s\n", Bool[StreamTemp]);
+  fprintf(OutFile, "Riparian Shading      = FALSE\n");
+  fprintf(OutFile, "Improved Radiation Scheme = FALSE\n");
+  fprintf(OutFile, "Number of Threads     = %d\n", NThreads);
+  fprintf(OutFile, "Profile               = TRUE\n\n");
+
+  fprintf(OutFile, "[AREA]\n");
+  fprintf(OutFile, "Coordinate System     = UTM\n");
+  fprintf(OutFile, "Extreme North         = %.1f\n", North);
+  fprintf(OutFile, "Extreme West          = %.1f\n", West);
+  fprintf(OutFile, "Center Latitude       = %.4f\n", Latitude);
+  fprintf(OutFile, "Center Longitude      = %.4f\n", Longitude);
+  fprintf(OutFile, "Time Zone Meridian    = %.4f\n", Longitude);
+  fprintf(OutFile, "Number of Rows        = %d\n", NY);
+  fprintf(OutFile, "Number of Columns     = %d\n", NX);
+  fprintf(OutFile, "Grid spacing          = %g\n\n", DX);
+
+  fprintf(OutFile, "[TIME]\n");
+  fprintf(OutFile, "Time Step             = %d\n", Dt);
+  fprintf(OutFile, "Model Start           = %02d/%02d/%04d-%02d\n",
+	  Start.Month, Start.Day, Start.Year, Start.Hour);
+  fprintf(OutFile, "Model End             = %02d/%02d/%04d-%02d\n\n",
+	  End.Month, End.Day, End.Year, End.Hour);
+
+  fprintf(OutFile, "[CONSTANTS]\n");
+  fprintf(OutFile, "Ground Roughness      = 0.02\n");
+  fprintf(OutFile, "Snow Roughness        = 0.01\n");
+  fprintf(OutFile, "Rain Threshold        = 2.0\n");
+  fprintf(OutFile, "Snow Threshold        = 0.0\n");
+  fprintf(OutFile, "Snow Water Capacity   = 0.03\n");
+  fprintf(OutFile, "Reference Height      = 40.0\n");
+  fprintf(OutFile, "Rain LAI Multiplier   = 0.0001\n");
+  fprintf(OutFile, "Snow LAI Multiplier   = 0.0005\n");
+  fprintf(OutFile, "Min Intercepted Snow  = 0.005\n");
+  fprintf(OutFile, "Outside Basin Value   = 0\n");
+  fprintf(OutFile, "Temperature Lapse Rate = -0.0065\n");
+  fprintf(OutFile, "Precipitation Lapse Rate = 0.0001\n");
+  fprintf(OutFile, "Precipitation Multiplier = 0.0\n");
+  fprintf(OutFile, "Albedo Accumulation Lambda = 0.92\n");
+  fprintf(OutFile, "Albedo Melting Lambda = 0.70\n");
+  fprintf(OutFile, "Albedo Accumulation Min = 0.75\n");
+  fprintf(OutFile, "Albedo Melting Min    = 0.45\n\n");
+
+  fprintf(OutFile, "[TERRAIN]\n");
+  fprintf(OutFile, "DEM File              = input/dem.bin\n");
+  fprintf(OutFile, "Basin Mask File       = input/mask.bin\n\n");
+
+  fprintf(OutFile, "[ROUTING]\n");
+  fprintf(OutFile, "Stream Network File   = input/stream.network.dat\n");
+  fprintf(OutFile, "Stream Map File       = input/stream.map.dat\n");
+  fprintf(OutFile, "Stream Class File     = input/stream.class.dat\n");
+  fprintf(OutFile, "Riparian Veg File     = input/riparian.veg.dat\n");
+  if (HaveRoads) {
+    fprintf(OutFile, "Road Network File     = input/road.network.dat\n");
+    fprintf(OutFile, "Road Map File         = input/road.map.dat\n");
+    fprintf(OutFile, "Road Class File       = input/road.class.dat\n");
+  }
+  else {
+    fprintf(OutFile, "Road Network File     = none\n");
+    fprintf(OutFile, "Road Map File         = none\n");
+    fprintf(OutFile, "Road Class File       = none\n");
+  }
+  fprintf(OutFile, "\n");
+
+  fprintf(OutFile, "[METEOROLOGY]\n");
+  fprintf(OutFile, "Number of Stations    = %d\n", NStations);
+  for (i = 0; i < NStations; i++) {
+    int c = StationCell[i];
+    fprintf(OutFile, "Station Name %d        = Station%02d\n", i + 1, i + 1);
+    fprintf(OutFile, "North Coordinate %d    = %.1f\n", i + 1,
+	    North - (c / NX + 0.5) * DX);
+    fprintf(OutFile, "East Coordinate %d     = %.1f\n", i + 1,
+	    West + (c % NX + 0.5) * DX);
+    fprintf(OutFile, "Elevation %d           = %.1f\n", i + 1, Elev[c]);
+    if (Snow && HeatFlux)
+      fprintf(OutFile, "Station File %d        = met/station.%02d.snow."
+	      "heatflux\n", i + 1, i + 1);
+    else
+      fprintf(OutFile, "Station File %d        = met/station.%02d.%s\n",
+	      i + 1, i + 1, HeatFlux ? "heatflux" : (Snow ? "snow" : "nosnow"));
+  }
+  fprintf(OutFile, "\n");
+
+  fprintf(OutFile, "[SOILS]\n");
+  fprintf(OutFile, "Soil Map File         = input/soiltype.bin\n");
+  fprintf(OutFile, "Soil Depth File       = input/soildepth.bin\n");
+  fprintf(OutFile, "Number of Soil Types  = %d\n", NSoil);
+  {
+    const char *Key[17] = {
+      "Soil Description", "Lateral Conductivity", "Exponential Decrease",
+      "Depth Threshold", "Maximum Infiltration", "Capillary Drive",
+      "Surface Albedo", "Number of Soil Layers", "Porosity",
+      "Pore Size Distribution", "Bubbling Pressure", "Field Capacity",
+      "Wilting Point", "Bulk Density", "Vertical Conductivity",
+      "Thermal Conductivity", "Thermal Capacity"
+    };
+    for (i = 0; i < NSoil; i++) {
+      for (j = 0; j < 17; j++)
+	fprintf(OutFile, "%s %d = %s\n", Key[j], i + 1, SoilTemplate[i][j]);
+      fprintf(OutFile, "\n");
+    }
+  }
+
+  fprintf(OutFile, "[VEGETATION]\n");
+  fprintf(OutFile, "Vegetation Map File   = input/vegtype.bin\n");
+  fprintf(OutFile, "Number of Vegetation Types = %d\n", NVeg);
+  for (i = 0; i < NVeg; i++) {
+    /* the last class is bare soil if all the templates are used */
+    const char **V = VegTemplate[(i == NVeg - 1 && NVeg == NVEGTEMPLATES) ?
+				 NVEGTEMPLATES - 1 : i];
+    int Over = (strcmp(V[1], "TRUE") == 0);
+    int Under = (strcmp(V[2], "TRUE") == 0);
+    fprintf(OutFile, "Vegetation Description %d = %s\n", i + 1, V[0]);
+    fprintf(OutFile, "Overstory Present %d = %s\n", i + 1, V[1]);
+    fprintf(OutFile, "Understory Present %d = %s\n", i + 1, V[2]);
+    if (Over) {
+      fprintf(OutFile, "Fractional Coverage %d = 0.8\n", i + 1);
+      fprintf(OutFile, "Trunk Space %d = 0.4\n", i + 1);
+      fprintf(OutFile, "Aerodynamic Attenuation %d = 2.5\n", i + 1);
+      fprintf(OutFile, "Radiation Attenuation %d = 0.2\n", i + 1);
+      fprintf(OutFile, "Max Snow Int Capacity %d = 0.04\n", i + 1);
+      fprintf(OutFile, "Mass Release Drip Ratio %d = 0.4\n", i + 1);
+      fprintf(OutFile, "Snow Interception Eff %d = 0.6\n", i + 1);
+      fprintf(OutFile, "Overstory Root Fraction %d = %s\n", i + 1, V[9]);
+      WriteMonthly(OutFile, "Overstory Monthly LAI", i + 1, V[11]);
+      WriteMonthly(OutFile, "Overstory Monthly Alb", i + 1, "0.14");
+    }
+    if (Under) {
+      fprintf(OutFile, "Understory Root Fraction %d = %s\n", i + 1, V[10]);
+      WriteMonthly(OutFile, "Understory Monthly LAI", i + 1, V[12]);
+      WriteMonthly(OutFile, "Understory Monthly Alb", i + 1, "0.2");
+    }
+    fprintf(OutFile, "Impervious Fraction %d = 0.0\n", i + 1);
+    if (Over || Under) {
+      fprintf(OutFile, "Height %d = %s\n", i + 1, V[3]);
+      fprintf(OutFile, "Maximum Resistance %d = %s\n", i + 1, V[4]);
+      fprintf(OutFile, "Minimum Resistance %d = %s\n", i + 1, V[5]);
+      fprintf(OutFile, "Moisture Threshold %d = %s\n", i + 1, V[6]);
+      fprintf(OutFile, "Vapor Pressure Deficit %d = %s\n", i + 1, V[7]);
+      fprintf(OutFile, "Rpc %d = %s\n", i + 1, V[8]);
+    }
+    fprintf(OutFile, "Number of Root Zones %d = %d\n", i + 1, NSOILLAYERS);
+    fprintf(OutFile, "Root Zone Depths %d = 0.10 0.25 0.40\n\n", i + 1);
+  }
+
+  fprintf(OutFile, "[OUTPUT]\n");
+  fprintf(OutFile, "Output Directory      = output.%s/\n", Name);
+  fprintf(OutFile, "Initial State Directory = state/\n");
+  fprintf(OutFile, "Number of Output Pixels = 0\n");
+  if (Dumps) {
+    fprintf(OutFile, "Number of Model States = 1\n");
+    fprintf(OutFile, "State Date 1 = %02d/%02d/%04d-%02d\n", End.Month,
+	    End.Day, End.Year, End.Hour);
+    fprintf(OutFile, "Number of Map Variables = %d\n", NDUMPMAPS);
+    for (i = 0; i < NDUMPMAPS; i++) {
+      fprintf(OutFile, "Map Variable %d = %d\n", i + 1, DumpMaps[i][0]);
+      fprintf(OutFile, "Map Layer %d = %d\n", i + 1, DumpMaps[i][1]);
+      fprintf(OutFile, "Number Of Maps %d = 1\n", i + 1);
+      fprintf(OutFile, "Map Date 1 %d = %02d/%02d/%04d-%02d\n", i + 1,
+	      End.Month, End.Day, End.Year, End.Hour);
+    }
+  }
+  else {
+    fprintf(OutFile, "Number of Model States = 0\n");
+    fprintf(OutFile, "Number of Map Variables = 0\n");
+  }
+  fprintf(OutFile, "Number of Image Variables = 0\n");
+  fprintf(OutFile, "Number of Graphics    = 0\n");
+
+  fclose(OutFile);
+}
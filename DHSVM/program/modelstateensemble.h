@@ -0,0 +1,146 @@
+/*
+ * SUMMARY:      modelstateensemble.h - header file for the initial state
+ *               ensembles of MakeModelStateBin and MakeModelStateNetCDF
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The uniform model state of the info file, the planes of the
+ *               state files, and the perturbations of an ensemble of
+ *               initial states, see ModelStateEnsemble.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef MODELSTATEENSEMBLE_H
+#define MODELSTATEENSEMBLE_H
+
+#include <stdio.h>
+#include "settings.h"
+#include "Calendar.h"
+
+#define MAXLAYERS 10
+#define MAXPERTURB 50
+
+/* state file of a plane */
+#define INTERCEPTION_STATE 0
+#define SNOW_STATE 1
+#define SOIL_STATE 2
+#define NSTATEFILES 3
+
+/* output of the ensemble members */
+#define ENSEMBLE_MAPS 1		/* Interception, Snow and Soil state files */
+#define ENSEMBLE_CHECKPOINT 2	/* one Model.State.*.chk file per member */
+
+/* The layout of the model state checkpoint of DHSVM (STATE FORMAT =
+   CHECKPOINT), settings.h of the model, repeated here because the programs
+   have their own settings.h */
+#ifndef CHECKPOINT_MAGIC
+#define CHECKPOINT_MAGIC       "DHSVMCHK"
+#define CHECKPOINT_VERSION     3
+#define CHECKPOINT_SEED        2166136261u
+#define CHKCHANNEL_STORAGE     1
+enum CHKHEADER {
+  chk_version = 0, chk_ny, chk_nx, chk_nactive, chk_veglayers, chk_soillayers,
+  chk_nchannel, chk_nhydro, chk_year, chk_month, chk_day, chk_hour, chk_min,
+  chk_sec, chk_baseyear, chk_basemonth, chk_baseday, chk_basehour,
+  chk_basemin, chk_basesec, chk_basesum, chk_geomhash, chk_nethash,
+  chk_channelvars, chk_datasum, chk_headersum, NCHKHEADER
+};
+#endif
+
+/* uniform model state read from the info file */
+typedef struct {
+  char Path[MAXSTRING + 1];	/* path for the output files */
+  DATE Day;			/* date of the model state */
+  int NY;			/* number of rows */
+  int NX;			/* number of columns */
+  int NVegLayers;		/* maximum number of vegetation layers */
+  float RainInt[MAXLAYERS];	/* rain interception (m) */
+  float SnowInt[MAXLAYERS];	/* snow interception (m) */
+  float TempIntStorage;		/* temporary interception storage (m) */
+  unsigned char SnowMask;	/* snow cover mask */
+  unsigned short LastSnow;	/* days since last snowfall */
+  float Swq;			/* snow water equivalent (m) */
+  float LwBottom;		/* liquid water of the bottom layer (m) */
+  float TBottom;		/* temperature of the bottom layer (C) */
+  float LwTop;			/* liquid water of the surface layer (m) */
+  float TTop;			/* temperature of the surface layer (C) */
+  float Cold;			/* cold content of the snow pack */
+  int NSoilLayers;		/* maximum number of root zone layers */
+  float Moist[MAXLAYERS];	/* soil moisture, NSoilLayers + 1 layers */
+  float SoilTSurf;		/* soil surface temperature (C) */
+  float Temp[MAXLAYERS];	/* soil temperature (C) */
+  float GroundHeat;		/* ground heat storage */
+  float Runoff;			/* runoff */
+} STATEINFO;
+
+/* one map of the state files, in the order DHSVM reads them */
+typedef struct {
+  int File;			/* INTERCEPTION_STATE, SNOW_STATE or
+				   SOIL_STATE */
+  int ID;			/* map ID of the variable */
+  int Layer;			/* layer, -1 if the variable has none */
+  char Var[BUFSIZE + 1];	/* variable name, without the layer */
+  char Name[BUFSIZE + 1];	/* variable name, with the layer */
+  char LongName[BUFSIZE + 1];	/* long name */
+  char Format[BUFSIZE + 1];	/* output format (netcdf) */
+  char Units[BUFSIZE + 1];	/* units */
+  char FileLabel[BUFSIZE + 1];	/* label of the map (netcdf) */
+  int NonNegative;		/* TRUE if the value cannot be negative */
+  float Value;			/* value of the info file */
+} STATEPLANE;
+
+/* perturbation of a variable over the members */
+typedef struct {
+  char Var[BUFSIZE + 1];	/* variable name, without the layer */
+  int Layer;			/* layer, -1 for all layers */
+  int Relative;			/* TRUE: Value * (1 + Sd * z), FALSE:
+				   Value + Sd * z */
+  int PerCell;			/* TRUE: z differs between the cells, FALSE:
+				   one z for the whole member */
+  float Sd;			/* standard deviation */
+  float Min;			/* lower bound of the perturbed value */
+  float Max;			/* upper bound of the perturbed value */
+  int HasBounds;		/* TRUE if Min and Max were given */
+} PERTURBATION;
+
+/* ensemble of initial states */
+typedef struct {
+  int NMembers;			/* number of members */
+  unsigned int Seed;		/* seed of the perturbations */
+  int Format;			/* ENSEMBLE_MAPS or ENSEMBLE_CHECKPOINT */
+  unsigned char OutsideBasin;	/* mask value outside the basin */
+  char MaskFile[MAXSTRING + 1];	/* basin mask (checkpoint) */
+  char NetworkFile[MAXSTRING + 1];	/* stream network (checkpoint) */
+  int NHydro;			/* unit hydrograph values without a network */
+  float Storage;		/* storage of each channel segment */
+  int NPerturb;			/* number of perturbations */
+  PERTURBATION Perturb[MAXPERTURB];
+} ENSEMBLE;
+
+/* cells and channel segments of a checkpoint */
+typedef struct {
+  int NActive;			/* number of cells in the basin */
+  int *Cells;			/* y * NX + x of the cells, row by row */
+  unsigned int GeomHash;	/* chk_geomhash of the basin */
+  int NChannel;			/* number of channel segments */
+  unsigned int *ChannelID;	/* segment ids in routing order */
+  unsigned int NetHash;		/* chk_nethash of the network */
+} STATEBASIN;
+
+void ReadStateInfo(FILE *InfoFile, STATEINFO *Info);
+void DefaultEnsemble(ENSEMBLE *Ens);
+void ReadEnsemble(char *FileName, int NPlanes, STATEPLANE *Planes,
+		  ENSEMBLE *Ens);
+int MakeStatePlanes(STATEINFO *Info, STATEPLANE **Planes);
+void ReadStateBasin(STATEINFO *Info, ENSEMBLE *Ens, STATEBASIN *Basin);
+void MemberPath(char *Path, ENSEMBLE *Ens, int Member, char *MemberDir);
+void FillMemberState(ENSEMBLE *Ens, int NPlanes, STATEPLANE *Planes,
+		     int Member, int NCells, int *Cells, float *State);
+void StoreMemberCheckpoint(char *Path, STATEINFO *Info, ENSEMBLE *Ens,
+			   STATEBASIN *Basin, int NPlanes, float *State);
+
+#endif
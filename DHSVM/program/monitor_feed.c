@@ -0,0 +1,199 @@
+/*
+ * SUMMARY:      monitor_feed.c - print the live monitor feed of a run
+ * USAGE:        monitor_feed [-f] [-m] <feed>
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Maps the ring buffer that DHSVM writes with OPTIONS MONITOR
+ *               FEED read-only and prints the basin totals and the segment
+ *               flows of the newest step.  With -f it follows the run and
+ *               prints every step as it is published, with -m it prints
+ *               the coarse maps as well.
+ * DESCRIP-END.
+ * COMMENTS:     The layout of the ring buffer is described in
+ *               sourcecode/monitorfeed.h and sourcecode/MonitorFeed.c.  A
+ *               slot is copied and taken only if its sequence number is the
+ *               same before and after the copy, so the model is never
+ *               waited for.  If the viewer falls more than a ring behind
+ *               with -f, the steps it missed are reported and skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* must match sourcecode/settings.h and sourcecode/monitorfeed.h */
+#define MONITOR_MAGIC   "DHSVMMON"
+#define MONITOR_VERSION 1
+#define MONITOR_NAMELEN 16
+#define MONITOR_DATELEN 24
+#define MONITOR_TOTALS  13
+#define MONITOR_MAPS    4
+
+typedef struct {
+  char Magic[sizeof(MONITOR_MAGIC) - 1];
+  int Version;
+  int NSlots;
+  int NTotals;
+  int NSegments;
+  int NMaps;
+  int MapNX;
+  int MapNY;
+  int Stride;
+  int Dt;
+  float Fill;
+  unsigned long long SlotBytes;
+  unsigned long long SlotStart;
+  unsigned long long Latest;
+  char TotalNames[MONITOR_TOTALS][MONITOR_NAMELEN];
+  char MapNames[MONITOR_MAPS][MONITOR_NAMELEN];
+} MONITORHEADER;
+
+typedef struct {
+  unsigned long long Seq;
+  int Step;
+  int Full;
+  char Date[MONITOR_DATELEN];
+} MONITORSLOT;
+
+/* copy of sequence number k into Copy, 0 if it has been overwritten */
+static int ReadSlot(const char *Feed, const MONITORHEADER *Header,
+		    unsigned long long k, MONITORSLOT *Copy)
+{
+  const MONITORSLOT *Slot;
+  unsigned long long Seq;
+
+  Slot = (const MONITORSLOT *) (Feed + Header->SlotStart +
+				((k - 1) % Header->NSlots) *
+				Header->SlotBytes);
+  Seq = __atomic_load_n(&(Slot->Seq), __ATOMIC_ACQUIRE);
+  if (Seq != 2 * k)
+    return 0;
+  memcpy(Copy, Slot, Header->SlotBytes);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&(Slot->Seq), __ATOMIC_RELAXED) == Seq;
+}
+
+static void PrintSlot(const MONITORHEADER *Header, const int *Ids,
+		      const MONITORSLOT *Slot, int Maps)
+{
+  const float *Values = (const float *) (Slot + 1);
+  int NBlocks = Header->MapNX * Header->MapNY;
+  int i;
+  int m;
+  int x;
+  int y;
+
+  printf("%s step %d%s\n", Slot->Date, Slot->Step,
+	 Slot->Full ? "" : " (fluxes only)");
+  for (i = 0; i < Header->NTotals; i++)
+    printf("  %-15s %12.5g\n", Header->TotalNames[i], Values[i]);
+  Values += Header->NTotals;
+  for (i = 0; i < Header->NSegments; i++)
+    printf("  segment %-7d %12.5g\n", Ids[i], Values[i]);
+  Values += Header->NSegments;
+  if (!Maps)
+    return;
+  for (m = 0; m < Header->NMaps; m++) {
+    printf("  %s, blocks of %d x %d cells\n", Header->MapNames[m],
+	   Header->Stride, Header->Stride);
+    for (y = 0; y < Header->MapNY; y++) {
+      printf("   ");
+      for (x = 0; x < Header->MapNX; x++) {
+	if (Values[m * NBlocks + y * Header->MapNX + x] == Header->Fill)
+	  printf(" %9s", "-");
+	else
+	  printf(" %9.3g", Values[m * NBlocks + y * Header->MapNX + x]);
+      }
+      printf("\n");
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  MONITORHEADER *Header;
+  MONITORSLOT *Copy;
+  struct stat Info;
+  unsigned long long Latest;
+  unsigned long long k;
+  char *Feed;
+  int Follow = 0;
+  int Maps = 0;
+  int Fd;
+  int i;
+
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp(argv[i], "-f") == 0)
+      Follow = 1;
+    else if (strcmp(argv[i], "-m") == 0)
+      Maps = 1;
+    else
+      break;
+  }
+  if (i != argc - 1) {
+    printf("usage is: monitor_feed [-f] [-m] <feed>\n");
+    exit(-1);
+  }
+
+  if ((Fd = open(argv[i], O_RDONLY)) < 0 || fstat(Fd, &Info) != 0 ||
+      Info.st_size < (off_t) sizeof(MONITORHEADER)) {
+    printf("unable to open %s\n", argv[i]);
+    exit(-1);
+  }
+  Feed = (char *) mmap(NULL, Info.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+  close(Fd);
+  if (Feed == (char *) MAP_FAILED) {
+    printf("unable to map %s\n", argv[i]);
+    exit(-1);
+  }
+  Header = (MONITORHEADER *) Feed;
+  if (strncmp(Header->Magic, MONITOR_MAGIC, strlen(MONITOR_MAGIC)) != 0 ||
+      Header->Version != MONITOR_VERSION ||
+      Header->SlotStart + Header->NSlots * Header->SlotBytes >
+      (unsigned long long) Info.st_size) {
+    printf("%s is not a monitor feed of this version\n", argv[i]);
+    exit(-1);
+  }
+  if (!(Copy = (MONITORSLOT *) malloc(Header->SlotBytes))) {
+    printf("out of memory\n");
+    exit(-1);
+  }
+
+  /* k is the sequence number of the next slot to print */
+  k = 0;
+  for (;;) {
+    Latest = __atomic_load_n(&(Header->Latest), __ATOMIC_ACQUIRE);
+    if (!Follow && Latest == 0) {
+      printf("no step published yet\n");
+      break;
+    }
+    if (Latest == 0 || (k > 0 && k > Latest)) {
+      usleep(100000);
+      continue;
+    }
+    if (!Follow || k == 0)
+      k = Latest;
+    else if (Latest - k >= (unsigned long long) Header->NSlots) {
+      printf("skipped %llu steps, overwritten\n",
+	     Latest - Header->NSlots + 1 - k);
+      k = Latest - Header->NSlots + 1;
+    }
+    if (ReadSlot(Feed, Header, k, Copy))
+      PrintSlot(Header, (int *) (Feed + sizeof(MONITORHEADER)), Copy, Maps);
+    else
+      printf("skipped 1 step, overwritten\n");
+    fflush(stdout);
+    k++;
+    if (!Follow)
+      break;
+  }
+  munmap(Feed, Info.st_size);
+  free(Copy);
+  return EXIT_SUCCESS;
+}
@@ -12,10 +12,16 @@
  *                 float to asc
  * DESCRIP-END.
  * FUNCTIONS:    
- * COMMENTS:     
+ * COMMENTS:     The matrix is converted in blocks of rows, so that the
+ *               memory use does not depend on the number of rows.  Binary
+ *               input and output can be byte swapped (-swapin, -swapout),
+ *               e.g. for big endian ArcGIS grids, and a binary input can be
+ *               memory mapped instead of read (-mmap).  The conversion and
+ *               byte swap loops have no calls or branches in them, so that
+ *               the compiler can vectorize them.
  */
 
-#define _POSIX_SOURCE 1
+#define _POSIX_C_SOURCE 200112L
 
 #ifndef lint
 static char vcid[] = "$Id: convert.c,v 1.4 1998/06/25 04:25:10 nijssen Exp $";
@@ -27,10 +33,14 @@ static char vcid[] = "$Id: convert.c,v 1.4 1998/06/25 04:25:10 nijssen Exp $";
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#ifdef _POSIX_MAPPED_FILES
+#include <sys/mman.h>
+#endif
 #include "myconvert.h"
 
 const char *usage = 
-"myconvert source_format target_format source_file target_file\n        number_of_rows number_of_column\n";
+"myconvert source_format target_format source_file target_file\n        number_of_rows number_of_column [-swapin] [-swapout] [-mmap]\n        [-rows rows_per_block]\n";
 
 int sizeArray[N_FORMATS];     /* Array with sizeof() */
 
@@ -44,6 +54,11 @@ int main(int argc, char **argv)
   int nRows;                    /* Number of rows */
   int nCols;                    /* Number of columns */
   int writeFormat;              /* Format specifier for output file */
+  int blockRows;                /* Number of rows converted at a time */
+  int swapInput;                /* Byte swap the input */
+  int swapOutput;               /* Byte swap the output */
+  int mapInput;                 /* Memory map the input */
+  int i;
 
   InitSize();
 
@@ -60,6 +75,37 @@ int main(int argc, char **argv)
 
   nRows = GetNumber(argv[5]);
   nCols = GetNumber(argv[6]);
+  if (nRows <= 0 || nCols <= 0)
+    ReportError(argv[5], "Invalid matrix size:");
+  if (readFormat == ascii && writeFormat == ascii)
+    ReportError("ascii to ascii", "Unsupported conversion:");
+
+  blockRows = 0;
+  swapInput = FALSE;
+  swapOutput = FALSE;
+  mapInput = FALSE;
+  for (i = 7; i < argc; i++) {
+    if (strcmp(argv[i], "-swapin") == 0 && readFormat != ascii)
+      swapInput = TRUE;
+    else if (strcmp(argv[i], "-swapout") == 0 && writeFormat != ascii)
+      swapOutput = TRUE;
+    else if (strcmp(argv[i], "-mmap") == 0 && readFormat != ascii)
+      mapInput = TRUE;
+    else if (strcmp(argv[i], "-rows") == 0 && i + 1 < argc)
+      blockRows = GetNumber(argv[++i]);
+    else
+      ReportError(argv[i], "Invalid option:");
+  }
+  /* about BLOCKSIZE bytes of the larger of the two formats per block */
+  if (blockRows <= 0) {
+    blockRows = BLOCKSIZE / 
+      (nCols * MAX(sizeArray[readFormat == ascii ? writeFormat : readFormat],
+                   sizeArray[writeFormat == ascii ? readFormat : writeFormat]));
+    if (blockRows < 1)
+      blockRows = 1;
+  }
+  if (blockRows > nRows)
+    blockRows = nRows;
   
   if (readFormat == ascii)
     OpenFile(&inFile, inFilename, "r", FALSE);
@@ -71,7 +117,8 @@ int main(int argc, char **argv)
   else
     OpenFile(&outFile, outFilename, "wb", TRUE);
   
-  Convert(nRows, nCols, readFormat, inFile, writeFormat, outFile); 
+  Convert(nRows, nCols, blockRows, readFormat, inFile, mapInput, swapInput,
+          writeFormat, outFile, swapOutput); 
   
   fclose(inFile);
   fclose(outFile);
@@ -81,317 +128,239 @@ int main(int argc, char **argv)
 
 /*****************************************************************************
   Cast()
+
+  Convert nElements values from readFormat into writeFormat.  Each value
+  goes through long, unsigned long or double, as before, but in one loop
+  per pair of formats, which the compiler can vectorize.
 *****************************************************************************/
-void Cast(int nCols, int readFormat, void *readArray, 
+#define CAST_LOOP(TIN, TPROMO, TOUT)                                    \
+  for (i = 0; i < nElements; i++)                                       \
+    ((TOUT *)writeArray)[i] = (TOUT) (TPROMO) ((const TIN *)readArray)[i]
+
+#define CAST_FROM(TIN, TPROMO)                                          \
+  switch (writeFormat) {                                                \
+  case character:  CAST_LOOP(TIN, TPROMO, char); break;                 \
+  case ucharacter: CAST_LOOP(TIN, TPROMO, unsigned char); break;        \
+  case shortint:   CAST_LOOP(TIN, TPROMO, short); break;                \
+  case ushortint:  CAST_LOOP(TIN, TPROMO, unsigned short); break;       \
+  case integer:    CAST_LOOP(TIN, TPROMO, int); break;                  \
+  case uinteger:   CAST_LOOP(TIN, TPROMO, unsigned int); break;         \
+  case longint:    CAST_LOOP(TIN, TPROMO, long); break;                 \
+  case ulongint:   CAST_LOOP(TIN, TPROMO, unsigned long); break;        \
+  case floatp:     CAST_LOOP(TIN, TPROMO, float); break;                \
+  case doublep:    CAST_LOOP(TIN, TPROMO, double); break;               \
+  default:                                                              \
+    ReportError("Unrecognized format specifier:", "Fatal error");       \
+    break;                                                              \
+  }
+
+void Cast(long nElements, int readFormat, const void *readArray, 
           int writeFormat, void *writeArray)
 {
-  long *longValue = NULL;
-  unsigned long *ulongValue = NULL;
-  double *doubleValue = NULL;
-  int promotion = -1;
-  int i;
+  long i;
   
   if (readFormat == writeFormat)
     return;
   
   switch (readFormat) {
-  case character:
-  case shortint:
-  case integer:
-  case longint:
-    promotion = longint;
-    longValue = calloc(nCols, sizeArray[promotion]);
-    if (longValue == NULL)
-      ReportError("", "Failure to allocate memory");
-    break;
-  case ucharacter:
-  case ushortint:
-  case uinteger:
-  case ulongint:
-    promotion = ulongint;
-    ulongValue = calloc(nCols, sizeArray[promotion]);
-    if (ulongValue == NULL)
-      ReportError("", "Failure to allocate memory");
-    break;
-  case floatp:
-  case doublep:
-    promotion = doublep;
-    doubleValue = calloc(nCols, sizeArray[promotion]);
-    if (doubleValue == NULL)
-      ReportError("", "Failure to allocate memory");
-    break;
-  default:
-    ReportError("Unrecognized format specifier:", "Fatal error");
-    break;
-  }
-
-  switch (readFormat) {
-  case character:
-    for (i = 0; i < nCols; i++)
-      longValue[i] = (long) ((char *)readArray)[i];
-    break;  
-  case shortint:
-    for (i = 0; i < nCols; i++)
-      longValue[i] = (long) ((short *)readArray)[i];
-    break;  
-  case integer:
-    for (i = 0; i < nCols; i++)
-      longValue[i] = (long) ((int *)readArray)[i];
-    break;  
-  case longint:
-    for (i = 0; i < nCols; i++)
-      longValue[i] = (long) ((long *)readArray)[i];
-    break;  
-  case ucharacter:
-    for (i = 0; i < nCols; i++)
-      ulongValue[i] = (unsigned long) ((unsigned char *)readArray)[i];
-    break;  
-  case ushortint:
-    for (i = 0; i < nCols; i++)
-      ulongValue[i] = (unsigned long) ((unsigned short *)readArray)[i];
-    break;  
-  case uinteger:
-    for (i = 0; i < nCols; i++)
-      ulongValue[i] = (unsigned long) ((unsigned int *)readArray)[i];
-    break;  
-  case ulongint:
-    for (i = 0; i < nCols; i++)
-      ulongValue[i] = (unsigned long) ((unsigned long *)readArray)[i];
-    break;  
-  case floatp:
-    for (i = 0; i < nCols; i++)
-      doubleValue[i] = (double) ((float *)readArray)[i];
-    break;  
-  case doublep:
-    for (i = 0; i < nCols; i++)
-      doubleValue[i] = (double) ((double *)readArray)[i];
-    break;  
+  case character:  CAST_FROM(char, long); break;
+  case shortint:   CAST_FROM(short, long); break;
+  case integer:    CAST_FROM(int, long); break;
+  case longint:    CAST_FROM(long, long); break;
+  case ucharacter: CAST_FROM(unsigned char, unsigned long); break;
+  case ushortint:  CAST_FROM(unsigned short, unsigned long); break;
+  case uinteger:   CAST_FROM(unsigned int, unsigned long); break;
+  case ulongint:   CAST_FROM(unsigned long, unsigned long); break;
+  case floatp:     CAST_FROM(float, double); break;
+  case doublep:    CAST_FROM(double, double); break;
   default:
     ReportError("Unrecognized format specifier:", "Fatal error");
     break;
   }
-
-  switch (promotion) {
-  case longint:
-    switch (writeFormat) {
-    case character:
-      for (i = 0; i < nCols; i++)
-        ((char *)writeArray)[i] = (char)longValue[i];
-      break;
-    case ucharacter:
-      for (i = 0; i < nCols; i++)
-        ((unsigned char *)writeArray)[i] = (unsigned char)longValue[i];
-      break;
-    case shortint:
-      for (i = 0; i < nCols; i++)
-        ((short *)writeArray)[i] = (short)longValue[i];
-      break;
-    case ushortint:
-      for (i = 0; i < nCols; i++)
-        ((unsigned short *)writeArray)[i] = (unsigned short)longValue[i];
-      break;
-    case integer:
-      for (i = 0; i < nCols; i++)
-        ((int *)writeArray)[i] = (int)longValue[i];
-      break;
-    case uinteger:
-      for (i = 0; i < nCols; i++)
-        ((unsigned int *)writeArray)[i] = (unsigned int)longValue[i];
-      break;
-    case longint:
-      for (i = 0; i < nCols; i++)
-        ((long *)writeArray)[i] = (long)longValue[i];
-      break;
-    case ulongint:
-      for (i = 0; i < nCols; i++)
-        ((unsigned long *)writeArray)[i] = (unsigned long)longValue[i];
-      break;
-    case floatp:
-      for (i = 0; i < nCols; i++)
-        ((float *)writeArray)[i] = (float)longValue[i];
-      break;
-    case doublep:
-      for (i = 0; i < nCols; i++)
-        ((double *)writeArray)[i] = (double)longValue[i];
-      break;
-    default:
-      ReportError("Unrecognized format specifier:", "Fatal error");
-      break;
-    }
-    break;
-  case ulongint:
-    switch(writeFormat) {
-    case character:
-      for (i = 0; i < nCols; i++)
-        ((char *)writeArray)[i] = (char)ulongValue[i];
-      break;
-    case ucharacter:
-      for (i = 0; i < nCols; i++)
-        ((unsigned char *)writeArray)[i] = (unsigned char)ulongValue[i];
-      break;
-    case shortint:
-      for (i = 0; i < nCols; i++)
-        ((short *)writeArray)[i] = (short)ulongValue[i];
-      break;
-    case ushortint:
-      for (i = 0; i < nCols; i++)
-        ((unsigned short *)writeArray)[i] = (unsigned short)ulongValue[i];
-      break;
-    case integer:
-      for (i = 0; i < nCols; i++)
-        ((int *)writeArray)[i] = (int)ulongValue[i];
-      break;
-    case uinteger:
-      for (i = 0; i < nCols; i++)
-        ((unsigned int *)writeArray)[i] = (unsigned int)ulongValue[i];
-      break;
-    case longint:
-      for (i = 0; i < nCols; i++)
-        ((long *)writeArray)[i] = (long)ulongValue[i];
-      break;
-    case ulongint:
-      for (i = 0; i < nCols; i++)
-        ((unsigned long *)writeArray)[i] = (unsigned long)ulongValue[i];
-      break;
-    case floatp:
-      for (i = 0; i < nCols; i++)
-        ((float *)writeArray)[i] = (float)ulongValue[i];
-      break;
-    case doublep:
-      for (i = 0; i < nCols; i++)
-        ((double *)writeArray)[i] = (double)ulongValue[i];
-      break;
-    default:
-      ReportError("Unrecognized format specifier:", "Fatal error");
-      break;
-    }
-    break;
-  case doublep:
-    switch (writeFormat) {
-    case character:
-      for (i = 0; i < nCols; i++)
-        ((char *)writeArray)[i] = (char)doubleValue[i];
-      break;
-    case ucharacter:
-      for (i = 0; i < nCols; i++)
-        ((unsigned char *)writeArray)[i] = (unsigned char)doubleValue[i];
-      break;
-    case shortint:
-      for (i = 0; i < nCols; i++)
-        ((short *)writeArray)[i] = (short)doubleValue[i];
-      break;
-    case ushortint:
-      for (i = 0; i < nCols; i++)
-        ((unsigned short *)writeArray)[i] = (unsigned short)doubleValue[i];
-      break;
-    case integer:
-      for (i = 0; i < nCols; i++)
-        ((int *)writeArray)[i] = (int)doubleValue[i];
-      break;
-    case uinteger:
-      for (i = 0; i < nCols; i++)
-        ((unsigned int *)writeArray)[i] = (unsigned int)doubleValue[i];
-      break;
-    case longint:
-      for (i = 0; i < nCols; i++)
-        ((long *)writeArray)[i] = (long)doubleValue[i];
-      break;
-    case ulongint:
-      for (i = 0; i < nCols; i++)
-        ((unsigned long *)writeArray)[i] = (unsigned long)doubleValue[i];
-      break;
-    case floatp:
-      for (i = 0; i < nCols; i++)
-        ((float *)writeArray)[i] = (float)doubleValue[i];
-      break;
-    case doublep:
-      for (i = 0; i < nCols; i++)
-        ((double *)writeArray)[i] = (double)doubleValue[i];
-      break;
-    default:
-      ReportError("Unrecognized format specifier:", "Fatal error");
-      break;
-    }
-    break;
-  default:
-    ReportError("Unrecognized promotion specifier:", "Fatal error");
-    break;
-  }
-
-  switch (promotion) {
-  case longint: 
-    free(longValue);
-    break;
-  case ulongint:
-    free(ulongValue);
-    break;
-  case doublep:
-    free(doubleValue);
-    break;
-  default:
-    ReportError("Unrecognized promotion specifier:", "Fatal error");
-    break;
-  }
 }
 
+#undef CAST_FROM
+#undef CAST_LOOP
+
 /*****************************************************************************
   Convert()
+
+  Convert the matrix blockRows rows at a time.  A memory mapped input is
+  used in place, unless it has to be byte swapped.
 *****************************************************************************/
-void Convert(int nRows, int nCols, int readFormat, FILE *inFile, 
-             int writeFormat, FILE *outFile)
+void Convert(int nRows, int nCols, int blockRows, int readFormat, 
+             FILE *inFile, int mapInput, int swapInput, int writeFormat, 
+             FILE *outFile, int swapOutput)
 {
   char errorStr[BUFSIZ+1];
-  int nElements;
+  char *map = NULL;             /* Memory mapped input */
+  size_t mapSize = 0;
+  long nElements;
+  long nBlock;
+  long nRead;
   int row;
-  int (*Read)(FILE *inFile, int nCols, int format, void *Array);
-  int (*Write)(FILE *outFile, int nCols, int format, void *Array);
-  void *readArray;
-  void *writeArray;
-
-  if (readFormat == ascii) {
-    Read = ReadAscii;
+  long i;
+  int readAscii;
+  int writeAscii;
+  const void *inArray;
+  const void *outArray;
+  char *readArray;
+  char *writeArray;
+
+  readAscii = (readFormat == ascii);
+  writeAscii = (writeFormat == ascii);
+  if (readAscii)
     readFormat = writeFormat;
-  }
-  else 
-    Read = ReadBin;
-
-  if (writeFormat == ascii) {
-    Write = WriteAscii;
+  if (writeAscii)
     writeFormat = readFormat;
-  }
-  else 
-    Write = WriteBin;
   
-  readArray = calloc(nCols, sizeArray[readFormat]);
-  if (readArray == NULL)
+  readArray = calloc((size_t) blockRows * nCols, sizeArray[readFormat]);
+  writeArray = calloc((size_t) blockRows * nCols, sizeArray[writeFormat]);
+  if (readArray == NULL || writeArray == NULL)
     ReportError("", "Failure to allocate memory");
-  
-  if (readFormat != writeFormat) {
-    writeArray = calloc(nCols, sizeArray[writeFormat]);
-    if (writeArray == NULL)
-      ReportError("", "Failure to allocate memory");
+
+  if (mapInput) {
+#ifdef _POSIX_MAPPED_FILES
+    struct stat fileInfo;
+
+    mapSize = (size_t) nRows * nCols * sizeArray[readFormat];
+    if (fstat(fileno(inFile), &fileInfo) != 0 || 
+        (size_t) fileInfo.st_size < mapSize)
+      ReportError("", "Input file is smaller than the matrix");
+    map = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fileno(inFile), 0);
+    if (map == MAP_FAILED)
+      ReportError("", "Cannot memory map the input");
+    posix_madvise(map, mapSize, POSIX_MADV_SEQUENTIAL);
+#else
+    ReportError("-mmap", "Memory mapped files are not supported:");
+#endif
   }
-  else
-    writeArray = readArray;
 
-  for (row = 0; row < nRows; row++) {
-    nElements = Read(inFile, nCols, readFormat, readArray);
-    if (nElements != nCols) {
-      sprintf(errorStr, "Row: %d\tColumn: %d", row, nElements);
-      ReportError(errorStr, "Error reading input:");
+  for (row = 0; row < nRows; row += blockRows) {
+    nBlock = (nRows - row < blockRows) ? nRows - row : blockRows;
+    nElements = nBlock * nCols;
+
+    /* read */
+    if (map != NULL)
+      inArray = map + (size_t) row * nCols * sizeArray[readFormat];
+    else if (readAscii) {
+      for (i = 0; i < nBlock; i++) {
+        if (ReadAscii(inFile, nCols, readFormat, readArray + 
+                      (size_t) i * nCols * sizeArray[readFormat]) != nCols) {
+          sprintf(errorStr, "Row: %ld\tColumn: %d", row + i, nCols);
+          ReportError(errorStr, "Error reading input:");
+        }
+      }
+      inArray = readArray;
+    }
+    else {
+      nRead = ReadBin(inFile, nElements, readFormat, readArray);
+      if (nRead != nElements) {
+        sprintf(errorStr, "Row: %ld\tColumn: %ld", row + nRead / nCols, 
+                nRead % nCols);
+        ReportError(errorStr, "Error reading input:");
+      }
+      inArray = readArray;
+    }
+    if (swapInput) {
+      SwapBytes(nElements, sizeArray[readFormat], inArray, readArray);
+      inArray = readArray;
     }
-    Cast(nCols, readFormat, readArray, writeFormat, writeArray);
-    nElements = Write(outFile, nCols, writeFormat, writeArray);
-    if (nElements != nCols) {
-      sprintf(errorStr, "Row: %d\tColumn: %d", row, nElements);
+
+    /* convert */
+    if (readFormat != writeFormat) {
+      Cast(nElements, readFormat, inArray, writeFormat, writeArray);
+      outArray = writeArray;
+    }
+    else
+      outArray = inArray;
+    if (swapOutput) {
+      SwapBytes(nElements, sizeArray[writeFormat], outArray, writeArray);
+      outArray = writeArray;
+    }
+
+    /* write */
+    if (writeAscii) {
+      for (i = 0; i < nBlock; i++) {
+        if (WriteAscii(outFile, nCols, writeFormat, (const char *) outArray + 
+                       (size_t) i * nCols * sizeArray[writeFormat]) != nCols) {
+          sprintf(errorStr, "Row: %ld\tColumn: %d", row + i, nCols);
+          ReportError(errorStr, "Error writing output:");
+        }
+      }
+    }
+    else if (WriteBin(outFile, nElements, writeFormat, outArray) != 
+             nElements) {
+      sprintf(errorStr, "Row: %d\tColumn: %d", row, nCols);
       ReportError(errorStr, "Error writing output:");
     }
+
+#ifdef _POSIX_MAPPED_FILES
+    /* the mapped pages that are done are not needed again */
+    if (map != NULL)
+      posix_madvise(map + (size_t) row * nCols * sizeArray[readFormat],
+                    (size_t) nElements * sizeArray[readFormat], 
+                    POSIX_MADV_DONTNEED);
+#endif
   }
+
+#ifdef _POSIX_MAPPED_FILES
+  if (map != NULL)
+    munmap(map, mapSize);
+#endif
   free(readArray);
-  if (readFormat != writeFormat)
-    free(writeArray);
+  free(writeArray);
 } 
-  
+
+/*****************************************************************************
+  SwapBytes()
+
+  Reverse the bytes of nElements values of elementSize bytes from inArray
+  into outArray, which may be the same array
+*****************************************************************************/
+void SwapBytes(long nElements, int elementSize, const void *inArray,
+               void *outArray)
+{
+  long i;
+  unsigned short u16;
+  unsigned int u32;
+  unsigned long long u64;
+
+  switch (elementSize) {
+  case 1:
+    if (inArray != outArray)
+      memcpy(outArray, inArray, nElements);
+    break;
+  case 2:
+    for (i = 0; i < nElements; i++) {
+      u16 = ((const unsigned short *)inArray)[i];
+      ((unsigned short *)outArray)[i] = (unsigned short) 
+        ((u16 >> 8) | (u16 << 8));
+    }
+    break;
+  case 4:
+    for (i = 0; i < nElements; i++) {
+      u32 = ((const unsigned int *)inArray)[i];
+      ((unsigned int *)outArray)[i] = (u32 >> 24) | ((u32 >> 8) & 0xff00u) |
+        ((u32 << 8) & 0xff0000u) | (u32 << 24);
+    }
+    break;
+  case 8:
+    for (i = 0; i < nElements; i++) {
+      u64 = ((const unsigned long long *)inArray)[i];
+      u64 = ((u64 >> 8) & 0x00ff00ff00ff00ffULL) | 
+        ((u64 & 0x00ff00ff00ff00ffULL) << 8);
+      u64 = ((u64 >> 16) & 0x0000ffff0000ffffULL) | 
+        ((u64 & 0x0000ffff0000ffffULL) << 16);
+      ((unsigned long long *)outArray)[i] = (u64 >> 32) | (u64 << 32);
+    }
+    break;
+  default:
+    ReportError("Unsupported element size", "Fatal error:");
+    break;
+  }
+}
+
 /*****************************************************************************
   GetFormat()
 *****************************************************************************/
@@ -568,11 +537,11 @@ int ReadAscii(FILE *inFile, int nCols, int format, void *array)
 /*****************************************************************************
   ReadBin()
 *****************************************************************************/
-int ReadBin(FILE *inFile, int nCols, int format, void *array) 
+long ReadBin(FILE *inFile, long nElements, int format, void *array) 
 {
   int elementSize = sizeArray[format];
 
-  return fread(array, elementSize, nCols, inFile);    
+  return (long) fread(array, elementSize, nElements, inFile);    
 }
 
 /*****************************************************************************
@@ -588,7 +557,7 @@ void ReportError(char *errorStr1, char *errorStr2)
 /*****************************************************************************
   WriteAscii()
 *****************************************************************************/
-int WriteAscii(FILE *outFile, int nCols, int format, void *array) 
+int WriteAscii(FILE *outFile, int nCols, int format, const void *array) 
 {
   int i = 0;
   
@@ -646,9 +615,9 @@ int WriteAscii(FILE *outFile, int nCols, int format, void *array)
 /*****************************************************************************
   WriteBin()
 *****************************************************************************/
-int WriteBin(FILE *outFile, int nCols, int format, void *array)
+long WriteBin(FILE *outFile, long nElements, int format, const void *array)
 {
   int elementSize = sizeArray[format];
 
-  return fwrite(array, elementSize, nCols, outFile);
+  return (long) fwrite(array, elementSize, nElements, outFile);
 }
@@ -27,14 +27,21 @@
 
 #define N_FORMATS 10
 
+#define BLOCKSIZE (4 * 1024 * 1024)  /* bytes converted at a time */
+
+#ifndef MAX
+#define MAX(x,y) ((x) > (y) ? (x) : (y))
+#endif
+
 enum ValidFormat {character = 0, ucharacter, shortint, ushortint, integer,
                   uinteger, longint, ulongint, floatp, doublep, ascii};
 
-void Cast(int nCols, int readFormat, void *readArray, 
+void Cast(long nElements, int readFormat, const void *readArray, 
           int writeFormat, void *writeArray);
 
-void Convert(int nRows, int nCols, int readFormat, FILE *inFile, 
-             int writeFormat, FILE *outFile);
+void Convert(int nRows, int nCols, int blockRows, int readFormat, 
+             FILE *inFile, int mapInput, int swapInput, int writeFormat, 
+             FILE *outFile, int swapOutput);
 
 int GetFormat(char *formatStr);
 
@@ -47,12 +54,15 @@ void OpenFile(FILE **FilePtr, char *FileName, char *Mode,
 
 int ReadAscii(FILE *inFile, int nCols, int format, void *array);
 
-int ReadBin(FILE *inFile, int nCols, int format, void *array);
+long ReadBin(FILE *inFile, long nElements, int format, void *array);
 
 void ReportError(char *errorStr1, char *errorStr2);
 
-int WriteAscii(FILE *outFile, int nCols, int format, void *array);
+void SwapBytes(long nElements, int elementSize, const void *inArray,
+               void *outArray);
+
+int WriteAscii(FILE *outFile, int nCols, int format, const void *array);
 
-int WriteBin(FILE *outFile, int nCols, int format, void *array);
+long WriteBin(FILE *outFile, long nElements, int format, const void *array);
 
 #endif
@@ -0,0 +1,196 @@
+/*
+ * SUMMARY:      pixel_text.c - convert binary pixel output to text
+ * USAGE:        pixel_text <Pixel.bin> <output directory> [<pixel name> ...]
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Reads a Pixel.bin file written with PIXEL OUTPUT FORMAT =
+ *               BINARY and writes the Pixel.<name> text files DHSVM writes
+ *               with the TEXT format, for all the pixels or for the named
+ *               ones
+ * DESCRIP-END.
+ * COMMENTS:     The layout of the binary file is described with DumpPixBin()
+ *               in sourcecode/ExecDump.c.  The file has to be read on a
+ *               machine with the same byte order.  The pixels are converted
+ *               one at a time, so that only one text file is open
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* must match sourcecode/settings.h */
+#define PIXEL_BIN_MAGIC   "DHSVMPIX"
+#define PIXEL_BIN_DATELEN 20
+
+typedef struct {
+  int minveg;			/* vegetation layers a pixel needs */
+  int minsoil;			/* soil layers a pixel needs */
+  char *name;
+  char *header;			/* text of the column header */
+  char *format;			/* printf format of a value */
+  int isint;			/* TRUE if the format is %d */
+} PIXCOLUMN;
+
+typedef struct {
+  int row;
+  int col;
+  int nveg;			/* vegetation layers of the pixel */
+  int nsoil;			/* soil layers of the pixel */
+  char *name;
+} PIXHEAD;
+
+/* read a string written as its length and characters */
+static char *read_string(FILE *infile, char *file)
+{
+  char *str;
+  int len;
+
+  if (fread(&len, sizeof(int), 1, infile) != 1 || len < 0) {
+    printf("%s: truncated header\n", file);
+    exit(-1);
+  }
+  if (!(str = (char *) calloc(len + 1, sizeof(char)))) {
+    printf("out of memory\n");
+    exit(-1);
+  }
+  if (fread(str, 1, len, infile) != len) {
+    printf("%s: truncated header\n", file);
+    exit(-1);
+  }
+  return str;
+}
+
+int main(int argc, char **argv)
+{
+  FILE *infile, *outfile;
+  char magic[sizeof(PIXEL_BIN_MAGIC)];
+  char date[PIXEL_BIN_DATELEN + 1];
+  char outname[1024];
+  PIXCOLUMN *column;
+  PIXHEAD *pixel;
+  float *values;		/* the columns of one pixel */
+  long recordsize;		/* bytes of one time step */
+  long datastart;		/* offset of the first time step */
+  long nsteps;
+  int npix, ncol;
+  int i, j, k;
+  int nconverted = 0;
+
+  if (argc < 3) {
+    printf("usage is: pixel_text <binary pixel file> <output directory> "
+	   "[<pixel name> ...]\n");
+    exit(-1);
+  }
+
+  if (!(infile = fopen(argv[1], "rb"))) {
+    printf("unable to open %s\n", argv[1]);
+    exit(-1);
+  }
+
+  /* header */
+  if (fread(magic, 1, strlen(PIXEL_BIN_MAGIC), infile) !=
+      strlen(PIXEL_BIN_MAGIC) ||
+      strncmp(magic, PIXEL_BIN_MAGIC, strlen(PIXEL_BIN_MAGIC)) != 0 ||
+      fread(&npix, sizeof(int), 1, infile) != 1 || npix < 0 ||
+      fread(&ncol, sizeof(int), 1, infile) != 1 || ncol < 0) {
+    printf("%s is not a binary pixel file\n", argv[1]);
+    exit(-1);
+  }
+  column = (PIXCOLUMN *) calloc(ncol + 1, sizeof(PIXCOLUMN));
+  pixel = (PIXHEAD *) calloc(npix + 1, sizeof(PIXHEAD));
+  values = (float *) calloc(ncol + 1, sizeof(float));
+  if (column == NULL || pixel == NULL || values == NULL) {
+    printf("out of memory\n");
+    exit(-1);
+  }
+  for (k = 0; k < ncol; k++) {
+    if (fread(&(column[k].minveg), sizeof(int), 1, infile) != 1 ||
+	fread(&(column[k].minsoil), sizeof(int), 1, infile) != 1) {
+      printf("%s: truncated header\n", argv[1]);
+      exit(-1);
+    }
+    column[k].name = read_string(infile, argv[1]);
+    column[k].header = read_string(infile, argv[1]);
+    column[k].format = read_string(infile, argv[1]);
+    column[k].isint = (strchr(column[k].format, 'd') != NULL);
+  }
+  for (i = 0; i < npix; i++) {
+    if (fread(&(pixel[i].row), sizeof(int), 1, infile) != 1 ||
+	fread(&(pixel[i].col), sizeof(int), 1, infile) != 1 ||
+	fread(&(pixel[i].nveg), sizeof(int), 1, infile) != 1 ||
+	fread(&(pixel[i].nsoil), sizeof(int), 1, infile) != 1) {
+      printf("%s: truncated header\n", argv[1]);
+      exit(-1);
+    }
+    pixel[i].name = read_string(infile, argv[1]);
+  }
+  datastart = ftell(infile);
+  recordsize = PIXEL_BIN_DATELEN + (long) npix * ncol * sizeof(float);
+
+  /* one pass over the time steps for each pixel */
+  date[PIXEL_BIN_DATELEN] = '\0';
+  for (i = 0; i < npix; i++) {
+    if (argc > 3) {
+      for (j = 3; j < argc; j++)
+	if (strcmp(argv[j], pixel[i].name) == 0)
+	  break;
+      if (j == argc)
+	continue;
+    }
+
+    sprintf(outname, "%s/Pixel.%s", argv[2], pixel[i].name);
+    if (!(outfile = fopen(outname, "w"))) {
+      printf("unable to open %s\n", outname);
+      exit(-1);
+    }
+
+    fprintf(outfile, "         Date        ");
+    for (k = 0; k < ncol; k++)
+      if (pixel[i].nveg >= column[k].minveg &&
+	  pixel[i].nsoil >= column[k].minsoil)
+	fprintf(outfile, "%s", column[k].header);
+    fprintf(outfile, "\n");
+
+    for (nsteps = 0;; nsteps++) {
+      if (fseek(infile, datastart + nsteps * recordsize, SEEK_SET) != 0 ||
+	  fread(date, 1, PIXEL_BIN_DATELEN, infile) != PIXEL_BIN_DATELEN)
+	break;
+      if (fseek(infile, (long) i * ncol * sizeof(float), SEEK_CUR) != 0 ||
+	  fread(values, sizeof(float), ncol, infile) != ncol) {
+	printf("%s: truncated record after %ld steps\n", argv[1], nsteps);
+	break;
+      }
+      fprintf(outfile, "%s", date);
+      for (k = 0; k < ncol; k++) {
+	if (pixel[i].nveg < column[k].minveg ||
+	    pixel[i].nsoil < column[k].minsoil)
+	  continue;
+	if (column[k].isint)
+	  fprintf(outfile, column[k].format, (int) values[k]);
+	else
+	  fprintf(outfile, column[k].format, values[k]);
+      }
+      fprintf(outfile, "\n");
+    }
+    fclose(outfile);
+    nconverted++;
+  }
+
+  printf("%d of %d pixels converted\n", nconverted, npix);
+
+  fclose(infile);
+  for (k = 0; k < ncol; k++) {
+    free(column[k].name);
+    free(column[k].header);
+    free(column[k].format);
+  }
+  for (i = 0; i < npix; i++)
+    free(pixel[i].name);
+  free(column);
+  free(pixel);
+  free(values);
+
+  return 0;
+}
@@ -16,7 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
-
+#include "horizon.h"
 
 int GetNumber(char *numberStr);
 
@@ -29,24 +29,19 @@ int main(int argc, char **argv)
   float *temp;
   float **elev;
   float **skyview;
-  int    i;
   int    ny,nx;
-  float  lx,ly;
-  double max_angle,angle;
   int    nLook;
-  double theta;
   float  dx;
-  float  x,y,sx,sy,dz,dist;
-  float  mx,my;
-  float  start_elev;
   float  max_elev;
-  int    stop_flag;
+  HORIZON horizon;
 
 
   if(argc<7) {
     printf("usage is: skyview:  \n");
-    printf("demfilename, outfilename, # of look direction, nrows, ncols, cellsize\n");
-    printf("the last 4 variable should all be entered as integers \n");
+    printf("demfilename, outfilename, # of look direction, nrows, ncols, cellsize [horizon file]\n");
+    printf("the 4 variables after the file names should all be entered as integers \n");
+    printf("the horizons are read from the horizon file if it was made for this dem\n");
+    printf("and # of look directions, and written to it otherwise\n");
     exit(-1);
   }
 
@@ -97,42 +92,21 @@ int main(int argc, char **argv)
     }
   }
 
-  ly=(float)(nRows*dx-dx);
-  lx=(float)(nCols*dx-dx);
-
   printf("beginning skyview calculations \n");
-   
+
+  /* the horizons of all the cells at once, see horizon.c */
+  MakeHorizons(&horizon, elev, nRows, nCols, dx, nLook,
+	       (argc > 7) ? argv[7] : NULL);
+
   for (ny = 0; ny < nRows; ny++) {
     for (nx = 0; nx < nCols; nx++) {
-      skyview[ny][nx]=0.0;
-      start_elev=elev[ny][nx];
-
-      if(start_elev>0) {
-		  for (i = 0; i < nLook; i++) {
-		  theta=6.283185/((double)nLook)*(double)i;
-		  sx=(float)nx*dx+0.5*dx;
-		  sy=(float)ny*dx+0.5*dx;
-		  x=sx;
-	      y=sy;
-	      max_angle=0.0;
-		  
-		  while(x>dx && x < lx && y>dx && y<ly) {
-			  x=x+((float)cos(theta))*dx;
-			  y=y+((float)sin(theta))*dx;
-			  dz=elev[(int)(y/dx)][(int)(x/dx)]-start_elev;
-	          dist=sqrt((x-sx)*(x-sx)+(y-sy)*(y-sy));
-	          if(dz>0) {
-				  angle=atan((double)(dz/dist));
-				  if(angle > max_angle) 
-					  max_angle = angle;
-			  }
-		  }
-		  skyview[ny][nx]+=(cos(max_angle)*cos(max_angle));
-		  }
-		  skyview[ny][nx]=skyview[ny][nx]/(float)nLook;
-	  }
-	}
+      skyview[ny][nx] = 0.0;
+      if (elev[ny][nx] > 0)
+	skyview[ny][nx] = SkyViewFactor(&horizon, ny, nx);
+    }
   }
+  FreeHorizons(&horizon);
+
   for (ny = 0; ny < nRows; ny++) {
     fwrite(skyview[ny],sizeof(float),nCols,outfile); 
   }
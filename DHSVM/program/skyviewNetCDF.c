@@ -21,6 +21,7 @@
 #include "sizeofNetCDF.h"
 #include "data.h"
 #include "settings.h"
+#include "horizon.h"
 
 int GetNumber(char *numberStr);
 int CopyDouble(double *Value, char *Str, const int NValues);
@@ -37,16 +38,10 @@ int main(int argc, char **argv)
   float **skyview;
   int    i;
   int    ny,nx;
-  float  lx,ly;
-  double max_angle,angle;
   int    nLook;
-  double theta;
   float  dx;
-  float  x,y,sx,sy,dz,dist;
-  float  mx,my;
-  float  start_elev;
   float  max_elev;
-  int    stop_flag;
+  HORIZON horizon;
   float *Array;
   char FileLabel[BUFSIZE + 1];
   int eflag = 0;
@@ -62,7 +57,9 @@ int main(int argc, char **argv)
 
   if(argc < 9) {
     printf("usage is: skyview:  \n");
-    printf("demfilename, outfilename, # of look direction, nrows, ncols, cellsize, XOrigin, YOrigina\n");
+    printf("demfilename, outfilename, # of look direction, nrows, ncols, cellsize, XOrigin, YOrigina [horizon file]\n");
+    printf("the horizons are read from the horizon file if it was made for this dem\n");
+    printf("and # of look directions, and written to it otherwise\n");
     exit(-1);
   }
 
@@ -161,43 +158,21 @@ int main(int argc, char **argv)
     }
   }
 
-  ly=(float)(nRows*dx-dx);
-  lx=(float)(nCols*dx-dx);
-
   printf("beginning skyview calculations \n");
-   
+
+  /* the horizons of all the cells at once, see horizon.c */
+  MakeHorizons(&horizon, elev, nRows, nCols, dx, nLook,
+	       (argc > 9) ? argv[9] : NULL);
+
   for (ny = 0; ny < nRows; ny++) {
     for (nx = 0; nx < nCols; nx++) {
-      skyview[ny][nx]=0.0;
-      start_elev=elev[ny][nx];
-
-      if(start_elev>0) {
-		  for (i = 0; i < nLook; i++) {
-		  theta=6.283185/((double)nLook)*(double)i;
-		  sx=(float)nx*dx+0.5*dx;
-		  sy=(float)ny*dx+0.5*dx;
-		  x=sx;
-	      y=sy;
-	      max_angle=0.0;
-		  
-		  while(x>dx && x < lx && y>dx && y<ly) {
-			  x=x+((float)cos(theta))*dx;
-			  y=y+((float)sin(theta))*dx;
-			  dz=elev[(int)(y/dx)][(int)(x/dx)]-start_elev;
-	          dist=sqrt((x-sx)*(x-sx)+(y-sy)*(y-sy));
-	          if(dz>0) {
-				  angle=atan((double)(dz/dist));
-				  if(angle > max_angle) 
-					  max_angle = angle;
-			  }
-		  }
-		  skyview[ny][nx] +=(cos(max_angle)*cos(max_angle));
-		  }
-		  skyview[ny][nx]=skyview[ny][nx]/(float)nLook;
-	  }
-	  ((float *) Array)[ny * nCols + nx] = skyview[ny][nx];
-	}
+      skyview[ny][nx] = 0.0;
+      if (elev[ny][nx] > 0)
+	skyview[ny][nx] = SkyViewFactor(&horizon, ny, nx);
+      ((float *) Array)[ny * nCols + nx] = skyview[ny][nx];
+    }
   }
+  FreeHorizons(&horizon);
 
   CreateMapFileNetCDF(DMap.FileName, DMap.FileLabel, &Map);
   Write2DMatrixNetCDF(DMap.FileName, (void *)Array, DMap.NumberType, Map.NY, Map.NX, &DMap, 0);
@@ -10,6 +10,11 @@
  *               state variables over the basin.
  * DESCRIP-END.
  * FUNCTIONS:    Aggregate()
+ *               AggregateFluxes()
+ *               AggregateCell()
+ *               AddAggregated()
+ *               AddFluxes()
+ *               PartialBlocks()
  * COMMENTS:
  * $Id: Aggregate.c,v 1.17 2004/08/18 01:01:25 colleen Exp $
  */
@@ -17,150 +22,342 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "settings.h"
 #include "data.h"
 #include "DHSVMerror.h"
 #include "functions.h"
 #include "constants.h"
+#include "massenergy.h"
+
+#ifndef AGG_BLOCK
+#define AGG_BLOCK 1024		/* number of cells summed per block */
+#endif
+
+/* block sums, allocated on the first call */
+static AGGREGATED *Partial = NULL;
+static int NPartial = 0;
 
 /*****************************************************************************
-  Aggregate()
-  
-  Calculate the average values for the different fluxes and state variables
-  over the basin.  
-  In the current implementation the local radiation
-  elements are not stored for the entire area.  Therefore these components
-  are aggregated in AggregateRadiation() inside MassEnergyBalance().
-  
-  The aggregated values are set to zero in the function RestAggregate,
-  which is executed at the beginning of each time step.
+  PartialBlocks()
+
+  Number of blocks of AGG_BLOCK active cells, with a block sum in Partial
+  for each
 *****************************************************************************/
-void Aggregate(MAPSIZE *Map, OPTIONSTRUCT *Options, TOPOPIX **TopoMap,
-	       LAYER *Soil, LAYER * Veg, VEGPIX **VegMap, EVAPPIX **Evap,
-	       PRECIPPIX **Precip, PIXRAD **RadMap, SNOWPIX **Snow,
-	       SOILPIX **SoilMap, AGGREGATED *Total, VEGTABLE *VType,
-	       ROADSTRUCT **Network, CHANNEL *ChannelData, float *roadarea)
+static int PartialBlocks(MAPSIZE *Map, LAYER *Soil, LAYER *Veg)
 {
-  int NPixels;			/* Number of pixels in the basin */
+  int NBlocks;			/* Number of blocks of AGG_BLOCK cells */
+  int b;			/* block counter */
+
+  NBlocks = (Map->NumActive + AGG_BLOCK - 1) / AGG_BLOCK;
+  if (NBlocks > NPartial) {
+    if (!(Partial = (AGGREGATED *) realloc(Partial, NBlocks * sizeof(AGGREGATED))))
+      ReportError("Aggregate()", 1);
+    for (b = NPartial; b < NBlocks; b++)
+      InitAggregated(Veg->MaxLayers, Soil->MaxLayers, &(Partial[b]));
+    NPartial = NBlocks;
+  }
+  return NBlocks;
+}
+
+/*****************************************************************************
+  AggregateCell()
+
+  Add the values of the cell at (x, y), of class Class, to the sums in Sum
+*****************************************************************************/
+static void AggregateCell(int x, int y, OPTIONSTRUCT *Options, LAYER *Soil, 
+			  LAYER *Veg, CELLCLASS *Class, EVAPPIX **Evap,
+			  PRECIPPIX **Precip, PIXRAD **RadMap, SNOWPIX **Snow,
+			  SOILPIX **SoilMap, ROADSTRUCT **Network,
+			  AGGREGATED *Sum)
+{
+  float *RootDepth;		/* Root depths of the vegetation type */
   int NSoilL;			/* Number of soil layers for current pixel */
   int NVegL;			/* Number of vegetation layers for current pixel */
   int i;				/* counter */
   int j;				/* counter */
-  int x;
-  int y;
   float DeepDepth;		/* depth to bottom of lowest rooting zone */
 
-  NPixels = 0;
-  *roadarea = 0.;
-
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-		  NPixels++;
-		  NSoilL = Soil->NLayers[SoilMap[y][x].Soil - 1];
-		  NVegL = Veg->NLayers[VegMap[y][x].Veg - 1];
+		  NSoilL = Class->NSoilLayers;
+		  NVegL = Class->NVegLayers;
+		  RootDepth = Class->VType->RootDepth;
 		  
 		  /* aggregate the evaporation data */
-		  Total->Evap.ETot += Evap[y][x].ETot;
+		  Sum->Evap.ETot += Evap[y][x].ETot;
 		  for (i = 0; i < NVegL; i++) {
-			  Total->Evap.EPot[i] += Evap[y][x].EPot[i];
-			  Total->Evap.EAct[i] += Evap[y][x].EAct[i];
-			  Total->Evap.EInt[i] += Evap[y][x].EInt[i];
+			  Sum->Evap.EPot[i] += Evap[y][x].EPot[i];
+			  Sum->Evap.EAct[i] += Evap[y][x].EAct[i];
+			  Sum->Evap.EInt[i] += Evap[y][x].EInt[i];
 		  }
-		  Total->Evap.EPot[Veg->MaxLayers] += Evap[y][x].EPot[NVegL];
-		  Total->Evap.EAct[Veg->MaxLayers] += Evap[y][x].EAct[NVegL];
+		  Sum->Evap.EPot[Veg->MaxLayers] += Evap[y][x].EPot[NVegL];
+		  Sum->Evap.EAct[Veg->MaxLayers] += Evap[y][x].EAct[NVegL];
 		  
 		  for (i = 0; i < NVegL; i++) {
 			  for (j = 0; j < NSoilL; j++) {
-				  Total->Evap.ESoil[i][j] += Evap[y][x].ESoil[i][j];
+				  Sum->Evap.ESoil[i][j] += Evap[y][x].ESoil[i][j];
 			  }
 		  }
-		  Total->Evap.EvapSoil += Evap[y][x].EvapSoil;
+		  Sum->Evap.EvapSoil += Evap[y][x].EvapSoil;
 		  
 		  /* aggregate precipitation data */
-		  Total->Precip.Precip += Precip[y][x].Precip;
-          Total->Precip.SnowFall += Precip[y][x].SnowFall;
+		  Sum->Precip.Precip += Precip[y][x].Precip;
+          Sum->Precip.SnowFall += Precip[y][x].SnowFall;
 		  for (i = 0; i < NVegL; i++) {
-			  Total->Precip.IntRain[i] += Precip[y][x].IntRain[i];
-			  Total->Precip.IntSnow[i] += Precip[y][x].IntSnow[i];
-			  Total->CanopyWater += Precip[y][x].IntRain[i] +
+			  Sum->Precip.IntRain[i] += Precip[y][x].IntRain[i];
+			  Sum->Precip.IntSnow[i] += Precip[y][x].IntSnow[i];
+			  Sum->CanopyWater += Precip[y][x].IntRain[i] +
 			  Precip[y][x].IntSnow[i];
 		  }
 
 	/* aggregate radiation data */
 	if (Options->MM5 == TRUE) {
-	  Total->Rad.BeamIn = NOT_APPLICABLE;
-	  Total->Rad.DiffuseIn = NOT_APPLICABLE;
+	  Sum->Rad.BeamIn = NOT_APPLICABLE;
+	  Sum->Rad.DiffuseIn = NOT_APPLICABLE;
 	}
 	else {
-      Total->Rad.Tair += RadMap[y][x].Tair;
-      Total->Rad.ObsShortIn += RadMap[y][x].ObsShortIn;
-	  Total->Rad.BeamIn += RadMap[y][x].BeamIn;
-	  Total->Rad.DiffuseIn += RadMap[y][x].DiffuseIn;
-      Total->Rad.PixelNetShort += RadMap[y][x].PixelNetShort;
-      Total->NetRad += RadMap[y][x].NetRadiation[0] + RadMap[y][x].NetRadiation[1];
+      Sum->Rad.Tair += RadMap[y][x].Tair;
+      Sum->Rad.ObsShortIn += RadMap[y][x].ObsShortIn;
+	  Sum->Rad.BeamIn += RadMap[y][x].BeamIn;
+	  Sum->Rad.DiffuseIn += RadMap[y][x].DiffuseIn;
+      Sum->Rad.PixelNetShort += RadMap[y][x].PixelNetShort;
+      Sum->NetRad += RadMap[y][x].NetRadiation[0] + RadMap[y][x].NetRadiation[1];
 	}
 
+	/* the radiation balance of the cell, as MassEnergyBalance() left it */
+	AggregateRadiation(Veg->MaxLayers, NVegL, &(RadMap[y][x]), &(Sum->Rad));
+
 	/* aggregate snow data */
 	if (Snow[y][x].HasSnow)
-		Total->Snow.HasSnow = TRUE;
-		Total->Snow.Swq += Snow[y][x].Swq;
-		Total->Snow.Glacier += Snow[y][x].Glacier;
-		/* Total->Snow.Melt += Snow[y][x].Melt; */
-		Total->Snow.Melt += Snow[y][x].Outflow;
-		Total->Snow.PackWater += Snow[y][x].PackWater;
-		Total->Snow.TPack += Snow[y][x].TPack;
-		Total->Snow.SurfWater += Snow[y][x].SurfWater;
-		Total->Snow.TSurf += Snow[y][x].TSurf;
-		Total->Snow.ColdContent += Snow[y][x].ColdContent;
-		Total->Snow.Albedo += Snow[y][x].Albedo;
-		Total->Snow.Depth += Snow[y][x].Depth;
-		Total->Snow.VaporMassFlux += Snow[y][x].VaporMassFlux;
-		Total->Snow.CanopyVaporMassFlux += Snow[y][x].CanopyVaporMassFlux;
+		Sum->Snow.HasSnow = TRUE;
+		Sum->Snow.Swq += Snow[y][x].Swq;
+		Sum->Snow.Glacier += Snow[y][x].Glacier;
+		/* Sum->Snow.Melt += Snow[y][x].Melt; */
+		Sum->Snow.Melt += Snow[y][x].Outflow;
+		Sum->Snow.PackWater += Snow[y][x].PackWater;
+		Sum->Snow.TPack += Snow[y][x].TPack;
+		Sum->Snow.SurfWater += Snow[y][x].SurfWater;
+		Sum->Snow.TSurf += Snow[y][x].TSurf;
+		Sum->Snow.ColdContent += Snow[y][x].ColdContent;
+		Sum->Snow.Albedo += Snow[y][x].Albedo;
+		Sum->Snow.Depth += Snow[y][x].Depth;
+		Sum->Snow.VaporMassFlux += Snow[y][x].VaporMassFlux;
+		Sum->Snow.CanopyVaporMassFlux += Snow[y][x].CanopyVaporMassFlux;
 
 		/* aggregate soil moisture data */
-		Total->Soil.Depth += SoilMap[y][x].Depth;
+		Sum->Soil.Depth += SoilMap[y][x].Depth;
 		DeepDepth = 0.0;
 
 		for (i = 0; i < NSoilL; i++) {
-			Total->Soil.Moist[i] += SoilMap[y][x].Moist[i];
+			Sum->Soil.Moist[i] += SoilMap[y][x].Moist[i];
 			assert(SoilMap[y][x].Moist[i] >= 0.0);
-			Total->Soil.Perc[i] += SoilMap[y][x].Perc[i];
-			Total->Soil.Temp[i] += SoilMap[y][x].Temp[i];
-			Total->SoilWater += SoilMap[y][x].Moist[i] * VType[VegMap[y][x].Veg - 1].RootDepth[i] * Network[y][x].Adjust[i]; 
-			DeepDepth += VType[VegMap[y][x].Veg - 1].RootDepth[i];
+			Sum->Soil.Perc[i] += SoilMap[y][x].Perc[i];
+			Sum->Soil.Temp[i] += SoilMap[y][x].Temp[i];
+			Sum->SoilWater += SoilMap[y][x].Moist[i] * RootDepth[i] * Network[y][x].Adjust[i]; 
+			DeepDepth += RootDepth[i];
 		}
 
-		Total->Soil.Moist[Soil->MaxLayers] += SoilMap[y][x].Moist[NSoilL];
-		Total->SoilWater += SoilMap[y][x].Moist[NSoilL] * (SoilMap[y][x].Depth - DeepDepth) * Network[y][x].Adjust[NSoilL];
-		Total->Soil.TableDepth += SoilMap[y][x].TableDepth;
+		Sum->Soil.Moist[Soil->MaxLayers] += SoilMap[y][x].Moist[NSoilL];
+		Sum->SoilWater += SoilMap[y][x].Moist[NSoilL] * (SoilMap[y][x].Depth - DeepDepth) * Network[y][x].Adjust[NSoilL];
+		Sum->Soil.TableDepth += SoilMap[y][x].TableDepth;
 
 		if (SoilMap[y][x].TableDepth <= 0)
-			(Total->Saturated)++;
+			(Sum->Saturated)++;
+
+		/* saturation extent is based on the number of pixels with a water
+		   table that is at least MTHRESH of soil depth */
+		if ((SoilMap[y][x].Depth - SoilMap[y][x].TableDepth) / 
+			SoilMap[y][x].Depth > MTHRESH)
+			Sum->SatExtent += 1.;
 		
-		Total->Soil.WaterLevel += SoilMap[y][x].WaterLevel;
-		Total->Soil.SatFlow += SoilMap[y][x].SatFlow;
-		Total->Soil.TSurf += SoilMap[y][x].TSurf;
-		Total->Soil.Qnet += SoilMap[y][x].Qnet;
-		Total->Soil.Qs += SoilMap[y][x].Qs;
-		Total->Soil.Qe += SoilMap[y][x].Qe;
-		Total->Soil.Qg += SoilMap[y][x].Qg;
-		Total->Soil.Qst += SoilMap[y][x].Qst;
-		Total->Soil.IExcess += SoilMap[y][x].IExcess;
-		Total->Soil.DetentionStorage += SoilMap[y][x].DetentionStorage;
+		Sum->Soil.WaterLevel += SoilMap[y][x].WaterLevel;
+		Sum->Soil.SatFlow += SoilMap[y][x].SatFlow;
+		Sum->Soil.TSurf += SoilMap[y][x].TSurf;
+		Sum->Soil.Qnet += SoilMap[y][x].Qnet;
+		Sum->Soil.Qs += SoilMap[y][x].Qs;
+		Sum->Soil.Qe += SoilMap[y][x].Qe;
+		Sum->Soil.Qg += SoilMap[y][x].Qg;
+		Sum->Soil.Qst += SoilMap[y][x].Qst;
+		Sum->Soil.IExcess += SoilMap[y][x].IExcess;
+		Sum->Soil.DetentionStorage += SoilMap[y][x].DetentionStorage;
 		
 		if (Options->Infiltration == DYNAMIC)
-			Total->Soil.InfiltAcc += SoilMap[y][x].InfiltAcc;
+			Sum->Soil.InfiltAcc += SoilMap[y][x].InfiltAcc;
 		
-		Total->Soil.Runoff += SoilMap[y][x].Runoff;
-		Total->ChannelInt += SoilMap[y][x].ChannelInt;
+		Sum->Soil.Runoff += SoilMap[y][x].Runoff;
+		Sum->ChannelInt += SoilMap[y][x].ChannelInt;
 		SoilMap[y][x].ChannelInt = 0.0;
-		Total->RoadInt += SoilMap[y][x].RoadInt;
+		Sum->RoadInt += SoilMap[y][x].RoadInt;
 		SoilMap[y][x].RoadInt = 0.0;
-      }
-    }
+}
+
+/*****************************************************************************
+  AddAggregated()
+
+  Add the sums of the values that Aggregate() collects in Src to Dst
+*****************************************************************************/
+static void AddAggregated(LAYER *Soil, LAYER *Veg, OPTIONSTRUCT *Options,
+			  AGGREGATED *Src, AGGREGATED *Dst)
+{
+  int i;			/* counter */
+  int j;			/* counter */
+
+  Dst->Evap.ETot += Src->Evap.ETot;
+  for (i = 0; i < Veg->MaxLayers + 1; i++) {
+    Dst->Evap.EPot[i] += Src->Evap.EPot[i];
+    Dst->Evap.EAct[i] += Src->Evap.EAct[i];
+  }
+  for (i = 0; i < Veg->MaxLayers; i++) {
+    Dst->Evap.EInt[i] += Src->Evap.EInt[i];
+    for (j = 0; j < Soil->MaxLayers; j++)
+      Dst->Evap.ESoil[i][j] += Src->Evap.ESoil[i][j];
+  }
+  Dst->Evap.EvapSoil += Src->Evap.EvapSoil;
+
+  Dst->Precip.Precip += Src->Precip.Precip;
+  Dst->Precip.SnowFall += Src->Precip.SnowFall;
+  for (i = 0; i < Veg->MaxLayers; i++) {
+    Dst->Precip.IntRain[i] += Src->Precip.IntRain[i];
+    Dst->Precip.IntSnow[i] += Src->Precip.IntSnow[i];
+  }
+  Dst->CanopyWater += Src->CanopyWater;
+
+  Dst->Rad.Tair += Src->Rad.Tair;
+  Dst->Rad.ObsShortIn += Src->Rad.ObsShortIn;
+  Dst->Rad.BeamIn += Src->Rad.BeamIn;
+  Dst->Rad.DiffuseIn += Src->Rad.DiffuseIn;
+  AddRadiation(&(Src->Rad), &(Dst->Rad));
+  Dst->NetRad += Src->NetRad;
+
+  if (Src->Snow.HasSnow)
+    Dst->Snow.HasSnow = TRUE;
+  Dst->Snow.Swq += Src->Snow.Swq;
+  Dst->Snow.Glacier += Src->Snow.Glacier;
+  Dst->Snow.Melt += Src->Snow.Melt;
+  Dst->Snow.PackWater += Src->Snow.PackWater;
+  Dst->Snow.TPack += Src->Snow.TPack;
+  Dst->Snow.SurfWater += Src->Snow.SurfWater;
+  Dst->Snow.TSurf += Src->Snow.TSurf;
+  Dst->Snow.ColdContent += Src->Snow.ColdContent;
+  Dst->Snow.Albedo += Src->Snow.Albedo;
+  Dst->Snow.Depth += Src->Snow.Depth;
+  Dst->Snow.VaporMassFlux += Src->Snow.VaporMassFlux;
+  Dst->Snow.CanopyVaporMassFlux += Src->Snow.CanopyVaporMassFlux;
+
+  Dst->Soil.Depth += Src->Soil.Depth;
+  for (i = 0; i < Soil->MaxLayers; i++) {
+    Dst->Soil.Moist[i] += Src->Soil.Moist[i];
+    Dst->Soil.Perc[i] += Src->Soil.Perc[i];
+    Dst->Soil.Temp[i] += Src->Soil.Temp[i];
+  }
+  Dst->Soil.Moist[Soil->MaxLayers] += Src->Soil.Moist[Soil->MaxLayers];
+  Dst->SoilWater += Src->SoilWater;
+  Dst->Soil.TableDepth += Src->Soil.TableDepth;
+  Dst->Saturated += Src->Saturated;
+  Dst->SatExtent += Src->SatExtent;
+  Dst->Soil.WaterLevel += Src->Soil.WaterLevel;
+  Dst->Soil.SatFlow += Src->Soil.SatFlow;
+  Dst->Soil.TSurf += Src->Soil.TSurf;
+  Dst->Soil.Qnet += Src->Soil.Qnet;
+  Dst->Soil.Qs += Src->Soil.Qs;
+  Dst->Soil.Qe += Src->Soil.Qe;
+  Dst->Soil.Qg += Src->Soil.Qg;
+  Dst->Soil.Qst += Src->Soil.Qst;
+  Dst->Soil.IExcess += Src->Soil.IExcess;
+  Dst->Soil.DetentionStorage += Src->Soil.DetentionStorage;
+  if (Options->Infiltration == DYNAMIC)
+    Dst->Soil.InfiltAcc += Src->Soil.InfiltAcc;
+  Dst->Soil.Runoff += Src->Soil.Runoff;
+  Dst->ChannelInt += Src->ChannelInt;
+  Dst->RoadInt += Src->RoadInt;
+}
+
+/*****************************************************************************
+  AddFluxes()
+
+  Add the sums of the values that AggregateFluxes() collects in Src to Dst
+*****************************************************************************/
+static void AddFluxes(AGGREGATED *Src, AGGREGATED *Dst)
+{
+  Dst->Evap.ETot += Src->Evap.ETot;
+  Dst->Precip.Precip += Src->Precip.Precip;
+  Dst->Precip.SnowFall += Src->Precip.SnowFall;
+  Dst->Snow.VaporMassFlux += Src->Snow.VaporMassFlux;
+  Dst->Snow.CanopyVaporMassFlux += Src->Snow.CanopyVaporMassFlux;
+  Dst->Soil.IExcess += Src->Soil.IExcess;
+  Dst->ChannelInt += Src->ChannelInt;
+  Dst->RoadInt += Src->RoadInt;
+}
+
+/*****************************************************************************
+  Aggregate()
+  
+  Calculate the average values for the different fluxes and state variables
+  over the basin.  
+  In the current implementation the local radiation
+  elements are not stored for the entire area.  Therefore these components
+  are aggregated in AggregateRadiation() inside MassEnergyBalance().
+  
+  The aggregated values are set to zero in the function RestAggregate,
+  which is executed at the beginning of each time step.
+
+  The basin sums, including the saturation extent, Total->Saturated and the
+  radiation balance terms of the cells (AggregateRadiation()), are collected
+  in a single sweep over the active cells.  The cells are summed in blocks
+  of AGG_BLOCK cells, on Options->NThreads threads, and the block sums are
+  then added pairwise, in a fixed tree over the blocks.  The blocks and the
+  tree only depend on the number of cells, so the sums are the same with
+  any number of threads.
+*****************************************************************************/
+void Aggregate(MAPSIZE *Map, OPTIONSTRUCT *Options, TOPOPIX **TopoMap,
+	       LAYER *Soil, LAYER * Veg, CELLCLASSES *Classes, EVAPPIX **Evap,
+	       PRECIPPIX **Precip, PIXRAD **RadMap, SNOWPIX **Snow,
+	       SOILPIX **SoilMap, AGGREGATED *Total,
+	       ROADSTRUCT **Network, CHANNEL *ChannelData, float *roadarea)
+{
+  int NPixels;			/* Number of pixels in the basin */
+  int NBlocks;			/* Number of blocks of AGG_BLOCK cells */
+  int b;			/* block counter */
+  int Step;			/* distance of the blocks added in the tree */
+  int i;				/* counter */
+  int j;				/* counter */
+  int k;				/* active cell counter */
+
+  NPixels = Map->NumActive;
+  *roadarea = 0.;
+
+  /* sum over fixed blocks of cells, and add the block sums in block order. 
+     The result does not depend on the number of threads, and the rounding 
+     error grows with the block size plus the number of blocks rather than 
+     with the number of cells */
+  NBlocks = PartialBlocks(Map, Soil, Veg);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) private(k)
+#endif
+  for (b = 0; b < NBlocks; b++) {
+    /* ResetAggregate() leaves the glacier mass and the runoff, which are 
+       summed over the whole run in Total */
+    ResetAggregate(Soil, Veg, &(Partial[b]), Options);
+    Partial[b].Snow.Glacier = 0.0;
+    Partial[b].Soil.Runoff = 0.0;
+    memset(&(Partial[b].Rad), 0, sizeof(PIXRAD));
+    for (k = b * AGG_BLOCK; k < Map->NumActive && k < (b + 1) * AGG_BLOCK; k++)
+      AggregateCell(Map->ActiveCells[k].x, Map->ActiveCells[k].y, Options, 
+		    Soil, Veg, &(Classes->Class[Classes->Of[k]]), Evap, Precip,
+		    RadMap, Snow, SoilMap, Network, &(Partial[b]));
   }
+
+  for (Step = 1; Step < NBlocks; Step *= 2)
+    for (b = 0; b + Step < NBlocks; b += 2 * Step)
+      AddAggregated(Soil, Veg, Options, &(Partial[b + Step]), &(Partial[b]));
+  if (NBlocks > 0)
+    AddAggregated(Soil, Veg, Options, &(Partial[0]), Total);
+  if (Options->MM5 == TRUE) {
+    Total->Rad.BeamIn = NOT_APPLICABLE;
+    Total->Rad.DiffuseIn = NOT_APPLICABLE;
+  }
+
   /* divide road area by pixel area so it can be used to calculate depths
      over the road surface in FinalMassBalancs */
   *roadarea /= Map->DX * Map->DY * NPixels;
@@ -224,6 +421,7 @@ void Aggregate(MAPSIZE *Map, OPTIONSTRUCT *Options, TOPOPIX **TopoMap,
   }
   Total->Soil.Moist[Soil->MaxLayers] /= NPixels;
   Total->Soil.TableDepth /= NPixels;
+  Total->SatExtent *= 100. / NPixels;
   Total->Soil.WaterLevel /= NPixels;
   Total->Soil.SatFlow /= NPixels;
   Total->Soil.TSurf /= NPixels;
@@ -245,4 +443,79 @@ void Aggregate(MAPSIZE *Map, OPTIONSTRUCT *Options, TOPOPIX **TopoMap,
   Total->RoadInt /= NPixels;
   Total->CulvertReturnFlow /= NPixels;
   Total->CulvertToChannel /= NPixels;
+  Total->Full = TRUE;
+}
+
+/*****************************************************************************
+  AggregateFluxes()
+
+  Calculate the basin averages of only the fluxes and the ponded water that
+  MassBalance() adds up over the run, for the time steps between the full
+  aggregations (OUTPUT AGGREGATION INTERVAL).  The sums are collected in the
+  same blocks and tree as in Aggregate(), so that they are the same.  As
+  Aggregate(), the channel and road interception of the cells is reset.
+*****************************************************************************/
+void AggregateFluxes(MAPSIZE *Map, OPTIONSTRUCT *Options, LAYER *Soil,
+		     LAYER *Veg, EVAPPIX **Evap, PRECIPPIX **Precip,
+		     SNOWPIX **Snow, SOILPIX **SoilMap, AGGREGATED *Total)
+{
+  AGGREGATED *Sum;		/* sums of the block */
+  int NPixels;			/* Number of pixels in the basin */
+  int NBlocks;			/* Number of blocks of AGG_BLOCK cells */
+  int b;			/* block counter */
+  int Step;			/* distance of the blocks added in the tree */
+  int k;			/* active cell counter */
+  int x;
+  int y;
+
+  NPixels = Map->NumActive;
+  NBlocks = PartialBlocks(Map, Soil, Veg);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+private(k, x, y, Sum)
+#endif
+  for (b = 0; b < NBlocks; b++) {
+    Sum = &(Partial[b]);
+    Sum->Evap.ETot = 0.0;
+    Sum->Precip.Precip = 0.0;
+    Sum->Precip.SnowFall = 0.0;
+    Sum->Snow.VaporMassFlux = 0.0;
+    Sum->Snow.CanopyVaporMassFlux = 0.0;
+    Sum->Soil.IExcess = 0.0;
+    Sum->ChannelInt = 0.0;
+    Sum->RoadInt = 0.0;
+    for (k = b * AGG_BLOCK; k < Map->NumActive && k < (b + 1) * AGG_BLOCK; k++) {
+      x = Map->ActiveCells[k].x;
+      y = Map->ActiveCells[k].y;
+      Sum->Evap.ETot += Evap[y][x].ETot;
+      Sum->Precip.Precip += Precip[y][x].Precip;
+      Sum->Precip.SnowFall += Precip[y][x].SnowFall;
+      Sum->Snow.VaporMassFlux += Snow[y][x].VaporMassFlux;
+      Sum->Snow.CanopyVaporMassFlux += Snow[y][x].CanopyVaporMassFlux;
+      Sum->Soil.IExcess += SoilMap[y][x].IExcess;
+      Sum->ChannelInt += SoilMap[y][x].ChannelInt;
+      SoilMap[y][x].ChannelInt = 0.0;
+      Sum->RoadInt += SoilMap[y][x].RoadInt;
+      SoilMap[y][x].RoadInt = 0.0;
+    }
+  }
+
+  for (Step = 1; Step < NBlocks; Step *= 2)
+    for (b = 0; b + Step < NBlocks; b += 2 * Step)
+      AddFluxes(&(Partial[b + Step]), &(Partial[b]));
+  if (NBlocks > 0)
+    AddFluxes(&(Partial[0]), Total);
+
+  Total->Evap.ETot /= NPixels;
+  Total->Precip.Precip /= NPixels;
+  Total->Precip.SnowFall /= NPixels;
+  Total->Snow.VaporMassFlux /= NPixels;
+  Total->Snow.CanopyVaporMassFlux /= NPixels;
+  Total->Soil.IExcess /= NPixels;
+  Total->ChannelInt /= NPixels;
+  Total->RoadInt /= NPixels;
+  Total->CulvertReturnFlow /= NPixels;
+  Total->CulvertToChannel /= NPixels;
+  Total->Full = FALSE;
 }
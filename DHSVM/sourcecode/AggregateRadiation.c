@@ -8,7 +8,8 @@
  * ORIG-DATE:    Apr-96
  * DESCRIPTION:  Calculate basin-wide radiation
  * DESCRIP-END.
- * FUNCTIONS:    
+ * FUNCTIONS:    AggregateRadiation()
+ *               AddRadiation()
  * COMMENTS:
  * $Id: AggregateRadiation.c,v 1.4 2003/07/01 21:26:09 olivier Exp $     
  */
@@ -44,3 +45,28 @@ void AggregateRadiation(int MaxVegLayers, int NVegL, PIXRAD *Rad, PIXRAD *TotalR
   TotalRad->PixelLongOut += Rad->PixelLongOut;
 
 }
+
+/*****************************************************************************
+  AddRadiation()
+
+  Adds the per-thread or per-tile sums of AggregateRadiation() to the basin
+  sums.  The sums are added field by field: the partial sums already have
+  the layout that AggregateRadiation() gives the basin sums, so adding them
+  with AggregateRadiation() again would move the ground layer terms a
+  second time (into the fields that follow NetShort, LongIn and LongOut
+  when MaxVegLayers is 2) and the threaded results would differ from the
+  serial ones.
+*****************************************************************************/
+void AddRadiation(PIXRAD *Rad, PIXRAD *TotalRad)
+{
+  int i;			/* counter */
+
+  for (i = 0; i < 2; i++) {
+    TotalRad->NetShort[i] += Rad->NetShort[i];
+    TotalRad->LongIn[i] += Rad->LongIn[i];
+    TotalRad->LongOut[i] += Rad->LongOut[i];
+  }
+  TotalRad->PixelNetShort += Rad->PixelNetShort;
+  TotalRad->PixelLongIn += Rad->PixelLongIn;
+  TotalRad->PixelLongOut += Rad->PixelLongOut;
+}
@@ -0,0 +1,282 @@
+/*
+ * SUMMARY:      AutoTune.c - Thread count and tile size of the cell loops
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS AUTO TUNE the first steps of the run are run
+ *               a few times with different settings of the threaded cell
+ *               loops, and the run goes on with the fastest.  First the
+ *               thread counts 1, 2, 4, ... up to NUMBER OF THREADS are
+ *               timed with the CELL TILE SIZE of the configuration, then
+ *               the fastest count with fixed blocks (CELL TILE SIZE = 0)
+ *               and with tiles of a few sizes that are balanced by their
+ *               run time (TileSchedule.c).  Small basins are often
+ *               fastest with fewer threads than the machine has.
+ * DESCRIP-END.
+ * FUNCTIONS:    AutoTune()
+ *               HostType()
+ *               ReadTuneCache()
+ *               WriteTuneCache()
+ *               PrintSchedule()
+ * COMMENTS:     The trials are run by the caller (TuneTrial() in dhsvm.c),
+ *               each from the same model state and without output, so all
+ *               of them time the same steps.  The results of the model do
+ *               not depend on the settings.
+ *
+ *               The AUTO TUNE FILE keeps a line for each choice, with the
+ *               hash of the basin geometry (CheckpointGeometry()), the
+ *               type of the machine and the NUMBER OF THREADS.  A run that
+ *               finds its line there skips the trials.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "getinit.h"
+#include "autotune.h"
+
+/* CELL TILE SIZE candidates, 0 for fixed blocks */
+static const int TileSizes[] = { 0, 64, 256, 1024, 4096 };
+#define NTILESIZES ((int) (sizeof(TileSizes) / sizeof(TileSizes[0])))
+
+static void HostType(char *Host, size_t Size);
+static int ReadTuneCache(char *FileName, unint Basin, char *Host,
+			 int MaxThreads, int *NThreads, int *TileSize);
+static void WriteTuneCache(char *FileName, unint Basin, char *Host,
+			   int MaxThreads, int NThreads, int TileSize,
+			   double Seconds);
+static void PrintSchedule(int NThreads, int TileSize);
+
+/*****************************************************************************
+  Function name: AutoTune()
+
+  Purpose      : Choose the thread count and tile size of the cell loops
+
+  Required     :
+    OPTIONSTRUCT *Options - NUMBER OF THREADS, CELL TILE SIZE, AUTO TUNE
+                            FILE
+    MAPSIZE *Map          - basin
+    int NItems            - items of the pixel loop
+    int NSteps            - steps of each trial
+    TUNETRIAL Trial       - runs the trial steps
+
+  Returns      : void
+
+  Modifies     : Options->NThreads and Options->CellTileSize
+
+  Comments     : The caller makes the schedules of the cell loops for the
+                 settings, before each trial and after the choice
+*****************************************************************************/
+void AutoTune(OPTIONSTRUCT *Options, MAPSIZE *Map, int NItems, int NSteps,
+	      TUNETRIAL Trial)
+{
+  char Host[BUFSIZE + 1];	/* type of the machine */
+  unint Basin;			/* hash of the basin geometry */
+  int MaxThreads;		/* NUMBER OF THREADS */
+  int TileSize;			/* CELL TILE SIZE of the configuration */
+  int BestThreads;
+  int BestTile;
+  double Best;			/* time of the fastest trial (s) */
+  double Seconds;
+  int i;
+  int n;
+
+  MaxThreads = Options->NThreads;
+  TileSize = Options->CellTileSize;
+  Basin = CheckpointGeometry(Map);
+  HostType(Host, sizeof(Host));
+
+  if (!IsEmptyStr(Options->AutoTuneFile) &&
+      ReadTuneCache(Options->AutoTuneFile, Basin, Host, MaxThreads,
+		    &(Options->NThreads), &(Options->CellTileSize))) {
+    printf("Settings of the cell loops from %s: ", Options->AutoTuneFile);
+    PrintSchedule(Options->NThreads, Options->CellTileSize);
+    printf("\n");
+    return;
+  }
+
+  printf("Tuning the cell loops over %d step%s\n", NSteps,
+	 (NSteps > 1) ? "s" : "");
+
+  /* the first trial brings the model state and the input into the caches,
+     it is not counted */
+  Trial();
+
+  /* the thread counts with the tiles of the configuration */
+  BestThreads = MaxThreads;
+  BestTile = TileSize;
+  Best = -1.0;
+  for (n = 1;; n *= 2) {
+    if (n > MaxThreads)
+      n = MaxThreads;
+    Options->NThreads = n;
+    Options->CellTileSize = TileSize;
+    Seconds = Trial();
+    printf("  %8.3f s  ", Seconds);
+    PrintSchedule(n, TileSize);
+    printf("\n");
+    if (Best < 0.0 || Seconds < Best) {
+      Best = Seconds;
+      BestThreads = n;
+    }
+    if (n == MaxThreads)
+      break;
+  }
+
+  /* fixed blocks and the tile sizes with at least two tiles a thread, with
+     the fastest thread count */
+  for (i = 0; BestThreads > 1 && i < NTILESIZES; i++) {
+    if (TileSizes[i] == TileSize ||
+	(TileSizes[i] > 0 && NItems < 2 * BestThreads * TileSizes[i]))
+      continue;
+    Options->NThreads = BestThreads;
+    Options->CellTileSize = TileSizes[i];
+    Seconds = Trial();
+    printf("  %8.3f s  ", Seconds);
+    PrintSchedule(BestThreads, TileSizes[i]);
+    printf("\n");
+    if (Seconds < Best) {
+      Best = Seconds;
+      BestTile = TileSizes[i];
+    }
+  }
+
+  Options->NThreads = BestThreads;
+  Options->CellTileSize = BestTile;
+  printf("Running the cell loops with ");
+  PrintSchedule(BestThreads, BestTile);
+  printf(", %.3f s per step\n", Best / NSteps);
+
+  if (!IsEmptyStr(Options->AutoTuneFile))
+    WriteTuneCache(Options->AutoTuneFile, Basin, Host, MaxThreads,
+		   BestThreads, BestTile, Best / NSteps);
+}
+
+/*****************************************************************************
+  HostType()
+
+  Type of the machine: the architecture, the number of processors and the
+  processor model, without blanks
+*****************************************************************************/
+static void HostType(char *Host, size_t Size)
+{
+  struct utsname Name;
+  char Line[BUFSIZE + 1];
+  char Model[BUFSIZE + 1];
+  FILE *CpuInfo;
+  char *Value;
+  char *c;
+
+  if (uname(&Name) != 0)
+    strcpy(Name.machine, "unknown");
+
+  /* the processor model is only known on Linux */
+  strcpy(Model, "unknown");
+  if ((CpuInfo = fopen("/proc/cpuinfo", "r")) != NULL) {
+    while (fgets(Line, BUFSIZE + 1, CpuInfo) != NULL) {
+      if (strncmp(Line, "model name", 10) == 0 &&
+	  (Value = strchr(Line, ':')) != NULL) {
+	for (Value++; isspace((unsigned char) *Value); Value++)
+	  ;
+	strcpy(Model, Value);
+	break;
+      }
+    }
+    fclose(CpuInfo);
+  }
+
+  snprintf(Host, Size, "%s/%ld/%s", Name.machine,
+	   (long) sysconf(_SC_NPROCESSORS_ONLN), Model);
+  for (c = Host + strlen(Host) - 1; c >= Host && isspace((unsigned char) *c);
+       c--)
+    *c = '\0';
+  for (c = Host; *c != '\0'; c++) {
+    if (isspace((unsigned char) *c))
+      *c = '_';
+  }
+}
+
+/*****************************************************************************
+  ReadTuneCache()
+
+  Looks up the settings of the basin, the machine and the NUMBER OF THREADS
+  in the AUTO TUNE FILE.  The last line that matches is used.  Returns
+  FALSE if there is none, or if the file does not exist yet.
+*****************************************************************************/
+static int ReadTuneCache(char *FileName, unint Basin, char *Host,
+			 int MaxThreads, int *NThreads, int *TileSize)
+{
+  FILE *CacheFile;
+  char Line[2 * BUFSIZE + 1];
+  char LineHost[BUFSIZE + 1];
+  unsigned int LineBasin;
+  int LineMax;
+  int LineThreads;
+  int LineTile;
+  double Seconds;
+  int Found;
+
+  if ((CacheFile = fopen(FileName, "r")) == NULL)
+    return FALSE;
+
+  Found = FALSE;
+  while (fgets(Line, 2 * BUFSIZE + 1, CacheFile) != NULL) {
+    if (Line[0] == '#')
+      continue;
+    if (sscanf(Line, "%x %255s %d %d %d %lf", &LineBasin, LineHost, &LineMax,
+	       &LineThreads, &LineTile, &Seconds) != 6)
+      continue;
+    if (LineBasin == (unsigned int) Basin && strcmp(LineHost, Host) == 0 &&
+	LineMax == MaxThreads && LineThreads >= 1 &&
+	LineThreads <= MaxThreads && LineTile >= 0) {
+      *NThreads = LineThreads;
+      *TileSize = LineTile;
+      Found = TRUE;
+    }
+  }
+  fclose(CacheFile);
+  return Found;
+}
+
+/*****************************************************************************
+  WriteTuneCache()
+
+  Adds the choice to the AUTO TUNE FILE
+*****************************************************************************/
+static void WriteTuneCache(char *FileName, unint Basin, char *Host,
+			   int MaxThreads, int NThreads, int TileSize,
+			   double Seconds)
+{
+  FILE *CacheFile;
+
+  if ((CacheFile = fopen(FileName, "a")) == NULL)
+    ReportError(FileName, 3);
+  if (ftell(CacheFile) == 0)
+    fprintf(CacheFile, "# basin machine number_of_threads threads "
+	    "cell_tile_size seconds_per_step\n");
+  fprintf(CacheFile, "%08x %s %d %d %d %.6f\n", (unsigned int) Basin, Host,
+	  MaxThreads, NThreads, TileSize, Seconds);
+  if (fclose(CacheFile) != 0)
+    ReportError(FileName, 72);
+}
+
+/*****************************************************************************
+  PrintSchedule()
+*****************************************************************************/
+static void PrintSchedule(int NThreads, int TileSize)
+{
+  printf("%d thread%s", NThreads, (NThreads > 1) ? "s" : "");
+  if (NThreads > 1 && TileSize > 0)
+    printf(", tiles of %d cells", TileSize);
+  else if (NThreads > 1)
+    printf(", fixed blocks");
+}
@@ -0,0 +1,254 @@
+/*
+ * SUMMARY:      Batch.c - Run the basins of a manifest in one job
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Runs the basin configuration files listed in a manifest,
+ *               each as a stand-alone run in a worker process of its own,
+ *               with a number of workers running at the same time.  Reports
+ *               the throughput of the batch in basin-years per hour
+ * DESCRIP-END.
+ * FUNCTIONS:    dhsvm_run_batch()
+ *               ReadManifest()
+ *               RunBasin()
+ * COMMENTS:     The model state of libdhsvm is held once per process, so
+ *               the basins cannot run in threads of one process.  Each
+ *               worker is a process created with fork() from the batch,
+ *               which saves starting the program for every basin, and a
+ *               new worker starts as soon as one ends, so that the cores of
+ *               the job are kept busy with many small basins.
+ *
+ *               A basin runs as with "DHSVM config": its paths are relative
+ *               to the directory of the batch, its output goes to the
+ *               OUTPUT DIRECTORY of its configuration file, and its
+ *               messages go to the log file of its manifest line.  Basins
+ *               that read the same forcing or table files share them
+ *               through the file cache of the node, and through STATIC
+ *               DATA SHARE for the static maps of the same basin.  The
+ *               threads of the workers should not be pinned (THREAD
+ *               PINNING = NONE), since they would all be pinned to the same
+ *               processors.  Needs HAVE_FORK.
+ *
+ *               A line of the manifest is the configuration file of a basin
+ *               and, optionally, its log file, which defaults to the
+ *               configuration file with .log appended.  Empty lines and
+ *               lines that start with # are skipped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#ifdef HAVE_FORK
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#endif
+#include "settings.h"
+#include "DHSVMerror.h"
+#include "dhsvm.h"
+
+#define SECONDS_PER_YEAR (365.25 * 86400.)
+
+/* a basin of the manifest */
+typedef struct {
+  char Config[BUFSIZE + 1];	/* configuration file */
+  char Log[BUFSIZE + 1];	/* file for the messages of the run */
+} BATCHBASIN;
+
+#ifdef HAVE_FORK
+static int ReadManifest(const char *Manifest, BATCHBASIN **Basin);
+static void RunBasin(BATCHBASIN *Basin, double *Simulated);
+#endif
+
+/*****************************************************************************
+  dhsvm_run_batch()
+
+  Runs the basins of Manifest with at most NWorkers of them at the same
+  time, or as many as there are processors if NWorkers < 1.  Prints a line
+  for each basin that ends and the throughput of the batch.  Returns the
+  number of basins that failed.
+*****************************************************************************/
+int dhsvm_run_batch(const char *Manifest, int NWorkers)
+{
+  const char *Routine = "dhsvm_run_batch";
+#ifdef HAVE_FORK
+  BATCHBASIN *Basin;		/* basins of the manifest */
+  double *Simulated;		/* seconds simulated by each basin, written
+				   by its worker */
+  double *Started;		/* wall time at the start of each basin */
+  double Wall;			/* wall time of the batch */
+  double Years;			/* basin-years simulated */
+  struct timeval Now;
+  pid_t *Worker;		/* process of each basin, 0 once ended */
+  pid_t Pid;
+  int NBasins;
+  int NRunning;			/* number of workers running */
+  int NFailed;			/* number of basins that did not finish */
+  int Status;
+  int b;			/* counter */
+  int i;			/* counter */
+
+  NBasins = ReadManifest(Manifest, &Basin);
+
+  if (NWorkers < 1)
+    NWorkers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (NWorkers < 1)
+    NWorkers = 1;
+  if (NWorkers > NBasins)
+    NWorkers = NBasins;
+
+  /* the workers report the time they simulated in memory shared with the
+     batch */
+  Simulated = (double *) mmap(NULL, NBasins * sizeof(double),
+			      PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (Simulated == MAP_FAILED)
+    ReportError((char *) Routine, 1);
+  if (!(Started = (double *) calloc(NBasins, sizeof(double))))
+    ReportError((char *) Routine, 1);
+  if (!(Worker = (pid_t *) calloc(NBasins, sizeof(pid_t))))
+    ReportError((char *) Routine, 1);
+
+  printf("Running %d basins of %s with %d workers\n", NBasins, Manifest,
+	 NWorkers);
+  fflush(NULL);
+
+  gettimeofday(&Now, NULL);
+  Wall = Now.tv_sec + Now.tv_usec * 1e-6;
+  NRunning = 0;
+  NFailed = 0;
+  Years = 0.;
+  for (b = 0; b < NBasins || NRunning > 0;) {
+    if (b < NBasins && NRunning < NWorkers) {
+      Simulated[b] = 0.;
+      gettimeofday(&Now, NULL);
+      Started[b] = Now.tv_sec + Now.tv_usec * 1e-6;
+      if ((Pid = fork()) < 0)
+	ReportError((char *) Routine, 1);
+      if (Pid == 0) {
+	RunBasin(&(Basin[b]), &(Simulated[b]));
+	_exit(EXIT_SUCCESS);
+      }
+      Worker[b++] = Pid;
+      NRunning++;
+      continue;
+    }
+
+    /* wait for a worker to end before starting the next basin */
+    if ((Pid = wait(&Status)) <= 0)
+      break;
+    for (i = 0; i < b && Worker[i] != Pid; i++)
+      ;
+    if (i == b)
+      continue;
+    Worker[i] = 0;
+    NRunning--;
+    gettimeofday(&Now, NULL);
+    if (WIFEXITED(Status) && WEXITSTATUS(Status) == EXIT_SUCCESS) {
+      Years += Simulated[i] / SECONDS_PER_YEAR;
+      printf("Basin %d %s: %.2f years in %.1f s\n", i + 1, Basin[i].Config,
+	     Simulated[i] / SECONDS_PER_YEAR,
+	     Now.tv_sec + Now.tv_usec * 1e-6 - Started[i]);
+    }
+    else {
+      NFailed++;
+      printf("Basin %d %s: FAILED, see %s\n", i + 1, Basin[i].Config,
+	     Basin[i].Log);
+    }
+    fflush(stdout);
+  }
+  gettimeofday(&Now, NULL);
+  Wall = Now.tv_sec + Now.tv_usec * 1e-6 - Wall;
+
+  printf("\nBatch of %d basins: %d finished, %d failed\n", NBasins,
+	 NBasins - NFailed, NFailed);
+  printf("%.2f basin-years in %.1f s, %.1f basin-years per hour\n", Years,
+	 Wall, Wall > 0. ? Years * 3600. / Wall : 0.);
+
+  munmap(Simulated, NBasins * sizeof(double));
+  free(Started);
+  free(Worker);
+  free(Basin);
+  return NFailed;
+#else
+  ReportError((char *) Routine, 79);
+  return -1;
+#endif
+}
+
+#ifdef HAVE_FORK
+/*****************************************************************************
+  ReadManifest()
+
+  Reads the basins of Manifest into *Basin and returns their number
+*****************************************************************************/
+static int ReadManifest(const char *Manifest, BATCHBASIN **Basin)
+{
+  const char *Routine = "ReadManifest";
+  FILE *InFile;
+  char Line[BUFSIZE + 1];
+  char Config[BUFSIZE + 1];
+  char Log[BUFSIZE + 1];
+  int NBasins;
+  int MaxBasins;
+  int n;
+
+  if (!(InFile = fopen(Manifest, "r")))
+    ReportError((char *) Manifest, 3);
+
+  NBasins = 0;
+  MaxBasins = 64;
+  if (!(*Basin = (BATCHBASIN *) calloc(MaxBasins, sizeof(BATCHBASIN))))
+    ReportError((char *) Routine, 1);
+
+  while (fgets(Line, sizeof(Line), InFile)) {
+    n = sscanf(Line, "%s %s", Config, Log);
+    if (n < 1 || Config[0] == '#')
+      continue;
+    if (NBasins == MaxBasins) {
+      MaxBasins *= 2;
+      if (!(*Basin = (BATCHBASIN *) realloc(*Basin,
+					    MaxBasins * sizeof(BATCHBASIN))))
+	ReportError((char *) Routine, 1);
+    }
+    strcpy((*Basin)[NBasins].Config, Config);
+    if (n == 2)
+      strcpy((*Basin)[NBasins].Log, Log);
+    else
+      snprintf((*Basin)[NBasins].Log, BUFSIZE + 1, "%s.log", Config);
+    NBasins++;
+  }
+  fclose(InFile);
+
+  if (NBasins == 0)
+    ReportError((char *) Manifest, 5);
+  return NBasins;
+}
+
+/*****************************************************************************
+  RunBasin()
+
+  Runs a basin in a worker, with its messages in its log file, and leaves
+  the model time it simulated in *Simulated.  Exits on errors as a
+  stand-alone run does.
+*****************************************************************************/
+static void RunBasin(BATCHBASIN *Basin, double *Simulated)
+{
+  fflush(NULL);
+  if (!freopen(Basin->Log, "w", stdout))
+    ReportError(Basin->Log, 3);
+  dup2(fileno(stdout), fileno(stderr));
+
+  if (dhsvm_initialize(Basin->Config) != 0)
+    exit(EXIT_FAILURE);
+  while (!dhsvm_update())
+    *Simulated += dhsvm_get_time_step();
+  *Simulated += dhsvm_get_time_step();
+  dhsvm_finalize();
+  fflush(NULL);
+}
+#endif
@@ -40,21 +40,41 @@
                         due to channel/road-cut.  Multiplied with RootDepth
                         to give the layer thickness for use in calculating
                         soil moisture
+     SOILCAPACITY *Capacity - Constants of the soil column from
+                        InitSoilCapacity() for TotalDepth, NULL for another
+                        depth
+     float BankHeight - Depth of the road cut or stream bank (m), 0 for a
+                        cell without one
+     float *BankWater - Water available for saturated flow above
+                        BankHeight, NULL if not wanted
 
 
    Returns      :
      float AvailableWater - Total water available for saturated flow
+                        above TotalDepth
 
-   Modifies     : void
+   Modifies     : *BankWater
 
-   Comments     :
+   Comments     : Both depths are integrated in the same pass over the
+                  layers, with the same operations as two separate calls,
+                  so RouteSubSurface() evaluates each cell once.  A depth
+                  that the water table is not above gives 0.  With a water
+                  table below the root layers only the deep layer has water
+                  above field capacity, and with Capacity that is all that
+                  is left to compute for TotalDepth
  *****************************************************************************/
 float CalcAvailableWater(int NRootLayers, float TotalDepth, float *RootDepth,
-  float *Porosity, float *FCap, float TableDepth,  float *Adjust)
+  float *Porosity, float *FCap, float TableDepth,  float *Adjust,
+  SOILCAPACITY *Capacity, float BankHeight, float *BankWater)
 
 {
   float AvailableWater;		/* amount of water available for movement (m) */
 
+  float BankAvailable;		/* the same above BankHeight */
+
+  float BankDepth;		/* depth below the ground surface, down to
+				   BankHeight (m) */
+
   float DeepFCap;		    /* field capacity of the layer below the  deepest root layer */
 
   float DeepLayerDepth;		/* depth of layer below deepest root zone layer */
@@ -62,30 +82,63 @@ float CalcAvailableWater(int NRootLayers, float TotalDepth, float *RootDepth,
   float DeepPorosity;		/* porosity of the layer below the deepest root layer */
 
   float Depth;			    /* depth below the ground surface (m) */
+  int Column;			/* TRUE if TotalDepth is left to integrate */
+  int Bank;			/* TRUE if BankHeight is */
   int i;			        /* counter */
 
   AvailableWater = 0;
+  BankAvailable = 0;
 
-  Depth = 0.0;
-  for (i = 0; i < NRootLayers && Depth < TotalDepth; i++) {
-    if (RootDepth[i] < (TotalDepth - Depth))
-      Depth += RootDepth[i];
+  Column = (TableDepth < TotalDepth);
+  Bank = (BankWater != NULL && TableDepth < BankHeight);
+
+  if (Column && Capacity != NULL && TableDepth >= Capacity->RootBottom) {
+    if (Capacity->RootBottom >= TotalDepth)
+      AvailableWater = 0.0;
+    else if ((TotalDepth - TableDepth) > (TotalDepth - Capacity->RootBottom))
+      AvailableWater = Capacity->DeepAvailable;
     else
-      Depth = TotalDepth;
-    if (Depth > TableDepth) {
-      if ((Depth - TableDepth) > RootDepth[i])
-        AvailableWater += (Porosity[i] - FCap[i]) * RootDepth[i] * Adjust[i];
+      AvailableWater = (Porosity[NRootLayers - 1] - FCap[NRootLayers - 1]) *
+	(TotalDepth - TableDepth) * Adjust[NRootLayers];
+    Column = FALSE;
+  }
+
+  Depth = 0.0;
+  BankDepth = 0.0;
+  for (i = 0; i < NRootLayers && ((Column && Depth < TotalDepth) ||
+				  (Bank && BankDepth < BankHeight)); i++) {
+    if (Column && Depth < TotalDepth) {
+      if (RootDepth[i] < (TotalDepth - Depth))
+	Depth += RootDepth[i];
+      else
+	Depth = TotalDepth;
+      if (Depth > TableDepth) {
+	if ((Depth - TableDepth) > RootDepth[i])
+	  AvailableWater += (Porosity[i] - FCap[i]) * RootDepth[i] * Adjust[i];
+	else
+	  AvailableWater += (Porosity[i] - FCap[i]) * (Depth - TableDepth) *
+	    Adjust[i];
+      }
+    }
+    if (Bank && BankDepth < BankHeight) {
+      if (RootDepth[i] < (BankHeight - BankDepth))
+	BankDepth += RootDepth[i];
       else
-        AvailableWater += (Porosity[i] - FCap[i]) * (Depth - TableDepth) *
-        Adjust[i];
+	BankDepth = BankHeight;
+      if (BankDepth > TableDepth) {
+	if ((BankDepth - TableDepth) > RootDepth[i])
+	  BankAvailable += (Porosity[i] - FCap[i]) * RootDepth[i] * Adjust[i];
+	else
+	  BankAvailable += (Porosity[i] - FCap[i]) * (BankDepth - TableDepth) *
+	    Adjust[i];
+      }
     }
   }
 
-  if (Depth < TotalDepth) {
-
-    DeepPorosity = Porosity[NRootLayers - 1];
-    DeepFCap = FCap[NRootLayers - 1];
+  DeepPorosity = Porosity[NRootLayers - 1];
+  DeepFCap = FCap[NRootLayers - 1];
 
+  if (Column && Depth < TotalDepth) {
     DeepLayerDepth = TotalDepth - Depth;
     Depth = TotalDepth;
 
@@ -97,6 +150,20 @@ float CalcAvailableWater(int NRootLayers, float TotalDepth, float *RootDepth,
       Adjust[NRootLayers];
   }
 
-  assert(AvailableWater >= 0.0);
+  if (Bank && BankDepth < BankHeight) {
+    DeepLayerDepth = BankHeight - BankDepth;
+    BankDepth = BankHeight;
+
+    if ((BankDepth - TableDepth) > DeepLayerDepth)
+      BankAvailable += (DeepPorosity - DeepFCap) * DeepLayerDepth *
+      Adjust[NRootLayers];
+    else
+      BankAvailable += (DeepPorosity - DeepFCap) * (BankDepth - TableDepth) *
+      Adjust[NRootLayers];
+  }
+
+  assert(AvailableWater >= 0.0 && BankAvailable >= 0.0);
+  if (BankWater != NULL)
+    *BankWater = BankAvailable;
   return AvailableWater;
 }
@@ -10,7 +10,10 @@
  *               dry conditions
  * DESCRIP-END.
  * FUNCTIONS:    CalcEffectiveKh()
- * COMMENTS:
+ *               CalcSaturatedKh()
+ * COMMENTS:     The saturated conductivities of the soil layers only depend
+ *               on the soil type, they are computed once for each type by
+ *               CalcSaturatedKh() in InitSoilTable()
  * $Id: CalcEffectiveKh.c,v 1.4 2003/07/01 21:26:10 olivier Exp $     
  */
 
@@ -31,19 +34,21 @@
   This function calculates the effective thermal conductivity of a soil 
   based on the thermal conductivity under dry conditions, KhDry, and the
   thermal conductivity under saturated conditions, KhSat.  The latter
-  differs for frozen and unfrozen soils, and is function of the effective
-  solids thermal conductivity, KhSol, and the saturates soil moisture or 
-  ice content.  
+  differs for frozen and unfrozen soils, KhSatFrozen and KhSatThawed of
+  CalcSaturatedKh(), and is function of the effective solids thermal
+  conductivity, KhSol, and the saturates soil moisture or ice content.
 
   The method followed here is Johansen's method, section 7.11 [Farouk, 1986]
  
   First the effective conductivity is calculated for each layer, after which
   the total effective thermal conductivity is calculated for the specified 
-  depth.
+  depth.  The layers are added to the series as they are found, the last
+  one once its depth is known, in the order of the layers.
 *****************************************************************************/
 float CalcEffectiveKh(int NSoilLayers, float Top, float Bottom,
-		      float *SoilDepth, float *KhDry, float *KhSol,
-		      float *Moisture, float *Porosity, float *TSoil)
+		      float *SoilDepth, float *KhDry, float *KhSatFrozen,
+		      float *KhSatThawed, float *Moisture, float *Porosity,
+		      float *TSoil)
 {
   char NoEndLayer;		/* flag to indicate whether an end layer
 				   has been determined */
@@ -55,99 +60,93 @@ float CalcEffectiveKh(int NSoilLayers, float Top, float Bottom,
 				   (W/(m*K)) */
   float KhSat;			/* Thermal conductivity for saturated soils
 				   (W/(m*K)) */
-  float *LayerDepth;		/* Depth of each layer above the specified
-				   depth (m) */
-  float *LayerKh;		/* Effective thermal conductivity for each 
-				   soil layer above the specified depth 
-				   (W/(m*K)) */
+  float LayerDepth = 0.0;	/* Depth of the last layer above the
+				   specified depth (m) */
+  float LayerKh = 0.0;		/* Effective thermal conductivity of that
+				   layer (W/(m*K)) */
   float Sr;			/* degree of saturation */
   float TotalDepth;		/* Depth of soil column for which to 
 				   calculate the effective thermal 
 				   conductivity (m) */
   int i;			/* counter */
-  int NLayers;			/* Number of soil layers in depth interval */
-  int StartLayer = 0;		/* First layer below top */
 
   TotalDepth = Bottom - Top;
 
   Dz = 0.0;
-  NLayers = 0;
+  KhEff = 0.0;
   NoStartLayer = TRUE;
   NoEndLayer = TRUE;
-  LayerDepth = NULL;
 
   for (i = 0; i < NSoilLayers && NoEndLayer; i++) {
     Dz += SoilDepth[i];
 
     if (Dz > Top) {
-      NLayers++;
-      if (!(LayerDepth = (float *) realloc(LayerDepth, NLayers *
-					   sizeof(float))))
-	ReportError("CalcEffectiveKh()", 1);
+      /* the layer before is complete, place it in series */
+      if (!NoStartLayer)
+	KhEff += LayerDepth / TotalDepth / LayerKh;
 
       if (NoStartLayer) {
-	StartLayer = i;
-	LayerDepth[i - StartLayer] = Dz - Top;
+	LayerDepth = Dz - Top;
 	NoStartLayer = FALSE;
       }
       else if (Dz > Bottom) {
-	LayerDepth[i - StartLayer] = SoilDepth[i] + Bottom - Dz;
+	LayerDepth = SoilDepth[i] + Bottom - Dz;
 	NoEndLayer = FALSE;
       }
       else
-	LayerDepth[i - StartLayer] = SoilDepth[i];
-    }
-  }
-
-  /* If the soil column is thinner than Bottom, than assign the soil 
-     properties of the bottom layer to the remainder of the soil profile */
+	LayerDepth = SoilDepth[i];
 
-  if (NoEndLayer)
-    LayerDepth[NLayers - 1] += Bottom - Dz;
-
-  if (!(LayerKh = (float *) calloc(NLayers, sizeof(float))))
-    ReportError("CalcEffectiveKh()", 1);
-
-  for (i = 0; i < NLayers; i++) {
-
-    Sr = Moisture[i + StartLayer] / Porosity[i + StartLayer];
+      Sr = Moisture[i] / Porosity[i];
 
-    /* Assume for now that either all the water is either frozen or unfrozen */
+      /* Assume for now that either all the water is either frozen or
+         unfrozen */
 
-    /* frozen soil */
+      /* frozen soil */
+      if (TSoil[i] < 0) {
+	Ke = Sr;
+	KhSat = KhSatFrozen[i];
+      }
 
-    if (TSoil[i + StartLayer] < 0) {
-      Ke = Sr;
-      KhSat = pow((double) KhSol[i + StartLayer],
-		  (double) (1 - Porosity[i + StartLayer])) *
-	pow((double) 2.2, (double) Porosity[i + StartLayer]);
+      /* unfrozen soil */
+      else {
+	if (Sr > 0.1)
+	  Ke = log10((double) Sr) + 1.0;
+	else
+	  Ke = 0.0;
+	KhSat = KhSatThawed[i];
+      }
+      LayerKh = (KhSat - KhDry[i]) * Ke + KhDry[i];
     }
+  }
 
-    /* unfrozen soil */
+  /* If the soil column is thinner than Bottom, than assign the soil 
+     properties of the bottom layer to the remainder of the soil profile */
 
-    else {
-      if (Sr > 0.1)
-	Ke = log10((double) Sr) + 1.0;
-      else
-	Ke = 0.0;
-      KhSat = pow((double) KhSol[i + StartLayer],
-		  (double) (1 - Porosity[i + StartLayer])) *
-	pow((double) KhH2O, (double) Porosity[i + StartLayer]);
-    }
-    LayerKh[i] = (KhSat - KhDry[i + StartLayer]) * Ke + KhDry[i + StartLayer];
-  }
+  if (NoEndLayer)
+    LayerDepth += Bottom - Dz;
 
-  /* Now place the soil layers in series, and calculate the resulting effective
-     thermal conductivity for the entire soil */
+  /* Now place the last soil layer in series, and calculate the resulting
+     effective thermal conductivity for the entire soil */
 
-  KhEff = 0.0;
-  for (i = 0; i < NLayers; i++)
-    KhEff += LayerDepth[i] / TotalDepth / LayerKh[i];
+  KhEff += LayerDepth / TotalDepth / LayerKh;
   KhEff = 1.0 / KhEff;
 
-  /* clean up */
-  free(LayerKh);
-  free(LayerDepth);
-
   return KhEff;
 }
+
+/*****************************************************************************
+  CalcSaturatedKh()
+
+  Thermal conductivity of a saturated soil layer with solids conductivity
+  KhSol and porosity Porosity, frozen (ice, 2.2 W/(m*K)) and unfrozen
+  (water, KhH2O), the geometric mean of Johansen's method, section 7.11
+  [Farouki, 1986]
+*****************************************************************************/
+void CalcSaturatedKh(float KhSol, float Porosity, float *KhSatFrozen,
+		     float *KhSatThawed)
+{
+  *KhSatFrozen = pow((double) KhSol, (double) (1 - Porosity)) *
+    pow((double) 2.2, (double) Porosity);
+  *KhSatThawed = pow((double) KhSol, (double) (1 - Porosity)) *
+    pow((double) KhH2O, (double) Porosity);
+}
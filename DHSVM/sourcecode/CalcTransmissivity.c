@@ -10,6 +10,8 @@
  *               the soil profile
  * DESCRIP-END.
  * FUNCTIONS:    CalcTransmissivity()
+ *               InitTransmissivityTable()
+ *               SoilTransmissivity()
  * COMMENTS: Modified by Ted Bohn on 10/1/2013
              Implemented 2-part transmissivity v depth function. 
              Introduced a new parameter, DEPTH_THRESHOLD.  When water table depth 
@@ -28,6 +30,12 @@
 #include <stdlib.h>
 #include "settings.h"
 #include "functions.h"
+#include "fastmath.h"
+
+#ifndef TRANS_TABLE_DEPTH
+#define TRANS_TABLE_DEPTH 10.0	/* depth (m) covered by TransTable, deeper
+				   soils use the exact function */
+#endif
 
 /*****************************************************************************
   Function name: CalcTransmissivity()
@@ -70,10 +78,10 @@ float CalcTransmissivity(float SoilDepth, float WaterTable, float LateralKs,
   else {
 	/* a smaller value of WaterTable variables indicates a higher actual water table depth */
 	if (WaterTable < DepthThresh) {
-	  Transmissivity = (LateralKs / KsExponent) * (exp(-KsExponent * WaterTable) - exp(-KsExponent * SoilDepth));
+	  Transmissivity = (LateralKs / KsExponent) * (MathExp(-KsExponent * WaterTable) - MathExp(-KsExponent * SoilDepth));
 	}
     else  {
-	  TransThresh = (LateralKs / KsExponent) * (exp(-KsExponent * DepthThresh) - exp(-KsExponent * SoilDepth));
+	  TransThresh = (LateralKs / KsExponent) * (MathExp(-KsExponent * DepthThresh) - MathExp(-KsExponent * SoilDepth));
 	  if(SoilDepth < DepthThresh) {
 		printf("Warning: Soil DepthThreshold (%.2f) > the soil depth (%.2f)!\n", DepthThresh, SoilDepth);
 		printf("Transmissivity is set to zero!");
@@ -84,3 +92,74 @@ float CalcTransmissivity(float SoilDepth, float WaterTable, float LateralKs,
 
   return Transmissivity;
 }
+
+/*****************************************************************************
+  Function name: InitTransmissivityTable()
+
+  Purpose      : Tabulate exp(-KsLatExp * z) for a soil type, for use in
+                 SoilTransmissivity()
+                 
+  Required     : 
+    SOILTABLE *SType - Soil type
+    int Size         - Number of entries, 0 for no table
+
+  Returns      : void
+
+  Modifies     : SType->TransTable
+
+  Comments     : The table covers depths from 0 to TRANS_TABLE_DEPTH.  
+                 Linear interpolation gives a relative error of about 
+                 (KsLatExp * Delta)^2 / 8.
+*****************************************************************************/
+void InitTransmissivityTable(SOILTABLE *SType, int Size)
+{
+  int i;
+  double Delta;
+
+  SType->TransTable.Data = NULL;
+  if (Size == 0 || fequal(SType->KsLatExp, 0.0))
+    return;
+
+  Delta = TRANS_TABLE_DEPTH / (Size - 1);
+  InitInterpTable(Size, 0.0, (float) Delta, &(SType->TransTable));
+  for (i = 0; i < Size; i++)
+    SType->TransTable.Data[i] = exp(-SType->KsLatExp * (i * Delta));
+}
+
+/*****************************************************************************
+  Function name: SoilTransmissivity()
+
+  Purpose      : Same as CalcTransmissivity() for a soil type, using the 
+                 table set up by InitTransmissivityTable() if there is one
+
+  Required     : 
+    float SoilDepth  - Total soil depth in m
+    float WaterTable - Depth of the water table below the soil surface in m
+    SOILTABLE *SType - Soil type
+
+  Returns      : Transmissivity in m2/s
+
+  Modifies     : NA
+
+  Comments     : Depths outside the table use CalcTransmissivity()
+*****************************************************************************/
+float SoilTransmissivity(float SoilDepth, float WaterTable, SOILTABLE *SType)
+{
+  FLOATTABLE *Table = &(SType->TransTable);
+  float Depth;
+  float TransThresh;
+
+  Depth = (WaterTable < SType->DepthThresh) ? WaterTable : SType->DepthThresh;
+  if (Table->Data == NULL || Depth < 0.0 || SoilDepth < SType->DepthThresh ||
+      SoilDepth > Table->Offset + (Table->Size - 1) * Table->Delta)
+    return CalcTransmissivity(SoilDepth, WaterTable, SType->KsLat,
+			      SType->KsLatExp, SType->DepthThresh);
+
+  TransThresh = (SType->KsLat / SType->KsLatExp) *
+    (FloatInterpolate(Depth, Table) - FloatInterpolate(SoilDepth, Table));
+  if (WaterTable < SType->DepthThresh)
+    return TransThresh;
+
+  return (SoilDepth - WaterTable) / (SoilDepth - SType->DepthThresh) * 
+    TransThresh;
+}
@@ -11,7 +11,12 @@
  *               stations is variable.
  * DESCRIP-END.
  * FUNCTIONS:    CalcWeights()
- * COMMENTS:
+ *               CellWeights()
+ *               CressmanStations()
+ * COMMENTS:     The weights are stored sparsely: for each pixel only the
+ *               stations with a non-zero weight are kept.  The stations
+ *               near a pixel are found with the k-d tree of StationIndex.c,
+ *               and the rows of the grid are done in parallel.
  * $Id: CalcWeights.c,v 1.5 2003/10/28 20:02:41 colleen Exp $
  */
 
@@ -19,11 +24,36 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 #include "constants.h"
 #include "settings.h"
 #include "data.h"
 #include "DHSVMerror.h"
 #include "functions.h"
+#include "memaccount.h"
+
+/* work arrays of one thread of CalcWeights() */
+typedef struct {
+  uchar *Weights;		/* INVDIST: weights for all stations */
+  double *InvDist2;		/* inverse distance squared */
+  double *Distance;		/* distances to the stations of the pixel */
+  double *D2;			/* squared distances */
+  int *Id;			/* stations of the pixel */
+  int *Pos;			/* VARCRESS: position in the exchange sort */
+  int *Stat;			/* stations with a non-zero weight, by index */
+  uchar *Weight;		/* and their weights */
+  int *Keep;			/* stations kept for the pixel */
+  char *Used;			/* TRUE if a station is used for any pixel */
+} WEIGHTWORK;
+
+static int CellWeights(COORD *Loc, METLOCATION *Station, int NStats,
+		       STATIONINDEX *Index, OPTIONSTRUCT *Options,
+		       WEIGHTWORK *Work);
+static int CressmanStations(COORD *Loc, METLOCATION *Station, int NStats,
+			    STATIONINDEX *Index, int K, WEIGHTWORK *Work);
+static int CompareInt(const void *A, const void *B);
 
  /*****************************************************************************
    Function name: CalcWeights()
@@ -37,8 +67,13 @@
      int NStats           - Number of meteorological stations
      int NX               - Number of pixels in East - West direction
      int NY               - Number of pixels in North - South direction
+     int Step             - Pixels between the points (1 for the model 
+                            grid, see InitMetNodes())
      uchar ** BasinMask   - BasinMask
-     uchar ***WeightArray - 3D array with interpolation weights
+     METWEIGHT ***WeightArray - 2D array with the interpolation weights for 
+                            each pixel
+     OPTIONSTRUCT *Options - Options->MaxInterpStations limits the number of 
+                            stations per pixel (0 = no limit)
 
    Returns      :  void
 
@@ -46,255 +81,481 @@
      The values stored at the addresses pointed to by WeightArray (i.e. it
      calculates the weights and stores them)
 
-   Comments     :
+   Comments     : The weights are first calculated as 0 - MAXUCHAR for all 
+                  stations, as before.  Only the stations with a non-zero 
+                  weight (at most MaxInterpStations of the largest ones) are
+                  kept, and their weights are normalized so that they sum to 
+                  one.  The lists for all pixels share one block of memory.
+                  The rows are done by Options->NThreads threads, each
+                  into its own list, and the checks of the weights are
+                  printed afterwards in the order of the pixels
  *****************************************************************************/
 void CalcWeights(METLOCATION * Station, int NStats, int NX, int NY,
-  uchar ** BasinMask, uchar **** WeightArray,
+  int Step, uchar ** BasinMask, METWEIGHT *** WeightArray,
   OPTIONSTRUCT * Options)
 {
-  double *Weights;		/* Array with weights for all stations */
-  double *Distance;		/* Array with distances to all stations */
-  double *InvDist2;		/* Array with inverse distance squared */
-  double Denominator;		/* Sum of 1/Distance^2 */
-  double mindistance;
-  double avgdistance;
-  double tempdistance;
-  double cr, crt;
+  double cr;
   int totalweight;
   int y;			/* Counter for rows */
   int x;			/* Counter for columns */
   int i, j;			/* Counter for stations */
-  int CurrentStation;		/* Station at current location (if any) */
-  int *stationid;		/* index array for sorted list of station distances */
   int *stat;
-  int tempid;
+  int *used;			/* TRUE if a station is used for any pixel */
   int closest;
   int crstat;
+  int MaxStations;		/* maximum number of stations per pixel */
+  int NKeep;
+  int NNonZero;			/* stations with a non-zero weight */
+  int *Check;			/* total weight and number of non-zero weights
+				   of each pixel */
+  int **RowStat;		/* stations kept for the pixels of each row */
+  float **RowWeight;		/* and their weights */
+  int RowMax;			/* allocated length of the row lists */
+  int RowN;			/* length of the row lists */
+  float WeightSum;
+  long NTotal;			/* number of stored weights */
+  int *StatBlock;
+  float *WeightBlock;
+  float *OffsetBlock;
+  float *FactorBlock;
   COORD Loc;			/* Location of current point */
-
-  /* Allocate memory for a 3 dimensional array */
+  STATIONINDEX Index;		/* k-d tree of the stations */
+  WEIGHTWORK Work;
 
   if (DEBUG)
     printf("Calculating interpolation weights for %d stations\n", NStats);
 
-  if (!((*WeightArray) = (uchar ***)calloc(NY, sizeof(uchar **))))
+  if (!((*WeightArray) = (METWEIGHT **)TaggedCalloc(NY, sizeof(METWEIGHT *),
+						    MEM_MET)))
     ReportError("CalcWeights()", 1);
 
   for (y = 0; y < NY; y++)
-    if (!((*WeightArray)[y] = (uchar **)calloc(NX, sizeof(uchar *))))
+    if (!((*WeightArray)[y] = (METWEIGHT *)TaggedCalloc(NX, sizeof(METWEIGHT),
+							MEM_MET)))
       ReportError("CalcWeights()", 1);
 
-  for (y = 0; y < NY; y++)
-    for (x = 0; x < NX; x++)
-      if (!((*WeightArray)[y][x] = (uchar *)calloc(NStats, sizeof(uchar))))
-        ReportError("CalcWeights()", 1);
-
-  /* Allocate memory for the array that will contain weights, and the array for
-     the distances to each of the towers, and the inverse distance squared */
-
-  if (!(Weights = (double *) calloc(NStats, sizeof(double))))
+  if (!(used = (int *)calloc(NStats, sizeof(int))))
     ReportError("CalcWeights()", 1);
 
-  if (!(Distance = (double *)calloc(NStats, sizeof(double))))
+  if (!(stat = (int *)calloc(NStats + 1, sizeof(int))))
     ReportError("CalcWeights()", 1);
 
-  if (!(InvDist2 = (double *)calloc(NStats, sizeof(double))))
+  if (!(Check = (int *) calloc(2 * (long) NX * NY + 1, sizeof(int))) ||
+      !(RowStat = (int **) calloc(NY, sizeof(int *))) ||
+      !(RowWeight = (float **) calloc(NY, sizeof(float *))))
     ReportError("CalcWeights()", 1);
 
-  if (!(stationid = (int *)calloc(NStats, sizeof(int))))
-    ReportError("CalcWeights()", 1);
+  MaxStations = Options->MaxInterpStations;
+  if (MaxStations <= 0 || MaxStations > NStats)
+    MaxStations = NStats;
 
-  if (!(stat = (int *)calloc(NStats + 1, sizeof(int))))
-    ReportError("CalcWeights()", 1);
+  if (Options->Interpolation == NEAREST)
+    printf("Number of stations is %d \n", NStats);
+
+  if (Options->Interpolation == VARCRESS) {
+    cr = (double)Options->CressRadius;
+    if (cr < 2)
+      ReportError("CalcWeights.c", 42);
+    crstat = Options->CressStations;
+    if (crstat < 2)
+      ReportError("CalcWeights.c", 42);
+  }
+
+  InitStationIndex(Station, NStats, &Index);
+
+  printf("\nChecking interpolation weights\n");
+  printf("Sum should be 255 for all pixels \n");
+  printf("Some error is expected due to roundoff \n");
+  printf("Errors greater than +/- 2 Percent are: \n");
 
   /* Calculate the weights for each location that is inside the basin mask */
   /* note stations themselves can be outside the mask */
-  /* this first scheme is an inverse distance squared scheme */
 
-  if (Options->Interpolation == INVDIST) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(Options->NThreads) \
+  private(y, x, i, j, Loc, Work, NNonZero, NKeep, closest, WeightSum, \
+	  RowMax, RowN)
+#endif
+  {
+    if (!(Work.Weights = (uchar *) calloc(NStats + 1, sizeof(uchar))) ||
+	!(Work.InvDist2 = (double *) calloc(NStats + 1, sizeof(double))) ||
+	!(Work.Distance = (double *) calloc(NStats + 1, sizeof(double))) ||
+	!(Work.D2 = (double *) calloc(NStats + 1, sizeof(double))) ||
+	!(Work.Id = (int *) calloc(NStats + 1, sizeof(int))) ||
+	!(Work.Pos = (int *) calloc(NStats + 1, sizeof(int))) ||
+	!(Work.Stat = (int *) calloc(NStats + 1, sizeof(int))) ||
+	!(Work.Weight = (uchar *) calloc(NStats + 1, sizeof(uchar))) ||
+	!(Work.Keep = (int *) calloc(NStats + 1, sizeof(int))) ||
+	!(Work.Used = (char *) calloc(NStats + 1, sizeof(char))))
+      ReportError("CalcWeights()", 1);
+
+#ifdef HAVE_OPENMP
+#pragma omp for schedule(dynamic)
+#endif
     for (y = 0; y < NY; y++) {
-      Loc.N = y;
+      Loc.N = y * Step;
+      RowMax = 0;
+      RowN = 0;
       for (x = 0; x < NX; x++) {
-        Loc.E = x;
-        if (INBASIN(BasinMask[y][x])) {
-          if (IsStationLocation(&Loc, NStats, Station, &CurrentStation)) {
-            for (i = 0; i < NStats; i++) {
-              if (i == CurrentStation)
-                (*WeightArray)[y][x][i] = MAXUCHAR;
-              else
-                (*WeightArray)[y][x][i] = 0;
-            }
-          }
+        Loc.E = x * Step;
+        (*WeightArray)[y][x].NWeights = 0;
+        if (!INBASIN(BasinMask[y][x]))
+          continue;
+
+        NNonZero = CellWeights(&Loc, Station, NStats, &Index, Options, &Work);
+
+        /* the total weight and the number of stations, checked below */
+        Check[2 * ((long) y * NX + x)] = 0;
+        for (i = 0; i < NNonZero; i++) {
+          Check[2 * ((long) y * NX + x)] += (int) Work.Weight[i];
+          Work.Used[Work.Stat[i]] = 1;
+        }
+        Check[2 * ((long) y * NX + x) + 1] = NNonZero;
+
+        /* keep the stations with a non-zero weight.  If there are more than 
+           MaxStations, only keep the ones with the largest weights (the
+           lowest station index wins a tie) */
+        for (i = 0, NKeep = 0; i < NNonZero; i++) {
+          if (NKeep < MaxStations)
+            Work.Keep[NKeep++] = i;
           else {
-            for (i = 0, Denominator = 0; i < NStats; i++) {
-              Distance[i] = CalcDistance(&(Station[i].Loc), &Loc);
-              InvDist2[i] = 1 / (Distance[i] * Distance[i]);
-              Denominator += InvDist2[i];
-            }
-            for (i = 0; i < NStats; i++) {
-              (*WeightArray)[y][x][i] =
-                (uchar)Round(InvDist2[i] / Denominator * MAXUCHAR);
+            for (j = 0, closest = 0; j < NKeep; j++)
+              if (Work.Weight[Work.Keep[j]] <= Work.Weight[Work.Keep[closest]])
+                closest = j;
+            if (Work.Weight[i] > Work.Weight[Work.Keep[closest]]) {
+              for (j = closest; j < NKeep - 1; j++)
+                Work.Keep[j] = Work.Keep[j + 1];
+              Work.Keep[NKeep - 1] = i;
             }
           }
         }
-        else {
-          for (i = 0; i < NStats; i++)
-            (*WeightArray)[y][x][i] = 0;
+
+        if (RowN + NKeep > RowMax) {
+          while (RowN + NKeep > RowMax)
+            RowMax = (RowMax > 0) ? 2 * RowMax : NX;
+          if (!(RowStat[y] = (int *) realloc(RowStat[y], RowMax * sizeof(int))) ||
+              !(RowWeight[y] = (float *) realloc(RowWeight[y],
+                                                 RowMax * sizeof(float))))
+            ReportError("CalcWeights()", 1);
+        }
+
+        for (j = 0, WeightSum = 0.0; j < NKeep; j++)
+          WeightSum += (float) Work.Weight[Work.Keep[j]];
+        for (j = 0; j < NKeep; j++) {
+          RowStat[y][RowN + j] = Work.Stat[Work.Keep[j]];
+          RowWeight[y][RowN + j] = ((float) Work.Weight[Work.Keep[j]]) / WeightSum;
         }
+        (*WeightArray)[y][x].NWeights = NKeep;
+        RowN += NKeep;
       }
     }
+
+#ifdef HAVE_OPENMP
+#pragma omp critical
+#endif
+    for (i = 0; i < NStats; i++)
+      if (Work.Used[i])
+        used[i] = 1;
+
+    free(Work.Weights);
+    free(Work.InvDist2);
+    free(Work.Distance);
+    free(Work.D2);
+    free(Work.Id);
+    free(Work.Pos);
+    free(Work.Stat);
+    free(Work.Weight);
+    free(Work.Keep);
+    free(Work.Used);
   }
-  if (Options->Interpolation == NEAREST) {
+  FreeStationIndex(&Index);
 
-    /* this next scheme is a nearest station */
-    printf("Number of stations is %d \n", NStats);
+  /* check that all weights add up to MAXUCHAR */
+  /* and output some stats on the interpolation field */
+  for (y = 0, NTotal = 0; y < NY; y++) {
+    for (x = 0; x < NX; x++) {
+      if (!INBASIN(BasinMask[y][x]))
+        continue;
+      totalweight = Check[2 * ((long) y * NX + x)];
+      if (totalweight < 250 || totalweight > 260)
+        printf("error in interpolation weight at pixel y %d x %d : %d \n", y,
+          x, totalweight);
+      stat[Check[2 * ((long) y * NX + x) + 1]] += 1;
+      NTotal += (*WeightArray)[y][x].NWeights;
+    }
+  }
 
-    for (y = 0; y < NY; y++) {
-      Loc.N = y;
-      for (x = 0; x < NX; x++) {
-        Loc.E = x;
-        if (INBASIN(BasinMask[y][x])) {	/*we are inside the basin mask */
-          /* find the distance to nearest station */
-          mindistance = DHSVM_HUGE;
-          avgdistance = 0.0;
-          for (i = 0; i < NStats; i++) {
-            Distance[i] = CalcDistance(&(Station[i].Loc), &Loc);
-            avgdistance += Distance[i] / ((double)NStats);
-            if (Distance[i] < mindistance) {
-              mindistance = Distance[i];
-              closest = i;
-            }
-          }
-          /* got closest station */
+  for (i = 0; i <= NStats; i++)
+    if (stat[i] > 0)
+      printf("%d pixels are linked to %d met stations \n", stat[i],
+        i);
 
-          for (i = 0; i < NStats; i++) {
-            if (i == closest)
-              (*WeightArray)[y][x][i] = MAXUCHAR;
-            else
-              (*WeightArray)[y][x][i] = 0;
-          }
+  for (i = 0; i < NStats; i++)
+    if (used[i] > 0)
+      printf("%s station used in interpolation \n", Station[i].Name);
 
-        }			/* done in basin mask */
-        else {
-          for (i = 0; i < NStats; i++)
-            (*WeightArray)[y][x][i] = 0;
-        }
-      }
+  if (MaxStations < NStats)
+    printf("At most %d stations are kept for each pixel\n", MaxStations);
+
+  /* the lists of the rows go into one block.  The lapse terms are filled in
+     by MakeMetFields(), the precipitation factors by MakePrecipFactors() */
+  if (!(StatBlock = (int *) TaggedMalloc((NTotal > 0 ? NTotal : 1) *
+					 sizeof(int), MEM_MET)) ||
+      !(WeightBlock = (float *) TaggedMalloc((NTotal > 0 ? NTotal : 1) *
+					     sizeof(float), MEM_MET)) ||
+      !(OffsetBlock = (float *) TaggedCalloc(NTotal > 0 ? NTotal : 1,
+					     sizeof(float), MEM_MET)) ||
+      !(FactorBlock = (float *) TaggedCalloc(NTotal > 0 ? NTotal : 1,
+					     sizeof(float), MEM_MET)))
+    ReportError("CalcWeights()", 1);
+
+  /* now that the block is complete, point each pixel at its part */
+  for (y = 0, NTotal = 0; y < NY; y++) {
+    for (x = 0, RowN = 0; x < NX; x++)
+      RowN += (*WeightArray)[y][x].NWeights;
+    if (RowN > 0) {
+      memcpy(StatBlock + NTotal, RowStat[y], RowN * sizeof(int));
+      memcpy(WeightBlock + NTotal, RowWeight[y], RowN * sizeof(float));
+    }
+    free(RowStat[y]);
+    free(RowWeight[y]);
+    for (x = 0; x < NX; x++) {
+      (*WeightArray)[y][x].Stat = StatBlock + NTotal;
+      (*WeightArray)[y][x].Weight = WeightBlock + NTotal;
+      (*WeightArray)[y][x].TOffset = OffsetBlock + NTotal;
+      (*WeightArray)[y][x].PFactor = FactorBlock + NTotal;
+      NTotal += (*WeightArray)[y][x].NWeights;
     }
   }
 
-  if (Options->Interpolation == VARCRESS) {
+  /* Free memory */
 
-    /* this next scheme is a variable radius cressman */
-    /* find the distance to the nearest station */
-    /* make a decision based on the maximum allowable radius, cr */
-    /* and the distance to the closest station */
-    /* while limiting the number of interpolation stations to three */
-    cr = (double)Options->CressRadius;
-    if (cr < 2)
-      ReportError("CalcWeights.c", 42);
-    crstat = Options->CressStations;
-    if (crstat < 2)
-      ReportError("CalcWeights.c", 42);
-    for (y = 0; y < NY; y++) {
-      Loc.N = y;
-      for (x = 0; x < NX; x++) {
-        Loc.E = x;
-        if (INBASIN(BasinMask[y][x])) {	/*we are inside the basin mask */
-          /* find the distance to nearest station */
-          for (i = 0; i < NStats; i++) {
-            Distance[i] = CalcDistance(&(Station[i].Loc), &Loc);
-            stationid[i] = i;
-          }
-          /* got distances for each station */
-          /* now sort the list by distance */
-          for (i = 0; i < NStats; i++) {
-            for (j = 0; j < NStats; j++) {
-              if (Distance[j] > Distance[i]) {
-                tempdistance = Distance[i];
-                tempid = stationid[i];
-                Distance[i] = Distance[j];
-                stationid[i] = stationid[j];
-                Distance[j] = tempdistance;
-                stationid[j] = tempid;
-              }
-            }
-          }
+  free(used);
+  free(stat);
+  free(Check);
+  free(RowStat);
+  free(RowWeight);
+}
 
-          crt = Distance[0] * 2.0;
-          if (crt < 1.0)
-            crt = 1.0;
-          for (i = 0, Denominator = 0; i < NStats; i++) {
-            if (i < crstat && Distance[i] < crt) {
-              InvDist2[i] =
-                (crt * crt - Distance[i] * Distance[i]) /
-                (crt * crt + Distance[i] * Distance[i]);
-              Denominator += InvDist2[i];
-            }
-            else
-              InvDist2[i] = 0.0;
-          }
+/*****************************************************************************
+  Function name: CellWeights()
+
+  Purpose      : Calculate the weights of the stations for one pixel
 
-          for (i = 0; i < NStats; i++)
-            (*WeightArray)[y][x][stationid[i]] =
-            (uchar)Round(InvDist2[i] / Denominator * MAXUCHAR);
+  Required     :
+    COORD *Loc           - Location of the pixel
+    METLOCATION *Station - Location of meteorological stations
+    int NStats           - Number of meteorological stations
+    STATIONINDEX *Index  - k-d tree of the stations
+    OPTIONSTRUCT *Options - Interpolation method
 
-          /*at this point all weights have been assigned to one or more stations */
+  Returns      : int - number of stations with a non-zero weight
 
+  Modifies     : Work->Stat and Work->Weight - the stations with a non-zero
+                 weight (0 - MAXUCHAR), in station order
+
+  Comments     : The weights are those of the scan over all stations that
+                 this replaces.  Only INVERSE DISTANCE needs the distances
+                 to all stations
+*****************************************************************************/
+static int CellWeights(COORD *Loc, METLOCATION *Station, int NStats,
+		       STATIONINDEX *Index, OPTIONSTRUCT *Options,
+		       WEIGHTWORK *Work)
+{
+  double Denominator;		/* Sum of 1/Distance^2 */
+  double crt;
+  uchar w;
+  int CurrentStation;		/* Station at current location (if any) */
+  int NStations;
+  int NNonZero;
+  int i, j;
+
+  NNonZero = 0;
+
+  /* this first scheme is an inverse distance squared scheme */
+  if (Options->Interpolation == INVDIST) {
+    if ((CurrentStation = StationAt(Index, Loc)) >= 0) {
+      Work->Stat[0] = CurrentStation;
+      Work->Weight[0] = MAXUCHAR;
+      NNonZero = 1;
+    }
+    else {
+      for (i = 0, Denominator = 0; i < NStats; i++) {
+        Work->Distance[i] = CalcDistance(&(Station[i].Loc), Loc);
+        Work->InvDist2[i] = 1 / (Work->Distance[i] * Work->Distance[i]);
+        Denominator += Work->InvDist2[i];
+      }
+      for (i = 0; i < NStats; i++) {
+        Work->Weights[i] = (uchar)Round(Work->InvDist2[i] / Denominator * MAXUCHAR);
+        if (Work->Weights[i] > 0) {
+          Work->Stat[NNonZero] = i;
+          Work->Weight[NNonZero++] = Work->Weights[i];
         }
       }
     }
   }
 
-  /*check that all weights add up to MAXUCHAR */
-  /* and output some stats on the interpolation field */
+  /* this next scheme is a nearest station, the lowest index wins a tie */
+  else if (Options->Interpolation == NEAREST) {
+    if (NearestStations(Index, Loc, 1, Work->Id, Work->D2) == 1) {
+      Work->Stat[0] = Work->Id[0];
+      Work->Weight[0] = MAXUCHAR;
+      NNonZero = 1;
+    }
+  }
 
-  for (i = 0; i <= NStats; i++)
-    stat[i] = 0;
-  for (i = 0; i < NStats; i++)
-    stationid[i] = 0;
+  /* this next scheme is a variable radius cressman */
+  /* find the distance to the nearest station */
+  /* make a decision based on the maximum allowable radius, cr */
+  /* and the distance to the closest station */
+  /* while limiting the number of interpolation stations to three */
+  else if (Options->Interpolation == VARCRESS) {
+    NStations = CressmanStations(Loc, Station, NStats, Index,
+				 Options->CressStations, Work);
+    if (NStations > Options->CressStations)
+      NStations = Options->CressStations;
+
+    crt = Work->Distance[0] * 2.0;
+    if (crt < 1.0)
+      crt = 1.0;
+    for (i = 0, Denominator = 0; i < NStations; i++) {
+      if (Work->Distance[i] < crt) {
+        Work->InvDist2[i] =
+          (crt * crt - Work->Distance[i] * Work->Distance[i]) /
+          (crt * crt + Work->Distance[i] * Work->Distance[i]);
+        Denominator += Work->InvDist2[i];
+      }
+      else
+        Work->InvDist2[i] = 0.0;
+    }
 
-  printf("\nChecking interpolation weights\n");
-  printf("Sum should be 255 for all pixels \n");
-  printf("Some error is expected due to roundoff \n");
-  printf("Errors greater than +/- 2 Percent are: \n");
+    /* the stations in station order */
+    for (i = 0; i < NStations; i++) {
+      w = (uchar)Round(Work->InvDist2[i] / Denominator * MAXUCHAR);
+      if (w == 0)
+        continue;
+      for (j = NNonZero++; j > 0 && Work->Stat[j - 1] > Work->Id[i]; j--) {
+        Work->Stat[j] = Work->Stat[j - 1];
+        Work->Weight[j] = Work->Weight[j - 1];
+      }
+      Work->Stat[j] = Work->Id[i];
+      Work->Weight[j] = w;
+    }
+  }
 
-  for (y = 0; y < NY; y++) {
-    for (x = 0; x < NX; x++) {
-      if (INBASIN(BasinMask[y][x])) {	/*we are inside the basin mask */
-        tempid = 0;
-        totalweight = 0;
-
-        for (i = 0; i < NStats; i++) {
-          totalweight += (int)(*WeightArray)[y][x][i];
-          if ((*WeightArray)[y][x][i] > 0) {
-            tempid += 1;
-            stationid[i] = 1;
-          }
-        }
+  return NNonZero;
+}
 
-        if (totalweight < 250 || totalweight > 260)
-          printf("error in interpolation weight at pixel y %d x %d : %d \n", y,
-            x, totalweight);
-        stat[tempid] += 1;
-      }
+/*****************************************************************************
+  Function name: CressmanStations()
+
+  Purpose      : Find the K stations nearest to a pixel, in the order of the
+                 exchange sort of the distances to all stations that
+                 VARCRESS used to do
+
+  Required     :
+    COORD *Loc           - Location of the pixel
+    METLOCATION *Station - Location of meteorological stations
+    int NStats           - Number of meteorological stations
+    STATIONINDEX *Index  - k-d tree of the stations
+    int K                - Number of stations
+
+  Returns      : int - number of stations in Work->Id, at least K (or
+                       NStats): all stations as near as the K-th
+
+  Modifies     : Work->Id and Work->Distance - the stations and their
+                 distances, in the order of the exchange sort
+
+  Comments     : The sort swapped Distance[i] and Distance[j] for all i and
+                 j with Distance[j] > Distance[i].  That sorts the distances,
+                 but it does not keep the stations at the same distance in
+                 index order, and which of them come first decides which
+                 stations are used.  Candidates are all stations at most as
+                 far as the K-th nearest, the only ones that can end up in
+                 the first K places.  The first pass of the sort (i = 0)
+                 moves each new largest distance to element 0 and the
+                 previous one to its place.  After that pass i inserts
+                 element i into the sorted elements 0 .. i - 1 with the same
+                 swaps, and the farther stations only swap among
+                 themselves.  So the candidates are placed where the first
+                 pass leaves them, and their pass i is repeated in that
+                 order
+*****************************************************************************/
+static int CressmanStations(COORD *Loc, METLOCATION *Station, int NStats,
+			    STATIONINDEX *Index, int K, WEIGHTWORK *Work)
+{
+  double tempdistance;
+  int tempid;
+  int Cur;
+  int Next;
+  int NCand;
+  int i, j;
+
+  if ((NCand = NearestStations(Index, Loc, K, Work->Id, Work->D2)) == 0)
+    return 0;
+  NCand = StationsWithin(Index, Loc, Work->D2[NCand - 1], Work->Id);
+  qsort(Work->Id, NCand, sizeof(int), CompareInt);
+  for (i = 0; i < NCand; i++) {
+    Work->Distance[i] = CalcDistance(&(Station[Work->Id[i]].Loc), Loc);
+    Work->Pos[i] = Work->Id[i];
+  }
 
+  /* first pass: the candidates that are the largest distance so far when
+     the pass meets them.  The next larger distance is at the first station
+     after Cur that is not a candidate at most as far as Cur, and the last
+     one goes to element 0 */
+  if (Work->Id[0] == 0) {
+    for (Cur = 0;;) {
+      Next = Work->Id[Cur] + 1;
+      for (i = Cur + 1; i < NCand && Work->Id[i] == Next &&
+	     Work->Distance[i] <= Work->Distance[Cur]; i++)
+	Next++;
+      if (i < NCand && Work->Id[i] == Next) {
+	Work->Pos[Cur] = Next;
+	Cur = i;
+      }
+      else {
+	Work->Pos[Cur] = (Next < NStats) ? Next : 0;
+	break;
+      }
     }
   }
-  for (i = 0; i <= NStats; i++)
-    if (stat[i] > 0)
-      printf("%d pixels are linked to %d met stations \n", stat[i],
-        i);
 
-  for (i = 0; i < NStats; i++)
-    if (stationid[i] > 0)
-      printf("%s station used in interpolation \n", Station[i].Name);
+  /* the candidates in the order of their element after the first pass */
+  for (i = 1; i < NCand; i++) {
+    for (j = i; j > 0 && Work->Pos[j - 1] > Work->Pos[j]; j--) {
+      tempid = Work->Pos[j];
+      Work->Pos[j] = Work->Pos[j - 1];
+      Work->Pos[j - 1] = tempid;
+      tempid = Work->Id[j];
+      Work->Id[j] = Work->Id[j - 1];
+      Work->Id[j - 1] = tempid;
+      tempdistance = Work->Distance[j];
+      Work->Distance[j] = Work->Distance[j - 1];
+      Work->Distance[j - 1] = tempdistance;
+    }
+  }
 
-  /* Free memory */
+  /* pass i of the sort over elements 0 .. i - 1 */
+  for (i = 0; i < NCand; i++) {
+    for (j = 0; j < i; j++) {
+      if (Work->Distance[j] > Work->Distance[i]) {
+        tempdistance = Work->Distance[i];
+        tempid = Work->Id[i];
+        Work->Distance[i] = Work->Distance[j];
+        Work->Id[i] = Work->Id[j];
+        Work->Distance[j] = tempdistance;
+        Work->Id[j] = tempid;
+      }
+    }
+  }
+  return NCand;
+}
 
-  free(Weights);
-  free(Distance);
-  free(InvDist2);
-  free(stationid);
-  free(stat);
+/*****************************************************************************
+  CompareInt()
+*****************************************************************************/
+static int CompareInt(const void *A, const void *B)
+{
+  return *(const int *) A - *(const int *) B;
 }
@@ -447,12 +447,9 @@ double GregorianToJulianDay(int year, int mon, int day, int h, int mi,
 /*			     JulianDayToGregorian()                           */
 /******************************************************************************/
 /* Julian date converter. Takes a julian date (the number of days since
-** some distant epoch or other), and returns an int pointer to static space.
-** ip[0] = month;
-** ip[1] = day of month;
-** ip[2] = year (actual year, like 1977, not 77 unless it was  77 a.d.);
-** ip[3] = day of week (0->Sunday to 6->Saturday)
-** These are Gregorian.
+** some distant epoch or other), and returns the Gregorian date and time in
+** y, m, d, h, mi and sec.  The year is the actual year, like 1977, not 77
+** unless it was 77 a.d.
 ** Copied from Algorithm 199 in Collected algorithms of the CACM
 ** Author: Robert G. Tantzen, Translator: Nat Howard
 ** Copied from the xmgr auxiliary functions Mon Feb  1 14:16:40 1999
@@ -460,8 +457,6 @@ double GregorianToJulianDay(int year, int mon, int day, int h, int mi,
 void JulianDayToGregorian(double jd, int *y, int *m, int *d, int *h, int *mi,
 			  double *sec)
 {
-  static int ret[4];
-
   long j = jd;
   double tmp, frac = jd - j;
 
@@ -482,7 +477,6 @@ void JulianDayToGregorian(double jd, int *y, int *m, int *d, int *h, int *mi,
     frac = frac + 0.5;
   }
 
-  ret[3] = (j + 1L) % 7L;
   j -= 1721119L;
   *y = (4L * j - 1L) / 146097L;
   j = 4L * j - 1L - 146097L * *y;
@@ -8,8 +8,10 @@
  * ORIG-DATE:    Apr-96
  * DESCRIPTION:  Calculate canopy resistance
  * DESCRIP-END.
- * FUNCTIONS:    CanopyResistance()
- * COMMENTS:
+ * FUNCTIONS:    CanopyFactors()
+ *               CanopyResistance()
+ * COMMENTS:     The factors of the vegetation layer are computed once for
+ *               all the soil layers of a cell
  * $Id: CanopyResistance.c,v 1.4 2003/07/01 21:26:11 olivier Exp $
  */
 
@@ -17,21 +19,48 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "settings.h"
+#include "data.h"
 #include "massenergy.h"
 #include "constants.h"
 
- /*****************************************************************************
-   CanopyResistance()
- *****************************************************************************/
-float CanopyResistance(float LAI, float RsMin, float RsMax, float Rpc,
-  float VpdThres, float MoistThres, float WP,
-  float TSoil, float SoilMoisture, float Vpd, float Rp)
+/*****************************************************************************
+  CanopyFactors()
+
+  The feed-back factors of the canopy resistance of a vegetation layer that
+  are the same for all its soil layers, equations 14 and 15 of Wigmosta et
+  al [1994].  Returns FALSE if the vapor pressure deficit closes the stomata,
+  the resistance is then DHSVM_HUGE in all soil layers.  RsRatio is set by
+  InitNewMonth()
+*****************************************************************************/
+int CanopyFactors(VEGTABLE *VType, int Layer, float Vpd, float Rp,
+		  float *VpdFactor, float *RpFactor)
+{
+  /* equation 14, Wigmosta et al [1994] */
+
+  if (Vpd >= VType->VpdThres[Layer])
+    return FALSE;
+  *VpdFactor = 1.0 / (1 - Vpd / VType->VpdThres[Layer]);
+
+  /* equation 15, Wigmosta et al [1994 */
+
+  *RpFactor = 1.0 / ((VType->RsRatio[Layer] + Rp / VType->Rpc[Layer]) /
+		     (1 + Rp / VType->Rpc[Layer]));
+
+  return TRUE;
+}
+
+/*****************************************************************************
+  CanopyResistance()
+
+  Canopy resistance of a soil layer, with the factors of CanopyFactors()
+*****************************************************************************/
+float CanopyResistance(float VpdFactor, float RpFactor, float RsMin,
+		       float LAI, float MoistThres, float WP, float TSoil,
+		       float SoilMoisture)
 {
   float MoistFactor;	/* multiplier for resistance due to soil moisture feed-back */
   float Resistance;		/* Canopy resistance (s/m) */
-  float RpFactor;		/* multiplier for resistance due to light level feed-back */
   float TFactor;		/* multiplier for resistance due to soil temperaure feed-back */
-  float VpdFactor;		/* multiplier for resistance due to vapor pressure deficit feed-back */
 
   if (TSoil <= 0) {
     Resistance = DHSVM_HUGE;
@@ -46,19 +75,6 @@ float CanopyResistance(float LAI, float RsMin, float RsMax, float Rpc,
     return Resistance;
   }
 
-  /* equation 14, Wigmosta et al [1994] */
-
-  if (Vpd >= VpdThres) {
-    Resistance = DHSVM_HUGE;
-    return Resistance;
-  }
-  else
-    VpdFactor = 1.0 / (1 - Vpd / VpdThres);
-
-  /* equation 15, Wigmosta et al [1994 */
-
-  RpFactor = 1.0 / ((RsMin / RsMax + Rp / Rpc) / (1 + Rp / Rpc));
-
   /* equation 16, Wigmosta et al [1994] */
 
   if (SoilMoisture <= WP) {
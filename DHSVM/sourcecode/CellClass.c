@@ -0,0 +1,314 @@
+/*
+ * SUMMARY:      CellClass.c - Vegetation and soil class of each active cell
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Numbers the combinations of vegetation and soil type that
+ *               occur in the basin, and keeps the class of each active
+ *               cell, so that the loops over the active cells find the
+ *               vegetation and soil parameters of a cell with one indexed
+ *               load instead of VType[VegMap[y][x].Veg - 1] and
+ *               SType[SoilMap[y][x].Soil - 1]
+ * DESCRIP-END.
+ * FUNCTIONS:    InitCellClasses()
+ *               InitStructureClasses()
+ *               StructureOf()
+ *               OrderStructureClasses()
+ *               ChangeCellClass()
+ *               FreeCellClasses()
+ * COMMENTS:     The classes are made once, after the vegetation of the
+ *               stations has been set with SNOTEL, and are numbered in the
+ *               order of their first cell in Map->ActiveCells.  Only a map
+ *               event (MapEvents.c) changes the vegetation of a cell during
+ *               the run, and ChangeCellClass() then adds the classes of the
+ *               new pairs after the others
+ *
+ *               With CELL CLASS ORDER the pixel loop also groups the cells
+ *               of each of its tiles by their structure class: the canopy
+ *               layers of the vegetation type, snow, an impervious
+ *               fraction, and a road or channel cut.  The cells of a class
+ *               take the same branches in MassEnergyBalance(), and the
+ *               soil column and radiation batches get cells of one class.
+ *               Only the snow changes during the run, so the other bits
+ *               are kept and the order is sorted again at each step
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "memaccount.h"
+#include "soilmoisture.h"
+
+static unsigned char StructureOf(VEGTABLE *VType, ROADSTRUCT *Network);
+
+/*****************************************************************************
+  Function name: InitCellClasses()
+
+  Purpose      : Find the class of each active cell
+
+  Required     :
+    MAPSIZE *Map      - Active cells of the basin
+    VEGPIX **VegMap   - Vegetation type of each cell
+    SOILPIX **SoilMap - Soil type of each cell
+    VEGTABLE *VType   - Vegetation types
+    SOILTABLE *SType  - Soil types
+    LAYER *Veg        - Vegetation layers of each type
+    LAYER *Soil       - Soil layers of each type
+
+  Returns      : void
+
+  Modifies     : CELLCLASSES *Classes
+*****************************************************************************/
+void InitCellClasses(MAPSIZE *Map, VEGPIX **VegMap, SOILPIX **SoilMap,
+		     VEGTABLE *VType, SOILTABLE *SType, LAYER *Veg,
+		     LAYER *Soil, CELLCLASSES *Classes)
+{
+  const char *Routine = "InitCellClasses";
+  CELLCLASS *Class;
+  int *Pair;			/* class of each vegetation and soil pair, -1
+				   if no cell has it */
+  int VegType;
+  int SoilType;
+  int k;
+  int x;
+  int y;
+
+  if (!(Pair = (int *) malloc(Veg->NTypes * Soil->NTypes * sizeof(int))))
+    ReportError((char *) Routine, 1);
+  for (k = 0; k < Veg->NTypes * Soil->NTypes; k++)
+    Pair[k] = -1;
+
+  if (!(Classes->Of = (unsigned short *) TaggedCalloc(Map->NumActive + 1,
+						      sizeof(unsigned short),
+						      MEM_TERRAIN)))
+    ReportError((char *) Routine, 1);
+
+  Classes->NClasses = 0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    VegType = VegMap[y][x].Veg - 1;
+    SoilType = SoilMap[y][x].Soil - 1;
+    if (VegType < 0 || VegType >= Veg->NTypes || SoilType < 0 ||
+	SoilType >= Soil->NTypes)
+      ReportError((char *) Routine, 82);
+    if (Pair[VegType * Soil->NTypes + SoilType] < 0) {
+      if (Classes->NClasses > USHRT_MAX)
+	ReportError((char *) Routine, 65);
+      Pair[VegType * Soil->NTypes + SoilType] = Classes->NClasses++;
+    }
+    Classes->Of[k] = (unsigned short) Pair[VegType * Soil->NTypes + SoilType];
+  }
+
+  if (!(Classes->Class = (CELLCLASS *) TaggedCalloc(Classes->NClasses + 1,
+						    sizeof(CELLCLASS),
+						    MEM_TERRAIN)))
+    ReportError((char *) Routine, 1);
+  for (VegType = 0; VegType < Veg->NTypes; VegType++) {
+    for (SoilType = 0; SoilType < Soil->NTypes; SoilType++) {
+      if ((k = Pair[VegType * Soil->NTypes + SoilType]) < 0)
+	continue;
+      Class = &(Classes->Class[k]);
+      Class->VType = &(VType[VegType]);
+      Class->SType = &(SType[SoilType]);
+      Class->NVegLayers = Veg->NLayers[VegType];
+      Class->NSoilLayers = Soil->NLayers[SoilType];
+    }
+  }
+  free(Pair);
+}
+
+/*****************************************************************************
+  Function name: InitStructureClasses()
+
+  Purpose      : Find the structure class of each active cell, but for its
+                 snow
+
+  Required     :
+    MAPSIZE *Map         - Active cells of the basin
+    ROADSTRUCT **Network - Road and channel cuts of each cell
+    CELLCLASSES *Classes - Vegetation and soil class of each cell
+
+  Returns      : void
+
+  Modifies     : Classes->Structure
+*****************************************************************************/
+void InitStructureClasses(MAPSIZE *Map, ROADSTRUCT **Network,
+			  CELLCLASSES *Classes)
+{
+  const char *Routine = "InitStructureClasses";
+  int k;
+  int x;
+  int y;
+
+  if (!(Classes->Structure =
+	(unsigned char *) TaggedCalloc(Map->NumActive + 1,
+				       sizeof(unsigned char), MEM_TERRAIN)) ||
+      !(Classes->Sorted = (int *) TaggedCalloc(Map->NumActive + 1,
+					      sizeof(int), MEM_TERRAIN)))
+    ReportError((char *) Routine, 1);
+
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Classes->Structure[k] = StructureOf(Classes->Class[Classes->Of[k]].VType,
+					&(Network[y][x]));
+  }
+}
+
+/*****************************************************************************
+  Function name: StructureOf()
+
+  Purpose      : STRUCTURE_ bits of a cell with vegetation type VType and
+                 the cuts Network, but for its snow
+*****************************************************************************/
+static unsigned char StructureOf(VEGTABLE *VType, ROADSTRUCT *Network)
+{
+  unsigned char Bits = 0;
+
+  if (VType->OverStory)
+    Bits |= STRUCTURE_OVERSTORY;
+  if (VType->UnderStory)
+    Bits |= STRUCTURE_UNDERSTORY;
+  if (VType->ImpervFrac > 0.)
+    Bits |= STRUCTURE_IMPERVIOUS;
+  if (Network->CutBankZone != NO_CUT || Network->RoadArea > 0.)
+    Bits |= STRUCTURE_CUT;
+  return Bits;
+}
+
+/*****************************************************************************
+  Function name: OrderStructureClasses()
+
+  Purpose      : Group the cells of each tile of the pixel loop by their
+                 structure class
+
+  Required     :
+    MAPSIZE *Map         - Active cells of the basin
+    SNOWPIX **SnowMap    - Snow of each cell
+    CELLCLASSES *Classes - Structure class of each cell
+    TILESCHEDULE *Tiles  - Tiles of the pixel loop
+    int *CellOrder       - Active cell of each item of the pixel loop
+
+  Returns      : void
+
+  Modifies     : CellOrder
+
+  Comments     : The cells of a tile stay in the tile, so that the tiles
+                 keep their cost and the threads their share of the snow
+                 cells.  Within a tile the sort is stable, and the cells of
+                 a class stay in their order
+*****************************************************************************/
+void OrderStructureClasses(MAPSIZE *Map, SNOWPIX **SnowMap,
+			   CELLCLASSES *Classes, TILESCHEDULE *Tiles,
+			   int *CellOrder)
+{
+  int Next[N_STRUCTURES + 1];	/* next item of each class in the tile */
+  int c;
+  int j;
+  int k;
+  int t;
+
+  for (t = 0; t < Tiles->NTiles; t++) {
+    for (c = 0; c <= N_STRUCTURES; c++)
+      Next[c] = 0;
+    for (j = Tiles->Start[t]; j < Tiles->Start[t + 1]; j++) {
+      k = CellOrder[j];
+      c = Classes->Structure[k];
+      if (SnowMap[Map->ActiveCells[k].y][Map->ActiveCells[k].x].HasSnow)
+	c |= STRUCTURE_SNOW;
+      Next[c + 1]++;
+    }
+    Next[0] = Tiles->Start[t];
+    for (c = 0; c < N_STRUCTURES; c++)
+      Next[c + 1] += Next[c];
+
+    for (j = Tiles->Start[t]; j < Tiles->Start[t + 1]; j++) {
+      k = CellOrder[j];
+      c = Classes->Structure[k];
+      if (SnowMap[Map->ActiveCells[k].y][Map->ActiveCells[k].x].HasSnow)
+	c |= STRUCTURE_SNOW;
+      Classes->Sorted[Next[c]++] = k;
+    }
+    for (j = Tiles->Start[t]; j < Tiles->Start[t + 1]; j++)
+      CellOrder[j] = Classes->Sorted[j];
+  }
+}
+
+/*****************************************************************************
+  Function name: ChangeCellClass()
+
+  Purpose      : Give active cell k the class of vegetation type VegType and
+                 soil type SoilType (0-based), after its vegetation has
+                 changed
+
+  Required     :
+    int k                - Active cell index
+    int VegType          - New vegetation type of the cell
+    int SoilType         - Soil type of the cell
+    VEGTABLE *VType      - Vegetation types
+    SOILTABLE *SType     - Soil types
+    LAYER *Veg           - Vegetation layers of each type
+    LAYER *Soil          - Soil layers of each type
+    ROADSTRUCT *Network  - Cuts of the cell, for the structure class
+
+  Returns      : void
+
+  Modifies     : CELLCLASSES *Classes
+
+  Comments     : A pair that no cell had yet gets a new class at the end,
+                 so the classes of the other cells stay as they are
+*****************************************************************************/
+void ChangeCellClass(int k, int VegType, int SoilType, VEGTABLE *VType,
+		     SOILTABLE *SType, LAYER *Veg, LAYER *Soil,
+		     ROADSTRUCT *Network, CELLCLASSES *Classes)
+{
+  const char *Routine = "ChangeCellClass";
+  CELLCLASS *Class;
+  int c;
+
+  for (c = 0; c < Classes->NClasses; c++) {
+    if (Classes->Class[c].VType == &(VType[VegType]) &&
+	Classes->Class[c].SType == &(SType[SoilType]))
+      break;
+  }
+  if (c == Classes->NClasses) {
+    if (Classes->NClasses > USHRT_MAX)
+      ReportError((char *) Routine, 65);
+    if (!(Class = (CELLCLASS *) TaggedRealloc(Classes->Class,
+					      (Classes->NClasses + 2) *
+					      sizeof(CELLCLASS), MEM_TERRAIN)))
+      ReportError((char *) Routine, 1);
+    Classes->Class = Class;
+    Class = &(Classes->Class[Classes->NClasses++]);
+    Class->VType = &(VType[VegType]);
+    Class->SType = &(SType[SoilType]);
+    Class->NVegLayers = Veg->NLayers[VegType];
+    Class->NSoilLayers = Soil->NLayers[SoilType];
+  }
+  Classes->Of[k] = (unsigned short) c;
+  if (Classes->Structure)
+    Classes->Structure[k] = StructureOf(&(VType[VegType]), Network);
+}
+
+/*****************************************************************************
+  Function name: FreeCellClasses()
+*****************************************************************************/
+void FreeCellClasses(CELLCLASSES *Classes)
+{
+  TaggedFree(Classes->Of);
+  TaggedFree(Classes->Class);
+  TaggedFree(Classes->Structure);
+  TaggedFree(Classes->Sorted);
+  Classes->Of = NULL;
+  Classes->Class = NULL;
+  Classes->Structure = NULL;
+  Classes->Sorted = NULL;
+  Classes->NClasses = 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * SUMMARY:      ChannelBatch.c - Route the segments of a level together
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS CHANNEL ROUTING BATCH a pass over a compiled
+ *               channel network routes the segments of each level set
+ *               (channel_network_levels()) together.  The routing state of
+ *               the segments of a level is gathered into arrays, with the
+ *               routing parameters copied there at the setup, the segments
+ *               are routed by one loop over the arrays, which the compiler
+ *               vectorizes, and the state is written back to their
+ *               ChannelRoute while their outflow is scattered to the inflow
+ *               of their outlets, which are all in later levels.
+ * DESCRIP-END.
+ * FUNCTIONS:    channel_network_batch()
+ *               channel_route_batch()
+ *               SelectChannelKernels()
+ * COMMENTS:     The operations are those of channel_route_segment() in the
+ *               same order and precision, and the outflow of the segments
+ *               is added to each outlet in routing order, as in the serial
+ *               pass, so the results are the same.  The divisions by K and
+ *               the step are kept rather than multiplying by reciprocals,
+ *               which would change the last bit of the flows; they are
+ *               vectorized as well.  A level is gathered just before it is
+ *               routed, so its state is still in the cache when it is
+ *               written back.  With PARALLEL CHANNEL ROUTING the loop of a
+ *               wide level is split between the threads.  The loop is in
+ *               channelkernels.h, which is compiled for each SIMD level of
+ *               cpudispatch.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "settings.h"
+#include "channel.h"
+#include "errorhandler.h"
+#include "cpudispatch.h"
+
+/* -------------------------------------------------------------
+   struct ChannelBatch
+   The routing state of the segments of a compiled network, in
+   routing order, and the index of their outlets.  The arrays are
+   allocated with the structure, so it is freed with free().
+   ------------------------------------------------------------- */
+typedef struct _channel_batch_ {
+  float *K;			/* routing parameters, copied at the setup */
+  float *X;
+  float *Inflow;		/* upstream inflow of the step */
+  float *Lateral;		/* lateral inflow of the step */
+  float *Storage;
+  float *Outflow;
+  int *Outlet;			/* index of the outlet, -1 if none */
+} ChannelBatch;
+
+/* fewest segments of a level routed by each thread, a narrower level is
+   routed by one */
+#define THREAD_SEGMENTS 64
+
+/* the loops of each SIMD level, and the one selected by InitCpuDispatch() */
+typedef void (*CHANKERNEL) (ChannelBatch *Batch, int Start, int End,
+			    float Dt);
+
+#ifdef HAVE_SIMD_DISPATCH
+/* the select of the loop is only vectorized if both sides may be
+   computed, and a multiply and an add are not contracted at the levels
+   with FMA */
+#pragma GCC push_options
+#pragma GCC optimize("no-trapping-math", "fp-contract=off")
+#endif
+#define SIMD_SUFFIX _sse2
+#include "channelkernels.h"
+#undef SIMD_SUFFIX
+#ifdef HAVE_SIMD_DISPATCH
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SIMD_SUFFIX _avx2
+#include "channelkernels.h"
+#undef SIMD_SUFFIX
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f", "prefer-vector-width=512")
+#define SIMD_SUFFIX _avx512
+#include "channelkernels.h"
+#undef SIMD_SUFFIX
+#pragma GCC pop_options
+#pragma GCC pop_options
+#endif
+
+static CHANKERNEL RouteLevel = RouteLevel_sse2;
+
+/* -------------------------------------------------------------
+channel_network_batch
+Prepare a compiled network for routing level set by level set as
+loops over arrays.  The routing parameters have to be computed
+(channel_routing_parameters), they are copied to the arrays once.
+Returns TRUE if the network is routed that way, FALSE if it can not
+be split into levels.
+------------------------------------------------------------- */
+int channel_network_batch(ChannelNetwork *cnet)
+{
+  ChannelBatch *batch;
+  char *block;
+  int n = cnet->nseg;
+  int i;
+
+  free(cnet->batch);
+  cnet->batch = NULL;
+  if (n == 0 || channel_network_levels(cnet) == 0)
+    return FALSE;
+
+  if ((block = (char *) malloc(sizeof(ChannelBatch) +
+                               6 * n * sizeof(float) + n * sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_network_batch: malloc failed: %s",
+      strerror(errno));
+    return FALSE;
+  }
+  batch = (ChannelBatch *) block;
+  batch->K = (float *) (block + sizeof(ChannelBatch));
+  batch->X = batch->K + n;
+  batch->Inflow = batch->X + n;
+  batch->Lateral = batch->Inflow + n;
+  batch->Storage = batch->Lateral + n;
+  batch->Outflow = batch->Storage + n;
+  batch->Outlet = (int *) (batch->Outflow + n);
+  for (i = 0; i < n; i++) {
+    batch->K[i] = cnet->route[i]->K;
+    batch->X[i] = cnet->route[i]->X;
+    batch->Outlet[i] = cnet->outlet[i];
+  }
+  cnet->batch = batch;
+
+  error_handler(ERRHDL_STATUS,
+    "channel_network_batch: %d segments in %d levels", n, cnet->nlevel);
+
+  return TRUE;
+}
+
+/* -------------------------------------------------------------
+channel_route_batch
+A single pass over the compiled network in routing order, level by
+level (see channel_route_pass)
+------------------------------------------------------------- */
+int channel_route_batch(ChannelNetwork *cnet, int deltat)
+{
+  ChannelBatch *batch = cnet->batch;
+  ChannelRoute *current;
+  int i, l, t;
+  int start, end, chunk;
+
+  for (l = 0; l < cnet->nlevel; l++) {
+    start = cnet->level[l];
+    end = cnet->level[l + 1];
+    for (i = start; i < end; i++) {
+      current = cnet->route[i];
+      batch->Inflow[i] = current->inflow;
+      batch->Lateral[i] = current->lateral_inflow;
+      batch->Storage[i] = current->storage;
+    }
+
+    if (cnet->nthreads > 1 && end - start >= THREAD_SEGMENTS * cnet->nthreads) {
+      chunk = (end - start + cnet->nthreads - 1) / cnet->nthreads;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(cnet->nthreads)
+#endif
+      for (t = 0; t < cnet->nthreads; t++) {
+        if (start + t * chunk < end)
+          RouteLevel(batch, start + t * chunk,
+                     (start + (t + 1) * chunk < end) ?
+                     start + (t + 1) * chunk : end, (float) deltat);
+      }
+    }
+    else
+      RouteLevel(batch, start, end, (float) deltat);
+
+    /* segmented scatter, in routing order */
+    for (i = start; i < end; i++) {
+      current = cnet->route[i];
+      current->outflow = batch->Outflow[i];
+      current->storage = batch->Storage[i];
+      if (batch->Outlet[i] >= 0)
+        cnet->route[batch->Outlet[i]]->inflow += batch->Outflow[i];
+    }
+  }
+
+  return 0;
+}
+
+/*****************************************************************************
+  Function name: SelectChannelKernels()
+
+  Purpose      : Use the routing loop of SIMD Level
+*****************************************************************************/
+void SelectChannelKernels(int Level)
+{
+  RouteLevel = RouteLevel_sse2;
+#ifdef HAVE_SIMD_DISPATCH
+  if (Level == SIMD_AVX2)
+    RouteLevel = RouteLevel_avx2;
+  else if (Level == SIMD_AVX512)
+    RouteLevel = RouteLevel_avx512;
+#endif
+}
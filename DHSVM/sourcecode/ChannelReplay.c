@@ -0,0 +1,281 @@
+/*
+ * SUMMARY:      ChannelReplay.c - Record the lateral inflows of the streams
+ *               and route them again
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS CHANNEL INFLOW RECORD = TRUE a run writes the
+ *               lateral inflow of each stream segment at each time step to
+ *               Stream.Inflow.bin in the output directory.  DHSVM
+ *               --route-only then routes a recorded file through the stream
+ *               network of a configuration file, with its own stream class
+ *               and network files, without the rest of the model
+ * DESCRIP-END.
+ * FUNCTIONS:    WriteChannelRecordHeader()
+ *               SaveChannelRecord()
+ *               dhsvm_route_only()
+ *               ReadRecord()
+ * COMMENTS:     The lateral inflow of a segment holds everything that
+ *               drains to it in a time step: the channel interception and
+ *               the subsurface flow of its cells, their surface water and
+ *               the culvert flow of the roads.  Between the time steps the
+ *               routing only keeps the storage of the segments, so with the
+ *               storage before the first step the routing of the run can be
+ *               repeated exactly.  Changes to the stream classes (width,
+ *               friction) or the segment lengths and slopes can be studied
+ *               with the routing alone, but not changes to the roads, whose
+ *               culvert flow returns to the cells, or to the segments the
+ *               water drains to.  The stream temperature is not routed.
+ *
+ *               The file is in native byte order:
+ *                 CHANNEL_RECORD_MAGIC, version, number of segments and
+ *                 the id of each segment, in routing order (ints)
+ *                 the storage of each segment before the first step (m3)
+ *                 each time step: the date (CHANNEL_BIN_DATELEN chars) and
+ *                 the lateral inflow of each segment (m3)
+ *               The values are floats.  The storage is written with the
+ *               first step that is saved, after the spin-up.  The routing
+ *               uses the TIME STEP of the configuration file, which has to
+ *               be that of the recorded run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "DHSVMChannel.h"
+#include "fileio.h"
+#include "functions.h"
+#include "getinit.h"
+#include "profile.h"
+#include "dhsvm.h"
+
+#define CHANNEL_RECORD_MAGIC   "DHSVMLAT"
+#define CHANNEL_RECORD_VERSION 1
+
+static void ReadRecord(void *Data, size_t Size, size_t N, FILE *InFile,
+		       const char *FileName);
+
+/* -------------------------------------------------------------
+   WriteChannelRecordHeader
+   Writes the header of Stream.Inflow.bin for the compiled stream
+   network
+   ------------------------------------------------------------- */
+void WriteChannelRecordHeader(FILE *Out, ChannelNetwork *cnet)
+{
+  int Version = CHANNEL_RECORD_VERSION;
+  int Id;
+  int i;
+
+  if (fwrite(CHANNEL_RECORD_MAGIC, sizeof(char),
+	     strlen(CHANNEL_RECORD_MAGIC), Out) != strlen(CHANNEL_RECORD_MAGIC)
+      || fwrite(&Version, sizeof(int), 1, Out) != 1 ||
+      fwrite(&(cnet->nseg), sizeof(int), 1, Out) != 1)
+    ReportError("Stream.Inflow.bin", 72);
+  for (i = 0; i < cnet->nseg; i++) {
+    Id = cnet->seg[i]->id;
+    if (fwrite(&Id, sizeof(int), 1, Out) != 1)
+      ReportError("Stream.Inflow.bin", 72);
+  }
+}
+
+/* -------------------------------------------------------------
+   SaveChannelRecord
+   Writes the lateral inflows of a time step, before the network
+   is routed.  At the first step the storage is written first.
+   ------------------------------------------------------------- */
+void SaveChannelRecord(FILE *Out, ChannelNetwork *cnet, char *Date)
+{
+  char Buffer[CHANNEL_BIN_DATELEN];
+  long HeaderSize;
+  int i;
+
+  HeaderSize = (long) (strlen(CHANNEL_RECORD_MAGIC) +
+		       (2 + cnet->nseg) * sizeof(int));
+  if (ftell(Out) == HeaderSize) {
+    for (i = 0; i < cnet->nseg; i++) {
+      if (fwrite(&(cnet->route[i]->storage), sizeof(float), 1, Out) != 1)
+	ReportError("Stream.Inflow.bin", 72);
+    }
+  }
+
+  memset(Buffer, 0, CHANNEL_BIN_DATELEN);
+  strncpy(Buffer, Date, CHANNEL_BIN_DATELEN - 1);
+  if (fwrite(Buffer, sizeof(char), CHANNEL_BIN_DATELEN, Out) !=
+      CHANNEL_BIN_DATELEN)
+    ReportError("Stream.Inflow.bin", 72);
+  for (i = 0; i < cnet->nseg; i++) {
+    if (fwrite(&(cnet->route[i]->lateral_inflow), sizeof(float), 1, Out) != 1)
+      ReportError("Stream.Inflow.bin", 72);
+  }
+}
+
+/* -------------------------------------------------------------
+   dhsvm_route_only
+   Routes the lateral inflows of RecordFile through the stream
+   network of ConfigFile, and writes the stream flow files to its
+   OUTPUT DIRECTORY as a full run does.  The network may differ
+   from the recorded one in its classes and the length and slope
+   of its segments.  Returns the number of time steps routed.
+   ------------------------------------------------------------- */
+int dhsvm_route_only(const char *RecordFile, const char *ConfigFile)
+{
+  const char *Routine = "dhsvm_route_only";
+  LISTPTR Input = NULL;
+  OPTIONSTRUCT Options;
+  MAPSIZE Map;
+  SOLARGEOMETRY SolarGeo;
+  TIMESTRUCT Time;
+  CHANNEL ChannelData;
+  STRINIENTRY StrEnv[] = {
+    {"ROUTING", "STREAM NETWORK FILE", "", ""},
+    {"ROUTING", "STREAM CLASS FILE", "", ""},
+    {"OUTPUT", "OUTPUT DIRECTORY", "", ""},
+    {NULL, NULL, "", NULL}
+  };
+  FILE *InFile;
+  char ConfigName[BUFSIZE + 1];
+  char Magic[sizeof(CHANNEL_RECORD_MAGIC)];
+  char Date[CHANNEL_BIN_DATELEN];
+  char *Keep;			/* TRUE for the recorded segment ids */
+  double Start;
+  float *Values;		/* storage or lateral inflow of the recorded
+				   segments */
+  int *Ids;			/* ids of the recorded segments */
+  int *Index;			/* index in the routed network of each
+				   recorded segment */
+  int Version;
+  int NSeg;
+  int MaxID;
+  int NSteps;
+  int i;
+
+  Start = WallClock();
+  strncpy(ConfigName, ConfigFile, BUFSIZE);
+  ConfigName[BUFSIZE] = '\0';
+  memset(&Options, 0, sizeof(OPTIONSTRUCT));
+  memset(&ChannelData, 0, sizeof(CHANNEL));
+
+  printf("Routing %s through the streams of %s\n", RecordFile, ConfigFile);
+  ReadInitFile(ConfigName, &Input);
+  InitConstants(Input, &Options, &Map, &SolarGeo, &Time);
+  for (i = 0; StrEnv[i].SectionName; i++) {
+    GetInitString(StrEnv[i].SectionName, StrEnv[i].KeyName, StrEnv[i].Default,
+		  StrEnv[i].VarStr, (unsigned long) BUFSIZE, Input);
+    if (IsEmptyStr(StrEnv[i].VarStr))
+      ReportError(StrEnv[i].KeyName, 51);
+  }
+
+  /* header of the record */
+  if (!(InFile = fopen(RecordFile, "rb")))
+    ReportError((char *) RecordFile, 3);
+  memset(Magic, 0, sizeof(Magic));
+  ReadRecord(Magic, sizeof(char), strlen(CHANNEL_RECORD_MAGIC), InFile,
+	     RecordFile);
+  ReadRecord(&Version, sizeof(int), 1, InFile, RecordFile);
+  ReadRecord(&NSeg, sizeof(int), 1, InFile, RecordFile);
+  if (strcmp(Magic, CHANNEL_RECORD_MAGIC) != 0 ||
+      Version != CHANNEL_RECORD_VERSION || NSeg < 1)
+    ReportError((char *) RecordFile, 83);
+  if (!(Ids = (int *) calloc(NSeg, sizeof(int))) ||
+      !(Index = (int *) calloc(NSeg, sizeof(int))) ||
+      !(Values = (float *) calloc(NSeg, sizeof(float))))
+    ReportError((char *) Routine, 1);
+  ReadRecord(Ids, sizeof(int), NSeg, InFile, RecordFile);
+
+  /* the stream network, with only the recorded segments if the run was
+     for a SUB-BASIN OUTLET */
+  channel_init();
+  if (!(ChannelData.stream_class =
+	channel_read_classes(StrEnv[1].VarStr, stream_class)))
+    ReportError(StrEnv[1].VarStr, 5);
+  if (!(ChannelData.streams = channel_read_network(StrEnv[0].VarStr,
+						   ChannelData.stream_class,
+						   &MaxID)))
+    ReportError(StrEnv[0].VarStr, 5);
+  if (!(Keep = (char *) calloc(MaxID + 1, sizeof(char))))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < NSeg; i++) {
+    if (Ids[i] < 0 || Ids[i] > MaxID)
+      ReportError((char *) RecordFile, 83);
+    Keep[Ids[i]] = TRUE;
+  }
+  ChannelData.streams = channel_prune_network(ChannelData.streams, Keep);
+  free(Keep);
+  ChannelData.stream_net = channel_compile_network(ChannelData.streams,
+						   MaxID);
+  if (ChannelData.stream_net->nseg != NSeg)
+    ReportError((char *) RecordFile, 83);
+  for (i = 0; i < NSeg; i++) {
+    if ((Index[i] = ChannelData.stream_net->index[Ids[i]]) < 0)
+      ReportError((char *) RecordFile, 83);
+  }
+  channel_routing_parameters(ChannelData.streams,
+			     (double) (Time.Dt / Options.RoutingSubsteps));
+  if (Options.ParallelRouting)
+    channel_network_threads(ChannelData.stream_net, Options.NThreads);
+  channel_network_substeps(ChannelData.stream_net, Options.RoutingSubsteps);
+  if (Options.RoutingBatch)
+    channel_network_batch(ChannelData.stream_net);
+
+  /* the stream flow output of a full run, without the stream temperature
+     and without a record of its own */
+  Options.StreamTemp = FALSE;
+  Options.ChannelRecord = FALSE;
+  InitChannelDump(&Options, &ChannelData, StrEnv[2].VarStr);
+
+  ReadRecord(Values, sizeof(float), NSeg, InFile, RecordFile);
+  for (i = 0; i < NSeg; i++)
+    ChannelData.stream_net->route[Index[i]]->storage = Values[i];
+
+  for (NSteps = 0;
+       fread(Date, sizeof(char), CHANNEL_BIN_DATELEN, InFile) ==
+       CHANNEL_BIN_DATELEN; NSteps++) {
+    Date[CHANNEL_BIN_DATELEN - 1] = '\0';
+    ReadRecord(Values, sizeof(float), NSeg, InFile, RecordFile);
+    channel_step_initialize_network(ChannelData.streams);
+    for (i = 0; i < NSeg; i++)
+      ChannelData.stream_net->route[Index[i]]->lateral_inflow = Values[i];
+    channel_route_network(ChannelData.stream_net, Time.Dt);
+    if (Options.ChannelOutput == CHANNEL_BINARY)
+      channel_save_outflow_bin(Date, ChannelData.streams,
+			       ChannelData.streamout);
+    else if (Options.ChannelOutput == CHANNEL_TEXT)
+      channel_save_outflow_text(Date, ChannelData.streams,
+				ChannelData.streamout,
+				ChannelData.streamflowout, NSteps == 0);
+  }
+  fclose(InFile);
+
+  if (ChannelData.streamout != NULL)
+    fclose(ChannelData.streamout);
+  if (ChannelData.streamflowout != NULL)
+    fclose(ChannelData.streamflowout);
+  printf("Routed %d time steps of %d segments in %.3f s\n", NSteps, NSeg,
+	 WallClock() - Start);
+
+  channel_free_compiled_network(ChannelData.stream_net);
+  channel_free_network(ChannelData.streams);
+  channel_free_classes(ChannelData.stream_class);
+  channel_done();
+  DeleteList(Input);
+  free(Options.EnsemblePrecip);
+  free(Ids);
+  free(Index);
+  free(Values);
+  return NSteps;
+}
+
+/* -------------------------------------------------------------
+   ReadRecord
+   ------------------------------------------------------------- */
+static void ReadRecord(void *Data, size_t Size, size_t N, FILE *InFile,
+		       const char *FileName)
+{
+  if (fread(Data, Size, N, InFile) != N)
+    ReportError((char *) FileName, 5);
+}
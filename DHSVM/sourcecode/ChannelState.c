@@ -85,7 +85,7 @@ void ReadChannelState(char *Path, DATE *Now, Channel *Head)
       max_seg = Current->id;
     if (Match == NULL)
       ReportError("ReadChannelState", 55);
-    Current->storage = Match->storage;
+    Current->route->storage = Match->storage;
     Current = Current->next;
   }
 
@@ -120,7 +120,7 @@ void StoreChannelState(char *Path, DATE * Now, Channel * Head)
   Current = Head;
   while (Current) {
     fprintf(OutFile, "%12hu ", Current->id);
-    fprintf(OutFile, "%12g\n", Current->storage);
+    fprintf(OutFile, "%12g\n", Current->route->storage);
     Current = Current->next;
   }
 
@@ -0,0 +1,80 @@
+/*
+ * SUMMARY:      CpuDispatch.c - Vector kernels for the processor of the run
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The vector loops of RADIATION BATCH, INTERCEPTION BATCH,
+ *               SOIL COLUMN BATCH and CHANNEL ROUTING BATCH are compiled for SSE2, AVX2 and AVX-512,
+ *               so that one binary built without -march runs the widest
+ *               vectors of each node.  At the start of the run the instruction sets of
+ *               the processor are read with cpuid, and the kernels of the
+ *               highest level it supports are selected once, through the
+ *               function pointers of the kernel files.  OPTIONS SIMD LEVEL
+ *               selects a lower level instead.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitCpuDispatch()
+ *               SimdLevelName()
+ * COMMENTS:     The kernels of all the levels do the operations of the
+ *               scalar code in the same order and are compiled without the
+ *               contraction of a multiply and an add into one FMA, so the
+ *               results do not depend on the level.  A level that the
+ *               processor, or the compiler of the build, does not support
+ *               is replaced with the highest one it does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "cpudispatch.h"
+
+static const char *LevelName[NSIMDLEVELS] = { "SSE2", "AVX2", "AVX512" };
+
+/*****************************************************************************
+  InitCpuDispatch()
+
+  Selects the kernels of level Forced, or of the highest level of the
+  processor for SIMD_AUTO, and returns the level that is used
+*****************************************************************************/
+int InitCpuDispatch(int Forced)
+{
+  int Supported = SIMD_SSE2;
+  int Level;
+
+#ifdef HAVE_SIMD_DISPATCH
+  /* libgcc also checks that the operating system saves the vector
+     registers */
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    Supported = SIMD_AVX2;
+  if (__builtin_cpu_supports("avx512f"))
+    Supported = SIMD_AVX512;
+#endif
+
+  if (Forced == SIMD_AUTO)
+    Level = Supported;
+  else if (Forced > Supported) {
+    printf("WARNING: SIMD LEVEL %s is not supported on this processor, "
+	   "using %s\n", LevelName[Forced], LevelName[Supported]);
+    Level = Supported;
+  }
+  else
+    Level = Forced;
+
+  SelectRadiationKernels(Level);
+  SelectInterceptionKernels(Level);
+  SelectSoilKernels(Level);
+  SelectChannelKernels(Level);
+  return Level;
+}
+
+/*****************************************************************************
+  SimdLevelName()
+*****************************************************************************/
+const char *SimdLevelName(int Level)
+{
+  if (Level < 0 || Level >= NSIMDLEVELS)
+    return "AUTO";
+  return LevelName[Level];
+}
@@ -11,8 +11,14 @@
    ------------------------------------------------------------- */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "constants.h"
 #include "getinit.h"
 #include "DHSVMChannel.h"
@@ -21,10 +27,120 @@
 #include "settings.h"
 #include "errorhandler.h"
 #include "fileio.h"
+#include "rollover.h"
+
+/* stdio buffer of the binary channel flow files */
+#define CHANNEL_OUTBUF (1 << 20)
+
+/* stream routing of a time step that runs in a thread of its own with
+   OPTIONS PIPELINE CHANNEL ROUTING, from RouteChannel() until
+   WaitChannelRouting().  The date and the output flags are those of the
+   step, the main thread goes on with the next one */
+typedef struct {
+  CHANNEL *ChannelData;
+  OPTIONSTRUCT *Options;
+  TIMESTRUCT Time;		/* model time of the step */
+  char Date[32];		/* date of the step, for the output */
+  int First;			/* TRUE at the first step of the run */
+  int Save;			/* FALSE while the model is spun up */
+  int Running;			/* TRUE until WaitChannelRouting() */
+#ifdef HAVE_PTHREAD
+  pthread_t Thread;
+#endif
+} STREAMROUTING;
+
+static STREAMROUTING Pipeline;
+
+#ifdef HAVE_PTHREAD
+/* road routing of a time step that runs in a thread of its own with
+   OPTIONS CONCURRENT NETWORK ROUTING, while RouteChannel() prepares the
+   stream inflows.  Routed is set when the road outflows are known, the
+   road output is written after that, until the thread is joined at the
+   end of RouteChannel() */
+typedef struct {
+  CHANNEL *ChannelData;
+  OPTIONSTRUCT *Options;
+  int Dt;			/* time step (s) */
+  char Date[32];		/* date of the step, for the output */
+  int First;			/* TRUE at the first step of the run */
+  int Save;			/* FALSE while the model is spun up */
+  int Routed;			/* TRUE once the road network is routed */
+  pthread_t Thread;
+} ROADROUTING;
+
+static ROADROUTING RoadTask;
+static pthread_mutex_t RoadLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t RoadsRouted = PTHREAD_COND_INITIALIZER;
+#endif
+
+/* an output file of InitChannelDump(), Roll is FALSE for the files that are
+   read back as one file and do not start again with OUTPUT ROLLOVER */
+typedef struct {
+  FILE **File;
+  const char *Name;
+  int Roll;
+} CHANNELDUMP;
+
+#define NCHANNELDUMPS 19
+
+static void ChannelDumpFiles(OPTIONSTRUCT *Options, CHANNEL *channel,
+			     CHANNELDUMP *Files);
+
+static void AddCulvertFlows(CHANNEL *ChannelData, MAPSIZE *Map,
+			    SOILPIX **SoilMap, AGGREGATED *Total,
+			    float *IExcess);
+static void StartStreamRouting(CHANNEL *ChannelData, TIMESTRUCT *Time,
+			       OPTIONSTRUCT *Options, char *buffer, int flag,
+			       int save);
+static void RouteStreams(CHANNEL *ChannelData, TIMESTRUCT *Time,
+			 OPTIONSTRUCT *Options, char *buffer, int flag,
+			 int save);
+static void SaveRoads(CHANNEL *ChannelData, OPTIONSTRUCT *Options,
+		      char *buffer, int flag);
+static void SaveStreams(CHANNEL *ChannelData, TIMESTRUCT *Time,
+			OPTIONSTRUCT *Options, char *buffer, int flag);
+#ifdef HAVE_PTHREAD
+static void PrepareStreamInflows(CHANNEL *ChannelData, MAPSIZE *Map,
+				 SOILPIX **SoilMap, float *IExcess);
+static void *RouteRoadsTask(void *Arg);
+static void *RouteStreamsTask(void *Arg);
+#endif
+
+/* channel network cache (STREAM CACHE FILE and ROAD CACHE FILE), the first
+   8 bytes of the file, and the files a network is read from: class,
+   network, map and riparian vegetation file */
+#define CHANNEL_CACHE_MAGIC    "DHSVMCHN"
+#define CHANNEL_CACHE_VERSION  1
+#define CHANNEL_CACHE_NSOURCES 4
+
+/* signature of a file the cache was made from, all zero for a file
+   that is not read */
+typedef struct {
+  unint Hash;			/* FNV-1a hash of the contents */
+  int Used;			/* TRUE if the file is read */
+  long Size;			/* size in bytes */
+  long MTime;			/* time of the last modification */
+} CHANNELSOURCE;
+
+static void ChannelSource(const char *FileName, CHANNELSOURCE *Source);
+static int ReadChannelCache(const char *CacheFile, int ChanType,
+			    CHANNELSOURCE *Sources, const char *MapFile,
+			    SOILPIX **SoilMap, ChannelClass **Class,
+			    Channel **Net, ChannelNetwork **CNet,
+			    ChannelMapPtr ***ChanMap, int *MaxID);
+static void ReadChannelNetwork(const char *CacheFile, const char *ClassFile,
+			       const char *NetworkFile, const char *MapFile,
+			       const char *RvegFile, int ChanType,
+			       SOILPIX **SoilMap, ChannelClass **Class,
+			       Channel **Net, ChannelNetwork **CNet,
+			       ChannelMapPtr ***ChanMap, int *MaxID);
 
 /* -----------------------------------------------------------------------------
    InitChannel
-   Reads stream and road files and builds the networks.
+   Reads stream and road files and builds the networks.  With STREAM
+   CACHE FILE or ROAD CACHE FILE a network is read from a binary
+   cache, which is written the first time and whenever one of the
+   files it was made from changes (see ReadChannelNetwork).
    -------------------------------------------------------------------------- */
 void
 InitChannel(LISTPTR Input, MAPSIZE *Map, int deltat, CHANNEL *channel,
@@ -36,9 +152,12 @@ InitChannel(LISTPTR Input, MAPSIZE *Map, int deltat, CHANNEL *channel,
     {"ROUTING", "STREAM MAP FILE", "", ""},
     {"ROUTING", "STREAM CLASS FILE", "", ""},
 	{"ROUTING", "RIPARIAN VEG FILE", "", ""},
+    {"ROUTING", "STREAM TEMPERATURE PARAMETER FILE", "", "none"},
     {"ROUTING", "ROAD NETWORK FILE", "", "none"},
     {"ROUTING", "ROAD MAP FILE", "", "none"},
     {"ROUTING", "ROAD CLASS FILE", "", "none"},
+    {"ROUTING", "STREAM CACHE FILE", "", "none"},
+    {"ROUTING", "ROAD CACHE FILE", "", "none"},
     {NULL, NULL, "", NULL}
   };
 
@@ -56,6 +175,8 @@ InitChannel(LISTPTR Input, MAPSIZE *Map, int deltat, CHANNEL *channel,
   channel->road_class = NULL;
   channel->streams = NULL;
   channel->roads = NULL;
+  channel->stream_net = NULL;
+  channel->road_net = NULL;
   channel->stream_map = NULL;
   channel->road_map = NULL;
 
@@ -66,54 +187,279 @@ InitChannel(LISTPTR Input, MAPSIZE *Map, int deltat, CHANNEL *channel,
 
     printf("\tReading Stream data\n");
 
-    if ((channel->stream_class =
-	 channel_read_classes(StrEnv[stream_class].VarStr, stream_class)) == NULL) {
-      ReportError(StrEnv[stream_class].VarStr, 5);
-    }
-    if ((channel->streams =
-	 channel_read_network(StrEnv[stream_network].VarStr,
-			      channel->stream_class, MaxStreamID)) == NULL) {
-      ReportError(StrEnv[stream_network].VarStr, 5);
-    }
-    if ((channel->stream_map =
-	 channel_grid_read_map(channel->streams,
-			       StrEnv[stream_map].VarStr, SoilMap)) == NULL) {
-      ReportError(StrEnv[stream_map].VarStr, 5);
-    }
+    ReadChannelNetwork(StrEnv[stream_cache].VarStr, StrEnv[stream_class].VarStr,
+		       StrEnv[stream_network].VarStr, StrEnv[stream_map].VarStr,
+		       (Options->StreamTemp &&
+			strncmp(StrEnv[riparian_veg].VarStr, "none", 4)) ?
+		       StrEnv[riparian_veg].VarStr : NULL, stream_class,
+		       SoilMap, &(channel->stream_class), &(channel->streams),
+		       &(channel->stream_net), &(channel->stream_map),
+		       MaxStreamID);
     error_handler(ERRHDL_STATUS,
 		  "InitChannel: computing stream network routing coefficients");
-    channel_routing_parameters(channel->streams, (double) deltat);
+    channel_routing_parameters(channel->streams,
+			       (double) (deltat / Options->RoutingSubsteps));
+    if (Options->ParallelRouting)
+      channel_network_threads(channel->stream_net, Options->NThreads);
+    channel_network_substeps(channel->stream_net, Options->RoutingSubsteps);
+    if (Options->RoutingBatch)
+      channel_network_batch(channel->stream_net);
   }
 
   if (Options->StreamTemp) {
-	if (strncmp(StrEnv[riparian_veg].VarStr, "none", 4)) {
-	  printf("\tReading channel riparian vegetation params\n");
-	  channel_read_rveg_param(channel->streams, StrEnv[riparian_veg].VarStr, MaxStreamID);
-	}
+    if (Options->StreamTempSolver == STREAMTEMP_INTERNAL &&
+	channel->stream_net != NULL &&
+	strncmp(StrEnv[stream_temp_param].VarStr, "none", 4)) {
+      printf("\tReading stream temperature params\n");
+      ReadStreamTempParam(channel->stream_net,
+			  StrEnv[stream_temp_param].VarStr);
+    }
   }
 
   if (strncmp(StrEnv[road_class].VarStr, "none", 4)) {
 
     printf("\tReading Road data\n");
 
-    if ((channel->road_class =
-	 channel_read_classes(StrEnv[road_class].VarStr, road_class) == NULL)) {
-      ReportError(StrEnv[road_class].VarStr, 5);
+    ReadChannelNetwork(StrEnv[road_cache].VarStr, StrEnv[road_class].VarStr,
+		       StrEnv[road_network].VarStr, StrEnv[road_map].VarStr,
+		       NULL, road_class, SoilMap, &(channel->road_class),
+		       &(channel->roads), &(channel->road_net),
+		       &(channel->road_map), MaxRoadID);
+    error_handler(ERRHDL_STATUS,
+		  "InitChannel: computing road network routing coefficients");
+    channel_routing_parameters(channel->roads,
+			       (double) (deltat / Options->RoutingSubsteps));
+    if (Options->ParallelRouting)
+      channel_network_threads(channel->road_net, Options->NThreads);
+    channel_network_substeps(channel->road_net, Options->RoutingSubsteps);
+    if (Options->RoutingBatch)
+      channel_network_batch(channel->road_net);
+  }
+
+  InitChannelCells(Map, channel);
+}
+
+/* -------------------------------------------------------------
+   ChannelSource
+   Size, modification time and hash of the contents of a file the
+   channel network cache is made from.  FileName is NULL for a file
+   that is not read.
+   ------------------------------------------------------------- */
+static void ChannelSource(const char *FileName, CHANNELSOURCE *Source)
+{
+  struct stat FileInfo;
+  unsigned char Buffer[BUFSIZ];
+  FILE *InFile;
+  size_t N;
+  size_t i;
+
+  memset(Source, 0, sizeof(CHANNELSOURCE));
+  if (FileName == NULL || stat(FileName, &FileInfo) != 0 ||
+      (InFile = fopen(FileName, "rb")) == NULL)
+    return;
+
+  Source->Used = TRUE;
+  Source->Size = (long) FileInfo.st_size;
+  Source->MTime = (long) FileInfo.st_mtime;
+  Source->Hash = 2166136261u;
+  while ((N = fread(Buffer, 1, sizeof(Buffer), InFile)) > 0) {
+    for (i = 0; i < N; i++) {
+      Source->Hash ^= Buffer[i];
+      Source->Hash *= 16777619u;
     }
-    if ((channel->roads =
-	 channel_read_network(StrEnv[road_network].VarStr,
-			      channel->road_class, MaxRoadID)) == NULL) {
-      ReportError(StrEnv[road_network].VarStr, 5);
+  }
+  fclose(InFile);
+}
+
+/* -------------------------------------------------------------
+   ReadChannelCache
+   Reads a network from the channel network cache CacheFile.  The
+   cache has a header with CHANNEL_CACHE_MAGIC, the version, the
+   channel type, the signatures of the source files and the largest
+   segment id, the classes and segments (channel_write_cache), and
+   the records of the map file (ChannelCrossing).  The whole file is
+   read into the stdio buffer at once.  Returns FALSE, with a warning
+   if the file exists, if the cache cannot be used; the network is
+   then read from the source files.
+   ------------------------------------------------------------- */
+static int ReadChannelCache(const char *CacheFile, int ChanType,
+			    CHANNELSOURCE *Sources, const char *MapFile,
+			    SOILPIX **SoilMap, ChannelClass **Class,
+			    Channel **Net, ChannelNetwork **CNet,
+			    ChannelMapPtr ***ChanMap, int *MaxID)
+{
+  struct stat FileInfo;
+  char Magic[sizeof(CHANNEL_CACHE_MAGIC)];
+  CHANNELSOURCE Cached[CHANNEL_CACHE_NSOURCES];
+  ChannelCrossing *Cross = NULL;
+  FILE *CacheFilePtr;
+  int NetMaxID;
+  int NCross;
+  int Version;
+  int Type;
+  int i;
+
+  if (stat(CacheFile, &FileInfo) != 0 ||
+      (CacheFilePtr = fopen(CacheFile, "rb")) == NULL)
+    return FALSE;
+  setvbuf(CacheFilePtr, NULL, _IOFBF,
+	  FileInfo.st_size > 0 ? (size_t) FileInfo.st_size : BUFSIZ);
+
+  memset(Magic, 0, sizeof(Magic));
+  if (fread(Magic, sizeof(char), strlen(CHANNEL_CACHE_MAGIC), CacheFilePtr) !=
+      strlen(CHANNEL_CACHE_MAGIC) || strcmp(Magic, CHANNEL_CACHE_MAGIC) != 0 ||
+      fread(&Version, sizeof(int), 1, CacheFilePtr) != 1 ||
+      Version != CHANNEL_CACHE_VERSION ||
+      fread(&Type, sizeof(int), 1, CacheFilePtr) != 1 || Type != ChanType ||
+      fread(Cached, sizeof(CHANNELSOURCE), CHANNEL_CACHE_NSOURCES,
+	    CacheFilePtr) != CHANNEL_CACHE_NSOURCES ||
+      fread(MaxID, sizeof(int), 1, CacheFilePtr) != 1) {
+    ReportWarning((char *) CacheFile, 81);
+    fclose(CacheFilePtr);
+    return FALSE;
+  }
+  for (i = 0; i < CHANNEL_CACHE_NSOURCES; i++) {
+    if (Cached[i].Used != Sources[i].Used ||
+	Cached[i].Size != Sources[i].Size ||
+	Cached[i].MTime != Sources[i].MTime ||
+	Cached[i].Hash != Sources[i].Hash) {
+      ReportWarning((char *) CacheFile, 81);
+      fclose(CacheFilePtr);
+      return FALSE;
     }
-    if ((channel->road_map =
-	 channel_grid_read_map(channel->roads,
-			       StrEnv[road_map].VarStr, SoilMap)) == NULL) {
-      ReportError(StrEnv[road_map].VarStr, 5);
+  }
+
+  if ((*Net = channel_read_cache(CacheFilePtr, Class, &NetMaxID)) == NULL ||
+      fread(&NCross, sizeof(int), 1, CacheFilePtr) != 1 || NCross < 0 ||
+      (Cross = (ChannelCrossing *) malloc((NCross + 1) *
+					  sizeof(ChannelCrossing))) == NULL ||
+      fread(Cross, sizeof(ChannelCrossing), NCross, CacheFilePtr) !=
+      (size_t) NCross) {
+    ReportWarning((char *) CacheFile, 81);
+    if (*Net != NULL) {
+      channel_free_network(*Net);
+      channel_free_classes(*Class);
     }
-    error_handler(ERRHDL_STATUS,
-		  "InitChannel: computing road network routing coefficients");
-    channel_routing_parameters(channel->roads, (double) deltat);
+    *Net = NULL;
+    *Class = NULL;
+    free(Cross);
+    fclose(CacheFilePtr);
+    return FALSE;
   }
+  fclose(CacheFilePtr);
+
+  *CNet = channel_compile_network(*Net, NetMaxID);
+  if ((*ChanMap = channel_grid_build_map(*CNet, Cross, NCross, SoilMap,
+					 MapFile)) == NULL)
+    ReportError((char *) MapFile, 5);
+  free(Cross);
+
+  printf("\tRead the network from the channel network cache %s\n", CacheFile);
+  return TRUE;
+}
+
+/* -------------------------------------------------------------
+   ReadChannelNetwork
+   Reads the classes, the network and the map of the streams or the
+   roads, and the riparian vegetation parameters of the streams if
+   RvegFile is not NULL, and compiles the network.  If CacheFile is
+   not "none" the network is read from that cache if it was made
+   from the same files, otherwise the cache is (re)written after the
+   files are read.
+   ------------------------------------------------------------- */
+static void ReadChannelNetwork(const char *CacheFile, const char *ClassFile,
+			       const char *NetworkFile, const char *MapFile,
+			       const char *RvegFile, int ChanType,
+			       SOILPIX **SoilMap, ChannelClass **Class,
+			       Channel **Net, ChannelNetwork **CNet,
+			       ChannelMapPtr ***ChanMap, int *MaxID)
+{
+  CHANNELSOURCE Sources[CHANNEL_CACHE_NSOURCES];
+  ChannelCrossing *Cross;
+  FILE *CacheFilePtr;
+  int UseCache;
+  int Version = CHANNEL_CACHE_VERSION;
+  int NCross;
+  int RvegErr = 0;
+
+  UseCache = strncmp(CacheFile, "none", 4);
+  if (UseCache) {
+    ChannelSource(ClassFile, &(Sources[0]));
+    ChannelSource(NetworkFile, &(Sources[1]));
+    ChannelSource(MapFile, &(Sources[2]));
+    ChannelSource(RvegFile, &(Sources[3]));
+    if (ReadChannelCache(CacheFile, ChanType, Sources, MapFile, SoilMap,
+			 Class, Net, CNet, ChanMap, MaxID))
+      return;
+  }
+
+  if ((*Class = channel_read_classes(ClassFile, ChanType)) == NULL)
+    ReportError((char *) ClassFile, 5);
+  if ((*Net = channel_read_network(NetworkFile, *Class, MaxID)) == NULL)
+    ReportError((char *) NetworkFile, 5);
+  *CNet = channel_compile_network(*Net, *MaxID);
+  if ((Cross = channel_grid_read_crossings(MapFile, &NCross)) == NULL ||
+      (*ChanMap = channel_grid_build_map(*CNet, Cross, NCross, SoilMap,
+					 MapFile)) == NULL)
+    ReportError((char *) MapFile, 5);
+  if (RvegFile != NULL) {
+    printf("\tReading channel riparian vegetation params\n");
+    RvegErr = channel_read_rveg_param(*Net, RvegFile, MaxID);
+  }
+
+  if (UseCache && RvegErr == 0) {
+    OpenFile(&CacheFilePtr, (char *) CacheFile, "wb", TRUE);
+    if (fwrite(CHANNEL_CACHE_MAGIC, sizeof(char), strlen(CHANNEL_CACHE_MAGIC),
+	       CacheFilePtr) != strlen(CHANNEL_CACHE_MAGIC) ||
+	fwrite(&Version, sizeof(int), 1, CacheFilePtr) != 1 ||
+	fwrite(&ChanType, sizeof(int), 1, CacheFilePtr) != 1 ||
+	fwrite(Sources, sizeof(CHANNELSOURCE), CHANNEL_CACHE_NSOURCES,
+	       CacheFilePtr) != CHANNEL_CACHE_NSOURCES ||
+	fwrite(MaxID, sizeof(int), 1, CacheFilePtr) != 1 ||
+	channel_write_cache(CacheFilePtr, *Class, *Net) != 0 ||
+	fwrite(&NCross, sizeof(int), 1, CacheFilePtr) != 1 ||
+	fwrite(Cross, sizeof(ChannelCrossing), NCross, CacheFilePtr) !=
+	(size_t) NCross || fclose(CacheFilePtr) != 0)
+      ReportError((char *) CacheFile, 72);
+    printf("\tWrote the channel network cache %s\n", CacheFile);
+  }
+  free(Cross);
+}
+
+/* -------------------------------------------------------------
+   InitChannelCells
+   Lists the active cells that RouteChannel() has to visit: road 
+   cells without a sink, which take the surface water, and cells 
+   with a stream channel or a road sink (culvert), which exchange 
+   water with the channels.  Both lists are in Map->ActiveCells 
+   order, which is the order of the full-grid sweeps they replace.
+   ------------------------------------------------------------- */
+void InitChannelCells(MAPSIZE *Map, CHANNEL *channel)
+{
+  const char *Routine = "InitChannelCells";
+  int i, x, y;
+  int road;
+  int stream;
+
+  channel->nroad_cells = 0;
+  channel->nstream_cells = 0;
+  if (!(channel->road_cells = (int *) calloc(Map->NumActive, sizeof(int))))
+    ReportError((char *) Routine, 1);
+  if (!(channel->stream_cells = (int *) calloc(Map->NumActive, sizeof(int))))
+    ReportError((char *) Routine, 1);
+
+  for (i = 0; i < Map->NumActive; i++) {
+    y = Map->ActiveCells[i].y;
+    x = Map->ActiveCells[i].x;
+    road = channel_grid_has_channel(channel->road_map, x, y);
+    stream = channel_grid_has_channel(channel->stream_map, x, y);
+    if (road && !channel_grid_has_sink(channel->road_map, x, y))
+      channel->road_cells[channel->nroad_cells++] = i;
+    if (stream || (road && channel_grid_has_sink(channel->road_map, x, y)))
+      channel->stream_cells[channel->nstream_cells++] = i;
+  }
+  printf("	%d road cells without a sink, %d stream and culvert cells\n",
+	 channel->nroad_cells, channel->nstream_cells);
 }
 
 /* -------------------------------------------------------------
@@ -122,62 +468,230 @@ InitChannel(LISTPTR Input, MAPSIZE *Map, int deltat, CHANNEL *channel,
 void InitChannelDump(OPTIONSTRUCT *Options, CHANNEL * channel, 
 					 char *DumpPath)
 {
-  char buffer[NAMESIZE];
+  const char *Routine = "InitChannelDump";
+  char buffer[BUFSIZE + 1];
+  Channel *seg;
+  int nseg;
 
   if (channel->streams != NULL) {
-    sprintf(buffer, "%sStream.Flow", DumpPath);
-    OpenFile(&(channel->streamout), buffer, "w", TRUE);
-    sprintf(buffer, "%sStreamflow.Only", DumpPath);
-    OpenFile(&(channel->streamflowout), buffer, "w", TRUE);
-    /* output files for John's RBM model */
-	if (Options->StreamTemp) {
+    if (Options->ChannelOutput == CHANNEL_BINARY) {
+      sprintf(buffer, "%sStream.Flow.bin", DumpPath);
+      OpenOutput(&(channel->streamout), buffer, buffer, "wb");
+      setvbuf(channel->streamout, NULL, _IOFBF, CHANNEL_OUTBUF);
+      channel_save_outflow_bin_header(channel->streams, channel->streamout);
+    }
+    else if (Options->ChannelOutput == CHANNEL_TEXT) {
+      sprintf(buffer, "%sStream.Flow", DumpPath);
+      OpenOutput(&(channel->streamout), buffer, buffer, "w");
+      sprintf(buffer, "%sStreamflow.Only", DumpPath);
+      OpenOutput(&(channel->streamflowout), buffer, buffer, "w");
+    }
+    /* lateral inflows for DHSVM --route-only */
+    if (Options->ChannelRecord) {
+      sprintf(buffer, "%sStream.Inflow.bin", DumpPath);
+      OpenFile(&(channel->streamrecord), buffer, "wb", TRUE);
+      setvbuf(channel->streamrecord, NULL, _IOFBF, CHANNEL_OUTBUF);
+      WriteChannelRecordHeader(channel->streamrecord, channel->stream_net);
+    }
+    /* output files for John's RBM model, or the temperatures of the
+       segments if they are solved during the run */
+    if (Options->StreamTemp &&
+	Options->StreamTempSolver == STREAMTEMP_INTERNAL) {
+      sprintf(buffer, "%sStream.Temp", DumpPath);
+      OpenOutput(&(channel->streamtemp), buffer, buffer, "w");
+    }
+    else if (Options->StreamTemp && Options->ChannelOutput == CHANNEL_BINARY) {
+      sprintf(buffer, "%sRBM.Forcing.bin", DumpPath);
+      OpenFile(&(channel->streamforcing), buffer, "wb", TRUE);
+      setvbuf(channel->streamforcing, NULL, _IOFBF, CHANNEL_OUTBUF);
+      for (nseg = 0, seg = channel->streams; seg != NULL; seg = seg->next)
+	nseg++;
+      if (!(channel->forcingrecord = 
+	    (float *) calloc(nseg * NRBMVARS, sizeof(float))))
+	ReportError((char *) Routine, 1);
+    }
+    else if (Options->StreamTemp) {
       //inflow to segment
       sprintf(buffer, "%sInflow.Only", DumpPath);
-      OpenFile(&(channel->streaminflow), buffer, "w", TRUE);
+      OpenOutput(&(channel->streaminflow), buffer, buffer, "w");
       // outflow ( redundant but it's a check
       sprintf(buffer, "%sOutflow.Only", DumpPath);
-      OpenFile(&(channel->streamoutflow), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamoutflow), buffer, buffer, "w");
       // total incoming short wave
       sprintf(buffer, "%sISW.Only", DumpPath);
-      OpenFile(&(channel->streamISW), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamISW), buffer, buffer, "w");
 	  //net incoming short wave
       sprintf(buffer, "%sNSW.Only", DumpPath);
-      OpenFile(&(channel->streamNSW), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamNSW), buffer, buffer, "w");
       // total incoming long wave
       sprintf(buffer, "%sILW.Only", DumpPath);
-      OpenFile(&(channel->streamILW), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamILW), buffer, buffer, "w");
 	  // net incoming long wave
 	  sprintf(buffer, "%sNLW.Only", DumpPath);
-      OpenFile(&(channel->streamNLW), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamNLW), buffer, buffer, "w");
       //Vapor pressure
       sprintf(buffer, "%sVP.Only", DumpPath);
-      OpenFile(&(channel->streamVP), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamVP), buffer, buffer, "w");
       //wind speed
       sprintf(buffer, "%sWND.Only", DumpPath);
-      OpenFile(&(channel->streamWND), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamWND), buffer, buffer, "w");
       //air temperature
       sprintf(buffer, "%sATP.Only", DumpPath);
-      OpenFile(&(channel->streamATP), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamATP), buffer, buffer, "w");
 	  //beam radiation
       sprintf(buffer, "%sBeam.Only", DumpPath);
-      OpenFile(&(channel->streamBeam), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamBeam), buffer, buffer, "w");
 	  //diffuse radiation
       sprintf(buffer, "%sDiffuse.Only", DumpPath);
-      OpenFile(&(channel->streamDiffuse), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamDiffuse), buffer, buffer, "w");
 	  //skyview
       sprintf(buffer, "%sSkyview.Only", DumpPath);
-      OpenFile(&(channel->streamSkyView), buffer, "w", TRUE);
+      OpenOutput(&(channel->streamSkyView), buffer, buffer, "w");
 	}
   }
   if (channel->roads != NULL) {
-    sprintf(buffer, "%sRoad.Flow", DumpPath);
-    OpenFile(&(channel->roadout), buffer, "w", TRUE);
-    sprintf(buffer, "%sRoadflow.Only", DumpPath);
-    OpenFile(&(channel->roadflowout), buffer, "w", TRUE);
+    if (Options->ChannelOutput == CHANNEL_BINARY) {
+      sprintf(buffer, "%sRoad.Flow.bin", DumpPath);
+      OpenOutput(&(channel->roadout), buffer, buffer, "wb");
+      setvbuf(channel->roadout, NULL, _IOFBF, CHANNEL_OUTBUF);
+      channel_save_outflow_bin_header(channel->roads, channel->roadout);
+    }
+    else if (Options->ChannelOutput == CHANNEL_TEXT) {
+      sprintf(buffer, "%sRoad.Flow", DumpPath);
+      OpenOutput(&(channel->roadout), buffer, buffer, "w");
+      sprintf(buffer, "%sRoadflow.Only", DumpPath);
+      OpenOutput(&(channel->roadflowout), buffer, buffer, "w");
+    }
+  }
+}
+
+/* -------------------------------------------------------------
+   ListChannelDump
+   Lists the channel output files opened by InitChannelDump in
+   Path, with the streams open on them, and returns their number.
+   Only counts them if List is NULL.  The names are those of the
+   open OUTPUT ROLLOVER period.
+   ------------------------------------------------------------- */
+int ListChannelDump(OPTIONSTRUCT *Options, CHANNEL * channel, char *Path,
+		    OUTPUTFILE *List)
+{
+  CHANNELDUMP files[NCHANNELDUMPS];
+  char BaseName[BUFSIZE + 1];
+  int i;
+  int n;
+
+  ChannelDumpFiles(Options, channel, files);
+  for (i = 0, n = 0; i < NCHANNELDUMPS; i++) {
+    if (*(files[i].File) == NULL)
+      continue;
+    if (List != NULL) {
+      snprintf(BaseName, BUFSIZE + 1, "%s%s", Path, files[i].Name);
+      if (files[i].Roll)
+	RolloverName(List[n].Name, BaseName);
+      else
+	strcpy(List[n].Name, BaseName);
+      List[n].FilePtr = files[i].File;
+      List[n].Length = 0;
+    }
+    n++;
+  }
+  return n;
+}
+
+/* -------------------------------------------------------------
+   RolloverChannelDump
+   Starts the channel output files in Path again for the new
+   OUTPUT ROLLOVER period, with the headers of the binary flow
+   files.  The lateral inflows and the RBM forcing go on in the
+   files of the run.
+   ------------------------------------------------------------- */
+void RolloverChannelDump(OPTIONSTRUCT *Options, CHANNEL * channel,
+			 char *Path)
+{
+  CHANNELDUMP files[NCHANNELDUMPS];
+  char BaseName[BUFSIZE + 1];
+  char FileName[BUFSIZE + 1];
+  int binary = (Options->ChannelOutput == CHANNEL_BINARY);
+  int i;
 
+  ChannelDumpFiles(Options, channel, files);
+  for (i = 0; i < NCHANNELDUMPS; i++) {
+    if (*(files[i].File) == NULL || !files[i].Roll)
+      continue;
+    snprintf(BaseName, BUFSIZE + 1, "%s%s", Path, files[i].Name);
+    if (binary && (files[i].File == &(channel->streamout) ||
+		   files[i].File == &(channel->roadout))) {
+      OpenOutput(files[i].File, FileName, BaseName, "wb");
+      setvbuf(*(files[i].File), NULL, _IOFBF, CHANNEL_OUTBUF);
+      channel_save_outflow_bin_header((files[i].File == &(channel->streamout))
+				      ? channel->streams : channel->roads,
+				      *(files[i].File));
+    }
+    else
+      OpenOutput(files[i].File, FileName, BaseName, "w");
   }
 }
 
+/* -------------------------------------------------------------
+   ChannelDumpFiles
+   The output files of InitChannelDump, in Files[NCHANNELDUMPS],
+   with a NULL stream if the file is not written
+   ------------------------------------------------------------- */
+static void ChannelDumpFiles(OPTIONSTRUCT *Options, CHANNEL *channel,
+			     CHANNELDUMP *Files)
+{
+  int binary = (Options->ChannelOutput == CHANNEL_BINARY);
+  CHANNELDUMP files[NCHANNELDUMPS] = {
+    {&(channel->streamout), binary ? "Stream.Flow.bin" : "Stream.Flow", TRUE},
+    {&(channel->streamflowout), "Streamflow.Only", TRUE},
+    {&(channel->streamforcing), "RBM.Forcing.bin", FALSE},
+    {&(channel->streamtemp), "Stream.Temp", TRUE},
+    {&(channel->streamrecord), "Stream.Inflow.bin", FALSE},
+    {&(channel->streaminflow), "Inflow.Only", TRUE},
+    {&(channel->streamoutflow), "Outflow.Only", TRUE},
+    {&(channel->streamISW), "ISW.Only", TRUE},
+    {&(channel->streamNSW), "NSW.Only", TRUE},
+    {&(channel->streamILW), "ILW.Only", TRUE},
+    {&(channel->streamNLW), "NLW.Only", TRUE},
+    {&(channel->streamVP), "VP.Only", TRUE},
+    {&(channel->streamWND), "WND.Only", TRUE},
+    {&(channel->streamATP), "ATP.Only", TRUE},
+    {&(channel->streamBeam), "Beam.Only", TRUE},
+    {&(channel->streamDiffuse), "Diffuse.Only", TRUE},
+    {&(channel->streamSkyView), "Skyview.Only", TRUE},
+    {&(channel->roadout), binary ? "Road.Flow.bin" : "Road.Flow", TRUE},
+    {&(channel->roadflowout), "Roadflow.Only", TRUE},
+  };
+
+  memcpy(Files, files, sizeof(files));
+}
+
+/* -------------------------------------------------------------
+   BranchChannelDump
+   Moves the channel output files opened by InitChannelDump in
+   OldPath to NewPath, with the output so far (see dhsvm_fork)
+   ------------------------------------------------------------- */
+void BranchChannelDump(OPTIONSTRUCT *Options, CHANNEL * channel,
+		       char *OldPath, char *NewPath)
+{
+  const char *Routine = "BranchChannelDump";
+  char NewName[BUFSIZE + 1];
+  OUTPUTFILE *List;
+  int i;
+  int n;
+
+  n = ListChannelDump(Options, channel, OldPath, NULL);
+  if (!(List = (OUTPUTFILE *) calloc(n + 1, sizeof(OUTPUTFILE))))
+    ReportError((char *) Routine, 1);
+  ListChannelDump(Options, channel, OldPath, List);
+  for (i = 0; i < n; i++) {
+    snprintf(NewName, BUFSIZE + 1, "%s%s", NewPath,
+	     List[i].Name + strlen(OldPath));
+    BranchFile(List[i].FilePtr, List[i].Name, NewName);
+  }
+  free(List);
+}
+
 /* -------------------------------------------------------------
    ChannelCulvertFlow    
    computes outflow of channel/road network to a grid cell, if it
@@ -202,69 +716,329 @@ RouteChannel(CHANNEL *ChannelData, TIMESTRUCT *Time, MAPSIZE *Map,
 	     OPTIONSTRUCT *Options, ROADSTRUCT **Network, SOILTABLE *SType, 
 		 PRECIPPIX **PrecipMap, float Tair, float Rh)
 {
-  int x, y;
+#ifdef HAVE_PTHREAD
+  static float *IExcess = NULL;	/* surface water of the stream cells, while
+				   the roads are routed concurrently */
+#endif
+  float *StreamWater = NULL;	/* IExcess once PrepareStreamInflows() has
+				   taken the surface water */
+  int i, x, y;
   int flag;
+  int save;			/* FALSE while the model is spun up */
+  int concurrent = FALSE;	/* TRUE if the roads are routed in RoadTask */
   char buffer[32];
-  float CulvertFlow;
 
 
   /* give any surface water to roads w/o sinks */
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-		if (channel_grid_has_channel(ChannelData->road_map, x, y) && 
-			!channel_grid_has_sink(ChannelData->road_map, x, y)) {	/* road w/o sink */
-	      SoilMap[y][x].RoadInt += SoilMap[y][x].IExcess; 
-		  channel_grid_inc_inflow(ChannelData->road_map, x, y, SoilMap[y][x].IExcess * Map->DX * Map->DY);
-		  SoilMap[y][x].IExcess = 0.0f;
-		}
-      }
-    }
+  for (i = 0; i < ChannelData->nroad_cells; i++) {
+    y = Map->ActiveCells[ChannelData->road_cells[i]].y;
+    x = Map->ActiveCells[ChannelData->road_cells[i]].x;
+    SoilMap[y][x].RoadInt += SoilMap[y][x].IExcess; 
+    channel_grid_inc_inflow(ChannelData->road_map, x, y, SoilMap[y][x].IExcess * Map->DX * Map->DY);
+    SoilMap[y][x].IExcess = 0.0f;
   }
 
-  /* route the road network and save results */
   SPrintDate(&(Time->Current), buffer);
-  flag = IsEqualTime(&(Time->Current), &(Time->Start));
-  if (ChannelData->roads != NULL) {
-    channel_route_network(ChannelData->roads, Time->Dt);
-    channel_save_outflow_text(buffer, ChannelData->roads,
-			      ChannelData->roadout, ChannelData->roadflowout, flag);
+  flag = IsEqualTime(&(Time->Current), &(Time->Start)) ||
+    IsRolloverStep(&(Time->Current));
+  save = (Options->SpinUpCycles == 0 && !Options->NoOutput);
+#ifdef HAVE_PTHREAD
+  /* with CONCURRENT NETWORK ROUTING the surface water of the stream cells
+     is taken while the roads are routed, and the culvert flows are added
+     to it once the road outflows are known.  The stream inflows are added
+     in the same order either way */
+  if (Options->ConcurrentNetworks && ChannelData->roads != NULL &&
+      ChannelData->nstream_cells > 0) {
+    if (IExcess == NULL &&
+	!(IExcess = (float *) calloc(ChannelData->nstream_cells,
+				     sizeof(float))))
+      ReportError("RouteChannel()", 1);
+    RoadTask.ChannelData = ChannelData;
+    RoadTask.Options = Options;
+    RoadTask.Dt = Time->Dt;
+    strcpy(RoadTask.Date, buffer);
+    RoadTask.First = flag;
+    RoadTask.Save = save;
+    RoadTask.Routed = FALSE;
+    if (pthread_create(&(RoadTask.Thread), NULL, RouteRoadsTask,
+		       &RoadTask) == 0)
+      concurrent = TRUE;
+    else
+      printf("WARNING: cannot start a thread for the road routing\n");
+  }
+  if (concurrent) {
+    PrepareStreamInflows(ChannelData, Map, SoilMap, IExcess);
+    StreamWater = IExcess;
+    pthread_mutex_lock(&RoadLock);
+    while (!RoadTask.Routed)
+      pthread_cond_wait(&RoadsRouted, &RoadLock);
+    pthread_mutex_unlock(&RoadLock);
   }
-  
-  /* add culvert outflow to surface water */
+#endif
+
+  /* route the road network and save results */
+  if (!concurrent && ChannelData->roads != NULL) {
+    channel_route_network(ChannelData->road_net, Time->Dt);
+    if (save)
+      SaveRoads(ChannelData, Options, buffer, flag);
+  }
+
+  AddCulvertFlows(ChannelData, Map, SoilMap, Total, StreamWater);
+
+  /* route stream channels, with PIPELINE CHANNEL ROUTING in a thread of
+     their own.  Until WaitChannelRouting() the stream segments may not be
+     read or written: dhsvm_update() initializes them for the next step
+     after the join, and the pixel loop adds its channel inflows to the
+     private slots of ChannelAccum in the meantime */
+  if (ChannelData->streams != NULL)
+    StartStreamRouting(ChannelData, Time, Options, buffer, flag, save);
+
+#ifdef HAVE_PTHREAD
+  /* the road output is written while the streams are routed, and is done
+     before the road segments are used again */
+  if (concurrent)
+    pthread_join(RoadTask.Thread, NULL);
+#endif
+}
+
+/* -------------------------------------------------------------
+   StartStreamRouting
+   Routes the stream network, with PIPELINE CHANNEL ROUTING in
+   a thread that runs until WaitChannelRouting()
+   ------------------------------------------------------------- */
+static void StartStreamRouting(CHANNEL *ChannelData, TIMESTRUCT *Time,
+			       OPTIONSTRUCT *Options, char *buffer, int flag,
+			       int save)
+{
+#ifdef HAVE_PTHREAD
+  if (Options->PipelineChannel) {
+    Pipeline.ChannelData = ChannelData;
+    Pipeline.Options = Options;
+    Pipeline.Time = *Time;
+    strcpy(Pipeline.Date, buffer);
+    Pipeline.First = flag;
+    Pipeline.Save = save;
+    if (pthread_create(&(Pipeline.Thread), NULL, RouteStreamsTask,
+		       &Pipeline) == 0) {
+      Pipeline.Running = TRUE;
+      return;
+    }
+    printf("WARNING: cannot start a thread for the stream routing\n");
+  }
+#endif
+  RouteStreams(ChannelData, Time, Options, buffer, flag, save);
+}
+
+#ifdef HAVE_PTHREAD
+/* -------------------------------------------------------------
+   PrepareStreamInflows
+   Takes the surface water of the stream channel cells into
+   IExcess (one value per entry of stream_cells) and adds it to
+   their channel interception, as AddCulvertFlows() does without
+   IExcess.  The cells with a culvert but no stream channel keep
+   their surface water.  Touches neither network, so it runs
+   while the roads are routed
+   ------------------------------------------------------------- */
+static void PrepareStreamInflows(CHANNEL *ChannelData, MAPSIZE *Map,
+				 SOILPIX **SoilMap, float *IExcess)
+{
+  int i, x, y;
+
+  for (i = 0; i < ChannelData->nstream_cells; i++) {
+    y = Map->ActiveCells[ChannelData->stream_cells[i]].y;
+    x = Map->ActiveCells[ChannelData->stream_cells[i]].x;
+    if (channel_grid_has_channel(ChannelData->stream_map, x, y)) {
+      IExcess[i] = SoilMap[y][x].IExcess;
+      SoilMap[y][x].ChannelInt += SoilMap[y][x].IExcess;
+      SoilMap[y][x].IExcess = 0.0f;
+    }
+  }
+}
+#endif
+
+/* -------------------------------------------------------------
+   AddCulvertFlows
+   Adds the culvert outflow and the surface water of the stream
+   channel cells to the stream inflows, and the culvert outflow of
+   the other cells to their surface water.  Only stream and culvert
+   cells are visited; elsewhere the culvert flow is zero.  IExcess
+   is the surface water taken by PrepareStreamInflows(), or NULL
+   to take it here
+   ------------------------------------------------------------- */
+static void AddCulvertFlows(CHANNEL *ChannelData, MAPSIZE *Map,
+			    SOILPIX **SoilMap, AGGREGATED *Total,
+			    float *IExcess)
+{
+  int i, x, y;
+  float CulvertFlow;
+  float Water;
+
   Total->CulvertReturnFlow = 0.0;
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-		CulvertFlow = ChannelCulvertFlow(y, x, ChannelData);
-		CulvertFlow /= Map->DX * Map->DY;
-		
-		/* CulvertFlow = (CulvertFlow > 0.0) ? CulvertFlow : 0.0; */
-		if (channel_grid_has_channel(ChannelData->stream_map, x, y)) {
-		  channel_grid_inc_inflow(ChannelData->stream_map, x, y,
-				  (SoilMap[y][x].IExcess + CulvertFlow) * Map->DX * Map->DY);
-		  SoilMap[y][x].ChannelInt += SoilMap[y][x].IExcess;
-		  Total->CulvertToChannel += CulvertFlow;
-		  SoilMap[y][x].IExcess = 0.0f;
-		}
-		else {
-		  SoilMap[y][x].IExcess += CulvertFlow;
-		  Total->CulvertReturnFlow += CulvertFlow;
-		}
+  for (i = 0; i < ChannelData->nstream_cells; i++) {
+    y = Map->ActiveCells[ChannelData->stream_cells[i]].y;
+    x = Map->ActiveCells[ChannelData->stream_cells[i]].x;
+    CulvertFlow = ChannelCulvertFlow(y, x, ChannelData);
+    CulvertFlow /= Map->DX * Map->DY;
+
+    /* CulvertFlow = (CulvertFlow > 0.0) ? CulvertFlow : 0.0; */
+    if (channel_grid_has_channel(ChannelData->stream_map, x, y)) {
+      if (IExcess != NULL)
+	Water = IExcess[i];
+      else {
+	Water = SoilMap[y][x].IExcess;
+	SoilMap[y][x].ChannelInt += SoilMap[y][x].IExcess;
+	SoilMap[y][x].IExcess = 0.0f;
       }
+      channel_grid_inc_inflow(ChannelData->stream_map, x, y,
+			      (Water + CulvertFlow) * Map->DX * Map->DY);
+      Total->CulvertToChannel += CulvertFlow;
+    }
+    else {
+      SoilMap[y][x].IExcess += CulvertFlow;
+      Total->CulvertReturnFlow += CulvertFlow;
     }
   }
-  /* route stream channels */
-  if (ChannelData->streams != NULL) {
-    channel_route_network(ChannelData->streams, Time->Dt);
+}
+
+/* -------------------------------------------------------------
+   RouteStreams
+   Routes the stream network over one time step and saves the
+   results
+   ------------------------------------------------------------- */
+static void RouteStreams(CHANNEL *ChannelData, TIMESTRUCT *Time,
+			 OPTIONSTRUCT *Options, char *buffer, int flag,
+			 int save)
+{
+  /* the lateral inflows are complete, and the storage is that of the end of
+     the last step */
+  if (save && ChannelData->streamrecord != NULL)
+    SaveChannelRecord(ChannelData->streamrecord, ChannelData->stream_net,
+		      buffer);
+  channel_route_network(ChannelData->stream_net, Time->Dt);
+  if (Options->StreamTemp &&
+      Options->StreamTempSolver == STREAMTEMP_INTERNAL)
+    StreamTemperature(ChannelData, Time->Dt);
+  if (save)
+    SaveStreams(ChannelData, Time, Options, buffer, flag);
+}
+
+/* -------------------------------------------------------------
+   SaveRoads
+   Saves the road outflows of the time step
+   ------------------------------------------------------------- */
+static void SaveRoads(CHANNEL *ChannelData, OPTIONSTRUCT *Options,
+		      char *buffer, int flag)
+{
+  if (Options->ChannelOutput == CHANNEL_BINARY)
+    channel_save_outflow_bin(buffer, ChannelData->roads, 
+			     ChannelData->roadout);
+  else if (Options->ChannelOutput == CHANNEL_TEXT)
+    channel_save_outflow_text(buffer, ChannelData->roads,
+			      ChannelData->roadout, ChannelData->roadflowout,
+			      flag);
+}
+
+/* -------------------------------------------------------------
+   SaveStreams
+   Saves the stream outflows of the time step, and the stream
+   temperature or the parameters for John's RBM model
+   ------------------------------------------------------------- */
+static void SaveStreams(CHANNEL *ChannelData, TIMESTRUCT *Time,
+			OPTIONSTRUCT *Options, char *buffer, int flag)
+{
+  if (Options->ChannelOutput == CHANNEL_BINARY)
+    channel_save_outflow_bin(buffer, ChannelData->streams,
+			     ChannelData->streamout);
+  else if (Options->ChannelOutput == CHANNEL_TEXT)
     channel_save_outflow_text(buffer, ChannelData->streams,
 			      ChannelData->streamout,
 			      ChannelData->streamflowout, flag);
-	/* save parameters for John's RBM model */
-	if (Options->StreamTemp)
-	  channel_save_outflow_text_cplmt(Time, buffer,ChannelData->streams,ChannelData, flag);
-  }
-  
+  if (Options->StreamTemp &&
+      Options->StreamTempSolver == STREAMTEMP_INTERNAL)
+    SaveStreamTemp(buffer, ChannelData->streams,
+		   ChannelData->streamtemp, flag);
+  else if (Options->StreamTemp && ChannelData->streamforcing != NULL)
+    channel_save_outflow_bin_cplmt(Time, buffer, ChannelData->streams,
+				   ChannelData, flag);
+  else if (Options->StreamTemp)
+    channel_save_outflow_text_cplmt(Time, buffer,ChannelData->streams,ChannelData, flag);
+}
+
+/* -------------------------------------------------------------
+   SaveChannelOutput
+   Writes the channel outputs of the time step for the segments as
+   they are, without routing them: the lateral inflow record and
+   the road and stream outflows.  Used by the I/O benchmark
+   (dhsvm_io_bench()), in which the model state does not change
+   ------------------------------------------------------------- */
+void SaveChannelOutput(CHANNEL *ChannelData, TIMESTRUCT *Time,
+		       OPTIONSTRUCT *Options)
+{
+  char buffer[32];
+  int flag;
+
+  SPrintDate(&(Time->Current), buffer);
+  flag = IsEqualTime(&(Time->Current), &(Time->Start)) ||
+    IsRolloverStep(&(Time->Current));
+  if (ChannelData->roads != NULL)
+    SaveRoads(ChannelData, Options, buffer, flag);
+  if (ChannelData->streams == NULL)
+    return;
+  if (ChannelData->streamrecord != NULL)
+    SaveChannelRecord(ChannelData->streamrecord, ChannelData->stream_net,
+		      buffer);
+  SaveStreams(ChannelData, Time, Options, buffer, flag);
+}
+
+#ifdef HAVE_PTHREAD
+/* -------------------------------------------------------------
+   RouteRoadsTask
+   Routes the road network, tells RouteChannel() that the road
+   outflows are known, and saves them
+   ------------------------------------------------------------- */
+static void *RouteRoadsTask(void *Arg)
+{
+  ROADROUTING *Task = (ROADROUTING *) Arg;
+
+  UnpinThread();
+  channel_route_network(Task->ChannelData->road_net, Task->Dt);
+  pthread_mutex_lock(&RoadLock);
+  Task->Routed = TRUE;
+  pthread_cond_signal(&RoadsRouted);
+  pthread_mutex_unlock(&RoadLock);
+  if (Task->Save)
+    SaveRoads(Task->ChannelData, Task->Options, Task->Date, Task->First);
+  return NULL;
+}
+
+/* -------------------------------------------------------------
+   RouteStreamsTask
+   ------------------------------------------------------------- */
+static void *RouteStreamsTask(void *Arg)
+{
+  STREAMROUTING *Task = (STREAMROUTING *) Arg;
+
+  /* the thread has the processor of the main thread if it is pinned */
+  UnpinThread();
+  RouteStreams(Task->ChannelData, &(Task->Time), Task->Options, Task->Date,
+	       Task->First, Task->Save);
+  return NULL;
+}
+#endif
+
+/* -------------------------------------------------------------
+   WaitChannelRouting
+   Waits for the stream routing that RouteChannel() started with
+   PIPELINE CHANNEL ROUTING, if it still runs.  Called before the
+   stream segments are used again.
+   ------------------------------------------------------------- */
+void WaitChannelRouting(void)
+{
+#ifdef HAVE_PTHREAD
+  if (Pipeline.Running)
+    pthread_join(Pipeline.Thread, NULL);
+#endif
+  Pipeline.Running = FALSE;
 }
 
 /* -------------------------------------------------------------
@@ -19,6 +19,33 @@
 #include "channel.h"
 #include "channel_grid.h"
 
+/* -------------------------------------------------------------
+   binary RBM forcing file (channel_save_outflow_bin_cplmt): the
+   first 8 bytes of the file and the variables of each segment, in
+   the order they are stored
+   ------------------------------------------------------------- */
+#define RBM_BIN_MAGIC "DHSVMRBM"
+
+enum RBMVARS {
+  RBM_INFLOW = 0, RBM_OUTFLOW, RBM_ISW, RBM_NSW, RBM_ILW, RBM_NLW, RBM_VP,
+  RBM_WND, RBM_ATP, RBM_BEAM, RBM_DIFFUSE, RBM_SKYVIEW, NRBMVARS
+};
+
+/* -------------------------------------------------------------
+   struct STREAMTEMPNET
+   The stream network in level sets for the stream temperature 
+   (StreamTemperature.c): the segments of a level only depend on 
+   the segments of the levels before it
+   ------------------------------------------------------------- */
+typedef struct {
+  int nthreads;			/* threads of the segment loops */
+  int nlevel;			/* number of levels */
+  int *level;			/* level l is seq[level[l]] .. seq[level[l+1]-1] */
+  int *seq;			/* indices in stream_net->seg, level by level */
+  int *upstart;			/* upstream segments of stream_net->seg[i] are */
+  int *upidx;			/* upidx[upstart[i]] .. upidx[upstart[i+1]-1] */
+} STREAMTEMPNET;
+
 /* -------------------------------------------------------------
    struct CHANNEL
    ------------------------------------------------------------- */
@@ -27,6 +54,8 @@ typedef struct {
   ChannelClass *road_class;
   Channel *streams;
   Channel *roads;
+  ChannelNetwork *stream_net;	/* streams compiled for routing */
+  ChannelNetwork *road_net;	/* roads compiled for routing */
   ChannelMapPtr **stream_map;
   ChannelMapPtr **road_map;
   FILE *streamout;
@@ -46,6 +75,23 @@ typedef struct {
   FILE *streamBeam;
   FILE *streamDiffuse;
   FILE *streamSkyView;
+  FILE *streamforcing;		/* all of the above in one binary file */
+  float *forcingrecord;		/* NRBMVARS values for each segment */
+  STREAMTEMPNET *temp_net;	/* STREAM TEMPERATURE SOLVER = INTERNAL */
+  ChannelCrossTable *stream_cross; /* stream cells and their segments, for
+				   the RBM energy terms */
+  ChannelGridAccum *stream_accum; /* interception of RouteSubSurface() by */
+  ChannelGridAccum *road_accum;	/* the streams and roads, with NUMBER OF
+				   THREADS > 1 */
+  FILE *streamtemp;		/* Stream.Temp, the segment temperatures */
+  FILE *streamrecord;		/* Stream.Inflow.bin, the lateral inflows
+				   (CHANNEL INFLOW RECORD) */
+  /* work lists for RouteChannel(), indices in Map->ActiveCells */
+  int nroad_cells;		/* number of road cells without a sink */
+  int *road_cells;		/* road cells without a sink */
+  int nstream_cells;		/* number of stream and culvert cells */
+  int *stream_cells;		/* cells with a stream channel or a road
+				   sink */
 } CHANNEL;
 
 /* -------------------------------------------------------------
@@ -53,13 +99,29 @@ typedef struct {
    ------------------------------------------------------------- */
 void InitChannel(LISTPTR Input, MAPSIZE *Map, int deltat, CHANNEL *channel,
 		 SOILPIX **SoilMap, int *MaxStreamID, int *MaxRoadID, OPTIONSTRUCT *Options);
+void InitChannelCells(MAPSIZE *Map, CHANNEL *channel);
 void InitChannelDump(OPTIONSTRUCT *Options, CHANNEL *channel, char *DumpPath);
+int ListChannelDump(OPTIONSTRUCT *Options, CHANNEL *channel, char *Path,
+		    OUTPUTFILE *List);
+void RolloverChannelDump(OPTIONSTRUCT *Options, CHANNEL *channel, char *Path);
+void BranchChannelDump(OPTIONSTRUCT *Options, CHANNEL *channel,
+		       char *OldPath, char *NewPath);
 double ChannelCulvertFlow(int y, int x, CHANNEL *ChannelData);
 void RouteChannel(CHANNEL *ChannelData, TIMESTRUCT *Time, MAPSIZE *Map,
 		  TOPOPIX **TopoMap, SOILPIX **SoilMap, AGGREGATED *Total, 
 		  OPTIONSTRUCT *Options, ROADSTRUCT **Network, SOILTABLE *SType, 
 		  PRECIPPIX **PrecipMap, float Tair, float Rh);
+void WaitChannelRouting(void);
+void SaveChannelOutput(CHANNEL *ChannelData, TIMESTRUCT *Time,
+		       OPTIONSTRUCT *Options);
 void ChannelCut(int y, int x, CHANNEL *ChannelData, ROADSTRUCT *Network);
 uchar ChannelFraction(TOPOPIX *topo, ChannelMapRec *rds);
+void ReadStreamTempParam(ChannelNetwork *cnet, const char *file);
+void InitStreamTemp(CHANNEL *channel, int NThreads);
+void StreamTemperature(CHANNEL *ChannelData, int Dt);
+int SaveStreamTemp(char *tstring, Channel *net, FILE *out, int flag);
+void FreeStreamTemp(CHANNEL *channel);
+void WriteChannelRecordHeader(FILE *Out, ChannelNetwork *cnet);
+void SaveChannelRecord(FILE *Out, ChannelNetwork *cnet, char *Date);
 
 #endif
@@ -9,8 +9,13 @@
 * ORIG-DATE:    2000
 * DESCRIPTION:  X11 routines for DHSVM
 * DESCRIP-END.
-* FUNCTIONS:   
-* COMMENTS:
+* FUNCTIONS:    FillGraphic()
+*               SampleGraphic()
+*               GraphicsShown()
+*               DrawFrame()
+* COMMENTS:     The graphics are filled and sampled by the model
+*               (Graphics.c), DrawFrame() only needs the GRAPHICSFRAME and
+*               can be called from the renderer thread
 * $Id: Draw.c,v 1.12 2006/10/03 22:50:22 nathalie Exp $     
 */
 
@@ -20,6 +25,7 @@
 #include "settings.h"
 #include "data.h"
 #include "functions.h"
+#include "graphics.h"
 #include "snow.h"
 #include "Calendar.h"
 
@@ -33,995 +39,1044 @@ extern Display *display;
 extern Window window;
 extern GC gc;
 extern XColor my_color[50];
-extern float **temp_array;
 extern long black, white;
 extern int e, ndx;
 #endif
 
-void draw(DATE *Day, int first, int DayStep, MAPSIZE *Map, int NGraphics,
-          int *which_graphics, VEGTABLE *VType, SOILTABLE *SType, SNOWPIX **SnowMap, 
-          SOILPIX **SoilMap, VEGPIX **VegMap, TOPOPIX **TopoMap, PRECIPPIX **PrecipMap, 
-          float **PrismMap, float **SkyViewMap, unsigned char ***ShadowMap, 
-          EVAPPIX **EvapMap, PIXRAD **RadMap, MET_MAP_PIX **MetMap, 
-          ROADSTRUCT **Network, OPTIONSTRUCT *Options)
-{				
-  int i, j, k, ie, je, ir, jr;
-  int PX, PY;
-  int MapNumber;
-  float min, max, scale;
-  float temp, surf_swe, pack_swe;
-  int index, skip_it;
-  char *text;
-  char text2[6];
-  char text3[20];
-  int length;
-  float max_temp;
-  float re;
-  int buf = 50;
-  int sample = 1;		/* if sample =0, then average if compression needed, otherwise if =1 then sample */
-  /*  obviously, for really large domains, the 1 option is much faster */
-  int expand;
-  int draw_static_colorbar;
-#ifdef HAVE_X11
-  XWindowAttributes windowattr;
+/*****************************************************************************
+  Function name: FillGraphic()
+
+  Purpose      : Fill Field with the graphic MapNumber over the basin
+
+  Required     :
+    int MapNumber  - graphic ID (GRAPHICS ID)
+    int DayStep    - time step of the day (shade factor)
+    ...            - the model maps
+    float **Field  - NY x NX work array
+
+  Returns      : TRUE, FALSE if MapNumber is not a graphic of this run
+
+  Modifies     : Field, Min, Max, Title, Length
+
+  Comments     : Values set to -9999.0 are drawn as white.  Min and Max are
+                 the range of the values in the basin
+*****************************************************************************/
+int FillGraphic(int MapNumber, int DayStep, MAPSIZE *Map, VEGTABLE *VType,
+		SOILTABLE *SType, SNOWPIX **SnowMap, SOILPIX **SoilMap,
+		VEGPIX **VegMap, TOPOPIX **TopoMap, PRECIPPIX **PrecipMap,
+		float **PrismMap, STATICMAP *SkyViewMap,
+		unsigned char ***ShadowMap, EVAPPIX **EvapMap, PIXRAD **RadMap,
+		MET_MAP_PIX **MetMap, OPTIONSTRUCT *Options, float **Field,
+		float *Min, float *Max, char **Title, int *Length)
+{
+  int i, j;
+  float min, max;
+  float temp = 0.0, surf_swe, pack_swe;
+  char *text = NULL;
+  int length = 0;
+
+  max = -1000000.;
+  min = 1000000.;
+
+  if (MapNumber == 1) {
+    text = "SWE (mm)";
+    length = 8;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SnowMap[j][i].Swq * 1000.0; 
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-  expand = e;
-  draw_static_colorbar = 1;
-  if (XGetWindowAttributes(display, window, &windowattr) == 0) {
-    printf("failed to get window attributes in draw \n");
-    exit(-1);
+  if (MapNumber == 2) {
+    text = "Water Table Depth (mm)";
+    length = 22;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].TableDepth * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
   }
 
-  /* windowatt.map_state = 0 if DHSVM realtime display is set to an icon */
-  /* windowatt.map_state = 2 if DHSVM realtime is active */
-  /* if the user iconizes DHSVM display then */
-  /* turn the graphics off and let DHSVM fly (or at least try to fly) */
+  if (MapNumber == 3) {
+    text = "Digital Elevation Model (m)";
+    length = 27;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = TopoMap[j][i].Dem;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-  if (windowattr.map_state > 0) {
-    XSetForeground(display, gc, black);
-    SPrintDate(Day, text3);
-    XClearArea(display, window, 10, 0, 100, 20, False);
-    XDrawString(display, window, gc, 10, 20, text3, 19);
-
-    /* if the user changes window size below 300 by 300 then */
-    /* turn the graphics off and let DHSVM fly (or at least try to fly) */
-    /* but at least print the date and time to the display */
-    if (windowattr.width > 300 && windowattr.height > 300) {
-      if (first == 1 || Day->Hour == 0)
-        draw_static_colorbar = 1;
-
-      for (k = 0; k < NGraphics; k++) {
-        /* this is the beginning of the master loop which tries to draw */
-        /* all the graphic variables */
-        /* however we override the static fields, 3, 4, 5 and 6 such that */
-        /* they are only drawn on the first call or on each new day */
-        /* the same limitation is given to drawing all the color bars */
-        MapNumber = which_graphics[k];
-        if (MapNumber < 3 || MapNumber > 6 || draw_static_colorbar == 1) {
-          PY = k / ndx;
-          PX = k - ndx * PY;
-          if (expand > 0) {
-            PX = PX * (Map->NX * expand + buf) + 10;
-            PY = PY * (Map->NY * expand + buf) + 20;	/*top 20 pixels reserved for date stamp */
+  if (MapNumber == 4) {
+    text = "Vegetation Class";
+    length = 16;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = VegMap[j][i].Veg;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
+
+  if (MapNumber == 5) {
+    text = "Soil Class";
+    length = 10;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].Soil;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
+
+  if (MapNumber == 6) {
+    text = "Soil Depth (mm)";
+    length = 15;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].Depth * 1000.;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
+
+  if (MapNumber == 7) {
+    text = "Precipitation (mm)";
+    length = 18;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = PrecipMap[j][i].Precip * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
+
+  if (MapNumber == 8) {
+    text = "Incoming Shortwave (W/sqm)";
+    length = 26;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = RadMap[j][i].BeamIn + RadMap[j][i].DiffuseIn;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
+
+  if (MapNumber == 9) {
+    text = "Intercepted Snow (mm)";
+    length = 21;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask) && VType[VegMap[j][i].Veg - 1].OverStory == 1) {
+          temp = PrecipMap[j][i].IntSnow[0] * 1000.0;;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        if (VType[VegMap[j][i].Veg - 1].OverStory == 1 && temp > 0.0)
+          Field[j][i] = temp;
+        else
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
+
+  if (MapNumber == 10) {
+    text = "Snow Surface Temp (C)";
+    length = 21;
+    max = 0.0;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SnowMap[j][i].TSurf;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(SnowMap[j][i].Swq, 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
+
+  if (MapNumber == 11) {
+    text = "Cold Content (kJ)";
+    length = 17;
+    max = 0.0;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          if (SnowMap[j][i].Swq > MAX_SURFACE_SWE) {
+            pack_swe = SnowMap[j][i].Swq - MAX_SURFACE_SWE;
+            surf_swe = SnowMap[j][i].Swq - pack_swe;
+            temp =
+              2.10e3 * (SnowMap[j][i].TSurf * surf_swe +
+              SnowMap[j][i].TPack * pack_swe);
           }
           else {
-            PX = PX * (Map->NX * (1.0 / ((float) (-expand))) + buf) + 10;
-            PY = PY * (Map->NY * (1.0 / ((float) (-expand))) + buf) + 20;
-          }
-          max = -1000000.;
-          min = 1000000.;
-
-          if (MapNumber == 1) {
-            text = "SWE (mm)";
-            length = 8;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SnowMap[j][i].Swq * 1000.0; 
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
+            temp = 2.10e3 * SnowMap[j][i].Swq * SnowMap[j][i].TSurf;
           }
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(SnowMap[j][i].Swq, 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 2) {
-            text = "Water Table Depth (mm)";
-            length = 22;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].TableDepth * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 12) {
+    text = "Snow Melt (mm)";
+    length = 14;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SnowMap[j][i].Melt * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 3) {
-            text = "Digital Elevation Model (m)";
-            length = 27;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = TopoMap[j][i].Dem;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 13) {
+    text = "Snow Pack Outflow (mm)";
+    length = 22;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SnowMap[j][i].Outflow * 1000.0;;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 4) {
-            text = "Vegetation Class";
-            length = 16;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = VegMap[j][i].Veg;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 14) {
+    text = "Sat. Subsurf Flow (mm) 0=white";
+    length = 30;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].SatFlow * 1000.0;;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 5) {
-            text = "Soil Class";
-            length = 10;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].Soil;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 15) {
+    text = "Overland Flow (mm)";
+    length = 18;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].Runoff * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 6) {
-            text = "Soil Depth (mm)";
-            length = 15;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].Depth * 1000.;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 16) {
+    text = "Total EvapoTranspiration (mm)";
+    length = 29;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = EvapMap[j][i].ETot * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 7) {
-            text = "Precipitation (mm)";
-            length = 18;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = PrecipMap[j][i].Precip * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 17) {
+    text = "Snow Pack Vapor Flux (mm)";
+    length = 25;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SnowMap[j][i].VaporMassFlux * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 8) {
-            text = "Incoming Shortwave (W/sqm)";
-            length = 26;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = RadMap[j][i].BeamIn + RadMap[j][i].DiffuseIn;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 18) {
+    text = "Int Snow Vapor Flux (mm)";
+    length = 24;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SnowMap[j][i].CanopyVaporMassFlux * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 9) {
-            text = "Intercepted Snow (mm)";
-            length = 21;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask) && VType[VegMap[j][i].Veg - 1].OverStory == 1) {
-                  temp = PrecipMap[j][i].IntSnow[0] * 1000.0;;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                if (VType[VegMap[j][i].Veg - 1].OverStory == 1 && temp > 0.0)
-                  temp_array[j][i] = temp;
-                else
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 19) {
+    text = "Soil Moist L1 (% Sat)";
+    length = 21;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp =
+            SoilMap[j][i].Moist[0] / SType[SoilMap[j][i].Soil -
+            1].Porosity[0] * 100.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
 
-          if (MapNumber == 10) {
-            text = "Snow Surface Temp (C)";
-            length = 21;
-            max = 0.0;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SnowMap[j][i].TSurf;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(SnowMap[j][i].Swq, 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+      }
+    }
+  }
 
-          if (MapNumber == 11) {
-            text = "Cold Content (kJ)";
-            length = 17;
-            max = 0.0;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  if (SnowMap[j][i].Swq > MAX_SURFACE_SWE) {
-                    pack_swe = SnowMap[j][i].Swq - MAX_SURFACE_SWE;
-                    surf_swe = SnowMap[j][i].Swq - pack_swe;
-                    temp =
-                      2.10e3 * (SnowMap[j][i].TSurf * surf_swe +
-                      SnowMap[j][i].TPack * pack_swe);
-                  }
-                  else {
-                    temp = 2.10e3 * SnowMap[j][i].Swq * SnowMap[j][i].TSurf;
-                  }
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(SnowMap[j][i].Swq, 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 20) {
+    text = "Soil Moist L2 (% Sat)";
+    length = 21;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp =
+            SoilMap[j][i].Moist[1] / SType[SoilMap[j][i].Soil -
+            1].Porosity[1] * 100.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
 
-          if (MapNumber == 12) {
-            text = "Snow Melt (mm)";
-            length = 14;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SnowMap[j][i].Melt * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+      }
+    }
+  }
 
-          if (MapNumber == 13) {
-            text = "Snow Pack Outflow (mm)";
-            length = 22;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SnowMap[j][i].Outflow * 1000.0;;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 21) {
+    text = "Soil Moist L3 (% Sat)";
+    length = 21;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].Moist[2] /
+            SType[SoilMap[j][i].Soil - 1].Porosity[2] * 100.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 14) {
-            text = "Sat. Subsurf Flow (mm) 0=white";
-            length = 30;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].SatFlow * 1000.0;;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 22) {
+    text = "Accumulated Precip (mm)";
+    length = 23;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = MetMap[j][i].accum_precip * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
 
-          if (MapNumber == 15) {
-            text = "Overland Flow (mm)";
-            length = 18;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].Runoff * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+      }
+    }
+  }
 
-          if (MapNumber == 16) {
-            text = "Total EvapoTranspiration (mm)";
-            length = 29;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = EvapMap[j][i].ETot * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 23) {
+    text = "Air Temp (C) 0=white";
+    length = 20;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = MetMap[j][i].air_temp;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (Field[j][i] > -0.5 && Field[j][i] < 0.0)
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 17) {
-            text = "Snow Pack Vapor Flux (mm)";
-            length = 25;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SnowMap[j][i].VaporMassFlux * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 24) {
+    text = "Wind Speed (m/s)";
+    length = 16;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = MetMap[j][i].wind_speed;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 18) {
-            text = "Int Snow Vapor Flux (mm)";
-            length = 24;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SnowMap[j][i].CanopyVaporMassFlux * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 25) {
+    text = "RH";
+    length = 2;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = MetMap[j][i].humidity;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
 
-          if (MapNumber == 19) {
-            text = "Soil Moist L1 (% Sat)";
-            length = 21;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp =
-                    SoilMap[j][i].Moist[0] / SType[SoilMap[j][i].Soil -
-                    1].Porosity[0] * 100.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-
-              }
-            }
-          }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 20) {
-            text = "Soil Moist L2 (% Sat)";
-            length = 21;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp =
-                    SoilMap[j][i].Moist[1] / SType[SoilMap[j][i].Soil -
-                    1].Porosity[1] * 100.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-
-              }
-            }
-          }
+  if (MapNumber == 26) {
+    text = "Prism Precip (mm)";
+    length = 17;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = PrismMap[j][i] / 100.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 21) {
-            text = "Soil Moist L3 (% Sat)";
-            length = 21;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].Moist[2] /
-                    SType[SoilMap[j][i].Soil - 1].Porosity[2] * 100.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 27) {
+    text = "Deep Layer Storage (% Sat)";
+    length = 26;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+
+          temp =
+            SoilMap[j][i].Moist[3] / SType[SoilMap[j][i].Soil -
+            1].Porosity[2] * 100.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 22) {
-            text = "Accumulated Precip (mm)";
-            length = 23;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = MetMap[j][i].accum_precip * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-
-              }
-            }
-          }
+  if (MapNumber == 28) {
+    text = "Surface runoff from HOF and Return Flow (mm)";
+    length = 22;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].IExcess * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 23) {
-            text = "Air Temp (C) 0=white";
-            length = 20;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = MetMap[j][i].air_temp;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (temp_array[j][i] > -0.5 && temp_array[j][i] < 0.0)
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 29 && Options->Infiltration == DYNAMIC) {
+    text = "Infiltration Accumulation (mm)";
+    length = 22;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].TableDepth * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 24) {
-            text = "Wind Speed (m/s)";
-            length = 16;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = MetMap[j][i].wind_speed;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 31) {
+    text = "Overstory Trans (mm)";
+    length = 20;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = EvapMap[j][i].EAct[0] * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 25) {
-            text = "RH";
-            length = 2;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = MetMap[j][i].humidity;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 32) {
+    text = "Understory Trans (mm)";
+    length = 21;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = EvapMap[j][i].EAct[1] * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 26) {
-            text = "Prism Precip (mm)";
-            length = 17;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = PrismMap[j][i] / 100.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 33) {
+    text = "Soil Evaporation (mm)";
+    length = 21;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = EvapMap[j][i].EvapSoil * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 27) {
-            text = "Deep Layer Storage (% Sat)";
-            length = 26;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-
-                  temp =
-                    SoilMap[j][i].Moist[3] / SType[SoilMap[j][i].Soil -
-                    1].Porosity[2] * 100.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 34) {
+    text = "Overstory Int Evap (mm)";
+    length = 23;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = EvapMap[j][i].EInt[0] * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 28) {
-            text = "Surface runoff from HOF and Return Flow (mm)";
-            length = 22;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].IExcess * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 35) {
+    text = "Understory Int Evap (mm)";
+    length = 24;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = EvapMap[j][i].EInt[1] * 1000.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 29 && Options->Infiltration == DYNAMIC) {
-            text = "Infiltration Accumulation (mm)";
-            length = 22;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].TableDepth * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 41) {
+    text = "Sky View Factor (%)";
+    length = 19;
+    ExpandStaticMap(Map, SkyViewMap, Field);
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = Field[j][i] * 100.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 31) {
-            text = "Overstory Trans (mm)";
-            length = 20;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = EvapMap[j][i].EAct[0] * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 42) {
+    text = "Shade Map  (%)";
+    length = 14;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = (float) ShadowMap[DayStep][j][i] / 0.2223191;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (Field[j][i] < 0.0)
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 32) {
-            text = "Understory Trans (mm)";
-            length = 21;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = EvapMap[j][i].EAct[1] * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 43) {
+    text = "Incoming Direct Beam Shortwave (W/sqm)";
+    length = 24;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = RadMap[j][i].BeamIn;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 33) {
-            text = "Soil Evaporation (mm)";
-            length = 21;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = EvapMap[j][i].EvapSoil * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 44) {
+    text = "Incoming Diffuse Shortwave (W/sqm)";
+    length = 25;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = RadMap[j][i].DiffuseIn;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 34) {
-            text = "Overstory Int Evap (mm)";
-            length = 23;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = EvapMap[j][i].EInt[0] * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 45) {
+    text = "Aspect (degrees)";
+    length = 16;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = TopoMap[j][i].Aspect * 57.2957;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 35) {
-            text = "Understory Int Evap (mm)";
-            length = 24;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = EvapMap[j][i].EInt[1] * 1000.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+  if (MapNumber == 46) {
+    text = "Slope (percent)";
+    length = 15;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = TopoMap[j][i].Slope * 100.0;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+      }
+    }
+  }
 
-          if (MapNumber == 41) {
-            text = "Sky View Factor (%)";
-            length = 19;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SkyViewMap[j][i] * 100.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 50) {
+    text = "Channel Sub Surf Int (mm)";
+    length = 25;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].ChannelInt * 1000.0;;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
 
-          if (MapNumber == 42) {
-            text = "Shade Map  (%)";
-            length = 14;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = (float) ShadowMap[DayStep][j][i] / 0.2223191;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (temp_array[j][i] < 0.0)
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  if (MapNumber == 51) {
+    text = "Road Sub Surf Inter (mm)";
+    length = 24;
+    for (i = 0; i < Map->NX; i++) {
+      for (j = 0; j < Map->NY; j++) {
+        if (INBASIN(TopoMap[j][i].Mask)) {
+          temp = SoilMap[j][i].RoadInt * 1000.0;;
+          if (temp > max)
+            max = temp;
+          if (temp < min)
+            min = temp;
+        }
+        Field[j][i] = temp;
+        if (fequal(Field[j][i], 0.0))
+          Field[j][i] = -9999.0;
+      }
+    }
+  }
+  *Min = min;
+  *Max = max;
+  *Title = text;
+  *Length = length;
+  return (text != NULL);
+}
 
-          if (MapNumber == 43) {
-            text = "Incoming Direct Beam Shortwave (W/sqm)";
-            length = 24;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = RadMap[j][i].BeamIn;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
+/*****************************************************************************
+  Function name: SampleGraphic()
+
+  Purpose      : Downsample a filled graphic to the panel of a frame
+
+  Required     :
+    int MapNumber  - graphic ID
+    MAPSIZE *Map   - basin grid
+    TOPOPIX **TopoMap - basin mask
+    float **Field  - graphic filled by FillGraphic()
+    int Step       - grid cells per panel value in each direction
+    int NY, NX     - size of the panel, Map->NY / Step x Map->NX / Step
+
+  Returns      : void
+
+  Modifies     : Panel, row by row
+
+  Comments     : Graphics below 50 are sampled from the first cell of each
+                 block, the channel and road interception graphics (50 and
+                 up) get the largest value of the block so that the network
+                 stays visible.  Cells outside the basin are -9999.0
+*****************************************************************************/
+void SampleGraphic(int MapNumber, MAPSIZE *Map, TOPOPIX **TopoMap,
+		   float **Field, int Step, int NY, int NX, float *Panel)
+{
+  int i, j, ie, je, ir, jr;
+  int skip_it;
+  float temp, max_temp;
+
+  for (j = 0; j < NY; j++) {
+    for (i = 0; i < NX; i++) {
+      jr = j * Step;
+      ir = i * Step;
+      temp = 0.0;
+      skip_it = 0;
+
+      if (MapNumber < 50 || Step == 1) {
+        if (!fequal(Field[jr][ir], -9999.0) && INBASIN(TopoMap[jr][ir].Mask))
+          temp = Field[jr][ir];
+        else
+          skip_it = 1;
+      }
+      else {
+        max_temp = -10000.0;
+        for (ie = 0; ie < Step; ie++) {
+          for (je = 0; je < Step; je++) {
+            if (INBASIN(TopoMap[je + jr][ie + ir].Mask)) {
+              if (Field[je + jr][ie + ir] > max_temp)
+                max_temp = Field[je + jr][ie + ir];
             }
-          }
-
-          if (MapNumber == 44) {
-            text = "Incoming Diffuse Shortwave (W/sqm)";
-            length = 25;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = RadMap[j][i].DiffuseIn;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
+            else {
+              skip_it = 1;
             }
           }
+        }
+        temp = max_temp;
+        if (temp == -9999.0)
+          skip_it = 1;
+      }
 
-          if (MapNumber == 45) {
-            text = "Aspect (degrees)";
-            length = 16;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = TopoMap[j][i].Aspect * 57.2957;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+      Panel[j * NX + i] = skip_it ? -9999.0 : temp;
+    }
+  }
+}
 
-          if (MapNumber == 46) {
-            text = "Slope (percent)";
-            length = 15;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = TopoMap[j][i].Slope * 100.0;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-              }
-            }
-          }
+/*****************************************************************************
+  Function name: GraphicsShown()
 
-          if (MapNumber == 50) {
-            text = "Channel Sub Surf Int (mm)";
-            length = 25;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].ChannelInt * 1000.0;;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  Purpose      : Find out how much of the X11 display the user lets us draw
 
-          if (MapNumber == 51) {
-            text = "Road Sub Surf Inter (mm)";
-            length = 24;
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (INBASIN(TopoMap[j][i].Mask)) {
-                  temp = SoilMap[j][i].RoadInt * 1000.0;;
-                  if (temp > max)
-                    max = temp;
-                  if (temp < min)
-                    min = temp;
-                }
-                temp_array[j][i] = temp;
-                if (fequal(temp_array[j][i], 0.0))
-                  temp_array[j][i] = -9999.0;
-              }
-            }
-          }
+  Returns      : 0 if the display is iconized (or there is none), 1 if it is
+                 too small for the graphics and only the date is drawn, 2
+                 otherwise
+*****************************************************************************/
+int GraphicsShown(void)
+{
+#ifdef HAVE_X11
+  XWindowAttributes windowattr;
 
-          if (fequal(max, min))
-            scale = 0.0;
-          else
-            scale = 50 / (max - min);
-
-          /* draw the raster image for the current data set */
-          /* all values set to -9999.0 will be drawn as white */
-          /* each image is left and bottom justified in its drawing area */
-          /* i.e. buf pixels are available on the top and right for text */
-          /* and the color bar */
-
-          if (expand > 0) {
-            for (i = 0; i < Map->NX; i++) {
-              for (j = 0; j < Map->NY; j++) {
-                if (!fequal(temp_array[j][i], -9999.0) && 
-                  INBASIN(TopoMap[j][i].Mask)) {
-                    index = (int) (scale * (temp_array[j][i] - min));
-                    if (index > 49)
-                      index = 49;
-                    XSetForeground(display, gc, my_color[index].pixel);
-                }
-                else {
-                  XSetForeground(display, gc, white);
-                }
-                for (ie = PX + i * expand; ie < PX + i * expand + expand; ie++){
-                  for (je = PY + j * expand; je < PY + j * expand + expand;
-                    je++) { 
-                      XDrawPoint(display, window, gc, ie, je + buf);
-                  }
-                }
-              }
-            }
-          }
-          else {		/* expand < 0 need to average image */
-            for (i = 0; i < Map->NX / (-expand); i++) {
-              for (j = 0; j < Map->NY / (-expand); j++) {
-                jr = j * (-expand);
-                ir = i * (-expand);
-                temp = 0.0;
-                skip_it = 0;
-                /* for map numbers less than 26 just get the average or a sample */
-
-                if (MapNumber < 50 && sample == 0) {
-                  for (ie = 0; ie < (-expand); ie++) {
-                    for (je = 0; je < (-expand); je++) {
-                      if (temp_array[je + jr][ie + ir] != -9999.0
-                        && (INBASIN(TopoMap[je + jr][ie + ir].Mask)))
-                        temp = temp + temp_array[je + jr][ie + ir];
-                      else
-                        skip_it = 1;
-                    }
-                  }
-                  temp = temp / ((float) (expand * expand));
-                }
-
-                if (MapNumber < 50 && sample == 1) {
-
-                  if (temp_array[jr][ir] != -9999.0
-                    && (INBASIN(TopoMap[jr][ir].Mask)))
-                    temp = temp_array[jr][ir];
-                  else
-                    skip_it = 1;
-
-                }
-
-                /* for map numbers of 50 or larger, which are the channel and runoff */
-                /* subsurface interception, get the max for each aggregated pixel */
-                if (MapNumber > 49) {
-                  max_temp = -10000.0;
-                  for (ie = 0; ie < (-expand); ie++) {
-                    for (je = 0; je < (-expand); je++) {
-                      if (INBASIN(TopoMap[je + jr][ie + ir].Mask)) {
-                        if (temp_array[je + jr][ie + ir] > max_temp)
-                          max_temp = temp_array[je + jr][ie + ir];
-                      }
-                      else {
-                        skip_it = 1;
-                      }
-                    }
-                  }
-                  temp = max_temp;
-                  if (temp == -9999.0)
-                    skip_it = 1;
-                }
-
-                index = (int) (scale * (temp - min));
-                if (index > 49)
-                  index = 49;
-
-                if (skip_it == 0) {
-                  XSetForeground(display, gc, my_color[index].pixel);
-                }
-                else {
-                  XSetForeground(display, gc, white);
-                }
-
-                XDrawPoint(display, window, gc, i + PX, j + PY + buf);
-
-              }
-            }
-          }
+  if (XGetWindowAttributes(display, window, &windowattr) == 0) {
+    printf("failed to get window attributes in draw \n");
+    exit(-1);
+  }
 
-          if (expand > 0)
-            re = (float) expand;
-          else
-            re = 1.0 / ((float) -expand);
-
-          if (draw_static_colorbar == 1) {
-            /* write the title */
-            XSetForeground(display, gc, black);
-            XSetBackground(display, gc, white);
-            XDrawString(display, window, gc, PX, PY + 40, text, length);
-
-            /* draw the color bar */
-            for (j = 0; j < Map->NY * re; j++) {
-              XSetForeground(display, gc,
-                my_color[(int) (50 * j / (Map->NY * re))].pixel);
-              /*    if((int)((float)(j*50/(Map->NY*re))/scale+min)==0) XSetForeground(display,gc,white); */
-              XDrawLine(display, window, gc, (int) (PX + Map->NX * re + 10),
-                (int) (PY + Map->NY * re - j + buf),
-                (int) (PX + Map->NX * re + 20),
-                (int) (PY + Map->NY * re - j + buf));
-            }
-          }
-          /* label the color bar */
-          sprintf(text2, "%6f", max);
-          XSetForeground(display, gc, black);
-          XClearArea(display, window, (int) (PX + Map->NX * re),
-            (int) (PY - 20 + buf), 50, 20, False);
-          XDrawString(display, window, gc, (int) (PX + Map->NX * re),
-            (int) (PY - 10 + buf), text2, 6);
-          sprintf(text2, "%6.1f", min);
-          XClearArea(display, window, (int) (PX + Map->NX * re),
-            (int) (PY + Map->NY * re + buf), 50, 30, False);
-          XDrawString(display, window, gc, (int) (PX + Map->NX * re),
-            (int) (PY + Map->NY * re + 20 + buf), text2, 6);
+  /* windowatt.map_state = 0 if DHSVM realtime display is set to an icon */
+  /* windowatt.map_state = 2 if DHSVM realtime is active */
+  /* if the user iconizes DHSVM display then */
+  /* turn the graphics off and let DHSVM fly (or at least try to fly) */
+  if (windowattr.map_state == 0)
+    return 0;
+
+  /* if the user changes window size below 300 by 300 then */
+  /* turn the graphics off and let DHSVM fly (or at least try to fly) */
+  /* but at least print the date and time to the display */
+  if (windowattr.width > 300 && windowattr.height > 300)
+    return 2;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/*****************************************************************************
+  Function name: DrawFrame()
+
+  Purpose      : Draw a frame of the graphics to the X11 display
+
+  Required     :
+    GRAPHICSFRAME *Frame - graphics sampled at the display resolution, with
+                           Step = -e if the images are shrunk, 1 otherwise
 
+  Returns      : void
+
+  Comments     : Touches nothing of the model, so that it can run on the
+                 renderer thread (GRAPHICS MODE = THREAD)
+*****************************************************************************/
+void DrawFrame(GRAPHICSFRAME *Frame)
+{
+#ifdef HAVE_X11
+  int i, j, k, ie, je;
+  int PX, PY;
+  float min, max, scale;
+  float *Panel;
+  char text2[20];
+  char text3[20];
+  float re;
+  int buf = 50;
+  int expand;
+  int Shown;
+
+  expand = e;
+  Shown = GraphicsShown();
+  if (Shown == 0)
+    return;
+
+  XSetForeground(display, gc, black);
+  SPrintDate(&(Frame->Day), text3);
+  XClearArea(display, window, 10, 0, 100, 20, False);
+  XDrawString(display, window, gc, 10, 20, text3, 19);
+
+  if (Shown == 1)
+    return;
+
+  if (expand > 0)
+    re = (float) expand;
+  else
+    re = 1.0 / ((float) -expand);
+
+  for (k = 0; k < Frame->NGraphics; k++) {
+    /* this is the beginning of the master loop which draws */
+    /* all the graphic variables */
+    PY = k / ndx;
+    PX = k - ndx * PY;
+    if (expand > 0) {
+      PX = PX * (Frame->MapNX * expand + buf) + 10;
+      PY = PY * (Frame->MapNY * expand + buf) + 20;	/*top 20 pixels reserved for date stamp */
+    }
+    else {
+      PX = PX * (Frame->MapNX * (1.0 / ((float) (-expand))) + buf) + 10;
+      PY = PY * (Frame->MapNY * (1.0 / ((float) (-expand))) + buf) + 20;
+    }
+    min = Frame->Min[k];
+    max = Frame->Max[k];
+    Panel = Frame->Values + (size_t) k * Frame->NY * Frame->NX;
+
+    if (fequal(max, min))
+      scale = 0.0;
+    else
+      scale = 50 / (max - min);
+
+    /* draw the raster image for the current data set */
+    /* all values set to -9999.0 will be drawn as white */
+    /* each image is left and bottom justified in its drawing area */
+    /* i.e. buf pixels are available on the top and right for text */
+    /* and the color bar */
+    for (i = 0; i < Frame->NX; i++) {
+      for (j = 0; j < Frame->NY; j++) {
+        if (!fequal(Panel[j * Frame->NX + i], -9999.0))
+          XSetForeground(display, gc,
+            my_color[GraphicsColor(Panel[j * Frame->NX + i], min, scale)].pixel);
+        else
+          XSetForeground(display, gc, white);
+        if (expand > 0) {
+          for (ie = PX + i * expand; ie < PX + i * expand + expand; ie++) {
+            for (je = PY + j * expand; je < PY + j * expand + expand; je++)
+              XDrawPoint(display, window, gc, ie, je + buf);
+          }
+        }
+        else {
+          XDrawPoint(display, window, gc, i + PX, j + PY + buf);
         }
       }
     }
-  }
 
+    /* write the title */
+    XSetForeground(display, gc, black);
+    XSetBackground(display, gc, white);
+    XDrawString(display, window, gc, PX, PY + 40, Frame->Title[k],
+      Frame->Length[k]);
+
+    /* draw the color bar */
+    for (j = 0; j < Frame->MapNY * re; j++) {
+      XSetForeground(display, gc,
+        my_color[(int) (50 * j / (Frame->MapNY * re))].pixel);
+      XDrawLine(display, window, gc, (int) (PX + Frame->MapNX * re + 10),
+        (int) (PY + Frame->MapNY * re - j + buf),
+        (int) (PX + Frame->MapNX * re + 20),
+        (int) (PY + Frame->MapNY * re - j + buf));
+    }
+
+    /* label the color bar */
+    sprintf(text2, "%6f", max);
+    XSetForeground(display, gc, black);
+    XClearArea(display, window, (int) (PX + Frame->MapNX * re),
+      (int) (PY - 20 + buf), 50, 20, False);
+    XDrawString(display, window, gc, (int) (PX + Frame->MapNX * re),
+      (int) (PY - 10 + buf), text2, 6);
+    sprintf(text2, "%6.1f", min);
+    XClearArea(display, window, (int) (PX + Frame->MapNX * re),
+      (int) (PY + Frame->MapNY * re + buf), 50, 30, False);
+    XDrawString(display, window, gc, (int) (PX + Frame->MapNX * re),
+      (int) (PY + Frame->MapNY * re + 20 + buf), text2, 6);
+  }
 #endif
 }
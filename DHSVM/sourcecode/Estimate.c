@@ -0,0 +1,358 @@
+/*
+ * SUMMARY:      Estimate.c - Memory, output and run time of a run
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With "DHSVM --estimate" (dhsvm_estimate()) the
+ *               initialization stops once the basin, the channel network
+ *               and the met stations are known.  ProjectMemory() then
+ *               prints the memory each subsystem will hold after the
+ *               initialization, from what the memory accounting
+ *               (MemAccount.c) has counted so far and from the sizes of
+ *               the maps and per cell arrays that are still to come.  If
+ *               they fit, the initialization is finished and a few steps
+ *               are timed, with the output in a scratch directory, to
+ *               project the run time and the bytes of output.
+ * DESCRIP-END.
+ * FUNCTIONS:    ProjectMemory()
+ *               MapDumpBytes()
+ *               MakeScratchOutput()
+ *               ScratchOutputBytes()
+ *               RemoveScratchOutput()
+ *               ArenaBytes()
+ *               StaticMapBytes()
+ *               MaxDaylightSteps()
+ * COMMENTS:     The projection follows the allocations of the Init*
+ *               routines for the large maps and the per cell arrays.  The
+ *               small tables and the buffers of the output writer are not
+ *               included, and the maps in a STATIC DATA SHARE segment or
+ *               in OUT OF CORE DIRECTORY scratch files are not counted, as
+ *               in the accounting itself.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "settings.h"
+#include "constants.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "getinit.h"
+#include "sizeofnt.h"
+#include "memaccount.h"
+#include "estimate.h"
+
+#define MB 1048576.
+
+static double ArenaBytes(double Bytes);
+static double StaticMapBytes(MAPSIZE *Map, int Bits);
+static int MaxDaylightSteps(TIMESTRUCT *Time, SOLARGEOMETRY *SolarGeo);
+
+/*****************************************************************************
+  Function name: ProjectMemory()
+
+  Purpose      : Print the memory of each subsystem after the
+                 initialization
+
+  Required     :
+    LISTPTR Input          - configuration file
+    OPTIONSTRUCT *Options  - options of the run
+    MAPSIZE *Map           - basin, with the active cells
+    TIMESTRUCT *Time       - model period
+    SOLARGEOMETRY *SolarGeo - location of the basin
+    LAYER *Soil            - soil layers of each soil type
+    LAYER *Veg             - vegetation layers of each vegetation type
+    SOILPIX **SoilMap      - soil type of each cell
+    VEGPIX **VegMap        - vegetation type of each cell
+    int NStats             - number of met stations
+
+  Returns      : projected bytes of all the subsystems
+
+  Comments     : Called after InitMetSources(), the bytes that are
+                 counted until then are part of the projection
+*****************************************************************************/
+double ProjectMemory(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
+		     TIMESTRUCT *Time, SOLARGEOMETRY *SolarGeo, LAYER *Soil,
+		     LAYER *Veg, SOILPIX **SoilMap, VEGPIX **VegMap,
+		     int NStats)
+{
+  char Str[BUFSIZE + 1];
+  double Bytes[NMEMTAGS];	/* projected bytes of each subsystem */
+  double Grid;			/* cells of a map */
+  double Active;		/* active cells */
+  double Rows;			/* row pointers of a map */
+  double Weights;		/* stations used for a point */
+  double StatMaps;		/* maps of the annual statistics */
+  double Total;
+  int NMaps;			/* map variables of the output */
+  int NStatVars;		/* variables with annual statistics */
+  int NSoil;
+  int NVeg;
+  int NNodes;
+  int Step;
+  int i;
+  int k;
+  int x;
+  int y;
+
+  Grid = (double) Map->NY * Map->NX;
+  Active = (double) Map->NumActive;
+  Rows = (double) Map->NY * sizeof(void *);
+
+  for (i = 0; i < NMEMTAGS; i++)
+    Bytes[i] = MemoryInUse(i);
+
+  /* state maps, and the small arrays of each cell in the arenas */
+  Bytes[MEM_SNOW] += Grid * sizeof(SNOWPIX) + Rows;
+  Bytes[MEM_PRECIP] += Grid * sizeof(PRECIPPIX) + Rows;
+  Bytes[MEM_EVAP] += Grid * sizeof(EVAPPIX) + Rows;
+  Bytes[MEM_RADIATION] += Grid * sizeof(PIXRAD) + Rows;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    NVeg = Veg->NLayers[VegMap[y][x].Veg - 1];
+    NSoil = Soil->NLayers[SoilMap[y][x].Soil - 1];
+    Bytes[MEM_PRECIP] += 2 * ArenaBytes(NVeg * sizeof(float));
+    if (!Options->SnowOnly)
+      Bytes[MEM_EVAP] += 2 * ArenaBytes((NVeg + 1) * sizeof(float)) +
+      ArenaBytes(NVeg * sizeof(float)) + ArenaBytes(NVeg * sizeof(float *)) +
+      NVeg * ArenaBytes(NSoil * sizeof(float));
+  }
+  Bytes[MEM_TERRAIN] += Active * (sizeof(unsigned short) +
+				  (Options->CellClassOrder ?
+				   sizeof(unsigned char) + sizeof(int) : 0));
+  if (Options->SpinUpCycles > 0)
+    Bytes[MEM_SOIL] += 2 * Active * sizeof(float);
+  if (Options->HasNetwork)
+    Bytes[MEM_ROUTING] += Active * sizeof(int);
+
+  /* the shadow maps of the daylight steps of a month */
+  if (Options->Shading) {
+    Bytes[MEM_SHADOW] += Time->NDaySteps * (sizeof(int) + sizeof(void *) +
+					    Rows) + Grid;
+    if (Options->ShadingMode == SHADING_HORIZON)
+      Bytes[MEM_SHADOW] += Grid + Active * (Options->HorizonSectors + 1 +
+					     3 * sizeof(float));
+    else if (IsEmptyStr(Options->OutOfCoreDir) &&
+	     IsEmptyStr(Options->StaticShare))
+      Bytes[MEM_SHADOW] += (double) MaxDaylightSteps(Time, SolarGeo) * Grid;
+    if (IsEmptyStr(Options->StaticShare))
+      Bytes[MEM_SHADOW] += StaticMapBytes(Map, Options->StaticMapBits);
+  }
+
+  if (Options->MM5) {
+    NMaps = N_MM5_MAPS + (Options->HeatFlux ? Soil->MaxLayers : 0);
+    Bytes[MEM_MM5] += NMaps * (Grid * sizeof(float) + Rows);
+  }
+
+  /* the interpolation weights of the cells, and of the nodes of a coarse
+     met grid, with the stations of each point in one block */
+  Weights = (Options->Interpolation == NEAREST) ? 1 : NStats;
+  if (Options->MaxInterpStations > 0 && Options->MaxInterpStations < Weights)
+    Weights = Options->MaxInterpStations;
+  if (!(Options->MM5 && !Options->QPF) && IsEmptyStr(Options->StaticShare))
+    Bytes[MEM_MET] += Grid * sizeof(METWEIGHT) + Rows +
+      Active * Weights * (sizeof(int) + 3 * sizeof(float));
+  Step = Options->MetGridSpacing;
+  if (Step > 1) {
+    NNodes = ((Map->NY - 1) / Step + 2) * ((Map->NX - 1) / Step + 2);
+    Bytes[MEM_MET] += NNodes * (11 * sizeof(float) + sizeof(METWEIGHT) +
+				Weights * (sizeof(int) + 3 * sizeof(float))) +
+      Active * sizeof(float);
+  }
+  Bytes[MEM_MET] += 8 * Active * sizeof(float) +
+    NStats * (sizeof(STATVALUE) + 2 * sizeof(float));
+  if (Options->Prism)
+    Bytes[MEM_MET] += Grid * sizeof(float) + Rows;
+  if (IsEmptyStr(Options->StaticShare)) {
+    if (Options->PrecipLapse == MAP)
+      Bytes[MEM_MET] += StaticMapBytes(Map, Options->StaticMapBits);
+    if (Options->WindSource == MODEL)
+      Bytes[MEM_MET] += NWINDMAPS * StaticMapBytes(Map, Options->StaticMapBits);
+  }
+
+  if (Options->HRU)
+    Bytes[MEM_HRU] += 4 * Active * sizeof(int);
+
+  /* the map of a dump and the copies queued for the writer thread, and
+     the maps of the annual statistics */
+  GetInitString("OUTPUT", "NUMBER OF MAP VARIABLES", "0", Str,
+		(unsigned long) BUFSIZE, Input);
+  if (!CopyInt(&NMaps, Str, 1))
+    NMaps = 0;
+  GetInitString("OUTPUT", "NUMBER OF STATISTICS VARIABLES", "0", Str,
+		(unsigned long) BUFSIZE, Input);
+  if (!CopyInt(&NStatVars, Str, 1))
+    NStatVars = 0;
+  if (NMaps > 0)
+    Bytes[MEM_OUTPUT] += (1 + Options->OutputQueueSize) * Grid * sizeof(float)
+      + (Options->BasinOnlyOutput ? Active * sizeof(float) : 0.);
+  StatMaps = 6 * sizeof(float) + 2 * sizeof(double) + sizeof(int);
+  if (NStatVars > 0)
+    Bytes[MEM_OUTPUT] += Grid * sizeof(float) + NStatVars * Grid * StatMaps;
+
+  printf("\nProjected memory by subsystem after the initialization:\n");
+  printf("%-18s %12s %14s\n", "Subsystem", "So far (MB)", "Projected (MB)");
+  for (i = 0, Total = 0.0; i < NMEMTAGS; i++) {
+    Total += Bytes[i];
+    if (Bytes[i] > 0.0)
+      printf("%-18s %12.1f %14.1f\n", MemoryTagName(i), MemoryInUse(i) / MB,
+	     Bytes[i] / MB);
+  }
+  printf("%-18s %12s %14.1f\n", "total", "", Total / MB);
+  if (MemoryLimitBytes() > 0.0)
+    printf("Memory limit: %.1f MB\n", MemoryLimitBytes() / MB);
+  if (Options->NMembers > 1)
+    printf("Each of the %d ENSEMBLE MEMBERS holds its own copy of the "
+	   "state\n", Options->NMembers);
+  fflush(stdout);
+
+  return Total;
+}
+
+/*****************************************************************************
+  MapDumpBytes()
+
+  Bytes of the map dumps of the model period, without compression
+*****************************************************************************/
+double MapDumpBytes(DUMPSTRUCT *Dump, MAPSIZE *Map, int BasinOnly)
+{
+  double Bytes;
+  double Cells;
+  int i;
+
+  Cells = BasinOnly ? (double) Map->NumActive : (double) Map->NY * Map->NX;
+  for (i = 0, Bytes = 0.0; i < Dump->NMaps; i++)
+    Bytes += Dump->DMap[i].N * Cells *
+      SizeOfNumberType(Dump->DMap[i].NumberType);
+  return Bytes;
+}
+
+/*****************************************************************************
+  MakeScratchOutput()
+
+  Creates a new scratch directory for the output of the calibration steps
+  and puts its path, ending with a /, in Dir
+*****************************************************************************/
+void MakeScratchOutput(char *Dir)
+{
+  const char *Tmp;
+
+  if ((Tmp = getenv("TMPDIR")) == NULL || IsEmptyStr((char *) Tmp))
+    Tmp = "/tmp";
+  snprintf(Dir, BUFSIZE, "%s/DHSVM.estimate.XXXXXX", Tmp);
+  if (mkdtemp(Dir) == NULL)
+    ReportError(Dir, 3);
+  strcat(Dir, "/");
+}
+
+/*****************************************************************************
+  ScratchOutputBytes()
+
+  Bytes of the files in the scratch directory Dir
+*****************************************************************************/
+double ScratchOutputBytes(const char *Dir)
+{
+  char FileName[2 * BUFSIZE + 1];
+  struct dirent *Entry;
+  struct stat Info;
+  double Bytes;
+  DIR *Scratch;
+
+  if ((Scratch = opendir(Dir)) == NULL)
+    return 0.0;
+  Bytes = 0.0;
+  while ((Entry = readdir(Scratch)) != NULL) {
+    snprintf(FileName, sizeof(FileName), "%s%s", Dir, Entry->d_name);
+    if (stat(FileName, &Info) == 0 && S_ISREG(Info.st_mode))
+      Bytes += (double) Info.st_size;
+  }
+  closedir(Scratch);
+  return Bytes;
+}
+
+/*****************************************************************************
+  RemoveScratchOutput()
+
+  Removes the files of the scratch directory Dir, and the directory
+*****************************************************************************/
+void RemoveScratchOutput(const char *Dir)
+{
+  char FileName[2 * BUFSIZE + 1];
+  struct dirent *Entry;
+  DIR *Scratch;
+
+  if ((Scratch = opendir(Dir)) == NULL)
+    return;
+  while ((Entry = readdir(Scratch)) != NULL) {
+    if (strcmp(Entry->d_name, ".") == 0 || strcmp(Entry->d_name, "..") == 0)
+      continue;
+    snprintf(FileName, sizeof(FileName), "%s%s", Dir, Entry->d_name);
+    remove(FileName);
+  }
+  closedir(Scratch);
+  rmdir(Dir);
+}
+
+/*****************************************************************************
+  ArenaBytes()
+
+  Bytes an array of Bytes takes in an arena (see ArenaCalloc())
+*****************************************************************************/
+static double ArenaBytes(double Bytes)
+{
+  size_t Align = sizeof(double);
+
+  return (double) (((size_t) Bytes + Align - 1) / Align * Align);
+}
+
+/*****************************************************************************
+  StaticMapBytes()
+
+  Bytes of a static map of the active cells (see InitStaticMap())
+*****************************************************************************/
+static double StaticMapBytes(MAPSIZE *Map, int Bits)
+{
+  if (Bits == 8)
+    return (double) Map->NumActive * sizeof(unsigned char);
+  if (Bits == 16)
+    return (double) Map->NumActive * sizeof(unsigned short);
+  return (double) Map->NumActive * sizeof(float);
+}
+
+/*****************************************************************************
+  MaxDaylightSteps()
+
+  Largest number of steps of a day with the sun above the horizon in a
+  month, the shadow maps InitNewMonth() holds at the same time
+*****************************************************************************/
+static int MaxDaylightSteps(TIMESTRUCT *Time, SOLARGEOMETRY *SolarGeo)
+{
+  int *Slice;
+  int Max;
+  int Month;
+  int NSlices;
+  int n;
+
+  if (!(Slice = (int *) calloc(Time->NDaySteps, sizeof(int))))
+    ReportError("MaxDaylightSteps", 1);
+  for (Month = 1, Max = 0; Month <= 12; Month++) {
+    for (n = 0; n < Time->NDaySteps; n++)
+      Slice[n] = -1;
+    DaylightSteps(Time->Start.Year, Month, Time->Dt, SolarGeo,
+		  Time->NDaySteps, Slice);
+    for (n = 0, NSlices = 0; n < Time->NDaySteps; n++)
+      if (Slice[n] == 0)
+	NSlices++;
+    if (NSlices > Max)
+      Max = NSlices;
+  }
+  free(Slice);
+  return Max;
+}
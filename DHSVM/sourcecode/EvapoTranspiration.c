@@ -9,7 +9,16 @@
  * DESCRIPTION:  Calculate evapotranspiration
  * DESCRIP-END.
  * FUNCTIONS:    EvapoTranspiration()
- * COMMENTS:
+ *               NoTranspiration()
+ * COMMENTS:     EvapoTranspiration() only writes to the pixel it is called 
+ *               for: it allocates nothing and leaves VType unchanged, so 
+ *               that the cells can be computed concurrently.  They are
+ *               computed by the host threads of the pixel loop.  Of the
+ *               column physics only the rain interception of INTERCEPTION
+ *               BATCH has an OpenMP target path (DHSVM_USE_OPENMP_TARGET,
+ *               see InterceptionBatch.c); this routine works on the
+ *               pointer-linked pixel structures and reports errors with
+ *               ReportError(), which a device cannot do
  * $Id: EvapoTranspiration.c,v 1.5 2007/03/02 22:02:01 lancuo Exp $     
  */
 
@@ -32,18 +41,26 @@ void EvapoTranspiration(int Layer, int ImpvRad, int Dt, PIXMET *Met,
 			float MoistureFlux, SOILPIX *LocalSoil, float *Int,
 			EVAPPIX *LocalEvap, float *Adjust, float Ra)
 {
-  float *Rc;			/* canopy resistance associated with 
-				           conditions in each soil layer (s/m) */
+  float Rc;			/* canopy resistance associated with 
+				           conditions in a soil layer (s/m) */
   float DryArea;		/* relative dry leaf area  */
   float DryEvapTime;	/* amount of time remaining during a timestep
 				           after the interception storage is depleted (sec) */
   float F;			    /* Fractional coverage by vegetation layer */
+  float RpFactor;		/* light level factor of the canopy resistance */
+  float SlopeGamma;		/* Slope + Gamma of the Penman-Monteith equation */
+  float VpdFactor;		/* vapor pressure deficit factor of the canopy
+				   resistance */
+  float MaxInt;			/* interception capacity as if the entire pixel 
+				   is covered (m) */
   float SoilMoisture;	/* Amount of water in each soil layer (m) */
   float WetArea;		/* relative leaf area wetted by interception storage */
   float WetEvapRate;	/* evaporation rate from wetted fraction per unit ground area (m/s) */
   float WetEvapTime;	/* amount of time needed to evaporate the amount of water 
                            in interception storage (sec) */
   int i;			    /* counter */
+  int Open;			/* FALSE if the vapor pressure deficit closes
+				   the stomata */
 
 
   F = VType->Fract[Layer];
@@ -58,11 +75,7 @@ void EvapoTranspiration(int Layer, int ImpvRad, int Dt, PIXMET *Met,
   as if the entire pixel is covered. These depths will be converted back later on. */
   *Int /= F;
   MoistureFlux /= F;
-  VType->MaxInt[Layer] /= F;
-
-  /* allocate memory for the canopy resistance array */
-  if (!(Rc = (float *) calloc(VType->NSoilLayers, sizeof(float))))
-    ReportError("EvapoTranspiration()", 1);
+  MaxInt = VType->MaxInt[Layer] / F;
 
   /* Calculate the evaporation rate in m/s */
   LocalEvap->EPot[Layer] = (Met->Slope * NetRad + Met->AirDens * CP * Met->Vpd / Ra) /
@@ -83,8 +96,8 @@ void EvapoTranspiration(int Layer, int ImpvRad, int Dt, PIXMET *Met,
   if (LocalEvap->EPot[Layer] < 0)
     LocalEvap->EPot[Layer] = 0;
 
-  /* WetArea = pow(*Int/VType->MaxInt[Layer], (double) 2.0/3.0); */
-  WetArea = cbrt(*Int / VType->MaxInt[Layer]);
+  /* WetArea = pow(*Int/MaxInt, (double) 2.0/3.0); */
+  WetArea = cbrt(*Int / MaxInt);
   WetArea = WetArea * WetArea;
   DryArea = 1 - WetArea;
 
@@ -135,22 +148,25 @@ void EvapoTranspiration(int Layer, int ImpvRad, int Dt, PIXMET *Met,
   LocalEvap->EInt[Layer] *= F;
   LocalEvap->ETot += LocalEvap->EInt[Layer];
   *Int *= F;
-  VType->MaxInt[Layer] *= F;   
-
-  /* calculate the canopy conductances associated with the conditions in 
-     each of the soil layers */
-  for (i = 0; i < VType->NSoilLayers; i++)
-    Rc[i] = CanopyResistance(VType->LAI[Layer], VType->RsMin[Layer],
-			     VType->RsMax[Layer], VType->Rpc[Layer],
-			     VType->VpdThres[Layer], VType->MoistThres[Layer],
-			     SType->WP[i], LocalSoil->Temp[i],
-			     LocalSoil->Moist[i], Met->Vpd, Rp);
 
   /* calculate the transpiration rate for the current vegetation layer,
-     and adjust the soil moisture content in each of the soil layers */
+     and adjust the soil moisture content in each of the soil layers.  The 
+     canopy conductance of a soil layer only depends on the moisture of that
+     layer before it is adjusted.  The factors of the canopy resistance that
+     do not depend on the soil layer are computed once */
+  Open = CanopyFactors(VType, Layer, Met->Vpd, Rp, &VpdFactor, &RpFactor);
+  SlopeGamma = Met->Slope + Met->Gamma;
   for (i = 0; i < VType->NSoilLayers; i++) {
-    LocalEvap->ESoil[Layer][i] = (Met->Slope + Met->Gamma) /
-      (Met->Slope + Met->Gamma * (1 + Rc[i] / Ra)) * VType->RootFract[Layer][i] *
+    if (Open)
+      Rc = CanopyResistance(VpdFactor, RpFactor, VType->RsMin[Layer],
+			    VType->LAI[Layer], VType->MoistThres[Layer],
+			    SType->WP[i], LocalSoil->Temp[i],
+			    LocalSoil->Moist[i]);
+    else
+      Rc = DHSVM_HUGE;
+
+    LocalEvap->ESoil[Layer][i] = SlopeGamma /
+      (Met->Slope + Met->Gamma * (1 + Rc / Ra)) * VType->RootFract[Layer][i] *
       LocalEvap->EPot[Layer] * Adjust[i];
 
     /* calculate the amounts of water transpirated during each timestep based 
@@ -176,8 +192,21 @@ void EvapoTranspiration(int Layer, int ImpvRad, int Dt, PIXMET *Met,
     LocalEvap->ETot += LocalEvap->ESoil[Layer][i];
     LocalEvap->EAct[Layer] += LocalEvap->ESoil[Layer][i];
   }
-
-  /* clean up */
-  free(Rc);
 }
 
+/*****************************************************************************
+  NoTranspiration()
+
+  Sets the evapotranspiration of a vegetation layer to zero, for the dry
+  vegetation of quiescent cells at night (QUIESCENT CELLS = RELAXED)
+*****************************************************************************/
+void NoTranspiration(int Layer, int NSoilLayers, EVAPPIX *LocalEvap)
+{
+  int i;
+
+  LocalEvap->EPot[Layer] = 0.0;
+  LocalEvap->EInt[Layer] = 0.0;
+  LocalEvap->EAct[Layer] = 0.0;
+  for (i = 0; i < NSoilLayers; i++)
+    LocalEvap->ESoil[Layer][i] = 0.0;
+}
@@ -10,11 +10,18 @@
 * DESCRIP-END.
 * FUNCTIONS:    ExecDump()
 *               DumpMap()
+*               ReduceMap()
+*               ExtractDumpVar()
+*               ExtractMap()
 *               DumpPix()
+*               DumpPixBin()
+*               InitPixBinVars()
+*               DumpSatExtent()
 * COMMENTS:
 * $Id: ExecDump.c, v 4.0  2013/1/5   Ning Exp $
 */
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +32,10 @@
 #include "DHSVMerror.h"
 #include "functions.h"
 #include "constants.h"
+#include "memaccount.h"
+#include "varid.h"
+#include "rollover.h"
+#include "iobench.h"
 
 /*****************************************************************************
 ExecDump()
@@ -38,64 +49,107 @@ void ExecDump(MAPSIZE *Map, DATE *Current, DATE *Start, OPTIONSTRUCT *Options,
   float *Hydrograph)
 {
   int i;			/* counter */
-  int j;			/* counter */
+  int First;			/* first dump at this time step */
+  int Last;			/* one past the last dump at this time step */
+  DUMPEVENT *Event;
   int x;
   int y;
 
-  /* dump the aggregated basin values for this timestep */
-  DumpPix(Current, IsEqualTime(Current, Start), &(Dump->Aggregate),
-    &(Total->Evap), &(Total->Precip), &(Total->Rad), &(Total->Snow),
-    &(Total->Soil), Soil->MaxLayers, Veg->MaxLayers, Options);
-  //fprintf(Dump->Aggregate.FilePtr, " %lu", Total->Saturated);
-  fprintf(Dump->Aggregate.FilePtr, "\n");
+  /* dump the aggregated basin values for this timestep, if they were all
+     aggregated (AGGREGATION INTERVAL) */
+  if (Total->Full) {
+    IOBENCH_BEGIN(IO_AGGREGATE);
+    DumpPix(Current, IsEqualTime(Current, Start) || IsRolloverStep(Current),
+      &(Dump->Aggregate),
+      &(Total->Evap), &(Total->Precip), &(Total->Rad), &(Total->Snow),
+      &(Total->Soil), Soil->MaxLayers, Veg->MaxLayers, Options);
+    //fprintf(Dump->Aggregate.FilePtr, " %lu", Total->Saturated);
+    fprintf(Dump->Aggregate.FilePtr, "\n");
+    IOBENCH_END(IO_AGGREGATE);
+  }
 
   if (Options->Extent != POINT) {
+    /* find the state and map dumps for this time step in the sorted list.
+       Dump dates that do not fall on a time step are passed over */
+    while (Dump->NextEvent < Dump->NEvents &&
+	   Before(Dump->Events[Dump->NextEvent].Date, Current) &&
+	   !IsEqualTime(Dump->Events[Dump->NextEvent].Date, Current))
+      Dump->NextEvent++;
+    First = Dump->NextEvent;
+    while (Dump->NextEvent < Dump->NEvents &&
+	   IsEqualTime(Dump->Events[Dump->NextEvent].Date, Current))
+      Dump->NextEvent++;
+    Last = Dump->NextEvent;
+
     /* check whether the model state needs to be dumped at this timestep, and
     dump state if needed */
     if (Dump->NStates < 0) {
+      WaitChannelRouting();
+      IOBENCH_BEGIN(IO_STATES);
       StoreModelState(Dump->Path, Current, Map, Options, TopoMap, PrecipMap,
         SnowMap, MetMap, VegMap, Veg, SoilMap, Soil,
         Network, HydrographInfo, Hydrograph, ChannelData);
-      if (Options->HasNetwork)
+      if (Options->HasNetwork && Options->StateFormat == STATE_MAPS)
         StoreChannelState(Dump->Path, Current, ChannelData->streams);
+      IOBENCH_END(IO_STATES);
     }
     else {
-      for (i = 0; i < Dump->NStates; i++) {
-        if (IsEqualTime(Current, &(Dump->DState[i]))) {
+      for (i = First; i < Last; i++) {
+        if (Dump->Events[i].Type == STATE_EVENT) {
+          WaitChannelRouting();
+          IOBENCH_BEGIN(IO_STATES);
           StoreModelState(Dump->Path, Current, Map, Options, TopoMap,
             PrecipMap, SnowMap, MetMap, VegMap, Veg,
             SoilMap, Soil, Network, HydrographInfo, Hydrograph,
             ChannelData);
-          if (Options->HasNetwork)
+          if (Options->HasNetwork && Options->StateFormat == STATE_MAPS)
             StoreChannelState(Dump->Path, Current, ChannelData->streams);
+          IOBENCH_END(IO_STATES);
         }
       }
     }
 
     /* check which pixels need to be dumped, and dump if needed */
-    for (i = 0; i < Dump->NPix; i++) {
+    if (Dump->NPix > 0)
+      IOBENCH_BEGIN(IO_PIXELS);
+    if (Dump->NPix > 0 && Options->PixelOutput == PIXEL_BINARY)
+      DumpPixBin(Current, Dump, EvapMap, PrecipMap, RadMap, SnowMap, SoilMap,
+        VegMap, Soil, Veg, Options);
+    for (i = 0; i < Dump->NPix && Options->PixelOutput == PIXEL_TEXT; i++) {
       y = Dump->Pix[i].Loc.N;
       x = Dump->Pix[i].Loc.E;
 
       /* output variable at the pixel */
-      DumpPix(Current, IsEqualTime(Current, Start), &(Dump->Pix[i].OutFile),
+      DumpPix(Current, IsEqualTime(Current, Start) || IsRolloverStep(Current),
+        &(Dump->Pix[i].OutFile),
         &(EvapMap[y][x]), &(PrecipMap[y][x]), &(RadMap[y][x]), &(SnowMap[y][x]),
         &(SoilMap[y][x]), Soil->NLayers[(SoilMap[y][x].Soil - 1)],
         Veg->NLayers[(VegMap[y][x].Veg - 1)], Options);
       fprintf(Dump->Pix[i].OutFile.FilePtr, "\n");
     }
+    if (Dump->NPix > 0)
+      IOBENCH_END(IO_PIXELS);
+
+    /* accumulate the maps that are reduced over the steps between the 
+       dumps, this step included */
+    for (i = 0; i < Dump->NMaps; i++)
+      if (Dump->DMap[i].Reducer != REDUCE_LAST)
+	ReduceMap(Map, &(Dump->DMap[i]), TopoMap, EvapMap, PrecipMap, RadMap,
+		  SnowMap, SoilMap, Soil, VegMap, Veg, Options);
 
     /* check which maps need to be dumped at this timestep, and dump maps if needed */
-    for (i = 0; i < Dump->NMaps; i++) {
-      for (j = 0; j < Dump->DMap[i].N; j++) {
-        if (IsEqualTime(Current, &(Dump->DMap[i].DumpDate[j]))) {
-          fprintf(stdout, "Dumping Maps at ");
-          PrintDate(Current, stdout);
-          fprintf(stdout, "\n");
-          DumpMap(Map, Current, &(Dump->DMap[i]), TopoMap, EvapMap,
-            PrecipMap, RadMap, SnowMap, SoilMap, Soil, VegMap,
-            Veg, Network, Options);
-        }
+    for (i = First; i < Last; i++) {
+      Event = &(Dump->Events[i]);
+      if (Event->Type == MAP_EVENT) {
+        IOBENCH_BEGIN(IO_MAPS);
+        fprintf(stdout, "Dumping Maps at ");
+        PrintDate(Current, stdout);
+        fprintf(stdout, "\n");
+        DumpMap(Map, Current, &(Dump->DMap[Event->Map]),
+          Event->Index - Dump->DMap[Event->Map].FirstIndex,
+          TopoMap, EvapMap, PrecipMap, RadMap, SnowMap, SoilMap, Soil, 
+          VegMap, Veg, Network, Options);
+        IOBENCH_END(IO_MAPS);
       }
     }
   }
@@ -103,916 +157,393 @@ void ExecDump(MAPSIZE *Map, DATE *Current, DATE *Start, OPTIONSTRUCT *Options,
 
 /*****************************************************************************
 DumpMap()
+
+The variables that can be dumped are listed in DumpVars[], with the pixel 
+map they are taken from and the position of the field in the pixel 
+structure.  All variables are extracted by ExtractMap() into a buffer that
+is kept between calls.  Maps with a MAP REDUCER other than LAST are 
+accumulated at each step by ReduceMap(), and DumpMap() writes the reduced
+map and starts the next period.  Maps with a window or blocks are reduced
+to the grid of their file by WindowMap() before they are written.
 *****************************************************************************/
-void DumpMap(MAPSIZE *Map, DATE *Current, MAPDUMP *DMap, TOPOPIX **TopoMap,
+
+/* pixel maps from which DumpMap() takes the variables */
+#define EVAP_MAP    0
+#define PRECIP_MAP  1
+#define RAD_MAP     2
+#define SNOW_MAP    3
+#define SOIL_MAP    4
+#define N_DUMP_MAPS 5
+
+/* types of fields */
+#define FLOAT_FIELD    1	/* float */
+#define INT_FIELD      2	/* int, dumped as float */
+#define UCHAR_FIELD    3	/* uchar (flag), not scaled for images */
+#define USHORT_FIELD   4	/* unshort, dumped as float */
+#define PAIR_FIELD     5	/* sum of two consecutive floats */
+#define VEG_FIELD      6	/* float *, one per vegetation layer */
+#define VEG_SOIL_FIELD 7	/* float *, one per vegetation layer followed 
+				   by one for the soil surface */
+#define SOIL_FIELD     8	/* float *, one per soil layer */
+#define ESOIL_FIELD    9	/* float **, per vegetation layer and soil 
+				   layer, a map is dumped for each soil layer */
+#define ARRAY_FIELD   10	/* float [], one per vegetation layer (pixel
+				   output only) */
+
+typedef struct {
+  int ID;			/* variable ID (see VarID.c) */
+  int Source;			/* map the variable is taken from */
+  size_t Stride;		/* size of a pixel of that map */
+  size_t Offset;		/* offset of the field in the pixel */
+  int Field;			/* type of field */
+} DUMPVAR;
+
+static DUMPVAR DumpVars[] = {
+  {101, EVAP_MAP, sizeof(EVAPPIX), offsetof(EVAPPIX, ETot), FLOAT_FIELD},
+  {102, EVAP_MAP, sizeof(EVAPPIX), offsetof(EVAPPIX, EPot), VEG_SOIL_FIELD},
+  {103, EVAP_MAP, sizeof(EVAPPIX), offsetof(EVAPPIX, EInt), VEG_SOIL_FIELD},
+  {104, EVAP_MAP, sizeof(EVAPPIX), offsetof(EVAPPIX, ESoil), ESOIL_FIELD},
+  {105, EVAP_MAP, sizeof(EVAPPIX), offsetof(EVAPPIX, EAct), VEG_SOIL_FIELD},
+  {201, PRECIP_MAP, sizeof(PRECIPPIX), offsetof(PRECIPPIX, Precip), 
+   FLOAT_FIELD},
+  {202, PRECIP_MAP, sizeof(PRECIPPIX), offsetof(PRECIPPIX, IntRain), 
+   VEG_FIELD},
+  {203, PRECIP_MAP, sizeof(PRECIPPIX), offsetof(PRECIPPIX, IntSnow), 
+   VEG_FIELD},
+  {206, PRECIP_MAP, sizeof(PRECIPPIX), offsetof(PRECIPPIX, SumPrecip), 
+   FLOAT_FIELD},
+  {301, RAD_MAP, sizeof(PIXRAD), offsetof(PIXRAD, ObsShortIn), FLOAT_FIELD},
+  {302, RAD_MAP, sizeof(PIXRAD), offsetof(PIXRAD, PixelNetShort), 
+   FLOAT_FIELD},
+  {303, RAD_MAP, sizeof(PIXRAD), offsetof(PIXRAD, NetRadiation), PAIR_FIELD},
+  {401, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, HasSnow), UCHAR_FIELD},
+  {402, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, SnowCoverOver), 
+   UCHAR_FIELD},
+  {403, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, LastSnow), 
+   USHORT_FIELD},
+  {404, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, Swq), FLOAT_FIELD},
+  {405, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, Melt), FLOAT_FIELD},
+  {406, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, PackWater), FLOAT_FIELD},
+  {407, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, TPack), FLOAT_FIELD},
+  {408, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, SurfWater), FLOAT_FIELD},
+  {409, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, TSurf), FLOAT_FIELD},
+  {410, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, ColdContent), 
+   FLOAT_FIELD},
+  {411, SNOW_MAP, sizeof(SNOWPIX), offsetof(SNOWPIX, TSurfIter), INT_FIELD},
+  {501, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, Moist), SOIL_FIELD},
+  {502, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, Perc), SOIL_FIELD},
+  {503, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, TableDepth), 
+   FLOAT_FIELD},
+  {504, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, SatFlow), FLOAT_FIELD},
+  {505, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, TSurf), FLOAT_FIELD},
+  {506, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, Qnet), FLOAT_FIELD},
+  {507, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, Qs), FLOAT_FIELD},
+  {508, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, Qe), FLOAT_FIELD},
+  {509, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, Qg), FLOAT_FIELD},
+  {510, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, Qst), FLOAT_FIELD},
+  {513, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, IExcess), FLOAT_FIELD},
+  {514, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, InfiltAcc), 
+   FLOAT_FIELD},
+  {515, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, TSurfIter), INT_FIELD},
+  {516, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, CostSurfEval), INT_FIELD},
+  {517, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, CostSnowEval), INT_FIELD},
+  {518, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, CostSnowSteps), 
+   INT_FIELD},
+  {519, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, CostUnsatLayers), 
+   INT_FIELD},
+  {520, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, CostTime), FLOAT_FIELD},
+  {521, SOIL_MAP, sizeof(SOILPIX), offsetof(SOILPIX, CostQuietSteps), 
+   INT_FIELD},
+  {ENDOFLIST, 0, 0, 0, 0}
+};
+
+/* output buffer, large enough for a map of any number type */
+static void *DumpArray = NULL;
+static size_t DumpArraySize = 0;
+
+static void ExtractMap(DUMPVAR *Var, MAPDUMP *DMap, int SoilLayer, 
+		       void **Source, MAPSIZE *Map, TOPOPIX **TopoMap,
+		       SOILPIX **SoilMap, LAYER *Soil, VEGPIX **VegMap, 
+		       LAYER *Veg, OPTIONSTRUCT *Options, void *Array);
+
+/* find the variable of DMap in DumpVars[], NULL if it is not listed, and
+   make sure that the buffer is large enough for a map of it */
+static DUMPVAR *FindDumpVar(MAPSIZE *Map, MAPDUMP *DMap)
+{
+  const char *Routine = "FindDumpVar";
+  DUMPVAR *Var;
+  size_t Size;
+
+  for (Var = DumpVars; Var->ID != ENDOFLIST; Var++)
+    if (Var->ID == DMap->ID)
+      break;
+  if (Var->ID == ENDOFLIST)
+    return NULL;
+
+  /* the buffer is never smaller than a float map, because that is what is
+     extracted for most variables */
+  Size = MAX(SizeOfNumberType(DMap->NumberType), sizeof(float)) *
+    Map->NX * Map->NY;
+  if (Size > DumpArraySize) {
+    TaggedFree(DumpArray);
+    if (!(DumpArray = TaggedMalloc(Size, MEM_OUTPUT)))
+      ReportError((char *)Routine, 1);
+    DumpArraySize = Size;
+  }
+  return Var;
+}
+
+void DumpMap(MAPSIZE *Map, DATE *Current, MAPDUMP *DMap, int Index, 
+  TOPOPIX **TopoMap,
   EVAPPIX **EvapMap, PRECIPPIX **PrecipMap, PIXRAD **RadMap,
   SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER *Soil,
   VEGPIX **VegMap, LAYER *Veg, ROADSTRUCT **Network,
   OPTIONSTRUCT *Options)
 {
-  const char *Routine = "DumpMap";
-  char DataLabel[MAXSTRING + 1];
-  float Offset;
-  float Range;
-  int Index;
-  int NSoil;			/* Number of soil layers for current pixel */
-  int NVeg;			/* Number of veg layers for current pixel */
+  DUMPVAR *Var;
+  void *Source[N_DUMP_MAPS];
   int i;			/* counter */
-  int x;			/* counter */
-  int y;			/* counter */
-  void *Array;
-  int numPoints;
+  int j;			/* counter */
+  int NMaps;			/* number of maps written for this variable */
+  int NCells;
+  double *Accum;
+  MAPSIZE Out;			/* grid of the file of DMap */
   char VarIDStr[4];		/* stores VarID for sending to ReportError */
 
-  sprintf(DataLabel, "%02d.%02d.%04d.%02d.%02d.%02d", Current->Month,
-    Current->Day, Current->Year, Current->Hour, Current->Min,
-    Current->Sec);
+  sprintf(VarIDStr, "%d", DMap->ID);
 
-  /* find out what date we are dumping */
-  for (Index = 0; Index < DMap->N; Index++) {
-    if (IsEqualTime(Current, &(DMap->DumpDate[Index])))
-      break;
+  if (!(Var = FindDumpVar(Map, DMap)))
+    return;
+
+  if (DMap->Resolution != MAP_OUTPUT && DMap->Resolution != IMAGE_OUTPUT)
+    ReportError(VarIDStr, 66);
+  if (DMap->ID == 514 && Options->Infiltration != DYNAMIC)
+    ReportError(VarIDStr, 67);
+
+  Source[EVAP_MAP] = (void *) EvapMap;
+  Source[PRECIP_MAP] = (void *) PrecipMap;
+  Source[RAD_MAP] = (void *) RadMap;
+  Source[SNOW_MAP] = (void *) SnowMap;
+  Source[SOIL_MAP] = (void *) SoilMap;
+
+  NMaps = (Var->Field == ESOIL_FIELD) ? Soil->MaxLayers : 1;
+  NCells = Map->NX * Map->NY;
+  WindowMapSize(Map, DMap, &Out);
+  for (i = 0; i < NMaps; i++) {
+    if (DMap->Accum && DMap->NAccum > 0) {
+      /* reduced map, NA stays NA */
+      Accum = DMap->Accum + (size_t) i * NCells;
+      for (j = 0; j < NCells; j++) {
+	if (DMap->Reducer == REDUCE_MEAN && Accum[j] != NA)
+	  ((float *) DumpArray)[j] = (float) (Accum[j] / DMap->NAccum);
+	else
+	  ((float *) DumpArray)[j] = (float) Accum[j];
+      }
+    }
+    else
+      ExtractMap(Var, DMap, i, (void **) Source[Var->Source], Map, TopoMap,
+		 SoilMap, Soil, VegMap, Veg, Options, DumpArray);
+    if (DMap->WinNX > 0 || DMap->Block > 1)
+      WindowMap(Map, DMap, TopoMap, (float *) DumpArray);
+    Write2DMatrix(DMap->FileName, DumpArray, 
+		  (DMap->Resolution == MAP_OUTPUT) ? DMap->NumberType : NC_BYTE,
+		  &Out, DMap, Index);
   }
 
-  sprintf(VarIDStr, "%d", DMap->ID);
+  /* the next map is reduced over the steps that follow */
+  DMap->NAccum = 0;
+}
 
-  numPoints = Map->NX * Map->NY;
+/*****************************************************************************
+  ReduceMap()
 
-  switch (DMap->NumberType) {
-  case NC_BYTE:
-    if (!(Array = calloc(numPoints, SizeOfNumberType(NC_BYTE))))
-      ReportError((char *)Routine, 1);
-    break;
-  case NC_CHAR:
-    if (!(Array = calloc(numPoints, SizeOfNumberType(NC_CHAR))))
-      ReportError((char *)Routine, 1);
-    break;
-  case NC_SHORT:
-    if (!(Array = calloc(numPoints, SizeOfNumberType(NC_SHORT))))
-      ReportError((char *)Routine, 1);
-    break;
-  case NC_INT:
-    if (!(Array = calloc(numPoints, SizeOfNumberType(NC_INT))))
+  Add the variable of DMap at this time step to the reduced map(s) in 
+  DMap->Accum.  The first step after a dump starts the reduction.  Pixels 
+  that are NA stay NA, the layers of a pixel do not change during the run.
+*****************************************************************************/
+void ReduceMap(MAPSIZE *Map, MAPDUMP *DMap, TOPOPIX **TopoMap,
+	       EVAPPIX **EvapMap, PRECIPPIX **PrecipMap, PIXRAD **RadMap,
+	       SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER *Soil,
+	       VEGPIX **VegMap, LAYER *Veg, OPTIONSTRUCT *Options)
+{
+  const char *Routine = "ReduceMap";
+  DUMPVAR *Var;
+  void *Source[N_DUMP_MAPS];
+  int i;			/* counter */
+  int j;			/* counter */
+  int NMaps;			/* number of maps reduced for this variable */
+  int NCells;
+  float Value;
+  double *Accum;
+
+  if (!(Var = FindDumpVar(Map, DMap)))
+    return;
+
+  NMaps = (Var->Field == ESOIL_FIELD) ? Soil->MaxLayers : 1;
+  NCells = Map->NX * Map->NY;
+  if (!DMap->Accum) {
+    if (!(DMap->Accum = (double *) TaggedCalloc((size_t) NMaps * NCells, 
+						sizeof(double), MEM_OUTPUT)))
       ReportError((char *)Routine, 1);
-    break;
+    DMap->AccumSize = (size_t) NMaps * NCells;
+    DMap->NAccum = 0;
+  }
 
-  case NC_FLOAT:
-    if (!(Array = calloc(numPoints, SizeOfNumberType(NC_FLOAT))))
-      ReportError((char *)Routine, 1);
-    break;
-  case NC_DOUBLE:
-    if (!(Array = calloc(numPoints, SizeOfNumberType(NC_DOUBLE))))
-      ReportError((char *)Routine, 1);
-    break;
-  default:
-    Array = NULL;
-    ReportError((char *)Routine, 40);
-    break;
+  Source[EVAP_MAP] = (void *) EvapMap;
+  Source[PRECIP_MAP] = (void *) PrecipMap;
+  Source[RAD_MAP] = (void *) RadMap;
+  Source[SNOW_MAP] = (void *) SnowMap;
+  Source[SOIL_MAP] = (void *) SoilMap;
+
+  for (i = 0; i < NMaps; i++) {
+    ExtractMap(Var, DMap, i, (void **) Source[Var->Source], Map, TopoMap,
+	       SoilMap, Soil, VegMap, Veg, Options, DumpArray);
+    Accum = DMap->Accum + (size_t) i * NCells;
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(Value)
+#endif
+    for (j = 0; j < NCells; j++) {
+      Value = ((float *) DumpArray)[j];
+      if (DMap->NAccum == 0 || Value == NA || Accum[j] == NA)
+	Accum[j] = Value;
+      else if (DMap->Reducer == REDUCE_MIN) {
+	if (Value < Accum[j])
+	  Accum[j] = Value;
+      }
+      else if (DMap->Reducer == REDUCE_MAX) {
+	if (Value > Accum[j])
+	  Accum[j] = Value;
+      }
+      else
+	Accum[j] += Value;
+    }
   }
+  DMap->NAccum++;
+}
+
+/*****************************************************************************
+  ExtractDumpVar()
+
+  Extract the variable of DMap as a float map, for the statistics of 
+  Statistics.c.  Returns the buffer with the map, which is overwritten by 
+  the next dump, or NULL if the variable cannot be dumped or has more than
+  one map (ESOIL_FIELD).
+*****************************************************************************/
+float *ExtractDumpVar(MAPSIZE *Map, MAPDUMP *DMap, TOPOPIX **TopoMap,
+		      EVAPPIX **EvapMap, PRECIPPIX **PrecipMap, 
+		      PIXRAD **RadMap, SNOWPIX **SnowMap, SOILPIX **SoilMap,
+		      LAYER *Soil, VEGPIX **VegMap, LAYER *Veg,
+		      OPTIONSTRUCT *Options)
+{
+  DUMPVAR *Var;
+  void *Source[N_DUMP_MAPS];
+
+  if (!(Var = FindDumpVar(Map, DMap)) || Var->Field == ESOIL_FIELD)
+    return NULL;
+
+  Source[EVAP_MAP] = (void *) EvapMap;
+  Source[PRECIP_MAP] = (void *) PrecipMap;
+  Source[RAD_MAP] = (void *) RadMap;
+  Source[SNOW_MAP] = (void *) SnowMap;
+  Source[SOIL_MAP] = (void *) SoilMap;
+
+  ExtractMap(Var, DMap, 0, (void **) Source[Var->Source], Map, TopoMap,
+	     SoilMap, Soil, VegMap, Veg, Options, DumpArray);
+  return (float *) DumpArray;
+}
+
+/*****************************************************************************
+  ExtractMap()
+
+  Fill Array with the variable described by Var for each pixel, as float 
+  for maps (all variables in DumpVars[] are NC_FLOAT, see VarID.c) and as
+  uchar for images.  Layered variables are NA (0 for images) outside the basin and where the pixel 
+  does not have the layer.  For images the values are scaled between 
+  DMap->MinVal and DMap->MaxVal.  SoilLayer is only used for ESOIL_FIELD.
+*****************************************************************************/
+static void ExtractMap(DUMPVAR *Var, MAPDUMP *DMap, int SoilLayer, 
+		       void **Source, MAPSIZE *Map, TOPOPIX **TopoMap,
+		       SOILPIX **SoilMap, LAYER *Soil, VEGPIX **VegMap, 
+		       LAYER *Veg, OPTIONSTRUCT *Options, void *Array)
+{
+  float Offset;
+  float Range;
+  float Value;
+  int Present;			/* FALSE if the pixel does not have the layer */
+  int Layer;			/* layer index in the field */
+  int NLayers;
+  int x;			/* counter */
+  int y;			/* counter */
+  int i;			/* index in Array */
+  char *Field;			/* address of the field in the pixel */
 
   Offset = DMap->MinVal;
   Range = DMap->MaxVal - DMap->MinVal;
 
-  switch (DMap->ID) {
-
-  case 101:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = EvapMap[y][x].ETot;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map,
-        DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((EvapMap[y][x].ETot - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap,
-        Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 102:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer > Veg->MaxLayers)
-              /* soil */
-              ((float *)Array)[y * Map->NX + x] = EvapMap[y][x].EPot[NVeg];
-            else if (DMap->Layer <= NVeg)
-              /* vegetation layer */
-              ((float *)Array)[y * Map->NX + x] =
-              EvapMap[y][x].EPot[DMap->Layer - 1];
-            else
-              /* vegetation layer not present at this pixel */
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = NA;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map,
-        DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer > Veg->MaxLayers)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((EvapMap[y][x].EPot[NVeg] - Offset) /
-                Range * MAXUCHAR);
-            else if (DMap->Layer <= NVeg)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((EvapMap[y][x].EPot[DMap->Layer - 1] - Offset)
-                / Range * MAXUCHAR);
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = 0;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 103:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer > Veg->MaxLayers)
-              ((float *)Array)[y * Map->NX + x] = EvapMap[y][x].EInt[NVeg];
-            else if (DMap->Layer <= NVeg)
-              ((float *)Array)[y * Map->NX + x] =
-              EvapMap[y][x].EInt[DMap->Layer - 1];
-            else
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = NA;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer > Veg->MaxLayers)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((EvapMap[y][x].EInt[NVeg] - Offset) /
-                Range * MAXUCHAR);
-            else if (DMap->Layer <= NVeg)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((EvapMap[y][x].EInt[DMap->Layer - 1] - Offset)
-                / Range * MAXUCHAR);
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-          else
-            ((unsigned char *)Array)[y * Map->NX + x] = 0;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 104:
-    /* NETCDFWORK: This does not work for NETCDF.  Fix */
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (i = 0; i < Soil->MaxLayers; i++) {
-        for (y = 0; y < Map->NY; y++) {
-          for (x = 0; x < Map->NX; x++) {
-            if (INBASIN(TopoMap[y][x].Mask)) {
-              NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-              if (DMap->Layer <= NVeg)
-                ((float *)Array)[y * Map->NX + x] =
-                EvapMap[y][x].ESoil[DMap->Layer - 1][i];
-              else
-                ((float *)Array)[y * Map->NX + x] = NA;
-            }
-            else
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-        }
-        Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-      }
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (i = 0; i < Soil->MaxLayers; i++) {
-        for (y = 0; y < Map->NY; y++) {
-          for (x = 0; x < Map->NX; x++) {
-            if (INBASIN(TopoMap[y][x].Mask)) {
-              NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-              if (DMap->Layer <= NVeg)
-                ((unsigned char *)Array)[y * Map->NX + x] =
-                (unsigned char)((EvapMap[y][x].ESoil[DMap->Layer - 1][i] -
-                  Offset) / Range * MAXUCHAR);
-              else
-                ((unsigned char *)Array)[y * Map->NX + x] = 0;
-            }
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-        }
-        Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-      }
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 105:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer > Veg->MaxLayers)
-              ((float *)Array)[y * Map->NX + x] = EvapMap[y][x].EAct[NVeg];
-            else if (DMap->Layer <= NVeg)
-              ((float *)Array)[y * Map->NX + x] =
-              EvapMap[y][x].EAct[DMap->Layer - 1];
-            else
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = NA;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer > NVeg)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((EvapMap[y][x].EAct[NVeg] - Offset) /
-                Range * MAXUCHAR);
-            else if (DMap->Layer <= NVeg)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((EvapMap[y][x].EAct[DMap->Layer - 1] - Offset)
-                / Range * MAXUCHAR);
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-          else
-            ((unsigned char *)Array)[y * Map->NX + x] = 0;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 201:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          ((float *)Array)[y * Map->NX + x] = PrecipMap[y][x].Precip;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((PrecipMap[y][x].Precip - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 202:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer <= NVeg)
-              ((float *)Array)[y * Map->NX + x] = PrecipMap[y][x].IntRain[DMap->Layer - 1];
-            else
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = NA;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer <= NVeg)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((PrecipMap[y][x].IntRain[DMap->Layer - 1] -
-                Offset) / Range * MAXUCHAR);
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-          else
-            ((unsigned char *)Array)[y * Map->NX + x] = 0;
-        }
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(x, i, Field, Value, Present, Layer, NLayers)
+#endif
+  for (y = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
+      i = y * Map->NX + x;
+      Field = (char *) Source[y] + x * Var->Stride + Var->Offset;
+      Present = TRUE;
+      Value = 0.0;
+
+      switch (Var->Field) {
+      case FLOAT_FIELD:
+	Value = *(float *) Field;
+	break;
+      case INT_FIELD:
+	Value = (float) *(int *) Field;
+	break;
+      case UCHAR_FIELD:
+	if (DMap->Resolution == IMAGE_OUTPUT) {
+	  ((unsigned char *) Array)[i] = *(uchar *) Field;
+	  continue;
+	}
+	Value = (float) *(uchar *) Field;
+	break;
+      case USHORT_FIELD:
+	Value = (float) *(unshort *) Field;
+	break;
+      case PAIR_FIELD:
+	Value = ((float *) Field)[0] + ((float *) Field)[1];
+	break;
+      default:
+	/* layered fields */
+	if (!INBASIN(TopoMap[y][x].Mask)) {
+	  Present = FALSE;
+	  break;
+	}
+	if (Var->Field == SOIL_FIELD)
+	  NLayers = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
+	else
+	  NLayers = Veg->NLayers[(VegMap[y][x].Veg - 1)];
+	if (Var->Field == VEG_SOIL_FIELD && DMap->Layer > Veg->MaxLayers)
+	  Layer = NLayers;
+	else if (DMap->Layer <= NLayers)
+	  Layer = DMap->Layer - 1;
+	else {
+	  Present = FALSE;
+	  break;
+	}
+	if (Var->Field == ESOIL_FIELD)
+	  Value = (*(float ***) Field)[Layer][SoilLayer];
+	else
+	  Value = (*(float **) Field)[Layer];
+	break;
       }
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 203:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer <= NVeg)
-              ((float *)Array)[y * Map->NX + x] =
-              PrecipMap[y][x].IntSnow[DMap->Layer - 1];
-            else
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = NA;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
-            if (DMap->Layer <= NVeg)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((PrecipMap[y][x].IntSnow[DMap->Layer - 1] -
-                Offset) / Range * MAXUCHAR);
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-          else
-            ((unsigned char *)Array)[y * Map->NX + x] = 0;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 206:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          ((float *)Array)[y * Map->NX + x] = PrecipMap[y][x].SumPrecip;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((PrecipMap[y][x].Precip - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  /* incoming shortwave radiation with no shading adjustment */
-  case 301:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          ((float *)Array)[y * Map->NX + x] = RadMap[y][x].ObsShortIn;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((RadMap[y][x].ObsShortIn - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  /* net shortwave radiatoin received by the entire pixel*/
-  case 302:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = RadMap[y][x].PixelNetShort;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((RadMap[y][x].PixelNetShort - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-  
-  /* Net radiation (shortwave+longwave) received by the entire pixel*/
-  case 303:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = RadMap[y][x].NetRadiation[0]+RadMap[y][x].NetRadiation[1];
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((RadMap[y][x].NetRadiation[0] + RadMap[y][x].NetRadiation[1] - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 401:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] = SnowMap[y][x].HasSnow;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] = SnowMap[y][x].HasSnow;
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 402:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          SnowMap[y][x].SnowCoverOver;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          SnowMap[y][x].SnowCoverOver;
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 403:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned short *)Array)[y * Map->NX + x] = SnowMap[y][x].LastSnow;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)(((float)SnowMap[y][x].LastSnow - Offset) / Range
-            * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 404:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SnowMap[y][x].Swq;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SnowMap[y][x].Swq - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 405:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SnowMap[y][x].Melt;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SnowMap[y][x].Melt - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 406:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SnowMap[y][x].PackWater;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SnowMap[y][x].PackWater - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 407:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SnowMap[y][x].TPack;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SnowMap[y][x].TPack - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap,
-        Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 408:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SnowMap[y][x].SurfWater;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SnowMap[y][x].SurfWater - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 409:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SnowMap[y][x].TSurf;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SnowMap[y][x].TSurf - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 410:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SnowMap[y][x].ColdContent;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SnowMap[y][x].ColdContent - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 501:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NSoil = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
-            if (DMap->Layer <= NSoil)
-              ((float *)Array)[y * Map->NX + x] =
-              SoilMap[y][x].Moist[DMap->Layer - 1];
-            else
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = NA;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NSoil = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
-            if (DMap->Layer <= NSoil)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((SoilMap[y][x].Moist[DMap->Layer - 1] - Offset)
-                / Range * MAXUCHAR);
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-          else
-            ((unsigned char *)Array)[y * Map->NX + x] = 0;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 502:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NSoil = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
-            if (DMap->Layer <= NSoil)
-              ((float *)Array)[y * Map->NX + x] =
-              SoilMap[y][x].Perc[DMap->Layer - 1];
-            else
-              ((float *)Array)[y * Map->NX + x] = NA;
-          }
-          else
-            ((float *)Array)[y * Map->NX + x] = NA;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          if (INBASIN(TopoMap[y][x].Mask)) {
-            NSoil = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
-            if (DMap->Layer <= NSoil)
-              ((unsigned char *)Array)[y * Map->NX + x] =
-              (unsigned char)((SoilMap[y][x].Perc[DMap->Layer - 1] - Offset)
-                / Range * MAXUCHAR);
-            else
-              ((unsigned char *)Array)[y * Map->NX + x] = 0;
-          }
-          else
-            ((unsigned char *)Array)[y * Map->NX + x] = 0;
-        }
-      }
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 503:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].TableDepth;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].TableDepth - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 504:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].SatFlow;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].SatFlow - Offset) /
-            Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 505:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].TSurf;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].TSurf - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 506:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].Qnet;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].Qnet - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 507:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].Qs;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].Qs - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 508:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].Qe;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].Qe - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 509:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].Qg;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].Qg - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 510:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].Qst;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].Qst - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap,
-        Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
-
-  case 513:
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].IExcess;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].IExcess - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
 
-  case 514:
-    if (Options->Infiltration != DYNAMIC) {
-      ReportError(VarIDStr, 67);
+      if (DMap->Resolution == MAP_OUTPUT)
+	((float *) Array)[i] = Present ? Value : NA;
+      else
+	((unsigned char *) Array)[i] = Present ? 
+	  (unsigned char)((Value - Offset) / Range * MAXUCHAR) : 0;
     }
-    if (DMap->Resolution == MAP_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((float *)Array)[y * Map->NX + x] = SoilMap[y][x].InfiltAcc;
-      Write2DMatrix(DMap->FileName, Array, DMap->NumberType, Map, DMap, Index);
-    }
-    else if (DMap->Resolution == IMAGE_OUTPUT) {
-      for (y = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++)
-          ((unsigned char *)Array)[y * Map->NX + x] =
-          (unsigned char)((SoilMap[y][x].InfiltAcc - Offset) / Range * MAXUCHAR);
-      Write2DMatrix(DMap->FileName, Array, NC_BYTE, Map, DMap, Index);
-    }
-    else
-      ReportError(VarIDStr, 66);
-    break;
   }
 }
 
@@ -1129,3 +660,342 @@ void DumpPix(DATE *Current, int first, FILES *OutFile, EVAPPIX *Evap,
     fprintf(OutFile->FilePtr, " %g", Soil->InfiltAcc);
 
 }
+
+/*****************************************************************************
+AddPixVar()
+
+Describe column N of the binary pixel output in Vars, if it is not NULL,
+and return N + 1
+*****************************************************************************/
+static int AddPixVar(PIXVAR *Vars, int N, int Source, size_t Offset,
+  int Field, int Layer, int SoilLayer, int MinVeg, int MinSoil, char *Name,
+  char *Header, char *Format)
+{
+  PIXVAR *Var;
+
+  if (Vars != NULL) {
+    Var = &(Vars[N]);
+    strncpy(Var->Name, Name, sizeof(Var->Name) - 1);
+    Var->Name[sizeof(Var->Name) - 1] = '\0';
+    strncpy(Var->Header, Header, sizeof(Var->Header) - 1);
+    Var->Header[sizeof(Var->Header) - 1] = '\0';
+    strncpy(Var->Format, Format, sizeof(Var->Format) - 1);
+    Var->Format[sizeof(Var->Format) - 1] = '\0';
+    Var->MinVeg = MinVeg;
+    Var->MinSoil = MinSoil;
+    Var->Source = Source;
+    Var->Offset = Offset;
+    Var->Field = Field;
+    Var->Layer = Layer;
+    Var->SoilLayer = SoilLayer;
+  }
+  return N + 1;
+}
+
+/*****************************************************************************
+PixVarList()
+
+The columns of the binary pixel output for MaxVeg vegetation and MaxSoil
+soil layers, in the order, and with the headers and formats, of the text
+output of DumpPix().  Returns the number of columns, which are only
+described if Vars is not NULL
+*****************************************************************************/
+static int PixVarList(int MaxVeg, int MaxSoil, OPTIONSTRUCT *Options,
+  PIXVAR *Vars)
+{
+  char Name[32];
+  char Header[48];
+  int i, j;
+  int N = 0;
+
+#define ADD(S, T, F, Fld, L, SL, MV, MS, Nm, H, Fmt) \
+  N = AddPixVar(Vars, N, S, offsetof(T, F), Fld, L, SL, MV, MS, Nm, H, Fmt)
+
+  ADD(PRECIP_MAP, PRECIPPIX, Precip, FLOAT_FIELD, 0, 0, 0, 0, "Precip",
+    "  Precip(m) ", " %g ");
+  ADD(PRECIP_MAP, PRECIPPIX, SnowFall, FLOAT_FIELD, 0, 0, 0, 0, "SnowFall",
+    " Snow(m) ", " %g ");
+  ADD(SOIL_MAP, SOILPIX, IExcess, FLOAT_FIELD, 0, 0, 0, 0, "IExcess",
+    " IExcess(m) ", " %g ");
+
+  ADD(SNOW_MAP, SNOWPIX, HasSnow, UCHAR_FIELD, 0, 0, 0, 0, "HasSnow",
+    "HasSnow SnowCover LastSnow Swq Melt   ", " %1d");
+  ADD(SNOW_MAP, SNOWPIX, SnowCoverOver, UCHAR_FIELD, 0, 0, 0, 0, "SnowCover",
+    "", " %1d");
+  ADD(SNOW_MAP, SNOWPIX, LastSnow, USHORT_FIELD, 0, 0, 0, 0, "LastSnow", "",
+    " %4d");
+  ADD(SNOW_MAP, SNOWPIX, Swq, FLOAT_FIELD, 0, 0, 0, 0, "Swq", "", " %g");
+  ADD(SNOW_MAP, SNOWPIX, Melt, FLOAT_FIELD, 0, 0, 0, 0, "Melt", "", " %g");
+  ADD(SNOW_MAP, SNOWPIX, PackWater, FLOAT_FIELD, 0, 0, 0, 0, "PackWater",
+    "PackWater TPack ", " %g");
+  ADD(SNOW_MAP, SNOWPIX, TPack, FLOAT_FIELD, 0, 0, 0, 0, "TPack", "", " %g ");
+
+  ADD(EVAP_MAP, EVAPPIX, ETot, FLOAT_FIELD, 0, 0, 0, 0, "TotalET",
+    " TotalET ", " %g");
+  for (i = 0; i < MaxVeg + 1; i++) {
+    sprintf(Name, "PotTransp.Story%d", i);
+    sprintf(Header, " %s ", Name);
+    ADD(EVAP_MAP, EVAPPIX, EPot, VEG_SOIL_FIELD, i, 0, i, 0, Name, Header,
+      " %g");
+  }
+  for (i = 0; i < MaxVeg + 1; i++) {
+    sprintf(Name, "ActTransp.Story%d", i);
+    sprintf(Header, " %s ", Name);
+    ADD(EVAP_MAP, EVAPPIX, EAct, VEG_SOIL_FIELD, i, 0, i, 0, Name, Header,
+      " %g");
+  }
+  for (i = 0; i < MaxVeg; i++) {
+    sprintf(Name, "EvapCanopyInt.Story%d", i);
+    sprintf(Header, "  %s ", Name);
+    ADD(EVAP_MAP, EVAPPIX, EInt, VEG_FIELD, i, 0, i + 1, 0, Name, Header,
+      " %g");
+  }
+  for (i = 0; i < MaxVeg; i++)
+    for (j = 0; j < MaxSoil; j++) {
+      sprintf(Name, "ActTransp.Story%d.Soil%d", i, j);
+      sprintf(Header, " %s ", Name);
+      ADD(EVAP_MAP, EVAPPIX, ESoil, ESOIL_FIELD, i, j, i + 1, j + 1, Name,
+	Header, " %g");
+    }
+  ADD(EVAP_MAP, EVAPPIX, EvapSoil, FLOAT_FIELD, 0, 0, 0, 0, "SoilEvap",
+    " SoilEvap ", " %g");
+
+  for (i = 0; i < MaxVeg; i++) {
+    sprintf(Name, "IntRain.Story%d", i);
+    sprintf(Header, " %s ", Name);
+    ADD(PRECIP_MAP, PRECIPPIX, IntRain, VEG_FIELD, i, 0, i + 1, 0, Name,
+      Header, " %g");
+  }
+  for (i = 0; i < MaxVeg; i++) {
+    sprintf(Name, "IntSnow.Story%d", i);
+    sprintf(Header, " %s ", Name);
+    ADD(PRECIP_MAP, PRECIPPIX, IntSnow, VEG_FIELD, i, 0, i + 1, 0, Name,
+      Header, " %g");
+  }
+
+  for (i = 0; i < MaxSoil; i++) {
+    sprintf(Name, "SoilMoist%d", i + 1);
+    sprintf(Header, " %s ", Name);
+    ADD(SOIL_MAP, SOILPIX, Moist, SOIL_FIELD, i, 0, 0, i + 1, Name, Header,
+      " %g ");
+  }
+  for (i = 0; i < MaxSoil; i++) {
+    sprintf(Name, "Perc%d", i + 1);
+    sprintf(Header, " %s ", Name);
+    ADD(SOIL_MAP, SOILPIX, Perc, SOIL_FIELD, i, 0, 0, i + 1, Name, Header,
+      " %g ");
+  }
+  ADD(SOIL_MAP, SOILPIX, TableDepth, FLOAT_FIELD, 0, 0, 0, 0, "TableDepth",
+    " TableDepth SatFlow DetentionStorage ", " %g");
+  ADD(SOIL_MAP, SOILPIX, SatFlow, FLOAT_FIELD, 0, 0, 0, 0, "SatFlow", "",
+    " %g");
+  ADD(SOIL_MAP, SOILPIX, DetentionStorage, FLOAT_FIELD, 0, 0, 0, 0,
+    "DetentionStorage", "", " %g ");
+
+  for (i = 0; i < MaxVeg; i++) {
+    sprintf(Name, "NetShort.Story%d", i + 1);
+    sprintf(Header, " %s ", Name);
+    ADD(RAD_MAP, PIXRAD, NetShort, ARRAY_FIELD, i, 0, i + 1, 0, Name, Header,
+      " %g ");
+  }
+  ADD(RAD_MAP, PIXRAD, PixelNetShort, FLOAT_FIELD, 0, 0, 0, 0,
+    "PixelNetShort", " PixelNetShort ", " %g ");
+
+  if (Options->HeatFlux)
+    ADD(SOIL_MAP, SOILPIX, TSurf, FLOAT_FIELD, 0, 0, 0, 0, "TSurf",
+      " TSurf ", " %g ");
+
+  ADD(SOIL_MAP, SOILPIX, Qnet, FLOAT_FIELD, 0, 0, 0, 0, "Qnet",
+    " Qnet Qs Qe Qg Qst Ra ", " %g");
+  ADD(SOIL_MAP, SOILPIX, Qs, FLOAT_FIELD, 0, 0, 0, 0, "Qs", "", " %g");
+  ADD(SOIL_MAP, SOILPIX, Qe, FLOAT_FIELD, 0, 0, 0, 0, "Qe", "", " %g");
+  ADD(SOIL_MAP, SOILPIX, Qg, FLOAT_FIELD, 0, 0, 0, 0, "Qg", "", " %g");
+  ADD(SOIL_MAP, SOILPIX, Qst, FLOAT_FIELD, 0, 0, 0, 0, "Qst", "", " %g");
+  ADD(SOIL_MAP, SOILPIX, Ra, FLOAT_FIELD, 0, 0, 0, 0, "Ra", "", " %g ");
+
+  if (Options->Infiltration == DYNAMIC)
+    ADD(SOIL_MAP, SOILPIX, InfiltAcc, FLOAT_FIELD, 0, 0, 0, 0, "InfiltAcc",
+      " InfiltAcc", " %g");
+
+#undef ADD
+  return N;
+}
+
+/*****************************************************************************
+WritePixBinString()
+*****************************************************************************/
+static int WritePixBinString(char *Str, FILE *OutFile)
+{
+  int Len = (int) strlen(Str);
+
+  return (fwrite(&Len, sizeof(int), 1, OutFile) == 1 &&
+	  fwrite(Str, 1, Len, OutFile) == (size_t) Len);
+}
+
+/*****************************************************************************
+DumpPixBin()
+
+Write the values of all the output pixels at this step as one record of
+Pixel.bin (PIXEL OUTPUT FORMAT = BINARY), instead of a line in a text file
+for each pixel.
+
+The file starts with PIXEL_BIN_MAGIC, the number of pixels and the number
+of columns (int).  Each column follows with the vegetation and soil layers
+a pixel needs for it (int), and its name, text header and text format,
+each as its length (int) and characters.  Each pixel follows with its row,
+column, number of vegetation layers and number of soil layers (int) and
+its name.  This header is written at the first step, as the text header
+of DumpPix().
+
+Each step is the date (PrintDate(), PIXEL_BIN_DATELEN characters) and then
+the columns of each pixel (float), (time, pixel, column).  The columns are
+the same for all the pixels, for the largest number of layers, and the
+layers a pixel does not have are NA.  program/pixel_text converts the file
+to the text files of DumpPix().
+*****************************************************************************/
+void DumpPixBin(DATE *Current, DUMPSTRUCT *Dump, EVAPPIX **EvapMap,
+  PRECIPPIX **PrecipMap, PIXRAD **RadMap, SNOWPIX **SnowMap,
+  SOILPIX **SoilMap, VEGPIX **VegMap, LAYER *Soil, LAYER *Veg,
+  OPTIONSTRUCT *Options)
+{
+  char Date[PIXEL_BIN_DATELEN + 1];
+  char *Field;
+  void *Pixel[N_DUMP_MAPS];
+  float *Record;
+  PIXVAR *Var;
+  FILE *OutFile = Dump->PixBin.FilePtr;
+  int NSoil;
+  int NVeg;
+  int Header[4];
+  int i, k;
+  int x, y;
+  int Err = 0;
+
+  /* the header starts the file, and each file of OUTPUT ROLLOVER */
+  if (Dump->NPixVars == 0 || IsRolloverStep(Current)) {
+    if (Dump->NPixVars == 0)
+      InitPixBinVars(Dump, Soil, Veg, Options);
+
+    if (fwrite(PIXEL_BIN_MAGIC, 1, strlen(PIXEL_BIN_MAGIC), OutFile) !=
+      strlen(PIXEL_BIN_MAGIC) ||
+      fwrite(&(Dump->NPix), sizeof(int), 1, OutFile) != 1 ||
+      fwrite(&(Dump->NPixVars), sizeof(int), 1, OutFile) != 1)
+      Err++;
+    for (k = 0; k < Dump->NPixVars; k++) {
+      Var = &(Dump->PixVars[k]);
+      if (fwrite(&(Var->MinVeg), sizeof(int), 1, OutFile) != 1 ||
+	fwrite(&(Var->MinSoil), sizeof(int), 1, OutFile) != 1 ||
+	!WritePixBinString(Var->Name, OutFile) ||
+	!WritePixBinString(Var->Header, OutFile) ||
+	!WritePixBinString(Var->Format, OutFile))
+	Err++;
+    }
+    for (i = 0; i < Dump->NPix; i++) {
+      y = Dump->Pix[i].Loc.N;
+      x = Dump->Pix[i].Loc.E;
+      Header[0] = y;
+      Header[1] = x;
+      Header[2] = Veg->NLayers[(VegMap[y][x].Veg - 1)];
+      Header[3] = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
+      if (fwrite(Header, sizeof(int), 4, OutFile) != 4 ||
+	!WritePixBinString(Dump->Pix[i].Name, OutFile))
+	Err++;
+    }
+  }
+
+  Record = Dump->PixRecord;
+  for (i = 0; i < Dump->NPix; i++) {
+    y = Dump->Pix[i].Loc.N;
+    x = Dump->Pix[i].Loc.E;
+    NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
+    NSoil = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
+    Pixel[EVAP_MAP] = &(EvapMap[y][x]);
+    Pixel[PRECIP_MAP] = &(PrecipMap[y][x]);
+    Pixel[RAD_MAP] = &(RadMap[y][x]);
+    Pixel[SNOW_MAP] = &(SnowMap[y][x]);
+    Pixel[SOIL_MAP] = &(SoilMap[y][x]);
+
+    for (k = 0; k < Dump->NPixVars; k++, Record++) {
+      Var = &(Dump->PixVars[k]);
+      if (NVeg < Var->MinVeg || NSoil < Var->MinSoil) {
+	*Record = NA;
+	continue;
+      }
+      Field = (char *) Pixel[Var->Source] + Var->Offset;
+      switch (Var->Field) {
+      case FLOAT_FIELD:
+	*Record = *(float *) Field;
+	break;
+      case UCHAR_FIELD:
+	*Record = *(uchar *) Field;
+	break;
+      case USHORT_FIELD:
+	*Record = *(unshort *) Field;
+	break;
+      case ARRAY_FIELD:
+	*Record = ((float *) Field)[Var->Layer];
+	break;
+      case ESOIL_FIELD:
+	*Record = (*(float ***) Field)[Var->Layer][Var->SoilLayer];
+	break;
+      default:
+	*Record = (*(float **) Field)[Var->Layer];
+	break;
+      }
+    }
+  }
+
+  memset(Date, 0, sizeof(Date));
+  snprintf(Date, sizeof(Date), "%02d/%02d/%4d-%02d:%02d:%02d", Current->Month,
+    Current->Day, Current->Year, Current->Hour, Current->Min, Current->Sec);
+  if (fwrite(Date, 1, PIXEL_BIN_DATELEN, OutFile) != PIXEL_BIN_DATELEN ||
+    fwrite(Dump->PixRecord, sizeof(float), (size_t) Dump->NPix *
+      Dump->NPixVars, OutFile) != (size_t) Dump->NPix * Dump->NPixVars)
+    Err++;
+  if (Err)
+    ReportError(Dump->PixBin.FileName, 72);
+}
+
+/*****************************************************************************
+InitPixBinVars()
+
+Set up the columns of Pixel.bin and the record of a step.  Called by
+DumpPixBin() before it writes the header, and when a run is resumed with
+the header already in the file.
+*****************************************************************************/
+void InitPixBinVars(DUMPSTRUCT *Dump, LAYER *Soil, LAYER *Veg,
+		    OPTIONSTRUCT *Options)
+{
+  const char *Routine = "InitPixBinVars";
+
+  Dump->NPixVars = PixVarList(Veg->MaxLayers, Soil->MaxLayers, Options,
+    NULL);
+  if (!(Dump->PixVars = (PIXVAR *) TaggedCalloc(Dump->NPixVars,
+    sizeof(PIXVAR), MEM_OUTPUT)) ||
+    !(Dump->PixRecord = (float *) TaggedCalloc((size_t) Dump->NPix *
+    Dump->NPixVars, sizeof(float), MEM_OUTPUT)))
+    ReportError((char *) Routine, 1);
+  PixVarList(Veg->MaxLayers, Soil->MaxLayers, Options, Dump->PixVars);
+}
+
+/*****************************************************************************
+  DumpSatExtent()
+
+  Write the basin saturation extent (percentage of basin pixels with a water
+  table that is at least MTHRESH of soil depth) for the current time step.
+  The extent is calculated in Aggregate().  The file is kept open for the
+  entire run and flushed every Dump->SatFlushInterval time steps.
+*****************************************************************************/
+void DumpSatExtent(DATE *Current, DUMPSTRUCT *Dump, AGGREGATED *Total)
+{
+  char buffer[32];		/* formatted date */
+
+  SPrintDate(Current, buffer);
+  fprintf(Dump->Saturation.FilePtr, "%-20s %.4f \n", buffer, Total->SatExtent);
+
+  if (Dump->SatFlushInterval > 0 &&
+      ++(Dump->SatFlushCount) >= Dump->SatFlushInterval) {
+    fflush(Dump->Saturation.FilePtr);
+    Dump->SatFlushCount = 0;
+  }
+}
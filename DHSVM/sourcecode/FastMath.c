@@ -0,0 +1,199 @@
+/*
+ * SUMMARY:      FastMath.c - Accuracy of exp, log and pow
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The physics routines that call exp(), log() and pow() for
+ *               each cell and time step call MathExp(), MathLog() and
+ *               MathPow() of fastmath.h instead, with the accuracy of the
+ *               OPTIONS MATH ACCURACY of the run:
+ *
+ *                 EXACT  libm in double precision, the results of the
+ *                        model before (default)
+ *                 FLOAT  libm in single precision, expf(), logf() and
+ *                        powf(), within 1 ulp of the float result
+ *                 FAST   FLOAT, and in the lane loops of the kernels the
+ *                        inline polynomials PolyExp(), PolyLog() and
+ *                        PolyPow() of fastmath.h, which have no calls and
+ *                        no branches, so that the loops are vectorized
+ *
+ *               The data of the model are floats, so FLOAT and FAST only
+ *               change the results by the rounding of a float.  The
+ *               changes are checked against the golden output of the
+ *               regression test with regress_math.tol, see
+ *               dhsvm_regress.sh.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitMathAccuracy()
+ *               MathAccuracyName()
+ * COMMENTS:     PolyExp() is within 1 ulp of exp() between -87.3 and 88.4,
+ *               and 0 below, PolyLog() within 1 ulp of log() for the
+ *               normal floats, the test program below measures them.  In
+ *               PolyPow() the error of log(x) is multiplied by y, it is
+ *               within about 3 + |y log(x)| / 8 ulp.  The exponents of the
+ *               model are small: the Brooks-Corey exponent is about 10 and
+ *               the pressure exponent about 5.
+ *
+ *               A single call of PolyExp() is not faster than expf(), the
+ *               polynomials pay off in the vectorized loops only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "fastmath.h"
+
+int MathAccuracy = MATH_EXACT;
+
+static const char *AccuracyName[] = { "EXACT", "FLOAT", "FAST" };
+
+/*****************************************************************************
+  InitMathAccuracy()
+
+  Sets the accuracy of MathExp(), MathLog() and MathPow(), before the
+  model is initialized
+*****************************************************************************/
+void InitMathAccuracy(int Accuracy)
+{
+  MathAccuracy = Accuracy;
+  if (Accuracy != MATH_EXACT)
+    printf("exp, log and pow of the physics routines: %s\n",
+	   MathAccuracyName(Accuracy));
+}
+
+/*****************************************************************************
+  MathAccuracyName()
+*****************************************************************************/
+const char *MathAccuracyName(int Accuracy)
+{
+  if (Accuracy < MATH_EXACT || Accuracy > MATH_FAST)
+    return "UNKNOWN";
+  return AccuracyName[Accuracy];
+}
+
+/*****************************************************************************
+  Test program.  Reports the largest error in ulp of the float functions
+  of libm (FLOAT) and of the polynomials (FAST) with respect to libm in
+  double precision, over the ranges of the arguments in the model, and the
+  time per call.  To build:
+
+  gcc -O2 -fno-trapping-math -Wall -o test_fastmath -DTEST_FASTMATH
+  FastMath.c -lm
+
+  Without -fno-trapping-math, as in the kernel files, GCC does not
+  vectorize the loop of PolyExp().
+*****************************************************************************/
+#ifdef TEST_FASTMATH
+#include <float.h>
+#include <time.h>
+
+#define NPOINTS 2000000
+
+/* error of Value in ulp of the float nearest to Exact, a subnormal result
+   that is flushed to zero counts as exact */
+static double Ulp(double Value, double Exact)
+{
+  int e;
+
+  if (Value == 0.0 && fabs(Exact) < FLT_MIN)
+    return 0.0;
+  frexp(Exact, &e);
+  return fabs(Value - Exact) / ldexp(1.0, (e - 24 < -149) ? -149 : e - 24);
+}
+
+static double Exp64(double x, double y) { return exp(x); }
+static double Log64(double x, double y) { return log(x); }
+static double Pow64(double x, double y) { return pow(x, y); }
+static double ExpAt(double x, double y)
+{
+  return (MathAccuracy == MATH_FAST) ? PolyExp(x) : MathExp(x);
+}
+
+static double LogAt(double x, double y)
+{
+  return (MathAccuracy == MATH_FAST) ? PolyLog(x) : MathLog(x);
+}
+
+static double PowAt(double x, double y)
+{
+  return (MathAccuracy == MATH_FAST) ? PolyPow(x, y) : MathPow(x, y);
+}
+
+static void Measure(const char *Name, double (*Exact) (double, double),
+		    double (*Func) (double, double), double Low, double High,
+		    double y)
+{
+  double MaxUlp;
+  double Sum;
+  double Err;
+  float x;
+  clock_t Start;
+  int Level;
+  int i;
+
+  for (Level = MATH_FLOAT; Level <= MATH_FAST; Level++) {
+    MathAccuracy = Level;
+    MaxUlp = 0.0;
+    for (i = 0; i <= NPOINTS; i++) {
+      x = Low + (High - Low) * i / NPOINTS;
+      Err = Ulp((float) Func(x, y), Exact(x, y));
+      if (Err > MaxUlp)
+	MaxUlp = Err;
+    }
+    Sum = 0.0;
+    Start = clock();
+    for (i = 0; i <= NPOINTS; i++)
+      Sum += Func(Low + (High - Low) * i / NPOINTS, y);
+    printf("%-16s %-6s max %5.2f ulp  %6.2f ns/call (%g)\n", Name,
+	   MathAccuracyName(Level), MaxUlp,
+	   1e9 * (clock() - Start) / CLOCKS_PER_SEC / NPOINTS, Sum);
+  }
+}
+
+/* time per value of a loop over an array of 1024 values, the loops of the
+   polynomials are vectorized */
+#define VECTORLOOP(Label, Statement)					\
+  Sum = 0.0;								\
+  Start = clock();							\
+  for (n = 0; n < NPOINTS / 1024; n++) {				\
+    for (i = 0; i < 1024; i++)						\
+      Statement;							\
+    Sum += y[n % 1024];							\
+  }									\
+  printf("%-16s %-6s           %6.2f ns/value (%g)\n", Label, "",	\
+	 1e9 * (clock() - Start) / CLOCKS_PER_SEC / (NPOINTS / 1024 * 1024.),\
+	 Sum)
+
+static void Vector(void)
+{
+  static float x[1024];
+  static float y[1024];
+  double Sum;
+  clock_t Start;
+  int n;
+  int i;
+
+  for (i = 0; i < 1024; i++)
+    x[i] = -10.0 + 20.0 * i / 1024;
+  VECTORLOOP("expf() loop", y[i] = expf(x[i]));
+  VECTORLOOP("PolyExp() loop", y[i] = PolyExp(x[i]));
+  for (i = 0; i < 1024; i++)
+    x[i] = (float) i / 1024;
+  VECTORLOOP("powf() loop", y[i] = powf(x[i], 9.7f));
+  VECTORLOOP("PolyPow() loop", y[i] = PolyPow(x[i], 9.7f));
+}
+
+int main(int argc, char **argv)
+{
+  Measure("exp [-87, 88]", Exp64, ExpAt, -87.0, 88.0, 0.0);
+  Measure("exp [-10, 10]", Exp64, ExpAt, -10.0, 10.0, 0.0);
+  Measure("log (0, 1]", Log64, LogAt, 1e-30, 1.0, 0.0);
+  Measure("log [1, 1e6]", Log64, LogAt, 1.0, 1e6, 0.0);
+  Measure("pow [0, 1]^10", Pow64, PowAt, 0.0, 1.0, 10.0);
+  Measure("pow [0.7, 1]^5.3", Pow64, PowAt, 0.7, 1.0, 5.256);
+  Measure("pow [0, 200]^.18", Pow64, PowAt, 0.0, 200.0, 0.182);
+  Vector();
+  return EXIT_SUCCESS;
+}
+#endif
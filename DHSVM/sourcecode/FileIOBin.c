@@ -11,12 +11,22 @@
  * FUNCTIONS:    CreateMapFileBin()
  *               Read2DMatrixBin()
  *               Read2DMatrixByteSwapBin()
+ *               Read3DMatrixBin()
+ *               Read3DMatrixByteSwapBin()
+ *               Read2DWindowBin()
+ *               Read2DWindowByteSwapBin()
  *               Write2DMatrixBin()
  *		 Write2DMatrixByteSwapBin()
+ *               CloseFilesBin()
+ *               MapBinFile()
  *               SizeOfNumberType()
  *               byte_swap_long()
  *               byte_swap_short()
- * COMMENTS:
+ * COMMENTS:     If HAVE_MMAP is defined during the build, the read functions
+ *               map the input file into memory and copy from the mapping.
+ *               The last mapped file stays mapped, so reading further
+ *               datasets or windows from the same file (radar files, shadow
+ *               maps) does not open, seek and read the file again
  * $Id: FileIOBin.c,v 1.4 2003/07/01 21:26:14 olivier Exp $     
  */
 
@@ -24,12 +34,29 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "fifobin.h"
 #include "fileio.h"
 #include "sizeofnt.h"
 #include "settings.h"
 #include "DHSVMerror.h"
 
+#ifdef HAVE_MMAP
+static const char *MapBinFile(char *FileName, size_t *Size);
+
+/* the input file that is currently mapped */
+static char MappedName[BUFSIZE + 1] = "";
+static char *MappedData = NULL;
+static size_t MappedSize = 0;
+static time_t MappedTime = 0;
+static ino_t MappedInode = 0;
+#endif
+
 /*****************************************************************************
   Function name: CreateMapFileBin()
 
@@ -82,11 +109,24 @@ int Read2DMatrixBin(char *FileName, void *Matrix, int NumberType, int NY,
   size_t ElemSize;
   unsigned long OffSet;		/* number of bytes to OffSet (is non-zero when
 				   reading matrices other than the first one in the file */
+#ifdef HAVE_MMAP
+  const char *Data;
+  size_t Size;
+#endif
 
-  OpenFile(&InFile, FileName, "rb", FALSE);
   ElemSize = SizeOfNumberType(NumberType);
-  OffSet = NY * NX * ElemSize * NDataSet;
+  OffSet = (unsigned long) NY * NX * ElemSize * NDataSet;
+
+#ifdef HAVE_MMAP
+  if ((Data = MapBinFile(FileName, &Size)) != NULL) {
+    if (OffSet + (size_t) NY * NX * ElemSize > Size)
+      ReportError(FileName, 2);
+    memcpy(Matrix, Data + OffSet, (size_t) NY * NX * ElemSize);
+    return NY * NX;
+  }
+#endif
 
+  OpenFile(&InFile, FileName, "rb", FALSE);
   if (fseek(InFile, OffSet, SEEK_SET))
     ReportError(FileName, 39);
   NElements = fread(Matrix, ElemSize, NY * NX, InFile);
@@ -101,29 +141,192 @@ int Read2DMatrixBin(char *FileName, void *Matrix, int NumberType, int NY,
 /******************************************************************************/
 int Read2DMatrixByteSwapBin(char *FileName, void *Matrix, int NumberType,
 			    int NY, int NX, int NDataSet, ...)
+{
+  int NElements;
+  size_t ElemSize;
+
+  NElements = Read2DMatrixBin(FileName, Matrix, NumberType, NY, NX, NDataSet);
+
+  ElemSize = SizeOfNumberType(NumberType);
+  if (ElemSize == 4) {
+    byte_swap_long(Matrix, NElements);
+  }
+  else if (ElemSize == 2) {
+    byte_swap_short(Matrix, NElements);
+  }
+  else if (ElemSize != 1) {
+    ReportError(FileName, 61);
+  }
+
+  return NElements;
+}
+
+/*****************************************************************************
+  Function name: Read3DMatrixBin()
+
+  Purpose      : Function to read NLayers consecutive 2D arrays from a file
+                 in a single read.
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of contiguous array [NLayers][NY][NX] to read into
+    NumberType - code for number type
+    NY         - Number of rows
+    NX         - Number of columns
+    NDataSet   - number of the first dataset to read
+    NLayers    - number of consecutive datasets to read
+    Any remaining arguments are not used in straight binary
+
+  Returns      : Number of elements read
+
+  Modifies     : Matrix
+
+  Comments     :
+*****************************************************************************/
+int Read3DMatrixBin(char *FileName, void *Matrix, int NumberType, int NY,
+		    int NX, int NDataSet, int NLayers, ...)
 {
   FILE *InFile;
   int NElements = 0;		/* number of elements read */
   size_t ElemSize;
-  unsigned long OffSet;		/* number of bytes to OffSet (is non-zero when
-				   reading matrices other than the first one
-				   in the file */
+  unsigned long OffSet;
+#ifdef HAVE_MMAP
+  const char *Data;
+  size_t Size;
+#endif
+
+  ElemSize = SizeOfNumberType(NumberType);
+  OffSet = (unsigned long) NY * NX * ElemSize * NDataSet;
+
+#ifdef HAVE_MMAP
+  if ((Data = MapBinFile(FileName, &Size)) != NULL) {
+    if (OffSet + (size_t) NY * NX * NLayers * ElemSize > Size)
+      ReportError(FileName, 2);
+    memcpy(Matrix, Data + OffSet, (size_t) NY * NX * NLayers * ElemSize);
+    return NY * NX * NLayers;
+  }
+#endif
 
   OpenFile(&InFile, FileName, "rb", FALSE);
+  if (fseek(InFile, OffSet, SEEK_SET))
+    ReportError(FileName, 39);
+  NElements = fread(Matrix, ElemSize, NY * NX * NLayers, InFile);
+  if (NElements != NY * NX * NLayers)
+    ReportError(FileName, 2);
+
+  fclose(InFile);
+
+  return NElements;
+}
+
+/******************************************************************************/
+int Read3DMatrixByteSwapBin(char *FileName, void *Matrix, int NumberType,
+			    int NY, int NX, int NDataSet, int NLayers, ...)
+{
+  int NElements;
+  size_t ElemSize;
+
+  NElements = Read3DMatrixBin(FileName, Matrix, NumberType, NY, NX, NDataSet,
+			      NLayers);
 
   ElemSize = SizeOfNumberType(NumberType);
+  if (ElemSize == 4) {
+    byte_swap_long(Matrix, NElements);
+  }
+  else if (ElemSize == 2) {
+    byte_swap_short(Matrix, NElements);
+  }
+  else if (ElemSize != 1) {
+    ReportError(FileName, 61);
+  }
 
-  OffSet = NY * NX * ElemSize * NDataSet;
+  return NElements;
+}
 
-  if (fseek(InFile, OffSet, SEEK_SET)) {
-    ReportError(FileName, 39);
+/*****************************************************************************
+  Function name: Read2DWindowBin()
+
+  Purpose      : Function to read a rectangular window of a 2D array from a
+                 file, without reading the rest of the array.
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of array [WinNY][WinNX] to read into
+    NumberType - code for number type
+    NY         - Number of rows of the array in the file
+    NX         - Number of columns of the array in the file
+    NDataSet   - number of the dataset to read
+    WinY       - first row of the window
+    WinX       - first column of the window
+    WinNY      - Number of rows in the window
+    WinNX      - Number of columns in the window
+    Any remaining arguments are not used in straight binary
+
+  Returns      : Number of elements read
+
+  Modifies     : Matrix
+
+  Comments     : One seek and read per row of the window
+*****************************************************************************/
+int Read2DWindowBin(char *FileName, void *Matrix, int NumberType, int NY,
+		    int NX, int NDataSet, int WinY, int WinX, int WinNY,
+		    int WinNX, ...)
+{
+  FILE *InFile;
+  int NElements = 0;		/* number of elements read */
+  int y;			/* counter */
+  size_t ElemSize;
+  unsigned long OffSet;
+#ifdef HAVE_MMAP
+  const char *Data;
+  size_t Size;
+#endif
+
+  ElemSize = SizeOfNumberType(NumberType);
+
+#ifdef HAVE_MMAP
+  if ((Data = MapBinFile(FileName, &Size)) != NULL) {
+    for (y = 0; y < WinNY; y++) {
+      OffSet = (((unsigned long) NY * NDataSet + WinY + y) * NX + WinX) *
+	ElemSize;
+      if (OffSet + (size_t) WinNX * ElemSize > Size)
+	ReportError(FileName, 2);
+      memcpy((char *) Matrix + (size_t) y * WinNX * ElemSize, Data + OffSet,
+	     (size_t) WinNX * ElemSize);
+    }
+    return WinNY * WinNX;
   }
-  NElements = fread(Matrix, ElemSize, NY * NX, InFile);
-  if (NElements != NY * NX) {
-    ReportError(FileName, 2);
+#endif
+
+  OpenFile(&InFile, FileName, "rb", FALSE);
+  for (y = 0; y < WinNY; y++) {
+    OffSet = (((unsigned long) NY * NDataSet + WinY + y) * NX + WinX) *
+      ElemSize;
+    if (fseek(InFile, OffSet, SEEK_SET))
+      ReportError(FileName, 39);
+    if (fread((char *) Matrix + (size_t) y * WinNX * ElemSize, ElemSize, 
+	      WinNX, InFile) != (size_t) WinNX)
+      ReportError(FileName, 2);
+    NElements += WinNX;
   }
+
   fclose(InFile);
 
+  return NElements;
+}
+
+/******************************************************************************/
+int Read2DWindowByteSwapBin(char *FileName, void *Matrix, int NumberType,
+			    int NY, int NX, int NDataSet, int WinY, int WinX,
+			    int WinNY, int WinNX, ...)
+{
+  int NElements;
+  size_t ElemSize;
+
+  NElements = Read2DWindowBin(FileName, Matrix, NumberType, NY, NX, NDataSet,
+			      WinY, WinX, WinNY, WinNX);
+
+  ElemSize = SizeOfNumberType(NumberType);
   if (ElemSize == 4) {
     byte_swap_long(Matrix, NElements);
   }
@@ -205,27 +408,101 @@ int Write2DMatrixByteSwapBin(char *FileName, void *Matrix, int NumberType,
   return NY * NX;
 }
 
-/******************************************************************************/
-void byte_swap_short(short *buffer, int number_of_swaps)
+/*****************************************************************************
+  Function name: CloseFilesBin()
+
+  Purpose      : Release the mapped input file
+*****************************************************************************/
+void CloseFilesBin(void)
 {
-  short *temp;
-  int swap_loop;
+#ifdef HAVE_MMAP
+  if (MappedData != NULL)
+    munmap(MappedData, MappedSize);
+  MappedData = NULL;
+  MappedSize = 0;
+  strcpy(MappedName, "");
+#endif
+}
 
-  for (swap_loop = 0, temp = buffer; swap_loop < number_of_swaps;
-       swap_loop++, temp++) {
-    *temp = ((*temp & 0x00ff) << 8) | ((*temp & 0xff00) >> 8);
+#ifdef HAVE_MMAP
+/*****************************************************************************
+  Function name: MapBinFile()
+
+  Purpose      : Map an input file into memory
+
+  Returns      : Start of the mapping and its size in Size, or NULL if the
+                 file cannot be mapped, in which case the caller reads it
+
+  Comments     : The mapping of the previous file is reused if the name,
+                 inode, size and modification time still match, otherwise
+                 it is released
+*****************************************************************************/
+static const char *MapBinFile(char *FileName, size_t *Size)
+{
+  struct stat FileInfo;
+  void *Data;
+  int fd;
+
+  if (stat(FileName, &FileInfo) != 0)
+    ReportError(FileName, 3);
+
+  if (MappedData != NULL && strcmp(FileName, MappedName) == 0 &&
+      FileInfo.st_ino == MappedInode && FileInfo.st_mtime == MappedTime &&
+      (size_t) FileInfo.st_size == MappedSize) {
+    *Size = MappedSize;
+    return MappedData;
   }
+
+  CloseFilesBin();
+  if (FileInfo.st_size == 0 || strlen(FileName) > BUFSIZE ||
+      (fd = open(FileName, O_RDONLY)) < 0)
+    return NULL;
+  Data = mmap(NULL, (size_t) FileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (Data == MAP_FAILED)
+    return NULL;
+
+  MappedData = (char *) Data;
+  MappedSize = (size_t) FileInfo.st_size;
+  MappedTime = FileInfo.st_mtime;
+  MappedInode = FileInfo.st_ino;
+  strcpy(MappedName, FileName);
+
+  *Size = MappedSize;
+  return MappedData;
 }
+#endif
 
-/******************************************************************************/
-void byte_swap_long(long *buffer, int number_of_swaps)
+/*****************************************************************************
+  Function name: byte_swap_short(), byte_swap_long()
+
+  Purpose      : Swap the byte order of 2 and 4 byte numbers in place
+
+  Comments     : Each element is swapped independently in a plain loop that
+                 the compiler turns into bswap/rol instructions, or a byte
+                 shuffle (pshufb) when vector instructions are enabled.  A
+                 "long" here is a 4 byte number as in the file formats, not
+                 the C long, which has 8 bytes on 64-bit Unix
+*****************************************************************************/
+void byte_swap_short(void *buffer, int number_of_swaps)
 {
-  long *temp;
-  int swap_loop;
+  unshort *temp = (unshort *) buffer;
+  int i;
 
-  for (swap_loop = 0, temp = buffer; swap_loop < number_of_swaps;
-       swap_loop++, temp++) {
-    *temp = ((*temp & 0x000000ff) << 24) | ((*temp & 0x0000ff00) << 8) |
-      ((*temp & 0x00ff0000) >> 8) | ((*temp & 0xff000000) >> 24);
+  for (i = 0; i < number_of_swaps; i++)
+    temp[i] = (unshort) ((temp[i] << 8) | (temp[i] >> 8));
+}
+
+/******************************************************************************/
+void byte_swap_long(void *buffer, int number_of_swaps)
+{
+  unint *temp = (unint *) buffer;
+  unint v;
+  int i;
+
+  for (i = 0; i < number_of_swaps; i++) {
+    v = temp[i];
+    temp[i] = (v << 24) | ((v & 0x0000ff00) << 8) | ((v >> 8) & 0x0000ff00) |
+      (v >> 24);
   }
 }
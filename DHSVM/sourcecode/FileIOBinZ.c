@@ -0,0 +1,588 @@
+/*
+ * SUMMARY:      FileIOBinZ.c - Functions for compressed binary IO
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  FILE FORMAT BINZ.  Each Write2DMatrix() call stores its
+ *               matrix as one block of zlib streams, and a footer with an
+ *               index of the blocks at the end of the file gives the offset
+ *               of any dataset, so that Read2DMatrix() with NDataSet reads
+ *               and expands one block only.  The numbers are in the byte
+ *               order of the machine, as in FILE FORMAT BIN.
+ * DESCRIP-END.
+ * FUNCTIONS:    CreateMapFileBinZ()
+ *               Read2DMatrixBinZ()
+ *               Read3DMatrixBinZ()
+ *               Read2DWindowBinZ()
+ *               Write2DMatrixBinZ()
+ *               CloseFilesBinZ()
+ *               DataSetSizeBinZ()
+ *               ReadTrailer()
+ *               FindDataSet()
+ *               ExpandDataSet()
+ * COMMENTS:     Layout of a file:
+ *
+ *                 block 0, block 1, ...    with index pages in between
+ *                 directory                offsets of the full index pages
+ *                 entries                  index of the last datasets
+ *                 trailer                  fixed size, last in the file
+ *
+ *               A block is the table of the compressed sizes of its chunks,
+ *               followed by the chunks.  A chunk holds BINZ_CHUNK bytes of
+ *               the matrix, and the chunks of a block are compressed and
+ *               expanded by the OpenMP threads.  Each write appends its
+ *               block and a new footer, and the old footer stays behind as
+ *               unused bytes.  The file is thus only appended to, so that a
+ *               file cut at its length of a checkpoint (ResumeFile()) is
+ *               the file of that time.  Once BINZ_PAGE entries have
+ *               accumulated they are written as an index page and only the
+ *               offset of the page is carried in the later footers, which
+ *               keeps a footer below a few kilobytes for long runs.
+ *
+ *               Files without the trailer are read as FILE FORMAT BIN, so
+ *               the input maps of a basin do not have to be converted.
+ *               HAVE_ZLIB has to be defined during the build.
+ */
+
+#ifdef HAVE_ZLIB
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <zlib.h>
+#include "fifobin.h"
+#include "fifobinz.h"
+#include "fileio.h"
+#include "sizeofnt.h"
+#include "settings.h"
+#include "DHSVMerror.h"
+#include "memaccount.h"
+
+#define BINZ_MAGIC "DHSVMBZ1"	/* first bytes of the trailer */
+#define BINZ_CHUNK (1 << 20)	/* bytes of a matrix in one zlib stream */
+#define BINZ_PAGE  128		/* entries of an index page */
+#define BINZ_LEVEL Z_BEST_SPEED	/* zlib compression level */
+
+/* last bytes of a file */
+typedef struct {
+  char Magic[8];
+  uint64_t NDataSets;		/* datasets in the file */
+  uint64_t FooterOffset;	/* offset of the directory */
+  uint32_t ChunkSize;		/* bytes of a matrix in one chunk */
+  uint32_t NPages;		/* full index pages in the directory */
+} BINZTRAILER;
+
+/* index entry of a dataset */
+typedef struct {
+  uint64_t Offset;		/* offset of the block */
+  uint64_t Size;		/* bytes of the block */
+  uint64_t RawSize;		/* bytes of the matrix */
+  uint32_t NChunks;		/* chunks of the block */
+  uint32_t NumberType;		/* NumberType of the matrix */
+} BINZENTRY;
+
+static int ReadTrailer(FILE *InFile, char *FileName, BINZTRAILER *Trailer);
+static void FindDataSet(FILE *InFile, char *FileName, BINZTRAILER *Trailer,
+			int NDataSet, BINZENTRY *Entry);
+static void ExpandDataSet(FILE *InFile, char *FileName, BINZTRAILER *Trailer,
+			  int NDataSet, void *Matrix, size_t RawSize);
+
+/* compressed blocks of the writes, and of the reads, which the writer
+   thread and the main thread do not share */
+static unsigned char *WriteBuffer = NULL;
+static size_t WriteSize = 0;
+static unsigned char *ReadBuffer = NULL;
+static size_t ReadSize = 0;
+static unsigned char *WindowBuffer = NULL;
+static size_t WindowSize = 0;
+
+/*****************************************************************************
+  Function name: CreateMapFileBinZ()
+
+  Purpose      : Open and close a new file.  If the file already exists it
+                 will be overwritten.
+
+  Comments     : An empty file is a file without datasets
+*****************************************************************************/
+void CreateMapFileBinZ(char *FileName, ...)
+{
+  FILE *NewFile;
+
+  OpenFile(&NewFile, FileName, "w", TRUE);
+  fclose(NewFile);
+}
+
+/*****************************************************************************
+  Function name: Read2DMatrixBinZ()
+
+  Purpose      : Function to read a 2D array from a file.
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of array data into
+    NumberType - code for number type
+    NY         - Number of rows
+    NX         - Number of columns
+    NDataSet   - number of the dataset to read, i.e. the first matrix in a
+                 file is number 0, etc.
+    Any remaining arguments are not used
+
+  Returns      : Number of elements read
+
+  Modifies     : Matrix
+
+  Comments     : A file without the trailer is read with Read2DMatrixBin()
+*****************************************************************************/
+int Read2DMatrixBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, ...)
+{
+  FILE *InFile;
+  BINZTRAILER Trailer;
+
+  OpenFile(&InFile, FileName, "rb", FALSE);
+  if (!ReadTrailer(InFile, FileName, &Trailer)) {
+    fclose(InFile);
+    return Read2DMatrixBin(FileName, Matrix, NumberType, NY, NX, NDataSet);
+  }
+
+  ExpandDataSet(InFile, FileName, &Trailer, NDataSet, Matrix,
+		(size_t) NY * NX * SizeOfNumberType(NumberType));
+  fclose(InFile);
+
+  return NY * NX;
+}
+
+/*****************************************************************************
+  Function name: Read3DMatrixBinZ()
+
+  Purpose      : Function to read NLayers consecutive 2D arrays from a file
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of contiguous array [NLayers][NY][NX] to read into
+    NumberType - code for number type
+    NY         - Number of rows
+    NX         - Number of columns
+    NDataSet   - number of the first dataset to read
+    NLayers    - number of consecutive datasets to read
+    Any remaining arguments are not used
+
+  Returns      : Number of elements read
+
+  Modifies     : Matrix
+
+  Comments     : The file is opened and its trailer read once for all the
+                 layers
+*****************************************************************************/
+int Read3DMatrixBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, int NLayers, ...)
+{
+  FILE *InFile;
+  BINZTRAILER Trailer;
+  size_t RawSize;
+  int i;
+
+  OpenFile(&InFile, FileName, "rb", FALSE);
+  if (!ReadTrailer(InFile, FileName, &Trailer)) {
+    fclose(InFile);
+    return Read3DMatrixBin(FileName, Matrix, NumberType, NY, NX, NDataSet,
+			   NLayers);
+  }
+
+  RawSize = (size_t) NY * NX * SizeOfNumberType(NumberType);
+  for (i = 0; i < NLayers; i++)
+    ExpandDataSet(InFile, FileName, &Trailer, NDataSet + i,
+		  (char *) Matrix + i * RawSize, RawSize);
+  fclose(InFile);
+
+  return NY * NX * NLayers;
+}
+
+/*****************************************************************************
+  Function name: Read2DWindowBinZ()
+
+  Purpose      : Function to read a rectangular window of a 2D array from a
+                 file
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of array [WinNY][WinNX] to read into
+    NumberType - code for number type
+    NY         - Number of rows of the array in the file
+    NX         - Number of columns of the array in the file
+    NDataSet   - number of the dataset to read
+    WinY       - first row of the window
+    WinX       - first column of the window
+    WinNY      - Number of rows in the window
+    WinNX      - Number of columns in the window
+    Any remaining arguments are not used
+
+  Returns      : Number of elements read
+
+  Modifies     : Matrix
+
+  Comments     : The whole dataset is expanded, and the window copied out of
+                 it
+*****************************************************************************/
+int Read2DWindowBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, int WinY, int WinX, int WinNY,
+		     int WinNX, ...)
+{
+  const char *Routine = "Read2DWindowBinZ";
+  FILE *InFile;
+  BINZTRAILER Trailer;
+  size_t ElemSize;
+  size_t RawSize;
+  int y;
+
+  OpenFile(&InFile, FileName, "rb", FALSE);
+  if (!ReadTrailer(InFile, FileName, &Trailer)) {
+    fclose(InFile);
+    return Read2DWindowBin(FileName, Matrix, NumberType, NY, NX, NDataSet,
+			   WinY, WinX, WinNY, WinNX);
+  }
+
+  ElemSize = SizeOfNumberType(NumberType);
+  RawSize = (size_t) NY * NX * ElemSize;
+  if (RawSize > WindowSize) {
+    TaggedFree(WindowBuffer);
+    if (!(WindowBuffer = (unsigned char *) TaggedMalloc(RawSize, MEM_OUTPUT)))
+      ReportError((char *) Routine, 1);
+    WindowSize = RawSize;
+  }
+  ExpandDataSet(InFile, FileName, &Trailer, NDataSet, WindowBuffer, RawSize);
+  fclose(InFile);
+
+  for (y = 0; y < WinNY; y++)
+    memcpy((char *) Matrix + (size_t) y * WinNX * ElemSize,
+	   WindowBuffer + ((size_t) (WinY + y) * NX + WinX) * ElemSize,
+	   (size_t) WinNX * ElemSize);
+
+  return WinNY * WinNX;
+}
+
+/*****************************************************************************
+  Function name: Write2DMatrixBinZ()
+
+  Purpose      : Function to write a 2D array to a file.  Data is appended to
+                 the end of the file.
+
+  Required     :
+    FileName   - name of output file
+    Matrix     - address of array containing matrix elements
+    NumberType - code for number type
+    NY         - Number of rows
+    NX         - Number of columns
+
+  Returns      : Number of elements written
+
+  Modifies     :
+
+  Comments     : The chunks are compressed into WriteBuffer at fixed
+                 offsets, one compressBound() apart, and written after each
+                 other.  The footer of the file is read back for the index of
+                 the earlier datasets.
+*****************************************************************************/
+int Write2DMatrixBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		      int NX, ...)
+{
+  const char *Routine = "Write2DMatrixBinZ";
+  FILE *OutFile;
+  BINZTRAILER Trailer;
+  BINZENTRY Entries[BINZ_PAGE];
+  uint64_t *Directory = NULL;
+  uint32_t *ChunkSizes;
+  unsigned char *Chunks;
+  size_t RawSize;
+  size_t Bound;
+  size_t Needed;
+  uint64_t End;
+  long Length;
+  int NChunks;
+  int NEntries;
+  int Failed = FALSE;
+  int i;
+
+  OpenFile(&OutFile, FileName, "a+b", FALSE);
+  if (fseek(OutFile, 0L, SEEK_END) || (Length = ftell(OutFile)) < 0)
+    ReportError(FileName, 39);
+
+  /* the index of the earlier datasets */
+  if (Length == 0) {
+    memcpy(Trailer.Magic, BINZ_MAGIC, sizeof(Trailer.Magic));
+    Trailer.NDataSets = 0;
+    Trailer.FooterOffset = 0;
+    Trailer.ChunkSize = BINZ_CHUNK;
+    Trailer.NPages = 0;
+  }
+  else if (!ReadTrailer(OutFile, FileName, &Trailer))
+    ReportError(FileName, 85);
+  NEntries = (int) (Trailer.NDataSets % BINZ_PAGE);
+  if (!(Directory = (uint64_t *) malloc((Trailer.NPages + 1) *
+					sizeof(uint64_t))))
+    ReportError((char *) Routine, 1);
+  if (Length > 0) {
+    if (fseek(OutFile, (long) Trailer.FooterOffset, SEEK_SET))
+      ReportError(FileName, 39);
+    if (fread(Directory, sizeof(uint64_t), Trailer.NPages, OutFile) !=
+	Trailer.NPages ||
+	fread(Entries, sizeof(BINZENTRY), NEntries, OutFile) !=
+	(size_t) NEntries)
+      ReportError(FileName, 85);
+  }
+
+  /* compress the chunks of the matrix */
+  RawSize = (size_t) NY * NX * SizeOfNumberType(NumberType);
+  NChunks = (int) ((RawSize + Trailer.ChunkSize - 1) / Trailer.ChunkSize);
+  Bound = compressBound(Trailer.ChunkSize);
+  Needed = NChunks * (sizeof(uint32_t) + Bound);
+  if (Needed > WriteSize) {
+    TaggedFree(WriteBuffer);
+    if (!(WriteBuffer = (unsigned char *) TaggedMalloc(Needed, MEM_OUTPUT)))
+      ReportError((char *) Routine, 1);
+    WriteSize = Needed;
+  }
+  ChunkSizes = (uint32_t *) WriteBuffer;
+  Chunks = WriteBuffer + NChunks * sizeof(uint32_t);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) if (NChunks > 1)
+#endif
+  for (i = 0; i < NChunks; i++) {
+    uLongf Size = (uLongf) Bound;
+    size_t Start = (size_t) i * Trailer.ChunkSize;
+    size_t Count = (RawSize - Start < Trailer.ChunkSize) ?
+      RawSize - Start : Trailer.ChunkSize;
+
+    if (compress2(Chunks + i * Bound, &Size, (unsigned char *) Matrix + Start,
+		  (uLong) Count, BINZ_LEVEL) != Z_OK)
+      Failed = TRUE;
+    ChunkSizes[i] = (uint32_t) Size;
+  }
+  if (Failed)
+    ReportError((char *) Routine, 1);
+
+  /* append the block, after a seek as a read and a write of a stream need */
+  if (fseek(OutFile, 0L, SEEK_END))
+    ReportError(FileName, 39);
+  End = (uint64_t) Length;
+  Entries[NEntries].Offset = End;
+  Entries[NEntries].RawSize = RawSize;
+  Entries[NEntries].NChunks = NChunks;
+  Entries[NEntries].NumberType = NumberType;
+  if (NChunks > 0 &&
+      fwrite(ChunkSizes, sizeof(uint32_t), NChunks, OutFile) !=
+      (size_t) NChunks)
+    ReportError(FileName, 41);
+  End += NChunks * sizeof(uint32_t);
+  for (i = 0; i < NChunks; i++) {
+    if (fwrite(Chunks + i * Bound, 1, ChunkSizes[i], OutFile) != ChunkSizes[i])
+      ReportError(FileName, 41);
+    End += ChunkSizes[i];
+  }
+  Entries[NEntries].Size = End - Entries[NEntries].Offset;
+  NEntries++;
+  Trailer.NDataSets++;
+
+  /* a full page of entries stays where it is written */
+  if (NEntries == BINZ_PAGE) {
+    if (fwrite(Entries, sizeof(BINZENTRY), BINZ_PAGE, OutFile) != BINZ_PAGE)
+      ReportError(FileName, 41);
+    Directory[Trailer.NPages++] = End;
+    End += BINZ_PAGE * sizeof(BINZENTRY);
+    NEntries = 0;
+  }
+
+  /* the new footer */
+  Trailer.FooterOffset = End;
+  if (fwrite(Directory, sizeof(uint64_t), Trailer.NPages, OutFile) !=
+      Trailer.NPages ||
+      fwrite(Entries, sizeof(BINZENTRY), NEntries, OutFile) !=
+      (size_t) NEntries ||
+      fwrite(&Trailer, sizeof(BINZTRAILER), 1, OutFile) != 1)
+    ReportError(FileName, 41);
+  if (fclose(OutFile) != 0)
+    ReportError(FileName, 41);
+  free(Directory);
+
+  return NY * NX;
+}
+
+/*****************************************************************************
+  Function name: CloseFilesBinZ()
+
+  Purpose      : Release the buffers of the blocks and the mapped input file
+                 of the BIN reads
+*****************************************************************************/
+void CloseFilesBinZ(void)
+{
+  TaggedFree(WriteBuffer);
+  TaggedFree(ReadBuffer);
+  TaggedFree(WindowBuffer);
+  WriteBuffer = ReadBuffer = WindowBuffer = NULL;
+  WriteSize = ReadSize = WindowSize = 0;
+  CloseFilesBin();
+}
+
+/*****************************************************************************
+  Function name: DataSetSizeBinZ()
+
+  Purpose      : Bytes of the matrix of dataset NDataSet of a file
+
+  Returns      : The size of the matrix, 0 if the file has no trailer and is
+                 read as FILE FORMAT BIN
+
+  Comments     : Used to tell a map of the basin cells only (BASIN ONLY
+                 OUTPUT) from a map of the whole grid
+*****************************************************************************/
+size_t DataSetSizeBinZ(char *FileName, int NDataSet)
+{
+  FILE *InFile;
+  BINZTRAILER Trailer;
+  BINZENTRY Entry;
+
+  OpenFile(&InFile, FileName, "rb", FALSE);
+  if (!ReadTrailer(InFile, FileName, &Trailer)) {
+    fclose(InFile);
+    return 0;
+  }
+  FindDataSet(InFile, FileName, &Trailer, NDataSet, &Entry);
+  fclose(InFile);
+
+  return (size_t) Entry.RawSize;
+}
+
+/*****************************************************************************
+  Function name: ReadTrailer()
+
+  Purpose      : Read the trailer at the end of a file
+
+  Returns      : TRUE if the file ends in a trailer, FALSE if it does not
+
+  Comments     : A trailer whose footer does not end at the end of the file
+                 means that the file was cut or appended to by something
+                 else, and is an error
+*****************************************************************************/
+static int ReadTrailer(FILE *InFile, char *FileName, BINZTRAILER *Trailer)
+{
+  long Length;
+  uint64_t NEntries;
+
+  if (fseek(InFile, 0L, SEEK_END) || (Length = ftell(InFile)) < 0)
+    ReportError(FileName, 39);
+  if (Length < (long) sizeof(BINZTRAILER) ||
+      fseek(InFile, Length - (long) sizeof(BINZTRAILER), SEEK_SET) ||
+      fread(Trailer, sizeof(BINZTRAILER), 1, InFile) != 1 ||
+      memcmp(Trailer->Magic, BINZ_MAGIC, sizeof(Trailer->Magic)) != 0)
+    return FALSE;
+
+  NEntries = Trailer->NDataSets % BINZ_PAGE;
+  if (Trailer->ChunkSize == 0 ||
+      Trailer->NDataSets / BINZ_PAGE != Trailer->NPages ||
+      Trailer->FooterOffset + Trailer->NPages * sizeof(uint64_t) +
+      NEntries * sizeof(BINZENTRY) + sizeof(BINZTRAILER) != (uint64_t) Length)
+    ReportError(FileName, 85);
+  return TRUE;
+}
+
+/*****************************************************************************
+  Function name: FindDataSet()
+
+  Purpose      : Read the index entry of dataset NDataSet
+*****************************************************************************/
+static void FindDataSet(FILE *InFile, char *FileName, BINZTRAILER *Trailer,
+			int NDataSet, BINZENTRY *Entry)
+{
+  uint64_t Page;
+  uint64_t Where;
+
+  if (NDataSet < 0 || (uint64_t) NDataSet >= Trailer->NDataSets)
+    ReportError(FileName, 2);
+
+  Page = NDataSet / BINZ_PAGE;
+  if (Page < Trailer->NPages) {
+    if (fseek(InFile, (long) (Trailer->FooterOffset + Page * sizeof(uint64_t)),
+	      SEEK_SET) ||
+	fread(&Where, sizeof(uint64_t), 1, InFile) != 1)
+      ReportError(FileName, 85);
+  }
+  else
+    Where = Trailer->FooterOffset + Trailer->NPages * sizeof(uint64_t);
+  Where += (NDataSet % BINZ_PAGE) * sizeof(BINZENTRY);
+
+  if (fseek(InFile, (long) Where, SEEK_SET) ||
+      fread(Entry, sizeof(BINZENTRY), 1, InFile) != 1)
+    ReportError(FileName, 85);
+}
+
+/*****************************************************************************
+  Function name: ExpandDataSet()
+
+  Purpose      : Read the block of dataset NDataSet and expand it into
+                 Matrix, which has RawSize bytes
+
+  Comments     : A dataset of another size than the matrix is a read error,
+                 as a short file is in FILE FORMAT BIN
+*****************************************************************************/
+static void ExpandDataSet(FILE *InFile, char *FileName, BINZTRAILER *Trailer,
+			  int NDataSet, void *Matrix, size_t RawSize)
+{
+  const char *Routine = "ExpandDataSet";
+  BINZENTRY Entry;
+  uint32_t *ChunkSizes;
+  unsigned char **Chunks;
+  unsigned char *Next;
+  int Failed = FALSE;
+  uint32_t i;
+
+  FindDataSet(InFile, FileName, Trailer, NDataSet, &Entry);
+  if (Entry.RawSize != RawSize ||
+      Entry.NChunks != (RawSize + Trailer->ChunkSize - 1) / Trailer->ChunkSize ||
+      Entry.Size < Entry.NChunks * sizeof(uint32_t))
+    ReportError(FileName, 2);
+
+  if (Entry.Size > ReadSize) {
+    TaggedFree(ReadBuffer);
+    if (!(ReadBuffer = (unsigned char *) TaggedMalloc(Entry.Size, MEM_OUTPUT)))
+      ReportError((char *) Routine, 1);
+    ReadSize = Entry.Size;
+  }
+  if (fseek(InFile, (long) Entry.Offset, SEEK_SET) ||
+      fread(ReadBuffer, 1, Entry.Size, InFile) != Entry.Size)
+    ReportError(FileName, 85);
+
+  /* the start of each chunk in the block */
+  if (!(Chunks = (unsigned char **) malloc((Entry.NChunks + 1) *
+					   sizeof(unsigned char *))))
+    ReportError((char *) Routine, 1);
+  ChunkSizes = (uint32_t *) ReadBuffer;
+  Next = ReadBuffer + Entry.NChunks * sizeof(uint32_t);
+  for (i = 0; i < Entry.NChunks; i++) {
+    Chunks[i] = Next;
+    Next += ChunkSizes[i];
+  }
+  if (Next != ReadBuffer + Entry.Size)
+    ReportError(FileName, 85);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) if (Entry.NChunks > 1)
+#endif
+  for (i = 0; i < Entry.NChunks; i++) {
+    size_t Start = (size_t) i * Trailer->ChunkSize;
+    size_t Count = (RawSize - Start < Trailer->ChunkSize) ?
+      RawSize - Start : Trailer->ChunkSize;
+    uLongf Size = (uLongf) Count;
+
+    if (uncompress((unsigned char *) Matrix + Start, &Size, Chunks[i],
+		   (uLong) ChunkSizes[i]) != Z_OK || Size != Count)
+      Failed = TRUE;
+  }
+  free(Chunks);
+  if (Failed)
+    ReportError(FileName, 85);
+}
+
+#endif
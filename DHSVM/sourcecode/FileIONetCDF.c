@@ -10,7 +10,14 @@
  * DESCRIP-END.
  * FUNCTIONS:    CreateMapFileNetCDF()
  *               Read2DMatrixNetCDF()
+ *               Read3DMatrixNetCDF()
+ *               Read2DWindowNetCDF()
  *               Write2DMatrixNetCDF()
+ *               UseNetCDF4()
+ *               ncDefineStorage()
+ *               InitCacheNetCDF()
+ *               CloseFilesNetCDF()
+ *               IsGatheredNetCDF()
  *               SizeOfNumberType()
  *
  * Modified was made to Read2DMatrix by Ning (2013)
@@ -58,6 +65,7 @@
 #include "DHSVMerror.h"
 #include "sizeofnt.h"
 #include "varid.h"
+#include "trace.h"
 
 #define ATT_HISTORY   "history"
 #define ATT_COMMENT   "comment"
@@ -66,11 +74,61 @@
 #define ATT_NAME      "name"
 #define ATT_UNITS     "units"
 #define ATT_FORMAT    "C_format"
+#define ATT_COMPRESS  "compress"
 #define TIME_DIM      "time"
 #define X_DIM         "x"
 #define Y_DIM         "y"
+#define CELL_DIM      "cell"
+
+#define MAX_NC_OPEN   64	/* Maximum number of files kept open */
+#define NC_VAR_HEADER 512	/* Header bytes reserved per map of a file 
+				   that holds several maps */
+
+/* Open files are kept in a small cache, keyed by file name, so that a file
+   is opened once instead of once per Read2DMatrixNetCDF/Write2DMatrixNetCDF
+   call.  For every variable the id (and for reads, the orientation flag) is
+   cached as well, so that the coordinate checks are only done once. */
+typedef struct {
+  char Name[NC_MAX_NAME + 1];	/* Variable name */
+  int varid;			/* Variable id */
+  int timedim;			/* Id of the time dimension of the variable */
+  int flag;			/* Orientation flag for reads, -1 if unknown */
+  int ndims;			/* 2 for a gathered (time, cell) variable */
+} NCVARCACHE;
+
+typedef struct {
+  char FileName[BUFSIZE + 1];	/* Name of the open file */
+  int ncid;			/* NetCDF id */
+  int Writable;			/* TRUE if opened with NC_WRITE */
+  int dimids[3];		/* time, north, east; dimids[0] < 0 if unknown */
+  int celldim;			/* cell dimension of a gathered file, -1 if 
+				   the file has none */
+  int NWrites;			/* Number of writes since the last nc_sync */
+  unsigned long LastUse;	/* Used to close the least recently used file */
+  int NVars;			/* Number of cached variables */
+  NCVARCACHE *Vars;		/* Cached variables */
+} NCFILECACHE;
+
+static NCFILECACHE ncCache[MAX_NC_OPEN];
+static int ncNOpen = 0;
+static int ncSyncInterval = 0;
+static int ncGather = FALSE;	/* TRUE if new files only hold the basin */
+static unsigned long ncClock = 0;
 
 static void nc_check_err(const int ncstatus, const int line, const char *file);
+static NCFILECACHE *ncCacheFind(char *FileName);
+static NCFILECACHE *ncCacheAdd(char *FileName, int ncid, int Writable);
+static void ncCacheClose(NCFILECACHE *File);
+static NCFILECACHE *ncCacheOpen(char *FileName, int Writable);
+static NCVARCACHE *ncCacheGetVar(NCFILECACHE *File, char *Name);
+static NCVARCACHE *ncCacheAddVar(NCFILECACHE *File, char *Name, int varid,
+				 int timedim, int flag, int ndims);
+static int ReadMatrixNetCDF(char *FileName, void *Matrix, int NumberType,
+			    int NY, int NX, int NLayers, int WinY, int WinX,
+			    int WinNY, int WinNX, char *VarName, size_t index);
+static int UseNetCDF4(NCSTORAGE *Storage);
+static void ncDefineStorage(int ncid, int varid, int NumberType, 
+			    NCSTORAGE *Storage, int ndims, int NY, int NX);
 static int GenerateHistory(int argc, char **argv, char *History);
 static int ncUpdateGlobalHistory(int argc, char **argv, int ncid);
 
@@ -90,6 +148,8 @@ extern char commandline[];
     FileName  - Name of the new file
     FileLabel - String describing file contents
     Map       - structure with information about spatial extent of model area
+    Storage   - NetCDF-4 storage of the variable that will be written to the
+                file, NULL (or all zero) for a classic NetCDF file
 
   Returns      : void
 
@@ -101,12 +161,26 @@ extern char commandline[];
 		 _FillValue.  This behavior is turned off here to speed up the
 		 initialization process by or'ing  the  NC_NOFILL  flag  into
 		 the  mode parameter of nc_create() 
+
+		 Chunking and compression are per variable, and are set in
+		 Write2DMatrixNetCDF() when the variable is defined
+
+		 If Storage->NVars is more than one (MAP FILE LAYOUT = 
+		 COMBINED), a classic file reserves header space for the 
+		 variables, so that defining them at their first write does 
+		 not move the records written before
+
+		 With BASIN ONLY OUTPUT the file also gets a "cell" dimension
+		 of Map->NumActive, and a "cell" variable with the index 
+		 y * NX + x of each cell in the basin.  The maps in the file 
+		 are then (time, cell) variables
 *******************************************************************************/
 void CreateMapFileNetCDF(char *FileName, ...)
 {
   const char *Routine = "CreateMapFileNetCDF";
   va_list ap;
   MAPSIZE *Map = NULL;		/* pointer to structure with map info */
+  NCSTORAGE *Storage;		/* NetCDF-4 storage, NULL if classic */
   char *FileLabel;		/* File label */
   double *Array;
   double missing_value[1];
@@ -116,9 +190,14 @@ void CreateMapFileNetCDF(char *FileName, ...)
   int varideast;
   int varidnorth;
   int varidtime;
+  int varidcell;
+  int i;
+  int *Index;
   int ncstatus;
   int ncid;
   int dimids[3];		/* time, north, east */
+  int celldim = -1;
+  NCFILECACHE *File;
 
   /****************************************************************************/
   /*                     HANDLE VARIABLE ARGUMENT LIST                        */
@@ -127,9 +206,17 @@ void CreateMapFileNetCDF(char *FileName, ...)
   va_start(ap, FileName);
   FileLabel = va_arg(ap, char *);
   Map = va_arg(ap, MAPSIZE *);
-
-  /* Go ahead and clobber any existing file */
-  ncstatus = nc_create(FileName, NC_CLOBBER | NC_NOFILL, &ncid);
+  Storage = va_arg(ap, NCSTORAGE *);
+  va_end(ap);
+
+  /* Go ahead and clobber any existing file (closing it first if it is
+     still open) */
+  if ((File = ncCacheFind(FileName)) != NULL)
+    ncCacheClose(File);
+  if (UseNetCDF4(Storage))
+    ncstatus = nc_create(FileName, NC_CLOBBER | NC_NOFILL | NC_NETCDF4, &ncid);
+  else
+    ncstatus = nc_create(FileName, NC_CLOBBER | NC_NOFILL, &ncid);
   nc_check_err(ncstatus, __LINE__, __FILE__);
 
   /****************************************************************************/
@@ -186,6 +273,24 @@ void CreateMapFileNetCDF(char *FileName, ...)
 /*   ncstatus = nc_put_att_text(ncid, varideast, ATT_FORMAT, strlen("%g"), "%g"); */
 /*   nc_check_err(ncstatus, __LINE__, __FILE__); */
 
+  /* cells in the basin */
+  if (ncGather) {
+    ncstatus = nc_def_dim(ncid, CELL_DIM, Map->NumActive, &celldim);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    ncstatus = nc_def_var(ncid, CELL_DIM, NC_INT, 1, &celldim, &varidcell);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    ncstatus = nc_put_att_text(ncid, varidcell, ATT_NAME, strlen(CELL_DIM),
+			       CELL_DIM);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    ncstatus = nc_put_att_text(ncid, varidcell, ATT_LONGNAME,
+			       strlen("Index of the cells in the basin"),
+			       "Index of the cells in the basin");
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    ncstatus = nc_put_att_text(ncid, varidcell, ATT_COMPRESS,
+			       strlen(Y_DIM " " X_DIM), Y_DIM " " X_DIM);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+  }
+
   /* Update the history attribute */
   ptrstr[0] = commandline;
   ncstatus = ncUpdateGlobalHistory(1, ptrstr, ncid);
@@ -201,7 +306,11 @@ void CreateMapFileNetCDF(char *FileName, ...)
   nc_check_err(ncstatus, __LINE__, __FILE__);
 
   /* exit the define mode */
-  ncstatus = nc_enddef(ncid);
+  if (Storage != NULL && Storage->NVars > 1)
+    ncstatus = nc__enddef(ncid, (size_t) Storage->NVars * NC_VAR_HEADER, 4, 0,
+			  4);
+  else
+    ncstatus = nc_enddef(ncid);
   nc_check_err(ncstatus, __LINE__, __FILE__);
 
   /****************************************************************************/
@@ -226,8 +335,24 @@ void CreateMapFileNetCDF(char *FileName, ...)
   nc_check_err(ncstatus, __LINE__, __FILE__);
   free(Array);
 
-  ncstatus = nc_close(ncid);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
+  if (ncGather) {
+    Index = (int *) calloc(Map->NumActive, sizeof(int));
+    if (Index == NULL)
+      ReportError((char *) Routine, 1);
+    for (i = 0; i < Map->NumActive; i++)
+      Index[i] = Map->ActiveCells[ROWCELL(Map, i)].y * Map->NX +
+	Map->ActiveCells[ROWCELL(Map, i)].x;
+    ncstatus = nc_put_var_int(ncid, varidcell, Index);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    free(Index);
+  }
+
+  /* keep the file open for the writes that follow */
+  File = ncCacheAdd(FileName, ncid, TRUE);
+  File->dimids[0] = dimids[0];
+  File->dimids[1] = dimids[1];
+  File->dimids[2] = dimids[2];
+  File->celldim = celldim;
 }
 
 /*******************************************************************************
@@ -257,108 +382,236 @@ void CreateMapFileNetCDF(char *FileName, ...)
  int Read2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
 		       int NX, int NDataSet, ...) 
 {
-  const char *Routine = "Read2DMatrixNetCDF";
+  char *VarName;
+  size_t index;	
+  va_list ap;
+
+  /****************************************************************************/
+  /*                   GO THROUGH VARIABLE ARGUMENT LIST                      */
+  /****************************************************************************/
+  va_start(ap, NDataSet);
+  VarName = va_arg(ap, char *);
+  index = va_arg(ap, int);
+  va_end(ap);
+
+  return ReadMatrixNetCDF(FileName, Matrix, NumberType, NY, NX, 1, 0, 0, NY,
+			  NX, VarName, index);
+}
+
+/*******************************************************************************
+  Function name: Read3DMatrixNetCDF()
+
+  Purpose      : Function to read a stack of NLayers consecutive 2D arrays 
+                 from a file with a single hyperslab read
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of contiguous array [NLayers][NY][NX] to read into
+    NumberType - code for number type
+    NY         - Number of rows
+    NX         - Number of columns
+    NDataSet   - number of the first dataset to read (not used, see 
+                 Read2DMatrixNetCDF())
+    NLayers    - number of consecutive datasets to read
+    VarName    - Name of variable to retrieve
+    index      - time index of the first dataset
+
+  Returns      : orientation flag (see Read2DMatrixNetCDF())
+
+  Modifies     : Matrix
+
+  Comments     :
+*******************************************************************************/
+int Read3DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
+		       int NX, int NDataSet, int NLayers, ...)
+{
+  char *VarName;
+  size_t index;	
+  va_list ap;
+
+  va_start(ap, NLayers);
+  VarName = va_arg(ap, char *);
+  index = va_arg(ap, int);
+  va_end(ap);
+
+  return ReadMatrixNetCDF(FileName, Matrix, NumberType, NY, NX, NLayers, 0, 0,
+			  NY, NX, VarName, index);
+}
+
+/*******************************************************************************
+  Function name: Read2DWindowNetCDF()
+
+  Purpose      : Function to read a rectangular window of a 2D array from a
+                 file with a single hyperslab read
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of array [WinNY][WinNX] to read into
+    NumberType - code for number type
+    NY         - Number of rows of the variable in the file
+    NX         - Number of columns of the variable in the file
+    NDataSet   - not used, see Read2DMatrixNetCDF()
+    WinY       - first row of the window
+    WinX       - first column of the window
+    WinNY      - Number of rows in the window
+    WinNX      - Number of columns in the window
+    VarName    - Name of variable to retrieve
+    index      - time index of the dataset
+
+  Returns      : orientation flag (see Read2DMatrixNetCDF())
+
+  Modifies     : Matrix
+
+  Comments     :
+*******************************************************************************/
+int Read2DWindowNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
+		       int NX, int NDataSet, int WinY, int WinX, int WinNY,
+		       int WinNX, ...)
+{
+  char *VarName;
+  size_t index;	
+  va_list ap;
+
+  va_start(ap, WinNX);
+  VarName = va_arg(ap, char *);
+  index = va_arg(ap, int);
+  va_end(ap);
+
+  return ReadMatrixNetCDF(FileName, Matrix, NumberType, NY, NX, 1, WinY, WinX,
+			  WinNY, WinNX, VarName, index);
+}
+
+/*******************************************************************************
+  Function name: ReadMatrixNetCDF()
+
+  Purpose      : Read NLayers consecutive time slices of a variable, starting
+                 at time index, into Matrix.  Only the window of WinNY rows
+                 and WinNX columns starting at (WinY, WinX) is read.  Used by
+                 Read2DMatrixNetCDF(), Read3DMatrixNetCDF() and 
+                 Read2DWindowNetCDF()
+*******************************************************************************/
+static int ReadMatrixNetCDF(char *FileName, void *Matrix, int NumberType,
+			    int NY, int NX, int NLayers, int WinY, int WinX,
+			    int WinNY, int WinNX, char *VarName, size_t index)
+{
+  const char *Routine = "ReadMatrixNetCDF";
   char Str[BUFSIZE + 1];
   char dimname[NC_MAX_NAME + 1];
-  char *VarName;
   int dimids[3];
   int ndims;
   int ncid;
   int ncstatus;
   nc_type TempNumberType;
   int varid;
-  size_t index;	
   double time;
   int timid;
   size_t count[3];
   size_t start[3] = { 0, 0, 0 };
   size_t dimlen;
   size_t timelen;
-  va_list ap;
   double *Ycoord;
   double *Xcoord;  /* lat, lon variables */
   int	LatisAsc, LonisAsc, flag;    /* flag */
   int lon_varid, lat_varid;
-  count[0] = 1;
-  count[1] = NY;
-  count[2] = NX;
+  NCFILECACHE *File;
+  NCVARCACHE *Var;
+  count[0] = NLayers;
+  count[1] = WinNY;
+  count[2] = WinNX;
 
-  /****************************************************************************/
-  /*                   GO THROUGH VARIABLE ARGUMENT LIST                      */
-  /****************************************************************************/
-  va_start(ap, NDataSet);
-  VarName = va_arg(ap, char *);
-  index = va_arg(ap, int);
   /****************************************************************************/
   /*                           QUERY NETDCF FILE                              */
   /****************************************************************************/
 
-  ncstatus = nc_open(FileName, NC_NOWRITE, &ncid);
-  /* debugging if any file fails to be opened */
-  //printf("Trying to open %s\n", FileName);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
+  File = ncCacheOpen(FileName, FALSE);
+  ncid = File->ncid;
 
-  /* check whether the variable exists and get its parameters */
-  ncstatus = nc_inq_varid(ncid, VarName, &varid);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
+  /* the variable checks are only done the first time it is read */
+  Var = ncCacheGetVar(File, VarName);
+  if (Var == NULL || Var->flag < 0) {
+    /* check whether the variable exists and get its parameters */
+    ncstatus = nc_inq_varid(ncid, VarName, &varid);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
 
-  ncstatus = nc_inq_var(ncid, varid, 0, &TempNumberType, &ndims, dimids, NULL);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  if (TempNumberType != NumberType) {
-    sprintf(Str, "%s: nc_type for %s is different than expected.\n",
+    ncstatus = nc_inq_var(ncid, varid, 0, &TempNumberType, &ndims, dimids, NULL);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    if (TempNumberType != NumberType) {
+      sprintf(Str, "%s: nc_type for %s is different than expected.\n",
 	    FileName, VarName);
-    ReportWarning(Str, 58);
-  }
-
-  /* make sure that the x and y dimensions have the correct sizes */
-  ncstatus = nc_inq_dim(ncid, dimids[1], dimname, &dimlen);  
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  ncstatus = nc_inq_varid(ncid, dimname, &lat_varid);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  if (dimlen != NY)
-	  ReportError(VarName, 59);
-  Ycoord = (double *) calloc(dimlen, sizeof(double));
-  if (Ycoord == NULL)
-    ReportError((char *) Routine, 1);
-    /* Read the latitude coordinate variable data. */
-  ncstatus = nc_get_var_double(ncid, lat_varid, Ycoord);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  /* A quick check if the lat, long are in a ascending order. 
-  If so, matrix must be flipped so the first value in the matrix will be 
-  assigned to the lower left corner cell that has lowest X (lon) & Y (lat) value. 
-  (see more comments in the header of this C file). */
-  LatisAsc = 1;
-  if( Ycoord[0] > Ycoord[NY - 1] ) 
-	  LatisAsc = 0;
-
-  ncstatus = nc_inq_dim(ncid, dimids[2], dimname, &dimlen);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  ncstatus = nc_inq_varid(ncid, dimname, &lon_varid);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  if (dimlen != NX)
-    ReportError(VarName, 60);
-  Xcoord = (double *) calloc(NX, sizeof(double));
-  if (Xcoord == NULL)
-    ReportError((char *) Routine, 1);
-  /* Read the latitude coordinate variable data. */
-  ncstatus = nc_get_var_double(ncid, lon_varid, Xcoord);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  LonisAsc = 1;
-  if( Xcoord[0] > Xcoord[NX - 1] ) 
-	  LonisAsc = 0;
-
-  if (LonisAsc == 0){
-	  printf("The current program does not handle the cases when longitude or X \
+      ReportWarning(Str, 58);
+    }
+
+    /* a (time, cell) variable written with BASIN ONLY OUTPUT has no 
+       coordinates to check, only the number of cells */
+    if (ndims == 2) {
+      ncstatus = nc_inq_dimlen(ncid, dimids[1], &dimlen);
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+      if (dimlen != (size_t) NY * NX)
+	ReportError(VarName, 59);
+      flag = 0;
+    }
+    else {
+      /* make sure that the x and y dimensions have the correct sizes */
+      ncstatus = nc_inq_dim(ncid, dimids[1], dimname, &dimlen);  
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+      ncstatus = nc_inq_varid(ncid, dimname, &lat_varid);
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+      if (dimlen != NY)
+	    ReportError(VarName, 59);
+      Ycoord = (double *) calloc(dimlen, sizeof(double));
+      if (Ycoord == NULL)
+        ReportError((char *) Routine, 1);
+        /* Read the latitude coordinate variable data. */
+      ncstatus = nc_get_var_double(ncid, lat_varid, Ycoord);
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+      /* A quick check if the lat, long are in a ascending order. 
+      If so, matrix must be flipped so the first value in the matrix will be 
+      assigned to the lower left corner cell that has lowest X (lon) & Y (lat) value. 
+      (see more comments in the header of this C file). */
+      LatisAsc = 1;
+      if( Ycoord[0] > Ycoord[NY - 1] ) 
+	    LatisAsc = 0;
+
+      ncstatus = nc_inq_dim(ncid, dimids[2], dimname, &dimlen);
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+      ncstatus = nc_inq_varid(ncid, dimname, &lon_varid);
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+      if (dimlen != NX)
+        ReportError(VarName, 60);
+      Xcoord = (double *) calloc(NX, sizeof(double));
+      if (Xcoord == NULL)
+        ReportError((char *) Routine, 1);
+      /* Read the latitude coordinate variable data. */
+      ncstatus = nc_get_var_double(ncid, lon_varid, Xcoord);
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+      LonisAsc = 1;
+      if( Xcoord[0] > Xcoord[NX - 1] ) 
+	    LonisAsc = 0;
+
+      if (LonisAsc == 0){
+	    printf("The current program does not handle the cases when longitude or X \
 values in the .nc input in an descending order. You can either change the input \
 .nc file format outside of this program. or you can easily modify this program to \
 fit your needs. \n");
-	  ReportError("Improper NetCDF input files", 58);
+	    ReportError("Improper NetCDF input files", 58);
+      }
+      if ((LatisAsc == 0) & (LonisAsc == 1))
+	    flag = 0;
+      if ((LatisAsc == 1) & (LonisAsc == 1))
+	    flag = 1;
+
+      free(Ycoord);
+      free(Xcoord);
+    }
+    if (Var == NULL)
+      Var = ncCacheAddVar(File, VarName, varid, dimids[0], flag, ndims);
+    else
+      Var->flag = flag;
   }
-  if ((LatisAsc == 0) & (LonisAsc == 1))
-	  flag = 0;
-  if ((LatisAsc == 1) & (LonisAsc == 1))
-	  flag = 1;
-  
+  varid = Var->varid;
+  dimids[0] = Var->timedim;
+  flag = Var->flag;
+
   /* see whether the time dimension needs to be updated (the assumption is that
      the same index value refers to the same moment in time.  Since currently we
      make separate files for separate variables this is OK) */
@@ -372,6 +625,12 @@ fit your needs. \n");
     nc_check_err(ncstatus, __LINE__, __FILE__);
   }
   start[0] = index;
+  start[1] = WinY;
+  start[2] = WinX;
+  if (Var->ndims == 2) {
+    count[1] = (size_t) WinNY * WinNX;
+    start[1] = (size_t) WinY * NX + WinX;
+  }
   /****************************************************************************/
   /*                             READ VARIABLE                                */
   /****************************************************************************/
@@ -406,12 +665,7 @@ fit your needs. \n");
   }
   nc_check_err(ncstatus, __LINE__, __FILE__);
 
-  /****************************************************************************/
-  /*                                CLEAN UP                                  */
-  /****************************************************************************/
-
-  ncstatus = nc_close(ncid);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
+  /* the file stays open, it is closed by CloseFilesNetCDF() */
 
   return flag;
 }
@@ -434,7 +688,10 @@ fit your needs. \n");
 
   Modifies     :
 
-  Comments     :
+  Comments     : If the variable is new and the file is a NetCDF-4 file, the 
+                 chunking and compression in DMap->Storage are applied.  If 
+		 the file has a "cell" dimension, the NY * NX values are 
+		 written as one (time, cell) slice
 *******************************************************************************/
 int Write2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
 			int NX, ...)
@@ -442,9 +699,11 @@ int Write2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
   const char *Routine = "Write2DMatrixNetCDF";
   double time;
   int dimids[3];		/* time, north, east */
+  int ndims;
   size_t index;			/* index of the time slice being dumped */
   int ncid;
   int ncstatus;
+  int format;
   int timid;
   int varid;
   size_t count[3];
@@ -452,6 +711,8 @@ int Write2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
   size_t timelen;
   va_list ap;
   MAPDUMP *DMap;
+  NCFILECACHE *File;
+  NCVARCACHE *Var;
 
   count[0] = 1;
   count[1] = NY;
@@ -468,27 +729,58 @@ int Write2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
   /*                           QUERY NETDCF FILE                              */
   /****************************************************************************/
 
-  ncstatus = nc_open(FileName, NC_WRITE, &ncid);
-  nc_check_err(ncstatus, __LINE__, __FILE__);
+  File = ncCacheOpen(FileName, TRUE);
+  ncid = File->ncid;
 
   /* get dimension ID's */
-  nc_inq_dimid(ncid, TIME_DIM, &(dimids[0]));
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  nc_inq_dimid(ncid, Y_DIM, &(dimids[1]));
-  nc_check_err(ncstatus, __LINE__, __FILE__);
-  nc_inq_dimid(ncid, X_DIM, &(dimids[2]));
-  nc_check_err(ncstatus, __LINE__, __FILE__);
+  if (File->dimids[0] < 0) {
+    ncstatus = nc_inq_dimid(ncid, TIME_DIM, &(File->dimids[0]));
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    ncstatus = nc_inq_dimid(ncid, Y_DIM, &(File->dimids[1]));
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    ncstatus = nc_inq_dimid(ncid, X_DIM, &(File->dimids[2]));
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    ncstatus = nc_inq_dimid(ncid, CELL_DIM, &(File->celldim));
+    if (ncstatus == NC_EBADDIM)
+      File->celldim = -1;
+    else
+      nc_check_err(ncstatus, __LINE__, __FILE__);
+  }
+  dimids[0] = File->dimids[0];
+  if (File->celldim >= 0) {
+    ndims = 2;
+    dimids[1] = File->celldim;
+    count[1] = (size_t) NY * NX;
+  }
+  else {
+    ndims = 3;
+    dimids[1] = File->dimids[1];
+    dimids[2] = File->dimids[2];
+  }
 
   /* see whether variable has been defined; if not defined, define it now */
-  ncstatus = nc_inq_varid(ncid, DMap->Name, &varid);
+  if ((Var = ncCacheGetVar(File, DMap->Name)) != NULL) {
+    varid = Var->varid;
+    ncstatus = NC_NOERR;
+  }
+  else
+    ncstatus = nc_inq_varid(ncid, DMap->Name, &varid);
   if (ncstatus == NC_ENOTVAR) {	/* Variable not defined */
 
     ncstatus = nc_redef(ncid);
     nc_check_err(ncstatus, __LINE__, __FILE__);
-    ncstatus = nc_def_var(ncid, DMap->Name, DMap->NumberType, 3, dimids,
+    ncstatus = nc_def_var(ncid, DMap->Name, DMap->NumberType, ndims, dimids,
 			  &varid);
     nc_check_err(ncstatus, __LINE__, __FILE__);
 
+    /* state files are classic files and their DMap is not initialized
+       beyond the attributes, so only look at Storage for NetCDF-4 files */
+    ncstatus = nc_inq_format(ncid, &format);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    if (format == NC_FORMAT_NETCDF4)
+      ncDefineStorage(ncid, varid, DMap->NumberType, &(DMap->Storage), ndims,
+		      NY, NX);
+
     /* write variable attributes */
     ncstatus = nc_put_att_text(ncid, varid, ATT_NAME, strlen(DMap->Name),
 			       DMap->Name);
@@ -508,10 +800,12 @@ int Write2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
   }
   else				/* Variable defined */
     nc_check_err(ncstatus, __LINE__, __FILE__);
+  if (Var == NULL)
+    ncCacheAddVar(File, DMap->Name, varid, dimids[0], -1, ndims);
 
   /* see whether the time dimension needs to be updated (the assumption is that
-     the same index value refers to the same moment in time.  Since currently we
-     make separate files for separate variables this is OK) */
+     the same index value refers to the same moment in time.  This is OK since
+     the maps that share a file are dumped at the same dates) */
   ncstatus = nc_inq_dimlen(ncid, dimids[0], &timelen);
   nc_check_err(ncstatus, __LINE__, __FILE__);
   if (timelen < index + 1) {	/* need to add one to time */
@@ -557,14 +851,312 @@ int Write2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
   }
   nc_check_err(ncstatus, __LINE__, __FILE__);
 
-  /****************************************************************************/
-  /*                                CLEAN UP                                  */
-  /****************************************************************************/
+  /* the file stays open, flush it to disk every ncSyncInterval writes */
+  File->NWrites++;
+  if (ncSyncInterval > 0 && File->NWrites >= ncSyncInterval) {
+    ncstatus = nc_sync(ncid);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+    File->NWrites = 0;
+  }
 
-  ncstatus = nc_close(ncid);
+  return NY * NX;
+}
+
+/*******************************************************************************
+  Function name: UseNetCDF4()
+
+  Purpose      : Determine whether a file has to be created as a NetCDF-4 file
+
+  Required     : 
+    Storage - storage settings, may be NULL
+
+  Returns      : TRUE if any chunking or compression is requested
+
+  Modifies     : 
+
+  Comments     :
+*******************************************************************************/
+static int UseNetCDF4(NCSTORAGE *Storage)
+{
+  if (Storage == NULL)
+    return FALSE;
+  return (Storage->Chunk[0] > 0 || Storage->Deflate > 0 || Storage->Shuffle ||
+	  Storage->Quantize > 0);
+}
+
+/*******************************************************************************
+  Function name: ncDefineStorage()
+
+  Purpose      : Set the chunking, compression and quantization of a newly 
+                 defined variable in a NetCDF-4 file
+
+  Required     : 
+    ncid       - NetCDF id of the file, in define mode
+    varid      - id of the variable
+    NumberType - number type of the variable
+    Storage    - storage settings
+    ndims      - 3 for a (time, y, x) variable, 2 for a (time, cell) one
+    NY         - Number of rows
+    NX         - Number of columns
+
+  Returns      : void
+
+  Modifies     : the variable definition
+
+  Comments     : Chunks are limited to the size of the map.  Without MAP 
+                 CHUNK SIZE the library chooses the chunks.  The chunks of a
+                 (time, cell) variable hold as many cells as a y, x chunk.  Quantization is 
+                 only applied to floating point variables, and needs NetCDF
+                 4.8.1 or later
+*******************************************************************************/
+static void ncDefineStorage(int ncid, int varid, int NumberType, 
+			    NCSTORAGE *Storage, int ndims, int NY, int NX)
+{
+  size_t chunks[3];		/* time, north, east */
+  int ncstatus;
+
+  if (Storage->Chunk[0] > 0) {
+    chunks[0] = Storage->Chunk[0];
+    chunks[1] = MIN(Storage->Chunk[1], NY);
+    chunks[2] = MIN(Storage->Chunk[2], NX);
+    if (ndims == 2)
+      chunks[1] = MIN((size_t) Storage->Chunk[1] * Storage->Chunk[2], 
+		      (size_t) NY * NX);
+    ncstatus = nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+  }
+
+  if (Storage->Deflate > 0 || Storage->Shuffle) {
+    ncstatus = nc_def_var_deflate(ncid, varid, Storage->Shuffle,
+				  Storage->Deflate > 0, Storage->Deflate);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+  }
+
+  if (Storage->Quantize > 0 &&
+      (NumberType == NC_FLOAT || NumberType == NC_DOUBLE)) {
+#ifdef NC_QUANTIZE_BITGROOM
+    ncstatus = nc_def_var_quantize(ncid, varid, NC_QUANTIZE_BITGROOM,
+				   Storage->Quantize);
+    nc_check_err(ncstatus, __LINE__, __FILE__);
+#else
+    ReportWarning("MAP QUANTIZE DIGITS", 73);
+#endif
+  }
+}
+
+/*******************************************************************************
+  Function name: InitCacheNetCDF()
+
+  Purpose      : Set how often the open NetCDF files are flushed to disk, and
+                 whether new files only hold the cells in the basin
+
+  Required     : 
+    SyncInterval - Number of writes to a file between calls to nc_sync().  If 
+                   0, files are only flushed when they are closed
+    Gather       - if TRUE, CreateMapFileNetCDF() adds a "cell" dimension 
+                   (BASIN ONLY OUTPUT)
+
+  Returns      : void
+
+  Modifies     : ncSyncInterval, ncGather
+
+  Comments     :
+*******************************************************************************/
+void InitCacheNetCDF(int SyncInterval, int Gather)
+{
+  ncSyncInterval = SyncInterval;
+  ncGather = Gather;
+}
+
+/*******************************************************************************
+  Function name: CloseFilesNetCDF()
+
+  Purpose      : Close all the NetCDF files that are kept open
+
+  Required     : 
+
+  Returns      : void
+
+  Modifies     : ncCache
+
+  Comments     : Has to be called before the program ends, otherwise data 
+                 written to the files may be lost
+*******************************************************************************/
+void CloseFilesNetCDF(void)
+{
+  while (ncNOpen > 0)
+    ncCacheClose(&(ncCache[ncNOpen - 1]));
+}
+
+/*******************************************************************************
+  Function name: IsGatheredNetCDF()
+
+  Purpose      : TRUE if the file holds the basin cells only (BASIN ONLY
+                 OUTPUT), its variables then have the cell dimension
+*******************************************************************************/
+int IsGatheredNetCDF(char *FileName)
+{
+  NCFILECACHE *File;
+  int dimid;
+
+  File = ncCacheOpen(FileName, FALSE);
+  return nc_inq_dimid(File->ncid, CELL_DIM, &dimid) == NC_NOERR;
+}
+
+/*******************************************************************************
+  Function name: ncCacheFind()
+
+  Purpose      : Find an open file in the cache
+
+  Returns      : Pointer to the cache entry, NULL if the file is not open
+*******************************************************************************/
+static NCFILECACHE *ncCacheFind(char *FileName)
+{
+  int i;
+
+  for (i = 0; i < ncNOpen; i++) {
+    if (strcmp(ncCache[i].FileName, FileName) == 0) {
+      ncCache[i].LastUse = ++ncClock;
+      return &(ncCache[i]);
+    }
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+  Function name: ncCacheAdd()
+
+  Purpose      : Add an open file to the cache.  If the cache is full the 
+                 least recently used file is closed first
+
+  Returns      : Pointer to the new cache entry
+*******************************************************************************/
+static NCFILECACHE *ncCacheAdd(char *FileName, int ncid, int Writable)
+{
+  NCFILECACHE *File;
+  int i;
+
+  if (ncNOpen == MAX_NC_OPEN) {
+    File = &(ncCache[0]);
+    for (i = 1; i < ncNOpen; i++) {
+      if (ncCache[i].LastUse < File->LastUse)
+	File = &(ncCache[i]);
+    }
+    ncCacheClose(File);
+  }
+
+  File = &(ncCache[ncNOpen++]);
+  strncpy(File->FileName, FileName, BUFSIZE);
+  File->FileName[BUFSIZE] = '\0';
+  File->ncid = ncid;
+  File->Writable = Writable;
+  File->dimids[0] = File->dimids[1] = File->dimids[2] = -1;
+  File->celldim = -1;
+  File->NWrites = 0;
+  File->LastUse = ++ncClock;
+  File->NVars = 0;
+  File->Vars = NULL;
+
+  return File;
+}
+
+/*******************************************************************************
+  Function name: ncCacheClose()
+
+  Purpose      : Close a file and remove it from the cache
+*******************************************************************************/
+static void ncCacheClose(NCFILECACHE *File)
+{
+  int ncstatus;
+
+  ncstatus = nc_close(File->ncid);
   nc_check_err(ncstatus, __LINE__, __FILE__);
+  free(File->Vars);
 
-  return NY * NX;
+  /* fill the hole with the last entry */
+  ncNOpen--;
+  if (File != &(ncCache[ncNOpen]))
+    *File = ncCache[ncNOpen];
+}
+
+/*******************************************************************************
+  Function name: ncCacheOpen()
+
+  Purpose      : Return the cache entry for a file, opening the file if it is
+                 not open yet.  A file that is open read-only is re-opened if
+                 it needs to be written to
+
+  Returns      : Pointer to the cache entry
+*******************************************************************************/
+static NCFILECACHE *ncCacheOpen(char *FileName, int Writable)
+{
+  NCFILECACHE *File;
+  double Span;
+  int ncid;
+  int ncstatus;
+
+  if ((File = ncCacheFind(FileName)) != NULL) {
+    if (File->Writable || !Writable)
+      return File;
+    ncCacheClose(File);
+  }
+
+  Span = TRACE_BEGIN();
+  ncstatus = nc_open(FileName, Writable ? NC_WRITE : NC_NOWRITE, &ncid);
+  /* debugging if any file fails to be opened */
+  //printf("Trying to open %s\n", FileName);
+  nc_check_err(ncstatus, __LINE__, __FILE__);
+
+  File = ncCacheAdd(FileName, ncid, Writable);
+  TraceEnd(Span, "nc_open", "io", FileName, -1.0);
+  return File;
+}
+
+/*******************************************************************************
+  Function name: ncCacheGetVar()
+
+  Purpose      : Find a variable in the cache of an open file
+
+  Returns      : Pointer to the cached variable, NULL if not cached
+*******************************************************************************/
+static NCVARCACHE *ncCacheGetVar(NCFILECACHE *File, char *Name)
+{
+  int i;
+
+  for (i = 0; i < File->NVars; i++) {
+    if (strcmp(File->Vars[i].Name, Name) == 0)
+      return &(File->Vars[i]);
+  }
+  return NULL;
+}
+
+/*******************************************************************************
+  Function name: ncCacheAddVar()
+
+  Purpose      : Add a variable to the cache of an open file
+
+  Returns      : Pointer to the cached variable
+*******************************************************************************/
+static NCVARCACHE *ncCacheAddVar(NCFILECACHE *File, char *Name, int varid,
+				 int timedim, int flag, int ndims)
+{
+  const char *Routine = "ncCacheAddVar";
+  NCVARCACHE *Var;
+
+  File->Vars = (NCVARCACHE *) realloc(File->Vars, (File->NVars + 1) *
+				      sizeof(NCVARCACHE));
+  if (File->Vars == NULL)
+    ReportError((char *) Routine, 1);
+
+  Var = &(File->Vars[File->NVars++]);
+  strncpy(Var->Name, Name, NC_MAX_NAME);
+  Var->Name[NC_MAX_NAME] = '\0';
+  Var->varid = varid;
+  Var->timedim = timedim;
+  Var->flag = flag;
+  Var->ndims = ndims;
+
+  return Var;
 }
 
 /*******************************************************************************
@@ -769,7 +1361,7 @@ int main(void)
   DMap.DumpDate[1].JDay = 1;
   DMap.DumpDate[1].Hour = 0;
 
-  CreateMapFileNetCDF(DMap.FileName, DMap.FileLabel, &Map);
+  CreateMapFileNetCDF(DMap.FileName, DMap.FileLabel, &Map, NULL);
   WriteArray = (float *) calloc(Map.NX * Map.NY, sizeof(float));
   if (WriteArray == NULL)
     ReportError("Testing NetCDF", 1);
@@ -858,6 +1450,8 @@ int main(void)
 	    cWriteArray[i], cReadArray[i]);
   }
 
+  CloseFilesNetCDF();
+
   if (eflag == 0)
     printf("Test successful\n");
 
@@ -0,0 +1,1273 @@
+/*
+ * SUMMARY:      FileIOZarr.c - Functions for Zarr IO
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  FILE FORMAT ZARR.  A map file is a Zarr (version 2) store,
+ *               a directory with one array for each variable written to it,
+ *               so that the map dumps and the model states can be opened
+ *               with xarray or Dask, locally or after the directory has been
+ *               copied to an object store, without a conversion step.  Each
+ *               array is cut into chunks in time, y and x (MAP CHUNK of the
+ *               map dumps), and a chunk is one zlib stream that the OpenMP
+ *               threads compress in parallel.
+ * DESCRIP-END.
+ * FUNCTIONS:    JoinPath()
+ *               IsDirectory()
+ *               ReadText()
+ *               WriteFile()
+ *               PutString()
+ *               Dtype()
+ *               FindKey()
+ *               FindList()
+ *               InitZarr()
+ *               CreateMapFileZarr()
+ *               Read2DMatrixZarr()
+ *               Write2DMatrixZarr()
+ *               CloseFilesZarr()
+ *               IsStoreZarr()
+ *               IsGatheredZarr()
+ *               RemoveStoreZarr()
+ *               CopyStoreZarr()
+ *               FindArray()
+ *               NewArray()
+ *               ReadArray()
+ *               WriteArray()
+ *               DecodeChunk()
+ *               EncodeChunk()
+ *               WriteCoordinate()
+ *               Consolidate()
+ * COMMENTS:     Layout of a store, for a variable Soil.Moist:
+ *
+ *                 .zgroup, .zattrs         the group, with the file label
+ *                                          and the storage of the dumps
+ *                 x/, y/                   easting and northing of the
+ *                                          cells, and cell/ with BASIN ONLY
+ *                                          OUTPUT (see InitFileIO())
+ *                 Soil.Moist/.zarray       shape [time, y, x], or [time,
+ *                                          cell] for the basin cells only
+ *                 Soil.Moist/.zattrs       dimensions, long name and units
+ *                 Soil.Moist/t.i.j         chunk (t, i, j)
+ *
+ *               The numbers are in the byte order of the machine, as in the
+ *               other formats, and the rows from north to south.  A chunk is
+ *               written to a temporary file that is renamed, and .zarray
+ *               only after its chunks, so a reader never sees a partial
+ *               chunk or a record that has not been written.  Time chunks of
+ *               more than one record are read back and written again for
+ *               each record.  .zmetadata, the consolidated metadata of the
+ *               store, is removed when an array grows and written by
+ *               CloseFilesZarr(), so it is only there for a complete file.
+ *               Files that are not a store are read as FILE FORMAT BIN, so
+ *               the input maps of a basin do not have to be converted.
+ *               Without HAVE_ZLIB the chunks are not compressed.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "settings.h"
+#include "data.h"
+#include "fifobin.h"
+#include "fifozarr.h"
+#include "fileio.h"
+#include "sizeofnt.h"
+#include "DHSVMerror.h"
+#include "memaccount.h"
+
+#define ZARR_CHUNK 256		/* default chunk size in y and x */
+#define ZARR_LEVEL 1		/* default zlib compression level */
+#define ZARR_LINE  4096		/* characters of a metadata line */
+
+/* an array of a store that has been written by this process */
+typedef struct {
+  char Store[BUFSIZE + 1];	/* name of the store */
+  char Path[BUFSIZE + 1];	/* directory of the array */
+  int NumberType;		/* see sizeofnt.h */
+  int Rank;			/* 3 for [time, y, x], 2 for [time, cell] */
+  size_t Shape[3];		/* records, rows and columns, rows is 1 for
+				   rank 2 */
+  size_t Chunk[3];		/* chunk size in the same order */
+  int Level;			/* zlib level, 0 for no compression */
+  int Shuffle;			/* TRUE if the bytes are shuffled */
+  pid_t Pid;			/* process that wrote it */
+} ZARRARRAY;
+
+static ZARRARRAY *FindArray(char *Store, MAPDUMP *DMap, int NumberType,
+			    int NY, int NX);
+static void NewArray(ZARRARRAY *Array, MAPDUMP *DMap, int NY, int NX);
+static int ReadArray(char *Path, ZARRARRAY *Array);
+static void WriteArray(ZARRARRAY *Array);
+static int DecodeChunk(ZARRARRAY *Array, char *Key, unsigned char *Raw,
+		       unsigned char *Work, size_t RawSize);
+static int EncodeChunk(ZARRARRAY *Array, char *Key, unsigned char *Raw,
+		       unsigned char *Work, unsigned char *Out, size_t RawSize,
+		       size_t Bound);
+static void WriteCoordinate(char *Store, char *Name, char *LongName,
+			    char *Units, int NumberType, void *Values, int N,
+			    char *Compress);
+static void Consolidate(char *Store);
+
+/* the arrays written by this process, which only the writer thread (or
+   the main thread without OUTPUT QUEUE SIZE) changes */
+static ZARRARRAY *Arrays = NULL;
+static int NArrays = 0;
+static int MaxArrays = 0;
+
+/* chunks of the writes, and of the reads, which the writer thread and the
+   main thread do not share */
+static unsigned char *WriteBuffer = NULL;
+static size_t WriteSize = 0;
+static unsigned char *ReadBuffer = NULL;
+static size_t ReadSize = 0;
+
+static int Gather = FALSE;	/* BasinOnly passed to InitZarr() */
+
+/*****************************************************************************
+  Function name: JoinPath()
+
+  Purpose      : Path of entry Key of directory Dir
+*****************************************************************************/
+static void JoinPath(char *Path, const char *Dir, const char *Key)
+{
+  snprintf(Path, BUFSIZE + 1, "%s/%s", Dir, Key);
+}
+
+/*****************************************************************************
+  Function name: IsDirectory()
+*****************************************************************************/
+static int IsDirectory(const char *Path)
+{
+  struct stat Info;
+
+  return stat(Path, &Info) == 0 && S_ISDIR(Info.st_mode);
+}
+
+/*****************************************************************************
+  Function name: ReadText()
+
+  Purpose      : Contents of the metadata file Path, without the trailing
+                 white space, in a string the caller frees, or NULL if there
+                 is no such file
+*****************************************************************************/
+static char *ReadText(const char *Path)
+{
+  FILE *InFile;
+  char *Text;
+  long Length;
+  size_t N;
+
+  if (!(InFile = fopen(Path, "rb")))
+    return NULL;
+  if (fseek(InFile, 0L, SEEK_END) || (Length = ftell(InFile)) < 0 ||
+      fseek(InFile, 0L, SEEK_SET)) {
+    fclose(InFile);
+    return NULL;
+  }
+  if (!(Text = (char *) malloc((size_t) Length + 1)))
+    ReportError("ReadText", 1);
+  N = fread(Text, 1, (size_t) Length, InFile);
+  fclose(InFile);
+  while (N > 0 && (Text[N - 1] == '\n' || Text[N - 1] == ' '))
+    N--;
+  Text[N] = '\0';
+  return Text;
+}
+
+/*****************************************************************************
+  Function name: WriteFile()
+
+  Purpose      : Replace file Path with the Size bytes of Data
+
+  Returns      : TRUE, FALSE if the file could not be written
+
+  Comments     : The bytes go to Path.tmp, which is then renamed, so that a
+                 reader sees either the old or the new file
+*****************************************************************************/
+static int WriteFile(const char *Path, const void *Data, size_t Size)
+{
+  FILE *OutFile;
+  char TmpName[BUFSIZE + 1];
+  int Ok;
+
+  snprintf(TmpName, BUFSIZE + 1, "%s.tmp", Path);
+  if (!(OutFile = fopen(TmpName, "wb")))
+    return FALSE;
+  Ok = (Size == 0 || fwrite(Data, 1, Size, OutFile) == Size);
+  Ok = (fclose(OutFile) == 0) && Ok;
+  return Ok && rename(TmpName, Path) == 0;
+}
+
+/*****************************************************************************
+  Function name: PutString()
+
+  Purpose      : Print Str as a JSON string
+*****************************************************************************/
+static int PutString(char *Buffer, size_t Size, const char *Str)
+{
+  size_t n = 0;
+
+  if (Size < 3)
+    return 0;
+  Buffer[n++] = '"';
+  for (; *Str != '\0' && n < Size - 3; Str++) {
+    if (*Str == '"' || *Str == '\\')
+      Buffer[n++] = '\\';
+    Buffer[n++] = (*Str == '\n' || *Str == '\t') ? ' ' : *Str;
+  }
+  Buffer[n++] = '"';
+  Buffer[n] = '\0';
+  return (int) n;
+}
+
+/*****************************************************************************
+  Function name: Dtype()
+
+  Purpose      : Zarr data type of NumberType, in the byte order of the
+                 machine
+*****************************************************************************/
+static void Dtype(int NumberType, char *Type)
+{
+  const union {
+    int Int;
+    char Byte[sizeof(int)];
+  } Order = { 1 };
+  char Endian = Order.Byte[0] ? '<' : '>';
+
+  switch (NumberType) {
+  case NC_BYTE:
+  case NC_CHAR:
+    strcpy(Type, "|u1");
+    break;
+  case NC_SHORT:
+    sprintf(Type, "%ci2", Endian);
+    break;
+  case NC_INT:
+    sprintf(Type, "%ci4", Endian);
+    break;
+  case NC_FLOAT:
+    sprintf(Type, "%cf4", Endian);
+    break;
+  case NC_DOUBLE:
+    sprintf(Type, "%cf8", Endian);
+    break;
+  default:
+    ReportError("Dtype", 40);
+  }
+}
+
+/*****************************************************************************
+  Function name: FindKey()
+
+  Purpose      : The value of "Key" in the JSON text Json, NULL if there is
+                 none
+*****************************************************************************/
+static const char *FindKey(const char *Json, const char *Key)
+{
+  char Quoted[NAMESIZE + 3];
+  const char *Value;
+
+  snprintf(Quoted, sizeof(Quoted), "\"%s\"", Key);
+  if (!(Value = strstr(Json, Quoted)))
+    return NULL;
+  Value += strlen(Quoted);
+  while (*Value == ' ' || *Value == ':' || *Value == '\n')
+    Value++;
+  return Value;
+}
+
+/*****************************************************************************
+  Function name: FindList()
+
+  Purpose      : Read the list of at most Max integers of "Key"
+
+  Returns      : The number of integers, -1 if there is no such list
+*****************************************************************************/
+static int FindList(const char *Json, const char *Key, size_t *Values,
+		    int Max)
+{
+  const char *Value = FindKey(Json, Key);
+  char *End;
+  int n = 0;
+
+  if (Value == NULL || *Value != '[')
+    return -1;
+  Value++;
+  while (n < Max) {
+    Values[n] = (size_t) strtoul(Value, &End, 10);
+    if (End == Value)
+      break;
+    n++;
+    Value = End;
+    while (*Value == ' ' || *Value == ',')
+      Value++;
+  }
+  return (*Value == ']') ? n : -1;
+}
+
+/*****************************************************************************
+  Function name: InitZarr()
+
+  Purpose      : Set up the Zarr functions
+
+  Required     :
+    int BasinOnly - TRUE if the maps hold the basin cells only (BASIN ONLY
+                    OUTPUT), the arrays are then [time, cell]
+*****************************************************************************/
+void InitZarr(int BasinOnly)
+{
+  Gather = BasinOnly;
+}
+
+/*****************************************************************************
+  Function name: CreateMapFileZarr()
+
+  Purpose      : Create a new store.  If the file or store already exists it
+                 will be overwritten.
+
+  Required     :
+    FileName   - name of the store
+    FileLabel  - title of the store
+    Map        - the model map, for the coordinates of the cells
+    Storage    - chunks and compression of the arrays of a map dump, NULL
+                 for the defaults
+
+  Returns      : void
+
+  Comments     : The storage is kept in the attributes of the group, so
+                 that the arrays a branch or a resumed run adds to the store
+                 get it as well
+*****************************************************************************/
+void CreateMapFileZarr(char *FileName, ...)
+{
+  const char *Routine = "CreateMapFileZarr";
+  va_list ap;
+  char *FileLabel;
+  MAPSIZE *Map;
+  NCSTORAGE *Storage;
+  char Path[BUFSIZE + 1];
+  char Text[ZARR_LINE];
+  char Label[2 * BUFSIZE + 3];
+  double *Coords;
+  int *Index;
+  int n;
+  int i;
+
+  va_start(ap, FileName);
+  FileLabel = va_arg(ap, char *);
+  Map = va_arg(ap, MAPSIZE *);
+  Storage = va_arg(ap, NCSTORAGE *);
+  va_end(ap);
+
+  /* forget the arrays of an earlier store of the same name */
+  for (i = 0, n = 0; i < NArrays; i++)
+    if (strcmp(Arrays[i].Store, FileName) != 0)
+      Arrays[n++] = Arrays[i];
+  NArrays = n;
+
+  RemoveStoreZarr(FileName);
+  if (mkdir(FileName, 0777) != 0)
+    ReportError(FileName, 3);
+
+  JoinPath(Path, FileName, ".zgroup");
+  strcpy(Text, "{\n  \"zarr_format\": 2\n}\n");
+  if (!WriteFile(Path, Text, strlen(Text)))
+    ReportError(Path, 72);
+
+  PutString(Label, sizeof(Label), FileLabel);
+  n = snprintf(Text, sizeof(Text),
+	       "{\n  \"comment\": %s,\n  \"missing_value\": %d", Label, NA);
+  if (Storage != NULL)
+    n += snprintf(Text + n, sizeof(Text) - n,
+		  ",\n  \"dhsvm_storage\": {\"chunks\": [%d, %d, %d], "
+		  "\"deflate\": %d, \"shuffle\": %d}",
+		  Storage->Chunk[0], Storage->Chunk[1], Storage->Chunk[2],
+		  Storage->Deflate, Storage->Shuffle ? 1 : 0);
+  snprintf(Text + n, sizeof(Text) - n, "\n}\n");
+  JoinPath(Path, FileName, ".zattrs");
+  if (!WriteFile(Path, Text, strlen(Text)))
+    ReportError(Path, 72);
+
+  /* the coordinates, as in a NetCDF file */
+  n = (Map->NX > Map->NY) ? Map->NX : Map->NY;
+  if (!(Coords = (double *) malloc(n * sizeof(double))))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < Map->NX; i++)
+    Coords[i] = Map->Xorig + i * Map->DX;
+  WriteCoordinate(FileName, "x", "Easting", "m", NC_DOUBLE, Coords, Map->NX,
+		  NULL);
+  for (i = 0; i < Map->NY; i++)
+    Coords[i] = Map->Yorig - i * Map->DY;
+  WriteCoordinate(FileName, "y", "Northing", "m", NC_DOUBLE, Coords, Map->NY,
+		  NULL);
+  free(Coords);
+
+  if (Gather) {
+    if (!(Index = (int *) malloc((Map->NumActive + 1) * sizeof(int))))
+      ReportError((char *) Routine, 1);
+    for (i = 0; i < Map->NumActive; i++)
+      Index[i] = Map->ActiveCells[ROWCELL(Map, i)].y * Map->NX +
+	Map->ActiveCells[ROWCELL(Map, i)].x;
+    WriteCoordinate(FileName, "cell", "Index of the cells in the basin", "",
+		    NC_INT, Index, Map->NumActive, "y x");
+    free(Index);
+  }
+}
+
+/*****************************************************************************
+  Function name: Read2DMatrixZarr()
+
+  Purpose      : Function to read a 2D array from a file.
+
+  Required     :
+    FileName   - name of input file
+    Matrix     - address of array data into
+    NumberType - code for number type
+    NY         - Number of rows
+    NX         - Number of columns
+    NDataSet   - number of the dataset to read from a binary file
+    VarName    - variable to read from a store
+    index      - record of the variable to read from a store
+
+  Returns      : Number of elements read
+
+  Modifies     : Matrix
+
+  Comments     : A file that is not a store is read with Read2DMatrixBin().
+                 A chunk that has not been written is read as zeros, the
+                 fill value of the arrays.
+*****************************************************************************/
+int Read2DMatrixZarr(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, ...)
+{
+  const char *Routine = "Read2DMatrixZarr";
+  va_list ap;
+  char *VarName;
+  int index;
+  ZARRARRAY Array;
+  size_t ElemSize;
+  size_t RawSize;
+  size_t Per;
+  size_t T;
+  int NCY;
+  int NCX;
+  int NChunks;
+  int Failed = FALSE;
+  int i;
+
+  va_start(ap, NDataSet);
+  VarName = va_arg(ap, char *);
+  index = va_arg(ap, int);
+  va_end(ap);
+
+  if (!IsStoreZarr(FileName))
+    return Read2DMatrixBin(FileName, Matrix, NumberType, NY, NX, NDataSet);
+
+  JoinPath(Array.Path, FileName, VarName);
+  Array.NumberType = NumberType;
+  if (!ReadArray(Array.Path, &Array) || Array.NumberType != NumberType ||
+      Array.Shape[1] != (size_t) NY || Array.Shape[2] != (size_t) NX ||
+      index < 0 || (size_t) index >= Array.Shape[0])
+    ReportError(Array.Path, 88);
+
+  ElemSize = SizeOfNumberType(NumberType);
+  RawSize = Array.Chunk[0] * Array.Chunk[1] * Array.Chunk[2] * ElemSize;
+  NCY = (int) ((NY + Array.Chunk[1] - 1) / Array.Chunk[1]);
+  NCX = (int) ((NX + Array.Chunk[2] - 1) / Array.Chunk[2]);
+  NChunks = NCY * NCX;
+  Per = 2 * RawSize;
+  if (Per * NChunks > ReadSize) {
+    TaggedFree(ReadBuffer);
+    if (!(ReadBuffer = (unsigned char *) TaggedMalloc(Per * NChunks,
+						      MEM_OUTPUT)))
+      ReportError((char *) Routine, 1);
+    ReadSize = Per * NChunks;
+  }
+  T = index / Array.Chunk[0];
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) if (NChunks > 1)
+#endif
+  for (i = 0; i < NChunks; i++) {
+    unsigned char *Raw = ReadBuffer + i * Per;
+    unsigned char *Layer;
+    char Key[BUFSIZE + 1];
+    size_t Count;
+    size_t y0 = (i / NCX) * Array.Chunk[1];
+    size_t x0 = (i % NCX) * Array.Chunk[2];
+    size_t r;
+
+    if (Array.Rank == 3)
+      snprintf(Key, sizeof(Key), "%lu.%d.%d", (unsigned long) T, i / NCX,
+	       i % NCX);
+    else
+      snprintf(Key, sizeof(Key), "%lu.%d", (unsigned long) T, i % NCX);
+    switch (DecodeChunk(&Array, Key, Raw, Raw + RawSize, RawSize)) {
+    case -1:
+      Failed = TRUE;
+      continue;
+    case 0:
+      memset(Raw, 0, RawSize);
+      break;
+    }
+
+    Layer = Raw + (index % Array.Chunk[0]) * Array.Chunk[1] *
+      Array.Chunk[2] * ElemSize;
+    Count = ((size_t) NX - x0 < Array.Chunk[2]) ? NX - x0 : Array.Chunk[2];
+    for (r = 0; r < Array.Chunk[1] && y0 + r < (size_t) NY; r++)
+      memcpy((char *) Matrix + ((y0 + r) * NX + x0) * ElemSize,
+	     Layer + r * Array.Chunk[2] * ElemSize, Count * ElemSize);
+  }
+  if (Failed)
+    ReportError(Array.Path, 88);
+
+  return NY * NX;
+}
+
+/*****************************************************************************
+  Function name: Write2DMatrixZarr()
+
+  Purpose      : Function to write a 2D array to a file
+
+  Required     :
+    FileName   - name of the store
+    Matrix     - address of array containing matrix elements
+    NumberType - code for number type
+    NY         - Number of rows
+    NX         - Number of columns
+    DMap       - the variable of the array to write to
+    index      - record of the array to write
+
+  Returns      : Number of elements written
+
+  Modifies     : the store
+
+  Comments     : The chunks of the record are compressed into WriteBuffer by
+                 the OpenMP threads, each into its own part of the buffer,
+                 and then written by the same thread
+*****************************************************************************/
+int Write2DMatrixZarr(char *FileName, void *Matrix, int NumberType, int NY,
+		      int NX, ...)
+{
+  const char *Routine = "Write2DMatrixZarr";
+  va_list ap;
+  MAPDUMP *DMap;
+  int index;
+  ZARRARRAY *Array;
+  char Path[BUFSIZE + 1];
+  size_t ElemSize;
+  size_t RawSize;
+  size_t Bound;
+  size_t Per;
+  size_t T;
+  int NCY;
+  int NCX;
+  int NChunks;
+  int Failed = FALSE;
+  int i;
+
+  va_start(ap, NX);
+  DMap = va_arg(ap, MAPDUMP *);
+  index = va_arg(ap, int);
+  va_end(ap);
+
+  Array = FindArray(FileName, DMap, NumberType, NY, NX);
+  if (index < 0)
+    ReportError(Array->Path, 88);
+
+  ElemSize = SizeOfNumberType(NumberType);
+  RawSize = Array->Chunk[0] * Array->Chunk[1] * Array->Chunk[2] * ElemSize;
+#ifdef HAVE_ZLIB
+  Bound = (Array->Level > 0) ? compressBound((uLong) RawSize) : 0;
+#else
+  Bound = 0;
+#endif
+  NCY = (int) ((NY + Array->Chunk[1] - 1) / Array->Chunk[1]);
+  NCX = (int) ((NX + Array->Chunk[2] - 1) / Array->Chunk[2]);
+  NChunks = NCY * NCX;
+  Per = 2 * RawSize + Bound;
+  if (Per * NChunks > WriteSize) {
+    TaggedFree(WriteBuffer);
+    if (!(WriteBuffer = (unsigned char *) TaggedMalloc(Per * NChunks,
+						       MEM_OUTPUT)))
+      ReportError((char *) Routine, 1);
+    WriteSize = Per * NChunks;
+  }
+  T = index / Array->Chunk[0];
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) if (NChunks > 1)
+#endif
+  for (i = 0; i < NChunks; i++) {
+    unsigned char *Raw = WriteBuffer + i * Per;
+    unsigned char *Layer;
+    char Key[BUFSIZE + 1];
+    size_t Count;
+    size_t y0 = (i / NCX) * Array->Chunk[1];
+    size_t x0 = (i % NCX) * Array->Chunk[2];
+    size_t r;
+
+    if (Array->Rank == 3)
+      snprintf(Key, sizeof(Key), "%lu.%d.%d", (unsigned long) T, i / NCX,
+	       i % NCX);
+    else
+      snprintf(Key, sizeof(Key), "%lu.%d", (unsigned long) T, i % NCX);
+
+    /* the other records of a time chunk are kept */
+    if (Array->Chunk[0] == 1 ||
+	DecodeChunk(Array, Key, Raw, Raw + RawSize, RawSize) == 0)
+      memset(Raw, 0, RawSize);
+
+    Layer = Raw + (index % Array->Chunk[0]) * Array->Chunk[1] *
+      Array->Chunk[2] * ElemSize;
+    Count = ((size_t) NX - x0 < Array->Chunk[2]) ? NX - x0 : Array->Chunk[2];
+    for (r = 0; r < Array->Chunk[1] && y0 + r < (size_t) NY; r++)
+      memcpy(Layer + r * Array->Chunk[2] * ElemSize,
+	     (char *) Matrix + ((y0 + r) * NX + x0) * ElemSize,
+	     Count * ElemSize);
+
+    if (!EncodeChunk(Array, Key, Raw, Raw + RawSize, Raw + 2 * RawSize,
+		     RawSize, Bound))
+      Failed = TRUE;
+  }
+  if (Failed)
+    ReportError(Array->Path, 72);
+
+  /* the record is there once the shape includes it */
+  if ((size_t) index >= Array->Shape[0]) {
+    Array->Shape[0] = index + 1;
+    WriteArray(Array);
+    JoinPath(Path, Array->Store, ".zmetadata");
+    remove(Path);
+  }
+
+  return NY * NX;
+}
+
+/*****************************************************************************
+  Function name: CloseFilesZarr()
+
+  Purpose      : Write the consolidated metadata of the stores that this
+                 process wrote to, and release the buffers of the chunks
+
+  Comments     : A branch inherits the arrays of the stores of its parent,
+                 which it does not write to, and skips them
+*****************************************************************************/
+void CloseFilesZarr(void)
+{
+  pid_t Pid = getpid();
+  int i;
+  int j;
+
+  for (i = 0; i < NArrays; i++) {
+    if (Arrays[i].Pid != Pid)
+      continue;
+    for (j = 0; j < i; j++)
+      if (Arrays[j].Pid == Pid && strcmp(Arrays[j].Store, Arrays[i].Store) == 0)
+	break;
+    if (j == i)
+      Consolidate(Arrays[i].Store);
+  }
+
+  free(Arrays);
+  Arrays = NULL;
+  NArrays = MaxArrays = 0;
+  TaggedFree(WriteBuffer);
+  TaggedFree(ReadBuffer);
+  WriteBuffer = ReadBuffer = NULL;
+  WriteSize = ReadSize = 0;
+  CloseFilesBin();
+}
+
+/*****************************************************************************
+  Function name: IsStoreZarr()
+
+  Purpose      : TRUE if FileName is the directory of a Zarr group
+*****************************************************************************/
+int IsStoreZarr(char *FileName)
+{
+  char Path[BUFSIZE + 1];
+  struct stat Info;
+
+  JoinPath(Path, FileName, ".zgroup");
+  return IsDirectory(FileName) && stat(Path, &Info) == 0;
+}
+
+/*****************************************************************************
+  Function name: IsGatheredZarr()
+
+  Purpose      : TRUE if the store FileName holds the basin cells only, its
+                 arrays are then [time, cell] with the cell coordinate array
+*****************************************************************************/
+int IsGatheredZarr(char *FileName)
+{
+  char Path[BUFSIZE + 1];
+
+  JoinPath(Path, FileName, "cell");
+  return IsDirectory(Path);
+}
+
+/*****************************************************************************
+  Function name: RemoveStoreZarr()
+
+  Purpose      : Remove the file or store FileName and everything in it
+
+  Comments     : Nothing happens if there is no such file
+*****************************************************************************/
+void RemoveStoreZarr(char *FileName)
+{
+  DIR *Dir;
+  struct dirent *Entry;
+  char Path[BUFSIZE + 1];
+
+  if (!IsDirectory(FileName)) {
+    if (remove(FileName) != 0 && errno != ENOENT)
+      ReportError(FileName, 3);
+    return;
+  }
+  if (!(Dir = opendir(FileName)))
+    ReportError(FileName, 3);
+  while ((Entry = readdir(Dir)) != NULL) {
+    if (strcmp(Entry->d_name, ".") == 0 || strcmp(Entry->d_name, "..") == 0)
+      continue;
+    JoinPath(Path, FileName, Entry->d_name);
+    RemoveStoreZarr(Path);
+  }
+  closedir(Dir);
+  if (rmdir(FileName) != 0)
+    ReportError(FileName, 3);
+}
+
+/*****************************************************************************
+  Function name: CopyStoreZarr()
+
+  Purpose      : Copy the store OldName and everything in it to NewName,
+                 which is removed first (see BranchFile())
+*****************************************************************************/
+void CopyStoreZarr(char *OldName, char *NewName)
+{
+  DIR *Dir;
+  struct dirent *Entry;
+  FILE *InFile;
+  FILE *OutFile;
+  char OldPath[BUFSIZE + 1];
+  char NewPath[BUFSIZE + 1];
+  char Buffer[BUFSIZ];
+  size_t N;
+
+  RemoveStoreZarr(NewName);
+  if (!IsDirectory(OldName)) {
+    if (!(InFile = fopen(OldName, "rb")))
+      ReportError(OldName, 3);
+    if (!(OutFile = fopen(NewName, "wb")))
+      ReportError(NewName, 3);
+    while ((N = fread(Buffer, 1, sizeof(Buffer), InFile)) > 0)
+      if (fwrite(Buffer, 1, N, OutFile) != N)
+	ReportError(NewName, 72);
+    fclose(InFile);
+    if (fclose(OutFile) != 0)
+      ReportError(NewName, 72);
+    return;
+  }
+
+  if (mkdir(NewName, 0777) != 0)
+    ReportError(NewName, 3);
+  if (!(Dir = opendir(OldName)))
+    ReportError(OldName, 3);
+  while ((Entry = readdir(Dir)) != NULL) {
+    if (strcmp(Entry->d_name, ".") == 0 || strcmp(Entry->d_name, "..") == 0)
+      continue;
+    JoinPath(OldPath, OldName, Entry->d_name);
+    JoinPath(NewPath, NewName, Entry->d_name);
+    CopyStoreZarr(OldPath, NewPath);
+  }
+  closedir(Dir);
+}
+
+/*****************************************************************************
+  Function name: FindArray()
+
+  Purpose      : The array of variable DMap->Name of store Store
+
+  Comments     : An array that this process has not written to yet is read
+                 from the store, for the stores of a branch and of a resumed
+                 run, or is added to the store.  It has to match the map.
+*****************************************************************************/
+static ZARRARRAY *FindArray(char *Store, MAPDUMP *DMap, int NumberType,
+			    int NY, int NX)
+{
+  const char *Routine = "FindArray";
+  ZARRARRAY *Array;
+  char Path[BUFSIZE + 1];
+  char *Slash;
+  int i;
+
+  JoinPath(Path, Store, DMap->Name);
+  for (Slash = Path + strlen(Store) + 1; *Slash != '\0'; Slash++)
+    if (*Slash == '/')
+      *Slash = '_';
+  for (i = 0; i < NArrays; i++)
+    if (strcmp(Arrays[i].Path, Path) == 0)
+      return &(Arrays[i]);
+
+  if (NArrays == MaxArrays) {
+    MaxArrays = (MaxArrays > 0) ? 2 * MaxArrays : 16;
+    if (!(Arrays = (ZARRARRAY *) realloc(Arrays,
+					 MaxArrays * sizeof(ZARRARRAY))))
+      ReportError((char *) Routine, 1);
+  }
+  Array = &(Arrays[NArrays]);
+  memset(Array, 0, sizeof(ZARRARRAY));
+  strcpy(Array->Store, Store);
+  strcpy(Array->Path, Path);
+  Array->NumberType = NumberType;
+  Array->Pid = getpid();
+
+  if (!ReadArray(Path, Array)) {
+    if (!IsStoreZarr(Store))
+      ReportError(Store, 88);
+    NewArray(Array, DMap, NY, NX);
+  }
+  if (Array->NumberType != NumberType || Array->Shape[1] != (size_t) NY ||
+      Array->Shape[2] != (size_t) NX)
+    ReportError(Path, 88);
+
+  NArrays++;
+  return Array;
+}
+
+/*****************************************************************************
+  Function name: NewArray()
+
+  Purpose      : Add an empty array for variable DMap to the store
+
+  Comments     : The chunks and the compression are those of the attribute
+                 dhsvm_storage of the group, a chunk size of 0 in y or x
+                 and a deflate level of 0 give the defaults.  With the basin
+                 cells only a chunk holds the cells of a chunk in y and x.
+*****************************************************************************/
+static void NewArray(ZARRARRAY *Array, MAPDUMP *DMap, int NY, int NX)
+{
+  char Path[BUFSIZE + 1];
+  char Text[ZARR_LINE];
+  char Name[2 * BUFSIZE + 3];
+  char Units[2 * BUFSIZE + 3];
+  char *Attrs;
+  const char *Value;
+  size_t Chunk[3] = { 0, 0, 0 };
+  int Deflate = 0;
+  int Shuffle = TRUE;
+
+  JoinPath(Path, Array->Store, ".zattrs");
+  if ((Attrs = ReadText(Path)) != NULL &&
+      (Value = FindKey(Attrs, "dhsvm_storage")) != NULL) {
+    FindList(Value, "chunks", Chunk, 3);
+    if ((Value = FindKey(Attrs, "deflate")) != NULL)
+      Deflate = atoi(Value);
+    if ((Value = FindKey(Attrs, "shuffle")) != NULL)
+      Shuffle = atoi(Value);
+  }
+  free(Attrs);
+
+  Array->Rank = (Gather && NY == 1) ? 2 : 3;
+  Array->Shape[0] = 0;
+  Array->Shape[1] = NY;
+  Array->Shape[2] = NX;
+  Array->Chunk[0] = (Chunk[0] > 0) ? Chunk[0] : 1;
+  if (Chunk[1] == 0)
+    Chunk[1] = ZARR_CHUNK;
+  if (Chunk[2] == 0)
+    Chunk[2] = ZARR_CHUNK;
+  if (Array->Rank == 2) {
+    Array->Chunk[1] = 1;
+    Array->Chunk[2] = Chunk[1] * Chunk[2];
+  }
+  else {
+    Array->Chunk[1] = (Chunk[1] < (size_t) NY) ? Chunk[1] : (size_t) NY;
+    Array->Chunk[2] = Chunk[2];
+  }
+  if (Array->Chunk[2] > (size_t) NX)
+    Array->Chunk[2] = NX;
+#ifdef HAVE_ZLIB
+  Array->Level = (Deflate > 0) ? Deflate : ZARR_LEVEL;
+#else
+  if (Deflate > 0)
+    ReportError(Array->Path, 89);
+  Array->Level = 0;
+#endif
+  Array->Shuffle = Shuffle && SizeOfNumberType(Array->NumberType) > 1;
+
+  if (mkdir(Array->Path, 0777) != 0 && errno != EEXIST)
+    ReportError(Array->Path, 3);
+  PutString(Name, sizeof(Name), DMap->LongName);
+  PutString(Units, sizeof(Units), DMap->Units);
+  snprintf(Text, sizeof(Text),
+	   "{\n  \"_ARRAY_DIMENSIONS\": %s,\n  \"long_name\": %s,\n"
+	   "  \"units\": %s,\n  \"missing_value\": %d\n}\n",
+	   (Array->Rank == 3) ? "[\"time\", \"y\", \"x\"]" :
+	   "[\"time\", \"cell\"]", Name, Units, NA);
+  JoinPath(Path, Array->Path, ".zattrs");
+  if (!WriteFile(Path, Text, strlen(Text)))
+    ReportError(Path, 72);
+  WriteArray(Array);
+}
+
+/*****************************************************************************
+  Function name: ReadArray()
+
+  Purpose      : Read the metadata of the array in directory Path
+
+  Returns      : TRUE, FALSE if there is no such array
+
+  Comments     : Only the arrays this file writes can be read, with the zlib
+                 compressor and the shuffle filter or neither
+*****************************************************************************/
+static int ReadArray(char *Path, ZARRARRAY *Array)
+{
+  char Name[BUFSIZE + 1];
+  char Type[8];
+  char *Meta;
+  const char *Value;
+  size_t Shape[3];
+  size_t Chunk[3];
+  int Rank;
+  int NumberType;
+
+  JoinPath(Name, Path, ".zarray");
+  if (!(Meta = ReadText(Name)))
+    return FALSE;
+
+  Rank = FindList(Meta, "shape", Shape, 3);
+  if (Rank < 2 || FindList(Meta, "chunks", Chunk, 3) != Rank)
+    ReportError(Name, 88);
+  if (Rank == 2) {
+    Shape[2] = Shape[1];
+    Chunk[2] = Chunk[1];
+    Shape[1] = Chunk[1] = 1;
+  }
+  if (Chunk[0] == 0 || Chunk[1] == 0 || Chunk[2] == 0)
+    ReportError(Name, 88);
+
+  /* the number type */
+  if (!(Value = FindKey(Meta, "dtype")))
+    ReportError(Name, 88);
+  for (NumberType = NC_BYTE; NumberType <= NC_DOUBLE; NumberType++) {
+    Dtype(NumberType, Type);
+    if (strncmp(Value + 1, Type, strlen(Type)) == 0)
+      break;
+  }
+  if (NumberType > NC_DOUBLE)
+    ReportError(Name, 88);
+  if (NumberType == NC_BYTE && Array->NumberType == NC_CHAR)
+    NumberType = NC_CHAR;
+
+  Array->Level = 0;
+  if ((Value = FindKey(Meta, "compressor")) != NULL &&
+      strncmp(Value, "null", 4) != 0) {
+    if (!strstr(Value, "\"zlib\"") || !(Value = FindKey(Value, "level")))
+      ReportError(Name, 88);
+    Array->Level = atoi(Value);
+#ifndef HAVE_ZLIB
+    ReportError(Name, 89);
+#endif
+  }
+  Array->Shuffle = (strstr(Meta, "\"shuffle\"") != NULL);
+  free(Meta);
+
+  Array->NumberType = NumberType;
+  Array->Rank = Rank;
+  memcpy(Array->Shape, Shape, sizeof(Shape));
+  memcpy(Array->Chunk, Chunk, sizeof(Chunk));
+  strcpy(Array->Path, Path);
+  return TRUE;
+}
+
+/*****************************************************************************
+  Function name: WriteArray()
+
+  Purpose      : Write the .zarray of Array
+*****************************************************************************/
+static void WriteArray(ZARRARRAY *Array)
+{
+  char Path[BUFSIZE + 1];
+  char Text[ZARR_LINE];
+  char Type[8];
+  char Shape[NAMESIZE + 1];
+  char Chunks[NAMESIZE + 1];
+  char Compressor[NAMESIZE + 1];
+  char Filters[NAMESIZE + 1];
+
+  Dtype(Array->NumberType, Type);
+  if (Array->Rank == 3) {
+    snprintf(Shape, sizeof(Shape), "[%lu, %lu, %lu]",
+	     (unsigned long) Array->Shape[0], (unsigned long) Array->Shape[1],
+	     (unsigned long) Array->Shape[2]);
+    snprintf(Chunks, sizeof(Chunks), "[%lu, %lu, %lu]",
+	     (unsigned long) Array->Chunk[0], (unsigned long) Array->Chunk[1],
+	     (unsigned long) Array->Chunk[2]);
+  }
+  else {
+    snprintf(Shape, sizeof(Shape), "[%lu, %lu]",
+	     (unsigned long) Array->Shape[0], (unsigned long) Array->Shape[2]);
+    snprintf(Chunks, sizeof(Chunks), "[%lu, %lu]",
+	     (unsigned long) Array->Chunk[0], (unsigned long) Array->Chunk[2]);
+  }
+  if (Array->Level > 0)
+    snprintf(Compressor, sizeof(Compressor),
+	     "{\"id\": \"zlib\", \"level\": %d}", Array->Level);
+  else
+    strcpy(Compressor, "null");
+  if (Array->Shuffle)
+    snprintf(Filters, sizeof(Filters),
+	     "[{\"id\": \"shuffle\", \"elementsize\": %d}]",
+	     (int) SizeOfNumberType(Array->NumberType));
+  else
+    strcpy(Filters, "null");
+
+  snprintf(Text, sizeof(Text),
+	   "{\n  \"zarr_format\": 2,\n  \"shape\": %s,\n  \"chunks\": %s,\n"
+	   "  \"dtype\": \"%s\",\n  \"compressor\": %s,\n"
+	   "  \"fill_value\": 0,\n  \"order\": \"C\",\n  \"filters\": %s,\n"
+	   "  \"dimension_separator\": \".\"\n}\n",
+	   Shape, Chunks, Type, Compressor, Filters);
+  JoinPath(Path, Array->Path, ".zarray");
+  if (!WriteFile(Path, Text, strlen(Text)))
+    ReportError(Path, 72);
+}
+
+/*****************************************************************************
+  Function name: DecodeChunk()
+
+  Purpose      : Read and expand chunk Key of Array into the RawSize bytes of
+                 Raw, with Work as scratch space of the same size
+
+  Returns      : 1, 0 if the chunk has not been written, -1 if it is corrupt
+
+  Comments     : Called by the OpenMP threads
+*****************************************************************************/
+static int DecodeChunk(ZARRARRAY *Array, char *Key, unsigned char *Raw,
+		       unsigned char *Work, size_t RawSize)
+{
+  FILE *InFile;
+  char Path[BUFSIZE + 1];
+  unsigned char *Data;
+  unsigned char *Packed = NULL;
+  size_t ElemSize;
+  size_t NElems;
+  size_t Size;
+  long Length;
+  size_t e;
+  size_t j;
+
+  JoinPath(Path, Array->Path, Key);
+  if (!(InFile = fopen(Path, "rb")))
+    return 0;
+  if (fseek(InFile, 0L, SEEK_END) || (Length = ftell(InFile)) < 0 ||
+      fseek(InFile, 0L, SEEK_SET)) {
+    fclose(InFile);
+    return -1;
+  }
+  Size = (size_t) Length;
+
+  /* the stored bytes go where the next step puts its result */
+  Data = Array->Shuffle ? Work : Raw;
+  if (Array->Level > 0) {
+    if (!(Packed = (unsigned char *) malloc(Size + 1))) {
+      fclose(InFile);
+      return -1;
+    }
+    if (fread(Packed, 1, Size, InFile) != Size) {
+      fclose(InFile);
+      free(Packed);
+      return -1;
+    }
+#ifdef HAVE_ZLIB
+    {
+      uLongf Expanded = (uLongf) RawSize;
+
+      if (uncompress(Data, &Expanded, Packed, (uLong) Size) != Z_OK ||
+	  Expanded != RawSize) {
+	fclose(InFile);
+	free(Packed);
+	return -1;
+      }
+    }
+#endif
+    free(Packed);
+  }
+  else if (Size != RawSize || fread(Data, 1, Size, InFile) != Size) {
+    fclose(InFile);
+    return -1;
+  }
+  fclose(InFile);
+
+  /* the bytes of an element are spread over the chunk */
+  if (Array->Shuffle) {
+    ElemSize = SizeOfNumberType(Array->NumberType);
+    NElems = RawSize / ElemSize;
+    for (j = 0; j < ElemSize; j++)
+      for (e = 0; e < NElems; e++)
+	Raw[e * ElemSize + j] = Work[j * NElems + e];
+  }
+  return 1;
+}
+
+/*****************************************************************************
+  Function name: EncodeChunk()
+
+  Purpose      : Shuffle and compress the RawSize bytes of chunk Key of Array
+                 in Raw and write them, with Work as scratch space of the
+                 same size and Out of Bound bytes for the compressed chunk
+
+  Returns      : TRUE, FALSE if the chunk could not be written
+
+  Comments     : Called by the OpenMP threads
+*****************************************************************************/
+static int EncodeChunk(ZARRARRAY *Array, char *Key, unsigned char *Raw,
+		       unsigned char *Work, unsigned char *Out, size_t RawSize,
+		       size_t Bound)
+{
+  char Path[BUFSIZE + 1];
+  unsigned char *Data = Raw;
+  size_t Size = RawSize;
+  size_t ElemSize;
+  size_t NElems;
+  size_t e;
+  size_t j;
+
+  if (Array->Shuffle) {
+    ElemSize = SizeOfNumberType(Array->NumberType);
+    NElems = RawSize / ElemSize;
+    for (j = 0; j < ElemSize; j++)
+      for (e = 0; e < NElems; e++)
+	Work[j * NElems + e] = Raw[e * ElemSize + j];
+    Data = Work;
+  }
+
+#ifdef HAVE_ZLIB
+  if (Array->Level > 0) {
+    uLongf Packed = (uLongf) Bound;
+
+    if (compress2(Out, &Packed, Data, (uLong) RawSize, Array->Level) != Z_OK)
+      return FALSE;
+    Data = Out;
+    Size = (size_t) Packed;
+  }
+#endif
+
+  JoinPath(Path, Array->Path, Key);
+  return WriteFile(Path, Data, Size);
+}
+
+/*****************************************************************************
+  Function name: WriteCoordinate()
+
+  Purpose      : Write the N Values of coordinate Name of a store as a one
+                 dimensional array in one uncompressed chunk
+
+  Comments     : Compress is the dimensions that a cell index refers to, NULL
+                 for the easting and the northing
+*****************************************************************************/
+static void WriteCoordinate(char *Store, char *Name, char *LongName,
+			    char *Units, int NumberType, void *Values, int N,
+			    char *Compress)
+{
+  char Path[BUFSIZE + 1];
+  char Key[BUFSIZE + 1];
+  char Text[ZARR_LINE];
+  char Type[8];
+  int n;
+
+  JoinPath(Path, Store, Name);
+  if (mkdir(Path, 0777) != 0)
+    ReportError(Path, 3);
+
+  Dtype(NumberType, Type);
+  snprintf(Text, sizeof(Text),
+	   "{\n  \"zarr_format\": 2,\n  \"shape\": [%d],\n  \"chunks\": [%d],\n"
+	   "  \"dtype\": \"%s\",\n  \"compressor\": null,\n"
+	   "  \"fill_value\": 0,\n  \"order\": \"C\",\n  \"filters\": null,\n"
+	   "  \"dimension_separator\": \".\"\n}\n", N, (N > 0) ? N : 1, Type);
+  JoinPath(Key, Path, ".zarray");
+  if (!WriteFile(Key, Text, strlen(Text)))
+    ReportError(Key, 72);
+
+  n = snprintf(Text, sizeof(Text),
+	       "{\n  \"_ARRAY_DIMENSIONS\": [\"%s\"],\n  \"long_name\": \"%s\","
+	       "\n  \"units\": \"%s\"", Name, LongName, Units);
+  if (Compress != NULL)
+    n += snprintf(Text + n, sizeof(Text) - n, ",\n  \"compress\": \"%s\"",
+		  Compress);
+  snprintf(Text + n, sizeof(Text) - n, "\n}\n");
+  JoinPath(Key, Path, ".zattrs");
+  if (!WriteFile(Key, Text, strlen(Text)))
+    ReportError(Key, 72);
+
+  JoinPath(Key, Path, "0");
+  if (N > 0 && !WriteFile(Key, Values, (size_t) N * SizeOfNumberType(NumberType)))
+    ReportError(Key, 72);
+}
+
+/*****************************************************************************
+  Function name: Consolidate()
+
+  Purpose      : Write .zmetadata, the metadata of the group and of all its
+                 arrays in one file, so that a reader of an object store
+                 needs one request to open the store
+*****************************************************************************/
+static void Consolidate(char *Store)
+{
+  FILE *OutFile;
+  DIR *Dir;
+  struct dirent *Entry;
+  char Path[BUFSIZE + 1];
+  char Key[BUFSIZE + 1];
+  char TmpName[BUFSIZE + 1];
+  char *Text;
+  const char *Meta[2] = { ".zarray", ".zattrs" };
+  int m;
+
+  if (!IsStoreZarr(Store) || !(Dir = opendir(Store)))
+    return;
+  JoinPath(Path, Store, ".zmetadata");
+  snprintf(TmpName, BUFSIZE + 1, "%s.tmp", Path);
+  if (!(OutFile = fopen(TmpName, "w")))
+    ReportError(TmpName, 3);
+
+  fprintf(OutFile, "{\n  \"metadata\": {\n");
+  JoinPath(Key, Store, ".zgroup");
+  Text = ReadText(Key);
+  fprintf(OutFile, "    \".zgroup\": %s", Text ? Text : "{}");
+  free(Text);
+  JoinPath(Key, Store, ".zattrs");
+  if ((Text = ReadText(Key)) != NULL)
+    fprintf(OutFile, ",\n    \".zattrs\": %s", Text);
+  free(Text);
+
+  while ((Entry = readdir(Dir)) != NULL) {
+    if (Entry->d_name[0] == '.')
+      continue;
+    for (m = 0; m < 2; m++) {
+      snprintf(Key, BUFSIZE + 1, "%s/%s/%s", Store, Entry->d_name, Meta[m]);
+      if ((Text = ReadText(Key)) != NULL)
+	fprintf(OutFile, ",\n    \"%s/%s\": %s", Entry->d_name, Meta[m], Text);
+      free(Text);
+    }
+  }
+  closedir(Dir);
+  fprintf(OutFile, "\n  },\n  \"zarr_consolidated_format\": 1\n}\n");
+
+  if (fclose(OutFile) != 0 || rename(TmpName, Path) != 0)
+    ReportError(Path, 72);
+}
@@ -9,6 +9,9 @@
  * DESCRIPTION:  File and I/O functions
  * DESCRIP-END.
  * FUNCTIONS:    OpenFile() 
+ *               BranchFile() 
+ *               SetAsideFile() 
+ *               ResumeFile() 
  *               ScanInts() 
  *               ScanFloats() 
  *               SkipLines()             
@@ -31,6 +34,7 @@
 #include "functions.h"
 #include "constants.h"
 #include "fileio.h"
+#include "fifozarr.h"
 
 /*****************************************************************************
   OpenFile()
@@ -51,6 +55,113 @@ void OpenFile(FILE **FilePtr, char *FileName, char *Mode, uchar OverWrite)
 
 }
 
+/*****************************************************************************
+  BranchFile()
+
+  Copy the output file OldName to NewName.  If FilePtr is not NULL, the
+  stream open on OldName is closed and replaced by the new file, positioned
+  at its end.  Used by the branches of a run (see dhsvm_fork()), which
+  continue the output written before the branch point in a file of their
+  own.  The stream has to be flushed before the process is forked.  A Zarr
+  store (FILE FORMAT ZARR) is copied with everything in it.
+*****************************************************************************/
+void BranchFile(FILE **FilePtr, char *OldName, char *NewName)
+{
+  FILE *InFile;
+  FILE *OutFile;
+  char Buffer[BUFSIZ];
+  size_t N;
+
+  if (FilePtr != NULL && *FilePtr != NULL)
+    fclose(*FilePtr);
+
+  if (IsStoreZarr(OldName)) {
+    CopyStoreZarr(OldName, NewName);
+    return;
+  }
+
+  OpenFile(&InFile, OldName, "rb", TRUE);
+  OpenFile(&OutFile, NewName, "wb", TRUE);
+  while ((N = fread(Buffer, 1, sizeof(Buffer), InFile)) > 0)
+    if (fwrite(Buffer, 1, N, OutFile) != N)
+      ReportError(NewName, 72);
+  fclose(InFile);
+
+  if (FilePtr != NULL)
+    *FilePtr = OutFile;
+  else if (fclose(OutFile) != 0)
+    ReportError(NewName, 72);
+}
+
+/*****************************************************************************
+  SetAsideFile()
+
+  Rename the output file FileName to FileName.resume, so that the output of
+  a resumed run is not lost when its files are created again (see
+  ResumeFile()).  A .resume file left by an earlier attempt to resume is
+  kept, since FileName may already have been created again.
+*****************************************************************************/
+void SetAsideFile(char *FileName)
+{
+  char AsideName[BUFSIZE + 1];
+  struct stat FileInfo;
+
+  snprintf(AsideName, BUFSIZE + 1, "%s%s", FileName, RESUME_SUFFIX);
+  if (stat(AsideName, &FileInfo) == 0)
+    return;
+  if (rename(FileName, AsideName) != 0)
+    ReportError(FileName, 3);
+}
+
+/*****************************************************************************
+  ResumeFile()
+
+  Replace the output file FileName, created again by the initialization of
+  a resumed run, with the first Length bytes of the copy SetAsideFile()
+  made, or all of it if Length is negative.  If FilePtr is not NULL, the
+  stream open on FileName is closed and replaced by the new file,
+  positioned at its end, as with BranchFile().  A Zarr store is replaced by
+  the whole copy, its records after the checkpoint are written again.
+*****************************************************************************/
+void ResumeFile(FILE **FilePtr, char *FileName, long Length)
+{
+  FILE *InFile;
+  FILE *OutFile;
+  char AsideName[BUFSIZE + 1];
+  char Buffer[BUFSIZ];
+  size_t N;
+
+  if (FilePtr != NULL && *FilePtr != NULL)
+    fclose(*FilePtr);
+
+  snprintf(AsideName, BUFSIZE + 1, "%s%s", FileName, RESUME_SUFFIX);
+  if (IsStoreZarr(AsideName)) {
+    RemoveStoreZarr(FileName);
+    if (rename(AsideName, FileName) != 0)
+      ReportError(FileName, 3);
+    return;
+  }
+  OpenFile(&InFile, AsideName, "rb", TRUE);
+  OpenFile(&OutFile, FileName, "wb", TRUE);
+  while (Length != 0 &&
+	 (N = fread(Buffer, 1, (Length > 0 && Length < (long) sizeof(Buffer)) ?
+		    (size_t) Length : sizeof(Buffer), InFile)) > 0) {
+    if (fwrite(Buffer, 1, N, OutFile) != N)
+      ReportError(FileName, 72);
+    if (Length > 0)
+      Length -= (long) N;
+  }
+  fclose(InFile);
+  if (Length > 0)
+    ReportError(AsideName, 76);
+  remove(AsideName);
+
+  if (FilePtr != NULL)
+    *FilePtr = OutFile;
+  else if (fclose(OutFile) != 0)
+    ReportError(FileName, 72);
+}
+
 /*****************************************************************************
   ScanUChars()
 *****************************************************************************/
@@ -27,6 +27,7 @@
  * FUNCTIONS:    GetInitString()
  *               GetInitLong()
  *               GetInitDouble()
+ *               FindInitEntry()
  *               LocateKey()
  *               LocateSection()
  *               Strip()
@@ -38,6 +39,10 @@
  *               CopyUChar()
  *               IsEmptyStr()
  *               ReadInitFile()
+ *               BuildInitIndex()
+ *               InitIndexHash()
+ *               FindInitIndex()
+ *               FreeInitIndex()
  *               CreateNode()
  *               DeleteList()
  *               CountLines()
@@ -56,18 +61,17 @@
 #include "fileio.h"
 #include "getinit.h"
 
+static unsigned char FindInitEntry(const char *Section, const char *Key,
+				   char *Entry, LISTPTR Input);
+static unsigned long InitIndexHash(const char *Section, const char *Key);
+static INITKEY *FindInitIndex(INITINDEX *Index, const char *Section,
+			      const char *Key, unsigned long Hash);
+
 unsigned long GetInitString(const char *Section, const char *Key,
 			    const char *Default, char *ReturnBuffer,
 			    unsigned long BufferSize, LISTPTR Input)
 {
-  LISTPTR SectionHead = NULL;
-
-  if ((SectionHead = LocateSection(Section, Input)) == NULL) {
-    strncpy(ReturnBuffer, Default, BufferSize);
-    return (unsigned long) strlen(ReturnBuffer);
-  }
-
-  if (!LocateKey(Key, ReturnBuffer, SectionHead)) {
+  if (!FindInitEntry(Section, Key, ReturnBuffer, Input)) {
     strncpy(ReturnBuffer, Default, BufferSize);
     return (unsigned long) strlen(ReturnBuffer);
   }
@@ -78,16 +82,11 @@ unsigned long GetInitString(const char *Section, const char *Key,
 long GetInitLong(const char *Section, const char *Key, long Default,
 		 LISTPTR Input)
 {
-  LISTPTR SectionHead = NULL;
   char Buffer[BUFSIZE + 1];
   char *EndPtr = NULL;
   long Entry;
 
-  if ((SectionHead = LocateSection(Section, Input)) == NULL) {
-    return Default;
-  }
-
-  if (!LocateKey(Key, Buffer, SectionHead)) {
+  if (!FindInitEntry(Section, Key, Buffer, Input)) {
     return Default;
   }
 
@@ -102,16 +101,11 @@ long GetInitLong(const char *Section, const char *Key, long Default,
 double GetInitDouble(const char *Section, const char *Key, double Default,
 		     LISTPTR Input)
 {
-  LISTPTR SectionHead = NULL;
   char Buffer[BUFSIZE + 1];
   char *EndPtr = NULL;
   double Entry;
 
-  if ((SectionHead = LocateSection(Section, Input)) == NULL) {
-    return Default;
-  }
-
-  if (!LocateKey(Key, Buffer, SectionHead)) {
+  if (!FindInitEntry(Section, Key, Buffer, Input)) {
     return Default;
   }
 
@@ -122,6 +116,31 @@ double GetInitDouble(const char *Section, const char *Key, double Default,
 
   return (Entry);
 }
+/*#####################################################################################
+ Find the entry for Key in the first section named Section.  The index built by
+ ReadInitFile() is used if the list has one, otherwise the list is searched 
+ with LocateSection() and LocateKey()
+ #####################################################################################*/
+static unsigned char FindInitEntry(const char *Section, const char *Key,
+				   char *Entry, LISTPTR Input)
+{
+  LISTPTR SectionHead = NULL;
+  INITKEY *Found = NULL;
+
+  if (Input != NULL && Input->Index != NULL) {
+    Found = FindInitIndex(Input->Index, Section, Key,
+			  InitIndexHash(Section, Key));
+    if (Found == NULL)
+      return FALSE;
+    memmove(Entry, Found->Value, strlen(Found->Value) + 1);
+    return TRUE;
+  }
+
+  if ((SectionHead = LocateSection(Section, Input)) == NULL)
+    return FALSE;
+
+  return LocateKey(Key, Entry, SectionHead);
+}
 /*#####################################################################################
  This function is used to find the matching key word in the input file for the "key" 
  specified in the fucntion: InitVegTable( )
@@ -440,8 +459,145 @@ void ReadInitFile(char *TemplateFileName, LISTPTR * Input)
 
   fclose(InFile);
 
+  if (Head != NULL)
+    Head->Index = BuildInitIndex(Head);
+
   return;
 }
+/*#####################################################################################
+ Build a hash table of the (section, key) pairs in the list, so that GetInitString()
+ and friends do not have to walk the list for every lookup.  Section and key names 
+ are stored as LocateSection() and LocateKey() compare them.  Only the first 
+ section with a given name and the first occurrence of a key in it are stored, 
+ because those are the ones the list search finds.  Lines before the first 
+ section are never found and are left out.
+ #####################################################################################*/
+INITINDEX *BuildInitIndex(LISTPTR Input)
+{
+  INITINDEX *Index = NULL;
+  INITKEY *Slot = NULL;
+  LISTPTR Current = NULL;
+  char Buffer[BUFSIZE + 1];
+  char *StrPtr = NULL;
+  char *Section = NULL;		/* current section, NULL if a repeat */
+  unsigned long NLines = 0;
+  unsigned long Hash;
+
+  for (Current = Input; Current != NULL; Current = Current->Next)
+    NLines++;
+
+  if ((Index = calloc(1, sizeof(INITINDEX))) == NULL)
+    ReportError("BuildInitIndex", 1);
+  for (Index->Size = 16; Index->Size < 2 * NLines; Index->Size *= 2)
+    ;
+  if ((Index->Slot = calloc(Index->Size, sizeof(INITKEY))) == NULL)
+    ReportError("BuildInitIndex", 1);
+
+  for (Current = Input; Current != NULL; Current = Current->Next) {
+    strncpy(Buffer, Current->Str, BUFSIZE);
+    Buffer[BUFSIZE] = '\0';
+    if (IsSection(Buffer)) {
+      Section = NULL;
+      *strchr(Buffer, CLOSESECTION) = '\0';
+      memmove(Buffer, &Buffer[1], strlen(Buffer));
+      Strip(Buffer);
+      MakeKeyString(Buffer);
+      Hash = InitIndexHash(Buffer, NULL);
+      if (FindInitIndex(Index, Buffer, NULL, Hash) != NULL)
+	continue;
+      /* slot for the section itself */
+      Slot = &(Index->Slot[Hash & (Index->Size - 1)]);
+      while (Slot->Section != NULL)
+	Slot = (Slot == &(Index->Slot[Index->Size - 1])) ? Index->Slot : Slot + 1;
+      if ((Slot->Section = malloc(strlen(Buffer) + 1)) == NULL)
+	ReportError("BuildInitIndex", 1);
+      strcpy(Slot->Section, Buffer);
+      Slot->Hash = Hash;
+      Section = Slot->Section;
+    }
+    else if (Section != NULL && IsKeyEntryPair(Buffer)) {
+      StrPtr = strchr(Buffer, SEPARATOR);
+      *StrPtr++ = '\0';
+      Strip(Buffer);
+      MakeKeyString(Buffer);
+      Strip(StrPtr);
+      Hash = InitIndexHash(Section, Buffer);
+      if (FindInitIndex(Index, Section, Buffer, Hash) != NULL)
+	continue;
+      Slot = &(Index->Slot[Hash & (Index->Size - 1)]);
+      while (Slot->Section != NULL)
+	Slot = (Slot == &(Index->Slot[Index->Size - 1])) ? Index->Slot : Slot + 1;
+      if ((Slot->Key = malloc(strlen(Buffer) + 1)) == NULL ||
+	  (Slot->Value = malloc(strlen(StrPtr) + 1)) == NULL)
+	ReportError("BuildInitIndex", 1);
+      strcpy(Slot->Key, Buffer);
+      strcpy(Slot->Value, StrPtr);
+      Slot->Section = Section;
+      Slot->Hash = Hash;
+    }
+  }
+
+  return Index;
+}
+/*#####################################################################################
+ FNV-1a hash of a section name and a key, Key is NULL for the section itself
+ #####################################################################################*/
+static unsigned long InitIndexHash(const char *Section, const char *Key)
+{
+  unsigned long Hash = 2166136261UL;
+
+  while (*Section != '\0') {
+    Hash ^= (unsigned char) *Section++;
+    Hash = (Hash * 16777619UL) & 0xffffffffUL;
+  }
+  if (Key != NULL) {
+    Hash ^= (unsigned char) CLOSESECTION;
+    Hash = (Hash * 16777619UL) & 0xffffffffUL;
+    while (*Key != '\0') {
+      Hash ^= (unsigned char) *Key++;
+      Hash = (Hash * 16777619UL) & 0xffffffffUL;
+    }
+  }
+
+  return Hash;
+}
+/*#####################################################################################
+ Find the entry for (Section, Key) in the index, Key is NULL for the section itself.
+ Returns NULL if there is no such entry
+ #####################################################################################*/
+static INITKEY *FindInitIndex(INITINDEX *Index, const char *Section,
+			      const char *Key, unsigned long Hash)
+{
+  INITKEY *Slot = NULL;
+
+  Slot = &(Index->Slot[Hash & (Index->Size - 1)]);
+  while (Slot->Section != NULL) {
+    if (Slot->Hash == Hash && strcmp(Slot->Section, Section) == 0 &&
+	((Key == NULL && Slot->Key == NULL) ||
+	 (Key != NULL && Slot->Key != NULL && strcmp(Slot->Key, Key) == 0)))
+      return Slot;
+    Slot = (Slot == &(Index->Slot[Index->Size - 1])) ? Index->Slot : Slot + 1;
+  }
+
+  return NULL;
+}
+/*#####################################################################################*/
+void FreeInitIndex(INITINDEX *Index)
+{
+  unsigned long i;
+
+  if (Index == NULL)
+    return;
+
+  for (i = 0; i < Index->Size; i++) {
+    if (Index->Slot[i].Section != NULL && Index->Slot[i].Key == NULL)
+      free(Index->Slot[i].Section);
+    free(Index->Slot[i].Key);
+    free(Index->Slot[i].Value);
+  }
+  free(Index->Slot);
+  free(Index);
+}
 /*#####################################################################################*/
 LISTPTR CreateNode(void)
 {
@@ -459,6 +615,9 @@ void DeleteList(LISTPTR Head)
 {
   LISTPTR Current = NULL;
 
+  if (Head != NULL)
+    FreeInitIndex(Head->Index);
+
   Current = Head;
   while (Current != NULL) {
     Head = Head->Next;
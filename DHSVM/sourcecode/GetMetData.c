@@ -27,17 +27,23 @@
    GetMetData()
  *****************************************************************************/
 void GetMetData(OPTIONSTRUCT *Options, TIMESTRUCT *Time, int NSoilLayers,
-  int NStats, float SunMax, METLOCATION *Stat, MAPSIZE *Radar,
-  RADARPIX **RadarMap, char *RadarFileName)
+  int NStats, SOLARGEOMETRY *SolarGeo, METLOCATION *Stat, MAPSIZE *Radar,
+  float *RadarMap, char *RadarFileName)
 {
+  float SunMax = SolarGeo->SunMax;
   int i;			/* counter */
 
   if (DEBUG)
     printf("Reading all met data for current timestep\n");
 
-  for (i = 0; i < NStats; i++)
-    ReadMetRecord(Options, &(Time->Current), NSoilLayers, &(Stat[i].MetFile),
-      Stat[i].IsWindModelLocation, &(Stat[i].Data));
+  /* records at a coarser interval than the time step are interpolated */
+  if (Options->MetInterval > 0)
+    InterpolateMetData(Options, Time, NSoilLayers, NStats, Stat, SolarGeo);
+  else
+    ReadMetRecords(Options, &(Time->Current), NSoilLayers, NStats, Stat);
+
+  /* the forcing of an ensemble member, before the shortwave is split */
+  PerturbMetData(Options, Time, NStats, Stat);
 
   if (Options->PrecipType == RADAR)
     ReadRadarMap(&(Time->Current), &(Time->StartRadar), Time->Dt, Radar,
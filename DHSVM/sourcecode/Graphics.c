@@ -0,0 +1,697 @@
+/*
+ * SUMMARY:      Graphics.c - Frames of the graphics
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Take the graphics (NUMBER OF GRAPHICS, GRAPHICS ID) of the
+ *               model state every GRAPHICS INTERVAL time steps and draw them
+ *               to the X11 display or write them as PNG images
+ * DESCRIP-END.
+ * FUNCTIONS:    InitGraphics()
+ *               UpdateGraphics()
+ *               CloseGraphics()
+ *               GraphicsPalette()
+ *               GraphicsColor()
+ *               MakeFrame()
+ *               RenderFrame()
+ *               RendererThread()
+ *               WriteFrameImage()
+ *               WritePNG()
+ * COMMENTS:     With GRAPHICS MODE = DIRECT the frame is drawn by the model
+ *               loop, as DHSVM always did.  With THREAD (X11) or IMAGE (PNG
+ *               files in the output directory) the model only fills a
+ *               frame, downsampled to the resolution it is shown at, and
+ *               publishes it to a renderer thread through three frames
+ *               that are swapped with atomic exchanges: the model never
+ *               waits for the renderer, a frame that the renderer was too
+ *               slow to take is replaced by the next one (and counted).
+ *               Without HAVE_PTHREAD the frames are rendered by the model
+ *               loop
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#include <time.h>
+#endif
+#ifdef HAVE_X11
+#include <X11/Xlib.h>
+#endif
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "fileio.h"
+#include "functions.h"
+#include "graphics.h"
+
+#define NFRAMES 3		/* model, renderer and ready frame */
+#define FRESH   4		/* flag of a ready frame not yet rendered */
+
+static int Active = FALSE;	/* TRUE if there is something to draw to */
+static int Mode = GRAPHICS_DIRECT;
+static int Interval = 1;
+static int Count = 0;		/* time steps since the start of the run */
+static float **Field = NULL;	/* filled graphic at the grid resolution */
+static GRAPHICSFRAME Frames[NFRAMES];
+static int Back = 0;		/* frame filled by the model */
+static long NPublished = 0;	/* frames filled by the model */
+static long NRendered = 0;	/* frames drawn or written */
+static long NDropped = 0;	/* frames replaced before they were rendered */
+
+/* PNG images (GRAPHICS MODE = IMAGE) */
+static char ImagePath[BUFSIZE + 1];
+static FILE *FrameFile = NULL;	/* Graphics.Frames, date and range of
+				   the images */
+static int Zoom = 1;		/* image pixels per panel value */
+static int ImageColumns = 1;
+static int ImageNX = 0;
+static int ImageNY = 0;
+static unsigned char *Image = NULL;	/* RGB pixels, row by row */
+
+#ifdef HAVE_PTHREAD
+static int Threaded = FALSE;	/* TRUE if the renderer thread is running */
+static pthread_t Renderer;
+static int Ready = 2;		/* frame ready for the renderer, | FRESH if
+				   it has not been rendered */
+static int Stop = FALSE;	/* set at the end of the run */
+static void *RendererThread(void *Arg);
+#endif
+
+static void MakeFrame(GRAPHICSFRAME *Frame, DATE *Day, int DayStep,
+		      MAPSIZE *Map, int NGraphics, int *which_graphics,
+		      VEGTABLE *VType, SOILTABLE *SType, SNOWPIX **SnowMap,
+		      SOILPIX **SoilMap, VEGPIX **VegMap, TOPOPIX **TopoMap,
+		      PRECIPPIX **PrecipMap, float **PrismMap,
+		      STATICMAP *SkyViewMap, unsigned char ***ShadowMap,
+		      EVAPPIX **EvapMap, PIXRAD **RadMap, MET_MAP_PIX **MetMap,
+		      OPTIONSTRUCT *Options);
+static void RenderFrame(GRAPHICSFRAME *Frame);
+static void WriteFrameImage(GRAPHICSFRAME *Frame);
+static void WritePNG(char *FileName, int Width, int Height,
+		     unsigned char *RGB);
+
+/*****************************************************************************
+  Function name: InitGraphics()
+
+  Purpose      : Set up the graphics of the run
+
+  Required     :
+    int argc, char **argv - command line, for the X11 display
+    MAPSIZE *Map          - basin grid
+    int NGraphics         - number of graphics
+    DUMPSTRUCT *Dump      - GraphicsMode, GraphicsInterval and the output
+                            directory for the images
+
+  Returns      : void
+
+  Modifies     : MetMap, the met fields of the graphics (MakeLocalMetData())
+
+  Comments     : IMAGE runs without a display, the panels are at most
+                 GRAPHICS_IMAGE_SIZE values on a side
+*****************************************************************************/
+void InitGraphics(int argc, char **argv, MAPSIZE *Map, int NGraphics,
+		  DUMPSTRUCT *Dump, MET_MAP_PIX ***MetMap)
+{
+  const char *Routine = "InitGraphics";
+  char FileName[BUFSIZE + 1];
+  int Step;
+  int i;
+  int y;
+
+  Mode = Dump->GraphicsMode;
+  Interval = Dump->GraphicsInterval;
+  Count = 0;
+
+  /* the met fields are filled by MakeLocalMetData() if a graphic or a state
+     dump reads them (DIAG_METMAP, see InitDiagnostics()) */
+  if (!((*MetMap) = (MET_MAP_PIX **) calloc(Map->NY, sizeof(MET_MAP_PIX *))))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < Map->NY; y++) {
+    if (!((*MetMap)[y] = (MET_MAP_PIX *) calloc(Map->NX, sizeof(MET_MAP_PIX))))
+      ReportError((char *) Routine, 1);
+  }
+
+  if (Mode == GRAPHICS_IMAGE) {
+    Step = (((Map->NY > Map->NX) ? Map->NY : Map->NX) + GRAPHICS_IMAGE_SIZE - 1)
+      / GRAPHICS_IMAGE_SIZE;
+    if (Step < 1)
+      Step = 1;
+    strcpy(ImagePath, Dump->Path);
+    sprintf(FileName, "%sGraphics.Frames", Dump->Path);
+    OpenFile(&FrameFile, FileName, "w", TRUE);
+    printf("Writing the graphics every %d time steps to %sGraphics.*.png\n",
+	   Interval, Dump->Path);
+  }
+  else {
+#if defined(HAVE_X11) && defined(HAVE_PTHREAD)
+    if (Mode == GRAPHICS_THREAD)
+      XInitThreads();
+#endif
+    printf("Initialzing X11 display and graphics \n");
+    Step = InitXGraphics(argc, argv, Map->NY, Map->NX, NGraphics);
+    if (Step == 0) {
+      printf("No graphics, DHSVM was built without HAVE_X11\n");
+      return;
+    }
+  }
+
+  if (!(Field = (float **) calloc(Map->NY, sizeof(float *))))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < Map->NY; y++) {
+    if (!(Field[y] = (float *) calloc(Map->NX, sizeof(float))))
+      ReportError((char *) Routine, 1);
+  }
+
+  for (i = 0; i < NFRAMES; i++) {
+    Frames[i].NGraphics = 0;
+    Frames[i].MapNY = Map->NY;
+    Frames[i].MapNX = Map->NX;
+    Frames[i].Step = Step;
+    Frames[i].NY = Map->NY / Step;
+    Frames[i].NX = Map->NX / Step;
+    if (!(Frames[i].MapNumber = (int *) calloc(NGraphics, sizeof(int))) ||
+	!(Frames[i].Title = (char **) calloc(NGraphics, sizeof(char *))) ||
+	!(Frames[i].Length = (int *) calloc(NGraphics, sizeof(int))) ||
+	!(Frames[i].Min = (float *) calloc(NGraphics, sizeof(float))) ||
+	!(Frames[i].Max = (float *) calloc(NGraphics, sizeof(float))) ||
+	!(Frames[i].Values = (float *) calloc((size_t) NGraphics *
+					      Frames[i].NY * Frames[i].NX,
+					      sizeof(float))))
+      ReportError((char *) Routine, 1);
+  }
+
+  if (Mode == GRAPHICS_IMAGE) {
+    Zoom = GRAPHICS_IMAGE_SIZE /
+      ((Frames[0].NY > Frames[0].NX) ? Frames[0].NY : Frames[0].NX);
+    if (Zoom < 1)
+      Zoom = 1;
+    ImageColumns = (int) ceil(sqrt((double) NGraphics));
+    /* each panel has 10 pixels around it and the color bar on the right */
+    ImageNX = ImageColumns * (Frames[0].NX * Zoom + 40) + 10;
+    ImageNY = ((NGraphics + ImageColumns - 1) / ImageColumns) *
+      (Frames[0].NY * Zoom + 20) + 10;
+    if (!(Image = (unsigned char *) malloc((size_t) 3 * ImageNX * ImageNY)))
+      ReportError((char *) Routine, 1);
+  }
+
+  Back = 0;
+  NPublished = NRendered = NDropped = 0;
+  Active = TRUE;
+
+#ifdef HAVE_PTHREAD
+  if (Mode != GRAPHICS_DIRECT) {
+    Ready = 2;
+    Stop = FALSE;
+    if (pthread_create(&Renderer, NULL, RendererThread, NULL) != 0)
+      ReportError((char *) Routine, 1);
+    Threaded = TRUE;
+    printf("Rendering the graphics on a separate thread\n");
+  }
+#else
+  if (Mode != GRAPHICS_DIRECT)
+    printf("Rendering the graphics in the model loop, DHSVM was built "
+	   "without HAVE_PTHREAD\n");
+#endif
+}
+
+/*****************************************************************************
+  Function name: UpdateGraphics()
+
+  Purpose      : Take the graphics of the current time step
+
+  Required     : the model maps, see FillGraphic()
+
+  Returns      : void
+
+  Comments     : Called every time step, does nothing between the frames of
+                 GRAPHICS INTERVAL
+*****************************************************************************/
+void UpdateGraphics(DATE *Day, int DayStep, MAPSIZE *Map, int NGraphics,
+		    int *which_graphics, VEGTABLE *VType, SOILTABLE *SType,
+		    SNOWPIX **SnowMap, SOILPIX **SoilMap, VEGPIX **VegMap,
+		    TOPOPIX **TopoMap, PRECIPPIX **PrecipMap, float **PrismMap,
+		    STATICMAP *SkyViewMap, unsigned char ***ShadowMap,
+		    EVAPPIX **EvapMap, PIXRAD **RadMap, MET_MAP_PIX **MetMap,
+		    OPTIONSTRUCT *Options)
+{
+  int Shown;
+#ifdef HAVE_PTHREAD
+  int Old;
+#endif
+
+  if (!Active || (Count++ % Interval) != 0)
+    return;
+
+  if (Mode == GRAPHICS_DIRECT) {
+    /* nothing is filled while the display is iconized */
+    Shown = GraphicsShown();
+    if (Shown == 0)
+      return;
+    MakeFrame(&Frames[0], Day, DayStep, Map, (Shown == 2) ? NGraphics : 0,
+	      which_graphics, VType, SType, SnowMap, SoilMap, VegMap, TopoMap,
+	      PrecipMap, PrismMap, SkyViewMap, ShadowMap, EvapMap, RadMap,
+	      MetMap, Options);
+    DrawFrame(&Frames[0]);
+    return;
+  }
+
+  MakeFrame(&Frames[Back], Day, DayStep, Map, NGraphics, which_graphics,
+	    VType, SType, SnowMap, SoilMap, VegMap, TopoMap, PrecipMap,
+	    PrismMap, SkyViewMap, ShadowMap, EvapMap, RadMap, MetMap, Options);
+  NPublished++;
+
+#ifdef HAVE_PTHREAD
+  if (Threaded) {
+    /* hand the frame over and take the one the renderer is done with, or
+       the previous frame if the renderer did not get to it */
+    Old = __atomic_exchange_n(&Ready, Back | FRESH, __ATOMIC_ACQ_REL);
+    if (Old & FRESH)
+      NDropped++;
+    Back = Old & ~FRESH;
+    return;
+  }
+#endif
+
+  RenderFrame(&Frames[Back]);
+}
+
+/*****************************************************************************
+  Function name: CloseGraphics()
+
+  Purpose      : Render the last frame and stop the renderer thread
+
+  Returns      : void
+
+  Comments     : Reports the frames that were dropped by the renderer
+*****************************************************************************/
+void CloseGraphics(void)
+{
+  int i;
+
+  if (!Active)
+    return;
+
+#ifdef HAVE_PTHREAD
+  if (Threaded) {
+    __atomic_store_n(&Stop, TRUE, __ATOMIC_RELEASE);
+    pthread_join(Renderer, NULL);
+    Threaded = FALSE;
+  }
+#endif
+
+  if (Mode != GRAPHICS_DIRECT)
+    printf("Graphics: %ld frames, %ld rendered, %ld dropped\n", NPublished,
+	   NRendered, NDropped);
+
+  if (FrameFile) {
+    fclose(FrameFile);
+    FrameFile = NULL;
+  }
+  free(Image);
+  Image = NULL;
+  for (i = 0; i < NFRAMES; i++) {
+    free(Frames[i].MapNumber);
+    free(Frames[i].Title);
+    free(Frames[i].Length);
+    free(Frames[i].Min);
+    free(Frames[i].Max);
+    free(Frames[i].Values);
+  }
+  for (i = 0; i < Frames[0].MapNY; i++)
+    free(Field[i]);
+  free(Field);
+  Field = NULL;
+  Active = FALSE;
+}
+
+/*****************************************************************************
+  Function name: GraphicsPalette()
+
+  Purpose      : Color of the graphics
+
+  Required     :
+    int Index - 0 (smallest value) to 49 (largest value)
+
+  Returns      : void
+
+  Modifies     : Red, Green, Blue, 0 - 65535
+
+  Comments     : black to blue, cyan, green, yellow, magenta and red
+*****************************************************************************/
+void GraphicsPalette(int Index, unsigned short *Red, unsigned short *Green,
+		     unsigned short *Blue)
+{
+  int i = Index;
+
+  /* black to blue */
+  if (i < 10) {
+    *Red = 0;
+    *Green = 0;
+    *Blue = 65535 * i / 9;
+  }
+  /* blue to cyan */
+  else if (i < 20) {
+    *Red = 0;
+    *Green = i * 65535 / 19;
+    *Blue = 65535;
+  }
+  /*cyan to green */
+  else if (i < 25) {
+    *Red = 0;
+    *Green = 65535;
+    *Blue = 65535 - (65535 * (i - 20) / 5);
+  }
+  /*green to yellow */
+  else if (i < 30) {
+    *Red = (i - 25) * 65535 / 5;
+    *Green = 65535;
+    *Blue = 0;
+  }
+  /*yellow to magenta */
+  else if (i < 40) {
+    *Red = 65535;
+    *Green = 65535 - (65535 * (i - 30) / 9);
+    *Blue = 65535 * (i - 30) / 9;
+  }
+  /*magenta to red */
+  else {
+    *Red = 65335;
+    *Green = 0;
+    *Blue = 65535 - (65535 * (i - 40) / 9);
+  }
+}
+
+/*****************************************************************************
+  Function name: GraphicsColor()
+
+  Purpose      : Palette index of a value of a panel
+
+  Required     :
+    float Value - value, not -9999
+    float Min   - smallest value of the panel
+    float Scale - 50 / (largest - smallest value), 0 for a uniform panel
+
+  Returns      : int, 0 - 49
+*****************************************************************************/
+int GraphicsColor(float Value, float Min, float Scale)
+{
+  int index;
+
+  index = (int) (Scale * (Value - Min));
+  if (index > 49)
+    index = 49;
+  if (index < 0)
+    index = 0;
+  return index;
+}
+
+/*****************************************************************************
+  MakeFrame()
+
+  Fills and samples the NGraphics panels of Frame from the model maps
+*****************************************************************************/
+static void MakeFrame(GRAPHICSFRAME *Frame, DATE *Day, int DayStep,
+		      MAPSIZE *Map, int NGraphics, int *which_graphics,
+		      VEGTABLE *VType, SOILTABLE *SType, SNOWPIX **SnowMap,
+		      SOILPIX **SoilMap, VEGPIX **VegMap, TOPOPIX **TopoMap,
+		      PRECIPPIX **PrecipMap, float **PrismMap,
+		      STATICMAP *SkyViewMap, unsigned char ***ShadowMap,
+		      EVAPPIX **EvapMap, PIXRAD **RadMap, MET_MAP_PIX **MetMap,
+		      OPTIONSTRUCT *Options)
+{
+  int i, k;
+  size_t NPanel;
+  float *Panel;
+
+  Frame->Day = *Day;
+  Frame->NGraphics = NGraphics;
+  NPanel = (size_t) Frame->NY * Frame->NX;
+
+  for (k = 0; k < NGraphics; k++) {
+    Frame->MapNumber[k] = which_graphics[k];
+    Panel = Frame->Values + k * NPanel;
+    if (FillGraphic(which_graphics[k], DayStep, Map, VType, SType, SnowMap,
+		    SoilMap, VegMap, TopoMap, PrecipMap, PrismMap, SkyViewMap,
+		    ShadowMap, EvapMap, RadMap, MetMap, Options, Field,
+		    &(Frame->Min[k]), &(Frame->Max[k]), &(Frame->Title[k]),
+		    &(Frame->Length[k])))
+      SampleGraphic(which_graphics[k], Map, TopoMap, Field, Frame->Step,
+		    Frame->NY, Frame->NX, Panel);
+    else {
+      /* not a graphic of this run */
+      Frame->Title[k] = "";
+      Frame->Length[k] = 0;
+      Frame->Min[k] = Frame->Max[k] = 0.0;
+      for (i = 0; i < (int) NPanel; i++)
+	Panel[i] = -9999.0;
+    }
+  }
+}
+
+/*****************************************************************************
+  RenderFrame()
+
+  Draws Frame to the X11 display or writes it as a PNG image
+*****************************************************************************/
+static void RenderFrame(GRAPHICSFRAME *Frame)
+{
+  if (Mode == GRAPHICS_IMAGE)
+    WriteFrameImage(Frame);
+  else
+    DrawFrame(Frame);
+  NRendered++;
+}
+
+#ifdef HAVE_PTHREAD
+/*****************************************************************************
+  RendererThread()
+
+  Renders the frames published by UpdateGraphics() until CloseGraphics(),
+  the last frame is always rendered
+*****************************************************************************/
+static void *RendererThread(void *Arg)
+{
+  struct timespec Wait = { 0, 1000000 };
+  int Front = 1;		/* frame rendered by this thread */
+
+  for (;;) {
+    if (__atomic_load_n(&Ready, __ATOMIC_ACQUIRE) & FRESH) {
+      Front = __atomic_exchange_n(&Ready, Front, __ATOMIC_ACQ_REL) & ~FRESH;
+      RenderFrame(&Frames[Front]);
+    }
+    else if (__atomic_load_n(&Stop, __ATOMIC_ACQUIRE))
+      break;
+    else
+      nanosleep(&Wait, NULL);
+  }
+  return NULL;
+}
+#endif
+
+/*****************************************************************************
+  WriteFrameImage()
+
+  Writes Frame as Graphics.NNNNNN.png in the output directory, with the
+  panels in ImageColumns columns, and adds the date and the range of the
+  panels to Graphics.Frames.  The titles are listed at the top of
+  Graphics.Frames, the images have no text
+*****************************************************************************/
+static void WriteFrameImage(GRAPHICSFRAME *Frame)
+{
+  char FileName[BUFSIZE + 1];
+  char DateStr[20];
+  unsigned short Red, Green, Blue;
+  unsigned char *Pixel;
+  float scale;
+  float Value;
+  float *Panel;
+  int PanelNX, PanelNY;
+  int PX, PY;
+  int i, j, k, x, y;
+  int Color;
+
+  PanelNX = Frame->NX * Zoom;
+  PanelNY = Frame->NY * Zoom;
+  memset(Image, 255, (size_t) 3 * ImageNX * ImageNY);
+
+  for (k = 0; k < Frame->NGraphics; k++) {
+    PX = (k % ImageColumns) * (PanelNX + 40) + 10;
+    PY = (k / ImageColumns) * (PanelNY + 20) + 10;
+    Panel = Frame->Values + (size_t) k * Frame->NY * Frame->NX;
+
+    if (fequal(Frame->Max[k], Frame->Min[k]))
+      scale = 0.0;
+    else
+      scale = 50 / (Frame->Max[k] - Frame->Min[k]);
+
+    for (y = 0; y < PanelNY; y++) {
+      j = y / Zoom;
+      Pixel = Image + 3 * ((size_t) (PY + y) * ImageNX + PX);
+      for (x = 0; x < PanelNX; x++, Pixel += 3) {
+	Value = Panel[j * Frame->NX + x / Zoom];
+	if (fequal(Value, -9999.0))
+	  continue;
+	GraphicsPalette(GraphicsColor(Value, Frame->Min[k], scale), &Red,
+			&Green, &Blue);
+	Pixel[0] = Red >> 8;
+	Pixel[1] = Green >> 8;
+	Pixel[2] = Blue >> 8;
+      }
+    }
+
+    /* the color bar, smallest value at the bottom */
+    for (y = 0; y < PanelNY; y++) {
+      Color = 50 * (PanelNY - 1 - y) / PanelNY;
+      GraphicsPalette(Color, &Red, &Green, &Blue);
+      Pixel = Image + 3 * ((size_t) (PY + y) * ImageNX + PX + PanelNX + 10);
+      for (i = 0; i < 10; i++, Pixel += 3) {
+	Pixel[0] = Red >> 8;
+	Pixel[1] = Green >> 8;
+	Pixel[2] = Blue >> 8;
+      }
+    }
+  }
+
+  if (NRendered == 0) {
+    fprintf(FrameFile, "# image, date, then the minimum and maximum of:\n");
+    for (k = 0; k < Frame->NGraphics; k++)
+      fprintf(FrameFile, "# panel %d: graphic %d, %s\n", k + 1,
+	      Frame->MapNumber[k], Frame->Title[k]);
+  }
+  sprintf(FileName, "Graphics.%06ld.png", NRendered + 1);
+  SPrintDate(&(Frame->Day), DateStr);
+  fprintf(FrameFile, "%s %s", FileName, DateStr);
+  for (k = 0; k < Frame->NGraphics; k++)
+    fprintf(FrameFile, " %g %g", Frame->Min[k], Frame->Max[k]);
+  fprintf(FrameFile, "\n");
+  fflush(FrameFile);
+
+  sprintf(FileName, "%sGraphics.%06ld.png", ImagePath, NRendered + 1);
+  WritePNG(FileName, ImageNX, ImageNY, Image);
+}
+
+/*****************************************************************************
+  PNG helpers: big endian words and the CRC of the chunks
+*****************************************************************************/
+static void PutWord(unsigned char *Buffer, unsigned long Value)
+{
+  Buffer[0] = (Value >> 24) & 0xff;
+  Buffer[1] = (Value >> 16) & 0xff;
+  Buffer[2] = (Value >> 8) & 0xff;
+  Buffer[3] = Value & 0xff;
+}
+
+static unsigned long Crc(unsigned long Sum, unsigned char *Buffer, size_t N)
+{
+  static unsigned long Table[256];
+  static int HasTable = FALSE;
+  unsigned long c;
+  size_t i;
+  int k;
+
+  if (!HasTable) {
+    for (i = 0; i < 256; i++) {
+      c = (unsigned long) i;
+      for (k = 0; k < 8; k++)
+	c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+      Table[i] = c;
+    }
+    HasTable = TRUE;
+  }
+  c = Sum ^ 0xffffffffUL;
+  for (i = 0; i < N; i++)
+    c = Table[(c ^ Buffer[i]) & 0xff] ^ (c >> 8);
+  return c ^ 0xffffffffUL;
+}
+
+static void PutChunk(FILE *OutFile, const char *Type, unsigned char *Data,
+		     size_t N)
+{
+  unsigned char Word[4];
+  unsigned long Sum;
+
+  PutWord(Word, (unsigned long) N);
+  fwrite(Word, 1, 4, OutFile);
+  fwrite(Type, 1, 4, OutFile);
+  if (N > 0)
+    fwrite(Data, 1, N, OutFile);
+  Sum = Crc(0, (unsigned char *) Type, 4);
+  Sum = Crc(Sum, Data, N);
+  PutWord(Word, Sum);
+  fwrite(Word, 1, 4, OutFile);
+}
+
+/*****************************************************************************
+  WritePNG()
+
+  Writes a Width x Height RGB image as a PNG file.  The image data is a
+  zlib stream of stored (uncompressed) deflate blocks, which needs no
+  compression library; the images of the graphics are only a few hundred
+  pixels on a side
+*****************************************************************************/
+static void WritePNG(char *FileName, int Width, int Height,
+		     unsigned char *RGB)
+{
+  static unsigned char Signature[8] = { 137, 'P', 'N', 'G', 13, 10, 26, 10 };
+  FILE *OutFile;
+  unsigned char Header[13];
+  unsigned char *Data;
+  unsigned char *Out;
+  size_t Row, NRaw, NData, Block, i;
+  unsigned long A = 1, B = 0;
+  int y;
+
+  Row = (size_t) 3 * Width + 1;
+  NRaw = Row * Height;
+  NData = 2 + NRaw + 5 * ((NRaw + 65534) / 65535) + 4;
+  if (!(Data = (unsigned char *) malloc(NData + Row)))
+    ReportError("WritePNG", 1);
+
+  /* the scanlines, without filter, go after the space for the block
+     headers so that the stream can be built in place */
+  for (y = 0; y < Height; y++) {
+    Out = Data + NData - NRaw - 4 + y * Row;
+    Out[0] = 0;
+    memcpy(Out + 1, RGB + (size_t) 3 * Width * y, Row - 1);
+  }
+  for (i = 0; i < NRaw; i++) {
+    A = (A + Data[NData - NRaw - 4 + i]) % 65521;
+    B = (B + A) % 65521;
+  }
+
+  Out = Data;
+  *Out++ = 0x78;
+  *Out++ = 0x01;
+  for (i = 0; i < NRaw; i += Block) {
+    Block = (NRaw - i > 65535) ? 65535 : NRaw - i;
+    *Out++ = (i + Block == NRaw) ? 1 : 0;
+    *Out++ = Block & 0xff;
+    *Out++ = (Block >> 8) & 0xff;
+    *Out++ = ~Block & 0xff;
+    *Out++ = (~Block >> 8) & 0xff;
+    memmove(Out, Data + NData - NRaw - 4 + i, Block);
+    Out += Block;
+  }
+  PutWord(Out, (B << 16) | A);
+
+  PutWord(Header, (unsigned long) Width);
+  PutWord(Header + 4, (unsigned long) Height);
+  Header[8] = 8;		/* bits per sample */
+  Header[9] = 2;		/* RGB */
+  Header[10] = 0;
+  Header[11] = 0;
+  Header[12] = 0;
+
+  OpenFile(&OutFile, FileName, "wb", TRUE);
+  fwrite(Signature, 1, 8, OutFile);
+  PutChunk(OutFile, "IHDR", Header, 13);
+  PutChunk(OutFile, "IDAT", Data, NData);
+  PutChunk(OutFile, "IEND", NULL, 0);
+  fclose(OutFile);
+  free(Data);
+}
@@ -0,0 +1,521 @@
+/*
+ * SUMMARY:      GridMetNetCDF.c - Gridded met forcing from a NetCDF file
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Reads the gridded met forcing directly from a CF NetCDF file
+ *               with (time, lat, lon) variables, instead of one text file
+ *               per grid point.  The grid points that InitGridMet() would
+ *               select become the met stations, and the values of all of
+ *               them are read with one hyperslab read per variable and time
+ *               step, over the window of the grid that holds the selected
+ *               points
+ * DESCRIP-END.
+ * FUNCTIONS:    InitGridMetNetCDF()
+ *               ReadGridMetNetCDF()
+ *               CloseGridMetNetCDF()
+ *               SetChunkCache()
+ *               ReadTimeAxis()
+ * COMMENTS:     GRID NETCDF VARIABLES lists one variable for each value of
+ *               the records of a grid met file, in the same order (see
+ *               CountMetVars()).  Packed variables are unpacked with their
+ *               scale_factor and add_offset, temperatures in K are converted
+ *               to C, and precipitation in mm or kg m-2 s-1 to m per time
+ *               step.  All other values must be in the units of the met
+ *               files.  The interpolation weights of the model cells to the
+ *               stations (see CalcWeights()) are the map of the grid values
+ *               to the cells.  Only the standard (gregorian) calendar is
+ *               supported.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "Calendar.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "constants.h"
+
+#ifdef HAVE_NETCDF
+
+#include <netcdf.h>
+
+#define NC_CHECK(status) \
+  do { if ((status) != NC_NOERR) ncReportError((status), __LINE__); } while (0)
+
+/* a variable of the grid met file */
+typedef struct {
+  char Name[NC_MAX_NAME + 1];
+  int varid;
+  double Scale;			/* value = Scale * packed + Offset */
+  double Offset;
+  float Fill;			/* packed value of the cells without data */
+  int HasFill;
+} NCGRIDVAR;
+
+/* state of the grid met file, NStats == 0 if it is not used */
+static struct {
+  int ncid;
+  char FileName[BUFSIZE + 1];
+  int NStats;			/* Number of stations (selected grid points) */
+  int NVars;			/* Number of values per station */
+  NCGRIDVAR *Var;
+  size_t Start[2];		/* first row and column of the window */
+  size_t Count[2];		/* number of rows and columns of the window */
+  size_t *Cell;			/* position of each station in the window */
+  float *Window;		/* [Count[0]][Count[1]] values of one variable */
+  float *Buffer;		/* [NStats][NVars] records for one time step */
+  size_t NTimes;
+  double *Time;			/* time axis, in days since the Julian epoch */
+  size_t Last;			/* time index of the last read */
+} GridNC = { -1, "", 0, 0, NULL, {0, 0}, {0, 0}, NULL, NULL, NULL, 0, NULL,
+	     0 };
+
+static void ncReportError(int ncstatus, int line);
+static void SetChunkCache(int ncid, int varid);
+static void ReadTimeAxis(int ncid, int dimid);
+
+/*******************************************************************************
+  Function name: InitGridMetNetCDF()
+
+  Purpose      : Open the grid met file, select the grid points within the
+                 basin (or within the bounding box of Grid if OUTSIDE is TRUE)
+                 as met stations and find the window of the grid that holds
+                 them
+
+  Required     :
+    OPTIONSTRUCT *Options - Options
+    MAPSIZE *Map          - Basin grid
+    TOPOPIX **TopoMap     - Basin mask
+    int NSoilLayers       - Number of soil layers
+    int Dt                - Model time step (in sec)
+    GRID *Grid            - grid met setup, with the file and variables
+
+  Returns      : void
+
+  Modifies     : Stat, NStats
+*******************************************************************************/
+void InitGridMetNetCDF(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		       int NSoilLayers, int Dt, GRID *Grid,
+		       METLOCATION **Stat, int *NStats)
+{
+  const char *Routine = "InitGridMetNetCDF";
+  char Names[BUFSIZE + 1];
+  char Units[NC_MAX_NAME + 1];
+  char DimName[NC_MAX_NAME + 1];
+  char *Token;
+  double *Lat;
+  double *Lon;
+  float East;
+  float North;
+  float lon;
+  int dimids[3];
+  int Dims[3];
+  int ndims;
+  int varid;
+  int i, j, k, v;
+  int *Row;			/* row and column in the file of each selected */
+  int *Col;			/*   grid point */
+  int Loc[2];
+  size_t NLat;
+  size_t NLon;
+  size_t Len;
+  size_t Min[2], Max[2];
+  NCGRIDVAR *Var;
+
+  if (Options->WindSource == MODEL ||
+      (Options->Outside == TRUE && Options->Prism == TRUE))
+    ReportError((char *) Routine, 65);
+
+  /* the file is read by date, the station file pool and the met cache are
+     not needed */
+  if (Options->MaxMetFiles > 0 || !IsEmptyStr(Options->MetCacheFile))
+    printf("MAXIMUM OPEN MET FILES and MET FORCING CACHE are not used with a "
+	   "GRID NETCDF FILE\n");
+  Options->MaxMetFiles = 0;
+  Options->MetCacheFile[0] = '\0';
+
+  strcpy(GridNC.FileName, Grid->ncfile);
+  NC_CHECK(nc_open(GridNC.FileName, NC_NOWRITE, &(GridNC.ncid)));
+
+  /* the variables, one for each value of a grid met record */
+  GridNC.NVars = CountMetVars(Options, NSoilLayers, FALSE);
+  if (!(GridNC.Var = (NCGRIDVAR *) calloc(GridNC.NVars, sizeof(NCGRIDVAR))))
+    ReportError((char *) Routine, 1);
+  strcpy(Names, Grid->ncvars);
+  v = 0;
+  for (Token = strtok(Names, " \t,"); Token != NULL;
+       Token = strtok(NULL, " \t,")) {
+    if (v == GridNC.NVars || strlen(Token) > NC_MAX_NAME)
+      ReportError("GRID NETCDF VARIABLES", 51);
+    strcpy(GridNC.Var[v++].Name, Token);
+  }
+  if (v != GridNC.NVars)
+    ReportError("GRID NETCDF VARIABLES", 51);
+
+  for (v = 0; v < GridNC.NVars; v++) {
+    Var = &(GridNC.Var[v]);
+    NC_CHECK(nc_inq_varid(GridNC.ncid, Var->Name, &(Var->varid)));
+    NC_CHECK(nc_inq_varndims(GridNC.ncid, Var->varid, &ndims));
+    if (ndims != 3)
+      ReportError(Var->Name, 65);
+    NC_CHECK(nc_inq_vardimid(GridNC.ncid, Var->varid, dimids));
+    if (v == 0)
+      for (i = 0; i < 3; i++)
+	Dims[i] = dimids[i];
+    else if (dimids[0] != Dims[0] || dimids[1] != Dims[1] ||
+	     dimids[2] != Dims[2])
+      ReportError(Var->Name, 65);
+
+    if (nc_get_att_double(GridNC.ncid, Var->varid, "scale_factor",
+			  &(Var->Scale)) != NC_NOERR)
+      Var->Scale = 1.0;
+    if (nc_get_att_double(GridNC.ncid, Var->varid, "add_offset",
+			  &(Var->Offset)) != NC_NOERR)
+      Var->Offset = 0.0;
+    Var->HasFill =
+      (nc_get_att_float(GridNC.ncid, Var->varid, "_FillValue",
+			&(Var->Fill)) == NC_NOERR ||
+       nc_get_att_float(GridNC.ncid, Var->varid, "missing_value",
+			&(Var->Fill)) == NC_NOERR);
+
+    /* convert to the units of the met files */
+    memset(Units, 0, sizeof(Units));
+    if (nc_inq_attlen(GridNC.ncid, Var->varid, "units", &Len) == NC_NOERR &&
+	Len <= NC_MAX_NAME) {
+      NC_CHECK(nc_get_att_text(GridNC.ncid, Var->varid, "units", Units));
+      if (strcmp(Units, "K") == 0 || strcmp(Units, "degK") == 0 ||
+	  strcmp(Units, "kelvin") == 0)
+	Var->Offset -= 273.15;
+      else if (strcmp(Units, "mm") == 0) {
+	Var->Scale *= 0.001;
+	Var->Offset *= 0.001;
+      }
+      else if (strcmp(Units, "kg m-2 s-1") == 0 ||
+	       strcmp(Units, "mm s-1") == 0 || strcmp(Units, "mm/s") == 0) {
+	Var->Scale *= 0.001 * Dt;
+	Var->Offset *= 0.001 * Dt;
+      }
+    }
+  }
+
+  /* the coordinates of the grid */
+  NC_CHECK(nc_inq_dim(GridNC.ncid, Dims[1], DimName, &NLat));
+  NC_CHECK(nc_inq_varid(GridNC.ncid, DimName, &varid));
+  if (!(Lat = (double *) calloc(NLat, sizeof(double))))
+    ReportError((char *) Routine, 1);
+  NC_CHECK(nc_get_var_double(GridNC.ncid, varid, Lat));
+  NC_CHECK(nc_inq_dim(GridNC.ncid, Dims[2], DimName, &NLon));
+  NC_CHECK(nc_inq_varid(GridNC.ncid, DimName, &varid));
+  if (!(Lon = (double *) calloc(NLon, sizeof(double))))
+    ReportError((char *) Routine, 1);
+  NC_CHECK(nc_get_var_double(GridNC.ncid, varid, Lon));
+  ReadTimeAxis(GridNC.ncid, Dims[0]);
+
+  /* select the grid points in the same way as InitGridMet() selects the
+     grid met files */
+  if (!(Row = (int *) malloc(Grid->NGrids * sizeof(int))) ||
+      !(Col = (int *) malloc(Grid->NGrids * sizeof(int))) ||
+      !(*Stat = (METLOCATION *) calloc(Grid->NGrids, sizeof(METLOCATION))))
+    ReportError((char *) Routine, 1);
+  Min[0] = NLat;
+  Min[1] = NLon;
+  Max[0] = Max[1] = 0;
+  k = 0;
+  for (j = 0; j < (int) NLat; j++) {
+    for (i = 0; i < (int) NLon; i++) {
+      lon = (Lon[i] > 180.0) ? Lon[i] - 360.0 : Lon[i];
+      if (Options->Outside == TRUE) {
+	if (Lat[j] > Grid->LatNorth || Lat[j] < Grid->LatSouth ||
+	    lon < Grid->LonWest || lon > Grid->LonEast)
+	  continue;
+      }
+      deg2utm((float) Lat[j], lon, &East, &North);
+      Loc[0] = Round(((Map->Yorig - 0.5 * Map->DY) - North) / Map->DY);
+      Loc[1] = Round((East - (Map->Xorig + 0.5 * Map->DX)) / Map->DX);
+      if (Loc[0] >= Map->NY || Loc[0] < 0 || Loc[1] >= Map->NX || Loc[1] < 0)
+	continue;
+      if (Options->Outside == FALSE && !INBASIN(TopoMap[Loc[0]][Loc[1]].Mask))
+	continue;
+      if (k == Grid->NGrids)
+	ReportError("NUMBER OF GRIDS", 51);
+      sprintf((*Stat)[k].Name, "data_%f_%f\n", (float) Lat[j], lon);
+      (*Stat)[k].Loc.N = Loc[0];
+      (*Stat)[k].Loc.E = Loc[1];
+      strcpy((*Stat)[k].MetFile.FileName, GridNC.FileName);
+      (*Stat)[k].MetFile.FilePtr = NULL;
+      Row[k] = j;
+      Col[k] = i;
+      if ((size_t) j < Min[0]) Min[0] = j;
+      if ((size_t) j > Max[0]) Max[0] = j;
+      if ((size_t) i < Min[1]) Min[1] = i;
+      if ((size_t) i > Max[1]) Max[1] = i;
+      k++;
+    }
+  }
+  free(Lat);
+  free(Lon);
+
+  /* if no grid is found within the mask, exit with error */
+  if (k < 1)
+    ReportError(GridNC.FileName, 69);
+  *NStats = GridNC.NStats = k;
+
+  /* the window of the grid with all the selected points */
+  for (i = 0; i < 2; i++) {
+    GridNC.Start[i] = Min[i];
+    GridNC.Count[i] = Max[i] - Min[i] + 1;
+  }
+  if (!(GridNC.Cell = (size_t *) malloc(k * sizeof(size_t))) ||
+      !(GridNC.Window = (float *) malloc(GridNC.Count[0] * GridNC.Count[1] *
+					 sizeof(float))) ||
+      !(GridNC.Buffer = (float *) malloc(k * GridNC.NVars * sizeof(float))))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < k; i++)
+    GridNC.Cell[i] = (Row[i] - GridNC.Start[0]) * GridNC.Count[1] +
+      (Col[i] - GridNC.Start[1]);
+  free(Row);
+  free(Col);
+
+  for (v = 0; v < GridNC.NVars; v++)
+    SetChunkCache(GridNC.ncid, GridNC.Var[v].varid);
+
+  printf("\n%d grid points of %s are used as met stations, read from a"
+	 " window of %d rows and %d columns\n", k, GridNC.FileName,
+	 (int) GridNC.Count[0], (int) GridNC.Count[1]);
+}
+
+/*******************************************************************************
+  Function name: ReadGridMetNetCDF()
+
+  Purpose      : Read the records of all stations for date Current from the
+                 grid met file
+
+  Required     :
+    DATE *Current - date of the records
+    int *NVars    - Number of values in each record
+
+  Returns      : [NStats][NVars] raw records (see StoreMetRecord()), or NULL
+                 if the met forcing is not read from a NetCDF file.  The
+                 records stay valid until the next call
+
+  Modifies     : NVars
+*******************************************************************************/
+float *ReadGridMetNetCDF(DATE *Current, int *NVars)
+{
+  double Julian;
+  double Tolerance = 0.5 / SECPDAY;	/* half a second */
+  size_t Lo, Hi, Mid;
+  size_t Start[3];
+  size_t Count[3];
+  float Value;
+  int i, v;
+  NCGRIDVAR *Var;
+
+  if (GridNC.NStats == 0)
+    return NULL;
+
+  /* time index of Current, the next one after the last read in a run */
+  Julian = GregorianToJulianDay(Current->Year, Current->Month, Current->Day,
+				Current->Hour, Current->Min, Current->Sec);
+  if (GridNC.Last + 1 < GridNC.NTimes &&
+      fabs(GridNC.Time[GridNC.Last + 1] - Julian) < Tolerance)
+    GridNC.Last++;
+  else if (fabs(GridNC.Time[GridNC.Last] - Julian) >= Tolerance) {
+    Lo = 0;
+    Hi = GridNC.NTimes;
+    while (Lo < Hi) {
+      Mid = Lo + (Hi - Lo) / 2;
+      if (GridNC.Time[Mid] < Julian - Tolerance)
+	Lo = Mid + 1;
+      else
+	Hi = Mid;
+    }
+    if (Lo == GridNC.NTimes || fabs(GridNC.Time[Lo] - Julian) >= Tolerance)
+      ReportError(GridNC.FileName, 28);
+    GridNC.Last = Lo;
+  }
+
+  Start[0] = GridNC.Last;
+  Count[0] = 1;
+  for (i = 0; i < 2; i++) {
+    Start[i + 1] = GridNC.Start[i];
+    Count[i + 1] = GridNC.Count[i];
+  }
+  for (v = 0; v < GridNC.NVars; v++) {
+    Var = &(GridNC.Var[v]);
+    NC_CHECK(nc_get_vara_float(GridNC.ncid, Var->varid, Start, Count,
+			       GridNC.Window));
+    for (i = 0; i < GridNC.NStats; i++) {
+      Value = GridNC.Window[GridNC.Cell[i]];
+      if (Var->HasFill && Value == Var->Fill)
+	ReportError(Var->Name, 5);
+      GridNC.Buffer[i * GridNC.NVars + v] =
+	(float) (Var->Scale * Value + Var->Offset);
+    }
+  }
+
+  *NVars = GridNC.NVars;
+  return GridNC.Buffer;
+}
+
+/*******************************************************************************
+  Function name: CloseGridMetNetCDF()
+*******************************************************************************/
+void CloseGridMetNetCDF(void)
+{
+  if (GridNC.NStats == 0)
+    return;
+  nc_close(GridNC.ncid);
+  free(GridNC.Var);
+  free(GridNC.Cell);
+  free(GridNC.Window);
+  free(GridNC.Buffer);
+  free(GridNC.Time);
+  GridNC.Var = NULL;
+  GridNC.Cell = NULL;
+  GridNC.Window = NULL;
+  GridNC.Buffer = NULL;
+  GridNC.Time = NULL;
+  GridNC.NStats = 0;
+}
+
+/*******************************************************************************
+  Function name: SetChunkCache()
+
+  Purpose      : Size the chunk cache of a chunked variable so that it holds
+                 all the chunks that cross the window.  A chunk usually holds
+                 several time steps, so that each chunk is only read and
+                 decompressed once.  Contiguous (netCDF-3) variables have no
+                 chunk cache
+*******************************************************************************/
+static void SetChunkCache(int ncid, int varid)
+{
+  char Name[NC_MAX_NAME + 1];
+  int Storage;
+  int i;
+  nc_type Type;
+  size_t Chunk[3];
+  size_t TypeSize;
+  size_t NChunks;
+  size_t Bytes;
+
+  if (nc_inq_var_chunking(ncid, varid, &Storage, Chunk) != NC_NOERR ||
+      Storage != NC_CHUNKED)
+    return;
+  NC_CHECK(nc_inq_vartype(ncid, varid, &Type));
+  NC_CHECK(nc_inq_type(ncid, Type, Name, &TypeSize));
+
+  NChunks = 1;
+  Bytes = Chunk[0] * TypeSize;
+  for (i = 0; i < 2; i++) {
+    NChunks *= (GridNC.Start[i] + GridNC.Count[i] - 1) / Chunk[i + 1] -
+      GridNC.Start[i] / Chunk[i + 1] + 1;
+    Bytes *= Chunk[i + 1];
+  }
+  NC_CHECK(nc_set_var_chunk_cache(ncid, varid, NChunks * Bytes,
+				  2 * NChunks + 1, 0.75));
+}
+
+/*******************************************************************************
+  Function name: ReadTimeAxis()
+
+  Purpose      : Read the time coordinate, with units "<unit> since <date>",
+                 and store it in GridNC.Time in days since the Julian epoch,
+                 see GregorianToJulianDay()
+*******************************************************************************/
+static void ReadTimeAxis(int ncid, int dimid)
+{
+  const char *Routine = "ReadTimeAxis";
+  char Name[NC_MAX_NAME + 1];
+  char Units[BUFSIZE + 1];
+  char Unit[BUFSIZE + 1];
+  double Epoch;
+  double DaysPerUnit;
+  double Sec = 0.0;
+  int Year, Month, Day;
+  int Hour = 0;
+  int Min = 0;
+  int varid;
+  size_t Len;
+  size_t n;
+
+  NC_CHECK(nc_inq_dim(ncid, dimid, Name, &(GridNC.NTimes)));
+  NC_CHECK(nc_inq_varid(ncid, Name, &varid));
+  if (GridNC.NTimes == 0)
+    ReportError(GridNC.FileName, 28);
+
+  NC_CHECK(nc_inq_attlen(ncid, varid, "units", &Len));
+  if (Len > BUFSIZE)
+    ReportError(Name, 65);
+  memset(Units, 0, sizeof(Units));
+  NC_CHECK(nc_get_att_text(ncid, varid, "units", Units));
+  if (sscanf(Units, "%s since %d-%d-%d%*[ T]%d:%d:%lf", Unit, &Year, &Month,
+	     &Day, &Hour, &Min, &Sec) < 4)
+    ReportError(Name, 65);
+  if (strncmp(Unit, "day", 3) == 0)
+    DaysPerUnit = 1.0;
+  else if (strncmp(Unit, "hour", 4) == 0)
+    DaysPerUnit = 1.0 / HOURPDAY;
+  else if (strncmp(Unit, "minute", 6) == 0)
+    DaysPerUnit = (double) SECPMIN / SECPDAY;
+  else if (strncmp(Unit, "second", 6) == 0)
+    DaysPerUnit = 1.0 / SECPDAY;
+  else
+    ReportError(Name, 65);
+  memset(Unit, 0, sizeof(Unit));
+  if (nc_inq_attlen(ncid, varid, "calendar", &Len) == NC_NOERR) {
+    if (Len > BUFSIZE)
+      ReportError(Name, 65);
+    NC_CHECK(nc_get_att_text(ncid, varid, "calendar", Unit));
+    if (strcmp(Unit, "standard") != 0 && strcmp(Unit, "gregorian") != 0 &&
+	strcmp(Unit, "proleptic_gregorian") != 0)
+      ReportError(Name, 65);
+  }
+  Epoch = GregorianToJulianDay(Year, Month, Day, Hour, Min, Sec);
+
+  if (!(GridNC.Time = (double *) malloc(GridNC.NTimes * sizeof(double))))
+    ReportError((char *) Routine, 1);
+  NC_CHECK(nc_get_var_double(ncid, varid, GridNC.Time));
+  for (n = 0; n < GridNC.NTimes; n++)
+    GridNC.Time[n] = Epoch + GridNC.Time[n] * DaysPerUnit;
+  GridNC.Last = 0;
+}
+
+/*******************************************************************************
+  Function name: ncReportError()
+*******************************************************************************/
+static void ncReportError(int ncstatus, int line)
+{
+  char Str[BUFSIZE + 1];
+
+  sprintf(Str, "%s, line: %d -- %s", GridNC.FileName, line,
+	  nc_strerror(ncstatus));
+  ReportError(Str, 57);
+}
+
+#else
+
+/* without NetCDF the grid met forcing can only be read from text files */
+void InitGridMetNetCDF(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		       int NSoilLayers, int Dt, GRID *Grid,
+		       METLOCATION **Stat, int *NStats)
+{
+  ReportError(Grid->ncfile, 56);
+}
+
+float *ReadGridMetNetCDF(DATE *Current, int *NVars)
+{
+  return NULL;
+}
+
+void CloseGridMetNetCDF(void)
+{
+}
+
+#endif
@@ -0,0 +1,449 @@
+/*
+ * SUMMARY:      HorizonShading.c - Terrain shading from the horizon angles
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS SHADING MODE = HORIZON the shadow map of each
+ *               step is computed from the solar geometry of the step and
+ *               the horizon angles of the cells, rather than read from the
+ *               monthly shadow files of make_shade_maps.  The horizons are
+ *               computed from the DEM at the start, or read from the
+ *               HORIZON FILE, and kept for the active cells as one byte
+ *               per azimuth sector.  The memory of the shading does not
+ *               depend on the number of steps of a day, and there is
+ *               nothing to read at the start of a month.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitHorizons()
+ *               HorizonShadeStep()
+ *               SweepSector()
+ *               DemHash()
+ *               ReadHorizonFile()
+ *               WriteHorizonFile()
+ * COMMENTS:     The horizons are those of horizon.c of the preprocessing
+ *               programs (the same sweep of the sectors, and the same
+ *               HORIZON FILE format, so a file written by skyview or
+ *               make_shade_maps can be used here and the other way
+ *               around).  The shade factor of a cell is the one of
+ *               make_shade_maps, from the slope and aspect of the model
+ *               (TopoMap), with the horizon angle at the solar azimuth
+ *               interpolated between the two nearest sectors.  The factor
+ *               is that of the solar geometry of the step, rather than of
+ *               one day of the month.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "settings.h"
+#include "constants.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "getinit.h"
+#include "memaccount.h"
+
+#define HORIZON_MAGIC "DHSVMHZ1"
+
+/* horizon angle of one step of the codes of HORIZONMAP.Angle (rad) */
+#define HORIZON_STEP (PI / 2. / 255.)
+
+/* header of a HORIZON FILE, followed by the tangents of the horizon angles
+   as 4 byte floats, [NSectors][NRows][NCols] */
+typedef struct {
+  char Magic[8];
+  int NRows;
+  int NCols;
+  int NSectors;
+  float DX;
+  unsigned int Hash;		/* of the DEM */
+} HORIZONHEADER;
+
+static void SweepSector(MAPSIZE *Map, float *Elev, int NSectors, int k,
+			int NThreads, float *Tan);
+static unsigned int DemHash(float *Elev, size_t NCells);
+static FILE *ReadHorizonFile(char *FileName, MAPSIZE *Map, int NSectors,
+			     unsigned int Hash);
+static FILE *WriteHorizonFile(char *FileName, MAPSIZE *Map, int NSectors,
+			      unsigned int Hash);
+
+/*****************************************************************************
+  Function name: InitHorizons()
+
+  Purpose      : Compute or read the horizons of the active cells
+
+  Required     :
+    OPTIONSTRUCT *Options - HORIZON SECTORS, HORIZON FILE
+    MAPSIZE *Map          - Size and active cells of the model map
+    TOPOPIX **TopoMap     - Elevation, slope and aspect of the cells
+    float *SkyView        - NY * NX sky view factors, NULL if not needed
+
+  Returns      : void
+
+  Modifies     : Horizon, and the sky view factor of the active cells in
+                 SkyView, the mean of cos^2 of their horizon angles
+
+  Comments     : The horizons are read from the HORIZON FILE if it was made
+                 for the same DEM, cell size and number of sectors, and
+                 computed and written to it otherwise
+*****************************************************************************/
+void InitHorizons(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		  HORIZONMAP *Horizon, float *SkyView)
+{
+  const char *Routine = "InitHorizons";
+  size_t NCells = (size_t) Map->NY * Map->NX;
+  int NSectors = Options->HorizonSectors;
+  int n = Map->NumActive;
+  unsigned int Hash;
+  float *Elev;			/* DEM, row-major */
+  float *Tan;			/* tangents of a sector, row-major */
+  float Slope;
+  FILE *In = NULL;
+  FILE *Out = NULL;
+  int i;
+  int k;
+  int x;
+  int y;
+
+  Horizon->NSectors = NSectors;
+  Horizon->NCells = n;
+  if (!(Horizon->Angle = (unsigned char *)
+	TaggedCalloc((size_t) NSectors * n, sizeof(unsigned char),
+		     MEM_SHADOW)) ||
+      !(Horizon->CosSlope = (float *) TaggedCalloc(3 * n, sizeof(float),
+						   MEM_SHADOW)) ||
+      !(Horizon->Shade = (unsigned char *)
+	TaggedCalloc(n, sizeof(unsigned char), MEM_SHADOW)))
+    ReportError((char *) Routine, 1);
+  Horizon->SinSlopeN = Horizon->CosSlope + n;
+  Horizon->SinSlopeE = Horizon->CosSlope + 2 * n;
+
+  /* TopoMap Slope is the gradient */
+  for (i = 0; i < n; i++) {
+    y = Map->ActiveCells[i].y;
+    x = Map->ActiveCells[i].x;
+    Slope = atan(TopoMap[y][x].Slope);
+    Horizon->CosSlope[i] = cos(Slope);
+    Horizon->SinSlopeN[i] = sin(Slope) * cos(TopoMap[y][x].Aspect);
+    Horizon->SinSlopeE[i] = sin(Slope) * sin(TopoMap[y][x].Aspect);
+    if (SkyView != NULL)
+      SkyView[y * Map->NX + x] = 0.0;
+  }
+
+  if (!(Elev = (float *) calloc(NCells, sizeof(float))) ||
+      !(Tan = (float *) calloc(NCells, sizeof(float))))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++)
+      Elev[y * Map->NX + x] = TopoMap[y][x].Dem;
+  Hash = DemHash(Elev, NCells);
+
+  if (!IsEmptyStr(Options->HorizonFile)) {
+    In = ReadHorizonFile(Options->HorizonFile, Map, NSectors, Hash);
+    if (In == NULL)
+      Out = WriteHorizonFile(Options->HorizonFile, Map, NSectors, Hash);
+  }
+  if (In != NULL)
+    printf("Reading the horizons of %d sectors from %s\n", NSectors,
+	   Options->HorizonFile);
+  else
+    printf("Computing the horizons of %d sectors\n", NSectors);
+
+  for (k = 0; k < NSectors; k++) {
+    if (In != NULL) {
+      if (fread(Tan, sizeof(float), NCells, In) != NCells)
+	ReportError(Options->HorizonFile, 93);
+    }
+    else
+      SweepSector(Map, Elev, NSectors, k, Options->NThreads, Tan);
+    if (Out != NULL && fwrite(Tan, sizeof(float), NCells, Out) != NCells) {
+      printf("Cannot write the horizons to %s\n", Options->HorizonFile);
+      fclose(Out);
+      Out = NULL;
+      remove(Options->HorizonFile);
+    }
+
+    for (i = 0; i < n; i++) {
+      float t = Tan[Map->ActiveCells[i].y * Map->NX + Map->ActiveCells[i].x];
+      Horizon->Angle[(size_t) k * n + i] =
+	(unsigned char) (atan(t) / HORIZON_STEP + 0.5);
+      if (SkyView != NULL)
+	SkyView[Map->ActiveCells[i].y * Map->NX + Map->ActiveCells[i].x] +=
+	  1.0 / (1.0 + t * t) / NSectors;
+    }
+  }
+
+  if (In != NULL)
+    fclose(In);
+  if (Out != NULL) {
+    if (fclose(Out) != 0) {
+      printf("Cannot write the horizons to %s\n", Options->HorizonFile);
+      remove(Options->HorizonFile);
+    }
+    else
+      printf("Horizons written to %s\n", Options->HorizonFile);
+  }
+  free(Elev);
+  free(Tan);
+}
+
+/*****************************************************************************
+  Function name: HorizonShadeStep()
+
+  Purpose      : Compute the shadow map of the current step
+
+  Required     :
+    MAPSIZE *Map            - Size and active cells of the model map
+    SOLARGEOMETRY *SolarGeo - Solar geometry of the step
+    SHADOWMAP *ShadowMap    - Shadow maps, with the horizons
+
+  Returns      : void
+
+  Modifies     : The slice in ShadowMap->Block that all the steps show
+
+  Comments     : Called each step after InitNewStep().  The shade factors
+                 of the active cells are computed by one loop over arrays
+                 of the cells, which the compiler vectorizes, and then
+                 written to the map
+*****************************************************************************/
+void HorizonShadeStep(MAPSIZE *Map, SOLARGEOMETRY *SolarGeo,
+		      SHADOWMAP *ShadowMap)
+{
+  HORIZONMAP *Horizon = &(ShadowMap->Horizon);
+  const unsigned char *A0;	/* horizons of the sectors on either side */
+  const unsigned char *A1;	/* of the solar azimuth */
+  unsigned char *Shade = Horizon->Shade;
+  float SinAlt = SolarGeo->SineSolarAltitude;
+  float CosAlt;
+  float SinAz;
+  float CosAz;
+  float AltCode;		/* solar altitude, in steps of HORIZON_STEP */
+  float Scale;			/* shade factor of the incidence */
+  float W0;			/* weights of the two sectors */
+  float W1;
+  double Sector;
+  int n = Horizon->NCells;
+  int k;
+  int i;
+
+  if (SinAlt <= 0.0) {
+    memset(Shade, 0, n);
+  }
+  else {
+    CosAlt = sqrt(1.0 - SinAlt * SinAlt);
+    SinAz = sin(SolarGeo->SolarAzimuth);
+    CosAz = cos(SolarGeo->SolarAzimuth);
+    AltCode = asin(SinAlt) / HORIZON_STEP;
+    Scale = 255.0 / (SinAlt * 11.47);
+
+    Sector = SolarGeo->SolarAzimuth / (2. * PI) * Horizon->NSectors;
+    Sector -= floor(Sector / Horizon->NSectors) * Horizon->NSectors;
+    k = (int) Sector;
+    W1 = Sector - k;
+    W0 = 1.0 - W1;
+    k %= Horizon->NSectors;
+    A0 = Horizon->Angle + (size_t) k * n;
+    A1 = Horizon->Angle + (size_t) ((k + 1) % Horizon->NSectors) * n;
+
+    /* the shade factor of make_shade_maps, 255 * the incidence on the slope
+       / the sine of the altitude / 11.47, 0 if the cell is in the shade of
+       the terrain */
+    for (i = 0; i < n; i++) {
+      float Incidence = SinAlt * Horizon->CosSlope[i] +
+	CosAlt * (Horizon->SinSlopeN[i] * CosAz +
+		  Horizon->SinSlopeE[i] * SinAz);
+      float Factor = (Incidence > 0.0 &&
+		      W0 * A0[i] + W1 * A1[i] <= AltCode) ?
+	Incidence * Scale : 0.0;
+      Shade[i] = (unsigned char) ((Factor < 255.0) ? Factor : 255.0);
+    }
+  }
+
+  for (i = 0; i < n; i++)
+    ShadowMap->Block[Map->ActiveCells[i].y * Map->NX +
+		     Map->ActiveCells[i].x] = Shade[i];
+}
+
+/*****************************************************************************
+  Function name: SweepSector()
+
+  Purpose      : Tangents of the horizon angles of sector k of all the cells
+
+  Comments     : See horizon.c of the preprocessing programs.  The cells are
+                 cut into lines in the direction of the sector, one cell per
+                 column (or row), and each line is swept from its far end
+                 while the upper convex hull of the elevations ahead is kept
+                 on a stack, so that a sector costs O(cells).  Only terrain
+                 higher than the cell counts
+*****************************************************************************/
+static void SweepSector(MAPSIZE *Map, float *Elev, int NSectors, int k,
+			int NThreads, float *Tan)
+{
+  const char *Routine = "SweepSector";
+  double Azimuth = 2. * PI * k / NSectors;
+  double Ex = sin(Azimuth);	/* east component of the direction */
+  double Ey = -cos(Azimuth);	/* south component (rows go south) */
+  int XMajor = (fabs(Ex) >= fabs(Ey));
+  double Major = XMajor ? Ex : Ey;
+  double Minor = (XMajor ? Ey : Ex) / fabs(Major);
+  double Step = Map->DX / fabs(Major);	/* distance of a step */
+  int NSteps = XMajor ? Map->NX : Map->NY;
+  int NOther = XMajor ? Map->NY : Map->NX;
+  int *Offset;			/* minor axis offset of each step */
+  int OffsetMin = 0;
+  int OffsetMax = 0;
+  int Line;
+  int i;
+
+  if (!(Offset = (int *) calloc(NSteps, sizeof(int))))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < NSteps; i++) {
+    Offset[i] = (int) floor(i * Minor + 0.5);
+    if (Offset[i] < OffsetMin)
+      OffsetMin = Offset[i];
+    if (Offset[i] > OffsetMax)
+      OffsetMax = Offset[i];
+  }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(NThreads) private(i, Line)
+#endif
+  {
+    int *Cell;			/* cell of each point of the line */
+    int *Stack;			/* upper hull of the points ahead */
+    float *S;			/* distance along the line */
+    float *Z;			/* elevation */
+    int Height;
+    int m;
+    int j;
+
+    if (!(Cell = (int *) calloc(NSteps, sizeof(int))) ||
+	!(Stack = (int *) calloc(NSteps, sizeof(int))) ||
+	!(S = (float *) calloc(NSteps, sizeof(float))) ||
+	!(Z = (float *) calloc(NSteps, sizeof(float))))
+      ReportError((char *) Routine, 1);
+
+#ifdef HAVE_OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+    for (Line = -OffsetMax; Line < NOther - OffsetMin; Line++) {
+      /* the cells of the line, in the direction of the sector */
+      for (i = 0, m = 0; i < NSteps; i++) {
+	int s = (Major > 0) ? i : NSteps - 1 - i;
+	int o = Line + Offset[i];
+
+	if (o < 0 || o >= NOther)
+	  continue;
+	Cell[m] = XMajor ? o * Map->NX + s : s * Map->NX + o;
+	S[m] = (float) (i * Step);
+	Z[m] = Elev[Cell[m]];
+	m++;
+      }
+
+      /* from the far end back, the top of the stack is the nearest vertex
+         of the hull */
+      for (j = m - 1, Height = 0; j >= 0; j--) {
+	while (Height >= 2 &&
+	       (Z[Stack[Height - 2]] - Z[j]) / (S[Stack[Height - 2]] - S[j]) >=
+	       (Z[Stack[Height - 1]] - Z[j]) / (S[Stack[Height - 1]] - S[j]))
+	  Height--;
+	Tan[Cell[j]] = 0.0;
+	if (Height > 0 && Z[Stack[Height - 1]] > Z[j])
+	  Tan[Cell[j]] = (Z[Stack[Height - 1]] - Z[j]) /
+	    (S[Stack[Height - 1]] - S[j]);
+	Stack[Height++] = j;
+      }
+    }
+
+    free(Cell);
+    free(Stack);
+    free(S);
+    free(Z);
+  }
+
+  free(Offset);
+}
+
+/*****************************************************************************
+  Function name: DemHash()
+
+  Purpose      : FNV-1a hash of the elevations, to tell if a HORIZON FILE was
+                 made for them
+*****************************************************************************/
+static unsigned int DemHash(float *Elev, size_t NCells)
+{
+  const unsigned char *Byte = (const unsigned char *) Elev;
+  unsigned int Hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < NCells * sizeof(float); i++) {
+    Hash ^= Byte[i];
+    Hash *= 16777619u;
+  }
+  return Hash;
+}
+
+/*****************************************************************************
+  Function name: ReadHorizonFile()
+
+  Purpose      : Open FileName if it holds the horizons of this DEM, cell
+                 size and number of sectors
+
+  Returns      : The file, at the tangents of the first sector, NULL if it
+                 does not exist or holds other horizons
+*****************************************************************************/
+static FILE *ReadHorizonFile(char *FileName, MAPSIZE *Map, int NSectors,
+			     unsigned int Hash)
+{
+  HORIZONHEADER Header;
+  FILE *In;
+
+  if (!(In = fopen(FileName, "rb")))
+    return NULL;
+  if (fread(&Header, sizeof(Header), 1, In) == 1 &&
+      memcmp(Header.Magic, HORIZON_MAGIC, sizeof(Header.Magic)) == 0 &&
+      Header.NRows == Map->NY && Header.NCols == Map->NX &&
+      Header.NSectors == NSectors && Header.DX == Map->DX &&
+      Header.Hash == Hash)
+    return In;
+  fclose(In);
+  printf("%s is not a horizon file of this DEM and number of sectors\n",
+	 FileName);
+  return NULL;
+}
+
+/*****************************************************************************
+  Function name: WriteHorizonFile()
+
+  Purpose      : Create FileName and write the header of the horizons
+
+  Returns      : The file, to be followed by the tangents of the sectors,
+                 NULL if it can not be written
+*****************************************************************************/
+static FILE *WriteHorizonFile(char *FileName, MAPSIZE *Map, int NSectors,
+			      unsigned int Hash)
+{
+  HORIZONHEADER Header;
+  FILE *Out;
+
+  memset(&Header, 0, sizeof(Header));
+  memcpy(Header.Magic, HORIZON_MAGIC, sizeof(Header.Magic));
+  Header.NRows = Map->NY;
+  Header.NCols = Map->NX;
+  Header.NSectors = NSectors;
+  Header.DX = Map->DX;
+  Header.Hash = Hash;
+
+  if (!(Out = fopen(FileName, "wb")) ||
+      fwrite(&Header, sizeof(Header), 1, Out) != 1) {
+    printf("Cannot write the horizons to %s\n", FileName);
+    if (Out != NULL) {
+      fclose(Out);
+      remove(FileName);
+    }
+    return NULL;
+  }
+  return Out;
+}
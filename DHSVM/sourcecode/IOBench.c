@@ -0,0 +1,198 @@
+/*
+ * SUMMARY:      IOBench.c - Bytes and latency of the reads and writes
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With "DHSVM --io-bench" (dhsvm_io_bench()) the time loop
+ *               only does the reads and writes of the configured run, and
+ *               each class of them (see iobench.h) is timed here.  The
+ *               report gives the calls, the wall clock time per call and
+ *               the bytes moved by each class.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitIOBench()
+ *               IOBenchBegin()
+ *               IOBenchEnd()
+ *               IOBenchReport()
+ *               ProcessIO()
+ *               ProcessBytes()
+ * COMMENTS:     The bytes are those the process has read and written
+ *               between the start and the end of a call, from the rchar
+ *               and wchar counters of /proc/self/io, so they include the
+ *               buffered writes of the C library and of the output writer
+ *               thread, which are flushed before a call ends.  The time of
+ *               a call therefore includes writing its data out, and the
+ *               writes of OUTPUT QUEUE SIZE are not overlapped with the
+ *               next step.  Where /proc/self/io does not exist only the
+ *               times are reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "fileio.h"
+#include "profile.h"
+#include "iobench.h"
+
+int IOBenchOn = FALSE;
+
+/* totals of a class */
+typedef struct {
+  int N;			/* calls */
+  double Wall;			/* wall clock time of the calls (s) */
+  double MaxWall;		/* longest call (s) */
+  double Bytes;			/* bytes read and written by the calls */
+  double Start;			/* wall clock time at the start of a call */
+  double StartBytes;		/* ProcessBytes() at the start of a call */
+} IOCLASS;
+
+static IOCLASS Classes[NIOCLASSES];
+static double Overhead = 0.0;	/* bytes read by ProcessBytes() itself */
+static int HaveBytes = FALSE;	/* TRUE if /proc/self/io can be read */
+
+static const char *ClassNames[NIOCLASSES] = {
+  "forcing reads", "aggregated values", "pixel dumps", "state dumps",
+  "map dumps", "channel output"
+};
+
+static double ProcessBytes(void);
+
+/*****************************************************************************
+  Function name: InitIOBench()
+
+  Purpose      : Start the accounting of the classes
+*****************************************************************************/
+void InitIOBench(void)
+{
+  double First;
+
+  memset(Classes, 0, sizeof(Classes));
+  First = ProcessBytes();
+  HaveBytes = (First >= 0.0);
+  if (HaveBytes)
+    Overhead = ProcessBytes() - First;
+  IOBenchOn = TRUE;
+}
+
+/*****************************************************************************
+  Function name: IOBenchBegin()
+
+  Purpose      : Start a call of class Class
+
+  Comments     : The output of the calls before is written out first, so
+                 that it is not counted with this call
+*****************************************************************************/
+void IOBenchBegin(int Class)
+{
+  fflush(NULL);
+  WaitFileIO();
+  Classes[Class].StartBytes = HaveBytes ? ProcessBytes() : 0.0;
+  Classes[Class].Start = WallClock();
+}
+
+/*****************************************************************************
+  Function name: IOBenchEnd()
+
+  Purpose      : End the call of class Class started with IOBenchBegin()
+*****************************************************************************/
+void IOBenchEnd(int Class)
+{
+  IOCLASS *C = &(Classes[Class]);
+  double Wall;
+
+  fflush(NULL);
+  WaitFileIO();
+  Wall = WallClock() - C->Start;
+  if (HaveBytes)
+    C->Bytes += ProcessBytes() - C->StartBytes - Overhead;
+  C->Wall += Wall;
+  if (Wall > C->MaxWall)
+    C->MaxWall = Wall;
+  C->N++;
+}
+
+/*****************************************************************************
+  Function name: IOBenchReport()
+
+  Purpose      : Print the calls, the time and the bytes of each class
+
+  Required     :
+    const char *ConfigFile - configuration file of the run
+    int NSteps             - time steps replayed
+    double Wall            - wall clock time of the steps (s)
+*****************************************************************************/
+void IOBenchReport(const char *ConfigFile, int NSteps, double Wall)
+{
+  IOCLASS *C;
+  double Total = 0.0;
+  int i;
+
+  printf("\nI/O benchmark of %s\n", ConfigFile);
+  printf("Replayed the reads and writes of %d steps in %.2f s\n", NSteps,
+	 Wall);
+  printf("%-18s %7s %10s %10s %10s %10s %9s\n", "class", "calls",
+	 "total (s)", "mean (ms)", "max (ms)", "MB", "MB/s");
+  for (i = 0; i < NIOCLASSES; i++) {
+    C = &(Classes[i]);
+    if (C->N == 0)
+      continue;
+    printf("%-18s %7d %10.3f %10.3f %10.3f", ClassNames[i], C->N, C->Wall,
+	   1000. * C->Wall / C->N, 1000. * C->MaxWall);
+    if (HaveBytes)
+      printf(" %10.3f %9.1f\n", C->Bytes / 1048576.,
+	     (C->Wall > 0.0) ? C->Bytes / 1048576. / C->Wall : 0.0);
+    else
+      printf(" %10s %9s\n", "-", "-");
+    Total += C->Bytes;
+  }
+  if (HaveBytes)
+    printf("%.3f MB read and written, %.3f MB per step\n", Total / 1048576.,
+	   (NSteps > 0) ? Total / 1048576. / NSteps : 0.0);
+  fflush(stdout);
+  IOBenchOn = FALSE;
+}
+
+/*****************************************************************************
+  Function name: ProcessIO()
+
+  Purpose      : Bytes read and written by the process so far
+
+  Required     :
+    double *Read    - bytes read
+    double *Written - bytes written
+
+  Returns      : TRUE if they are known, FALSE otherwise
+
+  Modifies     : Read and Written
+*****************************************************************************/
+int ProcessIO(double *Read, double *Written)
+{
+  char Line[BUFSIZE + 1];
+  int NFound = 0;
+  FILE *In;
+
+  if ((In = fopen("/proc/self/io", "r")) == NULL)
+    return FALSE;
+  while (fgets(Line, sizeof(Line), In) != NULL)
+    if (sscanf(Line, "rchar: %lf", Read) == 1 ||
+	sscanf(Line, "wchar: %lf", Written) == 1)
+      NFound++;
+  fclose(In);
+  return (NFound == 2);
+}
+
+/*****************************************************************************
+  Function name: ProcessBytes()
+
+  Purpose      : Bytes read and written by the process so far, -1 if they are
+                 not known
+*****************************************************************************/
+static double ProcessBytes(void)
+{
+  double Read;
+  double Written;
+
+  return ProcessIO(&Read, &Written) ? Read + Written : -1.0;
+}
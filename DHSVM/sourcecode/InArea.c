@@ -6,9 +6,10 @@
  * ORG:          University of Washington, Department of Civil Engineering
  * E-MAIL:       nijssen@u.washington.edu
  * ORIG-DATE:    Apr-96
- * DESCRIPTION:  Check whether a pixel is in the area
+ * DESCRIPTION:  Check whether a pixel is in the area, or in the input maps
  * DESCRIP-END.
  * FUNCTIONS:    InArea()
+ *               InInputArea()
  * COMMENTS:
  * $Id $     
  */
@@ -31,3 +32,21 @@ uchar InArea(MAPSIZE * Map, COORD * Loc)
   else
     return TRUE;
 }
+
+/*****************************************************************************
+  InInputArea()
+
+  Same as InArea(), for the input maps, of which Map is a window in POINT
+  mode (see PointWindow())
+*****************************************************************************/
+uchar InInputArea(MAPSIZE * Map, COORD * Loc)
+{
+  if (Map->FileNY == 0)
+    return InArea(Map, Loc);
+  if (Loc->N + Map->WinY < 0 || Loc->N + Map->WinY > (Map->FileNY - 1))
+    return FALSE;
+  else if (Loc->E + Map->WinX < 0 || Loc->E + Map->WinX > (Map->FileNX - 1))
+    return FALSE;
+  else
+    return TRUE;
+}
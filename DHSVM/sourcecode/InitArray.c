@@ -9,13 +9,18 @@
  * DESCRIPTION:  Initialize array
  * DESCRIP-END.
  * FUNCTIONS:    InitCharArray()
+ *               AllocHaloMap()
+ *               FreeHaloMap()
+ *               GrowFieldBlock()
  * COMMENTS:
  * $Id: InitArray.c,v 1.4 2003/07/01 21:26:15 olivier Exp $     
  */
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "functions.h"
+#include "memaccount.h"
 
 void InitCharArray(char *Array, int Size)
 {
@@ -24,3 +29,79 @@ void InitCharArray(char *Array, int Size)
   for (i = 0; i < Size; i++)
     Array[i] = '\0';
 }
+
+/*****************************************************************************
+  AllocHaloMap()
+
+  Allocates an NY by NX map with elements of Size bytes as a single block 
+  with a border (halo) of one element around it, and returns the row 
+  pointers.  Map[y][x] is valid for y = -1 .. NY and x = -1 .. NX, so that 
+  the neighbours of every cell in the map can be addressed without checking
+  the grid bounds.  Consecutive rows are NX + 2 elements apart (see 
+  InitNeighborOffsets()).  The whole block, including the halo, is set to 
+  zero.  Returns NULL if the memory cannot be allocated.  The pages are not
+  touched (see FirstTouchRows()).  The memory is counted for the subsystem
+  Tag (memaccount.h).
+*****************************************************************************/
+void *AllocHaloMap(int NY, int NX, size_t Size, int Tag)
+{
+  char **Rows;
+  char *Block;
+  int y;
+
+  if (!(Rows = (char **) TaggedCalloc(NY + 2, sizeof(char *), Tag)))
+    return NULL;
+  if (!(Block = (char *) TaggedCalloc((size_t) (NY + 2) * (NX + 2), Size,
+				      Tag))) {
+    TaggedFree(Rows);
+    return NULL;
+  }
+  HugePageHint(Block, (size_t) (NY + 2) * (NX + 2) * Size);
+  for (y = 0; y < NY + 2; y++)
+    Rows[y] = Block + ((size_t) y * (NX + 2) + 1) * Size;
+
+  return (void *) (Rows + 1);
+}
+
+/*****************************************************************************
+  FreeHaloMap()
+
+  Frees a map allocated with AllocHaloMap()
+*****************************************************************************/
+void FreeHaloMap(void *Map, size_t Size)
+{
+  char **Rows;
+
+  if (Map == NULL)
+    return;
+  Rows = ((char **) Map) - 1;
+  TaggedFree(Rows[0] - Size);
+  TaggedFree(Rows);
+}
+
+/*****************************************************************************
+  GrowFieldBlock()
+
+  Allocates a block of NFields arrays of NewMax floats each and copies the
+  first N values of each of the NFields arrays of OldMax floats in Fields
+  to it.  Fields, which may be NULL if N is 0, is freed.  Returns the new
+  block, or NULL if the memory cannot be allocated, in which case Fields is
+  left as it was.  Used by the cell batches of the pixel loop, which keep
+  one array per variable (see RadiationBatch.c and InterceptionBatch.c).
+*****************************************************************************/
+float *GrowFieldBlock(float *Fields, int NFields, int N, int OldMax,
+		      int NewMax)
+{
+  float *Block;
+  int f;
+
+  if (!(Block = (float *) malloc((size_t) NFields * NewMax * sizeof(float))))
+    return NULL;
+  if (Fields != NULL && N > 0) {
+    for (f = 0; f < NFields; f++)
+      memcpy(Block + (size_t) f * NewMax, Fields + (size_t) f * OldMax,
+	     N * sizeof(float));
+  }
+  free(Fields);
+  return Block;
+}
@@ -9,6 +9,7 @@
  * DESCRIPTION:  Initialize constants for DHSVM
  * DESCRIP-END.
  * FUNCTIONS:    InitConstants()
+ *               PointWindow()
  * COMMENTS:
  * $Id: InitConstants.c,v 1.16 2004/08/18 01:01:28 colleen Exp $     
  */
@@ -27,6 +28,13 @@
 #include "getinit.h"
 #include "constants.h"
 #include "rad.h"
+#include "messagelog.h"
+
+static void PointWindow(OPTIONSTRUCT *Options, MAPSIZE *Map);
+#include "cpudispatch.h"
+#include "fastmath.h"
+#include "rollover.h"
+#include "resumeio.h"
 
 /*****************************************************************************
   Function name: InitConstants()
@@ -54,10 +62,14 @@
 void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
 		   SOLARGEOMETRY *SolarGeo, TIMESTRUCT *Time)
 {
+  const char *Routine = "InitConstants";
   int i;			/* counter */
   double PointModelX;		/* X-coordinate for POINT model mode */
   double PointModelY;		/* Y-coordinate for POINT model mode */
+  double OutletY;		/* Y-coordinate of the sub-basin outlet */
+  double OutletX;		/* X-coordinate of the sub-basin outlet */
   float TimeStep;		/* Timestep in hours */
+  float MetInterval;		/* Interval of the station records in hours */
   DATE End;			/* End of run */
   DATE Start;			/* Start of run */
 
@@ -92,6 +104,101 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
 	{"OPTIONS", "STREAM TEMPERATURE", "", ""}, 
 	{"OPTIONS", "RIPARIAN SHADING", "", ""}, 
     {"OPTIONS", "IMPROVED RADIATION SCHEME", "", "" },
+    {"OPTIONS", "NUMBER OF THREADS", "", "1"},
+    {"OPTIONS", "PARALLEL CHANNEL ROUTING", "", "FALSE"},
+    {"OPTIONS", "NETCDF SYNC INTERVAL", "", "0"},
+    {"OPTIONS", "MET FORCING CACHE", "", ""},
+    {"OPTIONS", "MAX INTERPOLATION STATIONS", "", "0"},
+    {"OPTIONS", "PREFETCH MET DATA", "", "FALSE"},
+    {"OPTIONS", "SURFACE TEMPERATURE SOLVER", "", "BRENT"},
+    {"OPTIONS", "WATER TABLE TOLERANCE", "", "0"},
+    {"OPTIONS", "SOIL TABLE SIZE", "", "0"},
+    {"OPTIONS", "OUTPUT QUEUE SIZE", "", "0"},
+    {"OPTIONS", "BASIN ONLY OUTPUT", "", "FALSE"},
+    {"OPTIONS", "CHANNEL OUTPUT FORMAT", "", "TEXT"},
+    {"OPTIONS", "STATE FORMAT", "", "MAPS"},
+    {"OPTIONS", "CHECKPOINT BASE INTERVAL", "", "1"},
+    {"OPTIONS", "ENSEMBLE MEMBERS", "", "1"},
+    {"OPTIONS", "ENSEMBLE PRECIPITATION FACTORS", "", ""},
+    {"OPTIONS", "ENSEMBLE PRECIPITATION PERTURBATION", "", "0"},
+    {"OPTIONS", "ENSEMBLE TEMPERATURE PERTURBATION", "", "0"},
+    {"OPTIONS", "ENSEMBLE RADIATION PERTURBATION", "", "0"},
+    {"OPTIONS", "ENSEMBLE PERTURBATION AUTOCORRELATION", "", "0"},
+    {"OPTIONS", "ENSEMBLE PERTURBATION STATION CORRELATION", "", "0"},
+    {"OPTIONS", "ENSEMBLE PERTURBATION SEED", "", "1"},
+    {"OPTIONS", "HRU MODE", "", "FALSE"},
+    {"OPTIONS", "HRU ELEVATION BAND", "", "100"},
+    {"OPTIONS", "HRU SLOPE CLASS", "", "5"},
+    {"OPTIONS", "HRU ASPECT CLASS", "", "45"},
+    {"OPTIONS", "HRU SOIL DEPTH CLASS", "", "0.5"},
+    {"OPTIONS", "HRU SKY VIEW CLASS", "", "0.1"},
+    {"OPTIONS", "HRU MET WEIGHT TOLERANCE", "", "0.05"},
+    {"OPTIONS", "SUB-BASIN OUTLET SEGMENT", "", ""},
+    {"OPTIONS", "SUB-BASIN OUTLET NORTH", "", ""},
+    {"OPTIONS", "SUB-BASIN OUTLET EAST", "", ""},
+    {"OPTIONS", "MET GRID SPACING", "", "1"},
+    {"OPTIONS", "CELL TILE SIZE", "", "0"},
+    {"OPTIONS", "THREAD PINNING", "", "NONE"},
+    {"OPTIONS", "HUGE PAGES", "", "FALSE"},
+    {"OPTIONS", "PROFILE", "", "FALSE"},
+    {"OPTIONS", "TRACE FILE", "", ""},
+    {"OPTIONS", "TRACE INTERVAL", "", "1"},
+    {"OPTIONS", "PERF COUNTERS", "", "FALSE"},
+    {"OPTIONS", "PERF VECTOR EVENTS", "", ""},
+    {"OPTIONS", "CELL COST TIMING", "", "FALSE"},
+    {"OPTIONS", "MEMORY LIMIT", "", "0"},
+    {"OPTIONS", "TELEMETRY FILE", "", ""},
+    {"OPTIONS", "TELEMETRY FORMAT", "", "JSON"},
+    {"OPTIONS", "TELEMETRY INTERVAL", "", "10"},
+    {"OPTIONS", "MONITOR FEED", "", ""},
+    {"OPTIONS", "MONITOR FEED SLOTS", "", "64"},
+    {"OPTIONS", "MONITOR FEED MAP STRIDE", "", "8"},
+    {"OPTIONS", "PARALLEL INITIALIZATION", "", "FALSE"},
+    {"OPTIONS", "STREAM TEMPERATURE SOLVER", "", "EXTERNAL"},
+    {"OPTIONS", "QUIESCENT CELLS", "", "NONE"},
+    {"OPTIONS", "MAXIMUM OPEN MET FILES", "", "0"},
+    {"OPTIONS", "STATIC MAP BITS", "", "0"},
+    {"OPTIONS", "CHANNEL ROUTING SUBSTEPS", "", "1"},
+    {"OPTIONS", "CELL ORDER", "", "ROW"},
+    {"OPTIONS", "CELL ORDER TILE", "", "64"},
+    {"OPTIONS", "CHECKPOINT CHANNEL FLOWS", "", "FALSE"},
+    {"OPTIONS", "PIXEL OUTPUT FORMAT", "", "TEXT"},
+    {"OPTIONS", "SPIN UP CYCLES", "", "0"},
+    {"OPTIONS", "SPIN UP TOLERANCE", "", "0.001"},
+    {"OPTIONS", "SPIN UP ACCELERATION", "", "1.0"},
+    {"OPTIONS", "CHECKPOINT WALL INTERVAL", "", "0"},
+    {"OPTIONS", "STATIC DATA SHARE", "", ""},
+    {"OPTIONS", "SOIL COLUMN BATCH", "", "FALSE"},
+    {"OPTIONS", "RADIATION BATCH", "", "FALSE"},
+    {"OPTIONS", "INTERCEPTION BATCH", "", "FALSE"},
+    {"OPTIONS", "PIPELINE CHANNEL ROUTING", "", "FALSE"},
+    {"OPTIONS", "CONCURRENT STAGES", "", "FALSE"},
+    {"OPTIONS", "CELL CLASS ORDER", "", "FALSE"},
+    {"OPTIONS", "CHANNEL INFLOW RECORD", "", "FALSE"},
+    {"OPTIONS", "MESSAGE LEVEL", "", "NOTE"},
+    {"OPTIONS", "MESSAGE LIMIT", "", "10"},
+    {"OPTIONS", "SIMD LEVEL", "", "AUTO"},
+    {"OPTIONS", "MATH ACCURACY", "", "EXACT"},
+    {"OPTIONS", "OUTPUT ROLLOVER", "", "NONE"},
+    {"OPTIONS", "OUTPUT ROLLOVER NAME", "", ROLLOVER_TEMPLATE},
+    {"OPTIONS", "CHECKPOINT COMPRESSION", "", "NONE"},
+    {"OPTIONS", "CHECKPOINT COMPRESSION LEVEL", "", "1"},
+    {"OPTIONS", "CHECKPOINT SHUFFLE", "", "FALSE"},
+    {"OPTIONS", "OUT OF CORE DIRECTORY", "", ""},
+    {"OPTIONS", "AUTO TUNE", "", "FALSE"},
+    {"OPTIONS", "AUTO TUNE STEPS", "", "0"},
+    {"OPTIONS", "AUTO TUNE FILE", "", ""},
+    {"OPTIONS", "SNOW ONLY", "", "FALSE"},
+    {"OPTIONS", "CHANNEL ROUTING BATCH", "", "FALSE"},
+    {"OPTIONS", "SHADING MODE", "", "MAPS"},
+    {"OPTIONS", "HORIZON SECTORS", "", "32"},
+    {"OPTIONS", "HORIZON FILE", "", ""},
+    {"OPTIONS", "MAP FILE LAYOUT", "", "SEPARATE"},
+    {"OPTIONS", "MET FILE INTERVAL", "", ""},
+    {"OPTIONS", "MET INTERPOLATION", "", "LINEAR"},
+    {"OPTIONS", "CONCURRENT NETWORK ROUTING", "", "FALSE"},
+    {"OPTIONS", "RADIATION TABLE SIZE", "", "0"},
+    {"OPTIONS", "SUBSURFACE ROUTING SUBSTEPS", "", "1"},
     {"AREA", "COORDINATE SYSTEM", "", ""},
     {"AREA", "EXTREME NORTH", "", ""},
     {"AREA", "EXTREME WEST", "", ""},
@@ -134,7 +241,11 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
   /**************** Determine model options ****************/
 
   /* Determine file format to be used */
-  if (strncmp(StrEnv[format].VarStr, "BIN", 3) == 0)
+  if (strncmp(StrEnv[format].VarStr, "BINZ", 4) == 0)
+    Options->FileFormat = BINZ;
+  else if (strncmp(StrEnv[format].VarStr, "ZARR", 4) == 0)
+    Options->FileFormat = ZARR;
+  else if (strncmp(StrEnv[format].VarStr, "BIN", 3) == 0)
     Options->FileFormat = BIN;
   else if (strncmp(StrEnv[format].VarStr, "NETCDF", 3) == 0)
     Options->FileFormat = NETCDF;
@@ -299,6 +410,59 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
   else
     ReportError(StrEnv[canopy_shading].KeyName, 51);
 
+  /* Determine whether the stream temperature is solved by RBM after the
+     run, from the forcing files, or during the run, in memory */
+  if (strncmp(StrEnv[stream_temp_solver].VarStr, "EXTERNAL", 8) == 0)
+    Options->StreamTempSolver = STREAMTEMP_EXTERNAL;
+  else if (strncmp(StrEnv[stream_temp_solver].VarStr, "INTERNAL", 8) == 0)
+    Options->StreamTempSolver = STREAMTEMP_INTERNAL;
+  else
+    ReportError(StrEnv[stream_temp_solver].KeyName, 51);
+
+  /* Determine whether the cells without water input or drainage take the
+     fast path of MassEnergyBalance(), EXACT only skips the steps that do
+     not change the state, RELAXED also skips the transpiration at night */
+  if (strncmp(StrEnv[quiescent_cells].VarStr, "NONE", 4) == 0)
+    Options->QuietCells = QUIET_NONE;
+  else if (strncmp(StrEnv[quiescent_cells].VarStr, "EXACT", 5) == 0)
+    Options->QuietCells = QUIET_EXACT;
+  else if (strncmp(StrEnv[quiescent_cells].VarStr, "RELAXED", 7) == 0)
+    Options->QuietCells = QUIET_RELAXED;
+  else
+    ReportError(StrEnv[quiescent_cells].KeyName, 51);
+
+  /* Number of station (or grid) met files that are kept open, the others
+     are closed until they are read (0 = all are kept open) */
+  if (!CopyInt(&(Options->MaxMetFiles), StrEnv[max_met_files].VarStr, 1) ||
+      Options->MaxMetFiles < 0)
+    ReportError(StrEnv[max_met_files].KeyName, 51);
+
+  /* Storage of the static maps (sky view, wind model, precipitation lapse
+     rate): 0 keeps the values, 8 or 16 bit fixed point codes make them
+     smaller */
+  if (!CopyInt(&(Options->StaticMapBits), StrEnv[static_map_bits].VarStr, 1) ||
+      (Options->StaticMapBits != 0 && Options->StaticMapBits != 8 &&
+       Options->StaticMapBits != 16))
+    ReportError(StrEnv[static_map_bits].KeyName, 51);
+
+  /* Number of routing steps of the road and stream channels, and of the
+     saturated subsurface flow, in each model step.  The model step has to
+     be a multiple of the routing steps (checked below, when the model step
+     is known).  The energy and water balance of the cells, the surface
+     routing, the met input and the output run at the model step, so for a
+     coarse physics step with fine routing the model step is set to the
+     physics step and the channels and the subsurface flow are routed in
+     sub-steps of it.  There is no separate multiple of the model step for
+     the vertical physics. */
+  if (!CopyInt(&(Options->RoutingSubsteps),
+	       StrEnv[channel_routing_substeps].VarStr, 1) ||
+      Options->RoutingSubsteps < 1)
+    ReportError(StrEnv[channel_routing_substeps].KeyName, 51);
+  if (!CopyInt(&(Options->SubSurfaceSubsteps),
+	       StrEnv[subsurface_routing_substeps].VarStr, 1) ||
+      Options->SubSurfaceSubsteps < 1)
+    ReportError(StrEnv[subsurface_routing_substeps].KeyName, 51);
+
   /* Determine if then improved radiation scheme will be used */
   if (strncmp(StrEnv[improv_radiation].VarStr, "TRUE", 4) == 0)
     Options->ImprovRadiation = TRUE;
@@ -307,6 +471,365 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
   else
     ReportError(StrEnv[improv_radiation].KeyName, 51);
 
+  /* Number of threads used for the pixel loop (only with OpenMP builds) */
+  if (!CopyInt(&(Options->NThreads), StrEnv[number_of_threads].VarStr, 1) ||
+      Options->NThreads < 1)
+    ReportError(StrEnv[number_of_threads].KeyName, 51);
+
+  /* Number of active cells in each tile of the threaded cell loops, 0 if
+     each thread does a fixed block of cells */
+  if (!CopyInt(&(Options->CellTileSize), StrEnv[cell_tile_size].VarStr, 1) ||
+      Options->CellTileSize < 0)
+    ReportError(StrEnv[cell_tile_size].KeyName, 51);
+
+  /* Order of the active cells in all the per-cell loops and arrays: ROW
+     (row-major), MORTON (Z-order curve) or TILES (square tiles of CELL
+     ORDER TILE cells on a side, row-major within and between the tiles) */
+  if (strncmp(StrEnv[cell_order].VarStr, "ROW", 3) == 0)
+    Options->CellOrder = CELLORDER_ROW;
+  else if (strncmp(StrEnv[cell_order].VarStr, "MORTON", 6) == 0)
+    Options->CellOrder = CELLORDER_MORTON;
+  else if (strncmp(StrEnv[cell_order].VarStr, "TILES", 5) == 0)
+    Options->CellOrder = CELLORDER_TILES;
+  else
+    ReportError(StrEnv[cell_order].KeyName, 51);
+  if (!CopyInt(&(Options->CellOrderTile), StrEnv[cell_order_tile].VarStr, 1) ||
+      Options->CellOrderTile < 1)
+    ReportError(StrEnv[cell_order_tile].KeyName, 51);
+
+  /* Order in which the pixel loop does the cells of each thread block or
+     tile: in the order above, or grouped by their canopy, snow, impervious
+     and road or channel cut structure, see OrderStructureClasses() */
+  if (strncmp(StrEnv[cell_class_order].VarStr, "TRUE", 4) == 0)
+    Options->CellClassOrder = TRUE;
+  else if (strncmp(StrEnv[cell_class_order].VarStr, "FALSE", 5) == 0)
+    Options->CellClassOrder = FALSE;
+  else
+    ReportError(StrEnv[cell_class_order].KeyName, 51);
+#ifndef HAVE_OPENMP
+  if (Options->NThreads > 1) {
+    printf("WARNING: DHSVM was built without OpenMP, ignoring %s = %d\n",
+	   StrEnv[number_of_threads].KeyName, Options->NThreads);
+    Options->NThreads = 1;
+  }
+#endif
+
+  /* Determine if the channel networks are routed with NThreads threads */
+  if (strncmp(StrEnv[parallel_routing].VarStr, "TRUE", 4) == 0)
+    Options->ParallelRouting = TRUE;
+  else if (strncmp(StrEnv[parallel_routing].VarStr, "FALSE", 5) == 0)
+    Options->ParallelRouting = FALSE;
+  else
+    ReportError(StrEnv[parallel_routing].KeyName, 51);
+
+  /* Route the segments of each level of the channel networks together, as
+     loops over arrays of the level (see ChannelBatch.c) */
+  if (strncmp(StrEnv[channel_routing_batch].VarStr, "TRUE", 4) == 0)
+    Options->RoutingBatch = TRUE;
+  else if (strncmp(StrEnv[channel_routing_batch].VarStr, "FALSE", 5) == 0)
+    Options->RoutingBatch = FALSE;
+  else
+    ReportError(StrEnv[channel_routing_batch].KeyName, 51);
+
+  /* Number of writes to an open NetCDF file between flushes to disk */
+  if (!CopyInt(&(Options->NcSyncInterval), StrEnv[nc_sync_interval].VarStr, 1) ||
+      Options->NcSyncInterval < 0)
+    ReportError(StrEnv[nc_sync_interval].KeyName, 51);
+
+  /* Binary cache of the station met files (empty = read the text files) */
+  strcpy(Options->MetCacheFile, StrEnv[met_cache_file].VarStr);
+
+  /* Maximum number of stations with a non-zero interpolation weight */
+  if (!CopyInt(&(Options->MaxInterpStations), 
+	       StrEnv[max_interp_stations].VarStr, 1) ||
+      Options->MaxInterpStations < 0)
+    ReportError(StrEnv[max_interp_stations].KeyName, 51);
+
+  /* Determine if the station records for the next step are read while the
+     subsurface routing for the current step is done */
+  if (strncmp(StrEnv[prefetch_met].VarStr, "TRUE", 4) == 0)
+    Options->PrefetchMet = TRUE;
+  else if (strncmp(StrEnv[prefetch_met].VarStr, "FALSE", 5) == 0)
+    Options->PrefetchMet = FALSE;
+  else
+    ReportError(StrEnv[prefetch_met].KeyName, 51);
+#ifndef HAVE_OPENMP
+  if (Options->PrefetchMet) {
+    printf("WARNING: DHSVM was built without OpenMP, ignoring %s\n",
+	   StrEnv[prefetch_met].KeyName);
+    Options->PrefetchMet = FALSE;
+  }
+#endif
+
+  /* Determine how the surface temperatures are solved for */
+  if (strncmp(StrEnv[tsurf_solver].VarStr, "BRENT", 5) == 0)
+    Options->TSurfSolver = BRENT;
+  else if (strncmp(StrEnv[tsurf_solver].VarStr, "NEWTON", 6) == 0)
+    Options->TSurfSolver = NEWTON;
+  else
+    ReportError(StrEnv[tsurf_solver].KeyName, 51);
+
+  /* Change in water level (m) below which the subsurface flow directions
+     of a cell and its neighbours are not recalculated (0 = always) */
+  if (!CopyFloat(&(Options->WaterTableTol),
+		 StrEnv[watertable_tolerance].VarStr, 1) ||
+      Options->WaterTableTol < 0.0)
+    ReportError(StrEnv[watertable_tolerance].KeyName, 51);
+
+  /* Number of entries in the per soil type interpolation tables for the
+     transmissivity and the unsaturated drainage (0 = exact functions) */
+  if (!CopyInt(&(Options->SoilTableSize), StrEnv[soil_table_size].VarStr, 1) ||
+      Options->SoilTableSize < 0 || Options->SoilTableSize == 1)
+    ReportError(StrEnv[soil_table_size].KeyName, 51);
+
+  /* Number of entries in the interpolation table of the diffuse fraction
+     of the shortwave radiation (0 = exact relation) */
+  if (!CopyInt(&(Options->RadiationTableSize),
+	       StrEnv[radiation_table_size].VarStr, 1) ||
+      Options->RadiationTableSize < 0 || Options->RadiationTableSize == 1)
+    ReportError(StrEnv[radiation_table_size].KeyName, 51);
+
+  /* Number of map writes that may wait for the background writer thread
+     (0 = maps are written before the model continues) */
+  if (!CopyInt(&(Options->OutputQueueSize), 
+	       StrEnv[output_queue_size].VarStr, 1) ||
+      Options->OutputQueueSize < 0)
+    ReportError(StrEnv[output_queue_size].KeyName, 51);
+
+  /* Determine if map and state files only hold the cells in the basin */
+  if (strncmp(StrEnv[basin_only_output].VarStr, "TRUE", 4) == 0)
+    Options->BasinOnlyOutput = TRUE;
+  else if (strncmp(StrEnv[basin_only_output].VarStr, "FALSE", 5) == 0)
+    Options->BasinOnlyOutput = FALSE;
+  else
+    ReportError(StrEnv[basin_only_output].KeyName, 51);
+
+  /* Determine if each map dump has its own file, or the map dumps with the
+     same dates share a NetCDF file (see InitMapDump()) */
+  if (strncmp(StrEnv[map_file_layout].VarStr, "SEPARATE", 8) == 0)
+    Options->MapFileLayout = MAPFILES_SEPARATE;
+  else if (strncmp(StrEnv[map_file_layout].VarStr, "COMBINED", 8) == 0 &&
+	   Options->FileFormat == NETCDF)
+    Options->MapFileLayout = MAPFILES_COMBINED;
+  else
+    ReportError(StrEnv[map_file_layout].KeyName, 51);
+
+  /* Determine whether the channel flows are written as text or binary, or
+     not at all */
+  if (strncmp(StrEnv[channel_output_format].VarStr, "TEXT", 4) == 0)
+    Options->ChannelOutput = CHANNEL_TEXT;
+  else if (strncmp(StrEnv[channel_output_format].VarStr, "BINARY", 6) == 0)
+    Options->ChannelOutput = CHANNEL_BINARY;
+  else if (strncmp(StrEnv[channel_output_format].VarStr, "NONE", 4) == 0)
+    Options->ChannelOutput = CHANNEL_NONE;
+  else
+    ReportError(StrEnv[channel_output_format].KeyName, 51);
+
+  /* Determine whether the lateral inflows of the streams are recorded, to
+     be routed again with DHSVM --route-only (see ChannelReplay.c) */
+  if (strncmp(StrEnv[channel_inflow_record].VarStr, "TRUE", 4) == 0)
+    Options->ChannelRecord = TRUE;
+  else if (strncmp(StrEnv[channel_inflow_record].VarStr, "FALSE", 5) == 0)
+    Options->ChannelRecord = FALSE;
+  else
+    ReportError(StrEnv[channel_inflow_record].KeyName, 51);
+
+  /* Determine whether the pixel time series are written as a text file for
+     each pixel or as one binary file */
+  if (strncmp(StrEnv[pixel_output_format].VarStr, "TEXT", 4) == 0)
+    Options->PixelOutput = PIXEL_TEXT;
+  else if (strncmp(StrEnv[pixel_output_format].VarStr, "BINARY", 6) == 0)
+    Options->PixelOutput = PIXEL_BINARY;
+  else
+    ReportError(StrEnv[pixel_output_format].KeyName, 51);
+
+  /* Number of times the model period is run to spin up the model state,
+     the largest change of the cell water storage (RMS over the cells, m)
+     over a cycle at which the spin-up stops, and the factor that the
+     change of the deep layer moisture over a cycle is extrapolated with.
+     During the spin-up no output is written, only the final state */
+  if (!CopyInt(&(Options->SpinUpCycles), StrEnv[spin_up_cycles].VarStr, 1) ||
+      Options->SpinUpCycles < 0)
+    ReportError(StrEnv[spin_up_cycles].KeyName, 51);
+  if (!CopyFloat(&(Options->SpinUpTol), StrEnv[spin_up_tolerance].VarStr, 1) ||
+      Options->SpinUpTol < 0.0)
+    ReportError(StrEnv[spin_up_tolerance].KeyName, 51);
+  if (!CopyFloat(&(Options->SpinUpAccel), StrEnv[spin_up_acceleration].VarStr,
+		 1) || Options->SpinUpAccel < 1.0)
+    ReportError(StrEnv[spin_up_acceleration].KeyName, 51);
+  if (Options->SpinUpCycles > 0 && Options->Extent == POINT)
+    ReportError(StrEnv[spin_up_cycles].KeyName, 65);
+
+  /* Wall clock minutes between the resume checkpoints that a run killed
+     part way can be continued from (DHSVM --resume), 0 for none */
+  if (!CopyFloat(&(Options->CheckpointWall),
+		 StrEnv[checkpoint_wall_interval].VarStr, 1) ||
+      Options->CheckpointWall < 0.0)
+    ReportError(StrEnv[checkpoint_wall_interval].KeyName, 51);
+  if (Options->CheckpointWall > 0.0 && Options->SpinUpCycles > 0)
+    ReportError(StrEnv[checkpoint_wall_interval].KeyName, 65);
+
+  /* Segment with the static maps that the runs of the basin on a node
+     share (empty = each run keeps its own, see StaticShare.c) */
+  strcpy(Options->StaticShare, StrEnv[static_data_share].VarStr);
+#ifndef HAVE_MMAP
+  if (!IsEmptyStr(Options->StaticShare))
+    ReportError(StrEnv[static_data_share].KeyName, 65);
+#endif
+
+  /* Do the soil columns of the cells of a soil type together in the pixel
+     loop (see SoilColumnBatch.c) */
+  if (strncmp(StrEnv[soil_column_batch].VarStr, "TRUE", 4) == 0)
+    Options->SoilColumnBatch = TRUE;
+  else if (strncmp(StrEnv[soil_column_batch].VarStr, "FALSE", 5) == 0)
+    Options->SoilColumnBatch = FALSE;
+  else
+    ReportError(StrEnv[soil_column_batch].KeyName, 51);
+
+  /* Do the radiation balance of the cells together in the pixel loop (see
+     RadiationBatch.c) */
+  if (strncmp(StrEnv[radiation_batch].VarStr, "TRUE", 4) == 0)
+    Options->RadiationBatch = TRUE;
+  else if (strncmp(StrEnv[radiation_batch].VarStr, "FALSE", 5) == 0)
+    Options->RadiationBatch = FALSE;
+  else
+    ReportError(StrEnv[radiation_batch].KeyName, 51);
+
+  /* Do the rain interception of the cells together in the pixel loop (see
+     InterceptionBatch.c), after their radiation balance, which also
+     makes the met of the cells of a piece before MassEnergyBalance() */
+  if (strncmp(StrEnv[interception_batch].VarStr, "TRUE", 4) == 0)
+    Options->InterceptionBatch = TRUE;
+  else if (strncmp(StrEnv[interception_batch].VarStr, "FALSE", 5) == 0)
+    Options->InterceptionBatch = FALSE;
+  else
+    ReportError(StrEnv[interception_batch].KeyName, 51);
+  if (Options->InterceptionBatch)
+    Options->RadiationBatch = TRUE;
+
+  /* Route the stream network of a step in a thread of its own while the
+     next step is computed (see RouteChannel()).  dhsvm_initialize() turns
+     it off for the options that read the stream segments in between */
+  if (strncmp(StrEnv[pipeline_channel_routing].VarStr, "TRUE", 4) == 0)
+    Options->PipelineChannel = TRUE;
+  else if (strncmp(StrEnv[pipeline_channel_routing].VarStr, "FALSE", 5) == 0)
+    Options->PipelineChannel = FALSE;
+  else
+    ReportError(StrEnv[pipeline_channel_routing].KeyName, 51);
+#ifndef HAVE_PTHREAD
+  if (Options->PipelineChannel) {
+    printf("WARNING: DHSVM was built without HAVE_PTHREAD, ignoring %s\n",
+	   StrEnv[pipeline_channel_routing].KeyName);
+    Options->PipelineChannel = FALSE;
+  }
+#endif
+
+  /* Run the stages of a time step that do not depend on each other
+     concurrently (see StepGraph.c) */
+  if (strncmp(StrEnv[concurrent_stages].VarStr, "TRUE", 4) == 0)
+    Options->ConcurrentStages = TRUE;
+  else if (strncmp(StrEnv[concurrent_stages].VarStr, "FALSE", 5) == 0)
+    Options->ConcurrentStages = FALSE;
+  else
+    ReportError(StrEnv[concurrent_stages].KeyName, 51);
+#ifndef HAVE_PTHREAD
+  if (Options->ConcurrentStages) {
+    printf("WARNING: DHSVM was built without HAVE_PTHREAD, ignoring %s\n",
+	   StrEnv[concurrent_stages].KeyName);
+    Options->ConcurrentStages = FALSE;
+  }
+#endif
+
+  /* Route the road network and write its output in a thread of its own
+     while the stream inflows are prepared (see RouteChannel()) */
+  if (strncmp(StrEnv[concurrent_network_routing].VarStr, "TRUE", 4) == 0)
+    Options->ConcurrentNetworks = TRUE;
+  else if (strncmp(StrEnv[concurrent_network_routing].VarStr, "FALSE", 5) == 0)
+    Options->ConcurrentNetworks = FALSE;
+  else
+    ReportError(StrEnv[concurrent_network_routing].KeyName, 51);
+#ifndef HAVE_PTHREAD
+  if (Options->ConcurrentNetworks) {
+    printf("WARNING: DHSVM was built without HAVE_PTHREAD, ignoring %s\n",
+	   StrEnv[concurrent_network_routing].KeyName);
+    Options->ConcurrentNetworks = FALSE;
+  }
+#endif
+
+  /* Determine whether the model state is stored as maps or as a single
+     checkpoint file */
+  if (strncmp(StrEnv[state_format].VarStr, "MAPS", 4) == 0)
+    Options->StateFormat = STATE_MAPS;
+  else if (strncmp(StrEnv[state_format].VarStr, "CHECKPOINT", 10) == 0)
+    Options->StateFormat = STATE_CHECKPOINT;
+  else
+    ReportError(StrEnv[state_format].KeyName, 51);
+
+  /* Number of checkpoints from one full checkpoint to the next, the ones
+     in between only store the change since the last full one */
+  if (!CopyInt(&(Options->CheckpointBase),
+	       StrEnv[checkpoint_base_interval].VarStr, 1) ||
+      Options->CheckpointBase < 1)
+    ReportError(StrEnv[checkpoint_base_interval].KeyName, 51);
+
+  /* Store the inflow and outflow of the stream segments in the checkpoint
+     as well as the storage, for a restart that continues exactly */
+  if (strncmp(StrEnv[checkpoint_channel_flows].VarStr, "TRUE", 4) == 0)
+    Options->CheckpointFlows = TRUE;
+  else if (strncmp(StrEnv[checkpoint_channel_flows].VarStr, "FALSE", 5) == 0)
+    Options->CheckpointFlows = FALSE;
+  else
+    ReportError(StrEnv[checkpoint_channel_flows].KeyName, 51);
+
+  /* Number of ensemble members run from the same static data, and the 
+     factor each member applies to the precipitation forcing */
+  if (!CopyInt(&(Options->NMembers), StrEnv[ensemble_members].VarStr, 1) ||
+      Options->NMembers < 1)
+    ReportError(StrEnv[ensemble_members].KeyName, 51);
+  if (!(Options->EnsemblePrecip = (float *) calloc(Options->NMembers,
+						   sizeof(float))))
+    ReportError((char *) Routine, 1);
+  if (IsEmptyStr(StrEnv[ensemble_precipitation_factors].VarStr)) {
+    for (i = 0; i < Options->NMembers; i++)
+      Options->EnsemblePrecip[i] = 1.0;
+  }
+  else if (!CopyFloat(Options->EnsemblePrecip,
+		      StrEnv[ensemble_precipitation_factors].VarStr,
+		      Options->NMembers))
+    ReportError(StrEnv[ensemble_precipitation_factors].KeyName, 51);
+  Options->Member = 0;
+  Options->PrecipFactor = (Options->NMembers > 1) ?
+    Options->EnsemblePrecip[0] : 1.0;
+
+  /* Random perturbation of the station forcing of each member, see
+     PerturbForcing.c: the standard deviation of the log of the
+     precipitation and shortwave factors and of the temperature offset
+     (C), their lag one autocorrelation from one time step to the next and
+     the correlation between the stations */
+  if (!CopyFloat(&(Options->PerturbPrecip),
+		 StrEnv[ensemble_precipitation_perturbation].VarStr, 1) ||
+      Options->PerturbPrecip < 0.0)
+    ReportError(StrEnv[ensemble_precipitation_perturbation].KeyName, 51);
+  if (!CopyFloat(&(Options->PerturbTemp),
+		 StrEnv[ensemble_temperature_perturbation].VarStr, 1) ||
+      Options->PerturbTemp < 0.0)
+    ReportError(StrEnv[ensemble_temperature_perturbation].KeyName, 51);
+  if (!CopyFloat(&(Options->PerturbRadiation),
+		 StrEnv[ensemble_radiation_perturbation].VarStr, 1) ||
+      Options->PerturbRadiation < 0.0)
+    ReportError(StrEnv[ensemble_radiation_perturbation].KeyName, 51);
+  if (!CopyFloat(&(Options->PerturbLag),
+		 StrEnv[ensemble_perturbation_autocorrelation].VarStr, 1) ||
+      Options->PerturbLag < 0.0 || Options->PerturbLag >= 1.0)
+    ReportError(StrEnv[ensemble_perturbation_autocorrelation].KeyName, 51);
+  if (!CopyFloat(&(Options->PerturbShared),
+		 StrEnv[ensemble_perturbation_station_correlation].VarStr, 1) ||
+      Options->PerturbShared < 0.0 || Options->PerturbShared > 1.0)
+    ReportError(StrEnv[ensemble_perturbation_station_correlation].KeyName, 51);
+  if (!CopyInt(&(Options->PerturbSeed),
+	       StrEnv[ensemble_perturbation_seed].VarStr, 1))
+    ReportError(StrEnv[ensemble_perturbation_seed].KeyName, 51);
+
   /* Determine if listed met stations outside bounding box are used */
   if (strncmp(StrEnv[outside].VarStr, "TRUE", 4) == 0)
     Options->Outside = TRUE;
@@ -325,7 +848,24 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
     strcpy(Options->PrismDataExt, StrEnv[prism_data_ext].VarStr);
   }
 
-  if (Options->Shading == TRUE) {
+  /* The shadow maps are either read from the monthly files of the
+     preprocessor, or computed each step from the horizon angles of the
+     cells, which are computed at the start or read from HORIZON FILE.
+     With the horizons the sky view factor is computed from them, unless
+     a SKYVIEW DATA PATH is given */
+  if (strncmp(StrEnv[shading_mode].VarStr, "MAPS", 4) == 0)
+    Options->ShadingMode = SHADING_MAPS;
+  else if (strncmp(StrEnv[shading_mode].VarStr, "HORIZON", 7) == 0)
+    Options->ShadingMode = SHADING_HORIZON;
+  else
+    ReportError(StrEnv[shading_mode].KeyName, 51);
+  if (!CopyInt(&(Options->HorizonSectors), StrEnv[horizon_sectors].VarStr,
+	       1) || Options->HorizonSectors < 4 ||
+      Options->HorizonSectors > 360)
+    ReportError(StrEnv[horizon_sectors].KeyName, 51);
+  strcpy(Options->HorizonFile, StrEnv[horizon_file].VarStr);
+
+  if (Options->Shading == TRUE && Options->ShadingMode == SHADING_MAPS) {
     if (IsEmptyStr(StrEnv[shading_data_path].VarStr))
       ReportError(StrEnv[shading_data_path].KeyName, 51);
     strcpy(Options->ShadingDataPath, StrEnv[shading_data_path].VarStr);
@@ -336,6 +876,8 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
       ReportError(StrEnv[skyview_data_path].KeyName, 51);
     strcpy(Options->SkyViewDataPath, StrEnv[skyview_data_path].VarStr);
   }
+  else if (Options->Shading == TRUE)
+    strcpy(Options->SkyViewDataPath, StrEnv[skyview_data_path].VarStr);
 
   /* Determine if rh override is used */
   if (strncmp(StrEnv[rhoverride].VarStr, "TRUE", 4) == 0)
@@ -392,6 +934,311 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
       ReportError(StrEnv[precip_lapse].KeyName, 51);
   }
 
+  /* Only the station forcing is perturbed, so the perturbations cannot be
+     used with the MM5 maps or the radar precipitation */
+  if (Options->MM5 == TRUE || Options->PrecipType == RADAR) {
+    if (Options->PerturbPrecip > 0.0)
+      ReportError(StrEnv[ensemble_precipitation_perturbation].KeyName, 51);
+    if (Options->PerturbTemp > 0.0)
+      ReportError(StrEnv[ensemble_temperature_perturbation].KeyName, 51);
+    if (Options->PerturbRadiation > 0.0)
+      ReportError(StrEnv[ensemble_radiation_perturbation].KeyName, 51);
+  }
+
+  /* Determine if the vertical physics is run once for each group of cells
+     with the same classes (hydrologic response unit), and the width of the
+     classes (0 = exact match).  Needs met inputs that only depend on the
+     station interpolation weights and the terrain classes */
+  if (strncmp(StrEnv[hru_mode].VarStr, "TRUE", 4) == 0)
+    Options->HRU = TRUE;
+  else if (strncmp(StrEnv[hru_mode].VarStr, "FALSE", 5) == 0)
+    Options->HRU = FALSE;
+  else
+    ReportError(StrEnv[hru_mode].KeyName, 51);
+  if (Options->HRU == TRUE && (Options->MM5 == TRUE ||
+			       Options->PrecipType == RADAR ||
+			       Options->Prism == TRUE ||
+			       Options->PrecipLapse == MAP ||
+			       Options->WindSource == MODEL ||
+			       (Options->Shading == TRUE &&
+				Options->ShadingMode == SHADING_HORIZON)))
+    ReportError(StrEnv[hru_mode].KeyName, 51);
+  if (!CopyFloat(&(Options->HRUElevBand), StrEnv[hru_elevation_band].VarStr,
+		 1) || Options->HRUElevBand < 0.0)
+    ReportError(StrEnv[hru_elevation_band].KeyName, 51);
+  if (!CopyFloat(&(Options->HRUSlopeClass), StrEnv[hru_slope_class].VarStr,
+		 1) || Options->HRUSlopeClass < 0.0)
+    ReportError(StrEnv[hru_slope_class].KeyName, 51);
+  if (!CopyFloat(&(Options->HRUAspectClass), StrEnv[hru_aspect_class].VarStr,
+		 1) || Options->HRUAspectClass < 0.0)
+    ReportError(StrEnv[hru_aspect_class].KeyName, 51);
+  if (!CopyFloat(&(Options->HRUDepthClass),
+		 StrEnv[hru_soil_depth_class].VarStr, 1) ||
+      Options->HRUDepthClass < 0.0)
+    ReportError(StrEnv[hru_soil_depth_class].KeyName, 51);
+  if (!CopyFloat(&(Options->HRUSkyViewClass),
+		 StrEnv[hru_sky_view_class].VarStr, 1) ||
+      Options->HRUSkyViewClass < 0.0)
+    ReportError(StrEnv[hru_sky_view_class].KeyName, 51);
+  if (!CopyFloat(&(Options->HRUWeightTol),
+		 StrEnv[hru_met_weight_tolerance].VarStr, 1) ||
+      Options->HRUWeightTol < 0.0)
+    ReportError(StrEnv[hru_met_weight_tolerance].KeyName, 51);
+
+  /* Number of model cells between the nodes of the grid on which the
+     station met is interpolated before it is downscaled to the cells 
+     (1 = interpolate for every cell) */
+  if (!CopyInt(&(Options->MetGridSpacing), StrEnv[met_grid_spacing].VarStr,
+	       1) || Options->MetGridSpacing < 1 ||
+      (Options->MetGridSpacing > 1 && (Options->MM5 == TRUE ||
+				       Options->HRU == TRUE)))
+    ReportError(StrEnv[met_grid_spacing].KeyName, 51);
+
+  /* Binding of the threads to processors, not with ENSEMBLE MEMBERS, whose
+     processes would all be pinned to the same processors */
+  if (strncmp(StrEnv[thread_pinning].VarStr, "NONE", 4) == 0)
+    Options->ThreadPinning = PIN_NONE;
+  else if (strncmp(StrEnv[thread_pinning].VarStr, "CLOSE", 5) == 0)
+    Options->ThreadPinning = PIN_CLOSE;
+  else if (strncmp(StrEnv[thread_pinning].VarStr, "SPREAD", 6) == 0)
+    Options->ThreadPinning = PIN_SPREAD;
+  else
+    ReportError(StrEnv[thread_pinning].KeyName, 51);
+  if (Options->ThreadPinning != PIN_NONE && Options->NMembers > 1)
+    ReportError(StrEnv[thread_pinning].KeyName, 51);
+
+  /* Determine if the large maps are allocated with transparent huge pages */
+  if (strncmp(StrEnv[huge_pages].VarStr, "TRUE", 4) == 0)
+    Options->HugePages = TRUE;
+  else if (strncmp(StrEnv[huge_pages].VarStr, "FALSE", 5) == 0)
+    Options->HugePages = FALSE;
+  else
+    ReportError(StrEnv[huge_pages].KeyName, 51);
+
+  /* Time the phases of the time loop */
+  if (strncmp(StrEnv[profile].VarStr, "TRUE", 4) == 0)
+    Options->Profile = TRUE;
+  else if (strncmp(StrEnv[profile].VarStr, "FALSE", 5) == 0)
+    Options->Profile = FALSE;
+  else
+    ReportError(StrEnv[profile].KeyName, 51);
+
+  /* Chrome trace of the phases and I/O, of every TRACE INTERVAL steps */
+  strncpy(Options->TraceFile, StrEnv[trace_file].VarStr, BUFSIZE);
+  Options->TraceFile[BUFSIZE] = '\0';
+  if (!CopyInt(&(Options->TraceInterval), StrEnv[trace_interval].VarStr, 1) ||
+      Options->TraceInterval < 1)
+    ReportError(StrEnv[trace_interval].KeyName, 51);
+
+  /* Count the hardware events of the profiled phases, with the raw codes
+     of the scalar and the packed floating point instructions */
+  if (strncmp(StrEnv[perf_counters].VarStr, "TRUE", 4) == 0)
+    Options->PerfCounters = TRUE;
+  else if (strncmp(StrEnv[perf_counters].VarStr, "FALSE", 5) == 0)
+    Options->PerfCounters = FALSE;
+  else
+    ReportError(StrEnv[perf_counters].KeyName, 51);
+  Options->PerfScalarEvent = 0;
+  Options->PerfVectorEvent = 0;
+  if (!IsEmptyStr(StrEnv[perf_vector_events].VarStr) &&
+      (sscanf(StrEnv[perf_vector_events].VarStr, "%lx %lx",
+	      &(Options->PerfScalarEvent), &(Options->PerfVectorEvent)) != 2 ||
+       Options->PerfScalarEvent == 0 || Options->PerfVectorEvent == 0))
+    ReportError(StrEnv[perf_vector_events].KeyName, 51);
+
+  /* Time the pixel loop of each cell for the cost map (Soil.CostTime) */
+  if (strncmp(StrEnv[cell_cost_timing].VarStr, "TRUE", 4) == 0)
+    Options->CellCostTiming = TRUE;
+  else if (strncmp(StrEnv[cell_cost_timing].VarStr, "FALSE", 5) == 0)
+    Options->CellCostTiming = FALSE;
+  else
+    ReportError(StrEnv[cell_cost_timing].KeyName, 51);
+
+  /* Warn before the tagged allocations exceed MEMORY LIMIT (MB), 0 for the
+     physical memory */
+  if (!CopyFloat(&(Options->MemoryLimit), StrEnv[memory_limit].VarStr, 1) ||
+      Options->MemoryLimit < 0.0)
+    ReportError(StrEnv[memory_limit].KeyName, 51);
+
+  /* The warnings of the time loop up to MESSAGE LEVEL are printed MESSAGE
+     LIMIT times per site, 0 for all of them, and counted for the summary at
+     the end of the run */
+  if (strncmp(StrEnv[message_level].VarStr, "ERROR", 5) == 0)
+    Options->MessageLevel = MSG_ERROR;
+  else if (strncmp(StrEnv[message_level].VarStr, "WARNING", 7) == 0)
+    Options->MessageLevel = MSG_WARNING;
+  else if (strncmp(StrEnv[message_level].VarStr, "NOTE", 4) == 0)
+    Options->MessageLevel = MSG_NOTE;
+  else if (strncmp(StrEnv[message_level].VarStr, "DEBUG", 5) == 0)
+    Options->MessageLevel = MSG_DEBUG;
+  else
+    ReportError(StrEnv[message_level].KeyName, 51);
+  if (!CopyInt(&(Options->MessageLimit), StrEnv[message_limit].VarStr, 1) ||
+      Options->MessageLimit < 0)
+    ReportError(StrEnv[message_limit].KeyName, 51);
+
+  /* Instruction set of the vector kernels, AUTO for the highest one of the
+     processor, or a lower one to compare the results */
+  if (strncmp(StrEnv[simd_level].VarStr, "AUTO", 4) == 0)
+    Options->SimdLevel = SIMD_AUTO;
+  else if (strncmp(StrEnv[simd_level].VarStr, "SSE2", 4) == 0)
+    Options->SimdLevel = SIMD_SSE2;
+  else if (strncmp(StrEnv[simd_level].VarStr, "AVX2", 4) == 0)
+    Options->SimdLevel = SIMD_AVX2;
+  else if (strncmp(StrEnv[simd_level].VarStr, "AVX512", 6) == 0)
+    Options->SimdLevel = SIMD_AVX512;
+  else
+    ReportError(StrEnv[simd_level].KeyName, 51);
+
+  /* Accuracy of exp, log and pow in the physics routines (FastMath.c),
+     EXACT for libm in double precision */
+  if (strncmp(StrEnv[math_accuracy].VarStr, "EXACT", 5) == 0)
+    Options->MathAccuracy = MATH_EXACT;
+  else if (strncmp(StrEnv[math_accuracy].VarStr, "FLOAT", 5) == 0)
+    Options->MathAccuracy = MATH_FLOAT;
+  else if (strncmp(StrEnv[math_accuracy].VarStr, "FAST", 4) == 0)
+    Options->MathAccuracy = MATH_FAST;
+  else
+    ReportError(StrEnv[math_accuracy].KeyName, 51);
+
+  /* Output files of each year or month for long runs, named with the
+     OUTPUT ROLLOVER NAME template (Rollover.c) */
+  if (strncmp(StrEnv[output_rollover].VarStr, "NONE", 4) == 0)
+    Options->Rollover = ROLLOVER_NONE;
+  else if (strncmp(StrEnv[output_rollover].VarStr, "YEAR", 4) == 0)
+    Options->Rollover = ROLLOVER_YEAR;
+  else if (strncmp(StrEnv[output_rollover].VarStr, "MONTH", 5) == 0)
+    Options->Rollover = ROLLOVER_MONTH;
+  else
+    ReportError(StrEnv[output_rollover].KeyName, 51);
+  strcpy(Options->RolloverName, StrEnv[output_rollover_name].VarStr);
+
+  /* The state of the resume checkpoint in zlib blocks that the threads
+     compress, at a level from 1 (fast) to 9 (small), and with the bytes of
+     the words regrouped with CHECKPOINT SHUFFLE (ResumeIO.c) */
+  if (strncmp(StrEnv[checkpoint_compression].VarStr, "NONE", 4) == 0)
+    Options->CheckpointCompression = RESUME_RAW;
+  else if (strncmp(StrEnv[checkpoint_compression].VarStr, "ZLIB", 4) == 0)
+    Options->CheckpointCompression = RESUME_ZLIB;
+  else
+    ReportError(StrEnv[checkpoint_compression].KeyName, 51);
+#ifndef HAVE_ZLIB
+  if (Options->CheckpointCompression != RESUME_RAW)
+    ReportError(StrEnv[checkpoint_compression].KeyName, 86);
+#endif
+  if (!CopyInt(&(Options->CheckpointLevel),
+	       StrEnv[checkpoint_compression_level].VarStr, 1) ||
+      Options->CheckpointLevel < 1 || Options->CheckpointLevel > 9)
+    ReportError(StrEnv[checkpoint_compression_level].KeyName, 51);
+  if (strncmp(StrEnv[checkpoint_shuffle].VarStr, "TRUE", 4) == 0)
+    Options->CheckpointShuffle = TRUE;
+  else if (strncmp(StrEnv[checkpoint_shuffle].VarStr, "FALSE", 5) == 0)
+    Options->CheckpointShuffle = FALSE;
+  else
+    ReportError(StrEnv[checkpoint_shuffle].KeyName, 51);
+
+  /* Directory of the scratch files that hold the shadow maps of the month
+     out of core (empty = in memory, see OutOfCore.c) */
+  strcpy(Options->OutOfCoreDir, StrEnv[out_of_core_directory].VarStr);
+#ifndef HAVE_MMAP
+  if (!IsEmptyStr(Options->OutOfCoreDir))
+    ReportError(StrEnv[out_of_core_directory].KeyName, 65);
+#endif
+
+  /* Time the first steps of the run with a few thread counts and tile sizes
+     of the cell loops, and run with the fastest (see AutoTune.c).  The
+     NUMBER OF THREADS is the largest count tried, AUTO TUNE STEPS the
+     steps of each trial, 0 for a model day, and the choice can be kept for
+     the basin and the machine in the AUTO TUNE FILE */
+  if (strncmp(StrEnv[auto_tune].VarStr, "TRUE", 4) == 0)
+    Options->AutoTune = TRUE;
+  else if (strncmp(StrEnv[auto_tune].VarStr, "FALSE", 5) == 0)
+    Options->AutoTune = FALSE;
+  else
+    ReportError(StrEnv[auto_tune].KeyName, 51);
+  if (!CopyInt(&(Options->AutoTuneSteps), StrEnv[auto_tune_steps].VarStr, 1) ||
+      Options->AutoTuneSteps < 0)
+    ReportError(StrEnv[auto_tune_steps].KeyName, 51);
+  strncpy(Options->AutoTuneFile, StrEnv[auto_tune_file].VarStr, BUFSIZE);
+  Options->AutoTuneFile[BUFSIZE] = '\0';
+  if (Options->AutoTune && (Options->NThreads < 2 || Options->NMembers > 1)) {
+    printf("WARNING: AUTO TUNE needs NUMBER OF THREADS > 1 and cannot be "
+	   "used with ENSEMBLE MEMBERS\n");
+    Options->AutoTune = FALSE;
+  }
+
+  /* Only model the snow pack: without evapotranspiration, soil water and
+     routing, whose data are not allocated.  A DHSVM built with
+     DHSVM_SNOW_ONLY always runs this way */
+#ifdef SNOW_ONLY
+  Options->SnowOnly = TRUE;
+#else
+  if (strncmp(StrEnv[snow_only].VarStr, "TRUE", 4) == 0)
+    Options->SnowOnly = TRUE;
+  else if (strncmp(StrEnv[snow_only].VarStr, "FALSE", 5) == 0)
+    Options->SnowOnly = FALSE;
+  else
+    ReportError(StrEnv[snow_only].KeyName, 51);
+#endif
+  if (Options->SnowOnly) {
+    if (Options->HasNetwork || Options->HRU || Options->SoilColumnBatch ||
+	Options->QuietCells != QUIET_NONE)
+      printf("WARNING: SNOW ONLY runs without the road/channel network, "
+	     "HRU MODE, SOIL COLUMN BATCH and QUIESCENT CELLS\n");
+    Options->HasNetwork = FALSE;
+    Options->StreamTemp = FALSE;
+    Options->PipelineChannel = FALSE;
+    Options->HRU = FALSE;
+    Options->SoilColumnBatch = FALSE;
+    Options->QuietCells = QUIET_NONE;
+  }
+
+  /* Progress and throughput records every TELEMETRY INTERVAL wall clock
+     seconds, as JSON lines or a Prometheus textfile */
+  strncpy(Options->TelemetryFile, StrEnv[telemetry_file].VarStr, BUFSIZE);
+  Options->TelemetryFile[BUFSIZE] = '\0';
+  if (strncmp(StrEnv[telemetry_format].VarStr, "JSON", 4) == 0)
+    Options->TelemetryFormat = TELEMETRY_JSON;
+  else if (strncmp(StrEnv[telemetry_format].VarStr, "PROMETHEUS", 10) == 0)
+    Options->TelemetryFormat = TELEMETRY_PROMETHEUS;
+  else
+    ReportError(StrEnv[telemetry_format].KeyName, 51);
+  if (!CopyFloat(&(Options->TelemetryInterval),
+		 StrEnv[telemetry_interval].VarStr, 1) ||
+      Options->TelemetryInterval < 0.0)
+    ReportError(StrEnv[telemetry_interval].KeyName, 51);
+
+  /* Ring buffer of the basin totals, the recorded segment flows and
+     coarse maps of each step for live viewers (see MonitorFeed.c) */
+  strncpy(Options->MonitorFeed, StrEnv[monitor_feed].VarStr, BUFSIZE);
+  Options->MonitorFeed[BUFSIZE] = '\0';
+  if (!CopyInt(&(Options->MonitorSlots), StrEnv[monitor_feed_slots].VarStr,
+	       1) || Options->MonitorSlots < 2)
+    ReportError(StrEnv[monitor_feed_slots].KeyName, 51);
+  if (!CopyInt(&(Options->MonitorStride),
+	       StrEnv[monitor_feed_map_stride].VarStr, 1) ||
+      Options->MonitorStride < 0)
+    ReportError(StrEnv[monitor_feed_map_stride].KeyName, 51);
+#ifndef HAVE_MMAP
+  if (!IsEmptyStr(Options->MonitorFeed))
+    ReportError(StrEnv[monitor_feed].KeyName, 65);
+#endif
+
+  /* Run the independent stages of the initialization concurrently */
+  if (strncmp(StrEnv[parallel_initialization].VarStr, "TRUE", 4) == 0)
+    Options->ParallelInit = TRUE;
+  else if (strncmp(StrEnv[parallel_initialization].VarStr, "FALSE", 5) == 0)
+    Options->ParallelInit = FALSE;
+  else
+    ReportError(StrEnv[parallel_initialization].KeyName, 51);
+#ifndef HAVE_PTHREAD
+  if (Options->ParallelInit) {
+    printf("WARNING: DHSVM was built without HAVE_PTHREAD, ignoring %s\n",
+	   StrEnv[parallel_initialization].KeyName);
+    Options->ParallelInit = FALSE;
+  }
+#endif
+
   /**************** Determine areal extent ****************/
 
   if (IsEmptyStr(StrEnv[coordinate_system].VarStr))
@@ -433,6 +1280,12 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
   Map->OffsetX = 0;
   Map->OffsetY = 0;
   Map->NumCells = 0;
+  Map->OrderedCells = NULL;
+  Map->NumActive = 0;
+  Map->ActiveCells = NULL;
+  Map->RowOrder = NULL;
+  Map->FileNX = 0;
+  Map->FileNY = 0;
 
   if (Options->Extent == POINT) {
     if (!CopyDouble(&PointModelY, StrEnv[point_north].VarStr, 1))
@@ -443,12 +1296,43 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
       Round(((Map->Yorig - 0.5 * Map->DY) - PointModelY) / Map->DY);
     Options->PointX =
       Round((PointModelX - (Map->Xorig + 0.5 * Map->DX)) / Map->DX);
+    if (Options->PointY < 0 || Options->PointY >= Map->NY)
+      ReportError(StrEnv[point_north].KeyName, 51);
+    if (Options->PointX < 0 || Options->PointX >= Map->NX)
+      ReportError(StrEnv[point_east].KeyName, 51);
+    PointWindow(Options, Map);
   }
   else {
     Options->PointY = 0;
     Options->PointX = 0;
   }
 
+  /* Only model the cells upstream of a stream segment or of a cell (see 
+     InitSubBasin()) */
+  Options->OutletSegment = -1;
+  Options->OutletY = -1;
+  Options->OutletX = -1;
+  if (!IsEmptyStr(StrEnv[sub_basin_outlet_segment].VarStr)) {
+    if (!CopyInt(&(Options->OutletSegment),
+		 StrEnv[sub_basin_outlet_segment].VarStr, 1) ||
+	Options->OutletSegment < 0 || Options->HasNetwork == FALSE ||
+	Options->Extent == POINT)
+      ReportError(StrEnv[sub_basin_outlet_segment].KeyName, 51);
+  }
+  if (!IsEmptyStr(StrEnv[sub_basin_outlet_north].VarStr) ||
+      !IsEmptyStr(StrEnv[sub_basin_outlet_east].VarStr)) {
+    if (!CopyDouble(&OutletY, StrEnv[sub_basin_outlet_north].VarStr, 1) ||
+	Options->OutletSegment >= 0 || Options->Extent == POINT)
+      ReportError(StrEnv[sub_basin_outlet_north].KeyName, 51);
+    if (!CopyDouble(&OutletX, StrEnv[sub_basin_outlet_east].VarStr, 1))
+      ReportError(StrEnv[sub_basin_outlet_east].KeyName, 51);
+    Options->OutletY = Round(((Map->Yorig - 0.5 * Map->DY) - OutletY) / Map->DY);
+    Options->OutletX = Round((OutletX - (Map->Xorig + 0.5 * Map->DX)) / Map->DX);
+    if (Options->OutletY < 0 || Options->OutletY >= Map->NY ||
+	Options->OutletX < 0 || Options->OutletX >= Map->NX)
+      ReportError(StrEnv[sub_basin_outlet_north].KeyName, 51);
+  }
+
   /**************** Determine model period ****************/
 
   if (!CopyFloat(&(TimeStep), StrEnv[time_step].VarStr, 1))
@@ -463,6 +1347,37 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
 
   InitTime(Time, &Start, &End, NULL, NULL, (int) TimeStep);
 
+  if (Time->Dt % Options->RoutingSubsteps != 0)
+    ReportError(StrEnv[channel_routing_substeps].KeyName, 51);
+  if (Time->Dt % Options->SubSurfaceSubsteps != 0)
+    ReportError(StrEnv[subsurface_routing_substeps].KeyName, 51);
+
+  /* Interval of the station and MM5 records (hours, empty = a record per
+     time step), the forcing of the steps in between is interpolated (see
+     MetInterpolation.c).  The interval is a multiple of the time step that
+     divides a day, and the records are not read from a met cache */
+  Options->MetInterval = 0;
+  if (!IsEmptyStr(StrEnv[met_file_interval].VarStr)) {
+    if (!CopyFloat(&MetInterval, StrEnv[met_file_interval].VarStr, 1))
+      ReportError(StrEnv[met_file_interval].KeyName, 51);
+    Options->MetInterval = Round(MetInterval * SECPHOUR);
+    if (Options->MetInterval < Time->Dt ||
+	Options->MetInterval % Time->Dt != 0 ||
+	SECPDAY % Options->MetInterval != 0)
+      ReportError(StrEnv[met_file_interval].KeyName, 51);
+    if (Options->MetInterval == Time->Dt)
+      Options->MetInterval = 0;
+    else if (!IsEmptyStr(Options->MetCacheFile))
+      ReportError(StrEnv[met_cache_file].KeyName, 51);
+  }
+
+  if (strncmp(StrEnv[met_interpolation].VarStr, "LINEAR", 6) == 0)
+    Options->MetInterpolation = METINTERP_LINEAR;
+  else if (strncmp(StrEnv[met_interpolation].VarStr, "CUBIC", 5) == 0)
+    Options->MetInterpolation = METINTERP_CUBIC;
+  else
+    ReportError(StrEnv[met_interpolation].KeyName, 51);
+
    /**************** Determine model constants ****************/
 
   if (!CopyFloat(&Z0_GROUND, StrEnv[ground_roughness].VarStr, 1))
@@ -529,3 +1444,42 @@ void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
     StrEnv[alb_melt_min].VarStr, 1))
     ReportError(StrEnv[alb_melt_min].KeyName, 51);
 }
+
+/*****************************************************************************
+  PointWindow()
+
+  In POINT mode the model map is made the window of the input maps around 
+  the point: the point and its neighbours, which give the slope, aspect and
+  flow directions of the point.  The maps and the state are then allocated
+  for these few cells, and Read2DMatrix() and Read3DMatrix() read only the
+  window of each input map.  The model map stays the whole of the input
+  maps if the point needs the maps at the met stations (gridded met, PRISM),
+  or if it reads files in the layout of the basin (BASIN ONLY OUTPUT, STATE
+  FORMAT CHECKPOINT, STATIC DATA SHARE)
+*****************************************************************************/
+static void PointWindow(OPTIONSTRUCT *Options, MAPSIZE *Map)
+{
+  int Last;			/* last row or column of the window */
+
+  if (Options->GRIDMET || Options->Prism || Options->BasinOnlyOutput ||
+      Options->StateFormat == STATE_CHECKPOINT ||
+      !IsEmptyStr(Options->StaticShare))
+    return;
+
+  Map->FileNY = Map->NY;
+  Map->FileNX = Map->NX;
+  Map->WinY = MAX(Options->PointY - 1, 0);
+  Map->WinX = MAX(Options->PointX - 1, 0);
+  Last = MIN(Options->PointY + 1, Map->FileNY - 1);
+  Map->NY = Last - Map->WinY + 1;
+  Last = MIN(Options->PointX + 1, Map->FileNX - 1);
+  Map->NX = Last - Map->WinX + 1;
+  Map->Yorig -= Map->WinY * Map->DY;
+  Map->Xorig += Map->WinX * Map->DX;
+  Options->PointY -= Map->WinY;
+  Options->PointX -= Map->WinX;
+
+  printf("Point mode: the model map is the window of %d by %d cells at row "
+	 "%d, column %d of the %d by %d input maps\n", Map->NY, Map->NX,
+	 Map->WinY, Map->WinX, Map->FileNY, Map->FileNX);
+}
@@ -13,6 +13,11 @@
  *               InitImageDump()
  *               InitMapDump()
  *               InitPixDump()
+ *               InitDumpEvents()
+ *               InitDiagnostics()
+ *               RolloverDump()
+ *               CreateMapFiles()
+ *               JoinMapFile()
  * COMMENTS:
  * $Id: InitDump.c,v 1.11 2004/08/18 01:01:29 colleen Exp $
  */
@@ -20,6 +25,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_FORK
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 #include "settings.h"
 #include "data.h"
 #include "DHSVMerror.h"
@@ -27,8 +37,15 @@
 #include "functions.h"
 #include "constants.h"
 #include "getinit.h"
+#include "memaccount.h"
 #include "sizeofnt.h"
 #include "varid.h"
+#include "rollover.h"
+
+static void OpenDumpFiles(OPTIONSTRUCT *Options, DUMPSTRUCT *Dump);
+static void CreateMapFiles(MAPSIZE *Map, char *Path, int NMaps, 
+			   MAPDUMP *DMap);
+static int JoinMapFile(MAPDUMP *DMap, int Set, int i);
 
  /*******************************************************************************
    Function name: InitDump()
@@ -78,6 +95,11 @@ void InitDump(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map, int MaxSoilLay
     {"OUTPUT", "NUMBER OF MAP VARIABLES", "", ""},
     {"OUTPUT", "NUMBER OF IMAGE VARIABLES", "", ""},
     {"OUTPUT", "NUMBER OF GRAPHICS", "", ""},
+    {"OUTPUT", "SATURATION FLUSH INTERVAL", "", ""},
+    {"OUTPUT", "GRAPHICS MODE", "", "DIRECT"},
+    {"OUTPUT", "GRAPHICS INTERVAL", "", "1"},
+    {"OUTPUT", "AGGREGATION INTERVAL", "", "1"},
+    {"OUTPUT", "NUMBER OF STATISTICS VARIABLES", "", "0"},
     {NULL, NULL, "", NULL},
   };
 
@@ -88,11 +110,28 @@ void InitDump(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map, int MaxSoilLay
     GetInitString(StrEnv[i].SectionName, StrEnv[i].KeyName, StrEnv[i].Default,
       StrEnv[i].VarStr, (unsigned long)BUFSIZE, Input);
 
+  /* the steps timed by dhsvm_estimate() write to a scratch directory */
+  if (!IsEmptyStr(Options->EstimateDir))
+    strcpy(StrEnv[output_path].VarStr, Options->EstimateDir);
+
   /* Assign the entries to the variables */
   if (IsEmptyStr(StrEnv[output_path].VarStr))
     ReportError(StrEnv[output_path].KeyName, 51);
   strcpy(Dump->Path, StrEnv[output_path].VarStr);
 
+  /* each ensemble member writes to its own subdirectory */
+  if (Options->NMembers > 1) {
+    sprintf(Dump->Path + strlen(Dump->Path), "member.%03d/",
+	    Options->Member + 1);
+#ifdef HAVE_FORK
+    if (mkdir(Dump->Path, 0777) != 0 && errno != EEXIST)
+      ReportError(Dump->Path, 3);
+#endif
+  }
+
+  /* the files of the OUTPUT ROLLOVER periods are listed from the start */
+  OpenRolloverIndex(Dump->Path);
+
   // delete any previous failure_summary.txt file
   sprintf(sumoutfile, "%sfailure_summary.txt", Dump->Path);
   if (remove(sumoutfile) != -1)
@@ -128,19 +167,47 @@ void InitDump(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map, int MaxSoilLay
   else if (!CopyInt(NGraphics, StrEnv[ngraphics].VarStr, 1) || *NGraphics < 0)
     ReportError(StrEnv[ngraphics].KeyName, 51);
 
-  if (Options->Extent == POINT)
+  if (IsEmptyStr(StrEnv[sat_flush_interval].VarStr))
+    Dump->SatFlushInterval = 0;
+  else if (!CopyInt(&(Dump->SatFlushInterval), 
+                    StrEnv[sat_flush_interval].VarStr, 1) || 
+           Dump->SatFlushInterval < 0)
+    ReportError(StrEnv[sat_flush_interval].KeyName, 51);
+  Dump->SatFlushCount = 0;
+
+  if (strncmp(StrEnv[graphics_mode].VarStr, "DIRECT", 6) == 0)
+    Dump->GraphicsMode = GRAPHICS_DIRECT;
+  else if (strncmp(StrEnv[graphics_mode].VarStr, "THREAD", 6) == 0)
+    Dump->GraphicsMode = GRAPHICS_THREAD;
+  else if (strncmp(StrEnv[graphics_mode].VarStr, "IMAGE", 5) == 0)
+    Dump->GraphicsMode = GRAPHICS_IMAGE;
+  else
+    ReportError(StrEnv[graphics_mode].KeyName, 51);
+
+  if (!CopyInt(&(Dump->GraphicsInterval), StrEnv[graphics_interval].VarStr, 1)
+      || Dump->GraphicsInterval < 1)
+    ReportError(StrEnv[graphics_interval].KeyName, 51);
+
+  /* Steps between the full basin aggregations, the steps in between only 
+     sum the fluxes of the mass balance */
+  if (!CopyInt(&(Dump->AggregationInterval), 
+	       StrEnv[aggregation_interval].VarStr, 1) ||
+      Dump->AggregationInterval < 1)
+    ReportError(StrEnv[aggregation_interval].KeyName, 51);
+
+  /* variables with annual statistics maps (Statistics.c) */
+  if (!CopyInt(&(Dump->NStats), StrEnv[nstatvars].VarStr, 1) ||
+      Dump->NStats < 0)
+    ReportError(StrEnv[nstatvars].KeyName, 51);
+
+  if (Options->Extent == POINT) {
     *NGraphics = 0;
+    Dump->NStats = 0;
+  }
 
   Dump->NMaps = NMapVars + NImageVars;
 
-  // Open file for recording aggregated values for entire basin
-  sprintf(Dump->Aggregate.FileName, "%sAggregated.Values", Dump->Path);
-  OpenFile(&(Dump->Aggregate.FilePtr), Dump->Aggregate.FileName, "w", TRUE);
-
-  // Open file for recording mass balance for entire basin
-  sprintf(Dump->Balance.FileName, "%sMass.Balance", Dump->Path);
-  OpenFile(&(Dump->Balance.FilePtr), Dump->Balance.FileName, "w", TRUE);
-
+  // the time series files are opened by OpenDumpFiles(), at the end
   sprintf(Dump->FinalBalance.FileName, "%sMass.Final.Balance", Dump->Path);
   OpenFile(&(Dump->FinalBalance.FilePtr), Dump->FinalBalance.FileName, "w", TRUE);
 
@@ -174,26 +241,352 @@ void InitDump(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map, int MaxSoilLay
         printf("total number of accepted dump pixels %d \n", Dump->NPix);
       }
     }
+    Dump->NPixVars = 0;
+    Dump->PixVars = NULL;
+    Dump->PixRecord = NULL;
+    Dump->PixBin.FilePtr = NULL;
+    Dump->PixBin.FileName[0] = '\0';
     for (y = 0; y < Map->NY; y++)
       free(BasinMask[y]);
     free(BasinMask);
 
     if (Dump->NMaps > 0)
       InitMapDump(Input, Map, MaxSoilLayers, MaxVegLayers, Dump->Path,
-        Dump->NMaps, NMapVars, &(Dump->DMap));
+        Dump->NMaps, NMapVars, &(Dump->DMap), Options);
     if (NImageVars > 0)
       InitImageDump(Input, Dt, Map, MaxSoilLayers, MaxVegLayers, Dump->Path,
         Dump->NMaps, NImageVars, &(Dump->DMap));
 
+    InitDumpEvents(Dump);
+
+    if (Dump->NStats > 0)
+      InitStatistics(Input, Map, MaxSoilLayers, MaxVegLayers, Dump->Path,
+		     Dump->NStats, &(Dump->Stats));
+
     if (*NGraphics > 0)
       InitGraphicsDump(Input, *NGraphics, &which_graphics);
+  }
+
+  OpenDumpFiles(Options, Dump);
+
+  InitDiagnostics(Options, Dump, *NGraphics, *which_graphics);
+}
+
+/*******************************************************************************
+  Function name: OpenDumpFiles()
+
+  Purpose      : Open the time series files of the basin and of the pixels,
+                 in the OUTPUT ROLLOVER period of the run (see Rollover.c)
+
+  Required     :
+    OPTIONSTRUCT *Options - Mode options
+    DUMPSTRUCT *Dump      - Information on what to output when, with the
+                            pixels set up
+
+  Returns      : void
+
+  Modifies     : The files of Dump, the files of the previous period are
+                 closed
+
+  Comments     : Mass.Final.Balance is written at the end of the run and
+                 does not roll over
+*******************************************************************************/
+static void OpenDumpFiles(OPTIONSTRUCT *Options, DUMPSTRUCT *Dump)
+{
+  char BaseName[BUFSIZE + 1];
+  int i;
+
+  // file for recording aggregated values for entire basin
+  sprintf(BaseName, "%sAggregated.Values", Dump->Path);
+  OpenOutput(&(Dump->Aggregate.FilePtr), Dump->Aggregate.FileName, BaseName,
+	     "w");
+
+  // file for recording mass balance for entire basin
+  sprintf(BaseName, "%sMass.Balance", Dump->Path);
+  OpenOutput(&(Dump->Balance.FilePtr), Dump->Balance.FileName, BaseName, "w");
+
+  // file for recording saturation extent for entire basin.  The file
+  // stays open for the whole run and is flushed every SatFlushInterval steps
+  sprintf(BaseName, "%ssaturation_extent.txt", Dump->Path);
+  OpenOutput(&(Dump->Saturation.FilePtr), Dump->Saturation.FileName,
+	     BaseName, "w");
+
+  if (Options->Extent == POINT)
+    return;
+
+  /* with the binary output all the pixels go to Pixel.bin */
+  for (i = 0; i < Dump->NPix && Options->PixelOutput == PIXEL_TEXT; i++) {
+    sprintf(BaseName, "%sPixel.%s", Dump->Path, Dump->Pix[i].Name);
+    OpenOutput(&(Dump->Pix[i].OutFile.FilePtr), Dump->Pix[i].OutFile.FileName,
+	       BaseName, "w");
+  }
+  if (Dump->NPix > 0 && Options->PixelOutput == PIXEL_BINARY) {
+    sprintf(BaseName, "%sPixel.bin", Dump->Path);
+    OpenOutput(&(Dump->PixBin.FilePtr), Dump->PixBin.FileName, BaseName,
+	       "wb");
+    setvbuf(Dump->PixBin.FilePtr, NULL, _IOFBF, PIXEL_OUTBUF);
+  }
+
+  /* if no network open unit hydrograph file, with SNOW ONLY nothing is
+     routed */
+  if (!(Options->HasNetwork) && !(Options->SnowOnly)) {
+    sprintf(BaseName, "%sStream.Flow", Dump->Path);
+    OpenOutput(&(Dump->Stream.FilePtr), Dump->Stream.FileName, BaseName, "w");
+  }
+}
+
+/*******************************************************************************
+  Function name: RolloverDump()
+
+  Purpose      : Start the output files of a new OUTPUT ROLLOVER period
+
+  Required     :
+    MAPSIZE *Map          - Information about basin area
+    OPTIONSTRUCT *Options - Mode options
+    DUMPSTRUCT *Dump      - Information on what to output when
+
+  Returns      : void
+
+  Modifies     : The files of Dump, and the names and first records of the
+                 map files
+
+  Comments     : Called at the first step of the period, after RolloverDue(),
+                 and before the outputs of the step are written.  The state
+                 files and the statistics maps do not roll over.
+*******************************************************************************/
+void RolloverDump(MAPSIZE *Map, OPTIONSTRUCT *Options, DUMPSTRUCT *Dump)
+{
+  OpenDumpFiles(Options, Dump);
+  if (Options->Extent == POINT)
+    return;
+
+  CreateMapFiles(Map, Dump->Path, Dump->NMaps, Dump->DMap);
+}
+
+/*******************************************************************************
+  Function name: CreateMapFiles()
+
+  Purpose      : Create the files of the map and image dumps for the open 
+                 OUTPUT ROLLOVER period
+
+  Required     :
+    MAPSIZE *Map  - Information about basin area
+    char *Path    - Directory to write output to
+    int NMaps     - Number of maps and images
+    MAPDUMP *DMap - Maps and images, with the dates and FileSet set
+
+  Returns      : void
+
+  Modifies     : The names and first records of the files of DMap
+
+  Comments     : The maps of a set of more than one map (MAP FILE LAYOUT = 
+                 COMBINED) are written to one file Map.Set<n>, which is 
+                 created by the first map of the set with header space for 
+                 all of them.  Write2DMatrixNetCDF() defines the variable of
+                 each map in the file at its first write
+*******************************************************************************/
+static void CreateMapFiles(MAPSIZE *Map, char *Path, int NMaps, 
+			   MAPDUMP *DMap)
+{
+  NCSTORAGE Storage;
+  int NSets = 0;
+  int i;
+  int j;
+
+  for (i = 0; i < NMaps; i++) {
+    if (DMap[i].FileSet != i) {
+      strcpy(DMap[i].FileName, DMap[DMap[i].FileSet].FileName);
+      DMap[i].FirstIndex = DMap[DMap[i].FileSet].FirstIndex;
+      continue;
+    }
+
+    Storage = DMap[i].Storage;
+    Storage.NVars = 0;
+    for (j = i; j < NMaps; j++)
+      if (DMap[j].FileSet == i)
+	Storage.NVars++;
 
-    /* if no network open unit hydrograph file */
-    if (!(Options->HasNetwork)) {
-      sprintf(Dump->Stream.FileName, "%sStream.Flow", Dump->Path);
-      OpenFile(&(Dump->Stream.FilePtr), Dump->Stream.FileName, "w", TRUE);
+    if (Storage.NVars > 1) {
+      sprintf(DMap[i].FileName, "%sMap.Set%d%s", Path, ++NSets, fileext);
+      sprintf(DMap[i].FileLabel, "%d maps dumped at the same dates", 
+	      Storage.NVars);
     }
+    else {
+      strcpy(DMap[i].FileName, Path);
+      GetVarFileName(DMap[i].ID, DMap[i].Layer, DMap[i].Resolution, 
+		     DMap[i].FileName);
+    }
+    CreateOutputMap(&(DMap[i]), Map, (DMap[i].Resolution == MAP_OUTPUT) ? 
+		    &Storage : NULL);
+  }
+}
+
+/*******************************************************************************
+  Function name: JoinMapFile()
+
+  Purpose      : Determine whether map dump i can be written to the file of
+                 the set of map dumps Set
+
+  Required     :
+    MAPDUMP *DMap - Map dumps, with FileSet set before i
+    int Set       - First map of the set
+    int i         - Map dump
+
+  Returns      : TRUE if the maps are dumped at the same dates on the same 
+                 grid, both are classic or both NetCDF-4 maps, and no map 
+                 of the set has 
+                 the name of map i (the same variable with another MAP 
+                 REDUCER)
+*******************************************************************************/
+static int JoinMapFile(MAPDUMP *DMap, int Set, int i)
+{
+  MAPDUMP *A = &(DMap[Set]);
+  MAPDUMP *B = &(DMap[i]);
+  NCSTORAGE *S[2];
+  int NetCDF4[2];
+  int j;
+
+  if (A->Resolution != MAP_OUTPUT || B->Resolution != MAP_OUTPUT || 
+      A->N != B->N)
+    return FALSE;
+  if (A->WinX != B->WinX || A->WinY != B->WinY || A->WinNX != B->WinNX ||
+      A->WinNY != B->WinNY || A->Block != B->Block)
+    return FALSE;
+  for (j = 0; j < A->N; j++)
+    if (!IsEqualTime(&(A->DumpDate[j]), &(B->DumpDate[j])))
+      return FALSE;
+  for (j = Set; j < i; j++)
+    if (DMap[j].FileSet == Set && strcmp(DMap[j].Name, B->Name) == 0)
+      return FALSE;
+
+  S[0] = &(A->Storage);
+  S[1] = &(B->Storage);
+  for (j = 0; j < 2; j++)
+    NetCDF4[j] = (S[j]->Chunk[0] > 0 || S[j]->Deflate > 0 || S[j]->Shuffle ||
+		  S[j]->Quantize > 0);
+  return NetCDF4[0] == NetCDF4[1];
+}
+
+/*******************************************************************************
+  Function name: InitDiagnostics()
+
+  Purpose      : Find the diagnostics that are read by the configured outputs,
+                 so that the model loop does not compute the others
+
+  Required     :
+    OPTIONSTRUCT *Options - Mode options
+    DUMPSTRUCT *Dump      - Information on what to output when, with the
+                            maps, statistics and state dumps set up
+    int NGraphics         - Number of graphics
+    int *which_graphics   - Graphics IDs (see Draw())
+
+  Returns      : void
+
+  Modifies     : Dump->Diagnostics
+
+  Comments     : The met fields of the graphics are drawn by graphics 22 to
+                 25, and written to the Met.State files of the model state
+                 when there are graphics
+*******************************************************************************/
+void InitDiagnostics(OPTIONSTRUCT *Options, DUMPSTRUCT *Dump, int NGraphics,
+		     int *which_graphics)
+{
+  int i;
+
+  Dump->Diagnostics = 0;
+  if (Options->Extent == POINT)
+    return;
+
+  for (i = 0; i < Dump->NMaps; i++)
+    if (Dump->DMap[i].ID == 206)
+      Dump->Diagnostics |= DIAG_SUMPRECIP;
+  for (i = 0; i < Dump->NStats; i++)
+    if (Dump->Stats[i].Map.ID == 206)
+      Dump->Diagnostics |= DIAG_SUMPRECIP;
+
+  if (NGraphics > 0) {
+    if (Options->StateFormat == STATE_MAPS &&
+	(Dump->NStates != 0 || Options->SpinUpCycles > 0))
+      Dump->Diagnostics |= DIAG_METMAP;
+    for (i = 0; i < NGraphics; i++)
+      if (which_graphics[i] >= 22 && which_graphics[i] <= 25)
+	Dump->Diagnostics |= DIAG_METMAP;
+  }
+}
+
+/*******************************************************************************
+  Function name: CompareDumpEvents()
+
+  Purpose      : qsort() comparison of two DUMPEVENTs, by date and then by 
+                 their position before sorting
+*******************************************************************************/
+static int CompareDumpEvents(const void *A, const void *B)
+{
+  const DUMPEVENT *EventA = (const DUMPEVENT *) A;
+  const DUMPEVENT *EventB = (const DUMPEVENT *) B;
+
+  if (EventA->Date->Julian < EventB->Date->Julian)
+    return -1;
+  if (EventA->Date->Julian > EventB->Date->Julian)
+    return 1;
+  return EventA->Order - EventB->Order;
+}
+
+/*******************************************************************************
+  Function name: InitDumpEvents()
+
+  Purpose      : Collect the state and map dump dates in a single list sorted
+                 by date, so that ExecDump() only has to look at the next 
+                 dumps in the list instead of comparing every dump date at 
+                 every time step
+
+  Required     :
+    DUMPSTRUCT *Dump      - Information on what to output when, with DState
+                            and DMap set up
+
+  Returns      : void
+
+  Modifies     : NEvents, Events and NextEvent in Dump
+
+  Comments     : At the same date the state dumps come first, followed by 
+                 the maps in the order of DMap, as in the original scan
+*****************************************************************************/
+void InitDumpEvents(DUMPSTRUCT *Dump)
+{
+  char *Routine = "InitDumpEvents";
+  int i;			/* counter */
+  int j;			/* counter */
+  int n;			/* event counter */
+
+  Dump->NEvents = (Dump->NStates > 0) ? Dump->NStates : 0;
+  for (i = 0; i < Dump->NMaps; i++)
+    Dump->NEvents += Dump->DMap[i].N;
+  Dump->NextEvent = 0;
+  Dump->Events = NULL;
+  if (Dump->NEvents == 0)
+    return;
+
+  if (!(Dump->Events = (DUMPEVENT *)TaggedCalloc(Dump->NEvents,
+						 sizeof(DUMPEVENT), MEM_OUTPUT)))
+    ReportError(Routine, 1);
+
+  n = 0;
+  for (i = 0; i < Dump->NStates; i++, n++) {
+    Dump->Events[n].Date = &(Dump->DState[i]);
+    Dump->Events[n].Type = STATE_EVENT;
+    Dump->Events[n].Order = n;
   }
+  for (i = 0; i < Dump->NMaps; i++) {
+    for (j = 0; j < Dump->DMap[i].N; j++, n++) {
+      Dump->Events[n].Date = &(Dump->DMap[i].DumpDate[j]);
+      Dump->Events[n].Type = MAP_EVENT;
+      Dump->Events[n].Map = i;
+      Dump->Events[n].Index = j;
+      Dump->Events[n].Order = n;
+    }
+  }
+
+  qsort(Dump->Events, Dump->NEvents, sizeof(DUMPEVENT), CompareDumpEvents);
 }
 
 /*******************************************************************************
@@ -262,7 +655,7 @@ void InitStateDump(LISTPTR Input, int NStates, DATE ** DState)
   char *SectionName = "OUTPUT";
   char VarStr[BUFSIZE + 1];
 
-  if (!(*DState = (DATE *)calloc(NStates, sizeof(DATE))))
+  if (!(*DState = (DATE *)TaggedCalloc(NStates, sizeof(DATE), MEM_OUTPUT)))
     ReportError(Routine, 1);
 
   for (i = 0; i < NStates; i++) {
@@ -357,8 +750,6 @@ void InitImageDump(LISTPTR Input, int Dt, MAPSIZE * Map, int MaxSoilLayers,
     (*DMap)[i].NumberType = NC_BYTE;
     strcpy((*DMap)[i].Format, "%d");
 
-    CreateMapFile((*DMap)[i].FileName, (*DMap)[i].FileLabel, Map);
-
     if (!SScanDate(VarStr[image_start], &Start))
       ReportError(KeyName[image_start], 51);
 
@@ -375,7 +766,8 @@ void InitImageDump(LISTPTR Input, int Dt, MAPSIZE * Map, int MaxSoilLayers,
     if (((*DMap)[i].N = NumberOfSteps(&Start, &End, Interval)) < 1)
       ReportError("Input Options File", 25);
 
-    if (!((*DMap)[i].DumpDate = (DATE *)calloc((*DMap)[i].N, sizeof(DATE))))
+    if (!((*DMap)[i].DumpDate = (DATE *)TaggedCalloc((*DMap)[i].N,
+						     sizeof(DATE), MEM_OUTPUT)))
       ReportError(Routine, 1);
 
     CopyDate(&((*DMap)[i].DumpDate[0]), &Start);
@@ -384,6 +776,10 @@ void InitImageDump(LISTPTR Input, int Dt, MAPSIZE * Map, int MaxSoilLayers,
       (*DMap)[i].DumpDate[j] =
       NextDate(&((*DMap)[i].DumpDate[j - 1]), Interval);
 
+    /* after the dates, which number the records of the file */
+    (*DMap)[i].FileSet = i;
+    CreateOutputMap(&((*DMap)[i]), Map, NULL);
+
     if (!CopyFloat(&((*DMap)[i].MaxVal), VarStr[image_upper], 1))
       ReportError(KeyName[image_upper], 51);
 
@@ -407,39 +803,66 @@ void InitImageDump(LISTPTR Input, int Dt, MAPSIZE * Map, int MaxSoilLayers,
     int NTotalMapImages   - Total number of maps and images to dump
     int NMaps             - Number of maps to dump
     MAPDUMP **DMap        - Array of maps and images to dump
+    OPTIONSTRUCT *Options - Mode options
 
   Returns      : void
 
   Modifies     : DMap and its members
 
-  Comments     :
+  Comments     : The optional keys MAP CHUNK SIZE (time, y and x), MAP 
+                 DEFLATE LEVEL, MAP SHUFFLE and MAP QUANTIZE DIGITS select
+                 NetCDF-4 storage for the map.  They are only used for 
+                 NETCDF output, and all but MAP QUANTIZE DIGITS for ZARR
+                 output (FileIOZarr.c).  MAP REDUCER (LAST, MEAN, MIN, MAX or SUM)
+                 selects the value dumped at each MAP DATE, the default LAST
+                 is the value at the date.  MAP WINDOW (first column, first
+                 row, columns and rows) or MAP MASK (a mask file) limit the
+                 map to a part of the model map, and MAP BLOCK SIZE with MAP
+                 BLOCK REDUCER (MEAN or MAX) reduce it to blocks of cells, 
+                 see MapWindow.c.  With MAP FILE LAYOUT = COMBINED
+                 the maps with the same dump dates are written to one NetCDF
+                 file (see CreateMapFiles())
 *******************************************************************************/
 void InitMapDump(LISTPTR Input, MAPSIZE * Map, int MaxSoilLayers,
   int MaxVegLayers, char *Path, int TotalMapImages, int NMaps,
-  MAPDUMP ** DMap)
+  MAPDUMP ** DMap, OPTIONSTRUCT *Options)
 {
   char *Routine = "InitMapDump";
   int i;			/* counter */
   int j;			/* counter */
   int MaxLayers;		/* Maximum number of layers allowed for this
                    variable */
-  char KeyName[map_date + 1][BUFSIZE + 1];
+  int Window[4];		/* MAP WINDOW */
+  NCSTORAGE *Storage;
+  char KeyName[map_block_reducer + 1][BUFSIZE + 1];
   char *KeyStr[] = {
     "MAP VARIABLE",
     "MAP LAYER",
     "NUMBER OF MAPS",
     "MAP DATE",
+    "MAP CHUNK SIZE",
+    "MAP DEFLATE LEVEL",
+    "MAP SHUFFLE",
+    "MAP QUANTIZE DIGITS",
+    "MAP REDUCER",
+    "MAP WINDOW",
+    "MAP MASK",
+    "MAP BLOCK SIZE",
+    "MAP BLOCK REDUCER",
   };
   char *SectionName = "OUTPUT";
-  char VarStr[map_date + 1][BUFSIZE + 1];
+  char VarStr[map_block_reducer + 1][BUFSIZE + 1];
 
-  if (!(*DMap = (MAPDUMP *)calloc(TotalMapImages, sizeof(MAPDUMP))))
+  if (!(*DMap = (MAPDUMP *)TaggedCalloc(TotalMapImages, sizeof(MAPDUMP),
+					MEM_OUTPUT)))
     ReportError(Routine, 1);
 
   for (i = 0; i < NMaps; i++) {
 
     /* Read the key-entry pairs from the input file */
-    for (j = 0; j <= nmaps; j++) {
+    for (j = 0; j <= map_block_reducer; j++) {
+      if (j == map_date)
+	continue;
       sprintf(KeyName[j], "%s %d", KeyStr[j], i + 1);
       GetInitString(SectionName, KeyName[j], "", VarStr[j],
         (unsigned long)BUFSIZE, Input);
@@ -467,7 +890,83 @@ void InitMapDump(LISTPTR Input, MAPSIZE * Map, int MaxSoilLayers,
     strncpy((*DMap)[i].FileName, Path, BUFSIZE);
     GetVarAttr(&((*DMap)[i]));
 
-    CreateMapFile((*DMap)[i].FileName, (*DMap)[i].FileLabel, Map);
+    /* NetCDF-4 storage, the defaults give a classic NetCDF file */
+    Storage = &((*DMap)[i].Storage);
+    if (!IsEmptyStr(VarStr[map_chunk]) &&
+        (!CopyInt(Storage->Chunk, VarStr[map_chunk], 3) ||
+         Storage->Chunk[0] < 1 || Storage->Chunk[1] < 1 || 
+         Storage->Chunk[2] < 1))
+      ReportError(KeyName[map_chunk], 51);
+    if (!IsEmptyStr(VarStr[map_deflate]) &&
+        (!CopyInt(&(Storage->Deflate), VarStr[map_deflate], 1) ||
+         Storage->Deflate < 0 || Storage->Deflate > 9))
+      ReportError(KeyName[map_deflate], 51);
+    if (strncmp(VarStr[map_shuffle], "TRUE", 4) == 0)
+      Storage->Shuffle = TRUE;
+    else if (IsEmptyStr(VarStr[map_shuffle]) ||
+             strncmp(VarStr[map_shuffle], "FALSE", 5) == 0)
+      Storage->Shuffle = FALSE;
+    else
+      ReportError(KeyName[map_shuffle], 51);
+    if (!IsEmptyStr(VarStr[map_quantize]) &&
+        (!CopyInt(&(Storage->Quantize), VarStr[map_quantize], 1) ||
+         Storage->Quantize < 0))
+      ReportError(KeyName[map_quantize], 51);
+
+    /* temporal reducer, the label of the file says how the map is reduced */
+    if (IsEmptyStr(VarStr[map_reducer]) ||
+        strncmp(VarStr[map_reducer], "LAST", 4) == 0)
+      (*DMap)[i].Reducer = REDUCE_LAST;
+    else if (strncmp(VarStr[map_reducer], "MEAN", 4) == 0)
+      (*DMap)[i].Reducer = REDUCE_MEAN;
+    else if (strncmp(VarStr[map_reducer], "MIN", 3) == 0)
+      (*DMap)[i].Reducer = REDUCE_MIN;
+    else if (strncmp(VarStr[map_reducer], "MAX", 3) == 0)
+      (*DMap)[i].Reducer = REDUCE_MAX;
+    else if (strncmp(VarStr[map_reducer], "SUM", 3) == 0)
+      (*DMap)[i].Reducer = REDUCE_SUM;
+    else
+      ReportError(KeyName[map_reducer], 51);
+    if ((*DMap)[i].Reducer != REDUCE_LAST) {
+      strncat((*DMap)[i].FileLabel, " (", 
+	      BUFSIZE - strlen((*DMap)[i].FileLabel));
+      strncat((*DMap)[i].FileLabel, VarStr[map_reducer], 
+	      BUFSIZE - strlen((*DMap)[i].FileLabel));
+      strncat((*DMap)[i].FileLabel, " since the previous map)", 
+	      BUFSIZE - strlen((*DMap)[i].FileLabel));
+    }
+
+    /* part of the map and spatial reduction, not with BASIN ONLY OUTPUT,
+       whose files hold the cells of the whole basin */
+    if (!IsEmptyStr(VarStr[map_window])) {
+      if (!CopyInt(Window, VarStr[map_window], 4) ||
+	  Options->BasinOnlyOutput || !IsEmptyStr(VarStr[map_mask]) ||
+	  Window[0] < 0 || Window[1] < 0 || Window[2] < 1 || Window[3] < 1 ||
+	  Window[0] + Window[2] > Map->NX || Window[1] + Window[3] > Map->NY)
+	ReportError(KeyName[map_window], 51);
+      (*DMap)[i].WinX = Window[0];
+      (*DMap)[i].WinY = Window[1];
+      (*DMap)[i].WinNX = Window[2];
+      (*DMap)[i].WinNY = Window[3];
+    }
+    if (!IsEmptyStr(VarStr[map_mask])) {
+      if (Options->BasinOnlyOutput)
+	ReportError(KeyName[map_mask], 51);
+      ReadMapMask(VarStr[map_mask], Map, &((*DMap)[i]));
+    }
+    (*DMap)[i].Block = 1;
+    if (!IsEmptyStr(VarStr[map_block_size]) &&
+	(!CopyInt(&((*DMap)[i].Block), VarStr[map_block_size], 1) ||
+	 (*DMap)[i].Block < 1 || 
+	 ((*DMap)[i].Block > 1 && Options->BasinOnlyOutput)))
+      ReportError(KeyName[map_block_size], 51);
+    if (IsEmptyStr(VarStr[map_block_reducer]) ||
+	strncmp(VarStr[map_block_reducer], "MEAN", 4) == 0)
+      (*DMap)[i].BlockReducer = REDUCE_MEAN;
+    else if (strncmp(VarStr[map_block_reducer], "MAX", 3) == 0)
+      (*DMap)[i].BlockReducer = REDUCE_MAX;
+    else
+      ReportError(KeyName[map_block_reducer], 51);
 
     if (!CopyInt(&((*DMap)[i].N), VarStr[nmaps], 1))
       ReportError(KeyName[nmaps], 51);
@@ -475,7 +974,8 @@ void InitMapDump(LISTPTR Input, MAPSIZE * Map, int MaxSoilLayers,
     if ((*DMap)[i].N < 1)
       ReportError("Input Options File", 22);
 
-    if (!((*DMap)[i].DumpDate = (DATE *)calloc((*DMap)[i].N, sizeof(DATE))))
+    if (!((*DMap)[i].DumpDate = (DATE *)TaggedCalloc((*DMap)[i].N,
+						     sizeof(DATE), MEM_OUTPUT)))
       ReportError(Routine, 1);
 
     for (j = 0; j < (*DMap)[i].N; j++) {
@@ -486,9 +986,20 @@ void InitMapDump(LISTPTR Input, MAPSIZE * Map, int MaxSoilLayers,
         ReportError(KeyName[map_date], 51);
     }
 
+    /* the first of the maps with the same dates creates their file */
+    (*DMap)[i].FileSet = i;
+    for (j = 0; j < i && Options->MapFileLayout == MAPFILES_COMBINED; j++)
+      if ((*DMap)[j].FileSet == j && JoinMapFile(*DMap, j, i)) {
+	(*DMap)[i].FileSet = j;
+	break;
+      }
+
     (*DMap)[i].MinVal = 0.0;
     (*DMap)[i].MaxVal = 0.0;
   }
+
+  /* after the dates, which number the records of the files */
+  CreateMapFiles(Map, Path, NMaps, *DMap);
 }
 
 /*******************************************************************************
@@ -533,7 +1044,7 @@ int InitPixDump(LISTPTR Input, MAPSIZE *Map, uchar **BasinMask, char *Path,
 
   ok = 0;
 
-  if (!(*Pix = (PIXDUMP *)calloc(NPix, sizeof(PIXDUMP))))
+  if (!(*Pix = (PIXDUMP *)TaggedCalloc(NPix, sizeof(PIXDUMP), MEM_OUTPUT)))
     ReportError(Routine, 1);
 
   for (i = 0; i < NPix; i++) {
@@ -567,10 +1078,10 @@ int InitPixDump(LISTPTR Input, MAPSIZE *Map, uchar **BasinMask, char *Path,
     else {
       printf("Accepting dump command for pixel named %s \n", temp_name);
       sprintf(Str, "%s", temp_name);
-      sprintf((*Pix)[ok].OutFile.FileName, "%sPixel.%s", Path, Str);
+      strcpy((*Pix)[ok].Name, Str);
       (*Pix)[ok].Loc.N = (*Pix)[i].Loc.N;
       (*Pix)[ok].Loc.E = (*Pix)[i].Loc.E;
-      OpenFile(&((*Pix)[ok].OutFile.FilePtr), (*Pix)[ok].OutFile.FileName, "w", TRUE);
+      /* the files of the pixels are opened by OpenDumpFiles() */
       ok++;
     }
   }
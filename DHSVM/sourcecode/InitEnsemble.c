@@ -0,0 +1,121 @@
+/*
+ * SUMMARY:      InitEnsemble.c - Run the members of an ensemble
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Runs OPTIONS ENSEMBLE MEMBERS copies of the model from the
+ *               static data loaded once by the parent process
+ * DESCRIP-END.
+ * FUNCTIONS:    InitEnsemble()
+ * COMMENTS:     Each member is a process created with fork() once the
+ *               terrain, the parameter tables, the channel network, the
+ *               shading and sky view maps and the interpolation weights are
+ *               loaded.  The child processes share the memory pages of the
+ *               parent until they write to them, so the static data is held
+ *               in memory once and only the model state that a member
+ *               changes is copied.  Members differ in their precipitation
+ *               factor (ENSEMBLE PRECIPITATION FACTORS) and in the random
+ *               perturbation of their station forcing (ENSEMBLE ...
+ *               PERTURBATION, see PerturbForcing.c), and write their
+ *               output to the subdirectory member.NNN of the output
+ *               directory.  Needs HAVE_FORK
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef HAVE_FORK
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "fileio.h"
+#include "functions.h"
+#include "trace.h"
+#include "telemetry.h"
+
+/*****************************************************************************
+  InitEnsemble()
+
+  Returns in each member process, with Options->Member and
+  Options->PrecipFactor set.  The parent process starts at most as many
+  members at a time as there are processors, waits for all of them and
+  exits.  Files that are open at this point and read later (the station
+  files and the met cache) are reopened in each member, and the file IO is
+  restarted, so that no file offsets or writer threads are shared.  Returns
+  0 without starting any processes if there is only one member.
+*****************************************************************************/
+int InitEnsemble(OPTIONSTRUCT *Options, int NStats, METLOCATION *Stat)
+{
+#ifdef HAVE_FORK
+  const char *Routine = "InitEnsemble";
+  pid_t Pid;
+  long MaxRunning;		/* Number of members run at the same time */
+  int NRunning;			/* Number of members running */
+  int NFailed;			/* Number of members that did not finish */
+  int Status;
+  int m;			/* counter */
+
+  if (Options->NMembers < 2)
+    return 0;
+
+  MaxRunning = sysconf(_SC_NPROCESSORS_ONLN);
+  if (MaxRunning < 1)
+    MaxRunning = 1;
+  printf("\nRunning %d ensemble members, at most %ld at a time\n",
+	 Options->NMembers, MaxRunning);
+
+  /* no output buffers, open NetCDF files or writer thread in the copies */
+  CloseFileIO();
+  ForkTrace(-1);
+  ForkTelemetry(-1);
+  fflush(stdout);
+  fflush(stderr);
+
+  NRunning = 0;
+  NFailed = 0;
+  for (m = 0; m < Options->NMembers; m++) {
+    if (NRunning == MaxRunning) {
+      if (wait(&Status) > 0 && !(WIFEXITED(Status) &&
+				 WEXITSTATUS(Status) == EXIT_SUCCESS))
+	NFailed++;
+      NRunning--;
+    }
+    if ((Pid = fork()) < 0)
+      ReportError((char *) Routine, 1);
+    if (Pid == 0) {
+      ForkTrace(m);
+      ForkTelemetry(m);
+      Options->Member = m;
+      Options->PrecipFactor = Options->EnsemblePrecip[m];
+      ReopenMetFiles(NStats, Stat);
+      InitFileIO(Options->FileFormat, Options->NcSyncInterval,
+		 Options->OutputQueueSize, Options->BasinOnlyOutput);
+      printf("Ensemble member %d, precipitation factor %g\n", m + 1,
+	     Options->PrecipFactor);
+      return m;
+    }
+    NRunning++;
+  }
+
+  while (NRunning > 0) {
+    if (wait(&Status) > 0 && !(WIFEXITED(Status) &&
+			       WEXITSTATUS(Status) == EXIT_SUCCESS))
+      NFailed++;
+    NRunning--;
+  }
+
+  printf("\n%d of %d ensemble members finished\n", Options->NMembers - NFailed,
+	 Options->NMembers);
+  CloseTrace();
+  exit(NFailed > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+#else
+  if (Options->NMembers > 1)
+    ReportError("ENSEMBLE MEMBERS (not supported in this build)", 51);
+  return 0;
+#endif
+}
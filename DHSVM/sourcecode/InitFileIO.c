@@ -10,23 +10,124 @@
  *               format to be used (at this time either binary or HDF v3.3
  * DESCRIP-END.
  * FUNCTIONS:    InitFileIO()
+ *               CloseFileIO()
+ *               WaitFileIO()
+ *               ReadBasinMatrix()
+ *               Read2DField()
+ *               ReadBasinField()
+ *               Read2DWindow()
+ *               GatherMatrix()
+ *               IsGathered()
+ *               IsBlock()
+ *               ReverseRows()
+ *               CopyValue()
+ *               WriterThread()
  * COMMENTS:     In order to use the NetCDF, you have to define HAVE_NETCDF 
- *               during the build
+ *               during the build, and HAVE_ZLIB for FILE FORMAT BINZ.  Map writes are passed to a background
+ *               thread if HAVE_PTHREAD is defined during the build and 
+ *               OUTPUT QUEUE SIZE is larger than zero.  With BASIN ONLY 
+ *               OUTPUT, maps are written as a vector of the cells in the 
+ *               basin.  The reads and writes are spans in the trace of the
+ *               run with OPTIONS TRACE FILE (Trace.c)
  * $Id: InitFileIO.c,v 3.1 2013/02/06 19:12 ning Exp $
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #include "fileio.h"
 #include "fifobin.h"
+#include "fifobinz.h"
+#include "fifozarr.h"
 #include "fifoNetCDF.h"
+#include "sizeofnt.h"
 #include "DHSVMerror.h"
+#include "memaccount.h"
+#include "trace.h"
 
 /* global function pointers */
 void (*CreateMapFileFmt) (char *FileName, ...);
 int (*Read2DMatrixFmt) (char *FileName, void *Matrix, int NumberType, int NY, int NX, int NDataSet, ...);
+int (*Read3DMatrixFmt) (char *FileName, void *Matrix, int NumberType, int NY, int NX, int NDataSet, int NLayers, ...);
+int (*Read2DWindowFmt) (char *FileName, void *Matrix, int NumberType, int NY, int NX, int NDataSet, int WinY, int WinX, int WinNY, int WinNX, ...);
 int (*Write2DMatrixFmt) (char *FileName, void *Matrix, int NumberType, int NY, int NX, ...);
+void (*CloseFileIOFmt) (void) = NULL;
+
+#ifdef HAVE_PTHREAD
+/* types of jobs for the writer thread */
+#define CREATE_JOB 1
+#define WRITE_JOB  2
+
+typedef struct {
+  int Type;			/* CREATE_JOB or WRITE_JOB */
+  char FileName[BUFSIZE + 1];
+  char FileLabel[BUFSIZE + 1];
+  MAPSIZE Map;
+  MAPDUMP DMap;
+  NCSTORAGE Storage;
+  int HasStorage;		/* FALSE if CreateMapFile() got NULL */
+  int NumberType;
+  int NY;			/* shape of Buffer, 1 x NumActive if the */
+  int NX;			/* map is gathered */
+  int Index;
+  void *Buffer;			/* copy of the matrix to write, kept with 
+				   the queue entry and reused */
+  size_t BufferSize;		/* allocated size of Buffer in bytes */
+} WRITEJOB;
+
+/* the queue is a ring of MaxJobs entries.  Only the main thread adds 
+   entries and only the writer thread removes them */
+static int Async = FALSE;	/* TRUE if the writer thread is running */
+static int SerializeIO = FALSE;	/* TRUE if reads on the main thread must 
+				   wait for the writer (NetCDF) */
+static WRITEJOB *Queue = NULL;
+static int MaxJobs = 0;
+static int Head = 0;		/* oldest pending entry */
+static int NPending = 0;	/* number of pending entries */
+static int StopWriter = FALSE;
+static pthread_t Writer;
+static pthread_mutex_t QueueLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t JobReady = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t JobDone = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t IOLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *WriterThread(void *Arg);
+static WRITEJOB *NextJob(void);
+static void SubmitJob(void);
+#endif
+
+/* With BASIN ONLY OUTPUT, maps are gathered into GatherArray before they 
+   are written, and scattered from it after they are read */
+static int Gather = FALSE;
+static int Format = 0;		/* FileFormat passed to InitFileIO() */
+static void *GatherArray = NULL;
+static size_t GatherSize = 0;	/* allocated size of GatherArray in bytes */
+
+static void *GatherMatrix(void *Matrix, int NumberType, MAPSIZE *Map,
+			  int Scatter);
+static int IsGathered(char *FileName, int NumberType, MAPSIZE *Map,
+                      int NDataSet);
+static int IsBlock(MAPFIELD *Field, MAPSIZE *Map);
+static void ReverseRows(void *Matrix, size_t RowSize, int NY);
+static void CopyValue(void *To, int ToType, void *From, int FromType);
+
+/* address of the field of cell (y, x) of a MAPFIELD */
+#define FIELDCELL(Field, y, x) \
+  ((char *) (Field)->Rows[(y)] + (size_t) (x) * (Field)->CellSize + \
+   (Field)->Offset)
+
+/* Lock the format specific functions for the main thread */
+#ifdef HAVE_PTHREAD
+#define LOCK_IO() if (SerializeIO) pthread_mutex_lock(&IOLock)
+#define UNLOCK_IO() if (SerializeIO) pthread_mutex_unlock(&IOLock)
+#else
+#define LOCK_IO()
+#define UNLOCK_IO()
+#endif
 
 /*******************************************************************************
   Function name: InitFileIO()
@@ -34,7 +135,12 @@ int (*Write2DMatrixFmt) (char *FileName, void *Matrix, int NumberType, int NY, i
   Purpose      : Initialize function pointers for file IO
 
   Required     :
-    int FileFormat - identifier for the file format to be used
+    int FileFormat   - identifier for the file format to be used
+    int SyncInterval - number of writes to an open NetCDF file between 
+                       flushes to disk (0 = only when the file is closed)
+    int QueueSize    - number of map writes that may be pending on the 
+                       writer thread (0 = write before returning)
+    int BasinOnly    - if TRUE, maps only hold the cells in the basin
 
   Returns      : void
 
@@ -83,8 +189,29 @@ int (*Write2DMatrixFmt) (char *FileName, void *Matrix, int NumberType, int NY, i
    installed on your system.  If this is the case, HAVE_NETCDF needs to be
    defined at compile time.  If it is not defined the NetCDF functions cannot be
    used, and DHSVM will not try to access the NetCDF libraries.
+
+   If QueueSize is larger than zero, CreateMapFile() and Write2DMatrix() 
+   copy their arguments into a queue and return, and a background thread 
+   does the actual writing in the order of the calls.  If the queue is full,
+   the model waits until the oldest write has finished.  The queue is
+   emptied by CloseFileIO().  The NetCDF library can only be used by one 
+   thread at a time, so in that case reads wait for a write in progress.
+   So do the reads of FILE FORMAT BINZ, whose writes move the index of a
+   file to its new end (FileIOBinZ.c), and of FILE FORMAT ZARR.
+
+   If BasinOnly is TRUE, Write2DMatrix() writes a map as a single row of 
+   Map->NumActive values, one for each cell in the basin in the row-major
+   order of the basin mask (ROWCELL(), whatever the order of
+   Map->ActiveCells), and ReadBasinMatrix()
+   reads such a row back into the map.  NetCDF files then have a "cell" 
+   dimension instead of "y" and "x", and a "cell" variable with the index 
+   y * NX + x of each cell and a "compress" attribute (compression by 
+   gathering in the CF conventions), and so do Zarr stores.  The binary
+   files do not store the index, it follows from the mask.  Model states have to be read with the
+   same setting that they were written with.
 *******************************************************************************/
-void InitFileIO(int FileFormat)
+void InitFileIO(int FileFormat, int SyncInterval, int QueueSize,
+		int BasinOnly)
 {
   const char *Routine = "InitFileIO";
 
@@ -95,13 +222,44 @@ void InitFileIO(int FileFormat)
     strcpy(fileext, ".bin");
     CreateMapFileFmt = CreateMapFileBin;
     Read2DMatrixFmt = Read2DMatrixBin;
+    Read3DMatrixFmt = Read3DMatrixBin;
+    Read2DWindowFmt = Read2DWindowBin;
     Write2DMatrixFmt = Write2DMatrixBin;
+    CloseFileIOFmt = CloseFilesBin;
   }
   else if (FileFormat == BYTESWAP) {
     strcpy(fileext, ".bin");
     CreateMapFileFmt = CreateMapFileBin;
     Read2DMatrixFmt = Read2DMatrixByteSwapBin;
+    Read3DMatrixFmt = Read3DMatrixByteSwapBin;
+    Read2DWindowFmt = Read2DWindowByteSwapBin;
     Write2DMatrixFmt = Write2DMatrixByteSwapBin;
+    CloseFileIOFmt = CloseFilesBin;
+  }
+  /******************* Compressed binary format ******************/
+  else if (FileFormat == BINZ) {
+#ifdef HAVE_ZLIB
+    strcpy(fileext, ".binz");
+    CreateMapFileFmt = CreateMapFileBinZ;
+    Read2DMatrixFmt = Read2DMatrixBinZ;
+    Read3DMatrixFmt = Read3DMatrixBinZ;
+    Read2DWindowFmt = Read2DWindowBinZ;
+    Write2DMatrixFmt = Write2DMatrixBinZ;
+    CloseFileIOFmt = CloseFilesBinZ;
+#else
+    ReportError((char *) Routine, 84);
+#endif
+  }
+  /************************* Zarr stores *************************/
+  else if (FileFormat == ZARR) {
+    strcpy(fileext, ".zarr");
+    CreateMapFileFmt = CreateMapFileZarr;
+    Read2DMatrixFmt = Read2DMatrixZarr;
+    Read3DMatrixFmt = Read3DMatrixBin;
+    Read2DWindowFmt = Read2DWindowBin;
+    Write2DMatrixFmt = Write2DMatrixZarr;
+    CloseFileIOFmt = CloseFilesZarr;
+    InitZarr(BasinOnly);
   }
   /************* NetCDF File Format (version 3.4) ****************/
   else if (FileFormat == NETCDF) {
@@ -109,22 +267,228 @@ void InitFileIO(int FileFormat)
     strcpy(fileext, ".nc");
     CreateMapFileFmt = CreateMapFileNetCDF;
     Read2DMatrixFmt = Read2DMatrixNetCDF;
+    Read3DMatrixFmt = Read3DMatrixNetCDF;
+    Read2DWindowFmt = Read2DWindowNetCDF;
     Write2DMatrixFmt = Write2DMatrixNetCDF;
+    CloseFileIOFmt = CloseFilesNetCDF;
+    InitCacheNetCDF(SyncInterval, BasinOnly);
 #else
     ReportError((char *) Routine, 56);
 #endif
   }
   else
     ReportError((char *) Routine, 38);
+
+  Format = FileFormat;
+  Gather = BasinOnly;
+  if (Gather)
+    printf("Writing maps and model states for the basin cells only\n");
+
+  if (QueueSize > 0) {
+#ifdef HAVE_PTHREAD
+    if (!(Queue = (WRITEJOB *) calloc(QueueSize, sizeof(WRITEJOB))))
+      ReportError((char *) Routine, 1);
+    MaxJobs = QueueSize;
+    SerializeIO = (FileFormat == NETCDF || FileFormat == BINZ ||
+		   FileFormat == ZARR);
+    if (pthread_create(&Writer, NULL, WriterThread, NULL) != 0)
+      ReportError((char *) Routine, 1);
+    Async = TRUE;
+    printf("Writing maps on a background thread (%d pending writes)\n",
+	   QueueSize);
+#else
+    printf("OUTPUT QUEUE SIZE ignored, DHSVM was built without HAVE_PTHREAD\n");
+#endif
+  }
+}
+
+/*******************************************************************************
+  Function name: CloseFileIO()
+
+  Purpose      : Close any files that the file IO functions keep open between
+                 calls (currently only NetCDF files)
+
+  Required     : 
+
+  Returns      : void
+
+  Modifies     : 
+
+  Comments     : Called once at the end of the model run.  Any writes still
+                 pending on the writer thread are finished first
+*******************************************************************************/
+void CloseFileIO(void)
+{
+#ifdef HAVE_PTHREAD
+  int i;
+
+  if (Async) {
+    pthread_mutex_lock(&QueueLock);
+    StopWriter = TRUE;
+    pthread_cond_signal(&JobReady);
+    pthread_mutex_unlock(&QueueLock);
+    pthread_join(Writer, NULL);
+    Async = FALSE;
+    SerializeIO = FALSE;
+    for (i = 0; i < MaxJobs; i++)
+      TaggedFree(Queue[i].Buffer);
+    free(Queue);
+    Queue = NULL;
+  }
+#endif
+
+  TaggedFree(GatherArray);
+  GatherArray = NULL;
+  GatherSize = 0;
+
+  if (CloseFileIOFmt != NULL)
+    CloseFileIOFmt();
+}
+
+/*******************************************************************************
+  Function name: WaitFileIO()
+
+  Purpose      : Wait until the writer thread has carried out the map writes
+                 that are pending
+
+  Required     : 
+
+  Returns      : void
+
+  Modifies     : 
+
+  Comments     : Returns at once without OUTPUT QUEUE SIZE
+*******************************************************************************/
+void WaitFileIO(void)
+{
+#ifdef HAVE_PTHREAD
+  if (Async) {
+    pthread_mutex_lock(&QueueLock);
+    while (NPending > 0)
+      pthread_cond_wait(&JobDone, &QueueLock);
+    pthread_mutex_unlock(&QueueLock);
+  }
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+/*******************************************************************************
+  Function name: WriterThread()
+
+  Purpose      : Carry out the queued CreateMapFile() and Write2DMatrix() 
+                 calls in order
+
+  Required     : 
+    void *Arg - not used
+
+  Returns      : NULL
+
+  Modifies     : the queue
+
+  Comments     : Returns when the queue is empty and CloseFileIO() has set
+                 StopWriter.  An entry stays in the queue until it has been
+                 written, so its buffer is not reused before that
+*******************************************************************************/
+static void *WriterThread(void *Arg)
+{
+  WRITEJOB *Job;
+  double Span;
+
+  pthread_mutex_lock(&QueueLock);
+  for (;;) {
+    while (NPending == 0 && !StopWriter)
+      pthread_cond_wait(&JobReady, &QueueLock);
+    if (NPending == 0)
+      break;
+    Job = &(Queue[Head]);
+    pthread_mutex_unlock(&QueueLock);
+
+    pthread_mutex_lock(&IOLock);
+    Span = TRACE_BEGIN();
+    if (Job->Type == CREATE_JOB) {
+      CreateMapFileFmt(Job->FileName, Job->FileLabel, &(Job->Map),
+		       Job->HasStorage ? &(Job->Storage) : NULL);
+      TraceEnd(Span, "CreateMapFile", "io", Job->FileName, -1.0);
+    }
+    else {
+      Write2DMatrixFmt(Job->FileName, Job->Buffer, Job->NumberType,
+		       Job->NY, Job->NX, &(Job->DMap), Job->Index);
+      TraceEnd(Span, "Write2DMatrix", "io", Job->FileName,
+	       (double) SizeOfNumberType(Job->NumberType) * Job->NY * Job->NX);
+    }
+    pthread_mutex_unlock(&IOLock);
+
+    pthread_mutex_lock(&QueueLock);
+    Head = (Head + 1) % MaxJobs;
+    NPending--;
+    pthread_cond_signal(&JobDone);
+  }
+  pthread_mutex_unlock(&QueueLock);
+
+  return NULL;
+}
+
+/* Return the next free queue entry, waiting for the writer thread if the 
+   queue is full */
+static WRITEJOB *NextJob(void)
+{
+  WRITEJOB *Job;
+
+  pthread_mutex_lock(&QueueLock);
+  while (NPending == MaxJobs)
+    pthread_cond_wait(&JobDone, &QueueLock);
+  Job = &(Queue[(Head + NPending) % MaxJobs]);
+  pthread_mutex_unlock(&QueueLock);
+
+  return Job;
+}
+
+/* Pass the entry returned by NextJob() to the writer thread */
+static void SubmitJob(void)
+{
+  pthread_mutex_lock(&QueueLock);
+  NPending++;
+  pthread_cond_signal(&JobReady);
+  pthread_mutex_unlock(&QueueLock);
 }
+#endif
 
 /******************************************************************************/
 /*                            CreateMapFile                                   */
 /******************************************************************************/
+/** 
+ * Create a new map file, overwriting an existing one
+ * 
+ * @param FileName name of the file
+ * @param FileLabel label stored in the file (NetCDF only)
+ * @param Map 
+ * @param Storage NetCDF-4 storage of the variable that will be written to
+ * the file, NULL for a classic file (NetCDF only)
+ */
 void
-CreateMapFile(char *FileName, char *FileLabel, MAPSIZE *Map)
+CreateMapFile(char *FileName, char *FileLabel, MAPSIZE *Map, 
+              NCSTORAGE *Storage)
 {
-  CreateMapFileFmt(FileName, FileLabel, Map);
+  double Span = TRACE_BEGIN();
+#ifdef HAVE_PTHREAD
+  WRITEJOB *Job;
+
+  if (Async) {
+    Job = NextJob();
+    Job->Type = CREATE_JOB;
+    strncpy(Job->FileName, FileName, BUFSIZE);
+    strncpy(Job->FileLabel, FileLabel, BUFSIZE);
+    Job->Map = *Map;
+    Job->HasStorage = (Storage != NULL);
+    if (Storage != NULL)
+      Job->Storage = *Storage;
+    SubmitJob();
+    TraceEnd(Span, "queue CreateMapFile", "io", FileName, -1.0);
+    return;
+  }
+#endif
+  CreateMapFileFmt(FileName, FileLabel, Map, Storage);
+  TraceEnd(Span, "CreateMapFile", "io", FileName, -1.0);
 }
 
 
@@ -135,6 +499,9 @@ CreateMapFile(char *FileName, char *FileLabel, MAPSIZE *Map)
 /** 
  * 
  * 
+ * With a model map that is a window of the input maps (POINT mode, see
+ * Map->FileNY) only the window is read
+ * 
  * @param FileName name of file to read
  * @param Matrix  @e local 2D array (NX, NY) to be filled
  * @param NumberType 
@@ -144,7 +511,9 @@ CreateMapFile(char *FileName, char *FileLabel, MAPSIZE *Map)
  * @param VarName 
  * @param index 
  * 
- * @return 
+ * @return orientation flag of the map: 1 if the rows of a NetCDF map are
+ * stored from south to north (see Read2DMatrixNetCDF()), the caller then
+ * has to reverse them, 0 otherwise.  A window is always read as it is
  */
 int 
 Read2DMatrix(char *FileName, void *Matrix, int NumberType, MAPSIZE *Map,
@@ -152,10 +521,263 @@ Read2DMatrix(char *FileName, void *Matrix, int NumberType, MAPSIZE *Map,
 {
   const char Routine[] = "Read2DMatrix";
   int result;
+  int flag = 0;
+  double Span = TRACE_BEGIN();
+
+  LOCK_IO();
+  if (Map->FileNY > 0)
+    result = Read2DWindowFmt(FileName, Matrix, NumberType, Map->FileNY,
+                             Map->FileNX, NDataSet, Map->WinY, Map->WinX,
+                             Map->NY, Map->NX, VarName, index);
+  else {
+    result = Read2DMatrixFmt(FileName, Matrix, NumberType,
+                             Map->NY, Map->NX, NDataSet, VarName, index);
+    /* the binary formats return the number of values read */
+    if (Format == NETCDF)
+      flag = result;
+  }
+  UNLOCK_IO();
+  TraceEnd(Span, Routine, "io", FileName,
+           (double) SizeOfNumberType(NumberType) * Map->NY * Map->NX);
+  return flag;
+}
+
+/******************************************************************************/
+/*                              Read2DField                                   */
+/******************************************************************************/
+/** 
+ * Read a map into a field of the cells of a model map, for example the Dem
+ * of TopoMap[y][x] (see MAP_FIELD() in fileio.h), instead of into a matrix
+ * that the caller copies.  The rows of a NetCDF map that is stored from
+ * south to north are put in reverse order.  A map of values of the number
+ * type of the file in one block (see MAP_VALUES()) is read in place, the
+ * rows are then reversed in place as well
+ * 
+ * @param FileName name of file to read
+ * @param NumberType number type of the map in the file
+ * @param NDataSet 
+ * @param VarName 
+ * @param index 
+ * @param Field field of the cells to be filled
+ * 
+ * @return orientation flag of the map, see Read2DMatrix()
+ */
+int 
+Read2DField(char *FileName, int NumberType, MAPSIZE *Map, int NDataSet,
+            char *VarName, int index, MAPFIELD Field)
+{
+  const char Routine[] = "Read2DField";
+  size_t Size;
+  size_t RowSize;
+  char *Matrix;
+  char *Row;
+  int flag;
+  int x;
+  int y;
+
+  Size = SizeOfNumberType(NumberType);
+  RowSize = Size * Map->NX;
+
+  if (Field.Type == NumberType && Field.CellSize == Size && 
+      Field.Offset == 0 && IsBlock(&Field, Map)) {
+    flag = Read2DMatrix(FileName, Field.Rows[0], NumberType, Map, NDataSet,
+                        VarName, index);
+    if (flag == 1)
+      ReverseRows(Field.Rows[0], RowSize, Map->NY);
+    return flag;
+  }
 
-  result = Read2DMatrixFmt(FileName, Matrix, NumberType,
-                           Map->NY, Map->NX, NDataSet, VarName, index);
-  return 0;
+  if (!(Matrix = (char *) calloc(Map->NY, RowSize)))
+    ReportError((char *) Routine, 1);
+  flag = Read2DMatrix(FileName, Matrix, NumberType, Map, NDataSet, VarName,
+                      index);
+  for (y = 0; y < Map->NY; y++) {
+    Row = Matrix + RowSize * ((flag == 1) ? Map->NY - 1 - y : y);
+    for (x = 0; x < Map->NX; x++)
+      CopyValue(FIELDCELL(&Field, y, x), Field.Type, Row + x * Size,
+                NumberType);
+  }
+  free(Matrix);
+  return flag;
+}
+
+/******************************************************************************/
+/*                             ReadBasinField                                 */
+/******************************************************************************/
+/** 
+ * Same as Read2DField(), for a map written by Write2DMatrix(): only the
+ * fields of the cells in the basin (Map->ActiveCells) are set.  With BASIN
+ * ONLY OUTPUT the cells are copied from the vector in the file without a
+ * matrix of the whole map, unless the file holds the whole grid (IsGathered())
+ * 
+ * @param FileName name of file to read
+ * @param NumberType number type of the map in the file
+ * @param NDataSet 
+ * @param VarName 
+ * @param index 
+ * @param Field field of the cells to be filled
+ * 
+ * @return result of the format specific read
+ */
+int 
+ReadBasinField(char *FileName, int NumberType, MAPSIZE *Map, int NDataSet,
+               char *VarName, int index, MAPFIELD Field)
+{
+  const char Routine[] = "ReadBasinField";
+  size_t Size;
+  char *Matrix;
+  ITEM *Cell;
+  int Vector;
+  int result;
+  int i;
+  double Span;
+
+  Size = SizeOfNumberType(NumberType);
+  Vector = Gather && IsGathered(FileName, NumberType, Map, NDataSet);
+  if (Vector) {
+    Span = TRACE_BEGIN();
+    Matrix = (char *) GatherMatrix(NULL, NumberType, Map, FALSE);
+    LOCK_IO();
+    result = Read2DMatrixFmt(FileName, Matrix, NumberType, 1,
+                             Map->NumActive, NDataSet, VarName, index);
+    UNLOCK_IO();
+    TraceEnd(Span, Routine, "io", FileName, (double) Size * Map->NumActive);
+  }
+  else {
+    if (!(Matrix = (char *) calloc((size_t) Map->NY * Map->NX, Size)))
+      ReportError((char *) Routine, 1);
+    result = Read2DMatrix(FileName, Matrix, NumberType, Map, NDataSet,
+                          VarName, index);
+  }
+
+  for (i = 0; i < Map->NumActive; i++) {
+    Cell = &(Map->ActiveCells[ROWCELL(Map, i)]);
+    CopyValue(FIELDCELL(&Field, Cell->y, Cell->x), Field.Type, 
+              Matrix + Size * (Vector ? (size_t) i :
+                               (size_t) Cell->y * Map->NX + Cell->x),
+              NumberType);
+  }
+
+  if (!Vector)
+    free(Matrix);
+  return result;
+}
+
+/******************************************************************************/
+/*                             ReadBasinMatrix                                */
+/******************************************************************************/
+/** 
+ * Read a map written by Write2DMatrix().  With BASIN ONLY OUTPUT only the 
+ * cells in the basin are read, the other cells of Matrix are not changed.
+ * A file of the whole grid, such as an initial state from a run without the
+ * option, is read as a whole (IsGathered())
+ * 
+ * @param FileName name of file to read
+ * @param Matrix  @e local 2D array (NX, NY) to be filled
+ * @param NumberType 
+ * @param NDataSet 
+ * @param VarName 
+ * @param index 
+ * 
+ * @return result of the format specific read
+ */
+int 
+ReadBasinMatrix(char *FileName, void *Matrix, int NumberType, MAPSIZE *Map,
+                int NDataSet, char *VarName, int index)
+{
+  int result;
+  double Span;
+
+  if (!Gather || !IsGathered(FileName, NumberType, Map, NDataSet))
+    return Read2DMatrix(FileName, Matrix, NumberType, Map, NDataSet, VarName,
+                        index);
+
+  Span = TRACE_BEGIN();
+  GatherMatrix(NULL, NumberType, Map, FALSE);
+  LOCK_IO();
+  result = Read2DMatrixFmt(FileName, GatherArray, NumberType, 1, 
+                           Map->NumActive, NDataSet, VarName, index);
+  UNLOCK_IO();
+  GatherMatrix(Matrix, NumberType, Map, TRUE);
+  TraceEnd(Span, "ReadBasinMatrix", "io", FileName,
+           (double) SizeOfNumberType(NumberType) * Map->NumActive);
+  return result;
+}
+
+/******************************************************************************/
+/*                              Read3DMatrix                                  */
+/******************************************************************************/
+/** 
+ * Read NLayers consecutive map layers with a single read, or the window of
+ * each layer in POINT mode (see Read2DMatrix())
+ * 
+ * @param FileName name of file to read
+ * @param Matrix  @e local contiguous 3D array (NLayers, NY, NX) to be filled
+ * @param NumberType 
+ * @param NDataSet first layer to read
+ * @param NLayers number of layers to read
+ * @param VarName 
+ * @param index time index of the first layer
+ * 
+ * @return result of the format specific read
+ */
+int 
+Read3DMatrix(char *FileName, void *Matrix, int NumberType, MAPSIZE *Map,
+             int NDataSet, int NLayers, char *VarName, int index)
+{
+  int result;
+  int Layer;
+  double Span = TRACE_BEGIN();
+
+  LOCK_IO();
+  if (Map->FileNY > 0) {
+    for (Layer = 0, result = 0; Layer < NLayers; Layer++)
+      result += Read2DWindowFmt(FileName, (char *) Matrix + (size_t) Layer *
+                                Map->NY * Map->NX * SizeOfNumberType(NumberType),
+                                NumberType, Map->FileNY, Map->FileNX,
+                                NDataSet + Layer, Map->WinY, Map->WinX,
+                                Map->NY, Map->NX, VarName, index + Layer);
+  }
+  else
+    result = Read3DMatrixFmt(FileName, Matrix, NumberType, Map->NY, Map->NX,
+                             NDataSet, NLayers, VarName, index);
+  UNLOCK_IO();
+  TraceEnd(Span, "Read3DMatrix", "io", FileName,
+           (double) SizeOfNumberType(NumberType) * NLayers * Map->NY * Map->NX);
+  return result;
+}
+
+/******************************************************************************/
+/*                              Read2DWindow                                  */
+/******************************************************************************/
+/** 
+ * Read only the window (Map->WinY, Map->WinX, Map->WinNY, Map->WinNX) of a
+ * map
+ * 
+ * @param FileName name of file to read
+ * @param Matrix  @e local 2D array (WinNY, WinNX) to be filled
+ * @param NumberType 
+ * @param NDataSet 
+ * @param VarName 
+ * @param index 
+ * 
+ * @return result of the format specific read
+ */
+int 
+Read2DWindow(char *FileName, void *Matrix, int NumberType, MAPSIZE *Map,
+             int NDataSet, char *VarName, int index)
+{
+  int result;
+  double Span = TRACE_BEGIN();
+
+  LOCK_IO();
+  result = Read2DWindowFmt(FileName, Matrix, NumberType, Map->NY, Map->NX,
+                           NDataSet, Map->WinY, Map->WinX, Map->WinNY,
+                           Map->WinNX, VarName, index);
+  UNLOCK_IO();
+  TraceEnd(Span, "Read2DWindow", "io", FileName,
+           (double) SizeOfNumberType(NumberType) * Map->WinNY * Map->WinNX);
+  return result;
 }
 
 /******************************************************************************/
@@ -167,7 +789,261 @@ Write2DMatrix(char *FileName, void *Matrix, int NumberType, MAPSIZE *Map,
 {
   const char Routine[] = "Write2DMatrix";
   int result;
-  result = Write2DMatrixFmt(FileName, Matrix, NumberType, 
-                            Map->NY, Map->NX, DMap, index);
+  int NY;
+  int NX;
+  double Span = TRACE_BEGIN();
+#ifdef HAVE_PTHREAD
+  WRITEJOB *Job;
+  size_t Size;
+#endif
+
+  if (Gather) {
+    Matrix = GatherMatrix(Matrix, NumberType, Map, FALSE);
+    NY = 1;
+    NX = Map->NumActive;
+  }
+  else {
+    NY = Map->NY;
+    NX = Map->NX;
+  }
+
+#ifdef HAVE_PTHREAD
+
+  /* the caller may reuse Matrix as soon as this returns, so the writer 
+     thread gets a copy */
+  if (Async) {
+    Job = NextJob();
+    Size = SizeOfNumberType(NumberType) * NY * NX;
+    if (Size > Job->BufferSize) {
+      TaggedFree(Job->Buffer);
+      if (!(Job->Buffer = TaggedMalloc(Size, MEM_OUTPUT)))
+	ReportError((char *) Routine, 1);
+      Job->BufferSize = Size;
+    }
+    memcpy(Job->Buffer, Matrix, Size);
+    Job->Type = WRITE_JOB;
+    strncpy(Job->FileName, FileName, BUFSIZE);
+    Job->Map = *Map;
+    Job->DMap = *DMap;
+    Job->NumberType = NumberType;
+    Job->NY = NY;
+    Job->NX = NX;
+    Job->Index = index;
+    SubmitJob();
+    TraceEnd(Span, "queue Write2DMatrix", "io", FileName, (double) Size);
+    return NY * NX;
+  }
+#endif
+  result = Write2DMatrixFmt(FileName, Matrix, NumberType, NY, NX, DMap, 
+                            index);
+  TraceEnd(Span, Routine, "io", FileName,
+           (double) SizeOfNumberType(NumberType) * NY * NX);
   return result;
 }
+
+/*******************************************************************************
+  Function name: GatherMatrix()
+
+  Purpose      : Copy the cells in the basin between a map and GatherArray
+
+  Required     : 
+    void *Matrix   - map [NY][NX], NULL to only allocate GatherArray
+    int NumberType - number type of the map
+    MAPSIZE *Map   - Map->ActiveCells gives the cells in the basin
+    int Scatter    - if FALSE the cells of Matrix are copied to GatherArray,
+                     if TRUE GatherArray is copied to the cells of Matrix
+
+  Returns      : GatherArray
+
+  Modifies     : GatherArray or Matrix
+
+  Comments     : GatherArray only grows, and is only used on the main thread
+*******************************************************************************/
+static void *GatherMatrix(void *Matrix, int NumberType, MAPSIZE *Map,
+			  int Scatter)
+{
+  const char *Routine = "GatherMatrix";
+  size_t ElemSize;
+  size_t Size;
+  char *Cell;
+  char *Vector;
+  int i;
+
+  ElemSize = SizeOfNumberType(NumberType);
+  Size = ElemSize * Map->NumActive;
+  if (Size > GatherSize) {
+    TaggedFree(GatherArray);
+    if (!(GatherArray = TaggedMalloc(Size, MEM_OUTPUT)))
+      ReportError((char *) Routine, 1);
+    GatherSize = Size;
+  }
+  if (Matrix == NULL)
+    return GatherArray;
+
+  Vector = (char *) GatherArray;
+  for (i = 0; i < Map->NumActive; i++) {
+    Cell = (char *) Matrix + ElemSize *
+      ((size_t) Map->ActiveCells[ROWCELL(Map, i)].y * Map->NX +
+       Map->ActiveCells[ROWCELL(Map, i)].x);
+    if (Scatter)
+      memcpy(Cell, Vector + i * ElemSize, ElemSize);
+    else
+      memcpy(Vector + i * ElemSize, Cell, ElemSize);
+  }
+
+  return GatherArray;
+}
+
+/*******************************************************************************
+  Function name: IsGathered()
+
+  Purpose      : TRUE if dataset NDataSet of a map file holds the cells in the
+                 basin only, as written with BASIN ONLY OUTPUT, FALSE if it
+                 holds the whole grid
+
+  Comments     : NetCDF files and Zarr stores have a cell dimension, and the
+                 index of a BINZ file has the size of each dataset.  The size
+                 of a BIN file is a whole number of vectors of the cells, or of
+                 maps of the grid.  A file of either size is taken to hold
+                 vectors, the layout of the option, and one of neither is
+                 left to fail in the read
+*******************************************************************************/
+static int IsGathered(char *FileName, int NumberType, MAPSIZE *Map,
+                      int NDataSet)
+{
+  size_t Size = SizeOfNumberType(NumberType);
+  size_t Cells = Size * Map->NumActive;
+  size_t Grid = Size * Map->NY * Map->NX;
+  size_t Bytes;
+  struct stat Info;
+
+#ifdef HAVE_NETCDF
+  if (Format == NETCDF)
+    return IsGatheredNetCDF(FileName);
+#endif
+  if (Format == ZARR && IsStoreZarr(FileName))
+    return IsGatheredZarr(FileName);
+#ifdef HAVE_ZLIB
+  if (Format == BINZ && (Bytes = DataSetSizeBinZ(FileName, NDataSet)) > 0)
+    return Bytes == Cells;
+#endif
+
+  if (Cells == Grid || stat(FileName, &Info) != 0)
+    return TRUE;
+  return !((size_t) Info.st_size % Grid == 0 &&
+           (size_t) Info.st_size % Cells != 0);
+}
+
+/*******************************************************************************
+  Function name: IsBlock()
+
+  Purpose      : Whether the field of a MAPFIELD is a map of NY rows of NX
+                 values one after the other
+
+  Returns      : TRUE or FALSE
+*******************************************************************************/
+static int IsBlock(MAPFIELD *Field, MAPSIZE *Map)
+{
+  size_t RowSize;
+  int y;
+
+  RowSize = Field->CellSize * Map->NX;
+  for (y = 1; y < Map->NY; y++)
+    if ((char *) Field->Rows[y] != (char *) Field->Rows[0] + y * RowSize)
+      return FALSE;
+  return TRUE;
+}
+
+/*******************************************************************************
+  Function name: ReverseRows()
+
+  Purpose      : Reverse the order of the NY rows of RowSize bytes of Matrix
+                 in place
+
+  Modifies     : Matrix
+*******************************************************************************/
+static void ReverseRows(void *Matrix, size_t RowSize, int NY)
+{
+  const char *Routine = "ReverseRows";
+  char *Row;
+  char *Top;
+  char *Bottom;
+  int y;
+
+  if (!(Row = (char *) malloc(RowSize)))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < NY / 2; y++) {
+    Top = (char *) Matrix + y * RowSize;
+    Bottom = (char *) Matrix + (NY - 1 - y) * RowSize;
+    memcpy(Row, Top, RowSize);
+    memcpy(Top, Bottom, RowSize);
+    memcpy(Bottom, Row, RowSize);
+  }
+  free(Row);
+}
+
+/*******************************************************************************
+  Function name: CopyValue()
+
+  Purpose      : Copy a value of number type FromType to a value of number
+                 type ToType
+
+  Comments     : A value of the same type is copied as it is, NC_BYTE is
+                 unsigned, as in the readers
+*******************************************************************************/
+static void CopyValue(void *To, int ToType, void *From, int FromType)
+{
+  const char *Routine = "CopyValue";
+  double Value = 0.0;
+
+  if (ToType == FromType) {
+    memcpy(To, From, SizeOfNumberType(FromType));
+    return;
+  }
+
+  switch (FromType) {
+  case NC_BYTE:
+    Value = *((unsigned char *) From);
+    break;
+  case NC_CHAR:
+    Value = *((char *) From);
+    break;
+  case NC_SHORT:
+    Value = *((short *) From);
+    break;
+  case NC_INT:
+    Value = *((int *) From);
+    break;
+  case NC_FLOAT:
+    Value = *((float *) From);
+    break;
+  case NC_DOUBLE:
+    Value = *((double *) From);
+    break;
+  default:
+    ReportError((char *) Routine, 40);
+  }
+
+  switch (ToType) {
+  case NC_BYTE:
+    *((unsigned char *) To) = (unsigned char) Value;
+    break;
+  case NC_CHAR:
+    *((char *) To) = (char) Value;
+    break;
+  case NC_SHORT:
+    *((short *) To) = (short) Value;
+    break;
+  case NC_INT:
+    *((int *) To) = (int) Value;
+    break;
+  case NC_FLOAT:
+    *((float *) To) = (float) Value;
+    break;
+  case NC_DOUBLE:
+    *((double *) To) = Value;
+    break;
+  default:
+    ReportError((char *) Routine, 40);
+  }
+}
@@ -0,0 +1,424 @@
+/*
+ * SUMMARY:      InitHRU.c - Hydrologic response units
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Groups the active cells that have the same vegetation and
+ *               soil type and fall in the same elevation, soil depth, slope,
+ *               aspect and sky view classes, with the same shading and met
+ *               interpolation weights, into hydrologic response units
+ *               (OPTIONS HRU MODE).  The vertical physics is only run for
+ *               one cell of each unit, and its results are copied to the
+ *               other cells of the unit before the lateral routing
+ * DESCRIP-END.
+ * FUNCTIONS:    InitHRU()
+ *               PrepareHRURep()
+ *               FinishHRURep()
+ *               BroadcastHRU()
+ * COMMENTS:     The representative of a unit is its first cell in row-major
+ *               order.  The other cells (members) get its met, snow,
+ *               interception, radiation and evaporation results, and the
+ *               change in soil moisture and surface water of the
+ *               representative over the time step.  The lateral inflow of
+ *               each member is still added to its own soil column, so the
+ *               soil moisture and water table keep their spatial pattern.
+ *               Cells with a stream or road channel are never grouped, and
+ *               neither is the last active cell, whose met conditions are
+ *               used for the channel routing.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "constants.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "DHSVMChannel.h"
+#include "functions.h"
+#include "memaccount.h"
+#include "massenergy.h"
+#include "soilmoisture.h"
+
+/* class numbers that define a unit, followed by the met weights */
+enum HRUCLASS {
+  hru_veg = 0, hru_soil, hru_elev, hru_depth, hru_slope, hru_aspect,
+  hru_skyview, hru_nweights, NHRUCLASS
+};
+
+typedef struct {
+  int k;			/* active cell */
+  int Class[NHRUCLASS];
+} HRUKEY;
+
+/* data used by CompareHRUKeys() */
+static MAPSIZE *KeyMap;
+static METWEIGHT **KeyWeights;
+static unsigned char ***KeyShadow;
+static int KeyNDaySteps;
+static float KeyWeightTol;
+
+/*****************************************************************************
+  ClassOf()
+
+  Class number of Value for classes of width Width, 0 if Width is 0
+  (all values in one class).  Values closer together than Width can still
+  fall in neighbouring classes.
+*****************************************************************************/
+static int ClassOf(float Value, float Width)
+{
+  if (Width <= 0.0)
+    return 0;
+  return (int) floor(Value / Width);
+}
+
+/*****************************************************************************
+  CompareHRUKeys()
+
+  qsort() comparison of two HRUKEYs: by class, then by met weights and
+  shading, and then by cell, so that the first cell of a unit is the one
+  that comes first in row-major order
+*****************************************************************************/
+static int CompareHRUKeys(const void *A, const void *B)
+{
+  const HRUKEY *KeyA = (const HRUKEY *) A;
+  const HRUKEY *KeyB = (const HRUKEY *) B;
+  METWEIGHT *WeightA;
+  METWEIGHT *WeightB;
+  int ya, xa, yb, xb;
+  int ClassA;
+  int ClassB;
+  int i;
+
+  for (i = 0; i < NHRUCLASS; i++)
+    if (KeyA->Class[i] != KeyB->Class[i])
+      return (KeyA->Class[i] < KeyB->Class[i]) ? -1 : 1;
+
+  ya = KeyMap->ActiveCells[KeyA->k].y;
+  xa = KeyMap->ActiveCells[KeyA->k].x;
+  yb = KeyMap->ActiveCells[KeyB->k].y;
+  xb = KeyMap->ActiveCells[KeyB->k].x;
+
+  WeightA = &(KeyWeights[ya][xa]);
+  WeightB = &(KeyWeights[yb][xb]);
+  for (i = 0; i < WeightA->NWeights; i++) {
+    if (WeightA->Stat[i] != WeightB->Stat[i])
+      return (WeightA->Stat[i] < WeightB->Stat[i]) ? -1 : 1;
+    ClassA = (KeyWeightTol > 0.0) ?
+      (int) floor(WeightA->Weight[i] / KeyWeightTol + 0.5) : 0;
+    ClassB = (KeyWeightTol > 0.0) ?
+      (int) floor(WeightB->Weight[i] / KeyWeightTol + 0.5) : 0;
+    if (KeyWeightTol <= 0.0 && WeightA->Weight[i] != WeightB->Weight[i])
+      return (WeightA->Weight[i] < WeightB->Weight[i]) ? -1 : 1;
+    if (ClassA != ClassB)
+      return (ClassA < ClassB) ? -1 : 1;
+  }
+
+  if (KeyShadow != NULL) {
+    for (i = 0; i < KeyNDaySteps; i++)
+      if (KeyShadow[i][ya][xa] != KeyShadow[i][yb][xb])
+	return (KeyShadow[i][ya][xa] < KeyShadow[i][yb][xb]) ? -1 : 1;
+  }
+
+  if (ya != yb)
+    return (ya < yb) ? -1 : 1;
+  return (xa < xb) ? -1 : (xa > xb);
+}
+
+/*****************************************************************************
+  InitHRU()
+
+  Group the active cells into units (see the file header).  With
+  Options->Shading the cells of a unit have the same shadow series, so this
+  is run again when InitNewMonth() reads the shading maps of a new month.
+  Does nothing unless OPTIONS HRU MODE is TRUE.
+*****************************************************************************/
+void InitHRU(OPTIONSTRUCT *Options, MAPSIZE *Map, LAYER *Soil,
+	     TOPOPIX **TopoMap, SOILPIX **SoilMap, VEGPIX **VegMap,
+	     ROADSTRUCT **Network, CHANNEL *ChannelData, STATICMAP *SkyViewMap,
+	     unsigned char ***ShadowMap, int NDaySteps, METWEIGHT **MetWeights,
+	     HRUSTRUCT *HRU)
+{
+  const char *Routine = "InitHRU";
+  HRUKEY *Keys;
+  int NKeys;
+  int First;			/* first key of the current unit */
+  int NSlots;			/* representatives with members */
+  int i;
+  int k;
+  int x;
+  int y;
+
+  HRU->Active = Options->HRU;
+  if (!HRU->Active)
+    return;
+
+  TaggedFree(HRU->Rep);
+  TaggedFree(HRU->Member);
+  TaggedFree(HRU->RepOf);
+  TaggedFree(HRU->Slot);
+  TaggedFree(HRU->Delta);
+  TaggedFree(HRU->SatFlow);
+
+  if (!(Keys = (HRUKEY *) calloc(Map->NumActive, sizeof(HRUKEY))) ||
+      !(HRU->Rep = (int *) TaggedCalloc(Map->NumActive, sizeof(int),
+					MEM_HRU)) ||
+      !(HRU->Member = (int *) TaggedCalloc(Map->NumActive, sizeof(int),
+					   MEM_HRU)) ||
+      !(HRU->RepOf = (int *) TaggedCalloc(Map->NumActive, sizeof(int),
+					  MEM_HRU)) ||
+      !(HRU->Slot = (int *) TaggedCalloc(Map->NumActive, sizeof(int), MEM_HRU)))
+    ReportError((char *)Routine, 1);
+
+  /* the cells that can be grouped, the others are their own unit */
+  NKeys = 0;
+  HRU->NReps = 0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    HRU->Slot[k] = -1;
+    if (k == Map->NumActive - 1 ||
+	channel_grid_has_channel(ChannelData->stream_map, x, y) ||
+	channel_grid_has_channel(ChannelData->road_map, x, y) ||
+	Network[y][x].Area > 0.0 || Network[y][x].RoadArea > 0.0) {
+      HRU->Rep[HRU->NReps++] = k;
+      continue;
+    }
+    Keys[NKeys].k = k;
+    Keys[NKeys].Class[hru_veg] = VegMap[y][x].Veg;
+    Keys[NKeys].Class[hru_soil] = SoilMap[y][x].Soil;
+    Keys[NKeys].Class[hru_elev] = ClassOf(TopoMap[y][x].Dem,
+					  Options->HRUElevBand);
+    Keys[NKeys].Class[hru_depth] = ClassOf(SoilMap[y][x].Depth,
+					   Options->HRUDepthClass);
+    Keys[NKeys].Class[hru_slope] =
+      ClassOf(atan(TopoMap[y][x].Slope) * DEGPRAD, Options->HRUSlopeClass);
+    /* the aspect classes are centred on the direction where the aspect
+       wraps around, so that the cells on both sides of it share a class */
+    Keys[NKeys].Class[hru_aspect] =
+      ClassOf(TopoMap[y][x].Aspect * DEGPRAD + 180.0 +
+	      0.5 * Options->HRUAspectClass, Options->HRUAspectClass);
+    if (Options->HRUAspectClass > 0.0 &&
+	Keys[NKeys].Class[hru_aspect] * Options->HRUAspectClass >= 360.0)
+      Keys[NKeys].Class[hru_aspect] = 0;
+    Keys[NKeys].Class[hru_skyview] = (Options->Shading) ?
+      ClassOf(StaticMapValue(SkyViewMap, k), Options->HRUSkyViewClass) : 0;
+    Keys[NKeys].Class[hru_nweights] = MetWeights[y][x].NWeights;
+    NKeys++;
+  }
+
+  KeyMap = Map;
+  KeyWeights = MetWeights;
+  KeyShadow = (Options->Shading) ? ShadowMap : NULL;
+  KeyNDaySteps = NDaySteps;
+  KeyWeightTol = Options->HRUWeightTol;
+  qsort(Keys, NKeys, sizeof(HRUKEY), CompareHRUKeys);
+
+  /* the first cell of each run of equal keys represents the others */
+  HRU->NMembers = 0;
+  NSlots = 0;
+  for (First = 0, i = 0; i < NKeys; i++) {
+    if (i > 0) {
+      /* CompareHRUKeys() only ties on the cell, so compare without it */
+      k = Keys[i].k;
+      Keys[i].k = Keys[First].k;
+      if (CompareHRUKeys(&(Keys[First]), &(Keys[i])) != 0)
+	First = i;
+      Keys[i].k = k;
+    }
+    if (First == i)
+      HRU->Rep[HRU->NReps++] = Keys[i].k;
+    else {
+      if (HRU->Slot[Keys[First].k] < 0)
+	HRU->Slot[Keys[First].k] = NSlots++;
+      HRU->Member[HRU->NMembers] = Keys[i].k;
+      HRU->RepOf[HRU->NMembers] = Keys[First].k;
+      HRU->NMembers++;
+    }
+  }
+  free(Keys);
+
+  /* soil moisture in each layer and surface water of each representative */
+  HRU->Stride = Soil->MaxLayers + 2;
+  if (!(HRU->Delta = (float *) TaggedCalloc(NSlots * HRU->Stride + 1,
+				      sizeof(float), MEM_HRU)) ||
+      !(HRU->SatFlow = (float *) TaggedCalloc(NSlots + 1, sizeof(float),
+					      MEM_HRU)))
+    ReportError((char *)Routine, 1);
+
+  printf("%d active cells in %d response units, %d cells share the "
+	 "vertical physics of another cell\n", Map->NumActive, HRU->NReps,
+	 HRU->NMembers);
+}
+
+/*****************************************************************************
+  PrepareHRURep()
+
+  Before MassEnergyBalance() for representative k: add the lateral inflow
+  of the last routing step (SatFlow) to the soil column, and store the soil
+  moisture and surface water, so that FinishHRURep() can find the change
+  that the vertical physics alone made.  SatFlow is set to 0 for
+  MassEnergyBalance(), which would otherwise add it a second time.
+*****************************************************************************/
+void PrepareHRURep(HRUSTRUCT *HRU, int k, int Dt, MAPSIZE *Map,
+		   SOILPIX *LocalSoil, SOILTABLE *SType, VEGTABLE *VType,
+		   ROADSTRUCT *LocalNetwork, int InfiltOption)
+{
+  float *Saved;
+  int i;
+
+  if (!HRU->Active || HRU->Slot[k] < 0)
+    return;
+
+  DistributeSatflow(Dt, Map->DX, Map->DY, LocalSoil->SatFlow, SType->NLayers,
+		    LocalSoil->Depth, LocalNetwork->Area, VType->RootDepth,
+		    SType->Ks, SType->PoreDist, SType->Porosity, SType->FCap,
+		    LocalSoil->Perc, LocalNetwork->PercArea,
+		    LocalNetwork->Adjust, LocalNetwork->CutBankZone,
+		    LocalNetwork->BankHeight, &(LocalSoil->TableDepth),
+		    &(LocalSoil->IExcess), LocalSoil->Moist, InfiltOption);
+  HRU->SatFlow[HRU->Slot[k]] = LocalSoil->SatFlow;
+  LocalSoil->SatFlow = 0.0;
+
+  Saved = HRU->Delta + HRU->Slot[k] * HRU->Stride;
+  for (i = 0; i <= SType->NLayers; i++)
+    Saved[i] = LocalSoil->Moist[i];
+  Saved[HRU->Stride - 1] = LocalSoil->IExcess;
+}
+
+/*****************************************************************************
+  FinishHRURep()
+
+  After MassEnergyBalance() for representative k: turn the values stored
+  by PrepareHRURep() into the change over the time step, and put SatFlow
+  back for the mass balance
+*****************************************************************************/
+void FinishHRURep(HRUSTRUCT *HRU, int k, SOILPIX *LocalSoil, int NSoilLayers)
+{
+  float *Delta;
+  int i;
+
+  if (!HRU->Active || HRU->Slot[k] < 0)
+    return;
+
+  Delta = HRU->Delta + HRU->Slot[k] * HRU->Stride;
+  for (i = 0; i <= NSoilLayers; i++)
+    Delta[i] = LocalSoil->Moist[i] - Delta[i];
+  Delta[HRU->Stride - 1] = LocalSoil->IExcess - Delta[HRU->Stride - 1];
+  LocalSoil->SatFlow = HRU->SatFlow[HRU->Slot[k]];
+}
+
+/*****************************************************************************
+  BroadcastHRU()
+
+  Give member m of the HRU->Member list the results of its representative
+  (see the file header).  The member's radiation is added to TotalRad, if
+  it is not NULL, as MassEnergyBalance() does for the cells it runs for.
+*****************************************************************************/
+void BroadcastHRU(HRUSTRUCT *HRU, int m, MAPSIZE *Map, int Dt,
+		  int InfiltOption, LAYER *Soil, LAYER *Veg, SOILTABLE *SType,
+		  VEGTABLE *VType, PRECIPPIX **PrecipMap, SNOWPIX **SnowMap,
+		  SOILPIX **SoilMap, VEGPIX **VegMap, PIXRAD **RadiationMap,
+		  EVAPPIX **EvapMap, ROADSTRUCT **Network, PIXRAD *TotalRad)
+{
+  PRECIPPIX *Precip;
+  PRECIPPIX *RepPrecip;
+  SOILPIX *Local;
+  SOILPIX *Rep;
+  EVAPPIX *Evap;
+  EVAPPIX *RepEvap;
+  SOILTABLE *LocalSType;
+  VEGTABLE *LocalVType;
+  ROADSTRUCT *LocalNetwork;
+  float *Delta;
+  float *IntRain;
+  float *IntSnow;
+  float SumPrecip;
+  int NVeg;
+  int NSoil;
+  int i;
+  int x, y, rx, ry;
+
+  y = Map->ActiveCells[HRU->Member[m]].y;
+  x = Map->ActiveCells[HRU->Member[m]].x;
+  ry = Map->ActiveCells[HRU->RepOf[m]].y;
+  rx = Map->ActiveCells[HRU->RepOf[m]].x;
+  NVeg = Veg->NLayers[VegMap[y][x].Veg - 1];
+  NSoil = Soil->NLayers[SoilMap[y][x].Soil - 1];
+  LocalSType = &(SType[SoilMap[y][x].Soil - 1]);
+  LocalVType = &(VType[VegMap[y][x].Veg - 1]);
+  LocalNetwork = &(Network[y][x]);
+
+  /* precipitation and interception */
+  Precip = &(PrecipMap[y][x]);
+  RepPrecip = &(PrecipMap[ry][rx]);
+  IntRain = Precip->IntRain;
+  IntSnow = Precip->IntSnow;
+  SumPrecip = Precip->SumPrecip;
+  *Precip = *RepPrecip;
+  Precip->IntRain = IntRain;
+  Precip->IntSnow = IntSnow;
+  Precip->SumPrecip = SumPrecip + Precip->Precip;
+  memcpy(IntRain, RepPrecip->IntRain, NVeg * sizeof(float));
+  memcpy(IntSnow, RepPrecip->IntSnow, NVeg * sizeof(float));
+
+  SnowMap[y][x] = SnowMap[ry][rx];
+  VegMap[y][x].Tcanopy = VegMap[ry][rx].Tcanopy;
+  RadiationMap[y][x] = RadiationMap[ry][rx];
+
+  Evap = &(EvapMap[y][x]);
+  RepEvap = &(EvapMap[ry][rx]);
+  Evap->ETot = RepEvap->ETot;
+  Evap->EvapSoil = RepEvap->EvapSoil;
+  memcpy(Evap->EPot, RepEvap->EPot, (NVeg + 1) * sizeof(float));
+  memcpy(Evap->EAct, RepEvap->EAct, (NVeg + 1) * sizeof(float));
+  memcpy(Evap->EInt, RepEvap->EInt, NVeg * sizeof(float));
+  for (i = 0; i < NVeg; i++)
+    memcpy(Evap->ESoil[i], RepEvap->ESoil[i], NSoil * sizeof(float));
+
+  /* soil energy balance */
+  Local = &(SoilMap[y][x]);
+  Rep = &(SoilMap[ry][rx]);
+  memcpy(Local->Temp, Rep->Temp, NSoil * sizeof(float));
+  memcpy(Local->Perc, Rep->Perc, NSoil * sizeof(float));
+  Local->TSurf = Rep->TSurf;
+  Local->Qnet = Rep->Qnet;
+  Local->Qrest = Rep->Qrest;
+  Local->Qs = Rep->Qs;
+  Local->Qe = Rep->Qe;
+  Local->Qg = Rep->Qg;
+  Local->Qst = Rep->Qst;
+  Local->Ra = Rep->Ra;
+  Local->TSurfIter = Rep->TSurfIter;
+  Local->InfiltAcc = Rep->InfiltAcc;
+  Local->MoistInit = Rep->MoistInit;
+  Local->DetentionStorage = Rep->DetentionStorage;
+  Local->DetentionIn = Rep->DetentionIn;
+  Local->DetentionOut = Rep->DetentionOut;
+
+  /* soil water: the member's own lateral inflow, then the vertical change
+     of the representative */
+  DistributeSatflow(Dt, Map->DX, Map->DY, Local->SatFlow, NSoil,
+		    Local->Depth, LocalNetwork->Area, LocalVType->RootDepth,
+		    LocalSType->Ks, LocalSType->PoreDist, LocalSType->Porosity,
+		    LocalSType->FCap, Local->Perc, LocalNetwork->PercArea,
+		    LocalNetwork->Adjust, LocalNetwork->CutBankZone,
+		    LocalNetwork->BankHeight, &(Local->TableDepth),
+		    &(Local->IExcess), Local->Moist, InfiltOption);
+  Delta = HRU->Delta + HRU->Slot[HRU->RepOf[m]] * HRU->Stride;
+  for (i = 0; i <= NSoil; i++)
+    Local->Moist[i] = MAX(Local->Moist[i] + Delta[i], 0.0);
+  Local->IExcess = MAX(Local->IExcess + Delta[HRU->Stride - 1], 0.0);
+  Local->TableDepth = WaterTableDepth(NSoil, Local->Depth,
+				      LocalVType->RootDepth,
+				      LocalSType->Porosity, LocalSType->FCap,
+				      LocalNetwork->Adjust, Local->Moist,
+				      &(LocalNetwork->Capacity));
+
+  if (TotalRad != NULL)
+    AggregateRadiation(Veg->MaxLayers, LocalVType->NVegLayers,
+		       &(RadiationMap[y][x]), TotalRad);
+}
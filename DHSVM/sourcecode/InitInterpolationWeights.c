@@ -9,6 +9,7 @@
  * DESCRIPTION:  Initialize the interpolation weights
  * DESCRIP-END.
  * FUNCTIONS:    InitInterpolationWeights()
+ *               InitMetNodes()
  * COMMENTS:
  * $Id: InitInterpolationWeights.c,v 1.5 2003/10/28 20:02:43 colleen Exp $
  */
@@ -19,13 +20,14 @@
 #include "data.h"
 #include "DHSVMerror.h"
 #include "functions.h"
+#include "memaccount.h"
 #include "constants.h"
 
  /*****************************************************************************
    InitInterpolationWeights()
  *****************************************************************************/
 void InitInterpolationWeights(MAPSIZE *Map, OPTIONSTRUCT *Options,
-  TOPOPIX **TopoMap, uchar ****MetWeights, METLOCATION *Stats, int NStats)
+  TOPOPIX **TopoMap, METWEIGHT ***MetWeights, METLOCATION *Stats, int NStats)
 {
   const char *Routine = "InitInterpolationWeights";
   uchar **BasinMask;
@@ -38,16 +40,23 @@ void InitInterpolationWeights(MAPSIZE *Map, OPTIONSTRUCT *Options,
       Stats[i].Elev = TopoMap[Stats[i].Loc.N][Stats[i].Loc.E].Dem;
 
   if (Options->MM5 == TRUE && Options->QPF == FALSE) {
-    if (!((*MetWeights) = (uchar ***)calloc(Map->NY, sizeof(uchar **))))
+    if (!((*MetWeights) = (METWEIGHT **)TaggedCalloc(Map->NY,
+						     sizeof(METWEIGHT *), MEM_MET)))
       ReportError("CalcWeights()", 1);
 
     for (y = 0; y < Map->NY; y++)
-      if (!((*MetWeights)[y] = (uchar **)calloc(Map->NX, sizeof(uchar *))))
+      if (!((*MetWeights)[y] = (METWEIGHT *)TaggedCalloc(Map->NX,
+							 sizeof(METWEIGHT), MEM_MET)))
         ReportError("CalcWeights()", 1);
 
     for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++)
-        (*MetWeights)[y][x] = NULL;
+      for (x = 0; x < Map->NX; x++) {
+        (*MetWeights)[y][x].NWeights = 0;
+        (*MetWeights)[y][x].Stat = NULL;
+        (*MetWeights)[y][x].Weight = NULL;
+        (*MetWeights)[y][x].TOffset = NULL;
+        (*MetWeights)[y][x].PFactor = NULL;
+      }
   }
   else {
     if (!(BasinMask = (uchar **)calloc(Map->NY, sizeof(uchar *))))
@@ -61,14 +70,15 @@ void InitInterpolationWeights(MAPSIZE *Map, OPTIONSTRUCT *Options,
       for (x = 0; x < Map->NX; x++)
         BasinMask[y][x] = TopoMap[y][x].Mask;
 
-    CalcWeights(Stats, NStats, Map->NX, Map->NY, BasinMask, MetWeights,
-      Options);
+    /* with a STATIC DATA SHARE the weights of other runs are used */
+    if (!SharedWeights(Map, MetWeights))
+      CalcWeights(Stats, NStats, Map->NX, Map->NY, 1, BasinMask, MetWeights,
+        Options);
 
     printf("\nSummary info on met stations used for current model run \n");
     printf("        Name\t\tY\tX\tIn Mask\tDefined Elev\tActual Elev\n");
     for (i = 0; i < NStats; i++) {
-      if ((Stats[i].Loc.N > Map->NY || Stats[i].Loc.N < 0 ||
-        Stats[i].Loc.E > Map->NX || Stats[i].Loc.E < 0))
+      if (!InArea(Map, &(Stats[i].Loc)))
         printf("%20s\t%d\t%d\t%5s\t%5.1f\t\t%5s\n",
           Stats[i].Name, Stats[i].Loc.N, Stats[i].Loc.E,
           "NA", Stats[i].Elev, "NA");
@@ -86,3 +96,105 @@ void InitInterpolationWeights(MAPSIZE *Map, OPTIONSTRUCT *Options,
     free(BasinMask);
   }
 }
+
+/*****************************************************************************
+  InitMetNodes()
+
+  Set up the coarse met grid of OPTIONS MET GRID SPACING.  The nodes are
+  every Step cells, starting at cell (0, 0), with one more row and column
+  past the end of the grid, so that every cell lies in a square of four
+  nodes.  MakeMetFields() interpolates the stations to the nodes only and
+  gives each cell the bilinear interpolation of the four nodes around it,
+  with the temperature and precipitation moved from each node elevation to
+  the cell elevation with the lapse rate of that node.
+
+  The elevation of a node is the mean of the cells that use it, weighted
+  with their bilinear weights, and only the nodes that are used get station
+  weights.  The station (not the cell) precipitation is only downscaled if
+  it is lapsed with the station lapse rates (Options->PrecipLapse is not
+  MAP and there is no PRISM).
+*****************************************************************************/
+void InitMetNodes(MAPSIZE *Map, OPTIONSTRUCT *Options, TOPOPIX **TopoMap,
+		  METLOCATION *Stats, int NStats, METFIELDS *MetFields)
+{
+  const char *Routine = "InitMetNodes";
+  uchar **NodeMask;
+  float *Block;
+  float *SumWeight;
+  float Weight[4];
+  int Node[4];
+  int NNodes;
+  int NUsed;
+  int Step;
+  int i;
+  int k;
+  int x;
+  int y;
+
+  Step = Options->MetGridSpacing;
+  MetFields->Step = Step;
+  if (Step <= 1)
+    return;
+
+  MetFields->NodeNY = (Map->NY - 1) / Step + 2;
+  MetFields->NodeNX = (Map->NX - 1) / Step + 2;
+  NNodes = MetFields->NodeNY * MetFields->NodeNX;
+  if (!(Block = (float *)TaggedCalloc(11 * NNodes, sizeof(float), MEM_MET)) ||
+      !(SumWeight = (float *)calloc(NNodes, sizeof(float))))
+    ReportError((char *)Routine, 1);
+  MetFields->NodeElev = Block;
+  MetFields->NodeTair = Block + NNodes;
+  MetFields->NodeTLapse = Block + 2 * NNodes;
+  MetFields->NodeRh = Block + 3 * NNodes;
+  MetFields->NodeWind = Block + 4 * NNodes;
+  MetFields->NodeSin = Block + 5 * NNodes;
+  MetFields->NodeSinBeam = Block + 6 * NNodes;
+  MetFields->NodeSinDiffuse = Block + 7 * NNodes;
+  MetFields->NodeLin = Block + 8 * NNodes;
+  MetFields->NodePrecip = Block + 9 * NNodes;
+  MetFields->NodePLapse = Block + 10 * NNodes;
+
+  /* node elevations */
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    MetNodeWeights(MetFields, y, x, Node, Weight);
+    for (i = 0; i < 4; i++) {
+      SumWeight[Node[i]] += Weight[i];
+      MetFields->NodeElev[Node[i]] += Weight[i] * TopoMap[y][x].Dem;
+    }
+  }
+
+  if (!(NodeMask = (uchar **)calloc(MetFields->NodeNY, sizeof(uchar *))))
+    ReportError((char *)Routine, 1);
+  for (y = 0, NUsed = 0; y < MetFields->NodeNY; y++) {
+    if (!(NodeMask[y] = (uchar *)calloc(MetFields->NodeNX, sizeof(uchar))))
+      ReportError((char *)Routine, 1);
+    for (x = 0; x < MetFields->NodeNX; x++) {
+      i = y * MetFields->NodeNX + x;
+      if (SumWeight[i] > 0.0) {
+	MetFields->NodeElev[i] /= SumWeight[i];
+	NodeMask[y][x] = (uchar) !OUTSIDEBASIN;
+	NUsed++;
+      }
+      else
+	NodeMask[y][x] = OUTSIDEBASIN;
+    }
+  }
+
+  printf("\nInterpolating the met to %d nodes every %d cells\n", NUsed, Step);
+  CalcWeights(Stats, NStats, MetFields->NodeNX, MetFields->NodeNY, Step,
+	      NodeMask, &(MetFields->NodeWeights), Options);
+
+  if (Options->PrecipType == STATION && Options->Prism == FALSE &&
+      Options->PrecipLapse != MAP) {
+    if (!(MetFields->Precip = (float *)TaggedCalloc(Map->NumActive,
+						    sizeof(float), MEM_MET)))
+      ReportError((char *)Routine, 1);
+  }
+
+  for (y = 0; y < MetFields->NodeNY; y++)
+    free(NodeMask[y]);
+  free(NodeMask);
+  free(SumWeight);
+}
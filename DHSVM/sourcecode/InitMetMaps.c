@@ -13,6 +13,7 @@
  *               InitPrecipMap()
  *               InitRadarMap()
  *               InitRadMap()
+ *               InitMetFields()
  * COMMENTS:
  * $Id: InitMetMaps.c,v 1.6 2006/10/03 22:50:22 nathalie Exp $
  */
@@ -20,12 +21,15 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "settings.h"
 #include "constants.h"
 #include "data.h"
 #include "DHSVMerror.h"
 #include "fileio.h"
 #include "functions.h"
+#include "getinit.h"
+#include "memaccount.h"
 #include "rad.h"
 #include "sizeofnt.h"
 #include "varid.h"
@@ -36,49 +40,42 @@
  *****************************************************************************/
 void InitMetMaps(int NDaySteps, MAPSIZE *Map, MAPSIZE *Radar,
   OPTIONSTRUCT *Options, char *WindPath, char *PrecipLapseFile,
-  float ***PrecipLapseMap, float ***PrismMap,
-  unsigned char ****ShadowMap, float ***SkyViewMap,
+  STATICMAP *PrecipLapseMap, float ***PrismMap,
+  SHADOWMAP *ShadowMap, STATICMAP *SkyViewMap,
   EVAPPIX ***EvapMap, PRECIPPIX ***PrecipMap,
-  RADARPIX ***RadarMap, PIXRAD ***RadMap,
+  float **RadarMap, PIXRAD ***RadMap,
   SOILPIX **SoilMap, LAYER *Soil, VEGPIX **VegMap,
   LAYER *Veg, TOPOPIX **TopoMap, float ****MM5Input,
-  float ****WindModel)
+  STATICMAP **WindModel)
 {
-  int y, x;
-
   printf("Initializing meteorological maps\n");
 
-  InitEvapMap(Map, EvapMap, SoilMap, Soil, VegMap, Veg, TopoMap);
+  InitEvapMap(Options, Map, EvapMap, SoilMap, Soil, VegMap, Veg, TopoMap);
   InitPrecipMap(Map, PrecipMap, VegMap, Veg, TopoMap);
 
   if (Options->MM5 == TRUE) {
     InitMM5Maps(Soil->MaxLayers, Map->NY, Map->NX, MM5Input, RadMap, Options);
     if (Options->Shading == TRUE)
-      InitShadeMap(Options, NDaySteps, Map, ShadowMap, SkyViewMap);
+      InitShadeMap(Options, NDaySteps, Map, TopoMap, ShadowMap,
+		   SkyViewMap);
   }
   else {
     if (Options->PrecipType == RADAR)
       InitRadarMap(Radar, RadarMap);
     if (Options->PrecipLapse == MAP)
-      InitPrecipLapseMap(PrecipLapseFile, Map, PrecipLapseMap);
+      InitPrecipLapseMap(PrecipLapseFile, Map, Options->StaticMapBits,
+			 PrecipLapseMap);
     if (Options->Prism == TRUE)
       InitPrismMap(Map->NY, Map->NX, PrismMap);
     if (Options->Shading == TRUE)
-      InitShadeMap(Options, NDaySteps, Map, ShadowMap, SkyViewMap);
+      InitShadeMap(Options, NDaySteps, Map, TopoMap, ShadowMap,
+		   SkyViewMap);
 
-    if (!((*SkyViewMap) = (float **)calloc(Map->NY, sizeof(float *))))
-      ReportError("InitMetMaps()", 1);
-    for (y = 0; y < Map->NY; y++) {
-      if (!((*SkyViewMap)[y] = (float *)calloc(Map->NX, sizeof(float))))
-        ReportError("InitMetMaps()", 1);
-    }
-    for (y = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++) {
-        (*SkyViewMap)[y][x] = 1.0;
-      }
-    }
+    /* without MM5 the sky view factor of all the cells is 1 */
+    FreeStaticMap(SkyViewMap);
+    InitStaticMap(Map, 0, NULL, 1.0, MEM_SHADOW, SkyViewMap);
     if (Options->WindSource == MODEL)
-      InitWindModelMaps(WindPath, Map, WindModel);
+      InitWindModelMaps(WindPath, Map, Options->StaticMapBits, WindModel);
 
     InitRadMap(Map, RadMap);
   }
@@ -89,9 +86,12 @@ void InitMetMaps(int NDaySteps, MAPSIZE *Map, MAPSIZE *Radar,
 
 /*****************************************************************************
   InitEvapMap()
+
+  With SNOW ONLY there is no evapotranspiration, and the layer arrays of
+  all the cells are the same zeros of the most layers
 *****************************************************************************/
-void InitEvapMap(MAPSIZE *Map, EVAPPIX ***EvapMap, SOILPIX **SoilMap,
-  LAYER *Soil, VEGPIX **VegMap, LAYER *Veg,
+void InitEvapMap(OPTIONSTRUCT *Options, MAPSIZE *Map, EVAPPIX ***EvapMap,
+  SOILPIX **SoilMap, LAYER *Soil, VEGPIX **VegMap, LAYER *Veg,
   TOPOPIX **TopoMap)
 {
   const char *Routine = "InitEvapMap";
@@ -100,16 +100,50 @@ void InitEvapMap(MAPSIZE *Map, EVAPPIX ***EvapMap, SOILPIX **SoilMap,
   int y;			/* counter */
   int NSoil;			/* Number of soil layers for current pixel */
   int NVeg;			/* Number of veg layers for current pixel */
+  EVAPPIX NoEvap;		/* layer arrays of all cells with SNOW ONLY */
 
   if (DEBUG)
     printf("Initializing evaporation map\n");
 
-  if (!(*EvapMap = (EVAPPIX **)calloc(Map->NY, sizeof(EVAPPIX *))))
+  if (!(*EvapMap = (EVAPPIX **)TaggedCalloc(Map->NY, sizeof(EVAPPIX *),
+					    MEM_EVAP)))
     ReportError((char *)Routine, 1);
 
   for (y = 0; y < Map->NY; y++) {
-    if (!((*EvapMap)[y] = (EVAPPIX *)calloc(Map->NX, sizeof(EVAPPIX))))
+    if (!((*EvapMap)[y] = (EVAPPIX *)TaggedCalloc(Map->NX, sizeof(EVAPPIX),
+						  MEM_EVAP)))
+      ReportError((char *)Routine, 1);
+  }
+  FirstTouchRows(Map, *EvapMap, Map->NX * sizeof(EVAPPIX));
+
+  if (Options->SnowOnly) {
+    NVeg = Veg->MaxLayers;
+    NSoil = Soil->MaxLayers;
+    if (!(NoEvap.EPot = (float *)ArenaCalloc(NVeg + 1, sizeof(float),
+                                             MEM_EVAP)) ||
+        !(NoEvap.EAct = (float *)ArenaCalloc(NVeg + 1, sizeof(float),
+                                             MEM_EVAP)) ||
+        !(NoEvap.EInt = (float *)ArenaCalloc(NVeg, sizeof(float),
+                                             MEM_EVAP)) ||
+        !(NoEvap.ESoil = (float **)ArenaCalloc(NVeg, sizeof(float *),
+                                               MEM_EVAP)))
       ReportError((char *)Routine, 1);
+    for (i = 0; i < NVeg; i++) {
+      if (!(NoEvap.ESoil[i] = (float *)ArenaCalloc(NSoil, sizeof(float),
+                                                   MEM_EVAP)))
+        ReportError((char *)Routine, 1);
+    }
+    for (y = 0; y < Map->NY; y++) {
+      for (x = 0; x < Map->NX; x++) {
+        if (INBASIN(TopoMap[y][x].Mask)) {
+          (*EvapMap)[y][x].EPot = NoEvap.EPot;
+          (*EvapMap)[y][x].EAct = NoEvap.EAct;
+          (*EvapMap)[y][x].EInt = NoEvap.EInt;
+          (*EvapMap)[y][x].ESoil = NoEvap.ESoil;
+        }
+      }
+    }
+    return;
   }
 
   for (y = 0; y < Map->NY; y++) {
@@ -120,23 +154,24 @@ void InitEvapMap(MAPSIZE *Map, EVAPPIX ***EvapMap, SOILPIX **SoilMap,
         assert(VegMap[y][x].Veg > 0 && SoilMap[y][x].Soil > 0);
 
         if (!((*EvapMap)[y][x].EPot =
-          (float *)calloc(NVeg + 1, sizeof(float))))
+          (float *)ArenaCalloc(NVeg + 1, sizeof(float), MEM_EVAP)))
           ReportError((char *)Routine, 1);
 
         if (!((*EvapMap)[y][x].EAct =
-          (float *)calloc(NVeg + 1, sizeof(float))))
+          (float *)ArenaCalloc(NVeg + 1, sizeof(float), MEM_EVAP)))
           ReportError((char *)Routine, 1);
 
-        if (!((*EvapMap)[y][x].EInt = (float *)calloc(NVeg, sizeof(float))))
+        if (!((*EvapMap)[y][x].EInt =
+          (float *)ArenaCalloc(NVeg, sizeof(float), MEM_EVAP)))
           ReportError((char *)Routine, 1);
 
         if (!((*EvapMap)[y][x].ESoil =
-          (float **)calloc(NVeg, sizeof(float *))))
+          (float **)ArenaCalloc(NVeg, sizeof(float *), MEM_EVAP)))
           ReportError((char *)Routine, 1);
 
         for (i = 0; i < NVeg; i++) {
           if (!((*EvapMap)[y][x].ESoil[i] =
-            (float *)calloc(NSoil, sizeof(float))))
+            (float *)ArenaCalloc(NSoil, sizeof(float), MEM_EVAP)))
             ReportError((char *)Routine, 1);
         }
       }
@@ -158,20 +193,23 @@ void InitPrecipMap(MAPSIZE * Map, PRECIPPIX *** PrecipMap, VEGPIX ** VegMap,
   if (DEBUG)
     printf("Initializing precipitation map\n");
 
-  if (!(*PrecipMap = (PRECIPPIX **)calloc(Map->NY, sizeof(PRECIPPIX *))))
+  if (!(*PrecipMap = (PRECIPPIX **)TaggedCalloc(Map->NY, sizeof(PRECIPPIX *),
+						MEM_PRECIP)))
     ReportError((char *)Routine, 1);
 
   for (y = 0; y < Map->NY; y++) {
-    if (!((*PrecipMap)[y] = (PRECIPPIX *)calloc(Map->NX, sizeof(PRECIPPIX))))
+    if (!((*PrecipMap)[y] = (PRECIPPIX *)TaggedCalloc(Map->NX,
+						      sizeof(PRECIPPIX), MEM_PRECIP)))
       ReportError((char *)Routine, 1);
   }
+  FirstTouchRows(Map, *PrecipMap, Map->NX * sizeof(PRECIPPIX));
 
   for (y = 0; y < Map->NY; y++) {
     for (x = 0; x < Map->NX; x++) {
       if (INBASIN(TopoMap[y][x].Mask)) {
         NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
         if (!((*PrecipMap)[y][x].IntRain =
-          (float *)calloc(NVeg, sizeof(float))))
+          (float *)ArenaCalloc(NVeg, sizeof(float), MEM_PRECIP)))
           ReportError((char *)Routine, 1);
       }
     }
@@ -182,7 +220,7 @@ void InitPrecipMap(MAPSIZE * Map, PRECIPPIX *** PrecipMap, VEGPIX ** VegMap,
       if (INBASIN(TopoMap[y][x].Mask)) {
         NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
         if (!((*PrecipMap)[y][x].IntSnow =
-          (float *)calloc(NVeg, sizeof(float))))
+          (float *)ArenaCalloc(NVeg, sizeof(float), MEM_PRECIP)))
           ReportError((char *)Routine, 1);
       }
     }
@@ -210,23 +248,27 @@ void InitMM5Maps(int NSoilLayers, int NY, int NX, float ****MM5Input,
   if (Options->HeatFlux == FALSE)
     NTotalMaps -= NSoilLayers;
 
-  if (!((*MM5Input) = (float ***)calloc(NTotalMaps, sizeof(float **))))
+  if (!((*MM5Input) = (float ***)TaggedCalloc(NTotalMaps, sizeof(float **),
+					      MEM_MM5)))
     ReportError(Routine, 1);
 
   for (n = 0; n < NTotalMaps; n++) {
-    if (!((*MM5Input)[n] = (float **)calloc(NY, sizeof(float *))))
+    if (!((*MM5Input)[n] = (float **)TaggedCalloc(NY, sizeof(float *),
+						  MEM_MM5)))
       ReportError(Routine, 1);
     for (y = 0; y < NY; y++) {
-      if (!((*MM5Input)[n][y] = (float *)calloc(NX, sizeof(float))))
+      if (!((*MM5Input)[n][y] = (float *)TaggedCalloc(NX, sizeof(float),
+						      MEM_MM5)))
         ReportError(Routine, 1);
     }
   }
 
   /* Initiate radiation map */
-  if (!(*RadMap = (PIXRAD **)calloc(NY, sizeof(PIXRAD *))))
+  if (!(*RadMap = (PIXRAD **)TaggedCalloc(NY, sizeof(PIXRAD *), MEM_RADIATION)))
     ReportError((char *)Routine, 1);
   for (y = 0; y < NY; y++) {
-    if (!((*RadMap)[y] = (PIXRAD *)calloc(NX, sizeof(PIXRAD))))
+    if (!((*RadMap)[y] = (PIXRAD *)TaggedCalloc(NX, sizeof(PIXRAD),
+						MEM_RADIATION)))
       ReportError((char *)Routine, 1);
   }
 }
@@ -234,29 +276,20 @@ void InitMM5Maps(int NSoilLayers, int NY, int NX, float ****MM5Input,
 /*******************************************************************************
   InitWindModelMaps()
 *******************************************************************************/
-void InitWindModelMaps(char *WindPath, MAPSIZE *Map, float ****WindModel)
+void InitWindModelMaps(char *WindPath, MAPSIZE *Map, int Bits,
+		       STATICMAP **WindModel)
 {
   char *Routine = "InitWindModelMaps";
   char InFileName[NAMESIZE + 1];
   char Str[NAMESIZE + 1];
   int NumberType;
   int n;
-  int x;
-  int y;
   float *Array = NULL;
 
-  if (!((*WindModel) = (float ***)calloc(NWINDMAPS, sizeof(float **))))
+  if (!((*WindModel) = (STATICMAP *)TaggedCalloc(NWINDMAPS, sizeof(STATICMAP),
+						 MEM_MET)))
     ReportError(Routine, 1);
 
-  for (n = 0; n < NWINDMAPS; n++) {
-    if (!((*WindModel)[n] = (float **)calloc(Map->NY, sizeof(float *))))
-      ReportError(Routine, 1);
-    for (y = 0; y < Map->NY; y++) {
-      if (!((*WindModel)[n][y] = (float *)calloc(Map->NX, sizeof(float))))
-        ReportError(Routine, 1);
-    }
-  }
-
   if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
     ReportError((char *)Routine, 1);
   NumberType = NC_FLOAT;
@@ -265,12 +298,10 @@ void InitWindModelMaps(char *WindPath, MAPSIZE *Map, float ****WindModel)
   for (n = 0; n < NWINDMAPS; n++) {
     sprintf(Str, "%02d", n + 1);
     sprintf(InFileName, "%s%s%s", WindPath, Str, fileext);
+    if (SharedStaticMap(share_wind + n, Map, &((*WindModel)[n])))
+      continue;
     Read2DMatrix(InFileName, Array, NumberType, Map, 0, "", 0);
-    for (y = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++) {
-        (*WindModel)[n][y][x] = Array[y * Map->NX + x];
-      }
-    }
+    InitStaticMap(Map, Bits, Array, 0.0, MEM_MET, &((*WindModel)[n]));
   }
   free(Array);
 }
@@ -278,21 +309,17 @@ void InitWindModelMaps(char *WindPath, MAPSIZE *Map, float ****WindModel)
 /*******************************************************************************
   InitRadarMap()
 *******************************************************************************/
-void InitRadarMap(MAPSIZE *Radar, RADARPIX ***RadarMap)
+void InitRadarMap(MAPSIZE *Radar, float **RadarMap)
 {
   const char *Routine = "InitRadarMap";
-  int y;			/* counter */
 
   if (DEBUG)
     printf("Initializing radar precipitation map\n");
 
-  if (!(*RadarMap = (RADARPIX **)calloc(Radar->NY, sizeof(RADARPIX *))))
+  /* only the window of the radar map that covers the basin is kept */
+  if (!(*RadarMap = (float *)TaggedCalloc(Radar->WinNY * Radar->WinNX, 
+				    sizeof(float), MEM_MET)))
     ReportError((char *)Routine, 1);
-
-  for (y = 0; y < Radar->NY; y++) {
-    if (!((*RadarMap)[y] = (RADARPIX *)calloc(Radar->NX, sizeof(RADARPIX))))
-      ReportError((char *)Routine, 1);
-  }
 }
 
 /******************************************************************************
@@ -306,44 +333,37 @@ void InitRadMap(MAPSIZE *Map, PIXRAD ***RadMap)
   if (DEBUG)
     printf("Initializing radiation map\n");
 
-  if (!(*RadMap = (PIXRAD **)calloc(Map->NY, sizeof(PIXRAD *))))
+  if (!(*RadMap = (PIXRAD **)TaggedCalloc(Map->NY, sizeof(PIXRAD *),
+					  MEM_RADIATION)))
     ReportError((char *)Routine, 1);
 
   for (y = 0; y < Map->NY; y++) {
-    if (!((*RadMap)[y] = (PIXRAD *)calloc(Map->NX, sizeof(PIXRAD))))
+    if (!((*RadMap)[y] = (PIXRAD *)TaggedCalloc(Map->NX, sizeof(PIXRAD),
+						MEM_RADIATION)))
       ReportError((char *)Routine, 1);
   }
+  FirstTouchRows(Map, *RadMap, Map->NX * sizeof(PIXRAD));
 }
 
 /******************************************************************************/
 /*			       InitPrecipLapseMap                             */
 /******************************************************************************/
-void InitPrecipLapseMap(char *PrecipLapseFile, MAPSIZE *Map, float ***PrecipLapseMap)
+void InitPrecipLapseMap(char *PrecipLapseFile, MAPSIZE *Map, int Bits,
+			STATICMAP *PrecipLapseMap)
 {
   const char *Routine = "InitPrecipLapseMap";
   int NumberType;
-  int x;			/* counter */
-  int y;			/* counter */
   float *Array = NULL;
 
-  if (!((*PrecipLapseMap) = (float **)calloc(Map->NY, sizeof(float *))))
-    ReportError((char *)Routine, 1);
-
-  for (y = 0; y < Map->NY; y++) {
-    if (!((*PrecipLapseMap)[y] = (float *)calloc(Map->NX, sizeof(float))))
-      ReportError((char *)Routine, 1);
-  }
+  if (SharedStaticMap(share_preciplapse, Map, PrecipLapseMap))
+    return;
 
   if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
     ReportError((char *)Routine, 1);
   NumberType = NC_FLOAT;
 
   Read2DMatrix(PrecipLapseFile, Array, NumberType, Map, 0, "", 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      (*PrecipLapseMap)[y][x] = Array[y * Map->NX + x];
-    }
-  }
+  InitStaticMap(Map, Bits, Array, 0.0, MEM_MET, PrecipLapseMap);
 
   free(Array);
 }
@@ -358,13 +378,15 @@ void InitPrismMap(int NY, int NX, float ***PrismMap)
   int x;			/* counter */
   int y;			/* counter */
 
-  if (!((*PrismMap) = (float **)calloc(NY, sizeof(float *))))
+  if (!((*PrismMap) = (float **)TaggedCalloc(NY, sizeof(float *), MEM_MET)))
     ReportError((char *)Routine, 1);
 
-  for (y = 0; y < NY; y++) {
-    if (!((*PrismMap)[y] = (float *)calloc(NX, sizeof(float))))
-      ReportError((char *)Routine, 1);
-  }
+  /* one block, so that InitNewMonth() reads the map in place */
+  if (!((*PrismMap)[0] = (float *)TaggedCalloc((size_t) NY * NX,
+					       sizeof(float), MEM_MET)))
+    ReportError((char *)Routine, 1);
+  for (y = 1; y < NY; y++)
+    (*PrismMap)[y] = (*PrismMap)[0] + (size_t) y * NX;
 
   for (y = 0; y < NY; y++) {
     for (x = 0; x < NX; x++) {
@@ -378,42 +400,73 @@ void InitPrismMap(int NY, int NX, float ***PrismMap)
 /*				  InitShadeMap                                */
 /******************************************************************************/
 void InitShadeMap(OPTIONSTRUCT * Options, int NDaySteps, MAPSIZE *Map,
-  unsigned char ****ShadowMap, float ***SkyViewMap)
+  TOPOPIX **TopoMap, SHADOWMAP *ShadowMap, STATICMAP *SkyViewMap)
 {
   const char *Routine = "InitShadeMap";
   char VarName[BUFSIZE + 1];	/* Variable name */
-  int x;			/* counter */
   int y;			/* counter */
   int n;
   int NumberType;
   float *Array = NULL;
 
-  if (!((*ShadowMap) =
-    (unsigned char ***)calloc(NDaySteps, sizeof(unsigned char **))))
+  /* only the time steps with the sun above the horizon get a shadow map,
+     these are stored in a contiguous block that InitNewMonth() allocates
+     for the daylight steps of each month.  Until then all the steps show 
+     the map of zeros */
+  ShadowMap->NDaySteps = NDaySteps;
+  ShadowMap->NSlices = 0;
+  ShadowMap->MaxSlices = 0;
+  ShadowMap->Block = NULL;
+  ShadowMap->Mapped = 0;
+  if (!(ShadowMap->Slice = (int *)TaggedCalloc(NDaySteps, sizeof(int),
+					       MEM_SHADOW)) ||
+      !(ShadowMap->Night = (unsigned char *)TaggedCalloc(Map->NY * Map->NX,
+					  sizeof(unsigned char), MEM_SHADOW)) ||
+      !(ShadowMap->Map =
+	(unsigned char ***)TaggedCalloc(NDaySteps, sizeof(unsigned char **),
+					MEM_SHADOW)))
     ReportError((char *)Routine, 1);
   for (n = 0; n < NDaySteps; n++) {
-    if (!((*ShadowMap)[n] =
-      (unsigned char **)calloc(Map->NY, sizeof(unsigned char *))))
+    if (!(ShadowMap->Map[n] =
+      (unsigned char **)TaggedCalloc(Map->NY, sizeof(unsigned char *),
+				     MEM_SHADOW)))
       ReportError((char *)Routine, 1);
-    for (y = 0; y < Map->NY; y++) {
-      if (!((*ShadowMap)[n][y] =
-        (unsigned char *)calloc(Map->NX, sizeof(unsigned char))))
-        ReportError((char *)Routine, 1);
-    }
+    ShadowMap->Slice[n] = -1;
+    for (y = 0; y < Map->NY; y++)
+      ShadowMap->Map[n][y] = ShadowMap->Night + (size_t) y * Map->NX;
   }
 
-  if (!((*SkyViewMap) = (float **)calloc(Map->NY, sizeof(float *))))
-    ReportError((char *)Routine, 1);
-  for (y = 0; y < Map->NY; y++) {
-    if (!((*SkyViewMap)[y] = (float *)calloc(Map->NX, sizeof(float))))
+  /* with SHADING MODE = HORIZON all the steps show the one slice that
+     HorizonShadeStep() computes each step.  The sky view factor is the one
+     of the horizons, unless a SKYVIEW DATA PATH is given */
+  memset(&(ShadowMap->Horizon), 0, sizeof(HORIZONMAP));
+  if (Options->ShadingMode == SHADING_HORIZON) {
+    ShadowMap->NSlices = ShadowMap->MaxSlices = 1;
+    if (!(ShadowMap->Block = (unsigned char *)
+	  TaggedCalloc(Map->NY * Map->NX, sizeof(unsigned char), MEM_SHADOW)))
       ReportError((char *)Routine, 1);
+    for (n = 0; n < NDaySteps; n++) {
+      ShadowMap->Slice[n] = 0;
+      for (y = 0; y < Map->NY; y++)
+	ShadowMap->Map[n][y] = ShadowMap->Block + (size_t) y * Map->NX;
+    }
   }
 
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      (*SkyViewMap)[y][x] = 1.0;
-    }
+  if (Options->ShadingMode == SHADING_HORIZON &&
+      IsEmptyStr(Options->SkyViewDataPath)) {
+    if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
+      ReportError((char *)Routine, 1);
+    InitHorizons(Options, Map, TopoMap, &(ShadowMap->Horizon), Array);
+    InitStaticMap(Map, Options->StaticMapBits, Array, 1.0, MEM_SHADOW,
+		  SkyViewMap);
+    free(Array);
+    return;
   }
+  if (Options->ShadingMode == SHADING_HORIZON)
+    InitHorizons(Options, Map, TopoMap, &(ShadowMap->Horizon), NULL);
+
+  if (SharedStaticMap(share_skyview, Map, SkyViewMap))
+    return;
 
   GetVarName(305, 0, VarName);
   GetVarNumberType(305, &NumberType);
@@ -421,11 +474,56 @@ void InitShadeMap(OPTIONSTRUCT * Options, int NDaySteps, MAPSIZE *Map,
     ReportError((char *)Routine, 1);
   Read2DMatrix(Options->SkyViewDataPath, Array, NumberType, Map, 0,
     VarName, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      (*SkyViewMap)[y][x] = Array[y * Map->NX + x];
-    }
-  }
+  InitStaticMap(Map, Options->StaticMapBits, Array, 1.0, MEM_SHADOW,
+		SkyViewMap);
 
   free(Array);
 }
+
+/*****************************************************************************
+  InitMetFields()
+
+  Allocate the interpolated met variables for all active cells.  The 
+  variables are stored one after the other in a single block.
+*****************************************************************************/
+void InitMetFields(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+		   METFIELDS *MetFields)
+{
+  const char *Routine = "InitMetFields";
+  float *Block;
+  int i;
+  int n;
+
+  n = Map->NumActive;
+  MetFields->NCells = n;
+  if (!(Block = (float *)TaggedCalloc(8 * n, sizeof(float), MEM_MET)))
+    ReportError((char *)Routine, 1);
+  MetFields->Tair = Block;
+  MetFields->Rh = Block + n;
+  MetFields->Wind = Block + 2 * n;
+  MetFields->Sin = Block + 3 * n;
+  MetFields->SinBeam = Block + 4 * n;
+  MetFields->SinDiffuse = Block + 5 * n;
+  MetFields->Lin = Block + 6 * n;
+  MetFields->Press = Block + 7 * n;
+  HugePageHint(Block, 8 * n * sizeof(float));
+  for (i = 0; i < 8; i++)
+    FirstTouchBlock(Block + i * n, n, sizeof(float));
+
+  MetFields->NStats = NStats;
+  if (!(MetFields->StatValue = (STATVALUE *)TaggedCalloc(NStats > 0 ? NStats : 1,
+					       sizeof(STATVALUE), MEM_MET)))
+    ReportError((char *)Routine, 1);
+  if (!(MetFields->StatLapse = (float *)TaggedCalloc(NStats > 0 ? NStats : 1, 
+					       sizeof(float), MEM_MET)))
+    ReportError((char *)Routine, 1);
+  MetFields->LapseValid = FALSE;
+  if (!(MetFields->StatPLapse = (float *)TaggedCalloc(NStats > 0 ? NStats : 1, 
+					       sizeof(float), MEM_MET)))
+    ReportError((char *)Routine, 1);
+  MetFields->PFactorMonth = 0;
+  MetFields->Step = 1;
+  MetFields->Precip = NULL;
+
+  InitTiles(&(MetFields->Tiles), n, Options->CellTileSize, Options->NThreads);
+}
@@ -9,6 +9,10 @@
  * DESCRIPTION:  Initialize meteorology options for DHSVM
  * DESCRIP-END.
  * FUNCTIONS:    InitMetSources()
+ *               InitGridMet()
+ *               ScanGridMet()
+ *               ReadGridCatalogue()
+ *               WriteGridCatalogue()
  *               InitMM5()
  *               InitRadar()
  *               InitStations()
@@ -33,6 +37,21 @@
 #include "constants.h"
 #include "rad.h"
 
+#define GRID_CATALOGUE_MAGIC "# DHSVM grid met catalogue"
+
+/* a file of the gridded met forcing (see InitGridMet()) */
+typedef struct {
+  float Lat;
+  float Lon;
+  float East;			/* UTM of Lat and Lon */
+  float North;
+  char FileName[BUFSIZE + 1];
+} GRIDFILE;
+
+static int ScanGridMet(GRID *Grid, GRIDFILE **Files);
+static int ReadGridCatalogue(GRID *Grid, GRIDFILE **Files);
+static void WriteGridCatalogue(GRID *Grid, int NFiles, GRIDFILE *Files);
+
  /*******************************************************************************
    Function name: InitMetSources()
 
@@ -79,7 +98,8 @@ void InitMetSources(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
 
   /* Use gridded met forcing data */
   if (Options->GRIDMET == TRUE)
-    InitGridMet(Options, Input, Map, TopoMap, Grid, Stat, NStats);
+    InitGridMet(Options, Input, Map, TopoMap, NSoilLayers, Time->Dt, Grid, Stat,
+      NStats);
 
   /* otherwise, check and initialize the other options */
   if (Options->QPF == TRUE || (Options->MM5 == FALSE && Options->GRIDMET == FALSE))
@@ -95,6 +115,9 @@ void InitMetSources(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
         ReportError((char *)Routine, 54);
       InitPrecipLapse(Input, InFiles);
     }
+    /* replace the station files with the binary cache if requested */
+    InitMetFilePool(Options->MaxMetFiles, *NStats, *Stat);
+    InitMetCache(Options, Time, NSoilLayers, *NStats, *Stat);
   }
 }
 
@@ -192,9 +215,7 @@ void InitStations(LISTPTR Input, MAPSIZE *Map, int NDaySteps,
     OpenFile(&((*Stat)[k].MetFile.FilePtr), (*Stat)[k].MetFile.FileName, "r", FALSE);
 
     /* check to see if the stations are inside the bounding box */
-    if (((*Stat)[k].Loc.N >= Map->NY || (*Stat)[k].Loc.N < 0 ||
-      (*Stat)[k].Loc.E >= Map->NX || (*Stat)[k].Loc.E < 0)
-      && Options->Outside == FALSE)
+    if (!InInputArea(Map, &((*Stat)[k].Loc)) && Options->Outside == FALSE)
       printf("Station %d outside bounding box: %s ignored\n", i + 1, (*Stat)[k].Name);
     else
       k = k + 1;
@@ -224,20 +245,28 @@ Function name: InitGridMet()
 
 Purpose      : Read the gridded met file.  This information
 is in the [METEOROLOGY] section
+
+Comments     : The files in MET FILE PATH are listed in the GRID CATALOGUE 
+FILE if it is given, which is written from a scan of the directory the
+first time.  With MAXIMUM OPEN MET FILES the selected files are closed 
+again and opened by the met file pool when they are read.  With a GRID 
+NETCDF FILE the grid points are read from that file instead, see 
+InitGridMetNetCDF()
 *****************************************************************************/
 void InitGridMet(OPTIONSTRUCT *Options, LISTPTR Input, MAPSIZE *Map,
-  TOPOPIX **TopoMap, GRID *Grid, METLOCATION **Stat, int *NStats)
+  TOPOPIX **TopoMap, int NSoilLayers, int Dt, GRID *Grid, METLOCATION **Stat,
+  int *NStats)
 {
   char *Routine = "InitGridMet";
   char KeyName[BUFSIZE + 1];
   char VarStr[BUFSIZE + 1];
   int i, k, m;
+  int n, NFiles;
+  int Selected;			/* number of stations before this file */
   float lat, lon, North, East;
   char tempfilename[BUFSIZE + 1];
   FILE *PrismStatFile;
-  char junk[BUFSIZE + 1], infileformat[BUFSIZE + 1];
-  DIR *dir;
-  struct dirent *ent;
+  GRIDFILE *Files;
 
   STRINIENTRY StrEnv[] = {
     { "METEOROLOGY", "EXTREME NORTH LAT", "", "" },
@@ -248,6 +277,9 @@ void InitGridMet(OPTIONSTRUCT *Options, LISTPTR Input, MAPSIZE *Map,
 	{ "METEOROLOGY", "GRID_DECIMAL", "", "" },
     { "METEOROLOGY", "MET FILE PATH", "", "" },
     { "METEOROLOGY", "FILE PREFIX", "", "" },
+    { "METEOROLOGY", "GRID CATALOGUE FILE", "", "" },
+    { "METEOROLOGY", "GRID NETCDF FILE", "", "" },
+    { "METEOROLOGY", "GRID NETCDF VARIABLES", "", "" },
     { NULL, NULL, "", NULL },
   };
 
@@ -283,6 +315,17 @@ void InitGridMet(OPTIONSTRUCT *Options, LISTPTR Input, MAPSIZE *Map,
   /* estimate of total grid cells for the basin (must > actual used grids */
   if (!CopyInt(&(Grid->NGrids), StrEnv[tot_grid].VarStr, 1))
     ReportError(StrEnv[tot_grid].KeyName, 51);
+
+  /* the grid met forcing can also be read from one NetCDF file */
+  strcpy(Grid->ncfile, StrEnv[grid_netcdf_file].VarStr);
+  strcpy(Grid->ncvars, StrEnv[grid_netcdf_vars].VarStr);
+  if (!IsEmptyStr(Grid->ncfile)) {
+    if (IsEmptyStr(Grid->ncvars))
+      ReportError(StrEnv[grid_netcdf_vars].KeyName, 51);
+    InitGridMetNetCDF(Options, Map, TopoMap, NSoilLayers, Dt, Grid, Stat,
+                      NStats);
+    return;
+  }
   
   /* Number of digits after decimal point in forcing file names */
   if (!CopyInt(&(Grid->Decimal), StrEnv[decim].VarStr, 1))
@@ -298,74 +341,77 @@ void InitGridMet(OPTIONSTRUCT *Options, LISTPTR Input, MAPSIZE *Map,
     ReportError(StrEnv[file_prefix].KeyName, 51);
   strcpy(Grid->fileprefix, StrEnv[file_prefix].VarStr);
 
+  /* catalogue of the grid met files (empty = scan the file path) */
+  strcpy(Grid->catalogue, StrEnv[grid_catalogue].VarStr);
+
   /* Allocate memory for the stations */
   if (!(*Stat = (METLOCATION *)calloc(Grid->NGrids, sizeof(METLOCATION))))
     ReportError(Routine, 1);
 
-  /* define the format of file input */
-  sprintf(junk, "%s_%%f_%%f", Grid->fileprefix);
-  /* define input file format */
-  sprintf(infileformat, "%%s%%s_%%.%if_%%.%if", Grid->Decimal, Grid->Decimal);
-  
   printf("\nReading the gridded met files ...\n");
+  NFiles = -1;
+  if (!IsEmptyStr(Grid->catalogue))
+    NFiles = ReadGridCatalogue(Grid, &Files);
+  if (NFiles < 0) {
+    NFiles = ScanGridMet(Grid, &Files);
+    if (!IsEmptyStr(Grid->catalogue))
+      WriteGridCatalogue(Grid, NFiles, Files);
+  }
+
   k = 0;
   m = 0;
-  if ((dir = opendir(Grid->filepath)) != NULL) {
-    /* print all the files and directories within directory */
-    while ((ent = readdir(dir)) != NULL) {
-      if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) {
-        continue;
+  for (n = 0; n < NFiles; n++) {
+    Selected = k;
+    lat = Files[n].Lat;
+    lon = Files[n].Lon;
+    East = Files[n].East;
+    North = Files[n].North;
+    sprintf((*Stat)[k].Name, "data_%f_%f\n", lat, lon);
+
+    (*Stat)[k].Loc.N = Round(((Map->Yorig - 0.5 * Map->DY) - North) / Map->DY);
+    (*Stat)[k].Loc.E = Round((East - (Map->Xorig + 0.5 * Map->DX)) / Map->DX);
+    m += 1;
+
+    /* met grids must be with the bounding box of the basin */
+    if (((*Stat)[k].Loc.N >= Map->NY || (*Stat)[k].Loc.N < 0 ||
+      (*Stat)[k].Loc.E >= Map->NX || (*Stat)[k].Loc.E < 0))
+      printf("..... Station %d outside the basin bounding box: %s ignored\n", m, (*Stat)[k].Name);
+    else {
+      /* only include grids within the mask */
+      if (Options->Outside == FALSE) {
+        if (INBASIN(TopoMap[(*Stat)[k].Loc.N][(*Stat)[k].Loc.E].Mask)) {
+
+          /* open met data file */
+          strcpy((*Stat)[k].MetFile.FileName, Files[n].FileName);
+
+          if (!((*Stat)[k].MetFile.FilePtr = fopen((*Stat)[k].MetFile.FileName, "r"))) {
+            printf("..... %s doesn't exist\n", (*Stat)[k].MetFile.FileName);
+            continue;
+          }
+          printf("..... Station %d: %s is selected\n", m, (*Stat)[k].Name);
+          k = k + 1;
+        }
       }
       else {
-        sscanf(ent->d_name, junk, &lat, &lon);
-
-        /* convert lat and lon to utm */
-        deg2utm(lat, lon, &East, &North);		
-		sprintf((*Stat)[k].Name, "data_%f_%f\n", lat, lon);
-		
-		(*Stat)[k].Loc.N = Round(((Map->Yorig - 0.5 * Map->DY) - North) / Map->DY);
-        (*Stat)[k].Loc.E = Round((East - (Map->Xorig + 0.5 * Map->DX)) / Map->DX);
-        m += 1;
-
-        /* met grids must be with the bounding box of the basin */
-		if (((*Stat)[k].Loc.N >= Map->NY || (*Stat)[k].Loc.N < 0 ||
-          (*Stat)[k].Loc.E >= Map->NX || (*Stat)[k].Loc.E < 0))
-          printf("..... Station %d outside the basin bounding box: %s ignored\n", m, (*Stat)[k].Name);
-        else {
-          /* only include grids within the mask */
-          if (Options->Outside == FALSE) {
-            if (INBASIN(TopoMap[(*Stat)[k].Loc.N][(*Stat)[k].Loc.E].Mask)) {
-              
-			  /* open met data file */
-              sprintf((*Stat)[k].MetFile.FileName, infileformat, Grid->filepath, Grid->fileprefix, lat, lon);
-
-              if (!((*Stat)[k].MetFile.FilePtr = fopen((*Stat)[k].MetFile.FileName, "r"))) {
-                printf("..... %s doesn't exist\n", (*Stat)[k].MetFile.FileName);
-                continue;
-              }
-              printf("..... Station %d: %s is selected\n", m, (*Stat)[k].Name);
-              k = k + 1;
-            }
-          }
-          else {
-            if (lat <= Grid->LatNorth && lat >= Grid->LatSouth && lon >= Grid->LonWest && lon <= Grid->LonWest) {
-              if (!((*Stat)[k].MetFile.FilePtr = fopen((*Stat)[k].MetFile.FileName, "r"))) {
-                //printf("..... %s doesn't exist\n", (*Stat)[k].MetFile.FileName);
-                continue;
-              }
-              printf("..... Station %d: %s is selected\n", m, (*Stat)[k].Name);
-              k = k + 1;
-            }
+        if (lat <= Grid->LatNorth && lat >= Grid->LatSouth && lon >= Grid->LonWest && lon <= Grid->LonWest) {
+          strcpy((*Stat)[k].MetFile.FileName, Files[n].FileName);
+          if (!((*Stat)[k].MetFile.FilePtr = fopen((*Stat)[k].MetFile.FileName, "r"))) {
+            //printf("..... %s doesn't exist\n", (*Stat)[k].MetFile.FileName);
+            continue;
           }
+          printf("..... Station %d: %s is selected\n", m, (*Stat)[k].Name);
+          k = k + 1;
         }
       }
     }
-    closedir(dir);
-  }
-  else {
-    /* could not open directory */
-    ReportError(Grid->filepath, 3);
+
+    /* the met file pool opens the file again when it is read */
+    if (Options->MaxMetFiles > 0 && k > Selected) {
+      fclose((*Stat)[Selected].MetFile.FilePtr);
+      (*Stat)[Selected].MetFile.FilePtr = NULL;
+    }
   }
+  free(Files);
 
   /* if no grid is found within the mask, exit with error */
   if (k < 1)
@@ -386,6 +432,150 @@ void InitGridMet(OPTIONSTRUCT *Options, LISTPTR Input, MAPSIZE *Map,
     }
   }
 }
+
+/*******************************************************************************
+Function name: ScanGridMet()
+
+Purpose      : List the grid met files in Grid->filepath, with the latitude
+and longitude from their names.  Returns the number of files in Files,
+which is allocated here
+*****************************************************************************/
+static int ScanGridMet(GRID *Grid, GRIDFILE **Files)
+{
+  char *Routine = "ScanGridMet";
+  char junk[BUFSIZE + 1], infileformat[BUFSIZE + 1];
+  int NFiles;
+  int MaxFiles;
+  float lat, lon;
+  DIR *dir;
+  struct dirent *ent;
+  GRIDFILE *File;
+
+  /* define the format of file input */
+  sprintf(junk, "%s_%%f_%%f", Grid->fileprefix);
+  /* define input file format */
+  sprintf(infileformat, "%%s%%s_%%.%if_%%.%if", Grid->Decimal, Grid->Decimal);
+
+  NFiles = 0;
+  MaxFiles = 0;
+  *Files = NULL;
+  if ((dir = opendir(Grid->filepath)) != NULL) {
+    while ((ent = readdir(dir)) != NULL) {
+      if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, ".."))
+        continue;
+      if (sscanf(ent->d_name, junk, &lat, &lon) != 2)
+        continue;
+      if (NFiles == MaxFiles) {
+        MaxFiles = (MaxFiles > 0) ? 2 * MaxFiles : 256;
+        if (!(*Files = (GRIDFILE *) realloc(*Files, 
+                                            MaxFiles * sizeof(GRIDFILE))))
+          ReportError(Routine, 1);
+      }
+      File = &((*Files)[NFiles++]);
+      File->Lat = lat;
+      File->Lon = lon;
+      /* convert lat and lon to utm */
+      deg2utm(lat, lon, &(File->East), &(File->North));
+      sprintf(File->FileName, infileformat, Grid->filepath, Grid->fileprefix,
+              lat, lon);
+    }
+    closedir(dir);
+  }
+  else {
+    /* could not open directory */
+    ReportError(Grid->filepath, 3);
+  }
+  return NFiles;
+}
+
+/*******************************************************************************
+Function name: ReadGridCatalogue()
+
+Purpose      : Read the list of grid met files from Grid->catalogue.  The 
+catalogue has four header lines (GRID_CATALOGUE_MAGIC, MET FILE PATH, FILE 
+PREFIX, the number of files and GRID_DECIMAL) and a line with latitude,
+longitude, UTM east and north and file name for each file.  Returns the 
+number of files in Files, or -1 if the catalogue does not exist or does not
+match the [METEOROLOGY] section
+*****************************************************************************/
+static int ReadGridCatalogue(GRID *Grid, GRIDFILE **Files)
+{
+  char *Routine = "ReadGridCatalogue";
+  char Line[2 * BUFSIZE + 1];
+  char Path[2 * BUFSIZE + 1];
+  char Prefix[2 * BUFSIZE + 1];
+  int NFiles;
+  int Decimal;
+  int n;
+  FILE *CatFile;
+  GRIDFILE *File;
+
+  if ((CatFile = fopen(Grid->catalogue, "r")) == NULL)
+    return -1;
+
+  if (!fgets(Line, sizeof(Line), CatFile) || 
+      strncmp(Line, GRID_CATALOGUE_MAGIC, strlen(GRID_CATALOGUE_MAGIC)) != 0 ||
+      !fgets(Path, sizeof(Path), CatFile) || 
+      !fgets(Prefix, sizeof(Prefix), CatFile) ||
+      !fgets(Line, sizeof(Line), CatFile) ||
+      sscanf(Line, "%d %d", &NFiles, &Decimal) != 2 || NFiles < 0) {
+    ReportWarning(Grid->catalogue, 80);
+    fclose(CatFile);
+    return -1;
+  }
+  Path[strcspn(Path, "\n")] = '\0';
+  Prefix[strcspn(Prefix, "\n")] = '\0';
+  if (strcmp(Path, Grid->filepath) != 0 || 
+      strcmp(Prefix, Grid->fileprefix) != 0 || Decimal != Grid->Decimal) {
+    ReportWarning(Grid->catalogue, 80);
+    fclose(CatFile);
+    return -1;
+  }
+
+  if (!(*Files = (GRIDFILE *) calloc(NFiles > 0 ? NFiles : 1, 
+                                     sizeof(GRIDFILE))))
+    ReportError(Routine, 1);
+  for (n = 0; n < NFiles; n++) {
+    File = &((*Files)[n]);
+    if (!fgets(Line, sizeof(Line), CatFile) ||
+        sscanf(Line, "%f %f %f %f %255[^\n]", &(File->Lat), &(File->Lon), 
+               &(File->East), &(File->North), File->FileName) != 5) {
+      ReportWarning(Grid->catalogue, 80);
+      free(*Files);
+      fclose(CatFile);
+      return -1;
+    }
+  }
+  fclose(CatFile);
+
+  printf("%d grid met files listed in %s\n", NFiles, Grid->catalogue);
+  return NFiles;
+}
+
+/*******************************************************************************
+Function name: WriteGridCatalogue()
+
+Purpose      : Write the list of grid met files to Grid->catalogue, see 
+ReadGridCatalogue().  The values are written with enough digits to be read
+back exactly
+*****************************************************************************/
+static void WriteGridCatalogue(GRID *Grid, int NFiles, GRIDFILE *Files)
+{
+  FILE *CatFile;
+  int n;
+
+  OpenFile(&CatFile, Grid->catalogue, "w", TRUE);
+  fprintf(CatFile, "%s\n%s\n%s\n%d %d\n", GRID_CATALOGUE_MAGIC,
+          Grid->filepath, Grid->fileprefix, NFiles, Grid->Decimal);
+  for (n = 0; n < NFiles; n++)
+    fprintf(CatFile, "%.9g %.9g %.9g %.9g %s\n", Files[n].Lat, Files[n].Lon,
+            Files[n].East, Files[n].North, Files[n].FileName);
+  if (fclose(CatFile) != 0)
+    ReportError(Grid->catalogue, 72);
+  printf("Wrote the catalogue of %d grid met files to %s\n", NFiles,
+         Grid->catalogue);
+}
+
 /*******************************************************************************
   Function name: InitMM5()
 
@@ -412,6 +602,8 @@ void InitMM5(LISTPTR Input, int NSoilLayers, TIMESTRUCT *Time,
   char KeyName[BUFSIZE + 1];
   char VarStr[BUFSIZE + 1];
   int i;
+  int y, x;
+  int MM5Y, MM5X;
   STRINIENTRY StrEnv[] = {
     {"METEOROLOGY", "MM5 START", "", ""},
     {"METEOROLOGY", "MM5 TEMPERATURE FILE", "", ""},
@@ -441,6 +633,13 @@ void InitMM5(LISTPTR Input, int NSoilLayers, TIMESTRUCT *Time,
 
   InitTime(Time, NULL, NULL, NULL, &Start, Time->Dt);
 
+  /* with MET FILE INTERVAL the MM5 records start on a record of the
+     stations */
+  if (Options->MetInterval > 0 &&
+      (Start.Hour * SECPHOUR + Start.Min * 60 + Start.Sec) %
+      Options->MetInterval != 0)
+    ReportError(StrEnv[MM5_start].KeyName, 51);
+
   if (IsEmptyStr(StrEnv[MM5_temperature].VarStr))
     ReportError(StrEnv[MM5_temperature].KeyName, 51);
   strcpy(InFiles->MM5Temp, StrEnv[MM5_temperature].VarStr);
@@ -513,6 +712,17 @@ void InitMM5(LISTPTR Input, int NSoilLayers, TIMESTRUCT *Time,
   if (MM5Map->OffsetX > 0 || MM5Map->OffsetY < 0)
     ReportError("Input Options File", 31);
 
+  /* index of the MM5 cell for every cell of the model grid, so that the MM5
+     maps can be regridded each step without recomputing the positions */
+  if (!(MM5Map->RegridIndex = (int *)calloc(Map->NY * Map->NX, sizeof(int))))
+    ReportError((char *)Routine, 1);
+  for (y = 0, i = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++, i++) {
+      MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
+      MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
+      MM5Map->RegridIndex[i] = MM5Y * MM5Map->NX + MM5X;
+    }
+
   printf("MM5 extreme north / south is %f %f \n", MM5Map->Yorig,
     MM5Map->Yorig - MM5Map->NY * MM5Map->DY);
   printf("MM5 extreme west / east is %f %f\n", MM5Map->Xorig,
@@ -563,13 +773,24 @@ void InitMM5(LISTPTR Input, int NSoilLayers, TIMESTRUCT *Time,
 
   Modifies     : Members of Time, InFiles and Radar
 
-  Comments     :
+  Comments     : Only the window of the radar map that covers the active 
+                 cells of the basin is read each time step.  The window and
+                 the position of every active cell in the window are 
+                 determined here.
 *****************************************************************************/
 void InitRadar(LISTPTR Input, MAPSIZE * Map, TIMESTRUCT * Time,
   INPUTFILES * InFiles, MAPSIZE * Radar)
 {
+  char *Routine = "InitRadar";
   DATE Start;
   int i;
+  int k;
+  int x;
+  int y;
+  int RadarX;
+  int RadarY;
+  int MaxX;
+  int MaxY;
   STRINIENTRY StrEnv[] = {
     {"METEOROLOGY", "RADAR START", "", ""},
     {"METEOROLOGY", "RADAR FILE", "", ""},
@@ -613,6 +834,7 @@ void InitRadar(LISTPTR Input, MAPSIZE * Map, TIMESTRUCT * Time,
 
   if (!CopyFloat(&(Radar->DY), StrEnv[radar_grid].VarStr, 1))
     ReportError(StrEnv[radar_grid].KeyName, 51);
+  Radar->DX = Radar->DY;
 
   Radar->DXY = sqrt(Radar->DX * Radar->DX + Radar->DY * Radar->DY);
   Radar->X = 0;
@@ -624,6 +846,42 @@ void InitRadar(LISTPTR Input, MAPSIZE * Map, TIMESTRUCT * Time,
 
   if (Radar->OffsetX > 0 || Radar->OffsetY < 0)
     ReportError("Input Options File", 31);
+
+  /* bounding window of the radar cells that cover the active cells */
+  Radar->WinY = Radar->NY;
+  Radar->WinX = Radar->NX;
+  MaxY = -1;
+  MaxX = -1;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    RadarY = (int)((y + Radar->OffsetY) * Map->DY / Radar->DY);
+    RadarX = (int)((x - Radar->OffsetX) * Map->DX / Radar->DX);
+    if (RadarY >= Radar->NY || RadarX >= Radar->NX)
+      ReportError("Input Options File", 31);
+    Radar->WinY = MIN(Radar->WinY, RadarY);
+    Radar->WinX = MIN(Radar->WinX, RadarX);
+    MaxY = MAX(MaxY, RadarY);
+    MaxX = MAX(MaxX, RadarX);
+  }
+  Radar->WinNY = MaxY - Radar->WinY + 1;
+  Radar->WinNX = MaxX - Radar->WinX + 1;
+
+  /* index of the radar cell in the window for every active cell of the model
+     grid */
+  if (!(Radar->RegridIndex = (int *)calloc(Map->NY * Map->NX, sizeof(int))))
+    ReportError(Routine, 1);
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    RadarY = (int)((y + Radar->OffsetY) * Map->DY / Radar->DY);
+    RadarX = (int)((x - Radar->OffsetX) * Map->DX / Radar->DX);
+    Radar->RegridIndex[y * Map->NX + x] =
+      (RadarY - Radar->WinY) * Radar->WinNX + (RadarX - Radar->WinX);
+  }
+
+  printf("Radar window is %d rows by %d columns of %d by %d\n", Radar->WinNY,
+    Radar->WinNX, Radar->NY, Radar->NX);
 }
 
 /*******************************************************************************
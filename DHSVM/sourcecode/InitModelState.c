@@ -10,12 +10,17 @@
  *               or a saved state from an earlier model run
  * DESCRIP-END.
  * FUNCTIONS:    InitModelState()
+ *               ReadStateMaps()
+ *               StateFileName()
+ *               ReadCheckpointFile()
+ *               ReadModelCheckpoint()
  *
  * $Id: InitModelState.c, v 3.1.1  2013/1/4   Ning Exp $
  ******************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "settings.h"
 #include "data.h"
 #include "DHSVMerror.h"
@@ -26,6 +31,20 @@
 #include "soilmoisture.h"
 #include "varid.h"
 
+static void ReadStateMaps(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options,
+  PRECIPPIX **PrecipMap, SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER Soil,
+  SOILTABLE *SType, VEGPIX **VegMap, LAYER Veg, char *Path,
+  TOPOPIX **TopoMap, UNITHYDRINFO *HydrographInfo, float *Hydrograph);
+static void StateFileName(char *FileName, char *Path, char *Kind, char *Str);
+static char *ReadCheckpointFile(char *Path, DATE *Date, MAPSIZE *Map,
+  LAYER Veg, LAYER Soil, ChannelNetwork *StreamNet, int NHydro,
+  char *FileName, size_t *NBytes);
+static void ReadModelCheckpoint(DATE *Start, MAPSIZE *Map,
+  OPTIONSTRUCT *Options, PRECIPPIX **PrecipMap, SNOWPIX **SnowMap,
+  SOILPIX **SoilMap, LAYER Soil, SOILTABLE *SType, VEGPIX **VegMap,
+  LAYER Veg, char *Path, UNITHYDRINFO *HydrographInfo, float *Hydrograph,
+  ChannelNetwork *StreamNet);
+
  /*****************************************************************************
    Function name: InitModelState()
 
@@ -45,12 +64,92 @@
      routine StoreModelState().  Timesteps at which to dump the model state
      can be specified in the file with dump information.
 
+     With STATE FORMAT = CHECKPOINT the state, including the storage (and
+     the flows) of the stream segments, is read from the single file written
+     by StoreModelCheckpoint() instead.
+
  *****************************************************************************/
 void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX **PrecipMap,
   SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER Soil, SOILTABLE *SType,
   VEGPIX **VegMap, LAYER Veg, VEGTABLE *VType, char *Path, SNOWTABLE *SnowAlbedo,
   TOPOPIX **TopoMap, ROADSTRUCT **Network, UNITHYDRINFO *HydrographInfo,
-  float *Hydrograph)
+  float *Hydrograph, ChannelNetwork *StreamNet)
+{
+  int x;				 /* counter */
+  int y;				 /* counter */
+  float remove;
+
+  printf("Restoring model state\n");
+
+  if (Options->StateFormat == STATE_CHECKPOINT)
+    ReadModelCheckpoint(Start, Map, Options, PrecipMap, SnowMap, SoilMap,
+			Soil, SType, VegMap, Veg, Path, HydrographInfo,
+			Hydrograph, StreamNet);
+  else
+    ReadStateMaps(Start, Map, Options, PrecipMap, SnowMap, SoilMap, Soil,
+		  SType, VegMap, Veg, Path, TopoMap, HydrographInfo,
+		  Hydrograph);
+
+  /* The snow albedo follows from the restored snow pack */
+  for (y = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
+      if (INBASIN(TopoMap[y][x].Mask)) {
+        if (SnowMap[y][x].HasSnow)
+          SnowMap[y][x].Albedo = CalcSnowAlbedo(SnowMap[y][x].TSurf, SnowMap[y][x].LastSnow, SnowAlbedo);
+        else
+          SnowMap[y][x].Albedo = 0;
+      }
+    }
+  }
+
+  /* Calculate the water table depth at each point based on the soil moisture profile. Give an error message if the water
+  ponds on the surface since that should not be allowed at this point */
+  remove = 0.0;
+  for (y = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
+      /* SatFlow needs to be initialized properly in the future.
+      For now it will just be set to zero here */
+      SoilMap[y][x].SatFlow = 0.0;
+      if (INBASIN(TopoMap[y][x].Mask)) {
+        if ((SoilMap[y][x].TableDepth =
+          WaterTableDepth((Soil.NLayers[SoilMap[y][x].Soil - 1]), SoilMap[y][x].Depth,
+            VType[VegMap[y][x].Veg - 1].RootDepth, SType[SoilMap[y][x].Soil - 1].Porosity,
+            SType[SoilMap[y][x].Soil - 1].FCap, Network[y][x].Adjust, SoilMap[y][x].Moist, NULL)) < 0.0)
+          /* ReportError((char *) Routine, 35); */ {
+            remove -= SoilMap[y][x].TableDepth * Map->DX * Map->DY;
+            SoilMap[y][x].TableDepth = 0.0;
+        }
+      }
+      else {
+        SoilMap[y][x].TableDepth = 0;
+      }
+    }
+  }
+  if (remove > 0.0) {
+    printf("WARNING:excess water in soil profile is %f m^3 \n", remove);
+    printf("Expect possible large flood wave during first timesteps \n\n");
+  }
+
+  // Initialize the flood detention storage in each pixel for impervious fraction > 0 situation. 
+  for (y = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
+      SoilMap[y][x].DetentionStorage = 0.0;
+      SoilMap[y][x].DetentionIn = 0.0;
+      SoilMap[y][x].DetentionOut = 0.0;
+    }
+  }
+}
+
+/*****************************************************************************
+  Function name: ReadStateMaps()
+
+  Purpose      : Read the model state from the Interception, Snow, Soil and
+                 Hydrograph state files written by StoreModelState()
+ *****************************************************************************/
+static void ReadStateMaps(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options,
+  PRECIPPIX **PrecipMap, SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER Soil,
+  SOILTABLE *SType, VEGPIX **VegMap, LAYER Veg, char *Path,
+  TOPOPIX **TopoMap, UNITHYDRINFO *HydrographInfo, float *Hydrograph)
 {
   const char *Routine = "InitModelState";
   char Str[NAMESIZE + 1];
@@ -62,12 +161,9 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   int NSet;				 /* Number of dataset to be read */
   int NSoil;			 /* Number of soil layers for current pixel */
   int NVeg;				 /* Number of veg layers for current pixel */
-  float remove;
   void *Array;
   MAPDUMP DMap;			 /* Dump Info */
 
-  printf("Restoring model state\n");
-
   /* Restore canopy interception */
   NSet = 0;
   if (DEBUG)
@@ -76,7 +172,7 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   sprintf(Str, "%02d.%02d.%02d.%02d.%02d.%02d", Start->Month, Start->Day,
     Start->Year, Start->Hour, Start->Min, Start->Sec);
 
-  sprintf(FileName, "%sInterception.State.%s%s", Path, Str, fileext);
+  StateFileName(FileName, Path, "Interception", Str);
 
   DMap.ID = 202;
   DMap.Layer = 0;
@@ -91,7 +187,8 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
     DMap.Resolution = MAP_OUTPUT;
     strcpy(DMap.FileName, "");
     GetVarAttr(&DMap);
-    Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
+    ReadBasinMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name,
+		    0);
     for (y = 0; y < Map->NY; y++) {
       for (x = 0; x < Map->NX; x++) {
         if (INBASIN(TopoMap[y][x].Mask)) {
@@ -117,7 +214,8 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
     DMap.Resolution = MAP_OUTPUT;
     strcpy(DMap.FileName, "");
     GetVarAttr(&DMap);
-    Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
+    ReadBasinMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name,
+		    0);
     for (y = 0; y < Map->NY; y++) {
       for (x = 0; x < Map->NX; x++) {
         if (INBASIN(TopoMap[y][x].Mask)) {
@@ -141,7 +239,8 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
+  ReadBasinMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name,
+		  0);
   for (y = 0; y < Map->NY; y++) {
     for (x = 0; x < Map->NX; x++) {
       if (INBASIN(TopoMap[y][x].Mask)) {
@@ -162,7 +261,7 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   if (DEBUG)
     printf("Restoring snow pack conditions\n");
 
-  sprintf(FileName, "%sSnow.State.%s%s", Path, Str, fileext);
+  StateFileName(FileName, Path, "Snow", Str);
 
   DMap.ID = 401;
   DMap.Resolution = MAP_OUTPUT;
@@ -170,20 +269,15 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   GetVarAttr(&DMap);
   if (!(Array = (float *)calloc(Map->NY * Map->NX, SizeOfNumberType(DMap.NumberType))))
     ReportError((char *)Routine, 1);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SnowMap[y][x].HasSnow = (unsigned char)((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SnowMap, SNOWPIX, HasSnow, NC_BYTE));
 
   DMap.ID = 403;
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
+  ReadBasinMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name,
+		  0);
   for (y = 0; y < Map->NY; y++) {
     for (x = 0; x < Map->NX; x++) {
       if (INBASIN(TopoMap[y][x].Mask)) {
@@ -196,99 +290,51 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SnowMap[y][x].Swq = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SnowMap, SNOWPIX, Swq, NC_FLOAT));
 
   DMap.ID = 406;
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SnowMap[y][x].PackWater = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SnowMap, SNOWPIX, PackWater, NC_FLOAT));
 
   DMap.ID = 407;
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SnowMap[y][x].TPack = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SnowMap, SNOWPIX, TPack, NC_FLOAT));
 
   DMap.ID = 408;
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SnowMap[y][x].SurfWater = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SnowMap, SNOWPIX, SurfWater, NC_FLOAT));
 
   DMap.ID = 409;
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SnowMap[y][x].TSurf = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SnowMap, SNOWPIX, TSurf, NC_FLOAT));
 
   DMap.ID = 410;
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SnowMap[y][x].ColdContent = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SnowMap, SNOWPIX, ColdContent, NC_FLOAT));
   free(Array);
 
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        if (SnowMap[y][x].HasSnow)
-          SnowMap[y][x].Albedo = CalcSnowAlbedo(SnowMap[y][x].TSurf, SnowMap[y][x].LastSnow, SnowAlbedo);
-        else
-          SnowMap[y][x].Albedo = 0;
-      }
-    }
-  }
-
   /* Restore soil conditions */
   NSet = 0;
   if (DEBUG)
     printf("Restoring soil conditions\n");
 
-  sprintf(FileName, "%sSoil.State.%s%s", Path, Str, fileext);
+  StateFileName(FileName, Path, "Soil", Str);
   DMap.ID = 501;
   DMap.Layer = 0;
   DMap.Resolution = MAP_OUTPUT;
@@ -303,7 +349,8 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
     DMap.Resolution = MAP_OUTPUT;
     strcpy(DMap.FileName, "");
     GetVarAttr(&DMap);
-    Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
+    ReadBasinMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name,
+		    0);
     for (y = 0; y < Map->NY; y++) {
       for (x = 0; x < Map->NX; x++) {
         if (INBASIN(TopoMap[y][x].Mask)) {
@@ -336,14 +383,8 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SoilMap[y][x].TSurf = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SoilMap, SOILPIX, TSurf, NC_FLOAT));
 
   for (i = 0; i < Soil.MaxLayers; i++) {
     DMap.ID = 511;
@@ -351,7 +392,8 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
     DMap.Resolution = MAP_OUTPUT;
     strcpy(DMap.FileName, "");
     GetVarAttr(&DMap);
-    Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
+    ReadBasinMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name,
+		    0);
     for (y = 0; y < Map->NY; y++) {
       for (x = 0; x < Map->NX; x++) {
         if (INBASIN(TopoMap[y][x].Mask)) {
@@ -366,74 +408,290 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options, PRECIPPIX
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SoilMap[y][x].Qst = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SoilMap, SOILPIX, Qst, NC_FLOAT));
 
   DMap.ID = 512;
   DMap.Resolution = MAP_OUTPUT;
   strcpy(DMap.FileName, "");
   GetVarAttr(&DMap);
-  Read2DMatrix(FileName, Array, DMap.NumberType, Map, NSet++, DMap.Name, 0);
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        SoilMap[y][x].IExcess = ((float *)Array)[y * Map->NX + x];
-      }
-    }
-  }
+  ReadBasinField(FileName, DMap.NumberType, Map, NSet++, DMap.Name, 0,
+		 MAP_FIELD(SoilMap, SOILPIX, IExcess, NC_FLOAT));
   free(Array);
 
-  /* Calculate the water table depth at each point based on the soil moisture profile. Give an error message if the water
-  ponds on the surface since that should not be allowed at this point */
-  remove = 0.0;
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      /* SatFlow needs to be initialized properly in the future.
-      For now it will just be set to zero here */
-      SoilMap[y][x].SatFlow = 0.0;
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        if ((SoilMap[y][x].TableDepth =
-          WaterTableDepth((Soil.NLayers[SoilMap[y][x].Soil - 1]), SoilMap[y][x].Depth,
-            VType[VegMap[y][x].Veg - 1].RootDepth, SType[SoilMap[y][x].Soil - 1].Porosity,
-            SType[SoilMap[y][x].Soil - 1].FCap, Network[y][x].Adjust, SoilMap[y][x].Moist)) < 0.0)
-          /* ReportError((char *) Routine, 35); */ {
-            remove -= SoilMap[y][x].TableDepth * Map->DX * Map->DY;
-            SoilMap[y][x].TableDepth = 0.0;
-        }
-      }
-      else {
-        SoilMap[y][x].TableDepth = 0;
-      }
-    }
-  }
-  if (remove > 0.0) {
-    printf("WARNING:excess water in soil profile is %f m^3 \n", remove);
-    printf("Expect possible large flood wave during first timesteps \n\n");
-  }
-
-  /* If the unit hydrograph is used for flow routing, initialize the unit hydrograph array */
-  if (Options->Extent == BASIN && Options->HasNetwork == FALSE) {
+  /* If the unit hydrograph is used for flow routing, initialize the unit
+     hydrograph array (there is none with SNOW ONLY) */
+  if (Options->Extent == BASIN && Options->HasNetwork == FALSE &&
+      Hydrograph != NULL) {
     sprintf(FileName, "%sHydrograph.State.%s", Path, Str);
     OpenFile(&HydroStateFile, FileName, "r", FALSE);
     for (i = 0; i < HydrographInfo->TotalWaveLength; i++)
       fscanf(HydroStateFile, "%f\n", &(Hydrograph[i]));
     fclose(HydroStateFile);
   }
-  // Initialize the flood detention storage in each pixel for impervious fraction > 0 situation. 
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      SoilMap[y][x].DetentionStorage = 0.0;
-      SoilMap[y][x].DetentionIn = 0.0;
-      SoilMap[y][x].DetentionOut = 0.0;
-    }
-  }
 }
 
+/*****************************************************************************
+  Function name: StateFileName()
+
+  Purpose      : Name of the Kind state file of date Str in directory Path
+
+  Comments     : Without a Zarr store of FILE FORMAT ZARR the binary file is
+                 read, so that the initial states of a basin do not have to
+                 be converted (see Read2DMatrixZarr())
+ *****************************************************************************/
+static void StateFileName(char *FileName, char *Path, char *Kind, char *Str)
+{
+  struct stat Info;
+
+  sprintf(FileName, "%s%s.State.%s%s", Path, Kind, Str, fileext);
+  if (strcmp(fileext, ".zarr") == 0 && stat(FileName, &Info) != 0)
+    sprintf(FileName, "%s%s.State.%s.bin", Path, Kind, Str);
+}
+
+/*****************************************************************************
+  Function name: ReadCheckpointFile()
+
+  Purpose      : Read the full or delta checkpoint for Date into memory with
+                 one fread and check its header against the model setup.
+                 The stream segments are matched by the hash of their ids
+                 in routing order, so their values can be copied by index
+
+  Returns      : The file contents, NBytes in size; FileName is set to the
+                 name of the file
+ *****************************************************************************/
+static char *ReadCheckpointFile(char *Path, DATE *Date, MAPSIZE *Map,
+  LAYER Veg, LAYER Soil, ChannelNetwork *StreamNet, int NHydro,
+  char *FileName, size_t *NBytes)
+{
+  const char *Routine = "ReadCheckpointFile";
+  FILE *InFile;
+  char *Buffer;
+  unint *Header;
+  size_t NMagic;
+  long FileSize;
+
+  sprintf(FileName, "%sModel.State.%02d.%02d.%04d.%02d.%02d.%02d.chk", Path,
+	  Date->Month, Date->Day, Date->Year, Date->Hour, Date->Min,
+	  Date->Sec);
+  OpenFile(&InFile, FileName, "rb", FALSE);
+  if (fseek(InFile, 0L, SEEK_END) != 0 || (FileSize = ftell(InFile)) < 0)
+    ReportError(FileName, 2);
+  rewind(InFile);
+
+  NMagic = strlen(CHECKPOINT_MAGIC);
+  *NBytes = (size_t) FileSize;
+  if (*NBytes < NMagic + NCHKHEADER * sizeof(unint))
+    ReportError(FileName, 74);
+  if (!(Buffer = (char *) malloc(*NBytes)))
+    ReportError((char *) Routine, 1);
+  if (fread(Buffer, 1, *NBytes, InFile) != *NBytes)
+    ReportError(FileName, 2);
+  fclose(InFile);
+
+  Header = (unint *) (Buffer + NMagic);
+  if ((strncmp(Buffer, CHECKPOINT_MAGIC, NMagic) != 0 &&
+       strncmp(Buffer, CHECKPOINT_DELTA_MAGIC, NMagic) != 0) ||
+      Header[chk_version] != CHECKPOINT_VERSION ||
+      Header[chk_headersum] != CheckpointSum(CHECKPOINT_SEED, Header,
+					     chk_headersum))
+    ReportError(FileName, 74);
+
+  /* the checkpoint has to come from the same basin and model setup */
+  if (Header[chk_ny] != (unint) Map->NY ||
+      Header[chk_nx] != (unint) Map->NX ||
+      Header[chk_nactive] != (unint) Map->NumActive ||
+      Header[chk_geomhash] != CheckpointGeometry(Map) ||
+      Header[chk_veglayers] != (unint) Veg.MaxLayers ||
+      Header[chk_soillayers] != (unint) Soil.MaxLayers ||
+      Header[chk_nchannel] != (unint) (StreamNet != NULL ? StreamNet->nseg : 0) ||
+      Header[chk_nethash] != CheckpointNetwork(StreamNet) ||
+      (Header[chk_channelvars] != CHKCHANNEL_STORAGE &&
+       Header[chk_channelvars] != CHKCHANNEL_FLOWS) ||
+      Header[chk_nhydro] != (unint) NHydro ||
+      Header[chk_year] != (unint) Date->Year ||
+      Header[chk_month] != (unint) Date->Month ||
+      Header[chk_day] != (unint) Date->Day ||
+      Header[chk_hour] != (unint) Date->Hour)
+    ReportError(FileName, 75);
+
+  return Buffer;
+}
 
+/*****************************************************************************
+  Function name: ReadModelCheckpoint()
 
+  Purpose      : Read the model state from the checkpoint written by
+                 StoreModelCheckpoint()
+
+  Comments     : Each file is read into memory with one fread.  A delta
+                 checkpoint is applied to the full checkpoint it names.  A
+                 file with a bad magic, version or checksum, or one that
+                 belongs to a different basin, layer setup, channel network
+                 or base, stops the model before any state is changed.
+ *****************************************************************************/
+static void ReadModelCheckpoint(DATE *Start, MAPSIZE *Map,
+  OPTIONSTRUCT *Options, PRECIPPIX **PrecipMap, SNOWPIX **SnowMap,
+  SOILPIX **SoilMap, LAYER Soil, SOILTABLE *SType, VEGPIX **VegMap,
+  LAYER Veg, char *Path, UNITHYDRINFO *HydrographInfo, float *Hydrograph,
+  ChannelNetwork *StreamNet)
+{
+  char FileName[NAMESIZE + 1];
+  char BaseName[NAMESIZE + 1];
+  char *Buffer;
+  char *BaseBuffer;
+  unint *Header;
+  unint *Data;
+  float *Plane;
+  ChannelRoute *Route;
+  DATE Base;
+  size_t NMagic;
+  size_t NWords;
+  size_t NBytes;
+  size_t NBaseBytes;
+  int NPlanes;
+  int NChannel;
+  int NChannelVars;
+  int NHydro;
+  int NSoil;
+  int NVeg;
+  int Soiltype;
+  int i;
+  int k;
+  int x;
+  int y;
+
+  if (DEBUG)
+    printf("Restoring model checkpoint\n");
+
+  NChannel = (StreamNet != NULL) ? StreamNet->nseg : 0;
+  NHydro = (Options->Extent == BASIN && Options->HasNetwork == FALSE) ?
+    HydrographInfo->TotalWaveLength : 0;
+  NPlanes = 2 * Veg.MaxLayers + 1 + 8 + (Soil.MaxLayers + 1) + 1 +
+    Soil.MaxLayers + 2;
+  NMagic = strlen(CHECKPOINT_MAGIC);
+
+  Buffer = ReadCheckpointFile(Path, Start, Map, Veg, Soil, StreamNet, NHydro,
+			      FileName, &NBytes);
+  Header = (unint *) (Buffer + NMagic);
+  Data = Header + NCHKHEADER;
+  NChannelVars = (int) Header[chk_channelvars];
+  NWords = (size_t) NPlanes * Map->NumActive +
+    (size_t) NChannelVars * NChannel + NHydro;
+
+  if (strncmp(Buffer, CHECKPOINT_DELTA_MAGIC, NMagic) == 0) {
+    /* a delta checkpoint is applied to its base */
+    Base.Year = (int) Header[chk_baseyear];
+    Base.Month = (int) Header[chk_basemonth];
+    Base.Day = (int) Header[chk_baseday];
+    Base.Hour = (int) Header[chk_basehour];
+    Base.Min = (int) Header[chk_basemin];
+    Base.Sec = (int) Header[chk_basesec];
+    BaseBuffer = ReadCheckpointFile(Path, &Base, Map, Veg, Soil, StreamNet,
+				    NHydro, BaseName, &NBaseBytes);
+    Data = (unint *) (BaseBuffer + NMagic) + NCHKHEADER;
+    if (strncmp(BaseBuffer, CHECKPOINT_MAGIC, NMagic) != 0 ||
+	((unint *) (BaseBuffer + NMagic))[chk_datasum] != Header[chk_basesum] ||
+	((unint *) (BaseBuffer + NMagic))[chk_channelvars] !=
+	Header[chk_channelvars])
+      ReportError(BaseName, 75);
+    if (NBaseBytes != NMagic + (NCHKHEADER + NWords) * sizeof(unint) ||
+	Header[chk_basesum] != CheckpointSum(CHECKPOINT_SEED, Data, NWords))
+      ReportError(BaseName, 76);
+    if (!DecodeCheckpointDelta((unsigned char *) (Header + NCHKHEADER),
+			       NBytes - NMagic - NCHKHEADER * sizeof(unint),
+			       Data, NWords) ||
+	Header[chk_datasum] != CheckpointSum(CHECKPOINT_SEED, Data, NWords))
+      ReportError(FileName, 76);
+    free(Buffer);
+    Buffer = BaseBuffer;
+  }
+  else if (NBytes != NMagic + (NCHKHEADER + NWords) * sizeof(unint) ||
+	   Header[chk_datasum] != CheckpointSum(CHECKPOINT_SEED, Data, NWords))
+    ReportError(FileName, 76);
+
+  /* Restore canopy interception */
+  Plane = (float *) Data;
+  for (i = 0; i < Veg.MaxLayers; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      NVeg = Veg.NLayers[(VegMap[y][x].Veg - 1)];
+      PrecipMap[y][x].IntRain[i] = (i < NVeg) ? MAX(Plane[k], 0.0) : 0.0;
+    }
+  }
+  for (i = 0; i < Veg.MaxLayers; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      NVeg = Veg.NLayers[(VegMap[y][x].Veg - 1)];
+      PrecipMap[y][x].IntSnow[i] = (i < NVeg) ? MAX(Plane[k], 0.0) : 0.0;
+    }
+  }
+
+  /* Restore snow pack conditions */
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    PrecipMap[y][x].TempIntStorage = MAX(Plane[k], 0.0);
+    SnowMap[y][x].HasSnow = (unsigned char) Plane[k + Map->NumActive];
+    SnowMap[y][x].LastSnow = (unsigned short) Plane[k + 2 * Map->NumActive];
+    SnowMap[y][x].Swq = Plane[k + 3 * Map->NumActive];
+    SnowMap[y][x].PackWater = Plane[k + 4 * Map->NumActive];
+    SnowMap[y][x].TPack = Plane[k + 5 * Map->NumActive];
+    SnowMap[y][x].SurfWater = Plane[k + 6 * Map->NumActive];
+    SnowMap[y][x].TSurf = Plane[k + 7 * Map->NumActive];
+    SnowMap[y][x].ColdContent = Plane[k + 8 * Map->NumActive];
+  }
+  Plane += 9 * Map->NumActive;
+
+  /* Restore soil conditions, with the same limits as the state maps */
+  for (i = 0; i < Soil.MaxLayers + 1; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      Soiltype = SoilMap[y][x].Soil - 1;
+      NSoil = Soil.NLayers[Soiltype];
+      if (i <= NSoil)
+	SoilMap[y][x].Moist[i] = MAX(Plane[k], 0.0);
+      if (i == NSoil && SoilMap[y][x].Moist[i] < SType[Soiltype].FCap[NSoil - 1])
+	SoilMap[y][x].Moist[i] = SType[Soiltype].FCap[NSoil - 1];
+      if (i < NSoil && SoilMap[y][x].Moist[i] < SType[Soiltype].WP[NSoil - 1])
+	SoilMap[y][x].Moist[i] = SType[Soiltype].WP[NSoil - 1];
+    }
+  }
+  for (k = 0; k < Map->NumActive; k++)
+    SoilMap[Map->ActiveCells[k].y][Map->ActiveCells[k].x].TSurf = Plane[k];
+  Plane += Map->NumActive;
+  for (i = 0; i < Soil.MaxLayers; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      NSoil = Soil.NLayers[(SoilMap[y][x].Soil - 1)];
+      if (i < NSoil)
+	SoilMap[y][x].Temp[i] = Plane[k];
+    }
+  }
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    SoilMap[y][x].Qst = Plane[k];
+    SoilMap[y][x].IExcess = Plane[k + Map->NumActive];
+  }
+  Plane += 2 * Map->NumActive;
+
+  /* Restore the channel state, in routing order, and the unit hydrograph */
+  for (k = 0; k < NChannel; k++) {
+    Route = StreamNet->route[k];
+    Route->storage = Plane[k];
+    if (NChannelVars == CHKCHANNEL_FLOWS) {
+      Route->inflow = Plane[k + NChannel];
+      Route->outflow = Plane[k + 2 * NChannel];
+    }
+  }
+  Plane += (size_t) NChannelVars * NChannel;
+  for (i = 0; i < NHydro; i++)
+    Hydrograph[i] = Plane[i];
+
+  free(Buffer);
+}
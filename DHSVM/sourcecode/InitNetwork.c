@@ -10,28 +10,41 @@
  *               necessary adjustments for the soil profile are calculated
  * DESCRIP-END.
  * FUNCTIONS:    InitNetwork()
+ *               InitDrains()
  * COMMENTS:
  * $Id: InitNetwork.c,v 1.8 2004/05/03 03:28:45 colleen Exp $
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "constants.h"
 #include "settings.h"
 #include "data.h"
 #include "DHSVMerror.h"
 #include "functions.h"
+#include "memaccount.h"
+#include "nearestchannel.h"
 #include "settings.h"
+#include "slopeaspect.h"
 #include "soilmoisture.h"
 #include "DHSVMChannel.h"
 
+static void InitDrains(int NY, int NX, TOPOPIX **TopoMap,
+		       CHANNEL *ChannelData, int Method);
+
  /*****************************************************************************
    Function name: InitNetwork()
 
    Purpose      : Initialize road/channel work.  Memory is allocated, and the
                   necessary adjustments for the soil profile are calculated
 
-   Comments     :
+   Comments     : Only the cells with a road or channel cut get their own
+                  Adjust and PercArea arrays.  All the other cells have no
+                  correction, and share one array of ones that is as long as
+                  the profile with the most soil layers.  The arrays are only
+                  read after this, so the sharing is safe.  With SNOW ONLY
+                  all the rows of the map are one row
  *****************************************************************************/
 void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
   SOILPIX **SoilMap, VEGPIX **VegMap, VEGTABLE *VType,
@@ -49,33 +62,37 @@ void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
                 with a road and channel */
   int numroadschan;      /* Counter of number of pixels
                 with a road */
+  int numcuts;           /* Counter of number of pixels with a cut */
+  int MaxLayers;         /* Most soil layers of a vegetation type */
+  float *NoCut;          /* Adjust and PercArea of the cells without a cut */
   FILE *inputfile;
   /* Allocate memory for network structure */
 
-  if (!(*Network = (ROADSTRUCT **)calloc(NY, sizeof(ROADSTRUCT *))))
+  if (!(*Network = (ROADSTRUCT **)TaggedCalloc(NY, sizeof(ROADSTRUCT *),
+					       MEM_NETWORK)))
     ReportError((char *)Routine, 1);
 
+  /* with SNOW ONLY there is no network and nothing is routed, so the
+     cells are all alike and all the rows share one */
   for (y = 0; y < NY; y++) {
-    if (!((*Network)[y] = (ROADSTRUCT *)calloc(NX, sizeof(ROADSTRUCT))))
+    if (Options->SnowOnly && y > 0)
+      (*Network)[y] = (*Network)[0];
+    else if (!((*Network)[y] = (ROADSTRUCT *)TaggedCalloc(NX, sizeof(ROADSTRUCT),
+							  MEM_NETWORK)))
       ReportError((char *)Routine, 1);
   }
 
-  for (y = 0; y < NY; y++) {
-    for (x = 0; x < NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-        if (!((*Network)[y][x].Adjust =
-          (float *)calloc((VType[VegMap[y][x].Veg - 1].NSoilLayers + 1), sizeof(float))))
-          ReportError((char *)Routine, 1);
-
-        if (!((*Network)[y][x].PercArea =
-          (float *)calloc((VType[VegMap[y][x].Veg - 1].NSoilLayers + 1), sizeof(float))))
-          ReportError((char *)Routine, 1);
-      }
-    }
-  }
+  for (i = 0, MaxLayers = 0; i < Veg.NTypes; i++)
+    MaxLayers = MAX(MaxLayers, VType[i].NSoilLayers);
+  if (!(NoCut = (float *)ArenaCalloc(MaxLayers + 1, sizeof(float),
+                                     MEM_NETWORK)))
+    ReportError((char *)Routine, 1);
+  for (i = 0; i <= MaxLayers; i++)
+    NoCut[i] = 1.0;
 
   numroadschan = 0;
   numroads = 0;
+  numcuts = 0;
 
   /* If a road/channel Network is imposed on the area, read the Network
      information, and calculate the storage adjustment factors */
@@ -84,14 +101,29 @@ void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
       for (x = 0; x < NX; x++) {
         if (INBASIN(TopoMap[y][x].Mask)) {
           ChannelCut(y, x, ChannelData, &((*Network)[y][x]));
-          AdjustStorage(VType[VegMap[y][x].Veg - 1].NSoilLayers,
-            SoilMap[y][x].Depth,
-            VType[VegMap[y][x].Veg - 1].RootDepth,
-            (*Network)[y][x].Area, DX, DY,
-            (*Network)[y][x].BankHeight,
-            (*Network)[y][x].PercArea,
-            (*Network)[y][x].Adjust,
-            &((*Network)[y][x].CutBankZone));
+          /* without a cut CutBankGeometry() leaves all the layers at one */
+          if ((*Network)[y][x].BankHeight > 0.0) {
+            if (!((*Network)[y][x].Adjust =
+              (float *)ArenaCalloc(VType[VegMap[y][x].Veg - 1].NSoilLayers + 1,
+                                   sizeof(float), MEM_NETWORK)) ||
+                !((*Network)[y][x].PercArea =
+              (float *)ArenaCalloc(VType[VegMap[y][x].Veg - 1].NSoilLayers + 1,
+                                   sizeof(float), MEM_NETWORK)))
+              ReportError((char *)Routine, 1);
+            AdjustStorage(VType[VegMap[y][x].Veg - 1].NSoilLayers,
+              SoilMap[y][x].Depth,
+              VType[VegMap[y][x].Veg - 1].RootDepth,
+              (*Network)[y][x].Area, DX, DY,
+              (*Network)[y][x].BankHeight,
+              (*Network)[y][x].PercArea,
+              (*Network)[y][x].Adjust,
+              &((*Network)[y][x].CutBankZone));
+            numcuts++;
+          }
+          else {
+            (*Network)[y][x].Adjust = NoCut;
+            (*Network)[y][x].PercArea = NoCut;
+          }
           (*Network)[y][x].IExcess = 0.;
           if (channel_grid_has_channel(ChannelData->road_map, x, y)) {
             numroads++;
@@ -128,12 +160,10 @@ void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
     for (y = 0; y < NY; y++) {
       for (x = 0; x < NX; x++) {
         if (INBASIN(TopoMap[y][x].Mask)) {
-          for (i = 0; i <= VType[VegMap[y][x].Veg - 1].NSoilLayers; i++) {
-            (*Network)[y][x].Adjust[i] = 1.0;
-            (*Network)[y][x].PercArea[i] = 1.0;
-            (*Network)[y][x].CutBankZone = NO_CUT;
-            (*Network)[y][x].MaxInfiltrationRate = 0.;
-          }
+          (*Network)[y][x].Adjust = NoCut;
+          (*Network)[y][x].PercArea = NoCut;
+          (*Network)[y][x].CutBankZone = NO_CUT;
+          (*Network)[y][x].MaxInfiltrationRate = 0.;
           (*Network)[y][x].FlowSlope = 0.;
           (*Network)[y][x].FlowLength = 0.;
           (*Network)[y][x].RoadArea = 0.;
@@ -148,6 +178,8 @@ void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
     printf("There are %d pixels with a road and %d with a road and a channel.\n",
       numroads, numroadschan);
   }
+  if (numcuts > 0)
+    printf("There are %d pixels with a road or channel cut.\n", numcuts);
 
   /* this all pertains to the impervious surface */
 
@@ -156,7 +188,12 @@ void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
     if (VType[i].ImpervFrac > 0.0)
       doimpervious = 1;
 
-  if (doimpervious) {
+  if (doimpervious && strcmp(Options->ImperviousFilePath, "FLOW") == 0)
+    InitDrains(NY, NX, TopoMap, ChannelData, NEAREST_FLOW);
+  else if (doimpervious &&
+	   strcmp(Options->ImperviousFilePath, "DISTANCE") == 0)
+    InitDrains(NY, NX, TopoMap, ChannelData, NEAREST_DISTANCE);
+  else if (doimpervious) {
     if (!(inputfile = fopen(Options->ImperviousFilePath, "rt"))) {
       fprintf(stderr,
         "User has specified a percentage impervious area \n");
@@ -171,7 +208,11 @@ void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
       fprintf(stderr,
         "This file was not found: see InitNetwork.c \n");
       fprintf(stderr,
-        "The code find_nearest_channel.c will make the file\n");
+        "The code find_nearest_channel.c will make the file,\n");
+      fprintf(stderr,
+        "or enter FLOW (the first channel down the flow path) or\n");
+      fprintf(stderr,
+        "DISTANCE (the nearest channel) to have DHSVM find them\n");
       ReportError(Options->ImperviousFilePath, 3);
     }
     for (y = 0; y < NY; y++) {
@@ -193,3 +234,75 @@ void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap,
     }
   }
 }
+
+/*****************************************************************************
+  Function name: InitDrains()
+
+  Purpose      : Find the channel cell the impervious runoff of each cell
+                 drains to (drains_x, drains_y), instead of reading them
+                 from the IMPERVIOUS SURFACE ROUTING FILE
+
+  Comments     : See NearestChannel.c.  The flow directions are those of
+                 the surface flow, TopoMap[y][x].Dir
+*****************************************************************************/
+static void InitDrains(int NY, int NX, TOPOPIX **TopoMap,
+		       CHANNEL *ChannelData, int Method)
+{
+  const char *Routine = "InitDrains";
+  unsigned char *InBasin;
+  unsigned char *Channel;
+  unsigned char *Down;
+  int *DrainsY;
+  int *DrainsX;
+  int Bit[NDIRS];
+  int NLost;
+  int i;
+  int j;
+  int k;
+  int x;
+  int y;
+
+  if (!(InBasin = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(Channel = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(Down = (unsigned char *) calloc(NY * NX, sizeof(unsigned char))) ||
+      !(DrainsY = (int *) calloc(NY * NX, sizeof(int))) ||
+      !(DrainsX = (int *) calloc(NY * NX, sizeof(int))))
+    ReportError((char *) Routine, 1);
+
+  /* the neighbors of the flow directions among those of NearestChannel() */
+  for (k = 0; k < NDIRS; k++)
+    for (j = 0; j < NEAREST_NDIRS; j++)
+      if (NearestDX[j] == xdirection[k] && NearestDY[j] == ydirection[k])
+	Bit[k] = j;
+
+  for (y = 0, i = 0; y < NY; y++) {
+    for (x = 0; x < NX; x++, i++) {
+      InBasin[i] = INBASIN(TopoMap[y][x].Mask);
+      Channel[i] = channel_grid_has_channel(ChannelData->stream_map, x, y);
+      for (k = 0; k < NDIRS; k++)
+	if (TopoMap[y][x].Dir[k] > 0)
+	  Down[i] |= 1 << Bit[k];
+    }
+  }
+
+  NLost = NearestChannel(NY, NX, Method, InBasin, Channel, Down,
+			 DrainsY, DrainsX);
+  if (NLost > 0)
+    printf("%d pixels leave the basin before they reach a channel, their "
+	   "impervious runoff goes to the nearest channel\n", NLost);
+
+  for (y = 0, i = 0; y < NY; y++) {
+    for (x = 0; x < NX; x++, i++) {
+      if (InBasin[i]) {
+	TopoMap[y][x].drains_x = DrainsX[i];
+	TopoMap[y][x].drains_y = DrainsY[i];
+      }
+    }
+  }
+
+  free(InBasin);
+  free(Channel);
+  free(Down);
+  free(DrainsY);
+  free(DrainsX);
+}
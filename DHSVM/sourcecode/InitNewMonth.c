@@ -10,9 +10,19 @@
  *               beginning of certain timestep
  * DESCRIP-END.
  * FUNCTIONS:    InitNewMonth()
+ *               ReadShadowMaps()
+ *               StepShadowMaps()
+ *               DaylightSteps()
+ *               ReadShadowSlices()
+ *               InitSolarSchedule()
  *               InitNewDay()
  *               InitNewStep()
- * COMMENTS:
+ *               ReadMM5Maps()
+ *               StepSolarGeometry()
+ * COMMENTS:     The sun of each day of the year and of each step of the day
+ *               is computed once, by InitSolarSchedule(), for the location
+ *               of the basin, and looked up by InitNewDay() and
+ *               StepSolarGeometry()
  * $Id: InitNewMonth.c,v 3.1 2013/02/06 ning Exp $
  */
 
@@ -30,6 +40,36 @@
 #include "slopeaspect.h"
 #include "sizeofnt.h"
 #include "varid.h"
+#include "memaccount.h"
+#include "getinit.h"
+#include "outofcore.h"
+
+static void ReadShadowMaps(TIMESTRUCT *Time, MAPSIZE *Map,
+			   SOLARGEOMETRY *SolarGeo, char *FileName,
+			   char *Scratch, SHADOWMAP *ShadowMap);
+
+/* sun of a time step of a day, as set by SolarHour() */
+typedef struct {
+  float SineSolarAltitude;
+  float SolarTimeStep;
+  float SunMax;
+  float SolarAzimuth;		/* only set with DayLight */
+  int DayLight;
+} SUNSTEP;
+
+/* sun of each day of the year and of each of its time steps for one
+   location and time step */
+static struct {
+  float Latitude;
+  float Longitude;
+  float StandardMeridian;
+  int Dt;
+  int NDaySteps;
+  SOLARGEOMETRY *Day;		/* DAYPYEAR + 1 days, [0] is January 1 */
+  SUNSTEP *Step;		/* NDaySteps steps of each day */
+} Schedule = { 0.0, 0.0, 0.0, 0, 0, NULL, NULL };
+
+static int InSchedule(SOLARGEOMETRY *SolarGeo);
 
  /*****************************************************************************
    InitNewMonth()
@@ -37,21 +77,16 @@
    (diffuse and direct beam), and potentially a new LAI value.
  *****************************************************************************/
 void InitNewMonth(TIMESTRUCT *Time, OPTIONSTRUCT *Options, MAPSIZE *Map,
-  TOPOPIX **TopoMap, float **PrismMap, unsigned char ***ShadowMap, 
-  INPUTFILES *InFiles, int NVegs, VEGTABLE *VType, int NStats,
+  TOPOPIX **TopoMap, float **PrismMap, SHADOWMAP *ShadowMap,
+  SOLARGEOMETRY *SolarGeo, INPUTFILES *InFiles, int NVegs, VEGTABLE *VType, int NStats,
   METLOCATION *Stat, char *Path)
 {
-  const char *Routine = "InitNewMonth";
   char FileName[MAXSTRING + 1];
   char VarName[BUFSIZE + 1];	/* Variable name */
   int i;
   int j;
-  int y, x;
   float a, b, l;
   int NumberType;
-  float *Array = NULL;
-  unsigned char *Array1 = NULL;
-  int flag;
 
   if (DEBUG)
     printf("Initializing new month\n");
@@ -65,43 +100,16 @@ void InitNewMonth(TIMESTRUCT *Time, OPTIONSTRUCT *Options, MAPSIZE *Map,
       Time->Current.Month, Options->PrismDataExt);
     GetVarName(205, 0, VarName);
     GetVarNumberType(205, &NumberType);
-    if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
-      ReportError((char *)Routine, 1);
-    flag = Read2DMatrix(FileName, Array, NumberType, Map, 0, VarName, 0);
-
-    if ((Options->FileFormat == NETCDF && flag == 0)
-      || (Options->FileFormat == BIN)) {
-      for (y = 0, i = 0; y < Map->NY; y++)
-        for (x = 0; x < Map->NX; x++, i++)
-          PrismMap[y][x] = Array[i];
-    }
-    else if (Options->FileFormat == NETCDF && flag == 1) {
-      for (y = Map->NY - 1, i = 0; y >= 0; y--)
-        for (x = 0; x < Map->NX; x++, i++)
-          PrismMap[y][x] = Array[i];
-    }
-    else ReportError((char *)Routine, 57);
-
-    free(Array);
+    Read2DField(FileName, NumberType, Map, 0, VarName, 0,
+		MAP_VALUES(PrismMap, float, NC_FLOAT));
   }
 
-  if (Options->Shading == TRUE) {
+  if (Options->Shading == TRUE && Options->ShadingMode == SHADING_MAPS) {
     printf("reading in new shadow map for month %d \n", Time->Current.Month);
     sprintf(FileName, "%s.%02d.%s", Options->ShadingDataPath,
       Time->Current.Month, Options->ShadingDataExt);
-    GetVarName(304, 0, VarName);
-    GetVarNumberType(304, &NumberType);
-    if (!(Array1 = (unsigned char *)calloc(Map->NY * Map->NX, sizeof(unsigned char))))
-      ReportError((char *)Routine, 1);
-    for (i = 0; i < Time->NDaySteps; i++) {
-      Read2DMatrix(FileName, Array1, NumberType, Map, i, VarName, i);
-      for (y = 0; y < Map->NY; y++) {
-        for (x = 0; x < Map->NX; x++) {
-          ShadowMap[i][y][x] = Array1[y * Map->NX + x];
-        }
-      }
-    }
-    free(Array1);
+    ReadShadowMaps(Time, Map, SolarGeo, FileName, Options->OutOfCoreDir,
+		   ShadowMap);
   }
 
   printf("changing LAI, albedo and diffuse transmission parameters\n");
@@ -117,6 +125,9 @@ void InitNewMonth(TIMESTRUCT *Time, OPTIONSTRUCT *Options, MAPSIZE *Map,
       VType[i].LAI[j] = VType[i].LAIMonthly[j][Time->Current.Month - 1];
       VType[i].MaxInt[j] = VType[i].LAI[j] * VType[i].Fract[j] * LAI_WATER_MULTIPLIER;
       VType[i].Albedo[j] = VType[i].AlbedoMonthly[j][Time->Current.Month - 1];
+      /* the part of the canopy resistance that is the same for all cells,
+         see CanopyFactors() */
+      VType[i].RsRatio[j] = VType[i].RsMin[j] / VType[i].RsMax[j];
     }
     if (VType[i].OverStory) {
       a = VType[i].LeafAngleA;
@@ -135,6 +146,81 @@ void InitNewMonth(TIMESTRUCT *Time, OPTIONSTRUCT *Options, MAPSIZE *Map,
 
 }
 
+/*****************************************************************************
+  Function name: InitSolarSchedule()
+
+  Purpose      : Compute the sun of each day of the year and of each time
+                 step of the day for the location of the basin
+
+  Required     :
+    int Dt                  - Model time step (s)
+    SOLARGEOMETRY *SolarGeo - Location of the basin
+
+  Returns      : void
+
+  Modifies     : the schedule looked up by InitNewDay() and
+                 StepSolarGeometry()
+
+  Comments     : The entries are those of SolarDay() and SolarHour(), so the
+                 lookups give the same sun.  A SOLARGEOMETRY of another
+                 location or time step is still computed.
+*****************************************************************************/
+void InitSolarSchedule(int Dt, SOLARGEOMETRY *SolarGeo)
+{
+  const char *Routine = "InitSolarSchedule";
+  SOLARGEOMETRY Geo;
+  SUNSTEP *Step;
+  int Day;
+  int n;
+
+  free(Schedule.Day);
+  free(Schedule.Step);
+  Schedule.Day = NULL;
+  Schedule.Step = NULL;
+  Schedule.Dt = Dt;
+  Schedule.NDaySteps = SECPDAY / Dt;
+
+  if (!(Schedule.Day = (SOLARGEOMETRY *) calloc(DAYPYEAR + 1,
+						sizeof(SOLARGEOMETRY))) ||
+      !(Step = (SUNSTEP *) calloc((DAYPYEAR + 1) * Schedule.NDaySteps,
+				  sizeof(SUNSTEP))))
+    ReportError((char *) Routine, 1);
+
+  Geo = *SolarGeo;
+  for (Day = 0; Day <= DAYPYEAR; Day++) {
+    SolarDay(Day + 1, Geo.Longitude, Geo.Latitude, Geo.StandardMeridian,
+      &(Geo.NoonHour), &(Geo.Declination), &(Geo.HalfDayLength),
+      &(Geo.Sunrise), &(Geo.Sunset), &(Geo.TimeAdjustment),
+      &(Geo.SunEarthDistance));
+    Schedule.Day[Day] = Geo;
+    for (n = 0; n < Schedule.NDaySteps; n++, Step++) {
+      SolarHour(Geo.Latitude, (n + 1) * ((float)Dt) / SECPHOUR,
+        ((float)Dt) / SECPHOUR, Geo.NoonHour, Geo.Declination, Geo.Sunrise,
+        Geo.Sunset, Geo.TimeAdjustment, Geo.SunEarthDistance,
+        &(Step->SineSolarAltitude), &(Step->DayLight),
+        &(Step->SolarTimeStep), &(Step->SunMax), &(Step->SolarAzimuth));
+    }
+  }
+  Schedule.Step = Step - (DAYPYEAR + 1) * Schedule.NDaySteps;
+
+  Schedule.Latitude = SolarGeo->Latitude;
+  Schedule.Longitude = SolarGeo->Longitude;
+  Schedule.StandardMeridian = SolarGeo->StandardMeridian;
+}
+
+/*****************************************************************************
+  Function name: InSchedule()
+
+  Purpose      : TRUE if the sun of SolarGeo can be looked up in the schedule
+*****************************************************************************/
+static int InSchedule(SOLARGEOMETRY *SolarGeo)
+{
+  return (Schedule.Step != NULL &&
+	  SolarGeo->Latitude == Schedule.Latitude &&
+	  SolarGeo->Longitude == Schedule.Longitude &&
+	  SolarGeo->StandardMeridian == Schedule.StandardMeridian);
+}
+
 /*****************************************************************************
   Function name: InitNewDay()
 
@@ -155,6 +241,20 @@ void InitNewMonth(TIMESTRUCT *Time, OPTIONSTRUCT *Options, MAPSIZE *Map,
 *****************************************************************************/
 void InitNewDay(int DayOfYear, SOLARGEOMETRY * SolarGeo)
 {
+  SOLARGEOMETRY *Day;
+
+  SolarGeo->DayOfYear = DayOfYear;
+  if (InSchedule(SolarGeo) && DayOfYear >= 1 && DayOfYear <= DAYPYEAR + 1) {
+    Day = &(Schedule.Day[DayOfYear - 1]);
+    SolarGeo->NoonHour = Day->NoonHour;
+    SolarGeo->Declination = Day->Declination;
+    SolarGeo->HalfDayLength = Day->HalfDayLength;
+    SolarGeo->Sunrise = Day->Sunrise;
+    SolarGeo->Sunset = Day->Sunset;
+    SolarGeo->TimeAdjustment = Day->TimeAdjustment;
+    SolarGeo->SunEarthDistance = Day->SunEarthDistance;
+    return;
+  }
   SolarDay(DayOfYear, SolarGeo->Longitude, SolarGeo->Latitude,
     SolarGeo->StandardMeridian, &(SolarGeo->NoonHour),
     &(SolarGeo->Declination), &(SolarGeo->HalfDayLength),
@@ -162,6 +262,230 @@ void InitNewDay(int DayOfYear, SOLARGEOMETRY * SolarGeo)
     &(SolarGeo->TimeAdjustment), &(SolarGeo->SunEarthDistance));
 }
 
+/*****************************************************************************
+  Function name: ReadShadowMaps()
+
+  Purpose      : Read the shadow maps of the time steps of the month that have
+                 the sun above the horizon
+
+  Required     :
+    TIMESTRUCT *Time         - Model time, the month is Time->Current
+    MAPSIZE *Map             - Information about the basin
+    SOLARGEOMETRY *SolarGeo  - Location of the basin
+    char *FileName           - Shadow file of the month, NDaySteps maps
+    char *Scratch            - OUT OF CORE DIRECTORY, "" for none
+    SHADOWMAP *ShadowMap     - Shadow maps, see InitShadeMap()
+
+  Returns      : void
+
+  Modifies     : ShadowMap
+
+  Comments     : A step is in daylight if SunMax > 0 on any day of the
+                 month, with the same solar geometry as InitNewStep().  In
+                 the other steps MakeMetFields() and GetMetData() set the 
+                 shortwave to zero, so their shadow maps are never used: 
+                 they are not read and all point to a map of zeros.  With
+                 a STATIC DATA SHARE the daylight steps point to the maps
+                 of the month in the shared segment instead.  With an
+                 OUT OF CORE DIRECTORY the block is a scratch file mapped
+                 into memory, of which StepShadowMaps() keeps only the
+                 slices of the current and next step in memory
+*****************************************************************************/
+static void ReadShadowMaps(TIMESTRUCT *Time, MAPSIZE *Map,
+			   SOLARGEOMETRY *SolarGeo, char *FileName,
+			   char *Scratch, SHADOWMAP *ShadowMap)
+{
+  const char *Routine = "ReadShadowMaps";
+  unsigned char *Block;		/* Maps of the daylight steps */
+  int *Slice;			/* Slice of each step in Block */
+  size_t NCells;		/* Cells in a map */
+  int Shared;			/* TRUE if the maps are in the shared 
+				   segment */
+  int n;			/* counter */
+  int y;			/* counter */
+
+  for (n = 0; n < ShadowMap->NDaySteps; n++)
+    ShadowMap->Slice[n] = -1;
+  DaylightSteps(Time->Current.Year, Time->Current.Month, Time->Dt, SolarGeo,
+		ShadowMap->NDaySteps, ShadowMap->Slice);
+  for (n = 0, ShadowMap->NSlices = 0; n < ShadowMap->NDaySteps; n++)
+    if (ShadowMap->Slice[n] == 0)
+      ShadowMap->Slice[n] = ShadowMap->NSlices++;
+
+  /* the shared segment has the maps of the daylight steps of the month in
+     any year */
+  Shared = SharedShadowMaps(Time->Current.Month, ShadowMap->NDaySteps,
+			    &Slice, &Block);
+  for (n = 0; n < ShadowMap->NDaySteps && Shared; n++)
+    if (ShadowMap->Slice[n] >= 0 && Slice[n] < 0)
+      Shared = FALSE;
+
+  NCells = (size_t) Map->NY * Map->NX;
+  if (!Shared && ShadowMap->NSlices > ShadowMap->MaxSlices &&
+      !IsEmptyStr(Scratch)) {
+    UnmapScratch(ShadowMap->Block, ShadowMap->Mapped);
+    ShadowMap->Mapped = ShadowMap->NSlices * NCells;
+    ShadowMap->Block = (unsigned char *) MapScratch(Scratch, "shadow",
+						    ShadowMap->Mapped);
+    ShadowMap->MaxSlices = ShadowMap->NSlices;
+  }
+  else if (!Shared && ShadowMap->NSlices > ShadowMap->MaxSlices) {
+    TaggedFree(ShadowMap->Block);
+    if (!(ShadowMap->Block = (unsigned char *)
+	  TaggedCalloc(ShadowMap->NSlices * NCells, sizeof(unsigned char),
+		       MEM_SHADOW)))
+      ReportError((char *)Routine, 1);
+    HugePageHint(ShadowMap->Block, ShadowMap->NSlices * NCells);
+    FirstTouchBlock(ShadowMap->Block, ShadowMap->NSlices * NCells,
+		    sizeof(unsigned char));
+    ShadowMap->MaxSlices = ShadowMap->NSlices;
+  }
+
+  if (!Shared)
+    Block = ShadowMap->Block;
+  for (n = 0; n < ShadowMap->NDaySteps; n++) {
+    for (y = 0; y < Map->NY; y++)
+      ShadowMap->Map[n][y] = (ShadowMap->Slice[n] < 0) ?
+	ShadowMap->Night + (size_t) y * Map->NX :
+	Block + ((Shared ? Slice[n] : ShadowMap->Slice[n]) * NCells +
+		 (size_t) y * Map->NX);
+  }
+
+  printf("%d of %d time steps of the day are in daylight\n",
+	 ShadowMap->NSlices, ShadowMap->NDaySteps);
+  if (!Shared)
+    ReadShadowSlices(FileName, Map, ShadowMap->NDaySteps, ShadowMap->Slice,
+		     ShadowMap->Block);
+
+  /* the slices go back to the scratch file until their steps come */
+  if (!Shared && ShadowMap->Mapped > 0)
+    AdviseScratch(ShadowMap->Block, ShadowMap->Mapped, FALSE);
+}
+
+/*****************************************************************************
+  Function name: StepShadowMaps()
+
+  Purpose      : Keep the shadow maps of an OUT OF CORE DIRECTORY that the
+                 time steps around DayStep use in memory
+
+  Required     :
+    SHADOWMAP *ShadowMap     - Shadow maps, see ReadShadowMaps()
+    MAPSIZE *Map             - Information about the basin
+    int DayStep              - Time step of the day that starts
+
+  Returns      : void
+
+  Modifies     : the pages of the scratch file that are in memory
+
+  Comments     : The slice of the step before goes back to the scratch file,
+                 and the slice of the next step is read in while this step
+                 runs.  It does nothing if the maps are in memory
+*****************************************************************************/
+void StepShadowMaps(SHADOWMAP *ShadowMap, MAPSIZE *Map, int DayStep)
+{
+  size_t NCells;		/* Cells in a map */
+  int Last;			/* Step before DayStep */
+  int n;			/* counter */
+
+  if (ShadowMap->Mapped == 0)
+    return;
+  NCells = (size_t) Map->NY * Map->NX;
+  Last = (DayStep + ShadowMap->NDaySteps - 1) % ShadowMap->NDaySteps;
+  if (ShadowMap->Slice[Last] >= 0)
+    AdviseScratch(ShadowMap->Block + ShadowMap->Slice[Last] * NCells,
+		  NCells, FALSE);
+  for (n = DayStep; n <= DayStep + 1; n++)
+    if (ShadowMap->Slice[n % ShadowMap->NDaySteps] >= 0)
+      AdviseScratch(ShadowMap->Block +
+		    ShadowMap->Slice[n % ShadowMap->NDaySteps] * NCells,
+		    NCells, TRUE);
+}
+
+/*****************************************************************************
+  Function name: DaylightSteps()
+
+  Purpose      : Find the time steps of the day that have the sun above the
+                 horizon on any day of a month
+
+  Required     :
+    int Year                 - Year
+    int Month                - Month
+    int Dt                   - Model time step (s)
+    SOLARGEOMETRY *SolarGeo  - Location of the basin
+    int NDaySteps            - Number of time steps in a day
+    int *Slice               - NDaySteps values
+
+  Returns      : void
+
+  Modifies     : Slice, set to 0 for the daylight steps, the other steps
+                 are left as they are, so that the daylight steps of
+                 several months can be joined
+*****************************************************************************/
+void DaylightSteps(int Year, int Month, int Dt, SOLARGEOMETRY *SolarGeo,
+		   int NDaySteps, int *Slice)
+{
+  SOLARGEOMETRY Geo;		/* Sun of a day of the month */
+  int Day;			/* counter */
+  int NDays;			/* Days in the month */
+  int n;			/* counter */
+
+  if (Month == 12)
+    NDays = 31;
+  else
+    NDays = DayOfYear(Year, Month + 1, 1) - DayOfYear(Year, Month, 1);
+  Geo = *SolarGeo;
+  for (Day = 1; Day <= NDays; Day++) {
+    InitNewDay(DayOfYear(Year, Month, Day), &Geo);
+    for (n = 0; n < NDaySteps; n++) {
+      StepSolarGeometry(n, Dt, &Geo);
+      if (Geo.SunMax > 0.0)
+	Slice[n] = 0;
+    }
+  }
+}
+
+/*****************************************************************************
+  Function name: ReadShadowSlices()
+
+  Purpose      : Read the shadow maps of the steps with a slice from the
+                 shadow file of a month
+
+  Required     :
+    char *FileName           - Shadow file of the month, NDaySteps maps
+    MAPSIZE *Map             - Information about the basin
+    int NDaySteps            - Number of time steps in a day
+    int *Slice               - Slice of each step in Block, -1 if the
+                               step is not read.  The slices of
+                               consecutive steps are consecutive
+    unsigned char *Block     - Maps of the slices, [slice][NY][NX]
+
+  Returns      : void
+
+  Modifies     : Block
+
+  Comments     : Each run of consecutive steps is read in one go
+*****************************************************************************/
+void ReadShadowSlices(char *FileName, MAPSIZE *Map, int NDaySteps, int *Slice,
+		      unsigned char *Block)
+{
+  char VarName[BUFSIZE + 1];	/* Variable name */
+  int First;			/* First step of a run of daylight steps */
+  int NumberType;
+  int n;			/* counter */
+
+  GetVarName(304, 0, VarName);
+  GetVarNumberType(304, &NumberType);
+  for (n = 0; n < NDaySteps; n++) {
+    if (Slice[n] < 0)
+      continue;
+    First = n;
+    while (n + 1 < NDaySteps && Slice[n + 1] >= 0)
+      n++;
+    Read3DMatrix(FileName, Block + (size_t) Slice[First] * Map->NY * Map->NX,
+		 NumberType, Map, First, n - First + 1, VarName, First);
+  }
+}
+
 /*****************************************************************************
   Function name: InitNewStep()
 
@@ -181,13 +505,13 @@ void InitNewDay(int DayOfYear, SOLARGEOMETRY * SolarGeo)
     char *RadarFileName      - Name of file with radar images
     MAPSIZE Radar            - Structure with information about the
                                precipitation radar coverage
-    RADARPIX **RadarMap      - Structure with precipitation information for
+    float *RadarMap          - Window of precipitation information for
                                each radar pixel
     SOLARGEOMETRY *SolarGeo  - structure with information about Earth-Sun
                                geometry
     SOILPIX **SoilMap        - structure with soil information
     float ***MM5Input        - MM5 input maps
-    float ***WindModel       - Wind model maps
+    STATICMAP *WindModel     - Wind model maps
 
   Returns      : void
 
@@ -198,123 +522,66 @@ void InitNewDay(int DayOfYear, SOLARGEOMETRY * SolarGeo)
 void InitNewStep(INPUTFILES *InFiles, MAPSIZE *Map, TIMESTRUCT *Time,
   int NSoilLayers, OPTIONSTRUCT *Options, int NStats,
   METLOCATION *Stat, char *RadarFileName, MAPSIZE *Radar,
-  RADARPIX **RadarMap, SOLARGEOMETRY *SolarGeo,
+  float *RadarMap, SOLARGEOMETRY *SolarGeo,
   TOPOPIX **TopoMap, SOILPIX **SoilMap,
-  float ***MM5Input, float ***WindModel, MAPSIZE *MM5Map)
+  float ***MM5Input, STATICMAP *WindModel, MAPSIZE *MM5Map)
 {
   const char *Routine = "InitNewStep";
   int i;			/* counter */
   int j;			/* counter */
   int x;			/* counter */
   int y;			/* counter */
-  int NumberType;	/* number type in MM5 input */
-  int Step;			/* Step in the MM5 Input */
-  float *Array = NULL;
-  int MM5Y, MM5X;
+  int NMaps;			/* Number of MM5 maps */
+  int NCells;			/* Number of cells in an MM5 map */
+  static float *Array = NULL;	/* MM5 maps for the current step */
+  float *MM5Array;
 
   /*printf("current time is %4d-%2d-%2d-%2d\n", Time->Current.Year,Time->Current.Month, Time->Current.Day, Time->Current.Hour);*/
 
   /* Calculate variables related to the position of the sun above the
      horizon, this is only necessary if shading is TRUE */
 
-  SolarHour(SolarGeo->Latitude,
-    (Time->DayStep + 1) * ((float)Time->Dt) / SECPHOUR,
-    ((float)Time->Dt) / SECPHOUR, SolarGeo->NoonHour,
-    SolarGeo->Declination, SolarGeo->Sunrise, SolarGeo->Sunset,
-    SolarGeo->TimeAdjustment, SolarGeo->SunEarthDistance,
-    &(SolarGeo->SineSolarAltitude), &(SolarGeo->DayLight),
-    &(SolarGeo->SolarTimeStep), &(SolarGeo->SunMax),
-    &(SolarGeo->SolarAzimuth));
+  StepSolarGeometry(Time->DayStep, Time->Dt, SolarGeo);
 
   if (Options->MM5 == TRUE) {
-    /* Read the data from the MM5 files */
-    if (!(Array = (float *)calloc(MM5Map->NY * MM5Map->NX, sizeof(float))))
-      ReportError((char *)Routine, 1);
-    NumberType = NC_FLOAT;
-
-    Step = NumberOfSteps(&(Time->StartMM5), &(Time->Current), Time->Dt);
-
-    Read2DMatrix(InFiles->MM5Temp, Array, NumberType, MM5Map, Step, "", 0);
-    for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_temperature - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-      }
-
-    Read2DMatrix(InFiles->MM5Humidity, Array, NumberType, MM5Map, Step, "", 0);
-
-    for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_humidity - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-      }
-
-    Read2DMatrix(InFiles->MM5Wind, Array, NumberType, MM5Map, Step, "", 0);
-    for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_wind - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-      }
-
-    Read2DMatrix(InFiles->MM5ShortWave, Array, NumberType, MM5Map, Step, "", 0);
-    for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_shortwave - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-      }
+    /* Read the data from the MM5 files.  The maps are read in the order in
+       which they are stored in MM5Input, into one buffer that is kept
+       between time steps.  With MET FILE INTERVAL the maps of the step are
+       interpolated between the records of the files */
+    NMaps = N_MM5_MAPS;
+    if (Options->HeatFlux == TRUE)
+      NMaps += NSoilLayers;
+    NCells = MM5Map->NY * MM5Map->NX;
+    if (Array == NULL) {
+      if (!(Array = (float *)calloc(NMaps * NCells, sizeof(float))))
+        ReportError((char *)Routine, 1);
+    }
 
-    Read2DMatrix(InFiles->MM5LongWave, Array, NumberType, MM5Map, Step, "", 0);
-    for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_longwave - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-      }
+    if (Options->MetInterval > 0)
+      InterpolateMM5Maps(InFiles, Options, Time, NSoilLayers, NMaps, MM5Map,
+			 SolarGeo, Array);
+    else
+      ReadMM5Maps(InFiles, Options, NSoilLayers, MM5Map,
+		  NumberOfSteps(&(Time->StartMM5), &(Time->Current), Time->Dt),
+		  Array);
+
+    /* regrid all maps to the model grid, using the index map built in 
+       InitMM5() */
+    for (j = 0; j < NMaps; j++) {
+      MM5Array = &Array[j * NCells];
+      for (y = 0, i = 0; y < Map->NY; y++)
+        for (x = 0; x < Map->NX; x++, i++)
+          MM5Input[j][y][x] = MM5Array[MM5Map->RegridIndex[i]];
+    }
 
-    Read2DMatrix(InFiles->MM5Precipitation, Array, NumberType, MM5Map, Step, "", 0);
     for (y = 0; y < Map->NY; y++)
       for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_precip - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
         if (MM5Input[MM5_precip - 1][y][x] < 0.0) {
           printf("Warning: MM5 precip is less than zero %f\n",
             MM5Input[MM5_precip - 1][y][x]);
           MM5Input[MM5_precip - 1][y][x] = 0.0;
         }
       }
-    Read2DMatrix(InFiles->MM5Terrain, Array, NumberType, MM5Map, Step, "", 0);
-    for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_terrain - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-      }
-    Read2DMatrix(InFiles->MM5Lapse, Array, NumberType, MM5Map, Step, "", 0);
-    for (y = 0; y < Map->NY; y++)
-      for (x = 0; x < Map->NX; x++) {
-        MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-        MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-        MM5Input[MM5_lapse - 1][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-      }
-
-    if (Options->HeatFlux == TRUE) {
-
-      for (i = 0, j = MM5_lapse; i < NSoilLayers; i++, j++) {
-        Read2DMatrix(InFiles->MM5SoilTemp[i], Array, NumberType, MM5Map, Step, "", 0);
-        for (y = 0; y < Map->NY; y++)
-          for (x = 0; x < Map->NX; x++) {
-            MM5Y = (int)((y + MM5Map->OffsetY) * Map->DY / MM5Map->DY);
-            MM5X = (int)((x - MM5Map->OffsetX) * Map->DX / MM5Map->DY);
-            MM5Input[j][y][x] = Array[MM5Y * MM5Map->NX + MM5X];
-          }
-      }
-    }
-    free(Array);
   }
   /*end if MM5*/
 
@@ -335,6 +602,100 @@ void InitNewStep(INPUTFILES *InFiles, MAPSIZE *Map, TIMESTRUCT *Time,
   }
 
   if ((Options->MM5 == TRUE && Options->QPF == TRUE) || Options->MM5 == FALSE)
-    GetMetData(Options, Time, NSoilLayers, NStats, SolarGeo->SunMax, Stat,
+    GetMetData(Options, Time, NSoilLayers, NStats, SolarGeo, Stat,
       Radar, RadarMap, RadarFileName);
 }
+
+/*****************************************************************************
+  Function name: ReadMM5Maps()
+
+  Purpose      : Read record Step of the MM5 files
+
+  Required     :
+    INPUTFILES *InFiles      - Names of the MM5 files
+    OPTIONSTRUCT *Options    - HeatFlux
+    int NSoilLayers          - Number of soil layers
+    MAPSIZE *MM5Map          - Size of the MM5 maps
+    int Step                 - Record of the files
+    float *Array             - Maps in the order of MM5Input
+
+  Returns      : void
+
+  Modifies     : Array
+*****************************************************************************/
+void ReadMM5Maps(INPUTFILES *InFiles, OPTIONSTRUCT *Options, int NSoilLayers,
+		 MAPSIZE *MM5Map, int Step, float *Array)
+{
+  int i;			/* counter */
+  int j;			/* counter */
+  int NumberType;	/* number type in MM5 input */
+  int NCells;			/* Number of cells in an MM5 map */
+
+  NCells = MM5Map->NY * MM5Map->NX;
+  NumberType = NC_FLOAT;
+
+  Read2DMatrix(InFiles->MM5Temp, &Array[(MM5_temperature - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  Read2DMatrix(InFiles->MM5Humidity, &Array[(MM5_humidity - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  Read2DMatrix(InFiles->MM5Wind, &Array[(MM5_wind - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  Read2DMatrix(InFiles->MM5ShortWave, &Array[(MM5_shortwave - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  Read2DMatrix(InFiles->MM5LongWave, &Array[(MM5_longwave - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  Read2DMatrix(InFiles->MM5Precipitation, &Array[(MM5_precip - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  Read2DMatrix(InFiles->MM5Terrain, &Array[(MM5_terrain - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  Read2DMatrix(InFiles->MM5Lapse, &Array[(MM5_lapse - 1) * NCells],
+    NumberType, MM5Map, Step, "", 0);
+  if (Options->HeatFlux == TRUE) {
+    for (i = 0, j = MM5_lapse; i < NSoilLayers; i++, j++)
+      Read2DMatrix(InFiles->MM5SoilTemp[i], &Array[j * NCells], NumberType,
+        MM5Map, Step, "", 0);
+  }
+}
+
+/*****************************************************************************
+  Function name: StepSolarGeometry()
+
+  Purpose      : Position of the sun during a time step of the day
+
+  Required     :
+    int DayStep              - Time step of the day
+    int Dt                   - Model time step (s)
+    SOLARGEOMETRY *SolarGeo  - Sun of the day, see InitNewDay()
+
+  Returns      : void
+
+  Modifies     : SolarGeo
+
+  Comments     : Like SolarHour(), the azimuth is left as it is when the sun
+                 is below the horizon
+*****************************************************************************/
+void StepSolarGeometry(int DayStep, int Dt, SOLARGEOMETRY *SolarGeo)
+{
+  SUNSTEP *Step;
+
+  if (InSchedule(SolarGeo) && Dt == Schedule.Dt &&
+      SolarGeo->DayOfYear >= 1 && SolarGeo->DayOfYear <= DAYPYEAR + 1 &&
+      DayStep >= 0 && DayStep < Schedule.NDaySteps) {
+    Step = &(Schedule.Step[(SolarGeo->DayOfYear - 1) * Schedule.NDaySteps +
+			   DayStep]);
+    SolarGeo->SineSolarAltitude = Step->SineSolarAltitude;
+    SolarGeo->DayLight = Step->DayLight;
+    SolarGeo->SolarTimeStep = Step->SolarTimeStep;
+    SolarGeo->SunMax = Step->SunMax;
+    if (Step->DayLight)
+      SolarGeo->SolarAzimuth = Step->SolarAzimuth;
+    return;
+  }
+  SolarHour(SolarGeo->Latitude, (DayStep + 1) * ((float)Dt) / SECPHOUR,
+    ((float)Dt) / SECPHOUR, SolarGeo->NoonHour,
+    SolarGeo->Declination, SolarGeo->Sunrise, SolarGeo->Sunset,
+    SolarGeo->TimeAdjustment, SolarGeo->SunEarthDistance,
+    &(SolarGeo->SineSolarAltitude), &(SolarGeo->DayLight),
+    &(SolarGeo->SolarTimeStep), &(SolarGeo->SunMax),
+    &(SolarGeo->SolarAzimuth));
+}
@@ -19,6 +19,7 @@
 #include "data.h"
 #include "DHSVMerror.h"
 #include "functions.h"
+#include "memaccount.h"
 #include "constants.h"
 
 /*****************************************************************************
@@ -44,11 +45,14 @@ void InitSnowMap(MAPSIZE * Map, SNOWPIX *** SnowMap)
 
   printf("Initializing snow map\n");
 
-  if (!(*SnowMap = (SNOWPIX **) calloc(Map->NY, sizeof(SNOWPIX *))))
+  if (!(*SnowMap = (SNOWPIX **) TaggedCalloc(Map->NY, sizeof(SNOWPIX *),
+					     MEM_SNOW)))
     ReportError((char *) Routine, 1);
 
   for (y = 0; y < Map->NY; y++) {
-    if (!((*SnowMap)[y] = (SNOWPIX *) calloc(Map->NX, sizeof(SNOWPIX))))
+    if (!((*SnowMap)[y] = (SNOWPIX *) TaggedCalloc(Map->NX, sizeof(SNOWPIX),
+						   MEM_SNOW)))
       ReportError((char *) Routine, 1);
   }
+  FirstTouchRows(Map, *SnowMap, Map->NX * sizeof(SNOWPIX));
 }
@@ -0,0 +1,222 @@
+/*
+ * SUMMARY:      InitSubBasin.c - Model only the basin upstream of an outlet
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Shrinks the basin mask and the channel networks to the area
+ *               that drains to a stream segment (OPTIONS SUB-BASIN OUTLET
+ *               SEGMENT) or to a cell (SUB-BASIN OUTLET NORTH and EAST)
+ * DESCRIP-END.
+ * FUNCTIONS:    InitSubBasin()
+ *               CellHasSegment()
+ * COMMENTS:     The stream segments of the sub-basin are the outlet segment
+ *               (or the segments in the outlet cell) and all segments that
+ *               drain to them.  The cells of the sub-basin are the outlet
+ *               cell and the cells of these segments, and every cell whose
+ *               surface flow directions lead to one of them.  A cell with a
+ *               stream channel that is not part of the sub-basin drains to
+ *               that channel and is left out.
+ *
+ *               The cells outside the sub-basin are removed from the mask,
+ *               and the terrain is treated as if the mask had been read
+ *               from the mask file: the slopes and flow directions at the
+ *               edge of the sub-basin are recalculated so that no surface
+ *               or subsurface flow leaves it.  The grid is not changed, so
+ *               map, state and pixel coordinates are those of the full
+ *               domain.  Road segments without a cell in the sub-basin are
+ *               removed, and the others keep only their cells in it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "constants.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "DHSVMChannel.h"
+#include "functions.h"
+#include "slopeaspect.h"
+#include "memaccount.h"
+
+/*****************************************************************************
+  CellHasSegment()
+
+  TRUE if one of the segments in cell (x, y) of map is marked in Keep
+*****************************************************************************/
+static int CellHasSegment(ChannelMapPtr ** map, int x, int y, char *Keep)
+{
+  ChannelMapPtr cell;
+
+  if (!channel_grid_has_channel(map, x, y))
+    return FALSE;
+  for (cell = map[x][y]; cell != NULL; cell = cell->next)
+    if (Keep[cell->channel->id])
+      return TRUE;
+  return FALSE;
+}
+
+/*****************************************************************************
+  InitSubBasin()
+
+  Needs the surface flow graph of the full basin and the channel networks.
+  Rebuilds everything that depends on the active cells up to that point:
+  Map->ActiveCells, the slopes and flow directions, the domain rows, the
+  surface flow graph, the compiled channel networks and the channel cell
+  lists.  Does nothing if no outlet is given.
+*****************************************************************************/
+void InitSubBasin(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		  FLOWGRAPH *SurfaceGraph, CHANNEL *ChannelData,
+		  int MaxStreamID, int MaxRoadID)
+{
+  const char *Routine = "InitSubBasin";
+  ChannelNetwork *Net;
+  Channel *Segment;
+  ChannelMapPtr cell;
+  char *StreamKeep;		/* segments in the sub-basin, by id */
+  char *RoadKeep;		/* road segments in the sub-basin, by id */
+  unsigned char *InSub;		/* active cells in the sub-basin */
+  int *Queue;			/* active cells whose donors are to be traced */
+  int NQueue;
+  int NFull;			/* active cells in the full basin */
+  int i;
+  int k;
+  int r;
+  int x;
+  int y;
+
+  if (Options->OutletSegment < 0 && Options->OutletY < 0)
+    return;
+
+  if (!(StreamKeep = (char *) calloc(MaxStreamID + 1, sizeof(char))) ||
+      !(RoadKeep = (char *) calloc(MaxRoadID + 1, sizeof(char))) ||
+      !(InSub = (unsigned char *) calloc(Map->NumActive, sizeof(char))) ||
+      !(Queue = (int *) calloc(Map->NumActive, sizeof(int))))
+    ReportError((char *)Routine, 1);
+
+  /* the segments at the outlet */
+  Net = ChannelData->stream_net;
+  if (Options->OutletSegment >= 0) {
+    if (Net == NULL || Options->OutletSegment > Net->maxid ||
+	Net->byid[Options->OutletSegment] == NULL)
+      ReportError("SUB-BASIN OUTLET SEGMENT", 51);
+    StreamKeep[Options->OutletSegment] = TRUE;
+  }
+  else {
+    if (!INBASIN(TopoMap[Options->OutletY][Options->OutletX].Mask))
+      ReportError("SUB-BASIN OUTLET NORTH", 51);
+    if (channel_grid_has_channel(ChannelData->stream_map, Options->OutletX,
+				 Options->OutletY))
+      for (cell = ChannelData->stream_map[Options->OutletX][Options->OutletY];
+	   cell != NULL; cell = cell->next)
+	StreamKeep[cell->channel->id] = TRUE;
+  }
+
+  /* and all segments upstream of them, the outlets are routed after the
+     segments that drain to them */
+  if (Net != NULL) {
+    for (i = Net->nseg - 1; i >= 0; i--) {
+      if (Net->outlet[i] >= 0 && StreamKeep[Net->seg[Net->outlet[i]]->id])
+	StreamKeep[Net->seg[i]->id] = TRUE;
+    }
+  }
+
+  /* the cells draining to them, traced upstream through the donors of the
+     surface flow graph */
+  NQueue = 0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    if ((y == Options->OutletY && x == Options->OutletX) ||
+	CellHasSegment(ChannelData->stream_map, x, y, StreamKeep)) {
+      InSub[k] = TRUE;
+      Queue[NQueue++] = k;
+    }
+  }
+  while (NQueue > 0) {
+    r = Queue[--NQueue];
+    for (i = SurfaceGraph->RevStart[r]; i < SurfaceGraph->RevStart[r + 1];
+	 i++) {
+      k = SurfaceGraph->RevDonor[i];
+      if (InSub[k])
+	continue;
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      if (channel_grid_has_channel(ChannelData->stream_map, x, y) &&
+	  !CellHasSegment(ChannelData->stream_map, x, y, StreamKeep))
+	continue;
+      InSub[k] = TRUE;
+      Queue[NQueue++] = k;
+    }
+  }
+
+  /* the new mask, and the road segments with a cell in it */
+  NFull = Map->NumActive;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    if (!InSub[k])
+      TopoMap[y][x].Mask = OUTSIDEBASIN;
+    else if (channel_grid_has_channel(ChannelData->road_map, x, y))
+      for (cell = ChannelData->road_map[x][y]; cell != NULL; cell = cell->next)
+	RoadKeep[cell->channel->id] = TRUE;
+  }
+
+  /* the terrain and flow graph of the sub-basin */
+  free(Map->OrderedCells);
+  Map->OrderedCells = NULL;
+  Map->NumCells = 0;
+  ElevationSlopeAspect(Map, TopoMap, Options->NThreads);
+  TaggedFree(Map->ActiveCells);
+  TaggedFree(Map->RowOrder);
+  InitActiveCells(Map, TopoMap, Options);
+  FreeFlowGraph(SurfaceGraph);
+  InitFlowGraph(Map, SurfaceGraph);
+  MakeFlowGraph(Map, TopoMap, NULL, NULL, SurfaceGraph);
+
+  /* the channel networks, the map records go before their segments */
+  if (ChannelData->stream_map != NULL)
+    channel_grid_clip_map(ChannelData->stream_map, TopoMap, StreamKeep);
+  if (ChannelData->road_map != NULL)
+    channel_grid_clip_map(ChannelData->road_map, TopoMap, RoadKeep);
+  if (ChannelData->streams != NULL) {
+    ChannelData->streams = channel_prune_network(ChannelData->streams,
+						 StreamKeep);
+    channel_free_compiled_network(ChannelData->stream_net);
+    ChannelData->stream_net = channel_compile_network(ChannelData->streams,
+						      MaxStreamID);
+    if (Options->ParallelRouting)
+      channel_network_threads(ChannelData->stream_net, Options->NThreads);
+    channel_network_substeps(ChannelData->stream_net, Options->RoutingSubsteps);
+    if (Options->RoutingBatch)
+      channel_network_batch(ChannelData->stream_net);
+  }
+  if (ChannelData->roads != NULL) {
+    ChannelData->roads = channel_prune_network(ChannelData->roads, RoadKeep);
+    channel_free_compiled_network(ChannelData->road_net);
+    ChannelData->road_net = channel_compile_network(ChannelData->roads,
+						    MaxRoadID);
+    if (Options->ParallelRouting)
+      channel_network_threads(ChannelData->road_net, Options->NThreads);
+    channel_network_substeps(ChannelData->road_net, Options->RoutingSubsteps);
+    if (Options->RoutingBatch)
+      channel_network_batch(ChannelData->road_net);
+  }
+  if (Options->HasNetwork) {
+    free(ChannelData->road_cells);
+    free(ChannelData->stream_cells);
+    InitChannelCells(Map, ChannelData);
+  }
+
+  for (i = 0, Segment = ChannelData->streams; Segment != NULL;
+       Segment = Segment->next)
+    i++;
+  printf("Sub-basin: %d of %d active cells and %d stream segments drain to "
+	 "the outlet\n", Map->NumActive, NFull, i);
+
+  free(StreamKeep);
+  free(RoadKeep);
+  free(InSub);
+  free(Queue);
+}
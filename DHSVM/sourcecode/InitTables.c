@@ -10,6 +10,7 @@
  * DESCRIP-END.
  * FUNCTIONS:    InitTables()
  *               InitSoilTable()
+ *               CheckSoilTables()
  *               InitVegTable()
  *               InitSnowTable()
  * COMMENTS:
@@ -32,6 +33,8 @@
 #include "constants.h"
 #include "fileio.h"
 #include "getinit.h"
+#include "massenergy.h"
+#include "rad.h"
 
  /*******************************************************************************/
  /*				  InitTables()                                 */
@@ -52,6 +55,7 @@ void InitTables(int StepsPerDay, LISTPTR Input, OPTIONSTRUCT *Options,
 
   InitSnowTable(SnowAlbedo, StepsPerDay);
   InitSatVaporTable();
+  InitSeparationTable(Options->RadiationTableSize);
 }
 
 /********************************************************************************
@@ -198,6 +202,15 @@ int InitSoilTable(OPTIONSTRUCT *Options, SOILTABLE ** SType,
     if (!((*SType)[i].Ch = (float *)calloc((*SType)[i].NLayers,
       sizeof(float))))
       ReportError((char *)Routine, 1);
+    if (!((*SType)[i].KhSatFrozen = (float *)calloc((*SType)[i].NLayers,
+      sizeof(float))))
+      ReportError((char *)Routine, 1);
+    if (!((*SType)[i].KhSatThawed = (float *)calloc((*SType)[i].NLayers,
+      sizeof(float))))
+      ReportError((char *)Routine, 1);
+    if (!((*SType)[i].ChSolids = (float *)calloc((*SType)[i].NLayers,
+      sizeof(float))))
+      ReportError((char *)Routine, 1);
 
     if (!CopyFloat((*SType)[i].Porosity, VarStr[porosity], (*SType)[i].NLayers))
       ReportError(KeyName[porosity], 51);
@@ -235,15 +248,83 @@ int InitSoilTable(OPTIONSTRUCT *Options, SOILTABLE ** SType,
   for (i = 0; i < NSoils; i++)
     for (j = 0; j < (*SType)[i].NLayers; j++) {
       (*SType)[i].KhDry[j] = CalcKhDry((*SType)[i].Dens[j]);
+      CalcSaturatedKh((*SType)[i].KhSol[j], (*SType)[i].Porosity[j],
+        &((*SType)[i].KhSatFrozen[j]), &((*SType)[i].KhSatThawed[j]));
+      (*SType)[i].ChSolids[j] = (1 - (*SType)[i].Porosity[j]) *
+        (*SType)[i].Ch[j];
       if (((*SType)[i].Porosity[j] < (*SType)[i].FCap[j])
         || ((*SType)[i].Porosity[j] < (*SType)[i].WP[j])
         || ((*SType)[i].FCap[j] < (*SType)[i].WP[j]))
         ReportError((*SType)[i].Desc, 11);
     }
 
+  /* interpolation tables for the transmissivity and the unsaturated 
+     drainage */
+  for (i = 0; i < NSoils; i++) {
+    InitTransmissivityTable(&((*SType)[i]), Options->SoilTableSize);
+    InitDrainageTable(&((*SType)[i]), Options->SoilTableSize);
+  }
+  if (Options->SoilTableSize > 0)
+    CheckSoilTables(NSoils, *SType);
+
   return NSoils;
 }
 
+/********************************************************************************
+  Function Name: CheckSoilTables()
+
+  Purpose      : Report the accuracy of the soil interpolation tables
+                 against the exact functions
+
+  Required     :
+    int NSoils        - Number of soil types
+    SOILTABLE *SType  - Soil types, with the tables set up
+
+  Returns      : void
+
+  Modifies     : void
+
+  Comments     : The error of linear interpolation is largest halfway 
+                 between the table entries, so that is where the tables are
+                 checked.  The transmissivity table error is relative, the
+                 drainage error is a fraction of the saturated conductivity.
+********************************************************************************/
+void CheckSoilTables(int NSoils, SOILTABLE *SType)
+{
+  double Exact;
+  double TransErr;
+  double DrainErr;
+  double x;
+  float Exponent;
+  unsigned long k;
+  int i;
+  int j;
+
+  for (i = 0; i < NSoils; i++) {
+    TransErr = 0.0;
+    if (SType[i].TransTable.Data != NULL) {
+      for (k = 0; k < SType[i].TransTable.Size - 1; k++) {
+	x = (k + 0.5) * SType[i].TransTable.Delta;
+	Exact = exp(-SType[i].KsLatExp * x);
+	TransErr = MAX(TransErr, fabs(FloatInterpolate(x, &(SType[i].TransTable)) - 
+				       Exact) / Exact);
+      }
+    }
+    DrainErr = 0.0;
+    for (j = 0; j < SType[i].NLayers; j++) {
+      Exponent = 2.0 / SType[i].PoreDist[j] + 3.0;
+      for (k = 0; k < SType[i].DrainTable[j].Size - 1; k++) {
+	x = (k + 0.5) * SType[i].DrainTable[j].Delta;
+	Exact = pow(x, (double) Exponent);
+	DrainErr = MAX(DrainErr, 
+		       fabs(FloatInterpolate(x, &(SType[i].DrainTable[j])) - Exact));
+      }
+    }
+    printf("Soil table accuracy for %s: transmissivity %g, drainage %g\n",
+	   SType[i].Desc, TransErr, DrainErr);
+  }
+}
+
 /********************************************************************************
   Function Name: InitVegTable()
 
@@ -428,6 +509,9 @@ int InitVegTable(VEGTABLE ** VType, LISTPTR Input, OPTIONSTRUCT * Options,
     if (!((*VType)[i].Rpc = (float *)calloc((*VType)[i].NVegLayers, sizeof(float))))
       ReportError((char *)Routine, 1);
 
+    if (!((*VType)[i].RsRatio = (float *)calloc((*VType)[i].NVegLayers, sizeof(float))))
+      ReportError((char *)Routine, 1);
+
     if (!((*VType)[i].Albedo = (float *)calloc(((*VType)[i].NVegLayers + 1), sizeof(float))))
       ReportError((char *)Routine, 1);
 
@@ -583,6 +667,9 @@ int InitVegTable(VEGTABLE ** VType, LISTPTR Input, OPTIONSTRUCT * Options,
       (*VType)[i].U, &((*VType)[i].USnow), (*VType)[i].Ra,
       &((*VType)[i].RaSnow));
 
+    /* The leaf drip velocity and momentum only depend on the canopy height */
+    InitLeafDrip(&((*VType)[i]));
+
     /* Run the improved radiation scheme in which the tree height, solar altitude and fractional coverage
     are all taken into account into the radiation calculation */
     if (Options->ImprovRadiation == TRUE) {
@@ -0,0 +1,102 @@
+/*
+ * SUMMARY:      InitTasks.c - Stages of the initialization run concurrently
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS PARALLEL INITIALIZATION = TRUE a stage of
+ *               dhsvm_initialize() that only depends on the stages before
+ *               it runs in a thread of its own, while the main thread goes
+ *               on with the stages that do not depend on it.  The main
+ *               thread waits for it before the first stage that uses its
+ *               results.
+ * DESCRIP-END.
+ * FUNCTIONS:    StartInitTask()
+ *               WaitInitTask()
+ *               RunTask()
+ * COMMENTS:     The graph of the stages is in dhsvm_initialize(): a task is
+ *               started after the stages that make its inputs, and waited
+ *               for before the stages that read its outputs or that fork the
+ *               process (InitEnsemble()).
+ *
+ *               A task may not read or write files (the NetCDF library is
+ *               not thread safe) or start OpenMP parallel regions (the
+ *               first touch of the maps, ThreadPlacement.c, would put their
+ *               pages in the wrong place).  Its messages may come in
+ *               between those of the main thread.
+ *
+ *               Without HAVE_PTHREAD, or without PARALLEL INITIALIZATION,
+ *               the task runs when it is started, as before.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "profile.h"
+#include "inittasks.h"
+
+static void *RunTask(void *Arg);
+
+/*****************************************************************************
+  RunTask()
+*****************************************************************************/
+static void *RunTask(void *Arg)
+{
+  INITTASK *Task = (INITTASK *) Arg;
+  double Start;
+
+  /* the thread has the processor of the main thread if it is pinned */
+  if (Task->Concurrent)
+    UnpinThread();
+  Start = WallClock();
+  Task->Run(Task->Arg);
+  Task->Wall = WallClock() - Start;
+  return NULL;
+}
+
+/*****************************************************************************
+  StartInitTask()
+
+  Runs Run(Arg) as the stage Name, in a thread of its own if Concurrent is
+  TRUE
+*****************************************************************************/
+void StartInitTask(INITTASK *Task, const char *Name, void (*Run)(void *),
+		   void *Arg, int Concurrent)
+{
+  Task->Name = Name;
+  Task->Run = Run;
+  Task->Arg = Arg;
+  Task->Concurrent = FALSE;
+  Task->Wall = 0.0;
+
+#ifdef HAVE_PTHREAD
+  if (Concurrent) {
+    Task->Concurrent = TRUE;
+    if (pthread_create(&(Task->Thread), NULL, RunTask, Task) == 0)
+      return;
+    Task->Concurrent = FALSE;
+    printf("WARNING: cannot start a thread for %s\n", Name);
+  }
+#endif
+  RunTask(Task);
+}
+
+/*****************************************************************************
+  WaitInitTask()
+
+  Waits for the task to finish, and records its run time in the profile of
+  the initialization
+*****************************************************************************/
+void WaitInitTask(INITTASK *Task)
+{
+#ifdef HAVE_PTHREAD
+  if (Task->Concurrent)
+    pthread_join(Task->Thread, NULL);
+#endif
+  StartupTask(Task->Name, Task->Wall, Task->Concurrent);
+  Task->Concurrent = FALSE;
+}
@@ -10,6 +10,9 @@
  * DESCRIP-END.
  * FUNCTIONS:    InitTerrainMaps()
  *               InitTopoMap()
+ *               InitActiveCells()
+ *               CompareCellOrder()
+ *               OrderActiveCells()
  *               InitSoilMap()
  *               InitVegMap()
  * COMMENTS:
@@ -26,10 +29,18 @@
 #include "functions.h"
 #include "constants.h"
 #include "getinit.h"
+#include "memaccount.h"
 #include "sizeofnt.h"
 #include "slopeaspect.h"
 #include "varid.h"
 
+static int CompareCellOrder(const void *A, const void *B);
+
+/* cells and order of the sort in InitActiveCells() */
+static ITEM *SortCells;
+static int SortOrder;
+static int SortTile;
+
  /*****************************************************************************
    InitTerrainMaps()
  *****************************************************************************/
@@ -39,6 +50,7 @@ void InitTerrainMaps(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
   printf("\nInitializing terrain maps\n");
 
   InitTopoMap(Input, Options, Map, TopoMap);
+  InitActiveCells(Map, *TopoMap, Options);
   InitSoilMap(Input, Options, Map, Soil, *TopoMap, SoilMap);
   InitVegMap(Options, Input, Map, VegMap);
 }
@@ -54,10 +66,7 @@ void InitTopoMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
   int i;			/* Counter */
   int x;			/* Counter */
   int y;			/* Counter */
-  int flag;         /* either or not reverse the matrix */
   int NumberType;		/* Number type of data set */
-  unsigned char *Mask = NULL;	/* Basin mask */
-  float *Elev;			/* Surface elevation */
   STRINIENTRY StrEnv[] = {
     {"TERRAIN", "DEM FILE", "", ""},
     {"TERRAIN", "BASIN MASK FILE", "", ""},
@@ -65,12 +74,21 @@ void InitTopoMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
   };
 
   /* Process the [TERRAIN] section in the input file */
-  if (!(*TopoMap = (TOPOPIX **)calloc(Map->NY, sizeof(TOPOPIX *))))
+  /* the map has a border of cells that are outside the basin, so that the
+     neighbour loops in SlopeAspect.c do not need to check the grid bounds.
+     The border elevation is set so high that it is never chosen as the 
+     direction of steepest descent */
+  if (!(*TopoMap = (TOPOPIX **)AllocHaloMap(Map->NY, Map->NX, sizeof(TOPOPIX),
+					     MEM_TERRAIN)))
     ReportError((char *)Routine, 1);
-  for (y = 0; y < Map->NY; y++) {
-    if (!((*TopoMap)[y] = (TOPOPIX *)calloc(Map->NX, sizeof(TOPOPIX))))
-      ReportError((char *)Routine, 1);
+  FirstTouchRows(Map, *TopoMap, Map->NX * sizeof(TOPOPIX));
+  for (y = -1; y <= Map->NY; y++) {
+    for (x = -1; x <= Map->NX; x++) {
+      if (y == -1 || y == Map->NY || x == -1 || x == Map->NX)
+        (*TopoMap)[y][x].Dem = (float) DHSVM_HUGE;
+    }
   }
+  InitNeighborOffsets(Map);
 
   /* Read the key-entry pairs from the input file */
   for (i = 0; StrEnv[i].SectionName; i++) {
@@ -80,64 +98,17 @@ void InitTopoMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
       ReportError(StrEnv[i].KeyName, 51);
   }
 
-  /* Read the elevation data from the DEM dataset */
+  /* Read the elevation data from the DEM dataset and the mask, the rows of
+     a NetCDF map from south to north are reversed by Read2DField() */
   GetVarName(001, 0, VarName);
   GetVarNumberType(001, &NumberType);
-  if (!(Elev = (float *)calloc(Map->NX * Map->NY,
-    SizeOfNumberType(NumberType))))
-    ReportError((char *)Routine, 1);
-
-  flag = Read2DMatrix(StrEnv[demfile].VarStr, Elev, NumberType, Map, 0,
-    VarName, 0);
-
-  /* Assign the attributes to the map pixel */
-  /* Reverse the matrix is flag = 1 & netcdf option is selected */
-  if ((Options->FileFormat == NETCDF && flag == 0) || (Options->FileFormat == BIN)) {
-    for (y = 0, i = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*TopoMap)[y][x].Dem = Elev[i];
-      }
-    }
-  }
-  else if (Options->FileFormat == NETCDF && flag == 1) {
-    for (y = Map->NY - 1, i = 0; y >= 0; y--) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*TopoMap)[y][x].Dem = Elev[i];
-      }
-    }
-  }
-  else ReportError((char *)Routine, 57);
-  free(Elev);
+  Read2DField(StrEnv[demfile].VarStr, NumberType, Map, 0, VarName, 0,
+	      MAP_FIELD(*TopoMap, TOPOPIX, Dem, NC_FLOAT));
 
-  /* Read the mask */
   GetVarName(002, 0, VarName);
   GetVarNumberType(002, &NumberType);
-  if (!(Mask = (unsigned char *)calloc(Map->NX * Map->NY,
-    SizeOfNumberType(NumberType))))
-    ReportError((char *)Routine, 1);
-  flag = Read2DMatrix(StrEnv[maskfile].VarStr, Mask, NumberType, Map, 0,
-    VarName, 0);
-
-  if ((Options->FileFormat == NETCDF && flag == 0)
-    || (Options->FileFormat == BIN))
-  {
-    for (y = 0, i = 0; y < Map->NY; y++) {
-
-
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*TopoMap)[y][x].Mask = Mask[i];
-      }
-    }
-  }
-  else if (Options->FileFormat == NETCDF && flag == 1) {
-    for (y = Map->NY - 1, i = 0; y >= 0; y--) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*TopoMap)[y][x].Mask = Mask[i];
-      }
-    }
-  }
-  else ReportError((char *)Routine, 57);
-  free(Mask);
+  Read2DField(StrEnv[maskfile].VarStr, NumberType, Map, 0, VarName, 0,
+	      MAP_FIELD(*TopoMap, TOPOPIX, Mask, NC_BYTE));
 
   /* find out the minimum grid elevation of the basin (using the mask) */
   MINELEV = 9999;
@@ -155,7 +126,7 @@ void InitTopoMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
   /* Calculate slope, aspect, magnitude of subsurface flow gradient, and
      fraction of flow flowing in each direction based on the land surface
      slope. */
-  ElevationSlopeAspect(Map, *TopoMap);
+  ElevationSlopeAspect(Map, *TopoMap, Options->NThreads);
 
 
   /* After calculating the slopes and aspects for all the points, reset the
@@ -168,6 +139,196 @@ void InitTopoMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
   }
 }
 
+/*****************************************************************************
+  InitActiveCells()
+
+  Build a dense index of the cells that are modeled (the basin mask, or the
+  single model pixel in point mode), in the same row-major order as a sweep
+  over the full NY*NX bounding box.  The per-pixel kernels iterate this
+  index instead of testing INBASIN() for every cell in the bounding box,
+  which gives identical results because the visiting order is unchanged.
+
+  With OPTIONS CELL ORDER = MORTON or TILES the index is then sorted along
+  a Z-order curve or by square tiles, so that the cells that are visited
+  one after the other, and the entries of every per-cell array, are close
+  together in both directions.  The neighbours of a cell in the rows above
+  and below are then usually still in the cache on wide grids.
+  Map->RowOrder keeps the row-major order for the files that store the
+  basin cells as a vector.
+*****************************************************************************/
+void InitActiveCells(MAPSIZE * Map, TOPOPIX ** TopoMap, OPTIONSTRUCT * Options)
+{
+  const char *Routine = "InitActiveCells";
+  ITEM *RowCells;		/* active cells in row-major order */
+  int *Perm;			/* row-major index of each cell in the order */
+  int k;			/* counter */
+  int x;			/* counter */
+  int y;			/* counter */
+
+  Map->NumActive = 0;
+  for (y = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++)
+      if (INBASIN(TopoMap[y][x].Mask))
+        Map->NumActive++;
+
+  if (Map->NumActive == 0)
+    ReportError((char *)Routine, 70);
+
+  if (!(Map->ActiveCells = (ITEM *)TaggedCalloc(Map->NumActive, sizeof(ITEM),
+						MEM_TERRAIN)))
+    ReportError((char *)Routine, 1);
+
+  for (y = 0, k = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
+      if (INBASIN(TopoMap[y][x].Mask)) {
+        Map->ActiveCells[k].Rank = TopoMap[y][x].Dem;
+        Map->ActiveCells[k].y = y;
+        Map->ActiveCells[k].x = x;
+        k++;
+      }
+    }
+  }
+  printf("%d of %d cells in the bounding box are active\n", Map->NumActive,
+         Map->NX * Map->NY);
+
+  Map->RowOrder = NULL;
+  if (Options->CellOrder == CELLORDER_ROW || Map->NumActive == 1)
+    return;
+
+  if (!(RowCells = (ITEM *) malloc(Map->NumActive * sizeof(ITEM))) ||
+      !(Perm = (int *) malloc(Map->NumActive * sizeof(int))) ||
+      !(Map->RowOrder = (int *) TaggedMalloc(Map->NumActive * sizeof(int),
+					     MEM_TERRAIN)))
+    ReportError((char *)Routine, 1);
+  for (k = 0; k < Map->NumActive; k++) {
+    RowCells[k] = Map->ActiveCells[k];
+    Perm[k] = k;
+  }
+  SortCells = RowCells;
+  SortOrder = Options->CellOrder;
+  SortTile = Options->CellOrderTile;
+  qsort(Perm, Map->NumActive, sizeof(int), CompareCellOrder);
+  for (k = 0; k < Map->NumActive; k++) {
+    Map->ActiveCells[k] = RowCells[Perm[k]];
+    Map->RowOrder[Perm[k]] = k;
+  }
+  free(Perm);
+  free(RowCells);
+
+  if (Options->CellOrder == CELLORDER_MORTON)
+    printf("Active cells in Morton (Z-curve) order\n");
+  else
+    printf("Active cells in tiles of %d x %d cells\n", Options->CellOrderTile,
+	   Options->CellOrderTile);
+}
+
+/*****************************************************************************
+  CompareCellOrder()
+
+  qsort() comparison of two row-major indices of SortCells.  MORTON compares
+  the coordinates at the most significant bit in which they differ, which
+  is the order of the interleaved bits (y before x) without building the
+  keys.  TILES compares the tile row, the tile column and then the cell.
+*****************************************************************************/
+static int CompareCellOrder(const void *A, const void *B)
+{
+  ITEM *CellA = &(SortCells[*((const int *) A)]);
+  ITEM *CellB = &(SortCells[*((const int *) B)]);
+  unsigned int DiffY;
+  unsigned int DiffX;
+  int a, b;
+
+  if (SortOrder == CELLORDER_MORTON) {
+    DiffY = (unsigned int) (CellA->y ^ CellB->y);
+    DiffX = (unsigned int) (CellA->x ^ CellB->x);
+    /* the highest bit of DiffY is below the highest bit of DiffX */
+    if (DiffY < DiffX && DiffY < (DiffY ^ DiffX)) {
+      a = CellA->x;
+      b = CellB->x;
+    }
+    else {
+      a = CellA->y;
+      b = CellB->y;
+    }
+  }
+  else {
+    a = CellA->y / SortTile;
+    b = CellB->y / SortTile;
+    if (a == b) {
+      a = CellA->x / SortTile;
+      b = CellB->x / SortTile;
+    }
+    if (a == b) {
+      a = CellA->y;
+      b = CellB->y;
+    }
+    if (a == b) {
+      a = CellA->x;
+      b = CellB->x;
+    }
+  }
+  return (a < b) ? -1 : (a > b);
+}
+
+/*****************************************************************************
+  OrderActiveCells()
+
+  Determine the order in which the threaded pixel loop visits the active 
+  cells.  Cells with a snow pack are much more expensive than cells without
+  one, and they are usually clustered at high elevations, so with a static
+  schedule a few threads get most of them.  The cells with and without snow
+  are therefore merged evenly, each set in row-major order, so that every
+  contiguous block of CellOrder holds about the same share of snow cells.
+  Returns the number of snow cells.
+*****************************************************************************/
+int OrderActiveCells(MAPSIZE * Map, SNOWPIX ** SnowMap, int *CellOrder)
+{
+  int j;			/* counter */
+  int k;			/* counter */
+  int n;			/* number of cells without snow placed */
+  int s;			/* number of snow cells placed */
+  int NSnow;			/* number of snow cells */
+  int NBare;			/* number of cells without snow */
+  int *Bare;			/* cells without snow, stored from the back of
+				   CellOrder */
+
+  /* snow cells go to the front of CellOrder and the other cells to the back
+     (in reverse), then the two sets are merged in place from the front */
+  NSnow = 0;
+  NBare = 0;
+  for (k = 0; k < Map->NumActive; k++) {
+    if (SnowMap[Map->ActiveCells[k].y][Map->ActiveCells[k].x].HasSnow)
+      CellOrder[NSnow++] = k;
+    else
+      CellOrder[Map->NumActive - 1 - NBare++] = k;
+  }
+  if (NSnow == 0 || NBare == 0) {
+    for (k = 0; k < Map->NumActive; k++)
+      CellOrder[k] = k;
+    return NSnow;
+  }
+
+  if (!(Bare = (int *)malloc(NBare * sizeof(int))))
+    ReportError("OrderActiveCells", 1);
+  for (n = 0; n < NBare; n++)
+    Bare[n] = CellOrder[Map->NumActive - 1 - n];
+
+  /* the snow cells only move towards the back, so they can be merged in 
+     place by filling CellOrder from the back */
+  s = NSnow - 1;
+  n = NBare - 1;
+  for (j = Map->NumActive - 1; j >= 0; j--) {
+    if (n < 0 || (s >= 0 && (long) (2 * s + 1) * NBare >
+		  (long) (2 * n + 1) * NSnow))
+      CellOrder[j] = CellOrder[s--];
+    else
+      CellOrder[j] = Bare[n--];
+  }
+
+  free(Bare);
+  return NSnow;
+}
+
 /*****************************************************************************
   InitSoilMap()
 *****************************************************************************/
@@ -180,9 +341,12 @@ void InitSoilMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
   int x;			/* counter */
   int y;			/* counter */
   int NumberType;		/* number type */
-  unsigned char *Type;		/* Soil type */
-  float *Depth;			/* Soil depth */
-  int flag;
+  int NLayerTotal;		/* Number of soil layers summed over the
+				   active cells */
+  float *MoistBlock;		/* Soil moisture for all active cells */
+  float *PercBlock;		/* Percolation for all active cells */
+  float *TempBlock;		/* Soil temperature for all active cells */
+  int NFluxTotal;		/* Values of PercBlock and TempBlock */
   STRINIENTRY StrEnv[] = {
     {"SOILS", "SOIL MAP FILE", "", ""},
     {"SOILS", "SOIL DEPTH FILE", "", ""},
@@ -191,12 +355,10 @@ void InitSoilMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
 
   /* Process the filenames in the [SOILS] section in the input file */
   /* Assign the attributes to the correct map pixel */
-  if (!(*SoilMap = (SOILPIX **)calloc(Map->NY, sizeof(SOILPIX *))))
+  if (!(*SoilMap = (SOILPIX **)AllocHaloMap(Map->NY, Map->NX, sizeof(SOILPIX),
+					     MEM_SOIL)))
     ReportError((char *)Routine, 1);
-  for (y = 0; y < Map->NY; y++) {
-    if (!((*SoilMap)[y] = (SOILPIX *)calloc(Map->NX, sizeof(SOILPIX))))
-      ReportError((char *)Routine, 1);
-  }
+  FirstTouchRows(Map, *SoilMap, Map->NX * sizeof(SOILPIX));
 
   /* Read the key-entry pairs from the input file */
   for (i = 0; StrEnv[i].SectionName; i++) {
@@ -206,81 +368,63 @@ void InitSoilMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
       ReportError(StrEnv[i].KeyName, 51);
   }
 
-  /* Read the soil type */
+  /* Read the soil type and the total soil depth */
   GetVarName(003, 0, VarName);
   GetVarNumberType(003, &NumberType);
-  if (!(Type = (unsigned char *)calloc(Map->NX * Map->NY,
-    SizeOfNumberType(NumberType))))
-    ReportError((char *)Routine, 1);
-  flag = Read2DMatrix(StrEnv[soiltype_file].VarStr, Type, NumberType, Map, 0, VarName, 0);
-
-  if ((Options->FileFormat == NETCDF && flag == 0)
-    || (Options->FileFormat == BIN))
-  {
-    for (y = 0, i = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        if (((int)Type[i]) > Soil->NTypes)
-          ReportError(StrEnv[soiltype_file].VarStr, 32);
-        (*SoilMap)[y][x].Soil = Type[i];
-      }
-    }
-  }
-  else if (Options->FileFormat == NETCDF && flag == 1) {
-    for (y = Map->NY - 1, i = 0; y >= 0; y--) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        if (((int)Type[i]) > Soil->NTypes)
-          ReportError(StrEnv[soiltype_file].VarStr, 32);
-        (*SoilMap)[y][x].Soil = Type[i];
-      }
-    }
-  }
-  else ReportError((char *)Routine, 57);
+  Read2DField(StrEnv[soiltype_file].VarStr, NumberType, Map, 0, VarName, 0,
+	      MAP_FIELD(*SoilMap, SOILPIX, Soil, NC_INT));
+  for (y = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++)
+      if ((*SoilMap)[y][x].Soil > Soil->NTypes)
+        ReportError(StrEnv[soiltype_file].VarStr, 32);
 
-  /* Read the total soil depth  */
   GetVarName(004, 0, VarName);
   GetVarNumberType(004, &NumberType);
-  if (!(Depth = (float *)calloc(Map->NX * Map->NY,
-    SizeOfNumberType(NumberType))))
+  Read2DField(StrEnv[soildepth_file].VarStr, NumberType, Map, 0, VarName, 0,
+	      MAP_FIELD(*SoilMap, SOILPIX, Depth, NC_FLOAT));
+
+  /* the layered soil variables of all active cells are stored in one
+     contiguous [cell][layer] block per variable, in the same row-major
+     order as Map->ActiveCells, rather than in separate allocations.  With
+     SNOW ONLY the percolation and the soil temperature do not change, and
+     all the cells share one zero row of them */
+  NLayerTotal = 0;
+  for (y = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++)
+      if (INBASIN(TopoMap[y][x].Mask))
+        NLayerTotal += Soil->NLayers[(*SoilMap)[y][x].Soil - 1];
+  NFluxTotal = Options->SnowOnly ? Soil->MaxLayers : NLayerTotal;
+
+  if (!(MoistBlock = (float *)TaggedCalloc(NLayerTotal + Map->NumActive, 
+					   sizeof(float), MEM_SOIL)))
     ReportError((char *)Routine, 1);
-  flag = Read2DMatrix(StrEnv[soildepth_file].VarStr, Depth, NumberType, Map, 0, VarName, 0);
-
-  /* Assign the attributes to the correct map pixel */
-  if ((Options->FileFormat == NETCDF && flag == 0)
-    || (Options->FileFormat == BIN))
-  {
-    for (y = 0, i = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*SoilMap)[y][x].Depth = Depth[i];
-      }
-    }
-  }
-  else if (Options->FileFormat == NETCDF && flag == 1) {
-    for (y = Map->NY - 1, i = 0; y >= 0; y--) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*SoilMap)[y][x].Depth = Depth[i];
-      }
-    }
-  }
-  else ReportError((char *)Routine, 57);
+  if (!(PercBlock = (float *)TaggedCalloc(NFluxTotal, sizeof(float),
+					  MEM_SOIL)))
+    ReportError((char *)Routine, 1);
+  if (!(TempBlock = (float *)TaggedCalloc(NFluxTotal, sizeof(float),
+					  MEM_SOIL)))
+    ReportError((char *)Routine, 1);
+  FirstTouchBlock(MoistBlock, NLayerTotal + Map->NumActive, sizeof(float));
+  FirstTouchBlock(PercBlock, NFluxTotal, sizeof(float));
+  FirstTouchBlock(TempBlock, NFluxTotal, sizeof(float));
 
-  for (y = 0, i = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++, i++) {
+  for (y = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
       if (Options->Infiltration == DYNAMIC)
         (*SoilMap)[y][x].InfiltAcc = 0.;
       (*SoilMap)[y][x].MoistInit = 0.;
 
-      /* allocate memory for the number of root layers, plus an additional
+      /* assign memory for the number of root layers, plus an additional
        layer below the deepest root layer */
       if (INBASIN(TopoMap[y][x].Mask)) {
-        if (!((*SoilMap)[y][x].Moist =
-          (float *)calloc((Soil->NLayers[Type[i] - 1] + 1), sizeof(float))))
-          ReportError((char *)Routine, 1);
-        if (!((*SoilMap)[y][x].Perc =
-          (float *)calloc(Soil->NLayers[Type[i] - 1], sizeof(float))))
-          ReportError((char *)Routine, 1);
-        if (!((*SoilMap)[y][x].Temp =
-          (float *)calloc(Soil->NLayers[Type[i] - 1], sizeof(float))))
-          ReportError((char *)Routine, 1);
+        (*SoilMap)[y][x].Moist = MoistBlock;
+        (*SoilMap)[y][x].Perc = PercBlock;
+        (*SoilMap)[y][x].Temp = TempBlock;
+        MoistBlock += Soil->NLayers[(*SoilMap)[y][x].Soil - 1] + 1;
+        if (!Options->SnowOnly) {
+          PercBlock += Soil->NLayers[(*SoilMap)[y][x].Soil - 1];
+          TempBlock += Soil->NLayers[(*SoilMap)[y][x].Soil - 1];
+        }
       }
       else {
         (*SoilMap)[y][x].Moist = NULL;
@@ -289,8 +433,6 @@ void InitSoilMap(LISTPTR Input, OPTIONSTRUCT * Options, MAPSIZE * Map,
       }
     }
   }
-  free(Type);
-  free(Depth);
 }
 
 /*****************************************************************************
@@ -301,12 +443,8 @@ void InitVegMap(OPTIONSTRUCT * Options, LISTPTR Input, MAPSIZE * Map, VEGPIX ***
   const char *Routine = "InitVegMap";
   char VarName[BUFSIZE + 1];
   char VegMapFileName[BUFSIZE + 1];
-  int i;			/* counter */
-  int x;			/* counter */
   int y;			/* counter */
-  int flag;
   int NumberType;		/* number type */
-  unsigned char *Type;		/* Vegetation type */
 
   /* Get the map filename from the [VEGETATION] section */
   GetInitString("VEGETATION", "VEGETATION MAP FILE", "", VegMapFileName,
@@ -314,43 +452,20 @@ void InitVegMap(OPTIONSTRUCT * Options, LISTPTR Input, MAPSIZE * Map, VEGPIX ***
   if (!VegMapFileName)
     ReportError("VEGETATION MAP FILE", 51);
 
-  /* Read the vegetation type */
-  GetVarName(005, 0, VarName);
-  GetVarNumberType(005, &NumberType);
-  if (!(Type = (unsigned char *)calloc(Map->NX * Map->NY,
-    SizeOfNumberType(NumberType))))
-    ReportError((char *)Routine, 1);
-  flag = Read2DMatrix(VegMapFileName, Type, NumberType, Map, 0, VarName, 0);
-
-  /* Assign the attributes to the correct map pixel */
-  if (!(*VegMap = (VEGPIX **)calloc(Map->NY, sizeof(VEGPIX *))))
+  if (!(*VegMap = (VEGPIX **)TaggedCalloc(Map->NY, sizeof(VEGPIX *), MEM_VEG)))
     ReportError((char *)Routine, 1);
   for (y = 0; y < Map->NY; y++) {
-    if (!((*VegMap)[y] = (VEGPIX *)calloc(Map->NX, sizeof(VEGPIX))))
+    if (!((*VegMap)[y] = (VEGPIX *)TaggedCalloc(Map->NX, sizeof(VEGPIX),
+						MEM_VEG)))
       ReportError((char *)Routine, 1);
   }
+  FirstTouchRows(Map, *VegMap, Map->NX * sizeof(VEGPIX));
 
-  if ((Options->FileFormat == NETCDF && flag == 0)
-    || (Options->FileFormat == BIN))
-  {
-    for (y = 0, i = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*VegMap)[y][x].Veg = Type[i];
-        (*VegMap)[y][x].Tcanopy = 0.0;
-      }
-    }
-  }
-  else if (Options->FileFormat == NETCDF && flag == 1) {
-    for (y = Map->NY - 1, i = 0; y >= 0; y--) {
-      for (x = 0; x < Map->NX; x++, i++) {
-        (*VegMap)[y][x].Veg = Type[i];
-        (*VegMap)[y][x].Tcanopy = 0.0;
-      }
-    }
-  }
-  else ReportError((char *)Routine, 57);
-
-  free(Type);
+  /* Read the vegetation type, Tcanopy is 0 */
+  GetVarName(005, 0, VarName);
+  GetVarNumberType(005, &NumberType);
+  Read2DField(VegMapFileName, NumberType, Map, 0, VarName, 0,
+	      MAP_FIELD(*VegMap, VEGPIX, Veg, NC_INT));
 }
 
 
@@ -55,14 +55,11 @@ void InitUnitHydrograph(LISTPTR Input, MAPSIZE * Map, TOPOPIX ** TopoMap,
   int WaveLength;
   int i;
   int j;
-  int x;
-  int y;
   STRINIENTRY StrEnv[] = {
     {"ROUTING", "TRAVEL TIME FILE", "", NULL},
     {"ROUTING", "UNIT HYDROGRAPH FILE", "", NULL},
     {NULL, NULL, "", NULL}
   };
-  unsigned short *Travel;
 
   printf("Initializing unit hydrograph\n");
 
@@ -77,17 +74,8 @@ void InitUnitHydrograph(LISTPTR Input, MAPSIZE * Map, TOPOPIX ** TopoMap,
   /* Read the travel times */
   GetVarName(006, 0, VarName);
   GetVarNumberType(006, &NumberType);
-  if (!(Travel = (unsigned short *) calloc(Map->NX * Map->NY,
-					   SizeOfNumberType(NumberType))))
-    ReportError((char *) Routine, 1);
-
-  Read2DMatrix(StrEnv[travel_file].VarStr, Travel, NumberType, Map, 0, VarName, 0);
-
-  /* Assign the travel times to the correct pixels */
-  for (y = 0, i = 0; y < Map->NY; y++)
-    for (x = 0; x < Map->NX; x++, i++)
-      TopoMap[y][x].Travel = Travel[i];
-  free(Travel);
+  Read2DField(StrEnv[travel_file].VarStr, NumberType, Map, 0, VarName, 0,
+	      MAP_FIELD(TopoMap, TOPOPIX, Travel, NC_SHORT));
 
   /* Read the unit hydrograph file */
   OpenFile(&HydrographFile, StrEnv[hydrograph_file].VarStr, "r", FALSE);
@@ -122,9 +110,15 @@ void InitUnitHydrograph(LISTPTR Input, MAPSIZE * Map, TOPOPIX ** TopoMap,
   HydrographInfo->TotalWaveLength =
     (*UnitHydrograph)[MaxTravelTime - 1][WaveLength - 1].TimeStep + 1;
 
+  /* The hydrograph is a ring buffer that starts at HydrographInfo->Head */
   if (!(*Hydrograph = (float *) calloc(HydrographInfo->TotalWaveLength,
 				       sizeof(float))))
     ReportError((char *) Routine, 1);
+  HydrographInfo->Head = 0;
+
+  if (!(HydrographInfo->TravelRunoff =
+	(float *) calloc(MaxTravelTime, sizeof(float))))
+    ReportError((char *) Routine, 1);
 
   fclose(HydrographFile);
 }
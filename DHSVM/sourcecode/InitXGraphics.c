@@ -9,7 +9,7 @@
  * DESCRIPTION:  Initialize the X11 graphics for DHSVM
  * DESCRIP-END.
  * FUNCTIONS:    InitXGraphics()
- * COMMENTS:
+ * COMMENTS:     The memory of the graphics is allocated by InitGraphics()
  * $Id: InitXGraphics.c,v 1.4 2003/07/01 21:26:18 olivier Exp $
  */
 
@@ -18,6 +18,7 @@
 #include "settings.h"
 #include "data.h"
 #include "DHSVMerror.h"
+#include "graphics.h"
 
 #ifdef HAVE_X11
 #include <X11/Xlib.h>
@@ -29,13 +30,19 @@ Display *display;
 Window window;
 GC gc;
 XColor my_color[50];
-float **temp_array;
 long black, white;
 int e, ndx;
 #endif
 
-void InitXGraphics(int argc, char **argv, int ny, int nx, int nd, 
-		   MET_MAP_PIX *** MetMap)
+/*****************************************************************************
+  InitXGraphics()
+
+  Opens the X11 display and sizes the images of the nd graphics of the ny x
+  nx basin to the screen.  Returns the number of grid cells per displayed
+  pixel in each direction (1 if the images are expanded), 0 if DHSVM was
+  built without X11
+*****************************************************************************/
+int InitXGraphics(int argc, char **argv, int ny, int nx, int nd)
 {
   /* following is for the X11 libraries */
 
@@ -154,42 +161,9 @@ void InitXGraphics(int argc, char **argv, int ny, int nx, int nd,
   XMapWindow(display, window);
 
   cmap = XDefaultColormap(display, screen);
-  /* black to blue */
-  for (i = 0; i < 10; i++) {
-    my_color[i].red = 0;
-    my_color[i].green = 0;
-    my_color[i].blue = 65535 * i / 9;
-  }
-  /* blue to cyan */
-  for (i = 10; i < 20; i++) {
-    my_color[i].red = 0;
-    my_color[i].green = i * 65535 / 19;
-    my_color[i].blue = 65535;
-  }
-  /*cyan to green */
-  for (i = 20; i < 25; i++) {
-    my_color[i].red = 0;
-    my_color[i].green = 65535;
-    my_color[i].blue = 65535 - (65535 * (i - 20) / 5);
-  }
-  /*green to yellow */
-  for (i = 25; i < 30; i++) {
-    my_color[i].red = (i - 25) * 65535 / 5;
-    my_color[i].green = 65535;
-    my_color[i].blue = 0;
-  }
-  /*yellow to magenta */
-  for (i = 30; i < 40; i++) {
-    my_color[i].red = 65535;
-    my_color[i].green = 65535 - (65535 * (i - 30) / 9);
-    my_color[i].blue = 65535 * (i - 30) / 9;
-  }
-  /*magenta to red */
-  for (i = 40; i < 50; i++) {
-    my_color[i].red = 65335;
-    my_color[i].green = 0;
-    my_color[i].blue = 65535 - (65535 * (i - 40) / 9);
-  }
+  for (i = 0; i < 50; i++)
+    GraphicsPalette(i, &(my_color[i].red), &(my_color[i].green),
+		    &(my_color[i].blue));
 
   for (i = 0; i < 50; i++) {
     if (XAllocColor(display, cmap, &my_color[i]) == 0) {
@@ -200,24 +174,8 @@ void InitXGraphics(int argc, char **argv, int ny, int nx, int nd,
 
   /* done initializing the X11 Display, available for drawing */
 
-  /* initialize the memory used solely by the drawing functions */
-
-  if (!((*MetMap) = (MET_MAP_PIX **) calloc(ny, sizeof(MET_MAP_PIX *))))
-    ReportError("InitXGraphics", 1);
-
-  for (y = 0; y < ny; y++) {
-    if (!((*MetMap)[y] = (MET_MAP_PIX *) calloc(nx, sizeof(MET_MAP_PIX))))
-      ReportError("InitXGraphics", 1);
-  }
-
-  if ((temp_array = (float **) malloc(ny * sizeof(float *))) == NULL) {
-    ReportError("draw.c", 1);
-  }
-  for (y = 0; y < ny; y++) {
-    if ((temp_array[y] = (float *) malloc(nx * sizeof(float))) == NULL) {
-      ReportError("draw.c", 1);
-    }
-  }
-
+  return (e < 0) ? -e : 1;
+#else
+  return 0;
 #endif
 }
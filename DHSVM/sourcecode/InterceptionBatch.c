@@ -0,0 +1,351 @@
+/*
+ * SUMMARY:      InterceptionBatch.c - Rain interception of many cells at once
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS INTERCEPTION BATCH the pixel loop does the
+ *               rainfall momentum and InterceptionStorage() for the cells
+ *               of a piece of a tile together, after their radiation
+ *               balance of RADIATION BATCH and before MassEnergyBalance()
+ *               of the cells, which then leaves them out.  The storage,
+ *               throughfall and leaf drip momentum of the vegetation
+ *               layers are loops over arrays of the cells, with the
+ *               branches of the scalar code turned into selects that the
+ *               compiler can vectorize, and the results are scattered to
+ *               the PRECIPPIX of the cells.  Built with HAVE_OPENMP_TARGET
+ *               (CMake DHSVM_USE_OPENMP_TARGET) the loops are offloaded
+ *               to the default device with OpenMP target, one cell per
+ *               device thread, and run on the host if there is no device
+ * DESCRIP-END.
+ * FUNCTIONS:    ClearInterceptionBatch()
+ *               AddInterceptionCell()
+ *               InterceptionBatch()
+ *               InterceptionFieldsTarget()
+ *               FreeInterceptionBatch()
+ *               SelectInterceptionKernels()
+ *               MoreCells()
+ * COMMENTS:     The operations are those of MassEnergyBalance() and
+ *               InterceptionStorage() in the same order and precision, so
+ *               the results are the same as those of the scalar code.  The
+ *               cells with snow on the canopy (SnowOnCanopy()) are left to
+ *               SnowInterception() in MassEnergyBalance(), whose energy
+ *               balance depends on the aerodynamic resistance of the cell.
+ *               The rainfall momentum needs MathPow() of the intensity and
+ *               is done cell by cell in AddInterceptionCell().  The loops
+ *               are in interceptionkernels.h, which is compiled for each
+ *               SIMD level of cpudispatch.h.  The batch of a piece is
+ *               copied to the device and back for each call, the state of
+ *               the cells stays on the host.  A device compiler that
+ *               contracts a multiply and an add can change the last bits
+ *               of the results
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "massenergy.h"
+#include "constants.h"
+#include "cpudispatch.h"
+
+/* the vegetation layers of a cell, an overstory and an understory */
+#define INT_LAYERS 2
+
+/* the arrays of Batch->Fields, the layer arrays for each layer */
+enum INTFIELD {
+  IF_RAIN, IF_MSRAIN, IF_MOMENTSQ,
+  IF_MAXINT, IF_FRACT = IF_MAXINT + INT_LAYERS, IF_INT = IF_FRACT + INT_LAYERS,
+  INT_FIELDS = IF_INT + INT_LAYERS
+};
+#define FIELD(Batch, f) ((Batch)->Fields + (f) * (Batch)->MaxCells)
+
+static void MoreCells(INTBATCH *Batch);
+
+/* the loops of each SIMD level, and the one selected by InitCpuDispatch() */
+typedef void (*INTKERNEL) (INTBATCH *Batch, float Dt);
+
+#ifdef HAVE_SIMD_DISPATCH
+/* the selects of the loops are only vectorized if the operations of both
+   sides may be done, which does not change the results, and a multiply
+   and an add are not contracted at the levels with FMA */
+#pragma GCC push_options
+#pragma GCC optimize("no-trapping-math", "fp-contract=off")
+#endif
+#define SIMD_SUFFIX _sse2
+#include "interceptionkernels.h"
+#undef SIMD_SUFFIX
+#ifdef HAVE_SIMD_DISPATCH
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SIMD_SUFFIX _avx2
+#include "interceptionkernels.h"
+#undef SIMD_SUFFIX
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f", "prefer-vector-width=512")
+#define SIMD_SUFFIX _avx512
+#include "interceptionkernels.h"
+#undef SIMD_SUFFIX
+#pragma GCC pop_options
+#pragma GCC pop_options
+#endif
+
+#ifdef HAVE_OPENMP_TARGET
+static void InterceptionFieldsTarget(INTBATCH *Batch, float Dt);
+static INTKERNEL InterceptionFields = InterceptionFieldsTarget;
+#else
+static INTKERNEL InterceptionFields = InterceptionFields_sse2;
+#endif
+
+/*****************************************************************************
+  Function name: ClearInterceptionBatch()
+
+  Purpose      : Empty the batch for the next piece of the pixel loop
+*****************************************************************************/
+void ClearInterceptionBatch(INTBATCH *Batch)
+{
+  Batch->N = 0;
+}
+
+/*****************************************************************************
+  Function name: AddInterceptionCell()
+
+  Purpose      : Add a cell without snow on the canopy to the batch, do the
+                 parts of MassEnergyBalance() before InterceptionStorage()
+                 and gather the inputs of the interception
+
+  Required     :
+    INTBATCH *Batch     - Batch
+    VEGTABLE *VType     - Vegetation type of the cell
+    PIXMET *LocalMet    - Met of the cell from MakeLocalMetData()
+    VEGPIX *LocalVeg    - Canopy temperature of the cell
+    SNOWPIX *LocalSnow  - Snow conditions of the cell
+    PRECIPPIX *LocalPrecip - Precipitation of the cell, where
+                          InterceptionBatch() puts the results
+    int Dt              - Time step (s)
+
+  Returns      : void
+
+  Modifies     : The canopy temperature, the canopy vapor flux, the
+                 temporary interception storage and the median raindrop
+                 diameter of the cell
+
+  Comments     : Called after the radiation balance of the cells, which
+                 reads the canopy temperature of the previous time step
+*****************************************************************************/
+void AddInterceptionCell(INTBATCH *Batch, VEGTABLE *VType, PIXMET *LocalMet,
+			 VEGPIX *LocalVeg, SNOWPIX *LocalSnow,
+			 PRECIPPIX *LocalPrecip, int Dt)
+{
+  int NVegLActual;
+  int i;
+  int n;
+
+  if (Batch->N == Batch->MaxCells)
+    MoreCells(Batch);
+  n = Batch->N++;
+
+  /* the number of vegetation layers above the snow */
+  NVegLActual = VType->NVegLayers;
+  if (LocalSnow->HasSnow == TRUE && VType->UnderStory == TRUE)
+    --NVegLActual;
+
+  Batch->Precip[n] = LocalPrecip;
+  Batch->Vegetated[n] = VType->NVegLayers > 0;
+  Batch->NActual[n] = NVegLActual;
+  Batch->UnderStory[n] = VType->UnderStory;
+  Batch->LD_MomentSq[n] = VType->LD_MomentSq;
+
+  FIELD(Batch, IF_MSRAIN)[n] = RainfallMomentum(LocalPrecip->RainFall, Dt,
+						&(LocalPrecip->Dm));
+  FIELD(Batch, IF_RAIN)[n] = LocalPrecip->RainFall;
+  for (i = 0; i < INT_LAYERS; i++) {
+    if (i < VType->NVegLayers) {
+      FIELD(Batch, IF_MAXINT + i)[n] = VType->MaxInt[i];
+      FIELD(Batch, IF_FRACT + i)[n] = VType->Fract[i];
+      FIELD(Batch, IF_INT + i)[n] = LocalPrecip->IntRain[i];
+    }
+    else {
+      FIELD(Batch, IF_MAXINT + i)[n] = 0.0;
+      FIELD(Batch, IF_FRACT + i)[n] = 0.0;
+      FIELD(Batch, IF_INT + i)[n] = 0.0;
+    }
+  }
+
+  if (VType->NVegLayers > 0) {
+    LocalVeg->Tcanopy = LocalMet->Tair;
+    LocalSnow->CanopyVaporMassFlux = 0.0;
+    LocalPrecip->TempIntStorage = 0.0;
+  }
+}
+
+/*****************************************************************************
+  Function name: InterceptionBatch()
+
+  Purpose      : InterceptionStorage() for all the cells of the batch
+
+  Required     :
+    INTBATCH *Batch     - Batch
+    int Dt              - Time step (s)
+
+  Returns      : void
+
+  Modifies     : The rain, the interception storage and the momentum
+                 squared of the rain of the cells
+*****************************************************************************/
+void InterceptionBatch(INTBATCH *Batch, int Dt)
+{
+  PRECIPPIX *LocalPrecip;
+  int i;
+  int n;
+
+  if (Batch->N == 0)
+    return;
+
+  InterceptionFields(Batch, (float) Dt);
+
+  for (n = 0; n < Batch->N; n++) {
+    LocalPrecip = Batch->Precip[n];
+
+    /* If no vegetation, kinetic energy is all due to direct
+       precipitation */
+    if (!Batch->Vegetated[n]) {
+      if (LocalPrecip->RainFall > 0.0)
+	LocalPrecip->MomentSq = FIELD(Batch, IF_MSRAIN)[n];
+      continue;
+    }
+    for (i = 0; i < Batch->NActual[n]; i++)
+      LocalPrecip->IntRain[i] = FIELD(Batch, IF_INT + i)[n];
+    LocalPrecip->RainFall = FIELD(Batch, IF_RAIN)[n];
+    LocalPrecip->MomentSq = FIELD(Batch, IF_MOMENTSQ)[n];
+  }
+}
+
+#ifdef HAVE_OPENMP_TARGET
+/*****************************************************************************
+  Function name: InterceptionFieldsTarget()
+
+  Purpose      : InterceptionFields() on the OpenMP target device
+
+  Comments     : The layers of a cell are done one after the other by the
+                 thread of the cell, the operations of each cell are those
+                 of InterceptionFields().  The fields are one block of
+                 INT_FIELDS * MaxCells values, mapped as a whole
+*****************************************************************************/
+static void InterceptionFieldsTarget(INTBATCH *Batch, float Dt)
+{
+  unsigned char *NActual = Batch->NActual;
+  unsigned char *Under = Batch->UnderStory;
+  double *LD_MomentSq = Batch->LD_MomentSq;
+  float *Fields = Batch->Fields;
+  float Available;		/* Available storage */
+  float Intercepted;		/* Amount of water intercepted during this
+				   timestep */
+  float *Rain;
+  double Moment;
+  int M = Batch->MaxCells;
+  int N = Batch->N;
+  int i;
+  int n;
+
+#pragma omp target teams distribute parallel for \
+  map(to: NActual[0:N], Under[0:N], LD_MomentSq[0:N]) \
+  map(tofrom: Fields[0:INT_FIELDS * M]) \
+  private(i, Available, Intercepted, Rain, Moment)
+  for (n = 0; n < N; n++) {
+    Rain = &Fields[IF_RAIN * M + n];
+    for (i = 0; i < INT_LAYERS; i++) {
+      Available = Fields[(IF_MAXINT + i) * M + n] -
+	Fields[(IF_INT + i) * M + n];
+      Intercepted = (Available > *Rain * Fields[(IF_FRACT + i) * M + n]) ?
+	*Rain * Fields[(IF_FRACT + i) * M + n] : Available;
+      Intercepted = (i < NActual[n]) ? Intercepted : 0.0f;
+      *Rain -= Intercepted;
+      Fields[(IF_INT + i) * M + n] += Intercepted;
+    }
+    Moment = LD_MomentSq[n] * *Rain / Dt;
+    Fields[IF_MOMENTSQ * M + n] = Under[n] ? Moment :
+      Moment + (1 - Fields[IF_FRACT * M + n]) * Fields[IF_MSRAIN * M + n];
+  }
+}
+#endif
+
+/*****************************************************************************
+  Function name: FreeInterceptionBatch()
+*****************************************************************************/
+void FreeInterceptionBatch(INTBATCH *Batch)
+{
+  free(Batch->Precip);
+  free(Batch->Vegetated);
+  free(Batch->NActual);
+  free(Batch->UnderStory);
+  free(Batch->LD_MomentSq);
+  free(Batch->Fields);
+  Batch->Precip = NULL;
+  Batch->Vegetated = NULL;
+  Batch->NActual = NULL;
+  Batch->UnderStory = NULL;
+  Batch->LD_MomentSq = NULL;
+  Batch->Fields = NULL;
+  Batch->N = 0;
+  Batch->MaxCells = 0;
+}
+
+/*****************************************************************************
+  Function name: SelectInterceptionKernels()
+
+  Purpose      : Use the interception loops of SIMD Level
+*****************************************************************************/
+void SelectInterceptionKernels(int Level)
+{
+  InterceptionFields = InterceptionFields_sse2;
+#ifdef HAVE_SIMD_DISPATCH
+  if (Level == SIMD_AVX2)
+    InterceptionFields = InterceptionFields_avx2;
+  else if (Level == SIMD_AVX512)
+    InterceptionFields = InterceptionFields_avx512;
+#endif
+#ifdef HAVE_OPENMP_TARGET
+  /* the SIMD levels are those of the host */
+  InterceptionFields = InterceptionFieldsTarget;
+#endif
+}
+
+/*****************************************************************************
+  Function name: MoreCells()
+
+  Purpose      : Make room for more cells, keeping the cells that were added
+
+  Comments     : Each variable is one array of MaxCells values, so the
+                 values are moved to the longer arrays one variable at a
+                 time (GrowFieldBlock()).  The first call allocates the
+                 arrays.
+*****************************************************************************/
+static void MoreCells(INTBATCH *Batch)
+{
+  const char *Routine = "MoreCells";
+  float *Fields;
+  int MaxCells;
+
+  MaxCells = (Batch->MaxCells > 0) ? 2 * Batch->MaxCells : SOIL_BATCH_CELLS;
+  if (!(Batch->Precip = (PRECIPPIX **) realloc(Batch->Precip,
+					       MaxCells * sizeof(PRECIPPIX *))) ||
+      !(Batch->Vegetated = (unsigned char *) realloc(Batch->Vegetated,
+						     MaxCells)) ||
+      !(Batch->NActual = (unsigned char *) realloc(Batch->NActual,
+						   MaxCells)) ||
+      !(Batch->UnderStory = (unsigned char *) realloc(Batch->UnderStory,
+						      MaxCells)) ||
+      !(Batch->LD_MomentSq = (double *) realloc(Batch->LD_MomentSq,
+						MaxCells * sizeof(double))) ||
+      !(Fields = GrowFieldBlock(Batch->Fields, INT_FIELDS, Batch->N,
+				Batch->MaxCells, MaxCells)))
+    ReportError((char *) Routine, 1);
+
+  Batch->Fields = Fields;
+  Batch->MaxCells = MaxCells;
+}
@@ -9,6 +9,9 @@
  * DESCRIPTION:  Calculate interception storage
  * DESCRIP-END.
  * FUNCTIONS:    InterceptionStorage()
+ *               InitLeafDrip()
+ *               RainfallMomentum()
+ *               SnowOnCanopy()
  * COMMENTS:
  * $Id: InterceptionStorage.c,v 1.5 2003/11/12 20:01:51 colleen Exp $
  */
@@ -21,6 +24,12 @@
 #include "DHSVMerror.h"
 #include "massenergy.h"
 #include "constants.h"
+#include "fastmath.h"
+
+/* empirical coefficients for the rainfall momentum of the four classes of
+   rainfall intensity after Wicks and Bathurst (1996) */
+static const float MS_Alpha[4] = { 2.69e-8,3.75e-8,6.12e-8,11.75e-8 };
+static const float MS_Beta[4] = { 1.6896,1.5545,1.4242,1.2821 };
 
  /*****************************************************************************
    InterceptionStorage()
@@ -28,7 +37,7 @@
 void InterceptionStorage(int NMax, int NAct, float *MaxInt, float *Fract,
   float *Int, float *Precip, float *MomentSq, float *Height,
   unsigned char Understory, float Dt, float MS_Rainfall,
-  float LD_FallVelocity)
+  double LD_MomentSq)
 {
   float Available;		/* Available storage */
   float Intercepted;	/* Amount of water intercepted during this timestep */
@@ -51,12 +60,10 @@ void InterceptionStorage(int NMax, int NAct, float *MaxInt, float *Fract,
   if (Understory)
     /* Since the understory is assumed to cover the entire grid cell, all
        momentum is associated with leaf drip, eq. 2, Wicks and Bathurst (1996) */
-    *MomentSq = pow(LD_FallVelocity * WATER_DENSITY, 2) * PI / 6 *
-    pow(LEAF_DRIP_DIA, 3) * (*Precip) / Dt;
+    *MomentSq = LD_MomentSq * (*Precip) / Dt;
   else
     /* If no understory, part of the rainfall reaches the ground as direct throughfall. */
-    *MomentSq = (pow(LD_FallVelocity * WATER_DENSITY, 2) * PI / 6 *
-      pow(LEAF_DRIP_DIA, 3) * (*Precip) / Dt) + (1 - Fract[0]) *
+    *MomentSq = (LD_MomentSq * (*Precip) / Dt) + (1 - Fract[0]) *
     MS_Rainfall;
 
   /* WORK IN PROGESS */
@@ -65,3 +72,128 @@ void InterceptionStorage(int NMax, int NAct, float *MaxInt, float *Fract,
      will cover this vegetation layer at t = T+1, the amount of water in
      storage will be lost */
 }
+
+/*****************************************************************************
+  InitLeafDrip()
+
+  Leaf drip fall velocity of a vegetation type, interpolated from the canopy
+  height after Epema and Riezebos (1983), and the momentum squared of the
+  leaf drip per depth of drip, eq. 2, Wicks and Bathurst (1996).  Both only
+  depend on the vegetation type, InterceptionStorage() and 
+  SnowInterception() multiply VType->LD_MomentSq by the drip of the time
+  step.
+
+  Epema, G.F. and H.T. Riezbos, 1983, Fall Velocity of waterdrops at 
+  different heights as a factor influencing erosivity of simulated rain. 
+  Rainfall simulation, Runoff and Soil Erosion. Catena suppl. 4, 
+  Braunschweig. Jan de Ploey (Ed), 1-17.
+*****************************************************************************/
+void InitLeafDrip(VEGTABLE *VType)
+{
+  static const float CanopyHeight[18] = { 0.5,1,1.5,2,3,4,5,6,7,8,9,10,11,12,
+                13,14,15,16 };	/* Canopy height at which drip fall
+                           velocity is prescribed (m) */
+  static const float FallVelocity[18] = { 2.96,4.12,5.12,5.82,6.84,7.54,8.05,
+                8.36,8.54,8.66,8.75,8.82,8.87,8.91,8.96,9.02,9.07,9.13 };
+                        /* Drip fall velocity corresponding to
+                           CanopyHeight (m/s)*/
+  float LD_FallVelocity;	/* Leaf drip fall velocity (m/s) */
+  int i;
+
+  /* canopies above the heights of the table drip at the largest velocity */
+  LD_FallVelocity = FallVelocity[17];
+
+  /* Find corresponding fall velocity for overstory and understory heights
+     by weighting scheme */
+  if (VType->OverStory) {
+    /* starting at 1 assumes the overstory height > 0.5 m */
+    for (i = 1; i <= 17; i++) {
+      if (VType->Height[0] < CanopyHeight[i]) {
+        LD_FallVelocity = ((VType->Height[0] - CanopyHeight[i - 1])
+          *FallVelocity[i] +
+          (CanopyHeight[i] - VType->Height[0])*FallVelocity[i - 1]) /
+          (CanopyHeight[i] - CanopyHeight[i - 1]);
+      }
+    }
+    if (VType->UnderStory) {
+      /* ending at 16 assumes the understory height < 16 m */
+      for (i = 0; i <= 16; i++) {
+        if (VType->Height[1] < CanopyHeight[i]) {
+          LD_FallVelocity = ((VType->Height[1] - CanopyHeight[i])*FallVelocity[i] +
+            (CanopyHeight[i + 1] - VType->Height[1])*FallVelocity[i - 1]) /
+            (CanopyHeight[i + 1] - CanopyHeight[i]);
+        }
+      }
+    }
+  }
+  else if (VType->UnderStory) {
+    /* ending at 16 assumes the understory height < 16 m */
+    for (i = 0; i <= 16; i++) {
+      if (VType->Height[0] < CanopyHeight[i]) {
+        LD_FallVelocity = ((VType->Height[0] - CanopyHeight[i])*FallVelocity[i] +
+          (CanopyHeight[i + 1] - VType->Height[0])*FallVelocity[i - 1]) /
+          (CanopyHeight[i + 1] - CanopyHeight[i]);
+      }
+    }
+  }
+  else
+    LD_FallVelocity = 0;
+
+  VType->LD_FallVelocity = LD_FallVelocity;
+  VType->LD_MomentSq = pow(LD_FallVelocity * WATER_DENSITY, 2) * PI / 6 *
+    pow(LEAF_DRIP_DIA, 3);
+}
+
+/*****************************************************************************
+  RainfallMomentum()
+
+  Momentum squared of the rainfall RainFall (m) of a time step of Dt
+  seconds, eq. 1, Wicks and Bathurst (1996), and the median raindrop
+  diameter *Dm after Laws and Parsons (1943), which is the leaf drip
+  diameter without rain.  The momentum is later weighted with the
+  overstory/understory fraction.
+
+  Laws, J.o., and D.A. Parsons, 1943, the relation of raindrop size to 
+  intensity. Trans. Am. Geophys. Union, 24: 452-460.
+*****************************************************************************/
+float RainfallMomentum(float RainFall, int Dt, float *Dm)
+{
+  float RainfallIntensity;  /* Rainfall intensity (mm/h) */
+  int MS_Index;             /* Index for determining alpha and beta
+                               cooresponding to RainfallIntensity*/
+
+  if (RainFall <= 0.) {
+    *Dm = LEAF_DRIP_DIA;
+    return 0;
+  }
+
+  /* 3600 is conversion factor (number of seconds per hour) */
+  RainfallIntensity = RainFall * (1. / MMTOM) * (3600. / Dt);
+
+  if (RainfallIntensity < 10.)
+    MS_Index = 0;
+  else if (RainfallIntensity >= 10. && RainfallIntensity < 100.)
+    MS_Index = floor((RainfallIntensity + 49) / 50);
+  else
+    MS_Index = 3;
+
+  *Dm = 0.00124 * MathPow((double)RainfallIntensity, 0.182);
+  return MS_Alpha[MS_Index] * MathPow(RainfallIntensity, MS_Beta[MS_Index]);
+}
+
+/*****************************************************************************
+  SnowOnCanopy()
+
+  TRUE if the overstory of the cell intercepts snow this time step, so that
+  MassEnergyBalance() calls SnowInterception() instead of
+  InterceptionStorage()
+*****************************************************************************/
+int SnowOnCanopy(VEGTABLE *VType, PRECIPPIX *LocalPrecip)
+{
+#ifndef NO_SNOW
+  return VType->OverStory == TRUE &&
+    (LocalPrecip->IntSnow[0] || LocalPrecip->SnowFall > 0.0);
+#else
+  return FALSE;
+#endif
+}
@@ -0,0 +1,1130 @@
+/*
+ * SUMMARY:      KernelBench.c - Micro-benchmarks of the physics kernels
+ * USAGE:        kernel_bench [-l] [-f filter] [-t seconds] [-r repetitions]
+ *                            [-n samples] [-c segments] [-s seed] [-o file]
+ *                            [-m accuracy]
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Times single routines of the model on inputs drawn from
+ *               realistic distributions, so that an optimisation of one
+ *               routine can be judged in seconds instead of with a full
+ *               run.  The soil and vegetation tables are made by
+ *               InitTables() from a configuration held in memory, the
+ *               channel network and map by the channel readers from
+ *               temporary files, as in a model run.
+ * DESCRIP-END.
+ * FUNCTIONS:    main()
+ *               Usage()
+ *               Uniform()
+ *               BenchPause()
+ *               BenchResume()
+ *               RunBenchmark()
+ *               InitBench()
+ *               InitMemoryInput()
+ *               InitSamples()
+ *               CopyPixel()
+ *               InitChannelBench()
+ *               Bench...()
+ * COMMENTS:     Each benchmark calls its routine N times, with N increased
+ *               until a batch takes at least the minimum time (-t), and
+ *               reports the wall clock and CPU time per call for the best
+ *               and the median of the repetitions (-r), in the manner of
+ *               Google Benchmark.  The calls cycle through -n samples of
+ *               the inputs.
+ *
+ *               The routines that change their state (MassEnergyBalance,
+ *               SnowMelt, UnsaturatedFlow) start each call from a copy of
+ *               the state of the sample, so that the inputs do not drift
+ *               with the number of calls.  The copy is part of the time,
+ *               it is small next to the routines.  The channel network is
+ *               reset outside the timed part, see BenchPause().
+ *
+ *               Built with DHSVM_BUILD_BENCH, the results of two builds can
+ *               be compared with the CSV file written with -o.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "getinit.h"
+#include "constants.h"
+#include "massenergy.h"
+#include "snow.h"
+#include "soilmoisture.h"
+#include "brent.h"
+#include "channel.h"
+#include "channel_grid.h"
+#include "DHSVMChannel.h"
+#include "profile.h"
+#include "fastmath.h"
+
+#define MAXBENCHVEG   2		/* vegetation layers */
+#define MAXBENCHSOIL  3		/* soil layers */
+#define BENCHDT       10800	/* time step (s) */
+#define BENCHDX       90.	/* grid spacing (m) */
+#define CELLSPERSEG   5		/* map cells of each channel segment */
+
+/* state of one cell for MassEnergyBalance(), with room for the arrays the
+   structures point to, see CopyPixel() */
+typedef struct {
+  int Veg;			/* index in VType */
+  int Soil;			/* index in SType */
+  float SineSolarAltitude;
+  PIXMET Met;
+  PRECIPPIX Precip;
+  VEGPIX VegPix;
+  SOILPIX SoilPix;
+  SNOWPIX Snow;
+  PIXRAD Rad;
+  EVAPPIX Evap;
+  ROADSTRUCT Network;
+  float IntRain[MAXBENCHVEG];
+  float IntSnow[MAXBENCHVEG];
+  float Moist[MAXBENCHSOIL + 1];
+  float Perc[MAXBENCHSOIL];
+  float Temp[MAXBENCHSOIL];
+  float EPot[MAXBENCHVEG + 1];
+  float EAct[MAXBENCHVEG + 1];
+  float EInt[MAXBENCHVEG];
+  float ESoilLayers[MAXBENCHVEG][MAXBENCHSOIL];
+  float *ESoil[MAXBENCHVEG];
+  float PercArea[MAXBENCHSOIL + 1];
+  float Adjust[MAXBENCHSOIL + 1];
+} BENCHPIXEL;
+
+typedef struct {
+  const char *Name;
+  void (*Run) (long N);
+  const char *Item;		/* what is counted in the items per second */
+  double *Items;		/* items per call, NULL for 1 */
+  const char *Counter;		/* name of the counter per call, NULL if
+				   none */
+} BENCHMARK;
+
+/* configuration of the tables, in the format of the input file */
+static const char *BenchInput[] = {
+  "[SOILS]",
+  "NUMBER OF SOIL TYPES = 2",
+  "SOIL DESCRIPTION 1 = Loam",
+  "LATERAL CONDUCTIVITY 1 = 0.01",
+  "EXPONENTIAL DECREASE 1 = 3.0",
+  "DEPTH THRESHOLD 1 = 0.5",
+  "MAXIMUM INFILTRATION 1 = 3.0e-5",
+  "CAPILLARY DRIVE 1 = 0.1",
+  "SURFACE ALBEDO 1 = 0.1",
+  "NUMBER OF SOIL LAYERS 1 = 3",
+  "POROSITY 1 = 0.43 0.43 0.43",
+  "PORE SIZE DISTRIBUTION 1 = 0.25 0.25 0.25",
+  "BUBBLING PRESSURE 1 = 0.11 0.11 0.11",
+  "FIELD CAPACITY 1 = 0.25 0.25 0.25",
+  "WILTING POINT 1 = 0.10 0.10 0.10",
+  "BULK DENSITY 1 = 1485. 1485. 1485.",
+  "VERTICAL CONDUCTIVITY 1 = 0.001 0.001 0.001",
+  "THERMAL CONDUCTIVITY 1 = 7.114 6.923 7.0",
+  "THERMAL CAPACITY 1 = 1.4e6 1.4e6 1.4e6",
+  "SOIL DESCRIPTION 2 = Sandy Loam",
+  "LATERAL CONDUCTIVITY 2 = 0.03",
+  "EXPONENTIAL DECREASE 2 = 2.0",
+  "DEPTH THRESHOLD 2 = 0.5",
+  "MAXIMUM INFILTRATION 2 = 6.0e-5",
+  "CAPILLARY DRIVE 2 = 0.15",
+  "SURFACE ALBEDO 2 = 0.15",
+  "NUMBER OF SOIL LAYERS 2 = 3",
+  "POROSITY 2 = 0.41 0.41 0.41",
+  "PORE SIZE DISTRIBUTION 2 = 0.32 0.32 0.32",
+  "BUBBLING PRESSURE 2 = 0.09 0.09 0.09",
+  "FIELD CAPACITY 2 = 0.18 0.18 0.18",
+  "WILTING POINT 2 = 0.06 0.06 0.06",
+  "BULK DENSITY 2 = 1560. 1560. 1560.",
+  "VERTICAL CONDUCTIVITY 2 = 0.003 0.003 0.003",
+  "THERMAL CONDUCTIVITY 2 = 7.6 7.6 7.6",
+  "THERMAL CAPACITY 2 = 1.3e6 1.3e6 1.3e6",
+  "[VEGETATION]",
+  "NUMBER OF VEGETATION TYPES = 3",
+  "VEGETATION DESCRIPTION 1 = Evergreen Needleleaf",
+  "OVERSTORY PRESENT 1 = TRUE",
+  "UNDERSTORY PRESENT 1 = TRUE",
+  "FRACTIONAL COVERAGE 1 = 0.8",
+  "TRUNK SPACE 1 = 0.4",
+  "AERODYNAMIC ATTENUATION 1 = 2.5",
+  "RADIATION ATTENUATION 1 = 0.2",
+  "MAX SNOW INT CAPACITY 1 = 0.04",
+  "MASS RELEASE DRIP RATIO 1 = 0.4",
+  "SNOW INTERCEPTION EFF 1 = 0.6",
+  "IMPERVIOUS FRACTION 1 = 0.0",
+  "HEIGHT 1 = 30.0 0.5",
+  "MAXIMUM RESISTANCE 1 = 5000. 600.",
+  "MINIMUM RESISTANCE 1 = 666.6 200.",
+  "MOISTURE THRESHOLD 1 = 0.33 0.13",
+  "VAPOR PRESSURE DEFICIT 1 = 4000. 4000.",
+  "RPC 1 = 0.108 0.108",
+  "NUMBER OF ROOT ZONES 1 = 3",
+  "ROOT ZONE DEPTHS 1 = 0.10 0.25 0.40",
+  "OVERSTORY ROOT FRACTION 1 = 0.20 0.40 0.40",
+  "UNDERSTORY ROOT FRACTION 1 = 0.40 0.60 0.00",
+  "OVERSTORY MONTHLY LAI 1 = 5 5 5 5 5 5 5 5 5 5 5 5",
+  "UNDERSTORY MONTHLY LAI 1 = 1 1 1 1 1 1 1 1 1 1 1 1",
+  "OVERSTORY MONTHLY ALB 1 = .14 .14 .14 .14 .14 .14 .14 .14 .14 .14 .14 .14",
+  "UNDERSTORY MONTHLY ALB 1 = .2 .2 .2 .2 .2 .2 .2 .2 .2 .2 .2 .2",
+  "VEGETATION DESCRIPTION 2 = Grassland",
+  "OVERSTORY PRESENT 2 = FALSE",
+  "UNDERSTORY PRESENT 2 = TRUE",
+  "IMPERVIOUS FRACTION 2 = 0.0",
+  "HEIGHT 2 = 0.5",
+  "MAXIMUM RESISTANCE 2 = 600.",
+  "MINIMUM RESISTANCE 2 = 120.",
+  "MOISTURE THRESHOLD 2 = 0.13",
+  "VAPOR PRESSURE DEFICIT 2 = 4000.",
+  "RPC 2 = 0.108",
+  "NUMBER OF ROOT ZONES 2 = 3",
+  "ROOT ZONE DEPTHS 2 = 0.10 0.25 0.40",
+  "UNDERSTORY ROOT FRACTION 2 = 0.50 0.50 0.00",
+  "UNDERSTORY MONTHLY LAI 2 = 1.5 1.5 1.5 1.5 1.5 1.5 1.5 1.5 1.5 1.5 1.5 1.5",
+  "UNDERSTORY MONTHLY ALB 2 = .2 .2 .2 .2 .2 .2 .2 .2 .2 .2 .2 .2",
+  "VEGETATION DESCRIPTION 3 = Bare",
+  "OVERSTORY PRESENT 3 = FALSE",
+  "UNDERSTORY PRESENT 3 = FALSE",
+  "IMPERVIOUS FRACTION 3 = 0.0",
+  "NUMBER OF ROOT ZONES 3 = 3",
+  "ROOT ZONE DEPTHS 3 = 0.10 0.25 0.40",
+  NULL
+};
+
+static unsigned long long RandomState = 1;
+static int NSamples = 1024;
+static int NSegments = 2000;
+static double MinTime = 0.5;
+static int Repetitions = 3;
+
+static OPTIONSTRUCT Options;
+static SOILTABLE *SType = NULL;
+static VEGTABLE *VType = NULL;
+static SNOWTABLE *SnowAlbedo = NULL;
+static LAYER Soil;
+static LAYER Veg;
+static BENCHPIXEL *Pristine = NULL;	/* state of the samples */
+static BENCHPIXEL *Work = NULL;	/* state used by the calls */
+static float *TSample = NULL;		/* -40 - 40 C */
+static float *Depth = NULL;		/* soil depth (m) */
+static float *WaterTable = NULL;	/* water table depth (m) */
+static float *Infiltration = NULL;	/* infiltration in a step (m) */
+static float *RaSample = NULL;		/* aerodynamic resistance (s/m) */
+static float *HeightScale = NULL;	/* scale of the vegetation height */
+static PIXRAD TotalRad;
+static CHANNEL ChannelData;		/* no channels in the cells */
+
+static ChannelClass *BenchClasses = NULL;
+static Channel *BenchStreams = NULL;
+static ChannelNetwork *BenchNet = NULL;
+static ChannelNetwork *BenchBatchNet = NULL;	/* CHANNEL ROUTING BATCH */
+static ChannelMapPtr **BenchMap = NULL;
+static int *MapCol = NULL;		/* cells with a channel */
+static int *MapRow = NULL;
+static int NMapCells = 0;
+static double NetworkItems = 0.0;
+
+static volatile float Sink;		/* keeps the results alive */
+static double CounterSum;		/* counter summed over the calls */
+static double PausedWall;		/* time outside the timed part (s) */
+static double PausedCpu;
+static double PauseStartWall;
+static double PauseStartCpu;
+
+static void Usage(char *Program);
+static double Uniform(double Min, double Max);
+static void BenchPause(void);
+static void BenchResume(void);
+static void InitBench(void);
+static LISTPTR InitMemoryInput(const char **Lines);
+static void InitSamples(void);
+static void CopyPixel(BENCHPIXEL *Dst, BENCHPIXEL *Src);
+static void InitChannelBench(void);
+static void RunBenchmark(BENCHMARK *Bench, FILE *CsvFile);
+
+static void BenchSatVaporPressure(long N);
+static void BenchCalcTransmissivity(long N);
+static void BenchCalcAerodynamic(long N);
+static void BenchSurfaceEnergyBalance(long N);
+static void BenchSurfaceEnergyBalanceNewton(long N);
+static void BenchSnowMelt(long N);
+static void BenchSnowMeltNewton(long N);
+static void BenchUnsaturatedFlow(long N);
+static void BenchMassEnergyBalance(long N);
+static void BenchMassEnergyBalanceHeatFlux(long N);
+static void BenchRouteNetwork(long N);
+static void BenchRouteNetworkBatch(long N);
+static void BenchGridIncInflow(long N);
+
+static BENCHMARK Benchmarks[] = {
+  {"SatVaporPressure", BenchSatVaporPressure, "calls", NULL, NULL},
+  {"CalcTransmissivity", BenchCalcTransmissivity, "calls", NULL, NULL},
+  {"CalcAerodynamic", BenchCalcAerodynamic, "calls", NULL, NULL},
+  {"RootBrent/SurfaceEnergyBalance", BenchSurfaceEnergyBalance, "calls",
+   NULL, "evaluations"},
+  {"RootNewton/SurfaceEnergyBalance", BenchSurfaceEnergyBalanceNewton,
+   "calls", NULL, "evaluations"},
+  {"SnowMelt", BenchSnowMelt, "calls", NULL, "evaluations"},
+  {"SnowMelt/Newton", BenchSnowMeltNewton, "calls", NULL, "evaluations"},
+  {"UnsaturatedFlow", BenchUnsaturatedFlow, "calls", NULL, NULL},
+  {"MassEnergyBalance", BenchMassEnergyBalance, "cells", NULL, NULL},
+  {"MassEnergyBalance/HeatFlux", BenchMassEnergyBalanceHeatFlux, "cells",
+   NULL, "evaluations"},
+  {"channel_route_network", BenchRouteNetwork, "segments", &NetworkItems,
+   NULL},
+  {"channel_route_network/Batch", BenchRouteNetworkBatch, "segments",
+   &NetworkItems, NULL},
+  {"channel_grid_inc_inflow", BenchGridIncInflow, "calls", NULL, NULL},
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+/*****************************************************************************
+  main()
+*****************************************************************************/
+int main(int argc, char **argv)
+{
+  char *Filter = NULL;
+  char *CsvName = NULL;
+  FILE *CsvFile = NULL;
+  int List = FALSE;
+  int i;
+  int c;
+
+  while ((c = getopt(argc, argv, "lf:t:r:n:c:s:o:m:")) != -1) {
+    switch (c) {
+    case 'l':
+      List = TRUE;
+      break;
+    case 'f':
+      Filter = optarg;
+      break;
+    case 't':
+      MinTime = atof(optarg);
+      break;
+    case 'r':
+      Repetitions = atoi(optarg);
+      break;
+    case 'n':
+      NSamples = atoi(optarg);
+      break;
+    case 'c':
+      NSegments = atoi(optarg);
+      break;
+    case 's':
+      RandomState = strtoull(optarg, NULL, 10);
+      break;
+    case 'o':
+      CsvName = optarg;
+      break;
+    case 'm':
+      for (MathAccuracy = MATH_EXACT;
+	   MathAccuracy <= MATH_FAST &&
+	   strcmp(optarg, MathAccuracyName(MathAccuracy)) != 0;
+	   MathAccuracy++)
+	;
+      if (MathAccuracy > MATH_FAST)
+	Usage(argv[0]);
+      break;
+    default:
+      Usage(argv[0]);
+    }
+  }
+  if (optind != argc || MinTime <= 0.0 || Repetitions < 1 || NSamples < 1 ||
+      NSegments < 1 || NSegments > 65535)
+    Usage(argv[0]);
+
+  if (List) {
+    for (i = 0; Benchmarks[i].Name != NULL; i++)
+      printf("%s\n", Benchmarks[i].Name);
+    return EXIT_SUCCESS;
+  }
+
+  InitBench();
+
+  if (CsvName != NULL) {
+    if (!(CsvFile = fopen(CsvName, "w")))
+      ReportError(CsvName, 3);
+    fprintf(CsvFile, "name,iterations,real_time_ns,median_time_ns,"
+	    "cpu_time_ns,items_per_second,counter\n");
+  }
+
+  printf("%-34s %12s %12s %12s %12s %14s\n", "Benchmark", "Time (ns)",
+	 "Median (ns)", "CPU (ns)", "Iterations", "Items/s");
+  for (i = 0; Benchmarks[i].Name != NULL; i++)
+    if (Filter == NULL || strstr(Benchmarks[i].Name, Filter) != NULL)
+      RunBenchmark(&Benchmarks[i], CsvFile);
+
+  if (CsvFile != NULL)
+    fclose(CsvFile);
+  return EXIT_SUCCESS;
+}
+
+/*****************************************************************************
+  Usage()
+*****************************************************************************/
+static void Usage(char *Program)
+{
+  fprintf(stderr, "usage: %s [options]\n", Program);
+  fprintf(stderr, "  -l          list the benchmarks\n");
+  fprintf(stderr, "  -f filter   only run the benchmarks with filter in the "
+	  "name\n");
+  fprintf(stderr, "  -t seconds  minimum time of a repetition (0.5)\n");
+  fprintf(stderr, "  -r n        repetitions (3)\n");
+  fprintf(stderr, "  -n n        input samples (1024)\n");
+  fprintf(stderr, "  -c n        segments of the channel network (2000)\n");
+  fprintf(stderr, "  -s seed     random seed of the samples (1)\n");
+  fprintf(stderr, "  -o file     also write the results to a CSV file\n");
+  fprintf(stderr, "  -m accuracy MATH ACCURACY of exp, log and pow (EXACT)\n");
+  exit(EXIT_FAILURE);
+}
+
+/*****************************************************************************
+  Uniform()
+
+  Uniform random number in [Min, Max) (splitmix64)
+*****************************************************************************/
+static double Uniform(double Min, double Max)
+{
+  unsigned long long z;
+
+  z = (RandomState += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return Min + (Max - Min) * ((double) (z >> 11) / 9007199254740992.0);
+}
+
+/*****************************************************************************
+  BenchPause()
+  BenchResume()
+
+  Leave the time between the two calls out of the time of the benchmark
+*****************************************************************************/
+static void BenchPause(void)
+{
+  PauseStartWall = WallClock();
+  PauseStartCpu = CpuClock();
+}
+
+static void BenchResume(void)
+{
+  PausedWall += WallClock() - PauseStartWall;
+  PausedCpu += CpuClock() - PauseStartCpu;
+}
+
+/*****************************************************************************
+  RunBenchmark()
+
+  Finds the number of calls that takes at least MinTime, then times
+  Repetitions batches of that many calls
+*****************************************************************************/
+static int CompareDouble(const void *a, const void *b)
+{
+  double A = *(const double *) a;
+  double B = *(const double *) b;
+
+  return (A > B) - (A < B);
+}
+
+static void RunBenchmark(BENCHMARK *Bench, FILE *CsvFile)
+{
+  double *Wall;
+  double *Cpu;
+  double Elapsed;
+  double Start;
+  double StartCpu;
+  double Counter = 0.0;
+  double Items;
+  long N = 1;
+  int i;
+
+  if (!(Wall = (double *) calloc(Repetitions, sizeof(double))) ||
+      !(Cpu = (double *) calloc(Repetitions, sizeof(double))))
+    ReportError("RunBenchmark", 1);
+
+  for (;;) {
+    PausedWall = 0.0;
+    Start = WallClock();
+    Bench->Run(N);
+    Elapsed = WallClock() - Start - PausedWall;
+    if (Elapsed >= MinTime || N >= 1000000000L)
+      break;
+    if (Elapsed <= 0.0)
+      N *= 10;
+    else
+      N = (long) ceil(N * ((1.4 * MinTime / Elapsed > 10.) ? 10. :
+			   (1.4 * MinTime / Elapsed < 2. ? 2. :
+			    1.4 * MinTime / Elapsed)));
+  }
+
+  for (i = 0; i < Repetitions; i++) {
+    PausedWall = 0.0;
+    PausedCpu = 0.0;
+    CounterSum = 0.0;
+    StartCpu = CpuClock();
+    Start = WallClock();
+    Bench->Run(N);
+    Wall[i] = (WallClock() - Start - PausedWall) / N;
+    Cpu[i] = (CpuClock() - StartCpu - PausedCpu) / N;
+    Counter = CounterSum / N;
+  }
+  qsort(Cpu, Repetitions, sizeof(double), CompareDouble);
+  /* CPU time of the fastest repetition is not kept with its wall time, the
+     minimum of each is reported */
+  for (i = 1, Start = Wall[0]; i < Repetitions; i++)
+    if (Wall[i] < Start)
+      Start = Wall[i];
+  Elapsed = Start;
+  qsort(Wall, Repetitions, sizeof(double), CompareDouble);
+
+  Items = (Bench->Items != NULL) ? *(Bench->Items) : 1.0;
+  printf("%-34s %12.1f %12.1f %12.1f %12ld %12.4g %s", Bench->Name,
+	 1e9 * Elapsed, 1e9 * Wall[Repetitions / 2], 1e9 * Cpu[0], N,
+	 Items / Elapsed, Bench->Item);
+  if (Bench->Counter != NULL)
+    printf("  %.2f %s/call", Counter, Bench->Counter);
+  printf("\n");
+  if (CsvFile != NULL)
+    fprintf(CsvFile, "%s,%ld,%.2f,%.2f,%.2f,%.6g,%.3f\n", Bench->Name, N,
+	    1e9 * Elapsed, 1e9 * Wall[Repetitions / 2], 1e9 * Cpu[0],
+	    Items / Elapsed, Counter);
+
+  free(Wall);
+  free(Cpu);
+}
+
+/*****************************************************************************
+  InitMemoryInput()
+
+  Input list from the lines of a configuration, as ReadInitFile() makes it
+  from a file
+*****************************************************************************/
+static LISTPTR InitMemoryInput(const char **Lines)
+{
+  LISTPTR Head = NULL;
+  LISTPTR Current = NULL;
+  int i;
+
+  for (i = 0; Lines[i] != NULL; i++) {
+    if (Head == NULL) {
+      Head = CreateNode();
+      Current = Head;
+    }
+    else {
+      Current->Next = CreateNode();
+      Current = Current->Next;
+    }
+    strncpy(Current->Str, Lines[i], BUFSIZE);
+    Strip(Current->Str);
+  }
+  if (Head != NULL)
+    Head->Index = BuildInitIndex(Head);
+  return Head;
+}
+
+/*****************************************************************************
+  InitBench()
+
+  Constants, tables and inputs of the benchmarks
+*****************************************************************************/
+static void InitBench(void)
+{
+  TIMESTRUCT Time;
+  LISTPTR Input;
+
+  /* [CONSTANTS] of the synthetic basins (make_synthetic_basin) */
+  Z0_GROUND = 0.02;
+  Z0_SNOW = 0.01;
+  MIN_RAIN_TEMP = -1.0;
+  MAX_SNOW_TEMP = 2.0;
+  LIQUID_WATER_CAPACITY = 0.03;
+  Zref = 40.0;
+  LAI_WATER_MULTIPLIER = 0.0001;
+  LAI_SNOW_MULTIPLIER = 0.0005;
+  MIN_INTERCEPTION_STORAGE = 0.005;
+  OUTSIDEBASIN = 0;
+  TEMPLAPSE = -0.0065;
+  PRECIPLAPSE = 0.0001;
+  PRECIPMULTIPLIER = 0.0;
+  ALB_ACC_LAMBDA = 0.92;
+  ALB_MELT_LAMBDA = 0.70;
+  ALB_ACC_MIN = 0.75;
+  ALB_MELT_MIN = 0.45;
+
+  memset(&Options, 0, sizeof(OPTIONSTRUCT));
+  Options.HasNetwork = TRUE;
+  Options.CanopyRadAtt = FIXED;
+  Options.Infiltration = STATIC;
+  Options.TSurfSolver = BRENT;
+  Options.SoilTableSize = 0;
+  Options.PrecipFactor = 1.0;
+
+  Input = InitMemoryInput(BenchInput);
+  InitTables(24 * 3600 / BENCHDT, Input, &Options, &SType, &Soil, &VType,
+	     &Veg, &SnowAlbedo);
+  DeleteList(Input);
+
+  /* LAI and albedo of July */
+  memset(&Time, 0, sizeof(TIMESTRUCT));
+  Time.Current.Month = 7;
+  InitNewMonth(&Time, &Options, NULL, NULL, NULL, NULL, NULL, NULL, Veg.NTypes,
+	       VType, 0, NULL, NULL);
+
+  memset(&ChannelData, 0, sizeof(CHANNEL));
+  InitSamples();
+  InitChannelBench();
+  printf("\n");
+}
+
+/*****************************************************************************
+  CopyPixel()
+
+  Copies the state of a cell and points the copy at its own arrays
+*****************************************************************************/
+static void CopyPixel(BENCHPIXEL *Dst, BENCHPIXEL *Src)
+{
+  int i;
+
+  memcpy(Dst, Src, sizeof(BENCHPIXEL));
+  Dst->Precip.IntRain = Dst->IntRain;
+  Dst->Precip.IntSnow = Dst->IntSnow;
+  Dst->SoilPix.Moist = Dst->Moist;
+  Dst->SoilPix.Perc = Dst->Perc;
+  Dst->SoilPix.Temp = Dst->Temp;
+  Dst->Evap.EPot = Dst->EPot;
+  Dst->Evap.EAct = Dst->EAct;
+  Dst->Evap.EInt = Dst->EInt;
+  Dst->Evap.ESoil = Dst->ESoil;
+  for (i = 0; i < MAXBENCHVEG; i++)
+    Dst->ESoil[i] = Dst->ESoilLayers[i];
+  Dst->Network.PercArea = Dst->PercArea;
+  Dst->Network.Adjust = Dst->Adjust;
+}
+
+/*****************************************************************************
+  InitSamples()
+
+  Met, snow, soil and interception state of the samples.  The air
+  temperature spans the snow and the growing seasons, a third of the steps
+  are at night, a quarter have precipitation, and the cells below 2 C have
+  a snow pack half of the time.
+*****************************************************************************/
+static void InitSamples(void)
+{
+  BENCHPIXEL *P;
+  VEGTABLE *V;
+  SOILTABLE *S;
+  float Tmp;
+  int i;
+  int j;
+
+  if (!(Pristine = (BENCHPIXEL *) calloc(NSamples, sizeof(BENCHPIXEL))) ||
+      !(Work = (BENCHPIXEL *) calloc(NSamples, sizeof(BENCHPIXEL))) ||
+      !(TSample = (float *) calloc(NSamples, sizeof(float))) ||
+      !(Depth = (float *) calloc(NSamples, sizeof(float))) ||
+      !(WaterTable = (float *) calloc(NSamples, sizeof(float))) ||
+      !(Infiltration = (float *) calloc(NSamples, sizeof(float))) ||
+      !(RaSample = (float *) calloc(NSamples, sizeof(float))) ||
+      !(HeightScale = (float *) calloc(NSamples, sizeof(float))))
+    ReportError("InitSamples", 1);
+
+  for (i = 0; i < NSamples; i++) {
+    P = &(Pristine[i]);
+    CopyPixel(P, P);
+    P->Veg = i % Veg.NTypes;
+    P->Soil = (i / Veg.NTypes) % Soil.NTypes;
+    V = &(VType[P->Veg]);
+    S = &(SType[P->Soil]);
+
+    P->Met.Tair = Uniform(-15.0, 30.0);
+    P->Met.Rh = Uniform(30.0, 100.0);
+    P->Met.Wind = 0.5 - 3.0 * log(1.0 - Uniform(0.0, 0.999));
+    P->SineSolarAltitude = (Uniform(0.0, 1.0) < 0.33) ? 0.0 :
+      Uniform(0.05, 0.9);
+    P->Met.Sin = 0.75 * SOLARCON * P->SineSolarAltitude;
+    P->Met.VICSin = P->Met.Sin;
+    P->Met.SinBeam = 0.7 * P->Met.Sin;
+    P->Met.SinDiffuse = 0.3 * P->Met.Sin;
+    Tmp = P->Met.Tair + 273.15;
+    P->Met.Lin = Uniform(0.7, 0.95) * STEFAN * Tmp * Tmp * Tmp * Tmp;
+    P->Met.Press = Uniform(85000., 101300.);
+    P->Met.Lv = 2501000 - 2361 * P->Met.Tair;
+    P->Met.Gamma = CP * P->Met.Press / (EPS * P->Met.Lv);
+    P->Met.Es = SatVaporPressure(P->Met.Tair);
+    P->Met.Slope = 4098.0 * P->Met.Es /
+      ((237.3 + P->Met.Tair) * (237.3 + P->Met.Tair));
+    P->Met.Eact = P->Met.Es * (P->Met.Rh / 100.);
+    P->Met.Vpd = P->Met.Es - P->Met.Eact;
+    P->Met.AirDens = 0.003486 * P->Met.Press / (275 + P->Met.Tair);
+
+    /* precipitation, split as in MakeLocalMetData() */
+    if (Uniform(0.0, 1.0) < 0.25)
+      P->Precip.Precip = -0.002 * log(1.0 - Uniform(0.0, 0.999));
+    if (P->Precip.Precip > 0.0 && P->Met.Tair < MAX_SNOW_TEMP) {
+      if (P->Met.Tair > MIN_RAIN_TEMP)
+	P->Precip.SnowFall = P->Precip.Precip *
+	  (MAX_SNOW_TEMP - P->Met.Tair) / (MAX_SNOW_TEMP - MIN_RAIN_TEMP);
+      else
+	P->Precip.SnowFall = P->Precip.Precip;
+    }
+    P->Precip.RainFall = P->Precip.Precip - P->Precip.SnowFall;
+    for (j = 0; j < V->NVegLayers; j++)
+      P->IntRain[j] = Uniform(0.0, 1.0) * V->MaxInt[j];
+    if (V->OverStory && P->Met.Tair < 0.0)
+      P->IntSnow[0] = Uniform(0.0, 0.01);
+
+    /* snow pack */
+    if (P->Met.Tair < MAX_SNOW_TEMP && Uniform(0.0, 1.0) < 0.5) {
+      P->Snow.HasSnow = TRUE;
+      P->Snow.Swq = Uniform(0.02, 0.8);
+      P->Snow.TPack = (P->Met.Tair < 0.0) ? P->Met.Tair : 0.0;
+      P->Snow.TSurf = P->Snow.TPack;
+      P->Snow.PackWater = 0.0;
+      P->Snow.SurfWater = 0.0;
+      P->Snow.LastSnow = (unshort) Uniform(0.0, 20.0);
+      P->Snow.Albedo = CalcSnowAlbedo(P->Snow.TSurf, P->Snow.LastSnow,
+				      SnowAlbedo);
+      P->Snow.ColdContent = CH_ICE * P->Snow.TPack * P->Snow.Swq;
+    }
+
+    /* soil between the wilting point and saturation */
+    P->SoilPix.Soil = P->Soil + 1;
+    P->SoilPix.Depth = Uniform(1.0, 3.0);
+    for (j = 0; j < S->NLayers; j++) {
+      P->Moist[j] = Uniform(S->WP[j] + 0.01, 0.95 * S->Porosity[j]);
+      P->Temp[j] = P->Met.Tair * 0.5 + 4.0;
+    }
+    P->Moist[S->NLayers] = Uniform(S->FCap[S->NLayers - 1],
+				   S->Porosity[S->NLayers - 1]);
+    P->SoilPix.TSurf = P->Met.Tair;
+    P->VegPix.Veg = P->Veg + 1;
+    P->VegPix.Tcanopy = P->Met.Tair;
+
+    /* no road or channel in the cell */
+    for (j = 0; j <= S->NLayers; j++) {
+      P->PercArea[j] = 1.0;
+      P->Adjust[j] = 1.0;
+    }
+    P->Network.CutBankZone = NO_CUT;
+    P->Network.MaxInfiltrationRate = DHSVM_HUGE;
+    InitSoilCapacity(V->NSoilLayers, P->SoilPix.Depth, V->RootDepth,
+		     S->Porosity, S->FCap, P->Adjust, &(P->Network.Capacity));
+    P->SoilPix.TableDepth =
+      WaterTableDepth(V->NSoilLayers, P->SoilPix.Depth, V->RootDepth,
+		      S->Porosity, S->FCap, P->Adjust, P->Moist,
+		      &(P->Network.Capacity));
+
+    /* inputs of the routines that are timed on their own */
+    TSample[i] = Uniform(-40.0, 40.0);
+    Depth[i] = P->SoilPix.Depth;
+    WaterTable[i] = Uniform(0.0, Depth[i]);
+    Infiltration[i] = (Uniform(0.0, 1.0) < 0.5) ? 0.0 : Uniform(0.0, 0.005);
+    RaSample[i] = Uniform(10.0, 300.0);
+    HeightScale[i] = Uniform(0.5, 1.5);
+
+    CopyPixel(&(Work[i]), P);
+  }
+}
+
+/*****************************************************************************
+  InitChannelBench()
+
+  A random tree of NSegments stream segments, each in CELLSPERSEG cells of
+  a map, read with the channel readers from temporary files
+*****************************************************************************/
+static void InitChannelBench(void)
+{
+  char ClassFile[] = "/tmp/kernel_bench_classXXXXXX";
+  char NetworkFile[] = "/tmp/kernel_bench_networkXXXXXX";
+  char MapFile[] = "/tmp/kernel_bench_mapXXXXXX";
+  SOILPIX **SoilMap;
+  FILE *OutFile;
+  int *Parent;
+  int *Level;
+  int MaxLevel = 0;
+  int MaxID;
+  int NCols;
+  int NRows;
+  int Cell;
+  int fd;
+  int i;
+  int j;
+
+  if (!(Parent = (int *) calloc(NSegments, sizeof(int))) ||
+      !(Level = (int *) calloc(NSegments, sizeof(int))))
+    ReportError("InitChannelBench", 1);
+
+  /* segment 0 is the outlet, the others drain to one of the 16 segments
+     created before them */
+  Parent[0] = -1;
+  for (i = 1; i < NSegments; i++) {
+    j = i - 1 - (int) Uniform(0.0, (i < 16) ? i : 16);
+    Parent[i] = j;
+    Level[i] = Level[j] + 1;
+    if (Level[i] > MaxLevel)
+      MaxLevel = Level[i];
+  }
+
+  if ((fd = mkstemp(ClassFile)) < 0 || !(OutFile = fdopen(fd, "w")))
+    ReportError(ClassFile, 3);
+  fprintf(OutFile, "1 2.0 0.3 0.05\n2 5.0 0.6 0.04\n3 10.0 1.0 0.035\n");
+  fclose(OutFile);
+
+  if ((fd = mkstemp(NetworkFile)) < 0 || !(OutFile = fdopen(fd, "w")))
+    ReportError(NetworkFile, 3);
+  for (i = 0; i < NSegments; i++)
+    fprintf(OutFile, "%d %d %.4f %.1f %d %d\n", i + 1, MaxLevel - Level[i] + 1,
+	    Uniform(0.001, 0.1), CELLSPERSEG * BENCHDX,
+	    (Level[i] < MaxLevel / 3) ? 3 : ((Level[i] < MaxLevel / 2) ? 2 : 1),
+	    Parent[i] + 1);
+  fclose(OutFile);
+
+  NCols = (int) ceil(sqrt((double) NSegments * CELLSPERSEG));
+  NRows = (NSegments * CELLSPERSEG + NCols - 1) / NCols;
+  if ((fd = mkstemp(MapFile)) < 0 || !(OutFile = fdopen(fd, "w")))
+    ReportError(MapFile, 3);
+  for (i = 0; i < NSegments; i++)
+    for (j = 0; j < CELLSPERSEG; j++) {
+      Cell = i * CELLSPERSEG + j;
+      fprintf(OutFile, "%d %d %d %.1f 0.5 2.0\n", Cell % NCols, Cell / NCols,
+	      i + 1, BENCHDX);
+      /* every 10th segment crosses the cell of the one before */
+      if (j == 0 && i % 10 == 1)
+	fprintf(OutFile, "%d %d %d %.1f 0.5 2.0\n", (Cell - 1) % NCols,
+		(Cell - 1) / NCols, i + 1, 0.3 * BENCHDX);
+    }
+  fclose(OutFile);
+
+  if (!(SoilMap = (SOILPIX **) calloc(NRows, sizeof(SOILPIX *))))
+    ReportError("InitChannelBench", 1);
+  for (i = 0; i < NRows; i++) {
+    if (!(SoilMap[i] = (SOILPIX *) calloc(NCols, sizeof(SOILPIX))))
+      ReportError("InitChannelBench", 1);
+    for (j = 0; j < NCols; j++)
+      SoilMap[i][j].Depth = 2.0;
+  }
+
+  channel_init();
+  channel_grid_init(NCols, NRows);
+  if ((BenchClasses = channel_read_classes(ClassFile, stream_class)) == NULL)
+    ReportError(ClassFile, 5);
+  if ((BenchStreams = channel_read_network(NetworkFile, BenchClasses,
+					   &MaxID)) == NULL)
+    ReportError(NetworkFile, 5);
+  BenchNet = channel_compile_network(BenchStreams, MaxID);
+  if ((BenchMap = channel_grid_read_map(BenchNet, MapFile, SoilMap)) == NULL)
+    ReportError(MapFile, 5);
+  channel_routing_parameters(BenchStreams, BENCHDT);
+  BenchBatchNet = channel_compile_network(BenchStreams, MaxID);
+  channel_network_batch(BenchBatchNet);
+  remove(ClassFile);
+  remove(NetworkFile);
+  remove(MapFile);
+
+  if (!(MapCol = (int *) calloc(NSegments * CELLSPERSEG, sizeof(int))) ||
+      !(MapRow = (int *) calloc(NSegments * CELLSPERSEG, sizeof(int))))
+    ReportError("InitChannelBench", 1);
+  for (i = 0; i < NRows; i++)
+    for (j = 0; j < NCols; j++)
+      if (channel_grid_has_channel(BenchMap, j, i)) {
+	MapCol[NMapCells] = j;
+	MapRow[NMapCells] = i;
+	NMapCells++;
+      }
+  NetworkItems = NSegments;
+
+  for (i = 0; i < NRows; i++)
+    free(SoilMap[i]);
+  free(SoilMap);
+  free(Parent);
+  free(Level);
+}
+
+/*****************************************************************************
+  The benchmarks, each calls its routine N times
+*****************************************************************************/
+static void BenchSatVaporPressure(long N)
+{
+  float Sum = 0.0;
+  long i;
+
+  for (i = 0; i < N; i++)
+    Sum += SatVaporPressure(TSample[i % NSamples]);
+  Sink = Sum;
+}
+
+static void BenchCalcTransmissivity(long N)
+{
+  SOILTABLE *S;
+  float Sum = 0.0;
+  long i;
+  int k;
+
+  for (i = 0; i < N; i++) {
+    k = i % NSamples;
+    S = &(SType[Pristine[k].Soil]);
+    Sum += CalcTransmissivity(Depth[k], WaterTable[k], S->KsLat, S->KsLatExp,
+			      S->DepthThresh);
+  }
+  Sink = Sum;
+}
+
+static void BenchCalcAerodynamic(long N)
+{
+  VEGTABLE *V;
+  float Height[MAXBENCHVEG];
+  float U[MAXBENCHVEG];
+  float Ra[MAXBENCHVEG];
+  float USnow;
+  float RaSnow;
+  float Sum = 0.0;
+  long i;
+  int j;
+  int k;
+
+  for (i = 0; i < N; i++) {
+    k = i % NSamples;
+    V = &(VType[i % Veg.NTypes]);
+    for (j = 0; j < V->NVegLayers; j++)
+      Height[j] = HeightScale[k] * V->Height[j];
+    CalcAerodynamic(V->NVegLayers, V->OverStory, V->Cn, Height, V->Trunk, U,
+		    &USnow, Ra, &RaSnow);
+    Sum += RaSnow;
+  }
+  Sink = Sum;
+}
+
+/* RootBrent() or RootNewton() on the surface energy balance, with the
+   arguments of SensibleHeatFlux() on bare soil */
+static void SurfaceEnergyBalanceCalls(long N, int Solver)
+{
+  SURFEBPARAMS Params;
+  BENCHPIXEL *P;
+  SOILTABLE *S;
+  double LogZ = log((Zref + Z0_GROUND) / Z0_GROUND);
+  float HeatCapacity;
+  float NetShort;
+  float Sum = 0.0;
+  float TSurf;
+  int NIter;
+  long i;
+  int k;
+
+  for (i = 0; i < N; i++) {
+    k = i % NSamples;
+    P = &(Pristine[k]);
+    S = &(SType[P->Soil]);
+    NetShort = (1.0 - S->Albedo) * P->Met.Sin;
+    TSurf = P->SoilPix.TSurf;
+    HeatCapacity = S->ChSolids[0] + P->Moist[0] *
+      ((P->Temp[0] >= 0.0) ? CH_WATER : CH_ICE);
+    NIter = 0;
+    if (Solver == NEWTON) {
+      Params.Dt = BENCHDT;
+      Params.Ra = RaSample[k];
+      Params.Z = Zref;
+      Params.Displacement = 0.0;
+      Params.LogZ = LogZ;
+      Params.Wind = P->Met.Wind;
+      Params.ShortRad = NetShort;
+      Params.LongRadIn = P->Met.Lin;
+      Params.AirDens = P->Met.AirDens;
+      Params.Lv = P->Met.Lv;
+      Params.ETot = 0.0;
+      Params.Kt = 1.0;
+      Params.HeatCapacity = HeatCapacity;
+      Params.Depth = 1.0;
+      Params.Tair = P->Met.Tair;
+      Params.TSoilLower = P->Temp[S->NLayers - 1];
+      Params.OldTSurf = TSurf;
+      Params.MeltEnergy = 0.0;
+      Sum += RootNewton(0, 0, 0.5 * (TSurf + P->Met.Tair) - DELTAT,
+			0.5 * (TSurf + P->Met.Tair) + DELTAT, TSurf, &NIter,
+			SurfaceEnergyBalanceParams, &Params);
+    }
+    else
+      Sum += RootBrent(0, 0, 0.5 * (TSurf + P->Met.Tair) - DELTAT,
+		       0.5 * (TSurf + P->Met.Tair) + DELTAT, &NIter,
+		       SurfaceEnergyBalance, BENCHDT, RaSample[k], Zref, 0.0f,
+		       LogZ, P->Met.Wind, NetShort, P->Met.Lin,
+		       P->Met.AirDens, P->Met.Lv, 0.0f, 1.0f, HeatCapacity,
+		       1.0f, P->Met.Tair, P->Temp[S->NLayers - 1], TSurf,
+		       0.0f);
+    CounterSum += NIter;
+  }
+  Sink = Sum;
+}
+
+static void BenchSurfaceEnergyBalance(long N)
+{
+  SurfaceEnergyBalanceCalls(N, BRENT);
+}
+
+static void BenchSurfaceEnergyBalanceNewton(long N)
+{
+  SurfaceEnergyBalanceCalls(N, NEWTON);
+}
+
+/* SnowMelt() on the samples with a snow pack */
+static void SnowMeltCalls(long N, int Solver)
+{
+  BENCHPIXEL *P;
+  float PackWater;
+  float SurfWater;
+  float Swq;
+  float VaporMassFlux;
+  float TPack;
+  float TSurf;
+  float MeltEnergy;
+  float Sum = 0.0;
+  int NIter;
+  long i;
+  int k = 0;
+
+  for (i = 0; i < N; i++) {
+    do {
+      k = (k + 1) % NSamples;
+    } while (!Pristine[k].Snow.HasSnow);
+    P = &(Pristine[k]);
+    PackWater = P->Snow.PackWater;
+    SurfWater = P->Snow.SurfWater;
+    Swq = P->Snow.Swq;
+    VaporMassFlux = 0.0;
+    TPack = P->Snow.TPack;
+    TSurf = P->Snow.TSurf;
+    MeltEnergy = 0.0;
+    NIter = 0;
+    Sum += SnowMelt(0, 0, BENCHDT, 2. + Z0_SNOW, 0.f, Z0_SNOW, RaSample[k],
+		    P->Met.AirDens, P->Met.Eact, P->Met.Lv,
+		    (1.0 - P->Snow.Albedo) * P->Met.Sin, P->Met.Lin,
+		    P->Met.Press, P->Precip.RainFall, P->Precip.SnowFall,
+		    P->Met.Tair, P->Met.Vpd, P->Met.Wind, &PackWater,
+		    &SurfWater, &Swq, &VaporMassFlux, &TPack, &TSurf,
+		    &MeltEnergy, Solver, &NIter);
+    CounterSum += NIter;
+  }
+  Sink = Sum;
+}
+
+static void BenchSnowMelt(long N)
+{
+  SnowMeltCalls(N, BRENT);
+}
+
+static void BenchSnowMeltNewton(long N)
+{
+  SnowMeltCalls(N, NEWTON);
+}
+
+static void BenchUnsaturatedFlow(long N)
+{
+  BENCHPIXEL *P;
+  VEGTABLE *V;
+  SOILTABLE *S;
+  float Moist[MAXBENCHSOIL + 1];
+  float Perc[MAXBENCHSOIL];
+  float TableDepth;
+  float Runoff;
+  float Sum = 0.0;
+  long i;
+  int k;
+
+  for (i = 0; i < N; i++) {
+    k = i % NSamples;
+    P = &(Pristine[k]);
+    V = &(VType[P->Veg]);
+    S = &(SType[P->Soil]);
+    memcpy(Moist, P->Moist, sizeof(Moist));
+    TableDepth = P->SoilPix.TableDepth;
+    Runoff = 0.0;
+    UnsaturatedFlow(BENCHDT, BENCHDX, BENCHDX, Infiltration[k], 0.0, 0.0,
+		    S->NLayers, P->SoilPix.Depth, 0.0, V->RootDepth, S->Ks,
+		    S->PoreDist, S->Porosity, S->FCap, S->DrainTable, Perc,
+		    P->PercArea, P->Adjust, NO_CUT, 0.0, &TableDepth, &Runoff,
+		    Moist, Options.Infiltration, &(P->Network.Capacity));
+    Sum += TableDepth;
+  }
+  Sink = Sum;
+}
+
+static void MassEnergyBalanceCalls(long N, int HeatFlux)
+{
+  BENCHPIXEL *P;
+  float Sum = 0.0;
+  long i;
+  int k;
+
+  for (i = 0; i < N; i++) {
+    k = i % NSamples;
+    P = &(Work[k]);
+    CopyPixel(P, &(Pristine[k]));
+    MassEnergyBalance(&Options, 0, 0, P->SineSolarAltitude, BENCHDX,
+		      BENCHDX, BENCHDT, HeatFlux, Options.CanopyRadAtt,
+		      Options.Infiltration, Veg.MaxLayers, &(P->Met),
+		      &(P->Network), &(P->Precip), &(VType[P->Veg]),
+		      &(P->VegPix), &(SType[P->Soil]), &(P->SoilPix),
+		      &(P->Snow), &(P->Rad), &(P->Evap), &TotalRad,
+		      &ChannelData, 0.0, NULL, NULL, FALSE);
+    Sum += P->Evap.ETot;
+    if (HeatFlux)
+      CounterSum += P->SoilPix.TSurfIter;
+  }
+  Sink = Sum;
+}
+
+static void BenchMassEnergyBalance(long N)
+{
+  MassEnergyBalanceCalls(N, FALSE);
+}
+
+static void BenchMassEnergyBalanceHeatFlux(long N)
+{
+  MassEnergyBalanceCalls(N, TRUE);
+}
+
+/* routing of the whole network, the lateral inflow of each step is set
+   outside the timed part */
+static void RouteNetworkCalls(ChannelNetwork *Net, long N)
+{
+  Channel *Current;
+  long i;
+
+  for (i = 0; i < N; i++) {
+    BenchPause();
+    channel_step_initialize_network(BenchStreams);
+    for (Current = BenchStreams; Current != NULL; Current = Current->next)
+      Current->route->lateral_inflow = 0.05 * BENCHDT * (1.0 + (i % 3));
+    BenchResume();
+    channel_route_network(Net, BENCHDT);
+  }
+  Sink = Net->seg[Net->nseg - 1]->route->outflow;
+}
+
+static void BenchRouteNetwork(long N)
+{
+  RouteNetworkCalls(BenchNet, N);
+}
+
+static void BenchRouteNetworkBatch(long N)
+{
+  RouteNetworkCalls(BenchBatchNet, N);
+}
+
+static void BenchGridIncInflow(long N)
+{
+  long i;
+  int k;
+
+  for (i = 0; i < N; i++) {
+    k = i % NMapCells;
+    channel_grid_inc_inflow(BenchMap, MapCol[k], MapRow[k], 1.0);
+  }
+  Sink = BenchStreams->route->lateral_inflow;
+}
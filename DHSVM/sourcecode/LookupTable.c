@@ -11,7 +11,12 @@
  * DESCRIP-END.
  * FUNCTIONS:    init_float_table()
  *               float float_lookup(float x, FLOATTABLE *table)
- * COMMENTS:
+ *               InitInterpTable()
+ *               FloatInterpolate()
+ *               ReportLookupError()
+ * COMMENTS:     The tables are filled during the initialization and only
+ *               read after that, so the lookups can be done by several
+ *               threads at the same time
  * $Id: LookupTable.c,v 1.4 2003/07/01 21:26:19 olivier Exp $     
  */
 
@@ -77,10 +82,99 @@ float FloatLookup(float x, FLOATTABLE * Table)
   int i;
 
   i = (int) (((x - Table->Offset) / Table->Delta));
-  if (i < 0 || i >= Table->Size) {
-    sprintf(errorstr, "FloatLookup: attempting lookup of value %f \n", x);
-    ReportError(errorstr, 47);
-  }
+  if (i < 0 || i >= Table->Size)
+    ReportLookupError("FloatLookup", x);
 
   return Table->Data[i];
 }
+
+/*****************************************************************************
+  Function name: InitInterpTable()
+
+  Purpose      : Allocate a table structure for FloatInterpolate()
+                 
+  Required     :
+    unsigned long Size        - Number of entries in the lookup table (> 1)
+    float Offset              - Value of key for first entry in the table
+    float Delta               - Key interval
+    FLOATTABLE *Table         - pointer to structure that holds the table
+
+  Returns      : void
+
+  Modifies     : FLOATTABLE *table
+
+  Comments     : Unlike InitFloatTable() the entries are not filled.  Entry
+                 i has to be set by the caller to the function value at 
+                 the key Offset + i * Delta (not at the middle of the 
+                 interval), calculated without accumulating the keys.
+*****************************************************************************/
+void InitInterpTable(unsigned long Size, float Offset, float Delta,
+		     FLOATTABLE * Table)
+{
+  Table->Size = Size;
+  Table->Offset = Offset;
+  Table->Delta = Delta;
+
+  Table->Data = calloc(Table->Size, sizeof(float));
+  if (Table->Data == NULL)
+    ReportError("InitInterpTable", 1);
+}
+
+/*****************************************************************************
+  Function name: FloatInterpolate()
+
+  Purpose      : Linear interpolation in a table set up with 
+                 InitInterpTable()
+                 
+  Required     : 
+    float x           - key to be looked up
+    FLOATTABLE *Table - Table structure that contains the entries
+
+  Returns      : float
+
+  Modifies     : None
+
+  Comments     : Keys outside the table return the first or last entry; the
+                 caller is responsible for staying within the table range.
+*****************************************************************************/
+float FloatInterpolate(float x, FLOATTABLE * Table)
+{
+  unsigned long i;
+  float f;
+
+  f = (x - Table->Offset) / Table->Delta;
+  if (f <= 0.0)
+    return Table->Data[0];
+  i = (unsigned long) f;
+  if (i >= Table->Size - 1)
+    return Table->Data[Table->Size - 1];
+  f -= (float) i;
+
+  return Table->Data[i] + f * (Table->Data[i + 1] - Table->Data[i]);
+}
+
+/*****************************************************************************
+  Function name: ReportLookupError()
+
+  Purpose      : Stop the run on a key outside a table
+                 
+  Required     : 
+    const char *Routine - Function that did the lookup
+    float x             - key that was looked up
+
+  Returns      : void
+
+  Modifies     : None
+
+  Comments     : The message is only formatted here, in a buffer of the 
+                 calling thread, so that the lookups neither format it nor
+                 share a buffer
+*****************************************************************************/
+void ReportLookupError(const char *Routine, float x)
+{
+  char Str[BUFSIZ + 1];
+
+  snprintf(Str, BUFSIZ + 1, "%s: attempting lookup of value %f \n", Routine,
+	   x);
+  ReportError(Str, 47);
+}
@@ -9,6 +9,11 @@
 * DESCRIPTION:  Generates meteorological conditions for each individual cell
 * DESCRIP-END.
 * FUNCTIONS:    MakeLocalMetData()
+*               MakePrecipFactors()
+*               MakeStationValues()
+*               MakeMetFields()
+*               MetNodeWeights()
+*               MakeNodeMetFields()
 * COMMENTS:
 * $Id: MakeLocalMetData.c,v3.1.2 2014/01/1 ning Exp $     
 */
@@ -24,6 +29,11 @@
 #include "functions.h"
 #include "constants.h"
 #include "rad.h"
+#include "fastmath.h"
+
+static void MakeNodeMetFields(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+                              METLOCATION *Stat, TOPOPIX **TopoMap,
+                              STATICMAP *WindModel, METFIELDS *MetFields);
 
 /*****************************************************************************
 Function name: MakeLocalMetData()
@@ -33,17 +43,19 @@ Purpose      : Generates meteorological for each individual cell
 Required     :
 int y 
 int x
+int Cell - index of the cell in Map->ActiveCells
 MAPSIZE Map
+METFIELDS *MetFields - interpolated met fields (see MakeMetFields())
 int DayStep
 unsigned char PrecipType
 int NStats
 METLOCATION *Stat
-uchar *MetWeights
+METWEIGHT *MetWeights - interpolation weights for this pixel
 float LocalElev
 RADCLASSPIX *RadMap 
 PRECIPPIX *PrecipMap
 MAPSIZE Radar
-RADARPIX **RadarMap
+float *RadarMap - radar precipitation for the window covering the basin
 
 Returns      :
 PIXMET LocalMet
@@ -54,119 +66,43 @@ Comments     :
 Reference: Shuttleworth, W.J., Evaporation,  In: Maidment, D. R. (ed.),
 Handbook of hydrology,  1993, McGraw-Hill, New York, etc..
 *****************************************************************************/
-PIXMET MakeLocalMetData(int y, int x, MAPSIZE *Map, int DayStep,
+PIXMET MakeLocalMetData(int y, int x, int Cell, MAPSIZE *Map,
+                        METFIELDS *MetFields, int DayStep,
                         OPTIONSTRUCT *Options, int NStats,
-                        METLOCATION *Stat, uchar *MetWeights,
+                        METLOCATION *Stat, METWEIGHT *MetWeights,
                         float LocalElev, PIXRAD *RadMap,
                         PRECIPPIX *PrecipMap, MAPSIZE *Radar,
-                        RADARPIX **RadarMap, float **PrismMap,
+                        float *RadarMap, float **PrismMap,
                         SNOWPIX *LocalSnow, SNOWTABLE *SnowAlbedo,
-                        float ***MM5Input, float ***WindModel,
-                        float **PrecipLapseMap, MET_MAP_PIX ***MetMap,
-                        int NGraphics, int Month, float skyview,
+                        float ***MM5Input, STATICMAP *WindModel,
+                        STATICMAP *PrecipLapseMap, MET_MAP_PIX ***MetMap,
+                        int Diagnostics, int Month, float skyview,
                         unsigned char shadow, float SunMax,
                         float SineSolarAltitude)
 {
-  float CurrentWeight;		/* weight for current station */
-  float ScaleWind = 1;		/* Wind to be scaled by model factors if 
-                            WindSource == MODEL */
-  float Temp;			/* Temporary variable */
-  float WeightSum;		/* sum of the weights */
+  float LapsedPrecip;		/* lapsed precipitation of a station */
+  float Multiplier;		/* PRECIPMULTIPLIER term of LapsePrecip() */
   int i;			/* counter */
-  int RadarX;			/* X coordinate of radar map coordinate */
-  int RadarY;			/* Y coordinate of radar map coordinate */
-  float TempLapseRate;
-  int WindDirection = 0;	/* Direction of model wind */
+  int j;			/* counter */
   PIXMET LocalMet;		/* local met data */
 
-  LocalMet.Tair = 0.0;
-  LocalMet.Rh = 0.0;
-  LocalMet.Wind = 0.0;
-  LocalMet.Sin = 0.0;
-  LocalMet.SinBeam = 0.0;
-  LocalMet.SinDiffuse = 0.0;
-  LocalMet.Lin = 0.0;
-  TempLapseRate = 0.0;
-
-  if (Options->MM5 == TRUE && Options->QPF == TRUE) {
-    WeightSum = 0.0;
-    for (i = 0; i < NStats; i++)
-      WeightSum += (float) MetWeights[i];
-  }
+  /* the basic met variables have been interpolated for all cells by 
+     MakeMetFields() */
+  LocalMet.Tair = MetFields->Tair[Cell];
+  LocalMet.Rh = MetFields->Rh[Cell];
+  LocalMet.Wind = MetFields->Wind[Cell];
+  LocalMet.Sin = MetFields->Sin[Cell];
+  LocalMet.SinBeam = MetFields->SinBeam[Cell];
+  LocalMet.SinDiffuse = MetFields->SinDiffuse[Cell];
+  LocalMet.Lin = MetFields->Lin[Cell];
+  LocalMet.Press = MetFields->Press[Cell];
 
   if (Options->MM5 == TRUE) {
-    LocalMet.Tair = MM5Input[MM5_temperature - 1][y][x] +
-      (LocalElev - MM5Input[MM5_terrain - 1][y][x]) * 
-      MM5Input[MM5_lapse - 1][y][x];
-    LocalMet.Rh = MM5Input[MM5_humidity - 1][y][x];
-    LocalMet.Wind = MM5Input[MM5_wind - 1][y][x];
-    LocalMet.Sin = MM5Input[MM5_shortwave - 1][y][x];
-
-    if (Options->Shading == TRUE) {
-      if (SunMax > 0.0) {
-        SeparateRadiation(LocalMet.Sin, LocalMet.Sin / SunMax,
-          &(LocalMet.SinBeam), &(LocalMet.SinDiffuse)); 
-      }
-      else {
-        /* if sun is below horizon, the force all shortwave to zero */
-        LocalMet.Sin = 0.0;
-        LocalMet.SinBeam = 0.0;
-        LocalMet.SinDiffuse = 0.0; 
-      }
-    }
-    LocalMet.Lin = MM5Input[MM5_longwave - 1][y][x];
-    LocalMet.Press = 101300.0;
     PrecipMap->Precip = MM5Input[MM5_precip - 1][y][x];
   }
-  else {			/* MM5 is false and we need to interpolate the basic met records */
-    WeightSum = 0.0;
-    for (i = 0; i < NStats; i++) {
-      WeightSum += (float) MetWeights[i];
-      if (Options->WindSource == MODEL && Stat[i].IsWindModelLocation) {
-        ScaleWind = Stat[i].Data.Wind;
-        WindDirection = Stat[i].Data.WindDirection;
-      }
-    }
-    for (i = 0; i < NStats; i++) {
-      CurrentWeight = ((float) MetWeights[i]) / WeightSum;
-      LocalMet.Tair += CurrentWeight *
-        LapseT(Stat[i].Data.Tair, Stat[i].Elev, LocalElev,
-        Stat[i].Data.TempLapse);
-      LocalMet.Rh += CurrentWeight * Stat[i].Data.Rh;
-      if (Options->WindSource == STATION)
-        LocalMet.Wind += CurrentWeight * Stat[i].Data.Wind;
-      LocalMet.Lin += CurrentWeight * Stat[i].Data.Lin;
-      LocalMet.Sin += CurrentWeight * Stat[i].Data.Sin;
-      if (Options->Shading == TRUE) {
-        LocalMet.SinBeam += CurrentWeight * Stat[i].Data.SinBeamObs;
-        LocalMet.SinDiffuse += CurrentWeight * Stat[i].Data.SinDiffuseObs;
-      }
-      TempLapseRate += CurrentWeight * Stat[i].Data.TempLapse;
-    }
-    if (Options->WindSource == MODEL)
-      LocalMet.Wind = ScaleWind * WindModel[WindDirection - 1][y][x];
-
-    if (Options->PrecipType == RADAR) {
-      RadarY = (int) ((y + Radar->OffsetY) * Map->DY / Radar->DY);
-      RadarX = (int) ((x - Radar->OffsetX) * Map->DX / Radar->DX);
-      PrecipMap->Precip = RadarMap[RadarY][RadarX].Precip;
-    }
-    /* WORK IN PROGRESS, taken from old DHSVM version */
-    /* Air pressure */
-    /* In rare cases - i.e. when the lapse rate has a different sign for 
-    different met stations - you can end up with a TemplapseRate of 0.0
-    This will result in a crash, so a check was put in (Jul 28, 1997 - Bart
-    Nijssen).  It is somewhat awkward to interpolate lapse rates anyway, so
-    a better way of doing this would be welcome */
-    if (TempLapseRate != 0.0) {
-      Temp = 9.8067 / (TempLapseRate * 287.0);
-      LocalMet.Press = 101300. * pow(((288.0 - TempLapseRate * LocalElev) / 288.0), Temp);
-    }
-    else
-      LocalMet.Press = 101300.;
-
-  }				/* end of else MM5==TRUE, i.e. all basic met, except for precip */
-  /* has been interpolated */
+  else if (Options->PrecipType == RADAR) {
+    PrecipMap->Precip = RadarMap[Radar->RegridIndex[y * Map->NX + x]];
+  }
 
   /* Here is how the following section works */
   /* Arc-Info (through use of the hillshade command) will give */
@@ -228,40 +164,40 @@ PIXMET MakeLocalMetData(int y, int x, MAPSIZE *Map, int DayStep,
   LocalMet.Sin = RadMap->BeamIn + RadMap->DiffuseIn;
 
   if (Options->QPF == TRUE || Options->MM5 == FALSE) {
-    if (Options->PrecipType == STATION && Options->Prism == FALSE) {
+    if (MetFields->Precip != NULL)
+      PrecipMap->Precip = MetFields->Precip[Cell];
+    else if (Options->PrecipType == STATION && Options->Prism == FALSE) {
+      /* LapsePrecip() with the lapse term of each station from
+         MakePrecipFactors(), LapsePrecip(P, 0, 1, Rate) for the MAP */
+      Multiplier = 1 + PRECIPMULTIPLIER *
+        (((Options->PrecipLapse == MAP) ? 1 : LocalElev) - MINELEV);
       PrecipMap->Precip = 0.0;
-      for (i = 0; i < NStats; i++) {
-        CurrentWeight = ((float) MetWeights[i]) / WeightSum;
-        if (Options->PrecipLapse == MAP)
-          PrecipMap->Precip += CurrentWeight *
-          LapsePrecip(Stat[i].Data.Precip, 0, 1, PrecipLapseMap[y][x]);
-        else
-          PrecipMap->Precip += CurrentWeight *
-          LapsePrecip(Stat[i].Data.Precip, Stat[i].Elev, LocalElev,
-          Stat[i].Data.PrecipLapse);
+      for (j = 0; j < MetWeights->NWeights; j++) {
+        i = MetWeights->Stat[j];
+        LapsedPrecip = MetFields->StatValue[i].Precip *
+          (1.0 + MetWeights->PFactor[j]) * Multiplier;
+        if (LapsedPrecip < 0.0)
+          LapsedPrecip = 0.0;
+        PrecipMap->Precip += MetWeights->Weight[j] * LapsedPrecip;
       }
     }
     else if (Options->PrecipType == STATION && Options->Prism == TRUE) {
+      /* this is the real prism interpolation, with the PRISM value at
+         each station from MakePrecipFactors() */
       PrecipMap->Precip = 0.0;
-      for (i = 0; i < NStats; i++) {
-        CurrentWeight = ((float) MetWeights[i]) / WeightSum;
-        /* this is the real prism interpolation */
-        /* note that X = position from left  boundary, ie # of columns */
-        /* note that Y = position from upper boundary, ie # of rows   */
-        if (Options->Outside == FALSE)
-          PrecipMap->Precip += CurrentWeight * Stat[i].Data.Precip /
-          PrismMap[Stat[i].Loc.N][Stat[i].Loc.E] * PrismMap[y][x];
-        else
-          PrecipMap->Precip += CurrentWeight * Stat[i].Data.Precip /
-          Stat[i].PrismPrecip[Month - 1] * PrismMap[y][x];
-        if (PrismMap[y][x] < 0){
-          printf("negative PrismMap value in MakeLocalMetData.c\n");
-          exit(0);
-        }
+      for (j = 0; j < MetWeights->NWeights; j++) {
+        i = MetWeights->Stat[j];
+        PrecipMap->Precip += MetWeights->Weight[j] *
+          MetFields->StatValue[i].Precip / MetWeights->PFactor[j] *
+          PrismMap[y][x];
       }
     }
   }
 
+  /* precipitation factor of this ensemble member or scenario */
+  if (Options->PrecipFactor != 1.0)
+    PrecipMap->Precip *= Options->PrecipFactor;
+
   /* due to the nature of the interpolation scheme in DHSVM and the */
   /* interpolation scheme to handle the mess of different formats of met stations */
   /* in the PRISM project */
@@ -320,7 +256,7 @@ PIXMET MakeLocalMetData(int y, int x, MAPSIZE *Map, int DayStep,
   else
     LocalSnow->LastSnow = 0;
 
-  if (NGraphics > 0) {
+  if (Diagnostics & DIAG_METMAP) {
     (*MetMap)[y][x].accum_precip =
       (*MetMap)[y][x].accum_precip + PrecipMap->Precip;
     (*MetMap)[y][x].air_temp = LocalMet.Tair;
@@ -330,3 +266,581 @@ PIXMET MakeLocalMetData(int y, int x, MAPSIZE *Map, int DayStep,
 
   return LocalMet;
 }
+
+/*****************************************************************************
+Function name: MetNodeWeights()
+
+Purpose      : Find the four nodes of the coarse met grid around cell (y, x)
+               and their bilinear interpolation weights
+
+Required     :
+METFIELDS *MetFields
+int y
+int x
+
+Returns      : void
+
+Modifies     : Node - index of the nodes, Weight - their weights (4 each)
+*****************************************************************************/
+void MetNodeWeights(METFIELDS *MetFields, int y, int x, int *Node,
+                    float *Weight)
+{
+  float Fy;			/* distance of the cell below the upper nodes */
+  float Fx;			/* distance of the cell right of the left nodes */
+  int Row;
+  int Col;
+
+  Row = y / MetFields->Step;
+  Col = x / MetFields->Step;
+  Fy = (float) (y - Row * MetFields->Step) / MetFields->Step;
+  Fx = (float) (x - Col * MetFields->Step) / MetFields->Step;
+  Node[0] = Row * MetFields->NodeNX + Col;
+  Node[1] = Node[0] + 1;
+  Node[2] = Node[0] + MetFields->NodeNX;
+  Node[3] = Node[2] + 1;
+  Weight[0] = (1 - Fy) * (1 - Fx);
+  Weight[1] = (1 - Fy) * Fx;
+  Weight[2] = Fy * (1 - Fx);
+  Weight[3] = Fy * Fx;
+}
+
+/*****************************************************************************
+Function name: MakeNodeMetFields()
+
+Purpose      : MakeMetFields() for a coarse met grid: interpolate the 
+               station met to the nodes, and downscale it to the cells
+
+Required     :
+MAPSIZE *Map
+OPTIONSTRUCT *Options
+int NStats
+METLOCATION *Stat
+TOPOPIX **TopoMap
+STATICMAP *WindModel
+float ScaleWind
+int WindDirection
+METFIELDS *MetFields
+
+Returns      : void
+
+Modifies     : MetFields
+
+Comments     : The temperature and the station precipitation of a node are
+               lapsed to the node elevation, and the weighted lapse rates of
+               the node are kept.  A cell gets the bilinear interpolation of
+               the node values lapsed from each node elevation to the cell 
+               elevation.  The lapse terms are linear in the elevation, so 
+               this gives the same result as interpolating the stations with
+               the bilinear interpolation of the node weights.  The air 
+               pressure is calculated from the interpolated lapse rate.  The
+               wind model, the shading and the sky view are still applied 
+               per cell.
+*****************************************************************************/
+static void MakeNodeMetFields(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+                              METLOCATION *Stat, TOPOPIX **TopoMap,
+                              STATICMAP *WindModel, METFIELDS *MetFields)
+{
+  float CurrentWeight;		/* weight for current station */
+  float Temp;			/* Temporary variable */
+  float Elev;
+  float Tair, Rh, Wind, Sin, SinBeam, SinDiffuse, Lin, Precip, PLapse;
+  float TempLapseRate;
+  float Weight[4];		/* bilinear weights of the nodes of a cell */
+  int Node[4];			/* nodes of a cell */
+  int StationWind;
+  int UpdateLapse;
+  int NNodes;
+  int i;
+  int j;
+  int k;
+  int n;
+  int t;			/* tile */
+  int x, y;
+  METWEIGHT *Weights;
+  STATVALUE *Value;
+
+  StationWind = (Options->WindSource == STATION);
+  UpdateLapse = !MetFields->LapseValid;
+  for (i = 0; i < NStats && !UpdateLapse; i++)
+    if (Stat[i].Data.TempLapse != MetFields->StatLapse[i])
+      UpdateLapse = TRUE;
+  if (UpdateLapse) {
+    for (i = 0; i < NStats; i++)
+      MetFields->StatLapse[i] = Stat[i].Data.TempLapse;
+    MetFields->LapseValid = TRUE;
+  }
+
+  NNodes = MetFields->NodeNY * MetFields->NodeNX;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(i, j, Weights, Value, Elev, CurrentWeight, Tair, Rh, Wind, Sin, \
+	  SinBeam, SinDiffuse, Lin, Precip, PLapse, TempLapseRate)
+#endif
+  for (n = 0; n < NNodes; n++) {
+    Weights = &(MetFields->NodeWeights[n / MetFields->NodeNX]
+		[n % MetFields->NodeNX]);
+    if (Weights->NWeights == 0)
+      continue;
+    Elev = MetFields->NodeElev[n];
+
+    if (UpdateLapse) {
+      TempLapseRate = 0.0;
+      for (j = 0; j < Weights->NWeights; j++) {
+        i = Weights->Stat[j];
+        Weights->TOffset[j] = (Elev - Stat[i].Elev) * Stat[i].Data.TempLapse;
+        TempLapseRate += Weights->Weight[j] * Stat[i].Data.TempLapse;
+      }
+      MetFields->NodeTLapse[n] = TempLapseRate;
+    }
+
+    Tair = 0.0;
+    Rh = 0.0;
+    Wind = 0.0;
+    Sin = 0.0;
+    SinBeam = 0.0;
+    SinDiffuse = 0.0;
+    Lin = 0.0;
+    Precip = 0.0;
+    PLapse = 0.0;
+    for (j = 0; j < Weights->NWeights; j++) {
+      i = Weights->Stat[j];
+      Value = &(MetFields->StatValue[i]);
+      CurrentWeight = Weights->Weight[j];
+      Tair += CurrentWeight * (Value->Tair + Weights->TOffset[j]);
+      Rh += CurrentWeight * Value->Rh;
+      Wind += CurrentWeight * Value->Wind;
+      Lin += CurrentWeight * Value->Lin;
+      Sin += CurrentWeight * Value->Sin;
+      SinBeam += CurrentWeight * Value->SinBeam;
+      SinDiffuse += CurrentWeight * Value->SinDiffuse;
+      /* LapsePrecip() without the PRECIPMULTIPLIER term, which is applied
+         per cell */
+      Precip += CurrentWeight * Value->Precip *
+        (1.0 + Stat[i].Data.PrecipLapse * (Elev - Stat[i].Elev));
+      PLapse += CurrentWeight * Value->Precip * Stat[i].Data.PrecipLapse;
+    }
+    MetFields->NodeTair[n] = Tair;
+    MetFields->NodeRh[n] = Rh;
+    MetFields->NodeWind[n] = Wind;
+    MetFields->NodeSin[n] = Sin;
+    MetFields->NodeSinBeam[n] = SinBeam;
+    MetFields->NodeSinDiffuse[n] = SinDiffuse;
+    MetFields->NodeLin[n] = Lin;
+    MetFields->NodePrecip[n] = Precip;
+    MetFields->NodePLapse[n] = PLapse;
+  }
+
+  PlanTiles(&(MetFields->Tiles));
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(Options->NThreads) \
+  private(t, k, x, y, i, n, Node, Weight, Elev, CurrentWeight, Temp, Tair, \
+	  Rh, Wind, Sin, SinBeam, SinDiffuse, Lin, Precip, TempLapseRate)
+#endif
+  while ((t = NextTile(&(MetFields->Tiles))) >= 0) {
+    for (k = MetFields->Tiles.Start[t]; k < MetFields->Tiles.Start[t + 1];
+	 k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      Elev = TopoMap[y][x].Dem;
+      MetNodeWeights(MetFields, y, x, Node, Weight);
+
+      Tair = 0.0;
+      Rh = 0.0;
+      Wind = 0.0;
+      Sin = 0.0;
+      SinBeam = 0.0;
+      SinDiffuse = 0.0;
+      Lin = 0.0;
+      Precip = 0.0;
+      TempLapseRate = 0.0;
+      for (i = 0; i < 4; i++) {
+        if (Weight[i] == 0.0)
+          continue;
+        n = Node[i];
+        CurrentWeight = Weight[i];
+        Tair += CurrentWeight * (MetFields->NodeTair[n] + 
+          (Elev - MetFields->NodeElev[n]) * MetFields->NodeTLapse[n]);
+        TempLapseRate += CurrentWeight * MetFields->NodeTLapse[n];
+        Rh += CurrentWeight * MetFields->NodeRh[n];
+        Wind += CurrentWeight * MetFields->NodeWind[n];
+        Sin += CurrentWeight * MetFields->NodeSin[n];
+        SinBeam += CurrentWeight * MetFields->NodeSinBeam[n];
+        SinDiffuse += CurrentWeight * MetFields->NodeSinDiffuse[n];
+        Lin += CurrentWeight * MetFields->NodeLin[n];
+        Precip += CurrentWeight * (MetFields->NodePrecip[n] +
+          (Elev - MetFields->NodeElev[n]) * MetFields->NodePLapse[n]);
+      }
+      if (!StationWind)
+        Wind = MetFields->ScaleWind *
+          StaticMapValue(&(WindModel[MetFields->WindDirection - 1]), k);
+
+      /* as in MakeMetFields() */
+      if (UpdateLapse) {
+        if (TempLapseRate != 0.0) {
+          Temp = 9.8067 / (TempLapseRate * 287.0);
+          MetFields->Press[k] = 101300. * MathPow(((288.0 - TempLapseRate * Elev) / 288.0), Temp);
+        }
+        else
+          MetFields->Press[k] = 101300.;
+      }
+
+      MetFields->Tair[k] = Tair;
+      MetFields->Rh[k] = Rh;
+      MetFields->Wind[k] = Wind;
+      MetFields->Sin[k] = Sin;
+      MetFields->SinBeam[k] = SinBeam;
+      MetFields->SinDiffuse[k] = SinDiffuse;
+      MetFields->Lin[k] = Lin;
+      if (MetFields->Precip != NULL) {
+        Precip *= (1 + PRECIPMULTIPLIER * (Elev - MINELEV));
+        MetFields->Precip[k] = (Precip < 0.0) ? 0.0 : Precip;
+      }
+    }
+  }
+}
+
+/*****************************************************************************
+Function name: MakePrecipFactors()
+
+Purpose      : Calculate the terms that scale the precipitation of each
+               station to the cells, for the station precipitation of 
+               MakeLocalMetData()
+
+Required     :
+MAPSIZE *Map
+OPTIONSTRUCT *Options
+int NStats
+METLOCATION *Stat
+METWEIGHT **MetWeights
+TOPOPIX **TopoMap
+float **PrismMap - PRISM map of the month (PRISM = TRUE)
+STATICMAP *PrecipLapseMap - Precipitation lapse rates (PRECIPITATION LAPSE
+                            RATE = MAP)
+int Month
+METFIELDS *MetFields
+
+Returns      : void
+
+Modifies     : MetWeights (PFactor), MetFields (StatPLapse, PFactorMonth)
+
+Comments     : The factor of a station is the PRISM value at the station
+               with PRISM, otherwise the lapse rate times the difference
+               of the elevations of the cell and the station, as in
+               LapsePrecip().  MakeLocalMetData() does the rest of the
+               scaling in the order of the operations of LapsePrecip() and
+               of the PRISM ratio, so the precipitation is the same to the
+               last bit; a factor that also held the interpolation weight
+               would change the rounding, which changes the snow pack
+               downstream of thresholds.  The factors only change with the
+               PRISM map (every month) or with the station lapse rates (if
+               these are read from the station files), and are only
+               recalculated then.
+*****************************************************************************/
+void MakePrecipFactors(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+                       METLOCATION *Stat, METWEIGHT **MetWeights,
+                       TOPOPIX **TopoMap, float **PrismMap,
+                       STATICMAP *PrecipLapseMap, int Month,
+                       METFIELDS *MetFields)
+{
+  float LocalElev;
+  int Update;			/* TRUE if the factors are recalculated */
+  int i;			/* counter */
+  int j;			/* counter */
+  int k;			/* cell counter */
+  int x, y;
+  METWEIGHT *Weights;
+
+  if (Options->PrecipType != STATION || MetFields->Precip != NULL ||
+      (Options->QPF == FALSE && Options->MM5 == TRUE))
+    return;
+
+  Update = (MetFields->PFactorMonth == 0);
+  if (Options->Prism == TRUE && Month != MetFields->PFactorMonth)
+    Update = TRUE;
+  if (Options->Prism == FALSE && Options->PrecipLapse != MAP)
+    for (i = 0; i < NStats && !Update; i++)
+      if (Stat[i].Data.PrecipLapse != MetFields->StatPLapse[i])
+	Update = TRUE;
+  if (!Update)
+    return;
+  for (i = 0; i < NStats; i++)
+    MetFields->StatPLapse[i] = Stat[i].Data.PrecipLapse;
+  MetFields->PFactorMonth = Month;
+
+  if (Options->Prism == TRUE) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      if (MetWeights[y][x].NWeights > 0 && PrismMap[y][x] < 0) {
+        printf("negative PrismMap value in MakeLocalMetData.c\n");
+        exit(0);
+      }
+    }
+  }
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(i, j, x, y, Weights, LocalElev)
+#endif
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Weights = &(MetWeights[y][x]);
+    LocalElev = TopoMap[y][x].Dem;
+    for (j = 0; j < Weights->NWeights; j++) {
+      i = Weights->Stat[j];
+      /* note that X = position from left  boundary, ie # of columns */
+      /* note that Y = position from upper boundary, ie # of rows   */
+      if (Options->Prism == TRUE && Options->Outside == FALSE)
+        Weights->PFactor[j] = PrismMap[Stat[i].Loc.N][Stat[i].Loc.E];
+      else if (Options->Prism == TRUE)
+        Weights->PFactor[j] = Stat[i].PrismPrecip[Month - 1];
+      else if (Options->PrecipLapse == MAP)
+        Weights->PFactor[j] = StaticMapValue(PrecipLapseMap, k);
+      else
+        Weights->PFactor[j] = Stat[i].Data.PrecipLapse *
+          (LocalElev - Stat[i].Elev);
+    }
+  }
+}
+
+/*****************************************************************************
+Function name: MakeStationValues()
+
+Purpose      : Gather the values of the stations that are interpolated to
+               the cells in the current time step
+
+Required     :
+OPTIONSTRUCT *Options
+int NStats
+METLOCATION *Stat
+METFIELDS *MetFields
+
+Returns      : void
+
+Modifies     : MetFields (StatValue, ScaleWind, WindDirection)
+
+Comments     : The cell loops of MakeMetFields() and the station
+               precipitation of MakeLocalMetData() read the values of each
+               station from this short vector instead of from the much
+               larger METLOCATION, and without a test per station.  A value
+               that is not interpolated (the station wind with the wind
+               model, the beam and diffuse radiation without shading) is
+               0, which adds nothing to the sums.  The scale and direction
+               of the wind model are those of its station.
+*****************************************************************************/
+void MakeStationValues(OPTIONSTRUCT *Options, int NStats, METLOCATION *Stat,
+                       METFIELDS *MetFields)
+{
+  STATVALUE *Value;
+  int StationWind;
+  int Shading;
+  int i;			/* counter */
+
+  StationWind = (Options->WindSource == STATION);
+  Shading = (Options->Shading == TRUE);
+  MetFields->ScaleWind = 1;
+  MetFields->WindDirection = 0;
+  for (i = 0; i < NStats; i++) {
+    Value = &(MetFields->StatValue[i]);
+    Value->Tair = Stat[i].Data.Tair;
+    Value->Rh = Stat[i].Data.Rh;
+    Value->Wind = StationWind ? Stat[i].Data.Wind : 0.0;
+    Value->Sin = Stat[i].Data.Sin;
+    Value->SinBeam = Shading ? Stat[i].Data.SinBeamObs : 0.0;
+    Value->SinDiffuse = Shading ? Stat[i].Data.SinDiffuseObs : 0.0;
+    Value->Lin = Stat[i].Data.Lin;
+    Value->Precip = Stat[i].Data.Precip;
+    if (Options->WindSource == MODEL && Stat[i].IsWindModelLocation) {
+      MetFields->ScaleWind = Stat[i].Data.Wind;
+      MetFields->WindDirection = Stat[i].Data.WindDirection;
+    }
+  }
+}
+
+/*****************************************************************************
+Function name: MakeMetFields()
+
+Purpose      : Interpolate the basic meteorological variables (air 
+               temperature, humidity, wind, shortwave and longwave 
+               radiation and air pressure) for all active cells
+
+Required     :
+MAPSIZE *Map
+OPTIONSTRUCT *Options
+int NStats
+METLOCATION *Stat
+METWEIGHT **MetWeights
+TOPOPIX **TopoMap
+float ***MM5Input
+STATICMAP *WindModel
+float SunMax
+METFIELDS *MetFields
+
+Returns      : void
+
+Modifies     : MetFields
+
+Comments     : This is done as a separate pass over the grid before the 
+               pixel loop, so that the choices that are the same for all 
+               cells (MM5 or stations, source of the wind, location of the
+               wind model station) are only made once per time step.  The
+               station sums are done in the same order as before, so the 
+               results do not change.
+               The lapse terms (lapse from each station to the cell and air
+               pressure) are kept between time steps in MetWeights and 
+               MetFields, and only recalculated when a station lapse rate 
+               changes.
+*****************************************************************************/
+void MakeMetFields(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+                   METLOCATION *Stat, METWEIGHT **MetWeights,
+                   TOPOPIX **TopoMap, float ***MM5Input, STATICMAP *WindModel,
+                   float SunMax, METFIELDS *MetFields)
+{
+  float CurrentWeight;		/* weight for current station */
+  float Temp;			/* Temporary variable */
+  float LocalElev;
+  float Tair, Rh, Wind, Sin, SinBeam, SinDiffuse, Lin;
+  float TempLapseRate;
+  int StationWind;
+  int UpdateLapse;		/* TRUE if the lapse terms are recalculated */
+  int i;			/* counter */
+  int j;			/* counter */
+  int k;			/* cell counter */
+  int t;			/* tile */
+  int x, y;
+  METWEIGHT *Weights;
+  STATVALUE *Value;
+
+  /* the station precipitation is also used with MM5 and QPF */
+  MakeStationValues(Options, NStats, Stat, MetFields);
+
+  if (Options->MM5 == TRUE) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(x, y)
+#endif
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      MetFields->Tair[k] = MM5Input[MM5_temperature - 1][y][x] +
+        (TopoMap[y][x].Dem - MM5Input[MM5_terrain - 1][y][x]) * 
+        MM5Input[MM5_lapse - 1][y][x];
+      MetFields->Rh[k] = MM5Input[MM5_humidity - 1][y][x];
+      MetFields->Wind[k] = MM5Input[MM5_wind - 1][y][x];
+      MetFields->Sin[k] = MM5Input[MM5_shortwave - 1][y][x];
+      MetFields->SinBeam[k] = 0.0;
+      MetFields->SinDiffuse[k] = 0.0;
+      MetFields->Lin[k] = MM5Input[MM5_longwave - 1][y][x];
+      MetFields->Press[k] = 101300.0;
+
+      /* with shading the radiation is separated here, with the other
+         fields of the cell; if sun is below horizon, the force all
+         shortwave to zero */
+      if (Options->Shading == TRUE) {
+        if (SunMax > 0.0)
+          SeparateRadiation(MetFields->Sin[k], MetFields->Sin[k] / SunMax,
+            &(MetFields->SinBeam[k]), &(MetFields->SinDiffuse[k]));
+        else
+          MetFields->Sin[k] = 0.0;
+      }
+    }
+    return;
+  }
+
+  /* MM5 is false and we need to interpolate the basic met records */
+  StationWind = (Options->WindSource == STATION);
+
+  /* with a coarse met grid the stations are only interpolated to its nodes
+     (see InitMetNodes()) */
+  if (MetFields->Step > 1) {
+    MakeNodeMetFields(Map, Options, NStats, Stat, TopoMap, WindModel,
+		      MetFields);
+    return;
+  }
+
+  /* The lapse from each station to each cell and the air pressure only 
+     depend on the station lapse rates.  These are constant unless the 
+     lapse rates are read from the station files, so the lapse terms are
+     only recalculated when one of the lapse rates changes */
+  UpdateLapse = !MetFields->LapseValid;
+  for (i = 0; i < NStats && !UpdateLapse; i++)
+    if (Stat[i].Data.TempLapse != MetFields->StatLapse[i])
+      UpdateLapse = TRUE;
+  if (UpdateLapse) {
+    for (i = 0; i < NStats; i++)
+      MetFields->StatLapse[i] = Stat[i].Data.TempLapse;
+    MetFields->LapseValid = TRUE;
+  }
+
+  PlanTiles(&(MetFields->Tiles));
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(Options->NThreads) \
+  private(t, k, x, y, i, j, Weights, Value, LocalElev, CurrentWeight, Temp, \
+	  Tair, Rh, Wind, Sin, SinBeam, SinDiffuse, Lin, TempLapseRate)
+#endif
+  while ((t = NextTile(&(MetFields->Tiles))) >= 0) {
+    for (k = MetFields->Tiles.Start[t]; k < MetFields->Tiles.Start[t + 1];
+	 k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      Weights = &(MetWeights[y][x]);
+      LocalElev = TopoMap[y][x].Dem;
+
+      Tair = 0.0;
+      Rh = 0.0;
+      Wind = 0.0;
+      Sin = 0.0;
+      SinBeam = 0.0;
+      SinDiffuse = 0.0;
+      Lin = 0.0;
+      if (UpdateLapse) {
+        TempLapseRate = 0.0;
+        for (j = 0; j < Weights->NWeights; j++) {
+          i = Weights->Stat[j];
+          /* same as LapseT() without the station temperature */
+          Weights->TOffset[j] = (LocalElev - Stat[i].Elev) * 
+            Stat[i].Data.TempLapse;
+          TempLapseRate += Weights->Weight[j] * Stat[i].Data.TempLapse;
+        }
+
+        /* WORK IN PROGRESS, taken from old DHSVM version */
+        /* Air pressure */
+        /* In rare cases - i.e. when the lapse rate has a different sign for 
+        different met stations - you can end up with a TemplapseRate of 0.0
+        This will result in a crash, so a check was put in (Jul 28, 1997 - Bart
+        Nijssen).  It is somewhat awkward to interpolate lapse rates anyway, so
+        a better way of doing this would be welcome */
+        if (TempLapseRate != 0.0) {
+          Temp = 9.8067 / (TempLapseRate * 287.0);
+          MetFields->Press[k] = 101300. * MathPow(((288.0 - TempLapseRate * LocalElev) / 288.0), Temp);
+        }
+        else
+          MetFields->Press[k] = 101300.;
+      }
+
+      for (j = 0; j < Weights->NWeights; j++) {
+        Value = &(MetFields->StatValue[Weights->Stat[j]]);
+        CurrentWeight = Weights->Weight[j];
+        Tair += CurrentWeight * (Value->Tair + Weights->TOffset[j]);
+        Rh += CurrentWeight * Value->Rh;
+        Wind += CurrentWeight * Value->Wind;
+        Lin += CurrentWeight * Value->Lin;
+        Sin += CurrentWeight * Value->Sin;
+        SinBeam += CurrentWeight * Value->SinBeam;
+        SinDiffuse += CurrentWeight * Value->SinDiffuse;
+      }
+      if (!StationWind)
+        Wind = MetFields->ScaleWind *
+          StaticMapValue(&(WindModel[MetFields->WindDirection - 1]), k);
+
+      MetFields->Tair[k] = Tair;
+      MetFields->Rh[k] = Rh;
+      MetFields->Wind[k] = Wind;
+      MetFields->Sin[k] = Sin;
+      MetFields->SinBeam[k] = SinBeam;
+      MetFields->SinDiffuse[k] = SinDiffuse;
+      MetFields->Lin[k] = Lin;
+    }
+  }
+}
@@ -0,0 +1,357 @@
+/*
+ * SUMMARY:      MapEvents.c - Replace the vegetation or soil depth map
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  A map event (NUMBER OF MAP EVENTS) replaces the vegetation
+ *               map or the soil depth map at a date of the run, for
+ *               scenarios of harvest, fire or urbanisation that would
+ *               otherwise store the state, edit the maps and start again.
+ *               Only the cells whose value changes are updated, together
+ *               with the per-cell data derived from the map.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitMapEvents()
+ *               ApplyMapEvent()
+ *               ReadEventMap()
+ *               CellStorage()
+ *               ChangeVegetation()
+ * COMMENTS:     The number of vegetation layers of a cell may change: its
+ *               interception and evapotranspiration arrays are then carved
+ *               again from the arena, and the water intercepted by the old
+ *               canopy falls to the ground, rain as surface water and snow
+ *               onto the pack.  The new vegetation type has to have as many
+ *               root zones as the soil of the cell has layers, and the soil
+ *               has to be deeper than the roots, as checked by CheckOut().
+ *               The soil moisture of each layer is kept, so the water in
+ *               the soil changes with the thickness of the layers; that
+ *               change is returned so that the mass balance does not count
+ *               it as an error.  The monthly vegetation parameters are per
+ *               type, so they need no update.  The response units are made
+ *               from the vegetation once, so map events cannot be used
+ *               with HRU MODE, nor with SPIN UP CYCLES, which would repeat
+ *               the events, or with a resumed run, whose checkpoint holds
+ *               the layers of the old maps
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "fileio.h"
+#include "functions.h"
+#include "getinit.h"
+#include "memaccount.h"
+#include "sizeofnt.h"
+#include "soilmoisture.h"
+#include "varid.h"
+
+static void ReadEventMap(MAPEVENT *Event, MAPSIZE *Map, void **Rows);
+static float CellStorage(int NSoil, int NVeg, float *RootDepth,
+			 SOILPIX *LocalSoil, SNOWPIX *LocalSnow,
+			 PRECIPPIX *LocalPrecip, ROADSTRUCT *LocalNetwork);
+static void ChangeVegetation(OPTIONSTRUCT *Options, int NOld, int NNew,
+			     int NSoil, SNOWPIX *LocalSnow, SOILPIX *LocalSoil,
+			     PRECIPPIX *LocalPrecip, EVAPPIX *LocalEvap);
+
+/*****************************************************************************
+  Function name: InitMapEvents()
+
+  Purpose      : Read the map events from the [OPTIONS] section
+
+  Required     :
+    LISTPTR Input         - Linked list with input strings
+    OPTIONSTRUCT *Options - HRU MODE and SPIN UP CYCLES
+    int Resume            - TRUE if the run continues from its checkpoint
+
+  Returns      : void
+
+  Modifies     : MAPEVENTS *Events
+
+  Comments     : Each event has a MAP EVENT DATE, a MAP EVENT VARIABLE,
+                 VEGETATION or SOIL DEPTH, and a MAP EVENT FILE in the
+                 format of the map it replaces.  The events are sorted by
+                 date, events of the same date keep their order
+*****************************************************************************/
+void InitMapEvents(LISTPTR Input, OPTIONSTRUCT *Options, int Resume,
+		   MAPEVENTS *Events)
+{
+  const char *Routine = "InitMapEvents";
+  char KeyName[BUFSIZE + 1];
+  char VarStr[BUFSIZE + 1];
+  MAPEVENT Event;
+  int i;
+  int j;
+
+  Events->NEvents = 0;
+  Events->Event = NULL;
+  Events->Next = 0;
+
+  GetInitString("OPTIONS", "NUMBER OF MAP EVENTS", "0", VarStr,
+		(unsigned long) BUFSIZE, Input);
+  if (!CopyInt(&(Events->NEvents), VarStr, 1) || Events->NEvents < 0)
+    ReportError("NUMBER OF MAP EVENTS", 51);
+  if (Events->NEvents == 0)
+    return;
+  if (Options->HRU || Options->SpinUpCycles > 0 || Resume)
+    ReportError((char *) Routine, 90);
+
+  if (!(Events->Event = (MAPEVENT *) calloc(Events->NEvents,
+					    sizeof(MAPEVENT))))
+    ReportError((char *) Routine, 1);
+
+  for (i = 0; i < Events->NEvents; i++) {
+    sprintf(KeyName, "MAP EVENT DATE %d", i + 1);
+    GetInitString("OPTIONS", KeyName, "", VarStr, (unsigned long) BUFSIZE,
+		  Input);
+    if (!SScanDate(VarStr, &(Event.Date)))
+      ReportError(KeyName, 51);
+
+    sprintf(KeyName, "MAP EVENT VARIABLE %d", i + 1);
+    GetInitString("OPTIONS", KeyName, "", VarStr, (unsigned long) BUFSIZE,
+		  Input);
+    if (strncmp(VarStr, "VEGETATION", 10) == 0)
+      Event.Variable = MAPEVENT_VEGETATION;
+    else if (strncmp(VarStr, "SOIL DEPTH", 10) == 0)
+      Event.Variable = MAPEVENT_SOILDEPTH;
+    else
+      ReportError(KeyName, 51);
+
+    sprintf(KeyName, "MAP EVENT FILE %d", i + 1);
+    GetInitString("OPTIONS", KeyName, "", Event.FileName,
+		  (unsigned long) BUFSIZE, Input);
+    if (IsEmptyStr(Event.FileName))
+      ReportError(KeyName, 51);
+
+    for (j = i; j > 0 && Before(&(Event.Date), &(Events->Event[j - 1].Date));
+	 j--)
+      Events->Event[j] = Events->Event[j - 1];
+    Events->Event[j] = Event;
+  }
+}
+
+/*****************************************************************************
+  Function name: ReadEventMap()
+
+  Purpose      : Read the map of Event into Rows, ints for the vegetation
+                 and floats for the soil depth
+*****************************************************************************/
+static void ReadEventMap(MAPEVENT *Event, MAPSIZE *Map, void **Rows)
+{
+  char VarName[BUFSIZE + 1];
+  int NumberType;
+  int ID = (Event->Variable == MAPEVENT_VEGETATION) ? 005 : 004;
+
+  GetVarName(ID, 0, VarName);
+  GetVarNumberType(ID, &NumberType);
+  if (Event->Variable == MAPEVENT_VEGETATION)
+    Read2DField(Event->FileName, NumberType, Map, 0, VarName, 0,
+		MAP_VALUES(Rows, int, NC_INT));
+  else
+    Read2DField(Event->FileName, NumberType, Map, 0, VarName, 0,
+		MAP_VALUES(Rows, float, NC_FLOAT));
+}
+
+/*****************************************************************************
+  Function name: CellStorage()
+
+  Purpose      : Water stored in the canopy, the snow pack, on the surface
+                 and in the soil column of a cell (m)
+*****************************************************************************/
+static float CellStorage(int NSoil, int NVeg, float *RootDepth,
+			 SOILPIX *LocalSoil, SNOWPIX *LocalSnow,
+			 PRECIPPIX *LocalPrecip, ROADSTRUCT *LocalNetwork)
+{
+  float Water;
+  int i;
+
+  Water = CalcTotalWater(NSoil, LocalSoil->Depth, RootDepth,
+			 LocalSoil->Moist, LocalNetwork->Adjust);
+  for (i = 0; i < NVeg; i++)
+    Water += LocalPrecip->IntRain[i] + LocalPrecip->IntSnow[i];
+  return Water + LocalSnow->Swq + LocalSoil->IExcess;
+}
+
+/*****************************************************************************
+  Function name: ChangeVegetation()
+
+  Purpose      : Drop the water intercepted by the old canopy of a cell and
+                 give it the layer arrays of NNew vegetation layers
+*****************************************************************************/
+static void ChangeVegetation(OPTIONSTRUCT *Options, int NOld, int NNew,
+			     int NSoil, SNOWPIX *LocalSnow, SOILPIX *LocalSoil,
+			     PRECIPPIX *LocalPrecip, EVAPPIX *LocalEvap)
+{
+  const char *Routine = "ChangeVegetation";
+  int i;
+
+  for (i = 0; i < NOld; i++) {
+    LocalSoil->IExcess += LocalPrecip->IntRain[i];
+    LocalSnow->Swq += LocalPrecip->IntSnow[i];
+    LocalPrecip->IntRain[i] = 0.0;
+    LocalPrecip->IntSnow[i] = 0.0;
+  }
+  LocalPrecip->TempIntStorage = 0.0;
+  LocalSnow->HasSnow = (LocalSnow->Swq > 0.0);
+
+  /* the arrays of the old canopy stay in the arena until the end */
+  if (NNew == NOld)
+    return;
+  if (!(LocalPrecip->IntRain = (float *) ArenaCalloc(NNew, sizeof(float),
+						     MEM_PRECIP)) ||
+      !(LocalPrecip->IntSnow = (float *) ArenaCalloc(NNew, sizeof(float),
+						     MEM_PRECIP)))
+    ReportError((char *) Routine, 1);
+
+  /* with SNOW ONLY all cells share arrays of the most layers */
+  if (Options->SnowOnly)
+    return;
+  if (!(LocalEvap->EPot = (float *) ArenaCalloc(NNew + 1, sizeof(float),
+						MEM_EVAP)) ||
+      !(LocalEvap->EAct = (float *) ArenaCalloc(NNew + 1, sizeof(float),
+						MEM_EVAP)) ||
+      !(LocalEvap->EInt = (float *) ArenaCalloc(NNew, sizeof(float),
+						MEM_EVAP)) ||
+      !(LocalEvap->ESoil = (float **) ArenaCalloc(NNew, sizeof(float *),
+						  MEM_EVAP)))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < NNew; i++) {
+    if (!(LocalEvap->ESoil[i] = (float *) ArenaCalloc(NSoil, sizeof(float),
+						      MEM_EVAP)))
+      ReportError((char *) Routine, 1);
+  }
+}
+
+/*****************************************************************************
+  Function name: ApplyMapEvent()
+
+  Purpose      : Replace the vegetation or soil depth of the cells of the
+                 map of Event, and update what depends on them
+
+  Required     :
+    MAPEVENT *Event       - Event to apply
+    OPTIONSTRUCT *Options - Options of the run
+    MAPSIZE *Map          - Active cells of the basin
+    LAYER *Veg            - Vegetation layers of each type
+    LAYER *Soil           - Soil layers of each type
+    VEGTABLE *VType       - Vegetation types
+    SOILTABLE *SType      - Soil types
+
+  Returns      : Number of cells changed
+
+  Modifies     : VegMap or the soil depth of SoilMap, the interception,
+                 snow, evapotranspiration arrays and cuts of the changed
+                 cells, their classes (ChangeCellClass()) and water table
+                 depth, and *Added, the water gained by the soil columns
+                 of the basin, summed over the cells (m)
+
+  Comments     : The caller rebuilds the lists of InitSurfaceRoute(), which
+                 depend on the impervious fraction of the vegetation
+*****************************************************************************/
+int ApplyMapEvent(MAPEVENT *Event, OPTIONSTRUCT *Options, MAPSIZE *Map,
+		  LAYER *Veg, LAYER *Soil, VEGTABLE *VType, SOILTABLE *SType,
+		  VEGPIX **VegMap, SOILPIX **SoilMap, SNOWPIX **SnowMap,
+		  PRECIPPIX **PrecipMap, EVAPPIX **EvapMap,
+		  ROADSTRUCT **Network, CELLCLASSES *Classes, float *Added)
+{
+  const char *Routine = "ApplyMapEvent";
+  ROADSTRUCT *LocalNetwork;
+  SOILPIX *LocalSoil;
+  VEGTABLE *NewType;
+  void **Rows;
+  float OldWater;		/* water of the cell before the event (m) */
+  float Depth;
+  int NChanged = 0;
+  int NSoil;
+  int Veg0;			/* vegetation type of a cell (0-based) */
+  int NewVeg;
+  int k;
+  int x;
+  int y;
+
+  if (!(Rows = (void **) calloc(Map->NY, sizeof(void *))))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < Map->NY; y++)
+    if (!(Rows[y] = calloc(Map->NX, sizeof(float) > sizeof(int) ?
+			   sizeof(float) : sizeof(int))))
+      ReportError((char *) Routine, 1);
+  ReadEventMap(Event, Map, Rows);
+
+  *Added = 0.0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    LocalSoil = &(SoilMap[y][x]);
+    LocalNetwork = &(Network[y][x]);
+    Veg0 = VegMap[y][x].Veg - 1;
+    NSoil = Soil->NLayers[LocalSoil->Soil - 1];
+    if (Event->Variable == MAPEVENT_VEGETATION) {
+      NewVeg = ((int *) Rows[y])[x];
+      Depth = LocalSoil->Depth;
+      if (NewVeg == VegMap[y][x].Veg)
+	continue;
+      if (NewVeg < 1 || NewVeg > Veg->NTypes)
+	ReportError(Event->FileName, 82);
+    }
+    else {
+      NewVeg = VegMap[y][x].Veg;
+      Depth = ((float *) Rows[y])[x];
+      if (Depth == LocalSoil->Depth)
+	continue;
+    }
+    NewType = &(VType[NewVeg - 1]);
+    if (NewType->NSoilLayers != NSoil || Depth <= NewType->TotalDepth) {
+      printf("Map event at (x, y) = (%d, %d): vegetation type %d, soil depth "
+	     "%f\n", x, y, NewVeg, Depth);
+      ReportError(Event->FileName, 91);
+    }
+
+    OldWater = CellStorage(NSoil, Veg->NLayers[Veg0], VType[Veg0].RootDepth,
+			 LocalSoil, &(SnowMap[y][x]), &(PrecipMap[y][x]),
+			 LocalNetwork);
+    if (Event->Variable == MAPEVENT_VEGETATION) {
+      ChangeVegetation(Options, Veg->NLayers[Veg0], Veg->NLayers[NewVeg - 1],
+		       NSoil, &(SnowMap[y][x]), LocalSoil, &(PrecipMap[y][x]),
+		       &(EvapMap[y][x]));
+      VegMap[y][x].Veg = NewVeg;
+      VegMap[y][x].Tcanopy = 0.0;
+    }
+    else
+      LocalSoil->Depth = Depth;
+
+    /* the cuts of the cell with its new root zones and soil depth, the
+       cells without a cut share the array of ones */
+    if (LocalNetwork->BankHeight > 0.0)
+      AdjustStorage(NSoil, LocalSoil->Depth, NewType->RootDepth,
+		    LocalNetwork->Area, Map->DX, Map->DY,
+		    LocalNetwork->BankHeight, LocalNetwork->PercArea,
+		    LocalNetwork->Adjust, &(LocalNetwork->CutBankZone));
+    ChangeCellClass(k, NewVeg - 1, LocalSoil->Soil - 1, VType, SType, Veg,
+		    Soil, LocalNetwork, Classes);
+    InitSoilCapacity(NSoil, LocalSoil->Depth, NewType->RootDepth,
+		     SType[LocalSoil->Soil - 1].Porosity,
+		     SType[LocalSoil->Soil - 1].FCap, LocalNetwork->Adjust,
+		     &(LocalNetwork->Capacity));
+
+    if ((LocalSoil->TableDepth =
+	 WaterTableDepth(NSoil, LocalSoil->Depth, NewType->RootDepth,
+			 SType[LocalSoil->Soil - 1].Porosity,
+			 SType[LocalSoil->Soil - 1].FCap, LocalNetwork->Adjust,
+			 LocalSoil->Moist, &(LocalNetwork->Capacity))) < 0.0)
+      LocalSoil->TableDepth = 0.0;
+
+    *Added += CellStorage(NSoil, Veg->NLayers[NewVeg - 1], NewType->RootDepth,
+			  LocalSoil, &(SnowMap[y][x]), &(PrecipMap[y][x]),
+			  LocalNetwork) - OldWater;
+    NChanged++;
+  }
+
+  for (y = 0; y < Map->NY; y++)
+    free(Rows[y]);
+  free(Rows);
+
+  return NChanged;
+}
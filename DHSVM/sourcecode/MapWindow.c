@@ -0,0 +1,199 @@
+/*
+ * SUMMARY:      MapWindow.c - Windowed and block reduced map dumps
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  A map dump can be limited to a rectangle of the model map
+ *               (MAP WINDOW) or to the cells of a mask (MAP MASK), and its
+ *               cells can be reduced to the mean or the maximum of blocks
+ *               of MAP BLOCK SIZE by MAP BLOCK SIZE cells.  The file of the
+ *               map then holds the smaller grid, with the coordinates of
+ *               the window and the spacing of the blocks.
+ * DESCRIP-END.
+ * FUNCTIONS:    ReadMapMask()
+ *               WindowMapSize()
+ *               WindowMap()
+ * COMMENTS:     The blocks start at the northwest corner of the window, the
+ *               last column and row of blocks can be partial.  The
+ *               coordinates of a block are those of its northwest corner,
+ *               like those of the model cells in CreateMapFile().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "fileio.h"
+#include "functions.h"
+#include "constants.h"
+#include "memaccount.h"
+#include "sizeofnt.h"
+#include "varid.h"
+
+/*****************************************************************************
+  Function name: ReadMapMask()
+
+  Purpose      : Read the MAP MASK of DMap and set the window of the map to
+                 the rectangle around the cells in it
+
+  Required     :
+    char *FileName - Mask file, a map of the basin mask type where the cells
+                     to write are not 0
+    MAPSIZE *Map   - Model map
+    MAPDUMP *DMap  - Map dump
+
+  Modifies     : DMap->WinX, WinY, WinNX, WinNY and WinMask
+*****************************************************************************/
+void ReadMapMask(char *FileName, MAPSIZE *Map, MAPDUMP *DMap)
+{
+  const char *Routine = "ReadMapMask";
+  char VarName[BUFSIZE + 1];
+  uchar **Mask;
+  int NumberType;
+  int x0 = Map->NX;
+  int x1 = -1;
+  int y0 = Map->NY;
+  int y1 = -1;
+  int x;
+  int y;
+
+  if (!(Mask = (uchar **) calloc(Map->NY, sizeof(uchar *))))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < Map->NY; y++)
+    if (!(Mask[y] = (uchar *) calloc(Map->NX, sizeof(uchar))))
+      ReportError((char *) Routine, 1);
+
+  GetVarName(002, 0, VarName);
+  GetVarNumberType(002, &NumberType);
+  Read2DField(FileName, NumberType, Map, 0, VarName, 0,
+	      MAP_VALUES(Mask, uchar, NC_BYTE));
+
+  for (y = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++)
+      if (Mask[y][x]) {
+	x0 = MIN(x0, x);
+	x1 = MAX(x1, x);
+	y0 = MIN(y0, y);
+	y1 = MAX(y1, y);
+      }
+  if (x1 < 0)
+    ReportError(FileName, 94);
+
+  DMap->WinX = x0;
+  DMap->WinY = y0;
+  DMap->WinNX = x1 - x0 + 1;
+  DMap->WinNY = y1 - y0 + 1;
+  if (!(DMap->WinMask = (uchar *) TaggedCalloc((size_t) DMap->WinNX *
+					       DMap->WinNY, sizeof(uchar),
+					       MEM_OUTPUT)))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < DMap->WinNY; y++)
+    for (x = 0; x < DMap->WinNX; x++)
+      DMap->WinMask[y * DMap->WinNX + x] = (Mask[y0 + y][x0 + x] != 0);
+
+  for (y = 0; y < Map->NY; y++)
+    free(Mask[y]);
+  free(Mask);
+}
+
+/*****************************************************************************
+  Function name: WindowMapSize()
+
+  Purpose      : Grid of the file of DMap
+
+  Required     :
+    MAPSIZE *Map  - Model map
+    MAPDUMP *DMap - Map dump
+    MAPSIZE *Out  - Grid of the file
+
+  Modifies     : Out, a copy of Map with the size, corner and spacing of the
+                 window and the blocks
+*****************************************************************************/
+void WindowMapSize(MAPSIZE *Map, MAPDUMP *DMap, MAPSIZE *Out)
+{
+  int Block = MAX(DMap->Block, 1);
+
+  *Out = *Map;
+  if (DMap->WinNX > 0) {
+    Out->Xorig = Map->Xorig + DMap->WinX * Map->DX;
+    Out->Yorig = Map->Yorig - DMap->WinY * Map->DY;
+    Out->NX = DMap->WinNX;
+    Out->NY = DMap->WinNY;
+  }
+  Out->NX = (Out->NX + Block - 1) / Block;
+  Out->NY = (Out->NY + Block - 1) / Block;
+  Out->DX = Map->DX * Block;
+  Out->DY = Map->DY * Block;
+  Out->DXY = Map->DXY * Block;
+}
+
+/*****************************************************************************
+  Function name: WindowMap()
+
+  Purpose      : Reduce a map extracted for DMap to the grid of its file
+
+  Required     :
+    MAPSIZE *Map      - Model map
+    MAPDUMP *DMap     - Map dump with a window or blocks
+    TOPOPIX **TopoMap - Basin mask
+    float *Array      - Map of Map->NY * Map->NX values
+
+  Modifies     : Array, of which the first values are the map of the grid
+                 of WindowMapSize()
+
+  Comments     : Cells outside the mask of the window are NA.  A block is
+                 the mean or the maximum of the cells in the basin and in
+                 the mask that are not NA, NA if there are none.  The map
+                 is reduced in place, each output value is written after
+                 the cells it is reduced from, which come at or after it in
+                 Array.
+*****************************************************************************/
+void WindowMap(MAPSIZE *Map, MAPDUMP *DMap, TOPOPIX **TopoMap, float *Array)
+{
+  MAPSIZE Out;
+  double Sum;
+  float Value;
+  int Block = MAX(DMap->Block, 1);
+  int X0 = (DMap->WinNX > 0) ? DMap->WinX : 0;
+  int Y0 = (DMap->WinNX > 0) ? DMap->WinY : 0;
+  int NWinX = (DMap->WinNX > 0) ? DMap->WinNX : Map->NX;
+  int NWinY = (DMap->WinNX > 0) ? DMap->WinNY : Map->NY;
+  int N;
+  int bx;
+  int by;
+  int x;
+  int y;
+
+  WindowMapSize(Map, DMap, &Out);
+
+  for (by = 0; by < Out.NY; by++) {
+    for (bx = 0; bx < Out.NX; bx++) {
+      Sum = 0.0;
+      N = 0;
+      for (y = by * Block; y < MIN((by + 1) * Block, NWinY); y++) {
+	for (x = bx * Block; x < MIN((bx + 1) * Block, NWinX); x++) {
+	  if (DMap->WinMask != NULL && !DMap->WinMask[y * NWinX + x])
+	    continue;
+	  Value = Array[(Y0 + y) * Map->NX + X0 + x];
+	  if (Block > 1 &&
+	      (Value == NA || !INBASIN(TopoMap[Y0 + y][X0 + x].Mask)))
+	    continue;
+	  if (N == 0 || DMap->BlockReducer == REDUCE_MEAN)
+	    Sum = (N == 0) ? Value : Sum + Value;
+	  else if (Value > Sum)
+	    Sum = Value;
+	  N++;
+	}
+      }
+      if (N == 0)
+	Array[by * Out.NX + bx] = NA;
+      else if (DMap->BlockReducer == REDUCE_MEAN)
+	Array[by * Out.NX + bx] = (float) (Sum / N);
+      else
+	Array[by * Out.NX + bx] = (float) Sum;
+    }
+  }
+}
@@ -10,6 +10,7 @@
  *               
  * DESCRIP-END.
  * FUNCTIONS:    MassBalance()
+ *               AccumulateMassBalance()
  * COMMENTS:
  * Modification made on 2012/12/31
  * $Id: MassBalance.c, v 4.0 Ning Exp $
@@ -23,6 +24,7 @@
 #include "functions.h"
 #include "constants.h"
 #include "Calendar.h"
+#include "rollover.h"
 
 /*****************************************************************************
   MassBalance()
@@ -35,6 +37,9 @@
 
   The aggregated values are set to zero in the function RestAggregate,
   which is executed at the beginning of each time step.
+
+  The fluxes of the line and of the mass balance error are those of the
+  time steps since the last line, see AccumulateMassBalance().
 *****************************************************************************/
 void MassBalance(DATE *Current, DATE *Start, FILES *Out, AGGREGATED *Total, WATERBALANCE *Mass)
 {
@@ -43,31 +48,25 @@ void MassBalance(DATE *Current, DATE *Start, FILES *Out, AGGREGATED *Total, WATE
   float Input;
   float MassError;		/* mass balance error m  */
 
+  /* the fluxes of this time step and those since the last line */
+  AccumulateMassBalance(Total, Mass);
+
   NewWaterStorage = Total->Soil.IExcess + Total->Road.IExcess + 
     Total->CanopyWater + Total->SoilWater +
     Total->Snow.Swq + Total->Soil.SatFlow + Total->Soil.DetentionStorage;
 
-  Output = Total->ChannelInt + Total->RoadInt + Total->Evap.ETot;
-  Input = Total->Precip.Precip + Total->Snow.VaporMassFlux +
-    Total->Snow.CanopyVaporMassFlux + Total->CulvertReturnFlow;
+  Output = Mass->IntervalChannelInt + Mass->IntervalRoadInt + Mass->IntervalET;
+  Input = Mass->IntervalPrecip + Mass->IntervalSnowVaporFlux +
+    Mass->IntervalCanopyVaporFlux + Mass->IntervalCulvertReturnFlow;
 
   MassError = (NewWaterStorage - Mass->OldWaterStorage) + Output -
-    Total->Precip.Precip - Total->Snow.VaporMassFlux -
-    Total->Snow.CanopyVaporMassFlux - Total->CulvertReturnFlow;
+    Mass->IntervalPrecip - Mass->IntervalSnowVaporFlux -
+    Mass->IntervalCanopyVaporFlux - Mass->IntervalCulvertReturnFlow;
 
   /* update */
   Mass->OldWaterStorage = NewWaterStorage;
-  Mass->CumPrecipIn += Total->Precip.Precip;
-  Mass->CumIExcess += Total->Soil.IExcess;
-  Mass->CumChannelInt += Total->ChannelInt;
-  Mass->CumRoadInt += Total->RoadInt;
-  Mass->CumET += Total->Evap.ETot;
-  Mass->CumSnowVaporFlux += Total->Snow.VaporMassFlux +
-    Total->Snow.CanopyVaporMassFlux;
-  Mass->CumCulvertReturnFlow += Total->CulvertReturnFlow;
-  Mass->CumCulvertToChannel += Total->CulvertToChannel;
   
-  if (IsEqualTime(Current, Start)) {
+  if (IsEqualTime(Current, Start) || IsRolloverStep(Current)) {
     fprintf(Out->FilePtr, "         Date        ");
     fprintf(Out->FilePtr, " Precip(m) ");
     fprintf(Out->FilePtr, " Snow(m) ");
@@ -85,10 +84,52 @@ void MassBalance(DATE *Current, DATE *Start, FILES *Out, AGGREGATED *Total, WATE
   PrintDate(Current, Out->FilePtr);
   fprintf(Out->FilePtr, " %g  %g  %g  %g  %g  %g  %g  %g  %g  %g \
       %g  %g  %g  %g  %g  %g  %g  %g %g  %g \n", 
-      Total->Precip.Precip, Total->Precip.SnowFall, Total->Soil.IExcess,
-      Total->Snow.Swq, Total->Snow.Melt, Total->Evap.ETot, 
-      Total->CanopyWater, Total->SoilWater, Total->Soil.SatFlow, Total->Snow.VaporMassFlux,
-	  Total->ChannelInt,  Total->RoadInt, Total->CulvertToChannel, 
+      Mass->IntervalPrecip, Mass->IntervalSnowFall, Total->Soil.IExcess,
+      Total->Snow.Swq, Total->Snow.Melt, Mass->IntervalET, 
+      Total->CanopyWater, Total->SoilWater, Total->Soil.SatFlow, Mass->IntervalSnowVaporFlux,
+	  Mass->IntervalChannelInt,  Mass->IntervalRoadInt, Mass->IntervalCulvertToChannel, 
       Total->Rad.BeamIn+Total->Rad.DiffuseIn, Total->Rad.PixelNetShort, 
       Total->Rad.NetShort[0], Total->Rad.NetShort[1], Total->NetRad, Total->Rad.Tair, MassError);
-}
\ No newline at end of file
+
+  /* start the next interval */
+  Mass->IntervalPrecip = 0.0;
+  Mass->IntervalSnowFall = 0.0;
+  Mass->IntervalET = 0.0;
+  Mass->IntervalSnowVaporFlux = 0.0;
+  Mass->IntervalCanopyVaporFlux = 0.0;
+  Mass->IntervalChannelInt = 0.0;
+  Mass->IntervalRoadInt = 0.0;
+  Mass->IntervalCulvertReturnFlow = 0.0;
+  Mass->IntervalCulvertToChannel = 0.0;
+}
+
+/*****************************************************************************
+  AccumulateMassBalance()
+
+  Add the basin fluxes of the time step to the sums over the run and to the
+  sums since the last line of MassBalance().  Called by MassBalance(), and 
+  on its own for the time steps between the full aggregations, after 
+  AggregateFluxes()
+*****************************************************************************/
+void AccumulateMassBalance(AGGREGATED *Total, WATERBALANCE *Mass)
+{
+  Mass->CumPrecipIn += Total->Precip.Precip;
+  Mass->CumIExcess += Total->Soil.IExcess;
+  Mass->CumChannelInt += Total->ChannelInt;
+  Mass->CumRoadInt += Total->RoadInt;
+  Mass->CumET += Total->Evap.ETot;
+  Mass->CumSnowVaporFlux += Total->Snow.VaporMassFlux +
+    Total->Snow.CanopyVaporMassFlux;
+  Mass->CumCulvertReturnFlow += Total->CulvertReturnFlow;
+  Mass->CumCulvertToChannel += Total->CulvertToChannel;
+
+  Mass->IntervalPrecip += Total->Precip.Precip;
+  Mass->IntervalSnowFall += Total->Precip.SnowFall;
+  Mass->IntervalET += Total->Evap.ETot;
+  Mass->IntervalSnowVaporFlux += Total->Snow.VaporMassFlux;
+  Mass->IntervalCanopyVaporFlux += Total->Snow.CanopyVaporMassFlux;
+  Mass->IntervalChannelInt += Total->ChannelInt;
+  Mass->IntervalRoadInt += Total->RoadInt;
+  Mass->IntervalCulvertReturnFlow += Total->CulvertReturnFlow;
+  Mass->IntervalCulvertToChannel += Total->CulvertToChannel;
+}
@@ -8,8 +8,17 @@
  * ORIG-DATE:    Apr-96
  * DESCRIPTION:  Calculate mass and energy balance at each pixel
  * DESCRIP-END.
- * FUNCTIONS:    MassEnergyBalance()
- * COMMENTS:
+ * FUNCTIONS:    QuiescentCell()
+ *               MassEnergyBalanceCell()
+ *               MassEnergyBalance()
+ *               SelectMassEnergyBalance()
+ * COMMENTS:     MassEnergyBalanceCell() is compiled once for each
+ *               combination of the heat flux, infiltration, improved
+ *               radiation and network options (MEB_VARIANT), and for SNOW
+ *               ONLY, with the options as constants, so that the branches
+ *               on them are removed.  SelectMassEnergyBalance() picks the variant of
+ *               the run once, MassEnergyBalance() reads the options for
+ *               each call
  * $Id: MassEnergyBalance.c,v3.1.2 2013/08/18 ning Exp $
  */
 #ifdef SNOW_ONLY
@@ -29,9 +38,58 @@
 #include "constants.h"
 #include "soilmoisture.h"
 #include "Calendar.h"
+#include "messagelog.h"
+#include "fastmath.h"
+
+ /* networks of the variants: no channels or roads, channels and roads, and
+    channels and roads with the RBM energy fluxes (STREAM TEMPERATURE) */
+#define MEB_NONETWORK  0
+#define MEB_NETWORK    1
+#define MEB_STREAMTEMP 2
+
+/*****************************************************************************
+  Function name: QuiescentCell()
+
+  Purpose      : Decide whether the cell can take the quiescent fast path of
+                 MassEnergyBalanceCell()
+
+  Returns      : int, TRUE if there is no rain, snow, snow pack, ponded
+                 water or drainage in the cell this time step
+
+  Comments     : Called after DistributeSatflow(), with the moisture of the
+                 time step.  The evapotranspiration only dries the soil, so
+                 the root layers stay at or below field capacity and the
+                 infiltration and percolation in UnsaturatedFlow() do
+                 nothing
+*****************************************************************************/
+static int QuiescentCell(PRECIPPIX *LocalPrecip, SNOWPIX *LocalSnow,
+  SOILPIX *LocalSoil, ROADSTRUCT *LocalNetwork, VEGTABLE *VType,
+  SOILTABLE *SType)
+{
+  int i;
+
+  if (LocalPrecip->RainFall > 0.0 || LocalPrecip->SnowFall > 0.0 ||
+      LocalPrecip->IntSnow[0] > 0.0)
+    return FALSE;
+  if (LocalSnow->HasSnow || LocalSnow->Swq > 0.0 || VType->Index == GLACIER)
+    return FALSE;
+  if (LocalSoil->IExcess > 0.0 || LocalNetwork->IExcess > 0.0)
+    return FALSE;
+  for (i = 0; i < SType->NLayers; i++)
+    if (LocalSoil->Moist[i] > SType->FCap[i])
+      return FALSE;
+  return TRUE;
+}
+
+/* the body is copied into each variant, where the options are constants */
+#if defined(__GNUC__)
+#define MEB_INLINE static inline __attribute__((always_inline))
+#else
+#define MEB_INLINE static inline
+#endif
 
  /*****************************************************************************
-   Function name: MassEnergyBalance()
+   Function name: MassEnergyBalanceCell()
 
    Purpose      : Calculate mass and energy balance
 
@@ -41,7 +99,35 @@
 
    Modifies     :
 
-   Comments     :
+   Comments     : ImprovRadiation, Network (MEB_NONETWORK, MEB_NETWORK or
+                  MEB_STREAMTEMP) and SnowOnly stand for
+                  Options->ImprovRadiation, Options->HasNetwork,
+                  Options->StreamTemp and Options->SnowOnly.  With SnowOnly
+                  the soil water and the evapotranspiration are left out.
+                  If ChannelAccum is not NULL, the lateral inflow to the
+                  channel segments is added to that accumulator (slots
+                  of the cell) instead of directly to the network, so
+                  that pixels can be processed concurrently.  The RBM
+                  energy terms always go to the row of the cell in
+                  ChannelData->stream_cross.  With
+                  TotalRad NULL the radiation balance of the cell is only
+                  kept in LocalRad and is summed over the basin by
+                  Aggregate().
+                  With QUIESCENT CELLS, the cells of QuiescentCell() skip
+                  the infiltration and drainage, which do nothing for
+                  them.  RELAXED also sets
+                  the transpiration of dry vegetation to zero at night.
+                  With Column not NULL (SOIL COLUMN BATCH), the pixel loop
+                  has done DistributeSatflow() in DistributeSatflowBatch(),
+                  and without the heat flux UnsaturatedFlow() is left to
+                  UnsaturatedFlowBatch(), as nothing after it depends on
+                  the soil moisture.
+                  With DONE_RADIATION in BatchDone (RADIATION BATCH), the
+                  pixel loop has done RadiationBalance() in
+                  RadiationBalanceBatch(), with DONE_INTERCEPTION
+                  (INTERCEPTION BATCH) the rainfall momentum and the rain
+                  interception of the cells without snow on the canopy
+                  in InterceptionBatch().
 
    Reference    :
      Epema, G.F. and H.T. Riezbos, 1983, Fall Velocity of waterdrops at different
@@ -52,7 +138,7 @@
  Trans. Am. Geophys. Union, 24: 452-460.
 
  *****************************************************************************/
-void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
+MEB_INLINE void MassEnergyBalanceCell(OPTIONSTRUCT *Options, int y, int x,
   float SineSolarAltitude, float DX, float DY,
   int Dt, int HeatFluxOption, int CanopyRadAttOption,
   int InfiltOption, int MaxVegLayers, PIXMET *LocalMet,
@@ -60,7 +146,8 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
   VEGTABLE *VType, VEGPIX *LocalVeg, SOILTABLE *SType,
   SOILPIX *LocalSoil, SNOWPIX *LocalSnow, PIXRAD *LocalRad,
   EVAPPIX *LocalEvap, PIXRAD *TotalRad, CHANNEL *ChannelData, 
-  float **skyview)
+  float skyview, ChannelGridAccum *ChannelAccum, SOILCOLUMN *Column,
+  int BatchDone, int ImprovRadiation, int Network, int SnowOnly)
 {
   float SurfaceWater;		/* Pixel average depth of water before infiltration is calculated (m) */
   float RoadWater;          /* Average depth of water on the road surface
@@ -92,24 +179,14 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
   float SnowRa;				/* Aerodynamic resistance for snow */
   float SnowWind;		    /* Wind 2 m above snow */
   float Tsurf;				/* Surface temperature used in LongwaveBalance (C) */
-  float RainfallIntensity;  /* Rainfall intensity (mm/h) */
   float MS_Rainfall;        /* Momentum squared for rain throughfall((kg* m/s)^2 /(m^2 * s)) */
-  int   MS_Index;           /* Index for determining alpha and beta cooresponding to RainfallIntensity*/
   int   NVegLActual;		/* Number of vegetation layers above snow */
-  float alpha[4] = { 2.69e-8,3.75e-8,6.12e-8,11.75e-8 }; /* empirical coefficient
-                for rainfall momentum after Wicks and Bathurst (1996) */
-  float beta[4] = { 1.6896,1.5545,1.4242,1.2821 };       /* empirical coefficient
-                for rainfall momentum after Wicks and Bathurst (1996) */
+  int   SnowCanopy;         /* TRUE if the overstory intercepts snow */
   int i;
-  float CanopyHeight[18] = { 0.5,1,1.5,2,3,4,5,6,7,8,9,10,11,12, 13,14,15,16 };        
-                      /* Canopy height at which drip fall
-                      velocity is prescribed after Epema and Riezebos (1983) (m)*/
-  float FallVelocity[18] = { 2.96,4.12,5.12,5.82,6.84,7.54,8.05,8.36,
-                8.54,8.66,8.75,8.82,8.87,8.91,8.96,9.02,9.07,9.13 };
-  /* Drip fall velocity corresponding to
-  CanopyHeight after Epema and Riezebos (1983) (m/s)*/
-  float LD_FallVelocity;             /* Leaf drip fall velocity corresponding to the
-                                     canopy height in vegetation map (m/s) */
+  int Quiet;                /* QUIET_NONE, or the level of the fast path of
+                               a quiescent cell */
+  int Dormant;              /* TRUE if the dry vegetation does not
+                               transpire (QUIET_RELAXED at night) */
 
   /* Calculate the number of vegetation layers above the snow */
   NVegLActual = VType->NVegLayers;
@@ -124,20 +201,31 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
   /* Edited by Zhuoran Duan zhuoran.duan@pnnl.gov 06/21/2006*/
   /*Add a function to modify soil moisture by distributing SatFlow 
   from previous time step*/
-  DistributeSatflow(Dt, DX, DY, LocalSoil->SatFlow, SType->NLayers,
-		  LocalSoil->Depth, LocalNetwork->Area, VType->RootDepth,
-		  SType->Ks, SType->PoreDist, SType->Porosity, SType->FCap,
-		  LocalSoil->Perc, LocalNetwork->PercArea,
-		  LocalNetwork->Adjust, LocalNetwork->CutBankZone,
-		  LocalNetwork->BankHeight, &(LocalSoil->TableDepth),
-		  &(LocalSoil->IExcess), LocalSoil->Moist, InfiltOption);
+  if (Column == NULL && !SnowOnly)
+    DistributeSatflow(Dt, DX, DY, LocalSoil->SatFlow, SType->NLayers,
+		      LocalSoil->Depth, LocalNetwork->Area, VType->RootDepth,
+		      SType->Ks, SType->PoreDist, SType->Porosity, SType->FCap,
+		      LocalSoil->Perc, LocalNetwork->PercArea,
+		      LocalNetwork->Adjust, LocalNetwork->CutBankZone,
+		      LocalNetwork->BankHeight, &(LocalSoil->TableDepth),
+		      &(LocalSoil->IExcess), LocalSoil->Moist, InfiltOption);
+
+  Quiet = QUIET_NONE;
+  if (Options->QuietCells != QUIET_NONE &&
+      QuiescentCell(LocalPrecip, LocalSnow, LocalSoil, LocalNetwork, VType,
+                    SType)) {
+    Quiet = Options->QuietCells;
+    LocalSoil->CostQuietSteps++;
+  }
+  Dormant = (Quiet == QUIET_RELAXED && LocalMet->Sin <= 0.0);
 
   /* calculate the radiation balance for the ground/snow surface and the
      vegetation layers above that surface */
-  RadiationBalance(Options, HeatFluxOption, CanopyRadAttOption, SineSolarAltitude,
-    LocalMet->VICSin, LocalMet->Sin, LocalMet->SinBeam, LocalMet->SinDiffuse,
-    LocalMet->Lin, LocalMet->Tair, LocalVeg->Tcanopy,
-    LocalSoil->TSurf, SType->Albedo, VType, LocalSnow, LocalRad);
+  if (!(BatchDone & DONE_RADIATION))
+    RadiationBalance(Options, HeatFluxOption, CanopyRadAttOption,
+      SineSolarAltitude, LocalMet->VICSin, LocalMet->Sin, LocalMet->SinBeam,
+      LocalMet->SinDiffuse, LocalMet->Lin, LocalMet->Tair, LocalVeg->Tcanopy,
+      LocalSoil->TSurf, SType->Albedo, VType, LocalSnow, LocalRad);
 
   /* calculate the actual aerodynamic resistances and wind speeds */
   UpperWind = VType->U[0] * LocalMet->Wind;
@@ -151,118 +239,64 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
     LowerRa = UpperRa;
   }
 
-  /* Leaf drip impact*/
-  /* Find corresponding fall velocity for overstory and understory heights
-     by weighting scheme */
-  if (VType->OverStory) {
-    /* starting at 1 assumes the overstory height > 0.5 m */
-    for (i = 1; i <= 17; i++) {
-      if (VType->Height[0] < CanopyHeight[i]) {
-        LD_FallVelocity = ((VType->Height[0] - CanopyHeight[i - 1])
-          *FallVelocity[i] +
-          (CanopyHeight[i] - VType->Height[0])*FallVelocity[i - 1]) /
-          (CanopyHeight[i] - CanopyHeight[i - 1]);
-      }
+  /* RainFall impact and the amount of interception storage, and the
+     amount of throughfall. Of course the interception only needs to be done
+     if there is vegetation present.  With INTERCEPTION BATCH the pixel loop
+     has done both for the cells without snow on the canopy */
+  SnowCanopy = SnowOnCanopy(VType, LocalPrecip);
+  if (!(BatchDone & DONE_INTERCEPTION) || SnowCanopy) {
+    MS_Rainfall = RainfallMomentum(LocalPrecip->RainFall, Dt,
+				   &(LocalPrecip->Dm));
+    if (SnowCanopy) {
+      SnowInterception(Options, y, x, Dt, VType->Fract[0], VType->Vf,
+        VType->LAI[0], VType->MaxInt[0], VType->MaxSnowInt, VType->MDRatio,
+        VType->SnowIntEff, UpperRa, LocalMet->AirDens,
+        LocalMet->Eact, LocalMet->Lv, LocalRad, LocalMet->Press,
+        LocalMet->Tair, LocalMet->Vpd, UpperWind,
+        &(LocalPrecip->RainFall), &(LocalPrecip->SnowFall),
+        &(LocalPrecip->IntRain[0]), &(LocalPrecip->IntSnow[0]),
+        &(LocalPrecip->TempIntStorage),
+        &(LocalSnow->CanopyVaporMassFlux), &(LocalVeg->Tcanopy),
+        &MeltEnergy, &(LocalPrecip->MomentSq), VType->Height,
+        VType->UnderStory, MS_Rainfall, VType->LD_MomentSq);
+
+      MoistureFlux -= LocalSnow->CanopyVaporMassFlux;
+
+      /* Because we now have a new estimate of the canopy temperature we can
+         recalculate the longwave balance */
+      if (LocalSnow->HasSnow == TRUE)
+        Tsurf = LocalSnow->TSurf;
+      else if (HeatFluxOption == TRUE)
+        Tsurf = LocalSoil->TSurf;
+      else
+        Tsurf = LocalMet->Tair;
+      LongwaveBalance(Options, VType->OverStory, VType->Fract[0], VType->Vf, 
+        LocalMet->Lin, LocalVeg->Tcanopy, Tsurf, LocalRad);
     }
-    if (VType->UnderStory) {
-      /* ending at 16 assumes the understory height < 16 m */
-      for (i = 0; i <= 16; i++) {
-        if (VType->Height[1] < CanopyHeight[i]) {
-          LD_FallVelocity = ((VType->Height[1] - CanopyHeight[i])*FallVelocity[i] +
-            (CanopyHeight[i + 1] - VType->Height[1])*FallVelocity[i - 1]) /
-            (CanopyHeight[i + 1] - CanopyHeight[i]);
-        }
-      }
+    else if (VType->NVegLayers > 0) {
+      LocalVeg->Tcanopy = LocalMet->Tair;
+      LocalSnow->CanopyVaporMassFlux = 0.0;
+      LocalPrecip->TempIntStorage = 0.0;
+      InterceptionStorage(VType->NVegLayers, NVegLActual, VType->MaxInt,
+        VType->Fract, LocalPrecip->IntRain,
+        &(LocalPrecip->RainFall), &(LocalPrecip->MomentSq),
+        VType->Height, VType->UnderStory, Dt, MS_Rainfall,
+        VType->LD_MomentSq);
     }
-  }
-  else if (VType->UnderStory) {
-    /* ending at 16 assumes the understory height < 16 m */
-    for (i = 0; i <= 16; i++) {
-      if (VType->Height[0] < CanopyHeight[i]) {
-        LD_FallVelocity = ((VType->Height[0] - CanopyHeight[i])*FallVelocity[i] +
-          (CanopyHeight[i + 1] - VType->Height[0])*FallVelocity[i - 1]) /
-          (CanopyHeight[i + 1] - CanopyHeight[i]);
-      }
+    else {/* If no vegetation, kinetic energy is all due to direct precipitation. */   
+      if (LocalPrecip->RainFall > 0.0)
+        LocalPrecip->MomentSq = MS_Rainfall;
     }
   }
-  else LD_FallVelocity = 0;
-
-  /* RainFall impact */
-  /* 3600 is conversion factor (number of seconds per hour) */
-  if (LocalPrecip->RainFall > 0.) {
-    RainfallIntensity = LocalPrecip->RainFall * (1. / MMTOM) * (3600. / Dt);
-
-    /* Momentum is later weighted with the overstory/understory fraction */
-    if (RainfallIntensity < 10.)
-      MS_Index = 0;
-    else if (RainfallIntensity >= 10. && RainfallIntensity < 100.)
-      MS_Index = floor((RainfallIntensity + 49) / 50);
-    else
-      MS_Index = 3;
-
-    /* Eq. 1, Wicks and Bathurst (1996) */
-    MS_Rainfall = alpha[MS_Index] * pow(RainfallIntensity, beta[MS_Index]);
-
-    /* Calculating mediam raindrop diameter after Laws and Parsons (1943) */
-    LocalPrecip->Dm = 0.00124 * pow((double)RainfallIntensity, 0.182);
-  }
-  else {
-    MS_Rainfall = 0;
-    LocalPrecip->Dm = LEAF_DRIP_DIA;
-  }
 
-  /* calculate the amount of interception storage, and the amount of
-     throughfall. Of course this only needs to be done if there is
-     vegetation present. */
 #ifndef NO_SNOW
-  if (VType->OverStory == TRUE &&
-    (LocalPrecip->IntSnow[0] || LocalPrecip->SnowFall > 0.0)) {
-    SnowInterception(Options, y, x, Dt, VType->Fract[0], VType->Vf,
-      VType->LAI[0], VType->MaxInt[0], VType->MaxSnowInt, VType->MDRatio,
-      VType->SnowIntEff, UpperRa, LocalMet->AirDens,
-      LocalMet->Eact, LocalMet->Lv, LocalRad, LocalMet->Press,
-      LocalMet->Tair, LocalMet->Vpd, UpperWind,
-      &(LocalPrecip->RainFall), &(LocalPrecip->SnowFall),
-      &(LocalPrecip->IntRain[0]), &(LocalPrecip->IntSnow[0]),
-      &(LocalPrecip->TempIntStorage),
-      &(LocalSnow->CanopyVaporMassFlux), &(LocalVeg->Tcanopy),
-      &MeltEnergy, &(LocalPrecip->MomentSq), VType->Height,
-      VType->UnderStory, MS_Rainfall, LD_FallVelocity);
-
-    MoistureFlux -= LocalSnow->CanopyVaporMassFlux;
-
-    /* Because we now have a new estimate of the canopy temperature we can
-       recalculate the longwave balance */
-    if (LocalSnow->HasSnow == TRUE)
-      Tsurf = LocalSnow->TSurf;
-    else if (HeatFluxOption == TRUE)
-      Tsurf = LocalSoil->TSurf;
-    else
-      Tsurf = LocalMet->Tair;
-    LongwaveBalance(Options, VType->OverStory, VType->Fract[0], VType->Vf, 
-      LocalMet->Lin, LocalVeg->Tcanopy, Tsurf, LocalRad);
-  }
-  else if (VType->NVegLayers > 0) {
-    LocalVeg->Tcanopy = LocalMet->Tair;
-    LocalSnow->CanopyVaporMassFlux = 0.0;
-    LocalPrecip->TempIntStorage = 0.0;
-    InterceptionStorage(VType->NVegLayers, NVegLActual, VType->MaxInt,
-      VType->Fract, LocalPrecip->IntRain,
-      &(LocalPrecip->RainFall), &(LocalPrecip->MomentSq),
-      VType->Height, VType->UnderStory, Dt, MS_Rainfall,
-      LD_FallVelocity);
-  }
-  else {/* If no vegetation, kinetic energy is all due to direct precipitation. */   
-    if (LocalPrecip->RainFall > 0.0)
-      LocalPrecip->MomentSq = MS_Rainfall;
-  }
-
   /* If snow on the ground, assume no overland flow erosion. */
   if (LocalSnow->HasSnow)
     LocalPrecip->MomentSq = 0.0;
 
   /* if snow is present, simulate the snow pack dynamics */
   if (LocalSnow->HasSnow || LocalPrecip->SnowFall > 0.0) {
+    LocalSoil->CostSnowSteps++;
     if (VType->OverStory == TRUE) {
       SnowLongIn = LocalRad->LongIn[1];
       SnowNetShort = LocalRad->NetShort[1];
@@ -282,7 +316,8 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
         LocalMet->Tair, LocalMet->Vpd, SnowWind,
         &(LocalSnow->PackWater), &(LocalSnow->SurfWater),
         &(LocalSnow->Swq), &(LocalSnow->VaporMassFlux),
-        &(LocalSnow->TPack), &(LocalSnow->TSurf), &MeltEnergy);
+        &(LocalSnow->TPack), &(LocalSnow->TSurf), &MeltEnergy,
+        Options->TSurfSolver, &(LocalSnow->TSurfIter));
 
     /* Rainfall was added to SurfWater of the snow pack and has to be set to zero */
     LocalPrecip->RainFall = 0.0;
@@ -297,6 +332,7 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
   else {
     LocalSnow->Outflow = 0.0;
     LocalSnow->VaporMassFlux = 0.0;
+    LocalSnow->TSurfIter = 0;
   }
 
   /* Determine whether a snow pack is still present, or whether everything
@@ -308,7 +344,8 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
 
   /*do the glacier add */
   if (LocalSnow->Swq < 1.0 && VType->Index == GLACIER) {
-    printf("resetting glacier swe of %f to 5.0 meters\n", LocalSnow->Swq);
+    LogMessage(MSG_NOTE, "resetting glacier swe of %f to 5.0 meters\n",
+	       LocalSnow->Swq);
     LocalSnow->Glacier += (5.0 - LocalSnow->Swq);
     LocalSnow->Swq = 5.0;
     LocalSnow->TPack = 0.0;
@@ -316,22 +353,33 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
   }
 #endif
 
+  /* with SNOW ONLY the snow pack is all there is */
+  if (SnowOnly) {
+    LocalSoil->CostSnowEval += LocalSnow->TSurfIter;
+    if (TotalRad != NULL)
+      AggregateRadiation(MaxVegLayers, VType->NVegLayers, LocalRad, TotalRad);
+    return;
+  }
+
 #ifndef NO_ET
   /* calculate the amount of evapotranspiration from each vegetation layer
      above the ground/soil surface.  Also calculate the total amount of
      evapotranspiration from the vegetation */
   if (VType->OverStory == TRUE) {
     Rp = VISFRACT * LocalRad->NetShort[0];
-    if (Options->ImprovRadiation)
+    if (ImprovRadiation)
       NetRadiation = LocalRad->NetShort[0] +
       LocalRad->LongIn[0] - 2 * VType->Vf * LocalRad->LongOut[0];
     else
       NetRadiation = LocalRad->NetShort[0] +
       LocalRad->LongIn[0] - 2 * VType->Fract[0] * LocalRad->LongOut[0];
     LocalRad->NetRadiation[0] = NetRadiation;
-    EvapoTranspiration(0, Options->ImprovRadiation, Dt, LocalMet, NetRadiation, 
-      Rp, VType, SType, MoistureFlux, LocalSoil, &(LocalPrecip->IntRain[0]),
-      LocalEvap, LocalNetwork->Adjust, UpperRa);
+    if (Dormant && LocalPrecip->IntRain[0] <= 0.0)
+      NoTranspiration(0, VType->NSoilLayers, LocalEvap);
+    else
+      EvapoTranspiration(0, ImprovRadiation, Dt, LocalMet, NetRadiation, 
+        Rp, VType, SType, MoistureFlux, LocalSoil, &(LocalPrecip->IntRain[0]),
+        LocalEvap, LocalNetwork->Adjust, UpperRa);
     MoistureFlux += LocalEvap->EAct[0] + LocalEvap->EInt[0];
 
     if (LocalSnow->HasSnow != TRUE && VType->UnderStory == TRUE) {
@@ -340,9 +388,12 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
         LocalRad->NetShort[1] +
         LocalRad->LongIn[1] - VType->Fract[1] * LocalRad->LongOut[1];
       LocalRad->NetRadiation[1] = NetRadiation;
-      EvapoTranspiration(1, Options->ImprovRadiation, Dt, LocalMet, NetRadiation, 
-        Rp, VType, SType, MoistureFlux, LocalSoil, &(LocalPrecip->IntRain[1]),
-        LocalEvap, LocalNetwork->Adjust, LowerRa);
+      if (Dormant && LocalPrecip->IntRain[1] <= 0.0)
+        NoTranspiration(1, VType->NSoilLayers, LocalEvap);
+      else
+        EvapoTranspiration(1, ImprovRadiation, Dt, LocalMet, NetRadiation, 
+          Rp, VType, SType, MoistureFlux, LocalSoil, &(LocalPrecip->IntRain[1]),
+          LocalEvap, LocalNetwork->Adjust, LowerRa);
       MoistureFlux += LocalEvap->EAct[1] + LocalEvap->EInt[1];
     }
     else if (VType->UnderStory == TRUE) {
@@ -356,9 +407,12 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
     NetRadiation =
       LocalRad->NetShort[0] +
       LocalRad->LongIn[0] - VType->Fract[0] * LocalRad->LongOut[0];
-    EvapoTranspiration(0, Options->ImprovRadiation, Dt, LocalMet, NetRadiation, 
-      Rp, VType, SType, MoistureFlux, LocalSoil, &(LocalPrecip->IntRain[0]),
-      LocalEvap, LocalNetwork->Adjust, LowerRa);
+    if (Dormant && LocalPrecip->IntRain[0] <= 0.0)
+      NoTranspiration(0, VType->NSoilLayers, LocalEvap);
+    else
+      EvapoTranspiration(0, ImprovRadiation, Dt, LocalMet, NetRadiation, 
+        Rp, VType, SType, MoistureFlux, LocalSoil, &(LocalPrecip->IntRain[0]),
+        LocalEvap, LocalNetwork->Adjust, LowerRa);
     MoistureFlux += LocalEvap->EAct[0] + LocalEvap->EInt[0];
     LocalRad->NetRadiation[0] = NetRadiation;
     LocalRad->NetRadiation[1] = 0.;
@@ -410,106 +464,139 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
      that some cells have roads and streams) needs to remain the same.
      Currently, the old PercArea is passed to UnsaturatedFlow */
 
-  MaxRoadbedInfiltration = 0.;
-  MaxInfiltration = 0.;
-  ChannelWater = 0.;
-  RoadWater = 0.;
-  SurfaceWater = 0.;
-  PercArea = 1.;
-  RoadbedInfiltration = 0.;
-
-  /* ChannelWater is precipitation falling on the channel */
-  /* (if there is no road, LocalNetwork->RoadArea = 0) */
-  if (channel_grid_has_channel(ChannelData->stream_map, x, y)) {
-    PercArea = 1. - (LocalNetwork->Area + LocalNetwork->RoadArea) / (DX*DY);
-    ChannelWater = LocalNetwork->Area / (DX*DY) * LocalPrecip->RainFall;
-  }
-  /* If there is a road and no channel, the PercArea is
-     based on the road only */
-  else if (channel_grid_has_channel(ChannelData->road_map, x, y)) {
-    PercArea = 1. - (LocalNetwork->RoadArea) / (DX*DY);
-    MaxRoadbedInfiltration = (1. - PercArea) *
-      LocalNetwork->MaxInfiltrationRate * Dt;
+  if (Quiet != QUIET_NONE) {
+    /* no water to infiltrate and no drainage, only the water table follows
+       the evapotranspiration */
+    for (i = 0; i < SType->NLayers; i++)
+      LocalSoil->Perc[i] = 0.0;
+    LocalSoil->TableDepth = WaterTableDepth(SType->NLayers, LocalSoil->Depth,
+      VType->RootDepth, SType->Porosity, SType->FCap, LocalNetwork->Adjust,
+      LocalSoil->Moist, &(LocalNetwork->Capacity));
+    if (LocalSoil->TableDepth < 0.0) {
+      LocalSoil->IExcess += -(LocalSoil->TableDepth);
+      LocalSoil->TableDepth = 0.0;
+    }
+    if (InfiltOption == DYNAMIC)
+      LocalPrecip->PrecipStart = TRUE;
   }
+  else {
+    MaxRoadbedInfiltration = 0.;
+    MaxInfiltration = 0.;
+    ChannelWater = 0.;
+    RoadWater = 0.;
+    SurfaceWater = 0.;
+    PercArea = 1.;
+    RoadbedInfiltration = 0.;
+
+    /* ChannelWater is precipitation falling on the channel */
+    /* (if there is no road, LocalNetwork->RoadArea = 0) */
+    if (Network != MEB_NONETWORK &&
+        channel_grid_has_channel(ChannelData->stream_map, x, y)) {
+      PercArea = 1. - (LocalNetwork->Area + LocalNetwork->RoadArea) / (DX*DY);
+      ChannelWater = LocalNetwork->Area / (DX*DY) * LocalPrecip->RainFall;
+    }
+    /* If there is a road and no channel, the PercArea is
+       based on the road only */
+    else if (Network != MEB_NONETWORK &&
+             channel_grid_has_channel(ChannelData->road_map, x, y)) {
+      PercArea = 1. - (LocalNetwork->RoadArea) / (DX*DY);
+      MaxRoadbedInfiltration = (1. - PercArea) *
+        LocalNetwork->MaxInfiltrationRate * Dt;
+    }
 
-  /* SurfaceWater is rain falling on the hillslope +
-     snowmelt on the hillslope (there is no snowmelt on the channel) +
-     existing IExcess */
-  SurfaceWater = (PercArea * LocalPrecip->RainFall) +
-    ((1. - (LocalNetwork->RoadArea) / (DX*DY)) * LocalSnow->Outflow) +
-    LocalSoil->IExcess;
-
-  /* RoadWater is rain falling on the road surface +
-     snowmelt on the road surface + existing Road IExcess
-     (Existing road IExcess = 0). WORK IN PROGRESS*/
-  RoadWater = (LocalNetwork->RoadArea / (DX*DY) *
-    (LocalPrecip->RainFall + LocalSnow->Outflow)) + LocalNetwork->IExcess;
-
-  if (InfiltOption == STATIC)
-    MaxInfiltration = (1. - VType->ImpervFrac) * PercArea * SType->MaxInfiltrationRate * Dt;
-  else { /* InfiltOption == DYNAMIC
-        Dynamic Infiltration Capacity after Parlange and Smith 1978,
-        as used in KINEROS and THALES */
-    Infiltration = 0.0;
-    if (SurfaceWater > 0.) {
-      /* Infiltration is a function of the amount of water infiltrated since
-     the storm started */
-      if (LocalPrecip->PrecipStart) {
-        LocalSoil->MoistInit = LocalSoil->Moist[0];
-        LocalSoil->InfiltAcc = 0.0;
-      }
-      /* Check that the B parameter > 0 */
-      if ((LocalSoil->InfiltAcc > 0.) && (SType->Porosity[0] > LocalSoil->MoistInit)) {
-        B = (SType->Porosity[0] - LocalSoil->MoistInit) * (SType->G_Infilt + SurfaceWater);
-          Infiltrability = SType->Ks[0] * exp((LocalSoil->InfiltAcc) / B) /
-          (exp((LocalSoil->InfiltAcc) / B) - 1.);
-      }
-      else
-        Infiltrability = SurfaceWater / Dt;
-
-      MaxInfiltration = Infiltrability * PercArea * (1. - VType->ImpervFrac) * Dt;
-      LocalPrecip->PrecipStart = FALSE;
-    }/* end  if (SurfaceWater > 0.) */
-    else
-      LocalPrecip->PrecipStart = TRUE;
+    /* SurfaceWater is rain falling on the hillslope +
+       snowmelt on the hillslope (there is no snowmelt on the channel) +
+       existing IExcess */
+    SurfaceWater = (PercArea * LocalPrecip->RainFall) +
+      ((1. - (LocalNetwork->RoadArea) / (DX*DY)) * LocalSnow->Outflow) +
+      LocalSoil->IExcess;
+
+    /* RoadWater is rain falling on the road surface +
+       snowmelt on the road surface + existing Road IExcess
+       (Existing road IExcess = 0). WORK IN PROGRESS*/
+    RoadWater = (LocalNetwork->RoadArea / (DX*DY) *
+      (LocalPrecip->RainFall + LocalSnow->Outflow)) + LocalNetwork->IExcess;
+
+    if (InfiltOption == STATIC)
+      MaxInfiltration = (1. - VType->ImpervFrac) * PercArea * SType->MaxInfiltrationRate * Dt;
+    else { /* InfiltOption == DYNAMIC
+          Dynamic Infiltration Capacity after Parlange and Smith 1978,
+          as used in KINEROS and THALES */
+      Infiltration = 0.0;
+      if (SurfaceWater > 0.) {
+        /* Infiltration is a function of the amount of water infiltrated since
+       the storm started */
+        if (LocalPrecip->PrecipStart) {
+          LocalSoil->MoistInit = LocalSoil->Moist[0];
+          LocalSoil->InfiltAcc = 0.0;
+        }
+        /* Check that the B parameter > 0 */
+        if ((LocalSoil->InfiltAcc > 0.) && (SType->Porosity[0] > LocalSoil->MoistInit)) {
+          B = (SType->Porosity[0] - LocalSoil->MoistInit) * (SType->G_Infilt + SurfaceWater);
+            Infiltrability = SType->Ks[0] * MathExp((LocalSoil->InfiltAcc) / B) /
+            (MathExp((LocalSoil->InfiltAcc) / B) - 1.);
+        }
+        else
+          Infiltrability = SurfaceWater / Dt;
 
-  } /* end Dynamic MaxInfiltration calculation */
+        MaxInfiltration = Infiltrability * PercArea * (1. - VType->ImpervFrac) * Dt;
+        LocalPrecip->PrecipStart = FALSE;
+      }/* end  if (SurfaceWater > 0.) */
+      else
+        LocalPrecip->PrecipStart = TRUE;
 
-  Infiltration = (1. - VType->ImpervFrac) * SurfaceWater;
+    } /* end Dynamic MaxInfiltration calculation */
 
-  if (Infiltration > MaxInfiltration)
-    Infiltration = MaxInfiltration;
+    Infiltration = (1. - VType->ImpervFrac) * SurfaceWater;
 
-  RoadbedInfiltration = RoadWater;
-  if (RoadbedInfiltration > MaxRoadbedInfiltration)
-    RoadbedInfiltration = MaxRoadbedInfiltration;
-  LocalSoil->IExcess = SurfaceWater - Infiltration +
-    RoadWater - RoadbedInfiltration;
+    if (Infiltration > MaxInfiltration)
+      Infiltration = MaxInfiltration;
 
-  if (LocalSoil->IExcess < 0.) {
-    printf("MEB: SoilIExcess(%f), reset to 0\n", LocalSoil->IExcess);
-    LocalSoil->IExcess = 0.;
-  }
+    RoadbedInfiltration = RoadWater;
+    if (RoadbedInfiltration > MaxRoadbedInfiltration)
+      RoadbedInfiltration = MaxRoadbedInfiltration;
+    LocalSoil->IExcess = SurfaceWater - Infiltration +
+      RoadWater - RoadbedInfiltration;
 
-  /*Add water that hits the channel network to the channel network */
-  if (ChannelWater > 0.) {
-    channel_grid_inc_inflow(ChannelData->stream_map, x, y, ChannelWater * DX * DY);
-    LocalSoil->ChannelInt += ChannelWater;
-  }
+    if (LocalSoil->IExcess < 0.) {
+      LogMessage(MSG_WARNING, "MEB: SoilIExcess(%f), reset to 0\n",
+		 LocalSoil->IExcess);
+      LocalSoil->IExcess = 0.;
+    }
 
-  /* Calculate unsaturated soil water movement, and adjust soil water table depth */
-  UnsaturatedFlow(Dt, DX, DY, Infiltration, RoadbedInfiltration,
-    LocalSoil->SatFlow, SType->NLayers, LocalSoil->Depth,
-    LocalNetwork->Area, VType->RootDepth, SType->Ks,
-    SType->PoreDist, SType->Porosity, SType->FCap, LocalSoil->Perc,
-    LocalNetwork->PercArea, LocalNetwork->Adjust, LocalNetwork->CutBankZone,
-    LocalNetwork->BankHeight, &(LocalSoil->TableDepth), &(LocalSoil->IExcess),
-    LocalSoil->Moist, InfiltOption);
+    /*Add water that hits the channel network to the channel network */
+    if (ChannelWater > 0.) {
+      if (ChannelAccum != NULL)
+        channel_grid_accum_inc_inflow(ChannelAccum, ChannelData->stream_map, x, y,
+                                      ChannelWater * DX * DY);
+      else
+        channel_grid_inc_inflow(ChannelData->stream_map, x, y, ChannelWater * DX * DY);
+      LocalSoil->ChannelInt += ChannelWater;
+    }
 
-  /* Infiltration is updated in UnsaturatedFlow and accumulated
-     below */
-  if ((InfiltOption == DYNAMIC) && (SurfaceWater > 0.))
-    LocalSoil->InfiltAcc += Infiltration;
+    /* Calculate unsaturated soil water movement, and adjust soil water table depth */
+    if (Column != NULL && !HeatFluxOption) {
+      Column->Infiltration = Infiltration;
+      Column->RoadbedInfiltration = RoadbedInfiltration;
+      Column->Pending = TRUE;
+    }
+    else
+      LocalSoil->CostUnsatLayers +=
+        UnsaturatedFlow(Dt, DX, DY, Infiltration, RoadbedInfiltration,
+          LocalSoil->SatFlow, SType->NLayers, LocalSoil->Depth,
+          LocalNetwork->Area, VType->RootDepth, SType->Ks,
+          SType->PoreDist, SType->Porosity, SType->FCap, SType->DrainTable,
+          LocalSoil->Perc,
+          LocalNetwork->PercArea, LocalNetwork->Adjust,
+          LocalNetwork->CutBankZone, LocalNetwork->BankHeight,
+          &(LocalSoil->TableDepth), &(LocalSoil->IExcess),
+          LocalSoil->Moist, InfiltOption, &(LocalNetwork->Capacity));
+
+    /* Infiltration is updated in UnsaturatedFlow and accumulated
+       below */
+    if ((InfiltOption == DYNAMIC) && (SurfaceWater > 0.))
+      LocalSoil->InfiltAcc += Infiltration;
+  }				/* end if (Quiet != QUIET_NONE) */
 
   if (HeatFluxOption == TRUE) {
     if (LocalSnow->HasSnow == TRUE) {
@@ -524,7 +611,7 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
     SensibleHeatFlux(y, x, Dt, LowerRa, Reference, 0.0f, Roughness,
       LocalMet, LocalRad->PixelNetShort, LocalRad->PixelLongIn,
       MoistureFlux, SType->NLayers, VType->RootDepth,
-      SType, MeltEnergy, LocalSoil);
+      SType, MeltEnergy, LocalSoil, Options->TSurfSolver);
     Tsurf = LocalSoil->TSurf;
     LongwaveBalance(Options, VType->OverStory, VType->Fract[0], VType->Vf, 
       LocalMet->Lin, LocalVeg->Tcanopy, Tsurf, LocalRad);
@@ -534,13 +621,150 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
 
 #endif
 
+  /* cost of the cell, see the Soil.Cost* map variables */
+  LocalSoil->CostSurfEval += LocalSoil->TSurfIter;
+  LocalSoil->CostSnowEval += LocalSnow->TSurfIter;
+
   /* add the components of the radiation balance for the current pixel to
      the total */
-  AggregateRadiation(MaxVegLayers, VType->NVegLayers, LocalRad, TotalRad);
+  if (TotalRad != NULL)
+    AggregateRadiation(MaxVegLayers, VType->NVegLayers, LocalRad, TotalRad);
 
-  /* For RBM model, save the energy fluxes for outputs */
-  if (Options->StreamTemp) {
+  /* For RBM model, save the energy fluxes for outputs, the model loop adds
+     them to the segments with channel_grid_cross_sum() */
+  if (Network == MEB_STREAMTEMP) {
     if (channel_grid_has_channel(ChannelData->stream_map, x, y))
-      channel_grid_inc_other(ChannelData->stream_map, x, y, LocalRad, LocalMet, skyview[y][x]);
+      channel_grid_cross_store(ChannelData->stream_cross, ChannelData->stream_map,
+                               x, y, LocalRad, LocalMet, skyview);
   }
 }
+
+/*****************************************************************************
+  Function name: MassEnergyBalance()
+
+  Purpose      : Calculate mass and energy balance of a cell, see
+                 MassEnergyBalanceCell()
+
+  Comments     : Reads the options of the run for each call, the model loop
+                 calls the variant of SelectMassEnergyBalance() instead
+*****************************************************************************/
+void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
+  float SineSolarAltitude, float DX, float DY,
+  int Dt, int HeatFluxOption, int CanopyRadAttOption,
+  int InfiltOption, int MaxVegLayers, PIXMET *LocalMet,
+  ROADSTRUCT *LocalNetwork, PRECIPPIX *LocalPrecip,
+  VEGTABLE *VType, VEGPIX *LocalVeg, SOILTABLE *SType,
+  SOILPIX *LocalSoil, SNOWPIX *LocalSnow, PIXRAD *LocalRad,
+  EVAPPIX *LocalEvap, PIXRAD *TotalRad, CHANNEL *ChannelData, 
+  float skyview, ChannelGridAccum *ChannelAccum, SOILCOLUMN *Column,
+  int BatchDone)
+{
+  int Network;
+
+  if (!Options->HasNetwork)
+    Network = MEB_NONETWORK;
+  else
+    Network = Options->StreamTemp ? MEB_STREAMTEMP : MEB_NETWORK;
+
+  MassEnergyBalanceCell(Options, y, x, SineSolarAltitude, DX, DY, Dt,
+    HeatFluxOption, CanopyRadAttOption, InfiltOption, MaxVegLayers, LocalMet,
+    LocalNetwork, LocalPrecip, VType, LocalVeg, SType, LocalSoil, LocalSnow,
+    LocalRad, LocalEvap, TotalRad, ChannelData, skyview, ChannelAccum,
+    Column, BatchDone, Options->ImprovRadiation, Network,
+    Options->SnowOnly);
+}
+
+/* MassEnergyBalance() with HeatFluxOption, InfiltOption, ImprovRadiation,
+   Network and SnowOnly fixed */
+#define MEB_VARIANT(Name, HEATFLUX, INFILT, IMPROVRAD, NETWORK, SNOWONLY) \
+static void Name(OPTIONSTRUCT *Options, int y, int x,			\
+  float SineSolarAltitude, float DX, float DY, int Dt,			\
+  int HeatFluxOption, int CanopyRadAttOption, int InfiltOption,		\
+  int MaxVegLayers, PIXMET *LocalMet, ROADSTRUCT *LocalNetwork,		\
+  PRECIPPIX *LocalPrecip, VEGTABLE *VType, VEGPIX *LocalVeg,		\
+  SOILTABLE *SType, SOILPIX *LocalSoil, SNOWPIX *LocalSnow,		\
+  PIXRAD *LocalRad, EVAPPIX *LocalEvap, PIXRAD *TotalRad,		\
+  CHANNEL *ChannelData, float skyview, ChannelGridAccum *ChannelAccum, \
+  SOILCOLUMN *Column, int BatchDone)				\
+{									\
+  MassEnergyBalanceCell(Options, y, x, SineSolarAltitude, DX, DY, Dt,	\
+    HEATFLUX, CanopyRadAttOption, INFILT, MaxVegLayers, LocalMet,	\
+    LocalNetwork, LocalPrecip, VType, LocalVeg, SType, LocalSoil,	\
+    LocalSnow, LocalRad, LocalEvap, TotalRad, ChannelData, skyview,	\
+    ChannelAccum, Column, BatchDone, IMPROVRAD, NETWORK, SNOWONLY);	\
+}
+
+/* MEB_<heat flux><dynamic infiltration><improved radiation><network> */
+MEB_VARIANT(MEB_0000, FALSE, STATIC, FALSE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_0001, FALSE, STATIC, FALSE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_0002, FALSE, STATIC, FALSE, MEB_STREAMTEMP, FALSE)
+MEB_VARIANT(MEB_0010, FALSE, STATIC, TRUE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_0011, FALSE, STATIC, TRUE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_0012, FALSE, STATIC, TRUE, MEB_STREAMTEMP, FALSE)
+MEB_VARIANT(MEB_0100, FALSE, DYNAMIC, FALSE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_0101, FALSE, DYNAMIC, FALSE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_0102, FALSE, DYNAMIC, FALSE, MEB_STREAMTEMP, FALSE)
+MEB_VARIANT(MEB_0110, FALSE, DYNAMIC, TRUE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_0111, FALSE, DYNAMIC, TRUE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_0112, FALSE, DYNAMIC, TRUE, MEB_STREAMTEMP, FALSE)
+MEB_VARIANT(MEB_1000, TRUE, STATIC, FALSE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_1001, TRUE, STATIC, FALSE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_1002, TRUE, STATIC, FALSE, MEB_STREAMTEMP, FALSE)
+MEB_VARIANT(MEB_1010, TRUE, STATIC, TRUE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_1011, TRUE, STATIC, TRUE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_1012, TRUE, STATIC, TRUE, MEB_STREAMTEMP, FALSE)
+MEB_VARIANT(MEB_1100, TRUE, DYNAMIC, FALSE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_1101, TRUE, DYNAMIC, FALSE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_1102, TRUE, DYNAMIC, FALSE, MEB_STREAMTEMP, FALSE)
+MEB_VARIANT(MEB_1110, TRUE, DYNAMIC, TRUE, MEB_NONETWORK, FALSE)
+MEB_VARIANT(MEB_1111, TRUE, DYNAMIC, TRUE, MEB_NETWORK, FALSE)
+MEB_VARIANT(MEB_1112, TRUE, DYNAMIC, TRUE, MEB_STREAMTEMP, FALSE)
+
+/* SNOW ONLY: the infiltration, the improved radiation and the network only
+   matter for the soil water and the evapotranspiration */
+MEB_VARIANT(MEB_SNOW0, FALSE, STATIC, FALSE, MEB_NONETWORK, TRUE)
+MEB_VARIANT(MEB_SNOW1, TRUE, STATIC, FALSE, MEB_NONETWORK, TRUE)
+
+/* [heat flux][dynamic infiltration][improved radiation][network] */
+static const MEBFUNCTION MEBVariants[2][2][2][3] = {
+  {{{MEB_0000, MEB_0001, MEB_0002}, {MEB_0010, MEB_0011, MEB_0012}},
+   {{MEB_0100, MEB_0101, MEB_0102}, {MEB_0110, MEB_0111, MEB_0112}}},
+  {{{MEB_1000, MEB_1001, MEB_1002}, {MEB_1010, MEB_1011, MEB_1012}},
+   {{MEB_1100, MEB_1101, MEB_1102}, {MEB_1110, MEB_1111, MEB_1112}}}
+};
+
+/*****************************************************************************
+  Function name: SelectMassEnergyBalance()
+
+  Purpose      : Pick the variant of MassEnergyBalance() for the options of
+                 the run
+
+  Required     :
+    OPTIONSTRUCT *Options - options of the run, after InitConstants()
+
+  Returns      : MEBFUNCTION, called with the same arguments as
+                 MassEnergyBalance()
+
+  Comments     : Options without a variant get MassEnergyBalance()
+*****************************************************************************/
+MEBFUNCTION SelectMassEnergyBalance(OPTIONSTRUCT *Options)
+{
+  int Network;
+
+  if ((Options->HeatFlux != TRUE && Options->HeatFlux != FALSE) ||
+      (Options->Infiltration != STATIC && Options->Infiltration != DYNAMIC) ||
+      (Options->ImprovRadiation != TRUE && Options->ImprovRadiation != FALSE))
+    return MassEnergyBalance;
+
+  if (Options->SnowOnly)
+    return (Options->HeatFlux == TRUE) ? MEB_SNOW1 : MEB_SNOW0;
+
+  if (!Options->HasNetwork)
+    Network = MEB_NONETWORK;
+  else
+    Network = Options->StreamTemp ? MEB_STREAMTEMP : MEB_NETWORK;
+
+  return MEBVariants[Options->HeatFlux == TRUE]
+    [Options->Infiltration == DYNAMIC][Options->ImprovRadiation == TRUE]
+    [Network];
+}
@@ -0,0 +1,409 @@
+/*
+ * SUMMARY:      MemAccount.c - Memory used by each subsystem
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The large maps and per cell arrays of the Init* routines
+ *               are allocated with TaggedCalloc() or TaggedMalloc(), which
+ *               count the bytes of each subsystem (memaccount.h).  The
+ *               table of the current and peak bytes is printed after the
+ *               initialization and at the end of the run.  Before an
+ *               allocation that takes the total above OPTIONS MEMORY LIMIT
+ *               (MB), or above the physical memory without a limit, a
+ *               warning and the table so far are printed, so that the
+ *               subsystem responsible is known even if the process is
+ *               killed afterwards.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitMemoryLimit()
+ *               TaggedCalloc()
+ *               TaggedMalloc()
+ *               ArenaCalloc()
+ *               TaggedRealloc()
+ *               TaggedFree()
+ *               FreeArenas()
+ *               ReportMemory()
+ *               MemoryInUse()
+ *               MemoryTagName()
+ *               MemoryLimitBytes()
+ * COMMENTS:     Each block carries a small header with its size and tag,
+ *               so a tagged block must be freed with TaggedFree() and not
+ *               with free().  The small arrays of each cell, which live
+ *               until the end of the run, are carved with ArenaCalloc()
+ *               from large chunks of the arena of their subsystem instead,
+ *               in the order of the calls, i.e. in cell order.  They have
+ *               neither a header nor a malloc header, cannot be freed one
+ *               by one, and are all released with FreeArenas() at the end
+ *               of the run.  Small tables and the temporary arrays of the
+ *               Init* routines are not tagged; the peak resident set of the
+ *               process, printed with the table, includes them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "settings.h"
+#include "memaccount.h"
+
+#ifdef HAVE_GETRUSAGE
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+/* header in front of each block, a multiple of the largest alignment */
+typedef union {
+  struct {
+    size_t Bytes;
+    int Tag;
+  } Info;
+  long double Align;
+} MEMHEADER;
+
+/* the arrays of an arena are aligned for float, int, double and pointers */
+typedef union {
+  double Double;
+  void *Pointer;
+  long Long;
+} ARENAALIGN;
+
+#define ARENA_CHUNK 4194304	/* bytes of a chunk of an arena */
+
+/* chunk of an arena, followed by its arrays */
+typedef union ARENACHUNK {
+  struct {
+    union ARENACHUNK *Next;	/* previous chunk of the arena */
+    size_t Bytes;		/* bytes after the header */
+    size_t Used;		/* bytes carved */
+  } Info;
+  ARENAALIGN Align;
+} ARENACHUNK;
+
+static const char *TagName[NMEMTAGS] = {
+  "Terrain", "Soil", "Vegetation", "Snow", "Precipitation", "Evaporation",
+  "Radiation", "Shadow/sky view", "Met", "MM5 input", "Road/channel cut",
+  "Channel", "Routing", "HRU", "Output"
+};
+
+static double Current[NMEMTAGS];	/* bytes in use */
+static double Peak[NMEMTAGS];		/* highest bytes in use */
+static long NAllocs[NMEMTAGS];		/* blocks in use */
+static double Total = 0.0;		/* bytes in use in all subsystems */
+static double TotalPeak = 0.0;
+static double Limit = 0.0;		/* bytes, 0 for none */
+static int Warned = FALSE;
+static ARENACHUNK *Arena[NMEMTAGS];	/* current chunk of each arena */
+/* the output writer and the initialization tasks (InitTasks.c) allocate
+   outside the OpenMP threads */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t MemLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_MEM() pthread_mutex_lock(&MemLock)
+#define UNLOCK_MEM() pthread_mutex_unlock(&MemLock)
+static pthread_mutex_t ArenaLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_ARENA() pthread_mutex_lock(&ArenaLock)
+#define UNLOCK_ARENA() pthread_mutex_unlock(&ArenaLock)
+#else
+#define LOCK_MEM()
+#define UNLOCK_MEM()
+#define LOCK_ARENA()
+#define UNLOCK_ARENA()
+#endif
+
+static void CheckLimit(double Bytes, int Tag);
+static void Count(int Tag, double Bytes, int NBlocks);
+static void *TaggedAlloc(size_t Bytes, int Tag, int Clear);
+
+/*****************************************************************************
+  InitMemoryLimit()
+
+  Sets the limit above which the allocations are reported, in MB, or the
+  physical memory if LimitMB is 0
+*****************************************************************************/
+void InitMemoryLimit(float LimitMB)
+{
+  Limit = LimitMB * 1048576.;
+#if defined(HAVE_GETRUSAGE) && defined(_SC_PHYS_PAGES)
+  if (Limit <= 0.0 && sysconf(_SC_PHYS_PAGES) > 0)
+    Limit = (double) sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+/*****************************************************************************
+  TaggedCalloc()
+
+  calloc() of NElements * Size bytes counted for the subsystem Tag.  Returns
+  NULL if the memory cannot be allocated.
+*****************************************************************************/
+void *TaggedCalloc(size_t NElements, size_t Size, int Tag)
+{
+  if (Size > 0 && NElements > ((size_t) -1 - sizeof(MEMHEADER)) / Size)
+    return NULL;
+  return TaggedAlloc(NElements * Size, Tag, TRUE);
+}
+
+/*****************************************************************************
+  TaggedMalloc()
+*****************************************************************************/
+void *TaggedMalloc(size_t Size, int Tag)
+{
+  if (Size > (size_t) -1 - sizeof(MEMHEADER))
+    return NULL;
+  return TaggedAlloc(Size, Tag, FALSE);
+}
+
+/*****************************************************************************
+  ArenaCalloc()
+
+  Zeroed array of NElements * Size bytes carved from the arena of the
+  subsystem Tag, for the small arrays of each cell.  Consecutive calls
+  return adjacent arrays, as long as they fit in the current chunk of
+  ARENA_CHUNK bytes, and a larger array gets a chunk of its own.  The array
+  stays counted until FreeArenas(), and cannot be freed by itself.  Returns
+  NULL if the memory cannot be allocated.
+*****************************************************************************/
+void *ArenaCalloc(size_t NElements, size_t Size, int Tag)
+{
+  ARENACHUNK *Chunk;
+  size_t Bytes;
+  size_t ChunkBytes;
+  void *Ptr = NULL;
+
+  if (Size > 0 && NElements > ((size_t) -1 - ARENA_CHUNK) / Size)
+    return NULL;
+  Bytes = NElements * Size;
+  Bytes = (Bytes + sizeof(ARENAALIGN) - 1) / sizeof(ARENAALIGN) *
+    sizeof(ARENAALIGN);
+  CheckLimit((double) Bytes, Tag);
+
+#if defined(HAVE_OPENMP) && !defined(HAVE_PTHREAD)
+#pragma omp critical (MemArena)
+#endif
+  {
+    LOCK_ARENA();
+    Chunk = Arena[Tag];
+    if (Chunk == NULL || Chunk->Info.Bytes - Chunk->Info.Used < Bytes) {
+      ChunkBytes = (Bytes > ARENA_CHUNK) ? Bytes : ARENA_CHUNK;
+      /* calloc() leaves the pages of a large chunk untouched until the
+	 arrays are first written, so the first touch still places them */
+      if ((Chunk = (ARENACHUNK *) calloc(1, sizeof(ARENACHUNK) + ChunkBytes))) {
+	Chunk->Info.Next = Arena[Tag];
+	Chunk->Info.Bytes = ChunkBytes;
+	Chunk->Info.Used = 0;
+	Arena[Tag] = Chunk;
+	Count(Tag, 0.0, 1);
+      }
+    }
+    if (Chunk != NULL) {
+      Ptr = (void *) ((char *) (Chunk + 1) + Chunk->Info.Used);
+      Chunk->Info.Used += Bytes;
+    }
+    UNLOCK_ARENA();
+  }
+  if (Ptr != NULL)
+    Count(Tag, (double) Bytes, 0);
+  return Ptr;
+}
+
+/*****************************************************************************
+  TaggedRealloc()
+
+  realloc() of a block allocated with TaggedCalloc() or TaggedMalloc(), or
+  of NULL.  Returns NULL if the memory cannot be allocated, in which case
+  the block is left as it is.
+*****************************************************************************/
+void *TaggedRealloc(void *Ptr, size_t Size, int Tag)
+{
+  MEMHEADER *Header;
+  size_t OldSize;
+
+  if (Ptr == NULL)
+    return TaggedMalloc(Size, Tag);
+  if (Size > (size_t) -1 - sizeof(MEMHEADER))
+    return NULL;
+  Header = ((MEMHEADER *) Ptr) - 1;
+  OldSize = Header->Info.Bytes;
+  if (Size > OldSize)
+    CheckLimit((double) (Size - OldSize), Tag);
+  if (!(Header = (MEMHEADER *) realloc(Header, sizeof(MEMHEADER) + Size)))
+    return NULL;
+  Header->Info.Bytes = Size;
+  Count(Header->Info.Tag, (double) Size - (double) OldSize, 0);
+  return (void *) (Header + 1);
+}
+
+/*****************************************************************************
+  TaggedFree()
+
+  Frees a block allocated with TaggedCalloc(), TaggedMalloc() or
+  TaggedRealloc()
+*****************************************************************************/
+void TaggedFree(void *Ptr)
+{
+  MEMHEADER *Header;
+
+  if (Ptr == NULL)
+    return;
+  Header = ((MEMHEADER *) Ptr) - 1;
+  Count(Header->Info.Tag, -(double) Header->Info.Bytes, -1);
+  free(Header);
+}
+
+/*****************************************************************************
+  FreeArenas()
+
+  Releases the chunks of all arenas, and with them all the arrays of
+  ArenaCalloc()
+*****************************************************************************/
+void FreeArenas(void)
+{
+  ARENACHUNK *Chunk;
+  int Tag;
+
+  LOCK_ARENA();
+  for (Tag = 0; Tag < NMEMTAGS; Tag++) {
+    while ((Chunk = Arena[Tag]) != NULL) {
+      Arena[Tag] = Chunk->Info.Next;
+      Count(Tag, -(double) Chunk->Info.Used, -1);
+      free(Chunk);
+    }
+  }
+  UNLOCK_ARENA();
+}
+
+/*****************************************************************************
+  TaggedAlloc()
+*****************************************************************************/
+static void *TaggedAlloc(size_t Bytes, int Tag, int Clear)
+{
+  MEMHEADER *Header;
+
+  CheckLimit((double) Bytes, Tag);
+  if (Clear)
+    Header = (MEMHEADER *) calloc(1, sizeof(MEMHEADER) + Bytes);
+  else
+    Header = (MEMHEADER *) malloc(sizeof(MEMHEADER) + Bytes);
+  if (Header == NULL)
+    return NULL;
+  Header->Info.Bytes = Bytes;
+  Header->Info.Tag = Tag;
+  Count(Tag, (double) Bytes, 1);
+  return (void *) (Header + 1);
+}
+
+/*****************************************************************************
+  CheckLimit()
+
+  Warns, once, if Bytes more for the subsystem Tag take the memory in use
+  above the limit
+*****************************************************************************/
+static void CheckLimit(double Bytes, int Tag)
+{
+  int First = FALSE;
+  double Projected;
+
+#if defined(HAVE_OPENMP) && !defined(HAVE_PTHREAD)
+#pragma omp critical (MemAccount)
+#endif
+  {
+    LOCK_MEM();
+    Projected = Total + Bytes;
+    if (Limit > 0.0 && !Warned && Projected > Limit) {
+      Warned = TRUE;
+      First = TRUE;
+    }
+    UNLOCK_MEM();
+  }
+  if (First) {
+    printf("WARNING: %.1f MB for %s take the memory in use to %.1f MB, "
+	   "above the limit of %.1f MB\n", Bytes / 1048576., TagName[Tag],
+	   Projected / 1048576., Limit / 1048576.);
+    ReportMemory("before this allocation");
+  }
+}
+
+/*****************************************************************************
+  Count()
+
+  Adds Bytes and NBlocks to the memory in use of the subsystem Tag
+*****************************************************************************/
+static void Count(int Tag, double Bytes, int NBlocks)
+{
+#if defined(HAVE_OPENMP) && !defined(HAVE_PTHREAD)
+#pragma omp critical (MemAccount)
+#endif
+  {
+    LOCK_MEM();
+    Current[Tag] += Bytes;
+    NAllocs[Tag] += NBlocks;
+    if (Current[Tag] > Peak[Tag])
+      Peak[Tag] = Current[Tag];
+    Total += Bytes;
+    if (Total > TotalPeak)
+      TotalPeak = Total;
+    UNLOCK_MEM();
+  }
+}
+
+/*****************************************************************************
+  ReportMemory()
+
+  Prints the memory of each subsystem that allocated any, the total and the
+  peak resident set of the process
+*****************************************************************************/
+void ReportMemory(const char *When)
+{
+#ifdef HAVE_GETRUSAGE
+  struct rusage Usage;
+#endif
+  int i;
+
+  printf("\nMemory by subsystem %s:\n", When);
+  printf("%-18s %10s %12s %12s\n", "Subsystem", "Blocks", "In use (MB)",
+	 "Peak (MB)");
+  for (i = 0; i < NMEMTAGS; i++)
+    if (Peak[i] > 0.0)
+      printf("%-18s %10ld %12.1f %12.1f\n", TagName[i], NAllocs[i],
+	     Current[i] / 1048576., Peak[i] / 1048576.);
+  printf("%-18s %10s %12.1f %12.1f\n", "total", "", Total / 1048576.,
+	 TotalPeak / 1048576.);
+#ifdef HAVE_GETRUSAGE
+  /* ru_maxrss is in kB on Linux */
+  if (getrusage(RUSAGE_SELF, &Usage) == 0)
+    printf("Peak resident set of the process: %.1f MB\n",
+	   Usage.ru_maxrss / 1024.);
+#endif
+  if (Limit > 0.0)
+    printf("Memory limit: %.1f MB\n", Limit / 1048576.);
+  fflush(stdout);
+}
+
+/*****************************************************************************
+  MemoryInUse()
+
+  Bytes in use in the subsystem Tag
+*****************************************************************************/
+double MemoryInUse(int Tag)
+{
+  return Current[Tag];
+}
+
+/*****************************************************************************
+  MemoryTagName()
+*****************************************************************************/
+const char *MemoryTagName(int Tag)
+{
+  return TagName[Tag];
+}
+
+/*****************************************************************************
+  MemoryLimitBytes()
+
+  Limit of InitMemoryLimit() in bytes, 0 for none
+*****************************************************************************/
+double MemoryLimitBytes(void)
+{
+  return Limit;
+}
@@ -0,0 +1,184 @@
+/*
+ * SUMMARY:      MessageLog.c - Rate-limited messages of the time loop
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The warnings that may be printed for every station or every
+ *               cell of every time step are printed with LogMessage()
+ *               (messagelog.h) instead of printf().  Each place in the code
+ *               that prints a message is a site with a counter of its own.
+ *               A site prints its first OPTIONS MESSAGE LIMIT messages, and
+ *               only counts the others, and the messages with a severity
+ *               above OPTIONS MESSAGE LEVEL are only counted.  At the end of
+ *               the run a table of the sites with their number of messages
+ *               is printed.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitMessageLog()
+ *               LogSite()
+ *               ReportMessages()
+ * COMMENTS:     A message that is not printed costs an atomic increment of
+ *               the counter of its site, so that the threads of the pixel
+ *               loop do not wait for each other or for stdout.  A message
+ *               that is printed is composed in a buffer of its thread and
+ *               written with one call, so that the messages of the threads
+ *               are not mixed within a line.  A MESSAGE LIMIT of 0 prints
+ *               all the messages.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#include "settings.h"
+#include "messagelog.h"
+
+#define MSG_LENGTH 512		/* longest message that is printed */
+#define MSG_SHOWN   48		/* characters of the format in the summary */
+
+static const char *LevelName[NMSGLEVELS] = {
+  "ERROR", "WARNING", "NOTE", "DEBUG"
+};
+
+static int MaxLevel = MSG_NOTE;	/* highest severity that is printed */
+static int Limit = 10;		/* messages printed by a site, 0 for all */
+static MSGSITE *Sites = NULL;	/* sites with messages, last one first */
+
+/* the side stages and the prefetch thread print outside the OpenMP
+   threads */
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t SiteLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_SITES() pthread_mutex_lock(&SiteLock)
+#define UNLOCK_SITES() pthread_mutex_unlock(&SiteLock)
+#else
+#define LOCK_SITES()
+#define UNLOCK_SITES()
+#endif
+
+/*****************************************************************************
+  InitMessageLog()
+
+  Sets the highest severity Level that is printed and the number of
+  messages each site prints, or all of them if MaxMessages is 0
+*****************************************************************************/
+void InitMessageLog(int Level, int MaxMessages)
+{
+  MaxLevel = Level;
+  Limit = MaxMessages;
+}
+
+/*****************************************************************************
+  LogSite()
+
+  Counts a message of Site, and prints it with the printf() Format and
+  arguments as long as the site has not reached the limit.  Use
+  LogMessage(), which gives each site its counter.
+*****************************************************************************/
+void LogSite(MSGSITE *Site, const char *Format, ...)
+{
+  char Message[MSG_LENGTH];
+  va_list Args;
+  long Count;
+  int Length;
+
+  if (!__atomic_exchange_n(&(Site->Registered), TRUE, __ATOMIC_ACQ_REL)) {
+    Site->Format = Format;
+#if defined(HAVE_OPENMP) && !defined(HAVE_PTHREAD)
+#pragma omp critical (MessageLog)
+#endif
+    {
+      LOCK_SITES();
+      Site->Next = Sites;
+      Sites = Site;
+      UNLOCK_SITES();
+    }
+  }
+
+  Count = __atomic_add_fetch(&(Site->Count), 1, __ATOMIC_RELAXED);
+  if (Site->Level > MaxLevel || (Limit > 0 && Count > Limit))
+    return;
+
+  va_start(Args, Format);
+  Length = vsnprintf(Message, MSG_LENGTH, Format, Args);
+  va_end(Args);
+  if (Length < 0)
+    return;
+  if (Length >= MSG_LENGTH)
+    Length = MSG_LENGTH - 1;
+  if (Limit > 0 && Count == Limit)
+    snprintf(Message + Length, MSG_LENGTH - Length,
+	     "%sfurther messages like this one are only counted\n",
+	     (Length > 0 && Message[Length - 1] == '\n') ? "" : "\n");
+  fputs(Message, stdout);
+}
+
+/*****************************************************************************
+  ReportMessages()
+
+  Prints the number of messages of each site of the run, and resets the
+  counters for the next run of the library
+*****************************************************************************/
+void ReportMessages(void)
+{
+  MSGSITE *Site;
+  MSGSITE *Next;
+  MSGSITE *First;
+  char Shown[MSG_SHOWN + 1];
+  char Where[BUFSIZE + 1];
+  const char *File;
+  long Printed;
+  long Suppressed;
+  int i;
+
+  if (Sites == NULL)
+    return;
+
+  /* the sites in the order of their first message */
+  First = NULL;
+  for (Site = Sites; Site != NULL; Site = Next) {
+    Next = Site->Next;
+    Site->Next = First;
+    First = Site;
+  }
+  Sites = NULL;
+
+  Suppressed = 0;
+  if (Limit > 0)
+    printf("\nMessages of the run (at most %d printed per site):\n", Limit);
+  else
+    printf("\nMessages of the run:\n");
+  printf("  %-7s %12s %12s  %-28s %s\n", "Level", "Count", "Printed", "Site",
+	 "Message");
+  for (Site = First; Site != NULL; Site = Next) {
+    Next = Site->Next;
+    if (Site->Level > MaxLevel)
+      Printed = 0;
+    else if (Limit > 0 && Site->Count > Limit)
+      Printed = Limit;
+    else
+      Printed = Site->Count;
+    Suppressed += Site->Count - Printed;
+
+    File = strrchr(Site->File, '/');
+    File = File ? File + 1 : Site->File;
+    strncpy(Shown, Site->Format, MSG_SHOWN);
+    Shown[MSG_SHOWN] = '\0';
+    for (i = 0; Shown[i] != '\0'; i++)
+      if (Shown[i] == '\n')
+	Shown[i] = ' ';
+    for (i--; i >= 0 && Shown[i] == ' '; i--)
+      Shown[i] = '\0';
+    snprintf(Where, BUFSIZE + 1, "%s:%d", File, Site->Line);
+    printf("  %-7s %12ld %12ld  %-28s %s\n", LevelName[Site->Level],
+	   Site->Count, Printed, Where, Shown);
+
+    Site->Count = 0;
+    Site->Next = NULL;
+    __atomic_store_n(&(Site->Registered), FALSE, __ATOMIC_RELEASE);
+  }
+  printf("%ld messages were counted and not printed\n", Suppressed);
+}
@@ -0,0 +1,464 @@
+/*
+ * SUMMARY:      MetInterpolation.c - Station forcing at a coarser interval
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With MET FILE INTERVAL the station records are read at
+ *               their own interval, a multiple of the model time step, and
+ *               the forcing of the steps in between is made from the
+ *               records around the step.  The air temperature, humidity,
+ *               wind, longwave, soil temperatures and lapse rates are
+ *               interpolated between the records, linearly or with a cubic
+ *               (Catmull-Rom) spline (MET INTERPOLATION).  The
+ *               precipitation of a record is the total of its interval and
+ *               is divided evenly over the steps, and the shortwave of a
+ *               record is the mean of its interval and is distributed over
+ *               the steps in proportion to the radiation at the top of the
+ *               atmosphere, so that both keep the total of the record.
+ *               The MM5 maps are made from their records in the same way.
+ * DESCRIP-END.
+ * FUNCTIONS:    InterpolateMetData()
+ *               LoadMetRecords()
+ *               ReadMetInterval()
+ *               InterpolateMM5Maps()
+ *               LoadMM5Records()
+ *               SunOfInterval()
+ *               Spline()
+ * COMMENTS:     The records are at midnight and at every MET FILE INTERVAL
+ *               after it, the interval divides a day.  A record holds the
+ *               values at its date, and the totals and means of the
+ *               interval that starts at its date, like the record of a
+ *               model step.  Beyond the records of the run (before the
+ *               start or after the end) the nearest record is used.  Each
+ *               record is read once while the steps follow each other,
+ *               after a jump in time (spin up, restored states) the station
+ *               files are read again from their start.  Record n of the
+ *               MM5 files is at MM5 START plus n intervals, MM5 START is
+ *               on a record of the stations (see InitMM5()), and the
+ *               terrain map is taken from the record of the step.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "constants.h"
+
+/* records of the stations around the current step */
+static struct {
+  int NStats;
+  long long Interval;		/* Index of the interval of Rec[1], -1 if
+				   nothing has been read */
+  MET *Rec[4];			/* Records of the intervals Interval - 1 to
+				   Interval + 2 of each station */
+  double SunSum;		/* SunMax summed over the steps of interval
+				   Interval */
+} MetInterp = { 0, -1, { NULL, NULL, NULL, NULL }, 0.0 };
+
+/* MM5 maps of the records around the current step */
+static struct {
+  int NValues;			/* Values of all the maps of a record */
+  long long Interval;		/* Record of Rec[1], -1 if nothing has been
+				   read */
+  float *Rec[4];		/* Maps of the records Interval - 1 to
+				   Interval + 2, in the order of MM5Input */
+  double SunSum;		/* SunMax summed over the steps of record
+				   Interval */
+} MM5Interp = { 0, -1, { NULL, NULL, NULL, NULL }, 0.0 };
+
+static void LoadMetRecords(OPTIONSTRUCT *Options, TIMESTRUCT *Time,
+			   int NSoilLayers, int NStats, METLOCATION *Stat,
+			   long long Interval, int Offset);
+static void ReadMetInterval(OPTIONSTRUCT *Options, TIMESTRUCT *Time,
+			    int NSoilLayers, int NStats, METLOCATION *Stat,
+			    DATE *Date, MET *Rec, MET *Nearest);
+static void LoadMM5Records(INPUTFILES *InFiles, OPTIONSTRUCT *Options,
+			   TIMESTRUCT *Time, int NSoilLayers, MAPSIZE *MM5Map,
+			   int NValues, long long Interval, int Offset);
+static double SunOfInterval(OPTIONSTRUCT *Options, DATE *Date, int Dt,
+			    SOLARGEOMETRY *SolarGeo);
+static float Spline(int Cubic, float p0, float p1, float p2, float p3,
+		    float w);
+
+/*****************************************************************************
+  Function name: InterpolateMetData()
+
+  Purpose      : Forcing of the stations for the current time step from the
+                 records at MET FILE INTERVAL
+
+  Required     :
+    OPTIONSTRUCT *Options    - MetInterval and MetInterpolation
+    TIMESTRUCT *Time         - Current time step
+    int NSoilLayers          - Number of soil layers
+    int NStats               - Number of stations
+    METLOCATION *Stat        - Stations
+    SOLARGEOMETRY *SolarGeo  - Sun of the current step
+
+  Modifies     : Stat[].Data
+
+  Comments     : Called by GetMetData() instead of ReadMetRecords()
+*****************************************************************************/
+void InterpolateMetData(OPTIONSTRUCT *Options, TIMESTRUCT *Time,
+			int NSoilLayers, int NStats, METLOCATION *Stat,
+			SOLARGEOMETRY *SolarGeo)
+{
+  const int I = Options->MetInterval;
+  const int Cubic = (Options->MetInterpolation == METINTERP_CUBIC);
+  DATE *Now = &(Time->Current);
+  long long Interval;		/* index of the interval of the step */
+  double Midnight;
+  float w;			/* position of the step in the interval */
+  int Second;			/* second of the day of the step */
+  int Offset;			/* seconds since the record of the step */
+  int i;
+  int j;
+  MET *r[4];
+
+  if (NStats <= 0)
+    return;
+
+  Second = Now->Hour * SECPHOUR + Now->Min * 60 + Now->Sec;
+  Midnight = floor(Now->Julian - (double) Second / SECPDAY + 0.25);
+  Interval = (long long) Midnight * (SECPDAY / I) + Second / I;
+  Offset = Second % I;
+  w = (float) Offset / I;
+
+  if (Interval != MetInterp.Interval || NStats != MetInterp.NStats) {
+    LoadMetRecords(Options, Time, NSoilLayers, NStats, Stat, Interval,
+		   Offset);
+    MetInterp.SunSum = SunOfInterval(Options, Now, Time->Dt, SolarGeo);
+  }
+
+  for (i = 0; i < NStats; i++) {
+    for (j = 0; j < 4; j++)
+      r[j] = &(MetInterp.Rec[j][i]);
+
+    Stat[i].Data = *r[1];
+    Stat[i].Data.Tair = Spline(Cubic, r[0]->Tair, r[1]->Tair, r[2]->Tair,
+			       r[3]->Tair, w);
+    Stat[i].Data.Rh = Spline(Cubic, r[0]->Rh, r[1]->Rh, r[2]->Rh, r[3]->Rh,
+			     w);
+    Stat[i].Data.Rh = MAX(0.0, MIN(100.0, Stat[i].Data.Rh));
+    Stat[i].Data.Wind = MAX(0.0, Spline(Cubic, r[0]->Wind, r[1]->Wind,
+					r[2]->Wind, r[3]->Wind, w));
+    Stat[i].Data.Lin = MAX(0.0, Spline(Cubic, r[0]->Lin, r[1]->Lin,
+				       r[2]->Lin, r[3]->Lin, w));
+    for (j = 0; Options->HeatFlux == TRUE && j < NSoilLayers; j++)
+      Stat[i].Data.Tsoil[j] = Spline(Cubic, r[0]->Tsoil[j], r[1]->Tsoil[j],
+				     r[2]->Tsoil[j], r[3]->Tsoil[j], w);
+    Stat[i].Data.TempLapse = Spline(Cubic, r[0]->TempLapse,
+				    r[1]->TempLapse, r[2]->TempLapse,
+				    r[3]->TempLapse, w);
+    Stat[i].Data.PrecipLapse = Spline(Cubic, r[0]->PrecipLapse,
+				      r[1]->PrecipLapse, r[2]->PrecipLapse,
+				      r[3]->PrecipLapse, w);
+
+    /* totals and means of the interval, the wind direction of the record */
+    Stat[i].Data.Precip = r[1]->Precip * Time->Dt / I;
+    if (MetInterp.SunSum > 0.0)
+      Stat[i].Data.Sin = (float) (r[1]->Sin * SolarGeo->SunMax *
+				  (I / Time->Dt) / MetInterp.SunSum);
+  }
+}
+
+/*****************************************************************************
+  Function name: LoadMetRecords()
+
+  Purpose      : Read the records around interval Interval
+
+  Comments     : The records of the next interval are read ahead.  The
+                 files are read again from the start if Interval does not
+                 follow the interval loaded last
+*****************************************************************************/
+static void LoadMetRecords(OPTIONSTRUCT *Options, TIMESTRUCT *Time,
+			   int NSoilLayers, int NStats, METLOCATION *Stat,
+			   long long Interval, int Offset)
+{
+  const char *Routine = "LoadMetRecords";
+  const int I = Options->MetInterval;
+  const int Cubic = (Options->MetInterpolation == METINTERP_CUBIC);
+  DATE Date;
+  MET *First;
+  int j;
+
+  if (MetInterp.NStats != NStats) {
+    for (j = 0; j < 4; j++) {
+      free(MetInterp.Rec[j]);
+      if (!(MetInterp.Rec[j] = (MET *) calloc(NStats, sizeof(MET))))
+	ReportError((char *) Routine, 1);
+    }
+    MetInterp.NStats = NStats;
+    MetInterp.Interval = -1;
+  }
+
+  if (MetInterp.Interval >= 0 && Interval == MetInterp.Interval + 1) {
+    /* the next interval, one record to read */
+    First = MetInterp.Rec[0];
+    for (j = 0; j < 3; j++)
+      MetInterp.Rec[j] = MetInterp.Rec[j + 1];
+    MetInterp.Rec[3] = First;
+    Date = NextDate(&(Time->Current), (Cubic ? 2 : 1) * I - Offset);
+    if (Cubic)
+      ReadMetInterval(Options, Time, NSoilLayers, NStats, Stat, &Date,
+		      MetInterp.Rec[3], MetInterp.Rec[2]);
+    else {
+      ReadMetInterval(Options, Time, NSoilLayers, NStats, Stat, &Date,
+		      MetInterp.Rec[2], MetInterp.Rec[1]);
+      for (j = 0; j < NStats; j++)
+	MetInterp.Rec[3][j] = MetInterp.Rec[2][j];
+    }
+  }
+  else {
+    /* the files are only read forward */
+    if (MetInterp.Interval >= 0)
+      RewindMetFiles(NStats, Stat);
+
+    Date = NextDate(&(Time->Current), -Offset - I);
+    First = NULL;
+    if (Cubic && !Before(&Date, &(Time->Start))) {
+      ReadMetInterval(Options, Time, NSoilLayers, NStats, Stat, &Date,
+		      MetInterp.Rec[0], NULL);
+      First = MetInterp.Rec[0];
+    }
+    Date = NextDate(&(Time->Current), -Offset);
+    ReadMetInterval(Options, Time, NSoilLayers, NStats, Stat, &Date,
+		    MetInterp.Rec[1], NULL);
+    if (First == NULL)
+      for (j = 0; j < NStats; j++)
+	MetInterp.Rec[0][j] = MetInterp.Rec[1][j];
+    Date = NextDate(&(Time->Current), I - Offset);
+    ReadMetInterval(Options, Time, NSoilLayers, NStats, Stat, &Date,
+		    MetInterp.Rec[2], MetInterp.Rec[1]);
+    Date = NextDate(&(Time->Current), 2 * I - Offset);
+    if (Cubic)
+      ReadMetInterval(Options, Time, NSoilLayers, NStats, Stat, &Date,
+		      MetInterp.Rec[3], MetInterp.Rec[2]);
+    else
+      for (j = 0; j < NStats; j++)
+	MetInterp.Rec[3][j] = MetInterp.Rec[2][j];
+  }
+  MetInterp.Interval = Interval;
+}
+
+/*****************************************************************************
+  Function name: ReadMetInterval()
+
+  Purpose      : Read the records of the stations at Date into Rec, or copy
+                 Nearest if Date is after the end of the run
+*****************************************************************************/
+static void ReadMetInterval(OPTIONSTRUCT *Options, TIMESTRUCT *Time,
+			    int NSoilLayers, int NStats, METLOCATION *Stat,
+			    DATE *Date, MET *Rec, MET *Nearest)
+{
+  int i;
+
+  if (Nearest != NULL && After(Date, &(Time->End))) {
+    for (i = 0; i < NStats; i++)
+      Rec[i] = Nearest[i];
+    return;
+  }
+  ReadMetRecords(Options, Date, NSoilLayers, NStats, Stat);
+  for (i = 0; i < NStats; i++)
+    Rec[i] = Stat[i].Data;
+}
+
+/*****************************************************************************
+  Function name: InterpolateMM5Maps()
+
+  Purpose      : MM5 maps of the current time step from the records at MET
+                 FILE INTERVAL
+
+  Required     :
+    INPUTFILES *InFiles      - Names of the MM5 files
+    OPTIONSTRUCT *Options    - MetInterval and MetInterpolation
+    TIMESTRUCT *Time         - Current time step and MM5 START
+    int NSoilLayers          - Number of soil layers
+    int NMaps                - Number of maps of a record
+    MAPSIZE *MM5Map          - Size of the MM5 maps
+    SOLARGEOMETRY *SolarGeo  - Sun of the current step
+    float *Array             - Maps in the order of MM5Input
+
+  Modifies     : Array
+
+  Comments     : Called by InitNewStep() instead of ReadMM5Maps()
+*****************************************************************************/
+void InterpolateMM5Maps(INPUTFILES *InFiles, OPTIONSTRUCT *Options,
+			TIMESTRUCT *Time, int NSoilLayers, int NMaps,
+			MAPSIZE *MM5Map, SOLARGEOMETRY *SolarGeo,
+			float *Array)
+{
+  const int I = Options->MetInterval;
+  const int Cubic = (Options->MetInterpolation == METINTERP_CUBIC);
+  const int NCells = MM5Map->NY * MM5Map->NX;
+  long long Seconds;		/* seconds since MM5 START */
+  long long Interval;		/* record of the step */
+  float w;			/* position of the step in the interval */
+  float *Out;			/* map of the step */
+  int Offset;			/* seconds since the record of the step */
+  int i;
+  int j;
+  int k;
+  float *r[4];
+
+  Seconds = (long long) NumberOfSteps(&(Time->StartMM5), &(Time->Current),
+				      Time->Dt) * Time->Dt;
+  Interval = Seconds / I;
+  Offset = (int) (Seconds % I);
+  w = (float) Offset / I;
+
+  if (Interval != MM5Interp.Interval || NMaps * NCells != MM5Interp.NValues) {
+    LoadMM5Records(InFiles, Options, Time, NSoilLayers, MM5Map,
+		   NMaps * NCells, Interval, Offset);
+    MM5Interp.SunSum = SunOfInterval(Options, &(Time->Current), Time->Dt,
+				     SolarGeo);
+  }
+
+  for (j = 0; j < NMaps; j++) {
+    for (k = 0; k < 4; k++)
+      r[k] = &(MM5Interp.Rec[k][j * NCells]);
+    Out = &Array[j * NCells];
+
+    /* totals and means of the interval, the terrain of the record */
+    if (j == MM5_precip - 1) {
+      for (i = 0; i < NCells; i++)
+	Out[i] = r[1][i] * Time->Dt / I;
+    }
+    else if (j == MM5_shortwave - 1) {
+      for (i = 0; i < NCells; i++)
+	Out[i] = MM5Interp.SunSum > 0.0 ?
+	  (float) (r[1][i] * SolarGeo->SunMax * (I / Time->Dt) /
+		   MM5Interp.SunSum) : r[1][i];
+    }
+    else if (j == MM5_terrain - 1) {
+      for (i = 0; i < NCells; i++)
+	Out[i] = r[1][i];
+    }
+    else {
+      for (i = 0; i < NCells; i++)
+	Out[i] = Spline(Cubic, r[0][i], r[1][i], r[2][i], r[3][i], w);
+      if (j == MM5_humidity - 1)
+	for (i = 0; i < NCells; i++)
+	  Out[i] = MAX(0.0, MIN(100.0, Out[i]));
+      else if (j == MM5_wind - 1 || j == MM5_longwave - 1)
+	for (i = 0; i < NCells; i++)
+	  Out[i] = MAX(0.0, Out[i]);
+    }
+  }
+}
+
+/*****************************************************************************
+  Function name: LoadMM5Records()
+
+  Purpose      : Read the MM5 records around record Interval
+
+  Comments     : The maps of the next record are read ahead.  Before the
+                 first record and after the end of the run the nearest
+                 record is used
+*****************************************************************************/
+static void LoadMM5Records(INPUTFILES *InFiles, OPTIONSTRUCT *Options,
+			   TIMESTRUCT *Time, int NSoilLayers, MAPSIZE *MM5Map,
+			   int NValues, long long Interval, int Offset)
+{
+  const char *Routine = "LoadMM5Records";
+  const int I = Options->MetInterval;
+  const int Cubic = (Options->MetInterpolation == METINTERP_CUBIC);
+  DATE Date;
+  float *First;
+  int j;
+  int k;
+
+  if (MM5Interp.NValues != NValues) {
+    for (j = 0; j < 4; j++) {
+      free(MM5Interp.Rec[j]);
+      if (!(MM5Interp.Rec[j] = (float *) calloc(NValues, sizeof(float))))
+	ReportError((char *) Routine, 1);
+    }
+    MM5Interp.NValues = NValues;
+    MM5Interp.Interval = -1;
+  }
+
+  if (MM5Interp.Interval >= 0 && Interval == MM5Interp.Interval + 1) {
+    /* the next record, one record to read */
+    First = MM5Interp.Rec[0];
+    for (j = 0; j < 3; j++)
+      MM5Interp.Rec[j] = MM5Interp.Rec[j + 1];
+    MM5Interp.Rec[3] = First;
+    k = Cubic ? 2 : 1;
+  }
+  else {
+    if (Interval > 0 && Cubic)
+      ReadMM5Maps(InFiles, Options, NSoilLayers, MM5Map, (int) Interval - 1,
+		  MM5Interp.Rec[0]);
+    ReadMM5Maps(InFiles, Options, NSoilLayers, MM5Map, (int) Interval,
+		MM5Interp.Rec[1]);
+    if (Interval <= 0 || !Cubic)
+      for (j = 0; j < NValues; j++)
+	MM5Interp.Rec[0][j] = MM5Interp.Rec[1][j];
+    k = 1;
+  }
+
+  /* records Interval + 1 and, for the spline, Interval + 2 */
+  for (; k <= (Cubic ? 2 : 1); k++) {
+    Date = NextDate(&(Time->Current), k * I - Offset);
+    if (After(&Date, &(Time->End)))
+      for (j = 0; j < NValues; j++)
+	MM5Interp.Rec[k + 1][j] = MM5Interp.Rec[k][j];
+    else
+      ReadMM5Maps(InFiles, Options, NSoilLayers, MM5Map, (int) Interval + k,
+		  MM5Interp.Rec[k + 1]);
+  }
+  if (!Cubic)
+    for (j = 0; j < NValues; j++)
+      MM5Interp.Rec[3][j] = MM5Interp.Rec[2][j];
+  MM5Interp.Interval = Interval;
+}
+
+/*****************************************************************************
+  Function name: SunOfInterval()
+
+  Purpose      : SunMax summed over the steps of the interval of Date, the
+                 step of Date included
+
+  Comments     : The sun of each step is the one of StepSolarGeometry()
+*****************************************************************************/
+static double SunOfInterval(OPTIONSTRUCT *Options, DATE *Date, int Dt,
+			    SOLARGEOMETRY *SolarGeo)
+{
+  SOLARGEOMETRY Geo = *SolarGeo;
+  DATE Step;
+  double Sum = 0.0;
+  int Second;
+  int n;
+
+  Second = Date->Hour * SECPHOUR + Date->Min * 60 + Date->Sec;
+  Step = NextDate(Date, -(Second % Options->MetInterval));
+  for (n = 0; n < Options->MetInterval / Dt; n++) {
+    InitNewDay(Step.JDay, &Geo);
+    Second = Step.Hour * SECPHOUR + Step.Min * 60 + Step.Sec;
+    StepSolarGeometry(Second / Dt, Dt, &Geo);
+    Sum += Geo.SunMax;
+    Step = NextDate(&Step, Dt);
+  }
+  return Sum;
+}
+
+/*****************************************************************************
+  Function name: Spline()
+
+  Purpose      : Value at w (0 to 1) between p1 and p2, linear or on the
+                 Catmull-Rom spline through p0 to p3
+*****************************************************************************/
+static float Spline(int Cubic, float p0, float p1, float p2, float p3,
+		    float w)
+{
+  if (!Cubic)
+    return p1 + w * (p2 - p1);
+  return 0.5 * (2.0 * p1 + (p2 - p0) * w +
+		(2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3) * w * w +
+		(3.0 * (p1 - p2) + p3 - p0) * w * w * w);
+}
@@ -0,0 +1,353 @@
+/*
+ * SUMMARY:      MonitorFeed.c - Live feed of the basin state for viewers
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS MONITOR FEED every time step puts the basin
+ *               totals, the outflow of the stream segments that are
+ *               recorded in Stream.Flow and coarse maps of the snow water
+ *               equivalent, the water table depth, the evapotranspiration
+ *               and the precipitation in a ring buffer of MONITOR FEED
+ *               SLOTS steps.  The ring buffer is a file, best in /dev/shm,
+ *               that viewers and dashboards map read-only while the model
+ *               runs, so that they follow it without text files or the X11
+ *               graphics and without slowing it down.  The cells of the
+ *               coarse maps are the means over blocks of MONITOR FEED MAP
+ *               STRIDE by STRIDE cells of the basin.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitMonitorFeed()
+ *               PublishMonitorFeed()
+ *               ForkMonitorFeed()
+ *               CloseMonitorFeed()
+ *               OpenFeed()
+ * COMMENTS:     The layout is in monitorfeed.h, and program/monitor_feed.c
+ *               reads it.  The slots are a sequence lock each: the Seq of
+ *               a slot is odd while it is written, and a viewer that reads
+ *               the same even Seq before and after copying a slot has a
+ *               consistent copy.  Latest in the header is the sequence
+ *               number of the newest complete slot.  A viewer never blocks
+ *               the model, it only has to keep up with the ring.
+ *
+ *               The totals are those of Aggregate(), which collects all of
+ *               them every AGGREGATION INTERVAL steps: Full is FALSE in the
+ *               steps in between, in which only the precipitation,
+ *               evapotranspiration, infiltration excess and channel
+ *               interception are basin values of the step.  Units are
+ *               those of the Aggregated.Values file, the segment flows are
+ *               in cubic meters per time step as in Stream.Flow.
+ *
+ *               A run that starts removes the file of an earlier run and
+ *               makes a new one, so a viewer that still has the old one
+ *               mapped keeps it.  Ensemble members and forked branches
+ *               write to a feed with the member or branch number appended,
+ *               as the telemetry does (Telemetry.c)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "constants.h"
+#include "functions.h"
+#include "getinit.h"
+#include "monitorfeed.h"
+
+static const char *TotalName[MONITOR_TOTALS] = {
+  "Precip", "ETot", "Swq", "Melt", "SoilWater", "CanopyWater", "TableDepth",
+  "SatExtent", "Runoff", "ChannelInt", "IExcess", "SatFlow", "NetRad"
+};
+static const char *MapName[MONITOR_MAPS] = {
+  "Swq", "TableDepth", "ETot", "Precip"
+};
+
+static char BaseName[BUFSIZE + 1];	/* OPTIONS MONITOR FEED */
+static char FeedName[BUFSIZE + 1];	/* with the rank or branch appended */
+static char *Feed = NULL;		/* the mapped ring buffer */
+static size_t FeedSize = 0;
+static MONITORHEADER Layout;		/* header of the ring buffer */
+static unsigned long long Sequence = 0;	/* of the last published slot */
+static Channel **Segment = NULL;	/* recorded stream segments */
+static int *BlockCells = NULL;		/* basin cells of each block */
+static double *BlockSum = NULL;		/* sums of the maps over a block */
+
+static void OpenFeed(void);
+
+/*****************************************************************************
+  Function name: OpenFeed()
+
+  Purpose      : Make the ring buffer FeedName with the header of Layout
+                 and the segment ids, and map it
+
+  Comments     : The magic is written last, so a viewer does not take a
+                 feed that is being made for a valid one
+*****************************************************************************/
+static void OpenFeed(void)
+{
+#ifdef HAVE_MMAP
+  int *Ids;
+  int Fd;
+  int i;
+
+  unlink(FeedName);
+  if ((Fd = open(FeedName, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+    ReportError(FeedName, 3);
+  if (ftruncate(Fd, (off_t) FeedSize) != 0)
+    ReportError(FeedName, 72);
+  Feed = (char *) mmap(NULL, FeedSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+		       Fd, 0);
+  close(Fd);
+  if (Feed == (char *) MAP_FAILED) {
+    Feed = NULL;
+    ReportError(FeedName, 72);
+  }
+
+  memcpy(Feed, &Layout, sizeof(MONITORHEADER));
+  memset(Feed, 0, sizeof(Layout.Magic));
+  Ids = (int *) (Feed + sizeof(MONITORHEADER));
+  for (i = 0; i < Layout.NSegments; i++)
+    Ids[i] = Segment[i]->id;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(Feed, MONITOR_MAGIC, sizeof(Layout.Magic));
+  Sequence = 0;
+#endif
+}
+
+/*****************************************************************************
+  Function name: InitMonitorFeed()
+
+  Purpose      : Make the ring buffer of OPTIONS MONITOR FEED (nothing if it
+                 is empty)
+
+  Required     :
+    OPTIONSTRUCT *Options - Options, MonitorFeed, MonitorSlots and
+                            MonitorStride
+    MAPSIZE *Map          - Information about the basin
+    TOPOPIX **TopoMap     - Basin mask
+    int Dt                - Model time step (s)
+    Channel *Streams      - Stream network, NULL if none
+
+  Returns      : void
+
+  Comments     : The basin cells of the blocks of the coarse maps are
+                 counted once here, the mask does not change during a run
+*****************************************************************************/
+void InitMonitorFeed(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		     int Dt, Channel *Streams)
+{
+#ifdef HAVE_MMAP
+  const char *Routine = "InitMonitorFeed";
+  Channel *Seg;
+  size_t Values;
+  int NBlocks;
+  int x;
+  int y;
+  int i;
+
+  if (IsEmptyStr(Options->MonitorFeed))
+    return;
+
+  strncpy(BaseName, Options->MonitorFeed, BUFSIZE);
+  BaseName[BUFSIZE] = '\0';
+  strcpy(FeedName, BaseName);
+
+  memset(&Layout, 0, sizeof(MONITORHEADER));
+  Layout.Version = MONITOR_VERSION;
+  Layout.NSlots = Options->MonitorSlots;
+  Layout.NTotals = MONITOR_TOTALS;
+  Layout.Dt = Dt;
+  Layout.Fill = NA;
+  for (i = 0; i < MONITOR_TOTALS; i++)
+    strncpy(Layout.TotalNames[i], TotalName[i], MONITOR_NAMELEN - 1);
+  for (Seg = Streams; Seg != NULL; Seg = Seg->next)
+    if (Seg->record)
+      Layout.NSegments++;
+  if (Layout.NSegments > 0) {
+    if (!(Segment = (Channel **) malloc(Layout.NSegments * sizeof(Channel *))))
+      ReportError((char *) Routine, 1);
+    i = 0;
+    for (Seg = Streams; Seg != NULL; Seg = Seg->next)
+      if (Seg->record)
+	Segment[i++] = Seg;
+  }
+
+  Layout.Stride = Options->MonitorStride;
+  if (Layout.Stride > 0) {
+    Layout.NMaps = MONITOR_MAPS;
+    Layout.MapNX = (Map->NX + Layout.Stride - 1) / Layout.Stride;
+    Layout.MapNY = (Map->NY + Layout.Stride - 1) / Layout.Stride;
+    for (i = 0; i < MONITOR_MAPS; i++)
+      strncpy(Layout.MapNames[i], MapName[i], MONITOR_NAMELEN - 1);
+    NBlocks = Layout.MapNX * Layout.MapNY;
+    if (!(BlockCells = (int *) calloc(NBlocks, sizeof(int))) ||
+	!(BlockSum = (double *) malloc(MONITOR_MAPS * NBlocks *
+				       sizeof(double))))
+      ReportError((char *) Routine, 1);
+    for (y = 0; y < Map->NY; y++)
+      for (x = 0; x < Map->NX; x++)
+	if (INBASIN(TopoMap[y][x].Mask))
+	  BlockCells[(y / Layout.Stride) * Layout.MapNX + x / Layout.Stride]++;
+  }
+
+  /* the slots start and end at multiples of MONITOR_ALIGN bytes */
+  Values = MONITOR_TOTALS + Layout.NSegments +
+    (size_t) Layout.NMaps * Layout.MapNX * Layout.MapNY;
+  Layout.SlotBytes = sizeof(MONITORSLOT) + Values * sizeof(float);
+  Layout.SlotBytes = (Layout.SlotBytes + MONITOR_ALIGN - 1) /
+    MONITOR_ALIGN * MONITOR_ALIGN;
+  Layout.SlotStart = sizeof(MONITORHEADER) + Layout.NSegments * sizeof(int);
+  Layout.SlotStart = (Layout.SlotStart + MONITOR_ALIGN - 1) /
+    MONITOR_ALIGN * MONITOR_ALIGN;
+  FeedSize = Layout.SlotStart + Layout.NSlots * Layout.SlotBytes;
+  OpenFeed();
+
+  printf("Monitor feed %s: %d slots of %llu bytes, %d segments",
+	 FeedName, Layout.NSlots, Layout.SlotBytes, Layout.NSegments);
+  if (Layout.NMaps > 0)
+    printf(", maps of %d x %d blocks", Layout.MapNX, Layout.MapNY);
+  printf("\n");
+#endif
+}
+
+/*****************************************************************************
+  Function name: PublishMonitorFeed()
+
+  Purpose      : Put the state after Step time steps in the next slot of
+                 the ring buffer
+
+  Required     :
+    int Step            - Time steps done
+    DATE *Current       - Date of the step in the output files
+    MAPSIZE *Map        - Information about the basin
+    TOPOPIX **TopoMap   - Basin mask
+    SNOWPIX **SnowMap   - Snow of the cells
+    SOILPIX **SoilMap   - Soil of the cells
+    EVAPPIX **EvapMap   - Evapotranspiration of the cells
+    PRECIPPIX **PrecipMap - Precipitation of the cells
+    AGGREGATED *Total   - Basin totals of the step
+
+  Returns      : void
+
+  Comments     : Called after Aggregate() and after the stream routing of
+                 the step has ended
+*****************************************************************************/
+void PublishMonitorFeed(int Step, DATE *Current, MAPSIZE *Map,
+			TOPOPIX **TopoMap, SNOWPIX **SnowMap,
+			SOILPIX **SoilMap, EVAPPIX **EvapMap,
+			PRECIPPIX **PrecipMap, AGGREGATED *Total)
+{
+  MONITORSLOT *Slot;
+  float *Values;
+  double *Sum;
+  int NBlocks;
+  int b;
+  int m;
+  int x;
+  int y;
+  int i;
+
+  if (Feed == NULL)
+    return;
+
+  Sequence++;
+  Slot = (MONITORSLOT *) (Feed + Layout.SlotStart +
+			  ((Sequence - 1) % Layout.NSlots) * Layout.SlotBytes);
+  __atomic_store_n(&(Slot->Seq), 2 * Sequence - 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  Slot->Step = Step;
+  Slot->Full = Total->Full;
+  SPrintDate(Current, Slot->Date);
+  Values = (float *) (Slot + 1);
+  Values[mon_precip] = Total->Precip.Precip;
+  Values[mon_etot] = Total->Evap.ETot;
+  Values[mon_swq] = Total->Snow.Swq;
+  Values[mon_melt] = Total->Snow.Melt;
+  Values[mon_soilwater] = Total->SoilWater;
+  Values[mon_canopywater] = Total->CanopyWater;
+  Values[mon_tabledepth] = Total->Soil.TableDepth;
+  Values[mon_satextent] = Total->SatExtent;
+  Values[mon_runoff] = Total->Soil.Runoff;
+  Values[mon_channelint] = Total->ChannelInt;
+  Values[mon_iexcess] = Total->Soil.IExcess;
+  Values[mon_satflow] = Total->Soil.SatFlow;
+  Values[mon_netrad] = Total->NetRad;
+  Values += MONITOR_TOTALS;
+
+  for (i = 0; i < Layout.NSegments; i++)
+    Values[i] = Segment[i]->route->outflow;
+  Values += Layout.NSegments;
+
+  if (Layout.NMaps > 0) {
+    NBlocks = Layout.MapNX * Layout.MapNY;
+    memset(BlockSum, 0, MONITOR_MAPS * NBlocks * sizeof(double));
+    for (y = 0; y < Map->NY; y++) {
+      for (x = 0; x < Map->NX; x++) {
+	if (!INBASIN(TopoMap[y][x].Mask))
+	  continue;
+	Sum = BlockSum + MONITOR_MAPS *
+	  ((y / Layout.Stride) * Layout.MapNX + x / Layout.Stride);
+	Sum[mon_map_swq] += SnowMap[y][x].Swq;
+	Sum[mon_map_tabledepth] += SoilMap[y][x].TableDepth;
+	Sum[mon_map_etot] += EvapMap[y][x].ETot;
+	Sum[mon_map_precip] += PrecipMap[y][x].Precip;
+      }
+    }
+    for (m = 0; m < MONITOR_MAPS; m++)
+      for (b = 0; b < NBlocks; b++)
+	Values[m * NBlocks + b] = (BlockCells[b] > 0) ?
+	  BlockSum[MONITOR_MAPS * b + m] / BlockCells[b] : Layout.Fill;
+  }
+
+  __atomic_store_n(&(Slot->Seq), 2 * Sequence, __ATOMIC_RELEASE);
+  __atomic_store_n(&(((MONITORHEADER *) Feed)->Latest), Sequence,
+		   __ATOMIC_RELEASE);
+}
+
+/*****************************************************************************
+  Function name: ForkMonitorFeed()
+
+  Purpose      : Called in the child of a fork with the number Branch of
+                 the branch or ensemble member, which continues in a feed
+                 of its own with Branch + 1 appended to the name
+*****************************************************************************/
+void ForkMonitorFeed(int Branch)
+{
+#ifdef HAVE_MMAP
+  if (Feed == NULL)
+    return;
+  munmap(Feed, FeedSize);
+  Feed = NULL;
+  snprintf(FeedName, BUFSIZE + 1, "%s.%d", BaseName, Branch + 1);
+  OpenFeed();
+#endif
+}
+
+/*****************************************************************************
+  Function name: CloseMonitorFeed()
+
+  Purpose      : Unmap the ring buffer at the end of the run.  The file is
+                 kept, so the viewers can read the last steps.
+*****************************************************************************/
+void CloseMonitorFeed(void)
+{
+#ifdef HAVE_MMAP
+  if (Feed != NULL)
+    munmap(Feed, FeedSize);
+#endif
+  Feed = NULL;
+  free(Segment);
+  free(BlockCells);
+  free(BlockSum);
+  Segment = NULL;
+  BlockCells = NULL;
+  BlockSum = NULL;
+}
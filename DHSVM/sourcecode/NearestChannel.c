@@ -0,0 +1,247 @@
+/*
+ * SUMMARY:      NearestChannel.c - Channel cell the impervious runoff drains to
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Finds for each cell of the basin the channel cell its
+ *               impervious runoff is routed to (TOPOPIX drains_y, drains_x),
+ *               either the first channel down its flow path (NEAREST_FLOW),
+ *               or the nearest channel in a straight line
+ *               (NEAREST_DISTANCE).  Used by InitNetwork() with the
+ *               IMPERVIOUS SURFACE ROUTING FILE = FLOW or DISTANCE, and by
+ *               the find_nearest_channel programs that write that file.
+ * DESCRIP-END.
+ * FUNCTIONS:    NearestChannel()
+ *               FlowSearch()
+ *               DistanceTransform()
+ * COMMENTS:     The maps are arrays of NY * NX cells, row by row, with
+ *               Down[] the flow directions as bits (see nearestchannel.h),
+ *               so that DHSVM and the programs, which have their flow
+ *               directions in different forms, can both use it.
+ *
+ *               NEAREST_FLOW is a breadth first search up the flow graph
+ *               from all the channel cells at once: a cell is reached from
+ *               the cell it drains to, so it gets the channel at the end of
+ *               the shortest flow path from it, in O(cells) rather than a
+ *               walk down the path from every cell.  The few cells whose
+ *               flow leaves the basin before it meets a channel get the
+ *               nearest channel in a straight line.
+ *
+ *               NEAREST_DISTANCE is the exact Euclidean distance transform
+ *               of Felzenszwalb and Huttenlocher (2012), keeping the channel
+ *               cell each distance is to: the nearest channel row of each
+ *               column, then the lower envelope of the parabolas of the
+ *               columns along each row, also in O(cells).
+ *
+ *               Without any channel the cells drain to themselves.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include "DHSVMerror.h"
+#include "nearestchannel.h"
+
+const int NearestDX[NEAREST_NDIRS] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+const int NearestDY[NEAREST_NDIRS] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+static int FlowSearch(int NY, int NX, const unsigned char *InBasin,
+		      const unsigned char *Channel, const unsigned char *Down,
+		      int *DrainsY, int *DrainsX);
+static void DistanceTransform(int NY, int NX, const unsigned char *Channel,
+			      int *DrainsY, int *DrainsX);
+
+/*****************************************************************************
+  NearestChannel()
+
+  Fills DrainsY and DrainsX of the cells with InBasin, with the channel
+  cells those with Channel.  Returns the number of cells that have no
+  channel down their flow path (NEAREST_FLOW), which get the nearest one
+  in a straight line instead.
+*****************************************************************************/
+int NearestChannel(int NY, int NX, int Method, const unsigned char *InBasin,
+		   const unsigned char *Channel, const unsigned char *Down,
+		   int *DrainsY, int *DrainsX)
+{
+  const char *Routine = "NearestChannel";
+  int *NearY;
+  int *NearX;
+  int NLost;
+  int i;
+
+  if (Method == NEAREST_DISTANCE) {
+    DistanceTransform(NY, NX, Channel, DrainsY, DrainsX);
+    return 0;
+  }
+
+  NLost = FlowSearch(NY, NX, InBasin, Channel, Down, DrainsY, DrainsX);
+  if (NLost > 0) {
+    if (!(NearY = (int *) calloc((size_t) NY * NX, sizeof(int))) ||
+	!(NearX = (int *) calloc((size_t) NY * NX, sizeof(int))))
+      ReportError((char *) Routine, 1);
+    DistanceTransform(NY, NX, Channel, NearY, NearX);
+    for (i = 0; i < NY * NX; i++) {
+      if (InBasin[i] && DrainsY[i] < 0) {
+	DrainsY[i] = NearY[i];
+	DrainsX[i] = NearX[i];
+      }
+    }
+    free(NearY);
+    free(NearX);
+  }
+  return NLost;
+}
+
+/*****************************************************************************
+  FlowSearch()
+
+  Breadth first search up the flow directions from the channel cells in
+  the basin.  The cells not reached are left at -1.
+*****************************************************************************/
+static int FlowSearch(int NY, int NX, const unsigned char *InBasin,
+		      const unsigned char *Channel, const unsigned char *Down,
+		      int *DrainsY, int *DrainsX)
+{
+  const char *Routine = "FlowSearch";
+  int *Queue;
+  int Head;
+  int Tail;
+  int NLost;
+  int i;
+  int k;
+  int x;
+  int y;
+  int xu;
+  int yu;
+  int u;
+
+  if (!(Queue = (int *) calloc((size_t) NY * NX, sizeof(int))))
+    ReportError((char *) Routine, 1);
+
+  Tail = 0;
+  for (i = 0; i < NY * NX; i++) {
+    DrainsY[i] = -1;
+    DrainsX[i] = -1;
+    if (InBasin[i] && Channel[i]) {
+      DrainsY[i] = i / NX;
+      DrainsX[i] = i % NX;
+      Queue[Tail++] = i;
+    }
+  }
+
+  for (Head = 0; Head < Tail; Head++) {
+    y = Queue[Head] / NX;
+    x = Queue[Head] % NX;
+    /* the neighbors that drain to this cell */
+    for (k = 0; k < NEAREST_NDIRS; k++) {
+      yu = y - NearestDY[k];
+      xu = x - NearestDX[k];
+      if (yu < 0 || yu >= NY || xu < 0 || xu >= NX)
+	continue;
+      u = yu * NX + xu;
+      if (!InBasin[u] || DrainsY[u] >= 0 || !(Down[u] & (1 << k)))
+	continue;
+      DrainsY[u] = DrainsY[Queue[Head]];
+      DrainsX[u] = DrainsX[Queue[Head]];
+      Queue[Tail++] = u;
+    }
+  }
+  free(Queue);
+
+  for (i = 0, NLost = 0; i < NY * NX; i++)
+    if (InBasin[i] && DrainsY[i] < 0)
+      NLost++;
+  return NLost;
+}
+
+/*****************************************************************************
+  DistanceTransform()
+
+  Nearest channel cell of every cell, in a straight line
+*****************************************************************************/
+static void DistanceTransform(int NY, int NX, const unsigned char *Channel,
+			      int *DrainsY, int *DrainsX)
+{
+  const char *Routine = "DistanceTransform";
+  int *Row;			/* nearest channel row in the column, or -1 */
+  int *V;			/* columns of the parabolas of the envelope */
+  double *Z;			/* where they take over */
+  double F;
+  double S;
+  int Next;
+  int j;
+  int k;
+  int q;
+  int x;
+  int y;
+
+  if (!(Row = (int *) calloc((size_t) NY * NX, sizeof(int))) ||
+      !(V = (int *) calloc(NX, sizeof(int))) ||
+      !(Z = (double *) calloc(NX + 1, sizeof(double))))
+    ReportError((char *) Routine, 1);
+
+  /* down and up each column */
+  for (x = 0; x < NX; x++) {
+    for (y = 0, Next = -1; y < NY; y++) {
+      if (Channel[y * NX + x])
+	Next = y;
+      Row[y * NX + x] = Next;
+    }
+    for (y = NY - 1, Next = -1; y >= 0; y--) {
+      if (Channel[y * NX + x])
+	Next = y;
+      if (Next >= 0 && (Row[y * NX + x] < 0 ||
+			Next - y < y - Row[y * NX + x]))
+	Row[y * NX + x] = Next;
+    }
+  }
+
+  /* along each row, the lower envelope of (x - q)^2 + F(q) over the columns
+     q with a channel, F(q) the squared distance to that channel row */
+#define ROWDIST(q) ((double) (y - Row[y * NX + (q)]) * (y - Row[y * NX + (q)]))
+  for (y = 0; y < NY; y++) {
+    k = -1;
+    for (q = 0; q < NX; q++) {
+      if (Row[y * NX + q] < 0)
+	continue;
+      F = ROWDIST(q) + (double) q * q;
+      if (k < 0) {
+	k = 0;
+	V[0] = q;
+	Z[0] = -DBL_MAX;
+	Z[1] = DBL_MAX;
+	continue;
+      }
+      for (;;) {
+	S = (F - (ROWDIST(V[k]) + (double) V[k] * V[k])) / (2.0 * (q - V[k]));
+	if (S > Z[k])
+	  break;
+	k--;
+      }
+      k++;
+      V[k] = q;
+      Z[k] = S;
+      Z[k + 1] = DBL_MAX;
+    }
+
+    for (x = 0, j = 0; x < NX; x++) {
+      if (k < 0) {
+	/* no channel at all */
+	DrainsY[y * NX + x] = y;
+	DrainsX[y * NX + x] = x;
+	continue;
+      }
+      while (Z[j + 1] < x)
+	j++;
+      DrainsY[y * NX + x] = Row[y * NX + V[j]];
+      DrainsX[y * NX + x] = V[j];
+    }
+  }
+#undef ROWDIST
+
+  free(Row);
+  free(V);
+  free(Z);
+}
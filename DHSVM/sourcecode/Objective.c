@@ -0,0 +1,417 @@
+/*
+ * SUMMARY:      Objective.c - Fit of the stream flow to observations
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With an OBSERVED FLOW FILE in the [ROUTING] section the
+ *               Nash-Sutcliffe efficiency, Kling-Gupta efficiency, bias
+ *               and RMSE of the simulated flow of the observed stream
+ *               segments are summed during the run, for calibration runs
+ *               that need no flow output (CHANNEL OUTPUT FORMAT = NONE).
+ *               With an OBJECTIVE THRESHOLD the run is stopped as soon as
+ *               the OBJECTIVE FUNCTION can no longer reach the threshold.
+ *               The fit is written to Objective.txt in the output directory
+ * DESCRIP-END.
+ * FUNCTIONS:    InitObjective()
+ *               UpdateObjective()
+ *               ReportObjective()
+ *               FreeObjective()
+ *               ReadObservedFlow()
+ *               ObjectiveBound()
+ * COMMENTS:     The observed flow file has the layout of Streamflow.Only: a
+ *               header line, which is skipped, and a line for each date
+ *               with a flow for each recorded segment (the SAVE segments of
+ *               the stream network file), in the order of the network and
+ *               in m3 per time step.  A negative flow is a missing
+ *               observation, and dates outside the model period are
+ *               skipped.  The sum of the
+ *               squared errors of a segment only grows during the run, so
+ *               with the squared differences of all its observations from
+ *               their mean, known from the start, it bounds the final NSE
+ *               from above and the final RMSE from below
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "getinit.h"
+#include "fileio.h"
+#include "constants.h"
+#include "memaccount.h"
+
+static void ReadObservedFlow(char *FileName, TIMESTRUCT *Time,
+			     Channel *Streams, OBJECTIVE *Obj);
+static double ObjectiveBound(OBJECTIVE *Obj);
+
+/*****************************************************************************
+  Function name: InitObjective()
+
+  Purpose      : Read the observed flows and the settings of the objective
+                 function.  This information is in the [ROUTING] section
+                 of the input file
+
+  Required     :
+    LISTPTR Input     - Linked list with input strings
+    TIMESTRUCT *Time  - Model period
+    Channel *Streams  - Stream segments
+    OBJECTIVE *Obj    - Objective function to set up
+
+  Returns      : void
+
+  Modifies     : Obj, NSegments is 0 without an OBSERVED FLOW FILE
+
+  Comments     : Segments without at least two different observations in
+                 the model period are left out, since their NSE is not
+                 defined
+*****************************************************************************/
+void InitObjective(LISTPTR Input, TIMESTRUCT *Time, Channel *Streams,
+		   OBJECTIVE *Obj)
+{
+  char *Routine = "InitObjective";
+  char FileName[BUFSIZE + 1];
+  char VarStr[BUFSIZE + 1];
+
+  memset(Obj, 0, sizeof(OBJECTIVE));
+
+  GetInitString("ROUTING", "OBSERVED FLOW FILE", "none", FileName,
+		(unsigned long) BUFSIZE, Input);
+  if (strncmp(FileName, "none", 4) == 0)
+    return;
+  if (Streams == NULL)
+    ReportError("OBSERVED FLOW FILE", 65);
+
+  GetInitString("ROUTING", "OBJECTIVE FUNCTION", "NSE", VarStr,
+		(unsigned long) BUFSIZE, Input);
+  if (strncmp(VarStr, "NSE", 3) == 0)
+    Obj->Function = OBJ_NSE;
+  else if (strncmp(VarStr, "RMSE", 4) == 0)
+    Obj->Function = OBJ_RMSE;
+  else
+    ReportError("OBJECTIVE FUNCTION", 51);
+
+  GetInitString("ROUTING", "OBJECTIVE THRESHOLD", "", VarStr,
+		(unsigned long) BUFSIZE, Input);
+  if (!IsEmptyStr(VarStr)) {
+    if (!CopyFloat(&(Obj->Threshold), VarStr, 1))
+      ReportError("OBJECTIVE THRESHOLD", 51);
+    Obj->HasThreshold = TRUE;
+  }
+
+  ReadObservedFlow(FileName, Time, Streams, Obj);
+
+  if (!(Obj->Sums = (double *) TaggedCalloc((size_t) Obj->NSegments *
+					    NOBJSUMS, sizeof(double),
+					    MEM_OUTPUT)))
+    ReportError(Routine, 1);
+
+  printf("Fitting the flow of %d stream segments to %s", Obj->NSegments,
+	 FileName);
+  if (Obj->HasThreshold)
+    printf(", the run stops when the %s cannot reach %g",
+	   (Obj->Function == OBJ_NSE) ? "NSE" : "RMSE", Obj->Threshold);
+  printf("\n");
+}
+
+/*****************************************************************************
+  Function name: ReadObservedFlow()
+
+  Purpose      : Read the observed flow file into Obj->Observed, keep the
+                 segments with observations, and sum the squared
+                 differences of their observations from the mean
+*****************************************************************************/
+static void ReadObservedFlow(char *FileName, TIMESTRUCT *Time,
+			     Channel *Streams, OBJECTIVE *Obj)
+{
+  char *Routine = "ReadObservedFlow";
+  FILE *InFile;
+  Channel **Column;		/* segment of each column of the file */
+  Channel *Seg;
+  char Token[BUFSIZE + 1];
+  DATE Day;
+  double Step;
+  double Mean;
+  float *Values = NULL;
+  float Value;
+  int NColumns;
+  int Keep;
+  int i;
+  int j;
+  int k;
+  int n;
+
+  OpenFile(&InFile, FileName, "r", FALSE);
+
+  /* a column for each recorded segment */
+  for (NColumns = 0, Seg = Streams; Seg != NULL; Seg = Seg->next)
+    if (Seg->record)
+      NColumns++;
+  if (NColumns == 0)
+    ReportError(FileName, 65);
+  if (!(Column = (Channel **) calloc(NColumns, sizeof(Channel *))))
+    ReportError(Routine, 1);
+  for (j = 0, Seg = Streams; Seg != NULL; Seg = Seg->next)
+    if (Seg->record)
+      Column[j++] = Seg;
+
+  /* the header line */
+  while ((i = fgetc(InFile)) != EOF && i != '\n')
+    ;
+
+  Obj->NSteps = Time->NTotalSteps;
+  if (!(Obj->Observed = (float *) TaggedCalloc((size_t) Obj->NSteps *
+					       NColumns, sizeof(float),
+					       MEM_OUTPUT)) ||
+      !(Values = (float *) calloc(NColumns, sizeof(float))))
+    ReportError(Routine, 1);
+  for (k = 0; k < Obj->NSteps * NColumns; k++)
+    Obj->Observed[k] = NA;
+
+  /* the flows of the dates in the model period */
+  while (fscanf(InFile, "%s", Token) == 1) {
+    if (!SScanDate(Token, &Day))
+      ReportError(FileName, 5);
+    for (j = 0; j < NColumns; j++)
+      if (fscanf(InFile, "%f", &(Values[j])) != 1)
+	ReportError(FileName, 5);
+    Step = (Day.Julian - Time->Start.Julian) * SECPDAY / Time->Dt;
+    k = (int) floor(Step + 0.5);
+    if (k < 0 || k >= Obj->NSteps)
+      continue;
+    if (fabs(Step - k) * Time->Dt > 1.0)
+      ReportError(FileName, 5);
+    for (j = 0; j < NColumns; j++)
+      Obj->Observed[(size_t) k * NColumns + j] = Values[j];
+  }
+  fclose(InFile);
+
+  /* the columns with observations, moved to the front */
+  if (!(Obj->Segment = (Channel **) calloc(NColumns, sizeof(Channel *))) ||
+      !(Obj->TotalSst = (double *) calloc(NColumns, sizeof(double))) ||
+      !(Obj->TotalN = (int *) calloc(NColumns, sizeof(int))))
+    ReportError(Routine, 1);
+  for (j = 0, n = 0; j < NColumns; j++) {
+    Mean = 0.0;
+    Obj->TotalN[n] = 0;
+    for (k = 0; k < Obj->NSteps; k++) {
+      Value = Obj->Observed[(size_t) k * NColumns + j];
+      if (Value >= 0.0) {
+	Mean += Value;
+	Obj->TotalN[n]++;
+      }
+    }
+    if (Obj->TotalN[n] > 0)
+      Mean /= Obj->TotalN[n];
+    Obj->TotalSst[n] = 0.0;
+    for (k = 0; k < Obj->NSteps; k++) {
+      Value = Obj->Observed[(size_t) k * NColumns + j];
+      if (Value >= 0.0)
+	Obj->TotalSst[n] += (Value - Mean) * (Value - Mean);
+    }
+    Keep = (Obj->TotalN[n] > 1 && Obj->TotalSst[n] > 0.0);
+    if (!Keep) {
+      printf("No observed flow variation for segment %d in the model "
+	     "period, it is not fitted\n", Column[j]->id);
+      continue;
+    }
+    Obj->Segment[n] = Column[j];
+    for (k = 0; k < Obj->NSteps; k++)
+      Obj->Observed[(size_t) k * NColumns + n] =
+	Obj->Observed[(size_t) k * NColumns + j];
+    n++;
+  }
+  Obj->NSegments = n;
+
+  /* the rows of Observed hold NSegments values */
+  for (k = 0; k < Obj->NSteps; k++)
+    for (i = 0; i < n; i++)
+      Obj->Observed[(size_t) k * n + i] =
+	Obj->Observed[(size_t) k * NColumns + i];
+
+  if (n == 0)
+    ReportError(FileName, 5);
+
+  free(Column);
+  free(Values);
+}
+
+/*****************************************************************************
+  Function name: UpdateObjective()
+
+  Purpose      : Add the simulated and observed flows of the time step to
+                 the sums
+
+  Required     :
+    TIMESTRUCT *Time  - Model time, Time->Step is the step that was routed
+    OBJECTIVE *Obj    - Objective function
+
+  Returns      : int, TRUE if the OBJECTIVE THRESHOLD can no longer be
+                 reached, and the run is to be stopped
+
+  Modifies     : Obj
+*****************************************************************************/
+int UpdateObjective(TIMESTRUCT *Time, OBJECTIVE *Obj)
+{
+  double *Sums;
+  double Sim;
+  double Obs;
+  int i;
+
+  if (Time->Step < 0 || Time->Step >= Obj->NSteps)
+    return FALSE;
+
+  for (i = 0; i < Obj->NSegments; i++) {
+    Obs = Obj->Observed[(size_t) Time->Step * Obj->NSegments + i];
+    if (Obs < 0.0)
+      continue;
+    Sim = Obj->Segment[i]->route->outflow;
+    Sums = Obj->Sums + (size_t) i * NOBJSUMS;
+    Sums[obj_n] += 1.0;
+    Sums[obj_obs] += Obs;
+    Sums[obj_sim] += Sim;
+    Sums[obj_obs2] += Obs * Obs;
+    Sums[obj_sim2] += Sim * Sim;
+    Sums[obj_obssim] += Obs * Sim;
+    Sums[obj_sse] += (Sim - Obs) * (Sim - Obs);
+  }
+
+  if (!Obj->HasThreshold)
+    return FALSE;
+  if (Obj->Function == OBJ_NSE)
+    Obj->Terminated = (ObjectiveBound(Obj) < Obj->Threshold);
+  else
+    Obj->Terminated = (ObjectiveBound(Obj) > Obj->Threshold);
+  return Obj->Terminated;
+}
+
+/*****************************************************************************
+  Function name: ObjectiveBound()
+
+  Purpose      : Best OBJECTIVE FUNCTION the run can still reach: the mean
+                 over the segments of the NSE with the squared errors so far
+                 and the squared differences of all the observations from
+                 their mean, or of the RMSE with the squared errors so far
+                 and the number of all the observations
+*****************************************************************************/
+static double ObjectiveBound(OBJECTIVE *Obj)
+{
+  double Bound = 0.0;
+  double Sse;
+  int i;
+
+  for (i = 0; i < Obj->NSegments; i++) {
+    Sse = Obj->Sums[(size_t) i * NOBJSUMS + obj_sse];
+    if (Obj->Function == OBJ_NSE)
+      Bound += 1.0 - Sse / Obj->TotalSst[i];
+    else
+      Bound += sqrt(Sse / Obj->TotalN[i]);
+  }
+  return Bound / Obj->NSegments;
+}
+
+/*****************************************************************************
+  Function name: ReportObjective()
+
+  Purpose      : Write the fit of each segment and the mean over the
+                 segments to Objective.txt in the output directory
+
+  Required     :
+    char *Path        - Output directory
+    DATE *Current     - Model time at the end of the run
+    OBJECTIVE *Obj    - Objective function
+
+  Returns      : void
+
+  Comments     : The bias is the relative difference of the simulated and
+                 observed volume (%).  The KGE is the one of Gupta et al.
+                 (2009), with the ratio of the standard deviations
+*****************************************************************************/
+void ReportObjective(char *Path, DATE *Current, OBJECTIVE *Obj)
+{
+  FILE *OutFile;
+  char FileName[BUFSIZE + 1];
+  double *Sums;
+  double N;
+  double MeanObs;
+  double MeanSim;
+  double VarObs;
+  double VarSim;
+  double Cov;
+  double R;
+  double Fit[4];		/* NSE, KGE, bias and RMSE */
+  double Mean[4];
+  int i;
+  int j;
+
+  sprintf(FileName, "%sObjective.txt", Path);
+  OpenFile(&OutFile, FileName, "w", TRUE);
+
+  fprintf(OutFile, "%10s %8s %12s %12s %12s %12s\n", "Segment", "N", "NSE",
+	  "KGE", "Bias(%)", "RMSE");
+  for (j = 0; j < 4; j++)
+    Mean[j] = 0.0;
+  for (i = 0; i < Obj->NSegments; i++) {
+    Sums = Obj->Sums + (size_t) i * NOBJSUMS;
+    N = Sums[obj_n];
+    for (j = 0; j < 4; j++)
+      Fit[j] = NA;
+    if (N > 0.0) {
+      MeanObs = Sums[obj_obs] / N;
+      MeanSim = Sums[obj_sim] / N;
+      VarObs = Sums[obj_obs2] / N - MeanObs * MeanObs;
+      VarSim = Sums[obj_sim2] / N - MeanSim * MeanSim;
+      Cov = Sums[obj_obssim] / N - MeanObs * MeanSim;
+      if (VarObs > 0.0)
+	Fit[0] = 1.0 - Sums[obj_sse] / (N * VarObs);
+      if (VarObs > 0.0 && VarSim > 0.0 && MeanObs > 0.0) {
+	R = Cov / sqrt(VarObs * VarSim);
+	Fit[1] = 1.0 - sqrt((R - 1.0) * (R - 1.0) +
+			    (sqrt(VarSim / VarObs) - 1.0) *
+			    (sqrt(VarSim / VarObs) - 1.0) +
+			    (MeanSim / MeanObs - 1.0) *
+			    (MeanSim / MeanObs - 1.0));
+      }
+      if (Sums[obj_obs] > 0.0)
+	Fit[2] = 100.0 * (Sums[obj_sim] - Sums[obj_obs]) / Sums[obj_obs];
+      Fit[3] = sqrt(Sums[obj_sse] / N);
+    }
+    fprintf(OutFile, "%10d %8.0f %12.5g %12.5g %12.5g %12.5g\n",
+	    Obj->Segment[i]->id, N, Fit[0], Fit[1], Fit[2], Fit[3]);
+    for (j = 0; j < 4; j++)
+      Mean[j] += Fit[j] / Obj->NSegments;
+  }
+  fprintf(OutFile, "%10s %8s %12.5g %12.5g %12.5g %12.5g\n", "Mean", "",
+	  Mean[0], Mean[1], Mean[2], Mean[3]);
+
+  if (Obj->Terminated) {
+    fprintf(OutFile, "Stopped at ");
+    PrintDate(Current, OutFile);
+    fprintf(OutFile, ", the %s cannot reach %g\n",
+	    (Obj->Function == OBJ_NSE) ? "NSE" : "RMSE", Obj->Threshold);
+  }
+  if (fclose(OutFile) != 0)
+    ReportError(FileName, 72);
+
+  printf("Mean NSE %g, KGE %g, bias %g%%, RMSE %g of the observed segments%s\n",
+	 Mean[0], Mean[1], Mean[2], Mean[3],
+	 Obj->Terminated ? " (run stopped early)" : "");
+}
+
+/*****************************************************************************
+  Function name: FreeObjective()
+*****************************************************************************/
+void FreeObjective(OBJECTIVE *Obj)
+{
+  TaggedFree(Obj->Observed);
+  TaggedFree(Obj->Sums);
+  free(Obj->Segment);
+  free(Obj->TotalSst);
+  free(Obj->TotalN);
+  memset(Obj, 0, sizeof(OBJECTIVE));
+}
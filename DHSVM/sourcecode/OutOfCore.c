@@ -0,0 +1,102 @@
+/*
+ * SUMMARY:      OutOfCore.c - Data kept in memory mapped scratch files
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS OUT OF CORE DIRECTORY the large static data of
+ *               a basin are kept in scratch files in that directory that
+ *               are mapped into memory, instead of in allocated memory.
+ *               The system then holds only the pages that are in use, and
+ *               writes the others back to the file when the memory is
+ *               needed.  The model tells it which pages it uses next
+ *               (AdviseScratch()), so that they are read in while the step
+ *               before is run.
+ * DESCRIP-END.
+ * FUNCTIONS:    MapScratch()
+ *               UnmapScratch()
+ *               AdviseScratch()
+ * COMMENTS:     The scratch file is removed as soon as it is mapped, so it
+ *               does not outlive the run.  HAVE_MMAP has to be defined
+ *               during the build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "DHSVMerror.h"
+#include "outofcore.h"
+
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+/*****************************************************************************
+  MapScratch()
+
+  Returns Size bytes of zeros in a new scratch file of the directory Dir,
+  of which Name is a part of the file name
+*****************************************************************************/
+void *MapScratch(char *Dir, const char *Name, size_t Size)
+{
+#ifdef HAVE_MMAP
+  const char *Routine = "MapScratch";
+  char FileName[BUFSIZE + 1];
+  void *Data;
+  size_t Len;
+  int fd;
+
+  Len = strlen(Dir);
+  snprintf(FileName, BUFSIZE + 1, "%s%sDHSVM.%s.%ld", Dir,
+	   (Len > 0 && Dir[Len - 1] != '/') ? "/" : "", Name, (long) getpid());
+  if ((fd = open(FileName, O_RDWR | O_CREAT | O_TRUNC, 0600)) < 0)
+    ReportError(FileName, 3);
+  if (ftruncate(fd, (off_t) Size) != 0)
+    ReportError(FileName, 72);
+  Data = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  unlink(FileName);
+  if (Data == MAP_FAILED)
+    ReportError((char *) Routine, 1);
+  return Data;
+#else
+  ReportError((char *) Dir, 65);
+  return NULL;
+#endif
+}
+
+/*****************************************************************************
+  UnmapScratch()
+*****************************************************************************/
+void UnmapScratch(void *Data, size_t Size)
+{
+#ifdef HAVE_MMAP
+  if (Data != NULL)
+    munmap(Data, Size);
+#endif
+}
+
+/*****************************************************************************
+  AdviseScratch()
+
+  With Need TRUE, starts to read the Size bytes of the scratch data at Data
+  into memory, and with Need FALSE, lets the system drop them from the
+  memory of the run.  The whole pages that hold the bytes are advised.
+*****************************************************************************/
+void AdviseScratch(void *Data, size_t Size, int Need)
+{
+#ifdef HAVE_MMAP
+  size_t Page = (size_t) sysconf(_SC_PAGESIZE);
+  size_t Start = (size_t) Data & ~(Page - 1);
+  size_t End = ((size_t) Data + Size + Page - 1) & ~(Page - 1);
+
+  if (Data == NULL || Size == 0)
+    return;
+  /* a dropped page of a shared file mapping is read back from the file */
+  madvise((void *) Start, End - Start, Need ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+}
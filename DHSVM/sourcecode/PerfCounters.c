@@ -0,0 +1,258 @@
+/*
+ * SUMMARY:      PerfCounters.c - Hardware event counters of the threads
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Opens the Linux perf_event counters of the cycles, the
+ *               instructions, the last level cache references and misses
+ *               and, with OPTIONS PERF VECTOR EVENTS, the scalar and packed
+ *               floating point instructions, in the main thread and in
+ *               each OpenMP thread.  The profiler (Profile.c) reads them at
+ *               the start and end of each phase and reports the IPC, the
+ *               cache misses and bytes per cell and the vector ratio of
+ *               the phases.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitPerfCounters()
+ *               OpenThreadCounters()
+ *               PerfEventCounted()
+ *               ReadPerfCounters()
+ *               ClosePerfCounters()
+ * COMMENTS:     Only the user space events of the process are counted,
+ *               which kernel.perf_event_paranoid = 2 (the default) allows.
+ *               Without access, or outside Linux, the run goes on without
+ *               counters after a warning.
+ *
+ *               The counts are those of the threads that run the cell
+ *               loops; the thread that writes the output maps (OUTPUT
+ *               QUEUE SIZE) is not counted.  When the kernel multiplexes
+ *               more events than the processor has counters, the counts
+ *               are scaled by the fraction of the time they were counted.
+ *
+ *               The codes of the floating point instructions depend on the
+ *               processor.  On Intel processors since Broadwell they are
+ *               the FP_ARITH_INST_RETIRED event 0xc7 with the unit masks of
+ *               the scalar (0x03) and the packed (0xfc) instructions:
+ *
+ *                 PERF VECTOR EVENTS = 0x03c7 0xfcc7
+ *
+ *               and on AMD Zen the retired SSE/AVX operations, 0x03 with
+ *               the unit masks of the scalar and packed operations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "perfcounters.h"
+
+#ifdef HAVE_PERF_EVENT
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+#ifdef HAVE_PERF_EVENT
+
+static int NThreads = 0;
+static int (*Fd)[NPERFEVENTS] = NULL;	/* counters of each thread, -1 if
+					   not open */
+static int Counted[NPERFEVENTS];	/* TRUE if the event is counted in all
+					   threads */
+
+static int OpenThreadCounters(OPTIONSTRUCT *Options, int *ThreadFd);
+
+/*****************************************************************************
+  InitPerfCounters()
+
+  Returns TRUE if at least the cycles and instructions are counted
+*****************************************************************************/
+int InitPerfCounters(OPTIONSTRUCT *Options)
+{
+  const char *Routine = "InitPerfCounters";
+  int Errno = 0;
+  int i;
+  int j;
+
+  NThreads = (Options->NThreads > 1) ? Options->NThreads : 1;
+  if (!(Fd = calloc(NThreads, sizeof(*Fd))))
+    ReportError((char *) Routine, 1);
+  for (j = 0; j < NPERFEVENTS; j++)
+    Counted[j] = TRUE;
+
+  /* each thread opens its own counters, the threads of the OpenMP pool are
+     the same in all cell loops */
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(NThreads) private(i) reduction(max:Errno)
+#endif
+  {
+    i = 0;
+#ifdef HAVE_OPENMP
+    i = omp_get_thread_num();
+#endif
+    Errno = OpenThreadCounters(Options, Fd[i]);
+  }
+
+  for (i = 0; i < NThreads; i++)
+    for (j = 0; j < NPERFEVENTS; j++)
+      if (Fd[i][j] < 0)
+	Counted[j] = FALSE;
+
+  if (!Counted[PERF_CYCLES] || !Counted[PERF_INSTRUCTIONS]) {
+    printf("WARNING: no hardware counters (%s), see "
+	   "kernel.perf_event_paranoid\n", strerror(Errno));
+    ClosePerfCounters();
+    return FALSE;
+  }
+  if (!Counted[PERF_LLC_REFS] || !Counted[PERF_LLC_MISSES])
+    printf("WARNING: the last level cache events are not counted\n");
+  if (Options->PerfScalarEvent != 0 &&
+      (!Counted[PERF_SCALAR_FP] || !Counted[PERF_VECTOR_FP]))
+    printf("WARNING: PERF VECTOR EVENTS are not counted\n");
+  if (!Counted[PERF_SCALAR_FP] || !Counted[PERF_VECTOR_FP])
+    Counted[PERF_SCALAR_FP] = Counted[PERF_VECTOR_FP] = FALSE;
+
+  printf("Counting hardware events in %d thread%s\n", NThreads,
+	 (NThreads > 1) ? "s" : "");
+  return TRUE;
+}
+
+/*****************************************************************************
+  OpenThreadCounters()
+
+  Opens the counters of the calling thread, returns 0 or the errno of the
+  first counter that could not be opened
+*****************************************************************************/
+static int OpenThreadCounters(OPTIONSTRUCT *Options, int *ThreadFd)
+{
+  struct perf_event_attr Attr;
+  int Errno = 0;
+  int j;
+
+  for (j = 0; j < NPERFEVENTS; j++) {
+    memset(&Attr, 0, sizeof(Attr));
+    Attr.size = sizeof(Attr);
+    Attr.exclude_kernel = 1;
+    Attr.exclude_hv = 1;
+    Attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+      PERF_FORMAT_TOTAL_TIME_RUNNING;
+    switch (j) {
+    case PERF_CYCLES:
+      Attr.type = PERF_TYPE_HARDWARE;
+      Attr.config = PERF_COUNT_HW_CPU_CYCLES;
+      break;
+    case PERF_INSTRUCTIONS:
+      Attr.type = PERF_TYPE_HARDWARE;
+      Attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+      break;
+    case PERF_LLC_REFS:
+      Attr.type = PERF_TYPE_HARDWARE;
+      Attr.config = PERF_COUNT_HW_CACHE_REFERENCES;
+      break;
+    case PERF_LLC_MISSES:
+      Attr.type = PERF_TYPE_HARDWARE;
+      Attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      break;
+    case PERF_SCALAR_FP:
+      Attr.type = PERF_TYPE_RAW;
+      Attr.config = Options->PerfScalarEvent;
+      break;
+    case PERF_VECTOR_FP:
+      Attr.type = PERF_TYPE_RAW;
+      Attr.config = Options->PerfVectorEvent;
+      break;
+    }
+    ThreadFd[j] = -1;
+    if (Attr.type == PERF_TYPE_RAW && Attr.config == 0)
+      continue;
+    ThreadFd[j] = (int) syscall(SYS_perf_event_open, &Attr, 0, -1, -1, 0);
+    if (ThreadFd[j] < 0 && Errno == 0)
+      Errno = errno;
+  }
+  return Errno;
+}
+
+/*****************************************************************************
+  PerfEventCounted()
+*****************************************************************************/
+int PerfEventCounted(int Event)
+{
+  return Fd != NULL && Counted[Event];
+}
+
+/*****************************************************************************
+  ReadPerfCounters()
+
+  Counts of all threads since the counters were opened, scaled for the
+  multiplexing, 0 for the events that are not counted
+*****************************************************************************/
+void ReadPerfCounters(double *Counts)
+{
+  unsigned long long Value[3];	/* count, time enabled, time running */
+  int i;
+  int j;
+
+  for (j = 0; j < NPERFEVENTS; j++) {
+    Counts[j] = 0.0;
+    if (Fd == NULL || !Counted[j])
+      continue;
+    for (i = 0; i < NThreads; i++)
+      if (read(Fd[i][j], Value, sizeof(Value)) == sizeof(Value) &&
+	  Value[2] > 0)
+	Counts[j] += (double) Value[0] * ((double) Value[1] / Value[2]);
+  }
+}
+
+/*****************************************************************************
+  ClosePerfCounters()
+*****************************************************************************/
+void ClosePerfCounters(void)
+{
+  int i;
+  int j;
+
+  if (Fd == NULL)
+    return;
+  for (i = 0; i < NThreads; i++)
+    for (j = 0; j < NPERFEVENTS; j++)
+      if (Fd[i][j] >= 0)
+	close(Fd[i][j]);
+  free(Fd);
+  Fd = NULL;
+}
+
+#else
+
+int InitPerfCounters(OPTIONSTRUCT *Options)
+{
+  printf("WARNING: PERF COUNTERS needs a build with HAVE_PERF_EVENT\n");
+  return FALSE;
+}
+
+int PerfEventCounted(int Event)
+{
+  return FALSE;
+}
+
+void ReadPerfCounters(double *Counts)
+{
+  int j;
+
+  for (j = 0; j < NPERFEVENTS; j++)
+    Counts[j] = 0.0;
+}
+
+void ClosePerfCounters(void)
+{
+}
+
+#endif
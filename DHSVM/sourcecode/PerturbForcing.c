@@ -0,0 +1,171 @@
+/*
+ * SUMMARY:      PerturbForcing.c - Random perturbation of the station forcing
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Perturbs the precipitation, air temperature and incoming
+ *               shortwave radiation of the stations as they are read, so
+ *               that the members of an ensemble can be driven by one set of
+ *               forcing files.  The precipitation and the shortwave are
+ *               multiplied by a lognormal factor with a mean of one, the
+ *               temperature is offset.  The perturbations are AR(1) series
+ *               in time, and are correlated between the stations through a
+ *               part shared by all of them.
+ * DESCRIP-END.
+ * FUNCTIONS:    PerturbMetData()
+ *               Mix()
+ *               Normal()
+ *               Series()
+ * COMMENTS:     The random numbers are a hash (splitmix64) of the seed, the
+ *               member, the station, the variable and the time step of the
+ *               run, counted from the Julian date, rather than the draws of
+ *               a generator.  The perturbation of a step does not depend on
+ *               the steps the process has run, so a member gets the same
+ *               forcing after a restart, a resume, a spin-up cycle or
+ *               dhsvm_restore(), and with any number of threads.  The AR(1)
+ *               series is the sum of the innovations of the last steps
+ *               weighted with the powers of the autocorrelation, as far as
+ *               they exceed PERTURB_CUTOFF, and scaled to unit variance.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "settings.h"
+#include "data.h"
+#include "constants.h"
+#include "Calendar.h"
+#include "functions.h"
+
+/* variables perturbed */
+enum PERTURBVAR { perturb_precip = 1, perturb_temp, perturb_radiation };
+
+/* smallest weight of an innovation of an earlier step in the AR(1) series,
+   and the most steps the series goes back */
+#define PERTURB_CUTOFF 1e-3
+#define PERTURB_MAXLAG 512
+
+/*****************************************************************************
+  Function name: Mix()
+
+  Purpose      : Add Value to the hash Key (splitmix64)
+*****************************************************************************/
+static unsigned long long Mix(unsigned long long Key, unsigned long long Value)
+{
+  unsigned long long z = Key + (Value + 1) * 0x9E3779B97F4A7C15ULL;
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/*****************************************************************************
+  Function name: Normal()
+
+  Purpose      : Standard normal random number of the hash Key (Box-Muller)
+*****************************************************************************/
+static double Normal(unsigned long long Key)
+{
+  double u1 = ((double) (Mix(Key, 0) >> 11) + 0.5) / 9007199254740992.0;
+  double u2 = (double) (Mix(Key, 1) >> 11) / 9007199254740992.0;
+
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2);
+}
+
+/*****************************************************************************
+  Function name: Series()
+
+  Purpose      : Value of the AR(1) series with unit variance of the hash Key
+                 at time step Step
+
+  Required     :
+    unsigned long long Key - Hash of the seed, member, station and variable
+    long long Step         - Time step, counted from the Julian date
+    int NLags              - Innovations summed
+    double Lag             - Lag one autocorrelation
+*****************************************************************************/
+static double Series(unsigned long long Key, long long Step, int NLags,
+		     double Lag)
+{
+  double Sum = 0.0;
+  double SumSq = 0.0;
+  double Weight = 1.0;
+  int k;
+
+  for (k = 0; k < NLags; k++) {
+    Sum += Weight * Normal(Mix(Key, (unsigned long long) (Step - k)));
+    SumSq += Weight * Weight;
+    Weight *= Lag;
+  }
+  return Sum / sqrt(SumSq);
+}
+
+/*****************************************************************************
+  Function name: PerturbMetData()
+
+  Purpose      : Perturb the forcing of the stations of the current time step
+                 for ensemble member Options->Member
+
+  Required     :
+    OPTIONSTRUCT *Options - ENSEMBLE ... PERTURBATION options
+    TIMESTRUCT *Time      - Current time step
+    int NStats            - Number of stations
+    METLOCATION *Stat     - Stations, with the forcing of the step read
+
+  Modifies     : Precip, Tair and Sin of each station
+
+  Comments     : Called by GetMetData() after the records are read, before
+                 the shortwave is split into beam and diffuse radiation.
+                 Does nothing if all the standard deviations are 0, so the
+                 forcing is the one of the files
+*****************************************************************************/
+void PerturbMetData(OPTIONSTRUCT *Options, TIMESTRUCT *Time, int NStats,
+		    METLOCATION *Stat)
+{
+  const float Sd[] = { 0.0, Options->PerturbPrecip, Options->PerturbTemp,
+    Options->PerturbRadiation };
+  unsigned long long Member;	/* hash of the seed and the member */
+  long long Step;		/* time step, counted from the Julian date */
+  double Lag = Options->PerturbLag;
+  double Shared;		/* perturbation shared by the stations */
+  double e;			/* perturbation of a station */
+  double Weight;
+  int NLags;			/* steps of the AR(1) series */
+  int i;
+  int v;
+
+  if (Sd[perturb_precip] == 0.0 && Sd[perturb_temp] == 0.0 &&
+      Sd[perturb_radiation] == 0.0)
+    return;
+
+  for (NLags = 1, Weight = Lag;
+       NLags < PERTURB_MAXLAG && Weight > PERTURB_CUTOFF; NLags++)
+    Weight *= Lag;
+  Step = (long long) floor(Time->Current.Julian * SECPDAY / Time->Dt + 0.5);
+  Member = Mix(Mix(0, (unsigned long long) Options->PerturbSeed),
+	       (unsigned long long) Options->Member);
+
+  for (v = perturb_precip; v <= perturb_radiation; v++) {
+    if (Sd[v] == 0.0)
+      continue;
+    Shared = Series(Mix(Mix(Member, v), 0), Step, NLags, Lag);
+    for (i = 0; i < NStats; i++) {
+      e = sqrt(Options->PerturbShared) * Shared +
+	sqrt(1.0 - Options->PerturbShared) *
+	Series(Mix(Mix(Member, v), i + 1), Step, NLags, Lag);
+      switch (v) {
+      case perturb_precip:
+	Stat[i].Data.Precip *= exp(Sd[v] * e - 0.5 * Sd[v] * Sd[v]);
+	break;
+      case perturb_temp:
+	Stat[i].Data.Tair += Sd[v] * e;
+	break;
+      default:
+	Stat[i].Data.Sin *= exp(Sd[v] * e - 0.5 * Sd[v] * Sd[v]);
+	break;
+      }
+    }
+  }
+}
@@ -0,0 +1,524 @@
+/*
+ * SUMMARY:      Profile.c - Wall clock and CPU time of the time loop phases
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Times the phases of each time step (see profile.h) with
+ *               OPTIONS PROFILE = TRUE, and reports the totals, the
+ *               distribution of the time per step and the throughput at the
+ *               end of the run
+ * DESCRIP-END.
+ * FUNCTIONS:    WallClock()
+ *               CpuClock()
+ *               InitProfile()
+ *               ProfileBegin()
+ *               ProfileEnd()
+ *               ProfileBeginStep()
+ *               ProfileEndStep()
+ *               ProfileReport()
+ *               ProfileTimes()
+ *               ProfilePhaseName()
+ *               StartupStage()
+ *               StartupTask()
+ *               ReportStartup()
+ *               ReportPerfCounters()
+ *               Percentile()
+ *               CompareFloat()
+ * COMMENTS:     The wall clock is monotonic.  The CPU time is that of the
+ *               whole process, so it includes all the threads, and CPU/wall
+ *               close to NUMBER OF THREADS means the threads were busy.
+ *
+ *               The time of each phase in each step is kept, so that the
+ *               percentiles show if a phase is slow in a few steps (reading
+ *               a new month, writing a dump) or in all of them.  Steps in
+ *               which a phase does not run are left out of its percentiles.
+ *
+ *               With OPTIONS TRACE FILE each phase and step is also a span
+ *               in the trace (Trace.c).
+ *
+ *               With OPTIONS PERF COUNTERS = TRUE the hardware events of
+ *               each phase are counted as well (PerfCounters.c), and the
+ *               report gives the instructions per cycle, the last level
+ *               cache misses, the bytes they move per active cell and the
+ *               share of the packed floating point instructions.  A phase
+ *               with a low IPC and many bytes per cell is limited by the
+ *               memory rather than by the computations.
+ *
+ *               The initialization is timed as well, in stages that end at
+ *               each call of StartupStage() in dhsvm_initialize(), and with
+ *               OPTIONS PROFILE = TRUE the stages are reported before the
+ *               time loop.  The tasks that run next to the stages with
+ *               PARALLEL INITIALIZATION (InitTasks.c) are reported with
+ *               their own run time, and the stage in which the main thread
+ *               waits for them shows what the concurrency did not hide.
+ *
+ *               The phases are timed in the main thread only.  The
+ *               subsurface routing includes the met records read at the same
+ *               time with PREFETCH MET.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "profile.h"
+#include "perfcounters.h"
+#include "trace.h"
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+/*****************************************************************************
+  WallClock()
+
+  Monotonic wall clock time (s) from an arbitrary start
+*****************************************************************************/
+double WallClock(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (double) Now.tv_sec + 1e-9 * Now.tv_nsec;
+#elif defined(HAVE_OPENMP)
+  return omp_get_wtime();
+#else
+  return (double) time(NULL);
+#endif
+}
+
+/*****************************************************************************
+  CpuClock()
+
+  CPU time (s) used by all threads of the process
+*****************************************************************************/
+double CpuClock(void)
+{
+#if defined(CLOCK_PROCESS_CPUTIME_ID)
+  struct timespec Now;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &Now);
+  return (double) Now.tv_sec + 1e-9 * Now.tv_nsec;
+#else
+  return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+#ifdef HAVE_PROFILE
+
+int ProfileOn = FALSE;
+
+static const char *PhaseName[NPHASES] = {
+  "InitNewMonth", "InitNewStep", "Met/energy pixels", "RouteSubSurface",
+  "RouteChannel", "RouteSurface", "draw", "Aggregate", "MassBalance",
+  "ExecDump"
+};
+
+static int Report = FALSE;		/* TRUE with OPTIONS PROFILE or PERF
+					   COUNTERS */
+static int PerfOn = FALSE;		/* TRUE if the hardware events are
+					   counted */
+static int NCells = 0;			/* active cells of the basin */
+static double Events[NPHASES + 1][NPERFEVENTS];	/* events of each phase
+						   and of all steps */
+static double PhaseEvents[NPERFEVENTS];	/* counts at the start of the
+					   running phase */
+static double StepEvents[NPERFEVENTS];	/* and of the running step */
+static long Calls[NPHASES];		/* number of times each phase ran */
+static double Wall[NPHASES];		/* wall clock time of each phase (s) */
+static double Cpu[NPHASES];		/* CPU time of each phase (s) */
+static double PhaseWall;		/* start of the running phase */
+static double PhaseCpu;
+static double PhaseSpan;		/* start of the running phase in the
+					   trace (see trace.h) */
+static double StepWall;			/* start of the running step */
+static double StepCpu;
+static double StepSpan;
+static double LoopWall;			/* wall clock time of all steps (s) */
+static double LoopCpu;			/* CPU time of all steps (s) */
+static float ThisStep[NPHASES + 1];	/* time of each phase in the running
+					   step, -1 if it did not run */
+static float *History = NULL;		/* ThisStep of each step */
+static int NSteps = 0;			/* steps in History */
+static int MaxSteps = 0;		/* steps that fit in History */
+
+/* stages of the initialization */
+#define MAXSTAGES 48
+static struct {
+  const char *Name;
+  double Wall;				/* wall clock time (s) */
+  double Cpu;				/* CPU time of the process (s) */
+  int Task;				/* TRUE for a task of InitTasks.c */
+  int Concurrent;			/* TRUE if the task ran in a thread of
+					   its own */
+} Stage[MAXSTAGES];
+static int NStages = 0;
+static double StageWall = -1.0;		/* end of the previous stage */
+static double StageCpu;
+static double StageSpan;
+
+static void ReportPerfCounters(void);
+static void ReportStartup(void);
+static float Percentile(float *Sorted, int N, float P);
+static int CompareFloat(const void *a, const void *b);
+
+/*****************************************************************************
+  InitProfile()
+
+  Turns the profiler on with OPTIONS PROFILE.  NSteps is the number of time
+  steps of the run, the history grows if more steps are done (dhsvm_restore)
+*****************************************************************************/
+void InitProfile(OPTIONSTRUCT *Options, MAPSIZE *Map, int Steps)
+{
+  const char *Routine = "InitProfile";
+
+  ProfileOn = Options->Profile || Options->PerfCounters ||
+    Options->TraceFile[0] != '\0' || Options->TelemetryFile[0] != '\0';
+  if (!ProfileOn)
+    return;
+  Report = Options->Profile || Options->PerfCounters;
+  PerfOn = Options->PerfCounters && InitPerfCounters(Options);
+  NCells = Map->NumActive;
+  memset(Events, 0, sizeof(Events));
+
+  MaxSteps = (Steps > 0) ? Steps : 1;
+  if (!(History = (float *) calloc((size_t) MaxSteps * (NPHASES + 1),
+				   sizeof(float))))
+    ReportError((char *) Routine, 1);
+  NSteps = 0;
+  memset(Calls, 0, sizeof(Calls));
+  memset(Wall, 0, sizeof(Wall));
+  memset(Cpu, 0, sizeof(Cpu));
+  LoopWall = 0.0;
+  LoopCpu = 0.0;
+
+  if (Options->Profile)
+    ReportStartup();
+}
+
+/*****************************************************************************
+  ProfileBegin()
+*****************************************************************************/
+void ProfileBegin(int Phase)
+{
+  if (PerfOn)
+    ReadPerfCounters(PhaseEvents);
+  PhaseWall = WallClock();
+  PhaseCpu = CpuClock();
+  PhaseSpan = TRACE_BEGIN();
+}
+
+/*****************************************************************************
+  ProfileEnd()
+*****************************************************************************/
+void ProfileEnd(int Phase)
+{
+  double DWall = WallClock() - PhaseWall;
+  double Counts[NPERFEVENTS];
+  int j;
+
+  Wall[Phase] += DWall;
+  Cpu[Phase] += CpuClock() - PhaseCpu;
+  Calls[Phase]++;
+  if (PerfOn) {
+    ReadPerfCounters(Counts);
+    for (j = 0; j < NPERFEVENTS; j++)
+      Events[Phase][j] += Counts[j] - PhaseEvents[j];
+  }
+  if (ThisStep[Phase] < 0.0)
+    ThisStep[Phase] = 0.0;
+  ThisStep[Phase] += (float) DWall;
+  TraceEnd(PhaseSpan, PhaseName[Phase], "phase", NULL, -1.0);
+}
+
+/*****************************************************************************
+  ProfileBeginStep()
+*****************************************************************************/
+void ProfileBeginStep(void)
+{
+  int i;
+
+  for (i = 0; i < NPHASES; i++)
+    ThisStep[i] = -1.0;
+  if (PerfOn)
+    ReadPerfCounters(StepEvents);
+  StepWall = WallClock();
+  StepCpu = CpuClock();
+  StepSpan = TRACE_BEGIN();
+}
+
+/*****************************************************************************
+  ProfileEndStep()
+*****************************************************************************/
+void ProfileEndStep(void)
+{
+  const char *Routine = "ProfileEndStep";
+  double DWall = WallClock() - StepWall;
+  double Counts[NPERFEVENTS];
+  int j;
+
+  if (PerfOn) {
+    ReadPerfCounters(Counts);
+    for (j = 0; j < NPERFEVENTS; j++)
+      Events[NPHASES][j] += Counts[j] - StepEvents[j];
+  }
+  LoopWall += DWall;
+  LoopCpu += CpuClock() - StepCpu;
+  ThisStep[NPHASES] = (float) DWall;
+  TraceEnd(StepSpan, "time step", "step", NULL, -1.0);
+
+  if (NSteps == MaxSteps) {
+    MaxSteps *= 2;
+    if (!(History = (float *) realloc(History, (size_t) MaxSteps *
+				      (NPHASES + 1) * sizeof(float))))
+      ReportError((char *) Routine, 1);
+  }
+  memcpy(History + (size_t) NSteps * (NPHASES + 1), ThisStep,
+	 sizeof(ThisStep));
+  NSteps++;
+}
+
+/*****************************************************************************
+  ReportPerfCounters()
+
+  Hardware events of each phase.  The bytes per cell are the cache lines
+  brought in by the last level cache misses of a call of the phase, divided
+  by the active cells.  The vector share is that of the instructions, not
+  of the operations.
+*****************************************************************************/
+static void ReportPerfCounters(void)
+{
+  double *E;
+  long N;
+  int i;
+
+  printf("\nHardware counters, %d active cells:\n", NCells);
+  printf("%-18s %10s %7s %10s %9s %11s %11s %8s\n", "Phase",
+	 "Ginstr", "IPC", "LLC miss %", "LLC/kinst", "misses/cell",
+	 "bytes/cell", "vector %");
+  for (i = 0; i <= NPHASES; i++) {
+    E = Events[i];
+    N = (i < NPHASES) ? Calls[i] : NSteps;
+    if (N == 0)
+      continue;
+    printf("%-18s %10.3f %7.2f", (i < NPHASES) ? PhaseName[i] : "time step",
+	   1e-9 * E[PERF_INSTRUCTIONS],
+	   (E[PERF_CYCLES] > 0.0) ? E[PERF_INSTRUCTIONS] / E[PERF_CYCLES] :
+	   0.0);
+    if (PerfEventCounted(PERF_LLC_MISSES))
+      printf(" %10.2f %9.3f %11.3f %11.1f",
+	     (E[PERF_LLC_REFS] > 0.0) ?
+	     100. * E[PERF_LLC_MISSES] / E[PERF_LLC_REFS] : 0.0,
+	     (E[PERF_INSTRUCTIONS] > 0.0) ?
+	     1e3 * E[PERF_LLC_MISSES] / E[PERF_INSTRUCTIONS] : 0.0,
+	     E[PERF_LLC_MISSES] / ((double) N * NCells),
+	     CACHE_LINE_BYTES * E[PERF_LLC_MISSES] / ((double) N * NCells));
+    else
+      printf(" %10s %9s %11s %11s", "-", "-", "-", "-");
+    if (PerfEventCounted(PERF_VECTOR_FP) &&
+	E[PERF_SCALAR_FP] + E[PERF_VECTOR_FP] > 0.0)
+      printf(" %8.2f\n", 100. * E[PERF_VECTOR_FP] /
+	     (E[PERF_SCALAR_FP] + E[PERF_VECTOR_FP]));
+    else
+      printf(" %8s\n", "-");
+  }
+}
+
+/*****************************************************************************
+  Percentile()
+
+  Value below which a fraction P of the N sorted values lies (nearest rank)
+*****************************************************************************/
+static float Percentile(float *Sorted, int N, float P)
+{
+  int i = (int) (P * N + 0.5) - 1;
+
+  if (i < 0)
+    i = 0;
+  if (i > N - 1)
+    i = N - 1;
+  return Sorted[i];
+}
+
+static int CompareFloat(const void *a, const void *b)
+{
+  float A = *(const float *) a;
+  float B = *(const float *) b;
+
+  return (A > B) - (A < B);
+}
+
+/*****************************************************************************
+  ProfileReport()
+
+  Prints the time of each phase and the throughput of the time loop.  Dt is
+  the model time step (s).
+*****************************************************************************/
+void ProfileReport(int Dt)
+{
+  float *Sorted;
+  double OtherWall;
+  double OtherCpu;
+  int N;
+  int i;
+  int j;
+
+  if (!Report || NSteps == 0)
+    return;
+
+  if (!(Sorted = (float *) calloc(NSteps, sizeof(float))))
+    ReportError("ProfileReport", 1);
+
+  printf("\nProfile of the time loop, %d steps:\n", NSteps);
+  printf("%-18s %8s %10s %7s %10s %8s %9s %9s %9s %9s\n", "Phase", "Calls",
+	 "Wall (s)", "% loop", "CPU (s)", "CPU/wall", "p50 (ms)", "p90 (ms)",
+	 "p99 (ms)", "max (ms)");
+
+  OtherWall = LoopWall;
+  OtherCpu = LoopCpu;
+  for (i = 0; i <= NPHASES; i++) {
+    for (j = 0, N = 0; j < NSteps; j++) {
+      float Value = History[(size_t) j * (NPHASES + 1) + i];
+      if (i == NPHASES || Value >= 0.0)
+	Sorted[N++] = Value;
+    }
+    if (i < NPHASES) {
+      if (Calls[i] == 0)
+	continue;
+      OtherWall -= Wall[i];
+      OtherCpu -= Cpu[i];
+      printf("%-18s %8ld %10.3f %7.2f %10.3f %8.2f", PhaseName[i], Calls[i],
+	     Wall[i], (LoopWall > 0.0) ? 100. * Wall[i] / LoopWall : 0.0,
+	     Cpu[i], (Wall[i] > 0.0) ? Cpu[i] / Wall[i] : 0.0);
+    }
+    else {
+      printf("%-18s %8s %10.3f %7.2f %10.3f %8.2f\n", "other", "",
+	     OtherWall, (LoopWall > 0.0) ? 100. * OtherWall / LoopWall : 0.0,
+	     OtherCpu, (OtherWall > 0.0) ? OtherCpu / OtherWall : 0.0);
+      printf("%-18s %8d %10.3f %7.2f %10.3f %8.2f", "time step", NSteps,
+	     LoopWall, 100.0, LoopCpu,
+	     (LoopWall > 0.0) ? LoopCpu / LoopWall : 0.0);
+    }
+    qsort(Sorted, N, sizeof(float), CompareFloat);
+    printf(" %9.3f %9.3f %9.3f %9.3f\n", 1e3 * Percentile(Sorted, N, 0.5),
+	   1e3 * Percentile(Sorted, N, 0.9), 1e3 * Percentile(Sorted, N, 0.99),
+	   1e3 * Sorted[N - 1]);
+  }
+
+  if (LoopWall > 0.0)
+    printf("Throughput: %.1f simulated hours per wall clock hour\n",
+	   (double) NSteps * Dt / LoopWall);
+
+  if (PerfOn) {
+    ReportPerfCounters();
+    ClosePerfCounters();
+    PerfOn = FALSE;
+  }
+
+  free(Sorted);
+  free(History);
+  History = NULL;
+  NSteps = 0;
+  MaxSteps = 0;
+}
+
+/*****************************************************************************
+  ProfileTimes()
+
+  Wall clock time of each phase and of all steps so far (s), for the
+  telemetry (Telemetry.c)
+*****************************************************************************/
+void ProfileTimes(double *PhaseTimes, double *StepsTime)
+{
+  memcpy(PhaseTimes, Wall, sizeof(Wall));
+  *StepsTime = LoopWall;
+}
+
+/*****************************************************************************
+  ProfilePhaseName()
+*****************************************************************************/
+const char *ProfilePhaseName(int Phase)
+{
+  return PhaseName[Phase];
+}
+
+/*****************************************************************************
+  StartupStage()
+
+  Ends the running stage of the initialization, which began at the previous
+  call, as stage Name.  The first call, with Name NULL, starts the first
+  stage.
+*****************************************************************************/
+void StartupStage(const char *Name)
+{
+  double Wall = WallClock();
+  double Cpu = CpuClock();
+
+  if (Name != NULL && StageWall >= 0.0 && NStages < MAXSTAGES) {
+    Stage[NStages].Name = Name;
+    Stage[NStages].Wall = Wall - StageWall;
+    Stage[NStages].Cpu = Cpu - StageCpu;
+    Stage[NStages].Task = FALSE;
+    Stage[NStages].Concurrent = FALSE;
+    NStages++;
+    TraceEnd(StageSpan, Name, "init", NULL, -1.0);
+  }
+  StageWall = Wall;
+  StageCpu = Cpu;
+  StageSpan = TRACE_BEGIN();
+}
+
+/*****************************************************************************
+  StartupTask()
+
+  Records the run time Wall (s) of the initialization task Name, which ran
+  in a thread of its own if Concurrent is TRUE and within the stages
+  otherwise
+*****************************************************************************/
+void StartupTask(const char *Name, double Wall, int Concurrent)
+{
+  if (NStages == MAXSTAGES)
+    return;
+  Stage[NStages].Name = Name;
+  Stage[NStages].Wall = Wall;
+  Stage[NStages].Cpu = 0.0;
+  Stage[NStages].Task = TRUE;
+  Stage[NStages].Concurrent = Concurrent;
+  NStages++;
+}
+
+/*****************************************************************************
+  ReportStartup()
+
+  Prints the wall clock and CPU time of the stages of the initialization
+*****************************************************************************/
+static void ReportStartup(void)
+{
+  double Total = 0.0;
+  int i;
+
+  for (i = 0; i < NStages; i++)
+    if (!Stage[i].Task)
+      Total += Stage[i].Wall;
+  if (Total <= 0.0)
+    return;
+
+  printf("\nProfile of the initialization, %.3f s:\n", Total);
+  printf("%-28s %10s %7s %10s\n", "Stage", "Wall (s)", "% init", "CPU (s)");
+  for (i = 0; i < NStages; i++) {
+    if (Stage[i].Task)
+      printf("  task %-21s %10.3f  %s\n", Stage[i].Name, Stage[i].Wall,
+	     Stage[i].Concurrent ? "in its own thread" : "in line");
+    else
+      printf("%-28s %10.3f %7.2f %10.3f\n", Stage[i].Name, Stage[i].Wall,
+	     100. * Stage[i].Wall / Total, Stage[i].Cpu);
+  }
+}
+
+#endif
@@ -38,6 +38,7 @@
 #include "DHSVMerror.h"
 #include "massenergy.h"
 #include "constants.h"
+#include "fastmath.h"
 
 /*****************************************************************************
   Function name: RadiationBalance()
@@ -126,7 +127,7 @@ void RadiationBalance(OPTIONSTRUCT *Options, int HeatFluxOption,
   /* if the attenuation is fixed, calculate the canopy transmittance */
   if (CanopyRadAttOption == FIXED) {
     if (VType->OverStory == TRUE)
-      Tau = exp(-VType->Atten * VType->LAI[0]);
+      Tau = MathExp(-VType->Atten * VType->LAI[0]);
     else
       Tau = 0.;
   }
@@ -137,7 +138,7 @@ void RadiationBalance(OPTIONSTRUCT *Options, int HeatFluxOption,
          1) LAI * ClumpingFactor = Effective LAI 
          2) Formulation is typically based on the cos of the solar zenith angle,
          which is the sin of the solar altitude (SA = 90 - SZA) */
-      Taub = exp(-VType->LAI[0] / VType->ClumpingFactor *
+      Taub = MathExp(-VType->LAI[0] / VType->ClumpingFactor *
 	    (VType->LeafAngleA / SineSolarAltitude + VType->LeafAngleB));
       
       /* transmittance for diffuse radiation (cacluated in CheckOut.c as a function of
@@ -149,7 +150,7 @@ void RadiationBalance(OPTIONSTRUCT *Options, int HeatFluxOption,
       if (Rs > 0.0) {
 	    Tau = Taub * Rsb / Rs + Taud * Rsd / Rs;
         /* adjust Tau to scaterring parameter */
-	    Tau = pow(Tau, (VType->Scat));
+	    Tau = MathPow(Tau, (VType->Scat));
         /* adjust Tau to over- and under- story reflection */
 	    Tau = Tau / (1 - Albedo[0] * Albedo[1]);
       }
@@ -164,7 +165,7 @@ void RadiationBalance(OPTIONSTRUCT *Options, int HeatFluxOption,
   if (Options->ImprovRadiation) {
     if (VType->OverStory == TRUE) {
       if (SineSolarAltitude > 0.)
-        Tau = exp(-VType->ExtnCoeff * h * F / SineSolarAltitude);
+        Tau = MathExp(-VType->ExtnCoeff * h * F / SineSolarAltitude);
       else
         Tau = 0.;
     }
@@ -0,0 +1,347 @@
+/*
+ * SUMMARY:      RadiationBatch.c - Radiation balance of many cells at once
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS RADIATION BATCH the pixel loop does
+ *               RadiationBalance() for the cells of a piece of a tile
+ *               together, before MassEnergyBalance() of the cells, which
+ *               then leaves it out.  The inputs of the cells (met, canopy
+ *               fraction, albedos and surface temperatures) are gathered
+ *               into one array per variable, the short- and longwave
+ *               balances are loops over those arrays with the branches of
+ *               the scalar code turned into selects that the compiler can
+ *               vectorize, and the results are scattered to the PIXRAD of
+ *               the cells
+ * DESCRIP-END.
+ * FUNCTIONS:    ClearRadiationBatch()
+ *               AddRadiationCell()
+ *               RadiationBalanceBatch()
+ *               FreeRadiationBatch()
+ *               SelectRadiationKernels()
+ *               MoreCells()
+ *               CanopyTransmittance()
+ * COMMENTS:     The operations are those of RadiationBalance(),
+ *               ShortwaveBalance() and LongwaveBalance() in the same order
+ *               and precision, so the results are the same as those of the
+ *               scalar code.  The canopy transmittance needs MathExp()
+ *               and MathPow() of the vegetation parameters and is done cell by
+ *               cell.  The short- and longwave loops are in
+ *               radiationkernels.h, which is compiled for each SIMD level
+ *               of cpudispatch.h
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "massenergy.h"
+#include "constants.h"
+#include "cpudispatch.h"
+#include "fastmath.h"
+
+/* the arrays of Batch->Fields */
+enum RADFIELD {
+  RF_F, RF_VF, RF_ALBEDO0, RF_ALBEDO1, RF_RS, RF_RSB, RF_RSD, RF_LD,
+  RF_TCANOPY, RF_TSURF, RF_TAU,
+  RF_NETSHORT0, RF_NETSHORT1, RF_PIXELNETSHORT, RF_RBMNETSHORT,
+  RF_PIXELBEAM, RF_PIXELDIFFUSE,
+  RF_LONGOUT0, RF_LONGOUT1, RF_LONGIN0, RF_LONGIN1, RF_PIXELLONGOUT,
+  RF_RBMNETLONG,
+  RAD_FIELDS
+};
+#define FIELD(Batch, f) ((Batch)->Fields + (f) * (Batch)->MaxCells)
+
+static void MoreCells(RADBATCH *Batch);
+static void CanopyTransmittance(RADBATCH *Batch, OPTIONSTRUCT *Options,
+				float SineSolarAltitude);
+
+/* the short- and longwave loops of each SIMD level, and those selected by
+   InitCpuDispatch() */
+typedef void (*RADKERNEL) (RADBATCH *Batch, OPTIONSTRUCT *Options);
+
+#ifdef HAVE_SIMD_DISPATCH
+/* the selects of the loops are only vectorized if the operations of both
+   sides may be done, which does not change the results, and a multiply
+   and an add are not contracted at the levels with FMA */
+#pragma GCC push_options
+#pragma GCC optimize("no-trapping-math", "fp-contract=off")
+#endif
+#define SIMD_SUFFIX _sse2
+#include "radiationkernels.h"
+#undef SIMD_SUFFIX
+#ifdef HAVE_SIMD_DISPATCH
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SIMD_SUFFIX _avx2
+#include "radiationkernels.h"
+#undef SIMD_SUFFIX
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f", "prefer-vector-width=512")
+#define SIMD_SUFFIX _avx512
+#include "radiationkernels.h"
+#undef SIMD_SUFFIX
+#pragma GCC pop_options
+#pragma GCC pop_options
+#endif
+
+static RADKERNEL ShortwaveFields = ShortwaveFields_sse2;
+static RADKERNEL LongwaveFields = LongwaveFields_sse2;
+
+/*****************************************************************************
+  Function name: ClearRadiationBatch()
+
+  Purpose      : Empty the batch for the next piece of the pixel loop
+*****************************************************************************/
+void ClearRadiationBatch(RADBATCH *Batch)
+{
+  Batch->N = 0;
+}
+
+/*****************************************************************************
+  Function name: AddRadiationCell()
+
+  Purpose      : Add a cell to the batch and gather the inputs of its
+                 radiation balance, as RadiationBalance() does
+
+  Required     :
+    RADBATCH *Batch     - Batch
+    OPTIONSTRUCT *Options - HeatFlux and CanopyRadAtt of the run
+    PIXMET *LocalMet    - Met of the cell from MakeLocalMetData()
+    VEGTABLE *VType     - Vegetation type of the cell
+    VEGPIX *LocalVeg    - Canopy temperature of the previous time step
+    SOILPIX *LocalSoil  - Soil surface temperature of the previous step
+    float SoilAlbedo    - Albedo of the soil type of the cell
+    SNOWPIX *LocalSnow  - Snow conditions of the cell
+    PIXRAD *LocalRad    - Where RadiationBalanceBatch() puts the results
+
+  Returns      : void
+
+  Comments     : The cells are numbered in the order they are added, the
+                 pixel loop takes the met of cell n from Batch->Met[n]
+*****************************************************************************/
+void AddRadiationCell(RADBATCH *Batch, OPTIONSTRUCT *Options,
+		      PIXMET *LocalMet, VEGTABLE *VType, VEGPIX *LocalVeg,
+		      SOILPIX *LocalSoil, float SoilAlbedo,
+		      SNOWPIX *LocalSnow, PIXRAD *LocalRad)
+{
+  int n;
+
+  if (Batch->N == Batch->MaxCells)
+    MoreCells(Batch);
+  n = Batch->N++;
+
+  Batch->Met[n] = *LocalMet;
+  Batch->VType[n] = VType;
+  Batch->Rad[n] = LocalRad;
+  Batch->OverStory[n] = VType->OverStory;
+
+  if (Options->CanopyRadAtt == VARIABLE)
+    FIELD(Batch, RF_F)[n] = VType->HemiFract[0];
+  else
+    FIELD(Batch, RF_F)[n] = VType->Fract[0];
+  FIELD(Batch, RF_VF)[n] = VType->Vf;
+
+  /* Determine Albedo */
+  FIELD(Batch, RF_ALBEDO1)[n] = 0.0;
+  if (VType->OverStory == TRUE) {
+    FIELD(Batch, RF_ALBEDO0)[n] = VType->Albedo[0];
+    if (LocalSnow->HasSnow == TRUE)
+      FIELD(Batch, RF_ALBEDO1)[n] = LocalSnow->Albedo;
+    else if (VType->UnderStory == TRUE)
+      FIELD(Batch, RF_ALBEDO1)[n] = VType->Albedo[1];
+    else
+      FIELD(Batch, RF_ALBEDO1)[n] = SoilAlbedo;
+  }
+  else if (LocalSnow->HasSnow == TRUE)
+    FIELD(Batch, RF_ALBEDO0)[n] = LocalSnow->Albedo;
+  else if (VType->UnderStory == TRUE)
+    FIELD(Batch, RF_ALBEDO0)[n] = VType->Albedo[0];
+  else
+    FIELD(Batch, RF_ALBEDO0)[n] = SoilAlbedo;
+
+  FIELD(Batch, RF_RS)[n] = LocalMet->Sin;
+  FIELD(Batch, RF_RSB)[n] = LocalMet->SinBeam;
+  FIELD(Batch, RF_RSD)[n] = LocalMet->SinDiffuse;
+  FIELD(Batch, RF_LD)[n] = LocalMet->Lin;
+  FIELD(Batch, RF_TCANOPY)[n] = LocalVeg->Tcanopy;
+
+  if (LocalSnow->HasSnow == TRUE)
+    FIELD(Batch, RF_TSURF)[n] = LocalSnow->TSurf;
+  else if (Options->HeatFlux == TRUE)
+    FIELD(Batch, RF_TSURF)[n] = LocalSoil->TSurf;
+  else
+    FIELD(Batch, RF_TSURF)[n] = LocalMet->Tair;
+}
+
+/*****************************************************************************
+  Function name: RadiationBalanceBatch()
+
+  Purpose      : RadiationBalance() for all the cells of the batch
+
+  Required     :
+    RADBATCH *Batch         - Batch
+    OPTIONSTRUCT *Options   - Options of the run
+    float SineSolarAltitude - Sine of the solar altitude of the time step
+
+  Returns      : void
+
+  Modifies     : The PIXRAD of the cells
+*****************************************************************************/
+void RadiationBalanceBatch(RADBATCH *Batch, OPTIONSTRUCT *Options,
+			   float SineSolarAltitude)
+{
+  PIXRAD *LocalRad;
+  int n;
+
+  if (Batch->N == 0)
+    return;
+
+  CanopyTransmittance(Batch, Options, SineSolarAltitude);
+  ShortwaveFields(Batch, Options);
+  LongwaveFields(Batch, Options);
+
+  for (n = 0; n < Batch->N; n++) {
+    LocalRad = Batch->Rad[n];
+    LocalRad->NetShort[0] = FIELD(Batch, RF_NETSHORT0)[n];
+    LocalRad->NetShort[1] = FIELD(Batch, RF_NETSHORT1)[n];
+    LocalRad->PixelNetShort = FIELD(Batch, RF_PIXELNETSHORT)[n];
+    LocalRad->LongOut[0] = FIELD(Batch, RF_LONGOUT0)[n];
+    LocalRad->LongOut[1] = FIELD(Batch, RF_LONGOUT1)[n];
+    LocalRad->LongIn[0] = FIELD(Batch, RF_LONGIN0)[n];
+    LocalRad->LongIn[1] = FIELD(Batch, RF_LONGIN1)[n];
+    LocalRad->PixelLongIn = FIELD(Batch, RF_LD)[n];
+    LocalRad->PixelLongOut = FIELD(Batch, RF_PIXELLONGOUT)[n];
+    LocalRad->ObsShortIn = Batch->Met[n].VICSin;
+    if (Options->StreamTemp) {
+      LocalRad->RBMNetShort = FIELD(Batch, RF_RBMNETSHORT)[n];
+      LocalRad->PixelBeam = FIELD(Batch, RF_PIXELBEAM)[n];
+      LocalRad->PixelDiffuse = FIELD(Batch, RF_PIXELDIFFUSE)[n];
+      LocalRad->RBMNetLong = FIELD(Batch, RF_RBMNETLONG)[n];
+    }
+  }
+}
+
+/*****************************************************************************
+  Function name: FreeRadiationBatch()
+*****************************************************************************/
+void FreeRadiationBatch(RADBATCH *Batch)
+{
+  free(Batch->Met);
+  free(Batch->VType);
+  free(Batch->Rad);
+  free(Batch->OverStory);
+  free(Batch->Fields);
+  Batch->Met = NULL;
+  Batch->VType = NULL;
+  Batch->Rad = NULL;
+  Batch->OverStory = NULL;
+  Batch->Fields = NULL;
+  Batch->N = 0;
+  Batch->MaxCells = 0;
+}
+
+/*****************************************************************************
+  Function name: SelectRadiationKernels()
+
+  Purpose      : Use the short- and longwave loops of SIMD Level
+*****************************************************************************/
+void SelectRadiationKernels(int Level)
+{
+  ShortwaveFields = ShortwaveFields_sse2;
+  LongwaveFields = LongwaveFields_sse2;
+#ifdef HAVE_SIMD_DISPATCH
+  if (Level == SIMD_AVX2) {
+    ShortwaveFields = ShortwaveFields_avx2;
+    LongwaveFields = LongwaveFields_avx2;
+  }
+  else if (Level == SIMD_AVX512) {
+    ShortwaveFields = ShortwaveFields_avx512;
+    LongwaveFields = LongwaveFields_avx512;
+  }
+#endif
+}
+
+/*****************************************************************************
+  Function name: MoreCells()
+
+  Purpose      : Make room for more cells, keeping the cells that were added
+
+  Comments     : Each variable is one array of MaxCells values, so the
+                 values are moved to the longer arrays one variable at a
+                 time (GrowFieldBlock()).  The first call allocates the
+                 arrays.
+*****************************************************************************/
+static void MoreCells(RADBATCH *Batch)
+{
+  const char *Routine = "MoreCells";
+  float *Fields;
+  int MaxCells;
+
+  MaxCells = (Batch->MaxCells > 0) ? 2 * Batch->MaxCells : SOIL_BATCH_CELLS;
+  if (!(Batch->Met = (PIXMET *) realloc(Batch->Met,
+					MaxCells * sizeof(PIXMET))) ||
+      !(Batch->VType = (VEGTABLE **) realloc(Batch->VType,
+					     MaxCells * sizeof(VEGTABLE *))) ||
+      !(Batch->Rad = (PIXRAD **) realloc(Batch->Rad,
+					 MaxCells * sizeof(PIXRAD *))) ||
+      !(Batch->OverStory = (unsigned char *) realloc(Batch->OverStory,
+						     MaxCells)) ||
+      !(Fields = GrowFieldBlock(Batch->Fields, RAD_FIELDS, Batch->N,
+				Batch->MaxCells, MaxCells)))
+    ReportError((char *) Routine, 1);
+
+  Batch->Fields = Fields;
+  Batch->MaxCells = MaxCells;
+}
+
+/*****************************************************************************
+  Function name: CanopyTransmittance()
+
+  Purpose      : Transmittance of the overstory of each cell, as in
+                 RadiationBalance()
+*****************************************************************************/
+static void CanopyTransmittance(RADBATCH *Batch, OPTIONSTRUCT *Options,
+				float SineSolarAltitude)
+{
+  VEGTABLE *VType;
+  float *F = FIELD(Batch, RF_F);
+  float *Albedo0 = FIELD(Batch, RF_ALBEDO0);
+  float *Albedo1 = FIELD(Batch, RF_ALBEDO1);
+  float *Rs = FIELD(Batch, RF_RS);
+  float *Rsb = FIELD(Batch, RF_RSB);
+  float *Rsd = FIELD(Batch, RF_RSD);
+  float *Tau = FIELD(Batch, RF_TAU);
+  float Taub;
+  float Taud;
+  int n;
+
+  for (n = 0; n < Batch->N; n++) {
+    VType = Batch->VType[n];
+    Tau[n] = 0.;
+    if (VType->OverStory != TRUE)
+      continue;
+
+    if (Options->ImprovRadiation) {
+      if (SineSolarAltitude > 0.)
+	Tau[n] = MathExp(-VType->ExtnCoeff * VType->Height[0] * F[n] /
+		     SineSolarAltitude);
+    }
+    else if (Options->CanopyRadAtt == FIXED)
+      Tau[n] = MathExp(-VType->Atten * VType->LAI[0]);
+    else if (Options->CanopyRadAtt == VARIABLE && Rs[n] > 0.0) {
+      Taub = MathExp(-VType->LAI[0] / VType->ClumpingFactor *
+		 (VType->LeafAngleA / SineSolarAltitude + VType->LeafAngleB));
+      Taud = VType->Taud;
+      Tau[n] = Taub * Rsb[n] / Rs[n] + Taud * Rsd[n] / Rs[n];
+      Tau[n] = MathPow(Tau[n], (VType->Scat));
+      Tau[n] = Tau[n] / (1 - Albedo0[n] * Albedo1[n]);
+    }
+  }
+}
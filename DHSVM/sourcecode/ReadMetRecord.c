@@ -8,22 +8,99 @@
  * DESCRIPTION:  Read station meteorological data
  * DESCRIP-END.
  * FUNCTIONS:    ReadMetRecord()
- * COMMENTS:
+ *               CountMetVars()
+ *               ScanMetRecord()
+ *               StoreMetRecord()
+ *               InitMetFilePool()
+ *               UseMetFile()
+ *               LinkMetFile()
+ *               FreeMetFilePool()
+ *               InitMetCache()
+ *               ReadMetCache()
+ *               CloseMetCache()
+ *               ReopenMetFiles()
+ *               TellMetFiles()
+ *               SeekMetFiles()
+ *               RewindMetFiles()
+ *               ReadMetRecords()
+ *               PrefetchMetRecords()
+ * COMMENTS:     The met cache is a binary copy of all station files, laid out
+ *               as [time][station][variable] floats after a short header, so
+ *               that the records for a time step can be read with one fseek
+ *               and one fread.  It is written in native byte order.
+ *               With MAXIMUM OPEN MET FILES the station files are kept in a
+ *               pool of at most that many open files, the least recently
+ *               read file is closed when another one has to be opened.
+ *               With a GRID NETCDF FILE the records of all stations are
+ *               read from it, see ReadGridMetNetCDF().
  * $Id: ReadMetRecord.c,v 1.4 2003/07/01 21:26:22 olivier Exp $     
  */
 
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#ifdef HAVE_FORK
+#include <unistd.h>
+#endif
 #include "settings.h"
 #include "data.h"
 #include "DHSVMerror.h"
 #include "functions.h"
 #include "constants.h"
+#include "fileio.h"
+#include "getinit.h"
+#include "trace.h"
+#include "messagelog.h"
 
 #define MAXMETVARS    21	/* Maximum Number of meteorological variables 
  to read.  Hack to be replaced by something better */
 
+#define METCACHE_MAGIC   "DHSVMMET"
+#define METCACHE_VERSION 1
+
+/* state of the met cache, NStats == 0 if the cache is not used */
+static struct {
+  FILE *FilePtr;
+  char FileName[BUFSIZE + 1];
+  int NStats;			/* Number of stations in the cache */
+  int NVars;			/* Number of values per station */
+  int Dt;			/* Time step of the cache (in sec) */
+  int NSteps;			/* Number of time steps in the cache */
+  DATE Start;			/* Date of the first record */
+  long Offset;			/* Size of the header (in bytes) */
+  float *Buffer;		/* [NStats][NVars] records for one time step */
+} MetCache = { NULL, "", 0, 0, 0, 0 };
+
+/* raw records prefetched for the next time step (see PrefetchMetRecords()) */
+static struct {
+  float *Buffer;		/* [NStats][Stride] raw station records */
+  int Stride;			/* Number of values stored per station */
+  int Valid;			/* TRUE if Buffer holds the records for Date */
+  DATE Date;
+  long *Position;		/* Positions in the station files before the
+				   records were read, see TellMetFiles() */
+} MetPrefetch = { NULL, 0, FALSE };
+
+/* open station files (see InitMetFilePool()), MaxOpen == 0 if all the
+   files stay open */
+static struct {
+  int MaxOpen;			/* Maximum number of open files */
+  int NOpen;			/* Number of open files */
+  int NStats;			/* Number of stations */
+  long *Position;		/* Read position of each closed file */
+  int *Prev;			/* Open files from the most (Head) to the */
+  int *Next;			/*   least recently read (Tail), -1 ends */
+  int Head;
+  int Tail;
+} MetPool = { 0, 0, 0, NULL, NULL, NULL, -1, -1 };
+
+static void UseMetFile(int Index, METLOCATION *Stat);
+static void LinkMetFile(int Index);
+static void FreeMetFilePool(void);
+static void ReadMetCacheStep(DATE *Current, int NStats, float *Buffer);
+static int ReadMetCacheHeader(FILE *CacheFile, int *NStats, int *NVars,
+			      int *Dt, int *NSteps, DATE *Start);
+
 /*****************************************************************************
   ReadMetRecord()
 *****************************************************************************/
@@ -31,9 +108,22 @@ void ReadMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
 		   FILES *InFile, unsigned char IsWindModelLocation,
 		   MET *MetRecord)
 {
-  DATE MetDate;			/* Date of meteorological record */
   float Array[MAXMETVARS];	/* Temporary storage of met variables */
-  int i;
+
+  ScanMetRecord(Options, Current, NSoilLayers, InFile, IsWindModelLocation,
+		Array);
+  StoreMetRecord(Options, NSoilLayers, InFile->FileName, IsWindModelLocation,
+		 Array, MetRecord);
+}
+
+/*****************************************************************************
+  CountMetVars()
+
+  Number of values in a station record for the current options
+*****************************************************************************/
+int CountMetVars(OPTIONSTRUCT *Options, int NSoilLayers,
+		 unsigned char IsWindModelLocation)
+{
   int NMetVars;			/* Number of meteorological variables to read */
   NMetVars = 5;
   /* these are - in order: 
@@ -55,6 +145,24 @@ void ReadMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
   if (IsWindModelLocation)
     NMetVars++;
 
+  return NMetVars;
+}
+
+/*****************************************************************************
+  ScanMetRecord()
+
+  Read the raw values of the record for date Current from a station file into
+  Array, and return the number of values read
+*****************************************************************************/
+int ScanMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
+		  FILES *InFile, unsigned char IsWindModelLocation,
+		  float *Array)
+{
+  DATE MetDate;			/* Date of meteorological record */
+  int NMetVars;			/* Number of meteorological variables to read */
+
+  NMetVars = CountMetVars(Options, NSoilLayers, IsWindModelLocation);
+
   if (!ScanDate(InFile->FilePtr, &MetDate))
     ReportError(InFile->FileName, 23);
 
@@ -78,11 +186,26 @@ void ReadMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
   if (ScanFloats(InFile->FilePtr, Array, NMetVars) != NMetVars)
     ReportError(InFile->FileName, 5);
 
+  return NMetVars;
+}
+
+/*****************************************************************************
+  StoreMetRecord()
+
+  Check the raw values in Array and store them in MetRecord.  FileName is
+  only used in the warnings.
+*****************************************************************************/
+void StoreMetRecord(OPTIONSTRUCT *Options, int NSoilLayers, char *FileName,
+		    unsigned char IsWindModelLocation, float *Array,
+		    MET *MetRecord)
+{
+  int i;
+
   MetRecord->Tair = Array[0];
   MetRecord->Wind = Array[1];
   MetRecord->Rh = Array[2];
   if (MetRecord->Rh < 0.0 || MetRecord->Rh > 100.0) {
-    printf("warning: RH out of bounds: %s\n", InFile->FileName);
+    LogMessage(MSG_WARNING, "warning: RH out of bounds: %s\n", FileName);
     if (MetRecord->Rh < 0.0)
       MetRecord->Rh = 0.0;
     if (MetRecord->Rh > 100.0)
@@ -90,17 +213,19 @@ void ReadMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
   }
   MetRecord->Sin = Array[3];
   if (MetRecord->Sin > 1380.0) {
-    printf("warning: Shortwave out of bounds: %s\n", InFile->FileName);
+    LogMessage(MSG_WARNING, "warning: Shortwave out of bounds: %s\n",
+	       FileName);
     MetRecord->Sin = 1380.0;
   }
   if (MetRecord->Sin < 0.0) {
-    printf("Warning: Negative Shortwave, setting to zero: %s\n",
-	   InFile->FileName);
+    LogMessage(MSG_WARNING,
+	       "Warning: Negative Shortwave, setting to zero: %s\n", FileName);
     MetRecord->Sin = 0.0;
   }
   MetRecord->Lin = Array[4];
   if (MetRecord->Lin < 0.0 || MetRecord->Lin > 1800.0) {
-    printf("warning: Longwave out of bounds: %s\n", InFile->FileName);
+    LogMessage(MSG_WARNING, "warning: Longwave out of bounds: %s\n",
+	       FileName);
   }
 
   i = 0;
@@ -111,7 +236,7 @@ void ReadMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
   if (Options->PrecipType == STATION) {
     MetRecord->Precip = Array[5 + i];
     if (MetRecord->Precip < 0) {
-      printf("Warning: negative precip %s \n", InFile->FileName);
+      LogMessage(MSG_WARNING, "Warning: negative precip %s \n", FileName);
       MetRecord->Precip = 0.0;
     }
     i++;
@@ -142,3 +267,554 @@ void ReadMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
     MetRecord->WindDirection = NOT_APPLICABLE;
 
 }
+
+/*****************************************************************************
+  InitMetFilePool()
+
+  Keep at most MaxOpen of the station files open (0 = all).  The files that
+  are open now are kept open up to MaxOpen and the others are closed, the
+  files that are closed (grid met files with a limit, see InitGridMet()) 
+  are read from the start.
+*****************************************************************************/
+void InitMetFilePool(int MaxOpen, int NStats, METLOCATION *Stat)
+{
+  const char *Routine = "InitMetFilePool";
+  int i;
+
+  if (MaxOpen <= 0 || NStats <= 0)
+    return;
+
+  MetPool.MaxOpen = MaxOpen;
+  MetPool.NStats = NStats;
+  MetPool.NOpen = 0;
+  MetPool.Head = MetPool.Tail = -1;
+  if (!(MetPool.Position = (long *) calloc(NStats, sizeof(long))) ||
+      !(MetPool.Prev = (int *) calloc(NStats, sizeof(int))) ||
+      !(MetPool.Next = (int *) calloc(NStats, sizeof(int))))
+    ReportError((char *) Routine, 1);
+
+  for (i = 0; i < NStats; i++) {
+    MetPool.Position[i] = 0;
+    if (Stat[i].MetFile.FilePtr == NULL)
+      continue;
+    if (MetPool.NOpen < MaxOpen) {
+      LinkMetFile(i);
+      MetPool.NOpen++;
+    }
+    else {
+      MetPool.Position[i] = ftell(Stat[i].MetFile.FilePtr);
+      fclose(Stat[i].MetFile.FilePtr);
+      Stat[i].MetFile.FilePtr = NULL;
+    }
+  }
+  printf("At most %d of the %d met files are kept open\n", MaxOpen, NStats);
+}
+
+/*****************************************************************************
+  UseMetFile()
+
+  Make sure the file of station Index is open before it is read, closing 
+  the least recently read file if MetPool.MaxOpen files are open, and make
+  it the most recently read file
+*****************************************************************************/
+static void UseMetFile(int Index, METLOCATION *Stat)
+{
+  int Last;
+
+  if (MetPool.MaxOpen == 0)
+    return;
+
+  if (Stat[Index].MetFile.FilePtr != NULL) {
+    if (MetPool.Head == Index)
+      return;
+    /* unlink */
+    MetPool.Next[MetPool.Prev[Index]] = MetPool.Next[Index];
+    if (MetPool.Next[Index] >= 0)
+      MetPool.Prev[MetPool.Next[Index]] = MetPool.Prev[Index];
+    else
+      MetPool.Tail = MetPool.Prev[Index];
+  }
+  else {
+    if (MetPool.NOpen >= MetPool.MaxOpen) {
+      /* close the least recently read file */
+      Last = MetPool.Tail;
+      MetPool.Position[Last] = ftell(Stat[Last].MetFile.FilePtr);
+      fclose(Stat[Last].MetFile.FilePtr);
+      Stat[Last].MetFile.FilePtr = NULL;
+      MetPool.Tail = MetPool.Prev[Last];
+      if (MetPool.Tail >= 0)
+	MetPool.Next[MetPool.Tail] = -1;
+      else
+	MetPool.Head = -1;
+      MetPool.NOpen--;
+    }
+    if ((Stat[Index].MetFile.FilePtr = 
+	 fopen(Stat[Index].MetFile.FileName, "r")) == NULL)
+      ReportError(Stat[Index].MetFile.FileName, 3);
+    if (fseek(Stat[Index].MetFile.FilePtr, MetPool.Position[Index],
+	      SEEK_SET) != 0)
+      ReportError(Stat[Index].MetFile.FileName, 39);
+    MetPool.NOpen++;
+  }
+  LinkMetFile(Index);
+}
+
+/*****************************************************************************
+  LinkMetFile()
+
+  Put the open file of station Index first in the list of open files, as
+  the most recently read file
+*****************************************************************************/
+static void LinkMetFile(int Index)
+{
+  MetPool.Prev[Index] = -1;
+  MetPool.Next[Index] = MetPool.Head;
+  if (MetPool.Head >= 0)
+    MetPool.Prev[MetPool.Head] = Index;
+  else
+    MetPool.Tail = Index;
+  MetPool.Head = Index;
+}
+
+/*****************************************************************************
+  FreeMetFilePool()
+
+  Stop limiting the open station files, they are all closed (met cache) or 
+  left as they are
+*****************************************************************************/
+static void FreeMetFilePool(void)
+{
+  free(MetPool.Position);
+  free(MetPool.Prev);
+  free(MetPool.Next);
+  MetPool.Position = NULL;
+  MetPool.Prev = NULL;
+  MetPool.Next = NULL;
+  MetPool.MaxOpen = 0;
+  MetPool.NOpen = 0;
+  MetPool.NStats = 0;
+  MetPool.Head = MetPool.Tail = -1;
+}
+
+/*****************************************************************************
+  InitMetCache()
+
+  Open the met cache Options->MetCacheFile.  If the file does not exist it is
+  created from the station files for the period of the model run.  If it
+  exists but was made for a different set of stations, time step or options,
+  a warning is issued and the station files are used instead.  When the
+  cache is used the station files are closed.
+*****************************************************************************/
+void InitMetCache(OPTIONSTRUCT *Options, TIMESTRUCT *Time, int NSoilLayers,
+		  int NStats, METLOCATION *Stat)
+{
+  const char *Routine = "InitMetCache";
+  FILE *CacheFile;
+  DATE Current;
+  DATE LastDate;
+  int NVars;
+  int Dt;
+  int NSteps;
+  int i;
+  int n;
+  int Version = METCACHE_VERSION;
+
+  if (IsEmptyStr(Options->MetCacheFile) || NStats <= 0)
+    return;
+
+  /* all stations get the same number of values, stations that are not wind
+     model locations have an unused last value */
+  NVars = CountMetVars(Options, NSoilLayers, FALSE);
+  for (i = 0; i < NStats; i++)
+    if (Stat[i].IsWindModelLocation) {
+      NVars++;
+      break;
+    }
+
+  if (!(MetCache.Buffer = (float *) calloc(NStats * NVars, sizeof(float))))
+    ReportError((char *) Routine, 1);
+
+  if ((CacheFile = fopen(Options->MetCacheFile, "rb")) == NULL) {
+    /* one time conversion of the station files */
+    printf("Writing met forcing cache %s\n", Options->MetCacheFile);
+    OpenFile(&CacheFile, Options->MetCacheFile, "wb", TRUE);
+    NSteps = Time->NTotalSteps;
+    fwrite(METCACHE_MAGIC, sizeof(char), strlen(METCACHE_MAGIC), CacheFile);
+    fwrite(&Version, sizeof(int), 1, CacheFile);
+    fwrite(&NStats, sizeof(int), 1, CacheFile);
+    fwrite(&NVars, sizeof(int), 1, CacheFile);
+    fwrite(&(Time->Dt), sizeof(int), 1, CacheFile);
+    fwrite(&NSteps, sizeof(int), 1, CacheFile);
+    fwrite(&(Time->Start), sizeof(DATE), 1, CacheFile);
+
+    Current = Time->Start;
+    for (n = 0; n < NSteps; n++) {
+      for (i = 0; i < NStats; i++) {
+	MetCache.Buffer[(i + 1) * NVars - 1] = NOT_APPLICABLE;
+	UseMetFile(i, Stat);
+	ScanMetRecord(Options, &Current, NSoilLayers, &(Stat[i].MetFile),
+		      Stat[i].IsWindModelLocation, &(MetCache.Buffer[i * NVars]));
+      }
+      if (fwrite(MetCache.Buffer, sizeof(float), NStats * NVars, CacheFile) !=
+	  (size_t) (NStats * NVars))
+	ReportError(Options->MetCacheFile, 72);
+      Current = NextDate(&Current, Time->Dt);
+    }
+    fclose(CacheFile);
+    OpenFile(&CacheFile, Options->MetCacheFile, "rb", FALSE);
+  }
+
+  /* check that the cache fits this model run */
+  if (!ReadMetCacheHeader(CacheFile, &(MetCache.NStats), &(MetCache.NVars),
+			  &Dt, &NSteps, &(MetCache.Start)) ||
+      MetCache.NStats != NStats || MetCache.NVars != NVars ||
+      Dt != Time->Dt) {
+    ReportWarning(Options->MetCacheFile, 71);
+    fclose(CacheFile);
+    free(MetCache.Buffer);
+    MetCache.Buffer = NULL;
+    MetCache.NStats = 0;
+    return;
+  }
+  LastDate = MetCache.Start;
+  LastDate.Julian += (double) (NSteps - 1) * Dt / SECPDAY;
+  if (Before(&(Time->Start), &(MetCache.Start)) || 
+      After(&(Time->End), &LastDate)) {
+    ReportWarning(Options->MetCacheFile, 71);
+    fclose(CacheFile);
+    free(MetCache.Buffer);
+    MetCache.Buffer = NULL;
+    MetCache.NStats = 0;
+    return;
+  }
+
+  MetCache.FilePtr = CacheFile;
+  strcpy(MetCache.FileName, Options->MetCacheFile);
+  MetCache.Dt = Dt;
+  MetCache.NSteps = NSteps;
+  MetCache.Offset = ftell(CacheFile);
+
+  /* the station files are not needed anymore */
+  for (i = 0; i < NStats; i++) {
+    if (Stat[i].MetFile.FilePtr != NULL) {
+      fclose(Stat[i].MetFile.FilePtr);
+      Stat[i].MetFile.FilePtr = NULL;
+    }
+  }
+  FreeMetFilePool();
+  printf("Reading met forcing from cache %s\n", MetCache.FileName);
+}
+
+/*****************************************************************************
+  ReadMetCacheHeader()
+*****************************************************************************/
+static int ReadMetCacheHeader(FILE *CacheFile, int *NStats, int *NVars,
+			      int *Dt, int *NSteps, DATE *Start)
+{
+  char Magic[sizeof(METCACHE_MAGIC)];
+  int Version;
+
+  memset(Magic, 0, sizeof(Magic));
+  if (fread(Magic, sizeof(char), strlen(METCACHE_MAGIC), CacheFile) !=
+      strlen(METCACHE_MAGIC) || strcmp(Magic, METCACHE_MAGIC) != 0)
+    return FALSE;
+  if (fread(&Version, sizeof(int), 1, CacheFile) != 1 ||
+      Version != METCACHE_VERSION)
+    return FALSE;
+  if (fread(NStats, sizeof(int), 1, CacheFile) != 1 ||
+      fread(NVars, sizeof(int), 1, CacheFile) != 1 ||
+      fread(Dt, sizeof(int), 1, CacheFile) != 1 ||
+      fread(NSteps, sizeof(int), 1, CacheFile) != 1 ||
+      fread(Start, sizeof(DATE), 1, CacheFile) != 1)
+    return FALSE;
+  if (*NStats <= 0 || *NVars <= 0 || *NVars > MAXMETVARS || *Dt <= 0 ||
+      *NSteps <= 0)
+    return FALSE;
+  return TRUE;
+}
+
+/*****************************************************************************
+  ReadMetCache()
+
+  Read the records for all stations for date Current from the met cache.
+  Returns FALSE if the cache is not used, in which case the station files
+  have to be read with ReadMetRecord().
+*****************************************************************************/
+int ReadMetCache(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
+		 int NStats, METLOCATION *Stat)
+{
+  int i;
+
+  if (MetCache.NStats == 0)
+    return FALSE;
+
+  ReadMetCacheStep(Current, NStats, MetCache.Buffer);
+
+  for (i = 0; i < NStats; i++)
+    StoreMetRecord(Options, NSoilLayers, Stat[i].MetFile.FileName,
+		   Stat[i].IsWindModelLocation,
+		   &(MetCache.Buffer[i * MetCache.NVars]), &(Stat[i].Data));
+
+  return TRUE;
+}
+
+/*****************************************************************************
+  ReadMetCacheStep()
+
+  Read the raw records of all stations for date Current from the met cache
+  into Buffer ([NStats][MetCache.NVars])
+*****************************************************************************/
+static void ReadMetCacheStep(DATE *Current, int NStats, float *Buffer)
+{
+  long Step;
+
+  Step = (long) ((Current->Julian - MetCache.Start.Julian) * SECPDAY /
+		 MetCache.Dt + 0.5);
+  if (Step < 0 || Step >= MetCache.NSteps)
+    ReportError(MetCache.FileName, 28);
+
+  if (fseek(MetCache.FilePtr, MetCache.Offset + Step * NStats *
+	    MetCache.NVars * (long) sizeof(float), SEEK_SET))
+    ReportError(MetCache.FileName, 39);
+  if (fread(Buffer, sizeof(float), NStats * MetCache.NVars,
+	    MetCache.FilePtr) != (size_t) (NStats * MetCache.NVars))
+    ReportError(MetCache.FileName, 2);
+}
+
+/*****************************************************************************
+  CloseMetCache()
+
+  Close the met cache and free the prefetch buffer and the met file pool
+*****************************************************************************/
+void CloseMetCache(void)
+{
+  FreeMetFilePool();
+  CloseGridMetNetCDF();
+  if (MetCache.FilePtr != NULL)
+    fclose(MetCache.FilePtr);
+  MetCache.FilePtr = NULL;
+  free(MetCache.Buffer);
+  MetCache.Buffer = NULL;
+  MetCache.NStats = 0;
+  free(MetPrefetch.Buffer);
+  MetPrefetch.Buffer = NULL;
+  free(MetPrefetch.Position);
+  MetPrefetch.Position = NULL;
+  MetPrefetch.Valid = FALSE;
+}
+
+#ifdef HAVE_FORK
+/*****************************************************************************
+  ReopenFile()
+
+  Give an open input file its own file descriptor at the same position.  The
+  old stream shares its file offset with the other processes forked from the
+  same parent.  It is not closed with fclose(), which would move that offset
+  for the others, only its descriptor is, and the stream is abandoned.
+*****************************************************************************/
+static void ReopenFile(FILE **FilePtr, char *FileName, char *Mode)
+{
+  FILE *NewFile;
+  long Position;
+
+  Position = ftell(*FilePtr);
+  if ((NewFile = fopen(FileName, Mode)) == NULL)
+    ReportError(FileName, 3);
+  if (Position < 0 || fseek(NewFile, Position, SEEK_SET) != 0)
+    ReportError(FileName, 39);
+  close(fileno(*FilePtr));
+  *FilePtr = NewFile;
+}
+
+/*****************************************************************************
+  ReopenMetFiles()
+
+  Reopen the station files and the met cache in a process created with 
+  fork() (see InitEnsemble()), so that it reads them independently of the
+  other members
+*****************************************************************************/
+void ReopenMetFiles(int NStats, METLOCATION *Stat)
+{
+  int i;
+
+  for (i = 0; i < NStats; i++)
+    if (Stat[i].MetFile.FilePtr != NULL)
+      ReopenFile(&(Stat[i].MetFile.FilePtr), Stat[i].MetFile.FileName, "r");
+  if (MetCache.FilePtr != NULL)
+    ReopenFile(&(MetCache.FilePtr), MetCache.FileName, "rb");
+}
+#endif
+
+/*****************************************************************************
+  TellMetFiles()
+
+  Store the position of each station file in Position (NStats values), to
+  be restored with SeekMetFiles().  The met cache is read by date and needs
+  no position.  If the records of the next step have been prefetched, the
+  positions are those before them, since SeekMetFiles() drops them.
+*****************************************************************************/
+void TellMetFiles(int NStats, METLOCATION *Stat, long *Position)
+{
+  int i;
+
+  for (i = 0; i < NStats; i++) {
+    if (MetPrefetch.Valid && MetCache.NStats == 0)
+      Position[i] = MetPrefetch.Position[i];
+    else if (Stat[i].MetFile.FilePtr != NULL)
+      Position[i] = ftell(Stat[i].MetFile.FilePtr);
+    else if (MetPool.MaxOpen > 0)
+      Position[i] = MetPool.Position[i];
+    else
+      Position[i] = -1;
+  }
+}
+
+/*****************************************************************************
+  SeekMetFiles()
+
+  Return the station files to the positions stored by TellMetFiles(), when
+  the model goes back to an earlier time step.  The prefetched records are
+  dropped.
+*****************************************************************************/
+void SeekMetFiles(int NStats, METLOCATION *Stat, long *Position)
+{
+  int i;
+
+  for (i = 0; i < NStats; i++) {
+    if (Position[i] < 0)
+      continue;
+    if (Stat[i].MetFile.FilePtr != NULL) {
+      if (fseek(Stat[i].MetFile.FilePtr, Position[i], SEEK_SET) != 0)
+	ReportError(Stat[i].MetFile.FileName, 39);
+    }
+    else if (MetPool.MaxOpen > 0)
+      MetPool.Position[i] = Position[i];
+  }
+  MetPrefetch.Valid = FALSE;
+}
+
+/*****************************************************************************
+  RewindMetFiles()
+
+  Open the station files again at their start, after they have been
+  replaced with the records of a new forcing period (see Service.c).  The
+  next read scans to the record of the model time.  Returns the number of
+  station files, or -1 with a met cache, which is not read again.
+*****************************************************************************/
+int RewindMetFiles(int NStats, METLOCATION *Stat)
+{
+  int n;
+  int i;
+
+  if (MetCache.NStats > 0)
+    return -1;
+
+  n = 0;
+  for (i = 0; i < NStats; i++) {
+    if (Stat[i].MetFile.FilePtr != NULL) {
+      if (!(Stat[i].MetFile.FilePtr = freopen(Stat[i].MetFile.FileName, "r",
+					      Stat[i].MetFile.FilePtr)))
+	ReportError(Stat[i].MetFile.FileName, 3);
+      n++;
+    }
+    else if (MetPool.MaxOpen > 0) {
+      MetPool.Position[i] = 0;
+      n++;
+    }
+  }
+  MetPrefetch.Valid = FALSE;
+  return n;
+}
+
+/*****************************************************************************
+  ReadMetRecords()
+
+  Read the records for all stations for date Current, from the records 
+  prefetched by PrefetchMetRecords() if they are for this date, otherwise 
+  from the met cache or the station files.
+*****************************************************************************/
+void ReadMetRecords(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
+		    int NStats, METLOCATION *Stat)
+{
+  double Span = TRACE_BEGIN();
+  float *Records;
+  int NVars;
+  int i;
+
+  if (MetPrefetch.Valid && IsEqualTime(&(MetPrefetch.Date), Current)) {
+    for (i = 0; i < NStats; i++)
+      StoreMetRecord(Options, NSoilLayers, Stat[i].MetFile.FileName,
+		     Stat[i].IsWindModelLocation,
+		     &(MetPrefetch.Buffer[i * MetPrefetch.Stride]), 
+		     &(Stat[i].Data));
+    MetPrefetch.Valid = FALSE;
+  }
+  else if ((Records = ReadGridMetNetCDF(Current, &NVars)) != NULL) {
+    for (i = 0; i < NStats; i++)
+      StoreMetRecord(Options, NSoilLayers, Stat[i].MetFile.FileName, FALSE,
+		     &(Records[i * NVars]), &(Stat[i].Data));
+  }
+  else if (!ReadMetCache(Options, Current, NSoilLayers, NStats, Stat)) {
+    for (i = 0; i < NStats; i++) {
+      UseMetFile(i, Stat);
+      ReadMetRecord(Options, Current, NSoilLayers, &(Stat[i].MetFile),
+		    Stat[i].IsWindModelLocation, &(Stat[i].Data));
+    }
+  }
+  TraceEnd(Span, "ReadMetRecords", "io", NULL, -1.0);
+}
+
+/*****************************************************************************
+  PrefetchMetRecords()
+
+  Read the raw records for all stations for date Next, so that the reads 
+  for the next time step can overlap with the current one.  Only the 
+  station files (or the met cache) and a private buffer are touched, so 
+  this can run alongside the rest of the time step.  The records are checked
+  and stored by ReadMetRecords() at the next time step.
+*****************************************************************************/
+void PrefetchMetRecords(OPTIONSTRUCT *Options, DATE *Next, int NSoilLayers,
+			int NStats, METLOCATION *Stat)
+{
+  const char *Routine = "PrefetchMetRecords";
+  double Span = TRACE_BEGIN();
+  float *Records;
+  int NVars;
+  int i;
+
+  /* the interpolated records are not read at every step */
+  if (NStats <= 0 || Options->MetInterval > 0)
+    return;
+
+  if (MetPrefetch.Buffer == NULL) {
+    if (!(MetPrefetch.Buffer =
+	  (float *) calloc(NStats * MAXMETVARS, sizeof(float))) ||
+	!(MetPrefetch.Position = (long *) calloc(NStats, sizeof(long))))
+      ReportError((char *) Routine, 1);
+  }
+
+  if ((Records = ReadGridMetNetCDF(Next, &NVars)) != NULL) {
+    /* read by date, so that there is no file position to go back to */
+    memcpy(MetPrefetch.Buffer, Records, NStats * NVars * sizeof(float));
+    for (i = 0; i < NStats; i++)
+      MetPrefetch.Position[i] = -1;
+    MetPrefetch.Stride = NVars;
+  }
+  else if (MetCache.NStats > 0) {
+    ReadMetCacheStep(Next, NStats, MetPrefetch.Buffer);
+    MetPrefetch.Stride = MetCache.NVars;
+  }
+  else {
+    for (i = 0; i < NStats; i++) {
+      UseMetFile(i, Stat);
+      MetPrefetch.Position[i] = ftell(Stat[i].MetFile.FilePtr);
+      ScanMetRecord(Options, Next, NSoilLayers, &(Stat[i].MetFile),
+		    Stat[i].IsWindModelLocation, 
+		    &(MetPrefetch.Buffer[i * MAXMETVARS]));
+    }
+    MetPrefetch.Stride = MAXMETVARS;
+  }
+  MetPrefetch.Date = *Next;
+  MetPrefetch.Valid = TRUE;
+  TraceEnd(Span, Routine, "io", NULL, -1.0);
+}
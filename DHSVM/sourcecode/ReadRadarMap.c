@@ -25,35 +25,20 @@
 
 /*****************************************************************************
   ReadRadarMap()
+
+  Only the window of the radar map that covers the basin (determined in 
+  InitRadar()) is read into RadarMap
 *****************************************************************************/
 void ReadRadarMap(DATE * Current, DATE * StartRadar, int Dt, MAPSIZE * Radar,
-		  RADARPIX ** RadarMap, char *FileName)
+		  float *RadarMap, char *FileName)
 {
-  const char *Routine = "ReadRadarMap";
-  int i;			/* counter */
-  int x;			/* counter */
-  int y;			/* counter */
   int RadarStep;		/* Location of current timestep in radarfile */
-  int NumberType;		/* number type */
-  void *Array;
 
   if (DEBUG)
     printf("Reading precipitation radar data from file: %s\n", FileName);
 
-  NumberType = NC_FLOAT;
-
-  if (!(Array = (float *) calloc(Radar->NY * Radar->NX,
-				 SizeOfNumberType(NumberType))))
-    ReportError((char *) Routine, 1);
-
   RadarStep = NumberOfSteps(StartRadar, Current, Dt);
 
   /* Read the precipitation */
-  Read2DMatrix(FileName, Array, NumberType, Radar, RadarStep, "", 0);
-
-  for (y = 0, i = 0; y < Radar->NY; y++)
-    for (x = 0; x < Radar->NX; x++, i++)
-      RadarMap[y][x].Precip = ((float *) Array)[i];
-
-  free(Array);
+  Read2DWindow(FileName, RadarMap, NC_FLOAT, Radar, RadarStep, "", 0);
 }
@@ -53,8 +53,8 @@ static char *ErrorMessage[] = {
   "Incorrect flag (valid flags: T, F): ",	/* 30 */
   "Radar or MM5 does not cover entire model area:",	/* 31 */
   "Unknown soil type in file:",	/* 32 */
-  "Maximum number of iterations exceeded in RootBrent():",	/* 33 */
-  "Root not bracketed in RootBrent():",	/* 34 */
+  "Maximum number of iterations exceeded in RootBrent()/RootNewton():",	/* 33 */
+  "Root not bracketed in RootBrent()/RootNewton():",	/* 34 */
   "Soil moisture profile is supersaturated: ",	/* 35 */
   "Grid NOT square, resulting in problems with flow width calculation:",	/* 36 */
   "Radar precipitation file starts later than start of run:",	/* 37 */
@@ -90,6 +90,31 @@ static char *ErrorMessage[] = {
   "The options set in the input file do not support plotting variable ID:", /* 67 */
   "Riparian parameter < 0:", /* 68 */
   "No gridded met file is found within the basin boundary", /* 69 */
+  "No active cells in the basin mask:", /* 70 */
+  "Met forcing cache does not match the model setup, using the station files:", /* 71 */
+  "Error while writing file:", /* 72 */
+  "NetCDF library does not support this storage option, ignored:", /* 73 */
+  "Not a DHSVM checkpoint file or unsupported checkpoint version:", /* 74 */
+  "Checkpoint does not match the basin, layers or channel network:", /* 75 */
+  "Checkpoint checksum error, the file is corrupt:", /* 76 */
+  "Unused error code:", /* 77 */
+  "DHSVM library function called before dhsvm_initialize() or twice:", /* 78 */
+  "Branching the model with fork() is not supported in this build:", /* 79 */
+  "Grid met catalogue does not match MET FILE PATH and FILE PREFIX, it is rebuilt:", /* 80 */
+  "Channel network cache does not match the stream or road files, it is rebuilt:", /* 81 */
+  "Vegetation or soil type of a cell is not in the vegetation or soil table:", /* 82 */
+  "Channel inflow record is not for the segments of the stream network:", /* 83 */
+  "HAVE_ZLIB undefined during build, cannot use BINZ format:", /* 84 */
+  "Compressed map file is truncated or corrupt:", /* 85 */
+  "HAVE_ZLIB undefined during build, cannot compress the checkpoint:", /* 86 */
+  "Forecast service socket path is too long:", /* 87 */
+  "Zarr array is missing, corrupt or does not match the map:", /* 88 */
+  "HAVE_ZLIB undefined during build, cannot compress the Zarr chunks:", /* 89 */
+  "Map events cannot be used with HRU MODE, SPIN UP CYCLES or a resumed run:", /* 90 */
+  "Map event gives a cell a vegetation type or soil depth that does not fit its soil:", /* 91 */
+  "Model state stored before a map event cannot be restored after it:", /* 92 */
+  "Horizon file is truncated:", /* 93 */
+  "Map mask has no cells to write:", /* 94 */
   NULL
 };
 
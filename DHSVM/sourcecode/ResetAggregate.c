@@ -113,6 +113,7 @@ void ResetAggregate(LAYER * Soil, LAYER * Veg, AGGREGATED * Total,
   Total->ChannelInt = 0.0;
   Total->RoadInt = 0.0;
   Total->Saturated = 0;
+  Total->SatExtent = 0.0;
   Total->CulvertReturnFlow = 0;
   Total->CulvertToChannel = 0;
 }
@@ -0,0 +1,341 @@
+/*
+ * SUMMARY:      ResumeIO.c - Compressed state of the resume checkpoint
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The model state of the resume checkpoint (StoreResume() in
+ *               dhsvm.c) is written through this stream, after the header
+ *               of the checkpoint.  With OPTIONS CHECKPOINT COMPRESSION =
+ *               ZLIB the state is cut into blocks of RESUME_BLOCK bytes,
+ *               and RESUME_BATCH blocks at a time are compressed by the
+ *               OpenMP threads and written with one large write.  With
+ *               CHECKPOINT SHUFFLE = TRUE the bytes of the 4 byte words of
+ *               a block are regrouped by their position in the word before
+ *               the block is compressed, which puts the exponent bytes of
+ *               the floats together and compresses the maps of the state
+ *               better.
+ * DESCRIP-END.
+ * FUNCTIONS:    OpenResumeStream()
+ *               WriteResumeStream()
+ *               ReadResumeStream()
+ *               CloseResumeStream()
+ *               FlushBatch()
+ *               FillBatch()
+ *               ShuffleBlock()
+ * COMMENTS:     A block is stored as its size, its stored size and its
+ *               bytes.  A block that does not become smaller is stored as
+ *               it is, with the two sizes the same.  Blocks are only
+ *               written in full, except for the last one, so that the
+ *               state is the blocks one after the other.
+ *
+ *               With RESUME_RAW the state is read and written as it is, and
+ *               the checkpoint is that of the runs before compression.
+ *               Only one checkpoint is open at a time, either for writing
+ *               or for reading.  ZLIB needs HAVE_ZLIB during the build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#include "settings.h"
+#include "DHSVMerror.h"
+#include "memaccount.h"
+#include "resumeio.h"
+
+#define RESUME_BLOCK (1 << 22)	/* bytes of the state in one block */
+#define RESUME_BATCH 16		/* blocks compressed at the same time */
+
+/* size of a block in the checkpoint, before its bytes */
+typedef struct {
+  uint32_t Size;		/* bytes of the state */
+  uint32_t Stored;		/* bytes in the file */
+} RESUMEBLOCK;
+
+static FILE *File = NULL;
+static char *FileName = NULL;
+static int Compression = RESUME_RAW;
+static int Level = 1;
+static int Shuffle = FALSE;
+static int Writing = FALSE;
+
+static unsigned char *Raw = NULL;	/* RESUME_BATCH blocks of the state */
+static unsigned char *Packed = NULL;	/* the blocks as they are stored */
+static unsigned char *Work = NULL;	/* shuffled blocks */
+static size_t Bound = 0;		/* largest stored size of a block */
+static size_t Used = 0;			/* bytes of the state in Raw */
+static size_t Next = 0;			/* next byte of Raw to be read */
+
+static void FlushBatch(void);
+static void FillBatch(void);
+#ifdef HAVE_ZLIB
+static void ShuffleBlock(const unsigned char *In, unsigned char *Out,
+			 size_t Size, int Forward);
+#endif
+
+/*****************************************************************************
+  OpenResumeStream()
+
+  Starts the state of a checkpoint at the position of File, which is named
+  FileName, for writing if Write is TRUE and for reading otherwise.  Level
+  is the zlib level of the writes, 1 (fast) to 9 (small).
+*****************************************************************************/
+void OpenResumeStream(FILE *StreamFile, char *StreamName, int StreamCompression,
+		      int StreamLevel, int StreamShuffle, int Write)
+{
+  const char *Routine = "OpenResumeStream";
+
+  File = StreamFile;
+  FileName = StreamName;
+  Compression = StreamCompression;
+  Level = StreamLevel;
+  Shuffle = StreamShuffle;
+  Writing = Write;
+  Used = 0;
+  Next = 0;
+  if (Compression == RESUME_RAW)
+    return;
+
+#ifdef HAVE_ZLIB
+  /* the sizes of the blocks in Packed stay aligned */
+  Bound = (compressBound(RESUME_BLOCK) + 7) & ~((size_t) 7);
+  if (!(Raw = (unsigned char *) TaggedMalloc((size_t) RESUME_BATCH *
+					     RESUME_BLOCK, MEM_OUTPUT)) ||
+      !(Packed = (unsigned char *) TaggedMalloc((size_t) RESUME_BATCH *
+						(sizeof(RESUMEBLOCK) + Bound),
+						MEM_OUTPUT)) ||
+      (Shuffle &&
+       !(Work = (unsigned char *) TaggedMalloc((size_t) RESUME_BATCH *
+					       RESUME_BLOCK, MEM_OUTPUT))))
+    ReportError((char *) Routine, 1);
+#else
+  ReportError(FileName, 86);
+#endif
+}
+
+/*****************************************************************************
+  WriteResumeStream()
+
+  Appends Size bytes of Data to the state
+*****************************************************************************/
+void WriteResumeStream(const void *Data, size_t Size)
+{
+  const unsigned char *Bytes = (const unsigned char *) Data;
+  size_t Count;
+
+  if (Compression == RESUME_RAW) {
+    if (Size > 0 && fwrite(Data, 1, Size, File) != Size)
+      ReportError(FileName, 72);
+    return;
+  }
+
+  while (Size > 0) {
+    Count = (size_t) RESUME_BATCH * RESUME_BLOCK - Used;
+    if (Count > Size)
+      Count = Size;
+    memcpy(Raw + Used, Bytes, Count);
+    Used += Count;
+    Bytes += Count;
+    Size -= Count;
+    if (Used == (size_t) RESUME_BATCH * RESUME_BLOCK)
+      FlushBatch();
+  }
+}
+
+/*****************************************************************************
+  ReadResumeStream()
+
+  Reads the next Size bytes of the state into Data
+*****************************************************************************/
+void ReadResumeStream(void *Data, size_t Size)
+{
+  unsigned char *Bytes = (unsigned char *) Data;
+  size_t Count;
+
+  if (Compression == RESUME_RAW) {
+    if (Size > 0 && fread(Data, 1, Size, File) != Size)
+      ReportError(FileName, 76);
+    return;
+  }
+
+  while (Size > 0) {
+    if (Next == Used)
+      FillBatch();
+    Count = Used - Next;
+    if (Count > Size)
+      Count = Size;
+    memcpy(Bytes, Raw + Next, Count);
+    Next += Count;
+    Bytes += Count;
+    Size -= Count;
+  }
+}
+
+/*****************************************************************************
+  CloseResumeStream()
+
+  Writes the last blocks of the state and releases the buffers.  The file
+  is closed by the caller.
+*****************************************************************************/
+void CloseResumeStream(void)
+{
+  if (Writing && Compression != RESUME_RAW && Used > 0)
+    FlushBatch();
+  TaggedFree(Raw);
+  TaggedFree(Packed);
+  TaggedFree(Work);
+  Raw = NULL;
+  Packed = NULL;
+  Work = NULL;
+  File = NULL;
+  Compression = RESUME_RAW;
+}
+
+/*****************************************************************************
+  FlushBatch()
+
+  Compresses the blocks in Raw on the OpenMP threads and writes them, in
+  their order, with one write
+*****************************************************************************/
+static void FlushBatch(void)
+{
+#ifdef HAVE_ZLIB
+  RESUMEBLOCK *Block;
+  unsigned char *Out;
+  size_t Size;
+  int NBlocks;
+  int Failed = FALSE;
+  int i;
+
+  NBlocks = (int) ((Used + RESUME_BLOCK - 1) / RESUME_BLOCK);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) if (NBlocks > 1)
+#endif
+  for (i = 0; i < NBlocks; i++) {
+    RESUMEBLOCK *Slot = (RESUMEBLOCK *) (Packed + i *
+					 (sizeof(RESUMEBLOCK) + Bound));
+    unsigned char *In = Raw + (size_t) i * RESUME_BLOCK;
+    size_t Count = (Used - (size_t) i * RESUME_BLOCK < RESUME_BLOCK) ?
+      Used - (size_t) i * RESUME_BLOCK : RESUME_BLOCK;
+    uLongf Stored = (uLongf) Bound;
+
+    if (Shuffle) {
+      ShuffleBlock(In, Work + (size_t) i * RESUME_BLOCK, Count, TRUE);
+      In = Work + (size_t) i * RESUME_BLOCK;
+    }
+    if (compress2((unsigned char *) (Slot + 1), &Stored, In, (uLong) Count,
+		  Level) != Z_OK)
+      Failed = TRUE;
+    else if (Stored >= Count) {
+      memcpy(Slot + 1, Raw + (size_t) i * RESUME_BLOCK, Count);
+      Stored = (uLongf) Count;
+    }
+    Slot->Size = (uint32_t) Count;
+    Slot->Stored = (uint32_t) Stored;
+  }
+  if (Failed)
+    ReportError(FileName, 72);
+
+  /* the blocks next to each other, for one write */
+  Out = Packed + sizeof(RESUMEBLOCK) + ((RESUMEBLOCK *) Packed)->Stored;
+  for (i = 1; i < NBlocks; i++) {
+    Block = (RESUMEBLOCK *) (Packed + i * (sizeof(RESUMEBLOCK) + Bound));
+    Size = sizeof(RESUMEBLOCK) + Block->Stored;
+    memmove(Out, Block, Size);
+    Out += Size;
+  }
+  Size = (size_t) (Out - Packed);
+  if (fwrite(Packed, 1, Size, File) != Size)
+    ReportError(FileName, 72);
+  Used = 0;
+#endif
+}
+
+/*****************************************************************************
+  FillBatch()
+
+  Reads the next RESUME_BATCH blocks, or those up to the end of the file,
+  into Packed, and expands them into Raw on the OpenMP threads
+*****************************************************************************/
+static void FillBatch(void)
+{
+#ifdef HAVE_ZLIB
+  RESUMEBLOCK Block[RESUME_BATCH];
+  int NBlocks;
+  int Failed = FALSE;
+  int i;
+
+  for (NBlocks = 0; NBlocks < RESUME_BATCH; NBlocks++) {
+    if (fread(&(Block[NBlocks]), sizeof(RESUMEBLOCK), 1, File) != 1)
+      break;
+    if (Block[NBlocks].Size > RESUME_BLOCK ||
+	Block[NBlocks].Stored > Bound ||
+	Block[NBlocks].Stored > Block[NBlocks].Size ||
+	fread(Packed + NBlocks * Bound, 1, Block[NBlocks].Stored, File) !=
+	Block[NBlocks].Stored)
+      ReportError(FileName, 76);
+    /* only the last block of the state is not full */
+    if (Block[NBlocks].Size < RESUME_BLOCK) {
+      NBlocks++;
+      break;
+    }
+  }
+  if (NBlocks == 0)
+    ReportError(FileName, 76);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(dynamic) if (NBlocks > 1)
+#endif
+  for (i = 0; i < NBlocks; i++) {
+    unsigned char *Out = Shuffle ? Work + (size_t) i * RESUME_BLOCK :
+      Raw + (size_t) i * RESUME_BLOCK;
+    uLongf Size = (uLongf) Block[i].Size;
+
+    if (Block[i].Stored == Block[i].Size)
+      memcpy(Raw + (size_t) i * RESUME_BLOCK, Packed + i * Bound, Size);
+    else if (uncompress(Out, &Size, Packed + i * Bound,
+			(uLong) Block[i].Stored) != Z_OK ||
+	     Size != Block[i].Size)
+      Failed = TRUE;
+    else if (Shuffle)
+      ShuffleBlock(Out, Raw + (size_t) i * RESUME_BLOCK, Size, FALSE);
+  }
+  if (Failed)
+    ReportError(FileName, 76);
+
+  Used = (size_t) (NBlocks - 1) * RESUME_BLOCK + Block[NBlocks - 1].Size;
+  Next = 0;
+#endif
+}
+
+#ifdef HAVE_ZLIB
+/*****************************************************************************
+  ShuffleBlock()
+
+  With Forward TRUE, puts byte j of the 4 byte words of In in the j-th
+  quarter of Out, and with Forward FALSE puts them back.  The bytes after
+  the last full word are copied.
+*****************************************************************************/
+static void ShuffleBlock(const unsigned char *In, unsigned char *Out,
+			 size_t Size, int Forward)
+{
+  size_t NWords = Size / 4;
+  size_t i;
+  int j;
+
+  for (j = 0; j < 4; j++)
+    for (i = 0; i < NWords; i++) {
+      if (Forward)
+	Out[j * NWords + i] = In[4 * i + j];
+      else
+	Out[4 * i + j] = In[j * NWords + i];
+    }
+  memcpy(Out + 4 * NWords, In + 4 * NWords, Size - 4 * NWords);
+}
+#endif
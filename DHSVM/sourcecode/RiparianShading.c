@@ -8,7 +8,11 @@
  * ORIG-DATE:    June-17-2013
  * DESCRIPTION:  Calculate the shadow length resulting from riparian vegetation zone
  * DESCRIP-END.
- * FUNCTIONS:    
+ * FUNCTIONS:    InitChannelRVeg()
+ *               CalcShadeFactor()
+ *               CalcCanopyShading()
+ *               CalcShadeDensity()
+ *               CalcCanopySkyView()
  * Modification 
  * $Id: CalcShadowLength.c, v3.1.2  2013/06/17 Ning Exp $    
  * Reference:
@@ -34,132 +38,187 @@
 #include "channel_grid.h"
 #include "functions.h"
 #include "constants.h"
+#include "rad.h"
 #include "tableio.h"
 #include "settings.h"
+
+/* day of the month of the sun of the shading tables */
+#define SHADE_DAY 15
+
+static float CalcShadeFactor(Channel *Channel, float HDEM, float BufferWidth,
+							 float SolarAltitude, float SolarAzimuth);
   
 /*****************************************************************************
   Function name: InitChannelRVeg()
   Purpose:	 This subroutine initiates the riparian extinction parameter for
-             each channel segment
-*****************************************************************************/
-void InitChannelRVeg(TIMESTRUCT *Time, Channel *Head) 
-{
-	if (Head != NULL) { 
-	  Channel *Current = NULL;
-	  Current = Head;
-	  while (Current) {
-		Current->rveg.Extn = Current->rveg.ExtnCoeff[Time->Current.Month - 1];
-		Current = Current->next;
-	  }
-	}
-}
-/*****************************************************************************
-  Function name: CalcCanopyShading()
-  Purpose:	 This subroutine calculates the shadow length
+             each channel segment, and the shading tables of the month: the
+             effective shade density for beam radiation at each time step of 
+             the day, for the sun of the 15th of the month, and the sky 
+             openness above the canopy.  The geometry only depends on the 
+             segment and the position of the sun, so CalcCanopyShading() 
+             only has to look up the shade of the time step.
+             Called after channel_grid_cross_alloc(), which sets the azimuth of
+             the segments, and at the start of each month.
 *****************************************************************************/
-void CalcCanopyShading(TIMESTRUCT *Time, Channel *Channel, SOLARGEOMETRY *SolarGeo) 
+void InitChannelRVeg(TIMESTRUCT *Time, Channel *Head, SOLARGEOMETRY *SolarGeo) 
 {
-	float Dx1 = 0., Dx2 = 0.;              /* shadow length (in meters) */
-	float SolarAltitude = 0.;   /* in radians */
-	float StreamAzimuth = 0.;   /* in radians */
-	float HDEM = 0.;            /* average height of the canopy in reference to the 
-				                elevation of stream surface */
-	float Net_Shade_Fctr = 0.;  /* the effective shade density fro beam radiation */
-	float SKOP = 0.;            /* sky openess ranging from 0 to 1 */
-	int ShadeCase;
-	float debug;
+	SOLARGEOMETRY RepDay;       /* sun of the representative day */
+	float *SolarAltitude = NULL; /* in radians, for each time step */
+	float *SolarAzimuth = NULL;
+	float BufferWidth;
+	float HDEM;
+	int Step;
+	Channel *Current;
 
-	/* compute solar altitude in radians */
-	SolarAltitude = asin(SolarGeo->SineSolarAltitude);
-	
-	while (Channel) {
-	  if (IsNewMonth(&(Time->Current), Time->Dt))
-		 Channel->rveg.Extn = Channel->rveg.ExtnCoeff[Time->Current.Month - 1];
+	if (Head == NULL)
+	  return;
+
+	if (!(SolarAltitude = (float *) calloc(Time->NDaySteps, sizeof(float))) ||
+		!(SolarAzimuth = (float *) calloc(Time->NDaySteps, sizeof(float))))
+	  ReportError("InitChannelRVeg()", 1);
+
+	/* position of the sun at each time step of the representative day, as
+	   InitNewDay() and InitNewStep() would find it */
+	RepDay = *SolarGeo;
+	InitNewDay(DayOfYear(Time->Current.Year, Time->Current.Month, SHADE_DAY),
+		  &RepDay);
+	for (Step = 0; Step < Time->NDaySteps; Step++) {
+	  StepSolarGeometry(Step, Time->Dt, &RepDay);
+	  SolarAltitude[Step] = asin(RepDay.SineSolarAltitude);
+	  SolarAzimuth[Step] = RepDay.SolarAzimuth;
+	}
 
-	  /* compute stream azimuth in radians */
-	  StreamAzimuth = Channel->azimuth*PI/180.;
+	for (Current = Head; Current != NULL; Current = Current->next) {
+	  Current->rveg.Extn = Current->rveg.ExtnCoeff[Time->Current.Month - 1];
 
-	  /* debug */
-	  if (Channel->rveg.TREEHEIGHT < 0.|| Channel->rveg.BUFFERWIDTH < 0. ||
-		  Channel->rveg.OvhCoeff < 0. || Channel->rveg.Extn < 0. ||
-		  Channel->rveg.CanopyBankDist < 0. ) {
-		ReportError("CalcCanopyShading()", 68);
+	  if (Current->rveg.TREEHEIGHT < 0.|| Current->rveg.BUFFERWIDTH < 0. ||
+		  Current->rveg.OvhCoeff < 0. || Current->rveg.Extn < 0. ||
+		  Current->rveg.CanopyBankDist < 0. ) {
+		ReportError("InitChannelRVeg()", 68);
 	  }
 
+	  if (Current->rveg.ShadeFctr == NULL &&
+		  !(Current->rveg.ShadeFctr = 
+			(float *) calloc(Time->NDaySteps, sizeof(float))))
+		ReportError("InitChannelRVeg()", 1);
+
 	  /* compute the average height of the canopy */
-	  HDEM = Channel->rveg.TREEHEIGHT;
+	  HDEM = Current->rveg.TREEHEIGHT;
 
 	  /* if a vegetation polygon on the sunward bank is located very close 
 	  to the stream, the overhanging canopy righ above the stream surface 
 	  may exist and contribute shade.
 	  The horizontal width of the protruding portion of the canopy toward
 	  the stream is assumed to be a percentage of the tree height. */
-	  Channel->rveg.BUFFERWIDTH += Channel->rveg.TREEHEIGHT * Channel->rveg.OvhCoeff;
-
-	  /* compute the shadow length on the stream */
-	  if (SolarAltitude > 0){
-		/* Examine six (6) cases based on the shadow length, 
-		canopy bank distance and buffer width */
-	    Dx1 = HDEM * fabs(sin(SolarGeo->SolarAzimuth - StreamAzimuth)/tan(SolarAltitude))
-			-(Channel->rveg.CanopyBankDist+Channel->rveg.StreamWidth);
-		Dx2 = HDEM * fabs(sin(SolarGeo->SolarAzimuth - StreamAzimuth)/tan(SolarAltitude))
-			-Channel->rveg.CanopyBankDist;
+	  BufferWidth = Current->rveg.BUFFERWIDTH + 
+		Current->rveg.TREEHEIGHT * Current->rveg.OvhCoeff;
+
+	  for (Step = 0; Step < Time->NDaySteps; Step++)
+		Current->rveg.ShadeFctr[Step] = 
+		  CalcShadeFactor(Current, HDEM, BufferWidth, SolarAltitude[Step],
+						  SolarAzimuth[Step]);
+
+	  /* sky openness for the diffuse and long-wave radiation */
+	  if (HDEM > 0 && Current->rveg.Extn != 0 && BufferWidth != 0)
+		Current->rveg.SkyOpen = CalcCanopySkyView(HDEM, Current->rveg.CanopyBankDist);
+	  else
+		Current->rveg.SkyOpen = 1.;
+	}
+
+	free(SolarAltitude);
+	free(SolarAzimuth);
+}
+/*****************************************************************************
+  Function name: CalcShadeFactor()
+  Purpose:	 This subroutine calculates the effective shade density for beam
+             radiation of a segment, from the shadow length
+*****************************************************************************/
+static float CalcShadeFactor(Channel *Channel, float HDEM, float BufferWidth,
+							 float SolarAltitude, float SolarAzimuth)
+{
+	float Dx1 = 0., Dx2 = 0.;   /* shadow length (in meters) */
+	float StreamAzimuth = 0.;   /* in radians */
+	float Net_Shade_Fctr = 0.;  /* the effective shade density fro beam radiation */
+	int ShadeCase = 1;
+
+	/* no shadow if the sun is below the horizon */
+	if (SolarAltitude <= 0)
+	  return 0.;
+
+	/* compute stream azimuth in radians */
+	StreamAzimuth = Channel->rveg.Azimuth*PI/180.;
+
+	/* Examine six (6) cases based on the shadow length, 
+	canopy bank distance and buffer width */
+	Dx1 = HDEM * fabs(sin(SolarAzimuth - StreamAzimuth)/tan(SolarAltitude))
+		-(Channel->rveg.CanopyBankDist+Channel->rveg.StreamWidth);
+	Dx2 = HDEM * fabs(sin(SolarAzimuth - StreamAzimuth)/tan(SolarAltitude))
+		-Channel->rveg.CanopyBankDist;
 		
-		/* Case 1 - No shade */
-		if (Dx2 <= 0.0 || Channel->rveg.Extn == 0 || Channel->rveg.BUFFERWIDTH == 0)
-          ShadeCase = 1;
-	    /* Case 2 - Partial shade, sun above buffer */
-	    else if (Dx1 <= 0.0 && Dx2 <= Channel->rveg.BUFFERWIDTH) 
-          ShadeCase = 2;
-	    /*Case 3 - Partial shade, sun below buffer */
-	    else if (Dx1 <= 0.0 &&  Dx2 > Channel->rveg.BUFFERWIDTH) 
-          ShadeCase = 3;
-	    /* Case 4 - Full shade, sun above buffer */
-	    else if (Dx1 > 0.0 && Dx2 <= Channel->rveg.BUFFERWIDTH) 
-          ShadeCase = 4;
-	    /* Case 5 - Full shade, sun partially below buffer */
-	    else if (Dx1 > 0.0 && Dx1 <= Channel->rveg.BUFFERWIDTH && Dx2 > Channel->rveg.BUFFERWIDTH)
-          ShadeCase = 5;
-	    /* Case 6 - Full shade, sun entirely below buffer */
-	    else if (Dx1 > Channel->rveg.BUFFERWIDTH && Dx2 > Channel->rveg.BUFFERWIDTH) 
-          ShadeCase = 6;
-
-		if (ShadeCase > 1) 
-	      /* calculate the effective shade density */
-		  Net_Shade_Fctr = CalcShadeDensity(ShadeCase, HDEM, Channel->rveg.StreamWidth,
-					  SolarGeo->SolarAzimuth, StreamAzimuth, SolarAltitude, 
-					  Channel->rveg.TREEHEIGHT, Channel->rveg.BUFFERWIDTH, Dx1, Dx2, Channel->rveg.Extn);
-		else Net_Shade_Fctr = 0.;
-		if (Net_Shade_Fctr > 1) {
-		  printf("The shading density > 1! must be <=0\n");
-		  exit(0);
-		}
+	/* Case 1 - No shade */
+	if (Dx2 <= 0.0 || Channel->rveg.Extn == 0 || BufferWidth == 0)
+	  ShadeCase = 1;
+	/* Case 2 - Partial shade, sun above buffer */
+	else if (Dx1 <= 0.0 && Dx2 <= BufferWidth) 
+	  ShadeCase = 2;
+	/*Case 3 - Partial shade, sun below buffer */
+	else if (Dx1 <= 0.0 &&  Dx2 > BufferWidth) 
+	  ShadeCase = 3;
+	/* Case 4 - Full shade, sun above buffer */
+	else if (Dx1 > 0.0 && Dx2 <= BufferWidth) 
+	  ShadeCase = 4;
+	/* Case 5 - Full shade, sun partially below buffer */
+	else if (Dx1 > 0.0 && Dx1 <= BufferWidth && Dx2 > BufferWidth)
+	  ShadeCase = 5;
+	/* Case 6 - Full shade, sun entirely below buffer */
+	else if (Dx1 > BufferWidth && Dx2 > BufferWidth) 
+	  ShadeCase = 6;
 
+	if (ShadeCase > 1) 
+	  /* calculate the effective shade density */
+	  Net_Shade_Fctr = CalcShadeDensity(ShadeCase, HDEM, Channel->rveg.StreamWidth,
+					  SolarAzimuth, StreamAzimuth, SolarAltitude, 
+					  Channel->rveg.TREEHEIGHT, BufferWidth, Dx1, Dx2, Channel->rveg.Extn);
+	if (Net_Shade_Fctr > 1) {
+	  printf("The shading density > 1! must be <=0\n");
+	  exit(0);
+	}
+
+	return Net_Shade_Fctr;
+}
+/*****************************************************************************
+  Function name: CalcCanopyShading()
+  Purpose:	 This subroutine applies the riparian shading of the time step,
+             from the tables of InitChannelRVeg(), to the radiation of each
+             segment
+*****************************************************************************/
+void CalcCanopyShading(TIMESTRUCT *Time, Channel *Channel, SOLARGEOMETRY *SolarGeo) 
+{
+	float SKOP = 0.;            /* sky openess ranging from 0 to 1 */
+
+	while (Channel) {
+	  if (SolarGeo->SineSolarAltitude > 0) {
 	    /* VEGSHD + OVHSHD is then divided by the stream surface width to 
 	    approximate the fraction of stream surface covered by the composite shade. 
 	    This ratio then is used to estimate the amount of incoming direct beam 
 	    radiation that actually reaches the water surface. */
-	    Channel->Beam *= (1 - Net_Shade_Fctr);
-	    if (Channel->Beam < 0)
-		  Channel->Beam = 0.;
+	    Channel->force->Beam *= (1 - Channel->rveg.ShadeFctr[Time->DayStep]);
+	    if (Channel->force->Beam < 0)
+		  Channel->force->Beam = 0.;
 	  }
 
 	  /* compute shading effect on diffusive radiation */
-	  if (HDEM > 0 && Channel->rveg.Extn != 0 && Channel->rveg.BUFFERWIDTH != 0) {
-		SKOP = CalcCanopySkyView(HDEM, Channel->rveg.CanopyBankDist);
-		Channel->Diffuse *= MIN(Channel->skyview, SKOP);
-	    /* compute long-wave radiation */
-	  }
-	  else {
-		SKOP = 1;
-		Channel->Diffuse *= Channel->skyview;
-	  }
+	  SKOP = Channel->rveg.SkyOpen;
+	  if (SKOP < 1.)
+		Channel->force->Diffuse *= MIN(Channel->force->skyview, SKOP);
+	  else
+		Channel->force->Diffuse *= Channel->force->skyview;
 
 	  /* compute the net shortwave raidation adjusted by canopy shading */
-	  Channel->NSW = Channel->Diffuse + Channel->Beam;
-	  debug = Channel->NLW;
-	  Channel->NLW = Channel->NLW * MIN(Channel->skyview, SKOP) + 
-		   0.96*(1-MIN(Channel->skyview, SKOP))*0.96*STEFAN*pow((double)(Channel->ATP+273.15),4);
+	  Channel->force->NSW = Channel->force->Diffuse + Channel->force->Beam;
+	  /* compute long-wave radiation */
+	  Channel->force->NLW = Channel->force->NLW * MIN(Channel->force->skyview, SKOP) + 
+		   0.96*(1-MIN(Channel->force->skyview, SKOP))*0.96*STEFAN*pow((double)(Channel->force->ATP+273.15),4);
 
 	  Channel = Channel->next;
 	}
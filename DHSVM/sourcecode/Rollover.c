@@ -0,0 +1,358 @@
+/*
+ * SUMMARY:      Rollover.c - Output files of each year or month
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS OUTPUT ROLLOVER = YEAR or MONTH the time series
+ *               outputs of a long run are written to one set of files for
+ *               each calendar year or month, instead of files that grow
+ *               over the whole run.  The name of the file of a period is
+ *               made from the name of the output with the template OPTIONS
+ *               OUTPUT ROLLOVER NAME, in which
+ *                 %N is the name of the output without its extension
+ *                 %E is its extension (.bin, .binz, .nc or .txt, or none)
+ *                 %P is the period, YYYY or YYYY-MM
+ *                 %Y and %M are the year and the month
+ *                 %% is a %
+ *               The default %N.%P%E gives Map.Swq.2003-01.bin for
+ *               Map.Swq.bin.  At the first output step of a new period the
+ *               files are closed and those of the period are started with
+ *               their headers, and each file that is started is listed in
+ *               ROLLOVER_INDEX in the output directory with its period and
+ *               its first step.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitRollover()
+ *               OpenRolloverIndex()
+ *               RolloverIndex()
+ *               GetRolloverDate()
+ *               SetRolloverDate()
+ *               RolloverDue()
+ *               IsRolloverStep()
+ *               RolloverName()
+ *               OpenOutput()
+ *               CreateOutputMap()
+ * COMMENTS:     The outputs that are opened with OpenOutput() and
+ *               CreateOutputMap() roll over.  With ROLLOVER_NONE both open
+ *               the file of the name they are given, and there is no index.
+ *               The period of the open files is part of the resume
+ *               checkpoint, so that a resumed run continues the files of
+ *               the period of the checkpoint.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "fileio.h"
+#include "functions.h"
+#include "rollover.h"
+
+static int Period = ROLLOVER_NONE;
+static char Template[BUFSIZE + 1] = ROLLOVER_TEMPLATE;
+static DATE Open;		/* a date in the period of the open files */
+static DATE Rolled;		/* step at which the files were last started */
+static int HasRolled = FALSE;
+static FILES Index = { "", NULL };
+
+/* extensions that %E keeps at the end of the name, longest first */
+static const char *Extensions[] = { ".binz", ".bin", ".nc", ".txt", NULL };
+
+static int CheckRolloverName(char *Template);
+static int PeriodKey(DATE *Date);
+static void PeriodName(DATE *Date, char *Str);
+static void IndexOutput(char *FileName);
+
+/*****************************************************************************
+  CheckRolloverName()
+
+  Returns TRUE if Template only has the tokens of OUTPUT ROLLOVER NAME, and
+  names each output of each period apart.  The files stay in the output
+  directory, so the template has no directory.
+*****************************************************************************/
+static int CheckRolloverName(char *Template)
+{
+  int HasName = FALSE;
+  int HasPeriod = FALSE;
+  int HasMonth = FALSE;
+  int HasYear = FALSE;
+  char *c;
+
+  for (c = Template; *c != '\0'; c++) {
+    if (*c == '/')
+      return FALSE;
+    if (*c != '%')
+      continue;
+    c++;
+    switch (*c) {
+    case 'P':
+      HasPeriod = TRUE;
+      break;
+    case 'Y':
+      HasYear = TRUE;
+      break;
+    case 'M':
+      HasMonth = TRUE;
+      break;
+    case 'N':
+      HasName = TRUE;
+      break;
+    case 'E':
+    case '%':
+      break;
+    default:
+      return FALSE;
+    }
+  }
+  return HasName && (HasPeriod || HasYear) &&
+    (HasPeriod || HasMonth || Period != ROLLOVER_MONTH);
+}
+
+/*****************************************************************************
+  InitRollover()
+
+  Sets the period of OUTPUT ROLLOVER and the template of the names, and
+  starts the files in the period of Start
+*****************************************************************************/
+void InitRollover(int RolloverPeriod, char *NameTemplate, DATE *Start)
+{
+  Period = RolloverPeriod;
+  strncpy(Template, NameTemplate, BUFSIZE);
+  Template[BUFSIZE] = '\0';
+  if (Period != ROLLOVER_NONE && !CheckRolloverName(Template))
+    ReportError("OUTPUT ROLLOVER NAME", 51);
+  Open = *Start;
+  HasRolled = FALSE;
+}
+
+/*****************************************************************************
+  OpenRolloverIndex()
+
+  Opens ROLLOVER_INDEX in the output directory Path, before the outputs are
+  opened
+*****************************************************************************/
+void OpenRolloverIndex(char *Path)
+{
+  if (Period == ROLLOVER_NONE)
+    return;
+  snprintf(Index.FileName, BUFSIZE + 1, "%s%s", Path, ROLLOVER_INDEX);
+  OpenFile(&(Index.FilePtr), Index.FileName, "w", TRUE);
+}
+
+/*****************************************************************************
+  RolloverIndex()
+
+  The index file, with an empty name if there is none, for the list of the
+  output files of the resume checkpoint and of the branches
+*****************************************************************************/
+FILES *RolloverIndex(void)
+{
+  return &Index;
+}
+
+/*****************************************************************************
+  GetRolloverDate(), SetRolloverDate()
+
+  A date in the period of the open files, set to that of the checkpoint
+  when a run is resumed, before the outputs are opened
+*****************************************************************************/
+void GetRolloverDate(DATE *Date)
+{
+  *Date = Open;
+}
+
+void SetRolloverDate(DATE *Date)
+{
+  Open = *Date;
+}
+
+/*****************************************************************************
+  RolloverDue()
+
+  Returns TRUE if the output step Current is in another period than the
+  open files, which are then to be started again for the period of Current
+*****************************************************************************/
+int RolloverDue(DATE *Current)
+{
+  if (Period == ROLLOVER_NONE || PeriodKey(Current) == PeriodKey(&Open))
+    return FALSE;
+  Open = *Current;
+  Rolled = *Current;
+  HasRolled = TRUE;
+  return TRUE;
+}
+
+/*****************************************************************************
+  IsRolloverStep()
+
+  Returns TRUE if the files were started again at step Current, so that the
+  text outputs write their headers as at the first step of the run
+*****************************************************************************/
+int IsRolloverStep(DATE *Current)
+{
+  return HasRolled && IsEqualTime(Current, &Rolled);
+}
+
+/*****************************************************************************
+  RolloverName()
+
+  Name of the file of the open period for the output BaseName, which may
+  be FileName itself
+*****************************************************************************/
+void RolloverName(char *FileName, char *BaseName)
+{
+  char Name[BUFSIZE + 1];
+  char Str[BUFSIZE + 1];
+  char Label[BUFSIZE + 1];
+  const char *Ext = "";
+  char *File;
+  size_t Len;
+  size_t n;
+  char *c;
+  int i;
+
+  if (Period == ROLLOVER_NONE) {
+    if (FileName != BaseName)
+      strcpy(FileName, BaseName);
+    return;
+  }
+
+  /* the directory is kept, the template makes the name of the file */
+  File = strrchr(BaseName, '/');
+  File = (File == NULL) ? BaseName : File + 1;
+  strncpy(Name, File, BUFSIZE);
+  Name[BUFSIZE] = '\0';
+  Len = strlen(Name);
+  for (i = 0; Extensions[i] != NULL; i++) {
+    n = strlen(Extensions[i]);
+    if (Len > n && strcmp(Name + Len - n, Extensions[i]) == 0) {
+      Ext = Extensions[i];
+      Name[Len - n] = '\0';
+      break;
+    }
+  }
+
+  n = File - BaseName;
+  memcpy(Str, BaseName, n);
+  Str[n] = '\0';
+  for (c = Template; *c != '\0' && n < BUFSIZE; c++) {
+    if (*c != '%') {
+      Str[n++] = *c;
+      Str[n] = '\0';
+      continue;
+    }
+    c++;
+    switch (*c) {
+    case 'N':
+      strcpy(Label, Name);
+      break;
+    case 'E':
+      strcpy(Label, Ext);
+      break;
+    case 'P':
+      PeriodName(&Open, Label);
+      break;
+    case 'Y':
+      sprintf(Label, "%04d", Open.Year);
+      break;
+    case 'M':
+      sprintf(Label, "%02d", Open.Month);
+      break;
+    default:
+      strcpy(Label, "%");
+      break;
+    }
+    strncat(Str, Label, BUFSIZE - n);
+    n = strlen(Str);
+  }
+  strcpy(FileName, Str);
+}
+
+/*****************************************************************************
+  OpenOutput()
+
+  Closes the stream FilePtr of the previous period if it is open, and opens
+  the file of the open period of the output BaseName with Mode.  FileName
+  gets the name of the file, and may be BaseName itself.
+*****************************************************************************/
+void OpenOutput(FILE **FilePtr, char *FileName, char *BaseName, char *Mode)
+{
+  if (*FilePtr != NULL) {
+    fclose(*FilePtr);
+    *FilePtr = NULL;
+  }
+  RolloverName(FileName, BaseName);
+  OpenFile(FilePtr, FileName, Mode, TRUE);
+  IndexOutput(FileName);
+}
+
+/*****************************************************************************
+  CreateOutputMap()
+
+  Creates the map file of the open period for the map dump DMap, whose
+  FileName is the name of the output and becomes that of the file.  The
+  records of the file are numbered from the first dump date of DMap in the
+  period.  The grid of the file is the window of DMap (see MapWindow.c).
+*****************************************************************************/
+void CreateOutputMap(MAPDUMP *DMap, MAPSIZE *Map, NCSTORAGE *Storage)
+{
+  MAPSIZE Out;
+  int i;
+
+  DMap->FirstIndex = 0;
+  if (Period != ROLLOVER_NONE) {
+    DMap->FirstIndex = DMap->N;
+    for (i = DMap->N - 1; i >= 0; i--)
+      if (PeriodKey(&(DMap->DumpDate[i])) == PeriodKey(&Open))
+	DMap->FirstIndex = i;
+  }
+  RolloverName(DMap->FileName, DMap->FileName);
+  WindowMapSize(Map, DMap, &Out);
+  CreateMapFile(DMap->FileName, DMap->FileLabel, &Out, Storage);
+  IndexOutput(DMap->FileName);
+}
+
+/*****************************************************************************
+  PeriodKey(), PeriodName()
+
+  Number and name of the period of Date
+*****************************************************************************/
+static int PeriodKey(DATE *Date)
+{
+  if (Period == ROLLOVER_MONTH)
+    return Date->Year * 12 + Date->Month - 1;
+  return Date->Year;
+}
+
+static void PeriodName(DATE *Date, char *Str)
+{
+  if (Period == ROLLOVER_MONTH)
+    sprintf(Str, "%04d-%02d", Date->Year, Date->Month);
+  else
+    sprintf(Str, "%04d", Date->Year);
+}
+
+/*****************************************************************************
+  IndexOutput()
+
+  Lists the file FileName of the open period in the index, with the period
+  and the first step of the file
+*****************************************************************************/
+static void IndexOutput(char *FileName)
+{
+  char Str[BUFSIZE + 1];
+  char *File;
+
+  if (Index.FilePtr == NULL)
+    return;
+  File = strrchr(FileName, '/');
+  File = (File == NULL) ? FileName : File + 1;
+  PeriodName(&Open, Str);
+  fprintf(Index.FilePtr, "%-8s ", Str);
+  PrintDate(&Open, Index.FilePtr);
+  fprintf(Index.FilePtr, " %s\n", File);
+  fflush(Index.FilePtr);
+}
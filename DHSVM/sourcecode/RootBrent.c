@@ -7,10 +7,13 @@
  * E-MAIL:       nijssen@u.washington.edu
  * ORIG-DATE:    Apr-96
  * DESCRIPTION:  Determine surface temperature iteratively using the Brent
- *               method.  
+ *               method or a safeguarded Newton-Raphson method.  
  * DESCRIP-END.
  * FUNCTIONS:    RootBrent()
- * COMMENTS:
+ *               RootNewton()
+ * COMMENTS:     y and x are only used in the message of a solve that fails,
+ *               which is only formatted then.  The functions keep no state,
+ *               so the solves of several threads can run at the same time
  * $Id: RootBrent.c,v 1.4 2003/07/01 21:26:23 olivier Exp $     
  */
 
@@ -65,6 +68,7 @@
     int x                 - Column number of current pixel 
     float LowerBound      - Lower bound for root
     float UpperBound      - Upper bound for root
+    int *NIter            - Number of function evaluations used
     float (*Function)(float Estimate, va_list ap)
     ...                   - Variable arguments 
                             The number and order of arguments has to be
@@ -77,11 +81,11 @@
   Returns      :
     float b               - Effective surface temperature (C)
 
-  Modifies     : none
+  Modifies     : *NIter
 
   Comments     :
 *****************************************************************************/
-float RootBrent(int y, int x, float LowerBound, float UpperBound,
+float RootBrent(int y, int x, float LowerBound, float UpperBound, int *NIter,
 		float (*Function) (float Estimate, va_list ap), ...)
 {
   const char *Routine = "RootBrent";
@@ -106,8 +110,6 @@ float RootBrent(int y, int x, float LowerBound, float UpperBound,
   int j;
   int eval = 0;
 
-  sprintf(ErrorString, "%s: y = %d, x = %d", Routine, y, x);
-
   /* initialize variable argument list */
 
   a = LowerBound;
@@ -134,6 +136,7 @@ float RootBrent(int y, int x, float LowerBound, float UpperBound,
     j++;
   }
   if ((fa * fb) >= 0) {
+    sprintf(ErrorString, "%s: y = %d, x = %d", Routine, y, x);
     ReportError(ErrorString, 34);
   }
   fc = fb;
@@ -161,6 +164,7 @@ float RootBrent(int y, int x, float LowerBound, float UpperBound,
 
     if (fabs(m) <= tol || fequal(fb, 0.0)) {
       va_end(ap);
+      *NIter = eval;
       return b;
     }
 
@@ -211,5 +215,171 @@ float RootBrent(int y, int x, float LowerBound, float UpperBound,
       eval++;
     }
   }
+  sprintf(ErrorString, "%s: y = %d, x = %d", Routine, y, x);
+  ReportError(ErrorString, 33);
+}
+
+/*****************************************************************************
+  Function name: RootNewton()
+
+  Purpose      : Calculate the surface temperature for which the energy 
+                 balance closes, using Newton-Raphson iterations that are
+                 safeguarded by bisection
+
+  Required     :
+    int y                 - Row number of current pixel
+    int x                 - Column number of current pixel 
+    float LowerBound      - Lower bound for root
+    float UpperBound      - Upper bound for root
+    float Guess           - First estimate of the root, usually the value 
+                            from the previous time step
+    int *NIter            - Number of function evaluations used
+    float (*Function)(float Estimate, void *Params, float *Derivative)
+                          - Function that returns the energy balance for 
+                            Estimate and its derivative with respect to 
+                            Estimate in *Derivative
+    void *Params          - Parameters passed on to Function
+
+  Returns      :
+    float                 - Effective surface temperature (C)
+
+  Modifies     : *NIter
+
+  Comments     : The iterations start from Guess and the function is only 
+                 evaluated at the bounds when a Newton step leaves the 
+                 bounds or does not converge fast enough.  In that case the
+                 root is bracketed in the same way as in RootBrent() and the
+                 iterations continue with bisection steps whenever a Newton 
+                 step falls outside the bracket.  The convergence tolerance
+                 is the same as in RootBrent().  The last function evaluation
+                 is always done for the returned root, so that any other 
+                 values calculated by Function correspond to the root.
+*****************************************************************************/
+float RootNewton(int y, int x, float LowerBound, float UpperBound, 
+		 float Guess, int *NIter,
+		 float (*Function) (float Estimate, void *Params, 
+				    float *Derivative), void *Params)
+{
+  const char *Routine = "RootNewton";
+  char ErrorString[MAXSTRING + 1];
+  float a;			/* lower bound */
+  float b;			/* upper bound */
+  float dfr;			/* derivative at the current estimate */
+  float dx;			/* last step */
+  float dxold;			/* step before the last one */
+  float fa;
+  float fb;
+  float fr;			/* function value at the current estimate */
+  float Lower;			/* lower end of the bracket */
+  float Upper;			/* upper end of the bracket */
+  float r;			/* current estimate of the root */
+  float rnew;			/* next estimate of the root */
+  float tol;
+  float xneg;			/* estimate with a negative function value */
+  float xpos;			/* estimate with a positive function value */
+  int HaveNeg = FALSE;
+  int HavePos = FALSE;
+  int i;
+  int j;
+  int eval = 0;
+
+  a = LowerBound;
+  b = UpperBound;
+  xneg = xpos = 0.0;
+
+  r = Guess;
+  if (r < a || r > b)
+    r = 0.5 * (a + b);
+  dx = dxold = b - a;
+
+  for (i = 0; i < MAXITER; i++) {
+
+    fr = Function(r, Params, &dfr);
+    eval++;
+
+    if (fequal(fr, 0.0)) {
+      *NIter = eval;
+      return r;
+    }
+
+    /* the estimates with a positive and a negative function value bracket
+       the root */
+    if (fr < 0) {
+      xneg = r;
+      HaveNeg = TRUE;
+    }
+    else {
+      xpos = r;
+      HavePos = TRUE;
+    }
+
+    tol = 2 * MACHEPS * fabs(r) + T;
+    if ((i > 0 && fabs(dx) <= tol) || 
+	(HaveNeg && HavePos && fabs(xpos - xneg) <= 2 * tol)) {
+      *NIter = eval;
+      return r;
+    }
+
+    rnew = (dfr != 0.0) ? r - fr / dfr : r;
+
+    /* take a bisection step if the Newton step leaves the bracket or does
+       not reduce the step size fast enough.  If the root has not been 
+       bracketed yet, bracket it in the same way as RootBrent() first */
+    if (fequal(rnew, r) || rnew < a || rnew > b || 
+	fabs(2 * fr) > fabs(dxold * dfr)) {
+      if (!(HaveNeg && HavePos)) {
+	fa = Function(a, Params, NULL);
+	eval++;
+	fb = Function(b, Params, NULL);
+	eval++;
+	j = 0;
+	while ((fa * fb) >= 0 && j < MAXTRIES) {
+	  a -= TSTEP;
+	  b += TSTEP;
+	  fa = Function(a, Params, NULL);
+	  eval++;
+	  fb = Function(b, Params, NULL);
+	  eval++;
+	  j++;
+	}
+	if ((fa * fb) >= 0) {
+	  sprintf(ErrorString, "%s: y = %d, x = %d", Routine, y, x);
+	  ReportError(ErrorString, 34);
+	}
+	/* r lies between a and b, so one of them brackets the root with r */
+	if ((fr < 0) == (fa < 0)) {
+	  if (fb < 0)
+	    xneg = b;
+	  else
+	    xpos = b;
+	}
+	else {
+	  if (fa < 0)
+	    xneg = a;
+	  else
+	    xpos = a;
+	}
+	HaveNeg = HavePos = TRUE;
+      }
+      Lower = MIN(xneg, xpos);
+      Upper = MAX(xneg, xpos);
+      if (fequal(rnew, r) || rnew <= Lower || rnew >= Upper ||
+	  fabs(2 * fr) > fabs(dxold * dfr))
+	rnew = 0.5 * (Lower + Upper);
+    }
+    else if (HaveNeg && HavePos) {
+      Lower = MIN(xneg, xpos);
+      Upper = MAX(xneg, xpos);
+      if (rnew <= Lower || rnew >= Upper)
+	rnew = 0.5 * (Lower + Upper);
+    }
+
+    dxold = dx;
+    dx = rnew - r;
+    r = rnew;
+  }
+
+  sprintf(ErrorString, "%s: y = %d, x = %d", Routine, y, x);
   ReportError(ErrorString, 33);
+  return r;
 }
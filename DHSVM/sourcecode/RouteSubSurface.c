@@ -8,7 +8,11 @@
  * ORIG-DATE:    Apr-96
  * DESCRIPTION:  Route subsurface flow
  * DESCRIP-END.
- * FUNCTIONS:    RouteSubSurface()
+ * FUNCTIONS:    InitSubSurfaceWork()
+ *               RouteSubSurface()
+ *               SubSurfaceStep()
+ *               DistributeSubStep()
+ *               SubSurfaceConstants()
  * COMMENTS:
  * $Id: RouteSubSurface.c,v3.1.2 2013/08/18 ning Exp $     
  */
@@ -20,6 +24,7 @@
 #include "data.h"
 #include "DHSVMerror.h"
 #include "functions.h"
+#include "memaccount.h"
 #include "constants.h"
 #include "soilmoisture.h"
 #include "slopeaspect.h"
@@ -29,6 +34,117 @@
 #define MIN_GRAD .3		/* minimum slope for flow to channel */
 #endif
 
+/* Destination of the channel interception stored in Work->ToChannel */
+#define ROAD_INFLOW    1
+#define STREAM_INFLOW  2
+
+/* Channels in a cell, stored in Work->HasChannel */
+#define HAS_STREAM     1
+#define HAS_ROAD       2
+
+static void SubSurfaceStep(int Dt, int First, MAPSIZE *Map,
+			   TOPOPIX **TopoMap, CELLCLASSES *Classes,
+			   ROADSTRUCT **Network, SOILPIX **SoilMap,
+			   CHANNEL *ChannelData, OPTIONSTRUCT *Options,
+			   FLOWGRAPH *SurfaceGraph, SUBSURFACEWORK *Work);
+static void DistributeSubStep(int Dt, MAPSIZE *Map, TOPOPIX **TopoMap,
+			      CELLCLASSES *Classes, ROADSTRUCT **Network,
+			      SOILPIX **SoilMap, OPTIONSTRUCT *Options);
+static void SubSurfaceConstants(int i, int x, int y, unsigned char *SubDir,
+				unsigned int SubTotalDir,
+				ROADSTRUCT **Network, SOILPIX **SoilMap,
+				CHANNEL *ChannelData, SUBSURFACEWORK *Work);
+
+
+/*****************************************************************************
+  InitSubSurfaceWork()
+
+  Allocates the subsurface flow direction workspace used by 
+  RouteSubSurface().  The workspace is allocated once and reused every time
+  step.  The per cell flows are always needed; the directions and the flow
+  graph only when the flow gradient is based on the water table, with 
+  TOPOGRAPHY the directions in TopoMap and the surface flow graph are used 
+  directly.
+*****************************************************************************/
+void InitSubSurfaceWork(MAPSIZE *Map, OPTIONSTRUCT *Options,
+			SUBSURFACEWORK *Work)
+{
+  const char *Routine = "InitSubSurfaceWork";
+  int NCells = Map->NY * Map->NX;
+
+  Work->FlowGrad = NULL;
+  Work->Dir = NULL;
+  Work->TotalDir = NULL;
+  Work->LastLevel = NULL;
+  Work->Changed = NULL;
+  Work->Updated = NULL;
+  Work->Valid = FALSE;
+  Work->ConstValid = FALSE;
+  Work->Graph.Start = NULL;
+  Work->Graph.RecvX = NULL;
+  Work->Graph.RecvY = NULL;
+  Work->Graph.Fract = NULL;
+  Work->Graph.Index = NULL;
+  Work->Graph.RevStart = NULL;
+  Work->Graph.RevDonor = NULL;
+  Work->Graph.RevEdge = NULL;
+
+  if (!(Work->OutFlow = (float *) TaggedCalloc(Map->NumActive, sizeof(float),
+					       MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->OwnFlow = (float *) TaggedCalloc(Map->NumActive, sizeof(float),
+					       MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->ChannelFlow = (float *) TaggedCalloc(Map->NumActive,
+						   sizeof(float), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->ToChannel = (unsigned char *) TaggedCalloc(Map->NumActive, 
+						    sizeof(unsigned char), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->BankHeight = (float *) TaggedCalloc(Map->NumActive,
+						  sizeof(float), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->FractUsed = (float *) TaggedCalloc(Map->NumActive, sizeof(float),
+						 MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->RoadFract = (float *) TaggedCalloc(Map->NumActive, sizeof(float),
+						 MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->HasChannel = (unsigned char *) TaggedCalloc(Map->NumActive, 
+						     sizeof(unsigned char), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  FirstTouchBlock(Work->OutFlow, Map->NumActive, sizeof(float));
+  FirstTouchBlock(Work->OwnFlow, Map->NumActive, sizeof(float));
+  FirstTouchBlock(Work->ChannelFlow, Map->NumActive, sizeof(float));
+  FirstTouchBlock(Work->BankHeight, Map->NumActive, sizeof(float));
+  FirstTouchBlock(Work->FractUsed, Map->NumActive, sizeof(float));
+  FirstTouchBlock(Work->RoadFract, Map->NumActive, sizeof(float));
+  InitTiles(&(Work->Tiles), Map->NumActive, Options->CellTileSize,
+	    Options->NThreads);
+
+  if (Options->FlowGradient != WATERTABLE)
+    return;
+
+  if (!(Work->FlowGrad = (float *) TaggedCalloc(NCells, sizeof(float),
+						MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->Dir = (unsigned char *) TaggedCalloc(NCells * NDIRS,
+						   sizeof(unsigned char), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->TotalDir = (unsigned int *) TaggedCalloc(NCells,
+						       sizeof(unsigned int), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->LastLevel = (float *) TaggedCalloc(NCells, sizeof(float),
+						 MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->Changed = (unsigned char *) TaggedCalloc((Map->NY + 2) * (Map->NX + 2),
+						  sizeof(unsigned char), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Work->Updated = (unsigned char *) TaggedCalloc(NCells,
+						       sizeof(unsigned char), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  InitFlowGraph(Map, &(Work->Graph));
+}
 
 /*****************************************************************************
   RouteSubSurface()
@@ -93,19 +209,76 @@
   and FlowGrad (SubDir, SubTotalDir, SubFlowGrad) for Gradient = WATERTABLE 
   are now determined locally here (in RouteSubsurface.c.)
 
+  The outflow of each cell is distributed over the receivers listed in a 
+  FLOWGRAPH: SurfaceGraph for Gradient = TOPOGRAPHY, and Work->Graph, 
+  rebuilt from the water table directions each time step, for 
+  Gradient = WATERTABLE.
+
+  The routing is done in three sweeps so that the work for each cell can be
+  shared over Options->NThreads threads without two threads adding to the 
+  same cell.  The first sweep calculates the outflow of each cell and only 
+  writes to that cell and to Work.  The second sweep gathers for each cell 
+  the inflow from its donors (FLOWGRAPH RevDonor), in increasing active 
+  cell order and with the cell's own outflow subtracted at the point where
+  the serial scatter over the active cells would have done so.  The sums
+  are therefore taken in the same order as before and the results do not 
+  depend on the number of threads.  The third sweep passes the 
+  interception to the road and stream channels, in cell order.
+
+  The parts of the calculation that only depend on the flow directions and
+  the cell geometry (BankHeight, the used fraction of the directions, the 
+  road fraction and the channels in the cell) are kept in Work and set by 
+  SubSurfaceConstants().  With Gradient = TOPOGRAPHY this is done on the
+  first call only, with WATERTABLE for the cells whose directions were 
+  recalculated by HeadSlopeAspect().
+
+  With SUBSURFACE ROUTING SUBSTEPS the time step is routed in that many
+  steps of Dt / Options->SubSurfaceSubsteps.  After each sub-step but the
+  last the saturated flow is added to the soil columns and the water table
+  follows it, as DistributeSatflow() does at the start of the next time
+  step, so the flow of the next sub-step starts from the new water table.
+  The road and stream interception are summed over the sub-steps, SatFlow 
+  is the flow of the last sub-step.
+
   WORK IN PROGRESS
 *****************************************************************************/
 void RouteSubSurface(int Dt, MAPSIZE *Map, TOPOPIX **TopoMap,
-		     VEGTABLE *VType, VEGPIX **VegMap,
-		     ROADSTRUCT **Network, SOILTABLE *SType,
+		     CELLCLASSES *Classes, ROADSTRUCT **Network,
 		     SOILPIX **SoilMap, CHANNEL *ChannelData,
 		     TIMESTRUCT *Time, OPTIONSTRUCT *Options, 
-		     char *DumpPath, int MaxStreamID, SNOWPIX **SnowMap)
+		     int MaxStreamID, SNOWPIX **SnowMap, FLOWGRAPH *SurfaceGraph,
+		     SUBSURFACEWORK *Work)
 {
-  const char *Routine = "RouteSubSurface";
+  int s;			/* sub-step */
+
+  for (s = 0; s < Options->SubSurfaceSubsteps; s++) {
+    if (s > 0)
+      DistributeSubStep(Dt / Options->SubSurfaceSubsteps, Map, TopoMap,
+			Classes, Network, SoilMap, Options);
+    SubSurfaceStep(Dt / Options->SubSurfaceSubsteps, s == 0, Map, TopoMap,
+		   Classes, Network, SoilMap, ChannelData, Options,
+		   SurfaceGraph, Work);
+  }
+}
+
+/*****************************************************************************
+  SubSurfaceStep()
+
+  One step of Dt of RouteSubSurface(), the road interception is reset on
+  the First sub-step of the time step and added to on the others
+*****************************************************************************/
+static void SubSurfaceStep(int Dt, int First, MAPSIZE *Map,
+			   TOPOPIX **TopoMap, CELLCLASSES *Classes,
+			   ROADSTRUCT **Network, SOILPIX **SoilMap,
+			   CHANNEL *ChannelData, OPTIONSTRUCT *Options,
+			   FLOWGRAPH *SurfaceGraph, SUBSURFACEWORK *Work)
+{
+  FLOWGRAPH *Graph;		/* Receivers of the subsurface flow */
+  CELLCLASS *Class;		/* Vegetation and soil class of the cell */
+  int i;			/* active cell counter */
+  int t;			/* tile */
   int x;			/* counter */
   int y;			/* counter */
-  int i, j;	        /* counters */
   float BankHeight;
   float *Adjust;
   float fract_used;
@@ -113,241 +286,310 @@ void RouteSubSurface(int Dt, MAPSIZE *Map, TOPOPIX **TopoMap,
   float OutFlow;
   float water_out_road;
   float Transmissivity;
-  float AvailableWater;
+  float AvailableWater;		/* water above field capacity down to the
+				   soil depth */
+  float BankWater;		/* and down to the bank height */
   int k;
-  float **SubFlowGrad;	        /* Magnitude of subsurface flow gradient slope * width */
-  unsigned char ***SubDir;      /* Fraction of flux moving in each direction*/ 
-  unsigned int **SubTotalDir;	/* Sum of Dir array */
-
-  int count, totalcount;
-  float mgrid, sat;
-  char buffer[32];
-  char satoutfile[100];         /* Character arrays to hold file name. */ 
-  FILE *fs;                     /* File pointer. */
-
-  /*****************************************************************************
-   Allocate memory 
-  ****************************************************************************/
-  
-  if (!(SubFlowGrad = (float **)calloc(Map->NY, sizeof(float *))))
-    ReportError((char *) Routine, 1);
-  for(i=0; i<Map->NY; i++) {
-    if (!(SubFlowGrad[i] = (float *)calloc(Map->NX, sizeof(float))))
-      ReportError((char *) Routine, 1);
-  }
-  
-  if (!((SubDir) = (unsigned char ***) calloc(Map->NY, sizeof(unsigned char **))))
-    ReportError((char *) Routine, 1);
-  for (i=0; i<Map->NY; i++) {
-    if (!((SubDir)[i] = (unsigned char **) calloc(Map->NX, sizeof(unsigned char*))))
-	  ReportError((char *) Routine, 1);
-	for (j=0; j<Map->NX; j++) {
-      if (!(SubDir[i][j] = (unsigned char *)calloc(NDIRS, sizeof(unsigned char ))))
-		ReportError((char *) Routine, 1);
-    }
-  }
+  int e;			/* receiver counter */
+  int d;			/* donor counter */
+  int Subtracted;
+  float SatFlow;
+  float SubFlowGrad;	        /* Magnitude of subsurface flow gradient slope * width */
+  unsigned char *SubDir;        /* Fraction of flux moving in each direction*/ 
+  unsigned int SubTotalDir;	/* Sum of Dir array */
 
-  if (!(SubTotalDir = (unsigned int **)calloc(Map->NY, sizeof(unsigned int *))))
-    ReportError((char *) Routine, 1);
-  for (i=0; i<Map->NY; i++) {
-    if (!(SubTotalDir[i] = (unsigned int *)calloc(Map->NX, sizeof(unsigned int))))
-      ReportError((char *) Routine, 1);
-  }
-  
-  /* reset the saturated subsurface flow to zero */
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-		SoilMap[y][x].SatFlow = 0;
-		SoilMap[y][x].RoadInt = 0;
-      }
-    }
+  /* reset the road interception to zero, the saturated subsurface flow is
+     assigned below */
+  for (i = 0; First && i < Map->NumActive; i++) {
+    y = Map->ActiveCells[i].y;
+    x = Map->ActiveCells[i].x;
+    SoilMap[y][x].RoadInt = 0;
   }
 
-  if (Options->FlowGradient == WATERTABLE)
-    HeadSlopeAspect(Map, TopoMap, SoilMap, SubFlowGrad, SubDir, SubTotalDir);
+  if (Options->FlowGradient == WATERTABLE) {
+    HeadSlopeAspect(Map, TopoMap, SoilMap, Options->WaterTableTol, Work);
+    MakeFlowGraph(Map, TopoMap, Work->Dir, Work->TotalDir, &(Work->Graph));
+    Graph = &(Work->Graph);
+  }
+  else
+    Graph = SurfaceGraph;
 
   /* next sweep through all the grid cells, calculate the amount of
-     flow in each direction, and divide the flow over the surrounding
-     pixels */
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-		if (Options->FlowGradient == TOPOGRAPHY){
-		  SubTotalDir[y][x] = TopoMap[y][x].TotalDir;
-	      SubFlowGrad[y][x] = TopoMap[y][x].FlowGrad;
-		  for (k = 0; k < NDIRS; k++) 
-	        SubDir[y][x][k] = TopoMap[y][x].Dir[k];
-		}
-		BankHeight = (Network[y][x].BankHeight > SoilMap[y][x].Depth) ?
-	    SoilMap[y][x].Depth : Network[y][x].BankHeight;
-	    Adjust = Network[y][x].Adjust;
-	    fract_used = 0.0f;
-		water_out_road = 0.0;
-		
-		if (!channel_grid_has_channel(ChannelData->stream_map, x, y)) {
-	      for (k = 0; k < NDIRS; k++) {
-			fract_used += (float) SubDir[y][x][k];
+     flow in each direction, and the flow that leaves each cell */
+  PlanTiles(&(Work->Tiles));
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(Options->NThreads) \
+  private(t, i, y, x, SubTotalDir, SubFlowGrad, SubDir, BankHeight, Adjust, \
+	  fract_used, water_out_road, depth, Transmissivity, OutFlow, \
+	  AvailableWater, BankWater, Class)
+#endif
+  while ((t = NextTile(&(Work->Tiles))) >= 0) {
+    for (i = Work->Tiles.Start[t]; i < Work->Tiles.Start[t + 1]; i++) {
+      y = Map->ActiveCells[i].y;
+      x = Map->ActiveCells[i].x;
+      Class = &(Classes->Class[Classes->Of[i]]);
+		  if (Options->FlowGradient != WATERTABLE){
+		    SubTotalDir = TopoMap[y][x].TotalDir;
+		SubFlowGrad = TopoMap[y][x].FlowGrad;
+		SubDir = TopoMap[y][x].Dir;
+		  }
+		  else {
+		    SubTotalDir = Work->TotalDir[y * Map->NX + x];
+		    SubFlowGrad = Work->FlowGrad[y * Map->NX + x];
+		    SubDir = &(Work->Dir[(y * Map->NX + x) * NDIRS]);
 		  }
-		  if (SubTotalDir[y][x] > 0)
-	        fract_used /= (float) SubTotalDir[y][x];
-		  else
-	        fract_used = 0.;
+		  if (!Work->ConstValid || (Options->FlowGradient == WATERTABLE &&
+					    Work->Updated[y * Map->NX + x]))
+		    SubSurfaceConstants(i, x, y, SubDir, SubTotalDir, Network,
+					SoilMap, ChannelData, Work);
+		  BankHeight = Work->BankHeight[i];
+	      Adjust = Network[y][x].Adjust;
+		  water_out_road = 0.0;
+		  Work->OutFlow[i] = 0.0f;
+		  Work->OwnFlow[i] = 0.0f;
+		  Work->ChannelFlow[i] = 0.0f;
+		  Work->ToChannel[i] = 0;
+
+		  /* the water available for redistribution, once per cell: down
+		     to the soil depth for the flow to the neighbours of a cell
+		     without a stream, and down to the bank height for the road
+		     or stream interception */
+		  AvailableWater =
+		    CalcAvailableWater(Class->VType->NSoilLayers,
+			(Work->HasChannel[i] & HAS_STREAM) ?
+			0.0f : SoilMap[y][x].Depth,
+			Class->VType->RootDepth, Class->SType->Porosity,
+			Class->SType->FCap, SoilMap[y][x].TableDepth, Adjust,
+			&(Network[y][x].Capacity),
+			(Work->HasChannel[i] & (HAS_STREAM | HAS_ROAD)) ?
+			BankHeight : 0.0f, &BankWater);
+		
+		  if (!(Work->HasChannel[i] & HAS_STREAM)) {
+		    fract_used = Work->FractUsed[i];
 		  
-		  /* only bother calculating subsurface flow if water table is above bedrock */
-		  if (SoilMap[y][x].TableDepth < SoilMap[y][x].Depth) {
-	        depth = ((SoilMap[y][x].TableDepth > BankHeight) ?
-				SoilMap[y][x].TableDepth : BankHeight);
+		    /* only bother calculating subsurface flow if water table is above bedrock */
+		    if (SoilMap[y][x].TableDepth < SoilMap[y][x].Depth) {
+		  depth = ((SoilMap[y][x].TableDepth > BankHeight) ?
+				  SoilMap[y][x].TableDepth : BankHeight);
 			
-			Transmissivity = CalcTransmissivity(SoilMap[y][x].Depth, depth,
-				 SType[SoilMap[y][x].Soil - 1].KsLat,
-				 SType[SoilMap[y][x].Soil - 1].KsLatExp,
-                 SType[SoilMap[y][x].Soil - 1].DepthThresh);
+			  Transmissivity = SoilTransmissivity(SoilMap[y][x].Depth, depth,
+				   Class->SType);
 			
-			OutFlow = 
-				(Transmissivity * fract_used * SubFlowGrad[y][x] * Dt) / (Map->DX * Map->DY);
+			  OutFlow = 
+				  (Transmissivity * fract_used * SubFlowGrad * Dt) / (Map->DX * Map->DY);
 			
-			/* check whether enough water is available for redistribution */
-			AvailableWater =
-				CalcAvailableWater(VType[VegMap[y][x].Veg - 1].NSoilLayers,
-				 SoilMap[y][x].Depth, VType[VegMap[y][x].Veg - 1].RootDepth,
-				 SType[SoilMap[y][x].Soil - 1].Porosity, SType[SoilMap[y][x].Soil - 1].FCap,
-				 SoilMap[y][x].TableDepth, Adjust);
-			OutFlow = (OutFlow > AvailableWater) ? AvailableWater : OutFlow;
-		  }
-		  else {
-	        depth = SoilMap[y][x].Depth;
-	        OutFlow = 0.0f;
-		  }
+			  /* check whether enough water is available for redistribution */
+			  OutFlow = (OutFlow > AvailableWater) ? AvailableWater : OutFlow;
+		    }
+		    else {
+		  depth = SoilMap[y][x].Depth;
+		  OutFlow = 0.0f;
+		    }
 		  
-		  /* compute road interception if water table is above road cut */
-		  if (SoilMap[y][x].TableDepth < BankHeight &&
-			  channel_grid_has_channel(ChannelData->road_map, x, y)) {
-		    if (SubTotalDir[y][x] > 0)
-	          fract_used = ((float) Network[y][x].fraction /
-			    (float)SubTotalDir[y][x]);
-			else
-	          fract_used = 0.;
-			Transmissivity =
-				 CalcTransmissivity(BankHeight, SoilMap[y][x].TableDepth,
-				 SType[SoilMap[y][x].Soil - 1].KsLat,
-				 SType[SoilMap[y][x].Soil - 1].KsLatExp,
-                 SType[SoilMap[y][x].Soil - 1].DepthThresh);
-			
-			water_out_road = (Transmissivity * fract_used *
-			      SubFlowGrad[y][x] * Dt) / (Map->DX * Map->DY);
+		    /* compute road interception if water table is above road cut */
+		    if (SoilMap[y][x].TableDepth < BankHeight &&
+			    (Work->HasChannel[i] & HAS_ROAD)) {
+		      fract_used = Work->RoadFract[i];
+			  Transmissivity =
+				   SoilTransmissivity(BankHeight, SoilMap[y][x].TableDepth,
+				   Class->SType);
 			
-			AvailableWater =
-				CalcAvailableWater(VType[VegMap[y][x].Veg - 1].NSoilLayers,
-				 BankHeight, VType[VegMap[y][x].Veg - 1].RootDepth,
-				 SType[SoilMap[y][x].Soil - 1].Porosity,
-				 SType[SoilMap[y][x].Soil - 1].FCap,
-				 SoilMap[y][x].TableDepth, Adjust);
+			  water_out_road = (Transmissivity * fract_used *
+				SubFlowGrad * Dt) / (Map->DX * Map->DY);
 			
-			water_out_road = 
-				(water_out_road > AvailableWater) ? AvailableWater : water_out_road;
+			  water_out_road = 
+				  (water_out_road > BankWater) ? BankWater : water_out_road;
 			
-			/* increase lateral inflow to road channel */
-			SoilMap[y][x].RoadInt = water_out_road;
-			channel_grid_inc_inflow(ChannelData->road_map, x, y,
-				    water_out_road * Map->DX * Map->DY);
-		  }
-		  /* Subsurface Component - Decrease water change by outwater */
-		  SoilMap[y][x].SatFlow -= OutFlow + water_out_road;
-		  
-		  /* Assign the water to appropriate surrounding pixels */
-		  if (SubTotalDir[y][x] > 0)
-	        OutFlow /= (float) SubTotalDir[y][x];
-		  else
-	        OutFlow = 0.;
+			  /* increase lateral inflow to road channel */
+			  SoilMap[y][x].RoadInt += water_out_road;
+			  Work->ChannelFlow[i] = water_out_road;
+			  Work->ToChannel[i] = ROAD_INFLOW;
+		    }
+		    /* Subsurface Component - Decrease water change by outwater */
+		    Work->OwnFlow[i] = OutFlow + water_out_road;
 		  
-		  for (k = 0; k < NDIRS; k++) {
-	        int nx = xdirection[k] + x;
-	        int ny = ydirection[k] + y;
-	        if (valid_cell(Map, nx, ny)) {
-	          SoilMap[ny][nx].SatFlow += OutFlow * SubDir[y][x][k];
-			}
+		    /* the water is assigned to the surrounding pixels below */
+		    Work->OutFlow[i] = OutFlow;
 		  }
-		}
-	    else {			/* cell has a stream channel */
-	      if (SoilMap[y][x].TableDepth < BankHeight &&
-	        channel_grid_has_channel(ChannelData->stream_map, x, y)) {
-			float gradient = 4.0 * (BankHeight - SoilMap[y][x].TableDepth);
-			if (gradient < 0.0)
-	          gradient = 0.0;
-			Transmissivity =
-				CalcTransmissivity(BankHeight, SoilMap[y][x].TableDepth,
-				 SType[SoilMap[y][x].Soil - 1].KsLat,
-				 SType[SoilMap[y][x].Soil - 1].KsLatExp,
-                 SType[SoilMap[y][x].Soil - 1].DepthThresh);
-
-			OutFlow = (Transmissivity * gradient * Dt) / (Map->DX * Map->DY);
-			
-			/* check whether enough water is available for redistribution */
-			AvailableWater = 
-				 CalcAvailableWater(VType[VegMap[y][x].Veg - 1].NSoilLayers,
-				 BankHeight, VType[VegMap[y][x].Veg - 1].RootDepth,
-				 SType[SoilMap[y][x].Soil - 1].Porosity,
-				 SType[SoilMap[y][x].Soil - 1].FCap,
-				 SoilMap[y][x].TableDepth, Adjust);
+	      else {			/* cell has a stream channel */
+		if (SoilMap[y][x].TableDepth < BankHeight) {
+			  float gradient = 4.0 * (BankHeight - SoilMap[y][x].TableDepth);
+			  if (gradient < 0.0)
+		    gradient = 0.0;
+			  Transmissivity =
+				  SoilTransmissivity(BankHeight, SoilMap[y][x].TableDepth,
+				   Class->SType);
+
+			  OutFlow = (Transmissivity * gradient * Dt) / (Map->DX * Map->DY);
 			
-			OutFlow = (OutFlow > AvailableWater) ? AvailableWater : OutFlow;
+			  /* check whether enough water is available for redistribution */
+			  OutFlow = (OutFlow > BankWater) ? BankWater : OutFlow;
 			
-			/* remove water going to channel from the grid cell */
-			SoilMap[y][x].SatFlow -= OutFlow;
+			  /* remove water going to channel from the grid cell */
+			  Work->OwnFlow[i] = OutFlow;
 			
-			/* contribute to channel segment lateral inflow */
-			channel_grid_inc_inflow(ChannelData->stream_map, x, y,
-				    OutFlow * Map->DX * Map->DY);
+			  /* contribute to channel segment lateral inflow */
+			  Work->ChannelFlow[i] = OutFlow;
+			  Work->ToChannel[i] = STREAM_INFLOW;
 			
-			SoilMap[y][x].ChannelInt += OutFlow;
+			  SoilMap[y][x].ChannelInt += OutFlow;
+		    }
 		  }
-		}
-      }
     }
   }
 
- for(i=0; i<Map->NY; i++) { 
-    free(SubTotalDir[i]);
-    free(SubFlowGrad[i]);
-    for(j=0; j<Map->NX; j++){
-      free(SubDir[i][j]);
+  Work->ConstValid = TRUE;
+
+  /* gather the inflow from the donors of each cell, subtracting the 
+     cell's own outflow after the donors that come before it */
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(y, x, k, e, d, SatFlow, Subtracted)
+#endif
+  for (i = 0; i < Map->NumActive; i++) {
+    SatFlow = 0.0f;
+    Subtracted = FALSE;
+    for (k = Graph->RevStart[i]; k < Graph->RevStart[i + 1]; k++) {
+      d = Graph->RevDonor[k];
+      e = Graph->RevEdge[k];
+      if (!Subtracted && d > i) {
+	SatFlow -= Work->OwnFlow[i];
+	Subtracted = TRUE;
+      }
+      SatFlow += Work->OutFlow[d] * Graph->Fract[e];
     }
-    free(SubDir[i]);
+    if (!Subtracted)
+      SatFlow -= Work->OwnFlow[i];
+    y = Map->ActiveCells[i].y;
+    x = Map->ActiveCells[i].x;
+    SoilMap[y][x].SatFlow = SatFlow;
   }
-  free(SubDir);
-  free(SubTotalDir);
-  free(SubFlowGrad);
-
-  /**********************************************************************/
-  /* Dump saturation extent file to screen.
-     Saturation extent is based on the number of pixels with a water table 
-     that is at least MTHRESH of soil depth. */ 
-  
-  count =0;
-  totalcount = 0;
-  for (y = 0; y < Map->NY; y++) {
-    for (x = 0; x < Map->NX; x++) {
-      if (INBASIN(TopoMap[y][x].Mask)) {
-	     mgrid = (SoilMap[y][x].Depth - SoilMap[y][x].TableDepth)/SoilMap[y][x].Depth;
-	     if (mgrid > MTHRESH) 
-		   count += 1;
-		 totalcount += 1;
-      }
+
+  /* pass the interception to the channel segments in cell order, with
+     threads through the slots of the accumulators */
+  if (ChannelData->stream_accum != NULL) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(y, x)
+#endif
+    for (i = 0; i < Map->NumActive; i++) {
+      y = Map->ActiveCells[i].y;
+      x = Map->ActiveCells[i].x;
+      if (Work->ToChannel[i] == ROAD_INFLOW)
+	channel_grid_accum_inc_inflow(ChannelData->road_accum,
+				      ChannelData->road_map, x, y,
+				      Work->ChannelFlow[i] * Map->DX * Map->DY);
+      else if (Work->ToChannel[i] == STREAM_INFLOW)
+	channel_grid_accum_inc_inflow(ChannelData->stream_accum,
+				      ChannelData->stream_map, x, y,
+				      Work->ChannelFlow[i] * Map->DX * Map->DY);
     }
+    if (ChannelData->road_accum != NULL)
+      channel_grid_accum_merge(ChannelData->road_accum);
+    channel_grid_accum_merge(ChannelData->stream_accum);
+    return;
   }
- 
-  sat = 100.*((float)count/(float)totalcount);
-  
-  sprintf(satoutfile, "%ssaturation_extent.txt", DumpPath);
-  
-  if((fs = fopen(satoutfile,"a")) == NULL){
-    printf("Cannot open saturation extent output file.\n");
-    exit(0);
+  for (i = 0; i < Map->NumActive; i++) {
+    y = Map->ActiveCells[i].y;
+    x = Map->ActiveCells[i].x;
+    if (Work->ToChannel[i] == ROAD_INFLOW)
+      channel_grid_inc_inflow(ChannelData->road_map, x, y,
+			      Work->ChannelFlow[i] * Map->DX * Map->DY);
+    else if (Work->ToChannel[i] == STREAM_INFLOW)
+      channel_grid_inc_inflow(ChannelData->stream_map, x, y,
+			      Work->ChannelFlow[i] * Map->DX * Map->DY);
   }
-  
-  SPrintDate(&(Time->Current), buffer);
-  fprintf(fs, "%-20s %.4f \n", buffer, sat); 
-  fclose(fs);    
+
 }
 
+/*****************************************************************************
+  DistributeSubStep()
+
+  Adds the saturated flow of a sub-step of RouteSubSurface() to the soil 
+  columns and finds their new water table, the water above the surface 
+  goes to IExcess as in MassEnergyBalance()
+*****************************************************************************/
+static void DistributeSubStep(int Dt, MAPSIZE *Map, TOPOPIX **TopoMap,
+			      CELLCLASSES *Classes, ROADSTRUCT **Network,
+			      SOILPIX **SoilMap, OPTIONSTRUCT *Options)
+{
+  CELLCLASS *Class;		/* Vegetation and soil class of the cell */
+  SOILPIX *LocalSoil;
+  ROADSTRUCT *LocalNetwork;
+  int i;			/* active cell counter */
+  int x;			/* counter */
+  int y;			/* counter */
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(y, x, Class, LocalSoil, LocalNetwork)
+#endif
+  for (i = 0; i < Map->NumActive; i++) {
+    y = Map->ActiveCells[i].y;
+    x = Map->ActiveCells[i].x;
+    Class = &(Classes->Class[Classes->Of[i]]);
+    LocalSoil = &(SoilMap[y][x]);
+    LocalNetwork = &(Network[y][x]);
+    DistributeSatflow(Dt, Map->DX, Map->DY, LocalSoil->SatFlow,
+		      Class->SType->NLayers, LocalSoil->Depth,
+		      LocalNetwork->Area, Class->VType->RootDepth,
+		      Class->SType->Ks, Class->SType->PoreDist,
+		      Class->SType->Porosity, Class->SType->FCap,
+		      LocalSoil->Perc, LocalNetwork->PercArea,
+		      LocalNetwork->Adjust, LocalNetwork->CutBankZone,
+		      LocalNetwork->BankHeight, &(LocalSoil->TableDepth),
+		      &(LocalSoil->IExcess), LocalSoil->Moist,
+		      Options->Infiltration);
+    LocalSoil->SatFlow = 0.0;
+    LocalSoil->TableDepth =
+      WaterTableDepth(Class->SType->NLayers, LocalSoil->Depth,
+		      Class->VType->RootDepth, Class->SType->Porosity,
+		      Class->SType->FCap, LocalNetwork->Adjust,
+		      LocalSoil->Moist, &(LocalNetwork->Capacity));
+    if (LocalSoil->TableDepth < 0.0) {
+      LocalSoil->IExcess += -(LocalSoil->TableDepth);
+      LocalSoil->TableDepth = 0.0;
+    }
+    if (Options->FlowGradient == WATERTABLE)
+      LocalSoil->WaterLevel = TopoMap[y][x].Dem - LocalSoil->TableDepth;
+  }
+}
+
+/*****************************************************************************
+  SubSurfaceConstants()
+
+  Sets the parts of the subsurface routing of active cell i at (x, y) that
+  do not change from one time step to the next for the given flow 
+  directions
+*****************************************************************************/
+static void SubSurfaceConstants(int i, int x, int y, unsigned char *SubDir,
+				unsigned int SubTotalDir,
+				ROADSTRUCT **Network, SOILPIX **SoilMap,
+				CHANNEL *ChannelData, SUBSURFACEWORK *Work)
+{
+  float fract_used;
+  int k;
+
+  Work->BankHeight[i] = (Network[y][x].BankHeight > SoilMap[y][x].Depth) ?
+    SoilMap[y][x].Depth : Network[y][x].BankHeight;
+
+  fract_used = 0.0f;
+  for (k = 0; k < NDIRS; k++)
+    fract_used += (float) SubDir[k];
+  if (SubTotalDir > 0)
+    fract_used /= (float) SubTotalDir;
+  else
+    fract_used = 0.;
+  Work->FractUsed[i] = fract_used;
+
+  if (SubTotalDir > 0)
+    Work->RoadFract[i] = ((float) Network[y][x].fraction / (float) SubTotalDir);
+  else
+    Work->RoadFract[i] = 0.;
+
+  Work->HasChannel[i] = 0;
+  if (channel_grid_has_channel(ChannelData->stream_map, x, y))
+    Work->HasChannel[i] |= HAS_STREAM;
+  if (channel_grid_has_channel(ChannelData->road_map, x, y))
+    Work->HasChannel[i] |= HAS_ROAD;
+}
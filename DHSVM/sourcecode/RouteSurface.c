@@ -8,7 +8,9 @@
 * ORIG-DATE:    Apr-96
 * DESCRIPTION:  Route surface flow
 * DESCRIP-END.
-* FUNCTIONS:    RouteSurface()
+* FUNCTIONS:    InitSurfaceRoute()
+*               RouteSurface()
+*               FreeSurfaceRoute()
 * Modification: Changes are made to exclude the impervious channel cell (with
 a non-zero impervious fraction) from surface routing. In the original
 code, some impervious channel cells are routed to themselves causing
@@ -26,6 +28,92 @@ overestimated runoff in those cells (Ning, 2013).
 #include "DHSVMerror.h"
 #include "functions.h"
 #include "constants.h"
+#include "memaccount.h"
+
+/*****************************************************************************
+InitSurfaceRoute()
+Splits the active cells for RouteSurface() into the cells with a stream
+channel, the urban cells (an impervious fraction and no stream channel) and
+the other, pervious, cells, each list in Map->ActiveCells order.  The
+vegetation fractions and the drain of the urban cells are resolved here, so
+that the time step does not go back to VType and TopoMap.  The lists are
+made after the vegetation of the stations has been set with SNOTEL, and
+again after a map event has changed the vegetation (StepMapEvents()).
+*****************************************************************************/
+void InitSurfaceRoute(MAPSIZE * Map, TOPOPIX ** TopoMap, VEGPIX ** VegMap,
+  VEGTABLE * VType, CHANNEL *ChannelData, SURFACEROUTE *Route)
+{
+  const char *Routine = "InitSurfaceRoute";
+  VEGTABLE *Type;
+  int n, x, y, k;               /* Counters */
+
+  Route->NPervious = 0;
+  Route->NChannel = 0;
+  Route->NUrban = 0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    if (channel_grid_has_channel(ChannelData->stream_map, x, y))
+      Route->NChannel++;
+    else if (VType[VegMap[y][x].Veg - 1].ImpervFrac > 0.0)
+      Route->NUrban++;
+    else
+      Route->NPervious++;
+  }
+
+  /* one extra entry, so that empty lists are still allocated */
+  if (!(Route->Pervious = (int *) TaggedCalloc(Route->NPervious + 1,
+					       sizeof(int), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->Channel = (int *) TaggedCalloc(Route->NChannel + 1,
+					      sizeof(int), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->Urban = (int *) TaggedCalloc(Route->NUrban + 1, sizeof(int),
+					    MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->DrainX = (int *) TaggedCalloc(Route->NUrban + 1, sizeof(int),
+					     MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->DrainY = (int *) TaggedCalloc(Route->NUrban + 1, sizeof(int),
+					     MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->Direct = (float *) TaggedCalloc(Route->NUrban + 1,
+					       sizeof(float), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->Detained = (float *) TaggedCalloc(Route->NUrban + 1,
+						 sizeof(float), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->Decay = (float *) TaggedCalloc(Route->NUrban + 1,
+					      sizeof(float), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Route->PerviousFrac = (float *) TaggedCalloc(Route->NUrban + 1,
+						     sizeof(float), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+
+  Route->NPervious = 0;
+  Route->NChannel = 0;
+  Route->NUrban = 0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Type = &(VType[VegMap[y][x].Veg - 1]);
+    if (channel_grid_has_channel(ChannelData->stream_map, x, y))
+      Route->Channel[Route->NChannel++] = k;
+    else if (Type->ImpervFrac > 0.0) {
+      n = Route->NUrban++;
+      Route->Urban[n] = k;
+      Route->DrainX[n] = TopoMap[y][x].drains_x;
+      Route->DrainY[n] = TopoMap[y][x].drains_y;
+      Route->Direct[n] = (1 - Type->DetentionFrac) * Type->ImpervFrac;
+      Route->Detained[n] = Type->DetentionFrac * Type->ImpervFrac;
+      Route->Decay[n] = Type->DetentionDecay;
+      Route->PerviousFrac[n] = 1 - Type->ImpervFrac;
+    }
+    else
+      Route->Pervious[Route->NPervious++] = k;
+  }
+}
+
 /*****************************************************************************
 RouteSurface()
 If the watertable calculated in WaterTableDepth() was negative, then water is
@@ -37,120 +125,140 @@ The net effect is that all pixels that have an impervious area are directly
 connected (over the coarse of a single time step) to the channel network, this
 assumption is likely to be true for small urban basins, and perhaps even for
 large rural basins with some urban development
+The cells are visited from the lists made by InitSurfaceRoute(), first the
+pervious cells, then the urban cells and then the channel cells.
 If Overland Routing = KINEMATIC, then "excess" water is routed to the outlet
 using a infinite difference approximation to the kinematic wave solution of
 the Saint-Venant equations.
+Without a channel network the runoff is routed with the unit hydrograph.  The
+runoff is first summed over the cells with the same travel time, so that each
+unit hydrograph is applied once per travel time rather than once per cell.
+The hydrograph is a ring buffer that starts at HydrographInfo->Head, so that
+advancing it by a time step does not move the contents.
 *****************************************************************************/
 void RouteSurface(MAPSIZE * Map, TIMESTRUCT * Time, TOPOPIX ** TopoMap,
   SOILPIX ** SoilMap, OPTIONSTRUCT *Options,
   UNITHYDR ** UnitHydrograph, UNITHYDRINFO * HydrographInfo, float *Hydrograph,
-  DUMPSTRUCT *Dump, VEGPIX ** VegMap, VEGTABLE * VType, CHANNEL *ChannelData)
+  DUMPSTRUCT *Dump, FLOWGRAPH *Graph, SURFACEROUTE *Route)
 {
   const char *Routine = "RouteSurface";
   int Lag;			/* Lag time for hydrograph */
+  int NSteps;			/* Number of hydrograph steps in a time step */
   int Step;
   float StreamFlow;
   int TravelTime;
   int WaveLength;
-  int i, j, x, y, n, k;         /* Counters */
+  float Runoff;
+  int i, j, x, y, e, k, n;      /* Counters */
 
 
   /* Allocate memory for Runon Matrix */
   if (Options->HasNetwork) {
     /* Option->Routing = false when routing = conventional */
-    for (y = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++) {
-        if (INBASIN(TopoMap[y][x].Mask)) {
-          SoilMap[y][x].Runoff = SoilMap[y][x].IExcess;
-          SoilMap[y][x].IExcess = 0;
-          SoilMap[y][x].DetentionIn = 0;
-        }
-      }
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      SoilMap[y][x].Runoff = SoilMap[y][x].IExcess;
+      SoilMap[y][x].IExcess = 0;
+      SoilMap[y][x].DetentionIn = 0;
     }
-    for (y = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++) {
-        if (INBASIN(TopoMap[y][x].Mask)) {
-          if (!channel_grid_has_channel(ChannelData->stream_map, x, y)) {
-            if (VType[VegMap[y][x].Veg - 1].ImpervFrac > 0.0) {
-              /* Calculate the outflow from impervious portion of urban cell straight to nearest channel cell */
-              SoilMap[TopoMap[y][x].drains_y][TopoMap[y][x].drains_x].IExcess +=
-                (1 - VType[VegMap[y][x].Veg - 1].DetentionFrac) *
-                VType[VegMap[y][x].Veg - 1].ImpervFrac * SoilMap[y][x].Runoff;
-              /* Retained water in detention storage */
-              SoilMap[y][x].DetentionIn = VType[VegMap[y][x].Veg - 1].DetentionFrac *
-                VType[VegMap[y][x].Veg - 1].ImpervFrac * SoilMap[y][x].Runoff;
-              /* Retained water in Detention storage routed to channel */
-              SoilMap[y][x].DetentionStorage += SoilMap[y][x].DetentionIn;
-              SoilMap[y][x].DetentionOut = SoilMap[y][x].DetentionStorage * VType[VegMap[y][x].Veg - 1].DetentionDecay;
-              SoilMap[TopoMap[y][x].drains_y][TopoMap[y][x].drains_x].IExcess += SoilMap[y][x].DetentionOut;
-              SoilMap[y][x].DetentionStorage -= SoilMap[y][x].DetentionOut;
-              if (SoilMap[y][x].DetentionStorage < 0.0)
-                SoilMap[y][x].DetentionStorage = 0.0;
-              /* Route the runoff from pervious portion of urban cell to the neighboring cell */
-              for (n = 0; n < NDIRS; n++) {
-                int xn = x + xdirection[n];
-                int yn = y + ydirection[n];
-                if (valid_cell(Map, xn, yn)) {
-                  SoilMap[yn][xn].IExcess += (1 - VType[VegMap[y][x].Veg - 1].ImpervFrac) * SoilMap[y][x].Runoff
-                    *((float)TopoMap[y][x].Dir[n] / (float)TopoMap[y][x].TotalDir);
-                }
-              }
-            }
-            else {
-              for (n = 0; n < NDIRS; n++) {
-                int xn = x + xdirection[n];
-                int yn = y + ydirection[n];
-                if (valid_cell(Map, xn, yn)) {
-                  SoilMap[yn][xn].IExcess += SoilMap[y][x].Runoff *((float)TopoMap[y][x].Dir[n] / (float)TopoMap[y][x].TotalDir);
-                }
-              }
-            }
-          }
-          else if (channel_grid_has_channel(ChannelData->stream_map, x, y)) {
-            SoilMap[y][x].IExcess += SoilMap[y][x].Runoff;
-          }
-        }
-      }
+    /* pervious cells route all the runoff to their neighbours */
+    for (n = 0; n < Route->NPervious; n++) {
+      k = Route->Pervious[n];
+      Runoff = SoilMap[Map->ActiveCells[k].y][Map->ActiveCells[k].x].Runoff;
+      for (e = Graph->Start[k]; e < Graph->Start[k + 1]; e++)
+        SoilMap[Graph->RecvY[e]][Graph->RecvX[e]].IExcess += Runoff * Graph->Fract[e];
+    }
+    /* urban cells */
+    for (n = 0; n < Route->NUrban; n++) {
+      k = Route->Urban[n];
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      Runoff = SoilMap[y][x].Runoff;
+      /* Calculate the outflow from impervious portion of urban cell straight to nearest channel cell */
+      SoilMap[Route->DrainY[n]][Route->DrainX[n]].IExcess += Route->Direct[n] * Runoff;
+      /* Retained water in detention storage */
+      SoilMap[y][x].DetentionIn = Route->Detained[n] * Runoff;
+      /* Retained water in Detention storage routed to channel */
+      SoilMap[y][x].DetentionStorage += SoilMap[y][x].DetentionIn;
+      SoilMap[y][x].DetentionOut = SoilMap[y][x].DetentionStorage * Route->Decay[n];
+      SoilMap[Route->DrainY[n]][Route->DrainX[n]].IExcess += SoilMap[y][x].DetentionOut;
+      SoilMap[y][x].DetentionStorage -= SoilMap[y][x].DetentionOut;
+      if (SoilMap[y][x].DetentionStorage < 0.0)
+        SoilMap[y][x].DetentionStorage = 0.0;
+      /* Route the runoff from pervious portion of urban cell to the neighboring cell */
+      for (e = Graph->Start[k]; e < Graph->Start[k + 1]; e++)
+        SoilMap[Graph->RecvY[e]][Graph->RecvX[e]].IExcess += Route->PerviousFrac[n] * Runoff
+          * Graph->Fract[e];
+    }
+    /* the runoff of the channel cells stays in the cell */
+    for (n = 0; n < Route->NChannel; n++) {
+      k = Route->Channel[n];
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      SoilMap[y][x].IExcess += SoilMap[y][x].Runoff;
     }
   }/* end if Options->routing = conventional */
 
 /* MAKE SURE THIS WORKS WITH A TIMESTEP IN SECONDS */
   else {			/* No network, so use unit hydrograph method */
-    for (y = 0; y < Map->NY; y++) {
-      for (x = 0; x < Map->NX; x++) {
-        if (INBASIN(TopoMap[y][x].Mask)) {
-          TravelTime = (int)TopoMap[y][x].Travel;
-          if (TravelTime != 0) {
-            WaveLength = HydrographInfo->WaveLength[TravelTime - 1];
-            for (Step = 0; Step < WaveLength; Step++) {
-              Lag = UnitHydrograph[TravelTime - 1][Step].TimeStep;
-              Hydrograph[Lag] += SoilMap[y][x].Runoff * UnitHydrograph[TravelTime - 1][Step].Fraction;
+    for (i = 0; i < HydrographInfo->MaxTravelTime; i++)
+      HydrographInfo->TravelRunoff[i] = 0.0;
 
-            }
-            SoilMap[y][x].Runoff = 0.0;
-          }
-        }
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      TravelTime = (int)TopoMap[y][x].Travel;
+      if (TravelTime != 0) {
+        HydrographInfo->TravelRunoff[TravelTime - 1] += SoilMap[y][x].Runoff;
+        SoilMap[y][x].Runoff = 0.0;
       }
     }
 
-    StreamFlow = 0.0;
-    for (i = 0; i < Time->Dt; i++)
-      StreamFlow += (Hydrograph[i] * Map->DX * Map->DY) / Time->Dt;
-
-    /* Advance Hydrograph */
-    for (i = 0; i < Time->Dt; i++) {
-      for (j = 0; j < HydrographInfo->TotalWaveLength - 1; j++) {
-        Hydrograph[j] = Hydrograph[j + 1];
+    for (i = 0; i < HydrographInfo->MaxTravelTime; i++) {
+      if (HydrographInfo->TravelRunoff[i] == 0.0)
+        continue;
+      WaveLength = HydrographInfo->WaveLength[i];
+      for (Step = 0; Step < WaveLength; Step++) {
+        Lag = (HydrographInfo->Head + UnitHydrograph[i][Step].TimeStep) %
+          HydrographInfo->TotalWaveLength;
+        Hydrograph[Lag] += HydrographInfo->TravelRunoff[i] * UnitHydrograph[i][Step].Fraction;
       }
-
     }
 
-    /* Set the last elements of the hydrograph to zero */
-    for (i = 0; i < Time->Dt; i++)
-      Hydrograph[HydrographInfo->TotalWaveLength - (i + 1)] = 0.0;
+    /* Collect the stream flow for this time step and advance the
+       hydrograph.  The steps that are consumed are set to zero, they are
+       reused at the end of the hydrograph */
+    NSteps = MIN(Time->Dt, HydrographInfo->TotalWaveLength);
+    StreamFlow = 0.0;
+    for (i = 0; i < NSteps; i++) {
+      j = (HydrographInfo->Head + i) % HydrographInfo->TotalWaveLength;
+      StreamFlow += (Hydrograph[j] * Map->DX * Map->DY) / Time->Dt;
+      Hydrograph[j] = 0.0;
+    }
+    HydrographInfo->Head = (HydrographInfo->Head + NSteps) %
+      HydrographInfo->TotalWaveLength;
 
-    PrintDate(&(Time->Current), Dump->Stream.FilePtr);
-    fprintf(Dump->Stream.FilePtr, " %g\n", StreamFlow);
+    if (Options->SpinUpCycles == 0 && !Options->NoOutput) {
+      PrintDate(&(Time->Current), Dump->Stream.FilePtr);
+      fprintf(Dump->Stream.FilePtr, " %g\n", StreamFlow);
+    }
   }
 }
 
+
+/*****************************************************************************
+FreeSurfaceRoute()
+*****************************************************************************/
+void FreeSurfaceRoute(SURFACEROUTE *Route)
+{
+  TaggedFree(Route->Pervious);
+  TaggedFree(Route->Channel);
+  TaggedFree(Route->Urban);
+  TaggedFree(Route->DrainX);
+  TaggedFree(Route->DrainY);
+  TaggedFree(Route->Direct);
+  TaggedFree(Route->Detained);
+  TaggedFree(Route->Decay);
+  TaggedFree(Route->PerviousFrac);
+}
@@ -10,18 +10,40 @@
  *               temperature 
  * DESCRIP-END.
  * FUNCTIONS:    SatVaporPressure()
- * COMMENTS:
+ *               SatVaporPressureDeriv()
+ * COMMENTS:     The accuracy of SatVaporPressure() is selected at compile time
+ *               with -DSVP_ACCURACY=n, see below.  Compile with
+ *               -DTEST_SATVAPORPRESSURE to get a small program that reports
+ *               the accuracy and speed against CalcVaporPressure()
  * $Id: SatVaporPressure.c,v 1.4 2003/07/01 21:26:23 olivier Exp $     
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include "lookuptable.h"
+#include "DHSVMerror.h"
+#include "fastmath.h"
+
+/* Accuracy levels for SatVaporPressure():
+   SVP_TABLE  - value of the 0.02 C table interval that contains T, same
+                results as FloatLookup() (default)
+   SVP_LINEAR - linear interpolation between the table entries, indexed by 
+                multiplication with the reciprocal of the table interval
+   SVP_EXACT  - evaluate CalcVaporPressure() */
+#define SVP_TABLE  1
+#define SVP_LINEAR 2
+#define SVP_EXACT  3
+
+#ifndef SVP_ACCURACY
+#define SVP_ACCURACY SVP_TABLE
+#endif
 
 float CalcVaporPressure(float T);
 static FLOATTABLE svp;		/* Table that contains saturated vapor 
 				   pressures as a function of temperature 
 				   in degrees C */
+static float svpInvDelta;	/* 1/svp.Delta */
 
 /*****************************************************************************
   Function name: InitSatVaporTable()
@@ -40,6 +62,20 @@ static FLOATTABLE svp;		/* Table that contains saturated vapor
 void InitSatVaporTable(void)
 {
   InitFloatTable(30000L, -300., .02, CalcVaporPressure, &svp);
+  svpInvDelta = 1. / svp.Delta;
+
+#if SVP_ACCURACY == SVP_LINEAR
+  {
+    unsigned long i;
+
+    /* InitFloatTable() accumulates the key in single precision, which 
+       shifts the entries by up to several hundredths of a degree at the end
+       of the table.  For interpolation the entries are recalculated at the
+       exact interval boundaries */
+    for (i = 0; i < svp.Size; i++)
+      svp.Data[i] = CalcVaporPressure(svp.Offset + (double) i * svp.Delta);
+  }
+#endif
 }
 
 /*****************************************************************************
@@ -92,9 +128,126 @@ float CalcVaporPressure(float T)
 
   Modifies     : none
   
-  Comments     : Uses lookup table
+  Comments     : Uses lookup table, unless SVP_ACCURACY is SVP_EXACT.  The
+                 table is read directly rather than through FloatLookup(), 
+                 and the bounds test is a single unsigned comparison
 *****************************************************************************/
 float SatVaporPressure(float T)
 {
-  return FloatLookup(T, &svp);
-}
\ No newline at end of file
+#if SVP_ACCURACY == SVP_EXACT
+  return CalcVaporPressure(T);
+#elif SVP_ACCURACY == SVP_LINEAR
+  float u;
+  int i;
+
+  u = (T - svp.Offset) * svpInvDelta;
+  i = (int) u;
+  if ((unsigned long) i >= svp.Size - 1)
+    ReportLookupError("SatVaporPressure", T);
+  u -= i;
+
+  return svp.Data[i] + u * (svp.Data[i + 1] - svp.Data[i]);
+#else
+  int i;
+
+  i = (int) ((T - svp.Offset) / svp.Delta);
+  if ((unsigned long) i >= svp.Size)
+    ReportLookupError("SatVaporPressure", T);
+
+  return svp.Data[i];
+#endif
+}
+
+/*****************************************************************************
+  Function name: SatVaporPressureDeriv()
+
+  Purpose      : Calculates the derivative of the saturated vapor pressure 
+                 with respect to temperature
+
+  Required     : 
+    float T    - Temperature (C)
+
+  Returns      :
+    float      - Derivative of the saturated vapor pressure (Pa/C) 
+
+  Modifies     : none
+  
+  Comments     : Derivative of the equations in CalcVaporPressure().  Used 
+                 by the Newton-Raphson surface temperature solver
+*****************************************************************************/
+float SatVaporPressureDeriv(float T)
+{
+  float Pressure;
+  float dPressure;
+
+  Pressure = 610.78 * MathExp((double) ((17.269 * T) / (237.3 + T)));
+  dPressure = Pressure * 17.269 * 237.3 / ((237.3 + T) * (237.3 + T));
+
+  if (T < 0.0)
+    dPressure = dPressure * (1.0 + .00972 * T + .000042 * T * T) +
+      Pressure * (.00972 + .000084 * T);
+
+  return dPressure;
+}
+
+/*****************************************************************************
+  Test program.  Reports the largest absolute and relative errors of
+  SatVaporPressure() with respect to CalcVaporPressure() between -50 C and 
+  50 C, and the time per call against FloatLookup() and CalcVaporPressure().  To build:
+
+  gcc -O2 -Wall -o test_svp -DTEST_SATVAPORPRESSURE [-DSVP_ACCURACY=n] 
+  SatVaporPressure.c FastMath.c LookupTable.c ReportError.c -lm
+*****************************************************************************/
+#ifdef TEST_SATVAPORPRESSURE
+#include <time.h>
+
+int main(int argc, char **argv)
+{
+  const int NCalls = 20000000;
+  double MaxAbs = 0.;
+  double MaxRel = 0.;
+  double Err;
+  double Sum;
+  float Exact;
+  float T;
+  clock_t Start;
+  int i;
+
+  InitSatVaporTable();
+
+  printf("SVP_ACCURACY = %d\n", SVP_ACCURACY);
+  for (i = 0; i <= 100000; i++) {
+    T = -50. + i * .001;
+    Exact = CalcVaporPressure(T);
+    Err = fabs((double) SatVaporPressure(T) - Exact);
+    if (Err > MaxAbs)
+      MaxAbs = Err;
+    if (Err / Exact > MaxRel)
+      MaxRel = Err / Exact;
+  }
+  printf("max abs error: %g Pa, max rel error: %g\n", MaxAbs, MaxRel);
+
+  Sum = 0.;
+  Start = clock();
+  for (i = 0; i < NCalls; i++)
+    Sum += SatVaporPressure(-40. + (i % 8000) * .01);
+  printf("SatVaporPressure:  %.2f ns/call (%g)\n",
+	 1e9 * (clock() - Start) / CLOCKS_PER_SEC / NCalls, Sum);
+
+  Sum = 0.;
+  Start = clock();
+  for (i = 0; i < NCalls; i++)
+    Sum += FloatLookup(-40. + (i % 8000) * .01, &svp);
+  printf("FloatLookup:       %.2f ns/call (%g)\n",
+	 1e9 * (clock() - Start) / CLOCKS_PER_SEC / NCalls, Sum);
+
+  Sum = 0.;
+  Start = clock();
+  for (i = 0; i < NCalls; i++)
+    Sum += CalcVaporPressure(-40. + (i % 8000) * .01);
+  printf("CalcVaporPressure: %.2f ns/call (%g)\n",
+	 1e9 * (clock() - Start) / CLOCKS_PER_SEC / NCalls, Sum);
+
+  return EXIT_SUCCESS;
+}
+#endif
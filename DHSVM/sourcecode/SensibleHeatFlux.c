@@ -25,6 +25,7 @@
 #include "constants.h"
 #include "brent.h"
 #include "functions.h"
+#include "fastmath.h"
 
 /*****************************************************************************
   SensibleHeatFlux()
@@ -33,8 +34,11 @@ void SensibleHeatFlux(int y, int x, int Dt, float Ra, float ZRef,
 		      float Displacement, float Z0, PIXMET *LocalMet,
 		      float NetShort, float LongIn, float ETot,
 		      int NSoilLayers, float *SoilDepth, SOILTABLE *SoilType,
-		      float MeltEnergy, SOILPIX *LocalSoil)
+		      float MeltEnergy, SOILPIX *LocalSoil, int Solver)
 {
+  SURFEBPARAMS Params;		/* Arguments of the energy balance */
+  double LogZ;			/* Logarithmic term of the stability 
+				   correction */
   float FluxDepth;		/* Lower boundary for soil heat flux (m) */
   float HeatCapacity;	/* Soil heat capacity */
   float MaxTSurf;		/* Upper bracket for effective surface temperature (C) */
@@ -47,6 +51,7 @@ void SensibleHeatFlux(int y, int x, int Dt, float Ra, float ZRef,
   double Tmp;			/* Temporary value */
 
   OldTSurf = LocalSoil->TSurf;
+  LogZ = MathLog((ZRef - Displacement) / Z0);
   MaxTSurf = 0.5 * (LocalSoil->TSurf + LocalMet->Tair) + DELTAT;
   MinTSurf = 0.5 * (LocalSoil->TSurf + LocalMet->Tair) - DELTAT;
 
@@ -62,21 +67,57 @@ void SensibleHeatFlux(int y, int x, int Dt, float Ra, float ZRef,
      FluxDepth and DZ_TOP */
 
   KhEff = CalcEffectiveKh(NSoilLayers, DZ_TOP, FluxDepth, SoilDepth,
-			  SoilType->KhDry, SoilType->KhSol, LocalSoil->Moist,
+			  SoilType->KhDry, SoilType->KhSatFrozen,
+			  SoilType->KhSatThawed, LocalSoil->Moist,
 			  SoilType->Porosity, LocalSoil->Temp);
 
   /*   KhEff = 1; */
 
+  /* The heat capacity of the top layer, with the water frozen or not,
+     the same for each iteration of the solver */
+
+  HeatCapacity = SoilType->ChSolids[0];
+
+  if (TSoilUpper >= 0.0)
+    HeatCapacity += LocalSoil->Moist[0] * CH_WATER;
+  else
+    HeatCapacity += LocalSoil->Moist[0] * CH_ICE;
+
   /* Calculate the effective surface temperature that makes sure that the 
      sum of the terms of the energy balance equals 0 */
 
-  LocalSoil->TSurf =
-    RootBrent(y, x, MinTSurf, MaxTSurf, SurfaceEnergyBalance, Dt, Ra, ZRef,
-	      Displacement, Z0, LocalMet->Wind, NetShort, LongIn,
-	      LocalMet->AirDens, LocalMet->Lv, ETot, KhEff,
-	      SoilType->Ch[0], SoilType->Porosity[0], LocalSoil->Moist[0],
-	      FluxDepth, LocalMet->Tair, TSoilUpper,
-	      TSoilLower, OldTSurf, MeltEnergy);
+  if (Solver == NEWTON) {
+    /* warm start from the surface temperature of the last time step */
+    Params.Dt = Dt;
+    Params.Ra = Ra;
+    Params.Z = ZRef;
+    Params.Displacement = Displacement;
+    Params.LogZ = LogZ;
+    Params.Wind = LocalMet->Wind;
+    Params.ShortRad = NetShort;
+    Params.LongRadIn = LongIn;
+    Params.AirDens = LocalMet->AirDens;
+    Params.Lv = LocalMet->Lv;
+    Params.ETot = ETot;
+    Params.Kt = KhEff;
+    Params.HeatCapacity = HeatCapacity;
+    Params.Depth = FluxDepth;
+    Params.Tair = LocalMet->Tair;
+    Params.TSoilLower = TSoilLower;
+    Params.OldTSurf = OldTSurf;
+    Params.MeltEnergy = MeltEnergy;
+    LocalSoil->TSurf =
+      RootNewton(y, x, MinTSurf, MaxTSurf, OldTSurf, &(LocalSoil->TSurfIter),
+		 SurfaceEnergyBalanceParams, &Params);
+  }
+  else
+    LocalSoil->TSurf =
+      RootBrent(y, x, MinTSurf, MaxTSurf, &(LocalSoil->TSurfIter),
+		SurfaceEnergyBalance, Dt, Ra, ZRef,
+		Displacement, LogZ, LocalMet->Wind, NetShort, LongIn,
+		LocalMet->AirDens, LocalMet->Lv, ETot, KhEff,
+		HeatCapacity, FluxDepth, LocalMet->Tair,
+		TSoilLower, OldTSurf, MeltEnergy);
 
   /* Calculate the terms of the energy balance.  This is similar to the
      code in SurfaceEnergyBalance.c */
@@ -85,7 +126,7 @@ void SensibleHeatFlux(int y, int x, int Dt, float Ra, float ZRef,
 
   if (LocalMet->Wind > 0.0)
     Ra /= StabilityCorrection(ZRef, Displacement, TMean, LocalMet->Tair,
-			      LocalMet->Wind, Z0);
+			      LocalMet->Wind, LogZ);
   else
     Ra = DHSVM_HUGE;
 
@@ -101,13 +142,6 @@ void SensibleHeatFlux(int y, int x, int Dt, float Ra, float ZRef,
 
   LocalSoil->Qg = KhEff * (TSoilLower - TMean) / FluxDepth;
 
-  HeatCapacity = (1 - SoilType->Porosity[0]) * SoilType->Ch[0];
-
-  if (TSoilUpper >= 0.0)
-    HeatCapacity += LocalSoil->Moist[0] * CH_WATER;
-  else
-    HeatCapacity += LocalSoil->Moist[0] * CH_ICE;
-
   LocalSoil->Qst = (HeatCapacity * (OldTSurf - TMean) * DZ_TOP) / Dt;
 
   LocalSoil->Qrest = LocalSoil->Qnet + LocalSoil->Qs + LocalSoil->Qe +
@@ -139,6 +173,8 @@ void NoSensibleHeatFlux(int Dt, PIXMET *LocalMet, float ETot, SOILPIX *LocalSoil
 {
   LocalSoil->TSurf = 0.0;
 
+  LocalSoil->TSurfIter = 0;
+
   LocalSoil->Ra = 0.0;
 
   LocalSoil->Qnet = 0.0;
@@ -9,15 +9,77 @@
  * DESCRIPTION:  Separate observed downward solar radiation into diffuse and 
  *               direct beam radiation based on the clearness index (kt)
  * DESCRIP-END.
- * FUNCTIONS:    SeparateRadiation()
- * COMMENTS:
+ * FUNCTIONS:    InitSeparationTable()
+ *               DiffuseFraction()
+ *               SeparateRadiation()
+ * COMMENTS:     With RADIATION TABLE SIZE the diffuse fraction is
+ *               interpolated in a table of the clearness index instead of
+ *               evaluated, see InitSeparationTable()
  * $Id: SeparateRadiation.c,v 1.4 2003/07/01 21:26:24 olivier Exp $     
  */
 
 #include <math.h>
+#include <stdlib.h>
 #include "settings.h"
+#include "lookuptable.h"
 #include "rad.h"
 
+#define MAXTABLEINDEX 0.8	/* Clearness index above which the diffuse
+				   fraction is constant (0.13) */
+
+static FLOATTABLE DiffuseTable;	/* Diffuse fraction as a function of the
+				   clearness index, Size 0 for none */
+static float DiffuseInvDelta;	/* 1/DiffuseTable.Delta */
+
+static double DiffuseFraction(double ClearIndex);
+
+/*****************************************************************************
+  Function name: InitSeparationTable()
+
+  Purpose      : Set up the table of the diffuse fraction between clearness
+                 indices 0 and 0.8
+
+  Required     :
+    int Size - Number of entries (RADIATION TABLE SIZE), 0 for no table
+
+  Returns      : void
+
+  Modifies     : the table used by SeparateRadiation()
+
+  Comments     : With 1000 entries the interpolated fraction is within 2e-6
+                 of DiffuseFraction()
+*****************************************************************************/
+void InitSeparationTable(int Size)
+{
+  unsigned long i;
+
+  free(DiffuseTable.Data);
+  DiffuseTable.Data = NULL;
+  DiffuseTable.Size = 0;
+  if (Size < 2)
+    return;
+
+  InitInterpTable((unsigned long) Size, 0.0, MAXTABLEINDEX / (Size - 1),
+		  &DiffuseTable);
+  DiffuseInvDelta = (Size - 1) / MAXTABLEINDEX;
+  for (i = 0; i < DiffuseTable.Size; i++)
+    DiffuseTable.Data[i] =
+      DiffuseFraction((double) i * MAXTABLEINDEX / (Size - 1));
+}
+
+/*****************************************************************************
+  Function name: DiffuseFraction()
+
+  Purpose      : Fraction of the shortwave radiation that is diffuse for a
+                 clearness index up to 0.8, see SeparateRadiation()
+*****************************************************************************/
+static double DiffuseFraction(double ClearIndex)
+{
+  return 0.943 + 0.734 * ClearIndex - 4.9 * ClearIndex * ClearIndex +
+    1.796 * ClearIndex * ClearIndex * ClearIndex +
+    2.058 * ClearIndex * ClearIndex * ClearIndex * ClearIndex;
+}
+
 /*****************************************************************************
   Function name: SeparateRadiation()
 
@@ -64,15 +126,22 @@ void SeparateRadiation(float TotalSolar, float ClearIndex,
   /* The following relationships were taken from Chen and Black or one
      of the papers that Chen and Black reference, for application in the PNW */
   /* The clear index is with respect to top of atmosphere radiation */
-  if (ClearIndex > 0.8) {
+  if (DiffuseTable.Size > 0 && ClearIndex >= 0.0 &&
+      ClearIndex <= MAXTABLEINDEX) {
+    float u = ClearIndex * DiffuseInvDelta;
+    unsigned long i = (unsigned long) u;
+
+    if (i >= DiffuseTable.Size - 1)
+      i = DiffuseTable.Size - 2;
+    u -= (float) i;
+    *Diffuse = TotalSolar * (DiffuseTable.Data[i] + u *
+			     (DiffuseTable.Data[i + 1] - DiffuseTable.Data[i]));
+  }
+  else if (ClearIndex > 0.8) {
     *Diffuse = TotalSolar * 0.13;
   }
   else {
-    *Diffuse = TotalSolar * (0.943 + 0.734 * ClearIndex -
-			     4.9 * ClearIndex * ClearIndex +
-			     1.796 * ClearIndex * ClearIndex * ClearIndex +
-			     2.058 * ClearIndex * ClearIndex * ClearIndex *
-			     ClearIndex);
+    *Diffuse = TotalSolar * DiffuseFraction(ClearIndex);
   }
 
   *Beam = TotalSolar - *Diffuse;
@@ -0,0 +1,357 @@
+/*
+ * SUMMARY:      Service.c - Forecast cycles of a warm model over a socket
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Initializes the model of a configuration file once and
+ *               then serves forecast cycles to the clients of a UNIX
+ *               socket, so that a cycle does not pay for reading the
+ *               basin, the tables and the channel network, nor for a
+ *               spin-up.  A client saves the warm state under a name,
+ *               runs a cycle and reads the hydrographs of the segments it
+ *               watches, and goes back to the saved state for the next
+ *               cycle.
+ * DESCRIP-END.
+ * FUNCTIONS:    dhsvm_serve()
+ *               ServeClient()
+ *               RunCommand()
+ *               RunCycle()
+ *               FindSnapshot()
+ *               FreeSnapshots()
+ * COMMENTS:     The protocol is one command a line.  Each command is
+ *               answered with one line that starts with OK or ERROR,
+ *               after the STEP lines of RUN:
+ *
+ *                 TIME              OK current end dt (s since the start)
+ *                 SEGMENTS          OK number of stream segments
+ *                 SAVE name         keeps the model state as name
+ *                 LOAD name         goes back to the state name, OK current
+ *                 DROP name         frees the state name
+ *                 FORCING           reads the met station files again
+ *                 OUTPUT ON|OFF     output files written by RUN or not
+ *                 RUN s [i ...]     runs the steps up to s seconds since
+ *                                   the start, with a line
+ *                                   STEP current q_i ... after each step,
+ *                                   q_i the outflow (m3 per step) of the
+ *                                   segment i (0, 1, ... in the order of
+ *                                   the stream network file), then
+ *                                   OK current, or OK current END once the
+ *                                   model period is over
+ *                 QUIT              closes the connection
+ *                 SHUTDOWN          ends the service and the model
+ *
+ *               New forcing is written over the met station files of the
+ *               configuration; after LOAD of the analysis state, FORCING
+ *               reads it from the start of the files again.  The MODEL
+ *               PERIOD of the configuration bounds the cycles.  One client
+ *               is served at a time.  Errors of the model end the process
+ *               as in a stand-alone run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "settings.h"
+#include "DHSVMerror.h"
+#include "dhsvm.h"
+
+#define MAXSNAPSHOTS 16		/* named states kept at the same time */
+
+/* what ServeClient() does after a command */
+#define SERVE_NEXT     0	/* reads the next command */
+#define SERVE_CLOSE    1	/* closes the connection */
+#define SERVE_SHUTDOWN 2	/* ends the service */
+
+/* a model state saved by a client */
+typedef struct {
+  char Name[BUFSIZE + 1];
+  DHSVMSNAPSHOT *State;		/* NULL if the slot is free */
+} NAMEDSNAPSHOT;
+
+static NAMEDSNAPSHOT Snapshots[MAXSNAPSHOTS];
+
+static int ServeClient(int Connection);
+static int RunCommand(char *Line, FILE *Out);
+static void RunCycle(char *Args, FILE *Out);
+static int FindSnapshot(const char *Name);
+static void FreeSnapshots(void);
+
+/*****************************************************************************
+  dhsvm_serve()
+
+  Initializes the model of ConfigFile and serves the clients of the UNIX
+  socket SocketPath until one of them sends SHUTDOWN.  Returns 0, or -1 if
+  the model could not be initialized.
+*****************************************************************************/
+int dhsvm_serve(const char *SocketPath, const char *ConfigFile)
+{
+  struct sockaddr_un Address;
+  int Listener;
+  int Connection;
+  int Status;
+
+  if (strlen(SocketPath) >= sizeof(Address.sun_path))
+    ReportError((char *) SocketPath, 87);
+
+  if (dhsvm_initialize(ConfigFile) != 0)
+    return -1;
+
+  memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  strcpy(Address.sun_path, SocketPath);
+  unlink(SocketPath);
+  if ((Listener = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+      bind(Listener, (struct sockaddr *) &Address, sizeof(Address)) != 0 ||
+      listen(Listener, 1) != 0)
+    ReportError((char *) SocketPath, 3);
+
+  /* a client that goes away while it is answered must not end the
+     service */
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("Serving forecast cycles on %s\n", SocketPath);
+  fflush(stdout);
+
+  Status = SERVE_NEXT;
+  while (Status != SERVE_SHUTDOWN) {
+    if ((Connection = accept(Listener, NULL, NULL)) < 0)
+      continue;
+    Status = ServeClient(Connection);
+  }
+
+  close(Listener);
+  unlink(SocketPath);
+  FreeSnapshots();
+  dhsvm_finalize();
+  return 0;
+}
+
+/*****************************************************************************
+  ServeClient()
+
+  Answers the commands of a connection until it is closed, QUIT or
+  SHUTDOWN.  Returns SERVE_SHUTDOWN after SHUTDOWN and SERVE_CLOSE
+  otherwise.
+*****************************************************************************/
+static int ServeClient(int Connection)
+{
+  FILE *In;
+  FILE *Out;
+  char Line[BUFSIZE + 1];
+  int Status;
+
+  In = fdopen(Connection, "r");
+  Out = fdopen(dup(Connection), "w");
+  if (In == NULL || Out == NULL) {
+    if (In != NULL)
+      fclose(In);
+    else
+      close(Connection);
+    if (Out != NULL)
+      fclose(Out);
+    return SERVE_CLOSE;
+  }
+
+  Status = SERVE_NEXT;
+  while (Status == SERVE_NEXT && fgets(Line, BUFSIZE + 1, In) != NULL) {
+    Status = RunCommand(Line, Out);
+    fflush(Out);
+  }
+
+  /* the next client starts with the output of the configuration */
+  dhsvm_set_output(TRUE);
+
+  fclose(In);
+  fclose(Out);
+  return (Status == SERVE_SHUTDOWN) ? SERVE_SHUTDOWN : SERVE_CLOSE;
+}
+
+/*****************************************************************************
+  RunCommand()
+
+  Runs the command of Line and writes the answer to Out.  Returns what
+  ServeClient() does next.
+*****************************************************************************/
+static int RunCommand(char *Line, FILE *Out)
+{
+  char Command[BUFSIZE + 1];
+  char Name[BUFSIZE + 1];
+  char *Args;
+  int n;
+  int i;
+
+  Line[strcspn(Line, "\r\n")] = '\0';
+  Name[0] = '\0';
+  if (sscanf(Line, "%255s %n", Command, &n) != 1)
+    return SERVE_NEXT;
+  Args = Line + n;
+  sscanf(Args, "%255s", Name);
+
+  if (strcmp(Command, "TIME") == 0) {
+    fprintf(Out, "OK %.0f %.0f %.0f\n", dhsvm_get_current_time(),
+	    dhsvm_get_end_time(), dhsvm_get_time_step());
+  }
+  else if (strcmp(Command, "SEGMENTS") == 0) {
+    fprintf(Out, "OK %d\n", dhsvm_get_value_size("channel_outflow"));
+  }
+  else if (strcmp(Command, "SAVE") == 0) {
+    if (Name[0] == '\0') {
+      fprintf(Out, "ERROR SAVE needs a name\n");
+      return SERVE_NEXT;
+    }
+    if ((i = FindSnapshot(Name)) < 0)
+      for (i = 0; i < MAXSNAPSHOTS && Snapshots[i].State != NULL; i++)
+	;
+    if (i == MAXSNAPSHOTS) {
+      fprintf(Out, "ERROR no more than %d saved states\n", MAXSNAPSHOTS);
+      return SERVE_NEXT;
+    }
+    if (Snapshots[i].State != NULL)
+      dhsvm_free_snapshot(Snapshots[i].State);
+    strcpy(Snapshots[i].Name, Name);
+    Snapshots[i].State = dhsvm_snapshot();
+    fprintf(Out, "OK\n");
+  }
+  else if (strcmp(Command, "LOAD") == 0) {
+    if ((i = FindSnapshot(Name)) < 0) {
+      fprintf(Out, "ERROR no saved state %s\n", Name);
+      return SERVE_NEXT;
+    }
+    dhsvm_restore(Snapshots[i].State);
+    fprintf(Out, "OK %.0f\n", dhsvm_get_current_time());
+  }
+  else if (strcmp(Command, "DROP") == 0) {
+    if ((i = FindSnapshot(Name)) < 0) {
+      fprintf(Out, "ERROR no saved state %s\n", Name);
+      return SERVE_NEXT;
+    }
+    dhsvm_free_snapshot(Snapshots[i].State);
+    Snapshots[i].State = NULL;
+    fprintf(Out, "OK\n");
+  }
+  else if (strcmp(Command, "FORCING") == 0) {
+    if (dhsvm_reload_forcing() != 0)
+      fprintf(Out, "ERROR the forcing is not read from met station files\n");
+    else
+      fprintf(Out, "OK\n");
+  }
+  else if (strcmp(Command, "OUTPUT") == 0) {
+    if (strcmp(Name, "ON") == 0 || strcmp(Name, "OFF") == 0) {
+      dhsvm_set_output(strcmp(Name, "ON") == 0);
+      fprintf(Out, "OK\n");
+    }
+    else
+      fprintf(Out, "ERROR OUTPUT needs ON or OFF\n");
+  }
+  else if (strcmp(Command, "RUN") == 0) {
+    RunCycle(Args, Out);
+  }
+  else if (strcmp(Command, "QUIT") == 0) {
+    fprintf(Out, "OK\n");
+    return SERVE_CLOSE;
+  }
+  else if (strcmp(Command, "SHUTDOWN") == 0) {
+    fprintf(Out, "OK\n");
+    return SERVE_SHUTDOWN;
+  }
+  else
+    fprintf(Out, "ERROR unknown command %s\n", Command);
+
+  return SERVE_NEXT;
+}
+
+/*****************************************************************************
+  RunCycle()
+
+  RUN: runs the steps up to the time of Args and writes the outflow of
+  the segments of Args after each step
+*****************************************************************************/
+static void RunCycle(char *Args, FILE *Out)
+{
+  const char *Routine = "RunCycle";
+  float *Outflow;		/* outflow of all segments */
+  int *Watch;			/* segments of Args */
+  double Until;			/* s since the start */
+  char *End;
+  int NSegments;
+  int NWatch;
+  int Done;
+  int i;
+
+  Until = strtod(Args, &End);
+  if (End == Args) {
+    fprintf(Out, "ERROR RUN needs the time to run to\n");
+    return;
+  }
+
+  NSegments = dhsvm_get_value_size("channel_outflow");
+  if (!(Watch = (int *) calloc(NSegments + 1, sizeof(int))))
+    ReportError((char *) Routine, 1);
+  if (!(Outflow = (float *) calloc(NSegments + 1, sizeof(float))))
+    ReportError((char *) Routine, 1);
+
+  for (NWatch = 0, Args = End;; NWatch++) {
+    i = (int) strtol(Args, &End, 10);
+    if (End == Args)
+      break;
+    if (i < 0 || i >= NSegments || NWatch == NSegments) {
+      fprintf(Out, "ERROR no segment %d, or too many\n", i);
+      free(Watch);
+      free(Outflow);
+      return;
+    }
+    Watch[NWatch] = i;
+    Args = End;
+  }
+
+  Done = (dhsvm_get_current_time() >= dhsvm_get_end_time());
+  while (!Done && dhsvm_get_current_time() < Until) {
+    Done = dhsvm_update();
+    if (NWatch > 0) {
+      dhsvm_get_value("channel_outflow", Outflow);
+      fprintf(Out, "STEP %.0f", dhsvm_get_current_time());
+      for (i = 0; i < NWatch; i++)
+	fprintf(Out, " %g", Outflow[Watch[i]]);
+      fprintf(Out, "\n");
+    }
+  }
+  fprintf(Out, "OK %.0f%s\n", dhsvm_get_current_time(), Done ? " END" : "");
+
+  free(Watch);
+  free(Outflow);
+}
+
+/*****************************************************************************
+  FindSnapshot()
+
+  Slot of the saved state Name, or -1 if there is none
+*****************************************************************************/
+static int FindSnapshot(const char *Name)
+{
+  int i;
+
+  for (i = 0; i < MAXSNAPSHOTS; i++)
+    if (Snapshots[i].State != NULL && strcmp(Snapshots[i].Name, Name) == 0)
+      return i;
+  return -1;
+}
+
+/*****************************************************************************
+  FreeSnapshots()
+*****************************************************************************/
+static void FreeSnapshots(void)
+{
+  int i;
+
+  for (i = 0; i < MAXSNAPSHOTS; i++) {
+    if (Snapshots[i].State != NULL)
+      dhsvm_free_snapshot(Snapshots[i].State);
+    Snapshots[i].State = NULL;
+  }
+}
@@ -12,12 +12,17 @@
  * DESCRIP-END.
  * FUNCTIONS:    valid_cell()
  *               valid_cell_fine()
+ *               InitNeighborOffsets()
  *               slope_aspect()
  *               flow_fractions()
  *               ElevationSlopeAspect()
+ *               RankedCells()
  *               HeadSlopeAspect()
  *               ElevationSlope()
  *               ElevationSlopeAspectfine()
+ *               InitFlowGraph()
+ *               MakeFlowGraph()
+ *               FreeFlowGraph()
  * COMMENTS:
                  This program is considerably changed to fix the problems including:
 				 1) runoff from some basins cell is rounted to the neighnoring cells 
@@ -33,10 +38,14 @@
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 #include "constants.h"
 #include "settings.h"
 #include "data.h"
 #include "functions.h"
+#include "memaccount.h"
 #include "slopeaspect.h"
 #include "DHSVMerror.h"
 
@@ -72,6 +81,24 @@ int valid_cell(MAPSIZE *Map, int x, int y)
   return (x >= 0 && y >= 0 && x < Map->NX && y < Map->NY);
 }
 
+/* -------------------------------------------------------------
+   InitNeighborOffsets
+   Fills the offsets of the neighbours (xneighbor/yneighbor and 
+   xdirection/ydirection) of a cell in a map allocated with 
+   AllocHaloMap(), so that &Map[y][x] + Offset[n] is the neighbour 
+   in direction n.  Cells on the edge of the map have neighbours in
+   the halo, so no valid_cell() check is needed.
+   ------------------------------------------------------------- */
+void InitNeighborOffsets(MAPSIZE *Map)
+{
+  int n;
+
+  for (n = 0; n < NNEIGHBORS; n++)
+    Map->NeighborOffset[n] = yneighbor[n] * (Map->NX + 2) + xneighbor[n];
+  for (n = 0; n < NDIRS; n++)
+    Map->DirOffset[n] = ydirection[n] * (Map->NX + 2) + xdirection[n];
+}
+
 /* -------------------------------------------------------------
    slope_aspect
    Calculation of slope and aspect given elevations of cell and neighbors
@@ -81,15 +108,11 @@ static void slope_aspect(float dx, float dy, float celev, float
 {
   int n;
   float dzdx, dzdy;
-  float *dummyelev;
+  float dummyelev[NNEIGHBORS];
   /* this dummy varaible is added for calculation of elev difference,
   in which the elev of OUTSIDEBASIN cells (which is ZERO) is 
   replaced by the elev of the central cell */
 
-  /* allocate memory */
-  if (!(dummyelev = (float*) calloc(NNEIGHBORS, sizeof(float))))
-	  ReportError("slope_aspect( )", 1);
-  
   for (n = 0; n < NNEIGHBORS; n++) {
       if (nelev[n] == OUTSIDEBASIN) {
 		  dummyelev[n] = celev;
@@ -110,7 +133,6 @@ static void slope_aspect(float dx, float dy, float celev, float
 	  /* convert from radian to degree */
 	  *aspect = atan2(dzdx, dzdy) ;
   }
-  free(dummyelev);
   return;
 }
 /* -------------------------------------------------------------
@@ -127,14 +149,9 @@ static void flow_fractions(float dx, float dy, float slope, float aspect,
   float cosine = cos(aspect);
   float sine = sin(aspect);
   float total_width, effective_width;
-  float *cos, *sin;
+  float cos[NDIRS/2] = {0.0};
+  float sin[NDIRS/2] = {0.0};
   int n;
- 
-  /* allocate memory */
-  if (!(cos = (float*) calloc(NDIRS/2, sizeof(float))))
-	  ReportError("slope_aspect( )", 1);
-  if (!(sin = (float*) calloc(NDIRS/2, sizeof(float))))
-	  ReportError("slope_aspect( )", 1);
 
  switch (NDIRS) {
   case 4:
@@ -188,43 +205,46 @@ static void flow_fractions(float dx, float dy, float slope, float aspect,
     ReportError("flow_fractions",65);
     assert(0);			/* other cases don't work either */
   }
-  free(sin);
-  free(cos);
   return;
 }
 /* -------------------------------------------------------------
    ElevationSlopeAspect
+   The rows are done by NThreads threads.  Each cell only writes its
+   own slope, aspect and flow fractions, from the elevations and
+   masks of its neighbours, so the results do not depend on the
+   number of threads.  The ranked cells are only made on request, see
+   RankedCells().
    ------------------------------------------------------------- */
-void ElevationSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap)
+void ElevationSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap, int NThreads)
 {
-  const char *Routine = "ElevationSlopeAspect";
   int x;
   int y;
   int n;
-  int k;
+  int NumCells;
   float neighbor_elev[NNEIGHBORS];
   int steepestdirection;
   float min;
-  int xn, yn;
+  TOPOPIX *Cell;
+  TOPOPIX *Neighbor;
 
-  /* fill neighbor array */
+  /* fill neighbor array, the map border is outside the basin (see 
+     InitTopoMap()) */
   
-  for (x = 0; x < Map->NX; x++) {
-    for (y = 0; y < Map->NY; y++) {
+  NumCells = 0;
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(NThreads) \
+  private(x, n, neighbor_elev, steepestdirection, min, Cell, Neighbor) \
+  reduction(+:NumCells)
+#endif
+  for (y = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
       if (INBASIN(TopoMap[y][x].Mask)) {
-	/* Count the number of cells in the basin.  
-	   Need this to allocate memory for
-	   the new, smaller Elev[] and Coords[][].  */
-	Map->NumCells++;
+	/* Count the number of cells in the basin.  */
+	NumCells++;
+	Cell = &(TopoMap[y][x]);
 	for (n = 0; n < NNEIGHBORS; n++) {
-	  xn = x + xneighbor[n];
-	  yn = y + yneighbor[n];	  
-	  if (valid_cell(Map, xn, yn)) {
-	    neighbor_elev[n] = ((TopoMap[yn][xn].Mask) ? TopoMap[yn][xn].Dem : (float) OUTSIDEBASIN);
-	  }
-	  else {
-	    neighbor_elev[n] = (float) OUTSIDEBASIN;
-	  }
+	  Neighbor = Cell + Map->NeighborOffset[n];
+	  neighbor_elev[n] = ((Neighbor->Mask) ? Neighbor->Dem : (float) OUTSIDEBASIN);
 	}	
 	slope_aspect(Map->DX, Map->DY, TopoMap[y][x].Dem, neighbor_elev,
 		     &(TopoMap[y][x].Slope), &(TopoMap[y][x].Aspect));	
@@ -242,110 +262,194 @@ void ElevationSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap)
 	  steepestdirection = -99;
 	  min = DHSVM_HUGE;	       
 	  for (n = 0; n < NDIRS; n++) {
-	    xn = x + xdirection[n];
-	    yn = y + ydirection[n];	  
-	    if (valid_cell(Map, xn, yn)) {
-	      if (INBASIN(TopoMap[yn][xn].Mask)) {
-			  if(TopoMap[yn][xn].Dem < min) { 
-				  min = TopoMap[yn][xn].Dem;
-				  steepestdirection = n;}
-		  }
+	    Neighbor = Cell + Map->DirOffset[n];
+	    if (INBASIN(Neighbor->Mask)) {
+			if(Neighbor->Dem < min) { 
+				min = Neighbor->Dem;
+				steepestdirection = n;}
 	    }
 	  }	  
-	  if(min < TopoMap[y][x].Dem) {
-	    TopoMap[y][x].Dir[steepestdirection] = (int)(255.0 + 0.5);
-	    TopoMap[y][x].TotalDir = (int)(255.0 + 0.5);
-	  }
-	  else {
-	    /*  Last resort: set the Dir of the cell to the cell that is
-		closest in elevation. This should only happen for the 
-		basin outlet, unless the Dem wasn't filled. */	  
-	    TopoMap[y][x].Dir[steepestdirection] = (int)(255.0 + 0.5);
-	    TopoMap[y][x].TotalDir = (int)(255.0 + 0.5);	    
-	    xn = x + xdirection[steepestdirection];
-	    yn = y + ydirection[steepestdirection];
-	  }
+	  /* if the neighbour is not lower this should only happen for the
+	     basin outlet, unless the Dem wasn't filled.  The cell then
+	     drains to the neighbour that is closest in elevation */
+	  TopoMap[y][x].Dir[steepestdirection] = (int)(255.0 + 0.5);
+	  TopoMap[y][x].TotalDir = (int)(255.0 + 0.5);
 	}
-   } 
+      }
+    }
   }
- } 	
-  /* Create a structure to hold elevations of only those cells
-     within the basin and the y,x of those cells.*/
-  if (!(Map->OrderedCells = (ITEM *) calloc(Map->NumCells, sizeof(ITEM))))
+  Map->NumCells += NumCells;
+  return;
+}
+
+/* -------------------------------------------------------------
+   RankedCells
+   Returns Map->OrderedCells, the cells within the basin in
+   ascending order of elevation, and makes it on the first call.
+   Cells with the same elevation are in row-major order.  The array
+   is freed and set to NULL when the mask changes (InitSubBasin()).
+
+   The elevations are sorted as unsigned keys that have the order of
+   the floats, with a least significant digit radix sort of four
+   8 bit passes.  Each of NThreads threads counts the digits of its
+   own part of the cells, and the parts are scattered in their
+   order, so the sort is stable.
+   ------------------------------------------------------------- */
+ITEM *RankedCells(MAPSIZE * Map, TOPOPIX ** TopoMap, int NThreads)
+{
+  const char *Routine = "RankedCells";
+  unsigned int *Key;
+  unsigned int *KeyTemp;
+  unsigned int *Swap;
+  ITEM *Temp;
+  ITEM *SwapItem;
+  long *Count;			/* digit counts of each thread */
+  long Sum;
+  long n;
+  int Pass;
+  int Digit;
+  int t;
+  int x;
+  int y;
+  int k;
+  union {
+    float f;
+    unsigned int u;
+  } Value;
+
+  if (Map->OrderedCells != NULL || Map->NumCells == 0)
+    return Map->OrderedCells;
+
+  if (NThreads < 1)
+    NThreads = 1;
+#ifndef HAVE_OPENMP
+  NThreads = 1;
+#endif
+  if (!(Map->OrderedCells = (ITEM *) calloc(Map->NumCells, sizeof(ITEM))) ||
+      !(Temp = (ITEM *) malloc(Map->NumCells * sizeof(ITEM))) ||
+      !(Key = (unsigned int *) malloc(Map->NumCells * sizeof(unsigned int))) ||
+      !(KeyTemp = (unsigned int *) malloc(Map->NumCells *
+					  sizeof(unsigned int))) ||
+      !(Count = (long *) calloc(256 * NThreads, sizeof(long))))
     ReportError((char *) Routine, 1);
+
+  /* Save the elevation, y, and x in the ITEM structure.  Negative floats
+     have their bits flipped, positive ones their sign bit set, and -0 is
+     made 0 so that it ties with 0 */
   k = 0;
   for (y = 0; y < Map->NY; y++) {
     for (x = 0; x < Map->NX; x++) {
-      /* Save the elevation, y, and x in the ITEM structure. */
       if (INBASIN(TopoMap[y][x].Mask)) {
         Map->OrderedCells[k].Rank = TopoMap[y][x].Dem;
         Map->OrderedCells[k].y = y;
         Map->OrderedCells[k].x = x;
+        Value.f = (TopoMap[y][x].Dem == 0.0) ? 0.0 : TopoMap[y][x].Dem;
+        Key[k] = (Value.u & 0x80000000u) ? ~Value.u : (Value.u | 0x80000000u);
         k++;
       }
     }
   }
-  /* Sort Elev in descending order-- Elev.x and Elev.y hold indices. */ 
-  quick(Map->OrderedCells, Map->NumCells);
 
-  /* End of modifications to create ordered cell coordinates.  SRW 10/02, LCB 03/03 */
-  return;
-}
-
-/* -------------------------------------------------------------
-   QuickSort
-   ------------------------------------------------------------- */
-
-/**********************************************************************
-        this subroutine starts the quick sort
-**********************************************************************/
+  for (Pass = 0; Pass < 4; Pass++) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(NThreads) private(t, n, Digit)
+#endif
+    {
+      long First;
+      long Last;
+
+#ifdef HAVE_OPENMP
+      t = omp_get_thread_num();
+#else
+      t = 0;
+#endif
+      First = (long) Map->NumCells * t / NThreads;
+      Last = (long) Map->NumCells * (t + 1) / NThreads;
+      for (Digit = 0; Digit < 256; Digit++)
+	Count[t * 256 + Digit] = 0;
+      for (n = First; n < Last; n++)
+	Count[t * 256 + ((Key[n] >> (8 * Pass)) & 0xff)]++;
+#ifdef HAVE_OPENMP
+#pragma omp barrier
+#pragma omp single
+#endif
+      {
+	/* start of each digit of each thread, digit by digit */
+	for (Digit = 0, Sum = 0; Digit < 256; Digit++) {
+	  for (k = 0; k < NThreads; k++) {
+	    n = Count[k * 256 + Digit];
+	    Count[k * 256 + Digit] = Sum;
+	    Sum += n;
+	  }
+	}
+      }
+      for (n = First; n < Last; n++) {
+	Digit = (Key[n] >> (8 * Pass)) & 0xff;
+	KeyTemp[Count[t * 256 + Digit]] = Key[n];
+	Temp[Count[t * 256 + Digit]++] = Map->OrderedCells[n];
+      }
+    }
+    Swap = Key;
+    Key = KeyTemp;
+    KeyTemp = Swap;
+    SwapItem = Map->OrderedCells;
+    Map->OrderedCells = Temp;
+    Temp = SwapItem;
+  }
 
-void quick(ITEM *OrderedCells, int count)
-{
-  qs(OrderedCells,0,count-1);
+  /* after an even number of passes the sorted cells are in the array
+     that was allocated for them */
+  free(Temp);
+  free(Key);
+  free(KeyTemp);
+  free(Count);
+  return Map->OrderedCells;
 }
 
-void qs(ITEM *item, int left, int right)
-/**********************************************************************
-        this is the quick sort subroutine - it returns the values in
-        an array from high to low.
-**********************************************************************/
-{
-  register int i,j;
-  ITEM x,y;
-
-  i=left;
-  j=right;
-  x=item[(left+right)/2];
-
-  do {
-    while(item[i].Rank<x.Rank && i<right) i++;
-    while(x.Rank<item[j].Rank && j>left) j--;
-
-    if (i<=j) {
-      y=item[i];
-      item[i]=item[j];
-      item[j]=y;
-      i++;
-      j--;
-    }
-  } while (i<=j);
-  if(left<j) qs(item,left,j);
-  if(i<right) qs(item,i,right);
-}
 /* -------------------------------------------------------------
    HeadSlopeAspect
    This computes slope and aspect using the water table elevation. 
 
+   FlowGrad, Dir and TotalDir in Work are contiguous NY*NX 
+   (NY*NX*NDIRS for Dir) blocks in row major order.  They are kept 
+   between calls, and only the cells for which the water level of the
+   cell itself or of one of its neighbours moved by more than 
+   Tolerance since the last calculation are recalculated.  With a 
+   Tolerance of zero the results are the same as recalculating all 
+   cells.  Changed has a zero border like the maps allocated with 
+   AllocHaloMap(), so the neighbours are found through 
+   Map->NeighborOffset.  The recalculated cells are flagged in 
+   Work->Updated.
+
    Comment: rewritten to fill the sinks (Ning, 2013)
    ------------------------------------------------------------- */
 void HeadSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap, SOILPIX ** SoilMap,
-		     float **FlowGrad, unsigned char ***Dir, unsigned int **TotalDir)
+		     float Tolerance, SUBSURFACEWORK * Work)
 {
   int x;
   int y;
   int n;
+  int i;
+  int c;
+  int Update;
   float neighbor_elev[NNEIGHBORS];
+  TOPOPIX *Topo;
+  SOILPIX *Soil;
+
+  /* find the cells whose water level changed */
+  for (x = 0; x < Map->NX; x++) {
+    for (y = 0; y < Map->NY; y++) {
+      if (INBASIN(TopoMap[y][x].Mask)) {
+	i = y * Map->NX + x;
+	c = (y + 1) * (Map->NX + 2) + x + 1;
+	Work->Changed[c] = (!Work->Valid ||
+	  fabs(SoilMap[y][x].WaterLevel - Work->LastLevel[i]) > Tolerance);
+	if (Work->Changed[c])
+	  Work->LastLevel[i] = SoilMap[y][x].WaterLevel;
+      }
+    }
+  }
+  Work->Valid = TRUE;
 
   /* let's assume for now that WaterLevel is the SOILPIX map is
      computed elsewhere */
@@ -353,47 +457,170 @@ void HeadSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap, SOILPIX ** SoilMap,
     for (y = 0; y < Map->NY; y++) {
       if (INBASIN(TopoMap[y][x].Mask)) {
 		  float slope, aspect;
+		  i = y * Map->NX + x;
+		  c = (y + 1) * (Map->NX + 2) + x + 1;
+		  Update = Work->Changed[c];
+		  for (n = 0; n < NNEIGHBORS; n++)
+			  Update |= Work->Changed[c + Map->NeighborOffset[n]];
+		  Work->Updated[i] = Update;
+		  if (!Update)
+			  continue;
+		  Topo = &(TopoMap[y][x]);
+		  Soil = &(SoilMap[y][x]);
 		  for (n = 0; n < NNEIGHBORS; n++) {
-			  int xn = x + xneighbor[n];
-			  int yn = y + yneighbor[n];			  
-			  if (valid_cell(Map, xn, yn)) {
-				  neighbor_elev[n] =
-					  ((TopoMap[yn][xn].Mask) ? SoilMap[yn][xn].WaterLevel : (float) OUTSIDEBASIN);
-			  }
-			  else {
-				  neighbor_elev[n] = (float) OUTSIDEBASIN;
-			  }
+			  neighbor_elev[n] = ((Topo[Map->NeighborOffset[n]].Mask) ? 
+				  Soil[Map->NeighborOffset[n]].WaterLevel : (float) OUTSIDEBASIN);
 		  }
 		  slope_aspect(Map->DX, Map->DY, SoilMap[y][x].WaterLevel, neighbor_elev,
 		     &slope, &aspect);
 		  flow_fractions(Map->DX, Map->DY, slope, aspect, neighbor_elev,
-		       &(FlowGrad[y][x]), Dir[y][x], &(TotalDir[y][x])); 
+		       &(Work->FlowGrad[i]), &(Work->Dir[i * NDIRS]),
+		       &(Work->TotalDir[i])); 
       }
     }
   }
   return;
 }
 
+/* -------------------------------------------------------------
+   InitFlowGraph
+   Allocates a flow graph for the active cells, with room for a 
+   receiver in each of the NDIRS directions, and fills the active 
+   cell index of each grid cell
+   ------------------------------------------------------------- */
+void InitFlowGraph(MAPSIZE * Map, FLOWGRAPH * Graph)
+{
+  const char *Routine = "InitFlowGraph";
+  int i;
 
+  Graph->NCells = Map->NumActive;
 
+  if (!(Graph->Start = (int *) TaggedCalloc(Graph->NCells + 1, sizeof(int),
+					    MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Graph->RecvX = (int *) TaggedCalloc(Graph->NCells * NDIRS, sizeof(int),
+					    MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Graph->RecvY = (int *) TaggedCalloc(Graph->NCells * NDIRS, sizeof(int),
+					    MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Graph->Fract = (float *) TaggedCalloc(Graph->NCells * NDIRS,
+					      sizeof(float), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Graph->Index = (int *) TaggedMalloc(Map->NY * Map->NX * sizeof(int),
+					    MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Graph->RevStart = (int *) TaggedCalloc(Graph->NCells + 1, sizeof(int),
+					       MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Graph->RevDonor = (int *) TaggedCalloc(Graph->NCells * NDIRS,
+					       sizeof(int), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
+  if (!(Graph->RevEdge = (int *) TaggedCalloc(Graph->NCells * NDIRS,
+					      sizeof(int), MEM_ROUTING)))
+    ReportError((char *) Routine, 1);
 
+  for (i = 0; i < Map->NY * Map->NX; i++)
+    Graph->Index[i] = -1;
+  for (i = 0; i < Graph->NCells; i++)
+    Graph->Index[Map->ActiveCells[i].y * Map->NX + Map->ActiveCells[i].x] = i;
+}
 
+/* -------------------------------------------------------------
+   MakeFlowGraph
+   Lists for each active cell the neighbours that receive part of 
+   its outflow, i.e. the directions with a non-zero Dir, together 
+   with the fraction Dir/TotalDir.  The routing loops then only 
+   visit the receivers and no longer need valid_cell() or the 
+   division.  The directions are taken from TopoMap if Dir is NULL, 
+   otherwise Dir and TotalDir are NY*NX*NDIRS and NY*NX blocks as 
+   filled by HeadSlopeAspect().
+
+   The reverse lists (RevStart, RevDonor, RevEdge) give for each 
+   active cell the donors that send water to it, in increasing 
+   active cell order, so that the inflow of a cell can be gathered 
+   in the same order in which the serial scatter adds it up.  
+   Receivers outside the active cells are not listed.
+   ------------------------------------------------------------- */
+void MakeFlowGraph(MAPSIZE * Map, TOPOPIX ** TopoMap, unsigned char *Dir,
+		   unsigned int *TotalDir, FLOWGRAPH * Graph)
+{
+  int i;
+  int k;
+  int n;
+  int x;
+  int y;
+  int xn;
+  int yn;
+  int r;
+  unsigned char *CellDir;
+  unsigned int CellTotalDir;
+
+  for (i = 0, k = 0; i < Graph->NCells; i++) {
+    y = Map->ActiveCells[i].y;
+    x = Map->ActiveCells[i].x;
+    if (Dir == NULL) {
+      CellDir = TopoMap[y][x].Dir;
+      CellTotalDir = TopoMap[y][x].TotalDir;
+    }
+    else {
+      CellDir = &(Dir[(y * Map->NX + x) * NDIRS]);
+      CellTotalDir = TotalDir[y * Map->NX + x];
+    }
+    Graph->Start[i] = k;
+    for (n = 0; n < NDIRS; n++) {
+      xn = x + xdirection[n];
+      yn = y + ydirection[n];
+      if (CellDir[n] > 0 && valid_cell(Map, xn, yn)) {
+	Graph->RecvX[k] = xn;
+	Graph->RecvY[k] = yn;
+	Graph->Fract[k] = (float) CellDir[n] / (float) CellTotalDir;
+	k++;
+      }
+    }
+  }
+  Graph->Start[Graph->NCells] = k;
+
+  /* count the donors of each receiver, and turn the counts into 
+     offsets */
+  for (i = 0; i <= Graph->NCells; i++)
+    Graph->RevStart[i] = 0;
+  for (k = 0; k < Graph->Start[Graph->NCells]; k++) {
+    r = Graph->Index[Graph->RecvY[k] * Map->NX + Graph->RecvX[k]];
+    if (r >= 0)
+      Graph->RevStart[r + 1]++;
+  }
+  for (i = 0; i < Graph->NCells; i++)
+    Graph->RevStart[i + 1] += Graph->RevStart[i];
+
+  /* fill the donor lists, using RevStart as the insertion point and 
+     shifting it back afterwards */
+  for (i = 0; i < Graph->NCells; i++) {
+    for (k = Graph->Start[i]; k < Graph->Start[i + 1]; k++) {
+      r = Graph->Index[Graph->RecvY[k] * Map->NX + Graph->RecvX[k]];
+      if (r >= 0) {
+	Graph->RevDonor[Graph->RevStart[r]] = i;
+	Graph->RevEdge[Graph->RevStart[r]] = k;
+	Graph->RevStart[r]++;
+      }
+    }
+  }
+  for (i = Graph->NCells; i > 0; i--)
+    Graph->RevStart[i] = Graph->RevStart[i - 1];
+  Graph->RevStart[0] = 0;
+}
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
+/* -------------------------------------------------------------
+   FreeFlowGraph
+   ------------------------------------------------------------- */
+void FreeFlowGraph(FLOWGRAPH * Graph)
+{
+  TaggedFree(Graph->Start);
+  TaggedFree(Graph->RecvX);
+  TaggedFree(Graph->RecvY);
+  TaggedFree(Graph->Fract);
+  TaggedFree(Graph->Index);
+  TaggedFree(Graph->RevStart);
+  TaggedFree(Graph->RevDonor);
+  TaggedFree(Graph->RevEdge);
+}
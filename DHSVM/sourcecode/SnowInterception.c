@@ -62,8 +62,8 @@
      float *MomentSq        - Momentum squared for rain (kg* m/s)^2 /m^2*s)
       float *Height          - Height of vegetation (m)
       float MS_Rainfall      - Momentum for direct rainfall () COD
-      float LD_FallVelocity  - Leaf drip fall velocity corresponding to the
-                 canopy height in vegetation map (m/s)
+      double LD_MomentSq     - Momentum squared of the leaf drip per depth
+                 of drip (VEGTABLE.LD_MomentSq, see InitLeafDrip())
 
    Returns      : none
 
@@ -92,7 +92,7 @@ void SnowInterception(OPTIONSTRUCT *Options, int y, int x, int Dt, float F,
   float *IntRain, float *IntSnow, float *TempIntStorage,
   float *VaporMassFlux, float *Tcanopy, float *MeltEnergy,
   float *MomentSq, float *Height, unsigned char Understory,
-  float MS_Rainfall, float LD_FallVelocity)
+  float MS_Rainfall, double LD_MomentSq)
 {
   float AdvectedEnergy;		/* Energy advected by the rain (W/m2) */
   float DeltaSnowInt;		/* Change in the physical swe of snow
@@ -365,10 +365,8 @@ void SnowInterception(OPTIONSTRUCT *Options, int y, int x, int Dt, float F,
   if (Understory)
     /* Since the understory is assumed to cover the entire grid cell, all
        momentum is associated with leaf drip, eq. 2, Wicks and Bathurst (1996) */
-    *MomentSq = pow(LD_FallVelocity * WATER_DENSITY, 2) * PI / 6 *
-    pow(LEAF_DRIP_DIA, 3) * (*RainFall) / Dt;
+    *MomentSq = LD_MomentSq * (*RainFall) / Dt;
   else
     /* If no understory, part of the rainfall reaches the ground as direct throughfall. */
-    *MomentSq = pow(LD_FallVelocity * WATER_DENSITY, 2) * PI / 6 *
-    pow(LEAF_DRIP_DIA, 3) * Drip / Dt + (1 - F) * MS_Rainfall;
+    *MomentSq = LD_MomentSq * Drip / Dt + (1 - F) * MS_Rainfall;
 }
@@ -25,6 +25,7 @@
 #include "massenergy.h"
 #include "functions.h"
 #include "snow.h"
+#include "fastmath.h"
 
 static float CalcSnowPackEnergyBalance(float Tsurf, ...);
 
@@ -63,6 +64,9 @@ static float CalcSnowPackEnergyBalance(float Tsurf, ...);
     float *TSurf           - Temperature of snow pack surface layer (C)
     float *MeltEnergy      - Energy used for melting and heating of snow pack
                              (W/m2)
+    int Solver             - Surface temperature solver (BRENT or NEWTON)
+    int *NIter             - Number of energy balance evaluations used to
+                             solve for TSurf
 
   Returns      :
     float Outflow          - Amount of snowpack outflow (m)
@@ -77,6 +81,8 @@ static float CalcSnowPackEnergyBalance(float Tsurf, ...);
     float *TSurf           - Temperature of snow pack surface layer (C)
     float *MeltEnergy      - Energy used for melting and heating of snow pack
                              (W/m2)
+    int *NIter             - Number of energy balance evaluations used to
+                             solve for TSurf
 
   Comments     :
 *****************************************************************************/
@@ -84,8 +90,12 @@ float SnowMelt(int y, int x, int Dt, float Z, float Displacement, float Z0,
   float BaseRa, float AirDens, float EactAir, float Lv, float ShortRad, 
   float LongRadIn, float Press, float RainFall, float SnowFall, float Tair, 
   float Vpd, float Wind, float *PackWater, float *SurfWater, float *Swq,
-  float *VaporMassFlux, float *TPack, float *TSurf, float *MeltEnergy)
+  float *VaporMassFlux, float *TPack, float *TSurf, float *MeltEnergy,
+  int Solver, int *NIter)
 {
+  SNOWEBPARAMS Params;		/* Arguments of the energy balance */
+  double LogZ;			    /* Logarithmic term of the stability 
+                               correction */
   float DeltaPackCC;		/* Change in cold content of the pack */
   float DeltaPackSwq;		/* Change in snow water equivalent of the pack (m) */
   float Ice;			    /* Ice content of snow pack (m) */
@@ -108,6 +118,8 @@ float SnowMelt(int y, int x, int Dt, float Z, float Displacement, float Z0,
 
   InitialSwq = *Swq;
   OldTSurf = *TSurf;
+  *NIter = 0;
+  LogZ = MathLog(2.0f / Z0);	/* the stability correction uses 2 m */
 
   /* Initialize snowpack variables */
   Ice = *Swq - *PackWater - *SurfWater;
@@ -159,7 +171,7 @@ float SnowMelt(int y, int x, int Dt, float Z, float Displacement, float Z0,
 
   /* Calculate the surface energy balance for snow_temp = 0.0 */
   Qnet = CalcSnowPackEnergyBalance((float) 0.0, Dt, BaseRa, Z, Displacement,
-    Z0, Wind, ShortRad, LongRadIn, AirDens,
+    LogZ, Wind, ShortRad, LongRadIn, AirDens,
     Lv, Tair, Press, Vpd, EactAir, RainFall,
     SurfaceSwq, *SurfWater, OldTSurf,
     &RefreezeEnergy, VaporMassFlux);
@@ -227,13 +239,40 @@ float SnowMelt(int y, int x, int Dt, float Z, float Displacement, float Z0,
 
   /* Else, SnowPackEnergyBalance(T=0.0) <= 0.0 */
   else {
-    /* Calculate surface layer temperature using "Brent method" */
-
-    *TSurf = RootBrent(y, x, (float)(*TSurf - DELTAT), (float) 0.0,
-      SnowPackEnergyBalance, Dt, BaseRa, Z, Displacement,
-      Z0, Wind, ShortRad, LongRadIn, AirDens, Lv, Tair,
-      Press, Vpd, EactAir, RainFall, SurfaceSwq, *SurfWater,
-      OldTSurf, &RefreezeEnergy, VaporMassFlux);
+    /* Calculate surface layer temperature using "Brent method", or using 
+       Newton-Raphson iterations starting from the surface temperature of 
+       the last time step */
+
+    if (Solver == NEWTON) {
+      Params.Dt = Dt;
+      Params.Ra = BaseRa;
+      Params.Z = Z;
+      Params.Displacement = Displacement;
+      Params.LogZ = LogZ;
+      Params.Wind = Wind;
+      Params.ShortRad = ShortRad;
+      Params.LongRadIn = LongRadIn;
+      Params.AirDens = AirDens;
+      Params.Lv = Lv;
+      Params.Tair = Tair;
+      Params.Press = Press;
+      Params.Vpd = Vpd;
+      Params.EactAir = EactAir;
+      Params.Rain = RainFall;
+      Params.SweSurfaceLayer = SurfaceSwq;
+      Params.SurfaceLiquidWater = *SurfWater;
+      Params.OldTSurf = OldTSurf;
+      Params.RefreezeEnergy = &RefreezeEnergy;
+      Params.VaporMassFlux = VaporMassFlux;
+      *TSurf = RootNewton(y, x, (float)(*TSurf - DELTAT), (float) 0.0,
+        OldTSurf, NIter, SnowPackEnergyBalanceParams, &Params);
+    }
+    else
+      *TSurf = RootBrent(y, x, (float)(*TSurf - DELTAT), (float) 0.0, NIter,
+        SnowPackEnergyBalance, Dt, BaseRa, Z, Displacement,
+        LogZ, Wind, ShortRad, LongRadIn, AirDens, Lv, Tair,
+        Press, Vpd, EactAir, RainFall, SurfaceSwq, *SurfWater,
+        OldTSurf, &RefreezeEnergy, VaporMassFlux);
 
     /* since we iterated, the surface layer is below freezing and no snowmelt */
     SnowMelt = 0.0;
@@ -9,6 +9,7 @@
  * DESCRIPTION:  Calculate snow pack energy balance
  * DESCRIP-END.
  * FUNCTIONS:    SnowPackEnergyBalance()
+ *               SnowPackEnergyBalanceParams()
  * COMMENTS:
  * $Id: SnowPackEnergyBalance.c,v 1.4 2003/07/01 21:26:25 olivier Exp $     
  */
@@ -47,42 +48,7 @@
 *****************************************************************************/
 float SnowPackEnergyBalance(float TSurf, va_list ap)
 {
-  /* start of list of arguments in variable argument list */
-
-  int Dt;			    /* Model time step (hours) */
-  float Ra;			    /* Aerodynamic resistance (s/m) */
-  float Z;			    /* Reference height (m) */
-  float Displacement;   /* Displacement height (m) */
-  float Z0;			    /* Roughness length (m) */
-  float Wind;			/* Wind speed (m/s) */
-  float ShortRad;		/* Net incident shortwave radiation (W/m2) */
-  float LongRadIn;		/* Incoming longwave radiation (W/m2) */
-  float AirDens;		/* Density of air (kg/m3) */
-  float Lv;			    /* Latent heat of vaporization (J/kg3) */
-  float Tair;			/* Air temperature (C) */
-  float Press;			/* Air pressure (Pa) */
-  float Vpd;			/* Vapor pressure deficit (Pa) */
-  float EactAir;		/* Actual vapor pressure of air (Pa) */
-  float Rain;			/* Rain fall (m/timestep) */
-  float SweSurfaceLayer;/* Snow water equivalent in surface layer (m) */
-  float SurfaceLiquidWater;	/* Liquid water in the surface layer (m) */
-  float OldTSurf;		    /* Surface temperature during previous time step */
-  float *RefreezeEnergy;	/* Refreeze energy (W/m2) */
-  float *VaporMassFlux;		/* Mass flux of water vapor to or from the intercepted snow */
-
-  /* end of list of arguments in variable argument list */
-
-  float AdvectedEnergy;		/* Energy advected by precipitation (W/m2) */
-  float DeltaColdContent;	/* Change in cold content (W/m2) */
-  float EsSnow;			    /* saturated vapor pressure in the snow pack (Pa)  */
-  float LatentHeat;		    /* Latent heat exchange at surface (W/m2) */
-  float LongRadOut;		    /* long wave radiation emitted by surface (W/m2) */
-  float Ls;			        /* Latent heat of sublimation (J/kg) */
-  float NetRad;			    /* Net radiation exchange at surface (W/m2) */
-  float RestTerm;		    /* Rest term in surface energy balance (W/m2) */
-  float SensibleHeat;		/* Sensible heat exchange at surface (W/m2) */
-  float TMean;			    /* Mean temperature during interval (C) */
-  double Tmp;			    /* temporary variable */
+  SNOWEBPARAMS Params;		/* arguments in variable argument list */
 
   /* Assign the elements of the array to the appropriate variables.  The list
      is traversed as if the elements are doubles, because:
@@ -96,29 +62,83 @@ float SnowPackEnergyBalance(float TSurf, va_list ap)
 
      (quoted from the comp.lang.c FAQ list)
    */
-  Dt = va_arg(ap, int);
-  Ra = (float) va_arg(ap, double);
-  Z = (float) va_arg(ap, double);
-  Displacement = (float) va_arg(ap, double);
-  Z0 = (float) va_arg(ap, double);
-  Wind = (float) va_arg(ap, double);
-  ShortRad = (float) va_arg(ap, double);
-  LongRadIn = (float) va_arg(ap, double);
-  AirDens = (float) va_arg(ap, double);
-  Lv = (float) va_arg(ap, double);
-  Tair = (float) va_arg(ap, double);
-  Press = (float) va_arg(ap, double);
-  Vpd = (float) va_arg(ap, double);
-  EactAir = (float) va_arg(ap, double);
-  Rain = (float) va_arg(ap, double);
-  SweSurfaceLayer = (float) va_arg(ap, double);
-  SurfaceLiquidWater = (float) va_arg(ap, double);
-  OldTSurf = (float) va_arg(ap, double);
-  RefreezeEnergy = (float *) va_arg(ap, double *);
-  VaporMassFlux = (float *) va_arg(ap, double *);
+  Params.Dt = va_arg(ap, int);
+  Params.Ra = (float) va_arg(ap, double);
+  Params.Z = (float) va_arg(ap, double);
+  Params.Displacement = (float) va_arg(ap, double);
+  Params.LogZ = va_arg(ap, double);
+  Params.Wind = (float) va_arg(ap, double);
+  Params.ShortRad = (float) va_arg(ap, double);
+  Params.LongRadIn = (float) va_arg(ap, double);
+  Params.AirDens = (float) va_arg(ap, double);
+  Params.Lv = (float) va_arg(ap, double);
+  Params.Tair = (float) va_arg(ap, double);
+  Params.Press = (float) va_arg(ap, double);
+  Params.Vpd = (float) va_arg(ap, double);
+  Params.EactAir = (float) va_arg(ap, double);
+  Params.Rain = (float) va_arg(ap, double);
+  Params.SweSurfaceLayer = (float) va_arg(ap, double);
+  Params.SurfaceLiquidWater = (float) va_arg(ap, double);
+  Params.OldTSurf = (float) va_arg(ap, double);
+  Params.RefreezeEnergy = (float *) va_arg(ap, double *);
+  Params.VaporMassFlux = (float *) va_arg(ap, double *);
+
+  return SnowPackEnergyBalanceParams(TSurf, &Params, NULL);
+}
+
+/*****************************************************************************
+  Function name: SnowPackEnergyBalanceParams()
+
+  Purpose      : Calculate the surface energy balance for the snow pack and
+                 its derivative with respect to the surface temperature
+
+  Required     :
+    float TSurf           - new estimate of effective surface temperature
+    void *Params          - Pointer to a SNOWEBPARAMS structure with the 
+                            remaining arguments of SnowPackEnergyBalance()
+    float *Derivative     - Derivative of the rest term with respect to 
+                            TSurf, not calculated if NULL
+
+  Returns      :
+    float RestTerm        - Rest term in the energy balance
+
+  Modifies     : 
+    float *RefreezeEnergy - Refreeze energy (W/m2) 
+    float *VaporMassFlux  - Mass flux of water vapor to or from the
+                            intercepted snow 
+    float *Derivative
+
+  Comments     : Used directly by RootNewton() and through 
+                 SnowPackEnergyBalance() by RootBrent()
+*****************************************************************************/
+float SnowPackEnergyBalanceParams(float TSurf, void *Params, 
+				  float *Derivative)
+{
+  SNOWEBPARAMS *P;		/* arguments */
+  float AdvectedEnergy;		/* Energy advected by precipitation (W/m2) */
+  float Correction;		/* stability correction */
+  float dCorrection;		/* derivative of Correction */
+  float DeltaColdContent;	/* Change in cold content (W/m2) */
+  float dLatentHeat;		/* derivative of LatentHeat with respect to 
+				   TMean */
+  float dRa;			/* derivative of Ra with respect to TMean */
+  float dVaporMassFlux;		/* derivative of *VaporMassFlux with respect
+				   to TMean */
+  float EsSnow;			    /* saturated vapor pressure in the snow pack (Pa)  */
+  float LatentHeat;		    /* Latent heat exchange at surface (W/m2) */
+  float LongRadOut;		    /* long wave radiation emitted by surface (W/m2) */
+  float Ls;			        /* Latent heat of sublimation (J/kg) */
+  float NetRad;			    /* Net radiation exchange at surface (W/m2) */
+  float Ra;			        /* Aerodynamic resistance (s/m) */
+  float RestTerm;		    /* Rest term in surface energy balance (W/m2) */
+  float SensibleHeat;		/* Sensible heat exchange at surface (W/m2) */
+  float TMean;			    /* Mean temperature during interval (C) */
+  double Tmp;			    /* temporary variable */
+
+  P = (SNOWEBPARAMS *) Params;
 
   /* Calculate active temp for energy balance as average of old and new  */
-  TMean = 0.5 * (OldTSurf + TSurf);
+  TMean = 0.5 * (P->OldTSurf + TSurf);
 
   /* Correct aerodynamic conductance for stable conditions
      Note: If air temp >> snow temp then aero_cond -> 0 (i.e. very stable)
@@ -128,18 +148,28 @@ float SnowPackEnergyBalance(float TSurf, va_list ap)
      NOTE: In the old code 2m was passed instead of Z-Displacement.  I (bart)
      think that it is more correct to calculate ALL fluxes at the same
      reference level */
-  if (Wind > 0.0)
-    Ra /= StabilityCorrection(2.0f, 0.f, TMean, Tair, Wind, Z0);
+  Ra = P->Ra;
+  dRa = 0.0;
+  if (P->Wind > 0.0) {
+    if (Derivative == NULL)
+      Ra /= StabilityCorrection(2.0f, 0.f, TMean, P->Tair, P->Wind, P->LogZ);
+    else {
+      Correction = StabilityCorrectionDeriv(2.0f, 0.f, TMean, P->Tair,
+					    P->Wind, P->LogZ, &dCorrection);
+      Ra /= Correction;
+      dRa = -Ra * dCorrection / Correction;
+    }
+  }
   else
     Ra = DHSVM_HUGE;
 
   /* Calculate longwave exchange and net radiation */
   Tmp = TMean + 273.15;
   LongRadOut = STEFAN * (Tmp * Tmp * Tmp * Tmp);
-  NetRad = ShortRad + LongRadIn - LongRadOut;
+  NetRad = P->ShortRad + P->LongRadIn - LongRadOut;
 
   /* Calculate the sensible heat flux */
-  SensibleHeat = AirDens * CP * (Tair - TMean) / Ra;
+  SensibleHeat = P->AirDens * CP * (P->Tair - TMean) / Ra;
 
   /* Calculate the mass flux of ice to or from the surface layer */
 
@@ -147,43 +177,62 @@ float SnowPackEnergyBalance(float TSurf, va_list ap)
      (Equation 3.32, Bras 1990) */
   EsSnow = SatVaporPressure(TMean);
 
-  *VaporMassFlux = AirDens * (EPS / Press) * (EactAir - EsSnow) / Ra;
-  *VaporMassFlux /= WATER_DENSITY;
-  if (fequal(Vpd, 0.0) && *VaporMassFlux < 0.0)
-    *VaporMassFlux = 0.0;
+  *(P->VaporMassFlux) = P->AirDens * (EPS / P->Press) * 
+    (P->EactAir - EsSnow) / Ra;
+  *(P->VaporMassFlux) /= WATER_DENSITY;
+  dVaporMassFlux = 0.0;
+  if (Derivative != NULL)
+    dVaporMassFlux = P->AirDens * (EPS / P->Press) *
+      (-SatVaporPressureDeriv(TMean) / Ra - 
+       (P->EactAir - EsSnow) * dRa / (Ra * Ra)) / WATER_DENSITY;
+  if (fequal(P->Vpd, 0.0) && *(P->VaporMassFlux) < 0.0) {
+    *(P->VaporMassFlux) = 0.0;
+    dVaporMassFlux = 0.0;
+  }
 
   /* Calculate latent heat flux */
   if (TMean >= 0.0) {
     /* Melt conditions: use latent heat of vaporization */
-    LatentHeat = Lv * *VaporMassFlux * WATER_DENSITY;
+    LatentHeat = P->Lv * *(P->VaporMassFlux) * WATER_DENSITY;
+    dLatentHeat = P->Lv * dVaporMassFlux * WATER_DENSITY;
   }
   else {
     /* Accumulation: use latent heat of sublimation (Eq. 3.19, Bras 1990 */
     Ls = (677. - 0.07 * TMean) * JOULESPCAL * GRAMSPKG;
-    LatentHeat = Ls * *VaporMassFlux * WATER_DENSITY;
+    LatentHeat = Ls * *(P->VaporMassFlux) * WATER_DENSITY;
+    dLatentHeat = (-0.07 * JOULESPCAL * GRAMSPKG * *(P->VaporMassFlux) +
+		   Ls * dVaporMassFlux) * WATER_DENSITY;
   }
 
   /* Calculate advected heat flux from rain 
      WORK IN PROGRESS:  Should the following read (Tair - Tsurf) ?? */
-  AdvectedEnergy = (CH_WATER * Tair * Rain) / Dt;
+  AdvectedEnergy = (CH_WATER * P->Tair * P->Rain) / P->Dt;
 
   /* Calculate change in cold content */
-  DeltaColdContent = CH_ICE * SweSurfaceLayer * (TSurf - OldTSurf) / Dt;
+  DeltaColdContent = CH_ICE * P->SweSurfaceLayer * (TSurf - P->OldTSurf) / 
+    P->Dt;
 
   /* Calculate net energy exchange at the snow surface */
   RestTerm = NetRad + SensibleHeat + LatentHeat + AdvectedEnergy -
     DeltaColdContent;
 
-  *RefreezeEnergy = (SurfaceLiquidWater * LF * WATER_DENSITY) / Dt;
+  /* dTMean/dTSurf = 0.5 */
+  if (Derivative != NULL)
+    *Derivative = 0.5 * (-4 * STEFAN * Tmp * Tmp * Tmp -
+			 P->AirDens * CP * (1 / Ra + (P->Tair - TMean) * dRa /
+					    (Ra * Ra)) + dLatentHeat) -
+      CH_ICE * P->SweSurfaceLayer / P->Dt;
+
+  *(P->RefreezeEnergy) = (P->SurfaceLiquidWater * LF * WATER_DENSITY) / P->Dt;
 
-  if (fequal(TSurf, 0.0) && RestTerm > -(*RefreezeEnergy)) {
-    *RefreezeEnergy = -RestTerm;	/* available energy input over cold content
+  if (fequal(TSurf, 0.0) && RestTerm > -(*(P->RefreezeEnergy))) {
+    *(P->RefreezeEnergy) = -RestTerm;	/* available energy input over cold content
 					                   used to melt, i.e. Qrf is negative value
 					                   (energy out of pack) */
     RestTerm = 0.0;
   }
   else {
-    RestTerm += *RefreezeEnergy;	/* add this positive value to the pack */
+    RestTerm += *(P->RefreezeEnergy);	/* add this positive value to the pack */
   }
 
   return RestTerm;
@@ -0,0 +1,118 @@
+/*
+ * SUMMARY:      SoilCapacity.c - Constants of the soil column of a cell
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  WaterTableDepth(), UnsaturatedFlow() and CalcAvailableWater()
+ *               are called for each cell in each time step, and each time
+ *               they work out the thickness and the storage of the layer
+ *               below the root layers from the soil depth, the root depths
+ *               and the cut-bank corrections of the cell, which only change
+ *               with a map event.  These are kept in the SOILCAPACITY of
+ *               the cell in its ROADSTRUCT.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitSoilCapacity()
+ *               InitSoilCapacities()
+ * COMMENTS:     The values are computed with the same operations, in the
+ *               same order, as in the routines that use them, so the
+ *               results do not change
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "constants.h"
+#include "data.h"
+#include "functions.h"
+#include "soilmoisture.h"
+
+/*****************************************************************************
+  Function name: InitSoilCapacity()
+
+  Purpose      : Set the constants of a soil column
+
+  Required     :
+    int NRootLayers  - Number of soil layers
+    float TotalDepth - Total depth of the soil profile (m)
+    float *RootDepth - Depth of each of the soil layers (m)
+    float *Porosity  - Porosity of each soil layer
+    float *FCap      - Field capacity of each soil layer
+    float *Adjust    - Correction for each layer for loss of soil storage
+                       due to channel/road-cut
+
+  Modifies     : Capacity
+*****************************************************************************/
+void InitSoilCapacity(int NRootLayers, float TotalDepth, float *RootDepth,
+		      float *Porosity, float *FCap, float *Adjust,
+		      SOILCAPACITY *Capacity)
+{
+  float DeepPorosity = Porosity[NRootLayers - 1];
+  float DeepFCap = FCap[NRootLayers - 1];
+  float Depth;
+  int i;
+
+  /* as in WaterTableDepth() and UnsaturatedFlow() */
+  Capacity->DeepDepth = TotalDepth;
+  for (i = 0; i < NRootLayers; i++)
+    Capacity->DeepDepth -= RootDepth[i];
+  Capacity->DeepThickness = Capacity->DeepDepth * Adjust[NRootLayers];
+  Capacity->DeepStorage = Capacity->DeepThickness * (DeepPorosity - DeepFCap);
+
+  /* as in CalcAvailableWater() */
+  Depth = 0.0;
+  for (i = 0; i < NRootLayers && Depth < TotalDepth; i++) {
+    if (RootDepth[i] < (TotalDepth - Depth))
+      Depth += RootDepth[i];
+    else
+      Depth = TotalDepth;
+  }
+  Capacity->RootBottom = Depth;
+  if (Depth < TotalDepth)
+    Capacity->DeepAvailable = (DeepPorosity - DeepFCap) *
+      (TotalDepth - Depth) * Adjust[NRootLayers];
+  else
+    Capacity->DeepAvailable = 0.0;
+}
+
+/*****************************************************************************
+  Function name: InitSoilCapacities()
+
+  Purpose      : Set the constants of the soil columns of the basin
+
+  Required     :
+    MAPSIZE *Map         - Model map
+    TOPOPIX **TopoMap    - Basin mask
+    SOILPIX **SoilMap    - Soil depth and type of each cell
+    VEGPIX **VegMap      - Vegetation type of each cell
+    VEGTABLE *VType      - Vegetation types
+    SOILTABLE *SType     - Soil types
+    ROADSTRUCT **Network - Cut-bank corrections of each cell
+
+  Modifies     : Network[y][x].Capacity
+
+  Comments     : Called after InitNetwork(), and not with SNOW ONLY, where
+                 the rows of Network are shared and the soil is not modeled
+*****************************************************************************/
+void InitSoilCapacities(MAPSIZE *Map, TOPOPIX **TopoMap, SOILPIX **SoilMap,
+			VEGPIX **VegMap, VEGTABLE *VType, SOILTABLE *SType,
+			ROADSTRUCT **Network)
+{
+  VEGTABLE *Veg;
+  SOILTABLE *Soil;
+  int x;
+  int y;
+
+  for (y = 0; y < Map->NY; y++) {
+    for (x = 0; x < Map->NX; x++) {
+      if (!INBASIN(TopoMap[y][x].Mask))
+	continue;
+      Veg = &(VType[VegMap[y][x].Veg - 1]);
+      Soil = &(SType[SoilMap[y][x].Soil - 1]);
+      InitSoilCapacity(Veg->NSoilLayers, SoilMap[y][x].Depth, Veg->RootDepth,
+		       Soil->Porosity, Soil->FCap, Network[y][x].Adjust,
+		       &(Network[y][x].Capacity));
+    }
+  }
+}
@@ -0,0 +1,326 @@
+/*
+ * SUMMARY:      SoilColumnBatch.c - Soil columns of many cells at once
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS SOIL COLUMN BATCH the pixel loop does
+ *               DistributeSatflow() and UnsaturatedFlow() for the cells of
+ *               a piece of a tile together instead of once per cell inside
+ *               MassEnergyBalance().  The columns of a soil type have the
+ *               same layers and soil parameters, so they are done
+ *               SOIL_LANES at a time: the layer values of the cells are
+ *               laid out lane by lane and each step of the layer loop is a
+ *               loop over the lanes, with the branches of the scalar code
+ *               turned into selects that the compiler can vectorize
+ * DESCRIP-END.
+ * FUNCTIONS:    ClearSoilBatch()
+ *               AddSoilColumn()
+ *               DistributeSatflowBatch()
+ *               UnsaturatedFlowBatch()
+ *               FreeSoilBatch()
+ *               SelectSoilKernels()
+ *               SortColumns()
+ *               LaneSpace()
+ * COMMENTS:     The lanes do the operations of DistributeSatflow() and
+ *               UnsaturatedFlow() in the same order and precision, so the
+ *               results are the same as those of the scalar code.  The
+ *               Brooks-Corey conductivity of the drainage comes from the
+ *               tables of the soil type (SOIL TABLE SIZE) in the
+ *               lanes, without them pow() is called for each draining
+ *               lane, or with MATH ACCURACY FAST the PolyPow() of all the
+ *               lanes is vectorized (FastMath.c).  The water table depth is found for each cell with
+ *               WaterTableDepth().  The lane loops are in soilkernels.h,
+ *               which is compiled for each SIMD level of cpudispatch.h,
+ *               and once more at each level for the soil types with
+ *               SOIL_COMMON_LAYERS layers, the types of nearly all the
+ *               configurations.  The loops of a piece of a soil type are
+ *               picked by its number of layers
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "soilmoisture.h"
+#include "cpudispatch.h"
+#include "fastmath.h"
+
+#define SOIL_LANES 8		/* cells done at once */
+#define SOIL_COMMON_LAYERS 3	/* layers of the soil types that have loops
+				   of their own */
+#define LANE(a, i, l) ((a)[(i) * SOIL_LANES + (l)])
+
+static void SortColumns(SOILBATCH *Batch);
+static void LaneSpace(SOILBATCH *Batch, int NLayers);
+
+/* the lane loops of each SIMD level, and those selected by
+   InitCpuDispatch() */
+typedef void (*DISTRIBUTEKERNEL) (SOILBATCH *Batch, int *Lane, int NLanes);
+typedef void (*UNSATKERNEL) (SOILBATCH *Batch, int *Lane, int NLanes, int Dt);
+
+#ifdef HAVE_SIMD_DISPATCH
+/* the selects of the loops are only vectorized if the operations of both
+   sides may be done, which does not change the results, and a multiply
+   and an add are not contracted at the levels with FMA */
+#pragma GCC push_options
+#pragma GCC optimize("no-trapping-math", "fp-contract=off")
+#endif
+#define SIMD_SUFFIX _sse2
+#include "soilkernels.h"
+#undef SIMD_SUFFIX
+#define SOIL_FIXED_LAYERS SOIL_COMMON_LAYERS
+#define SIMD_SUFFIX _sse2_fixed
+#include "soilkernels.h"
+#undef SIMD_SUFFIX
+#undef SOIL_FIXED_LAYERS
+#ifdef HAVE_SIMD_DISPATCH
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define SIMD_SUFFIX _avx2
+#include "soilkernels.h"
+#undef SIMD_SUFFIX
+#define SOIL_FIXED_LAYERS SOIL_COMMON_LAYERS
+#define SIMD_SUFFIX _avx2_fixed
+#include "soilkernels.h"
+#undef SIMD_SUFFIX
+#undef SOIL_FIXED_LAYERS
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f", "prefer-vector-width=512")
+#define SIMD_SUFFIX _avx512
+#include "soilkernels.h"
+#undef SIMD_SUFFIX
+#define SOIL_FIXED_LAYERS SOIL_COMMON_LAYERS
+#define SIMD_SUFFIX _avx512_fixed
+#include "soilkernels.h"
+#undef SIMD_SUFFIX
+#undef SOIL_FIXED_LAYERS
+#pragma GCC pop_options
+#pragma GCC pop_options
+#endif
+
+/* the loops of the soil types with SOIL_COMMON_LAYERS layers, and of the
+   others */
+static DISTRIBUTEKERNEL DistributeLanes = DistributeLanes_sse2;
+static UNSATKERNEL UnsaturatedLanes = UnsaturatedLanes_sse2;
+static DISTRIBUTEKERNEL DistributeFixed = DistributeLanes_sse2_fixed;
+static UNSATKERNEL UnsaturatedFixed = UnsaturatedLanes_sse2_fixed;
+
+#define DISTRIBUTE(Batch, Lane, NLanes) \
+  ((Batch)->Column[(Lane)[0]].SType->NLayers == SOIL_COMMON_LAYERS ? \
+   DistributeFixed : DistributeLanes) (Batch, Lane, NLanes)
+#define UNSATURATED(Batch, Lane, NLanes, Dt) \
+  ((Batch)->Column[(Lane)[0]].SType->NLayers == SOIL_COMMON_LAYERS ? \
+   UnsaturatedFixed : UnsaturatedLanes) (Batch, Lane, NLanes, Dt)
+
+/*****************************************************************************
+  Function name: ClearSoilBatch()
+
+  Purpose      : Empty the batch for the next piece of the pixel loop
+*****************************************************************************/
+void ClearSoilBatch(SOILBATCH *Batch)
+{
+  Batch->N = 0;
+}
+
+/*****************************************************************************
+  Function name: AddSoilColumn()
+
+  Purpose      : Add the soil column of a cell to the batch
+
+  Required     :
+    SOILBATCH *Batch     - Batch
+    SOILPIX *LocalSoil   - State of the cell
+    SOILTABLE *SType     - Soil type of the cell
+    VEGTABLE *VType      - Vegetation type of the cell
+    ROADSTRUCT *Network  - Channel and road cut of the cell
+
+  Returns      : void
+
+  Comments     : The columns are numbered in the order they are added,
+                 &(Batch->Column[n]) is only valid until the next call
+*****************************************************************************/
+void AddSoilColumn(SOILBATCH *Batch, SOILPIX *LocalSoil, SOILTABLE *SType,
+		   VEGTABLE *VType, ROADSTRUCT *Network)
+{
+  const char *Routine = "AddSoilColumn";
+  SOILCOLUMN *Column;
+
+  if (Batch->N == Batch->MaxColumns) {
+    Batch->MaxColumns = (Batch->MaxColumns > 0) ? 2 * Batch->MaxColumns :
+      SOIL_BATCH_CELLS;
+    if (!(Batch->Column = (SOILCOLUMN *) realloc(Batch->Column,
+						 Batch->MaxColumns *
+						 sizeof(SOILCOLUMN))) ||
+	!(Batch->Order = (int *) realloc(Batch->Order,
+					 Batch->MaxColumns * sizeof(int))))
+      ReportError((char *) Routine, 1);
+  }
+  LaneSpace(Batch, SType->NLayers);
+
+  Column = &(Batch->Column[Batch->N++]);
+  Column->Soil = LocalSoil;
+  Column->SType = SType;
+  Column->VType = VType;
+  Column->Network = Network;
+  Column->Infiltration = 0.0;
+  Column->RoadbedInfiltration = 0.0;
+  Column->Pending = FALSE;
+}
+
+/*****************************************************************************
+  Function name: DistributeSatflowBatch()
+
+  Purpose      : DistributeSatflow() for all the columns of the batch
+
+  Comments     : Done before MassEnergyBalance() of the cells, which then
+                 leaves it out
+*****************************************************************************/
+void DistributeSatflowBatch(SOILBATCH *Batch)
+{
+  int Lane[SOIL_LANES];
+  int NLanes;
+  int n;
+
+  SortColumns(Batch);
+  for (n = 0, NLanes = 0; n < Batch->N; n++) {
+    if (NLanes == SOIL_LANES || (NLanes > 0 &&
+	Batch->Column[Batch->Order[n]].SType != Batch->Column[Lane[0]].SType)) {
+      DISTRIBUTE(Batch, Lane, NLanes);
+      NLanes = 0;
+    }
+    Lane[NLanes++] = Batch->Order[n];
+  }
+  if (NLanes > 0)
+    DISTRIBUTE(Batch, Lane, NLanes);
+}
+
+/*****************************************************************************
+  Function name: UnsaturatedFlowBatch()
+
+  Purpose      : UnsaturatedFlow() for the columns that MassEnergyBalance()
+                 left for the batch (Pending)
+
+  Required     :
+    SOILBATCH *Batch - Batch
+    int Dt           - Time step (s)
+
+  Comments     : Adds the layers that drained to Soil->CostUnsatLayers, as
+                 MassEnergyBalance() does
+*****************************************************************************/
+void UnsaturatedFlowBatch(SOILBATCH *Batch, int Dt)
+{
+  SOILCOLUMN *Column;
+  int Lane[SOIL_LANES];
+  int NLanes;
+  int n;
+
+  for (n = 0, NLanes = 0; n < Batch->N; n++) {
+    Column = &(Batch->Column[Batch->Order[n]]);
+    if (!Column->Pending)
+      continue;
+    if (NLanes == SOIL_LANES ||
+	(NLanes > 0 && Column->SType != Batch->Column[Lane[0]].SType)) {
+      UNSATURATED(Batch, Lane, NLanes, Dt);
+      NLanes = 0;
+    }
+    Lane[NLanes++] = Batch->Order[n];
+    Column->Pending = FALSE;
+  }
+  if (NLanes > 0)
+    UNSATURATED(Batch, Lane, NLanes, Dt);
+}
+
+/*****************************************************************************
+  Function name: FreeSoilBatch()
+*****************************************************************************/
+void FreeSoilBatch(SOILBATCH *Batch)
+{
+  free(Batch->Column);
+  free(Batch->Order);
+  free(Batch->Lanes);
+  Batch->Column = NULL;
+  Batch->Order = NULL;
+  Batch->Lanes = NULL;
+  Batch->N = 0;
+  Batch->MaxColumns = 0;
+  Batch->MaxLayers = 0;
+}
+
+/*****************************************************************************
+  Function name: SelectSoilKernels()
+
+  Purpose      : Use the lane loops of SIMD Level
+*****************************************************************************/
+void SelectSoilKernels(int Level)
+{
+  DistributeLanes = DistributeLanes_sse2;
+  UnsaturatedLanes = UnsaturatedLanes_sse2;
+  DistributeFixed = DistributeLanes_sse2_fixed;
+  UnsaturatedFixed = UnsaturatedLanes_sse2_fixed;
+#ifdef HAVE_SIMD_DISPATCH
+  if (Level == SIMD_AVX2) {
+    DistributeLanes = DistributeLanes_avx2;
+    UnsaturatedLanes = UnsaturatedLanes_avx2;
+    DistributeFixed = DistributeLanes_avx2_fixed;
+    UnsaturatedFixed = UnsaturatedLanes_avx2_fixed;
+  }
+  else if (Level == SIMD_AVX512) {
+    DistributeLanes = DistributeLanes_avx512;
+    UnsaturatedLanes = UnsaturatedLanes_avx512;
+    DistributeFixed = DistributeLanes_avx512_fixed;
+    UnsaturatedFixed = UnsaturatedLanes_avx512_fixed;
+  }
+#endif
+}
+
+/*****************************************************************************
+  Function name: SortColumns()
+
+  Purpose      : Sort the columns by soil type into Batch->Order, in the
+                 order they were added within a soil type
+
+  Comments     : Insertion sort, the pieces of the pixel loop are short and
+                 neighbouring cells mostly have the same soil
+*****************************************************************************/
+static void SortColumns(SOILBATCH *Batch)
+{
+  int Key;
+  int n;
+  int m;
+
+  for (n = 0; n < Batch->N; n++) {
+    Key = Batch->Column[n].Soil->Soil;
+    for (m = n; m > 0 &&
+	 Batch->Column[Batch->Order[m - 1]].Soil->Soil > Key; m--)
+      Batch->Order[m] = Batch->Order[m - 1];
+    Batch->Order[m] = n;
+  }
+}
+
+/*****************************************************************************
+  Function name: LaneSpace()
+
+  Purpose      : Make room in Batch->Lanes for the layer values of
+                 SOIL_LANES columns with NLayers soil layers
+
+  Comments     : Seven arrays of (NLayers + 1) * SOIL_LANES values, see
+                 DistributeLanes() and UnsaturatedLanes()
+*****************************************************************************/
+static void LaneSpace(SOILBATCH *Batch, int NLayers)
+{
+  const char *Routine = "LaneSpace";
+
+  if (NLayers <= Batch->MaxLayers)
+    return;
+  free(Batch->Lanes);
+  if (!(Batch->Lanes = (float *) calloc(7 * (NLayers + 1) * SOIL_LANES,
+					sizeof(float))))
+    ReportError((char *) Routine, 1);
+  Batch->MaxLayers = NLayers;
+}
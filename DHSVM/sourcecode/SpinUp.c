@@ -0,0 +1,276 @@
+/*
+ * SUMMARY:      SpinUp.c - Spin-up cycles of the model period
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS SPIN UP CYCLES the model period is run again
+ *               and again from the end state of the previous cycle, until
+ *               the water storage of the cells changes by less than SPIN UP
+ *               TOLERANCE over a cycle, or the number of cycles is reached.
+ *               Only the final state is written (see dhsvm_update()).  With
+ *               SPIN UP ACCELERATION the change of the deep layer moisture
+ *               over a cycle is extrapolated where it fills, for the slow
+ *               deep storage
+ * DESCRIP-END.
+ * FUNCTIONS:    InitSpinUp()
+ *               SpinUpCycle()
+ *               FreeSpinUp()
+ *               CellStorage()
+ * COMMENTS:     The storage of a cell is the one of Mass.Balance: the
+ *               interception, snow water equivalent, soil water, saturated
+ *               flow, surface water and detention storage
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "memaccount.h"
+#include "soilmoisture.h"
+
+static float CellStorage(int y, int x, LAYER *Soil, LAYER *Veg,
+			 VEGTABLE *VType, PRECIPPIX **PrecipMap,
+			 SNOWPIX **SnowMap, SOILPIX **SoilMap,
+			 VEGPIX **VegMap, ROADSTRUCT **Network);
+
+/*****************************************************************************
+  Function name: InitSpinUp()
+
+  Purpose      : Keep the storage of the cells at the start of the first
+                 cycle
+
+  Required     :
+    OPTIONSTRUCT *Options  - Options, with SPIN UP CYCLES > 0
+    MAPSIZE *Map           - Information about the basin
+    LAYER *Soil            - Number of soil layers of each soil type
+    LAYER *Veg             - Number of vegetation layers of each class
+    VEGTABLE *VType        - Vegetation classes
+    PRECIPPIX **PrecipMap  - Interception storage
+    SNOWPIX **SnowMap      - Snow pack
+    SOILPIX **SoilMap      - Soil moisture and surface water
+    VEGPIX **VegMap        - Vegetation class of each cell
+    ROADSTRUCT **Network   - Road surface water and cut adjustments
+    SPINUP *Spin           - Spin-up to start
+
+  Returns      : void
+
+  Modifies     : Spin
+*****************************************************************************/
+void InitSpinUp(OPTIONSTRUCT *Options, MAPSIZE *Map, LAYER *Soil, LAYER *Veg,
+		VEGTABLE *VType, PRECIPPIX **PrecipMap, SNOWPIX **SnowMap,
+		SOILPIX **SoilMap, VEGPIX **VegMap, ROADSTRUCT **Network,
+		SPINUP *Spin)
+{
+  const char *Routine = "InitSpinUp";
+  int k;			/* counter */
+  int x;
+  int y;
+
+  Spin->Cycle = 0;
+  Spin->DeepMoist = NULL;
+
+  if (!(Spin->Storage = (float *) TaggedCalloc(Map->NumActive, sizeof(float),
+					       MEM_SOIL)))
+    ReportError((char *) Routine, 1);
+  if (Options->SpinUpAccel > 1.0 &&
+      !(Spin->DeepMoist = (float *) TaggedCalloc(Map->NumActive,
+						 sizeof(float), MEM_SOIL)))
+    ReportError((char *) Routine, 1);
+
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Spin->Storage[k] = CellStorage(y, x, Soil, Veg, VType, PrecipMap, SnowMap,
+				   SoilMap, VegMap, Network);
+    if (Spin->DeepMoist != NULL)
+      Spin->DeepMoist[k] =
+	SoilMap[y][x].Moist[Soil->NLayers[SoilMap[y][x].Soil - 1]];
+  }
+
+  printf("Spinning up the model state with at most %d cycles of the model "
+	 "period, no output is written\n", Options->SpinUpCycles);
+}
+
+/*****************************************************************************
+  Function name: SpinUpCycle()
+
+  Purpose      : Compare the storage of the cells at the end of a cycle with
+                 the storage at its start, and decide whether the spin-up
+                 goes on.  If it does, the deep layer moisture is
+                 extrapolated with SPIN UP ACCELERATION, and the storage at
+                 the start of the next cycle is kept
+
+  Required     :
+    OPTIONSTRUCT *Options  - Options
+    MAPSIZE *Map           - Information about the basin
+    LAYER *Soil            - Number of soil layers of each soil type
+    LAYER *Veg             - Number of vegetation layers of each class
+    SOILTABLE *SType       - Soil types
+    VEGTABLE *VType        - Vegetation classes
+    PRECIPPIX **PrecipMap  - Interception storage
+    SNOWPIX **SnowMap      - Snow pack
+    SOILPIX **SoilMap      - Soil moisture and surface water
+    VEGPIX **VegMap        - Vegetation class of each cell
+    ROADSTRUCT **Network   - Road surface water and cut adjustments
+    WATERBALANCE *Mass     - Mass balance, the water added or removed by
+                             the extrapolation is counted in the storage
+                             at the start of the run
+    SPINUP *Spin           - Spin-up
+
+  Returns      : int, TRUE if the spin-up is done, because the storage
+                 changed by less than SPIN UP TOLERANCE or the last cycle
+                 has been run, FALSE if the next cycle is run
+
+  Modifies     : Spin, the deep layer moisture and water table depth in
+                 SoilMap, Mass
+*****************************************************************************/
+int SpinUpCycle(OPTIONSTRUCT *Options, MAPSIZE *Map, LAYER *Soil, LAYER *Veg,
+		SOILTABLE *SType, VEGTABLE *VType, PRECIPPIX **PrecipMap,
+		SNOWPIX **SnowMap, SOILPIX **SoilMap, VEGPIX **VegMap,
+		ROADSTRUCT **Network, WATERBALANCE *Mass, SPINUP *Spin)
+{
+  double Added;			/* water added by the extrapolation (m) */
+  double Sum;			/* sum of the storage changes (m) */
+  double SumSq;			/* sum of the squared storage changes (m2) */
+  float Change;			/* storage change of a cell (m) */
+  float DeepDepth;		/* depth of the deep layer (m) */
+  float Largest;		/* largest storage change of a cell (m) */
+  float Moist;			/* extrapolated deep layer moisture */
+  float Rms;			/* RMS of the storage changes (m) */
+  float Storage;
+  SOILTABLE *Type;
+  int Done;
+  int NSoil;
+  int i;
+  int k;			/* counter */
+  int x;
+  int y;
+
+  Spin->Cycle++;
+
+  Sum = 0.0;
+  SumSq = 0.0;
+  Largest = 0.0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Storage = CellStorage(y, x, Soil, Veg, VType, PrecipMap, SnowMap,
+			  SoilMap, VegMap, Network);
+    Change = Storage - Spin->Storage[k];
+    Sum += Change;
+    SumSq += (double) Change * Change;
+    if (fabs(Change) > Largest)
+      Largest = fabs(Change);
+    Spin->Storage[k] = Storage;
+  }
+  Rms = sqrt(SumSq / Map->NumActive);
+
+  Done = (Rms <= Options->SpinUpTol || Spin->Cycle >= Options->SpinUpCycles);
+  printf("Spin-up cycle %d: mean storage change %g m, RMS %g m, largest "
+	 "%g m%s\n", Spin->Cycle, Sum / Map->NumActive, Rms, Largest,
+	 (Rms <= Options->SpinUpTol) ? ", converged" : "");
+  if (Done || Spin->DeepMoist == NULL)
+    return Done;
+
+  /* extrapolate the deep layer moisture of the cells where it rose over
+     the cycle, up to the porosity.  A deep layer that drains is left alone,
+     since after an extrapolation it can fall behind the water table of the
+     routing and be asked for more lateral outflow than it holds */
+  Added = 0.0;
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Type = &(SType[SoilMap[y][x].Soil - 1]);
+    NSoil = Soil->NLayers[SoilMap[y][x].Soil - 1];
+    DeepDepth = SoilMap[y][x].Depth;
+    for (i = 0; i < NSoil; i++)
+      DeepDepth -= VType[VegMap[y][x].Veg - 1].RootDepth[i];
+
+    Moist = SoilMap[y][x].Moist[NSoil] +
+      (Options->SpinUpAccel - 1.0) *
+      (SoilMap[y][x].Moist[NSoil] - Spin->DeepMoist[k]);
+    if (Moist > Type->Porosity[NSoil - 1])
+      Moist = MAX(Type->Porosity[NSoil - 1], SoilMap[y][x].Moist[NSoil]);
+    if (Moist < SoilMap[y][x].Moist[NSoil])
+      Moist = SoilMap[y][x].Moist[NSoil];
+
+    Change = (Moist - SoilMap[y][x].Moist[NSoil]) * DeepDepth *
+      Network[y][x].Adjust[NSoil];
+    Added += Change;
+    Spin->Storage[k] += Change;
+    SoilMap[y][x].Moist[NSoil] = Moist;
+    Spin->DeepMoist[k] = Moist;
+
+    SoilMap[y][x].TableDepth =
+      WaterTableDepth(NSoil, SoilMap[y][x].Depth,
+		      VType[VegMap[y][x].Veg - 1].RootDepth, Type->Porosity,
+		      Type->FCap, Network[y][x].Adjust, SoilMap[y][x].Moist,
+		      &(Network[y][x].Capacity));
+    if (SoilMap[y][x].TableDepth < 0.0)
+      SoilMap[y][x].TableDepth = 0.0;
+  }
+
+  /* the storages of the mass balance are basin means */
+  Mass->StartWaterStorage += Added / Map->NumActive;
+  Mass->OldWaterStorage += Added / Map->NumActive;
+
+  return FALSE;
+}
+
+/*****************************************************************************
+  Function name: FreeSpinUp()
+*****************************************************************************/
+void FreeSpinUp(SPINUP *Spin)
+{
+  TaggedFree(Spin->Storage);
+  TaggedFree(Spin->DeepMoist);
+  Spin->Storage = NULL;
+  Spin->DeepMoist = NULL;
+}
+
+/*****************************************************************************
+  Function name: CellStorage()
+
+  Purpose      : Water storage of a cell, as summed in Aggregate() for the
+                 mass balance
+
+  Returns      : float, storage (m)
+*****************************************************************************/
+static float CellStorage(int y, int x, LAYER *Soil, LAYER *Veg,
+			 VEGTABLE *VType, PRECIPPIX **PrecipMap,
+			 SNOWPIX **SnowMap, SOILPIX **SoilMap,
+			 VEGPIX **VegMap, ROADSTRUCT **Network)
+{
+  float DeepDepth;
+  float Storage;
+  int NSoil;
+  int NVeg;
+  int i;
+
+  NVeg = Veg->NLayers[VegMap[y][x].Veg - 1];
+  NSoil = Soil->NLayers[SoilMap[y][x].Soil - 1];
+
+  Storage = 0.0;
+  for (i = 0; i < NVeg; i++)
+    Storage += PrecipMap[y][x].IntRain[i] + PrecipMap[y][x].IntSnow[i];
+  Storage += SnowMap[y][x].Swq;
+
+  DeepDepth = SoilMap[y][x].Depth;
+  for (i = 0; i < NSoil; i++) {
+    Storage += SoilMap[y][x].Moist[i] *
+      VType[VegMap[y][x].Veg - 1].RootDepth[i] * Network[y][x].Adjust[i];
+    DeepDepth -= VType[VegMap[y][x].Veg - 1].RootDepth[i];
+  }
+  Storage += SoilMap[y][x].Moist[NSoil] * DeepDepth *
+    Network[y][x].Adjust[NSoil];
+
+  Storage += SoilMap[y][x].SatFlow + SoilMap[y][x].IExcess +
+    SoilMap[y][x].DetentionStorage + Network[y][x].IExcess;
+
+  return Storage;
+}
@@ -10,6 +10,7 @@
  *               heat between the surface and the atmosphere 
  * DESCRIP-END.
  * FUNCTIONS:    StabilityCorrection()
+ *               StabilityCorrectionDeriv()
  * COMMENTS:
  * $Id: StabilityCorrection.c,v 1.4 2003/07/01 21:26:25 olivier Exp $     
  */
@@ -33,17 +34,19 @@
     float TSurf      - Surface temperature (C)
     float Tair       - Air temperature (C)
     float Wind       - Wind speed (m/s)
-    float Z0         - Roughness length (m)
+    double LogZ      - log((Z - d)/Z0), with Z0 the roughness length (m)
 
   Returns      :
     float Correction - Multiplier for aerodynamic resistance
 
   Modifies     : None
     
-  Comments     :
+  Comments     : The logarithm only depends on the heights and the 
+                 roughness, and is calculated once by the caller rather than
+                 for each iteration of the surface temperature solver
 *****************************************************************************/
 float StabilityCorrection(float Z, float d, float TSurf, float Tair,
-			  float Wind, float Z0)
+			  float Wind, double LogZ)
 {
   float Correction;		/* Correction to aerodynamic resistance */
   float Ri;			/* Richardson's Number */
@@ -63,7 +66,7 @@ float StabilityCorrection(float Z, float d, float TSurf, float Tair,
       (((Tair + 273.15) + (TSurf + 273.15)) / 2.0 * Wind * Wind);
 
     RiLimit = (Tair + 273.15) /
-      (((Tair + 273.15) + (TSurf + 273.15)) / 2.0 * (log((Z - d) / Z0) + 5));
+      (((Tair + 273.15) + (TSurf + 273.15)) / 2.0 * (LogZ + 5));
 
     if (Ri > RiLimit)
       Ri = RiLimit;
@@ -120,3 +123,80 @@ float StabilityCorrection(float Z, float d, float TSurf, float Tair,
 
   /*   return Correction; */
 }
+
+/*****************************************************************************
+  Function name: StabilityCorrectionDeriv()
+
+  Purpose      : Calculate atmospheric stability correction for non-neutral
+                 conditions and its derivative with respect to the surface
+                 temperature
+
+  Required     :
+    float Z            - Reference height (m)
+    float d            - Displacement height (m)
+    float TSurf        - Surface temperature (C)
+    float Tair         - Air temperature (C)
+    float Wind         - Wind speed (m/s)
+    double LogZ        - log((Z - d)/Z0), with Z0 the roughness length (m)
+    float *dCorrection - Derivative of the correction with respect to TSurf
+                         (1/C)
+
+  Returns      :
+    float Correction   - Multiplier for aerodynamic resistance
+
+  Modifies     : *dCorrection
+    
+  Comments     : The correction is the same as the one calculated by 
+                 StabilityCorrection().  Used by the Newton-Raphson surface
+                 temperature solver.
+*****************************************************************************/
+float StabilityCorrectionDeriv(float Z, float d, float TSurf, float Tair,
+			       float Wind, double LogZ, float *dCorrection)
+{
+  float Correction;		/* Correction to aerodynamic resistance */
+  float dRi;			/* Derivative of Ri with respect to TSurf */
+  float Denom;			/* Mean absolute temperature (K) */
+  float Ri;			/* Richardson's Number */
+  float RiCr = 0.2;		/* Critical Richardson's Number */
+  float RiLimit;		/* Upper limit for Richardson's Number */
+
+  Correction = 1.0;
+  *dCorrection = 0.0;
+
+  if (TSurf != Tair) {
+
+    /* Non-neutral conditions */
+
+    Ri = G * (Tair - TSurf) * (Z - d) /
+      (((Tair + 273.15) + (TSurf + 273.15)) / 2.0 * Wind * Wind);
+
+    RiLimit = (Tair + 273.15) /
+      (((Tair + 273.15) + (TSurf + 273.15)) / 2.0 * (LogZ + 5));
+
+    Denom = ((Tair + 273.15) + (TSurf + 273.15)) / 2.0;
+    dRi = G * (Z - d) / (Wind * Wind) *
+      (-Denom - 0.5 * (Tair - TSurf)) / (Denom * Denom);
+
+    if (Ri > RiLimit) {
+      Ri = RiLimit;
+      dRi = -0.5 * RiLimit / Denom;
+    }
+
+    if (Ri > 0.0) {
+      Correction = (1 - Ri / RiCr) * (1 - Ri / RiCr);
+      *dCorrection = -2 * (1 - Ri / RiCr) / RiCr * dRi;
+    }
+
+    else {
+      if (Ri < -0.5) {
+	Ri = -0.5;
+	dRi = 0.0;
+      }
+
+      Correction = sqrt(1 - 16 * Ri);
+      *dCorrection = -8 * dRi / Correction;
+    }
+  }
+
+  return Correction;
+}
@@ -0,0 +1,196 @@
+/*
+ * SUMMARY:      StaticMap.c - Compact storage of the static input maps
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The maps that are read once and do not change during the
+ *               run (sky view factor, wind model maps, precipitation lapse
+ *               rate map) are only kept for the active cells, in
+ *               Map->ActiveCells order.  With OPTIONS STATIC MAP BITS of 8
+ *               or 16 the values are stored as fixed point codes between
+ *               the smallest and the largest value of the map, which are
+ *               decoded when the met of a cell is made
+ * DESCRIP-END.
+ * FUNCTIONS:    InitStaticMap()
+ *               StaticMapValue()
+ *               ExpandStaticMap()
+ *               FreeStaticMap()
+ * COMMENTS:     With 0 bits (the default) the values are kept as floats,
+ *               and the results are the same as with full maps.  The
+ *               largest error of a decoded value is half the code step,
+ *               (largest - smallest) / 2 / (2^bits - 1)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "memaccount.h"
+
+/*****************************************************************************
+  Function name: InitStaticMap()
+
+  Purpose      : Keep the active cells of a map
+
+  Required     :
+    MAPSIZE *Map       - Information about the basin, with the active cells
+    int Bits           - 0 to keep the values, 8 or 16 for fixed point codes
+    float *Array       - Map of NY x NX values (row-major), NULL if all the
+                         cells have the value Fill
+    float Fill         - Value of all the cells if Array is NULL
+    int Tag            - Memory account of the map (MEM_*)
+    STATICMAP *Static  - Map to fill
+
+  Returns      : void
+
+  Modifies     : Static
+*****************************************************************************/
+void InitStaticMap(MAPSIZE *Map, int Bits, float *Array, float Fill, int Tag,
+		   STATICMAP *Static)
+{
+  const char *Routine = "InitStaticMap";
+  float Max;			/* largest value of the active cells */
+  float Min;			/* smallest value of the active cells */
+  float Value;
+  unsigned long Code;
+  unsigned long MaxCode;	/* largest code, 2^Bits - 1 */
+  int k;			/* counter */
+
+  Static->NCells = Map->NumActive;
+  Static->Bits = Bits;
+  Static->Offset = Fill;
+  Static->Scale = 0.0;
+  Static->Value = NULL;
+  Static->Code8 = NULL;
+  Static->Code16 = NULL;
+  Static->Shared = FALSE;
+
+  if (Array == NULL)
+    return;
+
+  if (Bits == 0) {
+    if (!(Static->Value = (float *) TaggedCalloc(Static->NCells,
+						 sizeof(float), Tag)))
+      ReportError((char *)Routine, 1);
+    FirstTouchBlock(Static->Value, Static->NCells, sizeof(float));
+    for (k = 0; k < Static->NCells; k++)
+      Static->Value[k] = Array[Map->ActiveCells[k].y * Map->NX +
+			       Map->ActiveCells[k].x];
+    return;
+  }
+
+  Min = Max = Array[Map->ActiveCells[0].y * Map->NX + Map->ActiveCells[0].x];
+  for (k = 1; k < Static->NCells; k++) {
+    Value = Array[Map->ActiveCells[k].y * Map->NX + Map->ActiveCells[k].x];
+    if (Value < Min)
+      Min = Value;
+    if (Value > Max)
+      Max = Value;
+  }
+  MaxCode = (1UL << Bits) - 1;
+  Static->Offset = Min;
+  Static->Scale = (Max - Min) / MaxCode;
+
+  if (Bits == 8) {
+    if (!(Static->Code8 = (unsigned char *) TaggedCalloc(Static->NCells,
+						 sizeof(unsigned char), Tag)))
+      ReportError((char *)Routine, 1);
+    FirstTouchBlock(Static->Code8, Static->NCells, sizeof(unsigned char));
+  }
+  else {
+    if (!(Static->Code16 = (unsigned short *) TaggedCalloc(Static->NCells,
+						 sizeof(unsigned short), Tag)))
+      ReportError((char *)Routine, 1);
+    FirstTouchBlock(Static->Code16, Static->NCells, sizeof(unsigned short));
+  }
+
+  for (k = 0; k < Static->NCells; k++) {
+    Value = Array[Map->ActiveCells[k].y * Map->NX + Map->ActiveCells[k].x];
+    Code = 0;
+    if (Static->Scale > 0.0)
+      Code = (unsigned long) ((Value - Min) / Static->Scale + 0.5);
+    if (Code > MaxCode)
+      Code = MaxCode;
+    if (Bits == 8)
+      Static->Code8[k] = (unsigned char) Code;
+    else
+      Static->Code16[k] = (unsigned short) Code;
+  }
+}
+
+/*****************************************************************************
+  Function name: StaticMapValue()
+
+  Purpose      : Value of an active cell
+
+  Required     :
+    STATICMAP *Static  - Map
+    int k              - Index of the cell in Map->ActiveCells
+
+  Returns      : float, value of the cell (decoded)
+
+  Modifies     : none
+*****************************************************************************/
+float StaticMapValue(STATICMAP *Static, int k)
+{
+  if (Static->Value != NULL)
+    return Static->Value[k];
+  if (Static->Code8 != NULL)
+    return Static->Offset + Static->Scale * Static->Code8[k];
+  if (Static->Code16 != NULL)
+    return Static->Offset + Static->Scale * Static->Code16[k];
+  return Static->Offset;
+}
+
+/*****************************************************************************
+  Function name: ExpandStaticMap()
+
+  Purpose      : Copy the values of the active cells to a full map, for the
+                 graphics.  The other cells are not changed
+
+  Required     :
+    MAPSIZE *Map       - Information about the basin, with the active cells
+    STATICMAP *Static  - Map
+    float **Grid       - NY x NX map
+
+  Returns      : void
+
+  Modifies     : Grid
+*****************************************************************************/
+void ExpandStaticMap(MAPSIZE *Map, STATICMAP *Static, float **Grid)
+{
+  int k;			/* counter */
+
+  for (k = 0; k < Static->NCells; k++)
+    Grid[Map->ActiveCells[k].y][Map->ActiveCells[k].x] =
+      StaticMapValue(Static, k);
+}
+
+/*****************************************************************************
+  Function name: FreeStaticMap()
+
+  Purpose      : Free the storage of a map, unless it is in the STATIC DATA
+                 SHARE
+
+  Required     :
+    STATICMAP *Static  - Map
+
+  Returns      : void
+
+  Modifies     : Static
+*****************************************************************************/
+void FreeStaticMap(STATICMAP *Static)
+{
+  if (!Static->Shared) {
+    TaggedFree(Static->Value);
+    TaggedFree(Static->Code8);
+    TaggedFree(Static->Code16);
+  }
+  Static->Value = NULL;
+  Static->Code8 = NULL;
+  Static->Code16 = NULL;
+}
@@ -0,0 +1,705 @@
+/*
+ * SUMMARY:      StaticShare.c - Static maps shared by the runs on a node
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  With OPTIONS STATIC DATA SHARE the read-only data that the
+ *               runs of one basin all load the same way are kept in one
+ *               segment file, best in /dev/shm, that every run maps
+ *               read-only, so that a node holds them once however many
+ *               calibration runs it has.  These are the shadow maps of the
+ *               twelve months, the sky view, wind model and precipitation
+ *               lapse maps, and the station weights of the interpolation.
+ *               The first run that finds no valid segment builds it while
+ *               the others wait for it, the others map it without copying
+ *               after checking its hash
+ * DESCRIP-END.
+ * FUNCTIONS:    InitStaticShare()
+ *               PublishStaticShare()
+ *               SharedStaticMap()
+ *               SharedShadowMaps()
+ *               SharedWeights()
+ *               CloseStaticShare()
+ *               ShareKey()
+ *               ShareFile()
+ *               AttachShare()
+ *               FindShare()
+ *               AddShare()
+ *               PointWeights()
+ * COMMENTS:     The segment is only valid for the inputs it was built from:
+ *               its key hashes the basin geometry, the options the data
+ *               depend on, the station locations, and the name, size and
+ *               modification time of the input files.  A run with other
+ *               inputs builds a new segment in its place, the runs that
+ *               have the old one mapped keep it until they end.  The shadow
+ *               maps of a month are kept for the time steps that are in
+ *               daylight in that month in a leap year or another year, so
+ *               that they hold the steps of the month of any run.  The
+ *               segment is in native byte order, and the topography and the
+ *               channel grid, which the model changes, are not in it
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "constants.h"
+#include "fileio.h"
+#include "memaccount.h"
+
+#ifdef HAVE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* start of the segment */
+typedef struct {
+  char Magic[sizeof(STATIC_SHARE_MAGIC) - 1];
+  int Version;
+  unint Key;			/* hash of the inputs, see ShareKey() */
+  unint DataSum;		/* hash of the table and the data */
+  int NEntries;
+  size_t Size;			/* bytes of the segment */
+} SHAREHEADER;
+
+/* one array of the segment */
+typedef struct {
+  int Id;			/* SHAREID */
+  int Bits;			/* STATICMAP Bits, Offset and Scale of a map */
+  float Offset;
+  float Scale;
+  size_t Start;			/* offset of the data in the segment */
+  size_t Bytes;			/* bytes of the data */
+} SHAREENTRY;
+
+/* an array that is put in the segment */
+typedef struct {
+  SHAREENTRY Entry;
+  const void *Data;		/* NULL for the shadow maps, which are read
+				   from the shadow file of Month */
+  int Month;
+  int *Slice;			/* slices of the steps of Month */
+} SHARESOURCE;
+
+static char ShareName[BUFSIZE + 1] = "";
+static char *ShareData = NULL;	/* the mapped segment */
+static size_t ShareSize = 0;
+static SHAREENTRY *ShareEntry = NULL;
+static int ShareEntries = 0;
+static int ShareLock = -1;	/* lock file, open while the segment is built */
+static unint ShareInputs = 0;	/* key of the inputs of this run */
+
+static unint ShareKey(OPTIONSTRUCT *Options, MAPSIZE *Map, TIMESTRUCT *Time,
+		      SOLARGEOMETRY *SolarGeo, INPUTFILES *InFiles, int NStats,
+		      METLOCATION *Stat);
+static unint ShareFile(unint Sum, char *FileName);
+static int AttachShare(void);
+static SHAREENTRY *FindShare(int Id);
+static int AddShare(SHARESOURCE *Source, int N, int Id, const void *Data,
+		    size_t Bytes, STATICMAP *Static);
+static void PointWeights(MAPSIZE *Map, METWEIGHT **MetWeights);
+
+/*****************************************************************************
+  Function name: InitStaticShare()
+
+  Purpose      : Map the segment of the STATIC DATA SHARE if it holds the
+                 data of the inputs of this run, or else take the lock to
+                 build it
+
+  Required     :
+    OPTIONSTRUCT *Options    - Options, Options->StaticShare is the segment
+    MAPSIZE *Map             - Information about the basin
+    TIMESTRUCT *Time         - Model time step
+    SOLARGEOMETRY *SolarGeo  - Location of the basin
+    INPUTFILES *InFiles      - Wind and precipitation lapse map files
+    int NStats               - Number of met stations
+    METLOCATION *Stat        - Met stations
+
+  Returns      : void
+
+  Comments     : The lock stays taken until PublishStaticShare() has
+                 written the segment, so the runs that start at the same
+                 time wait for the first one and then map its segment
+*****************************************************************************/
+void InitStaticShare(OPTIONSTRUCT *Options, MAPSIZE *Map, TIMESTRUCT *Time,
+		     SOLARGEOMETRY *SolarGeo, INPUTFILES *InFiles, int NStats,
+		     METLOCATION *Stat)
+{
+#ifdef HAVE_MMAP
+  char LockName[BUFSIZE + 1];
+
+  if (IsEmptyStr(Options->StaticShare))
+    return;
+
+  strcpy(ShareName, Options->StaticShare);
+  ShareInputs = ShareKey(Options, Map, Time, SolarGeo, InFiles, NStats, Stat);
+  if (AttachShare())
+    return;
+
+  /* another run may have built it while we waited for the lock */
+  snprintf(LockName, BUFSIZE + 1, "%s.lock", ShareName);
+  if ((ShareLock = open(LockName, O_RDWR | O_CREAT, 0666)) < 0)
+    ReportError(LockName, 3);
+  if (flock(ShareLock, LOCK_EX) != 0)
+    ReportError(LockName, 3);
+  if (AttachShare()) {
+    close(ShareLock);
+    ShareLock = -1;
+    return;
+  }
+  printf("Building the static data share %s\n", ShareName);
+#endif
+}
+
+/*****************************************************************************
+  Function name: PublishStaticShare()
+
+  Purpose      : Write the segment of the STATIC DATA SHARE if this run has
+                 the lock to build it, map it, and replace the maps and
+                 weights this run has read by the ones in the segment
+
+  Required     :
+    OPTIONSTRUCT *Options     - Options
+    MAPSIZE *Map              - Information about the basin
+    TIMESTRUCT *Time          - Model time step
+    SOLARGEOMETRY *SolarGeo   - Location of the basin
+    STATICMAP *SkyViewMap     - Sky view map
+    STATICMAP *WindModel      - NWINDMAPS wind model maps, NULL if none
+    STATICMAP *PrecipLapseMap - Precipitation lapse rate map
+    METWEIGHT **MetWeights    - Interpolation weights, NULL if none
+
+  Returns      : void
+
+  Modifies     : the maps and the weights, which point into the segment
+
+  Comments     : Called after the maps and weights are made and before the
+                 shadow maps of the first month are read.  The maps that
+                 have not been read (NCells is 0) are not shared
+*****************************************************************************/
+void PublishStaticShare(OPTIONSTRUCT *Options, MAPSIZE *Map, TIMESTRUCT *Time,
+			SOLARGEOMETRY *SolarGeo, STATICMAP *SkyViewMap,
+			STATICMAP *WindModel, STATICMAP *PrecipLapseMap,
+			METWEIGHT **MetWeights)
+{
+#ifdef HAVE_MMAP
+  const char *Routine = "PublishStaticShare";
+  FILE *OutFile;
+  SHAREHEADER Header;
+  SHARESOURCE *Source;
+  struct stat FileInfo;
+  char FileName[MAXSTRING + 1];
+  char TempName[BUFSIZE + 1];
+  char *Data;
+  size_t NCells = (size_t) Map->NY * Map->NX;
+  size_t Start;
+  size_t NTotal;
+  int *NWeights = NULL;
+  int *Slices;
+  int Month;
+  int N;
+  int n;
+  int y;
+  int x;
+
+  if (ShareLock < 0)
+    return;
+
+  if (!(Source = (SHARESOURCE *) calloc(share_wind + NWINDMAPS + 1,
+					sizeof(SHARESOURCE))) ||
+      !(Slices = (int *) calloc(12 * Time->NDaySteps, sizeof(int))))
+    ReportError((char *) Routine, 1);
+
+  N = 0;
+  if (SkyViewMap->NCells == Map->NumActive)
+    N = AddShare(Source, N, share_skyview, NULL, 0, SkyViewMap);
+  if (PrecipLapseMap->NCells == Map->NumActive)
+    N = AddShare(Source, N, share_preciplapse, NULL, 0, PrecipLapseMap);
+  for (n = 0; WindModel != NULL && n < NWINDMAPS; n++)
+    N = AddShare(Source, N, share_wind + n, NULL, 0, &(WindModel[n]));
+
+  /* the weights of the cells follow each other in the blocks that
+     CalcWeights() made */
+  if (MetWeights != NULL && MetWeights[0][0].Stat != NULL) {
+    if (!(NWeights = (int *) calloc(NCells, sizeof(int))))
+      ReportError((char *) Routine, 1);
+    for (y = 0, NTotal = 0; y < Map->NY; y++)
+      for (x = 0; x < Map->NX; x++) {
+	NWeights[y * Map->NX + x] = MetWeights[y][x].NWeights;
+	NTotal += MetWeights[y][x].NWeights;
+      }
+    N = AddShare(Source, N, share_nweights, NWeights, NCells * sizeof(int),
+		 NULL);
+    N = AddShare(Source, N, share_metstat, MetWeights[0][0].Stat,
+		 NTotal * sizeof(int), NULL);
+    N = AddShare(Source, N, share_metweight, MetWeights[0][0].Weight,
+		 NTotal * sizeof(float), NULL);
+  }
+
+  /* the daylight steps of each month in a leap year and in another year */
+  for (Month = 1; Options->Shading && Options->ShadingMode == SHADING_MAPS &&
+	 Month <= 12; Month++) {
+    sprintf(FileName, "%s.%02d.%s", Options->ShadingDataPath, Month,
+	    Options->ShadingDataExt);
+    if (stat(FileName, &FileInfo) != 0)
+      continue;
+    Source[N].Slice = Slices + (Month - 1) * Time->NDaySteps;
+    for (n = 0; n < Time->NDaySteps; n++)
+      Source[N].Slice[n] = -1;
+    DaylightSteps(2000, Month, Time->Dt, SolarGeo, Time->NDaySteps,
+		  Source[N].Slice);
+    DaylightSteps(2001, Month, Time->Dt, SolarGeo, Time->NDaySteps,
+		  Source[N].Slice);
+    for (n = 0, x = 0; n < Time->NDaySteps; n++)
+      if (Source[N].Slice[n] == 0)
+	Source[N].Slice[n] = x++;
+    N = AddShare(Source, N, share_slices + Month - 1, Source[N].Slice,
+		 Time->NDaySteps * sizeof(int), NULL);
+    Source[N].Month = Month;
+    N = AddShare(Source, N, share_shadow + Month - 1, NULL, x * NCells, NULL);
+  }
+
+  /* the table and the data, each at a multiple of STATIC_SHARE_ALIGN */
+  Start = sizeof(SHAREHEADER) + N * sizeof(SHAREENTRY);
+  for (n = 0; n < N; n++) {
+    Start += (STATIC_SHARE_ALIGN - Start % STATIC_SHARE_ALIGN) %
+      STATIC_SHARE_ALIGN;
+    Source[n].Entry.Start = Start;
+    Start += Source[n].Entry.Bytes;
+  }
+  Start += (STATIC_SHARE_ALIGN - Start % STATIC_SHARE_ALIGN) %
+    STATIC_SHARE_ALIGN;
+
+  if (!(Data = (char *) calloc(Start, 1)))
+    ReportError((char *) Routine, 1);
+  memset(&Header, 0, sizeof(SHAREHEADER));
+  memcpy(Header.Magic, STATIC_SHARE_MAGIC, sizeof(Header.Magic));
+  Header.Version = STATIC_SHARE_VERSION;
+  Header.Key = ShareInputs;
+  Header.NEntries = N;
+  Header.Size = Start;
+  for (n = 0; n < N; n++) {
+    memcpy(Data + sizeof(SHAREHEADER) + n * sizeof(SHAREENTRY),
+	   &(Source[n].Entry), sizeof(SHAREENTRY));
+    if (Source[n].Data != NULL)
+      memcpy(Data + Source[n].Entry.Start, Source[n].Data,
+	     Source[n].Entry.Bytes);
+    else if (Source[n].Month > 0) {
+      sprintf(FileName, "%s.%02d.%s", Options->ShadingDataPath,
+	      Source[n].Month, Options->ShadingDataExt);
+      ReadShadowSlices(FileName, Map, Time->NDaySteps, Source[n - 1].Slice,
+		       (unsigned char *) (Data + Source[n].Entry.Start));
+    }
+  }
+  Header.DataSum = CheckpointSum(CHECKPOINT_SEED,
+				 (unint *) (Data + sizeof(SHAREHEADER)),
+				 (Start - sizeof(SHAREHEADER)) / sizeof(unint));
+  memcpy(Data, &Header, sizeof(SHAREHEADER));
+
+  /* the runs that map the segment never see it half written */
+  snprintf(TempName, BUFSIZE + 1, "%s.%ld", ShareName, (long) getpid());
+  OpenFile(&OutFile, TempName, "wb", TRUE);
+  if (fwrite(Data, 1, Start, OutFile) != Start || fclose(OutFile) != 0)
+    ReportError(TempName, 72);
+  if (rename(TempName, ShareName) != 0)
+    ReportError(ShareName, 72);
+  free(Data);
+  free(NWeights);
+  free(Slices);
+  free(Source);
+
+  close(ShareLock);
+  ShareLock = -1;
+  if (!AttachShare())
+    ReportError(ShareName, 76);
+
+  /* use the segment rather than the copies of this run */
+  if (SkyViewMap->NCells == Map->NumActive) {
+    FreeStaticMap(SkyViewMap);
+    SharedStaticMap(share_skyview, Map, SkyViewMap);
+  }
+  if (PrecipLapseMap->NCells == Map->NumActive) {
+    FreeStaticMap(PrecipLapseMap);
+    SharedStaticMap(share_preciplapse, Map, PrecipLapseMap);
+  }
+  for (n = 0; WindModel != NULL && n < NWINDMAPS; n++) {
+    FreeStaticMap(&(WindModel[n]));
+    SharedStaticMap(share_wind + n, Map, &(WindModel[n]));
+  }
+  if (FindShare(share_metstat) != NULL) {
+    TaggedFree(MetWeights[0][0].Stat);
+    TaggedFree(MetWeights[0][0].Weight);
+    PointWeights(Map, MetWeights);
+  }
+#endif
+}
+
+/*****************************************************************************
+  Function name: SharedStaticMap()
+
+  Purpose      : Take a static map from the STATIC DATA SHARE
+
+  Required     :
+    int Id             - SHAREID of the map
+    MAPSIZE *Map       - Information about the basin
+    STATICMAP *Static  - Map to fill
+
+  Returns      : int, TRUE if the map is in the segment, FALSE if it has to
+                 be read
+
+  Modifies     : Static, its values are in the segment (Static->Shared)
+*****************************************************************************/
+int SharedStaticMap(int Id, MAPSIZE *Map, STATICMAP *Static)
+{
+  SHAREENTRY *Entry;
+  void *Values;
+
+  if ((Entry = FindShare(Id)) == NULL)
+    return FALSE;
+
+  Values = (Entry->Bytes > 0) ? (void *) (ShareData + Entry->Start) : NULL;
+  Static->NCells = Map->NumActive;
+  Static->Bits = Entry->Bits;
+  Static->Offset = Entry->Offset;
+  Static->Scale = Entry->Scale;
+  Static->Value = (Entry->Bits == 0) ? (float *) Values : NULL;
+  Static->Code8 = (Entry->Bits == 8) ? (unsigned char *) Values : NULL;
+  Static->Code16 = (Entry->Bits == 16) ? (unsigned short *) Values : NULL;
+  Static->Shared = TRUE;
+  return TRUE;
+}
+
+/*****************************************************************************
+  Function name: SharedShadowMaps()
+
+  Purpose      : Find the shadow maps of a month in the STATIC DATA SHARE
+
+  Required     :
+    int Month             - Month
+    int NDaySteps         - Number of time steps in a day
+    int **Slice           - Slice of each step of the day in Block, -1 if
+                            the step is not in the segment
+    unsigned char **Block - Shadow maps of the slices, [slice][NY][NX]
+
+  Returns      : int, TRUE if the month is in the segment
+*****************************************************************************/
+int SharedShadowMaps(int Month, int NDaySteps, int **Slice,
+		     unsigned char **Block)
+{
+  SHAREENTRY *Entry;
+
+  if ((Entry = FindShare(share_slices + Month - 1)) == NULL ||
+      Entry->Bytes != NDaySteps * sizeof(int))
+    return FALSE;
+  *Slice = (int *) (ShareData + Entry->Start);
+  if ((Entry = FindShare(share_shadow + Month - 1)) == NULL)
+    return FALSE;
+  *Block = (unsigned char *) (ShareData + Entry->Start);
+  return TRUE;
+}
+
+/*****************************************************************************
+  Function name: SharedWeights()
+
+  Purpose      : Take the interpolation weights from the STATIC DATA SHARE
+
+  Required     :
+    MAPSIZE *Map              - Information about the basin
+    METWEIGHT ***MetWeights   - Interpolation weights to make
+
+  Returns      : int, TRUE if the weights are in the segment, FALSE if they
+                 have to be calculated
+
+  Modifies     : MetWeights, the stations and weights are in the segment,
+                 the lapse terms and precipitation factors, which the model
+                 fills in, are not
+
+  Comments     : Called from the weights task of the initialization, while
+                 the segment is only read
+*****************************************************************************/
+int SharedWeights(MAPSIZE *Map, METWEIGHT ***MetWeights)
+{
+  const char *Routine = "SharedWeights";
+  SHAREENTRY *Entry;
+  float *OffsetBlock;
+  float *FactorBlock;
+  size_t NTotal;
+  int y;
+  int x;
+
+  if ((Entry = FindShare(share_metweight)) == NULL)
+    return FALSE;
+  NTotal = Entry->Bytes / sizeof(float);
+
+  if (!((*MetWeights) = (METWEIGHT **) TaggedCalloc(Map->NY,
+						    sizeof(METWEIGHT *),
+						    MEM_MET)))
+    ReportError((char *) Routine, 1);
+  for (y = 0; y < Map->NY; y++)
+    if (!((*MetWeights)[y] = (METWEIGHT *) TaggedCalloc(Map->NX,
+							sizeof(METWEIGHT),
+							MEM_MET)))
+      ReportError((char *) Routine, 1);
+  if (!(OffsetBlock = (float *) TaggedCalloc(NTotal > 0 ? NTotal : 1,
+					     sizeof(float), MEM_MET)) ||
+      !(FactorBlock = (float *) TaggedCalloc(NTotal > 0 ? NTotal : 1,
+					     sizeof(float), MEM_MET)))
+    ReportError((char *) Routine, 1);
+
+  PointWeights(Map, *MetWeights);
+  for (y = 0, NTotal = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++) {
+      (*MetWeights)[y][x].TOffset = OffsetBlock + NTotal;
+      (*MetWeights)[y][x].PFactor = FactorBlock + NTotal;
+      NTotal += (*MetWeights)[y][x].NWeights;
+    }
+  return TRUE;
+}
+
+/*****************************************************************************
+  Function name: CloseStaticShare()
+
+  Purpose      : Unmap the segment at the end of the run
+*****************************************************************************/
+void CloseStaticShare(void)
+{
+#ifdef HAVE_MMAP
+  if (ShareData != NULL)
+    munmap(ShareData, ShareSize);
+  if (ShareLock >= 0)
+    close(ShareLock);
+#endif
+  ShareData = NULL;
+  ShareSize = 0;
+  ShareEntry = NULL;
+  ShareEntries = 0;
+  ShareLock = -1;
+}
+
+#ifdef HAVE_MMAP
+/*****************************************************************************
+  Function name: ShareKey()
+
+  Purpose      : Hash of everything the data of the segment depend on
+
+  Returns      : unint, key
+*****************************************************************************/
+static unint ShareKey(OPTIONSTRUCT *Options, MAPSIZE *Map, TIMESTRUCT *Time,
+		      SOLARGEOMETRY *SolarGeo, INPUTFILES *InFiles, int NStats,
+		      METLOCATION *Stat)
+{
+  char FileName[MAXSTRING + 1];
+  float Floats[5];
+  unint Words[14];
+  unint Sum;
+  int i;
+
+  Words[0] = STATIC_SHARE_VERSION;
+  Words[1] = CheckpointGeometry(Map);
+  Words[2] = (unint) Options->StaticMapBits;
+  Words[3] = (unint) Time->NDaySteps;
+  Words[4] = (unint) Time->Dt;
+  Words[5] = (unint) Options->MM5;
+  Words[6] = (unint) (Options->Shading ? Options->ShadingMode : FALSE);
+  Words[7] = (unint) Options->WindSource;
+  Words[8] = (unint) Options->PrecipLapse;
+  Words[9] = (unint) Options->Interpolation;
+  Words[10] = (unint) Options->CressRadius;
+  Words[11] = (unint) Options->CressStations;
+  Words[12] = (unint) Options->MaxInterpStations;
+  Words[13] = (unint) NWINDMAPS;
+  Sum = CheckpointSum(CHECKPOINT_SEED, Words, 14);
+  Floats[0] = Map->Xorig;
+  Floats[1] = Map->Yorig;
+  Floats[2] = Map->DX;
+  Floats[3] = SolarGeo->Latitude;
+  Floats[4] = SolarGeo->Longitude;
+  Sum = CheckpointSum(Sum, (unint *) Floats, 5);
+  Floats[0] = SolarGeo->StandardMeridian;
+  Sum = CheckpointSum(Sum, (unint *) Floats, 1);
+
+  Words[0] = (unint) NStats;
+  Sum = CheckpointSum(Sum, Words, 1);
+  for (i = 0; i < NStats; i++) {
+    Words[0] = (unint) Stat[i].Loc.N;
+    Words[1] = (unint) Stat[i].Loc.E;
+    Sum = CheckpointSum(Sum, Words, 2);
+  }
+
+  Sum = ShareFile(Sum, Options->SkyViewDataPath);
+  Sum = ShareFile(Sum, InFiles->PrecipLapseFile);
+  for (i = 1; i <= 12; i++) {
+    sprintf(FileName, "%s.%02d.%s", Options->ShadingDataPath, i,
+	    Options->ShadingDataExt);
+    Sum = ShareFile(Sum, FileName);
+  }
+  for (i = 0; i < NWINDMAPS; i++) {
+    sprintf(FileName, "%s%02d%s", InFiles->WindMapPath, i + 1, fileext);
+    Sum = ShareFile(Sum, FileName);
+  }
+  return Sum;
+}
+
+/*****************************************************************************
+  Function name: ShareFile()
+
+  Purpose      : Add the name, size and modification time of an input file
+                 to the key, a file that does not exist only adds its name
+*****************************************************************************/
+static unint ShareFile(unint Sum, char *FileName)
+{
+  struct stat FileInfo;
+  unint Words[3];
+  size_t i;
+
+  for (i = 0; FileName[i] != '\0'; i++) {
+    Words[0] = (unint) (unsigned char) FileName[i];
+    Sum = CheckpointSum(Sum, Words, 1);
+  }
+  if (stat(FileName, &FileInfo) == 0) {
+    Words[0] = (unint) FileInfo.st_size;
+    Words[1] = (unint) ((long long) FileInfo.st_size >> 32);
+    Words[2] = (unint) FileInfo.st_mtime;
+    Sum = CheckpointSum(Sum, Words, 3);
+  }
+  return Sum;
+}
+
+/*****************************************************************************
+  Function name: AttachShare()
+
+  Purpose      : Map the segment, if it is there and holds the data of the
+                 inputs of this run
+
+  Returns      : int, TRUE if it is mapped
+
+  Comments     : The hash of the data is checked once, reading it only
+                 brings the pages of the segment in, they are not copied
+*****************************************************************************/
+static int AttachShare(void)
+{
+  SHAREHEADER Header;
+  struct stat FileInfo;
+  void *Data;
+  int fd;
+
+  if ((fd = open(ShareName, O_RDONLY)) < 0)
+    return FALSE;
+  if (fstat(fd, &FileInfo) != 0 ||
+      (size_t) FileInfo.st_size < sizeof(SHAREHEADER) ||
+      (Data = mmap(NULL, (size_t) FileInfo.st_size, PROT_READ, MAP_SHARED,
+		   fd, 0)) == MAP_FAILED) {
+    close(fd);
+    return FALSE;
+  }
+  close(fd);
+
+  memcpy(&Header, Data, sizeof(SHAREHEADER));
+  if (strncmp(Header.Magic, STATIC_SHARE_MAGIC, sizeof(Header.Magic)) != 0 ||
+      Header.Version != STATIC_SHARE_VERSION ||
+      Header.Size != (size_t) FileInfo.st_size || Header.NEntries < 0 ||
+      Header.Key != ShareInputs ||
+      Header.DataSum !=
+      CheckpointSum(CHECKPOINT_SEED,
+		    (unint *) ((char *) Data + sizeof(SHAREHEADER)),
+		    (Header.Size - sizeof(SHAREHEADER)) / sizeof(unint))) {
+    if (Header.Key != ShareInputs && ShareLock >= 0)
+      printf("The static data share %s was built from other inputs\n",
+	     ShareName);
+    munmap(Data, (size_t) FileInfo.st_size);
+    return FALSE;
+  }
+
+  ShareData = (char *) Data;
+  ShareSize = Header.Size;
+  ShareEntry = (SHAREENTRY *) (ShareData + sizeof(SHAREHEADER));
+  ShareEntries = Header.NEntries;
+  printf("Using the static data share %s (%lu bytes)\n", ShareName,
+	 (unsigned long) ShareSize);
+  return TRUE;
+}
+#endif
+
+/*****************************************************************************
+  Function name: FindShare()
+
+  Returns      : SHAREENTRY *, entry Id of the mapped segment, NULL if there
+                 is none
+*****************************************************************************/
+static SHAREENTRY *FindShare(int Id)
+{
+  int n;
+
+  for (n = 0; ShareData != NULL && n < ShareEntries; n++)
+    if (ShareEntry[n].Id == Id)
+      return &(ShareEntry[n]);
+  return NULL;
+}
+
+/*****************************************************************************
+  Function name: AddShare()
+
+  Purpose      : Add an array to the segment that is built, Data with Bytes
+                 bytes, or the values of Static
+
+  Returns      : int, number of arrays
+*****************************************************************************/
+static int AddShare(SHARESOURCE *Source, int N, int Id, const void *Data,
+		    size_t Bytes, STATICMAP *Static)
+{
+  Source[N].Entry.Id = Id;
+  Source[N].Data = Data;
+  Source[N].Entry.Bytes = Bytes;
+  if (Static != NULL) {
+    Source[N].Entry.Bits = Static->Bits;
+    Source[N].Entry.Offset = Static->Offset;
+    Source[N].Entry.Scale = Static->Scale;
+    if (Static->Value != NULL) {
+      Source[N].Data = Static->Value;
+      Source[N].Entry.Bytes = Static->NCells * sizeof(float);
+    }
+    else if (Static->Code8 != NULL) {
+      Source[N].Data = Static->Code8;
+      Source[N].Entry.Bytes = Static->NCells * sizeof(unsigned char);
+    }
+    else if (Static->Code16 != NULL) {
+      Source[N].Data = Static->Code16;
+      Source[N].Entry.Bytes = Static->NCells * sizeof(unsigned short);
+    }
+  }
+  return N + 1;
+}
+
+/*****************************************************************************
+  Function name: PointWeights()
+
+  Purpose      : Point the stations and weights of the cells into the
+                 segment
+*****************************************************************************/
+static void PointWeights(MAPSIZE *Map, METWEIGHT **MetWeights)
+{
+  int *NWeights;
+  int *StatBlock;
+  float *WeightBlock;
+  size_t NTotal;
+  int y;
+  int x;
+
+  NWeights = (int *) (ShareData + FindShare(share_nweights)->Start);
+  StatBlock = (int *) (ShareData + FindShare(share_metstat)->Start);
+  WeightBlock = (float *) (ShareData + FindShare(share_metweight)->Start);
+  for (y = 0, NTotal = 0; y < Map->NY; y++)
+    for (x = 0; x < Map->NX; x++) {
+      MetWeights[y][x].NWeights = NWeights[y * Map->NX + x];
+      MetWeights[y][x].Stat = StatBlock + NTotal;
+      MetWeights[y][x].Weight = WeightBlock + NTotal;
+      NTotal += MetWeights[y][x].NWeights;
+    }
+}
@@ -0,0 +1,362 @@
+/*
+ * SUMMARY:      StationIndex.c - Spatial index of the met station locations
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  A k-d tree over the locations of the met stations, with
+ *               k-nearest and radius queries, and a hash of the locations,
+ *               so that CalcWeights() does not have to look at every
+ *               station for every pixel
+ * DESCRIP-END.
+ * FUNCTIONS:    InitStationIndex()
+ *               NearestStations()
+ *               StationsWithin()
+ *               StationAt()
+ *               FreeStationIndex()
+ * COMMENTS:     The distances are compared as squared distances in grid
+ *               cells.  The locations are integers, so these are exact, and
+ *               stations at the same distance are ordered by their index,
+ *               which is the order of the linear scans that the queries
+ *               replace.  The index is only read by the queries, so it can
+ *               be used by several threads at the same time
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+
+#define STATION_LEAF 8		/* most stations in a leaf of the tree */
+
+static METLOCATION *SortStation;	/* stations sorted by CompareStations() */
+static int SortDim;			/* 0 to sort by northing, 1 by easting */
+
+static int CompareStations(const void *A, const void *B);
+static int BuildNode(STATIONINDEX *Index, int First, int Last);
+static unsigned int HashLocation(COORD *Loc);
+static double StationDist2(METLOCATION *Station, COORD *Loc);
+static double BoxDist2(STATIONNODE *Node, COORD *Loc);
+static void NearestInNode(STATIONINDEX *Index, int n, COORD *Loc, int K,
+			  int *NFound, int *Id, double *D2);
+static void WithinNode(STATIONINDEX *Index, int n, COORD *Loc, double MaxD2,
+		       int *NFound, int *Id);
+
+/*****************************************************************************
+  Function name: InitStationIndex()
+
+  Purpose      : Build the k-d tree and the location hash of the stations
+
+  Required     :
+    METLOCATION *Station - Met stations
+    int NStats           - Number of met stations
+
+  Returns      : void
+
+  Modifies     : STATIONINDEX *Index
+
+  Comments     : Each node is split at the median of the wider side of its
+                 bounding box
+*****************************************************************************/
+void InitStationIndex(METLOCATION *Station, int NStats, STATIONINDEX *Index)
+{
+  const char *Routine = "InitStationIndex";
+  unsigned int h;
+  int i;
+
+  Index->Station = Station;
+  Index->NStats = NStats;
+  Index->NNodes = 0;
+  if (!(Index->Order = (int *) malloc((NStats + 1) * sizeof(int))) ||
+      !(Index->Node = (STATIONNODE *) malloc((2 * NStats + 1) *
+					     sizeof(STATIONNODE))))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < NStats; i++)
+    Index->Order[i] = i;
+  if (NStats > 0)
+    BuildNode(Index, 0, NStats);
+
+  for (Index->NSlots = 1; Index->NSlots < 2 * NStats; Index->NSlots *= 2)
+    ;
+  if (!(Index->Slot = (int *) malloc(Index->NSlots * sizeof(int))))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < Index->NSlots; i++)
+    Index->Slot[i] = -1;
+  for (i = 0; i < NStats; i++) {
+    h = HashLocation(&(Station[i].Loc)) & (Index->NSlots - 1);
+    while (Index->Slot[h] >= 0 &&
+	   (Station[Index->Slot[h]].Loc.N != Station[i].Loc.N ||
+	    Station[Index->Slot[h]].Loc.E != Station[i].Loc.E))
+      h = (h + 1) & (Index->NSlots - 1);
+    if (Index->Slot[h] < 0)
+      Index->Slot[h] = i;
+  }
+}
+
+/*****************************************************************************
+  Function name: NearestStations()
+
+  Purpose      : Find the K stations nearest to a location
+
+  Required     :
+    STATIONINDEX *Index - Stations
+    COORD *Loc          - Location
+    int K               - Number of stations to find
+
+  Returns      : int - number of stations found, K or Index->NStats if that
+                       is smaller
+
+  Modifies     : int *Id and double *D2 - the stations and their squared
+                 distances, nearest first, the lowest index first at the
+                 same distance
+*****************************************************************************/
+int NearestStations(STATIONINDEX *Index, COORD *Loc, int K, int *Id,
+		    double *D2)
+{
+  int NFound = 0;
+
+  if (Index->NNodes > 0 && K > 0)
+    NearestInNode(Index, 0, Loc, K, &NFound, Id, D2);
+  return NFound;
+}
+
+/*****************************************************************************
+  Function name: StationsWithin()
+
+  Purpose      : Find the stations within a squared distance of a location
+
+  Required     :
+    STATIONINDEX *Index - Stations
+    COORD *Loc          - Location
+    double MaxD2        - Squared distance, the stations at this distance
+                          are included
+
+  Returns      : int - number of stations found
+
+  Modifies     : int *Id - the stations, in no particular order.  Id needs
+                 room for Index->NStats stations
+*****************************************************************************/
+int StationsWithin(STATIONINDEX *Index, COORD *Loc, double MaxD2, int *Id)
+{
+  int NFound = 0;
+
+  if (Index->NNodes > 0)
+    WithinNode(Index, 0, Loc, MaxD2, &NFound, Id);
+  return NFound;
+}
+
+/*****************************************************************************
+  Function name: StationAt()
+
+  Purpose      : Find the station at a location, see IsStationLocation()
+
+  Returns      : int - the station with the lowest index at Loc, -1 if there
+                       is none
+*****************************************************************************/
+int StationAt(STATIONINDEX *Index, COORD *Loc)
+{
+  unsigned int h;
+  int s;
+
+  h = HashLocation(Loc) & (Index->NSlots - 1);
+  while ((s = Index->Slot[h]) >= 0) {
+    if (Index->Station[s].Loc.N == Loc->N &&
+	Index->Station[s].Loc.E == Loc->E)
+      return s;
+    h = (h + 1) & (Index->NSlots - 1);
+  }
+  return -1;
+}
+
+/*****************************************************************************
+  Function name: FreeStationIndex()
+*****************************************************************************/
+void FreeStationIndex(STATIONINDEX *Index)
+{
+  free(Index->Order);
+  free(Index->Node);
+  free(Index->Slot);
+  Index->Order = NULL;
+  Index->Node = NULL;
+  Index->Slot = NULL;
+  Index->NNodes = 0;
+}
+
+/*****************************************************************************
+  BuildNode()
+
+  Makes the node of stations Index->Order[First] .. Index->Order[Last - 1]
+  and its children, and returns its index
+*****************************************************************************/
+static int BuildNode(STATIONINDEX *Index, int First, int Last)
+{
+  STATIONNODE *Node;
+  COORD *Loc;
+  int Mid;
+  int n;
+  int i;
+
+  n = Index->NNodes++;
+  Node = &(Index->Node[n]);
+  Node->First = First;
+  Node->Last = Last;
+  Node->Child[0] = Node->Child[1] = -1;
+  Loc = &(Index->Station[Index->Order[First]].Loc);
+  Node->MinN = Node->MaxN = Loc->N;
+  Node->MinE = Node->MaxE = Loc->E;
+  for (i = First + 1; i < Last; i++) {
+    Loc = &(Index->Station[Index->Order[i]].Loc);
+    if (Loc->N < Node->MinN)
+      Node->MinN = Loc->N;
+    if (Loc->N > Node->MaxN)
+      Node->MaxN = Loc->N;
+    if (Loc->E < Node->MinE)
+      Node->MinE = Loc->E;
+    if (Loc->E > Node->MaxE)
+      Node->MaxE = Loc->E;
+  }
+  if (Last - First <= STATION_LEAF)
+    return n;
+
+  SortStation = Index->Station;
+  SortDim = (Node->MaxE - Node->MinE > Node->MaxN - Node->MinN) ? 1 : 0;
+  qsort(Index->Order + First, Last - First, sizeof(int), CompareStations);
+  Mid = (First + Last) / 2;
+  Node->Child[0] = BuildNode(Index, First, Mid);
+  Node->Child[1] = BuildNode(Index, Mid, Last);
+  return n;
+}
+
+/*****************************************************************************
+  CompareStations()
+
+  qsort() comparison of two station indices by the SortDim coordinate of
+  SortStation
+*****************************************************************************/
+static int CompareStations(const void *A, const void *B)
+{
+  COORD *LocA = &(SortStation[*(const int *) A].Loc);
+  COORD *LocB = &(SortStation[*(const int *) B].Loc);
+  int a = (SortDim == 0) ? LocA->N : LocA->E;
+  int b = (SortDim == 0) ? LocB->N : LocB->E;
+
+  if (a != b)
+    return (a < b) ? -1 : 1;
+  return *(const int *) A - *(const int *) B;
+}
+
+/*****************************************************************************
+  HashLocation()
+*****************************************************************************/
+static unsigned int HashLocation(COORD *Loc)
+{
+  return (unsigned int) Loc->N * 73856093u ^ (unsigned int) Loc->E * 19349663u;
+}
+
+/*****************************************************************************
+  StationDist2()
+
+  Squared distance between a station and a location
+*****************************************************************************/
+static double StationDist2(METLOCATION *Station, COORD *Loc)
+{
+  double dN = (double) (Station->Loc.N - Loc->N);
+  double dE = (double) (Station->Loc.E - Loc->E);
+
+  return dN * dN + dE * dE;
+}
+
+/*****************************************************************************
+  BoxDist2()
+
+  Squared distance between the bounding box of a node and a location, 0 if
+  the location is inside the box
+*****************************************************************************/
+static double BoxDist2(STATIONNODE *Node, COORD *Loc)
+{
+  double dN = 0.0;
+  double dE = 0.0;
+
+  if (Loc->N < Node->MinN)
+    dN = (double) (Node->MinN - Loc->N);
+  else if (Loc->N > Node->MaxN)
+    dN = (double) (Loc->N - Node->MaxN);
+  if (Loc->E < Node->MinE)
+    dE = (double) (Node->MinE - Loc->E);
+  else if (Loc->E > Node->MaxE)
+    dE = (double) (Loc->E - Node->MaxE);
+  return dN * dN + dE * dE;
+}
+
+/*****************************************************************************
+  NearestInNode()
+
+  Adds the stations of node n that are nearer than the K found so far to the
+  sorted list Id, D2 of *NFound stations.  A node is only skipped if all of
+  it is farther than the K-th station, so that a station at the same
+  distance with a lower index is still found
+*****************************************************************************/
+static void NearestInNode(STATIONINDEX *Index, int n, COORD *Loc, int K,
+			  int *NFound, int *Id, double *D2)
+{
+  STATIONNODE *Node = &(Index->Node[n]);
+  double d;
+  double Dist[2];
+  int Near;
+  int i;
+  int j;
+  int s;
+
+  if (Node->Child[0] < 0) {
+    for (i = Node->First; i < Node->Last; i++) {
+      s = Index->Order[i];
+      d = StationDist2(&(Index->Station[s]), Loc);
+      if (*NFound == K && (d > D2[K - 1] || (d == D2[K - 1] && s > Id[K - 1])))
+	continue;
+      j = (*NFound < K) ? (*NFound)++ : K - 1;
+      for (; j > 0 && (D2[j - 1] > d || (D2[j - 1] == d && Id[j - 1] > s));
+	   j--) {
+	D2[j] = D2[j - 1];
+	Id[j] = Id[j - 1];
+      }
+      D2[j] = d;
+      Id[j] = s;
+    }
+    return;
+  }
+
+  Dist[0] = BoxDist2(&(Index->Node[Node->Child[0]]), Loc);
+  Dist[1] = BoxDist2(&(Index->Node[Node->Child[1]]), Loc);
+  Near = (Dist[1] < Dist[0]) ? 1 : 0;
+  for (i = 0; i < 2; i++, Near = 1 - Near) {
+    if (*NFound == K && Dist[Near] > D2[K - 1])
+      continue;
+    NearestInNode(Index, Node->Child[Near], Loc, K, NFound, Id, D2);
+  }
+}
+
+/*****************************************************************************
+  WithinNode()
+
+  Adds the stations of node n within MaxD2 of Loc to Id
+*****************************************************************************/
+static void WithinNode(STATIONINDEX *Index, int n, COORD *Loc, double MaxD2,
+		       int *NFound, int *Id)
+{
+  STATIONNODE *Node = &(Index->Node[n]);
+  int i;
+
+  if (BoxDist2(Node, Loc) > MaxD2)
+    return;
+  if (Node->Child[0] < 0) {
+    for (i = Node->First; i < Node->Last; i++)
+      if (StationDist2(&(Index->Station[Index->Order[i]]), Loc) <= MaxD2)
+	Id[(*NFound)++] = Index->Order[i];
+    return;
+  }
+  WithinNode(Index, Node->Child[0], Loc, MaxD2, NFound, Id);
+  WithinNode(Index, Node->Child[1], Loc, MaxD2, NFound, Id);
+}
@@ -0,0 +1,385 @@
+/*
+ * SUMMARY:      Statistics.c - Annual per-cell statistics
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Keeps, for each cell, the annual maximum and minimum with
+ *               the day of year they occur, the mean and variance (Welford)
+ *               and the number of days on which a threshold is exceeded,
+ *               for the variables of NUMBER OF STATISTICS VARIABLES in the
+ *               [OUTPUT] section.  At the end of each calendar year and of
+ *               the run the statistics are written to the file
+ *               Stats.<variable> in the output directory, instead of the
+ *               maps of each time step
+ * DESCRIP-END.
+ * FUNCTIONS:    InitStatistics()
+ *               UpdateStatistics()
+ *               FinishStatistics()
+ *               WriteStatistics()
+ * COMMENTS:     The maps of a year are written in the order maximum, day of
+ *               the maximum, minimum, day of the minimum, mean, variance
+ *               and, with a STATISTICS THRESHOLD, exceedance days.  In
+ *               NetCDF files they are separate variables (the variable name
+ *               followed by .Max, .MaxDay, etc.) and the time index is the
+ *               number of the year in the run.  The variance is that of
+ *               the time steps of the year (divided by their number)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "fileio.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "memaccount.h"
+#include "sizeofnt.h"
+#include "varid.h"
+
+/* maps of a summary, in the order they are written */
+#define STAT_MAX     0
+#define STAT_MAXDAY  1
+#define STAT_MIN     2
+#define STAT_MINDAY  3
+#define STAT_MEAN    4
+#define STAT_VAR     5
+#define STAT_EXCEED  6
+#define N_STAT_MAPS  7
+
+static const char *StatName[N_STAT_MAPS] = {
+  "Max", "MaxDay", "Min", "MinDay", "Mean", "Var", "ExceedDays"
+};
+
+static const char *StatLongName[N_STAT_MAPS] = {
+  "Annual maximum", "Day of year of the annual maximum", "Annual minimum",
+  "Day of year of the annual minimum", "Annual mean", "Annual variance",
+  "Days exceeding the threshold"
+};
+
+/* map written by WriteStatistics() */
+static float *StatArray = NULL;
+
+static void WriteStatistics(MAPSIZE *Map, STATDUMP *Stat);
+
+/*******************************************************************************
+  Function name: InitStatistics()
+
+  Purpose      : Initialize the annual statistics.  This information is in
+                 the [OUTPUT] section of the input file
+
+  Required     :
+    LISTPTR Input         - Linked list with input strings
+    MAPSIZE *Map          - Information about areal extent
+    int MaxSoilLayers     - Maximum number of soil layers
+    int MaxVegLayers      - Maximum number of vegetation layers
+    char *Path            - Directory to write output to
+    int NStats            - Number of variables with statistics
+    STATDUMP **Stats      - Array with the statistics
+
+  Returns      : void
+
+  Modifies     : Stats and its members
+
+  Comments     : STATISTICS THRESHOLD n is optional, the variable exceeds it
+                 when it is larger, or with STATISTICS EXCEEDANCE n = BELOW
+                 when it is smaller
+*******************************************************************************/
+void InitStatistics(LISTPTR Input, MAPSIZE *Map, int MaxSoilLayers,
+		    int MaxVegLayers, char *Path, int NStats,
+		    STATDUMP **Stats)
+{
+  char *Routine = "InitStatistics";
+  int i;			/* counter */
+  int j;			/* counter */
+  int MaxLayers;		/* Maximum number of layers allowed for this
+				   variable */
+  int NCells;
+  char Label[BUFSIZE + 1];
+  STATDUMP *Stat;
+  char KeyName[stat_exceedance + 1][BUFSIZE + 1];
+  char *KeyStr[] = {
+    "STATISTICS VARIABLE",
+    "STATISTICS LAYER",
+    "STATISTICS THRESHOLD",
+    "STATISTICS EXCEEDANCE",
+  };
+  char *SectionName = "OUTPUT";
+  char VarStr[stat_exceedance + 1][BUFSIZE + 1];
+
+  if (!(*Stats = (STATDUMP *) TaggedCalloc(NStats, sizeof(STATDUMP),
+					   MEM_OUTPUT)))
+    ReportError(Routine, 1);
+
+  NCells = Map->NX * Map->NY;
+  if (!StatArray &&
+      !(StatArray = (float *) TaggedCalloc(NCells, sizeof(float),
+					   MEM_OUTPUT)))
+    ReportError(Routine, 1);
+
+  for (i = 0; i < NStats; i++) {
+    Stat = &((*Stats)[i]);
+
+    /* Read the key-entry pairs from the input file */
+    for (j = 0; j <= stat_exceedance; j++) {
+      sprintf(KeyName[j], "%s %d", KeyStr[j], i + 1);
+      GetInitString(SectionName, KeyName[j], "", VarStr[j],
+		    (unsigned long) BUFSIZE, Input);
+    }
+
+    /* Assign the entries to the appropriate variables */
+    if (!CopyInt(&(Stat->Map.ID), VarStr[stat_variable], 1))
+      ReportError(KeyName[stat_variable], 51);
+
+    if (!IsValidID(Stat->Map.ID))
+      ReportError("Input Options File", 19);
+
+    if (IsMultiLayer(Stat->Map.ID)) {
+      MaxLayers = GetVarNLayers(Stat->Map.ID, MaxSoilLayers, MaxVegLayers);
+      if (!CopyInt(&(Stat->Map.Layer), VarStr[stat_layer], 1))
+	ReportError(KeyName[stat_layer], 51);
+      if (Stat->Map.Layer < 1 || Stat->Map.Layer > MaxLayers)
+	ReportError("Input Options File", 20);
+    }
+    else
+      Stat->Map.Layer = 1;
+
+    if (IsEmptyStr(VarStr[stat_threshold]))
+      Stat->HasThreshold = FALSE;
+    else if (CopyFloat(&(Stat->Threshold), VarStr[stat_threshold], 1))
+      Stat->HasThreshold = TRUE;
+    else
+      ReportError(KeyName[stat_threshold], 51);
+
+    if (IsEmptyStr(VarStr[stat_exceedance]) ||
+	strncmp(VarStr[stat_exceedance], "ABOVE", 5) == 0)
+      Stat->ExceedBelow = FALSE;
+    else if (strncmp(VarStr[stat_exceedance], "BELOW", 5) == 0)
+      Stat->ExceedBelow = TRUE;
+    else
+      ReportError(KeyName[stat_exceedance], 51);
+
+    /* the attributes are those of the map of the variable */
+    Stat->Map.Resolution = MAP_OUTPUT;
+    strncpy(Stat->Map.FileName, Path, BUFSIZE);
+    GetVarAttr(&(Stat->Map));
+    Stat->Map.NumberType = NC_FLOAT;
+    sprintf(Stat->Map.FileName, "%sStats.%s%s", Path, Stat->Map.Name,
+	    fileext);
+    strcpy(Label, "Annual statistics of ");
+    strncat(Label, Stat->Map.FileLabel, BUFSIZE - strlen(Label));
+    strcpy(Stat->Map.FileLabel, Label);
+    Stat->Map.MinVal = 0.0;
+    Stat->Map.MaxVal = 0.0;
+
+    CreateMapFile(Stat->Map.FileName, Stat->Map.FileLabel, Map, NULL);
+
+    if (!(Stat->Max = (float *) TaggedCalloc(NCells, sizeof(float),
+					     MEM_OUTPUT)) ||
+	!(Stat->MaxDay = (float *) TaggedCalloc(NCells, sizeof(float),
+						MEM_OUTPUT)) ||
+	!(Stat->Min = (float *) TaggedCalloc(NCells, sizeof(float),
+					     MEM_OUTPUT)) ||
+	!(Stat->MinDay = (float *) TaggedCalloc(NCells, sizeof(float),
+						MEM_OUTPUT)) ||
+	!(Stat->Mean = (double *) TaggedCalloc(NCells, sizeof(double),
+					       MEM_OUTPUT)) ||
+	!(Stat->M2 = (double *) TaggedCalloc(NCells, sizeof(double),
+					     MEM_OUTPUT)) ||
+	!(Stat->ExceedDays = (float *) TaggedCalloc(NCells, sizeof(float),
+						    MEM_OUTPUT)) ||
+	!(Stat->LastExceed = (int *) TaggedCalloc(NCells, sizeof(int),
+						  MEM_OUTPUT)))
+      ReportError(Routine, 1);
+
+    Stat->N = 0;
+    Stat->Index = 0;
+  }
+}
+
+/*******************************************************************************
+  Function name: UpdateStatistics()
+
+  Purpose      : Add the variables at this time step to the statistics, and
+                 write the statistics of the previous year when the year
+                 changes
+
+  Comments     : Cells that are NA at the first step of a year stay NA
+*******************************************************************************/
+void UpdateStatistics(MAPSIZE *Map, DATE *Current, int NStats,
+		      STATDUMP *Stats, TOPOPIX **TopoMap, EVAPPIX **EvapMap,
+		      PRECIPPIX **PrecipMap, PIXRAD **RadMap,
+		      SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER *Soil,
+		      VEGPIX **VegMap, LAYER *Veg, OPTIONSTRUCT *Options)
+{
+  int i;			/* counter */
+  int j;			/* counter */
+  int NCells;
+  int Day;			/* day of year of this step */
+  int Exceeds;
+  float Value;
+  float *Values;
+  double Delta;
+  STATDUMP *Stat;
+  char VarIDStr[4];		/* stores VarID for sending to ReportError */
+
+  NCells = Map->NX * Map->NY;
+  Day = Current->JDay;
+
+  for (i = 0; i < NStats; i++) {
+    Stat = &(Stats[i]);
+
+    if (Stat->N > 0 && Current->Year != Stat->Year)
+      WriteStatistics(Map, Stat);
+
+    if (!(Values = ExtractDumpVar(Map, &(Stat->Map), TopoMap, EvapMap,
+				  PrecipMap, RadMap, SnowMap, SoilMap, Soil,
+				  VegMap, Veg, Options))) {
+      sprintf(VarIDStr, "%d", Stat->Map.ID);
+      ReportError(VarIDStr, 65);
+    }
+
+    /* start a new year */
+    if (Stat->N == 0) {
+      Stat->Year = Current->Year;
+      for (j = 0; j < NCells; j++) {
+	Value = Values[j];
+	Stat->Max[j] = Stat->Min[j] = Value;
+	Stat->MaxDay[j] = Stat->MinDay[j] = (Value == NA) ? NA : Day;
+	Stat->Mean[j] = Value;
+	Stat->M2[j] = 0.0;
+	Stat->ExceedDays[j] = (Value == NA) ? NA : 0.0;
+	Stat->LastExceed[j] = 0;
+      }
+    }
+    Stat->N++;
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options->NThreads) \
+  private(Value, Delta, Exceeds)
+#endif
+    for (j = 0; j < NCells; j++) {
+      Value = Values[j];
+      if (Value == NA || Stat->Max[j] == NA)
+	continue;
+
+      if (Value > Stat->Max[j]) {
+	Stat->Max[j] = Value;
+	Stat->MaxDay[j] = Day;
+      }
+      if (Value < Stat->Min[j]) {
+	Stat->Min[j] = Value;
+	Stat->MinDay[j] = Day;
+      }
+
+      if (Stat->N > 1) {
+	Delta = Value - Stat->Mean[j];
+	Stat->Mean[j] += Delta / Stat->N;
+	Stat->M2[j] += Delta * (Value - Stat->Mean[j]);
+      }
+
+      if (Stat->HasThreshold) {
+	Exceeds = Stat->ExceedBelow ? (Value < Stat->Threshold) :
+	  (Value > Stat->Threshold);
+	if (Exceeds && Stat->LastExceed[j] != Day) {
+	  Stat->ExceedDays[j] += 1.0;
+	  Stat->LastExceed[j] = Day;
+	}
+      }
+    }
+  }
+}
+
+/*******************************************************************************
+  Function name: FinishStatistics()
+
+  Purpose      : Write the statistics of the last (partial) year at the end
+                 of the run and release the statistics
+*******************************************************************************/
+void FinishStatistics(MAPSIZE *Map, int NStats, STATDUMP *Stats)
+{
+  int i;
+
+  for (i = 0; i < NStats; i++) {
+    if (Stats[i].N > 0)
+      WriteStatistics(Map, &(Stats[i]));
+    TaggedFree(Stats[i].Max);
+    TaggedFree(Stats[i].MaxDay);
+    TaggedFree(Stats[i].Min);
+    TaggedFree(Stats[i].MinDay);
+    TaggedFree(Stats[i].Mean);
+    TaggedFree(Stats[i].M2);
+    TaggedFree(Stats[i].ExceedDays);
+    TaggedFree(Stats[i].LastExceed);
+  }
+  TaggedFree(Stats);
+  TaggedFree(StatArray);
+  StatArray = NULL;
+}
+
+/*******************************************************************************
+  Function name: WriteStatistics()
+
+  Purpose      : Write the maps of the statistics of Stat->Year and start
+                 the next year
+*******************************************************************************/
+static void WriteStatistics(MAPSIZE *Map, STATDUMP *Stat)
+{
+  MAPDUMP Out;			/* attributes of the map that is written */
+  int i;			/* counter */
+  int j;			/* counter */
+  int NCells;
+
+  printf("Writing the %d statistics of %s\n", Stat->Year, Stat->Map.Name);
+
+  NCells = Map->NX * Map->NY;
+  for (i = 0; i < N_STAT_MAPS; i++) {
+    if (i == STAT_EXCEED && !Stat->HasThreshold)
+      continue;
+
+    Out = Stat->Map;
+    snprintf(Out.Name, BUFSIZE + 1, "%s.%s", Stat->Map.Name, StatName[i]);
+    snprintf(Out.LongName, BUFSIZE + 1, "%s of %s", StatLongName[i],
+	     Stat->Map.LongName);
+    if (i == STAT_MAXDAY || i == STAT_MINDAY)
+      strcpy(Out.Units, "day of year");
+    else if (i == STAT_VAR)
+      snprintf(Out.Units, BUFSIZE + 1, "(%s)^2", Stat->Map.Units);
+    else if (i == STAT_EXCEED)
+      strcpy(Out.Units, "days");
+
+    for (j = 0; j < NCells; j++) {
+      switch (i) {
+      case STAT_MAX:
+	StatArray[j] = Stat->Max[j];
+	break;
+      case STAT_MAXDAY:
+	StatArray[j] = Stat->MaxDay[j];
+	break;
+      case STAT_MIN:
+	StatArray[j] = Stat->Min[j];
+	break;
+      case STAT_MINDAY:
+	StatArray[j] = Stat->MinDay[j];
+	break;
+      case STAT_MEAN:
+	StatArray[j] = (float) Stat->Mean[j];
+	break;
+      case STAT_VAR:
+	StatArray[j] = (Stat->Max[j] == NA) ? NA :
+	  (float) (Stat->M2[j] / Stat->N);
+	break;
+      default:
+	StatArray[j] = Stat->ExceedDays[j];
+	break;
+      }
+    }
+    Write2DMatrix(Stat->Map.FileName, StatArray, NC_FLOAT, Map, &Out,
+		  Stat->Index);
+  }
+
+  Stat->Index++;
+  Stat->N = 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * SUMMARY:      StepGraph.c - Stages of a time step run in dependency order
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  A time step is a list of stages, each with the parts of the
+ *               model state (STEP_ in stepgraph.h) that it reads and
+ *               writes.  A stage depends on the stages before it in the
+ *               list that write what it reads or writes, or read what it
+ *               writes.  The stages are put in levels, each one level
+ *               after the last stage it depends on, so that the stages of a
+ *               level do not depend on each other.  With OPTIONS
+ *               CONCURRENT STAGES = TRUE the levels are run one after the
+ *               other, and the side stages of a level run in threads of
+ *               their own while the main thread runs the others.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitStepGraph()
+ *               RunStepGraph()
+ *               FreeStepGraph()
+ *               RunSideTask()
+ * COMMENTS:     The list is made in dhsvm_initialize(), see InitStepTasks()
+ *               in dhsvm.c.  The stages that start OpenMP parallel regions
+ *               run on the main thread, with all the threads of the run.
+ *               A side stage may not start parallel regions, since they
+ *               would not run in parallel in its thread, or be profiled,
+ *               since the profile has one running phase.  Its messages may
+ *               come in between those of the main thread.
+ *
+ *               Without HAVE_PTHREAD, or without CONCURRENT STAGES, the
+ *               stages run in the order of the list, as a serial step.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "stepgraph.h"
+
+#ifdef HAVE_PTHREAD
+static void *RunSideTask(void *Arg);
+#endif
+
+/*****************************************************************************
+  InitStepGraph()
+
+  Puts the NTasks stages of Tasks, in the order of a serial step, in levels.
+  The stages are copied.  With Concurrent the levels are printed.
+*****************************************************************************/
+void InitStepGraph(STEPGRAPH *Graph, STEPTASK *Tasks, int NTasks,
+		   int Concurrent)
+{
+  const char *Routine = "InitStepGraph";
+  STEPTASK *Task;
+  STEPTASK *Before;
+  int *NInLevel;		/* number of stages of each level */
+  int i;
+  int j;
+  int l;
+
+  if (!(Graph->Task = (STEPTASK *) calloc(NTasks + 1, sizeof(STEPTASK))))
+    ReportError((char *) Routine, 1);
+  memcpy(Graph->Task, Tasks, NTasks * sizeof(STEPTASK));
+  Graph->NTasks = NTasks;
+  Graph->Concurrent = FALSE;
+#ifdef HAVE_PTHREAD
+  Graph->Concurrent = Concurrent;
+#endif
+
+  Graph->NLevels = 0;
+  for (i = 0; i < NTasks; i++) {
+    Task = &(Graph->Task[i]);
+    Task->Level = 0;
+    for (j = 0; j < i; j++) {
+      Before = &(Graph->Task[j]);
+      if (((Before->Writes & (Task->Reads | Task->Writes)) ||
+	   (Before->Reads & Task->Writes)) && Before->Level >= Task->Level)
+	Task->Level = Before->Level + 1;
+    }
+    if (Task->Level >= Graph->NLevels)
+      Graph->NLevels = Task->Level + 1;
+  }
+
+  /* a side stage that is alone in its level is run by the main thread */
+  if (!(NInLevel = (int *) calloc(Graph->NLevels + 1, sizeof(int))))
+    ReportError((char *) Routine, 1);
+  for (i = 0; i < NTasks; i++)
+    NInLevel[Graph->Task[i].Level]++;
+  for (i = 0; i < NTasks; i++) {
+    if (NInLevel[Graph->Task[i].Level] == 1)
+      Graph->Task[i].Side = FALSE;
+  }
+  free(NInLevel);
+
+  if (!Graph->Concurrent)
+    return;
+  printf("Running the %d stages of a time step in %d levels\n", NTasks,
+	 Graph->NLevels);
+  for (l = 0; l < Graph->NLevels; l++) {
+    printf("\t%2d:", l);
+    for (i = 0; i < NTasks; i++) {
+      if (Graph->Task[i].Level == l)
+	printf(" %s%s", Graph->Task[i].Name,
+	       Graph->Task[i].Side ? " (thread)" : "");
+    }
+    printf("\n");
+  }
+}
+
+#ifdef HAVE_PTHREAD
+/*****************************************************************************
+  RunSideTask()
+*****************************************************************************/
+static void *RunSideTask(void *Arg)
+{
+  STEPTASK *Task = (STEPTASK *) Arg;
+
+  /* the thread has the processor of the main thread if it is pinned */
+  UnpinThread();
+  Task->Run();
+  return NULL;
+}
+#endif
+
+/*****************************************************************************
+  RunStepGraph()
+
+  Runs the stages of one time step
+*****************************************************************************/
+void RunStepGraph(STEPGRAPH *Graph)
+{
+#ifdef HAVE_PTHREAD
+  STEPTASK *Task;
+  int l;
+#endif
+  int i;
+
+  if (!Graph->Concurrent) {
+    for (i = 0; i < Graph->NTasks; i++)
+      Graph->Task[i].Run();
+    return;
+  }
+
+#ifdef HAVE_PTHREAD
+  for (l = 0; l < Graph->NLevels; l++) {
+    /* start the side stages of the level, run the others, and wait for the
+       side stages before the next level */
+    for (i = 0; i < Graph->NTasks; i++) {
+      Task = &(Graph->Task[i]);
+      Task->Started = FALSE;
+      if (Task->Level == l && Task->Side) {
+	if (pthread_create(&(Task->Thread), NULL, RunSideTask, Task) == 0)
+	  Task->Started = TRUE;
+	else
+	  printf("WARNING: cannot start a thread for %s\n", Task->Name);
+      }
+    }
+    for (i = 0; i < Graph->NTasks; i++) {
+      Task = &(Graph->Task[i]);
+      if (Task->Level == l && !Task->Started)
+	Task->Run();
+    }
+    for (i = 0; i < Graph->NTasks; i++) {
+      Task = &(Graph->Task[i]);
+      if (Task->Level == l && Task->Started) {
+	pthread_join(Task->Thread, NULL);
+	Task->Started = FALSE;
+      }
+    }
+  }
+#endif
+}
+
+/*****************************************************************************
+  FreeStepGraph()
+*****************************************************************************/
+void FreeStepGraph(STEPGRAPH *Graph)
+{
+  free(Graph->Task);
+  Graph->Task = NULL;
+  Graph->NTasks = 0;
+  Graph->NLevels = 0;
+}
@@ -10,6 +10,12 @@
  *               model with the correct initial conditions
  * DESCRIP-END.
  * FUNCTIONS:    StoreModelState()
+ *               CheckpointSum()
+ *               CheckpointGeometry()
+ *               CheckpointNetwork()
+ *               EncodeCheckpointDelta()
+ *               DecodeCheckpointDelta()
+ *               StoreModelCheckpoint()
  * COMMENTS:
  * $Id: StoreModelState.c,v 1.8 2004/08/16 18:26:38 colleen Exp $
  */
@@ -50,6 +56,9 @@
          - temperature
        - surface temperature
        - ground heat storage
+
+   With STATE FORMAT = CHECKPOINT the state, including the channel storage,
+   goes to a single file written by StoreModelCheckpoint().
  *****************************************************************************/
 void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
   OPTIONSTRUCT * Options, TOPOPIX ** TopoMap,
@@ -79,6 +88,13 @@ void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
   PrintDate(Current, stdout);
   printf("\n");
 
+  if (Options->StateFormat == STATE_CHECKPOINT) {
+    StoreModelCheckpoint(Path, Current, Map, Options, PrecipMap, SnowMap,
+			 VegMap, Veg, SoilMap, Soil, HydrographInfo,
+			 Hydrograph, ChannelData->stream_net);
+    return;
+  }
+
   if (MetMap != NULL) {
 
     sprintf(Str, "%02d.%02d.%04d.%02d.%02d.%02d", Current->Month, Current->Day,
@@ -86,7 +102,7 @@ void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
     sprintf(FileName, "%sMet.State.%s%s", Path, Str, fileext);
     strcpy(FileLabel, "Basic Meteorology at time step");
 
-    CreateMapFile(FileName, FileLabel, Map);
+    CreateMapFile(FileName, FileLabel, Map, NULL);
 
     if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
       ReportError((char *)Routine, 1);
@@ -177,7 +193,7 @@ void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
   sprintf(FileName, "%sInterception.State.%s%s", Path, Str, fileext);
   strcpy(FileLabel, "Interception storage for each vegetation layer");
 
-  CreateMapFile(FileName, FileLabel, Map);
+  CreateMapFile(FileName, FileLabel, Map, NULL);
 
   if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
     ReportError((char *)Routine, 1);
@@ -248,7 +264,7 @@ void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
 
   sprintf(FileName, "%sSnow.State.%s%s", Path, Str, fileext);
   strcpy(FileLabel, "Snow pack moisture and temperature state");
-  CreateMapFile(FileName, FileLabel, Map);
+  CreateMapFile(FileName, FileLabel, Map, NULL);
 
   if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
     ReportError((char *)Routine, 1);
@@ -371,7 +387,7 @@ void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
 
   sprintf(FileName, "%sSoil.State.%s%s", Path, Str, fileext);
   strcpy(FileLabel, "Soil moisture and temperature state");
-  CreateMapFile(FileName, FileLabel, Map);
+  CreateMapFile(FileName, FileLabel, Map, NULL);
 
   if (!(Array = (float *)calloc(Map->NY * Map->NX, sizeof(float))))
     ReportError((char *)Routine, 1);
@@ -469,7 +485,8 @@ void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
   /* If the unit hydrograph is used for flow routing, store the unit
      hydrograph array */
 
-  if (Options->Extent == BASIN && Options->HasNetwork == FALSE) {
+  if (Options->Extent == BASIN && Options->HasNetwork == FALSE &&
+      Hydrograph != NULL) {
     sprintf(FileName, "%sHydrograph.State.%s", Path, Str);
     OpenFile(&HydroStateFile, FileName, "w", FALSE);
     for (i = 0; i < HydrographInfo->TotalWaveLength; i++)
@@ -477,3 +494,399 @@ void StoreModelState(char *Path, DATE * Current, MAPSIZE * Map,
     fclose(HydroStateFile);
   }
 }
+
+/*****************************************************************************
+  CheckpointSum()
+
+  Running FNV-1a hash over NWords 32-bit words, used for the header and
+  data checksums and the basin geometry hash of a model state checkpoint.
+  Start with Sum = CHECKPOINT_SEED.
+*****************************************************************************/
+unint CheckpointSum(unint Sum, const unint *Words, size_t NWords)
+{
+  size_t i;
+
+  for (i = 0; i < NWords; i++) {
+    Sum ^= Words[i];
+    Sum *= 16777619u;
+  }
+  return Sum;
+}
+
+/*****************************************************************************
+  CheckpointGeometry()
+
+  Hash of the basin geometry (grid size and active cells) a checkpoint
+  belongs to.
+*****************************************************************************/
+unint CheckpointGeometry(MAPSIZE * Map)
+{
+  unint Words[3];
+  int i;
+  unint Sum;
+
+  Words[0] = (unint) Map->NY;
+  Words[1] = (unint) Map->NX;
+  Words[2] = (unint) Map->NumActive;
+  Sum = CheckpointSum(CHECKPOINT_SEED, Words, 3);
+  for (i = 0; i < Map->NumActive; i++) {
+    Words[0] = (unint) Map->ActiveCells[i].y;
+    Words[1] = (unint) Map->ActiveCells[i].x;
+    Sum = CheckpointSum(Sum, Words, 2);
+  }
+  return Sum;
+}
+
+/*****************************************************************************
+  CheckpointNetwork()
+
+  Hash of the stream network a checkpoint belongs to: the segment ids in
+  routing order, the order of the channel values of the checkpoint.
+  StreamNet is NULL if there is no stream network.
+*****************************************************************************/
+unint CheckpointNetwork(ChannelNetwork * StreamNet)
+{
+  unint Words[1];
+  int i;
+  unint Sum;
+
+  Words[0] = (StreamNet != NULL) ? (unint) StreamNet->nseg : 0;
+  Sum = CheckpointSum(CHECKPOINT_SEED, Words, 1);
+  for (i = 0; StreamNet != NULL && i < StreamNet->nseg; i++) {
+    Words[0] = (unint) StreamNet->seg[i]->id;
+    Sum = CheckpointSum(Sum, Words, 1);
+  }
+  return Sum;
+}
+
+/*****************************************************************************
+  EncodeCheckpointDelta()
+
+  Code the change from Base to Data (NWords words each) into Out, which has
+  to hold at least (NWords + 7) / 8 + 5 * NWords bytes.  Out starts with
+  one bit per block of CHECKPOINT_BLOCK words that is set if the block
+  changed.  Each changed block follows as one byte per word with the
+  number of significant bytes of Base ^ Data (0 - 4), and then those low
+  order bytes.  State that changes slowly only differs in the low bits of
+  the mantissa, so most of the high bytes drop out.
+
+  Returns the number of bytes used in Out.
+*****************************************************************************/
+size_t EncodeCheckpointDelta(const unint *Base, const unint *Data,
+			     size_t NWords, unsigned char *Out)
+{
+  unsigned char *Map;
+  unsigned char *Count;
+  unsigned char *Next;
+  size_t NBlocks;
+  size_t Block;
+  size_t First;
+  size_t Last;
+  size_t i;
+  unint Diff;
+  int n;
+
+  NBlocks = (NWords + CHECKPOINT_BLOCK - 1) / CHECKPOINT_BLOCK;
+  Map = Out;
+  memset(Map, 0, (NBlocks + 7) / 8);
+  Next = Out + (NBlocks + 7) / 8;
+
+  for (Block = 0; Block < NBlocks; Block++) {
+    First = Block * CHECKPOINT_BLOCK;
+    Last = MIN(First + CHECKPOINT_BLOCK, NWords);
+    for (i = First; i < Last && Base[i] == Data[i]; i++)
+      ;
+    if (i == Last)
+      continue;
+
+    Map[Block / 8] |= (unsigned char) (1 << (Block % 8));
+    Count = Next;
+    Next += Last - First;
+    for (i = First; i < Last; i++) {
+      Diff = Base[i] ^ Data[i];
+      for (n = 0; Diff != 0; n++, Diff >>= 8)
+	*Next++ = (unsigned char) (Diff & 0xff);
+      Count[i - First] = (unsigned char) n;
+    }
+  }
+  return (size_t) (Next - Out);
+}
+
+/*****************************************************************************
+  DecodeCheckpointDelta()
+
+  Apply the NIn bytes of delta In, as coded by EncodeCheckpointDelta(), to
+  the NWords words in Data, which hold the base on entry.
+
+  Returns FALSE if the delta does not fit NWords words.
+*****************************************************************************/
+int DecodeCheckpointDelta(const unsigned char *In, size_t NIn, unint *Data,
+			  size_t NWords)
+{
+  const unsigned char *Count;
+  const unsigned char *Next;
+  const unsigned char *End;
+  size_t NBlocks;
+  size_t Block;
+  size_t First;
+  size_t Last;
+  size_t i;
+  unint Diff;
+  int n;
+  int k;
+
+  NBlocks = (NWords + CHECKPOINT_BLOCK - 1) / CHECKPOINT_BLOCK;
+  End = In + NIn;
+  Next = In + (NBlocks + 7) / 8;
+  if (Next > End)
+    return FALSE;
+
+  for (Block = 0; Block < NBlocks; Block++) {
+    if (!(In[Block / 8] & (1 << (Block % 8))))
+      continue;
+    First = Block * CHECKPOINT_BLOCK;
+    Last = MIN(First + CHECKPOINT_BLOCK, NWords);
+    Count = Next;
+    Next += Last - First;
+    if (Next > End)
+      return FALSE;
+    for (i = First; i < Last; i++) {
+      n = Count[i - First];
+      if (n > 4 || Next + n > End)
+	return FALSE;
+      for (k = 0, Diff = 0; k < n; k++)
+	Diff |= (unint) (*Next++) << (8 * k);
+      Data[i] ^= Diff;
+    }
+  }
+  return Next == End;
+}
+
+/*****************************************************************************
+  StoreModelCheckpoint()
+
+  Store the model state in a single binary file instead of the
+  Interception, Snow, Soil, Hydrograph and Channel state files.  The file
+  is built in memory and written with one fwrite:
+
+    CHECKPOINT_MAGIC
+    NCHKHEADER header words (see enum CHKHEADER in settings.h)
+    the state variables, one plane of Map->NumActive floats per variable
+    and layer in the order of the state maps, NA for missing layers
+    chk_channelvars planes of chk_nchannel values, the storage of the
+    stream segments and, with CHECKPOINT CHANNEL FLOWS, their inflow and
+    outflow, in the routing order of the compiled network
+    chk_nhydro unit hydrograph values
+
+  All words are 4 bytes in the byte order of the machine.  The header holds
+  a hash of the active cells, a hash of the segment ids in routing order
+  (CheckpointNetwork()) and checksums of the data and the header.  The
+  inflow and outflow of the last step become the last inflow and outflow
+  of the first step after a restart, as in a run that goes on.
+
+  With CHECKPOINT BASE INTERVAL = N > 1 only every N-th checkpoint is
+  stored like this.  The ones in between start with CHECKPOINT_DELTA_MAGIC
+  and, after the header, hold the change since the last full (base)
+  checkpoint as coded by EncodeCheckpointDelta().  Their header names the
+  base and its data checksum, and chk_datasum is the checksum of the full
+  data.  The base is kept in memory, and a restart needs the base and the
+  one delta.
+*****************************************************************************/
+static char *BaseBuffer = NULL;	/* last full checkpoint */
+static size_t BaseNWords = 0;
+static int NSinceBase = 0;	/* checkpoints stored since BaseBuffer */
+
+void StoreModelCheckpoint(char *Path, DATE * Current, MAPSIZE * Map,
+			  OPTIONSTRUCT * Options, PRECIPPIX ** PrecipMap,
+			  SNOWPIX ** SnowMap, VEGPIX ** VegMap, LAYER * Veg,
+			  SOILPIX ** SoilMap, LAYER * Soil,
+			  UNITHYDRINFO * HydrographInfo, float *Hydrograph,
+			  ChannelNetwork * StreamNet)
+{
+  const char *Routine = "StoreModelCheckpoint";
+  char FileName[NAMESIZE + 1];
+  FILE *OutFile;
+  char *Buffer;
+  char *Delta;
+  unint *Header;
+  unint *BaseHeader;
+  float *Data;
+  float *Plane;
+  ChannelRoute *Route;
+  size_t NMagic;
+  size_t NWords;
+  size_t NBytes;
+  int NPlanes;
+  int NChannel;
+  int NChannelVars;
+  int NHydro;
+  int NVeg;
+  int NSoil;
+  int i;
+  int k;
+  int x;
+  int y;
+
+  printf("Storing model checkpoint\n");
+
+  NChannel = (StreamNet != NULL) ? StreamNet->nseg : 0;
+  NChannelVars = Options->CheckpointFlows ? CHKCHANNEL_FLOWS :
+    CHKCHANNEL_STORAGE;
+  NHydro = (Options->Extent == BASIN && Options->HasNetwork == FALSE) ?
+    HydrographInfo->TotalWaveLength : 0;
+
+  /* interception, snow (8) and soil planes */
+  NPlanes = 2 * Veg->MaxLayers + 1 + 8 + (Soil->MaxLayers + 1) + 1 +
+    Soil->MaxLayers + 2;
+  NWords = (size_t) NPlanes * Map->NumActive +
+    (size_t) NChannelVars * NChannel + NHydro;
+  NMagic = strlen(CHECKPOINT_MAGIC);
+  NBytes = NMagic + (NCHKHEADER + NWords) * sizeof(unint);
+
+  if (!(Buffer = (char *) malloc(NBytes)))
+    ReportError((char *) Routine, 1);
+  memcpy(Buffer, CHECKPOINT_MAGIC, NMagic);
+  Header = (unint *) (Buffer + NMagic);
+  Data = (float *) (Header + NCHKHEADER);
+
+  Plane = Data;
+  for (i = 0; i < Veg->MaxLayers; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
+      Plane[k] = (i < NVeg) ? PrecipMap[y][x].IntRain[i] : NA;
+    }
+  }
+  for (i = 0; i < Veg->MaxLayers; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      NVeg = Veg->NLayers[(VegMap[y][x].Veg - 1)];
+      Plane[k] = (i < NVeg) ? PrecipMap[y][x].IntSnow[i] : NA;
+    }
+  }
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Plane[k] = PrecipMap[y][x].TempIntStorage;
+    Plane[k + Map->NumActive] = (float) SnowMap[y][x].HasSnow;
+    Plane[k + 2 * Map->NumActive] = (float) SnowMap[y][x].LastSnow;
+    Plane[k + 3 * Map->NumActive] = SnowMap[y][x].Swq;
+    Plane[k + 4 * Map->NumActive] = SnowMap[y][x].PackWater;
+    Plane[k + 5 * Map->NumActive] = SnowMap[y][x].TPack;
+    Plane[k + 6 * Map->NumActive] = SnowMap[y][x].SurfWater;
+    Plane[k + 7 * Map->NumActive] = SnowMap[y][x].TSurf;
+    Plane[k + 8 * Map->NumActive] = SnowMap[y][x].ColdContent;
+  }
+  Plane += 9 * Map->NumActive;
+  for (i = 0; i < Soil->MaxLayers + 1; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      NSoil = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
+      Plane[k] = (i <= NSoil) ? SoilMap[y][x].Moist[i] : NA;
+    }
+  }
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Plane[k] = SoilMap[y][x].TSurf;
+  }
+  Plane += Map->NumActive;
+  for (i = 0; i < Soil->MaxLayers; i++, Plane += Map->NumActive) {
+    for (k = 0; k < Map->NumActive; k++) {
+      y = Map->ActiveCells[k].y;
+      x = Map->ActiveCells[k].x;
+      NSoil = Soil->NLayers[(SoilMap[y][x].Soil - 1)];
+      Plane[k] = (i < NSoil) ? SoilMap[y][x].Temp[i] : NA;
+    }
+  }
+  for (k = 0; k < Map->NumActive; k++) {
+    y = Map->ActiveCells[k].y;
+    x = Map->ActiveCells[k].x;
+    Plane[k] = SoilMap[y][x].Qst;
+    Plane[k + Map->NumActive] = SoilMap[y][x].IExcess;
+  }
+  Plane += 2 * Map->NumActive;
+
+  /* channel state and unit hydrograph */
+  for (k = 0; k < NChannel; k++) {
+    Route = StreamNet->route[k];
+    Plane[k] = Route->storage;
+    if (NChannelVars == CHKCHANNEL_FLOWS) {
+      Plane[k + NChannel] = Route->inflow;
+      Plane[k + 2 * NChannel] = Route->outflow;
+    }
+  }
+  Plane += (size_t) NChannelVars * NChannel;
+  for (i = 0; i < NHydro; i++)
+    Plane[i] = Hydrograph[i];
+
+  Header[chk_version] = CHECKPOINT_VERSION;
+  Header[chk_ny] = (unint) Map->NY;
+  Header[chk_nx] = (unint) Map->NX;
+  Header[chk_nactive] = (unint) Map->NumActive;
+  Header[chk_veglayers] = (unint) Veg->MaxLayers;
+  Header[chk_soillayers] = (unint) Soil->MaxLayers;
+  Header[chk_nchannel] = (unint) NChannel;
+  Header[chk_nhydro] = (unint) NHydro;
+  Header[chk_year] = (unint) Current->Year;
+  Header[chk_month] = (unint) Current->Month;
+  Header[chk_day] = (unint) Current->Day;
+  Header[chk_hour] = (unint) Current->Hour;
+  Header[chk_min] = (unint) Current->Min;
+  Header[chk_sec] = (unint) Current->Sec;
+  Header[chk_geomhash] = CheckpointGeometry(Map);
+  Header[chk_nethash] = CheckpointNetwork(StreamNet);
+  Header[chk_channelvars] = (unint) NChannelVars;
+  Header[chk_datasum] = CheckpointSum(CHECKPOINT_SEED, (unint *) Data, NWords);
+
+  sprintf(FileName, "%sModel.State.%02d.%02d.%04d.%02d.%02d.%02d.chk", Path,
+	  Current->Month, Current->Day, Current->Year, Current->Hour,
+	  Current->Min, Current->Sec);
+  OpenFile(&OutFile, FileName, "wb", TRUE);
+
+  if (BaseBuffer != NULL && BaseNWords == NWords &&
+      NSinceBase < Options->CheckpointBase) {
+    /* delta against the base checkpoint */
+    BaseHeader = (unint *) (BaseBuffer + NMagic);
+    for (i = chk_baseyear; i <= chk_basesum; i++)
+      Header[i] = BaseHeader[i];
+    Header[chk_headersum] = CheckpointSum(CHECKPOINT_SEED, Header,
+					  chk_headersum);
+    if (!(Delta = (char *) malloc(NMagic + NCHKHEADER * sizeof(unint) +
+				  (NWords + 7) / 8 + 5 * NWords)))
+      ReportError((char *) Routine, 1);
+    memcpy(Delta, CHECKPOINT_DELTA_MAGIC, NMagic);
+    memcpy(Delta + NMagic, Header, NCHKHEADER * sizeof(unint));
+    NBytes = NMagic + NCHKHEADER * sizeof(unint) +
+      EncodeCheckpointDelta(BaseHeader + NCHKHEADER, (unint *) Data, NWords,
+			    (unsigned char *) (Delta + NMagic +
+					       NCHKHEADER * sizeof(unint)));
+    if (fwrite(Delta, 1, NBytes, OutFile) != NBytes || fclose(OutFile) != 0)
+      ReportError(FileName, 72);
+    free(Delta);
+    free(Buffer);
+    NSinceBase++;
+  }
+  else {
+    /* full checkpoint, which is its own base */
+    Header[chk_baseyear] = Header[chk_year];
+    Header[chk_basemonth] = Header[chk_month];
+    Header[chk_baseday] = Header[chk_day];
+    Header[chk_basehour] = Header[chk_hour];
+    Header[chk_basemin] = Header[chk_min];
+    Header[chk_basesec] = Header[chk_sec];
+    Header[chk_basesum] = Header[chk_datasum];
+    Header[chk_headersum] = CheckpointSum(CHECKPOINT_SEED, Header,
+					  chk_headersum);
+    if (fwrite(Buffer, 1, NBytes, OutFile) != NBytes || fclose(OutFile) != 0)
+      ReportError(FileName, 72);
+    if (BaseBuffer != NULL)
+      free(BaseBuffer);
+    BaseBuffer = Buffer;
+    BaseNWords = NWords;
+    NSinceBase = 1;
+  }
+}
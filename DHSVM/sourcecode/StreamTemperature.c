@@ -0,0 +1,496 @@
+/*
+ * SUMMARY:      StreamTemperature.c - Stream temperature during the run
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Advances the heat budget of RBM (RBM/RBM.f) for each stream
+ *               segment at every time step, from the segment averages of
+ *               the RBM inputs (Channel ATP, NSW, NLW, VP and WND) and the
+ *               routed flows, without the RBM forcing files
+ * DESCRIP-END.
+ * FUNCTIONS:    ReadStreamTempParam()
+ *               InitStreamTemp()
+ *               StreamTemperature()
+ *               SaveStreamTemp()
+ *               FreeStreamTemp()
+ *               StreamHeatFlux()
+ *               StreamTempSegment()
+ * COMMENTS:     With OPTIONS STREAM TEMPERATURE SOLVER = INTERNAL the
+ *               segments take the place of the RBM cells.  The inputs are
+ *               converted to the units of RBM as Create_File does, and
+ *               the velocity and depth follow from the Leopold
+ *               coefficients, the headwater temperature from the Mohseni
+ *               parameters of each segment (the STREAM TEMPERATURE
+ *               PARAMETER FILE of the ROUTING section, or the defaults of
+ *               alloc_channel_segment()).
+ *
+ *               The temperature of a segment is kept at its inlet and
+ *               outlet, linear in between.  The water that leaves the
+ *               outlet at the end of a step is traced back over the
+ *               travel time of the segment: to the inlet, at a time in
+ *               the step, if the travel time is shorter than the step,
+ *               and else to a point in the segment at the start of the
+ *               step.  Its temperature there is interpolated and heated
+ *               along the way with the energy budget of RBM, in two parts
+ *               per segment length as the RBM cells are.  The inlet
+ *               temperature is the flow weighted mean of the outlet
+ *               temperatures of the upstream segments.
+ *
+ *               The segments are visited level by level, where level 0
+ *               holds the headwaters and every other segment is in the
+ *               level after the last of its upstream segments.  The
+ *               segments of a level are independent and are done by
+ *               NThreads threads, with the same result for any number of
+ *               threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "DHSVMChannel.h"
+#include "errorhandler.h"
+#include "tableio.h"
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+/* units of RBM */
+#define CFS_PER_CMS    35.315	/* m3/s to cfs */
+#define FT_PER_M       3.2808	/* m to ft */
+#define KCAL_PER_J     2.3884e-4	/* W/m2 to kcal/m2/s */
+#define MB_PER_PA      0.01	/* Pa to mb */
+#define RFAC           304.8	/* kcal/C of a column of 1 ft and 1 m2 */
+#define STREAMTEMP_QMIN    0.01	/* least flow (cfs), as in Create_File */
+#define STREAMTEMP_NDELTA  2	/* parts per segment, the ndelta of RBM */
+#define STREAMTEMP_TMIN    0.5	/* least water temperature (C) */
+
+static float StreamHeatFlux(float T, Channel *seg);
+static void StreamTempSegment(Channel *seg, float TIn, int Dt);
+
+/*****************************************************************************
+  ReadStreamTempParam()
+
+  Reads the Mohseni and Leopold parameters of the segments from a table
+  with the columns ID, Alpha, Beta, Gamma, Mu, Smooth, Ua, Ub, Umin, Da, Db
+  and Dmin.  Segments that are not in the table keep their defaults.
+*****************************************************************************/
+void ReadStreamTempParam(ChannelNetwork *cnet, const char *file)
+{
+  Channel *seg;
+  CHANTEMP *p;
+  int err = 0;
+  int done;
+  int i;
+  static const int fields = 12;
+  static TableField temp_fields[12] = {
+    {"ID", TABLE_INTEGER, TRUE, FALSE, {0}, "", NULL},
+    {"Alpha", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Beta", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Gamma", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Mu", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Smooth", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Ua", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Ub", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Umin", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Da", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Db", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+    {"Dmin", TABLE_REAL, TRUE, FALSE, {0.0}, "", NULL},
+  };
+
+  error_handler(ERRHDL_STATUS,
+		"ReadStreamTempParam: reading file \"%s\"", file);
+
+  if (table_open(file) != 0) {
+    error_handler(ERRHDL_ERROR,
+		  "ReadStreamTempParam: unable to open file \"%s\": %s",
+		  file, strerror(errno));
+    exit(3);
+  }
+
+  done = FALSE;
+  while (!done) {
+    done = (table_get_fields(fields, temp_fields) < 0);
+    for (i = 0; i < fields; i++) {
+      if (temp_fields[i].read)
+	break;
+    }
+    if (i >= fields)
+      continue;
+
+    for (i = 0; i < fields; i++) {
+      if (!temp_fields[i].read) {
+	error_handler(ERRHDL_ERROR, "%s: line %d: %s missing", file,
+		      table_lineno(), temp_fields[i].name);
+	err++;
+      }
+    }
+    if (!temp_fields[0].read)
+      continue;
+    if (temp_fields[0].value.integer <= 0 ||
+	temp_fields[0].value.integer > cnet->maxid ||
+	(seg = cnet->byid[temp_fields[0].value.integer]) == NULL) {
+      error_handler(ERRHDL_ERROR, "%s: segment %d: not in the stream network",
+		    file, temp_fields[0].value.integer);
+      err++;
+      continue;
+    }
+
+    p = &(seg->temp);
+    p->Alpha = temp_fields[1].value.real;
+    p->Beta = temp_fields[2].value.real;
+    p->Gamma = temp_fields[3].value.real;
+    p->Mu = temp_fields[4].value.real;
+    p->Smooth = temp_fields[5].value.real;
+    p->Ua = temp_fields[6].value.real;
+    p->Ub = temp_fields[7].value.real;
+    p->Umin = temp_fields[8].value.real;
+    p->Da = temp_fields[9].value.real;
+    p->Db = temp_fields[10].value.real;
+    p->Dmin = temp_fields[11].value.real;
+    p->TSmooth = p->TIn = p->TOut = p->Mu;
+
+    if (p->Smooth < 0.0 || p->Smooth > 1.0) {
+      error_handler(ERRHDL_ERROR, "%s: segment %d: smoothing (%f) invalid",
+		    file, seg->id, p->Smooth);
+      err++;
+    }
+    if (p->Ua <= 0.0 || p->Umin <= 0.0) {
+      error_handler(ERRHDL_ERROR, "%s: segment %d: velocity (%f, %f) invalid",
+		    file, seg->id, p->Ua, p->Umin);
+      err++;
+    }
+    if (p->Da <= 0.0 || p->Dmin <= 0.0) {
+      error_handler(ERRHDL_ERROR, "%s: segment %d: depth (%f, %f) invalid",
+		    file, seg->id, p->Da, p->Dmin);
+      err++;
+    }
+  }
+  table_close();
+
+  error_handler(ERRHDL_STATUS, "ReadStreamTempParam: %s: %d errors, %d warnings",
+		file, table_errors + err, table_warnings);
+
+  if (err > 0 || table_errors) {
+    error_handler(ERRHDL_ERROR, "ReadStreamTempParam: %s: too many errors",
+		  file);
+    exit(3);
+  }
+}
+
+/*****************************************************************************
+  InitStreamTemp()
+
+  Sorts the compiled stream network into level sets and lists the upstream
+  segments of each segment, in routing order.  Called after the network is
+  final (InitSubBasin() may prune it).
+*****************************************************************************/
+void InitStreamTemp(CHANNEL *channel, int NThreads)
+{
+  const char *Routine = "InitStreamTemp";
+  ChannelNetwork *cnet = channel->stream_net;
+  STREAMTEMPNET *net;
+  Channel *seg;
+  int *depth;
+  int *fill;
+  int i, j, l;
+  int n;
+
+  if (cnet == NULL)
+    return;
+  n = cnet->nseg;
+
+  if (!(net = (STREAMTEMPNET *) calloc(1, sizeof(STREAMTEMPNET))) ||
+      !(net->level = (int *) calloc(n + 2, sizeof(int))) ||
+      !(net->seq = (int *) calloc(n + 1, sizeof(int))) ||
+      !(net->upstart = (int *) calloc(n + 1, sizeof(int))) ||
+      !(net->upidx = (int *) calloc(n + 1, sizeof(int))) ||
+      !(depth = (int *) calloc(n + 1, sizeof(int))) ||
+      !(fill = (int *) calloc(n + 1, sizeof(int))))
+    ReportError((char *) Routine, 1);
+
+  /* upstream lists, filled in routing order */
+  for (i = 0; i < n; i++) {
+    if (cnet->outlet[i] >= 0)
+      net->upstart[cnet->outlet[i] + 1]++;
+  }
+  for (i = 0; i < n; i++) {
+    net->upstart[i + 1] += net->upstart[i];
+    fill[i] = net->upstart[i];
+  }
+  for (i = 0; i < n; i++) {
+    if ((j = cnet->outlet[i]) >= 0)
+      net->upidx[fill[j]++] = i;
+  }
+
+  /* the level of a segment is the longest path from a headwater, found
+     from the headwaters down (fill counts the upstream segments that are
+     not done yet, seq is the queue) */
+  for (i = 0; i < n; i++)
+    fill[i] = net->upstart[i + 1] - net->upstart[i];
+  for (i = 0, j = 0; i < n; i++) {
+    if (fill[i] == 0)
+      net->seq[j++] = i;
+  }
+  for (l = 0; l < j; l++) {
+    i = net->seq[l];
+    if (cnet->outlet[i] >= 0) {
+      if (depth[i] + 1 > depth[cnet->outlet[i]])
+	depth[cnet->outlet[i]] = depth[i] + 1;
+      if (--fill[cnet->outlet[i]] == 0)
+	net->seq[j++] = cnet->outlet[i];
+    }
+  }
+  if (j != n) {
+    error_handler(ERRHDL_ERROR,
+		  "%s: the stream network has a loop (%d of %d segments)",
+		  Routine, j, n);
+    exit(3);
+  }
+
+  /* level sets, in routing order within each level */
+  net->nlevel = 0;
+  for (i = 0; i < n; i++) {
+    net->level[depth[i] + 1]++;
+    if (depth[i] + 1 > net->nlevel)
+      net->nlevel = depth[i] + 1;
+  }
+  for (l = 0; l < net->nlevel; l++) {
+    net->level[l + 1] += net->level[l];
+    fill[l] = net->level[l];
+  }
+  for (i = 0; i < n; i++)
+    net->seq[fill[depth[i]]++] = i;
+  free(depth);
+  free(fill);
+
+  /* the water starts at the Mohseni temperature of the mean air
+     temperature Mu, as the headwaters of RBM */
+  for (i = 0; i < n; i++) {
+    seg = cnet->seg[i];
+    seg->temp.TSmooth = seg->temp.TIn = seg->temp.TOut = seg->temp.Mu;
+  }
+
+  net->nthreads = (NThreads > 1) ? NThreads : 1;
+  channel->temp_net = net;
+
+  error_handler(ERRHDL_STATUS, "%s: %d segments in %d levels, %d threads",
+		Routine, n, net->nlevel, net->nthreads);
+}
+
+/*****************************************************************************
+  StreamTemperature()
+
+  Advances the temperature of all stream segments over a time step, after
+  the routing of the step
+*****************************************************************************/
+void StreamTemperature(CHANNEL *ChannelData, int Dt)
+{
+  ChannelNetwork *cnet = ChannelData->stream_net;
+  STREAMTEMPNET *net = ChannelData->temp_net;
+  Channel *seg;
+  Channel *up;
+  CHANTEMP *p;
+  double q, qsum, tsum;
+  float TIn;
+  int i, j, k, l;
+
+  if (net == NULL)
+    return;
+
+  for (l = 0; l < net->nlevel; l++) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(net->nthreads) \
+  private(i, j, seg, up, p, q, qsum, tsum, TIn) \
+  if (net->level[l + 1] - net->level[l] > 1)
+#endif
+    for (k = net->level[l]; k < net->level[l + 1]; k++) {
+      i = net->seq[k];
+      seg = cnet->seg[i];
+      p = &(seg->temp);
+
+      if (net->upstart[i] == net->upstart[i + 1]) {
+	/* headwater: Mohseni temperature of the smoothed air temperature */
+	p->TSmooth = (1. - p->Smooth) * p->TSmooth + p->Smooth * seg->force->ATP;
+	TIn = p->Mu + p->Alpha / (1. + exp(p->Gamma * (p->Beta - p->TSmooth)));
+      }
+      else {
+	/* confluence: mixing of the upstream outflows */
+	qsum = 0.0;
+	tsum = 0.0;
+	for (j = net->upstart[i]; j < net->upstart[i + 1]; j++) {
+	  up = cnet->seg[net->upidx[j]];
+	  q = up->route->outflow / Dt * CFS_PER_CMS;
+	  if (q < STREAMTEMP_QMIN)
+	    q = STREAMTEMP_QMIN;
+	  qsum += q;
+	  tsum += q * up->temp.TOut;
+	}
+	TIn = tsum / qsum;
+      }
+
+      StreamTempSegment(seg, TIn, Dt);
+    }
+  }
+}
+
+/*****************************************************************************
+  StreamTempSegment()
+
+  Temperature at the outlet of a segment at the end of the step, with the
+  inlet temperature TIn at the end of the step
+*****************************************************************************/
+static void StreamTempSegment(Channel *seg, float TIn, int Dt)
+{
+  CHANTEMP *p = &(seg->temp);
+  float qin, qout, qavg;
+  float u, depth, length;
+  float travel, heat, h;
+  float T;
+  float s;
+  int n, nsub;
+
+  /* flows in cfs, with the lower bounds of Create_File and RBM */
+  qin = seg->route->inflow / Dt * CFS_PER_CMS;
+  qout = seg->route->outflow / Dt * CFS_PER_CMS;
+  if (qout < STREAMTEMP_QMIN)
+    qout = STREAMTEMP_QMIN;
+  if (qin < STREAMTEMP_QMIN)
+    qin = STREAMTEMP_QMIN;
+  if (qin < 0.5)
+    qin = qout;
+  qavg = 0.5 * (qin + qout);
+
+  /* velocity (ft/s) and depth (ft) from the Leopold coefficients */
+  u = p->Ua * pow(qavg, p->Ub);
+  if (u < p->Umin)
+    u = p->Umin;
+  depth = p->Da * pow(qavg, p->Db);
+  if (depth < p->Dmin)
+    depth = p->Dmin;
+
+  length = seg->length * FT_PER_M;
+  travel = length / u;
+
+  /* trace the water at the outlet back over one step */
+  if (travel < Dt) {
+    /* it entered during the step */
+    T = p->TIn + (TIn - p->TIn) * (1. - travel / Dt);
+    heat = travel;
+  }
+  else {
+    /* it was in the segment at the start of the step */
+    s = 1. - u * Dt / length;
+    T = p->TIn + s * (p->TOut - p->TIn);
+    heat = Dt;
+  }
+
+  nsub = (int) ceil(STREAMTEMP_NDELTA * heat / travel);
+  if (nsub < 1)
+    nsub = 1;
+  h = heat / nsub;
+  for (n = 0; n < nsub; n++) {
+    T += StreamHeatFlux(T, seg) / (depth * RFAC) * h;
+    if (T < 0.0)
+      T = 0.0;
+  }
+  if (T < STREAMTEMP_TMIN)
+    T = STREAMTEMP_TMIN;
+
+  p->TIn = TIn;
+  p->TOut = T;
+}
+
+/*****************************************************************************
+  StreamHeatFlux()
+
+  Net heat flux (kcal/m2/s) into the water surface at temperature T, the
+  mean of the fluxes at T - 0.5 and T + 0.5 as in SUBROUTINE ENERGY of RBM
+*****************************************************************************/
+static float StreamHeatFlux(float T, Channel *seg)
+{
+  const float evrate = 1.5e-9;
+  const float pf = 0.640;
+  float qns, qna, ea;
+  float Tfit, E0, rb, lvp, qevap, qconv, qws;
+  float q = 0.0;
+  int i;
+
+  qns = seg->force->NSW * KCAL_PER_J;
+  qna = seg->force->NLW * KCAL_PER_J;
+  ea = seg->force->VP * MB_PER_PA;
+
+  for (i = 0; i < 2; i++) {
+    Tfit = (i == 0) ? T - 0.5 : T + 0.5;
+    E0 = 2.1718E8 * exp(-4157.0 / (Tfit + 239.09));
+    rb = pf * (seg->force->ATP - Tfit);
+    lvp = 597.0 - 0.57 * Tfit;
+    qevap = 1000. * lvp * evrate * seg->force->WND;
+    if (qevap < 0.0)
+      qevap = 0.0;
+    qconv = rb * qevap;
+    qevap = qevap * (E0 - ea);
+    qws = 6.693E-2 + 1.471E-3 * Tfit;
+    q += qns + 0.97 * qna - qws - qevap + qconv;
+  }
+
+  return 0.5 * q;
+}
+
+/*****************************************************************************
+  SaveStreamTemp()
+
+  Writes the outlet temperature of every segment to Stream.Temp, one line
+  per time step, after a line with the segment ids at the first step
+*****************************************************************************/
+int SaveStreamTemp(char *tstring, Channel *net, FILE *out, int flag)
+{
+  int err = 0;
+  Channel *seg;
+
+  if (flag == 1) {
+    fprintf(out, "DATE ");
+    for (seg = net; seg != NULL; seg = seg->next)
+      fprintf(out, "%8d ", seg->id);
+    fprintf(out, "\n");
+  }
+
+  if (fprintf(out, "%15s ", tstring) == EOF)
+    err++;
+  for (seg = net; seg != NULL; seg = seg->next) {
+    if (fprintf(out, "%8.3f ", seg->temp.TOut) == EOF)
+      err++;
+  }
+  if (fprintf(out, "\n") == EOF)
+    err++;
+
+  if (err)
+    error_handler(ERRHDL_ERROR, "SaveStreamTemp: write error:%s",
+		  strerror(errno));
+
+  return (err);
+}
+
+/*****************************************************************************
+  FreeStreamTemp()
+*****************************************************************************/
+void FreeStreamTemp(CHANNEL *channel)
+{
+  STREAMTEMPNET *net = channel->temp_net;
+
+  if (net != NULL) {
+    free(net->level);
+    free(net->seq);
+    free(net->upstart);
+    free(net->upidx);
+    free(net);
+    channel->temp_net = NULL;
+  }
+}
@@ -7,10 +7,11 @@
  * E-MAIL:       nijssen@u.washington.edu
  * ORIG-DATE:    Apr-1996
  * DESCRIPTION:  Calculate surface energy balance.  This group of functions
- *               is used by the iterative Brent method to determine the
- *               surface temperature 
+ *               is used by the iterative Brent and Newton-Raphson methods
+ *               to determine the surface temperature 
  * DESCRIP-END.
  * FUNCTIONS:    SurfaceEnergyBalance()
+ *               SurfaceEnergyBalanceParams()
  * COMMENTS:
  * $Id: SurfaceEnergyBalance.c,v 1.4 2003/07/01 21:26:26 olivier Exp $     
  */
@@ -43,92 +44,106 @@
 *****************************************************************************/
 float SurfaceEnergyBalance(float TSurf, va_list ap)
 {
-  /* start of list of arguments in variable argument list */
+  SURFEBPARAMS Params;		/* arguments in variable argument list */
 
-  int Dt;			/* Model time step (seconds) */
-  float Ra;			/* Aerodynamic resistance (s/m) */
-  float Z;			/* Reference height (m) */
-  float Displacement;		/* Displacement height (m) */
-  float Z0;			/* Surface roughness (m) */
-  float Wind;			/* Wind speed (m/s) */
-  float ShortRad;		/* Net incident shortwave radiation (W/m2) */
-  float LongRadIn;		/* Incoming longwave radiation (W/m2) */
-  float AirDens;		/* Density of air (kg/m3) */
-  float Lv;			/* Latent heat of vaporization (J/kg3) */
-  float ETot;			/* Total evapotranspiration (m) */
-  float Kt;			/* Effective soil thermal conductivity 
-				   (W/(m*K)) */
-  float ChSoil;			/* Soil thermal capacity (J/(kg*K)) */
-  float Porosity;		/* Porosity of upper soil layer */
-  float MoistureContent;	/* Moisture content of upper soil layer */
-  float Depth;			/* Depth of soil heat profile (m) */
-  float Tair;			/* Air temperature (C) */
-  float TSoilUpper;		/* Soil temperature in upper layer (C) */
-  float TSoilLower;		/* Soil temperature at Depth (C) */
-  float OldTSurf;		/* Surface temperature during previous time
-				   step */
-  float MeltEnergy;		/* Energy used to melt/refreeze snow pack 
-				   (W/m2) */
+  /* Assign the elements of the array to the appropriate variables.  The list
+     is traversed as if the elements are doubles, because:
 
-  /* end of list of arguments in variable argument list */
+     In the variable-length part of variable-length argument lists, the old
+     ``default argument promotions'' apply: arguments of type float are
+     always promoted (widened) to type double, and types char and short int
+     are promoted to int. Therefore, it is never correct to invoke
+     va_arg(argp, float); instead you should always use va_arg(argp,
+     double). 
 
+     (quoted from the comp.lang.c FAQ list)
+   */
+
+  Params.Dt = va_arg(ap, int);
+  Params.Ra = (float) va_arg(ap, double);
+  Params.Z = (float) va_arg(ap, double);
+  Params.Displacement = (float) va_arg(ap, double);
+  Params.LogZ = va_arg(ap, double);
+  Params.Wind = (float) va_arg(ap, double);
+  Params.ShortRad = (float) va_arg(ap, double);
+  Params.LongRadIn = (float) va_arg(ap, double);
+  Params.AirDens = (float) va_arg(ap, double);
+  Params.Lv = (float) va_arg(ap, double);
+  Params.ETot = (float) va_arg(ap, double);
+  Params.Kt = (float) va_arg(ap, double);
+  Params.HeatCapacity = (float) va_arg(ap, double);
+  Params.Depth = (float) va_arg(ap, double);
+  Params.Tair = (float) va_arg(ap, double);
+  Params.TSoilLower = (float) va_arg(ap, double);
+  Params.OldTSurf = (float) va_arg(ap, double);
+  Params.MeltEnergy = (float) va_arg(ap, double);
+
+  return SurfaceEnergyBalanceParams(TSurf, &Params, NULL);
+}
+
+/*****************************************************************************
+  Function name: SurfaceEnergyBalanceParams()
+
+  Purpose      : Calculate the surface energy balance in the absence of snow
+                 and its derivative with respect to the surface temperature
+
+  Required     :
+    float TSurf           - new estimate of effective surface temperature
+    void *Params          - Pointer to a SURFEBPARAMS structure with the 
+                            remaining arguments of SurfaceEnergyBalance()
+    float *Derivative     - Derivative of the rest term with respect to 
+                            TSurf, not calculated if NULL
+
+  Returns      :
+    float RestTerm        - Rest term in the energy balance
+
+  Modifies     : *Derivative
+
+  Comments     : Used directly by RootNewton() and through 
+                 SurfaceEnergyBalance() by RootBrent()
+*****************************************************************************/
+float SurfaceEnergyBalanceParams(float TSurf, void *Params, float *Derivative)
+{
+  SURFEBPARAMS *P;		/* arguments */
+  float Correction;		/* stability correction */
+  float dCorrection;		/* derivative of Correction */
+  float dRa;			/* derivative of Ra with respect to TMean */
   float GroundHeat;		/* ground heat exchange at surface (W/m2) */
-  float HeatCapacity;		/* soil heat capacity (J/(m3*C) */
   float HeatStorageChange;	/* change in ground heat storage (W/m2) */
   float LatentHeat;		/* latent heat exchange at surface (W/m2) */
   float LongRadOut;		/* long wave radiation emitted by surface
 				   (W/m2) */
   float NetRad;			/* net radiation exchange at surface (W/m2) */
+  float Ra;			/* Aerodynamic resistance (s/m) */
   float RestTerm;		/* rest term in surface energy balance
 				   (W/m2) */
   float SensibleHeat;		/* sensible heat exchange at surface (W/m2) */
   float TMean;			/* Mean temperature during interval (C) */
   double Tmp;			/* temporary variable */
 
-  /* Assign the elements of the array to the appropriate variables.  The list
-     is traversed as if the elements are doubles, because:
-
-     In the variable-length part of variable-length argument lists, the old
-     ``default argument promotions'' apply: arguments of type float are
-     always promoted (widened) to type double, and types char and short int
-     are promoted to int. Therefore, it is never correct to invoke
-     va_arg(argp, float); instead you should always use va_arg(argp,
-     double). 
-
-     (quoted from the comp.lang.c FAQ list)
-   */
-
-  Dt = va_arg(ap, int);
-  Ra = (float) va_arg(ap, double);
-  Z = (float) va_arg(ap, double);
-  Displacement = (float) va_arg(ap, double);
-  Z0 = (float) va_arg(ap, double);
-  Wind = (float) va_arg(ap, double);
-  ShortRad = (float) va_arg(ap, double);
-  LongRadIn = (float) va_arg(ap, double);
-  AirDens = (float) va_arg(ap, double);
-  Lv = (float) va_arg(ap, double);
-  ETot = (float) va_arg(ap, double);
-  Kt = (float) va_arg(ap, double);
-  ChSoil = (float) va_arg(ap, double);
-  Porosity = (float) va_arg(ap, double);
-  MoistureContent = (float) va_arg(ap, double);
-  Depth = (float) va_arg(ap, double);
-  Tair = (float) va_arg(ap, double);
-  TSoilUpper = (float) va_arg(ap, double);
-  TSoilLower = (float) va_arg(ap, double);
-  OldTSurf = (float) va_arg(ap, double);
-  MeltEnergy = (float) va_arg(ap, double);
+  P = (SURFEBPARAMS *) Params;
 
   /* In this routine transport of energy to the surface is considered 
      positive */
 
-  TMean = 0.5 * (OldTSurf + TSurf);
+  TMean = 0.5 * (P->OldTSurf + TSurf);
 
   /* Apply the stability correction to the aerodynamic resistance */
 
-  if (Wind > 0.0)
-    Ra /= StabilityCorrection(Z, Displacement, TMean, Tair, Wind, Z0);
+  Ra = P->Ra;
+  dRa = 0.0;
+  if (P->Wind > 0.0) {
+    if (Derivative == NULL)
+      Ra /= StabilityCorrection(P->Z, P->Displacement, TMean, P->Tair,
+				P->Wind, P->LogZ);
+    else {
+      Correction = StabilityCorrectionDeriv(P->Z, P->Displacement, TMean,
+					    P->Tair, P->Wind, P->LogZ,
+					    &dCorrection);
+      Ra /= Correction;
+      dRa = -Ra * dCorrection / Correction;
+    }
+  }
   else
     Ra = DHSVM_HUGE;
 
@@ -136,38 +151,41 @@ float SurfaceEnergyBalance(float TSurf, va_list ap)
 
   Tmp = TMean + 273.15;
   LongRadOut = STEFAN * (Tmp * Tmp * Tmp * Tmp);
-  NetRad = ShortRad + LongRadIn - LongRadOut;
+  NetRad = P->ShortRad + P->LongRadIn - LongRadOut;
 
   /* Calculate the sensible heat flux */
 
-  SensibleHeat = AirDens * CP * (Tair - TMean) / Ra;
+  SensibleHeat = P->AirDens * CP * (P->Tair - TMean) / Ra;
 
   /* Calculate the latent heat flux */
 
-  LatentHeat = -(Lv * ETot) / Dt * WATER_DENSITY;
+  LatentHeat = -(P->Lv * P->ETot) / P->Dt * WATER_DENSITY;
 
   /* Calculate the ground heat flux */
 
-  GroundHeat = Kt * (TSoilLower - TMean) / Depth;
+  GroundHeat = P->Kt * (P->TSoilLower - TMean) / P->Depth;
 
   /* Calculate the change in the ground heat storage in the upper 
-     0.1 m of the soil */
+     0.1 m of the soil, whose heat capacity does not depend on TSurf and is
+     computed once by SensibleHeatFlux() */
 
-  HeatCapacity = (1 - Porosity) * ChSoil;
-  if (TSoilUpper >= 0.0)
-    HeatCapacity += MoistureContent * CH_WATER;
-  else
-    HeatCapacity += MoistureContent * CH_ICE;
-
-  HeatStorageChange = (HeatCapacity * (OldTSurf - TMean) * DZ_TOP) / Dt;
+  HeatStorageChange = (P->HeatCapacity * (P->OldTSurf - TMean) * DZ_TOP) / P->Dt;
 
   /* Calculate the net energy exchange at the surface.  The left hand side of 
      the equation should go to zero for the balance to close, so we want to 
      minimize the absolute value of the left hand side */
 
   RestTerm =
-    MeltEnergy + NetRad + SensibleHeat + LatentHeat +
+    P->MeltEnergy + NetRad + SensibleHeat + LatentHeat +
     GroundHeat + HeatStorageChange;
 
+  /* dTMean/dTSurf = 0.5 */
+  if (Derivative != NULL)
+    *Derivative = 0.5 * (-4 * STEFAN * Tmp * Tmp * Tmp -
+			 P->AirDens * CP * (1 / Ra + (P->Tair - TMean) * dRa /
+					    (Ra * Ra)) -
+			 P->Kt / P->Depth - 
+			 P->HeatCapacity * DZ_TOP / P->Dt);
+
   return RestTerm;
 }
@@ -0,0 +1,337 @@
+/*
+ * SUMMARY:      Telemetry.c - Progress and throughput records of a run
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Every TELEMETRY INTERVAL wall clock seconds of the time loop
+ *               writes the simulated time, the steps done, the steps per
+ *               second, a moving average of the simulated days per wall
+ *               clock hour, the estimated time to the end, the resident set
+ *               of the process and the share of each phase of the time
+ *               step to OPTIONS TELEMETRY FILE, so that a scheduler or a
+ *               dashboard can follow long runs.
+ * DESCRIP-END.
+ * FUNCTIONS:    InitTelemetry()
+ *               TelemetryStep()
+ *               ForkTelemetry()
+ *               CloseTelemetry()
+ *               OpenTelemetry()
+ *               WriteRecord()
+ *               ResidentBytes()
+ * COMMENTS:     With TELEMETRY FORMAT = JSON each record is a line of JSON
+ *               appended to the file, and the last one is written at the
+ *               end of the run with "done": true.  With TELEMETRY FORMAT =
+ *               PROMETHEUS the file holds the latest values as gauges in
+ *               the text format of the node exporter textfile collector.
+ *               It is written to FILE.tmp and renamed, so the collector
+ *               never reads half a file.
+ *
+ *               Between the records a time step only reads the wall clock.
+ *               The average of the throughput is exponential, with a time
+ *               constant of five intervals and at least a minute, so that a
+ *               slow step (a new month, a dump) does not swing the
+ *               estimated time to the end.  The shares of the phases are
+ *               those of the wall clock time since the previous record and
+ *               need a build with HAVE_PROFILE.  The resident set is read
+ *               from /proc/self/statm, or is the peak resident set from
+ *               getrusage() outside Linux.
+ *
+ *               Ensemble members and forked branches write to a file with
+ *               the member or branch number appended, as the trace does
+ *               (Trace.c).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef HAVE_GETRUSAGE
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "profile.h"
+#include "telemetry.h"
+
+int TelemetryOn = FALSE;
+
+static FILE *Stream = NULL;		/* JSON lines, NULL for PROMETHEUS */
+static char BaseName[BUFSIZE + 1];	/* OPTIONS TELEMETRY FILE */
+static char FileName[BUFSIZE + 1];	/* with the rank or branch appended */
+static int Format = TELEMETRY_JSON;
+static double Interval = 10.0;		/* wall clock seconds between records */
+static double Tau = 60.0;		/* time constant of the average (s) */
+static int TotalSteps = 0;		/* steps of the run */
+static int Dt = 3600;			/* model time step (s) */
+static double Origin = 0.0;		/* start of the time loop */
+static double Next = 0.0;		/* wall clock time of the next record */
+static double LastWall = 0.0;		/* of the previous record */
+static int LastStep = 0;
+static double Rate = -1.0;		/* average simulated days per wall
+					   clock hour, -1 before the first */
+#ifdef HAVE_PROFILE
+static double LastPhase[NPHASES];	/* ProfileTimes() at the previous */
+static double LastLoop = 0.0;		/* record */
+#endif
+
+static void OpenTelemetry(void);
+static void WriteRecord(int Step, DATE *Current, double Now, int Done);
+static double ResidentBytes(void);
+
+/*****************************************************************************
+  OpenTelemetry()
+*****************************************************************************/
+static void OpenTelemetry(void)
+{
+  if (Format == TELEMETRY_JSON && !(Stream = fopen(FileName, "w")))
+    ReportError(FileName, 3);
+}
+
+/*****************************************************************************
+  InitTelemetry()
+
+  Starts the records with OPTIONS TELEMETRY FILE (nothing if it is empty).
+  NSteps is the number of time steps of the run, Dt the time step (s).
+*****************************************************************************/
+void InitTelemetry(OPTIONSTRUCT *Options, int NSteps, int TimeStep)
+{
+  if (Options->TelemetryFile[0] == '\0')
+    return;
+
+  strncpy(BaseName, Options->TelemetryFile, BUFSIZE);
+  BaseName[BUFSIZE] = '\0';
+  strcpy(FileName, BaseName);
+  Format = Options->TelemetryFormat;
+  OpenTelemetry();
+
+  Interval = Options->TelemetryInterval;
+  Tau = (5.0 * Interval > 60.0) ? 5.0 * Interval : 60.0;
+  TotalSteps = NSteps;
+  Dt = TimeStep;
+  Origin = WallClock();
+  LastWall = Origin;
+  Next = Origin + Interval;
+  LastStep = 0;
+  Rate = -1.0;
+#ifdef HAVE_PROFILE
+  memset(LastPhase, 0, sizeof(LastPhase));
+  LastLoop = 0.0;
+#endif
+  TelemetryOn = TRUE;
+}
+
+/*****************************************************************************
+  TelemetryStep()
+
+  Called after Step time steps, at the simulated time Current, writes a
+  record if TELEMETRY INTERVAL has passed since the previous one
+*****************************************************************************/
+void TelemetryStep(int Step, DATE *Current)
+{
+  double Now = WallClock();
+
+  if (Now < Next)
+    return;
+  WriteRecord(Step, Current, Now, FALSE);
+  Next = Now + Interval;
+}
+
+/*****************************************************************************
+  ForkTelemetry()
+
+  With Branch < 0 the records are flushed before the process forks.  Branch
+  >= 0 is called in the child, which continues in a file of its own with
+  the branch or ensemble member number appended.
+*****************************************************************************/
+void ForkTelemetry(int Branch)
+{
+  if (!TelemetryOn)
+    return;
+  if (Branch < 0) {
+    if (Stream != NULL)
+      fflush(Stream);
+    return;
+  }
+  if (Stream != NULL)
+    fclose(Stream);
+  Stream = NULL;
+  snprintf(FileName, BUFSIZE + 1, "%s.%d", BaseName, Branch + 1);
+  OpenTelemetry();
+}
+
+/*****************************************************************************
+  CloseTelemetry()
+
+  Writes the last record, after Step time steps, and closes the file
+*****************************************************************************/
+void CloseTelemetry(int Step, DATE *Current)
+{
+  if (!TelemetryOn)
+    return;
+  WriteRecord(Step, Current, WallClock(), TRUE);
+  if (Stream != NULL)
+    fclose(Stream);
+  Stream = NULL;
+  TelemetryOn = FALSE;
+}
+
+/*****************************************************************************
+  ResidentBytes()
+
+  Resident set of the process (bytes), -1 if it is not known
+*****************************************************************************/
+static double ResidentBytes(void)
+{
+#ifdef HAVE_GETRUSAGE
+  struct rusage Usage;
+  FILE *Statm;
+  long Size;
+  long Resident;
+  int N = 0;
+
+  if ((Statm = fopen("/proc/self/statm", "r")) != NULL) {
+    N = fscanf(Statm, "%ld %ld", &Size, &Resident);
+    fclose(Statm);
+    if (N == 2)
+      return (double) Resident * sysconf(_SC_PAGESIZE);
+  }
+  /* ru_maxrss is in kB on Linux */
+  if (getrusage(RUSAGE_SELF, &Usage) == 0)
+    return Usage.ru_maxrss * 1024.;
+#endif
+  return -1.0;
+}
+
+/*****************************************************************************
+  WriteRecord()
+
+  Writes the values at the wall clock time Now, after Step time steps.  Done
+  is TRUE for the last record of the run.
+*****************************************************************************/
+static void WriteRecord(int Step, DATE *Current, double Now, int Done)
+{
+  char TmpName[BUFSIZE + 5];
+  char Date[32];
+#ifdef HAVE_PROFILE
+  double Fraction[NPHASES];
+  int NFractions = 0;
+  int i;
+#endif
+  double StepsPerSecond = 0.0;
+  double DWall = Now - LastWall;
+  double Eta = -1.0;
+  double Rss;
+  double Weight;
+  FILE *Out;
+
+  /* a restored state (dhsvm_restore) starts the rates again */
+  if (Step < LastStep)
+    LastStep = Step;
+  if (DWall > 0.0 && Step > LastStep) {
+    StepsPerSecond = (Step - LastStep) / DWall;
+    Weight = 1.0 - exp(-DWall / Tau);
+    if (Rate < 0.0)
+      Rate = StepsPerSecond * Dt * 3600. / 86400.;
+    else
+      Rate += Weight * (StepsPerSecond * Dt * 3600. / 86400. - Rate);
+  }
+  if (Done)
+    Eta = 0.0;
+  else if (Rate > 0.0)
+    Eta = (double) (TotalSteps - Step) * Dt / 86400. / Rate * 3600.;
+  if (Eta < 0.0 && Rate > 0.0)
+    Eta = 0.0;
+  Rss = ResidentBytes();
+
+#ifdef HAVE_PROFILE
+  {
+    double PhaseTimes[NPHASES];
+    double Loop;
+
+    ProfileTimes(PhaseTimes, &Loop);
+    if (Loop > LastLoop) {
+      for (i = 0; i < NPHASES; i++)
+	Fraction[i] = (PhaseTimes[i] - LastPhase[i]) / (Loop - LastLoop);
+      NFractions = NPHASES;
+    }
+    memcpy(LastPhase, PhaseTimes, sizeof(PhaseTimes));
+    LastLoop = Loop;
+  }
+#endif
+
+  snprintf(Date, sizeof(Date), "%04d-%02d-%02dT%02d:%02d:%02d",
+	   Current->Year, Current->Month, Current->Day, Current->Hour,
+	   Current->Min, Current->Sec);
+
+  if (Format == TELEMETRY_JSON) {
+    fprintf(Stream, "{\"time\":\"%s\",\"step\":%d,\"steps\":%d,"
+	    "\"wall_s\":%.3f,\"steps_per_s\":%.6g,"
+	    "\"sim_days_per_wall_hour\":%.6g,", Date, Step, TotalSteps,
+	    Now - Origin, StepsPerSecond, (Rate > 0.0) ? Rate : 0.0);
+    if (Eta >= 0.0)
+      fprintf(Stream, "\"eta_s\":%.1f,", Eta);
+    else
+      fprintf(Stream, "\"eta_s\":null,");
+    if (Rss >= 0.0)
+      fprintf(Stream, "\"rss_mb\":%.1f,", Rss / 1048576.);
+    else
+      fprintf(Stream, "\"rss_mb\":null,");
+    fprintf(Stream, "\"phases\":{");
+#ifdef HAVE_PROFILE
+    for (i = 0; i < NFractions; i++)
+      fprintf(Stream, "%s\"%s\":%.4f", (i > 0) ? "," : "",
+	      ProfilePhaseName(i), Fraction[i]);
+#endif
+    fprintf(Stream, "}%s}\n", Done ? ",\"done\":true" : "");
+    fflush(Stream);
+  }
+  else {
+    snprintf(TmpName, sizeof(TmpName), "%s.tmp", FileName);
+    if (!(Out = fopen(TmpName, "w")))
+      ReportError(TmpName, 3);
+    fprintf(Out, "# HELP dhsvm_step Time steps done\n"
+	    "# TYPE dhsvm_step gauge\ndhsvm_step %d\n", Step);
+    fprintf(Out, "# HELP dhsvm_steps_total Time steps of the run\n"
+	    "# TYPE dhsvm_steps_total gauge\ndhsvm_steps_total %d\n",
+	    TotalSteps);
+    fprintf(Out, "# HELP dhsvm_simulated_seconds Simulated time done\n"
+	    "# TYPE dhsvm_simulated_seconds gauge\n"
+	    "dhsvm_simulated_seconds %.0f\n", (double) Step * Dt);
+    fprintf(Out, "# HELP dhsvm_steps_per_second Steps per wall clock second "
+	    "since the previous record\n"
+	    "# TYPE dhsvm_steps_per_second gauge\n"
+	    "dhsvm_steps_per_second %.6g\n", StepsPerSecond);
+    fprintf(Out, "# HELP dhsvm_simulated_days_per_wall_hour Moving average "
+	    "of the throughput\n"
+	    "# TYPE dhsvm_simulated_days_per_wall_hour gauge\n"
+	    "dhsvm_simulated_days_per_wall_hour %.6g\n",
+	    (Rate > 0.0) ? Rate : 0.0);
+    if (Eta >= 0.0)
+      fprintf(Out, "# HELP dhsvm_eta_seconds Estimated wall clock time to "
+	      "the end\n# TYPE dhsvm_eta_seconds gauge\n"
+	      "dhsvm_eta_seconds %.1f\n", Eta);
+    if (Rss >= 0.0)
+      fprintf(Out, "# HELP dhsvm_rss_bytes Resident set of the process\n"
+	      "# TYPE dhsvm_rss_bytes gauge\ndhsvm_rss_bytes %.0f\n", Rss);
+    fprintf(Out, "# HELP dhsvm_done 1 at the end of the run\n"
+	    "# TYPE dhsvm_done gauge\ndhsvm_done %d\n", Done ? 1 : 0);
+#ifdef HAVE_PROFILE
+    if (NFractions > 0)
+      fprintf(Out, "# HELP dhsvm_phase_fraction Share of the wall clock time "
+	      "since the previous record\n"
+	      "# TYPE dhsvm_phase_fraction gauge\n");
+    for (i = 0; i < NFractions; i++)
+      fprintf(Out, "dhsvm_phase_fraction{phase=\"%s\"} %.4f\n",
+	      ProfilePhaseName(i), Fraction[i]);
+#endif
+    if (fclose(Out) != 0 || rename(TmpName, FileName) != 0)
+      ReportError(FileName, 3);
+  }
+
+  LastWall = Now;
+  LastStep = Step;
+}
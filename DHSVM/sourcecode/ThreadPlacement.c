@@ -0,0 +1,280 @@
+/*
+ * SUMMARY:      ThreadPlacement.c - Placement of the threads and the maps on
+ *               the processors and memory of a NUMA node
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Pins the threads of the cell loops to processors, and lets
+ *               each thread touch the pages of the maps it works on first,
+ *               so that the operating system puts them in its local memory
+ * DESCRIP-END.
+ * FUNCTIONS:    InitThreadPlacement()
+ *               PinThreads()
+ *               UnpinThread()
+ *               SetRowOwners()
+ *               FirstTouchRows()
+ *               FirstTouchBlock()
+ *               HugePageHint()
+ * COMMENTS:     Linux puts a page in the memory of the socket whose
+ *               processor writes it first.  The maps are allocated with
+ *               calloc(), which leaves large allocations untouched, and
+ *               the first touch functions write them in the threads that
+ *               do their cells in the cell loops before the serial
+ *               initialization writes them from the main thread.
+ *
+ *               Thread p works on the active cells from p * NumActive /
+ *               NThreads on, as in the fixed blocks of InitTiles().  A map
+ *               row belongs to the thread of its first active cell.  With
+ *               CELL TILE SIZE the tiles are balanced by their run time, and
+ *               the blocks are an approximation.
+ *
+ *               The pages are placed with NUMBER OF THREADS > 1.  This only
+ *               pays off fully if the threads do not move between sockets,
+ *               see THREAD PINNING = CLOSE or SPREAD.  The pinning relies on
+ *               the OpenMP runtime keeping the same system thread for each
+ *               thread number from one parallel region to the next.
+ */
+
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+/* allocations smaller than this do not get the huge page hint */
+#define HUGEPAGE_MIN (4 << 20)
+
+static int NThreads = 1;		/* threads of the cell loops */
+static int FirstTouch = FALSE;		/* TRUE if pages are placed */
+static int HugePages = FALSE;		/* TRUE if large maps get huge pages */
+#if defined(__linux__) && defined(HAVE_OPENMP)
+static cpu_set_t ProcessCpus;		/* processors of the run, before the
+					   threads are pinned */
+static int Pinned = FALSE;
+#endif
+
+static void PinThreads(int Mode);
+static void SetRowOwners(MAPSIZE *Map, int *Owner);
+
+/*****************************************************************************
+  InitThreadPlacement()
+
+  Pins the threads with OPTIONS THREAD PINNING, and sets up the first touch
+  and huge page hints for the maps allocated after it.  Must be called
+  before the maps are allocated.
+*****************************************************************************/
+void InitThreadPlacement(OPTIONSTRUCT *Options)
+{
+  NThreads = Options->NThreads;
+  HugePages = Options->HugePages;
+  FirstTouch = (NThreads > 1);
+  if (Options->ThreadPinning != PIN_NONE && NThreads > 1)
+    PinThreads(Options->ThreadPinning);
+}
+
+/*****************************************************************************
+  PinThreads()
+
+  Binds thread p of the cell loops to one of the processors the process
+  may run on: processor p with CLOSE, or processors spread evenly over all
+  of them with SPREAD, as OMP_PROC_BIND does.
+*****************************************************************************/
+static void PinThreads(int Mode)
+{
+#if defined(__linux__) && defined(HAVE_OPENMP)
+  cpu_set_t Allowed;
+  int *Cpus;
+  int NCpus;
+  int i;
+
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &Allowed) != 0) {
+    printf("WARNING: cannot get the processors of the run, threads are not "
+	   "pinned\n");
+    return;
+  }
+  ProcessCpus = Allowed;
+  Pinned = TRUE;
+  if (!(Cpus = (int *) calloc(CPU_SETSIZE, sizeof(int))))
+    ReportError("PinThreads", 1);
+  NCpus = 0;
+  for (i = 0; i < CPU_SETSIZE; i++)
+    if (CPU_ISSET(i, &Allowed))
+      Cpus[NCpus++] = i;
+
+#pragma omp parallel num_threads(NThreads)
+  {
+    cpu_set_t Own;
+    int p;
+
+    p = omp_get_thread_num();
+    if (Mode == PIN_SPREAD)
+      p = (int) (((long) p * NCpus) / NThreads);
+    CPU_ZERO(&Own);
+    CPU_SET(Cpus[p % NCpus], &Own);
+    sched_setaffinity(0, sizeof(cpu_set_t), &Own);
+  }
+
+  printf("Pinned %d threads to %s processors of %d\n", NThreads,
+	 (Mode == PIN_SPREAD) ? "spread" : "consecutive", NCpus);
+  free(Cpus);
+#else
+  printf("WARNING: THREAD PINNING needs OpenMP on Linux, threads are not "
+	 "pinned\n");
+#endif
+}
+
+/*****************************************************************************
+  UnpinThread()
+
+  Lets the calling thread run on all the processors of the run again.  For
+  the threads that work next to the cell loop threads, which inherit the
+  processor of the main thread when it is pinned.
+*****************************************************************************/
+void UnpinThread(void)
+{
+#if defined(__linux__) && defined(HAVE_OPENMP)
+  if (Pinned)
+    sched_setaffinity(0, sizeof(cpu_set_t), &ProcessCpus);
+#endif
+}
+
+/*****************************************************************************
+  SetRowOwners()
+
+  Owner[y] is the thread that works on row y, from the active cells if they
+  are known and from equal row blocks otherwise
+*****************************************************************************/
+static void SetRowOwners(MAPSIZE *Map, int *Owner)
+{
+  int k;
+  int p;
+  int y;
+
+  if (Map->ActiveCells == NULL || Map->NumActive == 0) {
+    for (y = 0; y < Map->NY; y++)
+      Owner[y] = (int) (((long) y * NThreads) / Map->NY);
+    return;
+  }
+
+  for (y = 0; y < Map->NY; y++)
+    Owner[y] = -1;
+  for (p = 0; p < NThreads; p++) {
+    for (k = (int) (((long) p * Map->NumActive) / NThreads);
+	 k < (int) (((long) (p + 1) * Map->NumActive) / NThreads); k++) {
+      y = Map->ActiveCells[k].y;
+      if (Owner[y] < 0)
+	Owner[y] = p;
+    }
+  }
+  /* rows without active cells go with the row above them */
+  for (y = 0; y < Map->NY; y++)
+    if (Owner[y] < 0)
+      Owner[y] = (y > 0) ? Owner[y - 1] : 0;
+}
+
+/*****************************************************************************
+  FirstTouchRows()
+
+  Lets the owner of each row of a map write it first.  Rows are the row
+  pointers of the map, and each row has RowBytes bytes.  Called right
+  after the map is allocated, the rows are set to zero.
+*****************************************************************************/
+void FirstTouchRows(MAPSIZE *Map, void *Rows, size_t RowBytes)
+{
+  char **Row = (char **) Rows;
+  int *Owner;
+
+  if (!FirstTouch)
+    return;
+
+  if (!(Owner = (int *) calloc(Map->NY, sizeof(int))))
+    ReportError("FirstTouchRows", 1);
+  SetRowOwners(Map, Owner);
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(NThreads)
+#endif
+  {
+    int p = 0;
+    int NActive = 1;
+    int y;
+
+#ifdef HAVE_OPENMP
+    p = omp_get_thread_num();
+    NActive = omp_get_num_threads();
+#endif
+    for (y = 0; y < Map->NY; y++)
+      if (Owner[y] % NActive == p)
+	memset(Row[y], 0, RowBytes);
+  }
+  free(Owner);
+}
+
+/*****************************************************************************
+  FirstTouchBlock()
+
+  Same as FirstTouchRows() for an array with one item of ItemSize bytes per
+  active cell, or for per cell data that is stored in active cell order
+*****************************************************************************/
+void FirstTouchBlock(void *Block, size_t NItems, size_t ItemSize)
+{
+  HugePageHint(Block, NItems * ItemSize);
+  if (!FirstTouch)
+    return;
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(NThreads)
+#endif
+  {
+    size_t First;
+    size_t Last;
+    int p = 0;
+    int NActive = 1;
+
+#ifdef HAVE_OPENMP
+    p = omp_get_thread_num();
+    NActive = omp_get_num_threads();
+#endif
+    First = (NItems * p) / NActive;
+    Last = (NItems * (p + 1)) / NActive;
+    memset((char *) Block + First * ItemSize, 0, (Last - First) * ItemSize);
+  }
+}
+
+/*****************************************************************************
+  HugePageHint()
+
+  Asks for transparent huge pages for an allocation of Bytes bytes with
+  OPTIONS HUGE PAGES.  Only has an effect before the pages are touched.
+*****************************************************************************/
+void HugePageHint(void *Block, size_t Bytes)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  uintptr_t Start;
+  uintptr_t End;
+  uintptr_t Page;
+
+  if (!HugePages || Bytes < HUGEPAGE_MIN)
+    return;
+  Page = (uintptr_t) sysconf(_SC_PAGESIZE);
+  Start = ((uintptr_t) Block + Page - 1) & ~(Page - 1);
+  End = ((uintptr_t) Block + Bytes) & ~(Page - 1);
+  if (End > Start)
+    madvise((void *) Start, End - Start, MADV_HUGEPAGE);
+#endif
+}
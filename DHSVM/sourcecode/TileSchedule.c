@@ -0,0 +1,224 @@
+/*
+ * SUMMARY:      TileSchedule.c - Load balancing of the threaded cell loops
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Splits the items of a cell loop into tiles of consecutive
+ *               items and hands the tiles to the threads
+ * DESCRIP-END.
+ * FUNCTIONS:    InitTiles()
+ *               FreeTiles()
+ *               PlanTiles()
+ *               NextTile()
+ *               TileClock()
+ * COMMENTS:     With OPTIONS CELL TILE SIZE = 0 each thread does one fixed
+ *               block of items, as with schedule(static).  Otherwise the
+ *               items are split into tiles of CELL TILE SIZE items, which
+ *               are in Map->ActiveCells order and so cover a few grid rows
+ *               each (a compact block with CELL ORDER = MORTON or TILES).
+ *               Before every pass PlanTiles() gives each thread a
+ *               range of consecutive tiles that took about the same time in
+ *               the last pass.  A thread works through its range from the
+ *               front, and when it is done it takes the last tile of the
+ *               thread with the most tiles left, until all are done.
+ *
+ *               A loop over a schedule looks like
+ *
+ *                 PlanTiles(Tiles);
+ *                 #pragma omp parallel num_threads(Tiles->NThreads)
+ *                 while ((t = NextTile(Tiles)) >= 0)
+ *                   for (i = Tiles->Start[t]; i < Tiles->Start[t + 1]; i++)
+ *                     ...
+ *
+ *               Which thread does a tile differs from pass to pass, so
+ *               sums over the items have to be kept per tile to get
+ *               results that do not depend on the scheduling.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "settings.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+
+static double TileClock(void);
+
+/*****************************************************************************
+  InitTiles()
+
+  Sets up the schedule of a loop over NItems items with NThreads threads.
+  TileSize is OPTIONS CELL TILE SIZE.
+*****************************************************************************/
+void InitTiles(TILESCHEDULE *Tiles, int NItems, int TileSize, int NThreads)
+{
+  const char *Routine = "InitTiles";
+  int t;
+
+  Tiles->NItems = NItems;
+  Tiles->NThreads = NThreads;
+  Tiles->Steal = (TileSize > 0 && NThreads > 1);
+  if (Tiles->Steal)
+    Tiles->NTiles = (NItems + TileSize - 1) / TileSize;
+  else
+    Tiles->NTiles = NThreads;
+
+  if (!(Tiles->Start = (int *) calloc(Tiles->NTiles + 1, sizeof(int))) ||
+      !(Tiles->Cost = (float *) calloc(Tiles->NTiles + 1, sizeof(float))) ||
+      !(Tiles->Head = (int *) calloc(NThreads, sizeof(int))) ||
+      !(Tiles->Tail = (int *) calloc(NThreads, sizeof(int))) ||
+      !(Tiles->Current = (int *) calloc(NThreads, sizeof(int))) ||
+      !(Tiles->Clock = (double *) calloc(NThreads, sizeof(double))))
+    ReportError((char *)Routine, 1);
+
+  for (t = 0; t <= Tiles->NTiles; t++) {
+    if (Tiles->Steal)
+      Tiles->Start[t] = (t * TileSize < NItems) ? t * TileSize : NItems;
+    else
+      Tiles->Start[t] = (int) (((long) t * NItems) / NThreads);
+  }
+  for (t = 0; t < Tiles->NTiles; t++)
+    Tiles->Cost[t] = (float) (Tiles->Start[t + 1] - Tiles->Start[t]);
+}
+
+/*****************************************************************************
+  FreeTiles()
+*****************************************************************************/
+void FreeTiles(TILESCHEDULE *Tiles)
+{
+  free(Tiles->Start);
+  free(Tiles->Cost);
+  free(Tiles->Head);
+  free(Tiles->Tail);
+  free(Tiles->Current);
+  free(Tiles->Clock);
+  Tiles->Start = NULL;
+  Tiles->Cost = NULL;
+  Tiles->Head = NULL;
+  Tiles->Tail = NULL;
+  Tiles->Current = NULL;
+  Tiles->Clock = NULL;
+  Tiles->NTiles = 0;
+}
+
+/*****************************************************************************
+  PlanTiles()
+
+  Gives each thread its tiles for the next pass.  Called outside the
+  parallel region.
+*****************************************************************************/
+void PlanTiles(TILESCHEDULE *Tiles)
+{
+  double Total;
+  double Sum;
+  int p;
+  int t;
+
+  for (p = 0; p < Tiles->NThreads; p++)
+    Tiles->Current[p] = -1;
+
+  if (!Tiles->Steal) {
+    for (p = 0; p < Tiles->NThreads; p++) {
+      Tiles->Head[p] = p;
+      Tiles->Tail[p] = p + 1;
+    }
+    return;
+  }
+
+  /* split the tiles into ranges of equal cost in the last pass */
+  Total = 0.0;
+  for (t = 0; t < Tiles->NTiles; t++)
+    Total += Tiles->Cost[t];
+  Sum = 0.0;
+  t = 0;
+  for (p = 0; p < Tiles->NThreads; p++) {
+    Tiles->Head[p] = t;
+    while (t < Tiles->NTiles &&
+	   (p == Tiles->NThreads - 1 ||
+	    Sum + 0.5 * Tiles->Cost[t] < Total * (p + 1) / Tiles->NThreads)) {
+      Sum += Tiles->Cost[t];
+      t++;
+    }
+    Tiles->Tail[p] = t;
+  }
+}
+
+/*****************************************************************************
+  TileClock()
+
+  Wall clock time (s), 0 without OpenMP
+*****************************************************************************/
+static double TileClock(void)
+{
+#ifdef HAVE_OPENMP
+  return omp_get_wtime();
+#else
+  return 0.0;
+#endif
+}
+
+/*****************************************************************************
+  NextTile()
+
+  Called by each thread in the parallel region.  Records the time of the
+  tile the calling thread has just finished, and returns the next tile for
+  it, or -1 if all tiles have been handed out.
+*****************************************************************************/
+int NextTile(TILESCHEDULE *Tiles)
+{
+  double Now;
+  int NActive;			/* threads in the parallel region */
+  int Victim;
+  int p;
+  int t;
+  int tid;
+
+  tid = 0;
+  NActive = 1;
+#ifdef HAVE_OPENMP
+  tid = omp_get_thread_num();
+  NActive = omp_get_num_threads();
+#endif
+
+  /* fixed blocks, a smaller team does the blocks of the missing threads */
+  if (!Tiles->Steal) {
+    t = Tiles->Head[tid];
+    if (t >= Tiles->NTiles)
+      return -1;
+    Tiles->Head[tid] += NActive;
+    return t;
+  }
+
+  Now = TileClock();
+  if (Tiles->Current[tid] >= 0)
+    Tiles->Cost[Tiles->Current[tid]] = (float) (Now - Tiles->Clock[tid]);
+  Tiles->Clock[tid] = Now;
+
+  t = -1;
+#ifdef HAVE_OPENMP
+#pragma omp critical (NextTile)
+#endif
+  {
+    if (Tiles->Head[tid] < Tiles->Tail[tid])
+      t = Tiles->Head[tid]++;
+    else {
+      Victim = -1;
+      for (p = 0; p < Tiles->NThreads; p++) {
+	if (Tiles->Tail[p] > Tiles->Head[p] &&
+	    (Victim < 0 || Tiles->Tail[p] - Tiles->Head[p] >
+	     Tiles->Tail[Victim] - Tiles->Head[Victim]))
+	  Victim = p;
+      }
+      if (Victim >= 0)
+	t = --Tiles->Tail[Victim];
+    }
+  }
+  Tiles->Current[tid] = t;
+  return t;
+}
@@ -0,0 +1,304 @@
+/*
+ * SUMMARY:      Trace.c - Trace of the phases and I/O of a run
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Writes spans of time to OPTIONS TRACE FILE in the Chrome
+ *               trace event format, which can be viewed with
+ *               chrome://tracing or ui.perfetto.dev
+ * DESCRIP-END.
+ * FUNCTIONS:    InitTrace()
+ *               TraceStep()
+ *               ForkTrace()
+ *               CloseTrace()
+ *               TraceBegin()
+ *               TraceEnd()
+ *               TraceClock()
+ *               TraceTrack()
+ *               OpenTrace()
+ *               WriteString()
+ * COMMENTS:     The trace is a JSON array of complete ("X") events, one per
+ *               span, with the time in microseconds since InitTrace().  The
+ *               phases of the time steps come from the profiler (Profile.c),
+ *               the map reads and writes and the met and NetCDF files from
+ *               the I/O functions, with the file name and the number of
+ *               bytes.
+ *
+ *               Each OpenMP thread has its own track, and so has the output
+ *               writer thread.  Ensemble members and forked branches write
+ *               to a file with the member or branch number appended.
+ *
+ *               With TRACE INTERVAL = N only the steps N, 2N, ... are
+ *               traced (and the initialization), so that the file stays
+ *               small for long runs.  A span is written when it ends, which
+ *               means that the spans of one track may be out of order in
+ *               the file.  The viewers sort them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+#include "settings.h"
+#include "DHSVMerror.h"
+#include "trace.h"
+
+/* track of the output writer thread, the OpenMP threads are 0, 1, ... */
+#define WRITER_TRACK 1000
+#define MAXTRACKS 256
+
+int TraceOn = FALSE;
+
+static FILE *TraceFile = NULL;
+static char TraceName[BUFSIZE + 1];	/* OPTIONS TRACE FILE */
+static int Interval = 1;		/* TRACE INTERVAL */
+static int Pid = 0;			/* process id of the events */
+static int NEvents = 0;			/* events written */
+static double Origin = 0.0;		/* start of the trace (s) */
+static char Named[MAXTRACKS + 1];	/* TRUE for the tracks with a name */
+#ifdef HAVE_PTHREAD
+static pthread_t MainThread;
+static pthread_mutex_t TraceLock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_TRACE() pthread_mutex_lock(&TraceLock)
+#define UNLOCK_TRACE() pthread_mutex_unlock(&TraceLock)
+#elif defined(HAVE_OPENMP)
+static omp_lock_t TraceLock;
+#define LOCK_TRACE() omp_set_lock(&TraceLock)
+#define UNLOCK_TRACE() omp_unset_lock(&TraceLock)
+#else
+#define LOCK_TRACE()
+#define UNLOCK_TRACE()
+#endif
+
+static double TraceClock(void);
+static int TraceTrack(void);
+static void WriteString(const char *String);
+static void OpenTrace(char *FileName);
+
+/*****************************************************************************
+  TraceClock()
+
+  Monotonic wall clock time (s)
+*****************************************************************************/
+static double TraceClock(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec Now;
+
+  clock_gettime(CLOCK_MONOTONIC, &Now);
+  return (double) Now.tv_sec + 1e-9 * Now.tv_nsec;
+#elif defined(HAVE_OPENMP)
+  return omp_get_wtime();
+#else
+  return (double) time(NULL);
+#endif
+}
+
+/*****************************************************************************
+  TraceTrack()
+
+  Track of the calling thread
+*****************************************************************************/
+static int TraceTrack(void)
+{
+  int Track = 0;
+
+#ifdef HAVE_OPENMP
+  Track = omp_get_thread_num();
+#endif
+#ifdef HAVE_PTHREAD
+  if (Track == 0 && !pthread_equal(pthread_self(), MainThread))
+    Track = WRITER_TRACK;
+#endif
+  return Track;
+}
+
+/*****************************************************************************
+  OpenTrace()
+*****************************************************************************/
+static void OpenTrace(char *FileName)
+{
+  if (!(TraceFile = fopen(FileName, "w")))
+    ReportError(FileName, 3);
+  fprintf(TraceFile, "[\n");
+  NEvents = 0;
+  memset(Named, 0, sizeof(Named));
+}
+
+/*****************************************************************************
+  InitTrace()
+
+  Starts the trace with OPTIONS TRACE FILE (nothing if FileName is empty).
+  Interval is OPTIONS TRACE INTERVAL.
+*****************************************************************************/
+void InitTrace(char *FileName, int TraceInterval)
+{
+  if (FileName == NULL || FileName[0] == '\0')
+    return;
+
+#ifdef HAVE_PTHREAD
+  MainThread = pthread_self();
+#elif defined(HAVE_OPENMP)
+  omp_init_lock(&TraceLock);
+#endif
+
+  strncpy(TraceName, FileName, BUFSIZE);
+  TraceName[BUFSIZE] = '\0';
+  OpenTrace(TraceName);
+
+  Interval = (TraceInterval > 0) ? TraceInterval : 1;
+  Origin = TraceClock();
+  TraceOn = TRUE;
+}
+
+/*****************************************************************************
+  TraceStep()
+
+  Called at the start of time step Step (0, 1, ...), records the step if it
+  is sampled with TRACE INTERVAL
+*****************************************************************************/
+void TraceStep(int Step)
+{
+  if (TraceFile != NULL)
+    TraceOn = ((Step + 1) % Interval == 0);
+}
+
+/*****************************************************************************
+  ForkTrace()
+
+  With Branch < 0 the trace is flushed before the process forks.  Branch >=
+  0 is called in the child, which continues the trace in a file of its own
+  with the branch or ensemble member number appended.  The spans so far go
+  to the file of the parent only.
+*****************************************************************************/
+void ForkTrace(int Branch)
+{
+  char Name[BUFSIZE + 1];
+
+  if (TraceFile == NULL)
+    return;
+  if (Branch < 0) {
+    fflush(TraceFile);
+    return;
+  }
+  fclose(TraceFile);
+  snprintf(Name, BUFSIZE + 1, "%s.%d", TraceName, Branch + 1);
+  OpenTrace(Name);
+}
+
+/*****************************************************************************
+  CloseTrace()
+
+  Names the tracks and ends the trace.  Called after the output writer
+  thread has finished.
+*****************************************************************************/
+void CloseTrace(void)
+{
+  int i;
+
+  if (TraceFile == NULL)
+    return;
+
+  for (i = 0; i <= MAXTRACKS; i++) {
+    if (!Named[i])
+      continue;
+    fprintf(TraceFile, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,"
+	    "\"tid\":%d,\"args\":{\"name\":", NEvents++ > 0 ? ",\n" : "",
+	    Pid, (i == MAXTRACKS) ? WRITER_TRACK : i);
+    if (i == 0)
+      fprintf(TraceFile, "\"main\"}}");
+    else if (i == MAXTRACKS)
+      fprintf(TraceFile, "\"output writer\"}}");
+    else
+      fprintf(TraceFile, "\"thread %d\"}}", i);
+  }
+  fprintf(TraceFile, "\n]\n");
+  fclose(TraceFile);
+  TraceFile = NULL;
+  TraceOn = FALSE;
+}
+
+/*****************************************************************************
+  TraceBegin()
+
+  Returns the start of a span for TraceEnd(), -1 if it is not recorded (see
+  TRACE_BEGIN())
+*****************************************************************************/
+double TraceBegin(void)
+{
+  if (!TraceOn)
+    return -1.0;
+  return TraceClock();
+}
+
+/*****************************************************************************
+  WriteString()
+
+  Writes String as a JSON string
+*****************************************************************************/
+static void WriteString(const char *String)
+{
+  const char *c;
+
+  fputc('"', TraceFile);
+  for (c = String; *c; c++) {
+    if (*c == '"' || *c == '\\')
+      fputc('\\', TraceFile);
+    if ((unsigned char) *c >= ' ')
+      fputc(*c, TraceFile);
+  }
+  fputc('"', TraceFile);
+}
+
+/*****************************************************************************
+  TraceEnd()
+
+  Writes the span from Start (TraceBegin()) to now on the track of the
+  calling thread.  FileName and Bytes are added for I/O spans, FileName is
+  NULL and Bytes < 0 for the others.
+*****************************************************************************/
+void TraceEnd(double Start, const char *Name, const char *Category,
+	      const char *FileName, double Bytes)
+{
+  double End;
+  int Track;
+
+  if (Start < 0.0 || TraceFile == NULL)
+    return;
+
+  End = TraceClock();
+  Track = TraceTrack();
+
+  LOCK_TRACE();
+  if (TraceFile != NULL) {
+    if (Track == WRITER_TRACK)
+      Named[MAXTRACKS] = TRUE;
+    else if (Track < MAXTRACKS)
+      Named[Track] = TRUE;
+    fprintf(TraceFile, "%s{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"%s\","
+	    "\"pid\":%d,\"tid\":%d,\"ts\":%.1f,\"dur\":%.1f",
+	    NEvents++ > 0 ? ",\n" : "", Name, Category, Pid, Track,
+	    1e6 * (Start - Origin), 1e6 * (End - Start));
+    if (FileName != NULL || Bytes >= 0.0) {
+      fprintf(TraceFile, ",\"args\":{");
+      if (FileName != NULL) {
+	fprintf(TraceFile, "\"file\":");
+	WriteString(FileName);
+      }
+      if (Bytes >= 0.0)
+	fprintf(TraceFile, "%s\"bytes\":%.0f", FileName != NULL ? "," : "",
+		Bytes);
+      fputc('}', TraceFile);
+    }
+    fputc('}', TraceFile);
+  }
+  UNLOCK_TRACE();
+}
@@ -11,6 +11,7 @@
 *               flow)
 * DESCRIP-END.
 * FUNCTIONS:    UnsaturatedFlow()
+*               InitDrainageTable()
 * COMMENTS: (*) Mark Wigmosta, Batelle Pacific Northwest Laboratories,
 *               ms_wigmosta@pnl.gov
 * $Id: UnsaturatedFlow.c,v 1.12 2017/10/1 Ning Exp $   
@@ -23,6 +24,8 @@
 #include "settings.h"
 #include "functions.h"
 #include "soilmoisture.h"
+#include "DHSVMerror.h"
+#include "fastmath.h"
 
 /*****************************************************************************
 Function name: UnsaturatedFlow()
@@ -48,6 +51,8 @@ soil layer (m/s)
 float *PoreDist    - Pore size distribution index for each soil layer
 float *Porosity    - Porosity of each soil layer
 float *FCap        - Field capacity of each soil layer
+FLOATTABLE *DrainTable - Brooks-Corey table for each soil layer (see 
+InitDrainageTable()), NULL to calculate the drainage exactly
 float *Perc        - Amount of water percolating from each soil layer to
 the layer below (m)
 float *PercArea    - Area of the bottom of each soil layer as a fraction
@@ -63,8 +68,12 @@ int CutBankZone    - Number of the soil layer containing the bottom of
 the cut-bank
 float BankHeight   - Distance from ground surface to channel bed or
 bottom of road-cut (m)
+int InfiltOption   - Static or dynamic infiltration
+SOILCAPACITY *Capacity - Constants of the soil column from
+InitSoilCapacity(), NULL to compute them here
 
-Returns      : void
+Returns      : int, the number of layers that drained (moisture above
+field capacity)
 
 Modifies     :
 float *TableDepth - Depth of the water table below the ground surface (m)
@@ -112,13 +121,14 @@ Changes have been made to account for the potental loss of soil storage
 in a grid cell due to a road-cut or channel.  Correction coefficents are
 calculated in AdjustStorage() and CutBankGeometry()
 *****************************************************************************/
-void UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration,
+int UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration,
   float RoadbedInfiltration, float SatFlow, int NSoilLayers,
   float TotalDepth, float Area, float *RootDepth, float *Ks,
-  float *PoreDist, float *Porosity, float *FCap,
+  float *PoreDist, float *Porosity, float *FCap, FLOATTABLE *DrainTable,
   float *Perc, float *PercArea, float *Adjust,
   int CutBankZone, float BankHeight, float *TableDepth,
-  float *Runoff, float *Moist, int InfiltOption)
+  float *Runoff, float *Moist, int InfiltOption,
+  SOILCAPACITY *Capacity)
 {
   float DeepDrainage;		/* amount of drainage from the lowest root
                                zone to the layer below it (m) */
@@ -129,11 +139,16 @@ void UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration,
   float FieldCapacity;		/* amount of water in soil at field capacity (m) */
   float MaxSoilWater;		/* maximum allowable amount of soil moiture in each layer (m) */
   float SoilWater;		    /* amount of water in each soil layer (m) */
+  int Drained = 0;		    /* number of layers that drained */
   int i;			        /* counter */
 
-  DeepLayerDepth = TotalDepth;
-  for (i = 0; i < NSoilLayers; i++)
-    DeepLayerDepth -= RootDepth[i];
+  if (Capacity != NULL)
+    DeepLayerDepth = Capacity->DeepDepth;
+  else {
+    DeepLayerDepth = TotalDepth;
+    for (i = 0; i < NSoilLayers; i++)
+      DeepLayerDepth -= RootDepth[i];
+  }
 
   /* first take care of infiltration through the roadbed/channel, then through the
   remaining surface */
@@ -165,14 +180,17 @@ void UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration,
 
     /* No movement if soil moisture is below field capacity */
     if (Moist[i] > FCap[i]) {
+      Drained++;
       Exponent = 2.0 / PoreDist[i] + 3.0;
 
       if (Moist[i] > Porosity[i])
         /* this can happen because the moisture content can exceed the
         porosity the way the algorithm is implemented */
         Drainage = Ks[i];
+      else if (DrainTable != NULL)
+        Drainage = Ks[i] * FloatInterpolate(Moist[i]/Porosity[i], &(DrainTable[i]));
       else
-        Drainage = Ks[i] * pow((double)(Moist[i]/Porosity[i]), (double)Exponent);
+        Drainage = Ks[i] * MathPow((double)(Moist[i]/Porosity[i]), (double)Exponent);
       /* convert to m */
       Drainage *= Dt;
 
@@ -224,7 +242,7 @@ void UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration,
   ponding on the surface.  This amount of water becomes surface Runoff */
 
   *TableDepth = WaterTableDepth(NSoilLayers, TotalDepth, RootDepth, Porosity,
-    FCap, Adjust, Moist);
+    FCap, Adjust, Moist, Capacity);
   
 
   if (*TableDepth < 0.0) {
@@ -238,4 +256,44 @@ void UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration,
 
     *TableDepth = 0.0;
   }
+  return Drained;
+}
+
+/*****************************************************************************
+Function name: InitDrainageTable()
+
+Purpose      : Tabulate the Brooks-Corey relative conductivity 
+(Moist/Porosity)^(2/PoreDist + 3) of each layer of a soil type, for use in
+UnsaturatedFlow()
+
+Required     :
+SOILTABLE *SType - Soil type
+int Size         - Number of entries per layer, 0 for no table
+
+Returns      : void
+
+Modifies     : SType->DrainTable
+
+Comments     : The tables cover relative saturations from 0 to 1.
+*****************************************************************************/
+void InitDrainageTable(SOILTABLE *SType, int Size)
+{
+  const char *Routine = "InitDrainageTable";
+  float Exponent;
+  int i;
+  int j;
+
+  SType->DrainTable = NULL;
+  if (Size == 0)
+    return;
+
+  if (!(SType->DrainTable = (FLOATTABLE *) calloc(SType->NLayers, 
+						   sizeof(FLOATTABLE))))
+    ReportError((char *) Routine, 1);
+  for (j = 0; j < SType->NLayers; j++) {
+    Exponent = 2.0 / SType->PoreDist[j] + 3.0;
+    InitInterpTable(Size, 0.0, 1.0 / (Size - 1), &(SType->DrainTable[j]));
+    for (i = 0; i < Size; i++)
+      SType->DrainTable[j].Data[i] = pow((double) i / (Size - 1), Exponent);
+  }
 }
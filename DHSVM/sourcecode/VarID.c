@@ -9,13 +9,22 @@
  * DESCRIPTION:  Maintains a structure that acts as a database with info on each
  *               variable, and provides functions to query this database
  * DESCRIP-END.
- * FUNCTIONS:    MakeVarAttr()
- *               IsValidDumpID()
+ * FUNCTIONS:    GetVarAttr()
+ *               GetVarName()
+ *               GetVarLongName()
+ *               GetVarFormat()
+ *               GetVarUnits()
+ *               GetVarFileName()
+ *               GetVarFileLabel()
+ *               GetVarNumberType()
+ *               IsValidID()
  *               IsMultiLayer()
- * COMMENTS:     If the number of IDs increases it might be worthwhile to use a
- *               better, faster search.  This is not done here, because in the 
- *               overall scheme of DHSVM it is not worth the programming effort
- *               right now.
+ *               GetVarNLayers()
+ * COMMENTS:     The entry of an ID is found through a table indexed by the
+ *               ID (VarIndex), which is built at the first query together
+ *               with the names of the first VARID_LAYERS layers of the multi
+ *               layer variables, so that the queries neither search the
+ *               list nor format the names.
  * $Id: VarID.c,v 1.7 2004/05/04 19:39:00 colleen Exp $     
  */
 
@@ -27,6 +36,13 @@
 #include "DHSVMerror.h"
 #include "sizeofnt.h"
 #include "varid.h"
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+#define MAXVARID     999	/* largest ID of varinfo */
+#define VARID_LAYERS 16		/* layers of the cached names of the multi
+				   layer variables */
 
 #ifdef TEST_VARID
 char *fileext = ".test";
@@ -34,7 +50,7 @@ char *fileext = ".test";
 extern char fileext[];
 #endif
 
-struct {
+static struct {
   int ID;
   char Name[BUFSIZE + 1];
   char LongName[BUFSIZE + 1];
@@ -150,6 +166,10 @@ struct {
   410, "Snow.ColdContent",
       "Snow Cold Content", "%.4g",
       "J", "Cold content of snow pack", NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  411, "Snow.TSurfIter",
+      "Snow Surface Temperature Iterations", "%.0f",
+      "", "Number of energy balance evaluations to solve for the snow surface temperature",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
   501, "Soil.Moist",
       "Soil Moisture Content", "%.4g",
       "", "Soil moisture for layer %d", NC_FLOAT, TRUE, FALSE, TRUE, 0}, {
@@ -196,6 +216,34 @@ struct {
       "Infiltration Accumulation", "%.4g",
       "m", "Accumulated water in top layer",
       NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  515, "Soil.TSurfIter",
+      "Surface Temperature Iterations", "%.0f",
+      "", "Number of energy balance evaluations to solve for the surface temperature",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  516, "Soil.CostSurfEval",
+      "Surface Temperature Evaluations", "%.0f",
+      "", "Energy balance evaluations for the soil surface temperature since the start",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  517, "Soil.CostSnowEval",
+      "Snow Temperature Evaluations", "%.0f",
+      "", "Energy balance evaluations for the snow surface temperature since the start",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  518, "Soil.CostSnowSteps",
+      "Snow Model Steps", "%.0f",
+      "", "Time steps with the snow pack model since the start",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  519, "Soil.CostUnsatLayers",
+      "Draining Soil Layers", "%.0f",
+      "", "Soil layers with unsaturated drainage since the start",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  520, "Soil.CostTime",
+      "Cell Time", "%.4g",
+      "ms", "Wall clock time of the cell since the start",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
+  521, "Soil.CostQuietSteps",
+      "Quiescent Steps", "%.0f",
+      "", "Time steps on the quiescent cell fast path since the start",
+      NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
   601, "WindModel",
       "Wind Direction Multiplier", "%.5f",
       "", "Wind Direction Multiplier", NC_FLOAT, FALSE, FALSE, FALSE, 0}, {
@@ -220,18 +268,99 @@ struct {
       ENDOFLIST, ENDOFLIST, ENDOFLIST, ENDOFLIST, ENDOFLIST}
 };
 
+#define NVARINFO (sizeof(varinfo) / sizeof(varinfo[0]))
+
+static short VarIndex[MAXVARID + 1];	/* entry in varinfo of each ID, -1 if
+					   none */
+static char *LayerName[NVARINFO][VARID_LAYERS];	/* Name of each layer */
+static char *LayerLongName[NVARINFO][VARID_LAYERS];	/* LongName of each
+							   layer */
+#ifdef HAVE_PTHREAD
+static pthread_once_t VarOnce = PTHREAD_ONCE_INIT;
+#else
+static int VarReady = FALSE;
+#endif
+
+static void InitVarIndex(void);
+static int FindVar(int ID, char *Routine);
+
+/*****************************************************************************
+  InitVarIndex()
+
+  Builds VarIndex and the names of the layers of the multi layer variables
+*****************************************************************************/
+static void InitVarIndex(void)
+{
+  char *Routine = "InitVarIndex";
+  char Str[BUFSIZE + 1];
+  int i;
+  int Layer;
+
+  for (i = 0; i <= MAXVARID; i++)
+    VarIndex[i] = -1;
+
+  for (i = 0; varinfo[i].ID != ENDOFLIST; i++) {
+    if (varinfo[i].ID < 0 || varinfo[i].ID > MAXVARID)
+      ReportError(Routine, 26);
+    VarIndex[varinfo[i].ID] = i;
+    if (varinfo[i].IsMultiLayer == TRUE) {
+      for (Layer = 0; Layer < VARID_LAYERS; Layer++) {
+	sprintf(Str, "%d.%s", Layer, varinfo[i].Name);
+	if (!(LayerName[i][Layer] = strdup(Str)))
+	  ReportError(Routine, 1);
+	sprintf(Str, "%s (Layer %d)", varinfo[i].LongName, Layer);
+	if (!(LayerLongName[i][Layer] = strdup(Str)))
+	  ReportError(Routine, 1);
+      }
+    }
+  }
+#ifndef HAVE_PTHREAD
+  VarReady = TRUE;
+#endif
+}
+
+/*****************************************************************************
+  FindVar()
+
+  Returns the entry of ID in varinfo, or -1 if there is none.  Routine is
+  reported as the routine with an invalid ID, unless it is NULL.
+*****************************************************************************/
+static int FindVar(int ID, char *Routine)
+{
+#ifdef HAVE_PTHREAD
+  pthread_once(&VarOnce, InitVarIndex);
+#else
+#ifdef HAVE_OPENMP
+#pragma omp critical (VarID)
+#endif
+  {
+    if (!VarReady)
+      InitVarIndex();
+  }
+#endif
+
+  if (ID >= 0 && ID <= MAXVARID && VarIndex[ID] >= 0)
+    return VarIndex[ID];
+  if (Routine != NULL)
+    ReportError(Routine, 26);
+  return -1;
+}
+
 /*****************************************************************************
   GetVarAttr()
 *****************************************************************************/
 void GetVarAttr(MAPDUMP * DMap)
 {
+  int i;
+
+  i = FindVar(DMap->ID, "GetVarAttr");
   GetVarName(DMap->ID, DMap->Layer, DMap->Name);
   GetVarLongName(DMap->ID, DMap->Layer, DMap->LongName);
-  GetVarFormat(DMap->ID, DMap->Format);
-  GetVarUnits(DMap->ID, DMap->Units);
+  strcpy(DMap->Format, varinfo[i].Format);
+  strcpy(DMap->Units, varinfo[i].Units);
   GetVarFileName(DMap->ID, DMap->Layer, DMap->Resolution, DMap->FileName);
-  GetVarFileLabel(DMap->ID, DMap->FileLabel);
-  GetVarNumberType(DMap->ID, &(DMap->NumberType));
+  strcpy(DMap->FileLabel, varinfo[i].FileLabel);
+  DMap->NumberType = varinfo[i].NumberType;
 }
 
 /******************************************************************************/
@@ -239,21 +368,17 @@ void GetVarAttr(MAPDUMP * DMap)
 /******************************************************************************/
 void GetVarName(int ID, int Layer, char *Name)
 {
-  char *Routine = "GetVarName";
   int i;
 
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      if (varinfo[i].IsMultiLayer == TRUE)
-	sprintf(Name, "%d.%s", Layer, varinfo[i].Name);
-      else
-	strcpy(Name, varinfo[i].Name);
-      return;
-    }
-    i++;
+  i = FindVar(ID, "GetVarName");
+  if (varinfo[i].IsMultiLayer == TRUE) {
+    if (Layer >= 0 && Layer < VARID_LAYERS)
+      strcpy(Name, LayerName[i][Layer]);
+    else
+      sprintf(Name, "%d.%s", Layer, varinfo[i].Name);
   }
-  ReportError((char *) Routine, 26);
+  else
+    strcpy(Name, varinfo[i].Name);
 }
 
 /******************************************************************************/
@@ -261,21 +386,17 @@ void GetVarName(int ID, int Layer, char *Name)
 /******************************************************************************/
 void GetVarLongName(int ID, int Layer, char *LongName)
 {
-  char *Routine = "GetVarLongName";
   int i;
 
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      if (varinfo[i].IsMultiLayer == TRUE)
-	sprintf(LongName, "%s (Layer %d)", varinfo[i].LongName, Layer);
-      else
-	strcpy(LongName, varinfo[i].LongName);
-      return;
-    }
-    i++;
+  i = FindVar(ID, "GetVarLongName");
+  if (varinfo[i].IsMultiLayer == TRUE) {
+    if (Layer >= 0 && Layer < VARID_LAYERS)
+      strcpy(LongName, LayerLongName[i][Layer]);
+    else
+      sprintf(LongName, "%s (Layer %d)", varinfo[i].LongName, Layer);
   }
-  ReportError((char *) Routine, 26);
+  else
+    strcpy(LongName, varinfo[i].LongName);
 }
 
 /******************************************************************************/
@@ -283,18 +404,7 @@ void GetVarLongName(int ID, int Layer, char *LongName)
 /******************************************************************************/
 void GetVarFormat(int ID, char *Format)
 {
-  char *Routine = "GetVarFormat";
-  int i;
-
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      strcpy(Format, varinfo[i].Format);
-      return;
-    }
-    i++;
-  }
-  ReportError((char *) Routine, 26);
+  strcpy(Format, varinfo[FindVar(ID, "GetVarFormat")].Format);
 }
 
 /******************************************************************************/
@@ -302,18 +412,7 @@ void GetVarFormat(int ID, char *Format)
 /******************************************************************************/
 void GetVarUnits(int ID, char *Units)
 {
-  char *Routine = "GetVarUnits";
-  int i;
-
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      strcpy(Units, varinfo[i].Units);
-      return;
-    }
-    i++;
-  }
-  ReportError((char *) Routine, 26);
+  strcpy(Units, varinfo[FindVar(ID, "GetVarUnits")].Units);
 }
 
 /******************************************************************************/
@@ -324,26 +423,18 @@ void GetVarFileName(int ID, int Layer, unsigned char Resolution, char *FileName)
   char *Routine = "GetVarFileName";
   char Name[BUFSIZE + 1];
   char Str[BUFSIZE + 1];
-  int i;
 
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      GetVarName(ID, Layer, Name);
-      if (Resolution == MAP_OUTPUT) {
-	sprintf(Str, "%sMap.%s%s", FileName, Name, fileext);
-      }
-      else if (Resolution == IMAGE_OUTPUT) {
-	sprintf(Str, "%sImage.%s%s", FileName, Name, fileext);
-      }
-      else
-	ReportError((char *) Routine, 21);
-      strncpy(FileName, Str, BUFSIZE);
-      return;
-    }
-    i++;
+  FindVar(ID, Routine);
+  GetVarName(ID, Layer, Name);
+  if (Resolution == MAP_OUTPUT) {
+    sprintf(Str, "%sMap.%s%s", FileName, Name, fileext);
   }
-  ReportError((char *) Routine, 26);
+  else if (Resolution == IMAGE_OUTPUT) {
+    sprintf(Str, "%sImage.%s%s", FileName, Name, fileext);
+  }
+  else
+    ReportError((char *) Routine, 21);
+  strncpy(FileName, Str, BUFSIZE);
 }
 
 /******************************************************************************/
@@ -351,18 +442,7 @@ void GetVarFileName(int ID, int Layer, unsigned char Resolution, char *FileName)
 /******************************************************************************/
 void GetVarFileLabel(int ID, char *FileLabel)
 {
-  char *Routine = "GetVarFileLabel";
-  int i;
-
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      strcpy(FileLabel, varinfo[i].FileLabel);
-      return;
-    }
-    i++;
-  }
-  ReportError((char *) Routine, 26);
+  strcpy(FileLabel, varinfo[FindVar(ID, "GetVarFileLabel")].FileLabel);
 }
 
 /******************************************************************************/
@@ -370,18 +450,7 @@ void GetVarFileLabel(int ID, char *FileLabel)
 /******************************************************************************/
 void GetVarNumberType(int ID, int *NumberType)
 {
-  char *Routine = "GetVarNumberType";
-  int i;
-
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      *NumberType = varinfo[i].NumberType;
-      return;
-    }
-    i++;
-  }
-  ReportError((char *) Routine, 26);
+  *NumberType = varinfo[FindVar(ID, "GetVarNumberType")].NumberType;
 }
 
 /******************************************************************************/
@@ -389,15 +458,7 @@ void GetVarNumberType(int ID, int *NumberType)
 /******************************************************************************/
 unsigned char IsValidID(int ID)
 {
-  int i;
-
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID)
-      return TRUE;
-    i++;
-  }
-  return FALSE;
+  return (FindVar(ID, NULL) >= 0) ? TRUE : FALSE;
 }
 
 /******************************************************************************/
@@ -405,17 +466,7 @@ unsigned char IsValidID(int ID)
 /******************************************************************************/
 unsigned char IsMultiLayer(int ID)
 {
-  char *Routine = "IsMultiLayer";
-  int i;
-
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID)
-      return varinfo[i].IsMultiLayer;
-    i++;
-  }
-  ReportError((char *) Routine, 26);
-  return FALSE;
+  return varinfo[FindVar(ID, "IsMultiLayer")].IsMultiLayer;
 }
 
 /******************************************************************************/
@@ -423,24 +474,16 @@ unsigned char IsMultiLayer(int ID)
 /******************************************************************************/
 int GetVarNLayers(int ID, int MaxSoilLayers, int MaxVegLayers)
 {
-  char *Routine = "GetVarNLayers";
-  int NLayers = -1;
+  int NLayers;
   int i;
 
-  i = 0;
-  while (varinfo[i].ID != ENDOFLIST) {
-    if (varinfo[i].ID == ID) {
-      if (varinfo[i].IsVegLayer == TRUE)
-	NLayers = MaxVegLayers + varinfo[i].AddLayer;
-      else if (varinfo[i].IsSoilLayer == TRUE)
-	NLayers = MaxSoilLayers + varinfo[i].AddLayer;
-      else
-	NLayers = 1;
-      return NLayers;
-    }
-    i++;
-  }
-  ReportError((char *) Routine, 26);
+  i = FindVar(ID, "GetVarNLayers");
+  if (varinfo[i].IsVegLayer == TRUE)
+    NLayers = MaxVegLayers + varinfo[i].AddLayer;
+  else if (varinfo[i].IsSoilLayer == TRUE)
+    NLayers = MaxSoilLayers + varinfo[i].AddLayer;
+  else
+    NLayers = 1;
   return NLayers;
 }
 
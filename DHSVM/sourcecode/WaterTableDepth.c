@@ -37,6 +37,8 @@ float *Adjust    - Correction for each layer for loss of soil storage
 due to channel/road-cut.  Multiplied with RootDepth
 to give the layer thickness for use in calculating
 soil moisture
+SOILCAPACITY *Capacity - Constants of the soil column from
+InitSoilCapacity(), NULL to compute them here
 
 Returns      :
 float TableDepth - Depth of the water table below the soil surface
@@ -56,7 +58,8 @@ Changes have been made to account for the potential loss of soil storage
 in a grid cell due to a road-cut or channel.
 *****************************************************************************/
 float WaterTableDepth(int NRootLayers, float TotalDepth, float *RootDepth,
-  float *Porosity, float *FCap, float *Adjust, float *Moist)
+  float *Porosity, float *FCap, float *Adjust, float *Moist,
+  SOILCAPACITY *Capacity)
 {
   float DeepFCap;		    /* field capacity of the layer below the deepest root layer */
   float DeepLayerDepth;		/* depth of layer below deepest root zone layer */
@@ -76,8 +79,11 @@ float WaterTableDepth(int NRootLayers, float TotalDepth, float *RootDepth,
   DeepPorosity = Porosity[NRootLayers - 1];
   DeepFCap = FCap[NRootLayers - 1];
   
-  for (i = 0; i < NRootLayers; i++)
-    DeepLayerDepth -= RootDepth[i];
+  if (Capacity != NULL)
+    DeepLayerDepth = Capacity->DeepDepth;
+  else
+    for (i = 0; i < NRootLayers; i++)
+      DeepLayerDepth -= RootDepth[i];
 
   /* Redistribute soil moisture.  I.e. water from supersaturated layers is
   transferred to the layer immediately above */
@@ -125,8 +131,14 @@ float WaterTableDepth(int NRootLayers, float TotalDepth, float *RootDepth,
     to the downslope, this water will be taken from the deepest soil layer, which
     can cause the deep layer soil moisture to go negative. */
 
-    DeepStorage = DeepLayerDepth * Adjust[NRootLayers] * (DeepPorosity - DeepFCap);
-    DeepExcessFCap = DeepLayerDepth * Adjust[NRootLayers] * (Moist[NRootLayers] - DeepFCap);
+    if (Capacity != NULL) {
+      DeepStorage = Capacity->DeepStorage;
+      DeepExcessFCap = Capacity->DeepThickness * (Moist[NRootLayers] - DeepFCap);
+    }
+    else {
+      DeepStorage = DeepLayerDepth * Adjust[NRootLayers] * (DeepPorosity - DeepFCap);
+      DeepExcessFCap = DeepLayerDepth * Adjust[NRootLayers] * (Moist[NRootLayers] - DeepFCap);
+    }
 
 
     if (DeepExcessFCap < 0.0) {
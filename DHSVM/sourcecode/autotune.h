@@ -0,0 +1,27 @@
+/*
+ * SUMMARY:      autotune.h - header file for the tuning of the cell loops
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Thread count and tile size of the cell loops timed at the
+ *               start of the run, see AutoTune.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include "data.h"
+
+/* runs the trial steps with Options->NThreads and Options->CellTileSize,
+   and returns their wall clock time (s) */
+typedef double (*TUNETRIAL) (void);
+
+void AutoTune(OPTIONSTRUCT *Options, MAPSIZE *Map, int NItems, int NSteps,
+	      TUNETRIAL Trial);
+
+#endif
@@ -16,9 +16,14 @@
 #ifndef BRENT_H
 #define BRENT_H
 
-float RootBrent(int y, int x, float LowerBound, float UpperBound,
+float RootBrent(int y, int x, float LowerBound, float UpperBound, int *NIter,
 		float (*Function) (float Estimate, va_list ap), ...);
 
+float RootNewton(int y, int x, float LowerBound, float UpperBound, 
+		 float Guess, int *NIter,
+		 float (*Function) (float Estimate, void *Params, 
+				    float *Derivative), void *Params);
+
 #define MACHEPS      3e-8	/* machine floating point precision (float) */
 #define T            1e-5	/* tolerance */
 #define MAXITER      1000	/* maximum number of allowed iterations */
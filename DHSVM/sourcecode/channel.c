@@ -21,6 +21,9 @@ $Id: channel.c,v3.1.2 2014/1/2 Ning Exp $
 #include "constants.h"
 #include "tableio.h"
 #include "settings.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 /* for test msw */
 #define TEST_MAIN 0
@@ -249,32 +252,111 @@ static Channel *alloc_channel_segment(void)
   seg->length = 0.0;
   seg->slope = 0.0;
   seg->class2 = NULL;
-  seg->lateral_inflow = 0.0;
-  seg->last_inflow = 0.0;
-  seg->last_outflow = 0.0;
-  seg->inflow = 0.0;
-  seg->outflow = 0.0;
-  seg->storage= 0.0;
+  /* the routing state and the RBM forcing are zeroed in the block of
+     the network, see channel_pack_block */
+  seg->route = NULL;
+  seg->force = NULL;
+  seg->block = NULL;
+  seg->Ncells = 0; /* not used for now */
   seg->outlet = NULL;
   seg->next = NULL;
 
-  /* Initialize the variables required by John's RBM model */
-  seg->ISW = 0.;   /* incident shortwave radiation */
-  seg->Beam = 0.;
-  seg->Diffuse = 0.;
-  seg->ILW = 0.;   /* incident longwave radiation */
-  seg->NSW = 0.;   /* net shortwave radiation */
-  seg->NLW = 0.;   /* net longwave radiation */
-  seg->VP = 0.;     /* actual vapor pressure */
-  seg->WND = 0.;
-  seg->ATP = 0.;
-  seg->Ncells = 0; /* not used for now */
-  seg->azimuth = 0;
-  seg->skyview = 0;
+  seg->rveg.TREEHEIGHT = 0.;
+  seg->rveg.BUFFERWIDTH = 0.;
+  seg->rveg.OvhCoeff = 0.;
+  memset(seg->rveg.ExtnCoeff, 0, sizeof(seg->rveg.ExtnCoeff));
+  seg->rveg.Extn = 0.;
+  seg->rveg.CanopyBankDist = 0.;
+  seg->rveg.StreamWidth = 0.;
+  seg->rveg.Azimuth = 0.;
+  seg->rveg.SkyOpen = 1.;
+  seg->rveg.ShadeFctr = NULL;
+
+  /* stream temperature parameters, unless given in the STREAM
+     TEMPERATURE PARAMETER FILE */
+  seg->temp.Alpha = 25.0;
+  seg->temp.Beta = 13.0;
+  seg->temp.Gamma = 0.18;
+  seg->temp.Mu = 0.5;
+  seg->temp.Smooth = 0.1;
+  seg->temp.Ua = 0.2;
+  seg->temp.Ub = 0.4;
+  seg->temp.Umin = 0.5;
+  seg->temp.Da = 0.3;
+  seg->temp.Db = 0.4;
+  seg->temp.Dmin = 0.5;
+  seg->temp.TSmooth = seg->temp.Mu;
+  seg->temp.TIn = seg->temp.Mu;
+  seg->temp.TOut = seg->temp.Mu;
 
   return seg;
 }
 
+/* -------------------------------------------------------------
+channel_pack_block
+Allocates the block of the routing states and forcings of the
+segments of net, in the routing sequence of channel_compile_network
+(a stable sort by order), and points the segments to their
+entries.  The entries are copied from the current block of the
+segments, if they have one, which the caller frees; otherwise they
+are zero.  Returns NULL if the memory cannot be allocated.
+------------------------------------------------------------- */
+static ChannelBlock *channel_pack_block(Channel *net)
+{
+  ChannelBlock *block;
+  Channel *current;
+  int *count;
+  unsigned maxorder = 0;
+  unsigned o;
+  int i, n = 0;
+
+  for (current = net; current != NULL; current = current->next) {
+    if (current->order > maxorder)
+      maxorder = current->order;
+    n++;
+  }
+
+  if ((block = (ChannelBlock *) malloc(sizeof(ChannelBlock))) == NULL ||
+      (block->route = (ChannelRoute *) calloc(n + 1, sizeof(ChannelRoute))) == NULL ||
+      (block->force = (ChannelForcing *) calloc(n + 1, sizeof(ChannelForcing))) == NULL ||
+      (count = (int *) calloc(maxorder + 2, sizeof(int))) == NULL) {
+    error_handler(ERRHDL_ERROR, "channel_pack_block: malloc failed: %s",
+      strerror(errno));
+    return NULL;
+  }
+  block->nseg = n;
+
+  for (current = net; current != NULL; current = current->next)
+    count[current->order + 1]++;
+  for (o = 1; o <= maxorder + 1; o++)
+    count[o] += count[o - 1];
+  for (current = net; current != NULL; current = current->next) {
+    i = count[current->order]++;
+    if (current->route != NULL) {
+      block->route[i] = *(current->route);
+      block->force[i] = *(current->force);
+    }
+    current->route = &(block->route[i]);
+    current->force = &(block->force[i]);
+    current->block = block;
+  }
+  free(count);
+
+  return block;
+}
+
+/* -------------------------------------------------------------
+channel_free_block
+------------------------------------------------------------- */
+static void channel_free_block(ChannelBlock *block)
+{
+  if (block != NULL) {
+    free(block->route);
+    free(block->force);
+    free(block);
+  }
+}
+
 /* -------------------------------------------------------------
 channel_find_segment
 A simple linear search of the channel network to find a segment
@@ -297,6 +379,244 @@ Channel *channel_find_segment(Channel * head, SegmentID id)
   return head;
 }
 
+/* -------------------------------------------------------------
+channel_compile_network
+Compile a network, once, into a contiguous array of segments in
+routing order with integer outlet indices.  Segments are sorted by
+order with a stable counting sort, so segments of equal order keep
+the sequence in which they were read, which is the sequence in which
+the old order-by-order scan of the linked list visited them.  An id
+lookup table (maxid + 1 entries) is built at the same time.
+------------------------------------------------------------- */
+ChannelNetwork *channel_compile_network(Channel *net, int maxid)
+{
+  ChannelNetwork *cnet;
+  Channel *current;
+  int *count;
+  unsigned maxorder = 0;
+  unsigned o;
+  int i, n = 0;
+
+  for (current = net; current != NULL; current = current->next) {
+    if (current->order > maxorder)
+      maxorder = current->order;
+    n++;
+  }
+
+  if ((cnet = (ChannelNetwork *) malloc(sizeof(ChannelNetwork))) == NULL ||
+      (cnet->seg = (Channel **) malloc((n + 1) * sizeof(Channel *))) == NULL ||
+      (cnet->route = (ChannelRoute **) malloc((n + 1) * sizeof(ChannelRoute *))) == NULL ||
+      (cnet->outlet = (int *) malloc((n + 1) * sizeof(int))) == NULL ||
+      (cnet->byid = (Channel **) calloc(maxid + 1, sizeof(Channel *))) == NULL ||
+      (cnet->index = (int *) malloc((maxid + 1) * sizeof(int))) == NULL ||
+      (count = (int *) calloc(maxorder + 2, sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_compile_network: malloc failed: %s",
+      strerror(errno));
+    return NULL;
+  }
+  cnet->nseg = n;
+  cnet->maxid = maxid;
+  cnet->nthreads = 1;
+  cnet->nlevel = 0;
+  cnet->level = NULL;
+  cnet->upstart = NULL;
+  cnet->upidx = NULL;
+  cnet->batch = NULL;
+  cnet->nsub = 1;
+  cnet->sub = NULL;
+
+  /* counting sort by order; count[o] becomes the first slot of order o */
+  for (current = net; current != NULL; current = current->next)
+    count[current->order + 1]++;
+  for (o = 1; o <= maxorder + 1; o++)
+    count[o] += count[o - 1];
+  for (o = 1; o < maxorder; o++) {
+    if (count[o + 1] == count[o])
+      error_handler(ERRHDL_WARNING,
+        "channel_compile_network: no segments of order %d", o);
+  }
+  for (current = net; current != NULL; current = current->next) {
+    i = count[current->order]++;
+    cnet->seg[i] = current;
+    cnet->route[i] = current->route;
+    cnet->byid[current->id] = current;
+    cnet->index[current->id] = i;
+  }
+  free(count);
+
+  for (i = 0; i < n; i++) {
+    current = cnet->seg[i];
+    if (current->outlet != NULL) {
+      cnet->outlet[i] = cnet->index[current->outlet->id];
+      if (cnet->outlet[i] <= i)
+        error_handler(ERRHDL_WARNING,
+          "channel_compile_network: segment %d (order %d) drains to segment %d (order %d), which is routed first",
+          current->id, current->order, current->outlet->id,
+          current->outlet->order);
+    }
+    else {
+      cnet->outlet[i] = -1;
+    }
+  }
+
+  return cnet;
+}
+
+/* -------------------------------------------------------------
+channel_network_segment
+Find the segment with the given id in a compiled network
+------------------------------------------------------------- */
+Channel *channel_network_segment(ChannelNetwork *cnet, SegmentID id)
+{
+  Channel *seg = NULL;
+
+  if (id <= cnet->maxid)
+    seg = cnet->byid[id];
+  if (seg == NULL) {
+    error_handler(ERRHDL_WARNING,
+      "channel_network_segment: unable to find segment %d", id);
+  }
+  return seg;
+}
+
+/* -------------------------------------------------------------
+channel_free_compiled_network
+The segments themselves are freed with channel_free_network
+------------------------------------------------------------- */
+void channel_free_compiled_network(ChannelNetwork *cnet)
+{
+  if (cnet != NULL) {
+    free(cnet->seg);
+    free(cnet->route);
+    free(cnet->outlet);
+    free(cnet->byid);
+    free(cnet->index);
+    free(cnet->level);
+    free(cnet->upstart);
+    free(cnet->upidx);
+    free(cnet->batch);
+    free(cnet->sub);
+    free(cnet);
+  }
+}
+
+/* -------------------------------------------------------------
+channel_network_levels
+Split a compiled network into level sets.  The segments of one order
+form a level set; they only interact through their outlets, which are
+all in later levels if every segment drains to a segment of higher
+order.  Returns the number of levels, 0 if a segment does not drain
+to a segment of higher order.
+------------------------------------------------------------- */
+int channel_network_levels(ChannelNetwork *cnet)
+{
+  int i, l;
+
+  if (cnet->level != NULL)
+    return cnet->nlevel;
+
+  for (i = 0; i < cnet->nseg; i++) {
+    if (cnet->outlet[i] >= 0 &&
+        cnet->seg[cnet->outlet[i]]->order <= cnet->seg[i]->order) {
+      error_handler(ERRHDL_WARNING,
+        "channel_network_levels: segment %d does not drain to a segment of higher order, using serial routing",
+        cnet->seg[i]->id);
+      return 0;
+    }
+  }
+
+  if ((cnet->level = (int *) malloc((cnet->nseg + 1) * sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_network_levels: malloc failed: %s",
+      strerror(errno));
+    return 0;
+  }
+
+  /* level sets: runs of equal order in the routing sequence */
+  l = 0;
+  for (i = 0; i < cnet->nseg; i++) {
+    if (i == 0 || cnet->seg[i]->order != cnet->seg[i - 1]->order)
+      cnet->level[l++] = i;
+  }
+  cnet->level[l] = cnet->nseg;
+  cnet->nlevel = l;
+
+  return cnet->nlevel;
+}
+
+/* -------------------------------------------------------------
+channel_network_threads
+Prepare a compiled network for routing with nthreads threads, level
+set by level set (channel_network_levels).  Instead of scattering
+outflow into the outlet, each segment gathers the outflow of its
+upstream segments, in routing order, so the levels can be routed
+concurrently without conflicts and with the same result as the
+serial pass.  Returns the number of threads that will be used.
+------------------------------------------------------------- */
+int channel_network_threads(ChannelNetwork *cnet, int nthreads)
+{
+  int i, j;
+  int *fill;
+
+  cnet->nthreads = 1;
+  if (nthreads <= 1 || cnet->nseg == 0 || channel_network_levels(cnet) == 0)
+    return cnet->nthreads;
+
+  if ((cnet->upstart = (int *) calloc(cnet->nseg + 1, sizeof(int))) == NULL ||
+      (cnet->upidx = (int *) malloc((cnet->nseg + 1) * sizeof(int))) == NULL ||
+      (fill = (int *) malloc((cnet->nseg + 1) * sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_network_threads: malloc failed: %s",
+      strerror(errno));
+    return 1;
+  }
+
+  /* upstream lists, filled in routing order */
+  for (i = 0; i < cnet->nseg; i++) {
+    if (cnet->outlet[i] >= 0)
+      cnet->upstart[cnet->outlet[i] + 1]++;
+  }
+  for (i = 0; i < cnet->nseg; i++) {
+    cnet->upstart[i + 1] += cnet->upstart[i];
+    fill[i] = cnet->upstart[i];
+  }
+  for (i = 0; i < cnet->nseg; i++) {
+    if ((j = cnet->outlet[i]) >= 0)
+      cnet->upidx[fill[j]++] = i;
+  }
+  free(fill);
+
+  cnet->nthreads = nthreads;
+  error_handler(ERRHDL_STATUS,
+    "channel_network_threads: %d segments in %d levels, %d threads",
+    cnet->nseg, cnet->nlevel, cnet->nthreads);
+
+  return cnet->nthreads;
+}
+
+/* -------------------------------------------------------------
+channel_network_substeps
+Route a compiled network in nsub steps of deltat / nsub in each
+model step.  The routing parameters have to be computed for the
+routing step (channel_routing_parameters).  Returns the number of
+steps that will be used.
+------------------------------------------------------------- */
+int channel_network_substeps(ChannelNetwork *cnet, int nsub)
+{
+  free(cnet->sub);
+  cnet->sub = NULL;
+  cnet->nsub = 1;
+  if (nsub <= 1 || cnet->nseg == 0)
+    return cnet->nsub;
+
+  if ((cnet->sub = (float *) malloc(4 * cnet->nseg * sizeof(float))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_network_substeps: malloc failed: %s",
+      strerror(errno));
+    return 1;
+  }
+  cnet->nsub = nsub;
+
+  return cnet->nsub;
+}
+
 /* -------------------------------------------------------------
 channel_routing_parameters
 ------------------------------------------------------------- */
@@ -309,9 +629,9 @@ void channel_routing_parameters(Channel *network, int deltat)
   for (segment = network; segment != NULL; segment = segment->next) {
     y = segment->class2->bank_height * 0.75;
     /*  for new routing scheme */
-    segment->K = sqrt(segment->slope) * pow((double)y, 2.0 / 3.0) /
+    segment->route->K = sqrt(segment->slope) * pow((double)y, 2.0 / 3.0) /
       (segment->class2->friction * segment->length);
-    segment->X = exp(-segment->K * deltat);
+    segment->route->X = exp(-segment->route->K * deltat);
   }
 
   return;
@@ -323,6 +643,7 @@ channel_read_network
 Channel *channel_read_network(const char *file, ChannelClass *class_list, int *MaxID)
 {
   Channel *head = NULL, *current = NULL;
+  Channel **byid;
   int err = 0;
   int done;
   static const int fields = 8;
@@ -452,13 +773,20 @@ Channel *channel_read_network(const char *file, ChannelClass *class_list, int *M
   table_close();
 
   /* find segment outlet segments, if
-  specified */
+  specified, using a table indexed by id */
+
+  if ((byid = (Channel **) calloc(*MaxID + 1, sizeof(Channel *))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_read_network: malloc failed: %s",
+      strerror(errno));
+  }
+  for (current = head; current != NULL; current = current->next)
+    byid[current->id] = current;
 
   for (current = head; current != NULL; current = current->next) {
     int outid = (int) current->outlet;
 
     if (outid != 0) {
-      current->outlet = channel_find_segment(head, outid);
+      current->outlet = (outid > 0 && outid <= *MaxID) ? byid[outid] : NULL;
       if (current->outlet == NULL) {
         error_handler(ERRHDL_ERROR,
           "%s: cannot find outlet (%d) for segment %d",
@@ -467,6 +795,7 @@ Channel *channel_read_network(const char *file, ChannelClass *class_list, int *M
       }
     }
   }
+  free(byid);
 
   table_errors += err;
 
@@ -480,6 +809,266 @@ Channel *channel_read_network(const char *file, ChannelClass *class_list, int *M
     channel_free_network(head);
     head = NULL;
   }
+  else if (head != NULL && channel_pack_block(head) == NULL) {
+    channel_free_network(head);
+    head = NULL;
+  }
+
+  return (head);
+}
+
+/* -------------------------------------------------------------
+channel cache records
+The classes and segments of a network as they are kept in the
+channel network cache (see InitChannel), one fixed size record
+each.  The riparian vegetation parameters are the ones that
+channel_read_rveg_param reads.
+------------------------------------------------------------- */
+#define CHANNEL_CACHE_NRVEG 17
+
+typedef struct {
+  int id;
+  int crown;
+  float width;
+  float bank_height;
+  float friction;
+  float infiltration;
+} ChannelCacheClass;
+
+typedef struct {
+  int id;
+  int order;
+  int class_id;
+  int outlet_id;		/* 0 if the segment has no outlet */
+  int record;
+  int name_len;			/* length of the record name, -1 if none */
+  float length;
+  float slope;
+  float rveg[CHANNEL_CACHE_NRVEG];
+} ChannelCacheSegment;
+
+/* -------------------------------------------------------------
+channel_cache_rveg
+Copies the riparian vegetation parameters of a segment to (dir > 0)
+or from (dir < 0) a cache record
+------------------------------------------------------------- */
+static void channel_cache_rveg(Channel *seg, float *rveg, int dir)
+{
+  float *p[CHANNEL_CACHE_NRVEG];
+  int i;
+
+  p[0] = &(seg->rveg.TREEHEIGHT);
+  p[1] = &(seg->rveg.BUFFERWIDTH);
+  for (i = 0; i < 12; i++)
+    p[2 + i] = &(seg->rveg.ExtnCoeff[i]);
+  p[14] = &(seg->rveg.CanopyBankDist);
+  p[15] = &(seg->rveg.OvhCoeff);
+  p[16] = &(seg->rveg.StreamWidth);
+
+  for (i = 0; i < CHANNEL_CACHE_NRVEG; i++) {
+    if (dir > 0)
+      rveg[i] = *(p[i]);
+    else
+      *(p[i]) = rveg[i];
+  }
+}
+
+/* -------------------------------------------------------------
+channel_write_cache
+Writes the classes and the segments of a network to a channel
+network cache: the number of classes and their records, the number
+of segments and their records, and the record names.  Returns
+non-zero if the file cannot be written.
+------------------------------------------------------------- */
+int channel_write_cache(FILE *out, ChannelClass *class_list, Channel *net)
+{
+  ChannelCacheClass *crec;
+  ChannelCacheSegment *srec;
+  ChannelClass *class2;
+  Channel *current;
+  int nclass = 0, nseg = 0, nchar = 0;
+  int i;
+  int err = 0;
+
+  for (class2 = class_list; class2 != NULL; class2 = class2->next)
+    nclass++;
+  for (current = net; current != NULL; current = current->next)
+    nseg++;
+
+  if ((crec = (ChannelCacheClass *) calloc(nclass + 1,
+					   sizeof(ChannelCacheClass))) == NULL ||
+      (srec = (ChannelCacheSegment *) calloc(nseg + 1,
+					     sizeof(ChannelCacheSegment))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_write_cache: malloc failed: %s",
+      strerror(errno));
+  }
+
+  for (i = 0, class2 = class_list; class2 != NULL; class2 = class2->next, i++) {
+    crec[i].id = class2->id;
+    crec[i].crown = class2->crown;
+    crec[i].width = class2->width;
+    crec[i].bank_height = class2->bank_height;
+    crec[i].friction = class2->friction;
+    crec[i].infiltration = class2->infiltration;
+  }
+  for (i = 0, current = net; current != NULL; current = current->next, i++) {
+    srec[i].id = current->id;
+    srec[i].order = current->order;
+    srec[i].class_id = (current->class2 != NULL) ? current->class2->id : 0;
+    srec[i].outlet_id = (current->outlet != NULL) ? current->outlet->id : 0;
+    srec[i].record = current->record;
+    srec[i].name_len = -1;
+    if (current->record_name != NULL) {
+      srec[i].name_len = strlen(current->record_name);
+      nchar += srec[i].name_len;
+    }
+    srec[i].length = current->length;
+    srec[i].slope = current->slope;
+    channel_cache_rveg(current, srec[i].rveg, 1);
+  }
+
+  if (fwrite(&nclass, sizeof(int), 1, out) != 1 ||
+      fwrite(crec, sizeof(ChannelCacheClass), nclass, out) != (size_t) nclass ||
+      fwrite(&nseg, sizeof(int), 1, out) != 1 ||
+      fwrite(srec, sizeof(ChannelCacheSegment), nseg, out) != (size_t) nseg ||
+      fwrite(&nchar, sizeof(int), 1, out) != 1)
+    err++;
+  for (current = net; current != NULL && !err; current = current->next) {
+    if (current->record_name != NULL &&
+	fwrite(current->record_name, sizeof(char), strlen(current->record_name),
+	       out) != strlen(current->record_name))
+      err++;
+  }
+
+  free(crec);
+  free(srec);
+  return err;
+}
+
+/* -------------------------------------------------------------
+channel_read_cache
+Reads the classes and the segments that channel_write_cache wrote
+and builds the network as channel_read_network does.  *MaxID is the
+largest segment id.  Returns NULL, without a message, if the records
+are incomplete or inconsistent; the caller reads the network files
+instead.
+------------------------------------------------------------- */
+Channel *channel_read_cache(FILE *in, ChannelClass **class_list, int *MaxID)
+{
+  ChannelCacheClass *crec = NULL;
+  ChannelCacheSegment *srec = NULL;
+  ChannelClass *class2 = NULL;
+  Channel *head = NULL, *current = NULL;
+  Channel **byid = NULL;
+  char *names = NULL;
+  char *name;
+  int nclass, nseg, nchar;
+  int i;
+  int err = 0;
+
+  *class_list = NULL;
+  *MaxID = 0;
+
+  if (fread(&nclass, sizeof(int), 1, in) != 1 || nclass < 0 ||
+      (crec = (ChannelCacheClass *) calloc(nclass + 1,
+					   sizeof(ChannelCacheClass))) == NULL ||
+      fread(crec, sizeof(ChannelCacheClass), nclass, in) != (size_t) nclass ||
+      fread(&nseg, sizeof(int), 1, in) != 1 || nseg < 0 ||
+      (srec = (ChannelCacheSegment *) calloc(nseg + 1,
+					     sizeof(ChannelCacheSegment))) == NULL ||
+      fread(srec, sizeof(ChannelCacheSegment), nseg, in) != (size_t) nseg ||
+      fread(&nchar, sizeof(int), 1, in) != 1 || nchar < 0 ||
+      (names = (char *) malloc(nchar + 1)) == NULL ||
+      fread(names, sizeof(char), nchar, in) != (size_t) nchar) {
+    free(crec);
+    free(srec);
+    free(names);
+    return NULL;
+  }
+
+  for (i = 0; i < nclass; i++) {
+    if (class2 == NULL) {
+      *class_list = alloc_channel_class();
+      class2 = *class_list;
+    }
+    else {
+      class2->next = alloc_channel_class();
+      class2 = class2->next;
+    }
+    class2->id = crec[i].id;
+    class2->crown = (ChannelCrownType) crec[i].crown;
+    class2->width = crec[i].width;
+    class2->bank_height = crec[i].bank_height;
+    class2->friction = crec[i].friction;
+    class2->infiltration = crec[i].infiltration;
+  }
+
+  name = names;
+  for (i = 0; i < nseg && !err; i++) {
+    if (head == NULL) {
+      head = alloc_channel_segment();
+      current = head;
+    }
+    else {
+      current->next = alloc_channel_segment();
+      current = current->next;
+    }
+    current->id = srec[i].id;
+    current->order = srec[i].order;
+    current->record = srec[i].record;
+    current->length = srec[i].length;
+    current->slope = srec[i].slope;
+    channel_cache_rveg(current, srec[i].rveg, -1);
+    if (srec[i].id <= 0 || srec[i].id > 65535 || srec[i].order <= 0 ||
+	(current->class2 = find_channel_class(*class_list,
+					      srec[i].class_id)) == NULL ||
+	srec[i].name_len > nchar - (int) (name - names)) {
+      err++;
+      break;
+    }
+    if (srec[i].name_len >= 0) {
+      if ((current->record_name = (char *) malloc(srec[i].name_len + 1)) == NULL) {
+	error_handler(ERRHDL_FATAL, "channel_read_cache: malloc failed: %s",
+	  strerror(errno));
+      }
+      memcpy(current->record_name, name, srec[i].name_len);
+      current->record_name[srec[i].name_len] = '\0';
+      name += srec[i].name_len;
+    }
+    if (current->id > *MaxID)
+      *MaxID = current->id;
+  }
+  free(names);
+
+  /* outlets by id, as in channel_read_network */
+  if (!err && (byid = (Channel **) calloc(*MaxID + 1, sizeof(Channel *))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_read_cache: malloc failed: %s",
+      strerror(errno));
+  }
+  for (current = head; current != NULL && !err; current = current->next)
+    byid[current->id] = current;
+  for (i = 0, current = head; current != NULL && !err;
+       current = current->next, i++) {
+    if (srec[i].outlet_id != 0) {
+      if (srec[i].outlet_id < 0 || srec[i].outlet_id > *MaxID ||
+	  (current->outlet = byid[srec[i].outlet_id]) == NULL)
+	err++;
+    }
+  }
+  free(byid);
+  free(crec);
+  free(srec);
+
+  if (!err && head != NULL && channel_pack_block(head) == NULL)
+    err++;
+  if (err) {
+    if (head != NULL)
+      channel_free_network(head);
+    if (*class_list != NULL)
+      channel_free_classes(*class_list);
+    *class_list = NULL;
+    head = NULL;
+  }
 
   return (head);
 }
@@ -487,7 +1076,7 @@ Channel *channel_read_network(const char *file, ChannelClass *class_list, int *M
 /* -------------------------------------------------------------
 channel_route_segment
 ------------------------------------------------------------- */
-static int channel_route_segment(Channel * segment, int deltat)
+static int channel_route_segment(ChannelRoute * segment, int deltat)
 {
   float K = segment->K;
   float X = segment->X;
@@ -518,67 +1107,124 @@ static int channel_route_segment(Channel * segment, int deltat)
   segment->outflow = outflow * deltat;
   segment->storage = storage;
 
-  if (segment->outlet != NULL)
-    segment->outlet->inflow += segment->outflow;
-
   return (err);
 }
 
 /* -------------------------------------------------------------
-channel_route_network
+channel_route_pass
+A single pass over the compiled network in routing order
 ------------------------------------------------------------- */
-int channel_route_network(Channel * net, int deltat)
+static int channel_route_pass(ChannelNetwork *cnet, int deltat)
 {
-  int order;
-  int order_count;
+  int i, j, l;
   int err = 0;
-  Channel *current;
+  ChannelRoute *current;
 
-  for (order = 1;; order += 1) {
-    order_count = 0;
-    current = net;
-    while (current != NULL) {
-      if (current->order == order) {
+  if (cnet->batch != NULL)
+    return channel_route_batch(cnet, deltat);
+
+  if (cnet->nthreads > 1) {
+    for (l = 0; l < cnet->nlevel; l++) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(cnet->nthreads) \
+  private(j, current) reduction(+:err)
+#endif
+      for (i = cnet->level[l]; i < cnet->level[l + 1]; i++) {
+        current = cnet->route[i];
+        for (j = cnet->upstart[i]; j < cnet->upstart[i + 1]; j++)
+          current->inflow += cnet->route[cnet->upidx[j]]->outflow;
         err += channel_route_segment(current, deltat);
-        order_count += 1;
       }
-      current = current->next;
     }
-    if (order_count == 0)
-      break;
+    return (err);
+  }
+
+  for (i = 0; i < cnet->nseg; i++) {
+    current = cnet->route[i];
+    err += channel_route_segment(current, deltat);
+    if (cnet->outlet[i] >= 0)
+      cnet->route[cnet->outlet[i]]->inflow += current->outflow;
+  }
+  return (err);
+}
+
+/* -------------------------------------------------------------
+channel_route_network
+Route the compiled network over a model step of deltat.  With
+routing sub-steps the lateral and external inflow of the step are
+spread evenly over the sub-steps; afterwards the segments hold the
+inflow and outflow of the whole model step, as with a single pass.
+------------------------------------------------------------- */
+int channel_route_network(ChannelNetwork *cnet, int deltat)
+{
+  int i, s;
+  int n = cnet->nseg;
+  int err = 0;
+  float *lateral, *external, *insum, *outsum;
+  ChannelRoute *current;
+
+  if (cnet->nsub <= 1)
+    return channel_route_pass(cnet, deltat);
+
+  lateral = cnet->sub;
+  external = cnet->sub + n;
+  insum = cnet->sub + 2 * n;
+  outsum = cnet->sub + 3 * n;
+  for (i = 0; i < n; i++) {
+    current = cnet->route[i];
+    lateral[i] = current->lateral_inflow;
+    external[i] = current->inflow;
+    insum[i] = 0.0;
+    outsum[i] = 0.0;
+  }
+
+  for (s = 0; s < cnet->nsub; s++) {
+    for (i = 0; i < n; i++) {
+      current = cnet->route[i];
+      current->lateral_inflow = lateral[i] / cnet->nsub;
+      current->inflow = external[i] / cnet->nsub;
+    }
+    err += channel_route_pass(cnet, deltat / cnet->nsub);
+    for (i = 0; i < n; i++) {
+      insum[i] += cnet->route[i]->inflow;
+      outsum[i] += cnet->route[i]->outflow;
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    current = cnet->route[i];
+    current->lateral_inflow = lateral[i];
+    current->inflow = insum[i];
+    current->outflow = outsum[i];
   }
   return (err);
 }
 
 /* -------------------------------------------------------------
 channel_step_initialize_network
+One pass over the arrays of the block of the network
 ------------------------------------------------------------- */
 int channel_step_initialize_network(Channel *net)
 {
-  if (net != NULL) {
-    net->last_inflow = net->inflow;
-    net->inflow = 0.0;
-    net->lateral_inflow = 0.0;
-    net->last_outflow = net->outflow;
-    net->last_storage = net->storage;
-
-    /* Initialzie variables for John's RBM model */ 
-    net->ILW = 0.; /* incident longwave radiation */
-    net->NLW = 0.; /* net longwave radiation */
-    net->ISW = 0.; /* incident shortwave radiation */
-    net->Beam = 0.;
-    net->Diffuse = 0.;
-    net->NSW = 0.0;            /* net shortwave radiation with both topo and canopy shading */
-
-    net->VP = 0.;              /* actual vapor pressure */
-    net->WND = 0.;
-    net->ATP = 0.;
-    net->azimuth = 0;
-    net->skyview = 0;
-    //net->Ncells = 0; /* not used for now */
-
-    channel_step_initialize_network(net->next);
+  ChannelBlock *block;
+  ChannelRoute *route;
+  int i;
+
+  if (net == NULL)
+    return (0);
+  block = net->block;
+  for (i = 0; i < block->nseg; i++) {
+    route = &(block->route[i]);
+    route->last_inflow = route->inflow;
+    route->inflow = 0.0;
+    route->lateral_inflow = 0.0;
+    route->last_outflow = route->outflow;
+    route->last_storage = route->storage;
   }
+
+  /* Initialzie variables for John's RBM model */ 
+  memset(block->force, 0, block->nseg * sizeof(ChannelForcing));
+
   return (0);
 }
 
@@ -607,16 +1253,13 @@ int
   float total_storage = 0.0;
   float total_storage_change = 0.0;
   float total_error = 0.0;
+  Channel *seg;
 
   if (flag == 1) {
     fprintf(out2, "DATE ");
-    for (; net != NULL; net = net->next) {
-      total_lateral_inflow += net->lateral_inflow;
-      if (net->outlet == NULL) {
-        total_outflow += net->outflow;
-      }
-      if (net->record)
-        fprintf(out2, "%s ", net->record_name);
+    for (seg = net; seg != NULL; seg = seg->next) {
+      if (seg->record)
+        fprintf(out2, "%s ", seg->record_name);
     }
     fprintf(out2, "\n");
   }
@@ -629,22 +1272,22 @@ int
   }
 
   for (; net != NULL; net = net->next) {
-    total_lateral_inflow += net->lateral_inflow;
+    total_lateral_inflow += net->route->lateral_inflow;
     if (net->outlet == NULL) {
-      total_outflow += net->outflow;
+      total_outflow += net->route->outflow;
     }
-    total_storage += net->storage;
-    total_storage_change += net->storage - net->last_storage;
+    total_storage += net->route->storage;
+    total_storage_change += net->route->storage - net->route->last_storage;
 
     if (net->record) {
       if (fprintf(out, "%15s %10d %12.5g %12.5g %12.5g %12.5g",
-        tstring, net->id, net->inflow, net->lateral_inflow,
-        net->outflow, net->storage - net->last_storage) == EOF) {
+        tstring, net->id, net->route->inflow, net->route->lateral_inflow,
+        net->route->outflow, net->route->storage - net->route->last_storage) == EOF) {
           error_handler(ERRHDL_ERROR,
             "channel_save_outflow: write error:%s", strerror(errno));
           err++;
       }
-      if (fprintf(out2, "%12.5g ", net->outflow) == EOF) {
+      if (fprintf(out2, "%12.5g ", net->route->outflow) == EOF) {
         error_handler(ERRHDL_ERROR,
           "channel_save_outflow: write error:%s", strerror(errno));
         err++;
@@ -682,15 +1325,153 @@ int
   return (err);
 }
 
+/* -------------------------------------------------------------
+channel_save_outflow_bin_header
+Starts a binary channel output file: CHANNEL_BIN_MAGIC, the number
+of recorded segments, and for each recorded segment its id, the
+length of its record name (-1 if it has none) and the name
+------------------------------------------------------------- */
+int channel_save_outflow_bin_header(Channel * net, FILE * out)
+{
+  int err = 0;
+  int nrecord = 0;
+  int id;
+  int len;
+  Channel *seg;
+
+  for (seg = net; seg != NULL; seg = seg->next)
+    if (seg->record)
+      nrecord++;
+
+  if (fwrite(CHANNEL_BIN_MAGIC, 1, strlen(CHANNEL_BIN_MAGIC), out) != 
+      strlen(CHANNEL_BIN_MAGIC))
+    err++;
+  if (fwrite(&nrecord, sizeof(int), 1, out) != 1)
+    err++;
+  for (seg = net; seg != NULL; seg = seg->next) {
+    if (seg->record) {
+      id = seg->id;
+      len = (seg->record_name != NULL) ? (int) strlen(seg->record_name) : -1;
+      if (fwrite(&id, sizeof(int), 1, out) != 1 ||
+          fwrite(&len, sizeof(int), 1, out) != 1 ||
+          (len > 0 && fwrite(seg->record_name, 1, len, out) != len))
+        err++;
+    }
+  }
+  if (err)
+    error_handler(ERRHDL_ERROR,
+      "channel_save_outflow_bin_header: write error:%s", strerror(errno));
+
+  return (err);
+}
+
+/* -------------------------------------------------------------
+channel_save_outflow_bin
+Saves the channel outflow as one binary record: the date string
+in CHANNEL_BIN_DATELEN characters, inflow, lateral inflow,
+outflow and storage change for each recorded segment, and the
+lateral inflow, outflow, storage, storage change and error
+totals of the network (all float).  These are the values
+channel_save_outflow_text writes, in one pass over the network
+------------------------------------------------------------- */
+int channel_save_outflow_bin(char *tstring, Channel * net, FILE * out)
+{
+  int err = 0;
+  char date[CHANNEL_BIN_DATELEN];
+  float values[4];
+  float totals[5] = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+  memset(date, 0, CHANNEL_BIN_DATELEN);
+  strncpy(date, tstring, CHANNEL_BIN_DATELEN - 1);
+  if (fwrite(date, 1, CHANNEL_BIN_DATELEN, out) != CHANNEL_BIN_DATELEN)
+    err++;
+
+  for (; net != NULL; net = net->next) {
+    totals[0] += net->route->lateral_inflow;
+    if (net->outlet == NULL)
+      totals[1] += net->route->outflow;
+    totals[2] += net->route->storage;
+    totals[3] += net->route->storage - net->route->last_storage;
+
+    if (net->record) {
+      values[0] = net->route->inflow;
+      values[1] = net->route->lateral_inflow;
+      values[2] = net->route->outflow;
+      values[3] = net->route->storage - net->route->last_storage;
+      if (fwrite(values, sizeof(float), 4, out) != 4)
+        err++;
+    }
+  }
+  totals[4] = totals[3] - totals[0] + totals[1];
+  if (fwrite(totals, sizeof(float), 5, out) != 5)
+    err++;
+
+  if (err)
+    error_handler(ERRHDL_ERROR,
+      "channel_save_outflow_bin: write error:%s", strerror(errno));
+
+  return (err);
+}
+
+/* -------------------------------------------------------------
+channel_prune_network
+Frees the segments whose id is not marked in keep (maxid + 1
+entries) and returns the remaining list, in the same sequence.
+Segments that drained to a removed segment no longer drain to
+another segment.  A compiled network of the list has to be
+compiled again.
+------------------------------------------------------------- */
+Channel *channel_prune_network(Channel *net, const char *keep)
+{
+  Channel *head = NULL;
+  Channel **last = &head;
+  Channel *current;
+  Channel *removed = NULL;
+
+  while (net != NULL) {
+    current = net;
+    net = net->next;
+    current->next = NULL;
+    if (keep[current->id]) {
+      *last = current;
+      last = &(current->next);
+    }
+    else {
+      current->next = removed;
+      removed = current;
+    }
+  }
+  for (current = head; current != NULL; current = current->next) {
+    if (current->outlet != NULL && !keep[current->outlet->id])
+      current->outlet = NULL;
+  }
+  /* the remaining segments get a block of their own, the removed
+     segments take the old block with them */
+  if (removed != NULL) {
+    if (head != NULL && channel_pack_block(head) == NULL)
+      error_handler(ERRHDL_FATAL,
+        "channel_prune_network: malloc failed: %s", strerror(errno));
+    channel_free_network(removed);
+  }
+
+  return head;
+}
+
 /* -------------------------------------------------------------
 channel_free_network
 ------------------------------------------------------------- */
 void channel_free_network(Channel * net)
 {
-  if (net->next != NULL) {
-    channel_free_network(net->next);
+  Channel *next;
+
+  if (net != NULL)
+    channel_free_block(net->block);
+  for (; net != NULL; net = next) {
+    next = net->next;
+    free(net->rveg.ShadeFctr);
+    free(net->record_name);
+    free(net);
   }
-  free(net);
 }
 
 /* -------------------------------------------------------------
@@ -745,6 +1526,8 @@ int main(int argc, char **argv)
   float time;
   ChannelClass *class;
   Channel *simple = NULL, *current, *tail;
+  ChannelNetwork *compiled;
+  int maxid;
 
   error_handler_init(argv[0], NULL, ERRHDL_ERROR);
   channel_init();
@@ -757,18 +1540,19 @@ int main(int argc, char **argv)
 
   /* read a network */
 
-  if ((simple = channel_read_network("example_network.dat", class)) == NULL) {
+  if ((simple = channel_read_network("example_network.dat", class, &maxid)) == NULL) {
     error_handler(ERRHDL_FATAL, "example_network.dat: trouble reading file");
   }
 
   /* initialize flows */
 
   for (current = simple; current != NULL; current = current->next) {
-    current->inflow = bndflow[0];
-    current->outflow = bndflow[0];
+    current->route->inflow = bndflow[0];
+    current->route->outflow = bndflow[0];
     current->outlet = current->next;
     tail = current;
   }
+  compiled = channel_compile_network(simple, maxid);
 
   /* time loop */
 
@@ -777,12 +1561,13 @@ int main(int argc, char **argv)
     float outflow;
 
     channel_step_initialize_network(simple);
-    simple->inflow = inflow;
-    (void) channel_route_network(simple, interval);
-    outflow = tail->outflow / interval;
+    simple->route->inflow = inflow;
+    (void) channel_route_network(compiled, interval);
+    outflow = tail->route->outflow / interval;
     channel_save_outflow(timestep * interval, simple, stdout);
   }
 
+  channel_free_compiled_network(compiled);
   channel_free_network(simple);
   channel_free_classes(class);
   channel_done();
@@ -15,6 +15,11 @@
 
 typedef unsigned short int SegmentID, ClassID;
 
+/* binary channel output (channel_save_outflow_bin), the first 8 bytes
+   of the file and the width of the date field of each record */
+#define CHANNEL_BIN_MAGIC   "DHSVMFLW"
+#define CHANNEL_BIN_DATELEN 20
+
 /* -------------------------------------------------------------
    struct ChannelClass
    ------------------------------------------------------------- */
@@ -51,24 +56,43 @@ typedef struct {
 	float Extn;
 	float CanopyBankDist;       /* Distance from bank to canopy */
     float StreamWidth;          /* segment width used in riparian shading module */
+	float Azimuth;              /* segment azimuth (degrees), set by channel_grid_cross_alloc */
+	float SkyOpen;              /* sky openness above the canopy */
+	float *ShadeFctr;           /* beam shade factor of each time step of the day,
+	                               for the sun of the 15th of the month */
 } CHANRVEG;
 
 /* -------------------------------------------------------------
-   struct Channel
-   This is the basic unit of channel information.
+   structure for the stream temperature of a segment, solved during
+   the run (STREAM TEMPERATURE SOLVER = INTERNAL): the Mohseni and
+   Leopold parameters of RBM and the temperatures of the last step
    ------------------------------------------------------------- */
-struct _channel_rec_ {
-  SegmentID id;
-  unsigned order;		/* determines computation order */
-  char *record_name;	/* The name this segment is to have in the output, if output is recorded */
-  char record;			/* TRUE if outflow values are to be saved by channel_save_outflow */
-  float length;			/* Parameters */
-  float slope;
+typedef struct {
+  float Alpha;			/* Mohseni headwater temperature (C) */
+  float Beta;			/*   T = Mu + Alpha / (1 + exp(Gamma * */
+  float Gamma;			/*   (Beta - smoothed air temperature))) */
+  float Mu;
+  float Smooth;			/* weight of the air temperature in the
+				   smoothed air temperature */
+  float Ua;			/* Leopold velocity (ft/s) */
+  float Ub;			/*   U = max(Umin, Ua * Q^Ub), Q in cfs */
+  float Umin;
+  float Da;			/* Leopold depth (ft) */
+  float Db;			/*   D = max(Dmin, Da * Q^Db), Q in cfs */
+  float Dmin;
+  float TSmooth;		/* smoothed air temperature (C) */
+  float TIn;			/* water temperature at the inlet (C) */
+  float TOut;			/* water temperature at the outlet (C) */
+} CHANTEMP;
+
+/* -------------------------------------------------------------
+   struct ChannelRoute
+   The routing state of a segment, the part of a segment that is
+   used at every step of the routing.
+   ------------------------------------------------------------- */
+typedef struct {
   float K;              /* Travel time constant, a function of slope */
   float X;              /* Weighting factor (0~1), exponential function of K */
-  ChannelClass *class2;	/* ChannelClass identifier */
-
-  /* necessary routing terms */
   float lateral_inflow;	/* cubic meters */
   float last_inflow;	/* cubic meters */
   float last_outflow;	/* cubic meters */
@@ -77,7 +101,14 @@ struct _channel_rec_ {
   float outflow;		/* cubic meters */
   float storage;		/* cubic meters */
   float last_lateral_inflow;
-  /* Added for John's RBM model */
+} ChannelRoute;
+
+/* -------------------------------------------------------------
+   struct ChannelForcing
+   The forcing of John's RBM model of a segment, summed over the
+   cells of the segment at every step
+   ------------------------------------------------------------- */
+typedef struct {
   float ATP;	        /* Avg air temp (C) */
   float ISW;            /* Incident incoming shortwave radiation (W/m2) */
   float Beam;           /* Incident incoming beam shortwave radiation (W/m2) */
@@ -89,15 +120,82 @@ struct _channel_rec_ {
   float WND;	        /* Wind (m/s) */
   float azimuth;        /* segment azimuth (degrees) */
   float skyview;
+} ChannelForcing;
+
+/* -------------------------------------------------------------
+   struct ChannelBlock
+   The routing states and the forcings of all segments of a network,
+   one contiguous array each, in routing order.  The block is shared
+   by the segments of the network and allocated when the network is
+   read (channel_read_network).
+   ------------------------------------------------------------- */
+typedef struct {
+  int nseg;			/* number of segments */
+  ChannelRoute *route;
+  ChannelForcing *force;
+} ChannelBlock;
+
+/* -------------------------------------------------------------
+   struct Channel
+   This is the basic unit of channel information.  The state that
+   changes at every step is in the arrays of the block of the
+   network; route and force point to the entries of the segment.
+   ------------------------------------------------------------- */
+struct _channel_rec_ {
+  SegmentID id;
+  unsigned order;		/* determines computation order */
+  char *record_name;	/* The name this segment is to have in the output, if output is recorded */
+  char record;			/* TRUE if outflow values are to be saved by channel_save_outflow */
+  float length;			/* Parameters */
+  float slope;
+  ChannelClass *class2;	/* ChannelClass identifier */
+
+  ChannelRoute *route;	/* routing state, in block->route */
+  ChannelForcing *force;	/* RBM forcing, in block->force */
+  ChannelBlock *block;	/* arrays of the network */
+
   int Ncells;	        /* Number of grid cells crossed by the segment*/
 
   CHANRVEG rveg;        /* riparian veg sub-structure */
+  CHANTEMP temp;        /* stream temperature sub-structure */
 
   struct _channel_rec_ *outlet;	/* NULL if does not drain to another segment */
   struct _channel_rec_ *next;
 };
 typedef struct _channel_rec_ Channel, *ChannelPtr;
 
+/* -------------------------------------------------------------
+   struct ChannelNetwork
+   A network compiled for routing: the segments in routing order
+   with the index of each segment's outlet, and a lookup by id.
+   ------------------------------------------------------------- */
+typedef struct {
+  int nseg;			/* number of segments */
+  int maxid;			/* largest segment id */
+  Channel **seg;		/* segments in routing (order) sequence */
+  ChannelRoute **route;		/* routing state of seg[i] */
+  int *outlet;			/* index in seg of the outlet, -1 if none */
+  Channel **byid;		/* segment by id, maxid + 1 entries */
+  int *index;			/* index in seg by id, maxid + 1 entries */
+
+  /* level sets, set up by channel_network_levels(), and parallel
+     routing, set up by channel_network_threads() */
+  int nthreads;			/* threads used for routing, 1 = serial */
+  int nlevel;			/* number of level sets (orders) */
+  int *level;			/* level l is seg[level[l]] .. seg[level[l+1]-1] */
+  int *upstart;			/* upstream segments of seg[i] are */
+  int *upidx;			/* upidx[upstart[i]] .. upidx[upstart[i+1]-1] */
+
+  /* routing of each level as loops over arrays, set up by
+     channel_network_batch() */
+  struct _channel_batch_ *batch; /* NULL to route segment by segment */
+
+  /* routing sub-steps, set up by channel_network_substeps() */
+  int nsub;			/* routing steps in each model step */
+  float *sub;			/* 4 x nseg: lateral and external inflow of
+				   the model step, inflow and outflow sums */
+} ChannelNetwork;
+
 /* -------------------------------------------------------------
    externally available routines
    ------------------------------------------------------------- */
@@ -111,14 +209,27 @@ void channel_free_classes(ChannelClass *head);
 
 Channel *channel_read_network(const char *file, ChannelClass * class_list, int *MaxID);
 int channel_read_rveg_param(Channel *net, const char *file, int *MaxID);
+int channel_write_cache(FILE *out, ChannelClass *class_list, Channel *net);
+Channel *channel_read_cache(FILE *in, ChannelClass **class_list, int *MaxID);
 void channel_routing_parameters(Channel *net, int deltat);
 Channel *channel_find_segment(Channel *net, SegmentID id);
+ChannelNetwork *channel_compile_network(Channel *net, int maxid);
+Channel *channel_network_segment(ChannelNetwork *cnet, SegmentID id);
+void channel_free_compiled_network(ChannelNetwork *cnet);
+int channel_network_levels(ChannelNetwork *cnet);
+int channel_network_threads(ChannelNetwork *cnet, int nthreads);
+int channel_network_batch(ChannelNetwork *cnet);
+int channel_network_substeps(ChannelNetwork *cnet, int nsub);
 int channel_step_initialize_network(Channel *net);
 int channel_incr_lat_inflow(Channel *segment, float linflow);
-int channel_route_network(Channel *net, int deltat);
+int channel_route_network(ChannelNetwork *cnet, int deltat);
+int channel_route_batch(ChannelNetwork *cnet, int deltat);
 int channel_save_outflow(double time, Channel * net, FILE *file, FILE *file2);
 int channel_save_outflow_text(char *tstring, Channel *net, FILE *out,
 			      FILE *out2, int flag);
+int channel_save_outflow_bin_header(Channel *net, FILE *out);
+int channel_save_outflow_bin(char *tstring, Channel *net, FILE *out);
+Channel *channel_prune_network(Channel *net, const char *keep);
 void channel_free_network(Channel *net);
 
 				/* Module */
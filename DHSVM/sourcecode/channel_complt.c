@@ -9,6 +9,7 @@
  * DESCRIPTION:  Calculate mass and energy balance at each pixel
  * DESCRIP-END.
  * FUNCTIONS:    channel_save_outflow_text_cplmt()
+                 channel_save_outflow_bin_cplmt()
                  channel_save_outflow_cplmt()
  * Modification 
  * $Id: channel_complt.c, v 3.2  2013/04/23   Ning Exp $    
@@ -226,51 +227,51 @@ channel_save_outflow_text_cplmt
   }
 
   for (; net != NULL; net = net->next) {
-    if (fprintf(out, "%12.4f ", net->outflow/Dt) == EOF) {
+    if (fprintf(out, "%12.4f ", net->route->outflow/Dt) == EOF) {
 	  error_handler(ERRHDL_ERROR, "channel_save_outflow: write error:%s", strerror(errno));
 	  err++;
 	}
-    if (fprintf(out2, "%12.4f ", net->inflow/Dt) == EOF) {
+    if (fprintf(out2, "%12.4f ", net->route->inflow/Dt) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_inflow: write error:%s", strerror(errno));
       err++;
 	}
-    if (fprintf(out4, "%8.2f ", net->ISW ) == EOF) {
+    if (fprintf(out4, "%8.2f ", net->force->ISW ) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_ISW: write error:%s", strerror(errno));
       err++;
     }
-    if (fprintf(out5, "%8.2f ", net->ILW ) == EOF) {
+    if (fprintf(out5, "%8.2f ", net->force->ILW ) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_ILW: write error:%s", strerror(errno));
       err++;
     }
-    if (fprintf(out9, "%9.2f ", net->VP ) == EOF) {
+    if (fprintf(out9, "%9.2f ", net->force->VP ) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_ActualVaporPressure: write error:%s", strerror(errno));
       err++;
     }
-    if (fprintf(out10, "%8.2f ", net->WND ) == EOF) {
+    if (fprintf(out10, "%8.2f ", net->force->WND ) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_Wind: write error:%s", strerror(errno));
       err++;
     }
-    if (fprintf(out11, "%5.2f ", net->ATP ) == EOF) {
+    if (fprintf(out11, "%5.2f ", net->force->ATP ) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_AirTemp: write error:%s", strerror(errno));
       err++;
     }
-	if (fprintf(out13, "%8.2f ", net->NLW) == EOF) {
+	if (fprintf(out13, "%8.2f ", net->force->NLW) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_NetLW: write error:%s", strerror(errno));
       err++;
     }
-	if (fprintf(out14, "%8.2f ", net->NSW) == EOF) {
+	if (fprintf(out14, "%8.2f ", net->force->NSW) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_NetSW: write error:%s", strerror(errno));
       err++;
     }
-	if (fprintf(out6, "%8.2f ", net->Beam ) == EOF) {
+	if (fprintf(out6, "%8.2f ", net->force->Beam ) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_ISW: write error:%s", strerror(errno));
       err++;
     }
-	if (fprintf(out7, "%8.2f ", net->Diffuse) == EOF) {
+	if (fprintf(out7, "%8.2f ", net->force->Diffuse) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_ILW: write error:%s", strerror(errno));
       err++;
     }
-	if (fprintf(out3, "%8.2f ", net->skyview) == EOF) {
+	if (fprintf(out3, "%8.2f ", net->force->skyview) == EOF) {
       error_handler(ERRHDL_ERROR, "channel_save_ILW: write error:%s", strerror(errno));
       err++;
     }
@@ -295,4 +296,89 @@ channel_save_outflow_text_cplmt
   return (err);
 }
 
+/* -------------------------------------------------------------
+   channel_save_outflow_bin_cplmt
+   Saves the same values as channel_save_outflow_text_cplmt, for
+   all segments, in the single binary file netfile->streamforcing.
+   The file starts with RBM_BIN_MAGIC, the start and end dates of
+   the text files (19 characters each, separated by a blank), and
+   the time step in hours, the number of segments, NRBMVARS and the
+   segment ids (int).  Each time step is the date string in CHANNEL_BIN_DATELEN
+   characters followed by NRBMVARS floats per segment (in enum 
+   RBMVARS order), written from netfile->forcingrecord at once
+   ------------------------------------------------------------- */
+int
+channel_save_outflow_bin_cplmt(TIMESTRUCT *Time, char *tstring, Channel *net,
+			       CHANNEL *netfile, int flag)
+{
+  int err = 0;
+  int Dt;
+  int nseg;
+  int id;
+  int header[3];
+  char date[CHANNEL_BIN_DATELEN];
+  float *values;
+  Channel *seg;
+  FILE *out;
+
+  Dt = Time->Dt;
+  out = netfile->streamforcing;
+
+  if (flag == 1) {
+    if (fwrite(RBM_BIN_MAGIC, 1, strlen(RBM_BIN_MAGIC), out) != 
+	strlen(RBM_BIN_MAGIC))
+      err++;
+    PrintRBMStartDate(Dt, &(Time->Current), out);
+    fprintf(out, " ");
+    PrintDate(&(Time->End), out);
+    for (nseg = 0, seg = net; seg != NULL; seg = seg->next)
+      nseg++;
+    header[0] = Dt / 3600;
+    header[1] = nseg;
+    header[2] = NRBMVARS;
+    if (fwrite(header, sizeof(int), 3, out) != 3)
+      err++;
+    for (seg = net; seg != NULL; seg = seg->next) {
+      id = seg->id;
+      if (fwrite(&id, sizeof(int), 1, out) != 1)
+	err++;
+    }
+  }
+
+  /* as for the text files, the first day is not written */
+  Time->Current.JDay = DayOfYear(Time->Current.Year, Time->Current.Month, Time->Current.Day);
+  Time->Start.JDay = DayOfYear(Time->Start.Year, Time->Start.Month, Time->Start.Day);
+
+  if ((Time->Current.JDay>=Time->Start.JDay+1) || 
+      (Time->Current.Year>Time->Start.Year)) {
+    values = netfile->forcingrecord;
+    for (nseg = 0, seg = net; seg != NULL; seg = seg->next, nseg++) {
+      values[RBM_INFLOW] = seg->route->inflow/Dt;
+      values[RBM_OUTFLOW] = seg->route->outflow/Dt;
+      values[RBM_ISW] = seg->force->ISW;
+      values[RBM_NSW] = seg->force->NSW;
+      values[RBM_ILW] = seg->force->ILW;
+      values[RBM_NLW] = seg->force->NLW;
+      values[RBM_VP] = seg->force->VP;
+      values[RBM_WND] = seg->force->WND;
+      values[RBM_ATP] = seg->force->ATP;
+      values[RBM_BEAM] = seg->force->Beam;
+      values[RBM_DIFFUSE] = seg->force->Diffuse;
+      values[RBM_SKYVIEW] = seg->force->skyview;
+      values += NRBMVARS;
+    }
 
+    memset(date, 0, CHANNEL_BIN_DATELEN);
+    strncpy(date, tstring, CHANNEL_BIN_DATELEN - 1);
+    if (fwrite(date, 1, CHANNEL_BIN_DATELEN, out) != CHANNEL_BIN_DATELEN ||
+	fwrite(netfile->forcingrecord, sizeof(float), nseg * NRBMVARS, out) !=
+	nseg * NRBMVARS)
+      err++;
+  }
+
+  if (err)
+    error_handler(ERRHDL_ERROR, "channel_save_outflow_bin_cplmt: write error:%s",
+		  strerror(errno));
+
+  return (err);
+}
@@ -17,7 +17,11 @@
 #define PI 3.14159265358979323846
 #endif
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
 
 #include "channel_grid.h"
 #include "tableio.h"
@@ -26,12 +30,16 @@
 #include "data.h"
 #include "DHSVMChannel.h"
 #include "constants.h"
+#include "memaccount.h"
+
+#define MAXSEGMENTID USHRT_MAX	/* largest SegmentID */
 
 /* -------------------------------------------------------------
    local function prototype
    ------------------------------------------------------------- */
 static ChannelMapRec *alloc_channel_map_record(void);
 static ChannelMapPtr **channel_grid_create_map(int cols, int rows);
+static void channel_grid_compile_map(ChannelMapPtr **map);
 Channel *Find_First_Segment(ChannelMapPtr **map, int col, int row, float SlopeAspect, 
 			    char *Continue);
 char channel_grid_has_intersection(ChannelMapPtr **map, int Currid, int Nextid, int row, 
@@ -39,6 +47,7 @@ char channel_grid_has_intersection(ChannelMapPtr **map, int Currid, int Nextid,
 
 /* -------------------------------------------------------------
    local module variables
+   set by channel_grid_init() only, and only read after that
    ------------------------------------------------------------- */
 static int channel_grid_cols = 0;
 static int channel_grid_rows = 0;
@@ -113,13 +122,15 @@ static ChannelMapPtr **channel_grid_create_map(int cols, int rows)
   int row, col;
   ChannelMapPtr *junk;
 
-  if ((map = (ChannelMapPtr **) malloc(cols * sizeof(ChannelMapPtr *))) == NULL) {
+  if ((map = (ChannelMapPtr **) TaggedMalloc(cols * sizeof(ChannelMapPtr *),
+					     MEM_CHANNEL)) == NULL) {
     error_handler(ERRHDL_FATAL, "channel_grid_create_map: malloc failed: %s",
 		  strerror(errno));
   }
   if ((junk =
-       (ChannelMapPtr *) malloc(rows * cols * sizeof(ChannelMapPtr))) == NULL) {
-    free(map);
+       (ChannelMapPtr *) TaggedMalloc(rows * cols * sizeof(ChannelMapPtr),
+				      MEM_CHANNEL)) == NULL) {
+    TaggedFree(map);
     error_handler(ERRHDL_FATAL,
 		  "channel_grid_create_map: malloc failed: %s",
 		  strerror(errno));
@@ -150,21 +161,129 @@ static void free_channel_map_record(ChannelMapRec * cell)
   free(cell);
 }
 
+/* -------------------------------------------------------------
+   channel_grid_compile_map
+   Copies the records of all cells into one contiguous block, in
+   cell order, and stores the cell totals that the query functions
+   need in the first record of each cell.  The totals are summed in
+   the same order and precision as the query functions used to, so
+   the results do not change.
+   ------------------------------------------------------------- */
+static void channel_grid_compile_map(ChannelMapPtr ** map)
+{
+  int c, r;
+  int n;
+  ChannelMapPtr cell;
+  ChannelMapPtr block;
+  ChannelMapPtr head;
+
+  n = 0;
+  for (c = 0; c < channel_grid_cols; c++)
+    for (r = 0; r < channel_grid_rows; r++)
+      for (cell = map[c][r]; cell != NULL; cell = cell->next)
+	n++;
+  if (n == 0)
+    return;
+
+  if ((block = (ChannelMapRec *) TaggedMalloc(n * sizeof(ChannelMapRec),
+					      MEM_CHANNEL)) == NULL) {
+    error_handler(ERRHDL_FATAL,
+		  "channel_grid_compile_map: %s", strerror(errno));
+  }
+
+  n = 0;
+  for (c = 0; c < channel_grid_cols; c++) {
+    for (r = 0; r < channel_grid_rows; r++) {
+      if (map[c][r] == NULL)
+	continue;
+      head = &(block[n]);
+      for (cell = map[c][r]; cell != NULL; cell = cell->next) {
+	block[n] = *cell;
+	block[n].next = (cell->next != NULL) ? &(block[n + 1]) : NULL;
+	n++;
+      }
+      free_channel_map_record(map[c][r]);
+      map[c][r] = head;
+
+      head->cell_length = 0.0;
+      head->cell_width = 0.0;
+      head->cell_bankht = 0.0;
+      head->cell_sink = FALSE;
+      head->cell_cross = -1;
+      for (cell = head; cell != NULL; cell = cell->next) {
+	head->cell_length += cell->length;
+	head->cell_width += cell->cut_width * cell->length;
+	head->cell_bankht += cell->cut_height * cell->length;
+	head->cell_sink = (head->cell_sink || cell->sink);
+      }
+      if (head->cell_length > 0.0) {
+	head->cell_width /= head->cell_length;
+	head->cell_bankht /= head->cell_length;
+      }
+      else {
+	head->cell_width = 0.0;
+	head->cell_bankht = 0.0;
+      }
+    }
+  }
+}
+
 /* -------------------------------------------------------------
    channel_grid_free_map
+   frees a map returned by channel_grid_read_map().  The first
+   record in cell order is the start of the record block.
    ------------------------------------------------------------- */
 void channel_grid_free_map(ChannelMapPtr ** map)
 {
   int c, r;
+  ChannelMapPtr block = NULL;
+
+  for (c = 0; c < channel_grid_cols && block == NULL; c++) {
+    for (r = 0; r < channel_grid_rows && block == NULL; r++) {
+      block = map[c][r];
+    }
+  }
+  TaggedFree(block);
+  TaggedFree(map[0]);
+  TaggedFree(map);
+}
+
+/* -------------------------------------------------------------
+   channel_grid_clip_map
+   removes the records of the cells outside the basin mask and of
+   the segments whose id is not marked in keep (maxid + 1 entries),
+   and compiles the map again
+   ------------------------------------------------------------- */
+void channel_grid_clip_map(ChannelMapPtr ** map, TOPOPIX ** TopoMap,
+			   const char *keep)
+{
+  int c, r;
+  ChannelMapPtr block = NULL;
+  ChannelMapPtr cell;
+  ChannelMapPtr *last;
+
   for (c = 0; c < channel_grid_cols; c++) {
     for (r = 0; r < channel_grid_rows; r++) {
-      if (map[c][r] != NULL) {
-	free_channel_map_record(map[c][r]);
+      if (map[c][r] == NULL)
+	continue;
+      if (block == NULL)
+	block = map[c][r];
+      cell = map[c][r];
+      map[c][r] = NULL;
+      if (!INBASIN(TopoMap[r][c].Mask))
+	continue;
+      for (last = &(map[c][r]); cell != NULL; cell = cell->next) {
+	if (keep[cell->channel->id]) {
+	  *last = alloc_channel_map_record();
+	  **last = *cell;
+	  (*last)->next = NULL;
+	  last = &((*last)->next);
+	}
       }
     }
   }
-  free(map[0]);
-  free(map);
+  TaggedFree(block);
+  channel_grid_compile_map(map);
 }
 
 /* -------------------------------------------------------------
@@ -172,12 +291,17 @@ void channel_grid_free_map(ChannelMapPtr ** map)
    ------------------------------------------------------------- */
 
 /* -------------------------------------------------------------
-   channel_grid_read_map
+   channel_grid_read_crossings
+   reads the records of a stream or road map file into a flat table,
+   in the order of the file.  Records with bad coordinates are
+   reported and skipped.  Returns NULL if there are errors, otherwise
+   the table (malloc) with *ncross records.
    ------------------------------------------------------------- */
-ChannelMapPtr **channel_grid_read_map(Channel *net, const char *file,
-				      SOILPIX ** SoilMap)
+ChannelCrossing *channel_grid_read_crossings(const char *file, int *ncross)
 {
-  ChannelMapPtr **map;
+  ChannelCrossing *cross = NULL;
+  ChannelCrossing *more;
+  int size = 0;
   static const int fields = 8;
   static char *sink_words[2] = {
     "SINK", "\n"
@@ -194,6 +318,7 @@ ChannelMapPtr **channel_grid_read_map(Channel *net, const char *file,
   };
   int done, err = 0;
 
+  *ncross = 0;
   if (!channel_grid_initialized) {
     error_handler(ERRHDL_ERROR,
 		  "channel_grid_read_map: channel_grid module not initialized");
@@ -209,14 +334,12 @@ ChannelMapPtr **channel_grid_read_map(Channel *net, const char *file,
     return NULL;
   }
 
-  map = channel_grid_create_map(channel_grid_cols, channel_grid_rows);
-
   done = FALSE;
   while (!done) {
     int i;
     int row = 0, col = 0;
     int rec_err = 0;
-    ChannelMapPtr cell;
+    ChannelCrossing *rec;
 
     done = (table_get_fields(fields, map_fields) < 0);
     if (done) {
@@ -260,68 +383,46 @@ ChannelMapPtr **channel_grid_read_map(Channel *net, const char *file,
       continue;
     }
 
-    if (map[col][row] != NULL) {
-      cell = map[col][row];
-      while (cell->next != NULL)
-	cell = cell->next;
-      cell->next = alloc_channel_map_record();
-      cell = cell->next;
-    }
-    else {
-      map[col][row] = alloc_channel_map_record();
-      cell = map[col][row];
+    if (*ncross == size) {
+      size = (size > 0) ? 2 * size : 1024;
+      if ((more = (ChannelCrossing *) realloc(cross,
+			      size * sizeof(ChannelCrossing))) == NULL) {
+	error_handler(ERRHDL_FATAL,
+		      "channel_grid_read_crossings: %s", strerror(errno));
+      }
+      cross = more;
     }
+    rec = &(cross[(*ncross)++]);
+    rec->col = col;
+    rec->row = row;
+    rec->segment = 0;
+    rec->line = table_lineno();
+    rec->length = 0.0;
+    rec->cut_height = 0.0;
+    rec->cut_width = 0.0;
+    rec->azimuth = 0.0;
+    rec->sink = FALSE;
 
     for (i = 2; i < fields; i++) {
       if (map_fields[i].read) {
 	switch (i) {
 	case 2:
-	  if ((cell->channel =
-	       channel_find_segment(net,
-				    map_fields[i].value.integer)) == NULL) {
-	    error_handler(ERRHDL_ERROR,
-			  "%s, line %d: unable to locate segment %d", file,
-			  table_lineno(), map_fields[i].value.integer);
-	    err++;
-	  }
+	  rec->segment = map_fields[i].value.integer;
 	  break;
 	case 3:
-	  cell->length = map_fields[i].value.real;
-	  if (cell->length < 0.0) {
-	    error_handler(ERRHDL_ERROR,
-			  "%s, line %d: bad length", file, table_lineno());
-	    err++;
-	  }
+	  rec->length = map_fields[i].value.real;
 	  break;
 	case 4:
-	  cell->cut_height = map_fields[i].value.real;
-	  if (cell->cut_height > SoilMap[row][col].Depth) {
-	    printf("warning overriding cut depths with 0.95 soil depth \n");
-	    cell->cut_height = SoilMap[row][col].Depth*0.95;
-	  }
-	  if (cell->cut_height < 0.0
-	      || cell->cut_height > SoilMap[row][col].Depth) {
-	    error_handler(ERRHDL_ERROR, "%s, line %d: bad cut_depth", file,
-			  table_lineno());
-	    err++;
-	  }
+	  rec->cut_height = map_fields[i].value.real;
 	  break;
 	case 5:
-	  cell->cut_width = map_fields[i].value.real;
-	  if (cell->cut_width < 0.0) {
-	    error_handler(ERRHDL_ERROR,
-			  "%s, line %d: bad cut_width", file, table_lineno());
-	    err++;
-	  }
+	  rec->cut_width = map_fields[i].value.real;
 	  break;
 	case 6:
-	  /* road aspect is read in degrees and
-	     stored in radians */
-	  cell->azimuth = (float)(map_fields[i].value.real);
-	  cell->aspect = map_fields[i].value.real * PI / 180.0;
+	  rec->azimuth = map_fields[i].value.real;
 	  break;
 	case 7:
-	  cell->sink = TRUE;
+	  rec->sink = TRUE;
 	  break;
 	default:
 	  error_handler(ERRHDL_FATAL,
@@ -346,6 +447,153 @@ ChannelMapPtr **channel_grid_read_map(Channel *net, const char *file,
   if (table_errors) {
     error_handler(ERRHDL_ERROR,
 		  "channel_grid_read_map: %s: too many errors", file);
+    free(cross);
+    cross = NULL;
+    *ncross = 0;
+  }
+  else if (cross == NULL) {
+    /* an empty map, which is not an error */
+    if ((cross = (ChannelCrossing *) malloc(sizeof(ChannelCrossing))) == NULL)
+      error_handler(ERRHDL_FATAL,
+		    "channel_grid_read_crossings: %s", strerror(errno));
+  }
+
+  return (cross);
+}
+
+/* -------------------------------------------------------------
+   channel_grid_build_map
+   builds a map from the records of channel_grid_read_crossings().
+   The records are placed in one contiguous block, in cell order and
+   within a cell in the order of the table, and the cell totals are
+   stored in the first record of each cell, as by
+   channel_grid_compile_map().  The cut heights are checked against
+   the soil depth here, so that a table kept in a cache does not
+   depend on the soil map.  file is only used in the messages.
+   Returns NULL if there are errors.
+   ------------------------------------------------------------- */
+ChannelMapPtr **channel_grid_build_map(ChannelNetwork *net,
+				       ChannelCrossing *cross, int ncross,
+				       SOILPIX ** SoilMap, const char *file)
+{
+  ChannelMapPtr **map;
+  ChannelMapPtr block;
+  ChannelMapPtr cell;
+  ChannelMapPtr head;
+  ChannelCrossing *rec;
+  int *count;
+  int ncells;
+  int c, r, k, n;
+  int err = 0;
+
+  for (k = 0; k < ncross; k++) {
+    if (cross[k].col < 0 || cross[k].col >= channel_grid_cols ||
+	cross[k].row < 0 || cross[k].row >= channel_grid_rows) {
+      error_handler(ERRHDL_ERROR,
+		    "%s: line %d: bad coordinates", file, cross[k].line);
+      return NULL;
+    }
+  }
+
+  map = channel_grid_create_map(channel_grid_cols, channel_grid_rows);
+  if (ncross == 0)
+    return (map);
+
+  /* counting sort of the records by cell, count[key] becomes the first
+     slot of the cell and, after the records are placed, the first slot
+     of the next cell */
+  ncells = channel_grid_cols * channel_grid_rows;
+  if ((count = (int *) calloc(ncells + 1, sizeof(int))) == NULL ||
+      (block = (ChannelMapRec *) TaggedMalloc(ncross * sizeof(ChannelMapRec),
+					      MEM_CHANNEL)) == NULL) {
+    error_handler(ERRHDL_FATAL,
+		  "channel_grid_build_map: %s", strerror(errno));
+  }
+  for (k = 0; k < ncross; k++)
+    count[cross[k].col * channel_grid_rows + cross[k].row + 1]++;
+  for (k = 1; k <= ncells; k++)
+    count[k] += count[k - 1];
+
+  for (k = 0; k < ncross; k++) {
+    rec = &(cross[k]);
+    c = rec->col;
+    r = rec->row;
+    cell = &(block[count[c * channel_grid_rows + r]++]);
+
+    cell->length = rec->length;
+    cell->cut_height = rec->cut_height;
+    cell->cut_width = rec->cut_width;
+    /* road aspect is read in degrees and
+       stored in radians */
+    cell->azimuth = rec->azimuth;
+    cell->aspect = rec->azimuth * PI / 180.0;
+    cell->sink = rec->sink;
+    cell->cell_length = 0.0;
+    cell->cell_width = 0.0;
+    cell->cell_bankht = 0.0;
+    cell->cell_sink = FALSE;
+    cell->next = NULL;
+
+    if ((cell->channel = channel_network_segment(net, rec->segment)) == NULL) {
+      error_handler(ERRHDL_ERROR,
+		    "%s, line %d: unable to locate segment %d", file,
+		    rec->line, rec->segment);
+      err++;
+    }
+    if (cell->length < 0.0) {
+      error_handler(ERRHDL_ERROR,
+		    "%s, line %d: bad length", file, rec->line);
+      err++;
+    }
+    if (cell->cut_height > SoilMap[r][c].Depth) {
+      printf("warning overriding cut depths with 0.95 soil depth \n");
+      cell->cut_height = SoilMap[r][c].Depth*0.95;
+    }
+    if (cell->cut_height < 0.0 || cell->cut_height > SoilMap[r][c].Depth) {
+      error_handler(ERRHDL_ERROR, "%s, line %d: bad cut_depth", file,
+		    rec->line);
+      err++;
+    }
+    if (cell->cut_width < 0.0) {
+      error_handler(ERRHDL_ERROR,
+		    "%s, line %d: bad cut_width", file, rec->line);
+      err++;
+    }
+  }
+
+  n = 0;
+  for (c = 0; c < channel_grid_cols; c++) {
+    for (r = 0; r < channel_grid_rows; r++) {
+      k = count[c * channel_grid_rows + r];
+      if (k == n)
+	continue;
+      head = &(block[n]);
+      for (; n < k - 1; n++)
+	block[n].next = &(block[n + 1]);
+      n = k;
+      map[c][r] = head;
+
+      for (cell = head; cell != NULL; cell = cell->next) {
+	head->cell_length += cell->length;
+	head->cell_width += cell->cut_width * cell->length;
+	head->cell_bankht += cell->cut_height * cell->length;
+	head->cell_sink = (head->cell_sink || cell->sink);
+      }
+      if (head->cell_length > 0.0) {
+	head->cell_width /= head->cell_length;
+	head->cell_bankht /= head->cell_length;
+      }
+      else {
+	head->cell_width = 0.0;
+	head->cell_bankht = 0.0;
+      }
+    }
+  }
+  free(count);
+
+  if (err) {
+    error_handler(ERRHDL_ERROR,
+		  "channel_grid_read_map: %s: %d errors", file, err);
     channel_grid_free_map(map);
     map = NULL;
   }
@@ -353,6 +601,24 @@ ChannelMapPtr **channel_grid_read_map(Channel *net, const char *file,
   return (map);
 }
 
+/* -------------------------------------------------------------
+   channel_grid_read_map
+   ------------------------------------------------------------- */
+ChannelMapPtr **channel_grid_read_map(ChannelNetwork *net, const char *file,
+				      SOILPIX ** SoilMap)
+{
+  ChannelMapPtr **map;
+  ChannelCrossing *cross;
+  int ncross;
+
+  if ((cross = channel_grid_read_crossings(file, &ncross)) == NULL)
+    return NULL;
+  map = channel_grid_build_map(net, cross, ncross, SoilMap, file);
+  free(cross);
+
+  return (map);
+}
+
 /* -------------------------------------------------------------
    ---------------------- Query Functions ---------------------
    ------------------------------------------------------------- */
@@ -374,13 +640,8 @@ int channel_grid_has_channel(ChannelMapPtr ** map, int col, int row)
 int channel_grid_has_sink(ChannelMapPtr ** map, int col, int row)
 {
   ChannelMapPtr cell = map[col][row];
-  char test = FALSE;
 
-  while (cell != NULL) {
-    test = (test || cell->sink);
-    cell = cell->next;
-  }
-  return (test);
+  return (cell != NULL && cell->cell_sink);
 }
 
 /* -------------------------------------------------------------
@@ -440,13 +701,8 @@ char channel_grid_has_intersection(ChannelMapPtr ** map, int Currid, int Nextid,
 double channel_grid_cell_length(ChannelMapPtr ** map, int col, int row)
 {
   ChannelMapPtr cell = map[col][row];
-  double len = 0.0;
 
-  while (cell != NULL) {
-    len += cell->length;
-    cell = cell->next;
-  }
-  return len;
+  return (cell != NULL) ? cell->cell_length : 0.0;
 }
 
 /* -------------------------------------------------------------
@@ -456,18 +712,8 @@ double channel_grid_cell_length(ChannelMapPtr ** map, int col, int row)
 double channel_grid_cell_width(ChannelMapPtr ** map, int col, int row)
 {
   ChannelMapPtr cell = map[col][row];
-  double len = channel_grid_cell_length(map, col, row);
-  double width = 0.0;
-
-  if (len > 0.0) {
-    while (cell != NULL) {
-      width += cell->cut_width * cell->length;
-      cell = cell->next;
-    }
-    width /= len;
-  }
 
-  return width;
+  return (cell != NULL) ? cell->cell_width : 0.0;
 }
 
 /* -------------------------------------------------------------
@@ -476,17 +722,8 @@ double channel_grid_cell_width(ChannelMapPtr ** map, int col, int row)
 double channel_grid_cell_bankht(ChannelMapPtr ** map, int col, int row)
 {
   ChannelMapPtr cell = map[col][row];
-  double len = channel_grid_cell_length(map, col, row);
-  double height = 0.0;
 
-  if (len > 0.0) {
-    while (cell != NULL) {
-      height += cell->cut_height * cell->length;
-      cell = cell->next;
-    }
-    height /= len;
-  }
-  return (height);
+  return (cell != NULL) ? cell->cell_bankht : 0.0;
 }
 
 /* -------------------------------------------------------------
@@ -510,7 +747,7 @@ void channel_grid_inc_inflow(ChannelMapPtr ** map, int col, int row, float mass)
    */
 
   while (cell != NULL) {
-    cell->channel->lateral_inflow += mass * cell->length / len;
+    cell->channel->route->lateral_inflow += mass * cell->length / len;
     cell = cell->next;
   }
 }
@@ -528,7 +765,7 @@ double channel_grid_outflow(ChannelMapPtr ** map, int col, int row)
 
   while (cell != NULL) {
     if (cell->sink) {
-      mass += cell->channel->outflow;
+      mass += cell->channel->route->outflow;
     }
     cell = cell->next;
   }
@@ -671,6 +908,8 @@ int main(int argc, char **argv)
 
   ChannelClass *class;
   Channel *simple = NULL, *current;
+  ChannelNetwork *compiled;
+  int maxid;
   ChannelMapPtr **map = NULL;
 
   static int interval = 3600;	/* seconds */
@@ -695,13 +934,14 @@ int main(int argc, char **argv)
 
   /* read a network */
 
-  if ((simple = channel_read_network("example_network.dat", class)) == NULL) {
+  if ((simple = channel_read_network("example_network.dat", class, &maxid)) == NULL) {
     error_handler(ERRHDL_FATAL, "example_network.dat: trouble reading file");
   }
 
   /* read channel map */
 
-  if ((map = channel_grid_read_map(simple, "example_map.dat")) == NULL) {
+  compiled = channel_compile_network(simple, maxid);
+  if ((map = channel_grid_read_map(compiled, "example_map.dat")) == NULL) {
     error_handler(ERRHDL_FATAL, "example_map.dat: trouble reading file");
   }
 
@@ -738,8 +978,8 @@ int main(int argc, char **argv)
   /* initialize flows */
 
   for (current = simple; current != NULL; current = current->next) {
-    current->inflow = bndflow[0] * timestep;
-    current->outflow = bndflow[0] * timestep;
+    current->route->inflow = bndflow[0] * timestep;
+    current->route->outflow = bndflow[0] * timestep;
   }
 
   /* time loop */
@@ -750,7 +990,7 @@ int main(int argc, char **argv)
 
     channel_step_initialize_network(simple);
     channel_grid_inc_inflow(map, 2, 0, inflow);
-    (void) channel_route_network(simple, interval);
+    (void) channel_route_network(compiled, interval);
     outflow = channel_grid_outflow(map, 2, 6);
     channel_save_outflow(time * interval, simple, stdout);
     printf("outflow: %8.3g\n", outflow);
@@ -759,6 +999,7 @@ int main(int argc, char **argv)
   /* deallocate memory */
 
   channel_grid_free_map(map);
+  channel_free_compiled_network(compiled);
   channel_free_network(simple);
   channel_free_classes(class);
 
@@ -772,46 +1013,6 @@ int main(int argc, char **argv)
 }
 #endif
 
-/* -----------------------------------------------------------------------------------
-   Function name : channel_grid_inc_other ()
-   Author: Nathalie Voisin Aug 2010
-   Function usage:
-   This function generates outputs required by John's RBM model
-
-   Given a mass/flux, this function increases the mass/flux in any
-   channel(s) is in proportion to their length within the cell 
-   BECAUSE THOSE ARE NRG fluxes, similar to each segment
-   --------------------------------------------------------------------------------- */
-
-void channel_grid_inc_other(ChannelMapPtr ** map, int col, int row, PIXRAD * LocalRad, 
-							PIXMET * LocalMet, float skyview)
-{
-  ChannelMapPtr cell = map[col][row];
-  float len = channel_grid_cell_length(map, col, row);
-
-  while (cell != NULL ) {
-	/* ISW is the total incoming shortwave radiation (VIC outputs) */
-	cell->channel->ISW += LocalRad->ObsShortIn;
-	
-	cell->channel->NSW += LocalRad->RBMNetShort;
-	cell->channel->Beam += LocalRad->PixelBeam;
-	cell->channel->Diffuse += LocalRad->PixelDiffuse;
-
-    cell->channel->ILW += LocalRad->PixelLongIn;
-	cell->channel->NLW += LocalRad->RBMNetLong;
-
-    cell->channel->VP += LocalMet->Eact;
-    cell->channel->WND += LocalMet->Wind;
-    cell->channel->ATP += LocalMet->Tair;
-
-	cell->channel->azimuth += 
-		cell->azimuth*cell->length /cell->channel->length;
-
-	cell->channel->skyview += skyview;
-
-    cell = cell->next;
-  }
-}
 /*************************************************************************************
 void channel_grid_avg( ): average the heat budget variables by the total cell numbers
 *************************************************************************************/
@@ -819,54 +1020,319 @@ void channel_grid_avg(Channel *Channel)
 {  
   while (Channel) {
     if (Channel->Ncells > 0 ) {
-	  Channel->ISW /= Channel->Ncells ;
+	  Channel->force->ISW /= Channel->Ncells ;
 	  
-	  Channel->NSW /= Channel->Ncells;
-	  Channel->Beam /= Channel->Ncells;
-	  Channel->Diffuse /= Channel->Ncells;
+	  Channel->force->NSW /= Channel->Ncells;
+	  Channel->force->Beam /= Channel->Ncells;
+	  Channel->force->Diffuse /= Channel->Ncells;
 
-	  Channel->ILW /= Channel->Ncells ;
-	  Channel->NLW /= Channel->Ncells ;
+	  Channel->force->ILW /= Channel->Ncells ;
+	  Channel->force->NLW /= Channel->Ncells ;
       
-      Channel->VP  /= Channel->Ncells;
-      Channel->WND /= Channel->Ncells;
-	  Channel->ATP /= Channel->Ncells;
+      Channel->force->VP  /= Channel->Ncells;
+      Channel->force->WND /= Channel->Ncells;
+	  Channel->force->ATP /= Channel->Ncells;
 
-	  Channel->skyview /= Channel->Ncells;
+	  Channel->force->skyview /= Channel->Ncells;
     }
 	Channel = Channel->next; 
   }
 }
-/*********************************************************************************
-Init_segment_ncell : computes the number of grid cell contributing to one segment
-**********************************************************************************/
-void Init_segment_ncell(TOPOPIX **TopoMap, ChannelMapPtr ** map, int NY, 
-						int NX, Channel* net)
-{
-  int y,x;
-  ChannelMapPtr cell; 
-
-  for (y = 0; y < NY; y++) {
-    for (x = 0; x < NX; x++) {      
-	  if (INBASIN(TopoMap[y][x].Mask)) {
-		if (channel_grid_has_channel(map, x, y)){	
-           cell = map[x][y];
-		   while (cell != NULL) {
-			 cell->channel->Ncells++;
-             cell = cell->next;
-		   }   
-        }
-      }
+/* -------------------------------------------------------------
+   ------------------- Accumulator Functions -------------------
+   ------------------------------------------------------------- */
+
+/* -------------------------------------------------------------
+   channel_grid_accum_alloc
+   Allocates an accumulator with a slot for each record of the
+   given cells (indices in Map->ActiveCells) of map.  The records
+   of each segment are merged in the order of the cells, and in
+   record order within a cell, with nthreads threads.
+   ------------------------------------------------------------- */
+ChannelGridAccum *channel_grid_accum_alloc(ChannelMapPtr **map, MAPSIZE *Map,
+					   int ncells, int *cells,
+					   int nthreads)
+{
+  ChannelGridAccum *accum;
+  ChannelMapPtr cell;
+  int *count;			/* slots of each segment id, then the start
+				   of its slots in order */
+  int *cellorder;		/* slots in cell order */
+  int c, r, i, id;
+
+  if ((accum = (ChannelGridAccum *) calloc(1, sizeof(ChannelGridAccum))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_grid_accum_alloc: %s", strerror(errno));
+  }
+
+  /* the record block starts with the first record in cell order */
+  for (c = 0; c < channel_grid_cols && accum->base == NULL; c++)
+    for (r = 0; r < channel_grid_rows && accum->base == NULL; r++)
+      accum->base = map[c][r];
+  for (c = 0; c < channel_grid_cols; c++)
+    for (r = 0; r < channel_grid_rows; r++)
+      for (cell = map[c][r]; cell != NULL; cell = cell->next)
+	accum->nrec++;
+
+  if ((accum->value = (float *) calloc(accum->nrec * ACCUM_NFIELDS + 1,
+				       sizeof(float))) == NULL ||
+      (accum->order = (int *) malloc((accum->nrec + 1) * sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_grid_accum_alloc: %s", strerror(errno));
+  }
+  accum->nthreads = nthreads;
+
+  if ((cellorder = (int *) malloc((accum->nrec + 1) * sizeof(int))) == NULL ||
+      (count = (int *) calloc(MAXSEGMENTID + 2, sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_grid_accum_alloc: %s", strerror(errno));
+  }
+  for (i = 0; i < ncells; i++) {
+    c = Map->ActiveCells[cells[i]].x;
+    r = Map->ActiveCells[cells[i]].y;
+    if (!channel_grid_has_channel(map, c, r))
+      continue;
+    for (cell = map[c][r]; cell != NULL; cell = cell->next) {
+      cellorder[accum->norder++] = (int) (cell - accum->base);
+      if (count[cell->channel->id]++ == 0)
+	accum->nseg++;
+    }
+  }
+
+  /* group the slots by segment id, keeping the cell order within each
+     segment (a counting sort) */
+  if ((accum->segstart = (int *) malloc((accum->nseg + 1) * sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_grid_accum_alloc: %s", strerror(errno));
+  }
+  for (id = 0, i = 0, accum->nseg = 0; id <= MAXSEGMENTID; id++) {
+    if (count[id] == 0)
+      continue;
+    accum->segstart[accum->nseg++] = i;
+    i += count[id];
+    count[id] = accum->segstart[accum->nseg - 1];
+  }
+  accum->segstart[accum->nseg] = i;
+  for (i = 0; i < accum->norder; i++)
+    accum->order[count[accum->base[cellorder[i]].channel->id]++] = cellorder[i];
+
+  free(count);
+  free(cellorder);
+  return accum;
+}
+
+/* -------------------------------------------------------------
+   accum_add
+   Adds the values of an accumulator slot to a segment and resets
+   them
+   ------------------------------------------------------------- */
+static void accum_add(Channel *net, float *v)
+{
+  net->route->lateral_inflow += v[ACCUM_INFLOW];
+  memset(v, 0, ACCUM_NFIELDS * sizeof(float));
+}
+
+/* -------------------------------------------------------------
+   channel_grid_accum_inc_inflow
+   Same as channel_grid_inc_inflow(), but into the slots of the
+   records of the cell
+   ------------------------------------------------------------- */
+void channel_grid_accum_inc_inflow(ChannelGridAccum *accum, ChannelMapPtr **map,
+				   int col, int row, float mass)
+{
+  ChannelMapPtr cell = map[col][row];
+  float len = channel_grid_cell_length(map, col, row);
+
+  while (cell != NULL) {
+    accum->value[(cell - accum->base) * ACCUM_NFIELDS + ACCUM_INFLOW] +=
+      mass * cell->length / len;
+    cell = cell->next;
+  }
+}
+
+/* -------------------------------------------------------------
+   channel_grid_accum_merge
+   Adds the slots to the segments of their records, in the order of
+   the cells given to channel_grid_accum_alloc(), and resets them
+   for the next time step.  Each cell only fills its own slots, so
+   the result is that of adding to the segments directly in that
+   order, whatever the number of threads and their schedule.  The
+   segments are merged in parallel, each by one thread.
+   ------------------------------------------------------------- */
+void channel_grid_accum_merge(ChannelGridAccum *accum)
+{
+  int g, s;
+
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(accum->nthreads) \
+  private(s) if (accum->nthreads > 1)
+#endif
+  for (g = 0; g < accum->nseg; g++)
+    for (s = accum->segstart[g]; s < accum->segstart[g + 1]; s++)
+      accum_add(accum->base[accum->order[s]].channel,
+		&(accum->value[accum->order[s] * ACCUM_NFIELDS]));
+}
+
+/* -------------------------------------------------------------
+   channel_grid_accum_free
+   ------------------------------------------------------------- */
+void channel_grid_accum_free(ChannelGridAccum *accum)
+{
+  if (accum == NULL)
+    return;
+  free(accum->value);
+  free(accum->order);
+  free(accum->segstart);
+  free(accum);
+}
+
+/* -------------------------------------------------------------
+   ----------------- Crossing Table Functions ------------------
+   ------------------------------------------------------------- */
+
+/* -------------------------------------------------------------
+   channel_grid_cross_alloc
+   Makes the crossing table of the given cells (indices in
+   Map->ActiveCells) that have a stream channel, and sets the number
+   of cells and the length weighted azimuth of each segment of net.
+   The azimuth is summed in grid row order, as the scan of the whole
+   grid that this replaces did
+   ------------------------------------------------------------- */
+ChannelCrossTable *channel_grid_cross_alloc(ChannelMapPtr **map, MAPSIZE *Map,
+					    int ncells, int *cells,
+					    Channel *net)
+{
+  ChannelCrossTable *cross;
+  ChannelMapPtr cell;
+  int c, r, i, k, s;
+
+  if ((cross = (ChannelCrossTable *) calloc(1, sizeof(ChannelCrossTable))) == NULL ||
+      (cross->start = (int *) malloc((ncells + 1) * sizeof(int))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_grid_cross_alloc: %s", strerror(errno));
+  }
+  for (i = 0; i < ncells; i++) {
+    c = Map->ActiveCells[cells[i]].x;
+    r = Map->ActiveCells[cells[i]].y;
+    if (!channel_grid_has_channel(map, c, r))
+      continue;
+    for (cell = map[c][r]; cell != NULL; cell = cell->next)
+      cross->ncross++;
+  }
+
+  if ((cross->segment = (Channel **) malloc((cross->ncross + 1) *
+					    sizeof(Channel *))) == NULL ||
+      (cross->azimuth = (float *) malloc((cross->ncross + 1) *
+					 sizeof(float))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_grid_cross_alloc: %s", strerror(errno));
+  }
+  cross->start[0] = 0;
+  for (i = 0, s = 0; i < ncells; i++) {
+    c = Map->ActiveCells[cells[i]].x;
+    r = Map->ActiveCells[cells[i]].y;
+    if (!channel_grid_has_channel(map, c, r))
+      continue;
+    map[c][r]->cell_cross = cross->ncells;
+    for (cell = map[c][r]; cell != NULL; cell = cell->next, s++) {
+      cross->segment[s] = cell->channel;
+      cross->azimuth[s] = cell->azimuth * cell->length / cell->channel->length;
+      cell->channel->Ncells++;
     }
+    cross->start[++cross->ncells] = s;
+  }
+  if ((cross->value = (float *) calloc(cross->ncells * CROSS_NFIELDS + 1,
+				       sizeof(float))) == NULL) {
+    error_handler(ERRHDL_FATAL, "channel_grid_cross_alloc: %s", strerror(errno));
+  }
+
+  for (i = 0; i < Map->NumActive; i++) {
+    k = (Map->RowOrder != NULL) ? Map->RowOrder[i] : i;
+    c = Map->ActiveCells[k].x;
+    r = Map->ActiveCells[k].y;
+    if (!channel_grid_has_channel(map, c, r) || map[c][r]->cell_cross < 0)
+      continue;
+    for (s = cross->start[map[c][r]->cell_cross];
+	 s < cross->start[map[c][r]->cell_cross + 1]; s++)
+      cross->segment[s]->rveg.Azimuth += cross->azimuth[s];
   }
 
-  // then check all segments
   for (; net != NULL; net = net->next) {
-    if (net->Ncells == 0 ) {
-      error_handler(ERRHDL_ERROR,"Init_segment_ncells: write error:%s", strerror(errno));
+    if (net->Ncells == 0) {
+      error_handler(ERRHDL_ERROR,
+		    "channel_grid_cross_alloc: segment %d crosses no cells",
+		    net->id);
     }
   }
-} 
+  return cross;
+}
 
+/* -------------------------------------------------------------
+   channel_grid_cross_store
+   Stores the RBM energy terms of a stream cell in its row of the
+   table.  Each cell has its own row, so the cells can be processed
+   in any order and on any thread
+   ------------------------------------------------------------- */
+void channel_grid_cross_store(ChannelCrossTable *cross, ChannelMapPtr **map,
+			      int col, int row, PIXRAD *LocalRad,
+			      PIXMET *LocalMet, float skyview)
+{
+  float *v;
+
+  if (map[col][row]->cell_cross < 0)
+    return;
+  v = &(cross->value[map[col][row]->cell_cross * CROSS_NFIELDS]);
+  /* ISW is the total incoming shortwave radiation (VIC outputs) */
+  v[CROSS_ISW] = LocalRad->ObsShortIn;
+  v[CROSS_NSW] = LocalRad->RBMNetShort;
+  v[CROSS_BEAM] = LocalRad->PixelBeam;
+  v[CROSS_DIFFUSE] = LocalRad->PixelDiffuse;
+  v[CROSS_ILW] = LocalRad->PixelLongIn;
+  v[CROSS_NLW] = LocalRad->RBMNetLong;
+  v[CROSS_VP] = LocalMet->Eact;
+  v[CROSS_WND] = LocalMet->Wind;
+  v[CROSS_ATP] = LocalMet->Tair;
+  v[CROSS_SKYVIEW] = skyview;
+}
 
+/* -------------------------------------------------------------
+   channel_grid_cross_sum
+   Adds the rows of the table to the segments that cross their
+   cells, and resets them for the next time step.  The terms are
+   added in cell order and in record order within a cell, so the
+   result is that of adding them from the pixel loop run in cell
+   order, whatever the number of threads
+   ------------------------------------------------------------- */
+void channel_grid_cross_sum(ChannelCrossTable *cross)
+{
+  ChannelForcing *force;
+  float *v;
+  int i, s;
+
+  for (i = 0; i < cross->ncells; i++) {
+    v = &(cross->value[i * CROSS_NFIELDS]);
+    for (s = cross->start[i]; s < cross->start[i + 1]; s++) {
+      force = cross->segment[s]->force;
+      force->ISW += v[CROSS_ISW];
+      force->NSW += v[CROSS_NSW];
+      force->Beam += v[CROSS_BEAM];
+      force->Diffuse += v[CROSS_DIFFUSE];
+      force->ILW += v[CROSS_ILW];
+      force->NLW += v[CROSS_NLW];
+      force->VP += v[CROSS_VP];
+      force->WND += v[CROSS_WND];
+      force->ATP += v[CROSS_ATP];
+      force->azimuth += cross->azimuth[s];
+      force->skyview += v[CROSS_SKYVIEW];
+    }
+  }
+  memset(cross->value, 0, cross->ncells * CROSS_NFIELDS * sizeof(float));
+}
 
+/* -------------------------------------------------------------
+   channel_grid_cross_free
+   ------------------------------------------------------------- */
+void channel_grid_cross_free(ChannelCrossTable *cross)
+{
+  if (cross == NULL)
+    return;
+  free(cross->start);
+  free(cross->segment);
+  free(cross->azimuth);
+  free(cross->value);
+  free(cross);
+}
@@ -25,6 +25,10 @@
    This is used to locate the channel segment located within a grid
    cell.  And to determine if the channel network has a sink in any of
    all of the segments which pass thru the cell
+
+   After a map is read, the records of all cells are stored in one
+   contiguous block, in cell order, and the first record of each cell
+   holds the totals over all records of that cell
    ------------------------------------------------------------- */
 
 struct _channel_map_rec_ {
@@ -36,11 +40,89 @@ struct _channel_map_rec_ {
   float azimuth;        /* channel azimuth */
   Channel *channel;		/* pointer to segment record */
 
+				/* first record of a cell only: */
+  double cell_length;		/* total channel length in the cell (m) */
+  double cell_width;		/* length-weighted cut width (m) */
+  double cell_bankht;		/* length-weighted cut height (m) */
+  char cell_sink;		/* is any segment in the cell a sink? */
+  int cell_cross;		/* row of the cell in the crossing table, -1
+				   if it has none */
+
   struct _channel_map_rec_ *next;
 };
 typedef struct _channel_map_rec_ ChannelMapRec;
 typedef struct _channel_map_rec_ *ChannelMapPtr;
 
+/* -------------------------------------------------------------
+   struct ChannelCrossing
+   A record of a stream or road map file as it is read, before the
+   segment is looked up and the cut height is checked against the
+   soil depth.  A table of these is what the channel network cache
+   keeps of a map file, so all fields are 4 bytes wide.
+   ------------------------------------------------------------- */
+typedef struct {
+  int col;			/* column of the cell */
+  int row;			/* row of the cell */
+  int segment;			/* segment id */
+  int line;			/* line in the map file */
+  float length;			/* channel length within cell (m) */
+  float cut_height;		/* channel cut depth (m) */
+  float cut_width;		/* "effective" cut width (m) */
+  float azimuth;		/* channel azimuth (degrees) */
+  int sink;			/* is this cell a channel sink? */
+} ChannelCrossing;
+
+/* -------------------------------------------------------------
+   struct ChannelGridAccum
+   Accumulation of the lateral inflow that a threaded cell loop
+   sends to the channel segments of a map.  Each record of
+   the map (a segment in a cell) has its own slot, so the cells can
+   be processed in any order and on any thread, and the slots are
+   added to the segments in a fixed cell order by
+   channel_grid_accum_merge().  The merge order is grouped by
+   segment, so that the segments can be merged on several threads,
+   each in the cell order of its own slots.
+   ------------------------------------------------------------- */
+enum {
+  ACCUM_INFLOW = 0, ACCUM_NFIELDS
+};
+
+typedef struct {
+  ChannelMapRec *base;		/* record block of the map, slot s is the
+				   record base[s] */
+  int nrec;			/* number of records (slots) */
+  float *value;			/* nrec * ACCUM_NFIELDS values */
+  int norder;			/* number of slots that are merged */
+  int *order;			/* slots in merge order */
+  int nseg;			/* number of segments with a slot */
+  int *segstart;		/* slots of segment g are order[segstart[g]]
+				   .. order[segstart[g+1]-1] */
+  int nthreads;			/* threads of channel_grid_accum_merge() */
+} ChannelGridAccum;
+
+/* -------------------------------------------------------------
+   struct ChannelCrossTable
+   The stream cells of the basin and the segments that cross them, in
+   compressed rows: the crossings of cell i are start[i] ..
+   start[i + 1] - 1.  Each cell stores its RBM energy terms in its own
+   row of value during the pixel loop, and channel_grid_cross_sum()
+   adds them to the crossing segments in one pass, in cell order and
+   in record order within a cell
+   ------------------------------------------------------------- */
+enum {
+  CROSS_ISW = 0, CROSS_NSW, CROSS_BEAM, CROSS_DIFFUSE, CROSS_ILW, CROSS_NLW,
+  CROSS_VP, CROSS_WND, CROSS_ATP, CROSS_SKYVIEW, CROSS_NFIELDS
+};
+
+typedef struct {
+  int ncells;			/* number of stream cells */
+  int *start;			/* ncells + 1 offsets in segment */
+  int ncross;			/* number of crossings */
+  Channel **segment;		/* segment of each crossing */
+  float *azimuth;		/* length weighted azimuth of each crossing */
+  float *value;			/* ncells * CROSS_NFIELDS values */
+} ChannelCrossTable;
+
 /* -------------------------------------------------------------
    externally available routines
    ------------------------------------------------------------- */
@@ -52,8 +134,12 @@ void channel_grid_done(void);
 
 				/* Input Functions */
 
-ChannelMapPtr **channel_grid_read_map(Channel *net, const char *file,
+ChannelMapPtr **channel_grid_read_map(ChannelNetwork *net, const char *file,
 				      SOILPIX **SoilMap);
+ChannelCrossing *channel_grid_read_crossings(const char *file, int *ncross);
+ChannelMapPtr **channel_grid_build_map(ChannelNetwork *net,
+				       ChannelCrossing *cross, int ncross,
+				       SOILPIX **SoilMap, const char *file);
 
 				/* Query Functions */
 
@@ -71,10 +157,30 @@ double channel_grid_flowslope(ChannelMapPtr **map, int col, int row);
 ChannelClass* channel_grid_class(ChannelMapPtr **map, int col, int row);
 
 void channel_grid_free_map(ChannelMapPtr **map);
+void channel_grid_clip_map(ChannelMapPtr **map, TOPOPIX **TopoMap,
+			   const char *keep);
 
 /* new functions for RBM model */
-void channel_grid_inc_other(ChannelMapPtr **map, int col, int row, PIXRAD *LocalRad , 
-							PIXMET *LocalMet, float skyview);
-void Init_segment_ncell(TOPOPIX **TopoMap, ChannelMapPtr **map, int NY, int NX, Channel *net);
 void channel_grid_avg (Channel *Channel);
+
+				/* Crossing Table Functions */
+
+ChannelCrossTable *channel_grid_cross_alloc(ChannelMapPtr **map, MAPSIZE *Map,
+					    int ncells, int *cells,
+					    Channel *net);
+void channel_grid_cross_store(ChannelCrossTable *cross, ChannelMapPtr **map,
+			      int col, int row, PIXRAD *LocalRad,
+			      PIXMET *LocalMet, float skyview);
+void channel_grid_cross_sum(ChannelCrossTable *cross);
+void channel_grid_cross_free(ChannelCrossTable *cross);
+
+				/* Accumulator Functions */
+
+ChannelGridAccum *channel_grid_accum_alloc(ChannelMapPtr **map, MAPSIZE *Map,
+					   int ncells, int *cells,
+					   int nthreads);
+void channel_grid_accum_inc_inflow(ChannelGridAccum *accum, ChannelMapPtr **map,
+				   int col, int row, float mass);
+void channel_grid_accum_merge(ChannelGridAccum *accum);
+void channel_grid_accum_free(ChannelGridAccum *accum);
 #endif
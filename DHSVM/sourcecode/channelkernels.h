@@ -0,0 +1,46 @@
+/*
+ * SUMMARY:      channelkernels.h - Vector loops of ChannelBatch.c
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The routing of the segments of a level of a channel
+ *               network, as a loop over the arrays of the routing batch
+ * DESCRIP-END.
+ * FUNCTIONS:    RouteLevel()
+ * COMMENTS:     Included by ChannelBatch.c once for each SIMD level, see
+ *               cpudispatch.h, so there is no include guard
+ */
+
+/*****************************************************************************
+  Function name: RouteLevel()
+
+  Purpose      : channel_route_segment() for the segments Start .. End - 1
+                 of the batch
+
+  Comments     : The inflow of the segments is complete, the outflow is
+                 scattered to their outlets by the caller
+*****************************************************************************/
+static void SIMD_NAME(RouteLevel)(ChannelBatch *Batch, int Start, int End,
+				  float Dt)
+{
+  float *K = Batch->K;
+  float *X = Batch->X;
+  float *Inflow = Batch->Inflow;
+  float *Lateral = Batch->Lateral;
+  float *Storage = Batch->Storage;
+  float *Outflow = Batch->Outflow;
+  float In;			/* inflow rate, upstream and lateral */
+  float S;			/* storage at the end of the step */
+  int i;
+
+  SIMD_INDEPENDENT
+  for (i = Start; i < End; i++) {
+    In = Inflow[i] / Dt + Lateral[i] / Dt;
+    S = (In / K[i]) + (Storage[i] - In / K[i]) * X[i];
+    S = (S < 0.0) ? 0.0 : S;
+    Outflow[i] = (In - (S - Storage[i]) / Dt) * Dt;
+    Storage[i] = S;
+  }
+}
@@ -56,6 +56,7 @@
 #define MinDiff   (1.e-8)
 
 /**************** extern constants - see globals.c ****************/
+/* set during the initialization only, read-only while the threads run */
 
 extern float LAI_SNOW_MULTIPLIER;		/* multiplier to calculate the amount of available
 										snow interception as a function of LAI */
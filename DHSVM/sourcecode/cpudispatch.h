@@ -0,0 +1,54 @@
+/*
+ * SUMMARY:      cpudispatch.h - header file for the SIMD kernel dispatch
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Instruction set levels of the vector kernels, see
+ *               CpuDispatch.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:     A kernel file (radiationkernels.h, soilkernels.h) is
+ *               included once for each level, with SIMD_SUFFIX defined to
+ *               the suffix of the level, and names its functions with
+ *               SIMD_NAME()
+ */
+
+#ifndef CPUDISPATCH_H
+#define CPUDISPATCH_H
+
+/* OPTIONS SIMD LEVEL, in the order of the instruction sets */
+#define SIMD_AUTO    -1		/* the highest level of the processor */
+#define SIMD_SSE2     0		/* the base instruction set of the build */
+#define SIMD_AVX2     1
+#define SIMD_AVX512   2
+#define NSIMDLEVELS   3
+
+/* the kernels of the higher levels are compiled with the target pragmas
+   of GCC on x86, the other compilers build the base kernels only */
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) \
+  && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SIMD_DISPATCH
+#endif
+
+/* before a loop over arrays of the kernel that do not overlap, which the
+   compiler would test at run time for each pair of arrays */
+#ifdef HAVE_SIMD_DISPATCH
+#define SIMD_INDEPENDENT _Pragma("GCC ivdep")
+#else
+#define SIMD_INDEPENDENT
+#endif
+
+#define SIMD_PASTE(Name, Suffix) Name ## Suffix
+#define SIMD_EXPAND(Name, Suffix) SIMD_PASTE(Name, Suffix)
+#define SIMD_NAME(Name) SIMD_EXPAND(Name, SIMD_SUFFIX)
+
+int InitCpuDispatch(int Forced);
+const char *SimdLevelName(int Level);
+void SelectRadiationKernels(int Level);
+void SelectInterceptionKernels(int Level);
+void SelectSoilKernels(int Level);
+void SelectChannelKernels(int Level);
+
+#endif
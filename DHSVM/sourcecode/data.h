@@ -19,6 +19,8 @@
 #include "settings.h"
 #include "Calendar.h"
 #include "channel.h"
+#include "lookuptable.h"
+#include "soilmoisture.h"
 
 typedef struct {
   int N;			/* Northing */
@@ -30,6 +32,19 @@ typedef struct {
   FILE *FilePtr;
 } FILES;
 
+/* NetCDF-4 storage of a dumped map, all zero for a classic NetCDF file */
+typedef struct {
+  int Chunk[3];			/* Chunk size in time, y and x (0 = library
+				   default) */
+  int Deflate;			/* Deflate level, 0 (none) to 9 */
+  int Shuffle;			/* if TRUE the shuffle filter is applied 
+				   before deflating */
+  int Quantize;			/* Number of significant digits kept for 
+				   floating point data (0 = lossless) */
+  int NVars;			/* Number of maps the file will hold, to
+				   reserve header space for (0 = one) */
+} NCSTORAGE;
+
 typedef struct {
   int ID;			/* Index for variable to dump */
   int Layer;			/* Layer for which to dump */
@@ -45,14 +60,114 @@ typedef struct {
   char FileLabel[BUFSIZE + 1];	/* File label */
   int NumberType;		/* Number type of variable */
   DATE *DumpDate;		/* Date(s) at which to dump */
+  int FirstIndex;		/* Index in DumpDate of the first record of
+				   the file of the open OUTPUT ROLLOVER
+				   period */
+  NCSTORAGE Storage;		/* NetCDF-4 chunking and compression */
+  int Reducer;			/* REDUCE_LAST dumps the map at the dump 
+				   date, the other reducers the map reduced 
+				   over the steps since the previous dump */
+  int NAccum;			/* Number of steps in Accum */
+  double *Accum;		/* Reduced map(s), allocated at the first
+				   step (NULL for REDUCE_LAST) */
+  size_t AccumSize;		/* Number of values in Accum */
+  int FileSet;			/* Index of the map dump whose file this map
+				   is written to, the map itself unless MAP
+				   FILE LAYOUT is COMBINED */
+  int WinX;			/* MAP WINDOW: first column, first row, */
+  int WinY;			/* number of columns and number of rows */
+  int WinNX;			/* of the part of the map that is written, */
+  int WinNY;			/* WinNX is 0 for the whole map */
+  uchar *WinMask;		/* MAP MASK: WinNY * WinNX flags of the cells
+				   of the window that are written, NULL for
+				   all of them */
+  int Block;			/* MAP BLOCK SIZE: the output cells are the
+				   mean or maximum of Block * Block cells
+				   (0 or 1 = the model cells) */
+  int BlockReducer;		/* REDUCE_MEAN or REDUCE_MAX */
 } MAPDUMP;
 
 typedef struct {
 
   COORD Loc;			/* Location for which to dump */
   FILES OutFile;		/* Files in which to dump */
+  char Name[BUFSIZE + 1];	/* Name of the pixel */
 } PIXDUMP;
 
+/* A column of the binary pixel output (PIXEL OUTPUT FORMAT = BINARY), see
+   DumpPixBin() */
+typedef struct {
+  char Name[32];		/* Name of the variable */
+  char Header[48];		/* Text of the column header, can be empty */
+  char Format[8];		/* printf format of the text output */
+  int MinVeg;			/* Written for pixels with at least MinVeg
+				   vegetation layers ... */
+  int MinSoil;			/* ... and at least MinSoil soil layers */
+  int Source;			/* Pixel map the value is taken from */
+  size_t Offset;		/* Offset of the field in the pixel */
+  int Field;			/* Type of the field */
+  int Layer;			/* Vegetation or soil layer of the field */
+  int SoilLayer;		/* Soil layer of a per vegetation and soil
+				   layer field */
+} PIXVAR;
+
+/* Annual per-cell statistics of a variable (NUMBER OF STATISTICS 
+   VARIABLES), see Statistics.c */
+typedef struct {
+  MAPDUMP Map;			/* Variable, layer, file and attributes */
+  int HasThreshold;		/* TRUE if the exceedance days are counted */
+  int ExceedBelow;		/* TRUE if the variable exceeds the threshold
+				   when it is below it */
+  float Threshold;		/* Threshold for the exceedance days */
+  int Year;			/* Year that is summarised */
+  int N;			/* Number of steps in the summary */
+  int Index;			/* Number of summaries written */
+  float *Max;			/* Maximum of the year */
+  float *MaxDay;		/* Day of year of the maximum */
+  float *Min;			/* Minimum of the year */
+  float *MinDay;		/* Day of year of the minimum */
+  double *Mean;			/* Running mean (Welford) */
+  double *M2;			/* Sum of the squared differences from the
+				   mean (Welford) */
+  float *ExceedDays;		/* Number of days with an exceedance */
+  int *LastExceed;		/* Day of year of the last exceedance */
+} STATDUMP;
+
+typedef struct {
+  int NSegments;		/* Number of observed stream segments */
+  int NSteps;			/* Number of steps in the model period */
+  Channel **Segment;		/* Observed stream segments */
+  float *Observed;		/* NSteps x NSegments observed flows
+				   (m3/timestep), negative if missing */
+  double *TotalSst;		/* Sum of the squared differences of all the
+				   observations of a segment from their mean */
+  int *TotalN;			/* Number of observations of a segment */
+  double *Sums;			/* NSegments x NOBJSUMS sums of the flows */
+  int Function;			/* OBJ_NSE or OBJ_RMSE */
+  int HasThreshold;		/* TRUE if the run stops early */
+  float Threshold;		/* OBJECTIVE THRESHOLD */
+  int Terminated;		/* TRUE if the threshold cannot be reached */
+} OBJECTIVE;
+
+typedef struct {
+  DATE *Date;			/* Date of the dump (in DState or DumpDate) */
+  int Type;			/* STATE_EVENT or MAP_EVENT */
+  int Map;			/* Index in DMap (MAP_EVENT only) */
+  int Index;			/* Index of Date in DumpDate (MAP_EVENT only) */
+  int Order;			/* Position before sorting, keeps the order of
+				   dumps at the same date */
+} DUMPEVENT;
+
+/* An output file of the run, for the resume checkpoint (see ListOutput()
+   in dhsvm.c) */
+typedef struct {
+  char Name[BUFSIZE + 1];
+  FILE **FilePtr;		/* Stream open on the file, NULL for the map
+				   files, which are opened when written */
+  long Length;			/* Bytes written, -1 for a file that is kept
+				   as it is (NetCDF maps) */
+} OUTPUTFILE;
+
 typedef struct {
   char Path[BUFSIZE + 1];			/* Path to dump to */
   char InitStatePath[BUFSIZE + 1];	/* Path for initial state */
@@ -60,12 +175,36 @@ typedef struct {
   FILES Balance;					/* File with summed mass balance values for entire basin */
   FILES FinalBalance;               /* File with summed mass balance values for the entire simulation period for entire basin */
   FILES Stream;
+  FILES Saturation;                 /* File with saturation extent for entire basin */
+  int SatFlushInterval;             /* Number of time steps between flushes of
+                                       the saturation extent file (0 = only 
+                                       when the buffer is full) */
+  int SatFlushCount;                /* Time steps written since last flush */
+  int GraphicsMode;                 /* GRAPHICS_DIRECT, GRAPHICS_THREAD or
+                                       GRAPHICS_IMAGE */
+  int GraphicsInterval;             /* Number of time steps between frames of
+                                       the graphics */
+  int AggregationInterval;          /* Number of time steps between the full
+                                       basin aggregations, written to
+                                       Aggregated.Values and Mass.Balance */
   int NStates;						/* Number of model state dumps */
   DATE *DState;						/* Array with dates on which to dump state */
   int NPix;							/* Number of pixels for which to output timeseries */
   PIXDUMP *Pix;						/* Array with info on pixels for which to output timeseries */
+  FILES PixBin;						/* Pixel.bin with the time series of all the
+							   pixels (PIXEL OUTPUT FORMAT = BINARY) */
+  int NPixVars;						/* Number of values of each pixel in PixBin, 0
+							   until its header is written */
+  PIXVAR *PixVars;					/* Columns of PixBin */
+  float *PixRecord;					/* Values of all the pixels at a step */
   int NMaps;						/* Number of variables for which to output maps */
   MAPDUMP *DMap;					/* Array with info on each map to output */
+  int NEvents;						/* Number of state and map dumps */
+  DUMPEVENT *Events;				/* State and map dumps sorted by date */
+  int NextEvent;					/* First dump that has not been done */
+  int NStats;						/* Number of variables with annual statistics */
+  STATDUMP *Stats;					/* Array with the annual statistics */
+  int Diagnostics;					/* DIAG_... diagnostics read by the outputs */
 } DUMPSTRUCT;
 
 typedef struct {
@@ -86,6 +225,10 @@ typedef struct {
   int MaxTravelTime;
   int TotalWaveLength;
   int *WaveLength;
+  int Head;			/* Position of the current time in the
+				   Hydrograph ring buffer */
+  float *TravelRunoff;		/* Runoff summed over the cells with the same
+				   travel time, MaxTravelTime */
 } UNITHYDRINFO;
 
 typedef struct {
@@ -134,6 +277,149 @@ typedef struct {
   float Vpd;			/* Vapor pressure deficit (Pa) */
 } PIXMET;
 
+typedef struct {
+  int NWeights;					/* Number of stations with a non-zero weight */
+  int *Stat;					/* Indices of those stations (ascending) */
+  float *Weight;				/* Interpolation weights, summing to 1 */
+  float *TOffset;				/* Temperature lapse from each station to the
+								   pixel (C), see MakeMetFields() */
+  float *PFactor;				/* PRISM value at each station, or its
+								   precipitation lapse rate times the
+								   elevation difference to the pixel, see
+								   MakePrecipFactors() */
+} METWEIGHT;
+
+typedef struct {
+  int NItems;			/* Number of items (cells) in the loop */
+  int NTiles;			/* Number of tiles */
+  int NThreads;			/* Number of threads the tiles are planned
+				   for */
+  int Steal;			/* TRUE if a thread takes tiles from the
+				   others when it has done its own, FALSE if
+				   each thread does one fixed block */
+  int *Start;			/* First item of each tile, NTiles+1 */
+  float *Cost;			/* Time each tile took in the last pass (s),
+				   initially its number of items */
+  int *Head;			/* Next tile of each thread, NThreads */
+  int *Tail;			/* End of the tiles of each thread, NThreads */
+  int *Current;			/* Tile each thread is working on, -1 if
+				   none, NThreads */
+  double *Clock;		/* Time that tile was started, NThreads */
+} TILESCHEDULE;			/* Tiles of a threaded cell loop, see
+				   TileSchedule.c */
+
+typedef struct {
+  float Tair;			/* Air temperature (C) */
+  float Rh;			/* Relative humidity (%) */
+  float Wind;			/* Wind (m/s), 0 with the wind model */
+  float Sin;			/* Incoming shortwave (W/m^2) */
+  float SinBeam;		/* Observed beam radiation (W/m^2), 0
+				   without shading */
+  float SinDiffuse;		/* Observed diffuse radiation (W/m^2), 0
+				   without shading */
+  float Lin;			/* Incoming longwave (W/m^2) */
+  float Precip;			/* Precipitation (m) */
+} STATVALUE;			/* Values of a station in the current time
+				   step, see MakeStationValues() */
+
+typedef struct {
+  int NCells;			/* Number of cells (Map->NumActive) */
+  float *Tair;			/* Air temperature (C) */
+  float *Rh;			/* Relative humidity (%) */
+  float *Wind;			/* Wind (m/s) */
+  float *Sin;			/* Incoming shortwave (W/m^2) */
+  float *SinBeam;		/* Incoming beam radiation (W/m^2) */
+  float *SinDiffuse;		/* Incoming diffuse radiation (W/m^2) */
+  float *Lin;			/* Incoming longwave (W/m^2) */
+  float *Press;			/* Atmospheric pressure (Pa) */
+  int NStats;			/* Number of met stations */
+  STATVALUE *StatValue;		/* Values of each station in the current
+				   time step */
+  float ScaleWind;		/* Wind of the wind model station, which
+				   scales the wind model maps */
+  int WindDirection;		/* Wind model of the current time step */
+  float *StatLapse;		/* Station lapse rates for which the lapse 
+				   terms (METWEIGHT.TOffset and Press) were
+				   calculated */
+  int LapseValid;		/* FALSE until the lapse terms are calculated */
+  float *StatPLapse;		/* Station precipitation lapse rates for which
+				   METWEIGHT.PFactor was calculated */
+  int PFactorMonth;		/* Month for which METWEIGHT.PFactor was 
+				   calculated, 0 until it is */
+  TILESCHEDULE Tiles;		/* Schedule of the cell loop */
+  /* coarse met grid (OPTIONS MET GRID SPACING, see InitMetNodes()) */
+  int Step;			/* Model cells between nodes, 1 if not used */
+  int NodeNY;			/* Number of node rows */
+  int NodeNX;			/* Number of node columns */
+  METWEIGHT **NodeWeights;	/* Station weights of each node */
+  float *NodeElev;		/* Elevation of each node (m) */
+  float *NodeTair;		/* Air temperature at NodeElev (C) */
+  float *NodeTLapse;		/* Weighted station temperature lapse rate */
+  float *NodeRh;
+  float *NodeWind;
+  float *NodeSin;
+  float *NodeSinBeam;
+  float *NodeSinDiffuse;
+  float *NodeLin;
+  float *NodePrecip;		/* Station precipitation lapsed to NodeElev */
+  float *NodePLapse;		/* Change of NodePrecip with elevation */
+  float *Precip;		/* Downscaled station precipitation of each
+				   cell, NULL if it is interpolated in
+				   MakeLocalMetData() */
+} METFIELDS;			/* Interpolated met variables for all active 
+				   cells, in Map->ActiveCells order */
+
+typedef struct {
+  int NCells;			/* Number of cells (Map->NumActive) */
+  int Bits;			/* 0 if the values are kept, 8 or 16 for 
+				   fixed point codes */
+  float Offset;			/* Value of code 0, or of all the cells if
+				   nothing is stored */
+  float Scale;			/* Value step of one code */
+  float *Value;			/* Values, with 0 bits */
+  unsigned char *Code8;		/* Codes, with 8 bits */
+  unsigned short *Code16;	/* Codes, with 16 bits */
+  int Shared;			/* TRUE if the values are in the STATIC DATA
+				   SHARE, and are not freed */
+} STATICMAP;			/* Static input map of the active cells, in 
+				   Map->ActiveCells order, see StaticMap.c */
+
+typedef struct {
+  int NSectors;			/* Azimuth sectors, sector k looks at 2 pi k /
+				   NSectors clockwise from north */
+  int NCells;			/* Map->NumActive */
+  unsigned char *Angle;		/* Horizon angle of sector k and active cell
+				   i at Angle[k * NCells + i], in steps of
+				   HORIZON_STEP */
+  float *CosSlope;		/* cos of the slope of each active cell */
+  float *SinSlopeN;		/* sin of the slope times cos of the aspect */
+  float *SinSlopeE;		/* sin of the slope times sin of the aspect */
+  unsigned char *Shade;		/* Shade factor of each active cell in the
+				   current step */
+} HORIZONMAP;			/* Horizons of the active cells, in
+				   Map->ActiveCells order, SHADING MODE =
+				   HORIZON only, see HorizonShading.c */
+
+typedef struct {
+  int NDaySteps;		/* Number of time steps in a day */
+  int *Slice;			/* Slice of each step of the day in Block, -1
+				   if the sun is below the horizon during the
+				   whole month, NDaySteps */
+  int NSlices;			/* Number of steps with a slice this month */
+  int MaxSlices;		/* Number of slices Block has room for */
+  unsigned char *Block;		/* Shadow maps of the daylight steps, 
+				   contiguous [MaxSlices][NY][NX] */
+  size_t Mapped;		/* Bytes of Block in a scratch file of the
+				   OUT OF CORE DIRECTORY, 0 if allocated */
+  unsigned char *Night;		/* Map of zeros for the other steps */
+  unsigned char ***Map;		/* Map[DayStep][y][x], rows in Block or
+				   Night */
+  HORIZONMAP Horizon;		/* SHADING MODE = HORIZON: the horizons, of
+				   which the one slice of Block is computed
+				   each step, that all the steps show */
+} SHADOWMAP;			/* Shadow maps of the current month, see
+				   InitShadeMap() and InitNewMonth() */
+
 typedef struct {
   float Rank;
   int   x;
@@ -154,7 +440,33 @@ typedef struct {
   int OffsetX;					 /* Offset in x-direction compared to basemap */
   int OffsetY;					 /* Offset in y-direction compared to basemap */
   int NumCells;                  /* Number of cells within the basin */
-  ITEM *OrderedCells;            /* Structure array to hold the ranked elevations; NumCells in size */
+  ITEM *OrderedCells;            /* Structure array to hold the ranked elevations; NumCells in size,
+                                    NULL until RankedCells() */
+  int NumActive;                 /* Number of active (modeled) cells */
+  ITEM *ActiveCells;             /* Active cells in the order of OPTIONS CELL
+                                    ORDER (row-major by default); NumActive
+                                    in size */
+  int *RowOrder;                 /* Index in ActiveCells of each active cell
+                                    in row-major order, NULL if ActiveCells
+                                    is row-major (see ROWCELL()) */
+  int *RegridIndex;              /* Coarse input maps (MM5, radar) only: for 
+                                    each cell of the base map (row-major) the 
+                                    index of the cell in this map (radar: in
+                                    the window) */
+  int WinX;                      /* Windowed input maps (radar) only: first */
+  int WinY;                      /* column and row, and number of columns */
+  int WinNX;                     /* and rows of the part of the map that */
+  int WinNY;                     /* covers the basin.  The model map in POINT
+                                    mode: first column and row of the model
+                                    map in the input maps */
+  int FileNX;                    /* Model map in POINT mode: number of columns */
+  int FileNY;                    /* and rows of the input maps, 0 if the
+                                    model map is the whole input map (see
+                                    PointWindow()) */
+  int NeighborOffset[NNEIGHBORS]; /* Offset of each of the neighbours (xneighbor,
+                                    yneighbor) in maps allocated with 
+                                    AllocHaloMap() */
+  int DirOffset[NDIRS];          /* Same for xdirection, ydirection */
 } MAPSIZE;
 
 typedef struct {
@@ -195,6 +507,28 @@ typedef struct {
   MET Data;
 } METLOCATION;
 
+/* node of the k-d tree of the station locations, see StationIndex.c */
+typedef struct {
+  int First;			/* stations Order[First] .. Order[Last - 1] */
+  int Last;
+  int Child[2];			/* lower and upper half, -1 for a leaf */
+  int MinN;			/* bounding box of the stations */
+  int MaxN;
+  int MinE;
+  int MaxE;
+} STATIONNODE;
+
+typedef struct {
+  METLOCATION *Station;		/* stations of the index */
+  int NStats;			/* number of stations */
+  int NNodes;			/* number of nodes, node 0 is the root */
+  int *Order;			/* stations in the order of the leaves */
+  STATIONNODE *Node;		/* nodes of the tree */
+  int NSlots;			/* size of the location hash, a power of 2 */
+  int *Slot;			/* lowest station at each hashed location,
+				   -1 for an empty slot */
+} STATIONINDEX;
+
 typedef struct {
   int NGrids;            
   int Decimal;  
@@ -204,6 +538,12 @@ typedef struct {
   float LonWest;                /* extreme west longitude */
   char filepath[BUFSIZE + 1];   /* file path */
   char fileprefix[BUFSIZE + 1]; /* file path */
+  char catalogue[BUFSIZE + 1];  /* catalogue of the grid met files, empty
+                                   if the file path is scanned */
+  char ncfile[BUFSIZE + 1];     /* NetCDF file with the grid met forcing,
+                                   empty if it is in a file per grid */
+  char ncvars[BUFSIZE + 1];     /* variables of ncfile, in the order of the
+                                   values of a grid met file */
 } GRID;
 
 typedef struct {
@@ -235,24 +575,213 @@ typedef struct {
   int GRIDMET;                  /* TRUE if gridded forcing will be used, FALSE otherwise */
   int PointX;					/* X-index of point to model in POINT mode */
   int PointY;					/* Y-index of point to model in POINT mode */
+  int OutletSegment;            /* Stream segment at the outlet of the
+                                   modeled sub-basin, -1 if none */
+  int OutletY;                  /* Y-index of the cell at the outlet of the
+                                   modeled sub-basin, -1 if none */
+  int OutletX;                  /* X-index of that cell */
   int Snotel;					/* if TRUE then station veg = bare for output */
   int Outside;					/* if TRUE then all listed met stats are used */
   int Rhoverride;				/* if TRUE then RH=100% if Precip>0 */
   int Shading;					/* if TRUE then terrain shading for solar is on */
+  int ShadingMode;              /* SHADING_MAPS (monthly shadow files) or
+                                   SHADING_HORIZON (from the horizon angles
+                                   of the cells, see HorizonShading.c) */
+  int HorizonSectors;           /* Azimuth sectors of the horizon angles */
   int StreamTemp;
+  int StreamTempSolver;         /* STREAMTEMP_EXTERNAL (RBM forcing files)
+                                   or STREAMTEMP_INTERNAL */
+  int QuietCells;               /* QUIET_NONE, QUIET_EXACT or QUIET_RELAXED
+                                   fast path for quiescent cells */
   int CanopyShading;
   int ImprovRadiation;          /* if TRUE then improved radiation scheme is on */
+  int NThreads;                 /* Number of threads used in the pixel loop */
+  int CellTileSize;             /* Active cells per tile of the threaded
+                                   cell loops, 0 for fixed blocks */
+  int CellOrder;                /* CELLORDER_ROW, CELLORDER_MORTON or
+                                   CELLORDER_TILES order of the active
+                                   cells */
+  int CellOrderTile;            /* Cells on a side of the CELLORDER_TILES
+                                   tiles */
+  int CellClassOrder;           /* TRUE if the pixel loop groups the cells
+                                   by their structure class */
+  int ThreadPinning;            /* PIN_NONE, PIN_CLOSE or PIN_SPREAD */
+  int HugePages;                /* TRUE if the large maps are allocated
+                                   with transparent huge pages */
+  int Profile;                  /* TRUE if the time loop phases are timed */
+  char TraceFile[BUFSIZE + 1];  /* Chrome trace of the run, "" for none */
+  int TraceInterval;            /* Steps between the traced steps */
+  int PerfCounters;             /* TRUE if the hardware events of the
+                                   profiled phases are counted */
+  unsigned long PerfScalarEvent; /* raw codes of the scalar and packed */
+  unsigned long PerfVectorEvent; /* floating point instructions, 0 if none */
+  int CellCostTiming;           /* TRUE if the wall clock time of each cell
+                                   is summed in SOILPIX.CostTime */
+  float MemoryLimit;            /* MB above which the allocations are
+                                   reported, 0 for the physical memory */
+  int MessageLevel;             /* MSG_ERROR ... MSG_DEBUG, highest severity
+                                   of the printed messages */
+  int MessageLimit;             /* messages printed per site, 0 for all */
+  int SimdLevel;                /* SIMD_AUTO or the SIMD_ level of the
+                                   vector kernels */
+  int MathAccuracy;             /* MATH_EXACT, MATH_FLOAT or MATH_FAST, of
+                                   exp, log and pow */
+  int Rollover;                 /* ROLLOVER_NONE, ROLLOVER_YEAR or
+                                   ROLLOVER_MONTH */
+  char RolloverName[BUFSIZE + 1]; /* template of the names of the files of
+                                     a period */
+  int CheckpointCompression;    /* RESUME_RAW or RESUME_ZLIB */
+  int CheckpointLevel;          /* zlib level of the checkpoint, 1 to 9 */
+  int CheckpointShuffle;        /* TRUE if the bytes of the words of the
+                                   checkpoint are regrouped */
+  char OutOfCoreDir[BUFSIZE + 1]; /* scratch files of the shadow maps,
+                                   "" to keep them in memory */
+  int AutoTune;                 /* TRUE if the thread count and tile size
+                                   of the cell loops are timed at the start */
+  int AutoTuneSteps;            /* steps of each trial, 0 for a day */
+  char AutoTuneFile[BUFSIZE + 1]; /* choices of earlier runs, "" for none */
+  int SnowOnly;                 /* TRUE if only the snow pack is modeled */
+  char TelemetryFile[BUFSIZE + 1]; /* progress records, "" for none */
+  int TelemetryFormat;          /* TELEMETRY_JSON or TELEMETRY_PROMETHEUS */
+  float TelemetryInterval;      /* wall clock seconds between the records,
+                                   0 for every step */
+  char MonitorFeed[BUFSIZE + 1]; /* ring buffer of the live viewers, "" for
+                                   none */
+  int MonitorSlots;             /* steps held by the ring buffer */
+  int MonitorStride;            /* cells of the side of a block of the
+                                   coarse maps, 0 for no maps */
+  int ParallelInit;             /* if TRUE the independent stages of the
+                                   initialization run concurrently */
+  int ParallelRouting;          /* if TRUE the channel networks are routed
+                                   level by level with NThreads threads */
+  int RoutingBatch;             /* if TRUE the segments of a level of the
+                                   channel networks are routed together */
+  int NcSyncInterval;           /* Number of writes to an open NetCDF file
+                                   between nc_sync calls (0 = at close only) */
+  int MaxInterpStations;        /* Maximum number of stations used for a
+                                   pixel (0 = no limit) */
+  int PrefetchMet;              /* if TRUE the station records for the next
+                                   step are read on a second thread */
+  int TSurfSolver;              /* BRENT or NEWTON (safeguarded Newton with
+                                   a warm start) surface temperature solver */
+  float WaterTableTol;          /* Change in water level (m) that triggers
+                                   a recalculation of the subsurface flow 
+                                   directions (WATERTABLE only) */
+  int SoilTableSize;            /* Number of entries in the soil 
+                                   transmissivity and drainage tables, 
+                                   0 to use the exact functions */
+  int RadiationTableSize;       /* Number of entries in the diffuse fraction
+                                   table of SeparateRadiation(), 0 to use
+                                   the exact relation */
+  int OutputQueueSize;          /* Number of map writes that may be pending
+                                   on the writer thread (0 = synchronous) */
+  int BasinOnlyOutput;          /* if TRUE map and state files only hold
+                                   the cells in the basin, as a vector */
+  int MapFileLayout;            /* MAPFILES_SEPARATE (a file per map dump)
+                                   or MAPFILES_COMBINED (a NetCDF file per
+                                   set of map dates) */
+  int MetInterval;              /* Interval of the station and MM5
+                                   records (s), 0 for a record per time
+                                   step */
+  int MetInterpolation;         /* METINTERP_LINEAR or METINTERP_CUBIC
+                                   forcing between the records */
+  int ChannelOutput;            /* CHANNEL_TEXT, CHANNEL_BINARY flow files
+                                   or CHANNEL_NONE */
+  int ChannelRecord;            /* TRUE to record the lateral inflows of the
+                                   streams in Stream.Inflow.bin */
+  int PixelOutput;              /* PIXEL_TEXT (a file per pixel) or
+                                   PIXEL_BINARY (Pixel.bin) time series */
+  int StateFormat;              /* STATE_MAPS or STATE_CHECKPOINT model
+                                   state files */
+  int CheckpointBase;           /* Every CheckpointBase-th checkpoint is a
+                                   full one, the others are deltas */
+  int CheckpointFlows;          /* TRUE if checkpoints also hold the flows
+                                   of the stream segments */
+  int SpinUpCycles;             /* Largest number of times the model period
+                                   is run to spin up the state, 0 for a
+                                   normal run */
+  float SpinUpTol;              /* RMS change of the cell water storage over
+                                   a cycle (m) at which the spin-up stops */
+  float SpinUpAccel;            /* Factor the deep layer moisture change of
+                                   a cycle is extrapolated with (1 = none) */
+  float CheckpointWall;         /* Wall clock minutes between the resume
+                                   checkpoints, 0 for none */
+  char StaticShare[BUFSIZE + 1];  /* Shared segment of the static maps,
+                                     empty if not used */
+  int SoilColumnBatch;          /* TRUE to do DistributeSatflow() and
+                                   UnsaturatedFlow() for the cells of a soil
+                                   type together */
+  int RadiationBatch;           /* TRUE to do RadiationBalance() for the
+                                   cells of a piece of the pixel loop
+                                   together */
+  int InterceptionBatch;        /* TRUE to do the rain interception of the
+                                   cells of a piece of the pixel loop
+                                   together, with RadiationBatch */
+  int PipelineChannel;          /* TRUE if the stream network of a step is
+                                   routed while the next step is computed */
+  int ConcurrentStages;         /* TRUE if the independent stages of a time
+                                   step run concurrently */
+  int ConcurrentNetworks;       /* TRUE if the road network is routed next
+                                   to the stream inflows of the step */
+  int NMembers;                 /* Number of ensemble members */
+  int Member;                   /* Ensemble member run by this process */
+  float *EnsemblePrecip;        /* Precipitation factor of each member */
+  float PrecipFactor;           /* EnsemblePrecip[Member], or set with
+                                   dhsvm_set_precipitation_factor() */
+  float PerturbPrecip;          /* Standard deviation of the log of the
+                                   precipitation factor of a member */
+  float PerturbTemp;            /* Standard deviation of the air
+                                   temperature offset of a member (C) */
+  float PerturbRadiation;       /* Standard deviation of the log of the
+                                   shortwave factor of a member */
+  float PerturbLag;             /* Lag one autocorrelation of the
+                                   perturbations */
+  float PerturbShared;          /* Correlation of the perturbations of the
+                                   stations */
+  int PerturbSeed;              /* Seed of the perturbations */
+  int NoOutput;                 /* TRUE while the time steps write no
+                                   output, see dhsvm_set_output() */
+  char EstimateDir[BUFSIZE + 1]; /* OUTPUT DIRECTORY of the steps timed by
+                                    dhsvm_estimate() or dhsvm_io_bench(),
+                                    "" otherwise */
+  int HRU;                      /* if TRUE cells with the same classes
+                                   share their vertical physics */
+  float HRUElevBand;            /* Width of the HRU elevation classes (m) */
+  float HRUSlopeClass;          /* Width of the slope classes (degrees) */
+  float HRUAspectClass;         /* Width of the aspect classes (degrees) */
+  float HRUDepthClass;          /* Width of the soil depth classes (m) */
+  float HRUSkyViewClass;        /* Width of the sky view classes */
+  float HRUWeightTol;           /* Met interpolation weights closer than
+                                   this are the same */
+  int MetGridSpacing;           /* Model cells between the coarse met
+                                   nodes, 1 if the met is interpolated for
+                                   every cell */
+  char MetCacheFile[BUFSIZE + 1];  /* Binary cache of the station met 
+                                     files, empty if not used */
+  int MaxMetFiles;              /* Maximum number of open station met 
+                                   files, 0 if they all stay open */
+  int StaticMapBits;            /* Bits of the fixed point codes of the 
+                                   static maps, 0 if the values are kept */
+  int RoutingSubsteps;          /* Channel routing steps in each model
+                                   step, 1 to route with the model step */
+  int SubSurfaceSubsteps;       /* Subsurface routing steps in each model
+                                   step, 1 to route with the model step;
+                                   the rest of the model runs at the
+                                   model step */
   char PrismDataPath[BUFSIZE + 1];
   char PrismDataExt[BUFSIZE + 1];
   char ShadingDataPath[BUFSIZE + 1];
   char ShadingDataExt[BUFSIZE + 1];
   char SkyViewDataPath[BUFSIZE + 1];
+  char HorizonFile[BUFSIZE + 1];  /* Cache of the horizon angles, "" for
+                                   none */
   char ImperviousFilePath[BUFSIZ + 1];
 } OPTIONSTRUCT;
 
 typedef struct {
   float Precip;					/* Total amount of precipitation at pixel (m) */
-  float SumPrecip;              /* Accumulated precipitation at pixel (m) */
+  float SumPrecip;              /* Accumulated precipitation at pixel (m),
+                                   only with DIAG_SUMPRECIP */
   float RainFall;		        /* Amount of rainfall (m) */
   float SnowFall;		        /* Amount of snowfall determined by air temperature (m) */
   float MomentSq;               /* Momentum squared for rain (kg* m/s)^2 /m^2*s) */
@@ -303,6 +832,7 @@ typedef struct {
   float FlowSlope;               /* Representative road surface slope along the flow path (m/m) */
   ChannelClass *RoadClass;       /* Class of road with most area in the pixel */
   float *h;                      /* Infiltration excess on road grid cell (m)*/
+  SOILCAPACITY Capacity;         /* Constants of the soil column of the cell, set by InitSoilCapacity() */
 } ROADSTRUCT;
 
 typedef struct {
@@ -326,6 +856,7 @@ typedef struct {
   float SolarTimeStep;		/* Fraction of the timestep the sun is above the horizon  */
 
   float SunMax;				/* Calculated solar radiation at the top of the atmosphere (W/m^2) */
+  int DayOfYear;			/* Day of the sun, set by InitNewDay() */
 } SOLARGEOMETRY;
 
 typedef struct {
@@ -347,6 +878,8 @@ typedef struct {
                                A negataive value indicates flux from snow -- sublimiation */
   float CanopyVaporMassFlux;/* Vapor mass flux to/from intercepted snow in the canopy (m/timestep) */
   float Glacier;		    /* Amount of snow added to glacier during simulation */
+  int TSurfIter;		    /* Number of energy balance evaluations used to
+                               solve for TSurf this time step */
 } SNOWPIX;
 
 typedef struct {
@@ -372,11 +905,24 @@ typedef struct {
   float Qg;				/* Ground heat exchange */
   float Qst;			/* Ground heat storage */
   float Ra;				/* Soil surface aerodynamic resistance (s/m) */
+  int TSurfIter;		/* Number of energy balance evaluations used to
+                           solve for TSurf this time step */
   float InfiltAcc;               /* Accumulated water in the top layer (m) */
   float MoistInit;               /* Initial moisture content when ponding begins (0-1) */
   float DetentionStorage;        /* amount of water kept in detention storage when impervious fraction > 0 */
   float DetentionIn;			 /* detention storage change in current time step */
   float DetentionOut;            /* water flow out of detention storage */
+  int CostSurfEval;		/* Energy balance evaluations for the soil surface
+                           temperature, summed over the run */
+  int CostSnowEval;		/* Energy balance evaluations for the snow surface
+                           temperature, summed over the run */
+  int CostSnowSteps;		/* Number of time steps with the snow pack model */
+  int CostUnsatLayers;		/* Number of soil layers that drained, summed
+                           over the run */
+  int CostQuietSteps;		/* Number of time steps on the quiescent cell
+                           fast path */
+  float CostTime;		/* Wall clock time of the cell (ms), summed over
+                           the run, with CELL COST TIMING = TRUE */
 } SOILPIX;
 
 typedef struct {
@@ -396,9 +942,20 @@ typedef struct {
   float *KhDry;				/* Thermal conductivity for dry soil (W/(m*K)) */
   float *KhSol;				/* Effective solids thermal conductivity (W/(M*K)) */
   float *Ch;				/* Heat capacity for soil medium */
+  float *KhSatFrozen;		/* Thermal conductivity of the frozen
+				   saturated soil (W/(m*K)) */
+  float *KhSatThawed;		/* Thermal conductivity of the unfrozen
+				   saturated soil (W/(m*K)), see
+				   CalcSaturatedKh() */
+  float *ChSolids;		/* Heat capacity of the solids,
+				   (1 - Porosity) * Ch */
   float MaxInfiltrationRate;/* Maximum infiltration rate for upper layer (m/s) */
   float G_Infilt;                /* Mean capillary drive for dynamic maximum infiltration rate (m)   */
   float DepthThresh;    /* Threshold water table depth, beyond which transmissivity decays linearly with water table depth */
+  FLOATTABLE TransTable;    /* exp(-KsLatExp * depth), Data is NULL if not 
+                               used (see InitTransmissivityTable()) */
+  FLOATTABLE *DrainTable;   /* Brooks-Corey drainage (Moist/Porosity)^Exponent
+                               for each layer, NULL if not used */
 } SOILTABLE;
 
 typedef struct {
@@ -431,6 +988,104 @@ typedef struct {
   ITEM *OrderedTopoIndex;       /* Structure array to hold the ranked topoindex for fine pixels in a coarse pixel */
 } TOPOPIX;
 
+typedef struct {
+  int NCells;			/* Number of draining cells (Map->NumActive) */
+  int *Start;			/* Index of the first receiver of each active
+				   cell in RecvX, RecvY and Fract, NCells+1 */
+  int *RecvX;			/* x-loc of each receiving cell */
+  int *RecvY;			/* y-loc of each receiving cell */
+  float *Fract;			/* Fraction of the outflow going to each
+				   receiving cell (Dir/TotalDir) */
+  int *Index;			/* Active cell index of each grid cell, -1 if
+				   not active, NY*NX */
+  int *RevStart;		/* Index of the first donor of each active 
+				   cell in RevDonor and RevEdge, NCells+1 */
+  int *RevDonor;		/* Active cell index of each donor, in 
+				   increasing order for each receiver */
+  int *RevEdge;			/* Index of the donor's entry in RecvX, RecvY
+				   and Fract */
+} FLOWGRAPH;			/* Downslope neighbours with a non-zero Dir 
+				   for all active cells, in Map->ActiveCells
+				   order */
+
+typedef struct {
+  int NPervious;		/* Number of cells without a stream channel
+				   and without an impervious fraction */
+  int *Pervious;		/* Active cell index of each of them */
+  int NChannel;			/* Number of cells with a stream channel */
+  int *Channel;			/* Active cell index of each of them */
+  int NUrban;			/* Number of cells without a stream channel
+				   with an impervious fraction */
+  int *Urban;			/* Active cell index of each of them */
+  int *DrainX;			/* x-loc of the cell the impervious runoff of
+				   each urban cell drains to */
+  int *DrainY;			/* y-loc of that cell */
+  float *Direct;		/* Fraction of the runoff going straight to
+				   the drain, (1 - DetentionFrac) *
+				   ImpervFrac */
+  float *Detained;		/* Fraction of the runoff going to the
+				   detention storage, DetentionFrac *
+				   ImpervFrac */
+  float *Decay;			/* DetentionDecay of each urban cell */
+  float *PerviousFrac;		/* Fraction of the runoff routed to the
+				   neighbours, 1 - ImpervFrac */
+} SURFACEROUTE;			/* Surface routing lists of the active cells,
+				   in Map->ActiveCells order, see
+				   InitSurfaceRoute() */
+
+typedef struct {
+  float *FlowGrad;		/* Magnitude of subsurface flow gradient slope * 
+				   width, NY*NX */
+  unsigned char *Dir;		/* Fraction of subsurface flux moving in each 
+				   direction, NY*NX*NDIRS */
+  unsigned int *TotalDir;	/* Sum of Dir array, NY*NX */
+  float *LastLevel;		/* Water level for which the directions were
+				   last calculated, NY*NX */
+  unsigned char *Changed;	/* Cells whose water level moved by more than
+				   the tolerance, (NY+2)*(NX+2) with a zero 
+				   border, see AllocHaloMap() */
+  int Valid;			/* FALSE until all directions have been 
+				   calculated once */
+  FLOWGRAPH Graph;		/* Receivers based on Dir */
+  float *OutFlow;		/* Outflow of each active cell to its 
+				   receivers, NumActive */
+  float *OwnFlow;		/* Flow removed from each active cell, 
+				   NumActive */
+  float *ChannelFlow;		/* Flow of each active cell to a road or 
+				   stream channel, NumActive */
+  unsigned char *ToChannel;	/* ROAD_INFLOW, STREAM_INFLOW or 0 for each
+				   active cell, NumActive */
+  float *BankHeight;		/* Lesser of the cut bank height and the soil
+				   depth, NumActive */
+  float *FractUsed;		/* Fraction of the outflow directions that 
+				   is used (sum of Dir / TotalDir), NumActive */
+  float *RoadFract;		/* Network fraction / TotalDir, NumActive */
+  unsigned char *HasChannel;	/* HAS_STREAM and HAS_ROAD bits, NumActive */
+  int ConstValid;		/* FALSE until the above have been set */
+  unsigned char *Updated;	/* Cells whose directions HeadSlopeAspect()
+				   recalculated in the last call, NY*NX */
+  TILESCHEDULE Tiles;		/* Schedule of the outflow sweep */
+} SUBSURFACEWORK;
+
+typedef struct {
+  int Active;			/* TRUE if OPTIONS HRU MODE is TRUE */
+  int NReps;			/* Number of cells for which the vertical
+				   physics is run */
+  int *Rep;			/* Those cells (active cell index), sorted
+				   by unit */
+  int NMembers;			/* Number of cells that get the results of
+				   another cell */
+  int *Member;			/* Those cells (active cell index) */
+  int *RepOf;			/* The cell each member gets them from */
+  int *Slot;			/* Index into Delta and SatFlow of each
+				   active cell with members, -1 otherwise,
+				   NumActive */
+  int Stride;			/* Values per slot in Delta */
+  float *Delta;			/* Change in soil moisture of each layer and
+				   in IExcess (last) over the time step */
+  float *SatFlow;		/* Lateral inflow of each representative */
+} HRUSTRUCT;
+
 typedef struct {
   int Veg;			/* Vegetation type */
   float Tcanopy;		        /* Canopy temperature (C) */
@@ -471,6 +1126,7 @@ typedef struct {
   float LeafAngleB;		/* parameter describing the leaf Angle Distribution */
   float Scat;			/* scattering parameter (between 0.7 and 0.85) */
   float *Rpc;			/* fraction of radiaton that is photosynthetically active (PAR) */
+  float *RsRatio;		/* RsMin / RsMax, see InitNewMonth() */
   float *Albedo;		/* Albedo for each vegetation layer */
   float **AlbedoMonthly;
   float Cn;				/* Canopy attenuation coefficient for wind profile */
@@ -488,10 +1144,84 @@ typedef struct {
   float Vf;             /* Canopy view factor (0 - 1); Vf = VfAdjust*Fract */
   float VfAdjust;       /* Canopy view adjustment factor */
   float ExtnCoeff;            /* Light extinction coefficient varied by month */
+  float LD_FallVelocity;      /* Leaf drip fall velocity for the canopy
+                                 height (m/s) */
+  double LD_MomentSq;         /* Momentum squared of the leaf drip per
+                                 depth of drip, times drip (m) / Dt (s)
+                                 gives (kg* m/s)^2 /(m^2 * s), see
+                                 InitLeafDrip() */
   float MonthlyExtnCoeff[12]; /* Monthly light extinction (or attenuation coeff); unit: m^-1; 
                              used in improved radiation scheme */
 } VEGTABLE;
 
+typedef struct {
+  SOILPIX *Soil;		/* State of the cell */
+  SOILTABLE *SType;		/* Soil type of the cell */
+  VEGTABLE *VType;		/* Vegetation type of the cell */
+  ROADSTRUCT *Network;		/* Channel and road cut of the cell */
+  float Infiltration;		/* Arguments of UnsaturatedFlow(), set by */
+  float RoadbedInfiltration;	/* MassEnergyBalance() */
+  int Pending;			/* TRUE if UnsaturatedFlow() is to be done */
+} SOILCOLUMN;			/* Soil column of a cell in a SOILBATCH */
+
+typedef struct {
+  int N;			/* Number of columns */
+  int MaxColumns;		/* Allocated columns */
+  SOILCOLUMN *Column;		/* Columns of the cells of a tile */
+  int *Order;			/* Columns sorted by soil type */
+  int MaxLayers;		/* Soil layers the lanes have room for */
+  float *Lanes;			/* Layer values of the lanes, see
+				   SoilColumnBatch.c */
+} SOILBATCH;			/* Soil columns of a tile, done for the cells
+				   of one soil type at once */
+
+typedef struct {
+  int N;			/* Number of cells */
+  int MaxCells;			/* Allocated cells */
+  PIXMET *Met;			/* Met of each cell, MakeLocalMetData() */
+  VEGTABLE **VType;		/* Vegetation type of each cell */
+  PIXRAD **Rad;			/* Radiation balance of each cell */
+  unsigned char *OverStory;	/* VType->OverStory of each cell */
+  float *Fields;		/* Inputs and results of the radiation
+				   balance, one array of MaxCells values
+				   per variable, see RadiationBatch.c */
+} RADBATCH;			/* Radiation balance of the cells of a piece
+				   of the pixel loop */
+
+typedef struct {
+  int N;			/* Number of cells */
+  int MaxCells;			/* Allocated cells */
+  PRECIPPIX **Precip;		/* Precipitation of each cell */
+  unsigned char *Vegetated;	/* VType->NVegLayers > 0 of each cell */
+  unsigned char *NActual;	/* Vegetation layers above the snow */
+  unsigned char *UnderStory;	/* VType->UnderStory of each cell */
+  double *LD_MomentSq;		/* VType->LD_MomentSq of each cell */
+  float *Fields;		/* Inputs and results of the interception,
+				   one array of MaxCells values per
+				   variable, see InterceptionBatch.c */
+} INTBATCH;			/* Rain interception of the cells of a
+				   piece of the pixel loop */
+
+typedef struct {
+  VEGTABLE *VType;		/* Vegetation type of the class */
+  SOILTABLE *SType;		/* Soil type of the class */
+  int NVegLayers;		/* Veg.NLayers of the vegetation type */
+  int NSoilLayers;		/* Soil.NLayers of the soil type */
+} CELLCLASS;			/* Combination of a vegetation and a soil
+				   type */
+
+typedef struct {
+  int NClasses;			/* Number of classes in the basin */
+  CELLCLASS *Class;		/* The classes */
+  unsigned short *Of;		/* Class of each active cell, in
+				   Map->ActiveCells order */
+  unsigned char *Structure;	/* STRUCTURE_ bits of each active cell but
+				   STRUCTURE_SNOW, NULL without CELL CLASS
+				   ORDER */
+  int *Sorted;			/* Scratch of OrderStructureClasses() */
+} CELLCLASSES;			/* Classes of the active cells, see
+				   CellClass.c */
+
 typedef struct {
   float StartWaterStorage;
   float OldWaterStorage;
@@ -503,8 +1233,42 @@ typedef struct {
   float CumSnowVaporFlux;
   float CumCulvertReturnFlow;
   float CumCulvertToChannel;
+  /* fluxes of the time steps since the last line of Mass.Balance, see
+     AccumulateMassBalance() */
+  float IntervalPrecip;
+  float IntervalSnowFall;
+  float IntervalET;
+  float IntervalSnowVaporFlux;
+  float IntervalCanopyVaporFlux;
+  float IntervalChannelInt;
+  float IntervalRoadInt;
+  float IntervalCulvertReturnFlow;
+  float IntervalCulvertToChannel;
 } WATERBALANCE;
 
+typedef struct {
+  int Cycle;			/* Number of cycles of the model period done */
+  float *Storage;		/* Water storage of each active cell at the
+				   start of the cycle (m), NumActive */
+  float *DeepMoist;		/* Deep layer moisture of each active cell at
+				   the start of the cycle, NumActive, only
+				   with SPIN UP ACCELERATION > 1 */
+} SPINUP;			/* Spin-up cycles (SPIN UP CYCLES), see
+				   SpinUp.c */
+
+typedef struct {
+  DATE Date;			/* Start of the first step with the new map */
+  int Variable;			/* MAPEVENT_VEGETATION or MAPEVENT_SOILDEPTH */
+  char FileName[BUFSIZE + 1];	/* File with the new map */
+} MAPEVENT;
+
+typedef struct {
+  int NEvents;			/* NUMBER OF MAP EVENTS */
+  MAPEVENT *Event;		/* The events sorted by date */
+  int Next;			/* First event that has not been applied */
+} MAPEVENTS;			/* Maps replaced during the run, see
+				   MapEvents.c */
+
 typedef struct {
   float accum_precip;
   float air_temp;
@@ -533,8 +1297,13 @@ typedef struct {
   float ChannelInt;
   float RoadInt;
   unsigned long Saturated;
+  float SatExtent;              /* Percentage of basin pixels with a water
+                                   table at least MTHRESH of soil depth */
   float CulvertReturnFlow;
   float CulvertToChannel;
+  int Full;                     /* TRUE if Aggregate() collected all the
+                                   values, FALSE if AggregateFluxes() only
+                                   collected the mass balance fluxes */
 } AGGREGATED;
 
 #endif
@@ -0,0 +1,3462 @@
+/*
+ * SUMMARY:      dhsvm.c - DHSVM as a library
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Initializes the model, advances it one time step at a time
+ *               and gives access to the model state, so that DHSVM can be
+ *               driven by another program or coupling framework.
+ *               MainDHSVM.c is the driver for a stand-alone run
+ * DESCRIP-END.
+ * FUNCTIONS:    dhsvm_initialize()
+ *               dhsvm_update()
+ *               dhsvm_update_until()
+ *               dhsvm_get_current_time()
+ *               dhsvm_get_end_time()
+ *               dhsvm_get_time_step()
+ *               dhsvm_get_value_ptr()
+ *               dhsvm_get_value_size()
+ *               dhsvm_get_value()
+ *               dhsvm_get_layer()
+ *               dhsvm_add_increment()
+ *               dhsvm_snapshot()
+ *               dhsvm_restore()
+ *               dhsvm_free_snapshot()
+ *               dhsvm_set_precipitation_factor()
+ *               dhsvm_set_output()
+ *               dhsvm_reload_forcing()
+ *               dhsvm_fork()
+ *               dhsvm_set_resume()
+ *               dhsvm_estimate()
+ *               dhsvm_io_bench()
+ *               dhsvm_catch_signals()
+ *               dhsvm_finalize()
+ *               cleanup()
+ *               GroupCells()
+ *               SplitPixelLoop()
+ *               RetileCellLoops()
+ *               TuneCellLoops()
+ *               TuneTrial()
+ *               PixelCell()
+ *               StartSoilBatch()
+ *               FinishSoilBatch()
+ *               CellMet()
+ *               StartRadiationBatch()
+ *               StartInterceptionBatch()
+ *               SetModelTime()
+ *               EndSpinUpCycle()
+ *               StepMapEvents()
+ *               StepReset()
+ *               StepNewMonth()
+ *               StepNewDay()
+ *               StepNewStep()
+ *               StepChannels()
+ *               StepPixels()
+ *               StepStreamHeat()
+ *               StepSubSurface()
+ *               StepPrefetch()
+ *               StepRouteChannel()
+ *               StepRouteSurface()
+ *               StepGraphics()
+ *               StepAggregate()
+ *               StepDump()
+ *               StepObjective()
+ *               AddStage()
+ *               InitStepTasks()
+ *               CellWater()
+ *               UpdateCell()
+ *               SaveMap()
+ *               RestoreMap()
+ *               CopyLayers()
+ *               CopySegments()
+ *               BranchName()
+ *               BranchOutput()
+ *               CatchStop()
+ *               ListOutput()
+ *               AddOutput()
+ *               MakeResumeHeader()
+ *               StoreResume()
+ *               OpenResume()
+ *               LoadResume()
+ *               WriteResume()
+ *               ReadResume()
+ *               LoadResumeMap()
+ *               KeepPointers()
+ * COMMENTS:     The model state is held in this file, so there is one model
+ *               per process.  Errors are still handled with ReportError(),
+ *               which ends the process
+ */
+
+/******************************************************************************/
+/*				    INCLUDES                                  */
+/******************************************************************************/
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <signal.h>
+#include "settings.h"
+#include "constants.h"
+#include "data.h"
+#include "DHSVMerror.h"
+#include "functions.h"
+#include "soilmoisture.h"
+#include "fileio.h"
+#include "getinit.h"
+#include "DHSVMChannel.h"
+#include "channel.h"
+#include "massenergy.h"
+#include "slopeaspect.h"
+#include "sizeofnt.h"
+#include "dhsvm.h"
+#include "graphics.h"
+#include "memaccount.h"
+#include "messagelog.h"
+#include "cpudispatch.h"
+#include "fastmath.h"
+#include "rollover.h"
+#include "resumeio.h"
+#include "profile.h"
+#include "trace.h"
+#include "telemetry.h"
+#include "monitorfeed.h"
+#include "inittasks.h"
+#include "stepgraph.h"
+#include "autotune.h"
+#include "estimate.h"
+#include "iobench.h"
+#ifdef HAVE_OPENMP
+#include <omp.h>
+#endif
+#ifdef HAVE_FORK
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+
+/******************************************************************************/
+/*				GLOBAL VARIABLES                              */
+/******************************************************************************/
+
+/* global strings */
+char *version = "Version 3.1.1";        /* store version string */
+char commandline[BUFSIZE + 1] = "";		/* store command line */
+char fileext[BUFSIZ + 1] = "";			/* file extension */
+
+/******************************************************************************/
+/*				  MODEL STATE                                 */
+/******************************************************************************/
+/* model state copied by dhsvm_snapshot() */
+struct DHSVMSNAPSHOT {
+  TIMESTRUCT Time;
+  int t;
+  WATERBALANCE Mass;
+  AGGREGATED Total;
+  int NextEvent;		/* Dump.NextEvent */
+  int NextMapEvent;		/* MapEvents.Next */
+  char *PrecipMap;
+  char *SnowMap;
+  char *SoilMap;
+  char *VegMap;
+  char *Network;
+  size_t NLayers;		/* number of values in Layers */
+  float *Layers;		/* layer arrays of the maps (CopyLayers()) */
+  int NStreams;			/* number of stream segments */
+  int NRoads;			/* number of road segments */
+  Channel *Segments;		/* stream segments followed by road segments */
+  ChannelRoute *Routes;		/* routing states of the Segments */
+  int NHydro;
+  float *Hydrograph;
+  long *MetPosition;		/* positions in the station files */
+};
+
+/* start of the resume checkpoint, followed by the table of the output 
+   files and the model state (see StoreResume()) */
+typedef struct {
+  char Magic[sizeof(RESUME_MAGIC) - 1];
+  int Version;
+  int Sizes[12];		/* sizes of the structures that are written 
+				   as they are */
+  int NY;
+  int NX;
+  int NumActive;
+  unint Geometry;		/* CheckpointGeometry() */
+  unint Network;		/* CheckpointNetwork() */
+  DATE Start;
+  DATE End;
+  int Dt;
+  int Rollover;			/* OPTIONS OUTPUT ROLLOVER */
+  DATE Period;			/* a date in the period of the open output
+				   files (GetRolloverDate()) */
+  int NFiles;			/* number of entries in the file table */
+  int Compression;		/* RESUME_RAW or RESUME_ZLIB, for what follows
+				   the header (ResumeIO.c) */
+  int Shuffle;			/* TRUE if the bytes of the words are
+				   regrouped */
+} RESUMEHEADER;
+
+/* pointer members of the cells, which keep the value of the cells of this
+   run when the cells are read from the resume checkpoint */
+static const size_t PrecipPointers[] = {
+  offsetof(PRECIPPIX, IntRain), offsetof(PRECIPPIX, IntSnow)
+};
+static const size_t SoilPointers[] = {
+  offsetof(SOILPIX, Moist), offsetof(SOILPIX, Perc), offsetof(SOILPIX, Temp)
+};
+static const size_t RoadPointers[] = {
+  offsetof(ROADSTRUCT, PercArea), offsetof(ROADSTRUCT, Adjust),
+  offsetof(ROADSTRUCT, RoadClass), offsetof(ROADSTRUCT, h)
+};
+static const size_t TotalPointers[] = {
+  offsetof(AGGREGATED, Evap.EPot), offsetof(AGGREGATED, Evap.EAct),
+  offsetof(AGGREGATED, Evap.EInt), offsetof(AGGREGATED, Evap.ESoil),
+  offsetof(AGGREGATED, Precip.IntRain), offsetof(AGGREGATED, Precip.IntSnow),
+  offsetof(AGGREGATED, Road.PercArea), offsetof(AGGREGATED, Road.Adjust),
+  offsetof(AGGREGATED, Road.RoadClass), offsetof(AGGREGATED, Road.h),
+  offsetof(AGGREGATED, Soil.Moist), offsetof(AGGREGATED, Soil.Perc),
+  offsetof(AGGREGATED, Soil.Temp)
+};
+#define NPOINTERS(List) ((int) (sizeof(List) / sizeof(List[0])))
+
+static int Initialized = FALSE;		/* TRUE between dhsvm_initialize() and
+					   dhsvm_finalize() */
+static float *Hydrograph = NULL;
+static float ***MM5Input = NULL;
+static STATICMAP PrecipLapseMap;
+static float **PrismMap = NULL;
+static SHADOWMAP ShadowMap;
+static STATICMAP SkyViewMap;
+static STATICMAP *WindModel = NULL;
+static int MaxStreamID, MaxRoadID;
+static double StartWall;			/* wall clock time at the start (s) */
+static double StartCpu;				/* CPU time at the start (s) */
+static int t = 0;
+static float roadarea;
+static int shade_offset;				/* a fast way of handling arraay position given the number of mm5 input options */
+static int NStats;					/* Number of meteorological stations */
+static METWEIGHT **MetWeights = NULL;	/* 2D array with weights for interpolating meteorological variables between the stations */
+
+static int NGraphics;				/* number of graphics for X11 */
+static int *which_graphics;			/* which graphics for X11 */
+
+static AGGREGATED Total = {			/* Total or average value of a  variable over the entire basin */
+  {0.0, NULL, NULL, NULL, NULL, 0.0},												/* EVAPPIX */
+  {0.0, 0.0, 0.0, 0.0, 0.0, NULL, NULL, 0.0, 0, 0.0},								/* PRECIPPIX */
+  {{0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}, 0.0, {0.0, 0.0}, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+                                                                                  /* PIXRAD */
+  {0.0, 0.0, 0, NULL, NULL, 0.0, 0, 0.0, 0.0, 0.0, 0.0, NULL, NULL},				/* ROADSTRUCT*/
+  {0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},		/* SNOWPIX */
+  {0, 0.0, NULL, NULL, NULL, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+  0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0},			                /* SOILPIX */
+  0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0l, 0.0, 0.0
+};
+static CHANNEL ChannelData = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, 
+NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+NULL, NULL, NULL, NULL, NULL, NULL};
+static DUMPSTRUCT Dump;
+static EVAPPIX **EvapMap = NULL;
+static INPUTFILES InFiles;
+static LAYER Soil;
+static LAYER Veg;
+static LISTPTR Input = NULL;			/* Linked list with input strings */
+static MAPSIZE Map;					/* Size and location of model area */
+static MAPSIZE Radar;				/* Size and location of area covered by precipitation radar */
+static MAPSIZE MM5Map;				/* Size and location of area covered by MM5 input files */
+static GRID Grid;
+static METLOCATION *Stat = NULL;
+static OPTIONSTRUCT Options;			/* Structure with information which program options to follow */
+static METFIELDS MetFields;			/* Interpolated met variables for all active cells */
+static PIXMET ChannelMet;			/* Meteorological conditions used in RouteChannel() */
+static ChannelGridAccum *ChannelAccum = NULL;	/* Channel inflows of the
+						   cells of the threaded
+						   pixel loop */
+static int *CellOrder = NULL;		/* Order of the active cells in the threaded 
+					   pixel loop */
+static TILESCHEDULE PixelTiles;		/* Tiles of the pixel loop */
+static DHSVMSNAPSHOT *TuneStart = NULL;	/* state the AUTO TUNE trials start
+					   from */
+static int TuneSteps;			/* steps of each AUTO TUNE trial */
+static HRUSTRUCT HRU;			/* Cells that share their vertical physics */
+static CELLCLASSES Classes;		/* Vegetation and soil class of each
+					   active cell */
+static MEBFUNCTION CellBalance = NULL;	/* MassEnergyBalance() for the options */
+static SOILBATCH *SoilBatch = NULL;	/* Soil columns of each thread, with
+					   SOIL COLUMN BATCH */
+static RADBATCH *RadBatch = NULL;	/* Radiation balance of each thread,
+					   with RADIATION BATCH */
+static INTBATCH *IntBatch = NULL;	/* Rain interception of each thread,
+					   with INTERCEPTION BATCH */
+static PRECIPPIX **PrecipMap = NULL;
+static float *RadarMap	= NULL;
+static PIXRAD **RadiationMap = NULL;
+static ROADSTRUCT **Network	= NULL;	/* 2D Array with channel information for each pixel */
+static SNOWPIX **SnowMap		= NULL;
+static MET_MAP_PIX **MetMap	= NULL;
+static SNOWTABLE *SnowAlbedo = NULL;
+static SOILPIX **SoilMap		= NULL;
+static SOILTABLE *SType	    = NULL;
+static FLOWGRAPH SurfaceGraph;		/* Receivers of each cell based on the
+				   surface flow directions */
+static SURFACEROUTE SurfaceRoute;	/* Urban, pervious and channel cells
+				   for RouteSurface() */
+static SPINUP SpinUp;			/* Storage at the start of the spin-up cycle */
+static MAPEVENTS MapEvents;		/* Maps replaced during the run */
+static OBJECTIVE Objective;		/* Fit to the OBSERVED FLOW FILE */
+static STEPGRAPH StepGraph;		/* Stages of a time step */
+static int StepOutput;			/* FALSE while the model is spun up or
+					   with Options.NoOutput */
+static TIMESTRUCT SpinUpTime;		/* Model time at the start of the cycles */
+static long *SpinUpMet = NULL;		/* Positions in the station files at the
+				   start of the cycles */
+static int Resume = FALSE;		/* TRUE to continue from the resume 
+				   checkpoint, see dhsvm_set_resume() */
+static char ResumeName[BUFSIZE + 1];	/* Resume checkpoint */
+static int Estimate = FALSE;		/* TRUE if dhsvm_initialize() is
+				   called by dhsvm_estimate() */
+static int IOBench = FALSE;		/* TRUE if dhsvm_initialize() is
+				   called by dhsvm_io_bench() */
+static int EstimateSteps = 0;		/* steps timed by dhsvm_estimate(), 0
+				   to only project the memory */
+static FILE *ResumeIn = NULL;		/* Resume checkpoint, open from 
+				   OpenResume() to LoadResume() */
+static int NResumeFiles = 0;
+static OUTPUTFILE *ResumeFiles = NULL;	/* Output files of the checkpoint */
+static double LastCheckpoint;		/* Wall clock time of the last resume
+				   checkpoint (s) */
+static volatile sig_atomic_t StopSignal = 0;	/* Set by SIGTERM or SIGUSR1 */
+static int Stopped = FALSE;		/* TRUE once the run has been stopped
+				   for StopSignal */
+static SUBSURFACEWORK SubWork;		/* Workspace for subsurface flow directions */
+static SOLARGEOMETRY SolarGeo;		/* Geometry of Sun-Earth system (needed for INLINE radiation calculations */
+static TIMESTRUCT Time;
+static TOPOPIX **TopoMap = NULL;
+static UNITHYDR **UnitHydrograph = NULL;
+static UNITHYDRINFO HydrographInfo;	/* Information about unit hydrograph */
+static VEGPIX **VegMap = NULL;
+static VEGTABLE *VType = NULL;
+static WATERBALANCE Mass =			/* parameter for mass balance calculations */
+  { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+/* variables available through dhsvm_get_value_ptr() */
+enum VIEWMAP { view_soil, view_snow, view_precip };
+static const struct {
+  const char *Name;
+  int Map;			/* map the variable is a field of */
+  size_t Offset;		/* offset of the field in a map cell */
+} ViewVars[] = {
+  {"water_table_depth", view_soil, offsetof(SOILPIX, TableDepth)},
+  {"saturated_flow", view_soil, offsetof(SOILPIX, SatFlow)},
+  {"surface_runoff", view_soil, offsetof(SOILPIX, IExcess)},
+  {"snow_water_equivalent", view_snow, offsetof(SNOWPIX, Swq)},
+  {"snow_pack_water", view_snow, offsetof(SNOWPIX, PackWater)},
+  {"snow_pack_temperature", view_snow, offsetof(SNOWPIX, TPack)},
+  {"precipitation", view_precip, offsetof(PRECIPPIX, Precip)},
+};
+#define NVIEWVARS (sizeof(ViewVars) / sizeof(ViewVars[0]))
+
+/* variable only available as a copy with dhsvm_get_value() */
+#define CHANNEL_OUTFLOW "channel_outflow"
+
+/* layered variable of dhsvm_get_layer() and dhsvm_add_increment() */
+#define SOIL_MOISTURE "soil_moisture"
+
+/* most stages of a time step, see InitStepTasks() */
+#define MAXSTAGES 17
+
+static void cleanup(DUMPSTRUCT *Dump, CHANNEL *ChannelData, OPTIONSTRUCT *Options);
+static int AtEnd(void);
+static void GroupCells(void);
+static void SplitPixelLoop(void);
+static void RetileCellLoops(void);
+static void TuneCellLoops(void);
+static double TuneTrial(void);
+static int PixelCell(int j);
+static void StartSoilBatch(SOILBATCH *Batch, int First, int Last);
+static void FinishSoilBatch(SOILBATCH *Batch, int First, int Last);
+static PIXMET CellMet(int y, int x, int k);
+static void StartRadiationBatch(RADBATCH *Batch, int First, int Last);
+static void StartInterceptionBatch(INTBATCH *Batch, RADBATCH *RadPiece,
+				   int First, int Last);
+static void WeightsTask(void *Unused);
+static void SetModelTime(const TIMESTRUCT *To, long *MetPosition);
+static int EndSpinUpCycle(void);
+static void StepMapEvents(void);
+static void StepReset(void);
+static void StepNewMonth(void);
+static void StepNewDay(void);
+static void StepNewStep(void);
+static void StepChannels(void);
+static void StepPixels(void);
+static void StepStreamHeat(void);
+static void StepSubSurface(void);
+static void StepPrefetch(void);
+static void StepRouteChannel(void);
+static void StepRouteSurface(void);
+static void StepGraphics(void);
+static void StepAggregate(void);
+static void StepDump(void);
+static void StepObjective(void);
+static void StepMonitor(void);
+static int AddStage(STEPTASK *Tasks, int n, const char *Name,
+		    void (*Run)(void), unsigned int Reads,
+		    unsigned int Writes, int Side);
+static void InitStepTasks(void);
+static void CatchStop(int Signal);
+static int ListOutput(OUTPUTFILE *List);
+static int AddOutput(OUTPUTFILE *List, int n, char *FileName, FILE **FilePtr);
+static void MakeResumeHeader(RESUMEHEADER *Header);
+static void StoreResume(void);
+static void OpenResume(void);
+static void LoadResume(void);
+static void WriteResume(const void *Data, size_t Size, size_t N);
+static void ReadResume(void *Data, size_t Size, size_t N);
+static void LoadResumeMap(char *Saved, size_t CellSize, const size_t *Pointers,
+			  int NPointers);
+static void KeepPointers(char *Cell, const char *Live, const size_t *Pointers,
+			 int NPointers);
+
+/*****************************************************************************
+  dhsvm_initialize()
+
+  Reads the configuration file ConfigFile and initializes the model to the
+  start of the run.  Returns 0 if the model is ready to run and 1 if an
+  estimate stops before the run (see dhsvm_estimate()).
+  commandline is set from ConfigFile unless the caller has set it already.
+*****************************************************************************/
+int dhsvm_initialize(const char *ConfigFile)
+{
+  const char *Routine = "dhsvm_initialize";
+  INITTASK Weights;		/* interpolation weights */
+  double Projected;		/* bytes projected by ProjectMemory() */
+  int *AllCells;		/* all the active cells, in order */
+  char *argv[2];		/* arguments for the X11 display */
+  int argc = 2;
+  int SimdLevel;		/* instruction set of the vector kernels */
+  int i;
+  int j;
+
+  if (Initialized)
+    ReportError((char *)Routine, 78);
+
+  strncpy(InFiles.Const, ConfigFile, BUFSIZE);
+  InFiles.Const[BUFSIZE] = '\0';
+  if (commandline[0] == '\0')
+    sprintf(commandline, "DHSVM %s", InFiles.Const);
+  printf("%s \n", commandline);
+  fprintf(stderr, "%s \n", commandline);
+  argv[0] = "DHSVM";
+  argv[1] = InFiles.Const;
+
+
+  printf("\nRunning DHSVM %s\n", version);
+  printf("\nSTARTING INITIALIZATION PROCEDURES\n\n");
+
+  /* Start recording time */
+  StartWall = WallClock();
+  StartCpu = CpuClock();
+  StartupStage(NULL);
+
+  ReadInitFile(InFiles.Const, &Input);
+  InitConstants(Input, &Options, &Map, &SolarGeo, &Time);
+  InitMapEvents(Input, &Options, Resume, &MapEvents);
+  CellBalance = SelectMassEnergyBalance(&Options);
+  if (Options.SoilColumnBatch &&
+      !(SoilBatch = (SOILBATCH *) calloc(Options.NThreads, sizeof(SOILBATCH))))
+    ReportError((char *)Routine, 1);
+  if (Options.RadiationBatch &&
+      !(RadBatch = (RADBATCH *) calloc(Options.NThreads, sizeof(RADBATCH))))
+    ReportError((char *)Routine, 1);
+  if (Options.InterceptionBatch &&
+      !(IntBatch = (INTBATCH *) calloc(Options.NThreads, sizeof(INTBATCH))))
+    ReportError((char *)Routine, 1);
+  InitMemoryLimit(Options.MemoryLimit);
+
+  /* an estimate or an I/O benchmark writes nothing outside its scratch
+     output directory */
+  if (Estimate || IOBench) {
+    Options.CheckpointWall = 0.0;
+    Options.TraceFile[0] = '\0';
+    Options.TelemetryFile[0] = '\0';
+    Options.MonitorFeed[0] = '\0';
+  }
+  InitMessageLog(Options.MessageLevel, Options.MessageLimit);
+  SimdLevel = InitCpuDispatch(Options.SimdLevel);
+  InitMathAccuracy(Options.MathAccuracy);
+  if (Options.SoilColumnBatch || Options.RadiationBatch)
+    printf("Vector kernels of the batches: %s\n", SimdLevelName(SimdLevel));
+  InitTrace(Options.TraceFile, Options.TraceInterval);
+  InitRollover(Options.Rollover, Options.RolloverName, &(Time.Start));
+  InitSolarSchedule(Time.Dt, &SolarGeo);
+  StartupStage("InitConstants");
+
+  InitFileIO(Options.FileFormat, Options.NcSyncInterval,
+	     Options.OutputQueueSize, Options.BasinOnlyOutput);
+
+  /* after the output thread is started, so that it may run anywhere */
+  InitThreadPlacement(&Options);
+  StartupStage("InitFileIO");
+
+  InitTables(Time.NDaySteps, Input, &Options, &SType, &Soil, &VType, &Veg,
+	     &SnowAlbedo);
+  StartupStage("InitTables");
+
+  InitTerrainMaps(Input, &Options, &Map, &Soil, &TopoMap, &SoilMap, &VegMap);
+  StartupStage("InitTerrainMaps");
+
+  /* the surface flow directions do not change during the run, with SNOW
+     ONLY they are only needed to trace a SUB-BASIN OUTLET */
+  if (!Options.SnowOnly || Options.OutletSegment >= 0 || Options.OutletY >= 0) {
+    InitFlowGraph(&Map, &SurfaceGraph);
+    MakeFlowGraph(&Map, TopoMap, NULL, NULL, &SurfaceGraph);
+  }
+
+  CheckOut(&Options, Veg, Soil, VType, SType, &Map, TopoMap, VegMap, SoilMap);
+  StartupStage("flow graph");
+
+  if (Options.HasNetwork)
+    InitChannel(Input, &Map, Time.Dt, &ChannelData, SoilMap, &MaxStreamID, &MaxRoadID, &Options);
+  StartupStage("InitChannel");
+
+  /* with a SUB-BASIN OUTLET only the cells draining to it are modeled */
+  InitSubBasin(&Options, &Map, TopoMap, &SurfaceGraph, &ChannelData,
+	       MaxStreamID, MaxRoadID);
+
+  if (!Options.HasNetwork && Options.Extent != POINT && !Options.SnowOnly)
+    InitUnitHydrograph(Input, &Map, TopoMap, &UnitHydrograph,
+		       &Hydrograph, &HydrographInfo);
+ 
+  InitNetwork(Map.NY, Map.NX, Map.DX, Map.DY, TopoMap, SoilMap, 
+	      VegMap, VType, &Network, &ChannelData, Veg, &Options);
+  if (!Options.SnowOnly)
+    InitSoilCapacities(&Map, TopoMap, SoilMap, VegMap, VType, SType, Network);
+
+  /* with SNOW ONLY nothing is routed */
+  if (Options.SnowOnly)
+    memset(&SubWork, 0, sizeof(SubWork));
+  else
+    InitSubSurfaceWork(&Map, &Options, &SubWork);
+  StartupStage("InitNetwork");
+
+  InitMetSources(Input, &Options, &Map, TopoMap, Soil.MaxLayers, &Time,
+		 &InFiles, &NStats, &Stat, &Radar, &MM5Map, &Grid);
+  StartupStage("InitMetSources");
+
+  /* an estimate stops here, before the met, shadow and output maps are
+     allocated, unless the projected memory leaves room to time the steps
+     (see dhsvm_estimate()) */
+  if (Estimate) {
+    Projected = ProjectMemory(Input, &Options, &Map, &Time, &SolarGeo, &Soil,
+			      &Veg, SoilMap, VegMap, NStats);
+    if (EstimateSteps == 0)
+      return 1;
+    if (MemoryLimitBytes() > 0.0 && Projected > MemoryLimitBytes()) {
+      printf("The projected memory is above the limit, the steps are not "
+	     "timed\n");
+      return 1;
+    }
+    Options.NMembers = 1;
+    MakeScratchOutput(Options.EstimateDir);
+  }
+  if (IOBench) {
+    Options.NMembers = 1;
+    MakeScratchOutput(Options.EstimateDir);
+  }
+
+  /* the maps and weights that the runs of the basin share are mapped
+     before they would be read */
+  InitStaticShare(&Options, &Map, &Time, &SolarGeo, &InFiles, NStats, Stat);
+
+  /* the weights only need the mask and the stations, and are computed
+     while the met maps are read */
+  StartInitTask(&Weights, "InterpolationWeights", WeightsTask, NULL,
+		Options.ParallelInit);
+
+  /* the following piece of code is for the UW PRISM project */
+  /* for real-time verification of SWE at Snotel sites */
+  /* Other users, set OPTION.SNOTEL to FALSE, or use TRUE with caution */
+
+  if (Options.Snotel == TRUE && Options.Outside == FALSE) {
+    printf
+      ("Warning: All met stations locations are being set to the vegetation class GLACIER\n");
+    printf
+      ("Warning: This requires that you have such a vegetation class in your vegetation table\n");
+    printf("To disable this feature set Snotel OPTION to FALSE\n");
+    for (i = 0; i < NStats; i++) {
+      printf("veg type for station %d is %d ", i,
+	     VegMap[Stat[i].Loc.N][Stat[i].Loc.E].Veg);
+      for (j = 0; j < Veg.NTypes; j++) {
+	    if (VType[j].Index == GLACIER) {
+	      VegMap[Stat[i].Loc.N][Stat[i].Loc.E].Veg = j;
+		  break;
+		}
+      }
+      if (j == Veg.NTypes) {	/* glacier class not found */
+	    ReportError((char *)Routine, 62);
+	  }
+      printf("setting to glacier type (assumed bare class): %d\n", j);
+    }
+  }
+
+  InitCellClasses(&Map, VegMap, SoilMap, VType, SType, &Veg, &Soil, &Classes);
+  if (Options.CellClassOrder)
+    InitStructureClasses(&Map, Network, &Classes);
+
+  if (Options.HasNetwork)
+    InitSurfaceRoute(&Map, TopoMap, VegMap, VType, &ChannelData,
+		     &SurfaceRoute);
+
+  InitMetMaps(Time.NDaySteps, &Map, &Radar, &Options, InFiles.WindMapPath,
+	      InFiles.PrecipLapseFile, &PrecipLapseMap, &PrismMap,
+	      &ShadowMap, &SkyViewMap, &EvapMap, &PrecipMap,
+	      &RadarMap, &RadiationMap, SoilMap, &Soil, VegMap, &Veg, TopoMap,
+	      &MM5Input, &WindModel);
+  StartupStage("InitMetMaps");
+
+  InitMetFields(&Map, &Options, NStats, &MetFields);
+
+  /* the nodes use the station elevations set with the weights (GRIDMET) */
+  WaitInitTask(&Weights);
+  StartupStage("wait for the weights");
+  InitMetNodes(&Map, &Options, TopoMap, Stat, NStats, &MetFields);
+  StartupStage("InitMetNodes");
+  PublishStaticShare(&Options, &Map, &Time, &SolarGeo, &SkyViewMap, WindModel,
+		     &PrecipLapseMap, MetWeights);
+
+  /* the static data is loaded, with ENSEMBLE MEMBERS each member continues
+     from here in its own process */
+  InitEnsemble(&Options, NStats, Stat);
+  StartupStage("InitEnsemble");
+
+  /* the output of the run so far is set aside before InitDump() creates the
+     output files again */
+  if (Resume)
+    OpenResume();
+
+  InitDump(Input, &Options, &Map, Soil.MaxLayers, Veg.MaxLayers, Time.Dt,
+	   TopoMap, &Dump, &NGraphics, &which_graphics);
+
+  if (Options.HasNetwork == TRUE) {
+    InitChannelDump(&Options, &ChannelData, Dump.Path);
+    InitObjective(Input, &Time, ChannelData.streams, &Objective);
+    if (Options.StateFormat == STATE_MAPS)
+      ReadChannelState(Dump.InitStatePath, &(Time.Start), ChannelData.streams);
+    if (Options.StreamTemp && Options.StreamTempSolver == STREAMTEMP_INTERNAL)
+      InitStreamTemp(&ChannelData, Options.NThreads);
+  }
+
+  InitSnowMap(&Map, &SnowMap);
+  InitAggregated(Veg.MaxLayers, Soil.MaxLayers, &Total);
+  StartupStage("InitDump");
+
+  InitModelState(&(Time.Start), &Map, &Options, PrecipMap, SnowMap, SoilMap,
+		 Soil, SType, VegMap, Veg, VType, Dump.InitStatePath,
+		 SnowAlbedo, TopoMap, Network, &HydrographInfo, Hydrograph,
+		 ChannelData.stream_net);
+  StartupStage("InitModelState");
+
+  InitNewMonth(&Time, &Options, &Map, TopoMap, PrismMap, &ShadowMap,
+	       &SolarGeo, &InFiles, Veg.NTypes, VType, NStats, Stat, Dump.InitStatePath);
+
+  InitNewDay(Time.Current.JDay, &SolarGeo);
+  StartupStage("InitNewMonth");
+
+  GroupCells();
+
+  if (NGraphics > 0)
+    InitGraphics(argc, argv, &Map, NGraphics, &Dump, &MetMap);
+
+  shade_offset = FALSE;
+  if (Options.Shading == TRUE)
+    shade_offset = TRUE;
+
+  /* private accumulators for threaded pixel loop, and with CELL CLASS ORDER,
+     so that the channel inflows are added in cell order */
+  if ((Options.NThreads > 1 || Options.CellClassOrder) &&
+      Options.HasNetwork && ChannelData.stream_map != NULL)
+    ChannelAccum = channel_grid_accum_alloc(ChannelData.stream_map, &Map,
+					    ChannelData.nstream_cells,
+					    ChannelData.stream_cells,
+					    Options.NThreads);
+  /* and for the interception of the subsurface flow, which comes from any
+     cell, added in active cell order */
+  if (Options.NThreads > 1 && Options.HasNetwork &&
+      ChannelData.stream_map != NULL) {
+    if (!(AllCells = (int *) calloc(Map.NumActive, sizeof(int))))
+      ReportError((char *)Routine, 1);
+    for (i = 0; i < Map.NumActive; i++)
+      AllCells[i] = i;
+    ChannelData.stream_accum =
+      channel_grid_accum_alloc(ChannelData.stream_map, &Map, Map.NumActive,
+			       AllCells, Options.NThreads);
+    if (ChannelData.road_map != NULL)
+      ChannelData.road_accum =
+	channel_grid_accum_alloc(ChannelData.road_map, &Map, Map.NumActive,
+				 AllCells, Options.NThreads);
+    free(AllCells);
+  }
+  if (Options.NThreads > 1) {
+    printf("Using %d threads for the pixel loop\n", Options.NThreads);
+    /* tiles keep their cells, and are balanced by their run time */
+    if (Options.CellTileSize > 0)
+      printf("Scheduling the cell loops in %d tiles of %d cells\n",
+	     PixelTiles.NTiles, Options.CellTileSize);
+  }
+  /* order of the cells of the pixel loop, made at each step */
+  if ((Options.NThreads > 1 && (Options.CellTileSize == 0 ||
+				Options.AutoTune)) ||
+      Options.CellClassOrder) {
+    if (!(CellOrder = (int *) calloc(Map.NumActive, sizeof(int))))
+      ReportError((char *)Routine, 1);
+  }
+
+  /* the stream routing of a step only runs next to the following step if
+     that step adds its channel inflows to ChannelAccum, and if nothing
+     before RouteSubSurface() reads the stream segments: the stream
+     temperature reads them in the pixel loop, and the objective function
+     after each step */
+  if (Options.PipelineChannel) {
+    if (ChannelAccum == NULL || ChannelData.streams == NULL ||
+	Options.StreamTemp || Objective.NSegments > 0) {
+      printf("WARNING: PIPELINE CHANNEL ROUTING needs NUMBER OF THREADS > 1 "
+	     "and a stream network, and cannot be used with STREAM "
+	     "TEMPERATURE or an OBSERVED FLOW FILE\n");
+      Options.PipelineChannel = FALSE;
+    }
+    else
+      printf("Routing the stream network of each step while the next step "
+	     "is computed\n");
+  }
+
+  /* Done with initialization, delete the list with input strings */
+  DeleteList(Input);
+
+  /* setup for mass balance calculations */
+  Aggregate(&Map, &Options, TopoMap, &Soil, &Veg, &Classes, EvapMap, PrecipMap,
+	      RadiationMap, SnowMap, SoilMap, &Total, Network, &ChannelData, &roadarea);
+
+  Mass.StartWaterStorage =
+    Total.Soil.IExcess + Total.CanopyWater + Total.SoilWater + Total.Snow.Swq +
+    Total.Soil.SatFlow;
+  Mass.OldWaterStorage = Mass.StartWaterStorage;
+
+  /* the model period is run again from here in each spin-up cycle */
+  if (Options.SpinUpCycles > 0) {
+    InitSpinUp(&Options, &Map, &Soil, &Veg, VType, PrecipMap, SnowMap,
+	       SoilMap, VegMap, Network, &SpinUp);
+    SpinUpTime = Time;
+    if (!(SpinUpMet = (long *) calloc(NStats + 1, sizeof(long))))
+      ReportError((char *)Routine, 1);
+    TellMetFiles(NStats, Stat, SpinUpMet);
+  }
+
+  /* the stream cells and their segments, with the number of grid cells
+     contributing to each segment */
+  if (Options.StreamTemp) {
+	ChannelData.stream_cross =
+	  channel_grid_cross_alloc(ChannelData.stream_map, &Map,
+				   ChannelData.nstream_cells,
+				   ChannelData.stream_cells, ChannelData.streams);
+	if (Options.CanopyShading)
+	  InitChannelRVeg(&Time, ChannelData.streams, &SolarGeo);
+  }
+  InitStepTasks();
+  StartupStage("cell order, Aggregate");
+  Initialized = TRUE;
+
+  if (Resume)
+    LoadResume();
+
+  /* the trials are not part of the profile and the telemetry of the run */
+  if (Options.AutoTune)
+    TuneCellLoops();
+
+  InitProfile(&Options, &Map, Time.NTotalSteps);
+  InitTelemetry(&Options, Time.NTotalSteps, Time.Dt);
+  InitMonitorFeed(&Options, &Map, TopoMap, Time.Dt, ChannelData.streams);
+  ReportMemory("after the initialization");
+
+  LastCheckpoint = WallClock();
+  return 0;
+}
+
+/*****************************************************************************
+  GroupCells()
+
+  (Re)builds the hydrologic response units, which depend on the shading
+  maps of the current month, and the tiles of the pixel loop over them
+*****************************************************************************/
+static void GroupCells(void)
+{
+  InitHRU(&Options, &Map, &Soil, TopoMap, SoilMap, VegMap, Network,
+	  &ChannelData, &SkyViewMap, ShadowMap.Map, Time.NDaySteps, MetWeights,
+	  &HRU);
+  SplitPixelLoop();
+}
+
+/*****************************************************************************
+  SplitPixelLoop()
+
+  Splits the pixel loop into tiles (CELL TILE SIZE).  The sums of the loop
+  do not depend on the tiles: the radiation is summed in Aggregate() and
+  each cell has its own slots in the channel accumulator
+*****************************************************************************/
+static void SplitPixelLoop(void)
+{
+  int NCells;
+
+  FreeTiles(&PixelTiles);
+  NCells = HRU.Active ? HRU.NReps : Map.NumActive;
+  InitTiles(&PixelTiles, NCells, Options.CellTileSize, Options.NThreads);
+}
+
+/*****************************************************************************
+  RetileCellLoops()
+
+  Makes the schedules of the threaded cell loops again, after AUTO TUNE has
+  changed the NUMBER OF THREADS or the CELL TILE SIZE.  The schedules that
+  InitTiles() did not make are left alone
+*****************************************************************************/
+static void RetileCellLoops(void)
+{
+  int NItems;
+
+  SplitPixelLoop();
+  if (MetFields.Tiles.Start != NULL) {
+    NItems = MetFields.Tiles.NItems;
+    FreeTiles(&(MetFields.Tiles));
+    InitTiles(&(MetFields.Tiles), NItems, Options.CellTileSize,
+	      Options.NThreads);
+  }
+  if (SubWork.Tiles.Start != NULL) {
+    NItems = SubWork.Tiles.NItems;
+    FreeTiles(&(SubWork.Tiles));
+    InitTiles(&(SubWork.Tiles), NItems, Options.CellTileSize,
+	      Options.NThreads);
+  }
+}
+
+/*****************************************************************************
+  TuneCellLoops()
+
+  AUTO TUNE: times the first AUTO TUNE STEPS of the run with the settings
+  that AutoTune() tries, from a snapshot of the model state, and goes on
+  from the snapshot with the fastest.  The trial steps write no output, as
+  in a spin-up.  The NUMBER OF THREADS of the configuration is the largest
+  count tried, the thread batches and the channel accumulator are made
+  for it
+*****************************************************************************/
+static void TuneCellLoops(void)
+{
+  int NoOutput;
+
+  TuneSteps = (Options.AutoTuneSteps > 0) ? Options.AutoTuneSteps :
+    Time.NDaySteps;
+  if (TuneSteps > Time.NTotalSteps - t)
+    TuneSteps = Time.NTotalSteps - t;
+  if (TuneSteps < 1)
+    return;
+
+  NoOutput = Options.NoOutput;
+  Options.NoOutput = TRUE;
+  StepOutput = FALSE;
+  TuneStart = dhsvm_snapshot();
+
+  AutoTune(&Options, &Map, PixelTiles.NItems, TuneSteps, TuneTrial);
+
+  dhsvm_restore(TuneStart);
+  dhsvm_free_snapshot(TuneStart);
+  TuneStart = NULL;
+  Options.NoOutput = NoOutput;
+  RetileCellLoops();
+}
+
+/*****************************************************************************
+  TuneTrial()
+
+  AUTO TUNE: runs the steps of a trial from the snapshot with the settings
+  of Options, and returns their wall clock time (s)
+*****************************************************************************/
+static double TuneTrial(void)
+{
+  double Start;
+  int i;
+
+  dhsvm_restore(TuneStart);
+  RetileCellLoops();
+  Start = WallClock();
+  for (i = 0; i < TuneSteps; i++) {
+    RunStepGraph(&StepGraph);
+    IncreaseTime(&Time);
+    t += 1;
+  }
+  WaitChannelRouting();
+  return WallClock() - Start;
+}
+
+/*****************************************************************************
+  PixelCell()
+
+  Active cell index of item j of the pixel loop
+*****************************************************************************/
+static int PixelCell(int j)
+{
+  if (HRU.Active)
+    return HRU.Rep[j];
+  return (CellOrder != NULL) ? CellOrder[j] : j;
+}
+
+/*****************************************************************************
+  StartSoilBatch()
+
+  SOIL COLUMN BATCH: put the soil columns of items First to Last - 1 of the
+  pixel loop in Batch, and distribute their lateral inflow before
+  MassEnergyBalance() of the cells.  For the representatives of the
+  response units PrepareHRURep() does it
+*****************************************************************************/
+static void StartSoilBatch(SOILBATCH *Batch, int First, int Last)
+{
+  CELLCLASS *Class;
+  int j;
+  int k;
+  int y;
+  int x;
+
+  ClearSoilBatch(Batch);
+  for (j = First; j < Last; j++) {
+    k = PixelCell(j);
+    y = Map.ActiveCells[k].y;
+    x = Map.ActiveCells[k].x;
+    Class = &(Classes.Class[Classes.Of[k]]);
+    PrepareHRURep(&HRU, k, Time.Dt, &Map, &(SoilMap[y][x]), Class->SType,
+		  Class->VType, &(Network[y][x]), Options.Infiltration);
+    AddSoilColumn(Batch, &(SoilMap[y][x]), Class->SType, Class->VType,
+		  &(Network[y][x]));
+  }
+  DistributeSatflowBatch(Batch);
+}
+
+/*****************************************************************************
+  FinishSoilBatch()
+
+  SOIL COLUMN BATCH: the unsaturated flow that MassEnergyBalance() left for
+  the batch, after which the representatives of the response units are
+  finished
+*****************************************************************************/
+static void FinishSoilBatch(SOILBATCH *Batch, int First, int Last)
+{
+  int j;
+  int k;
+  int y;
+  int x;
+
+  UnsaturatedFlowBatch(Batch, Time.Dt);
+  for (j = First; j < Last; j++) {
+    k = PixelCell(j);
+    y = Map.ActiveCells[k].y;
+    x = Map.ActiveCells[k].x;
+    FinishHRURep(&HRU, k, &(SoilMap[y][x]),
+		 Classes.Class[Classes.Of[k]].NSoilLayers);
+  }
+}
+
+/*****************************************************************************
+  CellMet()
+
+  MakeLocalMetData() for active cell k at row y and column x
+*****************************************************************************/
+static PIXMET CellMet(int y, int x, int k)
+{
+  if (Options.Shading)
+    return MakeLocalMetData(y, x, k, &Map, &MetFields, Time.DayStep,
+			    &Options, NStats, Stat, &(MetWeights[y][x]),
+			    TopoMap[y][x].Dem, &(RadiationMap[y][x]),
+			    &(PrecipMap[y][x]), &Radar, RadarMap, PrismMap,
+			    &(SnowMap[y][x]), SnowAlbedo, MM5Input, WindModel,
+			    &PrecipLapseMap, &MetMap, Dump.Diagnostics,
+			    Time.Current.Month, StaticMapValue(&SkyViewMap, k),
+			    ShadowMap.Map[Time.DayStep][y][x],
+			    SolarGeo.SunMax, SolarGeo.SineSolarAltitude);
+  return MakeLocalMetData(y, x, k, &Map, &MetFields, Time.DayStep,
+			  &Options, NStats, Stat, &(MetWeights[y][x]),
+			  TopoMap[y][x].Dem, &(RadiationMap[y][x]),
+			  &(PrecipMap[y][x]), &Radar, RadarMap, PrismMap,
+			  &(SnowMap[y][x]), SnowAlbedo, MM5Input, WindModel,
+			  &PrecipLapseMap, &MetMap, Dump.Diagnostics,
+			  Time.Current.Month, 0.0, 0.0, SolarGeo.SunMax,
+			  SolarGeo.SineSolarAltitude);
+}
+
+/*****************************************************************************
+  StartRadiationBatch()
+
+  RADIATION BATCH: the met of items First to Last - 1 of the pixel loop,
+  kept in Batch->Met, and their radiation balance before
+  MassEnergyBalance() of the cells.  Nothing that MakeLocalMetData() or
+  RadiationBalance() read is changed by the cells before them
+*****************************************************************************/
+static void StartRadiationBatch(RADBATCH *Batch, int First, int Last)
+{
+  CELLCLASS *Class;
+  PIXMET LocalMet;
+  int j;
+  int k;
+  int y;
+  int x;
+
+  ClearRadiationBatch(Batch);
+  for (j = First; j < Last; j++) {
+    k = PixelCell(j);
+    y = Map.ActiveCells[k].y;
+    x = Map.ActiveCells[k].x;
+    Class = &(Classes.Class[Classes.Of[k]]);
+    LocalMet = CellMet(y, x, k);
+    AddRadiationCell(Batch, &Options, &LocalMet, Class->VType,
+		     &(VegMap[y][x]), &(SoilMap[y][x]), Class->SType->Albedo,
+		     &(SnowMap[y][x]), &(RadiationMap[y][x]));
+  }
+  RadiationBalanceBatch(Batch, &Options, SolarGeo.SineSolarAltitude);
+}
+
+/*****************************************************************************
+  StartInterceptionBatch()
+
+  INTERCEPTION BATCH: the rain interception of the cells without snow on
+  the canopy of items First to Last - 1 of the pixel loop, after
+  StartRadiationBatch() has made their met in RadPiece->Met and their
+  radiation balance.  Nothing the interception reads is changed by the
+  cells before them
+*****************************************************************************/
+static void StartInterceptionBatch(INTBATCH *Batch, RADBATCH *RadPiece,
+				   int First, int Last)
+{
+  CELLCLASS *Class;
+  int j;
+  int k;
+  int y;
+  int x;
+
+  ClearInterceptionBatch(Batch);
+  for (j = First; j < Last; j++) {
+    k = PixelCell(j);
+    y = Map.ActiveCells[k].y;
+    x = Map.ActiveCells[k].x;
+    Class = &(Classes.Class[Classes.Of[k]]);
+    if (!SnowOnCanopy(Class->VType, &(PrecipMap[y][x])))
+      AddInterceptionCell(Batch, Class->VType, &(RadPiece->Met[j - First]),
+			  &(VegMap[y][x]), &(SnowMap[y][x]),
+			  &(PrecipMap[y][x]), Time.Dt);
+  }
+  InterceptionBatch(Batch, Time.Dt);
+}
+
+/*****************************************************************************
+  WeightsTask()
+
+  InitInterpolationWeights() as a task of the initialization (InitTasks.c).
+  Reads the mask, the elevations and the stations, and writes MetWeights
+  and the station elevations with GRIDMET only.
+*****************************************************************************/
+static void WeightsTask(void *Unused)
+{
+  InitInterpolationWeights(&Map, &Options, TopoMap, &MetWeights, Stat, NStats);
+}
+
+/*****************************************************************************
+  AtEnd()
+
+  TRUE once the last time step of the run has been done
+*****************************************************************************/
+static int AtEnd(void)
+{
+  return !(Before(&(Time.Current), &(Time.End)) ||
+	   IsEqualTime(&(Time.Current), &(Time.End)));
+}
+
+/*****************************************************************************
+  StepMapEvents()
+
+  Stage: the map events (MapEvents.c) whose date has been reached replace
+  the vegetation or soil depth of their cells before the step.  The water
+  the soil columns gain or lose with their new layers is left out of the
+  mass balance, as for dhsvm_add_increment()
+*****************************************************************************/
+static void StepMapEvents(void)
+{
+  MAPEVENT *Event;
+  float Added;			/* water gained by the changed cells (m) */
+  int NChanged;
+
+  while (MapEvents.Next < MapEvents.NEvents &&
+	 !Before(&(Time.Current),
+		 &(MapEvents.Event[MapEvents.Next].Date))) {
+    Event = &(MapEvents.Event[MapEvents.Next++]);
+    NChanged = ApplyMapEvent(Event, &Options, &Map, &Veg, &Soil, VType, SType,
+			     VegMap, SoilMap, SnowMap, PrecipMap, EvapMap,
+			     Network, &Classes, &Added);
+    Mass.OldWaterStorage += Added / Map.NumActive;
+    Mass.StartWaterStorage += Added / Map.NumActive;
+    if (Options.HasNetwork && Event->Variable == MAPEVENT_VEGETATION) {
+      FreeSurfaceRoute(&SurfaceRoute);
+      InitSurfaceRoute(&Map, TopoMap, VegMap, VType, &ChannelData,
+		       &SurfaceRoute);
+    }
+    printf("Map event: %s changes %d cells\n", Event->FileName, NChanged);
+  }
+}
+
+/*****************************************************************************
+  StepReset()
+
+  Stage of the time step (see InitStepTasks()): the basin totals of the
+  step start from zero
+*****************************************************************************/
+static void StepReset(void)
+{
+  /* reset aggregated variables */
+  ResetAggregate(&Soil, &Veg, &Total, &Options);
+}
+
+/*****************************************************************************
+  StepNewMonth()
+
+  Stage: the shading maps, response units and riparian shading of a new
+  month, and the shadow maps of the step out of the OUT OF CORE DIRECTORY
+*****************************************************************************/
+static void StepNewMonth(void)
+{
+  if (IsNewMonth(&(Time.Current), Time.Dt)) {
+    PROFILE_BEGIN(PHASE_NEWMONTH);
+    InitNewMonth(&Time, &Options, &Map, TopoMap, PrismMap, &ShadowMap,
+      	   &SolarGeo, &InFiles, Veg.NTypes, VType, NStats, Stat, Dump.InitStatePath);
+    if (Options.Shading && Options.ShadingMode == SHADING_MAPS)
+      GroupCells();
+    if (Options.StreamTemp && Options.CanopyShading)
+      InitChannelRVeg(&Time, ChannelData.streams, &SolarGeo);
+    PROFILE_END(PHASE_NEWMONTH);
+  }
+  if (Options.Shading)
+    StepShadowMaps(&ShadowMap, &Map, Time.DayStep);
+}
+
+/*****************************************************************************
+  StepNewDay()
+
+  Stage: the solar geometry of a new day
+*****************************************************************************/
+static void StepNewDay(void)
+{
+  if (IsNewDay(Time.DayStep)) {
+    InitNewDay(Time.Current.JDay, &SolarGeo);
+    PrintDate(&(Time.Current), stdout);
+    printf("\n");
+  }
+}
+
+/*****************************************************************************
+  StepNewStep()
+
+  Stage: the station records, radar and MM5 maps of the step, and the
+  shadow map of SHADING MODE = HORIZON
+*****************************************************************************/
+static void StepNewStep(void)
+{
+  PROFILE_BEGIN(PHASE_NEWSTEP);
+  InitNewStep(&InFiles, &Map, &Time, Soil.MaxLayers, &Options, NStats, Stat,
+      	InFiles.RadarFile, &Radar, RadarMap, &SolarGeo, TopoMap, 
+      SoilMap, MM5Input, WindModel, &MM5Map);
+  if (Options.Shading && Options.ShadingMode == SHADING_HORIZON)
+    HorizonShadeStep(&Map, &SolarGeo, &ShadowMap);
+  PROFILE_END(PHASE_NEWSTEP);
+}
+
+/*****************************************************************************
+  StepChannels()
+
+  Stage: the channel and road segments start the step without inflow
+*****************************************************************************/
+static void StepChannels(void)
+{
+  /* initialize channel/road networks for time step.  With PIPELINE
+     CHANNEL ROUTING the streams of the last step may still be routed, they
+     are initialized after the pixel loop */
+  if (Options.HasNetwork) {
+    if (!Options.PipelineChannel)
+      channel_step_initialize_network(ChannelData.streams);
+    channel_step_initialize_network(ChannelData.roads);
+  }
+}
+
+/*****************************************************************************
+  StepPixels()
+
+  Stage: the met fields, and the vertical mass and energy balance of the
+  cells
+*****************************************************************************/
+static void StepPixels(void)
+{
+  int i;
+  int j;
+  int x;			/* counter */
+  int y;			/* counter */
+  int k;			/* index of the active cell */
+  int Tile;			/* tile of the pixel loop */
+  double TileSpan;		/* start of the tile in the trace */
+  double CellStart;		/* start of the cell, with CELL COST TIMING */
+  int Piece;			/* first cell of a piece of the tile */
+  int PieceEnd;			/* end of the piece */
+  SOILBATCH *Batch;		/* soil columns of the piece, NULL without
+				   SOIL COLUMN BATCH */
+  RADBATCH *RadPiece;		/* radiation balance of the piece, NULL
+				   without RADIATION BATCH */
+  INTBATCH *IntPiece;		/* rain interception of the piece, NULL
+				   without INTERCEPTION BATCH */
+  CELLCLASS *Class;		/* vegetation and soil class of the cell */
+  PIXMET LocalMet;		/* Meteorological conditions for current pixel */
+
+  /* interpolate the basic met variables for all cells */
+  PROFILE_BEGIN(PHASE_PIXELS);
+  MakeMetFields(&Map, &Options, NStats, Stat, MetWeights, TopoMap,
+      	  MM5Input, WindModel, SolarGeo.SunMax, &MetFields);
+  MakePrecipFactors(&Map, &Options, NStats, Stat, MetWeights, TopoMap,
+		    PrismMap, &PrecipLapseMap, Time.Current.Month, &MetFields);
+
+  /* spread the snow cells evenly over the threads, and with CELL CLASS
+     ORDER group the cells of each tile by their structure class */
+  if (CellOrder != NULL && !HRU.Active) {
+    if (Options.NThreads > 1 && Options.CellTileSize == 0)
+      OrderActiveCells(&Map, SnowMap, CellOrder);
+    else {
+      for (k = 0; k < Map.NumActive; k++)
+	CellOrder[k] = k;
+    }
+    if (Options.CellClassOrder)
+      OrderStructureClasses(&Map, SnowMap, &Classes, &PixelTiles, CellOrder);
+  }
+
+  /* with HRU MODE only for the first cell of each response unit */
+  PlanTiles(&PixelTiles);
+#ifdef HAVE_OPENMP
+#pragma omp parallel num_threads(Options.NThreads) \
+private(x, y, i, j, k, Tile, TileSpan, CellStart, LocalMet, Piece, PieceEnd, \
+	Batch, RadPiece, IntPiece, Class)
+#endif
+  while ((Tile = NextTile(&PixelTiles)) >= 0) {
+    TileSpan = TRACE_BEGIN();
+    Batch = NULL;
+    RadPiece = NULL;
+    IntPiece = NULL;
+#ifdef HAVE_OPENMP
+    if (SoilBatch != NULL)
+      Batch = &(SoilBatch[omp_get_thread_num()]);
+    if (RadBatch != NULL)
+      RadPiece = &(RadBatch[omp_get_thread_num()]);
+    if (IntBatch != NULL)
+      IntPiece = &(IntBatch[omp_get_thread_num()]);
+#else
+    Batch = SoilBatch;
+    RadPiece = RadBatch;
+    IntPiece = IntBatch;
+#endif
+
+    /* with SOIL COLUMN BATCH or RADIATION BATCH the tile is done in pieces
+       of SOIL_BATCH_CELLS cells, whose soil columns or radiation balances
+       are done together */
+    for (Piece = PixelTiles.Start[Tile]; Piece < PixelTiles.Start[Tile + 1];
+	 Piece = PieceEnd) {
+      PieceEnd = PixelTiles.Start[Tile + 1];
+      if ((Batch != NULL || RadPiece != NULL) &&
+	  PieceEnd - Piece > SOIL_BATCH_CELLS)
+	PieceEnd = Piece + SOIL_BATCH_CELLS;
+      if (Batch != NULL)
+	StartSoilBatch(Batch, Piece, PieceEnd);
+      if (RadPiece != NULL)
+	StartRadiationBatch(RadPiece, Piece, PieceEnd);
+      if (IntPiece != NULL)
+	StartInterceptionBatch(IntPiece, RadPiece, Piece, PieceEnd);
+
+      for (j = Piece; j < PieceEnd; j++) {
+        k = PixelCell(j);
+        y = Map.ActiveCells[k].y;
+        x = Map.ActiveCells[k].x;
+        Class = &(Classes.Class[Classes.Of[k]]);
+        if (Options.CellCostTiming)
+          CellStart = WallClock();
+        if (RadPiece != NULL)
+          LocalMet = RadPiece->Met[j - Piece];
+        else
+          LocalMet = CellMet(y, x, k);
+
+        /* get surface tempeature of each soil layer, with SNOW ONLY the
+           soil is not modeled */
+        for (i = 0; !Options.SnowOnly && i < Soil.MaxLayers; i++) {
+          if (Options.HeatFlux == TRUE) {
+	    if (Options.MM5 == TRUE)
+	      SoilMap[y][x].Temp[i] =
+		MM5Input[shade_offset + i + N_MM5_MAPS][y][x];
+
+	    /* read tempeature of each soil layer from met station input */
+	    else
+	      SoilMap[y][x].Temp[i] = Stat[0].Data.Tsoil[i];
+          }
+          /* if heat flux option is turned off, soil temperature of all 3 layers 
+             is taken equal to air tempeature */
+          else
+	    SoilMap[y][x].Temp[i] = LocalMet.Tair;
+        }
+
+        if (Batch == NULL)
+          PrepareHRURep(&HRU, k, Time.Dt, &Map, &(SoilMap[y][x]),
+			Class->SType, Class->VType, &(Network[y][x]),
+			Options.Infiltration);
+
+        CellBalance(&Options, y, x, SolarGeo.SineSolarAltitude, Map.DX, Map.DY, 
+			  Time.Dt, Options.HeatFlux, Options.CanopyRadAtt, Options.Infiltration, 
+			  Veg.MaxLayers, &LocalMet, &(Network[y][x]), &(PrecipMap[y][x]), 
+			  Class->VType, &(VegMap[y][x]), Class->SType,
+			  &(SoilMap[y][x]), &(SnowMap[y][x]), &(RadiationMap[y][x]), &(EvapMap[y][x]), 
+			  NULL, &ChannelData, StaticMapValue(&SkyViewMap, k),
+			  ChannelAccum,
+			  (Batch != NULL) ? &(Batch->Column[j - Piece]) : NULL,
+			  ((RadPiece != NULL) ? DONE_RADIATION : 0) |
+			  ((IntPiece != NULL) ? DONE_INTERCEPTION : 0));
+
+        if (Batch == NULL)
+          FinishHRURep(&HRU, k, &(SoilMap[y][x]), Class->NSoilLayers);
+
+        if (Dump.Diagnostics & DIAG_SUMPRECIP)
+          PrecipMap[y][x].SumPrecip += PrecipMap[y][x].Precip;
+        if (Options.CellCostTiming)
+          SoilMap[y][x].CostTime += (float) (1000. * (WallClock() - CellStart));
+
+        /* the channel routing uses the met conditions of the last pixel */
+        if (k == Map.NumActive - 1)
+          ChannelMet = LocalMet;
+      }
+
+      if (Batch != NULL)
+	FinishSoilBatch(Batch, Piece, PieceEnd);
+    }
+    TraceEnd(TileSpan, "pixel tile", "thread", NULL, -1.0);
+  }
+
+  /* the other cells of each response unit copy the results of the first */
+  if (HRU.Active) {
+#ifdef HAVE_OPENMP
+#pragma omp parallel for schedule(static) num_threads(Options.NThreads)
+#endif
+    for (j = 0; j < HRU.NMembers; j++)
+      BroadcastHRU(&HRU, j, &Map, Time.Dt, Options.Infiltration, &Soil, &Veg,
+		   SType, VType, PrecipMap, SnowMap, SoilMap, VegMap,
+		   RadiationMap, EvapMap, Network, NULL);
+  }
+
+  /* the channel inflows and RBM energy terms of the cells, added in cell
+     order so that the results do not depend on the number of threads or
+     the scheduling.  The radiation balance of the cells is summed in Aggregate() */
+  if (Options.PipelineChannel) {
+    WaitChannelRouting();
+    channel_step_initialize_network(ChannelData.streams);
+  }
+  if (ChannelAccum != NULL)
+    channel_grid_accum_merge(ChannelAccum);
+  if (ChannelData.stream_cross != NULL)
+    channel_grid_cross_sum(ChannelData.stream_cross);
+  PROFILE_END(PHASE_PIXELS);
+}
+
+/*****************************************************************************
+  StepStreamHeat()
+
+  Stage with STREAM TEMPERATURE: the RBM inputs of each segment are
+  averaged over its cells, and shaded by the riparian vegetation
+*****************************************************************************/
+static void StepStreamHeat(void)
+{
+  channel_grid_avg(ChannelData.streams);
+  if (Options.CanopyShading)
+    CalcCanopyShading(&Time, ChannelData.streams, &SolarGeo);
+}
+
+/*****************************************************************************
+  StepSubSurface()
+
+  Stage: the saturated subsurface flow
+*****************************************************************************/
+static void StepSubSurface(void)
+{
+  int Prefetch;			/* TRUE if the next met record is read
+				   while the subsurface routing is done */
+  DATE NextStep;
+
+  /* read the station records for the next step while the subsurface 
+     routing is done (the two do not share any data).  With CONCURRENT
+     STAGES they are read in a stage of their own, StepPrefetch() */
+  NextStep = NextDate(&(Time.Current), Time.Dt);
+  Prefetch = Options.PrefetchMet && !Options.ConcurrentStages &&
+    !After(&NextStep, &(Time.End)) &&
+    (Options.QPF == TRUE || Options.MM5 == FALSE);
+
+  PROFILE_BEGIN(PHASE_SUBSURFACE);
+#ifdef HAVE_OPENMP
+#pragma omp parallel sections num_threads(2) if (Prefetch)
+#endif
+  {
+#ifdef HAVE_OPENMP
+#pragma omp section
+#endif
+    RouteSubSurface(Time.Dt, &Map, TopoMap, &Classes, Network,
+      	      SoilMap, &ChannelData, &Time, &Options,
+      	      MaxStreamID, SnowMap, &SurfaceGraph, &SubWork);
+#ifdef HAVE_OPENMP
+#pragma omp section
+#endif
+    if (Prefetch)
+      PrefetchMetRecords(&Options, &NextStep, Soil.MaxLayers, NStats, Stat);
+  }
+  PROFILE_END(PHASE_SUBSURFACE);
+}
+
+/*****************************************************************************
+  StepPrefetch()
+
+  Stage with PREFETCH MET and CONCURRENT STAGES: the station records of
+  the next step
+*****************************************************************************/
+static void StepPrefetch(void)
+{
+  DATE NextStep;
+
+  NextStep = NextDate(&(Time.Current), Time.Dt);
+  if (!After(&NextStep, &(Time.End)) &&
+      (Options.QPF == TRUE || Options.MM5 == FALSE))
+    PrefetchMetRecords(&Options, &NextStep, Soil.MaxLayers, NStats, Stat);
+}
+
+/*****************************************************************************
+  StepRouteChannel()
+
+  Stage: the road and stream networks
+*****************************************************************************/
+static void StepRouteChannel(void)
+{
+  if (Options.HasNetwork) {
+    PROFILE_BEGIN(PHASE_CHANNEL);
+    RouteChannel(&ChannelData, &Time, &Map, TopoMap, SoilMap, &Total, 
+      	   &Options, Network, SType, PrecipMap, ChannelMet.Tair, ChannelMet.Rh);
+    PROFILE_END(PHASE_CHANNEL);
+  }
+}
+
+/*****************************************************************************
+  StepRouteSurface()
+
+  Stage: the surface flow of the basin
+*****************************************************************************/
+static void StepRouteSurface(void)
+{
+  if (Options.Extent == BASIN) {
+    PROFILE_BEGIN(PHASE_SURFACE);
+    RouteSurface(&Map, &Time, TopoMap, SoilMap, &Options,
+      UnitHydrograph, &HydrographInfo, Hydrograph,
+      &Dump, &SurfaceGraph, &SurfaceRoute);
+    PROFILE_END(PHASE_SURFACE);
+  }
+}
+
+/*****************************************************************************
+  StepGraphics()
+
+  Stage: the X11 graphics
+*****************************************************************************/
+static void StepGraphics(void)
+{
+  if (NGraphics > 0 && StepOutput) {
+    PROFILE_BEGIN(PHASE_DRAW);
+    UpdateGraphics(&(Time.Current), Time.DayStep, &Map, NGraphics,
+                   which_graphics, VType, SType, SnowMap, SoilMap, VegMap,
+                   TopoMap, PrecipMap, PrismMap, &SkyViewMap, ShadowMap.Map,
+                   EvapMap, RadiationMap, MetMap, &Options);
+    PROFILE_END(PHASE_DRAW);
+  }
+}
+
+/*****************************************************************************
+  StepAggregate()
+
+  Stage: the basin totals and the mass balance
+*****************************************************************************/
+static void StepAggregate(void)
+{
+  DATE NextStep;
+
+  /* the basin values are aggregated every AGGREGATION INTERVAL steps and
+     at the last step, the steps in between only add up the mass balance
+     fluxes */
+  NextStep = NextDate(&(Time.Current), Time.Dt);
+  if (t % Dump.AggregationInterval == 0 ||
+      After(&NextStep, &(Time.End))) {
+    PROFILE_BEGIN(PHASE_AGGREGATE);
+    Aggregate(&Map, &Options, TopoMap, &Soil, &Veg, &Classes, EvapMap, PrecipMap,
+              RadiationMap, SnowMap, SoilMap, &Total, Network, &ChannelData, &roadarea);
+    PROFILE_END(PHASE_AGGREGATE);
+
+    PROFILE_BEGIN(PHASE_MASSBALANCE);
+    if (StepOutput)
+      MassBalance(&(Time.Current), &(Time.Start), &(Dump.Balance), &Total,
+		  &Mass);
+    else
+      AccumulateMassBalance(&Total, &Mass);
+    PROFILE_END(PHASE_MASSBALANCE);
+
+    if (StepOutput)
+      DumpSatExtent(&(Time.Current), &Dump, &Total);
+  }
+  else {
+    PROFILE_BEGIN(PHASE_AGGREGATE);
+    AggregateFluxes(&Map, &Options, &Soil, &Veg, EvapMap, PrecipMap, SnowMap,
+		    SoilMap, &Total);
+    PROFILE_END(PHASE_AGGREGATE);
+
+    PROFILE_BEGIN(PHASE_MASSBALANCE);
+    AccumulateMassBalance(&Total, &Mass);
+    PROFILE_END(PHASE_MASSBALANCE);
+  }
+}
+
+/*****************************************************************************
+  StepDump()
+
+  Stage: the output of the step
+*****************************************************************************/
+static void StepDump(void)
+{
+  PROFILE_BEGIN(PHASE_DUMP);
+  if (StepOutput)
+    ExecDump(&Map, &(Time.Current), &(Time.Start), &Options, &Dump, TopoMap,
+	     EvapMap, RadiationMap, PrecipMap, SnowMap, MetMap, VegMap, &Veg, 
+	     SoilMap, Network, &ChannelData, &Soil, &Total, &HydrographInfo,
+	     Hydrograph);
+  if (Dump.NStats > 0 && StepOutput)
+    UpdateStatistics(&Map, &(Time.Current), Dump.NStats, Dump.Stats, TopoMap,
+		     EvapMap, PrecipMap, RadiationMap, SnowMap, SoilMap, &Soil,
+		     VegMap, &Veg, &Options);
+  PROFILE_END(PHASE_DUMP);
+}
+
+/*****************************************************************************
+  StepObjective()
+
+  Stage with an OBSERVED FLOW FILE: the fit of the stream flow
+*****************************************************************************/
+static void StepObjective(void)
+{
+  if (Objective.NSegments > 0 && StepOutput)
+    UpdateObjective(&Time, &Objective);
+}
+
+/*****************************************************************************
+  StepMonitor()
+
+  Stage with a MONITOR FEED: the totals, segment flows and coarse maps of
+  the step for the live viewers.  It runs on the main thread after
+  ExecDump(), so waiting for the stream routing does not race with the
+  wait of another stage.
+*****************************************************************************/
+static void StepMonitor(void)
+{
+  WaitChannelRouting();
+  PublishMonitorFeed(t + 1, &(Time.Current), &Map, TopoMap, SnowMap, SoilMap, EvapMap,
+		     PrecipMap, &Total);
+}
+
+/*****************************************************************************
+  AddStage()
+
+  Appends a stage to the list of InitStepTasks(), and returns the number of
+  stages
+*****************************************************************************/
+static int AddStage(STEPTASK *Tasks, int n, const char *Name,
+		    void (*Run)(void), unsigned int Reads,
+		    unsigned int Writes, int Side)
+{
+  memset(&(Tasks[n]), 0, sizeof(STEPTASK));
+  Tasks[n].Name = Name;
+  Tasks[n].Run = Run;
+  Tasks[n].Reads = Reads;
+  Tasks[n].Writes = Writes;
+  Tasks[n].Side = Side;
+  return n + 1;
+}
+
+/*****************************************************************************
+  InitStepTasks()
+
+  The stages of a time step in the order of a serial step, with the model
+  state they read and write, for StepGraph.c.  A stage that the options do
+  not use is left out.  The side stages are short or only read and write
+  files, the others start OpenMP parallel regions or change most of the
+  model state.  With PIPELINE CHANNEL ROUTING the streams are routed in a
+  thread of their own that the stages wait for (WaitChannelRouting()) where
+  they use the segments, so that they keep the sets of a serial step.
+*****************************************************************************/
+static void InitStepTasks(void)
+{
+  STEPTASK Tasks[MAXSTAGES];
+  int n = 0;
+
+  if (MapEvents.NEvents > 0)
+    n = AddStage(Tasks, n, "MapEvents", StepMapEvents, STEP_CELLS | STEP_SURFACE,
+		 STEP_CELLS | STEP_SURFACE | STEP_TOTAL | STEP_NETCDF, FALSE);
+  n = AddStage(Tasks, n, "ResetAggregate", StepReset, 0, STEP_TOTAL, FALSE);
+  n = AddStage(Tasks, n, "InitNewMonth", StepNewMonth, 0,
+	       STEP_MET | STEP_CELLS | STEP_STREAMHEAT | STEP_NETCDF, FALSE);
+  n = AddStage(Tasks, n, "InitNewDay", StepNewDay, 0, STEP_MET, FALSE);
+  n = AddStage(Tasks, n, "InitNewStep", StepNewStep,
+	       STEP_MET | STEP_NEXTMET | STEP_CELLS,
+	       STEP_MET | STEP_NEXTMET | STEP_CELLS | STEP_NETCDF, FALSE);
+  n = AddStage(Tasks, n, "InitChannels", StepChannels, 0,
+	       STEP_STREAMS | STEP_STREAMHEAT | STEP_ROADS, FALSE);
+  n = AddStage(Tasks, n, "PixelLoop", StepPixels, STEP_MET | STEP_CELLS,
+	       STEP_MET | STEP_CELLS | STEP_STREAMS | STEP_STREAMHEAT, FALSE);
+  if (Options.StreamTemp)
+    n = AddStage(Tasks, n, "StreamHeat", StepStreamHeat,
+		 STEP_MET | STEP_STREAMHEAT, STEP_STREAMHEAT, TRUE);
+  /* with SNOW ONLY there is nothing to route */
+  if (!Options.SnowOnly)
+    n = AddStage(Tasks, n, "RouteSubSurface", StepSubSurface,
+		 STEP_MET | STEP_CELLS | STEP_STREAMS | STEP_ROADS,
+		 STEP_CELLS | STEP_STREAMS | STEP_ROADS |
+		 ((Options.PrefetchMet && !Options.ConcurrentStages) ?
+		  STEP_NEXTMET | STEP_NETCDF : 0), FALSE);
+  if (Options.PrefetchMet && Options.ConcurrentStages)
+    n = AddStage(Tasks, n, "PrefetchMet", StepPrefetch, STEP_NEXTMET,
+		 STEP_NEXTMET | STEP_NETCDF, TRUE);
+  if (Options.HasNetwork)
+    n = AddStage(Tasks, n, "RouteChannel", StepRouteChannel,
+		 STEP_MET | STEP_CELLS | STEP_STREAMS | STEP_STREAMHEAT |
+		 STEP_ROADS | STEP_TOTAL,
+		 STEP_CELLS | STEP_STREAMS | STEP_STREAMHEAT | STEP_ROADS |
+		 STEP_TOTAL, FALSE);
+  if (Options.Extent == BASIN && !Options.SnowOnly)
+    n = AddStage(Tasks, n, "RouteSurface", StepRouteSurface,
+		 STEP_CELLS | STEP_SURFACE,
+		 STEP_CELLS | STEP_SURFACE | STEP_DUMP, FALSE);
+  if (NGraphics > 0)
+    n = AddStage(Tasks, n, "UpdateGraphics", StepGraphics,
+		 STEP_MET | STEP_CELLS, STEP_DUMP, FALSE);
+  n = AddStage(Tasks, n, "Aggregate", StepAggregate,
+	       STEP_CELLS | STEP_TOTAL, STEP_CELLS | STEP_TOTAL | STEP_DUMP,
+	       FALSE);
+  n = AddStage(Tasks, n, "ExecDump", StepDump,
+	       STEP_MET | STEP_CELLS | STEP_STREAMS | STEP_ROADS |
+	       STEP_SURFACE | STEP_TOTAL,
+	       STEP_DUMP | STEP_STATS | STEP_NETCDF, FALSE);
+  if (!IsEmptyStr(Options.MonitorFeed))
+    n = AddStage(Tasks, n, "MonitorFeed", StepMonitor,
+		 STEP_CELLS | STEP_STREAMS | STEP_TOTAL, 0, FALSE);
+  if (Objective.NSegments > 0)
+    n = AddStage(Tasks, n, "UpdateObjective", StepObjective, STEP_STREAMS,
+		 STEP_OBJECTIVE, TRUE);
+
+  InitStepGraph(&StepGraph, Tasks, n, Options.ConcurrentStages);
+}
+
+/*****************************************************************************
+  dhsvm_update()
+
+  Runs one model time step.  Returns 1 if the run has reached its end,
+  either with this step or before it, in which case no step is done, and 0
+  otherwise.  The resume checkpoint is stored after the step if CHECKPOINT
+  WALL INTERVAL has passed since the last one, or if SIGTERM or SIGUSR1 has
+  been caught (dhsvm_catch_signals()).  After a signal the run is stopped,
+  and 1 is returned.  1 is also returned once the fit to the OBSERVED FLOW
+  FILE cannot reach the OBJECTIVE THRESHOLD (see UpdateObjective()).
+*****************************************************************************/
+int dhsvm_update(void)
+{
+  const char *Routine = "dhsvm_update";
+
+  if (!Initialized)
+    ReportError((char *)Routine, 78);
+  if (AtEnd() || Stopped || Objective.Terminated)
+    return 1;
+
+  TraceStep(t);
+  PROFILE_BEGIN_STEP();
+  StepOutput = (Options.SpinUpCycles == 0 && !Options.NoOutput);
+
+  /* OUTPUT ROLLOVER starts the output files of a new year or month with
+     its first step, once the streams of the last step are written */
+  if (StepOutput && RolloverDue(&(Time.Current))) {
+    WaitChannelRouting();
+    RolloverDump(&Map, &Options, &Dump);
+    if (Options.HasNetwork)
+      RolloverChannelDump(&Options, &ChannelData, Dump.Path);
+  }
+
+  /* the stages of the step, see InitStepTasks() */
+  RunStepGraph(&StepGraph);
+
+
+  IncreaseTime(&Time);
+  t += 1;
+
+  PROFILE_END_STEP();
+  TELEMETRY_STEP(t, &(Time.Current));
+
+  if (Options.SpinUpCycles > 0 && AtEnd())
+    return EndSpinUpCycle();
+
+  /* the rest of the run cannot reach the OBJECTIVE THRESHOLD, it is
+     finished as if the model period ended here */
+  if (Objective.Terminated && !AtEnd()) {
+    printf("Run stopped at ");
+    PrintDate(&(Time.Current), stdout);
+    printf(", the objective function cannot reach the threshold\n");
+    return 1;
+  }
+
+  /* a spin-up is not checkpointed, and is only stopped by a signal */
+  if (!AtEnd() && (StopSignal || (Options.CheckpointWall > 0.0 &&
+				  WallClock() - LastCheckpoint >=
+				  Options.CheckpointWall * 60.0))) {
+    if (Options.SpinUpCycles == 0)
+      StoreResume();
+    if (StopSignal) {
+      printf("Run stopped by signal %d at ", (int) StopSignal);
+      PrintDate(&(Time.Current), stdout);
+      printf("\n");
+      Stopped = TRUE;
+      return 1;
+    }
+  }
+
+  return AtEnd();
+}
+
+/*****************************************************************************
+  SetModelTime()
+
+  Sets the model time to To and the station files to the positions stored
+  with TellMetFiles() at that time, when the model goes back to an earlier
+  time step.  The monthly and daily fields are made again if the month or
+  the day changes.
+*****************************************************************************/
+static void SetModelTime(const TIMESTRUCT *To, long *MetPosition)
+{
+  int NewMonth;
+  int NewDay;
+
+  NewMonth = (To->Current.Month != Time.Current.Month ||
+	      To->Current.Year != Time.Current.Year);
+  NewDay = (To->Current.JDay != Time.Current.JDay || NewMonth);
+
+  Time = *To;
+  SeekMetFiles(NStats, Stat, MetPosition);
+
+  if (NewMonth) {
+    InitNewMonth(&Time, &Options, &Map, TopoMap, PrismMap, &ShadowMap,
+		 &SolarGeo, &InFiles, Veg.NTypes, VType, NStats, Stat, Dump.InitStatePath);
+    if (Options.Shading && Options.ShadingMode == SHADING_MAPS)
+      GroupCells();
+    if (Options.StreamTemp && Options.CanopyShading)
+      InitChannelRVeg(&Time, ChannelData.streams, &SolarGeo);
+  }
+  if (NewDay)
+    InitNewDay(Time.Current.JDay, &SolarGeo);
+}
+
+/*****************************************************************************
+  EndSpinUpCycle()
+
+  Called when a spin-up cycle has reached the end of the model period.
+  Either the spin-up is done, and the state is stored for the start of the
+  model period, so that a run of that period can start from it, or the
+  model goes back to the start of the period.  Returns as dhsvm_update()
+*****************************************************************************/
+static int EndSpinUpCycle(void)
+{
+  WaitChannelRouting();
+  if (SpinUpCycle(&Options, &Map, &Soil, &Veg, SType, VType, PrecipMap,
+		  SnowMap, SoilMap, VegMap, Network, &Mass, &SpinUp)) {
+    printf("Storing the spun-up model state for ");
+    PrintDate(&(Time.Start), stdout);
+    printf("\n");
+    StoreModelState(Dump.Path, &(Time.Start), &Map, &Options, TopoMap,
+		    PrecipMap, SnowMap, MetMap, VegMap, &Veg, SoilMap, &Soil,
+		    Network, &HydrographInfo, Hydrograph, &ChannelData);
+    if (Options.HasNetwork && Options.StateFormat == STATE_MAPS)
+      StoreChannelState(Dump.Path, &(Time.Start), ChannelData.streams);
+    return 1;
+  }
+
+  /* the extrapolated deep layer changes the water table */
+  if (Options.SpinUpAccel > 1.0)
+    SubWork.Valid = FALSE;
+  SetModelTime(&SpinUpTime, SpinUpMet);
+  return 0;
+}
+
+/*****************************************************************************
+  dhsvm_update_until()
+
+  Runs time steps until the model time (see dhsvm_get_current_time()) is at
+  or past Seconds, or the run ends.  Returns as dhsvm_update()
+*****************************************************************************/
+int dhsvm_update_until(double Seconds)
+{
+  int Done = AtEnd();
+
+  while (!Done && dhsvm_get_current_time() < Seconds)
+    Done = dhsvm_update();
+
+  return Done;
+}
+
+/*****************************************************************************
+  dhsvm_get_current_time()
+
+  Seconds since the start of the run
+*****************************************************************************/
+double dhsvm_get_current_time(void)
+{
+  return (double) t * Time.Dt;
+}
+
+/*****************************************************************************
+  dhsvm_get_end_time()
+
+  Seconds from the start to the end of the run
+*****************************************************************************/
+double dhsvm_get_end_time(void)
+{
+  return (double) Time.NTotalSteps * Time.Dt;
+}
+
+/*****************************************************************************
+  dhsvm_get_time_step()
+
+  Model time step in seconds
+*****************************************************************************/
+double dhsvm_get_time_step(void)
+{
+  return (double) Time.Dt;
+}
+
+/*****************************************************************************
+  dhsvm_get_value_ptr()
+
+  Fills View with the location of variable Name in the model maps, without
+  copying.  Cell (y, x) of the variable is at DHSVM_VIEW_CELL(View, y, x),
+  and stays valid until dhsvm_finalize().  Values may be changed between
+  calls to dhsvm_update().  Returns 0 on success and -1 if Name is not
+  available this way.
+*****************************************************************************/
+int dhsvm_get_value_ptr(const char *Name, DHSVMVIEW *View)
+{
+  size_t i;
+
+  if (!Initialized)
+    return -1;
+
+  for (i = 0; i < NVIEWVARS; i++) {
+    if (strcmp(Name, ViewVars[i].Name) == 0)
+      break;
+  }
+  if (i == NVIEWVARS)
+    return -1;
+
+  switch (ViewVars[i].Map) {
+  case view_soil:
+    View->Rows = (void **) SoilMap;
+    View->CellStride = sizeof(SOILPIX);
+    break;
+  case view_snow:
+    View->Rows = (void **) SnowMap;
+    View->CellStride = sizeof(SNOWPIX);
+    break;
+  default:
+    View->Rows = (void **) PrecipMap;
+    View->CellStride = sizeof(PRECIPPIX);
+    break;
+  }
+  View->Offset = ViewVars[i].Offset;
+  View->NumberType = NC_FLOAT;
+  View->NY = Map.NY;
+  View->NX = Map.NX;
+
+  return 0;
+}
+
+/*****************************************************************************
+  dhsvm_get_value_size()
+
+  Number of values dhsvm_get_value() copies for Name, or -1 if Name is not
+  a model variable.  The map variables have Map.NY * Map.NX values in row
+  order, channel_outflow has one value per stream segment (m3 per time
+  step), in the order of the stream network file
+*****************************************************************************/
+int dhsvm_get_value_size(const char *Name)
+{
+  DHSVMVIEW View;
+  Channel *Segment;
+  int n;
+
+  if (!Initialized)
+    return -1;
+  if (strcmp(Name, CHANNEL_OUTFLOW) == 0) {
+    for (n = 0, Segment = ChannelData.streams; Segment != NULL;
+	 Segment = Segment->next)
+      n++;
+    return n;
+  }
+  if (dhsvm_get_value_ptr(Name, &View) != 0)
+    return -1;
+  return View.NY * View.NX;
+}
+
+/*****************************************************************************
+  dhsvm_get_value()
+
+  Copies the dhsvm_get_value_size() values of Name to Dest.  Returns 0 on
+  success and -1 if Name is not a model variable.
+*****************************************************************************/
+int dhsvm_get_value(const char *Name, float *Dest)
+{
+  DHSVMVIEW View;
+  Channel *Segment;
+  int y;
+  int x;
+
+  if (!Initialized)
+    return -1;
+  if (strcmp(Name, CHANNEL_OUTFLOW) == 0) {
+    WaitChannelRouting();
+    for (Segment = ChannelData.streams; Segment != NULL;
+	 Segment = Segment->next)
+      *Dest++ = Segment->route->outflow;
+    return 0;
+  }
+  if (dhsvm_get_value_ptr(Name, &View) != 0)
+    return -1;
+  for (y = 0; y < View.NY; y++)
+    for (x = 0; x < View.NX; x++)
+      *Dest++ = *DHSVM_VIEW_CELL(&View, y, x);
+  return 0;
+}
+
+/*****************************************************************************
+  dhsvm_get_layer()
+
+  Copies layer Layer of the layered variable Name (soil_moisture) to Dest,
+  Map.NY * Map.NX values in row order.  Layer 0 is the top soil layer and
+  the layer after the root layers of a soil type is the one below the
+  roots.  Cells outside the basin or without that layer are 0.  Returns 0
+  on success and -1 if Name is not a layered variable or Layer is not a
+  layer of any soil type.
+*****************************************************************************/
+int dhsvm_get_layer(const char *Name, int Layer, float *Dest)
+{
+  int y;
+  int x;
+
+  if (!Initialized || strcmp(Name, SOIL_MOISTURE) != 0 ||
+      Layer < 0 || Layer > Soil.MaxLayers)
+    return -1;
+  for (y = 0; y < Map.NY; y++)
+    for (x = 0; x < Map.NX; x++)
+      *Dest++ = (INBASIN(TopoMap[y][x].Mask) &&
+		 Layer <= Soil.NLayers[SoilMap[y][x].Soil - 1]) ?
+	SoilMap[y][x].Moist[Layer] : 0.0;
+  return 0;
+}
+
+/*****************************************************************************
+  CellWater()
+
+  Water stored in the snow pack and the soil column of cell (y, x) (m),
+  as in Aggregate()
+*****************************************************************************/
+static float CellWater(int y, int x)
+{
+  SOILPIX *LocalSoil = &(SoilMap[y][x]);
+  float *RootDepth = VType[VegMap[y][x].Veg - 1].RootDepth;
+  float *Adjust = Network[y][x].Adjust;
+  float DeepDepth = 0.0;
+  float Water = 0.0;
+  int NSoilL = Soil.NLayers[LocalSoil->Soil - 1];
+  int i;
+
+  for (i = 0; i < NSoilL; i++) {
+    Water += LocalSoil->Moist[i] * RootDepth[i] * Adjust[i];
+    DeepDepth += RootDepth[i];
+  }
+  Water += LocalSoil->Moist[NSoilL] * (LocalSoil->Depth - DeepDepth) *
+    Adjust[NSoilL];
+
+  return Water + SnowMap[y][x].Swq;
+}
+
+/*****************************************************************************
+  UpdateCell()
+
+  Makes the state of cell (y, x) consistent after an update of its snow
+  pack or soil moisture: no negative water, no more liquid water in the
+  pack than its water equivalent, the snow albedo and the water table
+  depth recomputed as in InitModelState()
+*****************************************************************************/
+static void UpdateCell(int y, int x)
+{
+  SNOWPIX *LocalSnow = &(SnowMap[y][x]);
+  SOILPIX *LocalSoil = &(SoilMap[y][x]);
+  int NSoilL = Soil.NLayers[LocalSoil->Soil - 1];
+  int i;
+
+  if (LocalSnow->Swq < 0.0)
+    LocalSnow->Swq = 0.0;
+  if (LocalSnow->PackWater < 0.0)
+    LocalSnow->PackWater = 0.0;
+  if (LocalSnow->PackWater > LocalSnow->Swq)
+    LocalSnow->PackWater = LocalSnow->Swq;
+  if (LocalSnow->TPack > 0.0)
+    LocalSnow->TPack = 0.0;
+  LocalSnow->HasSnow = (LocalSnow->Swq > 0.0);
+  if (LocalSnow->HasSnow)
+    LocalSnow->Albedo = CalcSnowAlbedo(LocalSnow->TSurf, LocalSnow->LastSnow,
+				       SnowAlbedo);
+  else {
+    LocalSnow->TPack = 0.0;
+    LocalSnow->Albedo = 0;
+  }
+
+  for (i = 0; i <= NSoilL; i++)
+    if (LocalSoil->Moist[i] < 0.0)
+      LocalSoil->Moist[i] = 0.0;
+  if ((LocalSoil->TableDepth =
+       WaterTableDepth(NSoilL, LocalSoil->Depth,
+		       VType[VegMap[y][x].Veg - 1].RootDepth,
+		       SType[LocalSoil->Soil - 1].Porosity,
+		       SType[LocalSoil->Soil - 1].FCap, Network[y][x].Adjust,
+		       LocalSoil->Moist, &(Network[y][x].Capacity))) < 0.0)
+    LocalSoil->TableDepth = 0.0;
+}
+
+/*****************************************************************************
+  dhsvm_add_increment()
+
+  Adds the Map.NY * Map.NX values of Increment, in row order, to the
+  variable Name between two calls to dhsvm_update(), as an analysis
+  increment of data assimilation.  Name is snow_water_equivalent,
+  snow_pack_water, snow_pack_temperature or soil_moisture, of which
+  layer Layer is updated (see dhsvm_get_layer()); Layer is ignored for
+  the others.  Only the cells in the basin with a nonzero increment are
+  changed, and only their state is made consistent again (UpdateCell()):
+  the water table depth follows from the new soil moisture.  The water
+  added or removed is taken off the mass balance, so that it is not
+  reported as a mass balance error.  Returns the number of cells changed,
+  or -1 if Name can not be updated or Layer is not a layer of any soil
+  type.
+*****************************************************************************/
+int dhsvm_add_increment(const char *Name, int Layer, const float *Increment)
+{
+  DHSVMVIEW View;
+  float Added = 0.0;		/* water added to the changed cells (m) */
+  float Old;
+  float *Value;
+  int Layered = (strcmp(Name, SOIL_MOISTURE) == 0);
+  int n = 0;
+  int y;
+  int x;
+
+  if (!Initialized)
+    return -1;
+  if (Layered) {
+    if (Layer < 0 || Layer > Soil.MaxLayers)
+      return -1;
+  }
+  else if ((strcmp(Name, "snow_water_equivalent") != 0 &&
+	    strcmp(Name, "snow_pack_water") != 0 &&
+	    strcmp(Name, "snow_pack_temperature") != 0) ||
+	   dhsvm_get_value_ptr(Name, &View) != 0)
+    return -1;
+
+  for (y = 0; y < Map.NY; y++) {
+    for (x = 0; x < Map.NX; x++, Increment++) {
+      if (*Increment == 0.0 || !INBASIN(TopoMap[y][x].Mask))
+	continue;
+      if (Layered) {
+	if (Layer > Soil.NLayers[SoilMap[y][x].Soil - 1])
+	  continue;
+	Value = &(SoilMap[y][x].Moist[Layer]);
+      }
+      else
+	Value = DHSVM_VIEW_CELL(&View, y, x);
+      Old = CellWater(y, x);
+      *Value += *Increment;
+      UpdateCell(y, x);
+      Added += CellWater(y, x) - Old;
+      n++;
+    }
+  }
+
+  /* the storage the next mass balance line and the final one start from */
+  Mass.OldWaterStorage += Added / Map.NumActive;
+  Mass.StartWaterStorage += Added / Map.NumActive;
+
+  return n;
+}
+
+/*****************************************************************************
+  SaveMap(), RestoreMap()
+
+  Copy the NY rows of a map with cells of CellSize bytes to or from one
+  block.  The cells are copied as they are, pointer members included,
+  since the memory the pointers refer to stays in place for the run.
+*****************************************************************************/
+static char *SaveMap(void **Rows, size_t CellSize)
+{
+  const char *Routine = "SaveMap";
+  char *Saved;
+  size_t RowSize = CellSize * Map.NX;
+  int y;
+
+  if (!(Saved = (char *) malloc(RowSize * Map.NY)))
+    ReportError((char *)Routine, 1);
+  for (y = 0; y < Map.NY; y++)
+    memcpy(Saved + y * RowSize, Rows[y], RowSize);
+  return Saved;
+}
+
+static void RestoreMap(void **Rows, const char *Saved, size_t CellSize)
+{
+  size_t RowSize = CellSize * Map.NX;
+  int y;
+
+  for (y = 0; y < Map.NY; y++)
+    memcpy(Rows[y], Saved + y * RowSize, RowSize);
+}
+
+/*****************************************************************************
+  CopyLayers()
+
+  Copy the layer values of the active cells (interception storage, soil
+  moisture, percolation and soil temperature) to Layers if Save is TRUE,
+  or back from Layers.  Returns the number of values, and only counts them
+  if Layers is NULL.
+*****************************************************************************/
+static size_t CopyLayers(float *Layers, int Save)
+{
+  size_t n = 0;
+  int NVeg;
+  int NSoil;
+  int k;
+  int x;
+  int y;
+
+#define COPYLAYER(Array, N) \
+  do { \
+    if (Layers != NULL) { \
+      if (Save) \
+	memcpy(Layers + n, (Array), (N) * sizeof(float)); \
+      else \
+	memcpy((Array), Layers + n, (N) * sizeof(float)); \
+    } \
+    n += (N); \
+  } while (0)
+
+  for (k = 0; k < Map.NumActive; k++) {
+    y = Map.ActiveCells[k].y;
+    x = Map.ActiveCells[k].x;
+    NVeg = Classes.Class[Classes.Of[k]].NVegLayers;
+    NSoil = Classes.Class[Classes.Of[k]].NSoilLayers;
+    COPYLAYER(PrecipMap[y][x].IntRain, NVeg);
+    COPYLAYER(PrecipMap[y][x].IntSnow, NVeg);
+    COPYLAYER(SoilMap[y][x].Moist, NSoil + 1);
+    COPYLAYER(SoilMap[y][x].Perc, NSoil);
+    COPYLAYER(SoilMap[y][x].Temp, NSoil);
+  }
+#undef COPYLAYER
+
+  return n;
+}
+
+/*****************************************************************************
+  CopySegments()
+
+  Copy the channel segments of List to Saved, and their routing states to
+  Routes, if Save is TRUE, or back from Saved and Routes.  The RBM forcing
+  is summed anew at each step and is not copied.  Returns the number of
+  segments, and only counts them if Saved is NULL.
+*****************************************************************************/
+static int CopySegments(Channel *List, Channel *Saved, ChannelRoute *Routes,
+			int Save)
+{
+  Channel *Segment;
+  Channel *Next;
+  int n;
+
+  for (n = 0, Segment = List; Segment != NULL; Segment = Next, n++) {
+    Next = Segment->next;
+    if (Saved != NULL) {
+      if (Save) {
+	Saved[n] = *Segment;
+	Routes[n] = *(Segment->route);
+      }
+      else {
+	*Segment = Saved[n];
+	*(Segment->route) = Routes[n];
+      }
+    }
+  }
+  return n;
+}
+
+/*****************************************************************************
+  dhsvm_snapshot()
+
+  Copies the model state in memory, to go back to this time step later
+  with dhsvm_restore().  The snapshot holds the pixel maps of the
+  interception, snow, soil, vegetation and road state with their layers,
+  the channel segments, the unit hydrograph, the mass balance and
+  aggregated totals, the time and the next scheduled dump, and the
+  positions in the station files.  The evaporation and radiation maps and
+  the interpolated met fields are recomputed at each step and are not
+  part of it.  Free the snapshot with dhsvm_free_snapshot().
+*****************************************************************************/
+DHSVMSNAPSHOT *dhsvm_snapshot(void)
+{
+  const char *Routine = "dhsvm_snapshot";
+  DHSVMSNAPSHOT *Snapshot;
+
+  if (!Initialized)
+    ReportError((char *)Routine, 78);
+  WaitChannelRouting();
+
+  if (!(Snapshot = (DHSVMSNAPSHOT *) calloc(1, sizeof(DHSVMSNAPSHOT))))
+    ReportError((char *)Routine, 1);
+
+  Snapshot->Time = Time;
+  Snapshot->t = t;
+  Snapshot->Mass = Mass;
+  Snapshot->Total = Total;
+  Snapshot->NextEvent = Dump.NextEvent;
+  Snapshot->NextMapEvent = MapEvents.Next;
+
+  Snapshot->PrecipMap = SaveMap((void **) PrecipMap, sizeof(PRECIPPIX));
+  Snapshot->SnowMap = SaveMap((void **) SnowMap, sizeof(SNOWPIX));
+  Snapshot->SoilMap = SaveMap((void **) SoilMap, sizeof(SOILPIX));
+  Snapshot->VegMap = SaveMap((void **) VegMap, sizeof(VEGPIX));
+  if (Network != NULL)
+    Snapshot->Network = SaveMap((void **) Network, sizeof(ROADSTRUCT));
+
+  Snapshot->NLayers = CopyLayers(NULL, TRUE);
+  if (!(Snapshot->Layers = (float *) malloc((Snapshot->NLayers + 1) *
+					     sizeof(float))))
+    ReportError((char *)Routine, 1);
+  CopyLayers(Snapshot->Layers, TRUE);
+
+  Snapshot->NStreams = CopySegments(ChannelData.streams, NULL, NULL, TRUE);
+  Snapshot->NRoads = CopySegments(ChannelData.roads, NULL, NULL, TRUE);
+  if (!(Snapshot->Segments = (Channel *) malloc((Snapshot->NStreams +
+						 Snapshot->NRoads + 1) *
+						sizeof(Channel))) ||
+      !(Snapshot->Routes = (ChannelRoute *) malloc((Snapshot->NStreams +
+						    Snapshot->NRoads + 1) *
+						   sizeof(ChannelRoute))))
+    ReportError((char *)Routine, 1);
+  CopySegments(ChannelData.streams, Snapshot->Segments, Snapshot->Routes,
+	       TRUE);
+  CopySegments(ChannelData.roads, Snapshot->Segments + Snapshot->NStreams,
+	       Snapshot->Routes + Snapshot->NStreams, TRUE);
+
+  if (Hydrograph != NULL) {
+    Snapshot->NHydro = HydrographInfo.TotalWaveLength;
+    if (!(Snapshot->Hydrograph = (float *) malloc((Snapshot->NHydro + 1) *
+						  sizeof(float))))
+      ReportError((char *)Routine, 1);
+    memcpy(Snapshot->Hydrograph, Hydrograph, Snapshot->NHydro * sizeof(float));
+  }
+
+  if (!(Snapshot->MetPosition = (long *) calloc(NStats + 1, sizeof(long))))
+    ReportError((char *)Routine, 1);
+  TellMetFiles(NStats, Stat, Snapshot->MetPosition);
+
+  return Snapshot;
+}
+
+/*****************************************************************************
+  dhsvm_restore()
+
+  Returns the model to the state copied by dhsvm_snapshot(), so that the
+  run continues from that time step.  Output written after the snapshot is
+  kept, and the steps that are run again add to it.  A map event between
+  the snapshot and the restore is not undone, and is an error.
+*****************************************************************************/
+void dhsvm_restore(const DHSVMSNAPSHOT *Snapshot)
+{
+  const char *Routine = "dhsvm_restore";
+
+  if (!Initialized)
+    ReportError((char *)Routine, 78);
+  if (Snapshot->NextMapEvent != MapEvents.Next)
+    ReportError((char *)Routine, 92);
+  WaitChannelRouting();
+
+  t = Snapshot->t;
+  Mass = Snapshot->Mass;
+  Total = Snapshot->Total;
+  Dump.NextEvent = Snapshot->NextEvent;
+
+  RestoreMap((void **) PrecipMap, Snapshot->PrecipMap, sizeof(PRECIPPIX));
+  RestoreMap((void **) SnowMap, Snapshot->SnowMap, sizeof(SNOWPIX));
+  RestoreMap((void **) SoilMap, Snapshot->SoilMap, sizeof(SOILPIX));
+  RestoreMap((void **) VegMap, Snapshot->VegMap, sizeof(VEGPIX));
+  if (Network != NULL)
+    RestoreMap((void **) Network, Snapshot->Network, sizeof(ROADSTRUCT));
+  CopyLayers(Snapshot->Layers, FALSE);
+  CopySegments(ChannelData.streams, Snapshot->Segments, Snapshot->Routes,
+	       FALSE);
+  CopySegments(ChannelData.roads, Snapshot->Segments + Snapshot->NStreams,
+	       Snapshot->Routes + Snapshot->NStreams, FALSE);
+  if (Hydrograph != NULL)
+    memcpy(Hydrograph, Snapshot->Hydrograph, Snapshot->NHydro * sizeof(float));
+
+  SetModelTime(&(Snapshot->Time), Snapshot->MetPosition);
+
+  /* the subsurface flow directions are recalculated for the restored water
+     table */
+  SubWork.Valid = FALSE;
+}
+
+/*****************************************************************************
+  dhsvm_free_snapshot()
+*****************************************************************************/
+void dhsvm_free_snapshot(DHSVMSNAPSHOT *Snapshot)
+{
+  if (Snapshot == NULL)
+    return;
+  free(Snapshot->PrecipMap);
+  free(Snapshot->SnowMap);
+  free(Snapshot->SoilMap);
+  free(Snapshot->VegMap);
+  free(Snapshot->Network);
+  free(Snapshot->Layers);
+  free(Snapshot->Segments);
+  free(Snapshot->Routes);
+  free(Snapshot->Hydrograph);
+  free(Snapshot->MetPosition);
+  free(Snapshot);
+}
+
+/*****************************************************************************
+  dhsvm_set_precipitation_factor()
+
+  Multiply the precipitation from the next time step on by Factor, as for
+  the members of an ensemble (see InitEnsemble())
+*****************************************************************************/
+void dhsvm_set_precipitation_factor(double Factor)
+{
+  Options.PrecipFactor = (float) Factor;
+}
+
+/*****************************************************************************
+  dhsvm_set_output()
+
+  With On == 0 the time steps from the next one on write no output files,
+  as during a spin-up, until the output is turned on again.  The values of
+  the model state (dhsvm_get_value()) are not affected
+*****************************************************************************/
+void dhsvm_set_output(int On)
+{
+  Options.NoOutput = !On;
+}
+
+/*****************************************************************************
+  dhsvm_reload_forcing()
+
+  Reads the station files again from their start from the next time step
+  on, after they have been replaced with a new forcing period.  Call it
+  after dhsvm_restore(), whose file positions belong to the old files.
+  Returns 0, or -1 if the forcing is read from a met cache or a NetCDF
+  file, which are not read again
+*****************************************************************************/
+int dhsvm_reload_forcing(void)
+{
+  if (!Initialized)
+    return -1;
+  return (NStats > 0 && RewindMetFiles(NStats, Stat) <= 0) ? -1 : 0;
+}
+
+#ifdef HAVE_FORK
+/*****************************************************************************
+  BranchName()
+
+  Moves output file FileName from directory OldPath to Dump.Path, copying
+  what has been written to it (see BranchFile()).  FilePtr is the stream
+  open on the file, or NULL for the map files, which are opened when they
+  are written.
+*****************************************************************************/
+static void BranchName(char *FileName, FILE **FilePtr, char *OldPath)
+{
+  char NewName[BUFSIZE + 1];
+  size_t Len = strlen(OldPath);
+
+  if (FileName[0] == '\0' || strncmp(FileName, OldPath, Len) != 0)
+    return;
+  if (FilePtr != NULL && *FilePtr == NULL)
+    return;
+  snprintf(NewName, BUFSIZE + 1, "%s%s", Dump.Path, FileName + Len);
+  BranchFile(FilePtr, FileName, NewName);
+  strcpy(FileName, NewName);
+}
+
+/*****************************************************************************
+  BranchOutput()
+
+  Moves the output of a branch process to the subdirectory branch.NNN of
+  the output directory
+*****************************************************************************/
+static void BranchOutput(int Branch)
+{
+  char OldPath[BUFSIZE + 1];
+  int i;
+
+  strcpy(OldPath, Dump.Path);
+  snprintf(Dump.Path, BUFSIZE + 1, "%sbranch.%03d/", OldPath, Branch + 1);
+  if (mkdir(Dump.Path, 0777) != 0 && errno != EEXIST)
+    ReportError(Dump.Path, 3);
+
+  BranchName(Dump.Aggregate.FileName, &(Dump.Aggregate.FilePtr), OldPath);
+  BranchName(Dump.Balance.FileName, &(Dump.Balance.FilePtr), OldPath);
+  BranchName(Dump.FinalBalance.FileName, &(Dump.FinalBalance.FilePtr),
+	     OldPath);
+  BranchName(Dump.Stream.FileName, &(Dump.Stream.FilePtr), OldPath);
+  BranchName(Dump.Saturation.FileName, &(Dump.Saturation.FilePtr), OldPath);
+  for (i = 0; i < Dump.NPix; i++)
+    BranchName(Dump.Pix[i].OutFile.FileName, &(Dump.Pix[i].OutFile.FilePtr),
+	       OldPath);
+  BranchName(Dump.PixBin.FileName, &(Dump.PixBin.FilePtr), OldPath);
+  BranchName(RolloverIndex()->FileName, &(RolloverIndex()->FilePtr),
+	     OldPath);
+  for (i = 0; i < Dump.NMaps; i++)
+    BranchName(Dump.DMap[i].FileName, NULL, OldPath);
+  if (Options.HasNetwork)
+    BranchChannelDump(&Options, &ChannelData, OldPath, Dump.Path);
+}
+#endif
+
+/*****************************************************************************
+  dhsvm_fork()
+
+  Starts NBranches copies of the model as processes that continue from the
+  current state, for example to run forecast scenarios from one warm
+  state.  The copies share the memory of this process until they change
+  it.  Each branch writes its output to the subdirectory branch.NNN of the
+  output directory, starting with a copy of the output so far.  At most as
+  many branches as there are processors run at the same time.
+
+  Returns the branch number (0 .. NBranches - 1) in each branch.  In this
+  process it returns NBranches once all branches have ended, or -1 if one
+  of them failed, and the model can be used further.  Needs HAVE_FORK.
+*****************************************************************************/
+int dhsvm_fork(int NBranches)
+{
+  const char *Routine = "dhsvm_fork";
+#ifdef HAVE_FORK
+  pid_t Pid;
+  long MaxRunning;		/* Number of branches run at the same time */
+  int NRunning;			/* Number of branches running */
+  int NFailed;			/* Number of branches that did not finish */
+  int Status;
+  int b;			/* counter */
+
+  if (!Initialized)
+    ReportError((char *)Routine, 78);
+
+  MaxRunning = sysconf(_SC_NPROCESSORS_ONLN);
+  if (MaxRunning < 1)
+    MaxRunning = 1;
+
+  /* no output buffers, open NetCDF files or writer threads in the copies */
+  WaitChannelRouting();
+  CloseFileIO();
+  fflush(NULL);
+
+  NRunning = 0;
+  NFailed = 0;
+  for (b = 0; b < NBranches; b++) {
+    if (NRunning == MaxRunning) {
+      if (wait(&Status) > 0 && !(WIFEXITED(Status) &&
+				 WEXITSTATUS(Status) == EXIT_SUCCESS))
+	NFailed++;
+      NRunning--;
+    }
+    if ((Pid = fork()) < 0)
+      ReportError((char *)Routine, 1);
+    if (Pid == 0) {
+      ForkTrace(b);
+      ForkTelemetry(b);
+      ForkMonitorFeed(b);
+      ReopenMetFiles(NStats, Stat);
+      BranchOutput(b);
+      InitFileIO(Options.FileFormat, Options.NcSyncInterval,
+		 Options.OutputQueueSize, Options.BasinOnlyOutput);
+      return b;
+    }
+    NRunning++;
+  }
+
+  while (NRunning > 0) {
+    if (wait(&Status) > 0 && !(WIFEXITED(Status) &&
+			       WEXITSTATUS(Status) == EXIT_SUCCESS))
+      NFailed++;
+    NRunning--;
+  }
+
+  InitFileIO(Options.FileFormat, Options.NcSyncInterval,
+	     Options.OutputQueueSize, Options.BasinOnlyOutput);
+  return (NFailed > 0) ? -1 : NBranches;
+#else
+  ReportError((char *)Routine, 79);
+  return -1;
+#endif
+}
+
+/*****************************************************************************
+  dhsvm_set_resume()
+
+  With Resume TRUE, dhsvm_initialize() continues the run from the resume
+  checkpoint in the output directory (see StoreResume()), as left by a run
+  that was stopped or killed.  The output files are cut back to the time
+  step of the checkpoint, so that the resumed run writes the same output as
+  a run that was not interrupted.  Has to be called before
+  dhsvm_initialize().
+*****************************************************************************/
+void dhsvm_set_resume(int On)
+{
+  const char *Routine = "dhsvm_set_resume";
+
+  if (Initialized)
+    ReportError((char *)Routine, 78);
+  Resume = On;
+}
+
+/*****************************************************************************
+  dhsvm_estimate()
+
+  Projects the resources of the run of ConfigFile without doing the run.
+  The initialization stops once the basin, the channel network and the
+  met stations are known, and the memory of each subsystem is projected
+  (see ProjectMemory()).  If that fits under the memory limit, and NSteps
+  is not 0, the initialization is finished and the first NSteps steps are
+  timed, or the steps of a day if NSteps < 0.  Their output goes to a
+  scratch directory that is removed afterwards.  From the timed steps the
+  run time and the bytes of output of a simulated year are projected.
+  Returns 0, or -1 if the steps could not be timed.
+*****************************************************************************/
+int dhsvm_estimate(const char *ConfigFile, int NSteps)
+{
+  const char *Routine = "dhsvm_estimate";
+  char Scratch[BUFSIZE + 1];	/* output directory of the timed steps */
+  double Start;
+  double Wall;			/* wall clock time of the timed steps (s) */
+  double Before;		/* bytes of output before the timed steps */
+  double Series;		/* bytes of output of the timed steps */
+  double Maps;			/* bytes of the map dumps of the run */
+  double Years;			/* years of the model period */
+  double StepsPerYear;
+  double Steps;			/* steps of the run */
+  int Cycles;			/* SPIN UP CYCLES, at most */
+  int Done;
+  int n;
+
+  if (Initialized)
+    ReportError((char *)Routine, 78);
+  Estimate = TRUE;
+  EstimateSteps = NSteps;
+  if (dhsvm_initialize(ConfigFile) != 0)
+    return EstimateSteps == 0 ? 0 : -1;
+
+  if (NSteps < 0)
+    NSteps = Time.NDaySteps;
+  fflush(NULL);
+  Before = ScratchOutputBytes(Options.EstimateDir);
+  Start = WallClock();
+  for (n = 0, Done = FALSE; n < NSteps && !Done; n++)
+    Done = dhsvm_update();
+  Wall = WallClock() - Start;
+  fflush(NULL);
+  Series = ScratchOutputBytes(Options.EstimateDir) - Before;
+
+  Years = (double) Time.NTotalSteps * Time.Dt / (365.25 * SECPDAY);
+  StepsPerYear = 365.25 * SECPDAY / Time.Dt;
+  Cycles = (Options.SpinUpCycles > 0) ? Options.SpinUpCycles : 1;
+  Steps = (double) Time.NTotalSteps * Cycles;
+  Maps = (Options.SpinUpCycles > 0) ? 0.0 :
+    MapDumpBytes(&Dump, &Map, Options.BasinOnlyOutput);
+
+  printf("\nResource estimate for %s\n", ConfigFile);
+  printf("Timed %d steps in %.2f s, %.2f steps/s\n", n, Wall,
+	 (Wall > 0.0) ? n / Wall : 0.0);
+  if (n > 0 && Wall > 0.0)
+    printf("Projected run time: %.0f steps%s, %.0f s (%.2f h)\n", Steps,
+	   (Options.SpinUpCycles > 0) ? " of the SPIN UP CYCLES at most" : "",
+	   Steps * Wall / n, Steps * Wall / n / 3600.);
+  if (n > 0)
+    printf("Projected output per simulated year: %.1f MB of time series, "
+	   "%.1f MB of map dumps\n", Series / n * StepsPerYear / 1048576.,
+	   (Years > 0.0) ? Maps / Years / 1048576. : 0.0);
+  printf("Projected output of the run: %.1f MB\n",
+	 ((n > 0) ? Series / n * Time.NTotalSteps : 0.0) / 1048576. +
+	 Maps / 1048576.);
+  fflush(stdout);
+
+  strcpy(Scratch, Options.EstimateDir);
+  dhsvm_finalize();
+  RemoveScratchOutput(Scratch);
+  return 0;
+}
+
+/*****************************************************************************
+  dhsvm_io_bench()
+
+  Replays the reads and writes of the run of ConfigFile without the
+  physics.  After the initialization each of the first NSteps steps, or of
+  all the steps of the model period if NSteps < 0, only reads the forcing
+  (InitNewMonth(), InitNewStep()), writes the channel outputs and does the
+  ExecDump() of the step: the aggregated values, the pixel, state and map
+  dumps of the configured schedule.  The model state stays that of the
+  start of the run.  The output goes to a scratch directory that is
+  removed afterwards, and the calls, latency and bytes of each class of
+  reads and writes are reported (see IOBench.c).  A spin-up is not
+  replayed, the output schedule is that of the model period.  Returns 0.
+*****************************************************************************/
+int dhsvm_io_bench(const char *ConfigFile, int NSteps)
+{
+  const char *Routine = "dhsvm_io_bench";
+  char Scratch[BUFSIZE + 1];	/* output directory of the steps */
+  double Start;
+  int n;
+
+  if (Initialized)
+    ReportError((char *)Routine, 78);
+  IOBench = TRUE;
+  if (dhsvm_initialize(ConfigFile) != 0)
+    return -1;
+
+  if (NSteps < 0)
+    NSteps = Time.NTotalSteps;
+  StepOutput = !Options.NoOutput;
+  InitIOBench();
+  Start = WallClock();
+  for (n = 0; n < NSteps && !AtEnd(); n++) {
+    if (StepOutput && RolloverDue(&(Time.Current))) {
+      RolloverDump(&Map, &Options, &Dump);
+      if (Options.HasNetwork)
+	RolloverChannelDump(&Options, &ChannelData, Dump.Path);
+    }
+
+    IOBENCH_BEGIN(IO_FORCING);
+    StepNewMonth();
+    StepNewDay();
+    StepNewStep();
+    if (Options.PrefetchMet)
+      StepPrefetch();
+    IOBENCH_END(IO_FORCING);
+
+    if (Options.HasNetwork && StepOutput) {
+      IOBENCH_BEGIN(IO_CHANNEL);
+      SaveChannelOutput(&ChannelData, &Time, &Options);
+      IOBENCH_END(IO_CHANNEL);
+    }
+    StepDump();
+
+    IncreaseTime(&Time);
+    t += 1;
+  }
+  IOBenchReport(ConfigFile, n, WallClock() - Start);
+
+  strcpy(Scratch, Options.EstimateDir);
+  dhsvm_finalize();
+  RemoveScratchOutput(Scratch);
+  return 0;
+}
+
+/*****************************************************************************
+  dhsvm_catch_signals()
+
+  Catch SIGTERM and SIGUSR1, which then stop the run after the current time
+  step with a resume checkpoint.  Batch systems send one of them before a
+  job is killed at the end of its time or when its node is preempted.
+*****************************************************************************/
+void dhsvm_catch_signals(void)
+{
+  signal(SIGTERM, CatchStop);
+#ifdef SIGUSR1
+  signal(SIGUSR1, CatchStop);
+#endif
+}
+
+static void CatchStop(int Signal)
+{
+  StopSignal = Signal;
+}
+
+/*****************************************************************************
+  ListOutput(), AddOutput()
+
+  List the output files of the run with their length, for the resume
+  checkpoint.  Returns the number of files, and only counts them if List is
+  NULL.  Map files are only listed once they exist, and their length is -1
+  with NetCDF, since the records are written into them by index.
+*****************************************************************************/
+static int ListOutput(OUTPUTFILE *List)
+{
+  int NChannel;
+  int i;
+  int n = 0;
+
+  n = AddOutput(List, n, Dump.Aggregate.FileName, &(Dump.Aggregate.FilePtr));
+  n = AddOutput(List, n, Dump.Balance.FileName, &(Dump.Balance.FilePtr));
+  n = AddOutput(List, n, Dump.FinalBalance.FileName,
+		&(Dump.FinalBalance.FilePtr));
+  n = AddOutput(List, n, Dump.Stream.FileName, &(Dump.Stream.FilePtr));
+  n = AddOutput(List, n, Dump.Saturation.FileName,
+		&(Dump.Saturation.FilePtr));
+  for (i = 0; i < Dump.NPix; i++)
+    n = AddOutput(List, n, Dump.Pix[i].OutFile.FileName,
+		  &(Dump.Pix[i].OutFile.FilePtr));
+  n = AddOutput(List, n, Dump.PixBin.FileName, &(Dump.PixBin.FilePtr));
+  n = AddOutput(List, n, RolloverIndex()->FileName,
+		&(RolloverIndex()->FilePtr));
+  for (i = 0; i < Dump.NMaps; i++)
+    n = AddOutput(List, n, Dump.DMap[i].FileName, NULL);
+  for (i = 0; i < Dump.NStats; i++)
+    n = AddOutput(List, n, Dump.Stats[i].Map.FileName, NULL);
+
+  if (Options.HasNetwork) {
+    NChannel = ListChannelDump(&Options, &ChannelData, Dump.Path,
+			       (List != NULL) ? List + n : NULL);
+    for (i = n; List != NULL && i < n + NChannel; i++)
+      List[i].Length = ftell(*(List[i].FilePtr));
+    n += NChannel;
+  }
+  return n;
+}
+
+static int AddOutput(OUTPUTFILE *List, int n, char *FileName, FILE **FilePtr)
+{
+  FILE *MapFile;
+  long Length;
+
+  if (FileName[0] == '\0' || (FilePtr != NULL && *FilePtr == NULL))
+    return n;
+
+  if (FilePtr != NULL)
+    Length = ftell(*FilePtr);
+  else {
+    if (!(MapFile = fopen(FileName, "rb")))
+      return n;
+    fseek(MapFile, 0L, SEEK_END);
+    Length = (Options.FileFormat == NETCDF || Options.FileFormat == ZARR) ?
+      -1 : ftell(MapFile);
+    fclose(MapFile);
+  }
+
+  if (List != NULL) {
+    strcpy(List[n].Name, FileName);
+    List[n].FilePtr = FilePtr;
+    List[n].Length = Length;
+  }
+  return n + 1;
+}
+
+/*****************************************************************************
+  MakeResumeHeader()
+
+  Header of a resume checkpoint of this run
+*****************************************************************************/
+static void MakeResumeHeader(RESUMEHEADER *Header)
+{
+  memset(Header, 0, sizeof(RESUMEHEADER));
+  memcpy(Header->Magic, RESUME_MAGIC, sizeof(Header->Magic));
+  Header->Version = RESUME_VERSION;
+  Header->Sizes[0] = sizeof(TIMESTRUCT);
+  Header->Sizes[1] = sizeof(WATERBALANCE);
+  Header->Sizes[2] = sizeof(AGGREGATED);
+  Header->Sizes[3] = sizeof(PRECIPPIX);
+  Header->Sizes[4] = sizeof(SNOWPIX);
+  Header->Sizes[5] = sizeof(SOILPIX);
+  Header->Sizes[6] = sizeof(VEGPIX);
+  Header->Sizes[7] = sizeof(ROADSTRUCT);
+  Header->Sizes[8] = sizeof(ChannelRoute);
+  Header->Sizes[9] = sizeof(CHANTEMP);
+  Header->Sizes[10] = sizeof(long);
+  Header->Sizes[11] = sizeof(void *);
+  Header->NY = Map.NY;
+  Header->NX = Map.NX;
+  Header->NumActive = Map.NumActive;
+  Header->Geometry = CheckpointGeometry(&Map);
+  Header->Network = CheckpointNetwork(ChannelData.stream_net);
+  Header->Start = Time.Start;
+  Header->End = Time.End;
+  Header->Dt = Time.Dt;
+  Header->Rollover = Options.Rollover;
+}
+
+/*****************************************************************************
+  StoreResume()
+
+  Writes the resume checkpoint RESUME_FILE to the output directory, from
+  which DHSVM --resume continues the run at the current time step.  It
+  holds the length of each output file at this step, and the model state:
+  the state of dhsvm_snapshot() with the stream temperatures, the
+  reductions of the map dumps, the annual statistics and the subsurface
+  flow directions.  The cells are written as they are, pointer members
+  included, and the pointers are replaced by those of the resumed run when
+  they are read (KeepPointers()).  The checkpoint is written under a
+  temporary name and then renamed, so that a run killed while it writes
+  the checkpoint keeps the previous one.  With CHECKPOINT COMPRESSION =
+  ZLIB all but the header is compressed.
+*****************************************************************************/
+static void StoreResume(void)
+{
+  const char *Routine = "StoreResume";
+  FILE *OutFile;
+  RESUMEHEADER Header;
+  OUTPUTFILE *List;
+  STATDUMP *Stats;
+  Channel *Segment;
+  char TempName[BUFSIZE + 1];
+  float *Layers;
+  long *MetPosition;
+  size_t NCells = (size_t) Map.NY * Map.NX;
+  size_t NLayers;
+  size_t AccumSize;
+  int Counts[8];		/* sizes of the state, see LoadResume() */
+  int HasArrays;
+  int NFiles;
+  int Len;
+  int i;
+  int y;
+
+  /* everything written so far is in the files, so that their length is
+     known */
+  WaitChannelRouting();
+  CloseFileIO();
+  fflush(NULL);
+
+  NFiles = ListOutput(NULL);
+  if (!(List = (OUTPUTFILE *) calloc(NFiles + 1, sizeof(OUTPUTFILE))))
+    ReportError((char *)Routine, 1);
+  ListOutput(List);
+
+  snprintf(ResumeName, BUFSIZE + 1, "%s%s", Dump.Path, RESUME_FILE);
+  snprintf(TempName, BUFSIZE + 1, "%s.tmp", ResumeName);
+  OpenFile(&OutFile, TempName, "wb", TRUE);
+
+  MakeResumeHeader(&Header);
+  GetRolloverDate(&(Header.Period));
+  Header.NFiles = NFiles;
+  Header.Compression = Options.CheckpointCompression;
+  Header.Shuffle = Options.CheckpointShuffle;
+  if (fwrite(&Header, sizeof(RESUMEHEADER), 1, OutFile) != 1)
+    ReportError(TempName, 72);
+  OpenResumeStream(OutFile, TempName, Header.Compression,
+		   Options.CheckpointLevel, Header.Shuffle, TRUE);
+  for (i = 0; i < NFiles; i++) {
+    Len = (int) strlen(List[i].Name);
+    WriteResume(&Len, sizeof(int), 1);
+    WriteResume(List[i].Name, 1, Len);
+    WriteResume(&(List[i].Length), sizeof(long), 1);
+  }
+  free(List);
+
+  NLayers = CopyLayers(NULL, TRUE);
+  Counts[0] = NStats;
+  Counts[1] = CopySegments(ChannelData.streams, NULL, NULL, TRUE);
+  Counts[2] = CopySegments(ChannelData.roads, NULL, NULL, TRUE);
+  Counts[3] = (Hydrograph != NULL) ? HydrographInfo.TotalWaveLength : 0;
+  Counts[4] = Dump.NMaps;
+  Counts[5] = Dump.NStats;
+  Counts[6] = (Network != NULL);
+  Counts[7] = (Options.FlowGradient == WATERTABLE && SubWork.Valid);
+  WriteResume(Counts, sizeof(int), 8);
+  WriteResume(&NLayers, sizeof(size_t), 1);
+
+  WriteResume(&Time, sizeof(TIMESTRUCT), 1);
+  WriteResume(&t, sizeof(int), 1);
+  WriteResume(&Mass, sizeof(WATERBALANCE), 1);
+  WriteResume(&Total, sizeof(AGGREGATED), 1);
+  WriteResume(&(Dump.NextEvent), sizeof(int), 1);
+  WriteResume(&(Dump.SatFlushCount), sizeof(int), 1);
+
+  if (!(MetPosition = (long *) calloc(NStats + 1, sizeof(long))))
+    ReportError((char *)Routine, 1);
+  TellMetFiles(NStats, Stat, MetPosition);
+  WriteResume(MetPosition, sizeof(long), NStats);
+  free(MetPosition);
+
+  for (y = 0; y < Map.NY; y++)
+    WriteResume(PrecipMap[y], sizeof(PRECIPPIX), Map.NX);
+  for (y = 0; y < Map.NY; y++)
+    WriteResume(SnowMap[y], sizeof(SNOWPIX), Map.NX);
+  for (y = 0; y < Map.NY; y++)
+    WriteResume(SoilMap[y], sizeof(SOILPIX), Map.NX);
+  for (y = 0; y < Map.NY; y++)
+    WriteResume(VegMap[y], sizeof(VEGPIX), Map.NX);
+  for (y = 0; Network != NULL && y < Map.NY; y++)
+    WriteResume(Network[y], sizeof(ROADSTRUCT), Map.NX);
+
+  if (!(Layers = (float *) malloc((NLayers + 1) * sizeof(float))))
+    ReportError((char *)Routine, 1);
+  CopyLayers(Layers, TRUE);
+  WriteResume(Layers, sizeof(float), NLayers);
+  free(Layers);
+
+  for (Segment = ChannelData.streams; Segment != NULL; Segment = Segment->next) {
+    WriteResume(Segment->route, sizeof(ChannelRoute), 1);
+    WriteResume(&(Segment->temp), sizeof(CHANTEMP), 1);
+  }
+  for (Segment = ChannelData.roads; Segment != NULL; Segment = Segment->next) {
+    WriteResume(Segment->route, sizeof(ChannelRoute), 1);
+    WriteResume(&(Segment->temp), sizeof(CHANTEMP), 1);
+  }
+  WriteResume(Hydrograph, sizeof(float), Counts[3]);
+
+  for (i = 0; i < Dump.NMaps; i++) {
+    AccumSize = (Dump.DMap[i].Accum != NULL) ? Dump.DMap[i].AccumSize : 0;
+    WriteResume(&(Dump.DMap[i].NAccum), sizeof(int), 1);
+    WriteResume(&AccumSize, sizeof(size_t), 1);
+    WriteResume(Dump.DMap[i].Accum, sizeof(double), AccumSize);
+  }
+
+  for (i = 0; i < Dump.NStats; i++) {
+    Stats = &(Dump.Stats[i]);
+    HasArrays = (Stats->Max != NULL);
+    WriteResume(&(Stats->Year), sizeof(int), 1);
+    WriteResume(&(Stats->N), sizeof(int), 1);
+    WriteResume(&(Stats->Index), sizeof(int), 1);
+    WriteResume(&HasArrays, sizeof(int), 1);
+    if (HasArrays) {
+      WriteResume(Stats->Max, sizeof(float), NCells);
+      WriteResume(Stats->MaxDay, sizeof(float), NCells);
+      WriteResume(Stats->Min, sizeof(float), NCells);
+      WriteResume(Stats->MinDay, sizeof(float), NCells);
+      WriteResume(Stats->Mean, sizeof(double), NCells);
+      WriteResume(Stats->M2, sizeof(double), NCells);
+      WriteResume(Stats->ExceedDays, sizeof(float), NCells);
+      WriteResume(Stats->LastExceed, sizeof(int), NCells);
+    }
+  }
+
+  /* with a WATER TABLE TOLERANCE the directions depend on the water levels
+     they were last calculated for */
+  if (Counts[7]) {
+    WriteResume(SubWork.FlowGrad, sizeof(float), NCells);
+    WriteResume(SubWork.Dir, sizeof(unsigned char), NCells * NDIRS);
+    WriteResume(SubWork.TotalDir, sizeof(unsigned int), NCells);
+    WriteResume(SubWork.LastLevel, sizeof(float), NCells);
+  }
+
+  WriteResume(&(Objective.NSegments), sizeof(int), 1);
+  WriteResume(Objective.Sums, sizeof(double),
+	      (size_t) Objective.NSegments * NOBJSUMS);
+
+  WriteResume(RESUME_END, 1, strlen(RESUME_END));
+  CloseResumeStream();
+  if (fclose(OutFile) != 0)
+    ReportError(TempName, 72);
+  if (rename(TempName, ResumeName) != 0)
+    ReportError(ResumeName, 72);
+
+  InitFileIO(Options.FileFormat, Options.NcSyncInterval,
+	     Options.OutputQueueSize, Options.BasinOnlyOutput);
+
+  printf("Resume checkpoint stored for ");
+  PrintDate(&(Time.Current), stdout);
+  printf("\n");
+  LastCheckpoint = WallClock();
+}
+
+/*****************************************************************************
+  OpenResume()
+
+  Opens the resume checkpoint for DHSVM --resume, checks that it belongs to
+  this run, and sets the output files it lists aside (SetAsideFile())
+  before InitDump() creates them again.  The model state is read by
+  LoadResume() at the end of the initialization.
+*****************************************************************************/
+static void OpenResume(void)
+{
+  const char *Routine = "OpenResume";
+  RESUMEHEADER Header;
+  RESUMEHEADER Expected;
+  char Path[BUFSIZE + 1];
+  int Len;
+  int i;
+
+  /* each member of an ensemble would need its own checkpoint, and a
+     spin-up is not checkpointed */
+  if (Options.NMembers > 1 || Options.SpinUpCycles > 0)
+    ReportError((char *)Routine, 65);
+
+  GetInitString("OUTPUT", "OUTPUT DIRECTORY", "", Path,
+		(unsigned long) BUFSIZE, Input);
+  snprintf(ResumeName, BUFSIZE + 1, "%s%s", Path, RESUME_FILE);
+  OpenFile(&ResumeIn, ResumeName, "rb", FALSE);
+  printf("Resuming the run from %s\n", ResumeName);
+
+  MakeResumeHeader(&Expected);
+  if (fread(&Header, sizeof(RESUMEHEADER), 1, ResumeIn) != 1 ||
+      memcmp(Header.Magic, Expected.Magic, sizeof(Header.Magic)) != 0 ||
+      Header.Version != Expected.Version)
+    ReportError(ResumeName, 74);
+  if (memcmp(Header.Sizes, Expected.Sizes, sizeof(Header.Sizes)) != 0 ||
+      Header.NY != Expected.NY || Header.NX != Expected.NX ||
+      Header.NumActive != Expected.NumActive ||
+      Header.Geometry != Expected.Geometry ||
+      Header.Network != Expected.Network ||
+      !IsEqualTime(&(Header.Start), &(Expected.Start)) ||
+      !IsEqualTime(&(Header.End), &(Expected.End)) ||
+      Header.Dt != Expected.Dt || Header.Rollover != Expected.Rollover)
+    ReportError(ResumeName, 75);
+  if (Header.NFiles < 0 || Header.Compression < RESUME_RAW ||
+      Header.Compression > RESUME_ZLIB)
+    ReportError(ResumeName, 76);
+  OpenResumeStream(ResumeIn, ResumeName, Header.Compression, 0,
+		   Header.Shuffle, FALSE);
+
+  NResumeFiles = Header.NFiles;
+  if (!(ResumeFiles = (OUTPUTFILE *) calloc(NResumeFiles + 1,
+					    sizeof(OUTPUTFILE))))
+    ReportError((char *)Routine, 1);
+  for (i = 0; i < NResumeFiles; i++) {
+    ReadResume(&Len, sizeof(int), 1);
+    if (Len < 0 || Len > BUFSIZE)
+      ReportError(ResumeName, 76);
+    ReadResume(ResumeFiles[i].Name, 1, Len);
+    ReadResume(&(ResumeFiles[i].Length), sizeof(long), 1);
+  }
+
+  for (i = 0; i < NResumeFiles; i++)
+    SetAsideFile(ResumeFiles[i].Name);
+
+  /* InitDump() opens the output files of the period of the checkpoint */
+  SetRolloverDate(&(Header.Period));
+}
+
+/*****************************************************************************
+  LoadResume()
+
+  Reads the model state from the resume checkpoint opened by OpenResume(),
+  and replaces the output files created by the initialization with the
+  output that was written up to the checkpoint.  The state is read into a
+  snapshot of the initialized model, with the pointer members of the cells
+  kept, and restored with dhsvm_restore().
+*****************************************************************************/
+static void LoadResume(void)
+{
+  const char *Routine = "LoadResume";
+  DHSVMSNAPSHOT *Snapshot;
+  AGGREGATED Saved;
+  OUTPUTFILE *List;
+  STATDUMP *Stats;
+  MAPDUMP *DMap;
+  char End[sizeof(RESUME_END)];
+  size_t NCells = (size_t) Map.NY * Map.NX;
+  size_t NLayers;
+  size_t AccumSize;
+  int Counts[8];		/* sizes of the state, see StoreResume() */
+  int HasArrays;
+  int NFiles;
+  int i;
+  int j;
+  int n;
+
+  Snapshot = dhsvm_snapshot();
+
+  ReadResume(Counts, sizeof(int), 8);
+  ReadResume(&NLayers, sizeof(size_t), 1);
+  if (Counts[0] != NStats || Counts[1] != Snapshot->NStreams ||
+      Counts[2] != Snapshot->NRoads || Counts[3] != Snapshot->NHydro ||
+      Counts[4] != Dump.NMaps || Counts[5] != Dump.NStats ||
+      Counts[6] != (Network != NULL) || NLayers != Snapshot->NLayers ||
+      (Counts[7] && Options.FlowGradient != WATERTABLE))
+    ReportError(ResumeName, 75);
+
+  ReadResume(&(Snapshot->Time), sizeof(TIMESTRUCT), 1);
+  ReadResume(&(Snapshot->t), sizeof(int), 1);
+  ReadResume(&(Snapshot->Mass), sizeof(WATERBALANCE), 1);
+  ReadResume(&Saved, sizeof(AGGREGATED), 1);
+  KeepPointers((char *) &Saved, (char *) &(Snapshot->Total), TotalPointers,
+	       NPOINTERS(TotalPointers));
+  Snapshot->Total = Saved;
+  ReadResume(&(Snapshot->NextEvent), sizeof(int), 1);
+  ReadResume(&(Dump.SatFlushCount), sizeof(int), 1);
+  ReadResume(Snapshot->MetPosition, sizeof(long), NStats);
+
+  LoadResumeMap(Snapshot->PrecipMap, sizeof(PRECIPPIX), PrecipPointers,
+		NPOINTERS(PrecipPointers));
+  LoadResumeMap(Snapshot->SnowMap, sizeof(SNOWPIX), NULL, 0);
+  LoadResumeMap(Snapshot->SoilMap, sizeof(SOILPIX), SoilPointers,
+		NPOINTERS(SoilPointers));
+  LoadResumeMap(Snapshot->VegMap, sizeof(VEGPIX), NULL, 0);
+  if (Network != NULL)
+    LoadResumeMap(Snapshot->Network, sizeof(ROADSTRUCT), RoadPointers,
+		  NPOINTERS(RoadPointers));
+
+  ReadResume(Snapshot->Layers, sizeof(float), NLayers);
+  for (n = 0; n < Snapshot->NStreams + Snapshot->NRoads; n++) {
+    ReadResume(&(Snapshot->Routes[n]), sizeof(ChannelRoute), 1);
+    ReadResume(&(Snapshot->Segments[n].temp), sizeof(CHANTEMP), 1);
+  }
+  ReadResume(Snapshot->Hydrograph, sizeof(float), Snapshot->NHydro);
+
+  dhsvm_restore(Snapshot);
+  dhsvm_free_snapshot(Snapshot);
+
+  for (i = 0; i < Dump.NMaps; i++) {
+    DMap = &(Dump.DMap[i]);
+    ReadResume(&(DMap->NAccum), sizeof(int), 1);
+    ReadResume(&AccumSize, sizeof(size_t), 1);
+    if (AccumSize == 0)
+      continue;
+    if (DMap->Accum == NULL) {
+      if (!(DMap->Accum = (double *) TaggedCalloc(AccumSize, sizeof(double),
+						  MEM_OUTPUT)))
+	ReportError((char *)Routine, 1);
+      DMap->AccumSize = AccumSize;
+    }
+    else if (DMap->AccumSize != AccumSize)
+      ReportError(ResumeName, 75);
+    ReadResume(DMap->Accum, sizeof(double), AccumSize);
+  }
+
+  for (i = 0; i < Dump.NStats; i++) {
+    Stats = &(Dump.Stats[i]);
+    ReadResume(&(Stats->Year), sizeof(int), 1);
+    ReadResume(&(Stats->N), sizeof(int), 1);
+    ReadResume(&(Stats->Index), sizeof(int), 1);
+    ReadResume(&HasArrays, sizeof(int), 1);
+    if (!HasArrays)
+      continue;
+    if (Stats->Max == NULL)
+      ReportError(ResumeName, 75);
+    ReadResume(Stats->Max, sizeof(float), NCells);
+    ReadResume(Stats->MaxDay, sizeof(float), NCells);
+    ReadResume(Stats->Min, sizeof(float), NCells);
+    ReadResume(Stats->MinDay, sizeof(float), NCells);
+    ReadResume(Stats->Mean, sizeof(double), NCells);
+    ReadResume(Stats->M2, sizeof(double), NCells);
+    ReadResume(Stats->ExceedDays, sizeof(float), NCells);
+    ReadResume(Stats->LastExceed, sizeof(int), NCells);
+  }
+
+  /* dhsvm_restore() has the directions recalculated, but with a WATER
+     TABLE TOLERANCE they have to be the ones of the interrupted run */
+  if (Counts[7]) {
+    ReadResume(SubWork.FlowGrad, sizeof(float), NCells);
+    ReadResume(SubWork.Dir, sizeof(unsigned char), NCells * NDIRS);
+    ReadResume(SubWork.TotalDir, sizeof(unsigned int), NCells);
+    ReadResume(SubWork.LastLevel, sizeof(float), NCells);
+    SubWork.Valid = TRUE;
+  }
+
+  /* the sums of the fit to the observed flow */
+  ReadResume(&n, sizeof(int), 1);
+  if (n != Objective.NSegments)
+    ReportError(ResumeName, 75);
+  ReadResume(Objective.Sums, sizeof(double), (size_t) n * NOBJSUMS);
+
+  ReadResume(End, 1, strlen(RESUME_END));
+  if (strncmp(End, RESUME_END, strlen(RESUME_END)) != 0)
+    ReportError(ResumeName, 76);
+  CloseResumeStream();
+  fclose(ResumeIn);
+  ResumeIn = NULL;
+
+  /* the output up to the checkpoint, in place of the files the
+     initialization created */
+  CloseFileIO();
+  fflush(NULL);
+  NFiles = ListOutput(NULL);
+  if (!(List = (OUTPUTFILE *) calloc(NFiles + 1, sizeof(OUTPUTFILE))))
+    ReportError((char *)Routine, 1);
+  ListOutput(List);
+  for (j = 0; j < NResumeFiles; j++) {
+    for (i = 0; i < NFiles; i++)
+      if (strcmp(List[i].Name, ResumeFiles[j].Name) == 0)
+	break;
+    ResumeFile((i < NFiles) ? List[i].FilePtr : NULL, ResumeFiles[j].Name,
+	       ResumeFiles[j].Length);
+    /* the header of Pixel.bin is not written again */
+    if (strcmp(ResumeFiles[j].Name, Dump.PixBin.FileName) == 0 &&
+	ResumeFiles[j].Length > 0 && Dump.NPixVars == 0)
+      InitPixBinVars(&Dump, &Soil, &Veg, &Options);
+  }
+  free(List);
+  free(ResumeFiles);
+  ResumeFiles = NULL;
+  NResumeFiles = 0;
+  InitFileIO(Options.FileFormat, Options.NcSyncInterval,
+	     Options.OutputQueueSize, Options.BasinOnlyOutput);
+
+  printf("Resumed the run at step %d, ", t);
+  PrintDate(&(Time.Current), stdout);
+  printf("\n");
+}
+
+/*****************************************************************************
+  WriteResume(), ReadResume()
+
+  Write N values of Size bytes to the resume checkpoint, or read them from
+  the checkpoint opened by OpenResume(), after the header of the checkpoint
+  (see ResumeIO.c)
+*****************************************************************************/
+static void WriteResume(const void *Data, size_t Size, size_t N)
+{
+  WriteResumeStream(Data, Size * N);
+}
+
+static void ReadResume(void *Data, size_t Size, size_t N)
+{
+  ReadResumeStream(Data, Size * N);
+}
+
+/*****************************************************************************
+  LoadResumeMap(), KeepPointers()
+
+  Read the NY rows of a map with cells of CellSize bytes from the resume
+  checkpoint into Saved, a block of SaveMap(), keeping the pointer members
+  at the offsets Pointers of the cells in Saved.
+*****************************************************************************/
+static void LoadResumeMap(char *Saved, size_t CellSize, const size_t *Pointers,
+			  int NPointers)
+{
+  const char *Routine = "LoadResumeMap";
+  char *Cells;
+  size_t NCells = (size_t) Map.NY * Map.NX;
+  size_t i;
+
+  if (!(Cells = (char *) malloc(NCells * CellSize)))
+    ReportError((char *)Routine, 1);
+  ReadResume(Cells, CellSize, NCells);
+  for (i = 0; i < NCells; i++)
+    KeepPointers(Cells + i * CellSize, Saved + i * CellSize, Pointers,
+		 NPointers);
+  memcpy(Saved, Cells, NCells * CellSize);
+  free(Cells);
+}
+
+static void KeepPointers(char *Cell, const char *Live, const size_t *Pointers,
+			 int NPointers)
+{
+  int i;
+
+  for (i = 0; i < NPointers; i++)
+    memcpy(Cell + Pointers[i], Live + Pointers[i], sizeof(void *));
+}
+
+/*****************************************************************************
+  dhsvm_finalize()
+
+  Writes the final output and mass balance and closes the output files
+*****************************************************************************/
+void dhsvm_finalize(void)
+{
+  double Wall;
+  double Cpu;
+  double QuietSteps;		/* cell steps on the quiescent cell fast path */
+  double CellSteps;		/* cell steps of MassEnergyBalance() */
+  double IORead;		/* bytes read by the process */
+  double IOWritten;		/* bytes written by the process */
+  int i;
+  int k;
+
+  if (!Initialized)
+    return;
+  WaitChannelRouting();
+
+  /* the storage of the final mass balance, if the run was stopped between
+     two full aggregations */
+  if (!Total.Full && !Stopped) {
+    ResetAggregate(&Soil, &Veg, &Total, &Options);
+    Aggregate(&Map, &Options, TopoMap, &Soil, &Veg, &Classes, EvapMap, PrecipMap,
+              RadiationMap, SnowMap, SoilMap, &Total, Network, &ChannelData, &roadarea);
+  }
+
+  /* a run stopped by a signal is finished when it is resumed */
+  if (Options.SpinUpCycles == 0 && !Stopped)
+    ExecDump(&Map, &(Time.Current), &(Time.Start), &Options, &Dump, TopoMap,
+	     EvapMap, RadiationMap, PrecipMap, SnowMap, MetMap, VegMap, &Veg,
+	     SoilMap, Network, &ChannelData, &Soil, &Total, &HydrographInfo,
+	     Hydrograph);
+
+  if (!Stopped)
+    FinalMassBalance(&(Dump.FinalBalance), &Total, &Mass);
+
+  /* the statistics of the last year, the final ExecDump() above is not a
+     time step and is not included */
+  if (Dump.NStats > 0 && !Stopped)
+    FinishStatistics(&Map, Dump.NStats, Dump.Stats);
+
+  /* the checkpoint of a run that has ended is not needed */
+  if (!Stopped && ResumeName[0] != '\0')
+    remove(ResumeName);
+
+  if (Objective.NSegments > 0 && !Stopped)
+    ReportObjective(Dump.Path, &(Time.Current), &Objective);
+
+  /* with HRU MODE only the representative cells are computed */
+  QuietSteps = 0.0;
+  for (k = 0; k < Map.NumActive; k++)
+    QuietSteps +=
+      SoilMap[Map.ActiveCells[k].y][Map.ActiveCells[k].x].CostQuietSteps;
+  CellSteps = (double) t * (HRU.Active ? HRU.NReps : Map.NumActive);
+
+  TaggedFree(SubWork.FlowGrad);
+  TaggedFree(SubWork.Dir);
+  TaggedFree(SubWork.TotalDir);
+  TaggedFree(SubWork.LastLevel);
+  TaggedFree(SubWork.Changed);
+  TaggedFree(SubWork.OutFlow);
+  TaggedFree(SubWork.OwnFlow);
+  TaggedFree(SubWork.ChannelFlow);
+  TaggedFree(SubWork.ToChannel);
+  TaggedFree(SubWork.BankHeight);
+  TaggedFree(SubWork.FractUsed);
+  TaggedFree(SubWork.RoadFract);
+  TaggedFree(SubWork.HasChannel);
+  TaggedFree(SubWork.Updated);
+  FreeFlowGraph(&(SubWork.Graph));
+  FreeFlowGraph(&SurfaceGraph);
+  FreeSurfaceRoute(&SurfaceRoute);
+  free(MapEvents.Event);
+  FreeSpinUp(&SpinUp);
+  FreeObjective(&Objective);
+  free(SpinUpMet);
+  FreeTiles(&(SubWork.Tiles));
+  free(CellOrder);
+  FreeTiles(&PixelTiles);
+  for (i = 0; SoilBatch != NULL && i < Options.NThreads; i++)
+    FreeSoilBatch(&(SoilBatch[i]));
+  free(SoilBatch);
+  SoilBatch = NULL;
+  for (i = 0; RadBatch != NULL && i < Options.NThreads; i++)
+    FreeRadiationBatch(&(RadBatch[i]));
+  free(RadBatch);
+  RadBatch = NULL;
+  for (i = 0; IntBatch != NULL && i < Options.NThreads; i++)
+    FreeInterceptionBatch(&(IntBatch[i]));
+  free(IntBatch);
+  IntBatch = NULL;
+  FreeCellClasses(&Classes);
+  FreeTiles(&(MetFields.Tiles));
+  TaggedFree(HRU.Rep);
+  TaggedFree(HRU.Member);
+  TaggedFree(HRU.RepOf);
+  TaggedFree(HRU.Slot);
+  TaggedFree(HRU.Delta);
+  TaggedFree(HRU.SatFlow);
+  channel_grid_accum_free(ChannelAccum);
+  channel_grid_accum_free(ChannelData.stream_accum);
+  channel_grid_accum_free(ChannelData.road_accum);
+  FreeStepGraph(&StepGraph);
+  channel_grid_cross_free(ChannelData.stream_cross);
+  CloseGraphics();
+
+  cleanup(&Dump, &ChannelData, &Options);
+  CloseTrace();
+  CloseTelemetry(t, &(Time.Current));
+  CloseMonitorFeed();
+
+  printf("\nEND OF MODEL RUN\n\n");
+
+  /* record the run time at the end of each time loop */
+  Wall = WallClock() - StartWall;
+  Cpu = CpuClock() - StartCpu;
+  printf("***********************************************************************************");
+  printf("\nRuntime Summary:\n");
+  printf("%6.2f hours elapsed for the simulation period of %d hours (%.1f days) \n", 
+	  Wall/3600, t*Time.Dt/3600, (float)t*Time.Dt/3600/24);
+  printf("%6.2f hours of CPU time in all threads\n", Cpu/3600);
+  if (ProcessIO(&IORead, &IOWritten))
+    printf("%.3f MB read and %.3f MB written by the process\n",
+	   IORead / 1048576., IOWritten / 1048576.);
+  if (Options.QuietCells != QUIET_NONE && CellSteps > 0.0)
+    printf("%.0f of %.0f cell steps (%.1f%%) on the quiescent cell fast path\n",
+	   QuietSteps, CellSteps, 100. * QuietSteps / CellSteps);
+  ReportMessages();
+  ProfileReport(Time.Dt);
+  /* the layered arrays of the cells are released at once with their arenas */
+  FreeArenas();
+  ReportMemory("at the end of the run");
+  CloseStaticShare();
+
+  Initialized = FALSE;
+}
+/*****************************************************************************
+  Cleanup
+*****************************************************************************/
+static void cleanup(DUMPSTRUCT *Dump, CHANNEL *ChannelData, OPTIONSTRUCT *Options)
+{
+	if (Dump->Aggregate.FilePtr != NULL) 
+	  fclose(Dump->Aggregate.FilePtr);
+	if (Dump->Balance.FilePtr != NULL) 
+	  fclose(Dump->Balance.FilePtr);
+	if (Dump->FinalBalance.FilePtr != NULL) 
+	  fclose(Dump->FinalBalance.FilePtr);
+	if (Dump->Saturation.FilePtr != NULL) 
+	  fclose(Dump->Saturation.FilePtr);
+	CloseFileIO();
+	CloseMetCache();
+	if (ChannelData->streamflowout != NULL)
+	  fclose(ChannelData->streamflowout);
+	if (ChannelData->streamout != NULL)
+	  fclose(ChannelData->streamout);
+	if (ChannelData->streamrecord != NULL)
+	  fclose(ChannelData->streamrecord);
+	if (ChannelData->roadflowout != NULL)
+	  fclose(ChannelData->roadflowout );
+	if (ChannelData->roadout != NULL)
+	  fclose(ChannelData->roadout);
+
+	if (Options->StreamTemp) {
+	  if (ChannelData->streaminflow != NULL) 
+		fclose(ChannelData->streaminflow);
+	  if (ChannelData->streamoutflow != NULL) 
+        fclose(ChannelData->streamoutflow);
+	  if (ChannelData->streamISW != NULL) 
+		fclose(ChannelData->streamISW);
+	  if (ChannelData->streamNSW != NULL) 
+        fclose(ChannelData->streamNSW);
+	  if (ChannelData->streamILW != NULL) 
+        fclose(ChannelData->streamILW);
+	  if (ChannelData->streamNLW!= NULL) 
+        fclose(ChannelData->streamNLW);								  
+	  if (ChannelData->streamVP!= NULL) 
+		fclose(ChannelData->streamVP);	
+	  if (ChannelData->streamWND!= NULL) 
+		fclose(ChannelData->streamWND);	
+	  if (ChannelData->streamATP!= NULL) 
+		fclose(ChannelData->streamATP);
+	  if (ChannelData->streamBeam != NULL)
+		fclose(ChannelData->streamBeam);
+	  if (ChannelData->streamDiffuse != NULL)
+		fclose(ChannelData->streamDiffuse);
+	  if (ChannelData->streamSkyView != NULL)
+		fclose(ChannelData->streamSkyView);
+	  if (ChannelData->streamforcing != NULL)
+		fclose(ChannelData->streamforcing);
+	  free(ChannelData->forcingrecord);
+	  if (ChannelData->streamtemp != NULL)
+		fclose(ChannelData->streamtemp);
+	  FreeStreamTemp(ChannelData);
+	}
+}
@@ -0,0 +1,110 @@
+/*
+ * SUMMARY:      dhsvm.h - DHSVM library interface
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Functions to initialize, advance and finalize the model from
+ *               another program, and to access the model state
+ * DESCRIP-END.
+ * FUNCTIONS:    
+ * COMMENTS:     Link with libdhsvm.  A run is
+ *
+ *                 if (dhsvm_initialize("config") == 0) {
+ *                   while (!dhsvm_update())
+ *                     ;
+ *                   dhsvm_finalize();
+ *                 }
+ *
+ *               The file IO and the X11 display are set up from the
+ *               configuration file as for a stand-alone run.
+ *
+ *               Forecast scenarios can start from one warm state either in
+ *               this process, with dhsvm_snapshot() and dhsvm_restore()
+ *               around each scenario, or in branch processes created with
+ *               dhsvm_fork().
+ *
+ *               A run that is stopped with SIGTERM or SIGUSR1 (after
+ *               dhsvm_catch_signals()) or killed continues from its last
+ *               resume checkpoint (OPTIONS CHECKPOINT WALL INTERVAL) with
+ *               dhsvm_set_resume(1) before dhsvm_initialize()
+ *
+ *               dhsvm_run_batch() runs the basins of a manifest file, each
+ *               in a process of its own (see Batch.c)
+ *
+ *               dhsvm_route_only() routes the lateral inflows recorded by a
+ *               run (CHANNEL INFLOW RECORD) through the streams of a
+ *               configuration file (see ChannelReplay.c)
+ *
+ *               dhsvm_serve() keeps a warm model in this process for
+ *               forecast cycles sent over a UNIX socket (see Service.c)
+ *
+ *               A data assimilation cycle reads the state with
+ *               dhsvm_get_value() and dhsvm_get_layer() between two calls
+ *               to dhsvm_update() and applies its analysis with
+ *               dhsvm_add_increment(), which keeps the water table, the
+ *               snow albedo and the mass balance consistent with the
+ *               changed cells
+ *
+ *               dhsvm_estimate() projects the memory, the run time and
+ *               the output of a run before it is queued (see Estimate.c)
+ *
+ *               dhsvm_io_bench() times the reads and writes of a run on
+ *               their own, with the model state of the start of the run
+ *               (see IOBench.c)
+ */
+
+#ifndef DHSVM_H
+#define DHSVM_H
+
+#include <stddef.h>
+
+/* location of a map variable in the model state (dhsvm_get_value_ptr()).
+   The cells of a row are CellStride bytes apart and the variable is at
+   Offset bytes in a cell */
+typedef struct {
+  void **Rows;			/* start of each of the NY rows */
+  size_t Offset;		/* offset of the variable in a cell */
+  size_t CellStride;		/* size of a cell */
+  int NumberType;		/* NC_FLOAT */
+  int NY;			/* number of rows */
+  int NX;			/* number of columns */
+} DHSVMVIEW;
+
+/* model state copied in memory by dhsvm_snapshot() */
+typedef struct DHSVMSNAPSHOT DHSVMSNAPSHOT;
+
+/* pointer to the float at cell (y, x) of a DHSVMVIEW */
+#define DHSVM_VIEW_CELL(View, y, x) \
+  ((float *) ((char *) (View)->Rows[(y)] + (size_t) (x) * (View)->CellStride + \
+	      (View)->Offset))
+
+int dhsvm_initialize(const char *ConfigFile);
+int dhsvm_update(void);
+int dhsvm_update_until(double Seconds);
+double dhsvm_get_current_time(void);
+double dhsvm_get_end_time(void);
+double dhsvm_get_time_step(void);
+int dhsvm_get_value_ptr(const char *Name, DHSVMVIEW *View);
+int dhsvm_get_value_size(const char *Name);
+int dhsvm_get_value(const char *Name, float *Dest);
+int dhsvm_get_layer(const char *Name, int Layer, float *Dest);
+int dhsvm_add_increment(const char *Name, int Layer, const float *Increment);
+DHSVMSNAPSHOT *dhsvm_snapshot(void);
+void dhsvm_restore(const DHSVMSNAPSHOT *Snapshot);
+void dhsvm_free_snapshot(DHSVMSNAPSHOT *Snapshot);
+void dhsvm_set_precipitation_factor(double Factor);
+void dhsvm_set_output(int On);
+int dhsvm_reload_forcing(void);
+int dhsvm_fork(int NBranches);
+void dhsvm_set_resume(int Resume);
+void dhsvm_catch_signals(void);
+void dhsvm_finalize(void);
+int dhsvm_run_batch(const char *Manifest, int NWorkers);
+int dhsvm_route_only(const char *RecordFile, const char *ConfigFile);
+int dhsvm_serve(const char *SocketPath, const char *ConfigFile);
+int dhsvm_estimate(const char *ConfigFile, int NSteps);
+int dhsvm_io_bench(const char *ConfigFile, int NSteps);
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * SUMMARY:      estimate.h - header file for the resource estimate
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Memory, output and run time of a run projected before it
+ *               is started, see Estimate.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include "data.h"
+#include "getinit.h"
+
+double ProjectMemory(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
+		     TIMESTRUCT *Time, SOLARGEOMETRY *SolarGeo, LAYER *Soil,
+		     LAYER *Veg, SOILPIX **SoilMap, VEGPIX **VegMap,
+		     int NStats);
+double MapDumpBytes(DUMPSTRUCT *Dump, MAPSIZE *Map, int BasinOnly);
+void MakeScratchOutput(char *Dir);
+double ScratchOutputBytes(const char *Dir);
+void RemoveScratchOutput(const char *Dir);
+
+#endif
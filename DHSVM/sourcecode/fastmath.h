@@ -0,0 +1,162 @@
+/*
+ * SUMMARY:      fastmath.h - header file for the accuracy of exp, log and
+ *               pow
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  MathExp(), MathLog() and MathPow() of the physics routines,
+ *               with the accuracy of OPTIONS MATH ACCURACY, and the
+ *               polynomials of the FAST level, see FastMath.c
+ * DESCRIP-END.
+ * FUNCTIONS:    PolyExp()
+ *               PolyLog()
+ *               PolyPow()
+ *               MathExp()
+ *               MathLog()
+ *               MathPow()
+ * COMMENTS:     The polynomials are inline and without branches, so that
+ *               the lane loops of the kernels can be vectorized with them
+ */
+
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <math.h>
+
+/* OPTIONS MATH ACCURACY */
+#define MATH_EXACT 0		/* libm in double precision */
+#define MATH_FLOAT 1		/* libm in single precision, expf() ... */
+#define MATH_FAST  2		/* FLOAT, and PolyExp() ... in the lane
+				   loops */
+
+extern int MathAccuracy;
+
+void InitMathAccuracy(int Accuracy);
+const char *MathAccuracyName(int Accuracy);
+
+typedef union {
+  float f;
+  int i;
+} FLOATBITS;
+
+/*****************************************************************************
+  PolyExp()
+
+  exp(x) in single precision, with the polynomial of Cephes expf() on
+  x - n ln 2.  Within 1 ulp, see FastMath.c.  Below -87.3 the result is 0.
+*****************************************************************************/
+static inline float PolyExp(float x)
+{
+  FLOATBITS Scale;
+  float n;
+  float r;
+  float p;
+  float y;
+
+  y = (x > 88.37626f) ? 88.37626f : x;
+  y = (y < -87.33654f) ? -87.33654f : y;
+
+  /* round to the nearest integer by adding and subtracting 1.5 2^23 */
+  n = (y * 1.44269504f + 12582912.f) - 12582912.f;
+  r = y - n * 0.693359375f;
+  r = r + n * 2.12194440e-4f;
+
+  p = 1.9875691500e-4f;
+  p = p * r + 1.3981999507e-3f;
+  p = p * r + 8.3334519073e-3f;
+  p = p * r + 4.1665795894e-2f;
+  p = p * r + 1.6666665459e-1f;
+  p = p * r + 5.0000001201e-1f;
+  p = p * r * r + r + 1.0f;
+
+  Scale.i = ((int) n + 127) << 23;
+  p = p * Scale.f;
+  return (x < -87.33654f) ? 0.0f : p;
+}
+
+/*****************************************************************************
+  PolyLog()
+
+  log(x) in single precision, with the polynomial of Cephes logf() on the
+  mantissa.  Within 1 ulp for normal x > 0, see FastMath.c.  For x <= 0 the
+  result is -HUGE_VALF.
+*****************************************************************************/
+static inline float PolyLog(float x)
+{
+  FLOATBITS Bits;
+  float e;
+  float m;
+  float z;
+  float p;
+  int Small;
+
+  /* x = m 2^e, with m in [sqrt(1/2), sqrt(2)) */
+  Bits.f = x;
+  e = (float) (((Bits.i >> 23) & 0xff) - 126);
+  Bits.i = (Bits.i & 0x007fffff) | 0x3f000000;
+  Small = Bits.f < 0.70710678f;
+  e = Small ? e - 1.0f : e;
+  m = Small ? Bits.f + Bits.f - 1.0f : Bits.f - 1.0f;
+
+  z = m * m;
+  p = 7.0376836292e-2f;
+  p = p * m - 1.1514610310e-1f;
+  p = p * m + 1.1676998740e-1f;
+  p = p * m - 1.2420140846e-1f;
+  p = p * m + 1.4249322787e-1f;
+  p = p * m - 1.6668057665e-1f;
+  p = p * m + 2.0000714765e-1f;
+  p = p * m - 2.4999993993e-1f;
+  p = p * m + 3.3333331174e-1f;
+  p = p * m * z;
+  p = p + e * -2.12194440e-4f;
+  p = p - 0.5f * z;
+  p = m + p + e * 0.693359375f;
+  return (x > 0.0f) ? p : -HUGE_VALF;
+}
+
+/*****************************************************************************
+  PolyPow()
+
+  pow(x, y) = exp(y log(x)) in single precision, for x >= 0.  The error
+  grows with |y log(x)|, see FastMath.c.
+*****************************************************************************/
+static inline float PolyPow(float x, float y)
+{
+  float p;
+
+  p = PolyExp(y * PolyLog(x));
+  return (y == 0.0f) ? 1.0f : p;
+}
+
+/*****************************************************************************
+  MathExp(), MathLog(), MathPow()
+
+  exp(), log() and pow() of a single value with the accuracy of OPTIONS
+  MATH ACCURACY.  A single call of the polynomials is not faster than the
+  float functions of libm, so FAST calls those as well.
+*****************************************************************************/
+static inline double MathExp(double x)
+{
+  if (MathAccuracy == MATH_EXACT)
+    return exp(x);
+  return expf((float) x);
+}
+
+static inline double MathLog(double x)
+{
+  if (MathAccuracy == MATH_EXACT)
+    return log(x);
+  return logf((float) x);
+}
+
+static inline double MathPow(double x, double y)
+{
+  if (MathAccuracy == MATH_EXACT)
+    return pow(x, y);
+  return powf((float) x, (float) y);
+}
+
+#endif
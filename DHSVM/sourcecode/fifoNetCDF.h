@@ -19,7 +19,15 @@
 void CreateMapFileNetCDF(char *FileName, ...);
 int Read2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
 		       int NX, int NDataSet, ...);
+int Read3DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
+		       int NX, int NDataSet, int NLayers, ...);
+int Read2DWindowNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
+		       int NX, int NDataSet, int WinY, int WinX, int WinNY,
+		       int WinNX, ...);
 int Write2DMatrixNetCDF(char *FileName, void *Matrix, int NumberType, int NY,
 			int NX, ...);
+void InitCacheNetCDF(int SyncInterval, int Gather);
+void CloseFilesNetCDF(void);
+int IsGatheredNetCDF(char *FileName);
 
 #endif
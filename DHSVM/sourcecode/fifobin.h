@@ -21,11 +21,22 @@ int Read2DMatrixBin(char *FileName, void *Matrix, int NumberType, int NY,
 		    int NX, int NDataSet, ...); 
 int Read2DMatrixByteSwapBin(char *FileName, void *Matrix, int NumberType,
 			    int NY, int NX, int NDataSet, ...);
+int Read3DMatrixBin(char *FileName, void *Matrix, int NumberType, int NY,
+		    int NX, int NDataSet, int NLayers, ...);
+int Read3DMatrixByteSwapBin(char *FileName, void *Matrix, int NumberType,
+			    int NY, int NX, int NDataSet, int NLayers, ...);
+int Read2DWindowBin(char *FileName, void *Matrix, int NumberType, int NY,
+		    int NX, int NDataSet, int WinY, int WinX, int WinNY,
+		    int WinNX, ...);
+int Read2DWindowByteSwapBin(char *FileName, void *Matrix, int NumberType,
+			    int NY, int NX, int NDataSet, int WinY, int WinX,
+			    int WinNY, int WinNX, ...);
 int Write2DMatrixBin(char *FileName, void *Matrix, int NumberType, int NY,
 		     int NX, ...); 
 int Write2DMatrixByteSwapBin(char *FileName, void *Matrix, int NumberType,
 			     int NY, int NX, ...); 
-void byte_swap_long(long *buffer, int number_of_swaps);
-void byte_swap_short(short *buffer, int number_of_swaps);
+void CloseFilesBin(void);
+void byte_swap_long(void *buffer, int number_of_swaps);
+void byte_swap_short(void *buffer, int number_of_swaps);
 
 #endif
@@ -0,0 +1,30 @@
+/*
+ * SUMMARY:      fifobinz.h - header file for compressed binary IO functions
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  header file for the BINZ file format, see FileIOBinZ.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef FIFOBINZ_H
+#define FIFOBINZ_H
+
+void CreateMapFileBinZ(char *FileName, ...);
+int Read2DMatrixBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, ...);
+int Read3DMatrixBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, int NLayers, ...);
+int Read2DWindowBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, int WinY, int WinX, int WinNY,
+		     int WinNX, ...);
+int Write2DMatrixBinZ(char *FileName, void *Matrix, int NumberType, int NY,
+		      int NX, ...);
+void CloseFilesBinZ(void);
+size_t DataSetSizeBinZ(char *FileName, int NDataSet);
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * SUMMARY:      fifozarr.h - header file for Zarr IO functions
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  header file for the ZARR file format, see FileIOZarr.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef FIFOZARR_H
+#define FIFOZARR_H
+
+void InitZarr(int BasinOnly);
+void CreateMapFileZarr(char *FileName, ...);
+int Read2DMatrixZarr(char *FileName, void *Matrix, int NumberType, int NY,
+		     int NX, int NDataSet, ...);
+int Write2DMatrixZarr(char *FileName, void *Matrix, int NumberType, int NY,
+		      int NX, ...);
+void CloseFilesZarr(void);
+int IsStoreZarr(char *FileName);
+int IsGatheredZarr(char *FileName);
+void RemoveStoreZarr(char *FileName);
+void CopyStoreZarr(char *OldName, char *NewName);
+
+#endif
@@ -16,6 +16,7 @@
 #ifndef FILEIO_H
 #define FILEIO_H
 
+#include <stddef.h>
 #include "data.h"
 
 /* define identifiers for different file formats */
@@ -23,18 +24,60 @@
 #define BIN 1			/* binary IO */
 #define NETCDF 2		/* NetCDF format */
 #define BYTESWAP 3		/* binary IO but byteswap reads */
-void InitFileIO(int FileFormat);
+#define BINZ 4			/* binary IO compressed per dataset */
+#define ZARR 5			/* Zarr store per map file */
+void InitFileIO(int FileFormat, int SyncInterval, int QueueSize,
+		int BasinOnly);
+void CloseFileIO(void);
+void WaitFileIO(void);
+
+/* a field of the cells of a model map with row pointers Rows, for
+   Read2DField() and ReadBasinField() */
+typedef struct {
+  void **Rows;			/* Rows[y] is cell (y, 0) */
+  size_t CellSize;		/* size of a cell in bytes */
+  size_t Offset;		/* offset of the field in a cell */
+  int Type;			/* number type of the field, see sizeofnt.h */
+} MAPFIELD;
+
+/* the field Member of type Type of the map Rows of cells CellType, e.g.
+   MAP_FIELD(TopoMap, TOPOPIX, Dem, NC_FLOAT) */
+#define MAP_FIELD(Rows, CellType, Member, Type) \
+  ((MAPFIELD) { (void **) (Rows), sizeof(CellType), \
+                offsetof(CellType, Member), (Type) })
+
+/* a map Rows of values of ValueType, e.g. MAP_VALUES(PrismMap, float,
+   NC_FLOAT) */
+#define MAP_VALUES(Rows, ValueType, Type) \
+  ((MAPFIELD) { (void **) (Rows), sizeof(ValueType), 0, (Type) })
 
 /* global file extension string */
 extern char fileext[];
 
 /* function pointers for 2D file IO */
 
-void CreateMapFile(char *FileName, char *FileLabel, MAPSIZE *Map);
+void CreateMapFile(char *FileName, char *FileLabel, MAPSIZE *Map,
+		   NCSTORAGE *Storage);
 
 int Read2DMatrix(char *FileName, void *Matrix, int NumberType, 
                  MAPSIZE *Map, int NDataSet, char *VarName, int index);
 
+int ReadBasinMatrix(char *FileName, void *Matrix, int NumberType, 
+                    MAPSIZE *Map, int NDataSet, char *VarName, int index);
+
+int Read2DField(char *FileName, int NumberType, MAPSIZE *Map, int NDataSet,
+                char *VarName, int index, MAPFIELD Field);
+
+int ReadBasinField(char *FileName, int NumberType, MAPSIZE *Map,
+                   int NDataSet, char *VarName, int index, MAPFIELD Field);
+
+int Read3DMatrix(char *FileName, void *Matrix, int NumberType, 
+                 MAPSIZE *Map, int NDataSet, int NLayers, char *VarName,
+                 int index);
+
+int Read2DWindow(char *FileName, void *Matrix, int NumberType, 
+                 MAPSIZE *Map, int NDataSet, char *VarName, int index);
+
 int Write2DMatrix(char *FileName, void *Matrix, int NumberType, 
                   MAPSIZE *Map, MAPDUMP *DMap, int index);
 
@@ -42,5 +85,8 @@ int Write2DMatrix(char *FileName, void *Matrix, int NumberType,
 /* generic file functions */
 void OpenFile(FILE **FilePtr, char *FileName, char *Mode,
 	      unsigned char OverWrite);
+void BranchFile(FILE **FilePtr, char *OldName, char *NewName);
+void SetAsideFile(char *FileName);
+void ResumeFile(FILE **FilePtr, char *FileName, long Length);
 
 #endif
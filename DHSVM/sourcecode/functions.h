@@ -21,11 +21,17 @@
 #include "DHSVMChannel.h"
 
 void Aggregate(MAPSIZE *Map, OPTIONSTRUCT *Options, TOPOPIX **TopoMap,
-	       LAYER *Soil, LAYER *Veg, VEGPIX **VegMap, EVAPPIX **Evap,
+	       LAYER *Soil, LAYER *Veg, CELLCLASSES *Classes, EVAPPIX **Evap,
 	       PRECIPPIX **Precip, PIXRAD **RadMap, SNOWPIX **Snow,
-	       SOILPIX **SoilMap, AGGREGATED *Total, VEGTABLE *VType,
+	       SOILPIX **SoilMap, AGGREGATED *Total,
 	       ROADSTRUCT **Network, CHANNEL *ChannelData, float *roadarea);
 
+void AggregateFluxes(MAPSIZE *Map, OPTIONSTRUCT *Options, LAYER *Soil,
+		     LAYER *Veg, EVAPPIX **Evap, PRECIPPIX **Precip,
+		     SNOWPIX **Snow, SOILPIX **SoilMap, AGGREGATED *Total);
+
+void AccumulateMassBalance(AGGREGATED *Total, WATERBALANCE *Mass);
+
 void Alloc_Chan_Sed_Mem(float ** DummyVar);
 
 void CalcAerodynamic(int NVegLayers, unsigned char OverStory,
@@ -37,8 +43,12 @@ float CalcBagnold(float DS, TIMESTRUCT *Time, float, float, float, float);
 double CalcDistance(COORD *LocA, COORD *LocB);
 
 float CalcEffectiveKh(int NSoilLayers, float Top, float Bottom,
-		      float *SoilDepth, float *KhDry, float *KhSol,
-		      float *Moisture, float *Porosity, float *TSoil);
+		      float *SoilDepth, float *KhDry, float *KhSatFrozen,
+		      float *KhSatThawed, float *Moisture, float *Porosity,
+		      float *TSoil);
+
+void CalcSaturatedKh(float KhSol, float Porosity, float *KhSatFrozen,
+		     float *KhSatThawed);
 
 float CalcKhDry(float Density);
 
@@ -47,8 +57,14 @@ float CalcSnowAlbedo(float TSurf, unsigned short Last, SNOWTABLE *SnowAlbedo);
 float CalcTransmissivity(float SoilDepth, float WaterTable, float LateralKs,
 			 float KsExponent, float DepthThresh);
 
+void InitTransmissivityTable(SOILTABLE *SType, int Size);
+
+float SoilTransmissivity(float SoilDepth, float WaterTable, SOILTABLE *SType);
+
+void InitDrainageTable(SOILTABLE *SType, int Size);
+
 void CalcWeights(METLOCATION *Station, int NStats, int NX, int NY,
-		 uchar **BasinMask, uchar ****WeightArray,
+		 int Step, uchar **BasinMask, METWEIGHT ***WeightArray,
 		 OPTIONSTRUCT *Options);
 
 double ChannelCulvertSedFlow(int y, int x, CHANNEL * ChannelData, int i);
@@ -61,14 +77,8 @@ unsigned char dequal(double a, double b);
 
 void deg2utm(float la, float lo, float *x, float *y);
 
-void draw(DATE *Day, int first, int DayStep, MAPSIZE *Map, int NGraphics,
-	  int *which_graphics, VEGTABLE *VType, SOILTABLE *SType, SNOWPIX **SnowMap, 
-	  SOILPIX **SoilMap, VEGPIX **VegMap, TOPOPIX **TopoMap, PRECIPPIX **PrecipMap, 
-	  float **PrismMap, float **SkyViewMap, unsigned char ***ShadowMap, 
-	  EVAPPIX **EvapMap, PIXRAD **RadMap, MET_MAP_PIX **MetMap,
-	  ROADSTRUCT **Network, OPTIONSTRUCT *Options);
-
-void DumpMap(MAPSIZE *Map, DATE *Current, MAPDUMP *DMap, TOPOPIX **TopoMap,
+void DumpMap(MAPSIZE *Map, DATE *Current, MAPDUMP *DMap, int Index, 
+	     TOPOPIX **TopoMap,
 	     EVAPPIX **EvapMap, PRECIPPIX **PrecipMap, PIXRAD **RadMap,
 	     SNOWPIX **Snowap, SOILPIX **SoilMap, LAYER *Soil, VEGPIX **VegMap, 
          LAYER *Veg, ROADSTRUCT **Network, OPTIONSTRUCT *Options);
@@ -77,6 +87,16 @@ void DumpPix(DATE *Current, int first, FILES *OutFile, EVAPPIX *Evap,
 	     PRECIPPIX *Precip, PIXRAD *Rad, SNOWPIX *Snow, SOILPIX *Soil, int NSoil,
          int NVeg, OPTIONSTRUCT *Options);
 
+void DumpPixBin(DATE *Current, DUMPSTRUCT *Dump, EVAPPIX **EvapMap,
+		PRECIPPIX **PrecipMap, PIXRAD **RadMap, SNOWPIX **SnowMap,
+		SOILPIX **SoilMap, VEGPIX **VegMap, LAYER *Soil, LAYER *Veg,
+		OPTIONSTRUCT *Options);
+
+void InitPixBinVars(DUMPSTRUCT *Dump, LAYER *Soil, LAYER *Veg,
+		    OPTIONSTRUCT *Options);
+
+void DumpSatExtent(DATE *Current, DUMPSTRUCT *Dump, AGGREGATED *Total);
+
 void ExecDump(MAPSIZE *Map, DATE *Current, DATE *Start, OPTIONSTRUCT *Options,
 	      DUMPSTRUCT *Dump, TOPOPIX **TopoMap, EVAPPIX **EvapMap, PIXRAD **RadiMap,
 	      PRECIPPIX ** PrecipMap, SNOWPIX **SnowMap, MET_MAP_PIX **MetMap, 
@@ -95,17 +115,51 @@ void GenerateScales(MAPSIZE *Map, int NumberType, void **XScale,
 		    void **YScale);
 
 void GetMetData(OPTIONSTRUCT *Options, TIMESTRUCT *Time, int NSoilLayers,
-		int NStats, float SunMax, METLOCATION *Stat, MAPSIZE *Radar,
-		RADARPIX **RadarMap, char *RadarFileName);
+		int NStats, SOLARGEOMETRY *SolarGeo, METLOCATION *Stat,
+		MAPSIZE *Radar, float *RadarMap, char *RadarFileName);
+
+void PerturbMetData(OPTIONSTRUCT *Options, TIMESTRUCT *Time, int NStats,
+		    METLOCATION *Stat);
 
 uchar InArea(MAPSIZE *Map, COORD *Loc);
 
+uchar InInputArea(MAPSIZE *Map, COORD *Loc);
+
+void InitActiveCells(MAPSIZE *Map, TOPOPIX **TopoMap, OPTIONSTRUCT *Options);
+int OrderActiveCells(MAPSIZE *Map, SNOWPIX **SnowMap, int *CellOrder);
+
+void InitTiles(TILESCHEDULE *Tiles, int NItems, int TileSize, int NThreads);
+
+void FreeTiles(TILESCHEDULE *Tiles);
+
+void PlanTiles(TILESCHEDULE *Tiles);
+
+int NextTile(TILESCHEDULE *Tiles);
+
+void InitThreadPlacement(OPTIONSTRUCT *Options);
+
+void UnpinThread(void);
+
+void FirstTouchRows(MAPSIZE *Map, void *Rows, size_t RowBytes);
+
+void FirstTouchBlock(void *Block, size_t NItems, size_t ItemSize);
+
+void HugePageHint(void *Block, size_t Bytes);
+
 void InitAggregated(int MaxVegLayers, int MaxSoilLayers, AGGREGATED *Total);
 
-void InitChannelRVeg(TIMESTRUCT *Time, Channel *Channel); 
+void InitChannelRVeg(TIMESTRUCT *Time, Channel *Channel,
+		     SOLARGEOMETRY *SolarGeo);
 
 void InitCharArray(char *Array, int Size);
 
+void *AllocHaloMap(int NY, int NX, size_t Size, int Tag);
+
+void FreeHaloMap(void *Map, size_t Size);
+
+float *GrowFieldBlock(float *Fields, int NFields, int N, int OldMax,
+		      int NewMax);
+
 void InitConstants(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
 		   SOLARGEOMETRY *SolarGeo, TIMESTRUCT *Time);
 
@@ -114,8 +168,9 @@ void InitDump(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
 	      TOPOPIX **TopoMap, DUMPSTRUCT *Dump, int *NGraphics,
 	      int **which_graphics);
 
-void InitEvapMap(MAPSIZE *Map, EVAPPIX ***EvapMap, SOILPIX **SoilMap,
-		 LAYER *Soil, VEGPIX **VegMap, LAYER *Veg, TOPOPIX **TopoMap);
+void InitEvapMap(OPTIONSTRUCT *Options, MAPSIZE *Map, EVAPPIX ***EvapMap,
+		 SOILPIX **SoilMap, LAYER *Soil, VEGPIX **VegMap, LAYER *Veg,
+		 TOPOPIX **TopoMap);
 
 void InitImageDump(LISTPTR Input, int Dt, MAPSIZE *Map, int MaxSoilLayers,
 		   int MaxVegLayers, char *Path, int NMaps, int NImages, MAPDUMP **DMap);
@@ -123,25 +178,39 @@ void InitImageDump(LISTPTR Input, int Dt, MAPSIZE *Map, int MaxSoilLayers,
 void InitInFiles(INPUTFILES *InFiles);
 
 void InitInterpolationWeights(MAPSIZE *Map, OPTIONSTRUCT *Options,
-			      TOPOPIX **TopoMap, uchar ****MetWeights,
+			      TOPOPIX **TopoMap, METWEIGHT ***MetWeights,
 			      METLOCATION *Stats, int NStats);
 
 void InitMapDump(LISTPTR Input, MAPSIZE *Map, int MaxSoilLayers, int MaxVegLayers,
-		 char *Path, int TotalMapImages, int NMaps, MAPDUMP **DMap);
+		 char *Path, int TotalMapImages, int NMaps, MAPDUMP **DMap,
+		 OPTIONSTRUCT *Options);
 
 void InitMassWaste(LISTPTR Input, TIMESTRUCT *Time);
 
 void InitGridMet(OPTIONSTRUCT *Options, LISTPTR Input, MAPSIZE *Map, TOPOPIX **TopoMap,  
-         GRID *Grid, METLOCATION **Stat, int *NStats);
+         int NSoilLayers, int Dt, GRID *Grid, METLOCATION **Stat, int *NStats);
+
+void InitGridMetNetCDF(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		       int NSoilLayers, int Dt, GRID *Grid,
+		       METLOCATION **Stat, int *NStats);
 
 void InitMetMaps(int NDaySteps, MAPSIZE *Map, MAPSIZE *Radar,
 		 OPTIONSTRUCT *Options, char *WindPath, char *PrecipLapsePath,
-		 float ***PrecipLapseMap, float ***PrismMap,
-		 unsigned char ****ShadowMap, float ***SkyViewMap,
+		 STATICMAP *PrecipLapseMap, float ***PrismMap,
+		 SHADOWMAP *ShadowMap, STATICMAP *SkyViewMap,
 		 EVAPPIX ***EvapMap, PRECIPPIX ***PrecipMap,
-		 RADARPIX ***RadarMap, PIXRAD ***RadMap, SOILPIX **SoilMap, 
+		 float **RadarMap, PIXRAD ***RadMap, SOILPIX **SoilMap, 
          LAYER *Soil, VEGPIX **VegMap, LAYER *Veg, TOPOPIX **TopoMap, 
-         float ****MM5Input, float ****WindModel);
+         float ****MM5Input, STATICMAP **WindModel);
+
+void InitMetFields(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+		   METFIELDS *MetFields);
+
+void InitMetNodes(MAPSIZE *Map, OPTIONSTRUCT *Options, TOPOPIX **TopoMap,
+		  METLOCATION *Stats, int NStats, METFIELDS *MetFields);
+
+void MetNodeWeights(METFIELDS *MetFields, int y, int x, int *Node,
+		    float *Weight);
 
 void InitMetSources(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
             TOPOPIX **TopoMap, int NSoilLayers, TIMESTRUCT *Time, 
@@ -161,39 +230,71 @@ void InitModelState(DATE *Start, MAPSIZE *Map, OPTIONSTRUCT *Options,
 		    VEGPIX **VegMap, LAYER Veg, VEGTABLE *VType, char *Path,
 		    SNOWTABLE *SnowAlbedo, TOPOPIX **TopoMap,
 		    ROADSTRUCT **Network, UNITHYDRINFO *HydrographInfo,
-		    float *Hydrograph);
+		    float *Hydrograph, ChannelNetwork *StreamNet);
 
 void InitNetwork(int NY, int NX, float DX, float DY, TOPOPIX **TopoMap, 
 		 SOILPIX **SoilMap, VEGPIX **VegMap, VEGTABLE *VType, 
 		 ROADSTRUCT ***Network, CHANNEL *ChannelData, 
 		 LAYER Veg, OPTIONSTRUCT *Options);
 
+void InitSoilCapacities(MAPSIZE *Map, TOPOPIX **TopoMap, SOILPIX **SoilMap,
+			VEGPIX **VegMap, VEGTABLE *VType, SOILTABLE *SType,
+			ROADSTRUCT **Network);
+
+void InitSolarSchedule(int Dt, SOLARGEOMETRY *SolarGeo);
+
 void InitNewDay(int DayOfYear, SOLARGEOMETRY *SolarGeo);
 
+void StepSolarGeometry(int DayStep, int Dt, SOLARGEOMETRY *SolarGeo);
+
+void DaylightSteps(int Year, int Month, int Dt, SOLARGEOMETRY *SolarGeo,
+		   int NDaySteps, int *Slice);
+
+void ReadShadowSlices(char *FileName, MAPSIZE *Map, int NDaySteps, int *Slice,
+		      unsigned char *Block);
+
+void StepShadowMaps(SHADOWMAP *ShadowMap, MAPSIZE *Map, int DayStep);
+
 void InitNewMonth(TIMESTRUCT *Time, OPTIONSTRUCT *Options, MAPSIZE *Map,
-		  TOPOPIX **TopoMap, float **PrismMap, unsigned char ***ShadowMap, 
-		  INPUTFILES *InFiles, int NVegs, VEGTABLE *VType, int NStats,
+		  TOPOPIX **TopoMap, float **PrismMap, SHADOWMAP *ShadowMap,
+		  SOLARGEOMETRY *SolarGeo, INPUTFILES *InFiles, int NVegs, VEGTABLE *VType, int NStats,
 		  METLOCATION *Stat, char *Path);
 
 void InitNewStep(INPUTFILES *InFiles, MAPSIZE *Map, TIMESTRUCT *Time,
 		 int NSoilLayers, OPTIONSTRUCT *Options, int NStats,
 		 METLOCATION *Stat, char *RadarFileName, MAPSIZE *Radar,
-		 RADARPIX **RadarMap, SOLARGEOMETRY *SolarGeo, 
+		 float *RadarMap, SOLARGEOMETRY *SolarGeo, 
 		 TOPOPIX **TopoMap, SOILPIX **SoilMap, float ***MM5Input, 
-         float ***WindModel, MAPSIZE *MM5Map);
+         STATICMAP *WindModel, MAPSIZE *MM5Map);
+
+void ReadMM5Maps(INPUTFILES *InFiles, OPTIONSTRUCT *Options, int NSoilLayers,
+		 MAPSIZE *MM5Map, int Step, float *Array);
 
 int InitPixDump(LISTPTR Input, MAPSIZE *Map, uchar **BasinMask, char *Path,
 		int NPix, PIXDUMP **Pix, OPTIONSTRUCT *Options);
 
 void InitPrecipLapse(LISTPTR Input, INPUTFILES *InFiles);
 
-void InitPrecipLapseMap(char *PrecipLapseFile, MAPSIZE *Map,
-			float ***PrecipLapseMap);
+void InitPrecipLapseMap(char *PrecipLapseFile, MAPSIZE *Map, int Bits,
+			STATICMAP *PrecipLapseMap);
 
 void InitPrismMap(int NY, int NX, float ***PrismMap);
 
 void InitShadeMap(OPTIONSTRUCT *Options, int NDaySteps, MAPSIZE *Map,
-		  unsigned char ****ShadowMap, float ***SkyViewMap);
+		  TOPOPIX **TopoMap, SHADOWMAP *ShadowMap,
+		  STATICMAP *SkyViewMap);
+
+void InitHorizons(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		  HORIZONMAP *Horizon, float *SkyView);
+
+void HorizonShadeStep(MAPSIZE *Map, SOLARGEOMETRY *SolarGeo,
+		      SHADOWMAP *ShadowMap);
+
+void InitStaticMap(MAPSIZE *Map, int Bits, float *Array, float Fill, int Tag,
+		   STATICMAP *Static);
+float StaticMapValue(STATICMAP *Static, int k);
+void ExpandStaticMap(MAPSIZE *Map, STATICMAP *Static, float **Grid);
+void FreeStaticMap(STATICMAP *Static);
 
 void InitPrecipMap(MAPSIZE *Map, PRECIPPIX ***PrecipMap, VEGPIX **VegMap,
 		   LAYER *Veg, TOPOPIX **TopoMap);
@@ -201,7 +302,7 @@ void InitPrecipMap(MAPSIZE *Map, PRECIPPIX ***PrecipMap, VEGPIX **VegMap,
 void InitRadar(LISTPTR Input, MAPSIZE *Map, TIMESTRUCT *Time,
 	       INPUTFILES *InFiles, MAPSIZE *Radar);
 
-void InitRadarMap(MAPSIZE *Radar, RADARPIX ***RadarMap);
+void InitRadarMap(MAPSIZE *Radar, float **RadarMap);
 
 void InitRadMap(MAPSIZE *Map, PIXRAD ***RadMap);
 
@@ -209,9 +310,14 @@ void InitSatVaporTable(void);
 
 void InitSnowMap(MAPSIZE *Map, SNOWPIX ***SnowMap);
 
+void InitSubSurfaceWork(MAPSIZE *Map, OPTIONSTRUCT *Options,
+			SUBSURFACEWORK *Work);
+
 void InitSoilMap(LISTPTR Input, OPTIONSTRUCT *Options, MAPSIZE *Map,
 		 LAYER *Soil, TOPOPIX **TopoMap, SOILPIX ***SoilMap);
 
+void CheckSoilTables(int NSoils, SOILTABLE *SType);
+
 int InitSoilTable(OPTIONSTRUCT *Options, SOILTABLE **SType, 
 			LISTPTR Input, LAYER *Soil, int InfiltOption);
 
@@ -219,6 +325,25 @@ void InitSnowTable(SNOWTABLE **SnowAlbedo, int Dt);
 
 void InitStateDump(LISTPTR Input, int NStates, DATE **DState);
 
+void InitStatistics(LISTPTR Input, MAPSIZE *Map, int MaxSoilLayers,
+		    int MaxVegLayers, char *Path, int NStats, 
+		    STATDUMP **Stats);
+
+void UpdateStatistics(MAPSIZE *Map, DATE *Current, int NStats, 
+		      STATDUMP *Stats, TOPOPIX **TopoMap, EVAPPIX **EvapMap,
+		      PRECIPPIX **PrecipMap, PIXRAD **RadMap,
+		      SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER *Soil,
+		      VEGPIX **VegMap, LAYER *Veg, OPTIONSTRUCT *Options);
+
+void FinishStatistics(MAPSIZE *Map, int NStats, STATDUMP *Stats);
+
+void InitDumpEvents(DUMPSTRUCT *Dump);
+
+void InitDiagnostics(OPTIONSTRUCT *Options, DUMPSTRUCT *Dump, int NGraphics,
+		     int *which_graphics);
+
+void RolloverDump(MAPSIZE *Map, OPTIONSTRUCT *Options, DUMPSTRUCT *Dump);
+
 void InitGraphicsDump(LISTPTR Input, int NGraphics, int ***which_graphics);
 
 void InitStations(LISTPTR Input, MAPSIZE *Map, int NDaySteps,
@@ -248,29 +373,48 @@ float evalexpint(int n, float x);
 void InitWindModel(LISTPTR Input, INPUTFILES *InFiles, int NStats,
 		   METLOCATION *Stat);
 
-void InitWindModelMaps(char *WindPath, MAPSIZE *Map, float ****WindModel);
+void InitWindModelMaps(char *WindPath, MAPSIZE *Map, int Bits,
+		       STATICMAP **WindModel);
 
 uchar IsStationLocation(COORD *Loc, int NStats, METLOCATION *Station,
 			int *WhichStation);
 
-void InitXGraphics(int argc, char **argv,
-		   int ny, int nx, int nd, MET_MAP_PIX ***MetMap);
-
 float LapsePrecip(float Precip, float FromElev, float ToElev, float PrecipLapse);
 
 float LapseT(float Temp, float FromElev, float ToElev, float LapseRate);
  
-PIXMET MakeLocalMetData(int y, int x, MAPSIZE *Map, int DayStep,
+PIXMET MakeLocalMetData(int y, int x, int Cell, MAPSIZE *Map, 
+			METFIELDS *MetFields, int DayStep,
 			OPTIONSTRUCT *Options, int NStats, METLOCATION *Stat, 
-            uchar *MetWeights, float LocalElev, PIXRAD *RadMap,
-			PRECIPPIX *PrecipMap, MAPSIZE *Radar, RADARPIX **RadarMap,
+            METWEIGHT *MetWeights, float LocalElev, PIXRAD *RadMap,
+			PRECIPPIX *PrecipMap, MAPSIZE *Radar, float *RadarMap,
 			float **PrismMap, SNOWPIX *LocalSnow, SNOWTABLE *SnowAlbedo,
-			float ***MM5Input, float ***WindModel, float **PrecipLapseMap,
-			MET_MAP_PIX ***MetMap, int NGraphics, int Month, float skyview,
+			float ***MM5Input, STATICMAP *WindModel, 
+			STATICMAP *PrecipLapseMap,
+			MET_MAP_PIX ***MetMap, int Diagnostics, int Month, float skyview,
 			unsigned char shadow, float SunMax, float SineSolarAltitude);
 
+void MakePrecipFactors(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+		       METLOCATION *Stat, METWEIGHT **MetWeights,
+		       TOPOPIX **TopoMap, float **PrismMap,
+		       STATICMAP *PrecipLapseMap, int Month,
+		       METFIELDS *MetFields);
+
+void MakeStationValues(OPTIONSTRUCT *Options, int NStats, METLOCATION *Stat,
+		       METFIELDS *MetFields);
+
+void MakeMetFields(MAPSIZE *Map, OPTIONSTRUCT *Options, int NStats,
+		   METLOCATION *Stat, METWEIGHT **MetWeights,
+		   TOPOPIX **TopoMap, float ***MM5Input, STATICMAP *WindModel,
+		   float SunMax, METFIELDS *MetFields);
+
 void MassBalance(DATE *Current, DATE *Start, FILES *Out, AGGREGATED *Total, WATERBALANCE *Mass);
 
+/* stages of MassEnergyBalance() the pixel loop has done for the cells of
+   a piece (BatchDone) */
+#define DONE_RADIATION    1	/* RADIATION BATCH */
+#define DONE_INTERCEPTION 2	/* INTERCEPTION BATCH */
+
 void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x, 
 			   float SineSolarAltitude, float DX, float DY,
 		        int Dt, int HeatFluxOption, int CanopyRadAttOption, 
@@ -279,28 +423,218 @@ void MassEnergyBalance(OPTIONSTRUCT *Options, int y, int x,
 		       VEGTABLE *VType, VEGPIX *LocalVeg, SOILTABLE *SType,
 		       SOILPIX *LocalSoil, SNOWPIX *LocalSnow, PIXRAD *LocalRad,
                EVAPPIX *LocalEvap, PIXRAD *TotalRad, CHANNEL *ChannelData, 
-               float** skyview);
+               float skyview, ChannelGridAccum *ChannelAccum,
+               SOILCOLUMN *Column, int BatchDone);
+
+/* MassEnergyBalance() specialised for the options of the run */
+typedef void (*MEBFUNCTION) (OPTIONSTRUCT *Options, int y, int x,
+			     float SineSolarAltitude, float DX, float DY,
+			     int Dt, int HeatFluxOption,
+			     int CanopyRadAttOption, int InfiltOption,
+			     int MaxVegLayers, PIXMET *LocalMet,
+			     ROADSTRUCT *LocalNetwork,
+			     PRECIPPIX *LocalPrecip, VEGTABLE *VType,
+			     VEGPIX *LocalVeg, SOILTABLE *SType,
+			     SOILPIX *LocalSoil, SNOWPIX *LocalSnow,
+			     PIXRAD *LocalRad, EVAPPIX *LocalEvap,
+			     PIXRAD *TotalRad, CHANNEL *ChannelData,
+			     float skyview, ChannelGridAccum *ChannelAccum,
+			     SOILCOLUMN *Column, int BatchDone);
+MEBFUNCTION SelectMassEnergyBalance(OPTIONSTRUCT *Options);
 
 float MaxRoadInfiltration(ChannelMapPtr **map, int col, int row);
 
 double pow (double a, double b);
 
-void quick(ITEM *OrderedCells, int count);
-
-void qs(ITEM *OrderedCells, int left, int right);
-
 void ReadChannelState(char *Path, DATE *Current, Channel *Head);
 
 void ReadMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
 		   FILES *InFile, unsigned char IsWindModelLocation,
 		   MET *MetRecord);
 
+int CountMetVars(OPTIONSTRUCT *Options, int NSoilLayers,
+		 unsigned char IsWindModelLocation);
+
+int ScanMetRecord(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
+		  FILES *InFile, unsigned char IsWindModelLocation,
+		  float *Array);
+
+void StoreMetRecord(OPTIONSTRUCT *Options, int NSoilLayers, char *FileName,
+		    unsigned char IsWindModelLocation, float *Array,
+		    MET *MetRecord);
+
+void InitMetFilePool(int MaxOpen, int NStats, METLOCATION *Stat);
+
+void InitMetCache(OPTIONSTRUCT *Options, TIMESTRUCT *Time, int NSoilLayers,
+		  int NStats, METLOCATION *Stat);
+
+int ReadMetCache(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
+		 int NStats, METLOCATION *Stat);
+
+void CloseMetCache(void);
+
+float *ReadGridMetNetCDF(DATE *Current, int *NVars);
+
+void CloseGridMetNetCDF(void);
+
+void ReopenMetFiles(int NStats, METLOCATION *Stat);
+
+void TellMetFiles(int NStats, METLOCATION *Stat, long *Position);
+
+void SeekMetFiles(int NStats, METLOCATION *Stat, long *Position);
+
+int RewindMetFiles(int NStats, METLOCATION *Stat);
+
+int InitEnsemble(OPTIONSTRUCT *Options, int NStats, METLOCATION *Stat);
+
+void InitStaticShare(OPTIONSTRUCT *Options, MAPSIZE *Map, TIMESTRUCT *Time,
+		     SOLARGEOMETRY *SolarGeo, INPUTFILES *InFiles, int NStats,
+		     METLOCATION *Stat);
+
+void PublishStaticShare(OPTIONSTRUCT *Options, MAPSIZE *Map, TIMESTRUCT *Time,
+			SOLARGEOMETRY *SolarGeo, STATICMAP *SkyViewMap,
+			STATICMAP *WindModel, STATICMAP *PrecipLapseMap,
+			METWEIGHT **MetWeights);
+
+int SharedStaticMap(int Id, MAPSIZE *Map, STATICMAP *Static);
+
+int SharedShadowMaps(int Month, int NDaySteps, int **Slice,
+		     unsigned char **Block);
+
+int SharedWeights(MAPSIZE *Map, METWEIGHT ***MetWeights);
+
+void CloseStaticShare(void);
+
+void ClearSoilBatch(SOILBATCH *Batch);
+
+void AddSoilColumn(SOILBATCH *Batch, SOILPIX *LocalSoil, SOILTABLE *SType,
+		   VEGTABLE *VType, ROADSTRUCT *Network);
+
+void DistributeSatflowBatch(SOILBATCH *Batch);
+
+void UnsaturatedFlowBatch(SOILBATCH *Batch, int Dt);
+
+void FreeSoilBatch(SOILBATCH *Batch);
+
+void ClearRadiationBatch(RADBATCH *Batch);
+
+void AddRadiationCell(RADBATCH *Batch, OPTIONSTRUCT *Options,
+		      PIXMET *LocalMet, VEGTABLE *VType, VEGPIX *LocalVeg,
+		      SOILPIX *LocalSoil, float SoilAlbedo,
+		      SNOWPIX *LocalSnow, PIXRAD *LocalRad);
+
+void RadiationBalanceBatch(RADBATCH *Batch, OPTIONSTRUCT *Options,
+			   float SineSolarAltitude);
+
+void FreeRadiationBatch(RADBATCH *Batch);
+
+void ClearInterceptionBatch(INTBATCH *Batch);
+
+void AddInterceptionCell(INTBATCH *Batch, VEGTABLE *VType, PIXMET *LocalMet,
+			 VEGPIX *LocalVeg, SNOWPIX *LocalSnow,
+			 PRECIPPIX *LocalPrecip, int Dt);
+
+void InterceptionBatch(INTBATCH *Batch, int Dt);
+
+void FreeInterceptionBatch(INTBATCH *Batch);
+
+void InitStationIndex(METLOCATION *Station, int NStats, STATIONINDEX *Index);
+
+int NearestStations(STATIONINDEX *Index, COORD *Loc, int K, int *Id,
+		    double *D2);
+
+int StationsWithin(STATIONINDEX *Index, COORD *Loc, double MaxD2, int *Id);
+
+int StationAt(STATIONINDEX *Index, COORD *Loc);
+
+void FreeStationIndex(STATIONINDEX *Index);
+
+void InitCellClasses(MAPSIZE *Map, VEGPIX **VegMap, SOILPIX **SoilMap,
+		     VEGTABLE *VType, SOILTABLE *SType, LAYER *Veg,
+		     LAYER *Soil, CELLCLASSES *Classes);
+
+void InitStructureClasses(MAPSIZE *Map, ROADSTRUCT **Network,
+			  CELLCLASSES *Classes);
+
+void OrderStructureClasses(MAPSIZE *Map, SNOWPIX **SnowMap,
+			   CELLCLASSES *Classes, TILESCHEDULE *Tiles,
+			   int *CellOrder);
+
+void InitMapEvents(LISTPTR Input, OPTIONSTRUCT *Options, int Resume,
+		   MAPEVENTS *Events);
+
+int ApplyMapEvent(MAPEVENT *Event, OPTIONSTRUCT *Options, MAPSIZE *Map,
+		  LAYER *Veg, LAYER *Soil, VEGTABLE *VType, SOILTABLE *SType,
+		  VEGPIX **VegMap, SOILPIX **SoilMap, SNOWPIX **SnowMap,
+		  PRECIPPIX **PrecipMap, EVAPPIX **EvapMap,
+		  ROADSTRUCT **Network, CELLCLASSES *Classes, float *Added);
+
+void ChangeCellClass(int k, int VegType, int SoilType, VEGTABLE *VType,
+		     SOILTABLE *SType, LAYER *Veg, LAYER *Soil,
+		     ROADSTRUCT *Network, CELLCLASSES *Classes);
+
+void FreeCellClasses(CELLCLASSES *Classes);
+
+void InitSubBasin(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		  FLOWGRAPH *SurfaceGraph, CHANNEL *ChannelData,
+		  int MaxStreamID, int MaxRoadID);
+
+void InitHRU(OPTIONSTRUCT *Options, MAPSIZE *Map, LAYER *Soil,
+	     TOPOPIX **TopoMap, SOILPIX **SoilMap, VEGPIX **VegMap,
+	     ROADSTRUCT **Network, CHANNEL *ChannelData, STATICMAP *SkyViewMap,
+	     unsigned char ***ShadowMap, int NDaySteps, METWEIGHT **MetWeights,
+	     HRUSTRUCT *HRU);
+
+void PrepareHRURep(HRUSTRUCT *HRU, int k, int Dt, MAPSIZE *Map,
+		   SOILPIX *LocalSoil, SOILTABLE *SType, VEGTABLE *VType,
+		   ROADSTRUCT *LocalNetwork, int InfiltOption);
+
+void FinishHRURep(HRUSTRUCT *HRU, int k, SOILPIX *LocalSoil, int NSoilLayers);
+
+void BroadcastHRU(HRUSTRUCT *HRU, int m, MAPSIZE *Map, int Dt,
+		  int InfiltOption, LAYER *Soil, LAYER *Veg, SOILTABLE *SType,
+		  VEGTABLE *VType, PRECIPPIX **PrecipMap, SNOWPIX **SnowMap,
+		  SOILPIX **SoilMap, VEGPIX **VegMap, PIXRAD **RadiationMap,
+		  EVAPPIX **EvapMap, ROADSTRUCT **Network, PIXRAD *TotalRad);
+
+void ReadMetRecords(OPTIONSTRUCT *Options, DATE *Current, int NSoilLayers,
+		    int NStats, METLOCATION *Stat);
+
+void PrefetchMetRecords(OPTIONSTRUCT *Options, DATE *Next, int NSoilLayers,
+			int NStats, METLOCATION *Stat);
+
+void InterpolateMetData(OPTIONSTRUCT *Options, TIMESTRUCT *Time,
+			int NSoilLayers, int NStats, METLOCATION *Stat,
+			SOLARGEOMETRY *SolarGeo);
+
+void InterpolateMM5Maps(INPUTFILES *InFiles, OPTIONSTRUCT *Options,
+			TIMESTRUCT *Time, int NSoilLayers, int NMaps,
+			MAPSIZE *MM5Map, SOLARGEOMETRY *SolarGeo,
+			float *Array);
+
 void ReadRadarMap(DATE *Current, DATE *StartRadar, int Dt, MAPSIZE *Radar,
-		  RADARPIX **RadarMap, char *HDFFileName);
+		  float *RadarMap, char *HDFFileName);
 
 void ReadPRISMMap(DATE *Current, DATE *StartRadar, int Dt, MAPSIZE *Radar,
 		  RADARPIX **RadarMap, char *HDFFileName);
 
+float *ExtractDumpVar(MAPSIZE *Map, MAPDUMP *DMap, TOPOPIX **TopoMap,
+		      EVAPPIX **EvapMap, PRECIPPIX **PrecipMap, 
+		      PIXRAD **RadMap, SNOWPIX **SnowMap, SOILPIX **SoilMap,
+		      LAYER *Soil, VEGPIX **VegMap, LAYER *Veg,
+		      OPTIONSTRUCT *Options);
+
+void ReadMapMask(char *FileName, MAPSIZE *Map, MAPDUMP *DMap);
+
+void WindowMapSize(MAPSIZE *Map, MAPDUMP *DMap, MAPSIZE *Out);
+
+void WindowMap(MAPSIZE *Map, MAPDUMP *DMap, TOPOPIX **TopoMap, float *Array);
+
+void ReduceMap(MAPSIZE *Map, MAPDUMP *DMap, TOPOPIX **TopoMap,
+	       EVAPPIX **EvapMap, PRECIPPIX **PrecipMap, PIXRAD **RadMap,
+	       SNOWPIX **SnowMap, SOILPIX **SoilMap, LAYER *Soil,
+	       VEGPIX **VegMap, LAYER *Veg, OPTIONSTRUCT *Options);
+
 void ResetAggregate(LAYER *Soil, LAYER *Veg, AGGREGATED *Total,
                     OPTIONSTRUCT *Options);
 
@@ -309,18 +643,38 @@ void ResetValues(MAPSIZE *Map, SOILPIX **SoilMap);
 int Round(double x);
 
 void RouteSubSurface(int Dt, MAPSIZE *Map, TOPOPIX **TopoMap,
-		     VEGTABLE *VType, VEGPIX **VegMap,
-		     ROADSTRUCT **Network, SOILTABLE *SType,
+		     CELLCLASSES *Classes, ROADSTRUCT **Network,
 		     SOILPIX **SoilMap, CHANNEL *ChannelData, 
 		     TIMESTRUCT *Time, OPTIONSTRUCT *Options, 
-		     char *DumpPath, int MaxStreamID, SNOWPIX **SnowMap);
+		     int MaxStreamID, SNOWPIX **SnowMap, FLOWGRAPH *SurfaceGraph,
+		     SUBSURFACEWORK *Work);
 
 void RouteSurface(MAPSIZE * Map, TIMESTRUCT * Time, TOPOPIX ** TopoMap,
   SOILPIX ** SoilMap, OPTIONSTRUCT *Options,
   UNITHYDR ** UnitHydrograph, UNITHYDRINFO * HydrographInfo, float *Hydrograph,
-  DUMPSTRUCT *Dump, VEGPIX ** VegMap, VEGTABLE * VType, CHANNEL *ChannelData);
+  DUMPSTRUCT *Dump, FLOWGRAPH *Graph, SURFACEROUTE *Route);
+void InitSurfaceRoute(MAPSIZE * Map, TOPOPIX ** TopoMap, VEGPIX ** VegMap,
+  VEGTABLE * VType, CHANNEL *ChannelData, SURFACEROUTE *Route);
+void FreeSurfaceRoute(SURFACEROUTE *Route);
+
+void InitSpinUp(OPTIONSTRUCT *Options, MAPSIZE *Map, LAYER *Soil, LAYER *Veg,
+		VEGTABLE *VType, PRECIPPIX **PrecipMap, SNOWPIX **SnowMap,
+		SOILPIX **SoilMap, VEGPIX **VegMap, ROADSTRUCT **Network,
+		SPINUP *Spin);
+int SpinUpCycle(OPTIONSTRUCT *Options, MAPSIZE *Map, LAYER *Soil, LAYER *Veg,
+		SOILTABLE *SType, VEGTABLE *VType, PRECIPPIX **PrecipMap,
+		SNOWPIX **SnowMap, SOILPIX **SoilMap, VEGPIX **VegMap,
+		ROADSTRUCT **Network, WATERBALANCE *Mass, SPINUP *Spin);
+void FreeSpinUp(SPINUP *Spin);
+
+void InitObjective(LISTPTR Input, TIMESTRUCT *Time, Channel *Streams,
+		   OBJECTIVE *Obj);
+int UpdateObjective(TIMESTRUCT *Time, OBJECTIVE *Obj);
+void ReportObjective(char *Path, DATE *Current, OBJECTIVE *Obj);
+void FreeObjective(OBJECTIVE *Obj);
 
 float SatVaporPressure(float Temperature);
+float SatVaporPressureDeriv(float Temperature);
 
 int ScanInts(FILE *FilePtr, int *X, int N);
 
@@ -336,6 +690,25 @@ void SkipLines(FILES *InFile, int NLines);
 
 void StoreChannelState(char *Path, DATE *Current, Channel *Head);
 
+unint CheckpointSum(unint Sum, const unint *Words, size_t NWords);
+
+unint CheckpointGeometry(MAPSIZE *Map);
+
+unint CheckpointNetwork(ChannelNetwork *StreamNet);
+
+size_t EncodeCheckpointDelta(const unint *Base, const unint *Data,
+			     size_t NWords, unsigned char *Out);
+
+int DecodeCheckpointDelta(const unsigned char *In, size_t NIn, unint *Data,
+			  size_t NWords);
+
+void StoreModelCheckpoint(char *Path, DATE *Current, MAPSIZE *Map,
+			  OPTIONSTRUCT *Options, PRECIPPIX **PrecipMap,
+			  SNOWPIX **SnowMap, VEGPIX **VegMap, LAYER *Veg,
+			  SOILPIX **SoilMap, LAYER *Soil,
+			  UNITHYDRINFO *HydrographInfo, float *Hydrograph,
+			  ChannelNetwork *StreamNet);
+
 void StoreModelState(char *Path, DATE *Current, MAPSIZE *Map,
 		     OPTIONSTRUCT *Options, TOPOPIX **TopoMap, PRECIPPIX **PrecipMap, 
              SNOWPIX **SnowMap, MET_MAP_PIX **MetMap, VEGPIX **VegMap, 
@@ -346,6 +719,8 @@ float viscosity(float Tair, float Rh);
 
 /* functions for John's RBM model */
 int channel_save_outflow_text_cplmt(TIMESTRUCT *Time, char *tstring, Channel *net, CHANNEL *netfile, int flag);
+int channel_save_outflow_bin_cplmt(TIMESTRUCT *Time, char *tstring, 
+				   Channel *net, CHANNEL *netfile, int flag);
 void CalcCanopyShading (TIMESTRUCT *Time, Channel *Channel, SOLARGEOMETRY *SolarGeo);
 
 float CalcShadeDensity(int ShadeCase, float HDEM, float WStream, float SunAzimuth,
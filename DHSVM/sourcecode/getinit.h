@@ -36,11 +36,25 @@ typedef struct _INTINIENTRY {
   long Default;
 } INTINIENTRY;
 
+typedef struct _INITKEY {
+  unsigned long Hash;
+  char *Section;		/* owned by the entry with Key == NULL */
+  char *Key;			/* NULL for the entry that marks a section */
+  char *Value;
+} INITKEY;
+
+typedef struct _INITINDEX {
+  unsigned long Size;		/* number of slots, a power of 2 */
+  INITKEY *Slot;		/* Slot[i].Section == NULL if empty */
+} INITINDEX;
+
 typedef struct _INPUTSTRUCT *LISTPTR;
 
 typedef struct _INPUTSTRUCT {
   char Str[BUFSIZE + 1];
   LISTPTR Next;
+  INITINDEX *Index;		/* (section, key) index of the list, only set
+				   in the first node by ReadInitFile() */
 } INPUTSTRUCT;
 
 typedef struct _DBLINIENTRY {
@@ -66,6 +80,8 @@ int CopyUChar(unsigned char *Value, char *Str, const int NValues);
 
 int CountLines(FILE * InFile);
 
+INITINDEX *BuildInitIndex(LISTPTR Input);
+
 LISTPTR CreateNode(void);
 
 void DeleteList(LISTPTR StartNode);
@@ -80,6 +96,8 @@ unsigned long GetInitString(const char *Section, const char *Key,
 			    const char *Default, char *ReturnBuffer,
 			    unsigned long BufferSize, LISTPTR Input);
 
+void FreeInitIndex(INITINDEX *Index);
+
 int IsEmptyStr(char *Str);
 
 unsigned char IsKeyEntryPair(char *Buffer);
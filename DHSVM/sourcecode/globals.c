@@ -7,6 +7,8 @@
  * E-MAIL:       nijssen@u.washington.edu
  * ORIG-DATE:    29-May-97 at 20:27:40
  * $Id: globals.c,v 1.4 2003/07/01 21:26:30 olivier Exp $
+ * COMMENTS:     The constants are set while the model is initialized, before
+ *               any threads are started, and are only read after that
  */
 
 float LAI_SNOW_MULTIPLIER;	    /* multiplier to calculate the amount of 
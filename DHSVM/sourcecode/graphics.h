@@ -0,0 +1,71 @@
+/*
+ * SUMMARY:      graphics.h - header file for the graphics of DHSVM
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Frames of the graphics (NUMBER OF GRAPHICS) that are drawn
+ *               to the X11 display or written as PNG images, see Draw.c and
+ *               Graphics.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef GRAPHICS_H
+#define GRAPHICS_H
+
+#include "settings.h"
+#include "data.h"
+#include "Calendar.h"
+
+/* One snapshot of all the graphics.  The panels are the basin maps
+   downsampled to the resolution they are shown at, which is all the
+   renderer needs, so a frame can be drawn while the model goes on */
+typedef struct {
+  DATE Day;			/* date of the time step */
+  int NGraphics;		/* number of panels, 0 draws the date only */
+  int MapNY;			/* rows of the basin grid */
+  int MapNX;			/* columns of the basin grid */
+  int Step;			/* grid cells per panel value in each
+				   direction */
+  int NY;			/* rows of each panel */
+  int NX;			/* columns of each panel */
+  int *MapNumber;		/* graphic ID of each panel */
+  char **Title;			/* title of each panel */
+  int *Length;			/* number of title characters drawn */
+  float *Min;			/* smallest value of each panel */
+  float *Max;			/* largest value of each panel */
+  float *Values;		/* NGraphics panels of NY x NX values,
+				   -9999 is drawn white */
+} GRAPHICSFRAME;
+
+void InitGraphics(int argc, char **argv, MAPSIZE *Map, int NGraphics,
+		  DUMPSTRUCT *Dump, MET_MAP_PIX ***MetMap);
+void UpdateGraphics(DATE *Day, int DayStep, MAPSIZE *Map, int NGraphics,
+		    int *which_graphics, VEGTABLE *VType, SOILTABLE *SType,
+		    SNOWPIX **SnowMap, SOILPIX **SoilMap, VEGPIX **VegMap,
+		    TOPOPIX **TopoMap, PRECIPPIX **PrecipMap, float **PrismMap,
+		    STATICMAP *SkyViewMap, unsigned char ***ShadowMap,
+		    EVAPPIX **EvapMap, PIXRAD **RadMap, MET_MAP_PIX **MetMap,
+		    OPTIONSTRUCT *Options);
+void CloseGraphics(void);
+void GraphicsPalette(int Index, unsigned short *Red, unsigned short *Green,
+		     unsigned short *Blue);
+int GraphicsColor(float Value, float Min, float Scale);
+
+int FillGraphic(int MapNumber, int DayStep, MAPSIZE *Map, VEGTABLE *VType,
+		SOILTABLE *SType, SNOWPIX **SnowMap, SOILPIX **SoilMap,
+		VEGPIX **VegMap, TOPOPIX **TopoMap, PRECIPPIX **PrecipMap,
+		float **PrismMap, STATICMAP *SkyViewMap,
+		unsigned char ***ShadowMap, EVAPPIX **EvapMap, PIXRAD **RadMap,
+		MET_MAP_PIX **MetMap, OPTIONSTRUCT *Options, float **Field,
+		float *Min, float *Max, char **Title, int *Length);
+void SampleGraphic(int MapNumber, MAPSIZE *Map, TOPOPIX **TopoMap,
+		   float **Field, int Step, int NY, int NX, float *Panel);
+int GraphicsShown(void);
+void DrawFrame(GRAPHICSFRAME *Frame);
+int InitXGraphics(int argc, char **argv, int ny, int nx, int nd);
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * SUMMARY:      inittasks.h - header file for the initialization tasks
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Stages of the initialization that run next to the main
+ *               thread with OPTIONS PARALLEL INITIALIZATION, see InitTasks.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef INITTASKS_H
+#define INITTASKS_H
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+typedef struct {
+  const char *Name;
+  void (*Run)(void *);		/* the stage */
+  void *Arg;
+  int Concurrent;		/* TRUE while it runs in a thread of its own */
+  double Wall;			/* run time of the stage (s) */
+#ifdef HAVE_PTHREAD
+  pthread_t Thread;
+#endif
+} INITTASK;
+
+void StartInitTask(INITTASK *Task, const char *Name, void (*Run)(void *),
+		   void *Arg, int Concurrent);
+void WaitInitTask(INITTASK *Task);
+
+#endif
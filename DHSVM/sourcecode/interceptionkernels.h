@@ -0,0 +1,70 @@
+/*
+ * SUMMARY:      interceptionkernels.h - Vector loops of InterceptionBatch.c
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The rain interception of an interception batch, as loops
+ *               over the arrays of its cells
+ * DESCRIP-END.
+ * FUNCTIONS:    InterceptionFields()
+ * COMMENTS:     Included by InterceptionBatch.c once for each SIMD level,
+ *               see cpudispatch.h, so there is no include guard
+ */
+
+/*****************************************************************************
+  Function name: InterceptionFields()
+
+  Purpose      : InterceptionStorage() for the cells of the batch
+
+  Comments     : The layers below NActual of a cell intercept nothing, so
+                 the rain and the storage of those lanes do not change
+*****************************************************************************/
+static void SIMD_NAME(InterceptionFields)(INTBATCH *Batch, float Dt)
+{
+  unsigned char *NActual = Batch->NActual;
+  unsigned char *Under = Batch->UnderStory;
+  double *LD_MomentSq = Batch->LD_MomentSq;
+  float *Rain = FIELD(Batch, IF_RAIN);
+  float *MSRain = FIELD(Batch, IF_MSRAIN);
+  float *MomentSq = FIELD(Batch, IF_MOMENTSQ);
+  float *Fract0 = FIELD(Batch, IF_FRACT);
+  float *MaxInt;
+  float *Fract;
+  float *Int;
+  float Available;		/* Available storage */
+  float Intercepted;		/* Amount of water intercepted during this
+				   timestep */
+  double Moment;
+  int N = Batch->N;
+  int i;
+  int n;
+
+  /* The precipitation is multiplied by the fractional coverage, since if
+     the vegetation covers only 10% of the grid cell, only 10% can be
+     intercepted as a maximum */
+  for (i = 0; i < INT_LAYERS; i++) {
+    MaxInt = FIELD(Batch, IF_MAXINT + i);
+    Fract = FIELD(Batch, IF_FRACT + i);
+    Int = FIELD(Batch, IF_INT + i);
+    SIMD_INDEPENDENT
+    for (n = 0; n < N; n++) {
+      Available = MaxInt[n] - Int[n];
+      Intercepted = (Available > Rain[n] * Fract[n]) ?
+	Rain[n] * Fract[n] : Available;
+      Intercepted = (i < NActual[n]) ? Intercepted : 0.0f;
+      Rain[n] -= Intercepted;
+      Int[n] += Intercepted;
+    }
+  }
+
+  /* Find momentum squared of rainfall.  With an understory all momentum
+     is associated with leaf drip, without part of the rainfall reaches the
+     ground as direct throughfall, eq. 2, Wicks and Bathurst (1996) */
+  SIMD_INDEPENDENT
+  for (n = 0; n < N; n++) {
+    Moment = LD_MomentSq[n] * Rain[n] / Dt;
+    MomentSq[n] = Under[n] ? Moment : Moment + (1 - Fract0[n]) * MSRain[n];
+  }
+}
@@ -0,0 +1,40 @@
+/*
+ * SUMMARY:      iobench.h - header file for the I/O benchmark
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Classes of the reads and writes of the time loop that are
+ *               timed by "DHSVM --io-bench", see IOBench.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:     The IOBENCH_ macros do nothing unless the benchmark runs
+ */
+
+#ifndef IOBENCH_H
+#define IOBENCH_H
+
+/* classes of the reads and writes, in the order of the report */
+#define IO_FORCING    0		/* InitNewMonth(), InitNewStep() */
+#define IO_AGGREGATE  1		/* Aggregated.Values */
+#define IO_PIXELS     2		/* pixel dumps */
+#define IO_STATES     3		/* model state dumps */
+#define IO_MAPS       4		/* map dumps */
+#define IO_CHANNEL    5		/* channel and road outputs */
+#define NIOCLASSES    6
+
+extern int IOBenchOn;		/* TRUE while "DHSVM --io-bench" runs */
+
+void InitIOBench(void);
+void IOBenchBegin(int Class);
+void IOBenchEnd(int Class);
+void IOBenchReport(const char *ConfigFile, int NSteps, double Wall);
+int ProcessIO(double *Read, double *Written);
+
+#define IOBENCH_BEGIN(Class) \
+  do { if (IOBenchOn) IOBenchBegin(Class); } while (0)
+#define IOBENCH_END(Class) \
+  do { if (IOBenchOn) IOBenchEnd(Class); } while (0)
+
+#endif
@@ -22,7 +22,11 @@ typedef struct {
 } FLOATTABLE;
 
 float FloatLookup(float x, FLOATTABLE * Table);
+float FloatInterpolate(float x, FLOATTABLE * Table);
+void InitInterpTable(unsigned long Size, float Offset, float Delta,
+		     FLOATTABLE * Table);
 void InitFloatTable(unsigned long Size, float Offset, float Delta,
 		    float (*Function) (float), FLOATTABLE * Table);
+void ReportLookupError(const char *Routine, float x);
 
 #endif
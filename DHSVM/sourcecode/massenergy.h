@@ -19,12 +19,41 @@
 #include "data.h"
 #include <stdarg.h>
 
+/* parameters of SurfaceEnergyBalanceParams(), see SurfaceEnergyBalance() */
+typedef struct {
+  int Dt;			/* Model time step (seconds) */
+  float Ra;			/* Aerodynamic resistance (s/m) */
+  float Z;			/* Reference height (m) */
+  float Displacement;		/* Displacement height (m) */
+  double LogZ;			/* log((Z - Displacement)/Z0), with Z0 the
+				   surface roughness (m) */
+  float Wind;			/* Wind speed (m/s) */
+  float ShortRad;		/* Net incident shortwave radiation (W/m2) */
+  float LongRadIn;		/* Incoming longwave radiation (W/m2) */
+  float AirDens;		/* Density of air (kg/m3) */
+  float Lv;			/* Latent heat of vaporization (J/kg3) */
+  float ETot;			/* Total evapotranspiration (m) */
+  float Kt;			/* Effective soil thermal conductivity (W/(m*K)) */
+  float HeatCapacity;		/* Heat capacity of the upper soil layer,
+				   with its water or ice (J/(m3*C)) */
+  float Depth;			/* Depth of soil heat profile (m) */
+  float Tair;			/* Air temperature (C) */
+  float TSoilLower;		/* Soil temperature at Depth (C) */
+  float OldTSurf;		/* Surface temperature during previous time step */
+  float MeltEnergy;		/* Energy used to melt/refreeze snow pack (W/m2) */
+} SURFEBPARAMS;
+
 void AggregateRadiation(int MaxVegLayers, int NVegL, PIXRAD * Rad,
 			PIXRAD * TotalRad);
 
-float CanopyResistance(float LAI, float RsMin, float RsMax, float Rpc,
-		       float VpdThres, float MoistThres, float WP,
-		       float TSoil, float SoilMoisture, float Vpd, float Rp);
+void AddRadiation(PIXRAD *Rad, PIXRAD *TotalRad);
+
+int CanopyFactors(VEGTABLE *VType, int Layer, float Vpd, float Rp,
+		  float *VpdFactor, float *RpFactor);
+
+float CanopyResistance(float VpdFactor, float RpFactor, float RsMin,
+		       float LAI, float MoistThres, float WP, float TSoil,
+		       float SoilMoisture);
 
 float Desorption(int Dt, float Moisture, float Porosity, float Ks, 
 			   float Press, float m);
@@ -34,6 +63,8 @@ void EvapoTranspiration(int Layer, int impvRad, int Dt, PIXMET *Met,
 			   float MoistureFlux, SOILPIX * LocalSoil, float *Int,
 			   EVAPPIX * LocalEvap, float *Adjust, float Ra);
 
+void NoTranspiration(int Layer, int NSoilLayers, EVAPPIX *LocalEvap);
+
 void InitLocalRad(int HeatFluxOption, float Rs, float Ld, float Tair, 
                float Tcanopy, float Tsoil, VEGTABLE *VType, 
                SNOWPIX *LocalSnow, PIXRAD *LocalRad);
@@ -41,7 +72,13 @@ void InitLocalRad(int HeatFluxOption, float Rs, float Ld, float Tair,
 void InterceptionStorage(int NMax, int NAct, float *MaxInt, float *Fract,
 			   float *Int, float *Precip, float *MomentSq, float *Height, 
 			   unsigned char Understory, float Dt,
-			   float MS_Rainfall, float LD_FallVelocity);
+			   float MS_Rainfall, double LD_MomentSq);
+
+void InitLeafDrip(VEGTABLE *VType);
+
+float RainfallMomentum(float RainFall, int Dt, float *Dm);
+
+int SnowOnCanopy(VEGTABLE *VType, PRECIPPIX *LocalPrecip);
 
 void LongwaveBalance(OPTIONSTRUCT *Options, unsigned char OverStory, 
 			   float F, float Vf, float Ld, float Tcanopy, float Tsurf, 
@@ -61,7 +98,7 @@ void SensibleHeatFlux(int y, int x, int Dt, float Ra, float ZRef,
 		      float Displacement, float Z0, PIXMET *LocalMet,
 		      float NetShort, float LongIn, float ETot, int NSoilLayers, 
 		      float *SoilDepth, SOILTABLE *SoilType, float MeltEnergy, 
-              SOILPIX *LocalSoil);
+              SOILPIX *LocalSoil, int Solver);
 
 void ShortwaveBalance(OPTIONSTRUCT *Options, unsigned char OverStory, 
 			  float F, float Rs, float Rsb, float Rsd, float Tau, 
@@ -74,8 +111,13 @@ float SoilEvaporation(int Dt, float Temp, float Slope, float Gamma,
               float Adjust);
 
 float StabilityCorrection(float Z, float d, float Tsurf, float Tair,
-			  float Wind, float Z0);
+			  float Wind, double LogZ);
+
+float StabilityCorrectionDeriv(float Z, float d, float Tsurf, float Tair,
+			       float Wind, double LogZ, float *dCorrection);
 
 float SurfaceEnergyBalance(float TSurf, va_list ap);
 
+float SurfaceEnergyBalanceParams(float TSurf, void *Params, float *Derivative);
+
 #endif
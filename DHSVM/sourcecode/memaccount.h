@@ -0,0 +1,51 @@
+/*
+ * SUMMARY:      memaccount.h - header file for the memory accounting
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Allocations tagged with the subsystem that owns them, see
+ *               MemAccount.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef MEMACCOUNT_H
+#define MEMACCOUNT_H
+
+#include <stddef.h>
+
+/* subsystems, in the order of the report */
+#define MEM_TERRAIN    0	/* topography, active cells */
+#define MEM_SOIL       1	/* soil map and layers */
+#define MEM_VEG        2	/* vegetation map */
+#define MEM_SNOW       3	/* snow map */
+#define MEM_PRECIP     4	/* precipitation map and interception */
+#define MEM_EVAP       5	/* evapotranspiration map */
+#define MEM_RADIATION  6	/* radiation map */
+#define MEM_SHADOW     7	/* shadow and sky view maps */
+#define MEM_MET        8	/* interpolation weights, met fields, wind,
+				   PRISM, radar and lapse maps */
+#define MEM_MM5        9	/* MM5 input maps */
+#define MEM_NETWORK   10	/* road/channel cut geometry of the cells */
+#define MEM_CHANNEL   11	/* channel maps and accumulators */
+#define MEM_ROUTING   12	/* subsurface and surface routing work */
+#define MEM_HRU       13	/* hydrologic response units */
+#define MEM_OUTPUT    14	/* map and pixel dumps */
+#define NMEMTAGS      15
+
+void InitMemoryLimit(float LimitMB);
+void *TaggedCalloc(size_t NElements, size_t Size, int Tag);
+void *TaggedMalloc(size_t Size, int Tag);
+void *ArenaCalloc(size_t NElements, size_t Size, int Tag);
+void *TaggedRealloc(void *Ptr, size_t Size, int Tag);
+void TaggedFree(void *Ptr);
+void FreeArenas(void);
+void ReportMemory(const char *When);
+double MemoryInUse(int Tag);
+const char *MemoryTagName(int Tag);
+double MemoryLimitBytes(void);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * SUMMARY:      messagelog.h - header file for the rate-limited messages
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Messages of the time loop counted per site, see MessageLog.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef MESSAGELOG_H
+#define MESSAGELOG_H
+
+/* severity of a message, OPTIONS MESSAGE LEVEL prints up to this level */
+#define MSG_ERROR    0
+#define MSG_WARNING  1
+#define MSG_NOTE     2
+#define MSG_DEBUG    3
+#define NMSGLEVELS   4
+
+/* a place in the code that prints a message */
+typedef struct _MSGSITE_ {
+  int Level;			/* MSG_ERROR ... MSG_DEBUG */
+  const char *File;		/* source file of the site */
+  int Line;			/* line of the site */
+  const char *Format;		/* format of the message */
+  long Count;			/* messages of the run */
+  int Registered;		/* TRUE once in the list of sites */
+  struct _MSGSITE_ *Next;
+} MSGSITE;
+
+/* prints a message of Level with printf() arguments, as long as its site
+   has not printed MESSAGE LIMIT of them, and counts it for the summary */
+#define LogMessage(Level, ...)						\
+  do {									\
+    static MSGSITE Site_ = {(Level), __FILE__, __LINE__};		\
+    LogSite(&Site_, __VA_ARGS__);					\
+  } while (0)
+
+void InitMessageLog(int Level, int Limit);
+void LogSite(MSGSITE *Site, const char *Format, ...);
+void ReportMessages(void);
+
+#endif
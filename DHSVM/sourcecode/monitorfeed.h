@@ -0,0 +1,80 @@
+/*
+ * SUMMARY:      monitorfeed.h - header file for the live monitor feed
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Layout of the ring buffer of OPTIONS MONITOR FEED, see
+ *               MonitorFeed.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:     The layout is in native byte order.  It is copied in
+ *               program/monitor_feed.c, which has to be changed with it
+ */
+
+#ifndef MONITORFEED_H
+#define MONITORFEED_H
+
+#include "data.h"
+
+#define MONITOR_NAMELEN 16	/* characters of a name, with the '\0' */
+#define MONITOR_DATELEN 24	/* characters of the date of a slot */
+
+/* the basin totals of a slot, see MonitorFeed.c */
+enum MONITORTOTAL {
+  mon_precip, mon_etot, mon_swq, mon_melt, mon_soilwater, mon_canopywater,
+  mon_tabledepth, mon_satextent, mon_runoff, mon_channelint, mon_iexcess,
+  mon_satflow, mon_netrad, MONITOR_TOTALS
+};
+
+/* the coarse maps of a slot */
+enum MONITORMAP {
+  mon_map_swq, mon_map_tabledepth, mon_map_etot, mon_map_precip,
+  MONITOR_MAPS
+};
+
+/* start of the ring buffer, followed by the NSegments ids of the segments
+   at sizeof(MONITORHEADER) and the slots at SlotStart */
+typedef struct {
+  char Magic[sizeof(MONITOR_MAGIC) - 1];
+  int Version;
+  int NSlots;			/* slots of the ring */
+  int NTotals;			/* MONITOR_TOTALS */
+  int NSegments;		/* recorded stream segments */
+  int NMaps;			/* coarse maps, 0 without a MAP STRIDE */
+  int MapNX;			/* columns and rows of the coarse maps */
+  int MapNY;
+  int Stride;			/* cells of the side of a block */
+  int Dt;			/* model time step (s) */
+  float Fill;			/* value of a block outside the basin */
+  unsigned long long SlotBytes;	/* bytes of a slot */
+  unsigned long long SlotStart;	/* offset of the first slot */
+  unsigned long long Latest;	/* sequence number of the newest complete
+				   slot, 0 before the first */
+  char TotalNames[MONITOR_TOTALS][MONITOR_NAMELEN];
+  char MapNames[MONITOR_MAPS][MONITOR_NAMELEN];
+} MONITORHEADER;
+
+/* a slot, followed by NTotals totals, NSegments flows and NMaps maps of
+   MapNY rows of MapNX floats.  Sequence number k is in slot (k - 1) %
+   NSlots, whose Seq is 2 k - 1 while it is written and 2 k after */
+typedef struct {
+  unsigned long long Seq;
+  int Step;			/* time steps done */
+  int Full;			/* FALSE if only the fluxes of the totals
+				   were aggregated, see AGGREGATED */
+  char Date[MONITOR_DATELEN];	/* of the step in the output files,
+				   SPrintDate() */
+} MONITORSLOT;
+
+void InitMonitorFeed(OPTIONSTRUCT *Options, MAPSIZE *Map, TOPOPIX **TopoMap,
+		     int Dt, Channel *Streams);
+void PublishMonitorFeed(int Step, DATE *Current, MAPSIZE *Map,
+			TOPOPIX **TopoMap, SNOWPIX **SnowMap,
+			SOILPIX **SoilMap, EVAPPIX **EvapMap,
+			PRECIPPIX **PrecipMap, AGGREGATED *Total);
+void ForkMonitorFeed(int Branch);
+void CloseMonitorFeed(void);
+
+#endif
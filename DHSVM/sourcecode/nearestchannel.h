@@ -0,0 +1,32 @@
+/*
+ * SUMMARY:      nearestchannel.h - header file for the nearest channel search
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The channel cell each cell of the basin drains its
+ *               impervious runoff to, for DHSVM (InitNetwork()) and the
+ *               find_nearest_channel programs, see NearestChannel.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef NEARESTCHANNEL_H
+#define NEARESTCHANNEL_H
+
+#define NEAREST_FLOW      1	/* first channel down the flow paths */
+#define NEAREST_DISTANCE  2	/* nearest channel in a straight line */
+
+/* bit k of the flow directions of a cell is set if it drains to the
+   neighbor (y + NearestDY[k], x + NearestDX[k]), clockwise from east */
+#define NEAREST_NDIRS     8
+extern const int NearestDX[NEAREST_NDIRS];
+extern const int NearestDY[NEAREST_NDIRS];
+
+int NearestChannel(int NY, int NX, int Method, const unsigned char *InBasin,
+		   const unsigned char *Channel, const unsigned char *Down,
+		   int *DrainsY, int *DrainsX);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * SUMMARY:      outofcore.h - header file for the out-of-core data
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Data kept in memory mapped scratch files, see OutOfCore.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef OUTOFCORE_H
+#define OUTOFCORE_H
+
+#include <stddef.h>
+
+void *MapScratch(char *Dir, const char *Name, size_t Size);
+void UnmapScratch(void *Data, size_t Size);
+void AdviseScratch(void *Data, size_t Size, int Need);
+
+#endif
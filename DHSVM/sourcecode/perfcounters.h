@@ -0,0 +1,36 @@
+/*
+ * SUMMARY:      perfcounters.h - header file for the hardware event counters
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Hardware events counted in the profiled phases with
+ *               OPTIONS PERF COUNTERS = TRUE, see PerfCounters.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:     Only with HAVE_PERF_EVENT (Linux)
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include "data.h"
+
+/* events, in the order of the counts */
+#define PERF_CYCLES        0
+#define PERF_INSTRUCTIONS  1
+#define PERF_LLC_REFS      2	/* last level cache references */
+#define PERF_LLC_MISSES    3	/* last level cache misses */
+#define PERF_SCALAR_FP     4	/* scalar floating point instructions */
+#define PERF_VECTOR_FP     5	/* packed floating point instructions */
+#define NPERFEVENTS        6
+
+#define CACHE_LINE_BYTES   64	/* bytes moved by a cache miss */
+
+int InitPerfCounters(OPTIONSTRUCT *Options);
+int PerfEventCounted(int Event);
+void ReadPerfCounters(double *Counts);
+void ClosePerfCounters(void);
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * SUMMARY:      profile.h - header file for the time loop profiler
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Phases of the time loop that are timed with OPTIONS
+ *               PROFILE = TRUE, see Profile.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:     Without HAVE_PROFILE the PROFILE_ macros expand to nothing
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "data.h"
+
+/* phases of a time step, in the order of the report */
+#define PHASE_NEWMONTH     0	/* InitNewMonth() */
+#define PHASE_NEWSTEP      1	/* InitNewStep() */
+#define PHASE_PIXELS       2	/* MakeMetFields() and the pixel loop */
+#define PHASE_SUBSURFACE   3	/* RouteSubSurface() */
+#define PHASE_CHANNEL      4	/* RouteChannel() */
+#define PHASE_SURFACE      5	/* RouteSurface() */
+#define PHASE_DRAW         6	/* draw() */
+#define PHASE_AGGREGATE    7	/* Aggregate() */
+#define PHASE_MASSBALANCE  8	/* MassBalance() */
+#define PHASE_DUMP         9	/* ExecDump() */
+#define NPHASES           10
+
+double WallClock(void);
+double CpuClock(void);
+
+#ifdef HAVE_PROFILE
+
+extern int ProfileOn;		/* TRUE with OPTIONS PROFILE = TRUE, a
+				   TRACE FILE or a TELEMETRY FILE */
+
+void InitProfile(OPTIONSTRUCT *Options, MAPSIZE *Map, int NSteps);
+void ProfileBegin(int Phase);
+void ProfileEnd(int Phase);
+void ProfileBeginStep(void);
+void ProfileEndStep(void);
+void ProfileReport(int Dt);
+void ProfileTimes(double *PhaseTimes, double *StepsTime);
+const char *ProfilePhaseName(int Phase);
+void StartupStage(const char *Name);
+void StartupTask(const char *Name, double Wall, int Concurrent);
+
+#define PROFILE_BEGIN(Phase) \
+  do { if (ProfileOn) ProfileBegin(Phase); } while (0)
+#define PROFILE_END(Phase) \
+  do { if (ProfileOn) ProfileEnd(Phase); } while (0)
+#define PROFILE_BEGIN_STEP() \
+  do { if (ProfileOn) ProfileBeginStep(); } while (0)
+#define PROFILE_END_STEP() \
+  do { if (ProfileOn) ProfileEndStep(); } while (0)
+
+#else
+
+#define InitProfile(Options, Map, NSteps) \
+  do { if ((Options)->Profile || (Options)->PerfCounters || \
+	   (Options)->TraceFile[0] != '\0') \
+    printf("WARNING: PROFILE, PERF COUNTERS and the phases of TRACE FILE " \
+	   "need a build with HAVE_PROFILE\n"); } while (0)
+#define ProfileReport(Dt)
+#define StartupStage(Name)
+#define StartupTask(Name, Wall, Concurrent)
+#define PROFILE_BEGIN(Phase)
+#define PROFILE_END(Phase)
+#define PROFILE_BEGIN_STEP()
+#define PROFILE_END_STEP()
+
+#endif
+
+#endif
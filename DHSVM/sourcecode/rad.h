@@ -18,6 +18,8 @@
 
 #define ALBEDO  0.15		/* WORK IN PROGRESS, See InitNewStep() */
 
+void InitSeparationTable(int Size);
+
 void SeparateRadiation(float TotalSolar, float ClearIndex,
 		       float *Beam, float *Diffuse);
 
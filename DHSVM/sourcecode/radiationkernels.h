@@ -0,0 +1,145 @@
+/*
+ * SUMMARY:      radiationkernels.h - Vector loops of RadiationBatch.c
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The short- and longwave balances of a radiation batch, as
+ *               loops over the arrays of its cells
+ * DESCRIP-END.
+ * FUNCTIONS:    ShortwaveFields()
+ *               LongwaveFields()
+ * COMMENTS:     Included by RadiationBatch.c once for each SIMD level, see
+ *               cpudispatch.h, so there is no include guard
+ */
+
+/*****************************************************************************
+  Function name: ShortwaveFields()
+
+  Purpose      : ShortwaveBalance() for the cells of the batch
+*****************************************************************************/
+static void SIMD_NAME(ShortwaveFields)(RADBATCH *Batch, OPTIONSTRUCT *Options)
+{
+  unsigned char *Over = Batch->OverStory;
+  float *F = FIELD(Batch, RF_F);
+  float *Albedo0 = FIELD(Batch, RF_ALBEDO0);
+  float *Albedo1 = FIELD(Batch, RF_ALBEDO1);
+  float *Rs = FIELD(Batch, RF_RS);
+  float *Rsb = FIELD(Batch, RF_RSB);
+  float *Rsd = FIELD(Batch, RF_RSD);
+  float *Tau = FIELD(Batch, RF_TAU);
+  float *NetShort0 = FIELD(Batch, RF_NETSHORT0);
+  float *NetShort1 = FIELD(Batch, RF_NETSHORT1);
+  float *PixelNetShort = FIELD(Batch, RF_PIXELNETSHORT);
+  float *RBMNetShort = FIELD(Batch, RF_RBMNETSHORT);
+  float *PixelBeam = FIELD(Batch, RF_PIXELBEAM);
+  float *PixelDiffuse = FIELD(Batch, RF_PIXELDIFFUSE);
+  float Bare;
+  int N = Batch->N;
+  int n;
+
+  /* Because F was factored in during the tau calculations of the improved
+     radiation scheme, F is not used repeatedly there */
+  if (Options->ImprovRadiation == TRUE) {
+    SIMD_INDEPENDENT
+    for (n = 0; n < N; n++) {
+      Bare = Rs[n] * (1 - Albedo0[n]);
+      NetShort0[n] = Over[n] ?
+	Rs[n] * (1 - Albedo0[n]) * (1 - Tau[n] * (1 - Albedo1[n])) : Bare;
+      NetShort1[n] = Over[n] ? Rs[n] * (1 - Albedo1[n]) * Tau[n] : 0.;
+      PixelNetShort[n] = Over[n] ?
+	Rs[n] * (1 - Albedo0[n] - Albedo0[n] * (1 - Albedo1[n])) : Bare;
+    }
+  }
+  else {
+    SIMD_INDEPENDENT
+    for (n = 0; n < N; n++) {
+      Bare = Rs[n] * (1 - Albedo0[n]);
+      NetShort0[n] = Over[n] ?
+	Rs[n] * F[n] * ((1 - Albedo0[n]) - Tau[n] * (1 - Albedo1[n])) : Bare;
+      NetShort1[n] = Over[n] ?
+	Rs[n] * (1 - Albedo1[n]) * ((1 - F[n]) + (Tau[n] * F[n])) : 0.;
+      PixelNetShort[n] = Over[n] ?
+	Rs[n] * (1 - Albedo0[n] * F[n] - Albedo1[n] * (1 - F[n])) : Bare;
+    }
+  }
+
+  /* the shortwave reaching the water surface.  With the canopy shading
+     only the riparian vegetation shades the channel */
+  if (Options->StreamTemp && !Options->CanopyShading) {
+    SIMD_INDEPENDENT
+    for (n = 0; n < N; n++) {
+      RBMNetShort[n] = Over[n] ? Rs[n] * (1 - F[n]) + Rs[n] * Tau[n] * F[n] :
+	Rs[n];
+      PixelBeam[n] = Over[n] ? Rsb[n] * (1 - F[n]) + Rsb[n] * Tau[n] * F[n] :
+	Rsb[n];
+      PixelDiffuse[n] = Over[n] ? RBMNetShort[n] - PixelBeam[n] : Rsd[n];
+    }
+  }
+  else if (Options->StreamTemp) {
+    SIMD_INDEPENDENT
+    for (n = 0; n < N; n++) {
+      RBMNetShort[n] = Rs[n];
+      PixelBeam[n] = Rsb[n];
+      PixelDiffuse[n] = Rsd[n];
+    }
+  }
+}
+
+/*****************************************************************************
+  Function name: LongwaveFields()
+
+  Purpose      : LongwaveBalance() for the cells of the batch
+*****************************************************************************/
+static void SIMD_NAME(LongwaveFields)(RADBATCH *Batch, OPTIONSTRUCT *Options)
+{
+  unsigned char *Over = Batch->OverStory;
+  float *F = FIELD(Batch, RF_F);
+  float *Vf = FIELD(Batch, RF_VF);
+  float *Ld = FIELD(Batch, RF_LD);
+  float *Tcanopy = FIELD(Batch, RF_TCANOPY);
+  float *Tsurf = FIELD(Batch, RF_TSURF);
+  float *LongOut0 = FIELD(Batch, RF_LONGOUT0);
+  float *LongOut1 = FIELD(Batch, RF_LONGOUT1);
+  float *LongIn0 = FIELD(Batch, RF_LONGIN0);
+  float *LongIn1 = FIELD(Batch, RF_LONGIN1);
+  float *PixelLongOut = FIELD(Batch, RF_PIXELLONGOUT);
+  float *RBMNetLong = FIELD(Batch, RF_RBMNETLONG);
+  float *Cover;
+  float Canopy;
+  float Surface;
+  double Tmp;
+  int N = Batch->N;
+  int n;
+
+  /* emitted longwave of each layer */
+  SIMD_INDEPENDENT
+  for (n = 0; n < N; n++) {
+    Tmp = Tcanopy[n] + 273.15;
+    Canopy = STEFAN * (Tmp * Tmp * Tmp * Tmp);
+    Tmp = Tsurf[n] + 273.15;
+    Surface = STEFAN * (Tmp * Tmp * Tmp * Tmp);
+    LongOut0[n] = Over[n] ? Canopy : Surface;
+    LongOut1[n] = Over[n] ? Surface : 0.;
+  }
+
+  /* incoming longwave of each layer, with the canopy view factor Vf in
+     place of F in the improved radiation scheme (Thyer et al., 2004) */
+  Cover = (Options->ImprovRadiation == TRUE) ? Vf : F;
+  SIMD_INDEPENDENT
+  for (n = 0; n < N; n++) {
+    LongIn0[n] = Over[n] ? (Ld[n] + LongOut1[n]) * Cover[n] : Ld[n];
+    LongIn1[n] = Over[n] ?
+      Ld[n] * (1 - Cover[n]) + LongOut0[n] * Cover[n] : 0.;
+    PixelLongOut[n] = Over[n] ?
+      LongOut0[n] * F[n] + LongOut1[n] * (1 - F[n]) : LongOut0[n];
+  }
+
+  if (Options->StreamTemp) {
+    SIMD_INDEPENDENT
+    for (n = 0; n < N; n++)
+      RBMNetLong[n] = Over[n] ? Ld[n] * (1 - F[n]) + LongOut0[n] * F[n] :
+	Ld[n];
+  }
+}
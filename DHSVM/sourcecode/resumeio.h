@@ -0,0 +1,29 @@
+/*
+ * SUMMARY:      resumeio.h - header file for the resume checkpoint stream
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Compressed state of the resume checkpoint, see ResumeIO.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef RESUMEIO_H
+#define RESUMEIO_H
+
+#include <stdio.h>
+
+/* OPTIONS CHECKPOINT COMPRESSION */
+#define RESUME_RAW   0		/* the state as it is */
+#define RESUME_ZLIB  1		/* blocks of zlib streams */
+
+void OpenResumeStream(FILE *File, char *FileName, int Compression,
+		      int Level, int Shuffle, int Write);
+void WriteResumeStream(const void *Data, size_t Size);
+void ReadResumeStream(void *Data, size_t Size);
+void CloseResumeStream(void);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * SUMMARY:      rollover.h - header file for the output rollover
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Output files started again for each year or month, see
+ *               Rollover.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:     Needs Calendar.h and data.h
+ */
+
+#ifndef ROLLOVER_H
+#define ROLLOVER_H
+
+/* OPTIONS OUTPUT ROLLOVER */
+#define ROLLOVER_NONE   0
+#define ROLLOVER_YEAR   1
+#define ROLLOVER_MONTH  2
+
+/* OPTIONS OUTPUT ROLLOVER NAME, %N.%P%E gives Map.Swq.2003-01.bin */
+#define ROLLOVER_TEMPLATE "%N.%P%E"
+
+/* listing of the files of the periods in the output directory */
+#define ROLLOVER_INDEX "Output.Index"
+
+void InitRollover(int Period, char *Template, DATE *Start);
+void OpenRolloverIndex(char *Path);
+FILES *RolloverIndex(void);
+void GetRolloverDate(DATE *Date);
+void SetRolloverDate(DATE *Date);
+int RolloverDue(DATE *Current);
+int IsRolloverStep(DATE *Current);
+void RolloverName(char *FileName, char *BaseName);
+void OpenOutput(FILE **FilePtr, char *FileName, char *BaseName, char *Mode);
+void CreateOutputMap(MAPDUMP *DMap, MAPSIZE *Map, NCSTORAGE *Storage);
+
+#endif
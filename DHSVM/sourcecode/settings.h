@@ -25,6 +25,9 @@ typedef unsigned int unint;
 #define MAX(x,y) ((x) > (y) ? (x) : (y))
 #define MIN(x,y) ((x) < (y) ? (x) : (y))
 #define INBASIN(x) ((x) != OUTSIDEBASIN)
+
+/* Index in Map->ActiveCells of the i-th active cell in row-major order */
+#define ROWCELL(Map, i) ((Map)->RowOrder != NULL ? (Map)->RowOrder[(i)] : (i))
 #ifndef ABSVAL
 #define ABSVAL(x)  ( (x) < 0 ? -(x) : (x) )
 #endif
@@ -64,6 +67,10 @@ typedef unsigned int unint;
 #define NEAREST        2
 #define VARCRESS       3
 
+/* Options for the surface temperature solver */
+#define BRENT          1
+#define NEWTON         2
+
 /* Options for model extent */
 #define POINT 1
 #define BASIN 2
@@ -77,6 +84,97 @@ typedef unsigned int unint;
 #define STATIC 1
 #define DYNAMIC 2
 
+/* Options for the channel flow output */
+#define CHANNEL_TEXT   1
+#define CHANNEL_BINARY 2
+#define CHANNEL_NONE   3
+
+/* Objective functions of the fit to the observed flow (Objective.c) */
+#define OBJ_NSE  1
+#define OBJ_RMSE 2
+enum OBJSUM {
+  obj_n = 0, obj_obs, obj_sim, obj_obs2, obj_sim2, obj_obssim, obj_sse,
+  NOBJSUMS
+};
+
+/* Options for the pixel time series output */
+#define PIXEL_TEXT   1
+#define PIXEL_BINARY 2
+#define PIXEL_BIN_MAGIC   "DHSVMPIX"
+#define PIXEL_BIN_DATELEN 20
+#define PIXEL_OUTBUF      (1 << 20)	/* stdio buffer of Pixel.bin */
+
+/* Options for the stream temperature solver */
+#define STREAMTEMP_EXTERNAL 1
+#define STREAMTEMP_INTERNAL 2
+
+/* Options for the quiescent cell fast path of MassEnergyBalance() */
+#define QUIET_NONE     0
+#define QUIET_EXACT    1
+#define QUIET_RELAXED  2
+
+/* Terrain shading (SHADING MODE) */
+#define SHADING_MAPS     1
+#define SHADING_HORIZON  2
+
+/* Files of the map dumps (MAP FILE LAYOUT) */
+#define MAPFILES_SEPARATE  0
+#define MAPFILES_COMBINED  1
+
+/* Forcing between the station records (MET INTERPOLATION) */
+#define METINTERP_LINEAR  0
+#define METINTERP_CUBIC   1
+
+/* Order of the active cells (CELL ORDER) */
+#define CELLORDER_ROW     0
+#define CELLORDER_MORTON  1
+#define CELLORDER_TILES   2
+
+/* Structure classes of the cells of the pixel loop (CELL CLASS ORDER), the
+   bits of a class are the branches it takes in MassEnergyBalance() */
+#define STRUCTURE_SNOW        0x01
+#define STRUCTURE_OVERSTORY   0x02
+#define STRUCTURE_UNDERSTORY  0x04
+#define STRUCTURE_IMPERVIOUS  0x08
+#define STRUCTURE_CUT         0x10	/* road or channel cut */
+#define N_STRUCTURES          32
+
+/* Maps a map event replaces (MAP EVENT VARIABLE) */
+#define MAPEVENT_VEGETATION 0
+#define MAPEVENT_SOILDEPTH  1
+
+/* Temporal reducers of the map dumps (MAP REDUCER), the maps of the other
+   reducers are accumulated at each time step between the dumps */
+#define REDUCE_LAST    0
+#define REDUCE_MEAN    1
+#define REDUCE_MIN     2
+#define REDUCE_MAX     3
+#define REDUCE_SUM     4
+
+/* Diagnostics that are only computed when an output reads them (see
+   InitDiagnostics()) */
+#define DIAG_SUMPRECIP 0x01	/* accumulated precipitation (ID 206) */
+#define DIAG_METMAP    0x02	/* met fields of the graphics (MET_MAP_PIX) */
+
+/* Options for the model state files */
+#define STATE_MAPS       1
+#define STATE_CHECKPOINT 2
+
+/* Options for the thread pinning */
+#define PIN_NONE   0
+#define PIN_CLOSE  1
+#define PIN_SPREAD 2
+
+/* Options for the telemetry stream */
+#define TELEMETRY_JSON       1
+#define TELEMETRY_PROMETHEUS 2
+
+/* Options for the graphics (GRAPHICS MODE) */
+#define GRAPHICS_DIRECT 1	/* drawn to X11 by the model loop */
+#define GRAPHICS_THREAD 2	/* drawn to X11 by the renderer thread */
+#define GRAPHICS_IMAGE  3	/* written as PNG images by the renderer */
+#define GRAPHICS_IMAGE_SIZE 400	/* largest side of an image panel (pixels) */
+
 /* Options for canopy radiation attenuation */
 #define FIXED    1
 #define VARIABLE 2
@@ -104,6 +202,69 @@ typedef unsigned int unint;
 #define MAP_OUTPUT 1
 #define IMAGE_OUTPUT 2
 
+/* Types of scheduled dumps (DUMPEVENT) */
+#define STATE_EVENT 1
+#define MAP_EVENT   2
+
+/* Layout of the model state checkpoint (STATE FORMAT = CHECKPOINT).  The
+   file starts with CHECKPOINT_MAGIC, or CHECKPOINT_DELTA_MAGIC for a delta
+   against the base checkpoint at chk_baseyear ..., followed by NCHKHEADER
+   32-bit words.  Deltas are coded in blocks of CHECKPOINT_BLOCK words.
+   chk_channelvars is the number of values stored for each stream segment,
+   CHKCHANNEL_STORAGE or CHKCHANNEL_FLOWS */
+#define CHECKPOINT_MAGIC       "DHSVMCHK"
+#define CHECKPOINT_DELTA_MAGIC "DHSVMDLT"
+#define CHECKPOINT_VERSION     3
+#define CHECKPOINT_SEED        2166136261u
+#define CHECKPOINT_BLOCK       256
+#define CHKCHANNEL_STORAGE     1	/* storage */
+#define CHKCHANNEL_FLOWS       3	/* storage, inflow and outflow */
+enum CHKHEADER {
+  chk_version = 0, chk_ny, chk_nx, chk_nactive, chk_veglayers, chk_soillayers,
+  chk_nchannel, chk_nhydro, chk_year, chk_month, chk_day, chk_hour, chk_min,
+  chk_sec, chk_baseyear, chk_basemonth, chk_baseday, chk_basehour,
+  chk_basemin, chk_basesec, chk_basesum, chk_geomhash, chk_nethash,
+  chk_channelvars, chk_datasum, chk_headersum, NCHKHEADER
+};
+
+/* Resume checkpoint in the output directory, written every CHECKPOINT WALL
+   INTERVAL and when the run is stopped with SIGTERM or SIGUSR1, and read by
+   DHSVM --resume (see StoreResume() in dhsvm.c).  It holds the complete
+   model state at a step boundary in native byte order, so it is only read
+   by the same build on the same machine */
+#define RESUME_FILE    "Resume.chk"
+#define RESUME_MAGIC   "DHSVMRSM"
+#define RESUME_END     "DHSVMEND"
+#define RESUME_VERSION 4
+#define RESUME_SUFFIX  ".resume"	/* output kept aside while resuming */
+
+/* Segment of the STATIC DATA SHARE that the runs of a basin on one node map
+   read-only (see StaticShare.c).  It starts with STATIC_SHARE_MAGIC and is
+   followed by a table of entries and their data, at multiples of 
+   STATIC_SHARE_ALIGN bytes.  The entries of a month and of a wind map are
+   share_slices, share_shadow + Month - 1 and share_wind + map */
+#define STATIC_SHARE_MAGIC   "DHSVMSHR"
+#define STATIC_SHARE_VERSION 1
+#define STATIC_SHARE_ALIGN   64
+enum SHAREID {
+  share_skyview = 0, share_preciplapse, share_nweights, share_metstat,
+  share_metweight, share_slices, share_shadow = share_slices + 12,
+  share_wind = share_shadow + 12
+};
+
+/* Ring buffer of the MONITOR FEED that live viewers map read-only (see
+   MonitorFeed.c and monitorfeed.h).  It starts with MONITOR_MAGIC, and its
+   slots are at multiples of MONITOR_ALIGN bytes */
+#define MONITOR_MAGIC   "DHSVMMON"
+#define MONITOR_VERSION 1
+#define MONITOR_ALIGN   64
+
+/* Cells of the pieces of the pixel loop whose soil columns, radiation
+   balances or rain interception are done together with SOIL COLUMN BATCH,
+   RADIATION BATCH or INTERCEPTION BATCH (see SoilColumnBatch.c,
+   RadiationBatch.c and InterceptionBatch.c) */
+#define SOIL_BATCH_CELLS 256
+
 enum KEYS {
 /* Options *//* list order must match order in InitConstants.c */
   format = 0, extent, gradient, flow_routing, sensible_heat_flux,
@@ -112,6 +273,36 @@ enum KEYS {
   temp_lapse, precip_lapse, cressman_radius, cressman_stations, prism_data_path, 
   prism_data_ext, shading_data_path, shading_data_ext, 
   skyview_data_path, stream_temp, canopy_shading, improv_radiation,
+  number_of_threads, parallel_routing, nc_sync_interval, met_cache_file,
+  max_interp_stations, prefetch_met, tsurf_solver, watertable_tolerance,
+  soil_table_size, output_queue_size, basin_only_output,
+  channel_output_format, state_format, checkpoint_base_interval,
+  ensemble_members, ensemble_precipitation_factors,
+  ensemble_precipitation_perturbation, ensemble_temperature_perturbation,
+  ensemble_radiation_perturbation, ensemble_perturbation_autocorrelation,
+  ensemble_perturbation_station_correlation, ensemble_perturbation_seed,
+  hru_mode,
+  hru_elevation_band, hru_slope_class, hru_aspect_class, hru_soil_depth_class,
+  hru_sky_view_class, hru_met_weight_tolerance, sub_basin_outlet_segment,
+  sub_basin_outlet_north, sub_basin_outlet_east, met_grid_spacing,
+  cell_tile_size, thread_pinning, huge_pages, profile, trace_file,
+  trace_interval, perf_counters, perf_vector_events, cell_cost_timing,
+  memory_limit, telemetry_file, telemetry_format, telemetry_interval,
+  monitor_feed, monitor_feed_slots, monitor_feed_map_stride,
+  parallel_initialization, stream_temp_solver, quiescent_cells,
+  max_met_files, static_map_bits, channel_routing_substeps, cell_order,
+  cell_order_tile, checkpoint_channel_flows, pixel_output_format,
+  spin_up_cycles, spin_up_tolerance, spin_up_acceleration,
+  checkpoint_wall_interval, static_data_share, soil_column_batch,
+  radiation_batch, interception_batch, pipeline_channel_routing,
+  concurrent_stages, cell_class_order, channel_inflow_record, message_level,
+  message_limit, simd_level, math_accuracy, output_rollover,
+  output_rollover_name, checkpoint_compression, checkpoint_compression_level,
+  checkpoint_shuffle, out_of_core_directory, auto_tune, auto_tune_steps,
+  auto_tune_file, snow_only, channel_routing_batch, shading_mode,
+  horizon_sectors, horizon_file, map_file_layout,
+  met_file_interval, met_interpolation, concurrent_network_routing,
+  radiation_table_size, subsurface_routing_substeps,
   /* Area */
   coordinate_system, extreme_north, extreme_west, center_latitude,
   center_longitude, time_zone_meridian, number_of_rows,
@@ -139,7 +330,7 @@ enum KEYS {
   MM5_rows, MM5_cols, MM5_ext_north, MM5_ext_west, MM5_dy,
   /* grid information */
   grid_ext_north=0, grid_ext_south, grid_ext_east, grid_ext_west, tot_grid, decim,
-  grid_met_file, file_prefix,
+  grid_met_file, file_prefix, grid_catalogue, grid_netcdf_file, grid_netcdf_vars,
   /* Soil information */
   soil_description = 0, lateral_ks, exponent, depth_thresh, max_infiltration, capillary_drive,
   soil_albedo, number_of_layers, porosity, pore_size, bubbling_pressure, field_capacity,
@@ -156,19 +347,26 @@ enum KEYS {
   soiltype_file = 0, soildepth_file,
   /* DHSVM channel keys */
   stream_network = 0, stream_map, stream_class, riparian_veg,
-  road_network, road_map, road_class,
+  stream_temp_param, road_network, road_map, road_class, stream_cache,
+  road_cache,
   /* number of each type of output */
   output_path =
     0, initial_state_path, npixels, nstates, nmapvars, nimagevars, ngraphics,
+    sat_flush_interval, graphics_mode, graphics_interval,
+    aggregation_interval, nstatvars,
   /* pixel information */
   north = 0, east, name,
   /* state information */
   state_date = 0,
   /* map information */
-  map_variable = 0, map_layer, nmaps, map_date,
+  map_variable = 0, map_layer, nmaps, map_date, map_chunk, map_deflate,
+  map_shuffle, map_quantize, map_reducer, map_window, map_mask,
+  map_block_size, map_block_reducer,
   /* image information */
   image_variable = 0, image_layer, image_start, image_end, image_interval,
   image_upper, image_lower,
+  /* statistics information */
+  stat_variable = 0, stat_layer, stat_threshold, stat_exceedance,
   /* graphics information */
   graphics_variable = 0
 };
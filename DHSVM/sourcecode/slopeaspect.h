@@ -30,10 +30,15 @@ extern int ydirection[NDIRS];
 /* -------------------------------------------------------------
    available functions
    ------------------------------------------------------------- */
-void ElevationSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap);
+void ElevationSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap, int NThreads);
+ITEM *RankedCells(MAPSIZE * Map, TOPOPIX ** TopoMap, int NThreads);
 void HeadSlopeAspect(MAPSIZE * Map, TOPOPIX ** TopoMap, SOILPIX ** SoilMap,
-		     float **FlowGrad, unsigned char ***Dir, unsigned int **TotalDir);
+		     float Tolerance, SUBSURFACEWORK * Work);
+void InitFlowGraph(MAPSIZE * Map, FLOWGRAPH * Graph);
+void MakeFlowGraph(MAPSIZE * Map, TOPOPIX ** TopoMap, unsigned char *Dir,
+		   unsigned int *TotalDir, FLOWGRAPH * Graph);
+void FreeFlowGraph(FLOWGRAPH * Graph);
 int valid_cell(MAPSIZE * Map, int x, int y);
-void quick(ITEM *OrderedCells, int count);
+void InitNeighborOffsets(MAPSIZE * Map);
 #endif
 
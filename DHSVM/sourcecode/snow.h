@@ -21,6 +21,30 @@
 #define MAX_SURFACE_SWE     0.125	/* maximum depth of the surface layer
 					                   in water equivalent (m) */
 
+/* parameters of SnowPackEnergyBalanceParams(), see SnowPackEnergyBalance() */
+typedef struct {
+  int Dt;			    /* Model time step (seconds) */
+  float Ra;			    /* Aerodynamic resistance (s/m) */
+  float Z;			    /* Reference height (m) */
+  float Displacement;   /* Displacement height (m) */
+  double LogZ;		    /* log(2/Z0), with Z0 the roughness length (m) */
+  float Wind;			/* Wind speed (m/s) */
+  float ShortRad;		/* Net incident shortwave radiation (W/m2) */
+  float LongRadIn;		/* Incoming longwave radiation (W/m2) */
+  float AirDens;		/* Density of air (kg/m3) */
+  float Lv;			    /* Latent heat of vaporization (J/kg3) */
+  float Tair;			/* Air temperature (C) */
+  float Press;			/* Air pressure (Pa) */
+  float Vpd;			/* Vapor pressure deficit (Pa) */
+  float EactAir;		/* Actual vapor pressure of air (Pa) */
+  float Rain;			/* Rain fall (m/timestep) */
+  float SweSurfaceLayer;/* Snow water equivalent in surface layer (m) */
+  float SurfaceLiquidWater;	/* Liquid water in the surface layer (m) */
+  float OldTSurf;		    /* Surface temperature during previous time step */
+  float *RefreezeEnergy;	/* Refreeze energy (W/m2) */
+  float *VaporMassFlux;		/* Mass flux of water vapor to or from the snow */
+} SNOWEBPARAMS;
+
 void MassRelease(float *InterceptedSnow, float *TempInterceptionStorage,
 		 float *ReleasedMass, float *Drip, float MDRatio);
 
@@ -32,7 +56,7 @@ void SnowInterception(OPTIONSTRUCT *Options, int y, int x, int Dt, float F,
               float *SnowFall, float *IntRain, float *IntSnow, 
               float *TempIntStorage, float *VaporMassFlux, float *Tcanopy, 
               float *MeltEnergy, float *MomentSq, float *Height, 
-              unsigned char UnderStory, float MS_Rainfall, float LD_FallVelocity);
+              unsigned char UnderStory, float MS_Rainfall, double LD_MomentSq);
 
 float SnowMelt(int y, int x, int Dt, float Z, float Displacement, float Z0,
 	       float BaseRa, float AirDens, float EactAir, float Lv,
@@ -40,8 +64,11 @@ float SnowMelt(int y, int x, int Dt, float Z, float Displacement, float Z0,
 	       float SnowFall, float Tair, float Vpd, float Wind,
 	       float *PackWater, float *SurfWater, float *Swq,
 	       float *VaporMassFlux, float *TPack, float *TSurf,
-	       float *MeltEnergy);
+	       float *MeltEnergy, int Solver, int *NIter);
 
 float SnowPackEnergyBalance(float TSurf, va_list ap);
 
+float SnowPackEnergyBalanceParams(float TSurf, void *Params, 
+				  float *Derivative);
+
 #endif
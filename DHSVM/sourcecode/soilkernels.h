@@ -0,0 +1,380 @@
+/*
+ * SUMMARY:      soilkernels.h - Lane loops of SoilColumnBatch.c
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  DistributeSatflow() and UnsaturatedFlow() for the
+ *               SOIL_LANES columns of one soil type
+ * DESCRIP-END.
+ * FUNCTIONS:    DistributeLanes()
+ *               UnsaturatedLanes()
+ * COMMENTS:     Included by SoilColumnBatch.c once for each SIMD level, see
+ *               cpudispatch.h, so there is no include guard.  With
+ *               SOIL_FIXED_LAYERS defined the loops are those of the soil
+ *               types with that number of layers: the layer loops have a
+ *               fixed count, which the compiler unrolls, and the lane
+ *               arrays are local to the loops rather than in Batch->Lanes,
+ *               so they can be kept in registers and do not alias the
+ *               state of the cells
+ */
+
+/*****************************************************************************
+  Function name: DistributeLanes()
+
+  Purpose      : DistributeSatflow() for NLanes columns of one soil type
+
+  Required     :
+    SOILBATCH *Batch - Batch
+    int *Lane        - Columns of the lanes
+    int NLanes       - Number of lanes used, the others repeat the first
+
+  Comments     : The loops of DistributeSatflow() that stop once the lateral
+                 flow is used up are done for all the layers, a lane whose
+                 loop has stopped is left as it is
+*****************************************************************************/
+static void SIMD_NAME(DistributeLanes)(SOILBATCH *Batch, int *Lane, int NLanes)
+{
+  SOILCOLUMN *Column;
+  SOILTABLE *SType;
+  float *Moist;			/* [layer][lane] */
+  float *Thick;			/* RootDepth * Adjust, [layer][lane] */
+  float *RootDepth;
+  float *Adjust;
+#ifdef SOIL_FIXED_LAYERS
+  float LaneBlock[4 * (SOIL_FIXED_LAYERS + 1) * SOIL_LANES];
+#endif
+  float SatFlow[SOIL_LANES];
+  float TableDepth[SOIL_LANES];
+  float TotalDepth[SOIL_LANES];
+  float DeepLayerDepth[SOIL_LANES];
+  float Depth[SOIL_LANES];
+  float AvaWater;
+  float ExtracWater;
+  float NewDepth;
+  float DeepPorosity;
+  float DeepFCap;
+  int Active;
+  int NSoilLayers;
+  int Any;
+  int i;
+  int l;
+
+  SType = Batch->Column[Lane[0]].SType;
+#ifdef SOIL_FIXED_LAYERS
+  NSoilLayers = SOIL_FIXED_LAYERS;
+  Moist = LaneBlock;
+#else
+  NSoilLayers = SType->NLayers;
+  Moist = Batch->Lanes;
+#endif
+  DeepPorosity = SType->Porosity[NSoilLayers - 1];
+  DeepFCap = SType->FCap[NSoilLayers - 1];
+  Thick = Moist + (NSoilLayers + 1) * SOIL_LANES;
+  RootDepth = Thick + (NSoilLayers + 1) * SOIL_LANES;
+  Adjust = RootDepth + (NSoilLayers + 1) * SOIL_LANES;
+
+  for (l = 0, Any = FALSE; l < SOIL_LANES; l++) {
+    Column = &(Batch->Column[Lane[l < NLanes ? l : 0]]);
+    SatFlow[l] = (l < NLanes) ? Column->Soil->SatFlow : 0.0;
+    Any = Any || SatFlow[l] != 0.0;
+    TableDepth[l] = Column->Soil->TableDepth;
+    TotalDepth[l] = Column->Soil->Depth;
+    DeepLayerDepth[l] = TotalDepth[l];
+    for (i = 0; i < NSoilLayers; i++) {
+      LANE(RootDepth, i, l) = Column->VType->RootDepth[i];
+      DeepLayerDepth[l] -= Column->VType->RootDepth[i];
+    }
+    for (i = 0; i <= NSoilLayers; i++) {
+      LANE(Moist, i, l) = Column->Soil->Moist[i];
+      LANE(Adjust, i, l) = Column->Network->Adjust[i];
+    }
+    LANE(RootDepth, NSoilLayers, l) = DeepLayerDepth[l];
+    Depth[l] = 0.0;
+  }
+  /* most cells have no lateral flow left from the time step before */
+  if (!Any)
+    return;
+  for (i = 0; i <= NSoilLayers; i++)
+    for (l = 0; l < SOIL_LANES; l++)
+      LANE(Thick, i, l) = LANE(RootDepth, i, l) * LANE(Adjust, i, l);
+
+  /* outflow from the water table layer down to the bottom layer */
+  for (i = 0; i < NSoilLayers; i++) {
+    for (l = 0; l < SOIL_LANES; l++) {
+      Active = (SatFlow[l] < 0.0 && Depth[l] < TotalDepth[l]);
+      NewDepth = (LANE(RootDepth, i, l) < (TotalDepth[l] - Depth[l])) ?
+	Depth[l] + LANE(RootDepth, i, l) : TotalDepth[l];
+      AvaWater = 0.0;
+      if (NewDepth > TableDepth[l])
+	AvaWater = (((NewDepth - TableDepth[l]) > LANE(RootDepth, i, l)) ?
+		    SType->Porosity[i] - SType->FCap[i] :
+		    LANE(Moist, i, l) - SType->FCap[i]) *
+	  LANE(RootDepth, i, l) * LANE(Adjust, i, l);
+      ExtracWater = (-SatFlow[l] > AvaWater) ? -AvaWater : SatFlow[l];
+      if (Active) {
+	Depth[l] = NewDepth;
+	LANE(Moist, i, l) += ExtracWater / LANE(Thick, i, l);
+	SatFlow[l] -= ExtracWater;
+      }
+    }
+  }
+  for (l = 0; l < SOIL_LANES; l++) {
+    if (SatFlow[l] < 0.0) {
+      AvaWater = 0.0;
+      if (Depth[l] < TotalDepth[l]) {
+	Depth[l] = TotalDepth[l];
+	AvaWater = (((Depth[l] - TableDepth[l]) > DeepLayerDepth[l]) ?
+		    DeepPorosity - DeepFCap :
+		    LANE(Moist, NSoilLayers, l) - DeepFCap) *
+	  DeepLayerDepth[l] * LANE(Adjust, NSoilLayers, l);
+      }
+      ExtracWater = (-SatFlow[l] > AvaWater) ? -AvaWater : SatFlow[l];
+      LANE(Moist, NSoilLayers, l) += ExtracWater /
+	(DeepLayerDepth[l] * LANE(Adjust, NSoilLayers, l));
+      SatFlow[l] -= ExtracWater;
+    }
+  }
+
+  /* inflow fills the deep layer and then the layers above it */
+  for (l = 0; l < SOIL_LANES; l++) {
+    if (SatFlow[l] > 0.0) {
+      AvaWater = (DeepPorosity - LANE(Moist, NSoilLayers, l)) *
+	DeepLayerDepth[l] * LANE(Adjust, NSoilLayers, l);
+      ExtracWater = (SatFlow[l] > AvaWater) ? AvaWater : SatFlow[l];
+      SatFlow[l] -= ExtracWater;
+      LANE(Moist, NSoilLayers, l) += ExtracWater /
+	(DeepLayerDepth[l] * LANE(Adjust, NSoilLayers, l));
+    }
+  }
+  for (i = NSoilLayers - 1; i >= 0; i--) {
+    for (l = 0; l < SOIL_LANES; l++) {
+      AvaWater = (SType->Porosity[i] - LANE(Moist, i, l)) *
+	LANE(RootDepth, i, l) * LANE(Adjust, i, l);
+      ExtracWater = (SatFlow[l] > AvaWater) ? AvaWater : SatFlow[l];
+      if (SatFlow[l] > 0.0) {
+	SatFlow[l] -= ExtracWater;
+	LANE(Moist, i, l) += ExtracWater / LANE(Thick, i, l);
+      }
+    }
+  }
+
+  for (l = 0; l < NLanes; l++) {
+    Column = &(Batch->Column[Lane[l]]);
+    for (i = 0; i <= NSoilLayers; i++)
+      Column->Soil->Moist[i] = LANE(Moist, i, l);
+    if (SatFlow[l] > 0.0)
+      Column->Soil->IExcess += SatFlow[l];
+  }
+}
+
+/*****************************************************************************
+  Function name: UnsaturatedLanes()
+
+  Purpose      : UnsaturatedFlow() for NLanes columns of one soil type
+
+  Required     :
+    SOILBATCH *Batch - Batch
+    int *Lane        - Columns of the lanes
+    int NLanes       - Number of lanes used, the others repeat the first
+    int Dt           - Time step (s)
+
+  Comments     : The infiltration through the road bed or channel and the
+                 water table are done for each lane, the drainage of the
+                 layers in the lanes
+*****************************************************************************/
+static void SIMD_NAME(UnsaturatedLanes)(SOILBATCH *Batch, int *Lane, int NLanes, int Dt)
+{
+  SOILCOLUMN *Column;
+  SOILTABLE *SType;
+  SOILPIX *Soil;
+  FLOATTABLE *Table;
+  float *Moist;			/* [layer][lane] */
+  float *Thick;			/* RootDepth * Adjust, [layer][lane] */
+  float *RootDepth;
+  float *Adjust;
+  float *Perc;
+  float *PercArea;
+  float *Relative;		/* Moist / Porosity, [lane] */
+#ifdef SOIL_FIXED_LAYERS
+  float LaneBlock[6 * (SOIL_FIXED_LAYERS + 1) * SOIL_LANES + SOIL_LANES];
+#endif
+  float DeepLayerDepth[SOIL_LANES];
+  float Drainage[SOIL_LANES];
+  float Exponent;
+  float Ks;
+  float FieldCapacity;
+  float MaxSoilWater;
+  float SoilWater;
+  float Percolation;
+  float f;
+  unsigned long k;
+  int Drained[SOIL_LANES];
+  int Drains[SOIL_LANES];
+  int Over[SOIL_LANES];
+  int NSoilLayers;
+  int Zone;
+  int i;
+  int l;
+
+  SType = Batch->Column[Lane[0]].SType;
+#ifdef SOIL_FIXED_LAYERS
+  NSoilLayers = SOIL_FIXED_LAYERS;
+  Moist = LaneBlock;
+#else
+  NSoilLayers = SType->NLayers;
+  Moist = Batch->Lanes;
+#endif
+  Thick = Moist + (NSoilLayers + 1) * SOIL_LANES;
+  RootDepth = Thick + (NSoilLayers + 1) * SOIL_LANES;
+  Adjust = RootDepth + (NSoilLayers + 1) * SOIL_LANES;
+  Perc = Adjust + (NSoilLayers + 1) * SOIL_LANES;
+  PercArea = Perc + (NSoilLayers + 1) * SOIL_LANES;
+  Relative = PercArea + (NSoilLayers + 1) * SOIL_LANES;
+
+  for (l = 0; l < SOIL_LANES; l++) {
+    Column = &(Batch->Column[Lane[l < NLanes ? l : 0]]);
+    Soil = Column->Soil;
+    DeepLayerDepth[l] = Soil->Depth;
+    for (i = 0; i < NSoilLayers; i++) {
+      LANE(RootDepth, i, l) = Column->VType->RootDepth[i];
+      LANE(Perc, i, l) = Soil->Perc[i];
+      LANE(PercArea, i, l) = Column->Network->PercArea[i];
+      DeepLayerDepth[l] -= Column->VType->RootDepth[i];
+    }
+    for (i = 0; i <= NSoilLayers; i++) {
+      LANE(Moist, i, l) = Soil->Moist[i];
+      LANE(Adjust, i, l) = Column->Network->Adjust[i];
+    }
+    LANE(RootDepth, NSoilLayers, l) = DeepLayerDepth[l];
+    Drained[l] = 0;
+    if (l >= NLanes)
+      continue;
+
+    /* first take care of infiltration through the roadbed/channel, then
+       through the remaining surface */
+    Zone = Column->Network->CutBankZone;
+    if (Soil->TableDepth <= Column->Network->BankHeight)
+      Soil->IExcess += Column->RoadbedInfiltration;
+    else if (Zone == NSoilLayers)
+      LANE(Moist, NSoilLayers, l) += Column->RoadbedInfiltration /
+	(DeepLayerDepth[l] * LANE(Adjust, NSoilLayers, l));
+    else if (Zone >= 0)
+      LANE(Moist, Zone, l) += Column->RoadbedInfiltration /
+	(LANE(RootDepth, Zone, l) * LANE(Adjust, Zone, l));
+    if (Soil->TableDepth <= 0)
+      Soil->IExcess += Column->Infiltration;
+    else
+      LANE(Moist, 0, l) += Column->Infiltration /
+	(LANE(RootDepth, 0, l) * LANE(Adjust, 0, l));
+  }
+  for (i = 0; i <= NSoilLayers; i++)
+    for (l = 0; l < SOIL_LANES; l++)
+      LANE(Thick, i, l) = LANE(RootDepth, i, l) * LANE(Adjust, i, l);
+
+  /* from top to bottom soil layer, no movement if soil moisture is below
+     field capacity */
+  for (i = 0; i < NSoilLayers; i++) {
+    Exponent = 2.0 / SType->PoreDist[i] + 3.0;
+    for (l = 0; l < SOIL_LANES; l++) {
+      Drains[l] = LANE(Moist, i, l) > SType->FCap[i];
+      Over[l] = LANE(Moist, i, l) > SType->Porosity[i];
+      Relative[l] = (Drains[l] && !Over[l]) ?
+	LANE(Moist, i, l) / SType->Porosity[i] : 0.0;
+      Drained[l] += Drains[l];
+    }
+
+    /* Brooks-Corey conductivity, see FloatInterpolate() */
+    if (SType->DrainTable != NULL) {
+      Table = &(SType->DrainTable[i]);
+      for (l = 0; l < SOIL_LANES; l++) {
+	f = (Relative[l] - Table->Offset) / Table->Delta;
+	k = (f <= 0.0) ? 0 : (unsigned long) f;
+	if (f <= 0.0)
+	  Drainage[l] = Table->Data[0];
+	else if (k >= Table->Size - 1)
+	  Drainage[l] = Table->Data[Table->Size - 1];
+	else
+	  Drainage[l] = Table->Data[k] + (f - (float) k) *
+	    (Table->Data[k + 1] - Table->Data[k]);
+	Drainage[l] = SType->Ks[i] * Drainage[l];
+      }
+    }
+    else if (MathAccuracy == MATH_FAST) {
+      /* all the lanes, Relative is 0 in those that do not drain */
+      Ks = SType->Ks[i];
+      for (l = 0; l < SOIL_LANES; l++)
+	Drainage[l] = Ks * PolyPow(Relative[l], Exponent);
+    }
+    else {
+      for (l = 0; l < SOIL_LANES; l++)
+	if (Drains[l] && !Over[l])
+	  Drainage[l] = SType->Ks[i] *
+	    MathPow((double) Relative[l], (double) Exponent);
+    }
+
+    for (l = 0; l < SOIL_LANES; l++) {
+      if (Over[l])
+	Drainage[l] = SType->Ks[i];
+      /* convert to m */
+      Drainage[l] *= Dt;
+
+      /* percolation = drainage + perc from layer above */
+      Percolation = 0.5 * (LANE(Perc, i, l) + Drainage[l]) *
+	LANE(PercArea, i, l);
+
+      MaxSoilWater = LANE(RootDepth, i, l) * SType->Porosity[i] *
+	LANE(Adjust, i, l);
+      SoilWater = LANE(RootDepth, i, l) * LANE(Moist, i, l) *
+	LANE(Adjust, i, l);
+      FieldCapacity = LANE(RootDepth, i, l) * SType->FCap[i] *
+	LANE(Adjust, i, l);
+
+      if ((SoilWater - Percolation) < FieldCapacity)
+	Percolation = SoilWater - FieldCapacity;
+      SoilWater -= Percolation;
+      if (SoilWater > MaxSoilWater)
+	Percolation += SoilWater - MaxSoilWater;
+
+      if (Drains[l]) {
+	LANE(Perc, i, l) = Percolation;
+	LANE(Moist, i, l) -= Percolation / LANE(Thick, i, l);
+	if (i < (NSoilLayers - 1))
+	  LANE(Moist, i + 1, l) += Percolation / LANE(Thick, i + 1, l);
+      }
+      else
+	LANE(Perc, i, l) = 0.0;
+
+      /* convert back to straight 1-d flux */
+      LANE(Perc, i, l) /= LANE(PercArea, i, l);
+    }
+  }
+
+  for (l = 0; l < SOIL_LANES; l++)
+    LANE(Moist, NSoilLayers, l) +=
+      (LANE(Perc, NSoilLayers - 1, l) * LANE(PercArea, NSoilLayers - 1, l)) /
+      (DeepLayerDepth[l] * LANE(Adjust, NSoilLayers, l));
+
+  for (l = 0; l < NLanes; l++) {
+    Column = &(Batch->Column[Lane[l]]);
+    Soil = Column->Soil;
+    for (i = 0; i < NSoilLayers; i++)
+      Soil->Perc[i] = LANE(Perc, i, l);
+    for (i = 0; i <= NSoilLayers; i++)
+      Soil->Moist[i] = LANE(Moist, i, l);
+
+    /* a negative water table depth is water ponding on the surface, which
+       becomes surface runoff */
+    Soil->TableDepth = WaterTableDepth(NSoilLayers, Soil->Depth,
+				       Column->VType->RootDepth,
+				       SType->Porosity, SType->FCap,
+				       Column->Network->Adjust, Soil->Moist,
+				       &(Column->Network->Capacity));
+    if (Soil->TableDepth < 0.0) {
+      Soil->IExcess += -(Soil->TableDepth);
+      Soil->TableDepth = 0.0;
+    }
+    Soil->CostUnsatLayers += Drained[l];
+  }
+}
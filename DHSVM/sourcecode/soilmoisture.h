@@ -17,15 +17,33 @@
 #ifndef SOILMOISTURE_H
 #define SOILMOISTURE_H
 
+#include "lookuptable.h"
+
 #define NO_CUT -10
 
+/* constants of the soil column of a cell, which only change with its
+   layers (see InitSoilCapacity()) */
+typedef struct {
+  float DeepDepth;		/* Thickness of the layer below the root
+				   layers (m), as WaterTableDepth() finds it */
+  float DeepThickness;		/* DeepDepth * Adjust of the deep layer */
+  float DeepStorage;		/* Storage of the deep layer between field
+				   capacity and porosity (m) */
+  float RootBottom;		/* Bottom of the root layers (m), as
+				   CalcAvailableWater() finds it for the
+				   soil depth */
+  float DeepAvailable;		/* Water of the deep layer available for
+				   saturated flow when it is saturated (m) */
+} SOILCAPACITY;
+
 void AdjustStorage(int NSoilLayers, float TotalDepth, float *RootDepth,
 		   float Area, float DX, float DY, float BankHeight, 
 		   float *PercArea, float *Adjust, int *CutBankZone);
 
 float CalcAvailableWater(int NRootLayers, float TotalDepth, float *RootDepth,
 			 float *Moisture, float *FCap, float TableDepth,
-			 float *Adjust);
+			 float *Adjust, SOILCAPACITY *Capacity,
+			 float BankHeight, float *BankWater);
 
 float CalcTotalWater(int NSoilLayers, float TotalDepth, float *RootDepth,
 		     float *Moist, float *Adjust);
@@ -41,15 +59,20 @@ void DistributeSatflow(int Dt, float DX, float DY, float SatFlow, int NSoilLayer
 		     int CutBankZone, float BankHeight, float *TableDepth,
 		     float *Runoff, float *Moist, int InfiltOption);
 
-void UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration, 
+int UnsaturatedFlow(int Dt, float DX, float DY, float Infiltration, 
 		     float RoadbedInfiltration, float SatFlow, int NSoilLayers, 
 		     float TotalDepth, float Area, float *RootDepth, float *Ks, 
-		     float *PoreDist, float *Porosity, float *FCap, float *Perc, 
-		     float *PercArea, float *Adjust, int CutBankZone, float BankHeight,
-			 float *TableDepth, float *Runoff, float *Moist, int InfiltOption);
+		     float *PoreDist, float *Porosity, float *FCap, 
+		     FLOATTABLE *DrainTable, float *Perc, float *PercArea, float *Adjust, int CutBankZone, float BankHeight,
+			 float *TableDepth, float *Runoff, float *Moist, int InfiltOption,
+		     SOILCAPACITY *Capacity);
+
+void InitSoilCapacity(int NRootLayers, float TotalDepth, float *RootDepth,
+		      float *Porosity, float *FCap, float *Adjust,
+		      SOILCAPACITY *Capacity);
 
 float WaterTableDepth(int NRootLayers, float TotalDepth, float *RootDepth,
 		      float *Porosity, float *FCap, float *Adjust,
-		      float *Moist);
+		      float *Moist, SOILCAPACITY *Capacity);
 
 #endif
@@ -0,0 +1,71 @@
+/*
+ * SUMMARY:      stepgraph.h - header file for the stages of a time step
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  The stages of a time step with the model state they read
+ *               and write, and the order in which they can be run, see
+ *               StepGraph.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef STEPGRAPH_H
+#define STEPGRAPH_H
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* the model state of a time step, as read and write sets of the stages.
+   The model time is only changed after all stages of the step */
+#define STEP_MET        0x0001	/* station records, met fields, solar
+				   geometry, radar and MM5 maps */
+#define STEP_NEXTMET    0x0002	/* station files and the records read
+				   ahead for the next step */
+#define STEP_CELLS      0x0004	/* maps of the cells, response units and
+				   tiles of the pixel loop */
+#define STEP_STREAMS    0x0008	/* flow of the stream segments, and the
+				   stream flow files */
+#define STEP_STREAMHEAT 0x0010	/* RBM forcing, shading and temperature of
+				   the stream segments */
+#define STEP_ROADS      0x0020	/* road segments and the road flow files */
+#define STEP_SURFACE    0x0040	/* unit hydrograph and surface routing */
+#define STEP_TOTAL      0x0080	/* basin totals and mass balance */
+#define STEP_DUMP       0x0100	/* ExecDump() files and the graphics */
+#define STEP_STATS      0x0200	/* MAP STATISTICS */
+#define STEP_OBJECTIVE  0x0400	/* fit to the OBSERVED FLOW FILE */
+#define STEP_NETCDF     0x0800	/* the NetCDF library, which is not thread
+				   safe */
+
+typedef struct {
+  const char *Name;
+  void (*Run)(void);		/* the stage */
+  unsigned int Reads;		/* STEP_ state read by the stage */
+  unsigned int Writes;		/* and written by it */
+  int Side;			/* TRUE if the stage may run in a thread of
+				   its own: it starts no OpenMP parallel
+				   regions and is not profiled */
+  int Level;			/* set by InitStepGraph() */
+#ifdef HAVE_PTHREAD
+  pthread_t Thread;
+  int Started;			/* TRUE while it runs in its thread */
+#endif
+} STEPTASK;
+
+typedef struct {
+  int NTasks;
+  STEPTASK *Task;		/* the stages, in the order of a serial step */
+  int NLevels;			/* number of levels */
+  int Concurrent;		/* TRUE with OPTIONS CONCURRENT STAGES */
+} STEPGRAPH;
+
+void InitStepGraph(STEPGRAPH *Graph, STEPTASK *Tasks, int NTasks,
+		   int Concurrent);
+void RunStepGraph(STEPGRAPH *Graph);
+void FreeStepGraph(STEPGRAPH *Graph);
+
+#endif
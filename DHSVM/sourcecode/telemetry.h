@@ -0,0 +1,31 @@
+/*
+ * SUMMARY:      telemetry.h - header file for the progress telemetry
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Progress and throughput records written with OPTIONS
+ *               TELEMETRY FILE, see Telemetry.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "data.h"
+
+extern int TelemetryOn;		/* TRUE with a TELEMETRY FILE */
+
+void InitTelemetry(OPTIONSTRUCT *Options, int NSteps, int Dt);
+void TelemetryStep(int Step, DATE *Current);
+void ForkTelemetry(int Branch);
+void CloseTelemetry(int Step, DATE *Current);
+
+/* after time step Step - 1, costs a clock reading unless a record is due */
+#define TELEMETRY_STEP(Step, Current) \
+  do { if (TelemetryOn) TelemetryStep(Step, Current); } while (0)
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * SUMMARY:      trace.h - header file for the trace of a run
+ * USAGE:        Part of DHSVM
+ *
+ * AUTHOR:       DHSVM project
+ * ORG:          Pacific Northwest National Laboratory
+ * ORIG-DATE:    Oct-2026
+ * DESCRIPTION:  Spans of time written with OPTIONS TRACE FILE, see Trace.c
+ * DESCRIP-END.
+ * FUNCTIONS:
+ * COMMENTS:
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+extern int TraceOn;		/* TRUE while spans are recorded */
+
+void InitTrace(char *FileName, int Interval);
+void TraceStep(int Step);
+void ForkTrace(int Branch);
+void CloseTrace(void);
+double TraceBegin(void);
+void TraceEnd(double Start, const char *Name, const char *Category,
+	      const char *FileName, double Bytes);
+
+/* start of a span, -1 if it is not recorded */
+#define TRACE_BEGIN() (TraceOn ? TraceBegin() : -1.0)
+
+#endif
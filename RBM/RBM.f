@@ -31,6 +31,7 @@ C
       character*200 Prefix
       integer iargc
       integer numarg
+      logical binary
  
 c     Command line input
 c
@@ -51,9 +52,17 @@ c
 c     open the output file 
       open(unit=20,file=TRIM(Prefix)//'.temp',status='unknown')
 c
-c     Open file with weather and inflow data
-      write(*,*) 'Forcing file -  ', TRIM(Prefix)//'.forcing'
-      open(unit=30,file=TRIM(Prefix)//'.forcing',STATUS='old')
+c     Open file with weather and inflow data.  Create_File writes
+c     a binary forcing file if it is run with BINARY
+      inquire(file=TRIM(Prefix)//'.forcing.bin',exist=binary)
+      if (binary) then
+        write(*,*) 'Forcing file -  ', TRIM(Prefix)//'.forcing.bin'
+        open(unit=30,file=TRIM(Prefix)//'.forcing.bin',STATUS='old'
+     &      ,access='stream',form='unformatted')
+      else
+        write(*,*) 'Forcing file -  ', TRIM(Prefix)//'.forcing'
+        open(unit=30,file=TRIM(Prefix)//'.forcing',STATUS='old')
+      end if
 C
 c     open Mohseni file 
       open(40,file=TRIM(Prefix)//'.Mohseni',STATUS='old')    
@@ -89,6 +98,7 @@ C
       END
       SUBROUTINE BEGIN
       character*11 end_time,start_time
+      character*11 form30
       character*5 Dummy_B
       character*10 Dummy_A
       integer head_name,trib_cell,first_cell
@@ -102,15 +112,23 @@ c
 c     Read the starting and ending times and the number of
 c     periods per day of weather data from the forcing file
 c
-      read(30,*) start_time,end_time,nwpd,nd_start
-      write(*,*) start_time,'  ',end_time,nwpd,nd_start
+      inquire(unit=30,form=form30)
+      if (form30.eq.'UNFORMATTED') then
+        read(30) start_year,start_month,start_day,start_hour
+     &          ,end_year,end_month,end_day,end_hour,nwpd,nd_start
+      else
+        read(30,*) start_time,end_time,nwpd,nd_start
+        write(*,*) start_time,'  ',end_time,nwpd,nd_start
+      end if
 c 
       write(*,*) 'Number of simulations per day - ',nwpd
 c
-      read(start_time,'(i4,2i2,1x,i2)') start_year,start_month
-     &                                 ,start_day,start_hour
-      read(end_time,'(i4,2i2,1x,i2)') end_year,end_month
-     &                               ,end_day,end_hour
+      if (form30.ne.'UNFORMATTED') then
+        read(start_time,'(i4,2i2,1x,i2)') start_year,start_month
+     &                                   ,start_day,start_hour
+        read(end_time,'(i4,2i2,1x,i2)') end_year,end_month
+     &                                 ,end_day,end_hour
+      end if
       nyear1=start_year
       nyear2=end_year
       write(*,*) start_year,start_month,start_day
@@ -219,6 +237,10 @@ c
       nreach=no_rch
       xwpd=nwpd
       dt_comp=86400./xwpd
+c
+c     Group the reaches by tributary level for SYSTMM
+c
+      CALL LEVELS
 C
 C     ******************************************************
 C                         Return to RMAIN
@@ -227,13 +249,77 @@ C
 c
       RETURN
   900 END
+      SUBROUTINE LEVELS
+c
+c     Sorts the reaches by tributary level.  A reach mixes in the
+c     temperatures of this time step of the tributaries that come
+c     before it in the network file, and those of the last time step
+c     of the tributaries that come after it.  So it has to be solved
+c     after the first and before the second.  The reaches of a level
+c     do not depend on each other, and SYSTMM solves them at the same
+c     time, with the same results as in the order of the network file.
+c
+      integer level(1000),down(1000),next(1000)
+      INCLUDE 'RBM.fi'
+c
+c     DOWN(NR) is the reach that reach NR is tributary to
+c
+      do nr=1,nreach
+        down(nr)=0
+      end do
+      do nr=1,nreach
+        do nc=head_cell(nr),head_cell(nr)+no_cells(nr)-1
+          do nt=1,no_tribs(nc)
+            down(trib(nc,nt))=nr
+          end do
+        end do
+      end do
+c
+      no_levels=0
+      do nr=1,nreach
+        level(nr)=1
+        do nc=head_cell(nr),head_cell(nr)+no_cells(nr)-1
+          do nt=1,no_tribs(nc)
+            nr_trib=trib(nc,nt)
+            if (nr_trib.lt.nr) level(nr)=max(level(nr),level(nr_trib)+1)
+          end do
+        end do
+        if (down(nr).gt.0.and.down(nr).lt.nr)
+     &    level(nr)=max(level(nr),level(down(nr))+1)
+        no_levels=max(no_levels,level(nr))
+      end do
+c
+c     Counting sort, which keeps the order of the network file
+c     within a level
+c
+      do lvl=1,no_levels+1
+        lvl_first(lvl)=0
+      end do
+      do nr=1,nreach
+        lvl_first(level(nr)+1)=lvl_first(level(nr)+1)+1
+      end do
+      lvl_first(1)=1
+      do lvl=2,no_levels+1
+        lvl_first(lvl)=lvl_first(lvl-1)+lvl_first(lvl)
+      end do
+      do lvl=1,no_levels
+        next(lvl)=lvl_first(lvl)
+      end do
+      do nr=1,nreach
+        lvl_reach(next(level(nr)))=nr
+        next(level(nr))=next(level(nr))+1
+      end do
+      write(*,*) 'Number of tributary levels - ',no_levels
+      RETURN
+      END
       SUBROUTINE SYSTMM
       real*4 xa(4),ta(4),T_head(1000),T_smth(1000)
      *      ,dt_part(1000),x_part(1000)
       real*8 day_fract,hr_fract,sim_incr,year,prnt_time
       integer no_dt(1000),nstrt_elm(1000)
      .     ,ndltp(4),nterp(4),nptest(4),ndmo(12,2)
-      logical DONE
+      logical DONE,binary
+      character*11 form30
 
       INCLUDE 'RBM.fi'
       data ndltp/-2,-1,-2,-2/,nterp/4,3,2,3/
@@ -241,6 +327,10 @@ c
       data ndmo/0,31,59,90,120,151,181,212,243,273,304,334
      &         ,0,31,60,91,121,152,182,213,244,274,305,335/
 c
+c     The forcing file is binary if Create_File was run with BINARY
+      inquire(unit=30,form=form30)
+      binary=form30.eq.'UNFORMATTED'
+c
 c
       hour_inc=1./nwpd
       do nr=1,1000
@@ -326,10 +416,16 @@ c     Hardwire annual average temperature for headwaters
 c
                do nc=1,no_cells(nr)
                  l_seg=l_seg+1
-                 read(30,*,end=900) l1
+                 if (binary) then
+                   read(30,end=900) press(l_seg),dbt(l_seg)
+     &                      ,qna(l_seg),qns(l_seg),ea(l_seg),wind(l_seg)
+     &                      ,qin(l_seg),qout(l_seg)
+                 else
+                   read(30,*,end=900) l1
      &                      ,press(l_seg),dbt(l_seg)
      &                      ,qna(l_seg),qns(l_seg),ea(l_seg),wind(l_seg)
      &                      ,qin(l_seg),qout(l_seg)
+                 end if
                  if (qin(l_seg) < 0.5) then
                      qin(l_seg)=qout(l_seg)
                  end if
@@ -365,9 +461,18 @@ c     Headwaters flow and temperature
 c
  90            continue
 c
-c     Begin cycling through the reaches 
-c
-               do nr=1,nreach
+c     Begin cycling through the reaches, level by level.  The
+c     reaches of a level are solved in parallel
+c
+               do lvl=1,no_levels
+c$omp parallel do schedule(dynamic)
+c$omp& private(nl,nr,nc_head,x_head,x_bndry,ns,ncell,nx_s,nx_part
+c$omp& ,dt_total,dt_before,DONE,itest,nseg,npndx,ntrp,npart,nptest
+c$omp& ,xa,ta,x,t0,ttrp,dt_calc,nncell,ncell0,nm,u_river,z
+c$omp& ,QSURF,A,B,t_eq,qdot,q1,q2,ntribs,nt,nr_trib,t00
+c$omp& ,T_dist,dtlat,dt_part,x_part,nstrt_elm,no_dt)
+               do nl=lvl_first(lvl),lvl_first(lvl+1)-1
+                  nr=lvl_reach(nl)
                   nc_head=segment_cell(nr,1)
                   T_smth(nr)=b_smooth*T_smth(nr)+a_smooth*dbt(nc_head)
                   T_head(nr)=mu(nr)
@@ -542,8 +647,8 @@ c
 
                        ntribs=no_tribs(nncell)
                        if (ntribs.gt.0.and..not.DONE) then
-                         do ntrb=1,ntribs
-                           nr_trib=trib(nncell,ntrb)
+                         do nt=1,ntribs
+                           nr_trib=trib(nncell,nt)
                            q2=q1+q_trib(nr_trib)
                            t0=(q1*t0+q_trib(nr_trib)*T_trib(nr_trib))/q2
                            q1=q1+q_trib(nr_trib)
@@ -580,19 +685,6 @@ c
                      temp(nr,ns,n2)=t0
 	             T_trib(nr)=t0
 c
-c   Write file 20 with all temperature output 11/19/2008
-c
-                     nsmod=mod(ns,2)
-                     time=year+(day-1.+hour_inc*period)/xd_year
-                     if(nsmod.eq.0) then
-                       rmile_plot=x_dist(nr,ns)/5280.
-                       write(20,'(f11.5,i5,1x,i4,1x,2i5,1x,5f7.2,f9.2)') 
-     &                       time,nyear,nd,ncell,ns,t0
-     &                      ,T_head(nr),dbt(ncell)
-     &                      ,depth(ncell),u(ncell),qin(ncell)
-
-                     end if
-c
 c     End of computational element loop
 c
 
@@ -601,6 +693,24 @@ c     End of reach loop
 c
 
                end do
+c$omp end parallel do
+c     End of level loop
+c
+               end do
+c
+c   Write file 20 with all temperature output 11/19/2008.  It is
+c   written after the reach loop, in the order of the network file
+c
+               time=year+(day-1.+hour_inc*period)/xd_year
+               do nr=1,nreach
+                  do ns=2,no_celm(nr),2
+                     ncell=segment_cell(nr,ns)
+                     write(20,'(f11.5,i5,1x,i4,1x,2i5,1x,5f7.2,f9.2)') 
+     &                       time,nyear,nd,ncell,ns,temp(nr,ns,n2)
+     &                      ,T_head(nr),dbt(ncell)
+     &                      ,depth(ncell),u(ncell),qin(ncell)
+                  end do
+               end do
                ntmp=n1
                n1=n2
                n2=ntmp
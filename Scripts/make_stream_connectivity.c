@@ -6,295 +6,316 @@ Program: computes radiation attenuation for each stream segment at each time ste
 	-> headwater segments have no upstream segment
 	-> most segments have one upstream segment
 	-> confluence segments have an array of upstream segment
-  
+
   - azimuth.txt : ( all in same file)
 	-> estimated azimuth, use ArcInfo if need exact azimuth
 	-> segments are straight lines, get the 2 extremities x and y and
-	    derive the angle from north. The angle is +/- 180 because does 
+	    derive the angle from north. The angle is +/- 180 because does
 	    not take into account the flow direction.
             then get the 180-atan(dx/dy)
-	->NEVERMIND, azimuth provided in the map file, get the idea anyway 
+	->NEVERMIND, azimuth provided in the map file, get the idea anyway
         -> see SlopeAscpect.c
         -> NOTE that azimuth was derived by Lan but does not seem the default ( default is aspect?)
 
 Modified: Mar 12, 2014
+
+Modified: Oct 2026
+  - no fixed limits (MAXCONV, MAX_XY) any more: the segments are held in arrays that grow as the
+    network file is read, and found by id with a hash table
+  - the cells of a segment are not kept, only their length weighted sums of azimuth and elevation
+  - the upstream segments of all the segments are found in one pass over the segments (counting
+    sort on the downstream segment), in the order of the network file as before
+  so that the time and memory are linear in the number of segments and cells
 ******************************************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
 
-// to be updated for large basins as needed
-#define MAXCONV 15000	/* maxinum number of segments converging */ 
-#define MAX_XY  15000	/* max number of cell[x,y] crossed by one segment */
+#define LINE_LEN 4096	/* longest line of the network and map files */
+
+typedef struct {
+  int id;		/* seg id */
+  int next;		/* downstream seg id */
+  float length;		/* segment length in the network file */
+  int ncells;		/* number of cells[x,y] crossed by the segment */
+  double length_xy;	/* length of the segment in its cells */
+  double azim_xy;	/* sum of the azimuth * length in the cells */
+  double elev_xy;	/* sum of the elevation * length in the cells */
+} SEGMENT;
+
+/* hash table from seg id to seg number, open addressing */
+typedef struct {
+  int size;		/* power of 2 */
+  int *seg;		/* seg number, -1 for an empty slot */
+  SEGMENT *segs;
+} SEGHASH;
+
+static void *Allocate(size_t n, size_t size, const char *name);
+static void MakeHash(SEGHASH *hash, SEGMENT *segs, int nseg);
+static int FindSeg(const SEGHASH *hash, int id);
+static int IsBlank(const char *line);
 
 int main (int argc, char** argv)
 {
- int x, y, id, NX, NY, Nseg, seg;
+ int x, y, id, Nseg, seg, up;
  float length;
  int i;             /* counter */
- int *next; 		/* downstream seg id for present id*/
- int **before;		/* upstream seg id for present id */
- int *ct_before; 	/* number of upstream seg for present id */
- int *ct_id;		/* number of cells[x,y] crossed by seg id */
- int *segid;		/* seg id for seg number */
- int **seg_id;		/* seg id present in [x,y] */
- float *seg_length; /* segment length */
- int *x_id;		    /* x of [x,y] number ct_id in segment id; */
- int *y_id;		    /* y of [x,y] number ct_id in segment id; */
+ int nsegs;         /* number of segments read */
+ int maxsegs;       /* allocated segments */
+ SEGMENT *segs;
+ SEGHASH hash;
+ int *ct_before; 	/* number of upstream seg of seg number, then start in before */
+ int *before;		/* upstream seg ids, seg number by seg number */
+ int *down;         /* seg number of the downstream seg, -1 for none */
  int data;          /* temporarily store the destination cell */
- float *length_id;	        /* lenght of the entire cell id */
- float **length_xy;	        /* lenght if segment in gridcell*/ 
- float **azim_xy, dataf;    /* azimuth of the segment */
- float **elev_xy, hxy;      /* elevation of the segment */
+ float dataf;       /* azimuth of the segment */
+ float hxy;         /* elevation of the segment */
  float lid,lxy, hid;
- char convergence[150], outputdir[100];
+ char *convergence;
  int junki;
  float junkf;
- char junkc[350];
+ char line[LINE_LEN];
  int nskip;        /* header line number in stream map file */
+ int nline;
+ int nlost;        /* cells of segments not in the network file */
  FILE *fmap,*fnetwork,*fconv;
- int NsegDummy;
 
 if (argc != 6 ){
   printf("Command line arguments: enter <mapfile> <networkfile> <output directory> <Nseg> <skip>\n");
   printf("skip = lines of the header in stream map file\n");
+  printf("Nseg = number of segments in the network file, 0 to take them all\n");
   exit (0);
  }
  sscanf(argv[4],"%d", &Nseg);
  sscanf(argv[5],"%d", &nskip);
 
- Nseg++; // Nseg is 1 greater than the original hereafter
- NsegDummy = Nseg + 400;  //Increase the dimension of the matrix in case that streamnetwork is mannually 
-                          //modified to remove the redundant outlet "-1".
- 
  /*handle file names */
  fmap = fopen(argv[1], "r");
  if (fmap == NULL) {
-   fprintf(stderr,"NULL  %s \n", argv[1]); 
+   fprintf(stderr,"NULL  %s \n", argv[1]);
    exit(-1);
  }
  fprintf(stdout, " %s opened for reading\n", argv[1]);
 
  fnetwork = fopen(argv[2], "r");
- if (fmap == NULL) {
-   fprintf(stderr,"NULL  %s \n", argv[2]); 
+ if (fnetwork == NULL) {
+   fprintf(stderr,"NULL  %s \n", argv[2]);
    exit(-1);
  }
  fprintf(stdout, " %s opened for reading\n", argv[2]);
 
- sprintf(outputdir,argv[3]);
- strcpy(convergence, outputdir);
+ convergence = (char *) Allocate(strlen(argv[3]) + strlen("convergence.txt") + 1, 1,
+				 "convergence");
+ strcpy(convergence, argv[3]);
  strcat(convergence, "convergence.txt");
  fprintf(stdout, " %s opened for writing \n", convergence);
 
- /* allocate */
- if (!(segid = (int*) calloc(NsegDummy, sizeof(int)))) {
-   fprintf(stderr,"Failed to allocate variable 'segid'\n"); 
-   exit(-1);
- }
-
- if (!(seg_length = (float*) calloc(NsegDummy, sizeof(float)))) {
-   fprintf(stderr,"Failed to allocate variable 'segid'\n"); 
-   exit(-1);
- }
-
- if (!(next = (int*) calloc(NsegDummy, sizeof(int)))) {
-   fprintf(stderr,"Failed to allocate variable 'next'\n"); 
-   exit(-1);
- }
- if (!(before = (int**) calloc(MAXCONV,sizeof(int*)))) {
-   fprintf(stderr,"Failed to allocate variable 'before'\n"); 
-   exit(-1);
- }
- for (seg = 0; seg < MAXCONV; seg++){
-   if (!(before[seg] = (int*) calloc(NsegDummy, sizeof(int)))) {
-	 fprintf(stderr, "Failed to allocate variable 'before'\n");
-	 exit(-1);
-   }
- }
- if (!(ct_before = (int*) calloc(NsegDummy,sizeof(int)))) {
-   fprintf(stderr, "Failed to allocate variable 'ct_before'\n");
-   exit(-1);
- }
- if (!(ct_id = (int*) calloc(NsegDummy,sizeof(int)))) {
-   fprintf(stderr, "Failed to allocate variable 'ct_id'\n");
-   exit(-1);
- }
- if (!(length_id = (float*)calloc(NsegDummy,sizeof(float)))) {
-   fprintf(stderr, "Failed to allocate variable 'length_id'\n");
-   exit(-1);
- }
- if (!(azim_xy = (float**)calloc(MAX_XY,sizeof(float*)))) {
-   fprintf(stderr, "Failed to allocate variable 'azim_xy'\n");
-   exit(-1);
- }
- if (!(elev_xy = (float**)calloc(MAX_XY,sizeof(float*)))) {
-   fprintf(stderr, "Failed to allocate variable 'elev_xy'\n");
-   exit(-1);
- }
- if (!(length_xy = (float**)calloc(MAX_XY,sizeof(float*)))) {
-   fprintf(stderr, "Failed to allocate variable 'length_xy'\n");
-   exit(-1);
- }
- for (x = 0; x < MAX_XY; x++){
-   if (!(length_xy[x] = (float*) calloc(NsegDummy,sizeof(float)))) {
-	 fprintf(stderr, "Failed to allocate variable 'length_xy'\n");
-     exit(-1);
-   }
-   if (!(elev_xy[x] = (float*) calloc(NsegDummy,sizeof(float)))) {
-	 fprintf(stderr, "Failed to allocate variable 'elev_xy'\n");
-     exit(-1);
-   }
-   if (!(azim_xy[x] = (float*) calloc(NsegDummy,sizeof(float)))) {
-	 fprintf(stderr, "Failed to allocate variable 'azim_xy'\n");
-     exit(-1);
-   }
-  }
-
  /***** read network file *****/
- seg = -1;
- while (!feof(fnetwork)){
-   seg++;
-   if (seg >= Nseg) {
-     fprintf(stderr,
-		 "Increase the maximum number of segment in the basin in the code (Nseg)\n");
+ /* the 6th column of the network file is the destination segment of
+    the present segment, the outlet has the save flags after it */
+ maxsegs = (Nseg > 0) ? Nseg : 1024;
+ segs = (SEGMENT *) Allocate(maxsegs, sizeof(SEGMENT), "segs");
+ nsegs = 0;
+ nline = 0;
+ while (fgets(line, LINE_LEN, fnetwork) != NULL) {
+   nline++;
+   if (IsBlank(line))
+     continue;
+   if (sscanf(line, "%d %d %f %f %d %d", &id, &junki, &junkf, &length, &junki, &data) != 6) {
+     fprintf(stderr, "error reading %s at line %d\n", argv[2], nline);
      exit(-1);
-   }  
-
-   /* the 6th column of the network file is the destination segment of 
-   the present segment */
-   if (fscanf(fnetwork, "%d %d %f %f %d %d \n",&id,&junki,&junkf,&length,&junki,&data)!= 6){
-	 /* if the segment is the outlet, then it has 7 columns.
-	 Here just to skip reading the last save flags */
-	 if (data == 0 || data == -1 ) {
-		fgets(junkc, 100, fnetwork);
-		seg--;
-	 }
-	 else {
-       fprintf(stderr, "error reading %s at segment %d\n", argv[2], seg);
-       exit(-1);
-	 }
    }
-   segid[seg] = id;
-   seg_length[seg] = length;
-   
-   /* assign the destination cell to the present channel id */
-   next[id] = data;
-   if (data == -1 ) {
-	 data = 0; // outlet case of -1;
-	 printf("next-id = %d\n", next[51]);
-   }
-
-   ct_before[data]++;
-   if ( ct_before[data] >= MAXCONV ) {
-     fprintf(stderr,"Increase max num of stream that can converge at once %d\n",ct_before[next[id]]);
-     fprintf(stderr,"  seg %d , id, %d, next_id %d\n", seg, id, next[id]);
-     exit(-1);
+   if (nsegs == maxsegs) {
+     maxsegs *= 2;
+     if (!(segs = (SEGMENT *) realloc(segs, maxsegs * sizeof(SEGMENT)))) {
+       fprintf(stderr, "Failed to allocate variable 'segs'\n");
+       exit(-1);
+     }
    }
-   before[ct_before[data]][data] = id;
+   memset(&segs[nsegs], 0, sizeof(SEGMENT));
+   segs[nsegs].id = id;
+   segs[nsegs].next = data;
+   segs[nsegs].length = length;
+   nsegs++;
  }
  fclose(fnetwork);
- fprintf(stdout,"Read %d segments\n", seg + 1);
- if ((seg+1) != (Nseg-1)) {
+ fprintf(stdout,"Read %d segments\n", nsegs);
+ if (Nseg > 0 && nsegs != Nseg) {
    fprintf(stderr,"Error in the number of segment expected\n");
    exit(-1);
  }
- printf("next-id = %d\n", next[51]);
+
+ MakeHash(&hash, segs, nsegs);
+
+ /* the upstream segments of each segment, in the order of the network file */
+ down = (int *) Allocate(nsegs, sizeof(int), "down");
+ ct_before = (int *) Allocate(nsegs + 1, sizeof(int), "ct_before");
+ for (seg = 0; seg < nsegs; seg++) {
+   /* the outlet goes to -1 or 0, or another segment not in the network */
+   down[seg] = (segs[seg].next > 0) ? FindSeg(&hash, segs[seg].next) : -1;
+   if (down[seg] >= 0)
+     ct_before[down[seg] + 1]++;
+ }
+ for (seg = 0; seg < nsegs; seg++)
+   ct_before[seg + 1] += ct_before[seg];
+ before = (int *) Allocate(ct_before[nsegs] > 0 ? ct_before[nsegs] : 1, sizeof(int), "before");
+ for (seg = 0; seg < nsegs; seg++) {
+   if (down[seg] >= 0)
+     before[ct_before[down[seg]]++] = segs[seg].id;
+ }
+ /* ct_before[seg] is now the end of seg, the start of seg + 1 */
+ for (seg = nsegs; seg > 0; seg--)
+   ct_before[seg] = ct_before[seg - 1];
+ ct_before[0] = 0;
+
  /************ read map file **************/
 
  /* skip the headers */
  for (i = 0; i < nskip; i++)
-	fgets(junkc, 100, fmap);
+   if (fgets(line, LINE_LEN, fmap) == NULL)
+     break;
 
- while (!feof(fmap)){
-   /* initialize the variables */
-   id = -99;
-   lxy = -99;
-   
+ nlost = 0;
+ nline = nskip;
+ while (fgets(line, LINE_LEN, fmap) != NULL) {
+   nline++;
+   if (IsBlank(line))
+     continue;
    /* read in cell location, channel id, length and azimuth in sequence */
-   if (fscanf(fmap,"%d %d %d %f %f %f %f \n",&x, &y, &id, &lxy, &hxy, &junkf, &dataf)!= 7){
-     fprintf(stderr, "error reading %s at cell[%d][%d]\n", argv[1], x, y);
+   if (sscanf(line,"%d %d %d %f %f %f %f",&x, &y, &id, &lxy, &hxy, &junkf, &dataf)!= 7){
+     fprintf(stderr, "error reading %s at line %d\n", argv[1], nline);
      exit(-1);
    }
-   length_id[id] += lxy;
-   ct_id[id]++;
-
-   if (ct_id[id] >= MAX_XY) {
-     fprintf(stderr,"Increase MAX_XY: seg_id %d has (%d+1) upstream cells largert than MAX_XY %d\n",id,ct_id[id],MAX_XY);
-     exit(-1);
+   seg = FindSeg(&hash, id);
+   if (seg < 0) {
+     nlost++;
+     continue;
    }
-   length_xy[ct_id[id]][id] = lxy;
-   azim_xy[ct_id[id]][id] = dataf;
-   elev_xy[ct_id[id]][id] = hxy;
+   segs[seg].ncells++;
+   segs[seg].length_xy += lxy;
+   segs[seg].azim_xy += dataf * lxy;
+   segs[seg].elev_xy += hxy * lxy;
  }
  fclose(fmap);
+ if (nlost > 0)
+   fprintf(stdout, "%d cells of the map file are of segments not in the network file\n", nlost);
 
  /******** write convergence file *****/
  fconv = fopen(convergence, "w");
  if (fconv == NULL) {
-   fprintf(stderr,"NULL  %s \n", convergence); 
+   fprintf(stderr,"NULL  %s \n", convergence);
    exit(-1);
  }
 
- for (seg = 0; seg < (Nseg-1); seg++){
-   id = segid[seg];
+ for (seg = 0; seg < nsegs; seg++){
+   id = segs[seg].id;
 
    /* compute the weighted avg azimuth for the diff id based on azim_xy **/
-   y = ct_id[id] ;
-   lid = -99;
-   hid = -99;
-   if (y == 0 && id > 0) {
+   if (segs[seg].ncells == 0 && id > 0) {
      fprintf(stderr,"Error zero xy in seg id %d\n",id);
      exit(-1);
    }
-   else {
-     lid = 0;
-	 hid = 0.;
-     for (x = 1; x <= y; x++){
-       lid += azim_xy[x][id] * length_xy[x][id] / length_id[id];
-	   hid += elev_xy[x][id] * length_xy[x][id] / length_id[id];
-     }
-     if ( lid < 0 || lid > 360 ) {
-       fprintf(stderr,"Error azimuth %f\n",lid);
-       exit(-1);
-     }
-	 if (hid < 0) {
-       fprintf(stderr,"Error azimuth %f\n",hid);
-       exit(-1);
-     }
+   lid = 0.;
+   hid = 0.;
+   if (segs[seg].ncells > 0) {
+     lid = (float) (segs[seg].azim_xy / segs[seg].length_xy);
+     hid = (float) (segs[seg].elev_xy / segs[seg].length_xy);
    }
-   fprintf(fconv,"%d %d %.3f %.2f %.2f ",id, next[id], seg_length[seg], hid, lid);
-   y = ct_before[id] ;
-   if (y > 0)  {
-     for (x = 1; x <= y; x++) {
-       fprintf(fconv," %d ", before[x][id]);
-     }
+   if ( lid < 0 || lid > 360 ) {
+     fprintf(stderr,"Error azimuth %f\n",lid);
+     exit(-1);
    }
+   if (hid < 0) {
+     fprintf(stderr,"Error azimuth %f\n",hid);
+     exit(-1);
+   }
+   fprintf(fconv,"%d %d %.3f %.2f %.2f ",id, segs[seg].next, segs[seg].length, hid, lid);
+   for (up = ct_before[seg]; up < ct_before[seg + 1]; up++)
+     fprintf(fconv," %d ", before[up]);
    fprintf(fconv,"\n");
  }
- fclose(fconv);  
+ fclose(fconv);
 
  /***** clean up *****/
- free(segid);
- free(next);
+ free(segs);
+ free(hash.seg);
+ free(down);
  free(ct_before);
- for (x = 0; x < MAXCONV; x++) 
-   free(before[x]);
  free(before);
-
- free(length_id); 
- for (x = 0; x < MAX_XY; x++) 
-   free(length_xy[x]);
- free(length_xy);
- for (x = 0; x < MAX_XY; x++) 
-   free(azim_xy[x]);
- free(azim_xy);
-
- free(ct_id);
+ free(convergence);
 
  printf("completed .........................\n");
 
  return 0;
 }
 
+/*****************************************************************************
+  Allocate()
+*****************************************************************************/
+static void *Allocate(size_t n, size_t size, const char *name)
+{
+  void *p;
+
+  if (!(p = calloc(n, size))) {
+    fprintf(stderr, "Failed to allocate variable '%s'\n", name);
+    exit(-1);
+  }
+  return p;
+}
+
+/*****************************************************************************
+  MakeHash()
+*****************************************************************************/
+static void MakeHash(SEGHASH *hash, SEGMENT *segs, int nseg)
+{
+  unsigned int slot;
+  int seg;
+
+  for (hash->size = 16; hash->size < 2 * nseg; hash->size *= 2)
+    ;
+  hash->segs = segs;
+  hash->seg = (int *) Allocate(hash->size, sizeof(int), "hash");
+  for (slot = 0; slot < (unsigned int) hash->size; slot++)
+    hash->seg[slot] = -1;
+
+  for (seg = 0; seg < nseg; seg++) {
+    slot = ((unsigned int) segs[seg].id * 2654435761u) & (hash->size - 1);
+    while (hash->seg[slot] >= 0) {
+      if (segs[hash->seg[slot]].id == segs[seg].id) {
+	fprintf(stderr, "seg id %d is twice in the network file\n", segs[seg].id);
+	exit(-1);
+      }
+      slot = (slot + 1) & (hash->size - 1);
+    }
+    hash->seg[slot] = seg;
+  }
+}
+
+/*****************************************************************************
+  FindSeg()
+
+  seg number of seg id, or -1
+*****************************************************************************/
+static int FindSeg(const SEGHASH *hash, int id)
+{
+  unsigned int slot;
+
+  slot = ((unsigned int) id * 2654435761u) & (hash->size - 1);
+  while (hash->seg[slot] >= 0) {
+    if (hash->segs[hash->seg[slot]].id == id)
+      return hash->seg[slot];
+    slot = (slot + 1) & (hash->size - 1);
+  }
+  return -1;
+}
+
+/*****************************************************************************
+  IsBlank()
+*****************************************************************************/
+static int IsBlank(const char *line)
+{
+  while (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')
+    line++;
+  return *line == '\0';
+}